@@ -17,46 +17,245 @@
  */
 #include <cstdarg>
 #include <cstdio>
-#include <iostream>
-#include <sstream>
 #include <cstring>
-#include <libgen.h>
+#include <ctime>
+#include <cstdint>
+#include <iostream>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #include "Logger.h"
 #include "src/platform/Platform.h"
 
 namespace {
 
-std::mutex logMutex;
+// Callers only format their message into a free slot of the ring, the writer
+// thread adds the time stamp and does the I/O. The ring is a bounded MPSC queue:
+// a slot's sequence tells whether it is free for the producer at that position
+// or ready for the writer. When it is full, callers wait for the writer a bit
+// and then drop their message so that logging never blocks for long. Errors
+// are written before the call returns, as they often precede a crash.
+constexpr size_t RING_SIZE = 1024;
+constexpr size_t MESSAGE_SIZE = 1024;
+constexpr int WRITER_IDLE_MS = 20;
+constexpr int FULL_RING_WAIT_MS = 50;
+
+struct Slot {
+    std::atomic<size_t> sequence;
+    char level;
+    time_t time;
+    char text[MESSAGE_SIZE];
+};
+
+struct Ring {
+    Slot slots[RING_SIZE];
+    std::atomic<size_t> enqueuePos {0};
+    size_t dequeuePos = 0;
+
+    Ring() {
+        for (size_t i = 0; i < RING_SIZE; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+};
 
+Ring ring;
+std::atomic<size_t> droppedMessages {0};
+std::atomic_bool writerRunning {false};
+std::atomic_bool stopWriter {false};
+// callers that saw the writer running and may still publish into the ring
+std::atomic_int activeProducers {0};
+std::thread writerThread;
+
+// guards the file and the reading side of the ring
+std::mutex fileMutex;
 fs::ofstream logFile;
 bool toStdOut = false;
 
-void log(const std::string format, va_list args) {
-    std::lock_guard<std::mutex> lock(logMutex);
+const char *baseName(const char *path) {
+    const char *name = path;
+    for (const char *c = path; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    return name;
+}
+
+void writeLine(char level, time_t time, const char *text) {
+    if (!logFile) {
+        return;
+    }
+
+    char stamp[16];
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&time));
+    logFile << stamp << " " << level << ": " << text << '\n';
+    if (toStdOut) {
+        std::cout << stamp << " " << level << ": " << text << std::endl;
+    }
+}
+
+Slot *acquireSlot() {
+    size_t pos = ring.enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = ring.slots[pos % RING_SIZE];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (ring.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (diff < 0) {
+            return nullptr;
+        } else {
+            pos = ring.enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void publishSlot(Slot *slot) {
+    size_t seq = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(seq + 1, std::memory_order_release);
+}
+
+bool drainRing() {
+    bool any = false;
+    for (;;) {
+        Slot &slot = ring.slots[ring.dequeuePos % RING_SIZE];
+        if (slot.sequence.load(std::memory_order_acquire) != ring.dequeuePos + 1) {
+            break;
+        }
+        writeLine(slot.level, slot.time, slot.text);
+        slot.sequence.store(ring.dequeuePos + RING_SIZE, std::memory_order_release);
+        ring.dequeuePos++;
+        any = true;
+    }
+
+    size_t dropped = droppedMessages.exchange(0);
+    if (dropped > 0) {
+        char text[64];
+        snprintf(text, sizeof(text), "%zu log messages dropped, log ring was full", dropped);
+        writeLine('w', time(nullptr), text);
+        any = true;
+    }
+    return any;
+}
 
-    if (logFile) {
-        char buf[8192];
-        vsnprintf(buf, sizeof(buf), format.c_str(), args);
+void writerLoop() {
+    while (!stopWriter) {
+        bool any;
+        {
+            std::lock_guard<std::mutex> lock(fileMutex);
+            any = drainRing();
+            if (any) {
+                std::flush(logFile);
+            }
+        }
+        if (!any) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_IDLE_MS));
+        }
+    }
+}
 
-        std::stringstream logStr;
-        logStr << platform::getLocalTime("%H:%M:%S") << " " << buf;
-        logFile << logStr.str() << std::endl;
-        if (toStdOut) {
-            std::cout << logStr.str() << std::endl;
+void writeThrough(Slot *slot, size_t published) {
+    // the slot is written once the ones published before it are, which only
+    // takes long if their producers are interrupted while formatting
+    std::lock_guard<std::mutex> lock(fileMutex);
+    for (int i = 0; i < FULL_RING_WAIT_MS; i++) {
+        drainRing();
+        if (slot->sequence.load(std::memory_order_acquire) != published) {
+            break;
         }
-        std::flush(logFile);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::flush(logFile);
+}
+
+// file is set by the LOG_ macros, their messages start with file::function():line
+void log(char level, const char *file, const char *function, int line, const char *format, va_list args) {
+    // counted before looking at writerRunning, so shutdown can wait for the
+    // callers that still use the ring
+    activeProducers++;
+    if (!writerRunning) {
+        activeProducers--;
+        std::lock_guard<std::mutex> lock(fileMutex);
+        if (logFile) {
+            char text[MESSAGE_SIZE];
+            int len = file ? snprintf(text, sizeof(text), "%s::%s():%d ", baseName(file), function, line) : 0;
+            vsnprintf(text + len, sizeof(text) - len, format, args);
+            writeLine(level, time(nullptr), text);
+            std::flush(logFile);
+        }
+        return;
+    }
+
+    Slot *slot = acquireSlot();
+    for (int i = 0; !slot && i < FULL_RING_WAIT_MS && writerRunning; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        slot = acquireSlot();
+    }
+    if (!slot) {
+        droppedMessages++;
+        activeProducers--;
+        return;
+    }
+    slot->level = level;
+    slot->time = time(nullptr);
+    int len = file ? snprintf(slot->text, sizeof(slot->text), "%s::%s():%d ", baseName(file), function, line) : 0;
+    if (len < 0 || len >= (int) sizeof(slot->text)) {
+        len = 0;
+    }
+    vsnprintf(slot->text + len, sizeof(slot->text) - len, format, args);
+    publishSlot(slot);
+    size_t published = slot->sequence.load(std::memory_order_relaxed);
+    activeProducers--;
+
+    if (level == 'e') {
+        writeThrough(slot, published);
     }
 }
 
+// executables that don't call shutdown still get their last messages written
+struct WriterGuard {
+    ~WriterGuard() {
+        logger::shutdown();
+    }
+} writerGuard;
+
 }
 
 void logger::init(const std::string &path) {
-    logFile.open(fs::u8path(path + "AviTab.log"));
+    shutdown();
+    {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        logFile.open(fs::u8path(path + "AviTab.log"));
+    }
+    stopWriter = false;
+    writerThread = std::thread(writerLoop);
+    writerRunning = true;
     info("AviTab logger initialized");
 }
 
+void logger::shutdown() {
+    if (!writerThread.joinable()) {
+        return;
+    }
+    // new messages are written directly from now on, the ring is drained once
+    // the callers that were still publishing into it are done
+    writerRunning = false;
+    while (activeProducers > 0) {
+        std::this_thread::yield();
+    }
+    stopWriter = true;
+    writerThread.join();
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+    drainRing();
+    std::flush(logFile);
+}
+
 void logger::setStdOut(bool logToStdOut) {
     toStdOut = logToStdOut;
 }
@@ -64,78 +263,59 @@ void logger::setStdOut(bool logToStdOut) {
 void logger::verbose(const std::string format, ...) {
     va_list args;
     va_start(args, format);
-    log("v: " + format, args);
+    log('v', nullptr, nullptr, 0, format.c_str(), args);
     va_end(args);
 }
 
 void logger::info(const std::string format, ...) {
     va_list args;
     va_start(args, format);
-    log("i: " + format, args);
+    log('i', nullptr, nullptr, 0, format.c_str(), args);
     va_end(args);
 }
 
 void logger::warn(const std::string format, ...) {
     va_list args;
     va_start(args, format);
-    log("w: " + format, args);
+    log('w', nullptr, nullptr, 0, format.c_str(), args);
     va_end(args);
 }
 
 void logger::error(const std::string format, ...) {
     va_list args;
     va_start(args, format);
-    log("e: " + format, args);
+    log('e', nullptr, nullptr, 0, format.c_str(), args);
     va_end(args);
 }
 
-#define MAX_LOG_SIZE 1024
-
 void logger::log_info(bool enable, const char *file, const char *function, const int line, const char *format, ... ) {
     if (enable) {
-        char fileNonConst[MAX_LOG_SIZE];
-        char message[MAX_LOG_SIZE];
         va_list ap;
-        strncpy(fileNonConst, file, sizeof(fileNonConst) - 1);
         va_start(ap, format);
-        vsnprintf(message, sizeof(message), format, ap);
-        logger::info("%s::%s():%d %s", basename(fileNonConst), function, line, message);
+        log('i', file, function, line, format, ap);
         va_end(ap);
     }
 }
 
 void logger::log_verbose(bool enable, const char *file, const char *function, const int line, const char *format, ... ) {
     if (enable) {
-        char fileNonConst[MAX_LOG_SIZE];
-        char message[MAX_LOG_SIZE];
         va_list ap;
-        strncpy(fileNonConst, file, sizeof(fileNonConst) - 1);
         va_start(ap, format);
-        vsnprintf(message, sizeof(message), format, ap);
-        logger::verbose("%s::%s():%d %s", basename(fileNonConst), function, line, message);
+        log('v', file, function, line, format, ap);
         va_end(ap);
     }
 }
 
 void logger::log_warn(const char *file, const char *function, const int line, const char *format, ... ) {
-    char fileNonConst[MAX_LOG_SIZE];
-    char message[MAX_LOG_SIZE];
     va_list ap;
-    strncpy(fileNonConst, file, sizeof(fileNonConst) - 1);
     va_start(ap, format);
-    vsnprintf(message, sizeof(message), format, ap);
-    logger::warn("%s::%s():%d %s", basename(fileNonConst), function, line, message);
+    log('w', file, function, line, format, ap);
     va_end(ap);
 }
 
 void logger::log_error(const char *file, const char *function, const int line, const char *format, ... ) {
-    char fileNonConst[MAX_LOG_SIZE];
-    char message[MAX_LOG_SIZE];
     va_list ap;
-    strncpy(fileNonConst, file, sizeof(fileNonConst) - 1);
     va_start(ap, format);
-    vsnprintf(message, sizeof(message), format, ap);
-    logger::error("%s::%s():%d %s", basename(fileNonConst), function, line, message);
+    log('e', file, function, line, format, ap);
     va_end(ap);
 }
-
@@ -20,13 +20,23 @@
 
 #include <string>
 
-#define LOG_VERBOSE(enable_expression, ...) logger::log_verbose(enable_expression, __FILE__,__FUNCTION__,__LINE__,__VA_ARGS__)
-#define LOG_INFO(enable_expression, ...) logger::log_info(enable_expression, __FILE__,__FUNCTION__,__LINE__,__VA_ARGS__)
+// Builds with -DAVITAB_DEBUG_LOGGING=0 compile the LOG_VERBOSE and LOG_INFO call sites out.
+// Otherwise their arguments are only evaluated if enable_expression is true.
+#ifndef AVITAB_DEBUG_LOGGING
+#define AVITAB_DEBUG_LOGGING 1
+#endif
+
+#define LOG_VERBOSE(enable_expression, ...) do { if (AVITAB_DEBUG_LOGGING && (enable_expression)) logger::log_verbose(true, __FILE__,__FUNCTION__,__LINE__,__VA_ARGS__); } while (0)
+#define LOG_INFO(enable_expression, ...) do { if (AVITAB_DEBUG_LOGGING && (enable_expression)) logger::log_info(true, __FILE__,__FUNCTION__,__LINE__,__VA_ARGS__); } while (0)
 #define LOG_WARN(...) logger::log_warn(__FILE__,__FUNCTION__,__LINE__,__VA_ARGS__)
 #define LOG_ERROR(...) logger::log_error(__FILE__,__FUNCTION__,__LINE__,__VA_ARGS__)
 
+// Messages are formatted by the calling thread into a lock-free ring and written
+// by a background thread started by init, so logging doesn't wait for the disk.
 namespace logger {
     void init(const std::string &path);
+    // writes the pending messages and stops the writer thread, later messages are written directly
+    void shutdown();
     void setStdOut(bool logToStdOut);
 
     void verbose(const std::string format, ...);
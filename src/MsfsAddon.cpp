@@ -22,6 +22,7 @@
 #include "src/avitab/AviTab.h"
 #include "src/Logger.h"
 #include "src/platform/CrashHandler.h"
+#include "src/platform/Executor.h"
 
 int main() {
     crash::registerHandler([] () {return 0;});
@@ -45,6 +46,7 @@ int main() {
         aviTab->stopApp();
         aviTab.reset();
         env.reset();
+        platform::Executor::shared().shutdown();
     } catch (const std::exception &e) {
         logger::error("Exception: %s", e.what());
     }
@@ -52,6 +54,7 @@ int main() {
     logger::verbose("Quitting main");
 
     crash::unregisterHandler();
+    logger::shutdown();
 
     return 0;
 }
@@ -24,6 +24,7 @@
 #include "src/avitab/AviTab.h"
 #include "src/Logger.h"
 #include "src/platform/CrashHandler.h"
+#include "src/platform/Executor.h"
 
 std::shared_ptr<avitab::Environment> environment;
 std::unique_ptr<avitab::AviTab> aviTab;
@@ -101,6 +102,8 @@ PLUGIN_API void XPluginStop(void) {
                 aviTab.reset();
             }
             environment.reset();
+            // the workers must be gone before the plugin is unloaded
+            platform::Executor::shared().shutdown();
             curl_global_cleanup();
         }
     } catch (const std::exception &e) {
@@ -109,6 +112,7 @@ PLUGIN_API void XPluginStop(void) {
 
     crash::unregisterHandler();
     logger::verbose("AviTab unloaded");
+    logger::shutdown();
 }
 
 #ifdef _WIN32
@@ -18,14 +18,24 @@
 #include <memory>
 #include <thread>
 #include <iostream>
+#include <string>
 #include "src/environment/standalone/StandAloneEnvironment.h"
 #include "src/avitab/AviTab.h"
 #include "src/Logger.h"
 #include "src/platform/CrashHandler.h"
+#include "src/platform/Executor.h"
 
-int main() {
+int main(int argc, char **argv) {
     crash::registerHandler([] () {return 0;});
 
+    // --replay <trace> plays a trace recorded with the config's recordTrace
+    std::string replayFile;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--replay") {
+            replayFile = argv[i + 1];
+        }
+    }
+
     try {
         // Using the heap so we can debug destructors with log messages
         auto env = std::make_shared<avitab::StandAloneEnvironment>();
@@ -39,6 +49,9 @@ int main() {
         logger::init(env->getProgramPath());
         logger::verbose("Main thread has id %d", std::this_thread::get_id());
         env->loadSettings();
+        if (!replayFile.empty()) {
+            env->replayTrace(replayFile);
+        }
 
         auto aviTab = std::make_unique<avitab::AviTab>(env);
         aviTab->startApp();
@@ -50,6 +63,7 @@ int main() {
         aviTab->stopApp();
         aviTab.reset();
         env.reset();
+        platform::Executor::shared().shutdown();
     } catch (const std::exception &e) {
         logger::error("Exception: %s", e.what());
     }
@@ -57,6 +71,7 @@ int main() {
     logger::verbose("Quitting main");
 
     crash::unregisterHandler();
+    logger::shutdown();
 
     return 0;
 }
@@ -65,6 +80,6 @@ int main() {
 #include <windows.h>
 
 int CALLBACK WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
-    return main();
+    return main(__argc, __argv);
 }
 #endif
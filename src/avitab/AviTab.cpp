@@ -16,398 +16,198 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <climits>
+#include <algorithm>
 #include <future>
 #include "AviTab.h"
 #include "src/libimg/TTFStamper.h"
 #include "src/Logger.h"
+#include "src/platform/Metrics.h"
+#include "src/platform/MemoryBudget.h"
+#include "src/platform/Tracer.h"
+#include "src/platform/Executor.h"
 #include "src/environment/Config.h"
-#include "src/avitab/apps/HeaderApp.h"
+#include "src/world/routing/Route.h"
 #include "src/avitab/apps/AppLauncher.h"
 
 namespace avitab {
 
 AviTab::AviTab(std::shared_ptr<Environment> environment):
-    env(environment),
-    guiLib(environment->createGUIToolkit())
+    env(environment)
 {
+    // the tablets share one GUI thread and everything but their apps
+    int tabletCount = std::max(1, std::min(env->getConfig()->getInt("/AviTab/tablets"), MAX_TABLETS));
+    if (tabletCount > 1 && !env->supportsMultipleGUIToolkits()) {
+        logger::warn("Only one tablet is supported here");
+        tabletCount = 1;
+    }
+    for (int number = 1; number <= tabletCount; number++) {
+        tablets.push_back(std::make_unique<Tablet>(*this, env, number));
+    }
+
     // runs in environment thread, called by PluginStart
     img::TTFStamper::setFontDirectory(env->getFontDirectory());
     if (env->getConfig()->getBool("/AviTab/loadNavData")) {
         env->loadNavWorldInBackground();
     }
-    chartService = std::make_shared<apis::ChartService>(env->getProgramPath());
-    jsRuntime = std::make_shared<js::Runtime>();
-    env->resumeEnvironmentJobs();
-}
 
-void AviTab::startApp() {
-    // runs in environment thread, called by PluginEnable
-    logger::verbose("Starting AviTab %s", AVITAB_VERSION_STR);
-
-    env->createMenu("AviTab");
-    env->createCommand("AviTab/toggle_tablet", "Toggle Tablet", [this] (CommandState s) { if (s == CommandState::START) toggleTablet(); });
-    env->createCommand("AviTab/zoom_in", "Zoom In", [this] (CommandState s) { if (s == CommandState::START) zoomIn(); });
-    env->createCommand("AviTab/zoom_out", "Zoom Out", [this] (CommandState s) { if (s == CommandState::START) zoomOut(); });
-    env->createCommand("AviTab/recentre", "Recentre", [this] (CommandState s) { if (s == CommandState::START) recentre(); });
-    env->createCommand("AviTab/pan_left", "Pan left", [this] (CommandState s) { if (s == CommandState::START) panLeft(); });
-    env->createCommand("AviTab/pan_right", "Pan right", [this] (CommandState s) { if (s == CommandState::START) panRight(); });
-    env->createCommand("AviTab/pan_up", "Pan up", [this] (CommandState s) { if (s == CommandState::START) panUp(); });
-    env->createCommand("AviTab/pan_down", "Pan down", [this] (CommandState s) { if (s == CommandState::START) panDown(); });
-    env->createCommand("AviTab/Home", "Home Button",[this] (CommandState s) { if (s == CommandState::START) onHomeButton(); });
-
-    // App commands
-    env->createCommand("AviTab/app_charts", "Charts App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::CHARTS); });
-    env->createCommand("AviTab/app_airports", "Airports App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::AIRPORTS); });
-    env->createCommand("AviTab/app_routes", "Routes App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::ROUTES); });
-    env->createCommand("AviTab/app_maps", "Maps App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::MAPS); });
-    env->createCommand("AviTab/app_plane_manual", "Plane Manual App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::PLANE_MANUAL); });
-    env->createCommand("AviTab/app_notes", "Notes App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::NOTES); });
-    env->createCommand("AviTab/app_navigraph", "Navigraph App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::NAVIGRAPH); });
-    env->createCommand("AviTab/app_youtube", "YouTube Live App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::YOUTUBE); });
-    env->createCommand("AviTab/app_about", "About App", [this] (CommandState s) { if (s == CommandState::START) showApp(AppId::ABOUT); });
-
-    env->createCommand("AviTab/click_left", "Left click", [this] (CommandState s) { handleLeftClick(s != CommandState::END); });
-    env->createCommand("AviTab/wheel_up", "Wheel up", [this] (CommandState s) { if (s == CommandState::START) handleWheel(true); });
-    env->createCommand("AviTab/wheel_down", "Wheel down", [this] (CommandState s) { if (s == CommandState::START) handleWheel(false); });
-
-    env->addMenuEntry("Toggle Tablet", [this] { toggleTablet(); });
-    env->addMenuEntry("Reset Position", [this] { resetWindowPosition(); });
-
-    guiLib->setMouseWheelCallback([this] (int dir, int x, int y) {
-        if (appLauncher) {
-            appLauncher->onMouseWheel(dir, x, y);
-        }
-    });
-    createPanel();
-    guiLib->executeLater(std::bind(&AviTab::createLayout, this));
-}
-
-void AviTab::toggleTablet() {
-    // runs in environment thread, called by menu or command
-    try {
-        if (!guiLib->hasNativeWindow()) {
-            logger::info("Showing tablet");
-            // It's possible that the user closed the window with the close button.
-            // Since we don't get any callback for this, it's possible that we didn't store the last window coordinates yet.
-            // For that reason, the last known position is tried first.
-            auto rect = guiLib->getNativeWindowRect();
-            if (rect.valid && !resetWindowRect) {
-                env->getSettings()->saveWindowRect(rect);
-            } else {
-                rect = env->getSettings()->getWindowRect();
-            }
-            guiLib->createNativeWindow(std::string("Aviator's Tablet  ") + AVITAB_VERSION_STR, rect);
-        } else {
-            close();
-        }
-    } catch (const std::exception &e) {
-        logger::error("Exception in onShowTablet: %s", e.what());
+    // a flight trace can be replayed by AviTab-standalone --replay <trace>
+    std::string traceFile = env->getConfig()->getString("/AviTab/recordTrace");
+    if (!traceFile.empty()) {
+        env->startTraceRecording(env->getProgramPath() + traceFile);
+        tablets.front()->getGUI()->setTraceRecorder(env->getTraceRecorder());
     }
-}
 
-void AviTab::resetWindowPosition() {
-    // runs in environment thread
-    env->getSettings()->saveWindowRect({});
-    if (guiLib->hasNativeWindow()) {
-        guiLib->pauseNativeWindow();
+    // the tablet can be used from another device in the network, see RemoteDisplay
+    int remotePort = env->getConfig()->getInt("/AviTab/remoteDisplayPort");
+    if (remotePort > 0) {
+        env->startRemoteDisplay(remotePort);
+        tablets.front()->getGUI()->setRemoteDisplay(env->getRemoteDisplay());
     }
-    resetWindowRect = true;
-    toggleTablet();
-    resetWindowRect = false;
-}
-
-void AviTab::onPlaneLoad() {
-    // runs in environment thread
-    // close on plane reload to reset the VR window position
-    close();
-    env->onAircraftReload();
-    createPanel();
-
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->onPlaneLoad();
-        }
-        auto screen = guiLib->screen();
-        if (hideHeader) {
-            headerApp.reset();
-            headContainer.reset();
-            if (centerContainer) {
-                centerContainer->setPosition(0, 0);
-                centerContainer->setDimensions(screen->getWidth(), screen->getHeight());
-            }
-        } else {
-            if (!headerApp) {
-                headerApp = std::make_shared<HeaderApp>(this);
-                headContainer = headerApp->getUIContainer();
-                headContainer->setParent(screen);
-                headContainer->setVisible(true);
-                headContainer->setFit(Container::Fit::FILL, Container::Fit::OFF);
-                if (centerContainer) {
-                    centerContainer->setPosition(0, 30);
-                    centerContainer->setDimensions(screen->getWidth(), screen->getHeight() - 30);
-                }
-            }
-        }
-    });
-}
 
-void AviTab::zoomIn() {
-    // called from environment thread
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->onMouseWheel(1, 0, 0);
-        }
-    });
-}
-
-void AviTab::zoomOut() {
-    // called from environment thread
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->onMouseWheel(-1, 0, 0);
-        }
-    });
-}
-
-void AviTab::recentre() {
-    // called from environment thread
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->recentre();
-        }
-    });
-}
-
-void AviTab::panLeft() {
-    // called from environment thread
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->pan(-10, 0); // 10% leftwards
-        }
-    });
-}
-
-void AviTab::panRight() {
-    // called from environment thread
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->pan(10, 0); // 10% rightwards
-        }
-    });
-}
-
-void AviTab::panUp() {
-    // called from environment thread
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->pan(0, -10); // 10% upwards
-        }
-    });
-}
-
-void AviTab::panDown() {
-    // called from environment thread
-    guiLib->executeLater([this] () {
-        if (appLauncher) {
-            appLauncher->pan(0, 10); // 10% downwards
-        }
-    });
-}
-
-void AviTab::createPanel() {
-    auto cfgFile = getAirplanePath() + "/AviTab.json";
-    try {
-        Config cfg(cfgFile);
-        int left = cfg.getInt("/panel/left");
-        int bottom = cfg.getInt("/panel/bottom");
-        int width = cfg.getInt("/panel/width");
-        int height = cfg.getInt("/panel/height");
-        bool enable = false;
-        bool disableCaptureWindow = false;
-        hideHeader = false;
-        try {
-            enable = cfg.getBool("/panel/enabled");
-        } catch (...) {
-        }
-        try {
-            hideHeader = cfg.getBool("/panel/hide_header");
-        } catch (...) {
-        }
-        try {
-            disableCaptureWindow = cfg.getBool("/panel/disable_capture_window");
-        } catch (...) {
-        }
-
-        guiLib->createPanel(left, bottom, width, height, !disableCaptureWindow);
-        if (enable) {
-            env->enableAndPowerPanel();
-        }
-    } catch (const std::exception &e) {
-        logger::info("No panel config - window only mode");
-        hideHeader = false;
-        guiLib->hidePanel();
+    // other programs can follow the map, see MapStateExport
+    if (env->getConfig()->getBool("/AviTab/exportMapState")) {
+        env->startMapStateExport();
     }
-}
-
-void AviTab::createLayout() {
-    // runs in GUI thread
-    auto screen = guiLib->screen();
-    screen->setOnResize([this] { this->onScreenResize(); });
 
-    if (!env->isNavWorldReady()) {
-        if (!loadLabel) {
-            loadLabel = std::make_shared<Label>(screen, "Loading nav data...");
-            loadLabel->centerInParent();
-        }
-
-        // try again later
-        guiLib->executeLater(std::bind(&AviTab::createLayout, this));
-        return;
+    // spans of all threads, written by the dump_span_trace command and on exit
+    std::string spanTrace = env->getConfig()->getString("/AviTab/spanTrace");
+    if (!spanTrace.empty()) {
+        spanTraceFile = env->getProgramPath() + spanTrace;
+        platform::Tracer::start();
     }
 
-    loadLabel.reset();
+    // Independent and slow steps run in the background, createLayout waits for them.
+    // The chart service scans the calibration files.
+    std::string programPath = env->getProgramPath();
+    startupTasks.add("fonts", [] {
+        img::TTFStamper::preloadFont("Inconsolata.ttf");
+        img::TTFStamper::preloadFont("DejaVuSans.ttf");
+    });
+    startupTasks.add("icons", [programPath] { AppLauncher::preloadIcons(programPath + "icons/"); });
+    startupTasks.add("charts", [this, programPath] {
+        chartService = std::make_shared<apis::ChartService>(programPath);
+    }, {"fonts"});
+    startupTasks.start(STARTUP_WORKERS);
 
-    if (!hideHeader) {
-        if (!headerApp) {
-            headerApp = std::make_shared<HeaderApp>(this);
-            headContainer = headerApp->getUIContainer();
-            headContainer->setParent(screen);
-            headContainer->setVisible(true);
+    // QuickJS checks the stack of the thread that created the runtime, so not in the background
+    jsRuntime = std::make_shared<js::Runtime>();
+    if (platform::fileExists(programPath + "scripts")) {
+        int budgetMicros = env->getSettings()->getGeneralSetting<int>("script_budget_us");
+        if (budgetMicros > 0) {
+            jsRuntime->setFrameBudget(std::chrono::microseconds(budgetMicros));
         }
+        jsRuntime->setBytecodeCache(programPath + "scripts/cache/");
+        jsRuntime->loadScripts(programPath + "scripts/");
     }
-
-    if (!appLauncher) {
-        showAppLauncher();
-    }
+    env->resumeEnvironmentJobs();
 }
 
-void AviTab::onScreenResize() {
-    auto screen = guiLib->screen();
-    int width = screen->getWidth();
-    int height = screen->getHeight();
-
-    if (headerApp) {
-        headerApp->onScreenResize(width, height);
-    }
-
-    if (appLauncher) {
-        if (hideHeader) {
-            appLauncher->onScreenResize(width, height);
-        } else {
-            appLauncher->onScreenResize(width, height - 30);
-        }
-    }
-}
+void AviTab::startApp() {
+    // runs in environment thread, called by PluginEnable
+    logger::verbose("Starting AviTab %s with %d tablets", AVITAB_VERSION_STR, (int) tablets.size());
 
-void AviTab::showAppLauncher() {
-    if (!appLauncher) {
-        appLauncher = std::make_shared<AppLauncher>(this);;
+    env->createMenu("AviTab");
+    for (auto &tablet: tablets) {
+        createTabletCommands(tablet.get());
     }
-    appLauncher->show();
-}
 
-void AviTab::showApp(AppId id) {
-    if (appLauncher) {
-        guiLib->executeLater([this, id] () {
-            appLauncher->showApp(id);
+    if (!spanTraceFile.empty()) {
+        env->createCommand("AviTab/dump_span_trace", "Write span trace", [this] (CommandState s) {
+            if (s == CommandState::START) {
+                // not in the simulator's thread, writing takes a while
+                platform::Executor::shared().submit("tracer", platform::Executor::Priority::BACKGROUND, [this] { writeSpanTrace(); });
+            }
         });
     }
-}
-
-void AviTab::setIsInMenu(bool inMenu) {
-    env->setIsInMenu(inMenu);
-}
 
-std::shared_ptr<Container> AviTab::createGUIContainer() {
-    auto screen = guiLib->screen();
-    auto container = std::make_shared<Container>(screen);
-    container->setVisible(false);
-    if (hideHeader) {
-        container->setPosition(0, 0);
-        container->setDimensions(screen->getWidth(), screen->getHeight());
-    } else {
-        container->setPosition(0, 30);
-        container->setDimensions(screen->getWidth(), screen->getHeight() - 30);
+    if (jsRuntime->hasFrameHandlers()) {
+        scriptsStartedAt = std::chrono::steady_clock::now();
+        env->setFrameCallback([this] { runScripts(); });
     }
 
-    return container;
-}
+    size_t budgetMb = std::max(0, env->getSettings()->getGeneralSetting<int>("memory_budget_mb"));
+    platform::MemoryBudget::shared().setBudget(budgetMb * 1024 * 1024);
 
-void AviTab::showGUIContainer(std::shared_ptr<Container> container) {
-    if (centerContainer) {
-        centerContainer->setVisible(false);
+    int metricsLogSeconds = env->getSettings()->getGeneralSetting<int>("metrics_log_seconds");
+    if (metricsLogSeconds > 0) {
+        tablets.front()->executeLater([this, metricsLogSeconds] () {
+            metricsLogTimer = std::make_unique<Timer>([] () {
+                platform::Metrics::logSnapshot();
+                return true;
+            }, metricsLogSeconds * 1000);
+        });
     }
 
-    auto screen = guiLib->screen();
-    centerContainer = container;
-    centerContainer->setParent(screen);
-    if (hideHeader) {
-        centerContainer->setPosition(0, 0);
-        centerContainer->setDimensions(screen->getWidth(), screen->getHeight());
-    } else {
-        centerContainer->setPosition(0, 30);
-        centerContainer->setDimensions(screen->getWidth(), screen->getHeight() - 30);
+    for (auto &tablet: tablets) {
+        tablet->start();
     }
-    centerContainer->setVisible(true);
 }
 
-void AviTab::setBrightness(float brightness) {
-    guiLib->setBrightness(brightness);
-}
+void AviTab::createTabletCommands(Tablet *tablet) {
+    // the main tablet keeps the plain names, the others get their number
+    int n = tablet->getNumber();
+    std::string prefix = (n == 1) ? "AviTab/" : "AviTab/tablet" + std::to_string(n) + "/";
+    std::string suffix = (n == 1) ? "" : " " + std::to_string(n);
 
-float AviTab::getBrightness() {
-    return guiLib->getBrightness();
-}
-
-std::shared_ptr<world::World> AviTab::getNavWorld() {
-    return env->getNavWorld();
-}
-
-void AviTab::executeLater(std::function<void()> func) {
-    guiLib->executeLater(func);
-}
-
-std::string AviTab::getDataPath() {
-    return env->getProgramPath();
-}
+    env->createCommand(prefix + "toggle_tablet", "Toggle Tablet" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->toggleTablet(); });
+    env->createCommand(prefix + "zoom_in", "Zoom In" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->zoomIn(); });
+    env->createCommand(prefix + "zoom_out", "Zoom Out" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->zoomOut(); });
+    env->createCommand(prefix + "recentre", "Recentre" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->recentre(); });
+    env->createCommand(prefix + "pan_left", "Pan left" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->panLeft(); });
+    env->createCommand(prefix + "pan_right", "Pan right" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->panRight(); });
+    env->createCommand(prefix + "pan_up", "Pan up" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->panUp(); });
+    env->createCommand(prefix + "pan_down", "Pan down" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->panDown(); });
+    env->createCommand(prefix + "Home", "Home Button" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->onHomeButton(); });
 
-std::string AviTab::getFlightPlansPath() {
-    return env->getFlightPlansPath();
-}
+    // App commands
+    env->createCommand(prefix + "app_charts", "Charts App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::CHARTS); });
+    env->createCommand(prefix + "app_airports", "Airports App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::AIRPORTS); });
+    env->createCommand(prefix + "app_routes", "Routes App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::ROUTES); });
+    env->createCommand(prefix + "app_maps", "Maps App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::MAPS); });
+    env->createCommand(prefix + "app_plane_manual", "Plane Manual App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::PLANE_MANUAL); });
+    env->createCommand(prefix + "app_notes", "Notes App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::NOTES); });
+    env->createCommand(prefix + "app_navigraph", "Navigraph App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::NAVIGRAPH); });
+    env->createCommand(prefix + "app_youtube", "YouTube Live App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::YOUTUBE); });
+    env->createCommand(prefix + "app_about", "About App" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->showApp(AppId::ABOUT); });
 
-std::string AviTab::getEarthTexturePath() {
-    return env->getEarthTexturePath();
-}
+    env->createCommand(prefix + "click_left", "Left click" + suffix, [tablet] (CommandState s) { tablet->handleLeftClick(s != CommandState::END); });
+    env->createCommand(prefix + "wheel_up", "Wheel up" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->handleWheel(true); });
+    env->createCommand(prefix + "wheel_down", "Wheel down" + suffix, [tablet] (CommandState s) { if (s == CommandState::START) tablet->handleWheel(false); });
 
-std::string AviTab::getAirplanePath() {
-    return env->getAirplanePath();
+    env->addMenuEntry("Toggle Tablet" + suffix, [tablet] { tablet->toggleTablet(); });
+    env->addMenuEntry("Reset Position" + suffix, [tablet] { tablet->resetWindowPosition(); });
 }
 
-AviTab::MagVarMap AviTab::getMagneticVariations(std::vector<std::pair<double, double>> locations) {
-    return env->getMagneticVariations(locations);
+void AviTab::toggleTablet() {
+    tablets.front()->toggleTablet();
 }
 
-std::string AviTab::getMETARForAirport(const std::string &icao) {
-    return env->getMETARForAirport(icao);
+void AviTab::onPlaneLoad() {
+    // runs in environment thread
+    // close on plane reload to reset the VR window position
+    for (auto &tablet: tablets) {
+        tablet->close();
+    }
+    env->onAircraftReload();
+    for (auto &tablet: tablets) {
+        tablet->onPlaneLoad();
+    }
 }
 
-
-void AviTab::reloadMetar() {
-    logger::info("Reloading METAR...");
-    env->reloadMetar();
-    logger::info("Done METAR");
+bool AviTab::isStartupDone() {
+    return startupTasks.isDone();
 }
 
-void AviTab::loadUserFixes(std::string filename) {
-    env->loadUserFixes(filename);
+std::shared_ptr<apis::ChartService> AviTab::getChartService() {
+    return chartService;
 }
 
-world::NavNodeList AviTab::loadFlightPlan(const std::string filename) {
-    return env->loadFlightPlan(filename);
+std::shared_ptr<world::Procedure> AviTab::getProcedure() {
+    return activeProcedure;
 }
 
-std::shared_ptr<apis::ChartService> AviTab::getChartService() {
-    return chartService;
+void AviTab::setProcedure(std::shared_ptr<world::Procedure> procedure) {
+    activeProcedure = procedure;
 }
 
 std::shared_ptr<world::Route> AviTab::getRoute() {
@@ -416,43 +216,14 @@ std::shared_ptr<world::Route> AviTab::getRoute() {
 
 void AviTab::setRoute(std::shared_ptr<world::Route> route) {
     activeRoute = route;
-}
-
-std::shared_ptr<world::RouteFinder> AviTab::getRouteFinder() {
-    return getNavWorld()->getRouteFinder();
-}
-
-void AviTab::updateMapExports(float lat, float lon, int zoom, float vrange) {
-    env->updateMapExports(lat, lon, zoom, vrange);
-}
-
-AircraftID AviTab::getActiveAircraftCount() {
-    return env->getActiveAircraftCount();
-}
-
-Location AviTab::getAircraftLocation(AircraftID id) {
-    return env->getAircraftLocation(id);
-}
-
-float AviTab::getLastFrameTime() {
-    return env->getLastFrameTime();
-}
-
-std::shared_ptr<Settings> AviTab::getSettings() {
-    return env->getSettings();
-}
-
-void AviTab::onHomeButton() {
-    showAppLauncher();
-}
 
-void AviTab::close() {
-    logger::info("Closing tablet");
-    env->runInEnvironment([this] () {
-        if (guiLib->hasNativeWindow()) {
-            guiLib->pauseNativeWindow();
-        }
-    });
+    if (route && chartService) {
+        auto start = route->getStart();
+        auto dest = route->getDestination();
+        std::string departure = (start && start->isAirport()) ? start->getID() : "";
+        std::string destination = (dest && dest->isAirport()) ? dest->getID() : "";
+        chartService->prefetchCharts(departure, destination);
+    }
 }
 
 void AviTab::stopApp() {
@@ -462,19 +233,25 @@ void AviTab::stopApp() {
     // job to run, we would create a deadlock now. So for a proper
     // shutdown, we must do the following:
 
-    // remember the last window position
-    auto rect = guiLib->getNativeWindowRect();
-    env->getSettings()->saveWindowRect(rect);
+    env->setFrameCallback(nullptr);
+
+    // remember the last window positions
+    for (auto &tablet: tablets) {
+        tablet->saveWindowRect();
+    }
 
     // Cancel the loading if it is still running
     env->cancelNavWorldLoading();
+    startupTasks.wait();
 
     // Stop the chart APIs so they no longer call the GUI
     chartService->stop();
 
     // Tell the GUI to not execute more background jobs
     // after the current ones have finished
-    guiLib->signalStop();
+    for (auto &tablet: tablets) {
+        tablet->signalStop();
+    }
 
     // Let the environment run its callbacks one last time,
     // letting the GUI jobs finish to release the wait on the
@@ -486,30 +263,38 @@ void AviTab::stopApp() {
     env->destroyMenu();
     env->destroyCommands();
 
-    // this will also join the GUI thread
-    guiLib->destroyNativeWindow();
-
-    cleanupLayout();
-}
+    // the last one will also join the GUI thread
+    for (auto &tablet: tablets) {
+        tablet->destroyWindow();
+    }
 
-void AviTab::cleanupLayout() {
     logger::verbose("Stopping AviTab");
-    headContainer.reset();
-    centerContainer.reset();
-    headerApp.reset();
-    appLauncher.reset();
-}
+    metricsLogTimer.reset();
+    for (auto &tablet: tablets) {
+        tablet->cleanupLayout();
+    }
+    writeSpanTrace();
+}
+
+void AviTab::runScripts() {
+    // runs in environment thread, every frame
+    js::FrameState state;
+    state.timeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - scriptsStartedAt).count();
+    state.frameTime = env->getLastFrameTime();
+    auto aircraft = env->getAircraftLocations();
+    state.aircraft.reserve(aircraft->locations.size());
+    for (auto &loc: aircraft->locations) {
+        state.aircraft.push_back({loc.latitude, loc.longitude, loc.elevation, loc.heading});
+    }
 
-void AviTab::handleLeftClick(bool down) {
-    guiLib->sendLeftClick(down);
+    jsRuntime->setWorld(env->isNavWorldReady() ? env->getNavWorld() : nullptr);
+    jsRuntime->runFrame(state);
 }
 
-void AviTab::handleWheel(bool up) {
-    guiLib->executeLater([this, up] () {
-        if (appLauncher) {
-            appLauncher->onMouseWheel(up ? 1 : -1, 0, 0);
-        }
-    });
+void AviTab::writeSpanTrace() {
+    if (!spanTraceFile.empty()) {
+        platform::Tracer::writeChromeTrace(spanTraceFile);
+    }
 }
 
 AviTab::~AviTab() {
@@ -19,91 +19,62 @@
 
 #include <memory>
 #include <future>
+#include <vector>
 #include "src/charts/libnavigraph/NavigraphAPI.h"
 #include "src/charts/ChartService.h"
 #include "src/environment/Environment.h"
-#include "src/gui_toolkit/widgets/Container.h"
-#include "src/gui_toolkit/widgets/Label.h"
-#include "src/avitab/apps/AppFunctions.h"
-#include "src/avitab/apps/AppLauncher.h"
+#include "src/gui_toolkit/Timer.h"
+#include "src/avitab/Tablet.h"
 #include "src/scripting/Runtime.h"
+#include "src/platform/StartupTasks.h"
 
 namespace avitab {
 
-class AviTab: public AppFunctions {
+// The plugin's commands, menu and tablets with what the tablets share
+class AviTab {
 public:
     AviTab(std::shared_ptr<Environment> environment);
     void startApp();
+    // the main tablet's
     void toggleTablet();
-    void resetWindowPosition();
-    void zoomIn();
-    void zoomOut();
-    void recentre();
-    void panLeft();
-    void panRight();
-    void panUp();
-    void panDown();
     void stopApp();
     void onPlaneLoad();
 
-    // App API
-    void setBrightness(float brightness) override;
-    float getBrightness() override;
-    void executeLater(std::function<void()> func) override;
-    std::string getDataPath() override;
-    std::string getEarthTexturePath() override;
-    std::string getAirplanePath() override;
-    std::string getFlightPlansPath() override;
-    std::shared_ptr<Container> createGUIContainer() override;
-    void showGUIContainer(std::shared_ptr<Container> container) override;
-    void onHomeButton() override;
-    std::shared_ptr<world::World> getNavWorld() override;
-    using MagVarMap = std::map<std::pair<double, double>, double>;
-    MagVarMap getMagneticVariations(std::vector<std::pair<double, double>> locations) override;
-    std::string getMETARForAirport(const std::string &icao) override;
-    void reloadMetar() override;
-    void loadUserFixes(std::string filename) override;
-    world::NavNodeList loadFlightPlan(const std::string filename) override;
-    void close() override;
-    void setIsInMenu(bool inMenu) override;
-    std::shared_ptr<apis::ChartService> getChartService() override;
-    AircraftID getActiveAircraftCount() override;
-    Location getAircraftLocation(AircraftID id) override;
-    float getLastFrameTime() override;
-    std::shared_ptr<Settings> getSettings() override;
-    std::shared_ptr<world::Route> getRoute() override;
-    void setRoute(std::shared_ptr<world::Route> route) override;
-    std::shared_ptr<world::RouteFinder> getRouteFinder() override;
-    void updateMapExports(float lat, float lon, int zoom, float vrange) override;
+    // shared by the tablets, called from the GUI thread
+    bool isStartupDone();
+    std::shared_ptr<apis::ChartService> getChartService();
+    std::shared_ptr<world::Route> getRoute();
+    void setRoute(std::shared_ptr<world::Route> route);
+    std::shared_ptr<world::Procedure> getProcedure();
+    void setProcedure(std::shared_ptr<world::Procedure> procedure);
 
     ~AviTab();
 
 private:
-    bool hideHeader = false;
-    std::shared_ptr<Environment> env;
-    std::shared_ptr<LVGLToolkit> guiLib;
-    std::shared_ptr<Label> loadLabel;
-
-    std::shared_ptr<Container> headContainer;
-    std::shared_ptr<Container> centerContainer;
+    static constexpr const size_t STARTUP_WORKERS = 3;
+    static constexpr const int MAX_TABLETS = 4;
 
-    std::shared_ptr<App> headerApp;
-    std::shared_ptr<AppLauncher> appLauncher;
+    std::shared_ptr<Environment> env;
     std::shared_ptr<world::Route> activeRoute;
+    std::shared_ptr<world::Procedure> activeProcedure;
+    // dumps the metrics every metrics_log_seconds if that setting is not 0
+    std::unique_ptr<Timer> metricsLogTimer;
+    // where the span trace is written, empty if spans aren't traced
+    std::string spanTraceFile;
 
     std::shared_ptr<apis::ChartService> chartService;
     std::shared_ptr<js::Runtime> jsRuntime;
-    bool resetWindowRect = false;
+    std::chrono::steady_clock::time_point scriptsStartedAt;
+
+    // the first one is the main tablet, set by config.json's "tablets"
+    std::vector<std::unique_ptr<Tablet>> tablets;
 
-    void createPanel();
-    void createLayout();
-    void showAppLauncher();
-    void showApp(AppId id);
-    void cleanupLayout();
+    // last so that it's destroyed first, its tasks fill the members above
+    platform::StartupTasks startupTasks;
 
-    void onScreenResize();
-    void handleLeftClick(bool down);
-    void handleWheel(bool up);
+    void createTabletCommands(Tablet *tablet);
+    void writeSpanTrace();
+    void runScripts();
 };
 
 } /* namespace avitab */
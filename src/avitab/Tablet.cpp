@@ -0,0 +1,558 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include "Tablet.h"
+#include "AviTab.h"
+#include "src/Logger.h"
+#include "src/environment/Config.h"
+#include "src/avitab/apps/HeaderApp.h"
+
+namespace avitab {
+
+Tablet::Tablet(AviTab &aviTab, std::shared_ptr<Environment> environment, int number):
+    aviTab(aviTab),
+    env(environment),
+    number(number),
+    guiLib(environment->createGUIToolkit())
+{
+}
+
+int Tablet::getNumber() const {
+    return number;
+}
+
+std::shared_ptr<LVGLToolkit> Tablet::getGUI() {
+    return guiLib;
+}
+
+std::string Tablet::getTitle() const {
+    if (number == 1) {
+        return std::string("Aviator's Tablet  ") + AVITAB_VERSION_STR;
+    }
+    return "Aviator's Tablet " + std::to_string(number) + "  " + AVITAB_VERSION_STR;
+}
+
+std::string Tablet::getPanelKey() const {
+    return (number == 1) ? "/panel" : "/panel_" + std::to_string(number);
+}
+
+void Tablet::start() {
+    // runs in environment thread, called by AviTab::startApp
+    guiLib->setMouseWheelCallback([this] (int dir, int x, int y) {
+        if (appLauncher) {
+            appLauncher->onMouseWheel(dir, x, y);
+        }
+    });
+    createPanel();
+    guiLib->setFramePacing(env->getSettings()->getGeneralSetting<int>("gui_frame_pacing"));
+    configuredRenderScale = env->getSettings()->getGeneralSetting<int>("gui_render_scale_percent") / 100.0f;
+    guiLib->setRenderScale(configuredRenderScale);
+    guiLib->executeLater(std::bind(&Tablet::createLayout, this));
+}
+
+void Tablet::toggleTablet() {
+    // runs in environment thread, called by menu or command
+    try {
+        if (!guiLib->hasNativeWindow()) {
+            logger::info("Showing tablet %d", number);
+            // It's possible that the user closed the window with the close button.
+            // Since we don't get any callback for this, it's possible that we didn't store the last window coordinates yet.
+            // For that reason, the last known position is tried first.
+            auto rect = guiLib->getNativeWindowRect();
+            if (rect.valid && !resetWindowRect) {
+                env->getSettings()->saveWindowRect(rect, number);
+            } else {
+                rect = env->getSettings()->getWindowRect(number);
+            }
+            guiLib->createNativeWindow(getTitle(), rect);
+        } else {
+            close();
+        }
+    } catch (const std::exception &e) {
+        logger::error("Exception in onShowTablet: %s", e.what());
+    }
+}
+
+void Tablet::resetWindowPosition() {
+    // runs in environment thread
+    env->getSettings()->saveWindowRect({}, number);
+    if (guiLib->hasNativeWindow()) {
+        guiLib->pauseNativeWindow();
+    }
+    resetWindowRect = true;
+    toggleTablet();
+    resetWindowRect = false;
+}
+
+void Tablet::onPlaneLoad() {
+    // runs in environment thread, after the aircraft was reloaded
+    createPanel();
+
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->onPlaneLoad();
+        }
+        auto screen = guiLib->screen();
+        if (hideHeader) {
+            headerApp.reset();
+            headContainer.reset();
+            if (centerContainer) {
+                centerContainer->setPosition(0, 0);
+                centerContainer->setDimensions(screen->getWidth(), screen->getHeight());
+            }
+        } else {
+            if (!headerApp) {
+                headerApp = std::make_shared<HeaderApp>(this);
+                headContainer = headerApp->getUIContainer();
+                headContainer->setParent(screen);
+                headContainer->setVisible(true);
+                headContainer->setFit(Container::Fit::FILL, Container::Fit::OFF);
+                if (centerContainer) {
+                    centerContainer->setPosition(0, 30);
+                    centerContainer->setDimensions(screen->getWidth(), screen->getHeight() - 30);
+                }
+            }
+        }
+    });
+}
+
+void Tablet::zoomIn() {
+    // called from environment thread
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->onMouseWheel(1, 0, 0);
+        }
+    });
+}
+
+void Tablet::zoomOut() {
+    // called from environment thread
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->onMouseWheel(-1, 0, 0);
+        }
+    });
+}
+
+void Tablet::recentre() {
+    // called from environment thread
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->recentre();
+        }
+    });
+}
+
+void Tablet::panLeft() {
+    // called from environment thread
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->pan(-10, 0); // 10% leftwards
+        }
+    });
+}
+
+void Tablet::panRight() {
+    // called from environment thread
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->pan(10, 0); // 10% rightwards
+        }
+    });
+}
+
+void Tablet::panUp() {
+    // called from environment thread
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->pan(0, -10); // 10% upwards
+        }
+    });
+}
+
+void Tablet::panDown() {
+    // called from environment thread
+    guiLib->executeLater([this] () {
+        if (appLauncher) {
+            appLauncher->pan(0, 10); // 10% downwards
+        }
+    });
+}
+
+void Tablet::createPanel() {
+    auto cfgFile = getAirplanePath() + "/AviTab.json";
+    std::string key = getPanelKey();
+    try {
+        Config cfg(cfgFile);
+        int left = cfg.getInt(key + "/left");
+        int bottom = cfg.getInt(key + "/bottom");
+        int width = cfg.getInt(key + "/width");
+        int height = cfg.getInt(key + "/height");
+        bool enable = false;
+        bool disableCaptureWindow = false;
+        hideHeader = false;
+        try {
+            enable = cfg.getBool(key + "/enabled");
+        } catch (...) {
+        }
+        try {
+            hideHeader = cfg.getBool(key + "/hide_header");
+        } catch (...) {
+        }
+        try {
+            disableCaptureWindow = cfg.getBool(key + "/disable_capture_window");
+        } catch (...) {
+        }
+
+        guiLib->createPanel(left, bottom, width, height, !disableCaptureWindow);
+        if (enable) {
+            env->enableAndPowerPanel();
+        }
+    } catch (const std::exception &e) {
+        logger::info("No panel config for tablet %d - window only mode", number);
+        hideHeader = false;
+        guiLib->hidePanel();
+    }
+}
+
+void Tablet::createLayout() {
+    // runs in GUI thread
+    auto screen = guiLib->screen();
+    screen->setOnResize([this] { this->onScreenResize(); });
+
+    if (!aviTab.isStartupDone()) {
+        if (!loadLabel) {
+            loadLabel = std::make_shared<Label>(screen, "Starting...");
+            loadLabel->centerInParent();
+        }
+        guiLib->executeLater(std::bind(&Tablet::createLayout, this));
+        return;
+    }
+
+    if (!env->isNavWorldReady()) {
+        if (!loadLabel) {
+            loadLabel = std::make_shared<Label>(screen, "Loading nav data...");
+            loadLabel->centerInParent();
+        }
+
+        std::string phase = env->getNavWorldLoadStatus();
+        std::string text = phase.empty() ? "Loading nav data..." : "Loading nav data: " + phase + "...";
+        if (text != loadLabel->getText()) {
+            loadLabel->setText(text);
+            loadLabel->centerInParent();
+        }
+
+        // try again later
+        guiLib->executeLater(std::bind(&Tablet::createLayout, this));
+        return;
+    }
+
+    loadLabel.reset();
+
+    if (!hideHeader) {
+        if (!headerApp) {
+            headerApp = std::make_shared<HeaderApp>(this);
+            headContainer = headerApp->getUIContainer();
+            headContainer->setParent(screen);
+            headContainer->setVisible(true);
+        }
+    }
+
+    if (!appLauncher) {
+        showAppLauncher();
+    }
+
+    if (env->getSettings()->getGeneralSetting<bool>("gui_auto_render_scale") && !renderScaleTimer) {
+        renderScaleTimer = std::make_unique<Timer>([this] () {
+            updateRenderScale();
+            return true;
+        }, RENDER_SCALE_CHECK_MS);
+    }
+}
+
+void Tablet::updateRenderScale() {
+    // runs in GUI thread: lower the resolution while the simulator is slow,
+    // go back up slowly once it has recovered
+    float frameTime = env->getLastFrameTime();
+    if (frameTime > SLOW_FRAME_SECONDS) {
+        slowRenderChecks++;
+        fastRenderChecks = 0;
+    } else if (frameTime > 0 && frameTime < FAST_FRAME_SECONDS) {
+        fastRenderChecks++;
+        slowRenderChecks = 0;
+    } else {
+        slowRenderChecks = 0;
+        fastRenderChecks = 0;
+    }
+
+    float scale = guiLib->getRenderScale();
+    if (slowRenderChecks >= SLOW_CHECKS_TO_DOWNSCALE && scale > GUIDriver::MIN_RENDER_SCALE) {
+        guiLib->setRenderScale(scale - RENDER_SCALE_STEP);
+        slowRenderChecks = 0;
+    } else if (fastRenderChecks >= FAST_CHECKS_TO_UPSCALE && scale < configuredRenderScale) {
+        guiLib->setRenderScale(std::min(configuredRenderScale, scale + RENDER_SCALE_STEP));
+        fastRenderChecks = 0;
+    }
+}
+
+void Tablet::onScreenResize() {
+    auto screen = guiLib->screen();
+    int width = screen->getWidth();
+    int height = screen->getHeight();
+
+    if (headerApp) {
+        headerApp->onScreenResize(width, height);
+    }
+
+    if (appLauncher) {
+        if (hideHeader) {
+            appLauncher->onScreenResize(width, height);
+        } else {
+            appLauncher->onScreenResize(width, height - 30);
+        }
+    }
+}
+
+void Tablet::showAppLauncher() {
+    if (!appLauncher) {
+        appLauncher = std::make_shared<AppLauncher>(this);;
+    }
+    appLauncher->show();
+}
+
+void Tablet::showApp(AppId id) {
+    if (appLauncher) {
+        guiLib->executeLater([this, id] () {
+            appLauncher->showApp(id);
+        });
+    }
+}
+
+void Tablet::handleLeftClick(bool down) {
+    guiLib->sendLeftClick(down);
+}
+
+void Tablet::handleWheel(bool up) {
+    guiLib->executeLater([this, up] () {
+        if (appLauncher) {
+            appLauncher->onMouseWheel(up ? 1 : -1, 0, 0);
+        }
+    });
+}
+
+void Tablet::saveWindowRect() {
+    auto rect = guiLib->getNativeWindowRect();
+    env->getSettings()->saveWindowRect(rect, number);
+}
+
+void Tablet::signalStop() {
+    guiLib->signalStop();
+}
+
+void Tablet::destroyWindow() {
+    guiLib->destroyNativeWindow();
+}
+
+void Tablet::cleanupLayout() {
+    renderScaleTimer.reset();
+    headContainer.reset();
+    centerContainer.reset();
+    headerApp.reset();
+    appLauncher.reset();
+}
+
+void Tablet::setIsInMenu(bool inMenu) {
+    env->setIsInMenu(inMenu);
+}
+
+bool Tablet::isTabletShown() {
+    return guiLib->isTabletShown();
+}
+
+std::shared_ptr<Container> Tablet::createGUIContainer() {
+    auto screen = guiLib->screen();
+    auto container = std::make_shared<Container>(screen);
+    container->setVisible(false);
+    if (hideHeader) {
+        container->setPosition(0, 0);
+        container->setDimensions(screen->getWidth(), screen->getHeight());
+    } else {
+        container->setPosition(0, 30);
+        container->setDimensions(screen->getWidth(), screen->getHeight() - 30);
+    }
+
+    return container;
+}
+
+void Tablet::showGUIContainer(std::shared_ptr<Container> container) {
+    if (centerContainer) {
+        centerContainer->setVisible(false);
+    }
+
+    auto screen = guiLib->screen();
+    centerContainer = container;
+    centerContainer->setParent(screen);
+    if (hideHeader) {
+        centerContainer->setPosition(0, 0);
+        centerContainer->setDimensions(screen->getWidth(), screen->getHeight());
+    } else {
+        centerContainer->setPosition(0, 30);
+        centerContainer->setDimensions(screen->getWidth(), screen->getHeight() - 30);
+    }
+    centerContainer->setVisible(true);
+}
+
+void Tablet::setBrightness(float brightness) {
+    guiLib->setBrightness(brightness);
+}
+
+float Tablet::getBrightness() {
+    return guiLib->getBrightness();
+}
+
+std::shared_ptr<world::World> Tablet::getNavWorld() {
+    return env->getNavWorld();
+}
+
+void Tablet::executeLater(std::function<void()> func, TaskPriority priority) {
+    guiLib->executeLater(func, priority);
+}
+
+std::string Tablet::getDataPath() {
+    return env->getProgramPath();
+}
+
+std::string Tablet::getFlightPlansPath() {
+    return env->getFlightPlansPath();
+}
+
+std::string Tablet::getEarthTexturePath() {
+    return env->getEarthTexturePath();
+}
+
+std::string Tablet::getAirplanePath() {
+    return env->getAirplanePath();
+}
+
+Tablet::MagVarMap Tablet::getMagneticVariations(std::vector<std::pair<double, double>> locations) {
+    return env->getMagneticVariations(locations);
+}
+
+std::string Tablet::getMETARForAirport(const std::string &icao) {
+    return env->getMETARForAirport(icao);
+}
+
+std::shared_ptr<const WeatherStations> Tablet::getWeatherStations() {
+    return env->getWeatherStations();
+}
+
+void Tablet::reloadMetar() {
+    logger::info("Reloading METAR...");
+    env->reloadMetar();
+    logger::info("Done METAR");
+}
+
+void Tablet::loadUserFixes(std::string filename) {
+    env->loadUserFixes(filename);
+}
+
+world::NavNodeList Tablet::loadFlightPlan(const std::string filename) {
+    return env->loadFlightPlan(filename);
+}
+
+std::shared_ptr<apis::ChartService> Tablet::getChartService() {
+    return aviTab.getChartService();
+}
+
+std::shared_ptr<world::Procedure> Tablet::getProcedure() {
+    return aviTab.getProcedure();
+}
+
+void Tablet::setProcedure(std::shared_ptr<world::Procedure> procedure) {
+    aviTab.setProcedure(procedure);
+}
+
+std::shared_ptr<world::Route> Tablet::getRoute() {
+    return aviTab.getRoute();
+}
+
+void Tablet::setRoute(std::shared_ptr<world::Route> route) {
+    aviTab.setRoute(route);
+}
+
+std::shared_ptr<world::RouteFinder> Tablet::getRouteFinder() {
+    return getNavWorld()->getRouteFinder();
+}
+
+void Tablet::updateMapExports(float lat, float lon, int zoom, float vrange) {
+    env->updateMapExports(lat, lon, zoom, vrange);
+}
+
+bool Tablet::isMapStateExported() {
+    // there is only one shared memory segment, it follows the main tablet's map
+    return number == 1 && env->isMapStateExported();
+}
+
+void Tablet::publishMapState(const MapState &state) {
+    if (number == 1) {
+        env->publishMapState(state);
+    }
+}
+
+void Tablet::updateOverlayTimingExports(const maps::OverlayTimings &timings) {
+    env->updateOverlayTimingExports(timings);
+}
+
+AircraftID Tablet::getActiveAircraftCount() {
+    return env->getActiveAircraftCount();
+}
+
+Location Tablet::getAircraftLocation(AircraftID id) {
+    return env->getAircraftLocation(id);
+}
+
+AircraftLocations Tablet::getAircraftLocations() {
+    return env->getAircraftLocations();
+}
+
+std::shared_ptr<DataSubscription> Tablet::subscribeData(const std::vector<std::string> &dataRefs) {
+    return env->subscribeData(dataRefs);
+}
+
+float Tablet::getLastFrameTime() {
+    return env->getLastFrameTime();
+}
+
+std::shared_ptr<Settings> Tablet::getSettings() {
+    return env->getSettings();
+}
+
+void Tablet::onHomeButton() {
+    showAppLauncher();
+}
+
+void Tablet::close() {
+    logger::info("Closing tablet %d", number);
+    env->runInEnvironment([this] () {
+        if (guiLib->hasNativeWindow()) {
+            guiLib->pauseNativeWindow();
+        }
+    });
+}
+
+} /* namespace avitab */
@@ -0,0 +1,141 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include "src/environment/Environment.h"
+#include "src/gui_toolkit/widgets/Container.h"
+#include "src/gui_toolkit/widgets/Label.h"
+#include "src/gui_toolkit/Timer.h"
+#include "src/avitab/apps/AppFunctions.h"
+#include "src/avitab/apps/AppLauncher.h"
+
+namespace avitab {
+
+class AviTab;
+
+// One tablet, i.e. a window or panel with its own GUI surface and apps.
+// The tablets of the plugin share the AviTab's charts and route and the
+// environment's nav data and caches.
+class Tablet: public AppFunctions {
+public:
+    // number 1 is the main tablet, the others have their own window and panel settings
+    Tablet(AviTab &aviTab, std::shared_ptr<Environment> environment, int number);
+    int getNumber() const;
+    std::shared_ptr<LVGLToolkit> getGUI();
+
+    // runs in environment thread
+    void start();
+    void toggleTablet();
+    void resetWindowPosition();
+    void zoomIn();
+    void zoomOut();
+    void recentre();
+    void panLeft();
+    void panRight();
+    void panUp();
+    void panDown();
+    void showApp(AppId id);
+    void handleLeftClick(bool down);
+    void handleWheel(bool up);
+    void onPlaneLoad();
+    void saveWindowRect();
+    // no more GUI tasks run afterwards
+    void signalStop();
+    void destroyWindow();
+    // once the GUI thread is gone
+    void cleanupLayout();
+
+    // App API
+    void setBrightness(float brightness) override;
+    float getBrightness() override;
+    void executeLater(std::function<void()> func, TaskPriority priority = TaskPriority::INPUT) override;
+    std::string getDataPath() override;
+    std::string getEarthTexturePath() override;
+    std::string getAirplanePath() override;
+    std::string getFlightPlansPath() override;
+    std::shared_ptr<Container> createGUIContainer() override;
+    void showGUIContainer(std::shared_ptr<Container> container) override;
+    void onHomeButton() override;
+    std::shared_ptr<world::World> getNavWorld() override;
+    MagVarMap getMagneticVariations(std::vector<std::pair<double, double>> locations) override;
+    std::string getMETARForAirport(const std::string &icao) override;
+    std::shared_ptr<const WeatherStations> getWeatherStations() override;
+    void reloadMetar() override;
+    void loadUserFixes(std::string filename) override;
+    world::NavNodeList loadFlightPlan(const std::string filename) override;
+    void close() override;
+    void setIsInMenu(bool inMenu) override;
+    bool isTabletShown() override;
+    std::shared_ptr<apis::ChartService> getChartService() override;
+    AircraftID getActiveAircraftCount() override;
+    Location getAircraftLocation(AircraftID id) override;
+    AircraftLocations getAircraftLocations() override;
+    std::shared_ptr<DataSubscription> subscribeData(const std::vector<std::string> &dataRefs) override;
+    float getLastFrameTime() override;
+    std::shared_ptr<Settings> getSettings() override;
+    std::shared_ptr<world::Route> getRoute() override;
+    void setRoute(std::shared_ptr<world::Route> route) override;
+    std::shared_ptr<world::Procedure> getProcedure() override;
+    void setProcedure(std::shared_ptr<world::Procedure> procedure) override;
+    std::shared_ptr<world::RouteFinder> getRouteFinder() override;
+    void updateMapExports(float lat, float lon, int zoom, float vrange) override;
+    bool isMapStateExported() override;
+    void publishMapState(const MapState &state) override;
+    void updateOverlayTimingExports(const maps::OverlayTimings &timings) override;
+
+private:
+    // automatic render scale: below 25 fps for 5s lowers it, above 40 fps for 15s raises it again
+    static constexpr const int RENDER_SCALE_CHECK_MS = 1000;
+    static constexpr const float SLOW_FRAME_SECONDS = 1.0f / 25;
+    static constexpr const float FAST_FRAME_SECONDS = 1.0f / 40;
+    static constexpr const int SLOW_CHECKS_TO_DOWNSCALE = 5;
+    static constexpr const int FAST_CHECKS_TO_UPSCALE = 15;
+    static constexpr const float RENDER_SCALE_STEP = 0.25f;
+
+    AviTab &aviTab;
+    std::shared_ptr<Environment> env;
+    int number;
+    bool hideHeader = false;
+    std::shared_ptr<LVGLToolkit> guiLib;
+    std::shared_ptr<Label> loadLabel;
+
+    std::shared_ptr<Container> headContainer;
+    std::shared_ptr<Container> centerContainer;
+
+    std::shared_ptr<App> headerApp;
+    std::shared_ptr<AppLauncher> appLauncher;
+    // lowers the render scale while the simulator struggles if gui_auto_render_scale is set
+    std::unique_ptr<Timer> renderScaleTimer;
+    float configuredRenderScale = 1.0f;
+    int slowRenderChecks = 0;
+    int fastRenderChecks = 0;
+    bool resetWindowRect = false;
+
+    std::string getTitle() const;
+    // "/panel" in the aircraft's AviTab.json for the main tablet, "/panel_<number>" for the others
+    std::string getPanelKey() const;
+    void createPanel();
+    void createLayout();
+    void showAppLauncher();
+    void updateRenderScale();
+    void onScreenResize();
+};
+
+} /* namespace avitab */
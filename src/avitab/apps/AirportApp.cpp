@@ -31,7 +31,11 @@ int padHeight = 40;
 
 AirportApp::AirportApp(FuncsPtr appFuncs):
     App(appFuncs),
-    updateTimer(std::bind(&AirportApp::onTimer, this), 200)
+    updateTimer(std::bind(&AirportApp::onTimer, this), 200),
+    airportSearch([appFuncs] (std::function<void()> f) { appFuncs->executeLater(f); },
+        [this] (const std::string &query, const AirportSearch::Results &results) {
+            onSearchResults(query, results);
+        })
 {
     resetLayout();
 }
@@ -57,6 +61,10 @@ void AirportApp::resetLayout() {
     keys = std::make_shared<Keyboard>(searchWindow, searchField);
     keys->hideEnterKey();
     keys->setOnCancel([this] { searchField->setText(""); });
+    keys->setOnChange([this] {
+        openSingleMatch = false;
+        airportSearch.setQuery(api().getNavWorld(), searchField->getText());
+    });
     keys->setOnOk([this] {
         api().executeLater([this] {
             onSearchEntered(searchField->getText());
@@ -74,14 +82,24 @@ void AirportApp::onSearchEntered(const std::string& code) {
         return;
     }
 
-    auto airports = world->findAirport(code);
+    openSingleMatch = true;
+    airportSearch.searchNow(world, code);
+}
+
+void AirportApp::onSearchResults(const std::string &query, const AirportSearch::Results &airports) {
+    resultList.reset();
+    nextButton.reset();
 
-    if (airports.empty()) {
+    if (query.empty()) {
+        searchLabel->setText("Enter a keyword or ICAO code");
+        return;
+    } else if (!api().getNavWorld()) {
+        searchLabel->setText("No navigation data available, check AviTab.log");
+        return;
+    } else if (airports.empty()) {
         searchLabel->setText("No matching airports found");
-        resultList.reset();
-        nextButton.reset();
         return;
-    } else if (airports.size() == 1) {
+    } else if (airports.size() == 1 && openSingleMatch) {
         onAirportSelected(airports.front());
         return;
     } else if (airports.size() >= world::World::MAX_SEARCH_RESULTS) {
@@ -150,6 +168,12 @@ void AirportApp::onAirportSelected(std::shared_ptr<world::Airport> airport) {
         });
     });
 
+    tab.window->addSymbol(Widget::Symbol::GPS, [this, airport, page] {
+        api().executeLater([this, airport, page] {
+            toggleProcedures(page, airport);
+        });
+    });
+
     pages.push_back(tab);
     fillPage(page, airport);
     tabs->showTab(page);
@@ -158,6 +182,9 @@ void AirportApp::onAirportSelected(std::shared_ptr<world::Airport> airport) {
 void AirportApp::removeTab(std::shared_ptr<Page> page) {
     for (auto it = pages.begin(); it != pages.end(); ++it) {
         if (it->page == page) {
+            if (it->chartCall) {
+                it->chartCall->cancel();
+            }
             size_t index = tabs->getTabIndex(it->page);
             pages.erase(it);
             tabs->removeTab(index);
@@ -178,6 +205,8 @@ void AirportApp::fillPage(std::shared_ptr<Page> page, std::shared_ptr<world::Air
 
     TabPage &tab = findPage(page);
     tab.chartSelect.reset();
+    tab.procedureSelect.reset();
+    tab.procedures.clear();
 
     tab.label->setText(str.str());
     tab.label->setDimensions(tab.window->getContentWidth(), tab.window->getHeight());
@@ -276,11 +305,73 @@ void AirportApp::toggleCharts(std::shared_ptr<Page> page, std::shared_ptr<world:
     if (tab.charts.empty()) {
         fillChartsPage(page, airport);
     } else {
+        if (tab.chartCall) {
+            tab.chartCall->cancel();
+        }
         tab.charts.clear();
         fillPage(page, airport);
     }
 }
 
+void AirportApp::toggleProcedures(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport) {
+    TabPage &tab = findPage(page);
+    if (tab.chartCall) {
+        tab.chartCall->cancel();
+    }
+    tab.charts.clear();
+
+    if (tab.procedureSelect) {
+        fillPage(page, airport);
+    } else {
+        fillProceduresPage(page, airport);
+    }
+}
+
+void AirportApp::fillProceduresPage(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport) {
+    TabPage &tab = findPage(page);
+    tab.label->setVisible(false);
+    tab.chartSelect.reset();
+
+    tab.procedures.clear();
+    for (auto &sid: airport->getSIDs()) {
+        tab.procedures.push_back(sid);
+    }
+    for (auto &star: airport->getSTARs()) {
+        tab.procedures.push_back(star);
+    }
+    for (auto &approach: airport->getApproaches()) {
+        tab.procedures.push_back(approach);
+    }
+
+    auto active = api().getProcedure();
+    tab.procedureSelect = std::make_shared<List>(tab.window);
+    tab.procedureSelect->setDimensions(tab.window->getContentWidth() - 5, tab.window->getHeight() - padHeight);
+    tab.procedureSelect->add("Don't show a procedure", -1);
+    for (size_t i = 0; i < tab.procedures.size(); i++) {
+        auto &proc = tab.procedures[i];
+        std::string kind = std::dynamic_pointer_cast<world::SID>(proc) ? "SID" :
+                           std::dynamic_pointer_cast<world::STAR>(proc) ? "STAR" : "Approach";
+        if (proc == active) {
+            tab.procedureSelect->add(kind + " " + proc->getID(), Widget::Symbol::GPS, i);
+        } else {
+            tab.procedureSelect->add(kind + " " + proc->getID(), i);
+        }
+    }
+
+    tab.procedureSelect->centerInParent();
+    tab.procedureSelect->setCallback([this, page, airport] (int index) {
+        api().executeLater([this, page, airport, index] {
+            TabPage &listTab = findPage(page);
+            if (index < 0) {
+                api().setProcedure(nullptr);
+            } else {
+                api().setProcedure(listTab.procedures.at(index));
+            }
+            fillPage(page, airport);
+        });
+    });
+}
+
 void AirportApp::fillChartsPage(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport) {
     auto svc = api().getChartService();
 
@@ -288,10 +379,14 @@ void AirportApp::fillChartsPage(std::shared_ptr<Page> page, std::shared_ptr<worl
     tab.label->setText("Loading...");
 
     auto call = svc->getChartsFor(airport->getID());
+    if (tab.chartCall) {
+        tab.chartCall->cancel();
+    }
+    tab.chartCall = call;
     call->andThen([this, page] (std::future<apis::ChartService::ChartList> res) {
         try {
             auto charts = res.get();
-            api().executeLater([this, page, charts] { onChartsLoaded(page, charts); });
+            api().executeLater([this, page, charts] { onChartsLoaded(page, charts); }, TaskPriority::BACKGROUND);
         } catch (const std::exception &e) {
             TabPage &tab = findPage(page);
             tab.label->setTextFormatted("Error: %s", e.what());
@@ -303,6 +398,7 @@ void AirportApp::fillChartsPage(std::shared_ptr<Page> page, std::shared_ptr<worl
 void AirportApp::onChartsLoaded(std::shared_ptr<Page> page, const apis::ChartService::ChartList &charts) {
     TabPage &tab = findPage(page);
     tab.label->setVisible(false);
+    tab.procedureSelect.reset();
     tab.charts = charts;
     tab.chartSelect = std::make_shared<List>(tab.window);
     tab.chartSelect->setDimensions(tab.window->getContentWidth() - 5, tab.window->getHeight() - padHeight);
@@ -364,11 +460,12 @@ void AirportApp::onChartsLoaded(std::shared_ptr<Page> page, const apis::ChartSer
 
             auto svc = api().getChartService();
             auto call = svc->loadChart(chart);
+            findPage(newPage).chartCall = call;
             call->andThen([this, newPage] (std::future<std::shared_ptr<apis::Chart>> res) {
                 try {
                     TabPage &tab = findPage(newPage);
                     tab.chart = res.get();
-                    api().executeLater([this, newPage] { onChartLoaded(newPage); });
+                    api().executeLater([this, newPage] { onChartLoaded(newPage); }, TaskPriority::BACKGROUND);
                 } catch (const std::exception &e) {
                     // if the page was closed, findPage will throw an exception again
                     try {
@@ -418,7 +515,12 @@ void AirportApp::onChartLoaded(std::shared_ptr<Page> page) {
             nightMode = !nightMode;
             tab.nightModeButton->setToggleState(nightMode);
             tab.chart->changeNightMode(tab.mapSource, nightMode);
-            tab.mapStitcher->invalidateCache();
+            if (tab.mapSource->isDocumentSource()) {
+                // documents keep their tiles, only the colour map changes
+                tab.mapStitcher->updateImage();
+            } else {
+                tab.mapStitcher->invalidateCache();
+            }
         }
     });
     tab.nightModeButton->setToggleState(nightMode);
@@ -441,11 +543,16 @@ void AirportApp::onChartLoaded(std::shared_ptr<Page> page) {
 
         tab.mapSource = tab.chart->createTileSource(nightMode);
         tab.mapStitcher = std::make_shared<img::Stitcher>(tab.mapImage, tab.mapSource);
+        if (tab.mapSource->cachesRenderedTiles() && api().getSettings()->getGeneralSetting<bool>("document_tile_cache")) {
+            // charts from images have no unique tile names across files
+            tab.mapStitcher->setCacheDirectory(api().getDataPath() + "DocumentTiles/");
+        }
         tab.map = std::make_shared<maps::OverlayedMap>(tab.mapStitcher, tab.overlays);
         tab.map->loadOverlayIcons(api().getDataPath() + "icons/");
         tab.map->setRedrawCallback([this, page] () { redrawPage(page); });
         tab.map->setNavWorld(api().getNavWorld());
         tab.map->setGetRouteCallback([this] () { return api().getRoute(); });
+        tab.map->setGetProcedureCallback([this] () { return api().getProcedure(); });
 
         tab.trackButton->setToggleState(tab.trackPlane);
 
@@ -522,13 +629,18 @@ void AirportApp::onMouseWheel(int dir, int x, int y) {
 }
 
 bool AirportApp::onTimer() {
+    if (!isVisible()) {
+        return true;
+    }
+
+    // the other tabs catch up when they are selected
+    auto activeTabIndex = tabs->getActiveTab();
     for (auto &tab: pages) {
+        if (tabs->getTabIndex(tab.page) != activeTabIndex) {
+            continue;
+        }
         if (tab.map) {
-            std::vector<avitab::Location> locs;
-            for (AircraftID i = 0; i < api().getActiveAircraftCount(); ++i) {
-                locs.push_back(api().getAircraftLocation(i));
-            }
-            tab.map->setPlaneLocations(locs);
+            tab.map->setPlaneLocations(api().getAircraftLocations());
             if (tab.trackPlane) {
                 tab.map->centerOnPlane();
             }
@@ -36,6 +36,7 @@
 #include "src/libimg/stitcher/TileSource.h"
 #include "src/maps/OverlayedMap.h"
 #include "src/libimg/stitcher/Stitcher.h"
+#include "components/AirportSearch.h"
 
 namespace avitab {
 
@@ -55,7 +56,13 @@ private:
         apis::ChartService::ChartList charts;
         std::shared_ptr<List> chartSelect;
 
+        // SIDs, STARs and approaches that can be shown on the maps
+        std::vector<std::shared_ptr<world::Procedure>> procedures;
+        std::shared_ptr<List> procedureSelect;
+
         std::shared_ptr<apis::Chart> chart;
+        // the chart request of this page, cancelled when superseded or the page is closed
+        std::shared_ptr<apis::BaseCall> chartCall;
         std::shared_ptr<img::TileSource> mapSource;
         std::shared_ptr<img::Image> mapImage;
         std::shared_ptr<img::Stitcher> mapStitcher;
@@ -78,10 +85,14 @@ private:
     std::shared_ptr<DropDownList> resultList;
     std::shared_ptr<Button> nextButton;
     std::shared_ptr<Keyboard> keys;
+    AirportSearch airportSearch;
+    // a single match is only opened when the query was confirmed, not while typing
+    bool openSingleMatch = false;
 
     void removeTab(std::shared_ptr<Page> page);
     void resetLayout();
     void onSearchEntered(const std::string &code);
+    void onSearchResults(const std::string &query, const AirportSearch::Results &airports);
     void onAirportSelected(std::shared_ptr<world::Airport> airport);
     void fillPage(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport);
 
@@ -93,6 +104,8 @@ private:
     TabPage &findPage(std::shared_ptr<Page> page);
 
     void toggleCharts(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport);
+    void toggleProcedures(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport);
+    void fillProceduresPage(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport);
     void fillChartsPage(std::shared_ptr<Page> page, std::shared_ptr<world::Airport> airport);
     void onChartsLoaded(std::shared_ptr<Page> page, const apis::ChartService::ChartList &charts);
     void onChartLoaded(std::shared_ptr<Page> page);
@@ -35,6 +35,14 @@ AppFunctions& App::api() {
     return *funcs;
 }
 
+void App::setActive(bool isActive) {
+    active = isActive;
+}
+
+bool App::isVisible() {
+    return active && funcs->isTabletShown();
+}
+
 void App::setOnExit(ExitFunct onExitFunct) {
     onExit = onExitFunct;
 }
@@ -35,6 +35,7 @@ public:
     virtual void onScreenResize(int width, int height);
     virtual void resume();
     virtual void suspend();
+    void setActive(bool isActive);
     void setOnExit(ExitFunct onExitFunct);
     ContPtr getUIContainer();
     virtual void show();
@@ -46,6 +47,9 @@ public:
     virtual ~App() = default;
 protected:
     AppFunctions &api();
+    // false while another app is in front or the tablet isn't shown,
+    // periodic work like map updates should be skipped then
+    bool isVisible();
     void exit();
     ExitFunct &getOnExit();
 
@@ -59,6 +63,7 @@ private:
     FuncsPtr funcs;
     ContPtr uiContainer;
     ExitFunct onExit;
+    bool active = false;
 };
 
 } /* namespace avitab */
@@ -20,8 +20,10 @@
 #include <memory>
 #include <string>
 #include "src/gui_toolkit/widgets/Container.h"
+#include "src/gui_toolkit/TaskQueue.h"
 #include "src/world/World.h"
 #include "src/world/routing/Route.h"
+#include "src/world/models/airport/procs/Procedure.h"
 #include "src/charts/ChartService.h"
 #include "src/environment/Environment.h"
 
@@ -36,6 +38,7 @@ enum class AppId {
     NOTES,
     NAVIGRAPH,
     YOUTUBE,
+    METRICS,
     ABOUT,
 };
 
@@ -43,7 +46,7 @@ class AppFunctions {
 public:
     virtual void setBrightness(float brightness) = 0;
     virtual float getBrightness() = 0;
-    virtual void executeLater(std::function<void()> func) = 0;
+    virtual void executeLater(std::function<void()> func, TaskPriority priority = TaskPriority::INPUT) = 0;
     virtual std::string getDataPath() = 0;
     virtual std::string getEarthTexturePath() = 0;
     virtual std::string getAirplanePath() = 0;
@@ -58,17 +61,30 @@ public:
     using MagVarMap = std::map<std::pair<double, double>, double>;
     virtual MagVarMap getMagneticVariations(std::vector<std::pair<double, double>> locations) = 0;
     virtual std::string getMETARForAirport(const std::string &icao) = 0;
+    virtual std::shared_ptr<const WeatherStations> getWeatherStations() = 0;
     virtual void close() = 0;
     virtual void setIsInMenu(bool inMenu) = 0;
+    // false while the tablet is hidden or its panel isn't powered
+    virtual bool isTabletShown() = 0;
     virtual std::shared_ptr<apis::ChartService> getChartService() = 0;
     virtual unsigned int getActiveAircraftCount() = 0;
     virtual Location getAircraftLocation(AircraftID id) = 0;
+    virtual AircraftLocations getAircraftLocations() = 0;
+    // reading the subscription never blocks, unlike asking the environment for each value
+    virtual std::shared_ptr<DataSubscription> subscribeData(const std::vector<std::string> &dataRefs) = 0;
     virtual float getLastFrameTime() = 0;
     virtual std::shared_ptr<Settings> getSettings() = 0;
     virtual void setRoute(std::shared_ptr<world::Route> route) = 0;
     virtual std::shared_ptr<world::Route> getRoute() = 0;
+    // the SID, STAR or approach shown on the maps, nullptr for none
+    virtual void setProcedure(std::shared_ptr<world::Procedure> procedure) = 0;
+    virtual std::shared_ptr<world::Procedure> getProcedure() = 0;
     virtual std::shared_ptr<world::RouteFinder> getRouteFinder() = 0;
     virtual void updateMapExports(float lat, float lon, int zoom, float vrange) = 0;
+    // the state is only worth collecting if it is exported, which only the main tablet's is
+    virtual bool isMapStateExported() = 0;
+    virtual void publishMapState(const MapState &state) = 0;
+    virtual void updateOverlayTimingExports(const maps::OverlayTimings &timings) = 0;
     virtual ~AppFunctions() = default;
 };
 
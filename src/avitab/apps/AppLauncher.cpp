@@ -26,10 +26,36 @@
 #include "MapApp.h"
 #include "ProvidersApp.h"
 #include "YouTubeLiveApp.h"
+#include "MetricsApp.h"
 #include "src/libimg/Image.h"
+#include "src/platform/Platform.h"
+#include <mutex>
+#include <map>
+
+namespace {
+std::mutex preloadedIconsMutex;
+std::map<std::string, img::Image> preloadedIcons;
+}
 
 namespace avitab {
 
+void AppLauncher::preloadIcons(const std::string &dir) {
+    for (auto &entry: platform::readDirectory(dir)) {
+        if (entry.isDirectory || entry.utf8Name.find(".png") == std::string::npos) {
+            continue;
+        }
+        std::string path = dir + entry.utf8Name;
+        try {
+            img::Image icon;
+            icon.loadImageFile(path);
+            std::lock_guard<std::mutex> lock(preloadedIconsMutex);
+            preloadedIcons[path] = std::move(icon);
+        } catch (const std::exception &e) {
+            // addEntry tries again and reports it
+        }
+    }
+}
+
 AppLauncher::AppLauncher(FuncsPtr appFuncs):
     App(appFuncs)
 {
@@ -46,20 +72,31 @@ AppLauncher::AppLauncher(FuncsPtr appFuncs):
     addEntry<YouTubeLiveApp>("YouTube", root + "youtube.png", AppId::YOUTUBE);
 
     if (api().getChartService()->getNavigraph()->isSupported() || api().getChartService()->getChartFox()->isSupported()) {
-        addEntry<ProvidersApp>("Providers", root + "if_Airport_22906.png", AppId::NAVIGRAPH);
+        // logs in to the providers that were used before
+        addEntry<ProvidersApp>("Providers", root + "if_Airport_22906.png", AppId::NAVIGRAPH, true);
+    }
+
+    if (api().getSettings()->getGeneralSetting<bool>("show_metrics_app")) {
+        addEntry<MetricsApp>("Metrics", root + "if_Help_1493288.png", AppId::METRICS);
     }
 
     addEntry<About>("About", root + "if_Help_1493288.png", AppId::ABOUT);
+
+    std::lock_guard<std::mutex> lock(preloadedIconsMutex);
+    preloadedIcons.clear();
 }
 
 void AppLauncher::onScreenResize(int width, int height) {
     for (auto &entry: entries) {
-        entry.app->onScreenResize(width, height);
+        if (entry.app) {
+            entry.app->onScreenResize(width, height);
+        }
     }
 }
 
 void AppLauncher::show() {
     if (activeApp) {
+        activeApp->setActive(false);
         activeApp->suspend();
     }
     App::show();
@@ -70,9 +107,14 @@ void AppLauncher::showApp(AppId id) {
     for (auto &entry: entries) {
         if (entry.id == id) {
             if (activeApp) {
+                activeApp->setActive(false);
                 activeApp->suspend();
             }
+            if (!entry.app) {
+                createApp(entry);
+            }
             activeApp = entry.app;
+            activeApp->setActive(true);
             activeApp->resume();
             activeApp->show();
             api().setIsInMenu(false);
@@ -81,24 +123,42 @@ void AppLauncher::showApp(AppId id) {
     }
 }
 
-template<typename T>
-void AppLauncher::addEntry(const std::string& name, const std::string& icon, AppId id) {
-    auto app = startSubApp<T>();
-    app->setOnExit([this] () {
+void AppLauncher::createApp(Entry &entry) {
+    entry.app = entry.create();
+    entry.app->setOnExit([this] () {
         this->show();
     });
+    if (planeLoaded) {
+        entry.app->onPlaneLoad();
+    }
+}
 
+template<typename T>
+void AppLauncher::addEntry(const std::string& name, const std::string& icon, AppId id, bool eager) {
     img::Image iconImg;
-    try {
-        iconImg.loadImageFile(icon);
-    } catch (const std::exception &e) {
-        logger::warn("Couldn't load icon %s: %s", icon.c_str(), e.what());
+    {
+        std::lock_guard<std::mutex> lock(preloadedIconsMutex);
+        auto it = preloadedIcons.find(icon);
+        if (it != preloadedIcons.end()) {
+            iconImg = std::move(it->second);
+            preloadedIcons.erase(it);
+        }
+    }
+    if (iconImg.getWidth() == 0) {
+        try {
+            iconImg.loadImageFile(icon);
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't load icon %s: %s", icon.c_str(), e.what());
+        }
     }
 
     Entry entry;
     entry.id = id;
-    entry.app = std::move(app);
+    entry.create = [this] () -> std::shared_ptr<App> { return startSubApp<T>(); };
     entry.button = std::make_shared<Button>(getUIContainer(), std::move(iconImg), name, 100);
+    if (eager) {
+        createApp(entry);
+    }
     entries.push_back(entry);
 
     size_t index = entries.size() - 1;
@@ -108,8 +168,11 @@ void AppLauncher::addEntry(const std::string& name, const std::string& icon, App
 }
 
 void AppLauncher::onPlaneLoad() {
+    planeLoaded = true;
     for (auto &entry: entries) {
-        entry.app->onPlaneLoad();
+        if (entry.app) {
+            entry.app->onPlaneLoad();
+        }
     }
 }
 
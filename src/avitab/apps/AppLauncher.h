@@ -32,11 +32,17 @@ public:
     using Callback = std::function<void()>;
     struct Entry {
         AppId id;
+        // created when the app is first opened
         std::shared_ptr<App> app;
+        std::function<std::shared_ptr<App>()> create;
         std::shared_ptr<Button> button;
     };
 
     AppLauncher(FuncsPtr appFuncs);
+    // Decodes the icons in dir so that the launcher can be built without doing it on
+    // the GUI thread. Can be called from any thread, icons not used are dropped once
+    // the launcher was created.
+    static void preloadIcons(const std::string &dir);
     void onScreenResize(int width, int height) override;
     void onPlaneLoad() override;
     void onMouseWheel(int dir, int x, int y) override;
@@ -48,9 +54,12 @@ private:
     std::vector<Entry> entries;
 
     std::shared_ptr<App> activeApp;
+    bool planeLoaded = false;
 
+    // apps that work while they are closed, e.g. logging in, have to be created eagerly
     template<typename T>
-    void addEntry(const std::string &name, const std::string &icon, AppId id);
+    void addEntry(const std::string &name, const std::string &icon, AppId id, bool eager = false);
+    void createApp(Entry &entry);
 };
 
 } /* namespace avitab */
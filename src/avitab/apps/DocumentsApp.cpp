@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include "DocumentsApp.h"
 #include "src/Logger.h"
 
@@ -52,6 +53,8 @@ void DocumentsApp::resetLayout() {
     tabs = std::make_shared<TabGroup>(getUIContainer());
     tabs->setCallback([this]() {
         if (settingsContainer) settingsContainer->setVisible(false);
+        onSearchToggle(true);
+        onThumbnailsToggle(true);
     });
     tabs->centerInParent();
     createBrowseTab();
@@ -77,8 +80,29 @@ void DocumentsApp::createBrowseTab() {
 
 void DocumentsApp::showDirectory() {
     browseWindow->setCaption(appTitle + ": " + fsBrowser.rtrimmed(68 - appTitle.size()));
-    currentEntries = fsBrowser.entries();
+    currentEntries.clear();
     showCurrentEntries();
+    fsBrowser.listAsync([this] (FilesystemBrowser::Ticket ticket, std::vector<platform::DirEntry> entries, bool complete) {
+        api().executeLater([this, ticket, entries, complete] {
+            if (!ticket.expired()) {
+                onEntries(entries, complete);
+            }
+        });
+    });
+}
+
+void DocumentsApp::onEntries(const std::vector<platform::DirEntry> &entries, bool complete) {
+    if (complete) {
+        currentEntries = entries;
+        showCurrentEntries();
+        return;
+    }
+
+    for (auto &entry: entries) {
+        Widget::Symbol smb = entry.isDirectory ? Window::Symbol::DIRECTORY : Window::Symbol::FILE;
+        list->add(entry.utf8Name, smb, currentEntries.size());
+        currentEntries.push_back(entry);
+    }
 }
 
 void DocumentsApp::setFilterRegex(const std::string ext) {
@@ -155,11 +179,7 @@ void DocumentsApp::createDocumentTab(const std::string &docPath) {
     tab->window->setDimensions(tab->page->getContentWidth(), tab->page->getHeight());
     tab->window->alignInTopLeft();
 
-    tab->pixMap = std::make_shared<PixMap>(tab->window);
-    tab->rasterImage = std::make_shared<img::Image>(tab->window->getContentWidth(), tab->window->getContentHeight(), img::COLOR_TRANSPARENT);
-    tab->pixMap->setClickable(true);
-    tab->pixMap->setClickHandler([this] (int x, int y, bool pr, bool rel) { onPan(x, y, pr, rel); });
-    tab->pixMap->draw(*tab->rasterImage);
+    createView(tab, tab->window->getContentWidth(), tab->window->getContentHeight());
 
     auto page = tab->page;
     tab->window->setOnClose([this, page] {
@@ -167,6 +187,8 @@ void DocumentsApp::createDocumentTab(const std::string &docPath) {
             if (settingsContainer) {
                 settingsContainer->setVisible(false);
             }
+            onSearchToggle(true);
+            onThumbnailsToggle(true);
             removeTab(page);
         });
     });
@@ -182,6 +204,35 @@ void DocumentsApp::createDocumentTab(const std::string &docPath) {
     tabs->showTab(page);
 }
 
+void DocumentsApp::createView(PageInfo view, int width, int height) {
+    view->pixMap = std::make_shared<PixMap>(view->window);
+    view->rasterImage = std::make_shared<img::Image>(width, height, img::COLOR_TRANSPARENT);
+    view->pixMap->setClickable(true);
+
+    // the view owns the pixmap, so the handler can't outlive it
+    DocumentPage *viewPtr = view.get();
+    view->pixMap->setClickHandler([this, viewPtr] (int x, int y, bool pr, bool rel) {
+        DocumentPage *tab = viewPtr->owner ? viewPtr->owner : viewPtr;
+        bool focusSplit = (viewPtr != tab);
+        if (pr && tab->splitPane && tab->splitFocused != focusSplit) {
+            tab->splitFocused = focusSplit;
+            onThumbnailsToggle(true);
+            setTitle(focusSplit ? tab->splitPane : getActiveTab());
+        }
+        onPan(x, y, pr, rel);
+    });
+    view->pixMap->draw(*view->rasterImage);
+}
+
+void DocumentsApp::resizeView(PageInfo view, int width, int height) {
+    // the stitcher renders into the same image, it only needs to be redrawn
+    view->rasterImage->resize(width, height, img::COLOR_TRANSPARENT);
+    view->pixMap->draw(*view->rasterImage);
+    if (view->map) {
+        view->map->updateImage();
+    }
+}
+
 void DocumentsApp::removeTab(std::shared_ptr<Page> page) {
     for (auto it = pages.begin(); it != pages.end(); ++it) {
         if ((*it)->page == page) {
@@ -199,25 +250,40 @@ void DocumentsApp::removeTab(std::shared_ptr<Page> page) {
 
 void DocumentsApp::setupCallbacks(PageInfo tab) {
     tab->window->addSymbol(Widget::Symbol::SETTINGS, [this] () { onSettingsToggle(); });
+    tab->window->addSymbol(Widget::Symbol::KEYBOARD, [this] () { onSearchToggle(); });
+    tab->window->addSymbol(Widget::Symbol::LIST, [this] () { onThumbnailsToggle(); });
     tab->window->addSymbol(Widget::Symbol::MINUS, std::bind(&DocumentsApp::onMinus, this));
     tab->window->addSymbol(Widget::Symbol::PLUS, std::bind(&DocumentsApp::onPlus, this));
     tab->window->addSymbol(Widget::Symbol::RIGHT, std::bind(&DocumentsApp::onNextPage, this));
     tab->window->addSymbol(Widget::Symbol::LEFT, std::bind(&DocumentsApp::onPrevPage, this));
     tab->window->addSymbol(Widget::Symbol::ROTATE, std::bind(&DocumentsApp::onRotate, this));
+    tab->window->addSymbol(Widget::Symbol::COPY, [this] () { onSplitToggle(); });
 }
 
 void DocumentsApp::loadFile(PageInfo tab, const std::string &docPath) {
     tab->source = std::make_shared<maps::LocalFileSource>(docPath, api().getChartService());
     tab->stitcher = std::make_shared<img::Stitcher>(tab->rasterImage, tab->source);
-    tab->stitcher->setCacheDirectory(api().getDataPath() + "MapTiles/");
+    if (api().getSettings()->getGeneralSetting<bool>("document_tile_cache")) {
+        tab->stitcher->setCacheDirectory(api().getDataPath() + "DocumentTiles/");
+    }
+    tab->source->startTextIndex(api().getDataPath() + "DocumentIndex/");
 
     tab->map = std::make_shared<maps::OverlayedMap>(tab->stitcher, overlays);
     tab->map->loadOverlayIcons(api().getDataPath() + "icons/");
     tab->map->setGetRouteCallback([this] () { return api().getRoute(); });
+    tab->map->setGetProcedureCallback([this] () { return api().getProcedure(); });
 
     auto pixMap = tab->pixMap;
-    tab->map->setRedrawCallback([pixMap] () { if (pixMap) pixMap->invalidate(); });
+    auto stitcher = tab->stitcher.get();
+    tab->map->setRedrawCallback([pixMap, stitcher] () {
+        if (pixMap) {
+            int x0, y0, x1, y1;
+            stitcher->getDirtyArea(x0, y0, x1, y1);
+            pixMap->invalidateArea(x0, y0, x1, y1);
+        }
+    });
     tab->map->setNavWorld(api().getNavWorld());
+    tab->stitcher->setContinuousPages(settings.continuousScroll);
     tab->map->updateImage();
 
     setTitle(tab);
@@ -229,13 +295,38 @@ void DocumentsApp::loadFile(PageInfo tab, const std::string &docPath) {
     }
 }
 
-void DocumentsApp::setTitle(PageInfo tab) {
-    int page = tab->stitcher->getCurrentPage() + 1;
-    int pageCount = tab->stitcher->getPageCount();
-    tab->window->setCaption(std::string("Page ") + std::to_string(page) + " / " + std::to_string(pageCount));
+void DocumentsApp::setTitle(PageInfo view) {
+    view->titlePage = view->stitcher->getCurrentPage();
+
+    auto caption = [] (const DocumentPage &v) {
+        return std::string("Page ") + std::to_string(v.titlePage + 1) + " / " + std::to_string(v.stitcher->getPageCount());
+    };
+
+    // both views of a split tab share its caption, the focused one is bracketed
+    DocumentPage &tab = view->owner ? *view->owner : *view;
+    auto &pane = tab.splitPane;
+    if (pane && pane->stitcher && tab.stitcher) {
+        std::string left = caption(tab);
+        std::string right = caption(*pane);
+        if (tab.splitFocused) {
+            right = "[" + right + "]";
+        } else {
+            left = "[" + left + "]";
+        }
+        tab.window->setCaption(left + " | " + right);
+    } else if (tab.stitcher) {
+        tab.window->setCaption(caption(tab));
+    }
 }
 
-DocumentsApp::PageInfo DocumentsApp::getActiveDocPage() {
+void DocumentsApp::updateTitle(PageInfo tab) {
+    // continuous pages change the current page while panning
+    if (tab->stitcher->getCurrentPage() != tab->titlePage) {
+        setTitle(tab);
+    }
+}
+
+DocumentsApp::PageInfo DocumentsApp::getActiveTab() {
     size_t tabIndex = tabs->getActiveTab();
     if (tabIndex > 0) {
         return pages[tabIndex - 1];
@@ -244,6 +335,66 @@ DocumentsApp::PageInfo DocumentsApp::getActiveDocPage() {
     }
 }
 
+DocumentsApp::PageInfo DocumentsApp::getActiveDocPage() {
+    auto tab = getActiveTab();
+    if (tab && tab->splitPane && tab->splitFocused) {
+        return tab->splitPane;
+    }
+    return tab;
+}
+
+void DocumentsApp::onSplitToggle() {
+    auto tab = getActiveTab();
+    if (!tab || !tab->stitcher) {
+        return;
+    }
+
+    // thumbnails and search hits belong to the focused view
+    onThumbnailsToggle(true);
+    onSearchToggle(true);
+    if (tab->splitPane) {
+        closeSplitPane(tab);
+    } else {
+        openSplitPane(tab);
+    }
+}
+
+void DocumentsApp::openSplitPane(PageInfo tab) {
+    int width = tab->window->getContentWidth() / 2;
+    int height = tab->window->getContentHeight();
+
+    auto pane = std::make_shared<DocumentPage>();
+    pane->path = tab->path;
+    pane->page = tab->page;
+    pane->window = tab->window;
+    pane->owner = tab.get();
+    createView(pane, tab->window->getContentWidth() - width, height);
+    pane->pixMap->setPosition(width, 0);
+
+    tab->splitPane = pane;
+    tab->splitFocused = true;
+    resizeView(tab, width, height);
+
+    try {
+        // the document is already open, the pane only adds a source and stitcher of its own
+        loadFile(pane, tab->path);
+        if (pane->stitcher->setPage(tab->stitcher->getCurrentPage())) {
+            setTitle(pane);
+            positionPage(pane, VerticalPosition::Top, HorizontalPosition::Middle);
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't split view: %s", e.what());
+        closeSplitPane(tab);
+    }
+}
+
+void DocumentsApp::closeSplitPane(PageInfo tab) {
+    tab->splitPane.reset();
+    tab->splitFocused = false;
+    resizeView(tab, tab->window->getContentWidth(), tab->window->getContentHeight());
+    setTitle(tab);
+}
+
 void DocumentsApp::onPan(int x, int y, bool start, bool end) {
     PageInfo tab = getActiveDocPage();
     if (tab) {
@@ -255,6 +406,7 @@ void DocumentsApp::onPan(int x, int y, bool start, bool end) {
             int vy = tab->panStartY - y;
             if (vx != 0 || vy != 0) {
                 tab->stitcher->pan(vx, vy);
+                updateTitle(tab);
             }
             tab->panStartX = x;
             tab->panStartY = y;
@@ -304,6 +456,7 @@ void DocumentsApp::onScrollUp() {
     auto tab = getActiveDocPage();
     if (tab && tab->map) {
         tab->stitcher->pan(0, -100);
+        updateTitle(tab);
     }
 }
 
@@ -311,6 +464,7 @@ void DocumentsApp::onScrollDown() {
     auto tab = getActiveDocPage();
     if (tab && tab->map) {
         tab->stitcher->pan(0, 100);
+        updateTitle(tab);
     }
 }
 
@@ -327,14 +481,20 @@ void DocumentsApp::onRotate() {
 }
 
 bool DocumentsApp::onTimer() {
-    auto tab = getActiveDocPage();
+    if (!isVisible()) {
+        return true;
+    }
+
+    auto tab = getActiveTab();
     if (tab && tab->map) {
-        std::vector<avitab::Location> locs;
-        for (AircraftID i = 0; i < api().getActiveAircraftCount(); ++i) {
-            locs.push_back(api().getAircraftLocation(i));
-        }
-        tab->map->setPlaneLocations(locs);
+        tab->map->setPlaneLocations(api().getAircraftLocations());
         tab->map->doWork();
+        auto pane = tab->splitPane;
+        if (pane && pane->map) {
+            pane->map->setPlaneLocations(api().getAircraftLocations());
+            pane->map->doWork();
+        }
+        updateThumbnails(getActiveDocPage());
     }
     return true;
 }
@@ -392,8 +552,182 @@ void DocumentsApp::showAppSettings() {
     mouseWheelScrollsCheckbox->setChecked(settings.mouseWheelScrollsMultiPage);
     mouseWheelScrollsCheckbox->alignBelow(settingsLabel);
     mouseWheelScrollsCheckbox->setCallback([this] (bool checked) { settings.mouseWheelScrollsMultiPage = checked; });
+
+    continuousScrollCheckbox = std::make_shared<Checkbox>(settingsContainer, "Scroll through the pages continuously");
+    continuousScrollCheckbox->setChecked(settings.continuousScroll);
+    continuousScrollCheckbox->alignBelow(mouseWheelScrollsCheckbox);
+    continuousScrollCheckbox->setCallback([this] (bool checked) {
+        api().executeLater([this, checked] { setContinuousScroll(checked); });
+    });
 };
 
+void DocumentsApp::setContinuousScroll(bool continuous) {
+    settings.continuousScroll = continuous;
+    for (auto &tab: pages) {
+        for (auto &view: {tab, tab->splitPane}) {
+            if (view && view->stitcher) {
+                view->stitcher->setContinuousPages(continuous);
+                updateTitle(view);
+            }
+        }
+    }
+}
+
+void DocumentsApp::onSearchToggle(bool forceClose) {
+    lastQuery.clear();
+    searchHits.clear();
+    if (!searchContainer) {
+        if (forceClose) {
+            return;
+        }
+        showSearch();
+    }
+    bool show = forceClose ? false : !searchContainer->isVisible();
+    searchContainer->setVisible(show);
+}
+
+void DocumentsApp::showSearch() {
+    auto ui = getUIContainer();
+
+    searchContainer = std::make_shared<Container>();
+    searchContainer->setDimensions(ui->getWidth(), ui->getHeight() / 2);
+    searchContainer->setFit(Container::Fit::OFF, Container::Fit::TIGHT);
+    searchContainer->alignInBottomCenter();
+    searchContainer->setVisible(false);
+
+    searchField = std::make_shared<TextArea>(searchContainer, "");
+    searchField->alignInTopLeft();
+    searchField->setDimensions(searchContainer->getWidth() / 2, 30);
+
+    searchLabel = std::make_shared<Label>(searchContainer, "Enter words to find in the document");
+    searchLabel->alignRightOf(searchField, 10);
+
+    searchKeys = std::make_shared<Keyboard>(searchContainer, searchField);
+    searchKeys->hideEnterKey();
+    searchKeys->setOnCancel([this] {
+        api().executeLater([this] { onSearchToggle(true); });
+    });
+    searchKeys->setOnOk([this] {
+        api().executeLater([this] { onSearch(searchField->getText()); });
+    });
+    searchKeys->setDimensions(searchContainer->getWidth(), searchKeys->getHeight());
+    searchKeys->alignBelow(searchField, 5);
+}
+
+void DocumentsApp::onSearch(const std::string &query) {
+    auto tab = getActiveDocPage();
+    if (!tab || !tab->source) {
+        return;
+    }
+
+    if (query != lastQuery || searchHits.empty()) {
+        lastQuery = query;
+        searchHits = tab->source->findText(query, MAX_SEARCH_HITS);
+        searchHitIndex = 0;
+    } else {
+        searchHitIndex = (searchHitIndex + 1) % searchHits.size();
+    }
+
+    // the index is still being built for large documents that weren't searched before
+    std::string progress;
+    int indexed = tab->source->getIndexedPages();
+    int pageCount = tab->stitcher->getPageCount();
+    if (indexed < pageCount) {
+        progress = ", " + std::to_string(indexed) + " of " + std::to_string(pageCount) + " pages indexed";
+    }
+
+    if (searchHits.empty()) {
+        searchLabel->setText("No matches" + progress);
+        return;
+    }
+    searchLabel->setText("Match " + std::to_string(searchHitIndex + 1) + " of " + std::to_string(searchHits.size()) + progress);
+
+    auto &hit = searchHits[searchHitIndex];
+    tab->stitcher->setPage(hit.page);
+    setTitle(tab);
+    auto xy = tab->source->hitToXY(hit, tab->stitcher->getZoomLevel());
+    tab->stitcher->setCenter(xy.x, xy.y);
+}
+
+void DocumentsApp::onThumbnailsToggle(bool forceClose) {
+    auto tab = getActiveDocPage();
+    bool show = !forceClose && tab && tab->stitcher && !thumbnailContainer;
+    thumbnailButtons.clear();
+    thumbnailContainer.reset();
+    missingThumbnails.clear();
+    thumbnailCenterPage = -1;
+    if (show) {
+        showThumbnails(tab);
+    }
+}
+
+void DocumentsApp::showThumbnails(PageInfo tab) {
+    auto source = tab->stitcher->getTileSource();
+    int pageCount = tab->stitcher->getPageCount();
+    int current = tab->stitcher->getCurrentPage();
+    int first = std::max(0, std::min(current - THUMBNAIL_COUNT / 2, pageCount - THUMBNAIL_COUNT));
+    int last = std::min(first + THUMBNAIL_COUNT, pageCount);
+
+    thumbnailButtons.clear();
+    missingThumbnails.clear();
+    thumbnailCenterPage = current;
+
+    if (!thumbnailContainer) {
+        thumbnailContainer = std::make_shared<Container>();
+        thumbnailContainer->setLayoutRow();
+        thumbnailContainer->setFit(Container::Fit::TIGHT, Container::Fit::TIGHT);
+    }
+
+    for (int page = first; page < last; page++) {
+        img::Image icon;
+        auto thumbnail = source->getPageThumbnail(page);
+        if (thumbnail) {
+            icon.resize(thumbnail->getWidth(), thumbnail->getHeight(), img::COLOR_WHITE);
+            thumbnail->copyTo(icon, 0, 0);
+        } else {
+            // requested now, shown by updateThumbnails once it is rendered
+            icon.resize(THUMBNAIL_PLACEHOLDER_WIDTH, THUMBNAIL_PLACEHOLDER_HEIGHT, img::COLOR_DARK_GREY);
+            missingThumbnails.push_back(page);
+        }
+
+        std::string caption = std::to_string(page + 1);
+        if (page == current) {
+            caption = "[" + caption + "]";
+        }
+        auto button = std::make_shared<Button>(thumbnailContainer, std::move(icon), caption);
+        button->setCallback([this, page] (const Button &) {
+            api().executeLater([this, page] { onThumbnailSelected(page); });
+        });
+        thumbnailButtons.push_back(button);
+    }
+
+    thumbnailContainer->alignInBottomCenter();
+}
+
+void DocumentsApp::updateThumbnails(PageInfo tab) {
+    if (!thumbnailContainer) {
+        return;
+    }
+
+    bool changed = (tab->stitcher->getCurrentPage() != thumbnailCenterPage);
+    auto source = tab->stitcher->getTileSource();
+    for (int page: missingThumbnails) {
+        changed |= (source->getPageThumbnail(page) != nullptr);
+    }
+    if (changed) {
+        showThumbnails(tab);
+    }
+}
+
+void DocumentsApp::onThumbnailSelected(int page) {
+    auto tab = getActiveDocPage();
+    if (tab && tab->stitcher && tab->stitcher->setPage(page)) {
+        setTitle(tab);
+        positionPage(tab, VerticalPosition::Top, HorizontalPosition::Middle);
+        updateThumbnails(tab);
+    }
+}
+
 void DocumentsApp::positionPage(PageInfo tab, VerticalPosition vp, HorizontalPosition hp, ZoomAdjust za) {
     if (!tab->stitcher) {
         return;
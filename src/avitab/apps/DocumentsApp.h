@@ -29,6 +29,9 @@
 #include "src/gui_toolkit/widgets/Checkbox.h"
 #include "src/gui_toolkit/widgets/Container.h"
 #include "src/gui_toolkit/widgets/Label.h"
+#include "src/gui_toolkit/widgets/TextArea.h"
+#include "src/gui_toolkit/widgets/Keyboard.h"
+#include "src/gui_toolkit/widgets/Button.h"
 #include "src/gui_toolkit/Timer.h"
 #include "src/libimg/Image.h"
 #include "src/libimg/stitcher/Stitcher.h"
@@ -65,6 +68,7 @@ private:
 
     void createBrowseTab();
     void showDirectory();
+    void onEntries(const std::vector<platform::DirEntry> &entries, bool complete);
     void setFilterRegex(const std::string regex);
     void showCurrentEntries();
     void upOneDirectory();
@@ -83,17 +87,31 @@ private:
         std::shared_ptr<img::Stitcher> stitcher;
         std::shared_ptr<maps::OverlayedMap> map;
         int panStartX = 0, panStartY = 0;
+        int titlePage = -1;
+        // a second view of the document next to this one, sharing its rasterizer.
+        // It shares the page and window of the tab that owns it.
+        std::shared_ptr<DocumentPage> splitPane;
+        bool splitFocused = false;
+        DocumentPage *owner = nullptr;
     };
 
     using PageInfo = std::shared_ptr<DocumentPage>;
     std::vector<PageInfo> pages;
 
     void createDocumentTab(const std::string &docPath);
+    void createView(PageInfo view, int width, int height);
+    void resizeView(PageInfo view, int width, int height);
     void removeTab(std::shared_ptr<Page> page);
     void setupCallbacks(PageInfo tab);
     void loadFile(PageInfo tab, const std::string &docPath);
     void setTitle(PageInfo tab);
+    void updateTitle(PageInfo tab);
+    PageInfo getActiveTab();
+    // the focused view of the active tab
     PageInfo getActiveDocPage();
+    void onSplitToggle();
+    void openSplitPane(PageInfo tab);
+    void closeSplitPane(PageInfo tab);
     void onNextPage();
     void onPrevPage();
     void onPlus();
@@ -108,7 +126,35 @@ private:
     std::shared_ptr<Container> settingsContainer;
     std::shared_ptr<Label> settingsLabel;
     std::shared_ptr<Checkbox> mouseWheelScrollsCheckbox;
+    std::shared_ptr<Checkbox> continuousScrollCheckbox;
     void showAppSettings();
+    void setContinuousScroll(bool continuous);
+
+    static constexpr const size_t MAX_SEARCH_HITS = 500;
+    std::shared_ptr<Container> searchContainer;
+    std::shared_ptr<TextArea> searchField;
+    std::shared_ptr<Label> searchLabel;
+    std::shared_ptr<Keyboard> searchKeys;
+    // hits of the last query in the active tab, OK with the same query shows the next one
+    std::string lastQuery;
+    std::vector<img::TextIndex::Hit> searchHits;
+    size_t searchHitIndex = 0;
+    void showSearch();
+    void onSearchToggle(bool forceClose = false);
+    void onSearch(const std::string &query);
+
+    // thumbnails of the pages around the current one to jump to, filled in as they are rendered
+    static constexpr const int THUMBNAIL_COUNT = 7;
+    static constexpr const int THUMBNAIL_PLACEHOLDER_WIDTH = 90;
+    static constexpr const int THUMBNAIL_PLACEHOLDER_HEIGHT = 128;
+    std::shared_ptr<Container> thumbnailContainer;
+    std::vector<std::shared_ptr<Button>> thumbnailButtons;
+    std::vector<int> missingThumbnails;
+    int thumbnailCenterPage = -1;
+    void onThumbnailsToggle(bool forceClose = false);
+    void showThumbnails(PageInfo tab);
+    void updateThumbnails(PageInfo tab);
+    void onThumbnailSelected(int page);
 
     enum class VerticalPosition { Top, Centre, Bottom };
     enum class HorizontalPosition { Left, Middle, Right };
@@ -16,10 +16,12 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <algorithm>
+#include <cstdio>
 #include <iomanip>
 #include <sstream>
 #include "HeaderApp.h"
 #include "src/platform/Platform.h"
+#include "src/platform/FrameProfiler.h"
 #include "src/Logger.h"
 
 namespace avitab {
@@ -50,6 +52,7 @@ HeaderApp::HeaderApp(FuncsPtr appFuncs):
     homeButton->centerInParent();
 
     createSettingsContainer();
+    setProfileVisible(savedSettings->getGeneralSetting<bool>("show_frame_profile"));
 
     onTick();
 }
@@ -78,6 +81,11 @@ void HeaderApp::createSettingsContainer() {
     fpsCheckbox->setCallback([this] (bool checked) { showFps = checked; savedSettings->setGeneralSetting<bool>("show_fps", showFps); fpsLabel->setVisible(showFps); });
     fpsCheckbox->alignRightOf(brightnessSlider);
 
+    profileCheckbox = std::make_shared<Checkbox>(prefContainer, "Show profile");
+    profileCheckbox->setChecked(savedSettings->getGeneralSetting<bool>("show_frame_profile"));
+    profileCheckbox->setCallback([this] (bool checked) { savedSettings->setGeneralSetting<bool>("show_frame_profile", checked); setProfileVisible(checked); });
+    profileCheckbox->alignBelow(fpsCheckbox, VERT_PADDING);
+
     mediaLabel = std::make_shared<Label>(prefContainer, "Ext. Media");
     mediaLabel->alignBelow(brightLabel, VERT_PADDING);
 
@@ -117,9 +125,43 @@ void HeaderApp::onClockClick(int x, int y, bool pr, bool rel) {
 bool HeaderApp::onTick() {
     updateClock();
     updateFPS();
+    if (profileLabel && (timerCount % TIMER_TICKS_PER_SEC) == 0) {
+        updateProfile();
+    }
     return true;
 }
 
+void HeaderApp::setProfileVisible(bool visible) {
+    if (!visible) {
+        profileLabel.reset();
+        profileContainer.reset();
+        return;
+    }
+
+    if (!profileContainer) {
+        profileContainer = std::make_shared<Container>();
+        profileContainer->setFit(Container::Fit::TIGHT, Container::Fit::TIGHT);
+        profileLabel = std::make_shared<Label>(profileContainer, "");
+        updateProfile();
+    }
+}
+
+void HeaderApp::updateProfile() {
+    using platform::FrameProfiler;
+
+    std::string text = "stage p50 / p95 / p99 ms";
+    for (int i = 0; i < FrameProfiler::NUM_STAGES; i++) {
+        auto stage = static_cast<FrameProfiler::Stage>(i);
+        char line[80];
+        snprintf(line, sizeof(line), "\n%s %.1f / %.1f / %.1f", FrameProfiler::getStageName(stage),
+                 FrameProfiler::getPercentile(stage, 50), FrameProfiler::getPercentile(stage, 95),
+                 FrameProfiler::getPercentile(stage, 99));
+        text += line;
+    }
+    profileLabel->setText(text);
+    profileContainer->alignInBottomLeft();
+}
+
 void HeaderApp::updateClock() {
     if ((timerCount % TIMER_TICKS_PER_SEC) == 0) {
         std::ostringstream t;
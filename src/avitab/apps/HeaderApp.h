@@ -40,13 +40,17 @@ private:
 
     std::shared_ptr<Container> prefContainer;
     std::shared_ptr<Slider> brightnessSlider;
-    std::shared_ptr<Checkbox> fpsCheckbox;
+    std::shared_ptr<Checkbox> fpsCheckbox, profileCheckbox;
     std::shared_ptr<Button> pauseButton, nextButton, prevButton;
     std::shared_ptr<Label> brightLabel, mediaLabel;
     std::shared_ptr<Button> closeButton;
 
     std::shared_ptr<avitab::Settings> savedSettings;
 
+    // frame profiler statistics on top of everything
+    std::shared_ptr<Container> profileContainer;
+    std::shared_ptr<Label> profileLabel;
+
     static constexpr int TIMER_PERIOD_MS = 100;
     static constexpr int TIMER_TICKS_PER_SEC = 1000 / TIMER_PERIOD_MS;
     Timer tickTimer;
@@ -67,6 +71,8 @@ private:
     bool onTick();
     void updateClock();
     void updateFPS();
+    void setProfileVisible(bool visible);
+    void updateProfile();
     void pushFPSValue(float fps);
     float getAverageFPS();
 };
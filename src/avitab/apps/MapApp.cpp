@@ -24,10 +24,13 @@
 #include "src/platform/Platform.h"
 #include "src/platform/strtod.h"
 #include "src/maps/sources/OnlineSlippySource.h"
+#include "src/maps/sources/VectorTileSource.h"
+#include "src/maps/sources/HillshadeSource.h"
 #include "src/maps/sources/GeoTIFFSource.h"
 #include "src/maps/sources/LocalFileSource.h"
 #include "src/maps/sources/XPlaneSource.h"
 #include "src/maps/sources/EPSGSource.h"
+#include "src/maps/TileSeedPlanner.h"
 
 namespace avitab {
 
@@ -38,6 +41,7 @@ MapApp::MapApp(FuncsPtr funcs):
     updateTimer(std::bind(&MapApp::onTimer, this), 200)
 {
     overlayConf = api().getSettings()->getOverlayConfig();
+    trackUp = savedSettings->getGeneralSetting<bool>("map_track_up");
 
     window->setOnClose([this] () { exit(); });
     window->addSymbol(Widget::Symbol::LIST, std::bind(&MapApp::onSettingsButton, this));
@@ -125,6 +129,15 @@ void MapApp::createSettingsLayout() {
     auto mercatorLabel = std::make_shared<Label>(settingsContainer, "Uses any PDF or image as Mercator map.");
     mercatorLabel->alignRightOf(mercatorButton, 10);
     mercatorLabel->setManaged();
+
+    seedRouteButton = std::make_shared<Button>(settingsContainer, "Offline");
+    seedRouteButton->setCallback([this] (const Button &) { onSeedRouteButton(); });
+    seedRouteButton->setFit(false, true);
+    seedRouteButton->setDimensions(onlineMapsButton->getWidth(), onlineMapsButton->getHeight());
+    seedRouteButton->alignBelow(mercatorButton, 10);
+    seedRouteLabel = std::make_shared<Label>(settingsContainer, baseSeedRouteLabel);
+    seedRouteLabel->alignRightOf(seedRouteButton, 10);
+    seedRouteLabel->setManaged();
 }
 
 void MapApp::setMapSource(MapSource style, bool init) {
@@ -255,6 +268,24 @@ void MapApp::selectEPSG() {
     chooserContainer->setVisible(true);
 }
 
+std::shared_ptr<maps::OnlineSlippySource> MapApp::createOnlineSource(const maps::OnlineSlippyMapConfig &conf) {
+    std::shared_ptr<maps::OnlineSlippySource> source;
+    if (conf.type == "vector") {
+        std::string stylePath = api().getDataPath() + "online-maps/" + conf.style;
+        source = std::make_shared<maps::VectorTileSource>(
+            conf.servers, conf.url, conf.minZoomLevel, conf.maxZoomLevel,
+            conf.tileWidthPx, conf.copyright, conf.name, conf.protocol, stylePath);
+    } else {
+        source = std::make_shared<maps::OnlineSlippySource>(
+            conf.servers, conf.url, conf.minZoomLevel, conf.maxZoomLevel,
+            conf.tileWidthPx, conf.tileHeightPx, conf.copyright,
+            conf.name, conf.protocol);
+    }
+    source->setMaxAge(conf.maxAgeSeconds);
+    source->setHedgedRequests(conf.hedgeRequests);
+    return source;
+}
+
 void MapApp::selectOnlineMaps(bool interactive, const std::shared_ptr<maps::OnlineSlippySource> fallback) {
     auto showOnlineMapsError([this, fallback](std::vector<std::string> errorMsgs) {
         // Lambda function to show an error in the online maps window
@@ -347,14 +378,23 @@ void MapApp::selectOnlineMaps(bool interactive, const std::shared_ptr<maps::Onli
                 &api(), "Select online slippy maps");
         containerWithClickableList->setListItems(slippyMapNames);
 
-        containerWithClickableList->setSelectCallback([this](int selectedItem) {
+        containerWithClickableList->setSelectCallback([this, showOnlineMapsError](int selectedItem) {
             const auto &conf = slippyMaps.at(selectedItem);
-            std::shared_ptr<img::TileSource> tileSource;
-
-            tileSource = std::make_shared<maps::OnlineSlippySource>(
-                conf.servers, conf.url, conf.minZoomLevel, conf.maxZoomLevel,
-                conf.tileWidthPx, conf.tileHeightPx, conf.copyright,
-                conf.name, conf.protocol);
+            std::shared_ptr<maps::OnlineSlippySource> slippySource;
+            try {
+                slippySource = createOnlineSource(conf);
+            } catch (const std::runtime_error &e) {
+                logger::error("Failed to create online map %s: %s", conf.name.c_str(), e.what());
+                api().executeLater([this, showOnlineMapsError, msg = std::string(e.what())] () {
+                    containerWithClickableList.reset();
+                    showOnlineMapsError(std::vector<std::string>{
+                            "Failed to load the online map:",
+                            msg,
+                            "Please check the AviTab logs for more details"});
+                });
+                return;
+            }
+            std::shared_ptr<img::TileSource> tileSource = slippySource;
 
             setTileSource(tileSource);
             currentActiveOnlineMap = conf.name;
@@ -377,12 +417,18 @@ void MapApp::selectOnlineMaps(bool interactive, const std::shared_ptr<maps::Onli
         // If non-interactive selection, pick the first map
         // found in the mapconfig.json
         const auto &conf = slippyMaps.at(0);
-        std::shared_ptr<img::TileSource> tileSource;
-        tileSource =
-            std::make_shared<maps::OnlineSlippySource>(
-                conf.servers, conf.url, conf.minZoomLevel, conf.maxZoomLevel,
-                conf.tileWidthPx, conf.tileHeightPx, conf.copyright,
-                conf.name, conf.protocol);
+        std::shared_ptr<maps::OnlineSlippySource> slippySource;
+        try {
+            slippySource = createOnlineSource(conf);
+        } catch (const std::runtime_error &e) {
+            logger::error("Failed to create online map %s: %s", conf.name.c_str(), e.what());
+            showOnlineMapsError(std::vector<std::string>{
+                    "Failed to load the online map:",
+                    e.what(),
+                    "Please check the AviTab logs for more details"});
+            return;
+        }
+        std::shared_ptr<img::TileSource> tileSource = slippySource;
         setTileSource(tileSource);
         currentActiveOnlineMap = conf.name;
     }
@@ -420,13 +466,22 @@ void MapApp::setTileSource(std::shared_ptr<img::TileSource> source) {
     trackPlane = true;
 
     mapStitcher = std::make_shared<img::Stitcher>(mapImage, tileSource);
+    terrainLayer = -1;
     mapStitcher->setCacheDirectory(api().getDataPath() + "MapTiles/");
+    if (savedSettings->getGeneralSetting<bool>("tile_cache_archive")) {
+        mapStitcher->setCacheArchive(api().getDataPath() + "MapTiles/tiles.sqlite");
+    }
 
     map = std::make_shared<maps::OverlayedMap>(mapStitcher, overlayConf);
     map->loadOverlayIcons(api().getDataPath() + "icons/");
+    // tiles ahead of the aircraft are loaded for this many minutes of flight, 0 turns it off
+    map->setPrefetchMinutes(savedSettings->getGeneralSetting<int>("map_prefetch_minutes"));
     map->setRedrawCallback([this] () { onRedrawNeeded(); });
     map->setGetRouteCallback([this] () { return api().getRoute(); });
+    map->setGetProcedureCallback([this] () { return api().getProcedure(); });
+    map->setGetWeatherCallback([this] () { return api().getWeatherStations(); });
     map->setNavWorld(api().getNavWorld());
+    applyTerrainLayer();
 
     keyboard.reset();
     coordsField.reset();
@@ -434,6 +489,28 @@ void MapApp::setTileSource(std::shared_ptr<img::TileSource> source) {
     onTimer();
 }
 
+void MapApp::applyTerrainLayer() {
+    // the relief tiles share the web mercator grid, so only slippy maps can show them
+    auto slippySource = std::dynamic_pointer_cast<maps::OnlineSlippySource>(tileSource);
+    if (terrainLayer >= 0) {
+        mapStitcher->removeLayer(terrainLayer);
+        terrainLayer = -1;
+    }
+    if (!slippySource || !savedSettings->getGeneralSetting<bool>("terrain_relief")) {
+        return;
+    }
+
+    auto tileDims = slippySource->getTileDimensions(slippySource->getInitialZoomLevel());
+    auto relief = std::make_shared<maps::HillshadeSource>(
+            std::vector<std::string>{"s3.amazonaws.com"},
+            "elevation-tiles-prod/terrarium/{z}/{x}/{y}.png",
+            15, tileDims.x, 0.4f,
+            "Terrain: Mapzen/AWS Terrain Tiles", "Terrain");
+    img::Stitcher::LayerOptions options;
+    options.position = img::Stitcher::LayerPosition::ABOVE;
+    terrainLayer = mapStitcher->addLayer(relief, options, api().getDataPath() + "MapTiles/");
+}
+
 void MapApp::resetWidgets() {
     overlayLabel.reset();
     ndbCheckbox.reset();
@@ -450,6 +527,9 @@ void MapApp::resetWidgets() {
     poiCheckbox.reset();
     vrpCheckbox.reset();
     markerCheckbox.reset();
+    terrainCheckbox.reset();
+    trackUpCheckbox.reset();
+    weatherCheckbox.reset();
     overlaysContainer.reset();
 }
 
@@ -463,6 +543,8 @@ void MapApp::suspend() {
 
 void MapApp::resume() {
     suspended = false;
+    // the dirty areas of the updates while suspended are lost
+    mapWidget->invalidate();
 }
 
 void MapApp::onSettingsButton() {
@@ -597,6 +679,31 @@ void MapApp::showOverlaySettings() {
     markerCheckbox->alignRightOf(vrpCheckbox);
     markerCheckbox->setCallback([this] (bool checked) { overlayConf->drawMarkers = checked; });
 
+    terrainCheckbox = std::make_shared<Checkbox>(overlaysContainer, "Terrain");
+    terrainCheckbox->setChecked(savedSettings->getGeneralSetting<bool>("terrain_relief"));
+    terrainCheckbox->alignBelow(loadUserFixesButton, 10);
+    terrainCheckbox->setCallback([this] (bool checked) {
+        savedSettings->setGeneralSetting<bool>("terrain_relief", checked);
+        if (mapStitcher) {
+            applyTerrainLayer();
+        }
+    });
+
+    trackUpCheckbox = std::make_shared<Checkbox>(overlaysContainer, "Track up");
+    trackUpCheckbox->setChecked(trackUp);
+    trackUpCheckbox->alignRightOf(terrainCheckbox);
+    trackUpCheckbox->setCallback([this] (bool checked) {
+        trackUp = checked;
+        savedSettings->setGeneralSetting<bool>("map_track_up", checked);
+        if (!checked && mapStitcher) {
+            mapStitcher->setRotation(0);
+        }
+    });
+
+    weatherCheckbox = std::make_shared<Checkbox>(overlaysContainer, "Weather");
+    weatherCheckbox->setChecked(overlayConf->drawWeather);
+    weatherCheckbox->alignRightOf(trackUpCheckbox);
+    weatherCheckbox->setCallback([this] (bool checked) { overlayConf->drawWeather = checked; });
 }
 
 void MapApp::selectUserFixesFile() {
@@ -636,7 +743,9 @@ void MapApp::selectUserFixesFile() {
 
 void MapApp::onRedrawNeeded() {
     if (!suspended) {
-        mapWidget->invalidate();
+        int x0, y0, x1, y1;
+        mapStitcher->getDirtyArea(x0, y0, x1, y1);
+        mapWidget->invalidateArea(x0, y0, x1, y1);
     }
 
     std::ostringstream str;
@@ -903,27 +1012,102 @@ bool MapApp::handleNonNumericContent(std::string coords)  {
 }
 
 bool MapApp::onTimer() {
-    if (suspended) {
+    if (!isVisible()) {
         return true;
     }
 
-    std::vector<avitab::Location> locs;
-    for (AircraftID i = 0; i < api().getActiveAircraftCount(); ++i) {
-        locs.push_back(api().getAircraftLocation(i));
-    }
-
-    map->setPlaneLocations(locs);
+    map->setPlaneLocations(api().getAircraftLocations());
     if (trackPlane) {
         map->centerOnPlane();
     }
+    if (trackUp) {
+        // the aircraft's heading points up, in the map's own north like the plane icon
+        mapStitcher->setRotation(-(api().getAircraftLocation(0).heading + map->getNorthOffset()));
+    }
 
     map->doWork();
+    updateSeedProgress();
 
     double lat, lon;
     map->getCenterLocation(lat, lon);
     api().updateMapExports(lat, lon, map->getZoomLevel(), map->getVerticalRange());
+    api().updateOverlayTimingExports(map->getOverlayTimings());
+    if (api().isMapStateExported()) {
+        publishMapState(lat, lon);
+    }
 
     return true;
 }
 
+void MapApp::onSeedRouteButton() {
+    if (seeding) {
+        mapStitcher->stopSeeding();
+        return;
+    }
+
+    auto route = api().getRoute();
+    if (currentActiveMapSource != MapSource::ONLINE_TILES) {
+        showMessage("Only online maps can be stored for offline use.");
+        return;
+    } else if (!route) {
+        showMessage("Plan a route first, the tiles along it are stored.");
+        return;
+    }
+
+    // the current zoom and two levels more detail, 10 NM to each side
+    int minZoom = mapStitcher->getZoomLevel();
+    int maxZoom = std::min(minZoom + 2, tileSource->getMaxZoomLevel());
+    auto tiles = maps::tilesAlongRoute(*tileSource, *route, 10, minZoom, maxZoom);
+    mapStitcher->stopSeeding();
+    mapStitcher->startSeeding(tiles, 2);
+    updateSeedProgress();
+}
+
+void MapApp::updateSeedProgress() {
+    auto progress = mapStitcher->getSeedProgress();
+    if (progress.running) {
+        seeding = true;
+        seedRouteLabel->setTextFormatted("Storing tiles: %zu / %zu, %zu failed. Press again to stop.",
+                progress.done, progress.total, progress.failed);
+    } else if (seeding) {
+        seeding = false;
+        seedRouteLabel->setText(baseSeedRouteLabel);
+    }
+}
+
+void MapApp::showMessage(const std::string &msg) {
+    messageBox = std::make_unique<avitab::MessageBox>(getUIContainer(), msg);
+    messageBox->addButton("Ok", [this] () {
+        api().executeLater([this] () {
+            messageBox.reset();
+        });
+    });
+    messageBox->centerInParent();
+}
+
+void MapApp::publishMapState(double lat, double lon) {
+    MapState state;
+    state.centerLat = lat;
+    state.centerLon = lon;
+    state.zoom = map->getZoomLevel();
+    state.verticalRange = map->getVerticalRange();
+    state.rotation = mapStitcher->getRotationAngle();
+    map->getVisibleArea(state.minLat, state.minLon, state.maxLat, state.maxLon);
+
+    auto aircraft = api().getAircraftLocations();
+    state.aircraft.reserve(aircraft->locations.size());
+    for (auto &loc: aircraft->locations) {
+        state.aircraft.push_back({loc.latitude, loc.longitude, (float) loc.elevation, (float) loc.heading});
+    }
+
+    if (auto route = api().getRoute()) {
+        route->iterateRoute([&state] (const std::shared_ptr<world::NavEdge> via, const std::shared_ptr<world::NavNode> to) {
+            auto &loc = to->getLocation();
+            state.route.push_back({loc.latitude, loc.longitude, to->getID()});
+        });
+    }
+
+    api().publishMapState(state);
+}
+
 } /* namespace avitab */
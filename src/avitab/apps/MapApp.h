@@ -56,6 +56,10 @@ const struct maps::OnlineSlippyMapConfig fallbackOnlineMap = {
     .maxZoomLevel = 16,
     .tileWidthPx = 256,
     .tileHeightPx = 256,
+    .maxAgeSeconds = -1,
+    .hedgeRequests = true,
+    .type = "raster",
+    .style = "",
     .enabled = true,
 };
 
@@ -95,6 +99,8 @@ private:
     std::shared_ptr<Button> trackButton;
     std::shared_ptr<Button> rotateButton;
     std::shared_ptr<Container> settingsContainer, chooserContainer, overlaysContainer;
+    std::shared_ptr<Button> seedRouteButton;
+    std::shared_ptr<Label> seedRouteLabel;
     std::shared_ptr<Button> mercatorButton, xplaneButton, geoTiffButton, epsgButton, naviLowButton, naviHighButton, naviVFRButton, naviWorldButton, onlineMapsButton;
     std::shared_ptr<Label> overlayLabel;
     std::shared_ptr<Checkbox> myAircraftCheckbox, otherAircraftCheckbox, routeCheckbox;
@@ -102,6 +108,7 @@ private:
     std::shared_ptr<Checkbox> vorCheckbox, ndbCheckbox, ilsCheckbox, waypointCheckbox;
     std::shared_ptr<Button> loadUserFixesButton;
     std::shared_ptr<Checkbox> poiCheckbox, vrpCheckbox, markerCheckbox;
+    std::shared_ptr<Checkbox> terrainCheckbox, trackUpCheckbox, weatherCheckbox;
 
     std::unique_ptr<MessageBox> messageBox;
     std::shared_ptr<TextArea> coordsField;
@@ -111,11 +118,15 @@ private:
     std::map<size_t, maps::OnlineSlippyMapConfig> slippyMaps;
 
     const std::string baseOnlineMapsLabel = "Select slippy tiles from online sources.";
+    const std::string baseSeedRouteLabel = "Stores the online map along the route for offline use.";
     std::shared_ptr<Label> onlineMapsLabel;
 
     Timer updateTimer;
     bool trackPlane = true;
     bool suspended = true;
+    int terrainLayer = -1;
+    bool trackUp = false;
+    bool seeding = false;
 
     int panPosX = 0, panPosY = 0;
     bool wasTrackingPlaneAtPanStart;
@@ -125,9 +136,11 @@ private:
     void showOverlaySettings();
     void setMapSource(MapSource style, bool init = false);
     void setTileSource(std::shared_ptr<img::TileSource> source);
+    void applyTerrainLayer();
     void selectGeoTIFF();
     void selectMercator();
     void selectEPSG();
+    std::shared_ptr<maps::OnlineSlippySource> createOnlineSource(const maps::OnlineSlippyMapConfig &conf);
     void selectOnlineMaps(bool interactive = true, const std::shared_ptr<maps::OnlineSlippySource> fallback =
             std::make_shared<maps::OnlineSlippySource>(
                 fallbackOnlineMap.servers,
@@ -141,8 +154,12 @@ private:
                 fallbackOnlineMap.protocol));
     void selectNavigraph(maps::NavigraphMapType type);
     void selectUserFixesFile();
+    void onSeedRouteButton();
+    void updateSeedProgress();
+    void showMessage(const std::string &msg);
 
     bool onTimer();
+    void publishMapState(double lat, double lon);
     void onRedrawNeeded();
     void resetWidgets();
     void onSettingsButton();
@@ -0,0 +1,40 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "MetricsApp.h"
+#include "src/platform/Metrics.h"
+
+namespace avitab {
+
+MetricsApp::MetricsApp(FuncsPtr appFuncs):
+    App(appFuncs),
+    window(std::make_shared<Window>(getUIContainer(), "Metrics")),
+    label(std::make_shared<Label>(window, ""))
+{
+    window->setOnClose([this] () { exit(); });
+    onTimer();
+    refreshTimer = std::make_unique<Timer>(std::bind(&MetricsApp::onTimer, this), REFRESH_MS);
+}
+
+bool MetricsApp::onTimer() {
+    if (isVisible()) {
+        label->setText(platform::Metrics::format(platform::Metrics::snapshot()));
+    }
+    return true;
+}
+
+} /* namespace avitab */
@@ -0,0 +1,42 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include "App.h"
+#include "src/gui_toolkit/widgets/Window.h"
+#include "src/gui_toolkit/widgets/Label.h"
+#include "src/gui_toolkit/Timer.h"
+
+namespace avitab {
+
+// Debug view of the runtime metrics, see platform::Metrics
+class MetricsApp: public App {
+public:
+    MetricsApp(FuncsPtr appFuncs);
+private:
+    static constexpr const int REFRESH_MS = 1000;
+
+    std::shared_ptr<Window> window;
+    std::shared_ptr<Label> label;
+    std::unique_ptr<Timer> refreshTimer;
+
+    bool onTimer();
+};
+
+} /* namespace avitab */
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include "NotesApp.h"
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
@@ -88,9 +89,12 @@ void NotesApp::onDraw(int x, int y, bool start, bool stop) {
     }
 
     if (!start && !stop) {
-        image.drawLine(drawPosX, drawPosY, x, y, 0xFF000000);
+        image.drawLineAA(drawPosX, drawPosY, x, y, 0xFF000000);
         if (scratchPad) {
-            scratchPad->invalidate();
+            // the ink is kept in the image, so only the new segment has to be redrawn
+            // instead of the whole pad, plus the antialiased pixels next to it
+            scratchPad->invalidateArea(std::min(drawPosX, x) - 1, std::min(drawPosY, y) - 1,
+                                       std::max(drawPosX, x) + 2, std::max(drawPosY, y) + 2);
         }
     }
 
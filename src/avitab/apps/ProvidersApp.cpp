@@ -17,6 +17,7 @@
  */
 #include "ProvidersApp.h"
 #include "src/platform/Platform.h"
+#include "src/charts/RequestStats.h"
 #include "src/Logger.h"
 
 namespace avitab {
@@ -51,6 +52,34 @@ ProvidersApp::ProvidersApp(FuncsPtr appFuncs):
             onChartFoxLoginSuccessful();
         }
     }
+
+    networkPage = tabs->addTab(tabs, "Network");
+    windowNetwork = std::make_shared<Window>(networkPage, "Network");
+    windowNetwork->setOnClose([this] () { exit(); });
+    createNetworkLayout();
+}
+
+void ProvidersApp::createNetworkLayout() {
+    labelNetwork = std::make_shared<Label>(windowNetwork, "");
+    labelNetwork->setLongMode(true);
+    labelNetwork->alignInTopLeft();
+
+    resetNetworkButton = std::make_shared<Button>(windowNetwork, "Reset");
+    resetNetworkButton->alignInBottomRight();
+    resetNetworkButton->setCallback([this] (const Button &btn) {
+        api().executeLater([this] () {
+            apis::RequestStats::shared().reset();
+            onNetworkTimer();
+        });
+    });
+
+    onNetworkTimer();
+    networkTimer = std::make_unique<Timer>(std::bind(&ProvidersApp::onNetworkTimer, this), NETWORK_REFRESH_MS);
+}
+
+bool ProvidersApp::onNetworkTimer() {
+    labelNetwork->setText(apis::RequestStats::shared().formatReport());
+    return true;
 }
 
 void ProvidersApp::resetNavigraphLayout() {
@@ -84,9 +113,9 @@ void ProvidersApp::onNavigraphLogin() {
     call->andThen([this] (std::future<bool> result) {
         try {
             result.get();
-            api().executeLater([this] () { onNavigraphAuthSuccess(); });
+            api().executeLater([this] () { onNavigraphAuthSuccess(); }, TaskPriority::BACKGROUND);
         } catch (const navigraph::LoginException &e) {
-            api().executeLater([this] () { onNavigraphAuthRequired(); });
+            api().executeLater([this] () { onNavigraphAuthRequired(); }, TaskPriority::BACKGROUND);
         } catch (const std::exception &e) {
             labelNavigraph->setTextFormatted("Error: %s", e.what());
         }
@@ -214,9 +243,9 @@ void ProvidersApp::testChartFoxLinkage() {
         try {
             bool authenticated = result.get();
             if (!authenticated) throw chartfox::LoginException();
-            api().executeLater([this] () { onChartFoxLoginSuccessful(); });
+            api().executeLater([this] () { onChartFoxLoginSuccessful(); }, TaskPriority::BACKGROUND);
         } catch (const chartfox::LoginException &e) {
-            api().executeLater([this] () { onChartFoxAuthRequired(); });
+            api().executeLater([this] () { onChartFoxAuthRequired(); }, TaskPriority::BACKGROUND);
         } catch (const std::exception &e) {
             labelChartFox->setTextFormatted("Error: %s", e.what());
         }
@@ -25,6 +25,7 @@
 #include "src/gui_toolkit/widgets/PixMap.h"
 #include "src/gui_toolkit/widgets/TabGroup.h"
 #include "src/gui_toolkit/widgets/Checkbox.h"
+#include "src/gui_toolkit/Timer.h"
 
 namespace avitab {
 
@@ -40,6 +41,14 @@ private:
     std::shared_ptr<Page> navigraphPage, chartFoxPage;
     std::shared_ptr<Button> chartFoxDonateButton;
 
+    // request timings of the providers and tile servers
+    static constexpr const int NETWORK_REFRESH_MS = 2000;
+    std::shared_ptr<Page> networkPage;
+    std::shared_ptr<Window> windowNetwork;
+    std::shared_ptr<Label> labelNetwork;
+    std::shared_ptr<Button> resetNetworkButton;
+    std::unique_ptr<Timer> networkTimer;
+
     void resetNavigraphLayout();
     void onNavigraphLogin();
     void onNavigraphAuthRequired();
@@ -56,6 +65,9 @@ private:
     void onChartFoxCancelLoginButton();
     void onChartFoxLoginSuccessful();
     void onChartFoxLogoutButton();
+
+    void createNetworkLayout();
+    bool onNetworkTimer();
 };
 
 } /* namespace avitab */
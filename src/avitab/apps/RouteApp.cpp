@@ -24,11 +24,18 @@
 namespace avitab {
 
 RouteApp::RouteApp(FuncsPtr appFuncs):
-    App(appFuncs)
+    App(appFuncs),
+    airportSearch([appFuncs] (std::function<void()> f) { appFuncs->executeLater(f); },
+        [this] (const std::string &query, const AirportSearch::Results &results) {
+            onMatchesFound(query, results);
+        })
 {
     auto ui = getUIContainer();
     window = std::make_shared<Window>(ui, "Route");
     window->setOnClose([this] () {
+        if (router) {
+            router->cancel();
+        }
         showDeparturePage();
         exit();
     });
@@ -43,6 +50,7 @@ RouteApp::RouteApp(FuncsPtr appFuncs):
 
 void RouteApp::showDeparturePage() {
     reset();
+    diverting = false;
 
     window->setCaption("Route Wizard - Departure");
 
@@ -68,6 +76,7 @@ void RouteApp::showDeparturePage() {
     keys->setOnCancel([this] () {
         departureField->setText("");
     });
+    showMatches(departureField, checkBox);
 
     keys->setOnOk([this] () { api().executeLater([this] () {
         if (checkBox->isChecked()) {
@@ -117,6 +126,7 @@ void RouteApp::showArrivalPage() {
     keys->setOnCancel([this] () {
         arrivalField->setText("");
     });
+    showMatches(arrivalField, arrivalField);
 
     keys->setOnOk([this] () { api().executeLater([this] () {
         onArrivalEntered(arrivalField->getText());
@@ -145,21 +155,127 @@ void RouteApp::onArrivalEntered(const std::string& arrival) {
 
     arrivalNode = ap;
 
-    auto router = api().getRouteFinder();
+    if (diverting && router && route) {
+        // the finder still holds its last search, re-planning from the route ahead reuses it
+        auto aircraft = api().getAircraftLocation(0);
+        departureNode = router->rejoinRoute(*route, world::Location(aircraft.latitude, aircraft.longitude));
+        router->setArrival(arrivalNode);
+        diverting = false;
+        showSearchPage();
+        startSearch();
+        return;
+    }
+
+    router = api().getRouteFinder();
     router->setDeparture(departureNode);
     router->setArrival(arrivalNode);
     router->setAirwayLevel(airwayLevel);
-    router->setGetMagVarsCallback([this] (std::vector<std::pair<double, double>> locations) {
-        return api().getMagneticVariations(locations);
+    router->setExpansionBudget(MAX_SEARCH_EXPANSIONS);
+    // these run on the search's thread, which must not touch the app unless it's still alive
+    FuncsPtr funcs = &api();
+    std::weak_ptr<const void> alive = lifetime;
+    router->setGetMagVarsCallback([funcs] (std::vector<std::pair<double, double>> locations) {
+        return funcs->getMagneticVariations(locations);
+    });
+    router->setProgressCallback([this, funcs, alive] (const world::RouteFinder::SearchProgress &progress) {
+        funcs->executeLater([this, alive, progress] () {
+            if (!alive.expired() && searching && label) {
+                label->setTextFormatted("Searching route from %s to %s ...\n%zu waypoints checked, best estimate %.0fnm",
+                        departureNode->getID().c_str(), arrivalNode->getID().c_str(), progress.nodesExpanded,
+                        progress.bestFScore / 1000 * world::KM_TO_NM);
+            }
+        });
+    });
+
+    showSearchPage();
+    startSearch();
+}
+
+void RouteApp::startSearch() {
+    // the search runs on the router's own thread, the result is handled on the GUI thread
+    FuncsPtr funcs = &api();
+    std::weak_ptr<const void> alive = lifetime;
+    router->findAsync([this, funcs, alive] (std::future<std::shared_ptr<world::Route>> result) {
+        std::shared_ptr<world::Route> found;
+        std::string error;
+        try {
+            found = result.get();
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+        funcs->executeLater([this, alive, found, error] () {
+            if (!alive.expired()) {
+                onRouteSearched(found, error);
+            }
+        });
+    });
+}
+
+void RouteApp::showMatches(std::shared_ptr<TextArea> field, std::shared_ptr<Widget> above) {
+    matchLabel = std::make_shared<Label>(window, "");
+    matchLabel->alignBelow(above, 5);
+
+    // the field goes away with its page
+    std::weak_ptr<TextArea> weakField = field;
+    keys->setOnChange([this, weakField] () {
+        if (auto f = weakField.lock()) {
+            airportSearch.setQuery(api().getNavWorld(), f->getText());
+        }
+    });
+}
+
+void RouteApp::onMatchesFound(const std::string &query, const AirportSearch::Results &airports) {
+    if (!matchLabel) {
+        return;
+    }
+
+    std::string text;
+    for (size_t i = 0; i < airports.size() && i < MAX_SHOWN_MATCHES; i++) {
+        text += airports[i]->getID() + " - " + airports[i]->getName() + "\n";
+    }
+    if (airports.size() > MAX_SHOWN_MATCHES) {
+        text += "...";
+    } else if (airports.empty() && !query.empty()) {
+        text = "No matching airports";
+    }
+    matchLabel->setText(text);
+}
+
+void RouteApp::showSearchPage() {
+    reset();
+    searching = true;
+
+    window->setCaption("Route Wizard - Searching");
+
+    label = std::make_shared<Label>(window, "");
+    label->setLongMode(true);
+    label->setDimensions(window->getContentWidth(), 60);
+    label->setTextFormatted("Searching route from %s to %s ...",
+            departureNode->getID().c_str(), arrivalNode->getID().c_str());
+    label->alignInTopLeft();
+
+    cancelButton = std::make_shared<Button>(window, "Cancel");
+    cancelButton->alignBelow(label);
+    cancelButton->setCallback([this] (const Button &) {
+        if (router) {
+            router->cancel();
+        }
     });
+}
 
-    try {
-        route = router->find();
+void RouteApp::onRouteSearched(std::shared_ptr<world::Route> found, const std::string &error) {
+    if (!searching) {
+        // the user has moved on to another page
+        return;
+    }
+
+    if (found) {
+        route = found;
         fromFMS = false;
         showRoute();
-    } catch (const std::exception &e) {
-        std::string error = std::string("Couldn't find a preliminary route, error: ") + e.what();
-        showError(error);
+    } else {
+        showArrivalPage();
+        showError(std::string("Couldn't find a preliminary route, error: ") + error);
     }
     api().setRoute(route);
 }
@@ -198,9 +314,113 @@ void RouteApp::showRoute() {
     label->setText(desc.str());
     label->setDimensions(window->getContentWidth(), window->getHeight() - 40);
     label->alignBelow(loadContainer);
+
+    if (router && !fromFMS) {
+        divertButton = std::make_shared<Button>(loadContainer, "Divert");
+        divertButton->alignInTopRight();
+        divertButton->setCallback([this] (const Button &) {
+            api().executeLater([this] () {
+                showArrivalPage();
+                diverting = true;
+            });
+        });
+
+        alternativesButton = std::make_shared<Button>(loadContainer, "Alternatives");
+        alternativesButton->alignLeftOf(divertButton);
+        alternativesButton->setCallback([this] (const Button &) {
+            api().executeLater([this] () {
+                showSearchPage();
+                startAlternativesSearch();
+            });
+        });
+    }
+}
+
+void RouteApp::startAlternativesSearch() {
+    // like startSearch, the list is built on the router's thread and shown on the GUI thread
+    FuncsPtr funcs = &api();
+    std::weak_ptr<const void> alive = lifetime;
+    router->findAlternativesAsync(MAX_ALTERNATIVES,
+            [this, funcs, alive] (std::future<std::vector<world::RouteFinder::Alternative>> result) {
+        std::vector<std::shared_ptr<world::Route>> found;
+        std::vector<std::string> descriptions;
+        std::string error;
+        try {
+            for (auto &alternative: result.get()) {
+                std::stringstream desc;
+                desc << std::fixed << std::setprecision(0);
+                desc << alternative.route->getRouteDistance() / 1000 * world::KM_TO_NM << "nm,";
+                alternative.route->iterateRouteShort([&desc] (const std::shared_ptr<world::NavEdge> via,
+                        const std::shared_ptr<world::NavNode> to) {
+                    if (via && !via->isProcedure()) {
+                        desc << " " << via->getID();
+                    }
+                });
+                found.push_back(alternative.route);
+                descriptions.push_back(desc.str());
+            }
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+        funcs->executeLater([this, alive, found, descriptions, error] () {
+            if (!alive.expired()) {
+                onAlternativesSearched(found, descriptions, error);
+            }
+        });
+    });
+}
+
+void RouteApp::onAlternativesSearched(std::vector<std::shared_ptr<world::Route>> found,
+        std::vector<std::string> descriptions, const std::string &error) {
+    if (!searching) {
+        return;
+    }
+
+    if (found.empty()) {
+        showRoute();
+        showError(std::string("Couldn't find alternative routes, error: ") + error);
+        return;
+    }
+
+    reset();
+    alternatives = found;
+    window->setCaption("Route Wizard - Alternatives");
+
+    label = std::make_shared<Label>(window, "Shortest first, each one uses different airways:");
+    label->alignInTopLeft();
+
+    list = std::make_shared<DropDownList>(window, descriptions);
+    list->setDimensions(window->getContentWidth(), 40);
+    list->alignBelow(label, 10);
+
+    nextButton = std::make_shared<Button>(window, "Use");
+    nextButton->alignBelow(list, 10);
+    nextButton->setCallback([this] (const Button &) {
+        api().executeLater([this] () {
+            int index = list->getSelectedIndex();
+            if (index >= 0 && index < (int) alternatives.size()) {
+                route = alternatives[index];
+                api().setRoute(route);
+            }
+            alternatives.clear();
+            showRoute();
+        });
+    });
+
+    cancelButton = std::make_shared<Button>(window, "Back");
+    cancelButton->alignRightOf(nextButton, 10);
+    cancelButton->setCallback([this] (const Button &) {
+        api().executeLater([this] () {
+            alternatives.clear();
+            showRoute();
+        });
+    });
 }
 
 void RouteApp::reset() {
+    searching = false;
+    airportSearch.cancel();
+    matchLabel.reset();
     checkBox.reset();
     errorMessage.reset();
     list.reset();
@@ -210,6 +430,8 @@ void RouteApp::reset() {
     keys.reset();
     nextButton.reset();
     cancelButton.reset();
+    divertButton.reset();
+    alternativesButton.reset();
     loadButton.reset();
 }
 
@@ -356,4 +578,13 @@ void RouteApp::parseFMS(const std::string &fmsFilename) {
     api().setRoute(route);
 }
 
+RouteApp::~RouteApp() {
+    // waits for a running search, whose results are then dropped
+    lifetime.reset();
+    if (router) {
+        router->cancel();
+        router.reset();
+    }
+}
+
 } /* namespace avitab */
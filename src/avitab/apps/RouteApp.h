@@ -24,6 +24,7 @@
 #include "App.h"
 //#include "src/world/router/Route.h"
 #include "src/avitab/apps/components/FileChooser.h"
+#include "src/avitab/apps/components/AirportSearch.h"
 #include "src/gui_toolkit/widgets/TabGroup.h"
 #include "src/gui_toolkit/widgets/Page.h"
 #include "src/gui_toolkit/widgets/TextArea.h"
@@ -40,7 +41,13 @@ namespace avitab {
 class RouteApp: public App {
 public:
     RouteApp(FuncsPtr appFuncs);
+    ~RouteApp();
 private:
+    // a search that expands more nodes than this won't produce a useful route
+    static constexpr const size_t MAX_SEARCH_EXPANSIONS = 2000000;
+    static constexpr const size_t MAX_SHOWN_MATCHES = 4;
+    static constexpr const size_t MAX_ALTERNATIVES = 4;
+
     std::shared_ptr<Window> window;
     std::shared_ptr<Label> label;
     std::shared_ptr<TextArea> departureField, arrivalField;
@@ -49,14 +56,25 @@ private:
     std::shared_ptr<Keyboard> keys;
     std::shared_ptr<DropDownList> list;
     std::shared_ptr<MessageBox> errorMessage;
-    std::shared_ptr<Button> nextButton, cancelButton;
+    std::shared_ptr<Button> nextButton, cancelButton, divertButton, alternativesButton;
     std::shared_ptr<Checkbox> checkBox;
     std::unique_ptr<FileChooser> fileChooser;
+    // airports matching the code being typed, shown below the field
+    std::shared_ptr<Label> matchLabel;
+    AirportSearch airportSearch;
 
     world::AirwayLevel airwayLevel = world::AirwayLevel::UPPER;
     std::shared_ptr<world::NavNode> departureNode, arrivalNode;
     std::shared_ptr<world::Fix> departureFix, arrivalFix;
     std::shared_ptr<world::Route> route;
+    std::shared_ptr<world::RouteFinder> router;
+    // the routes offered on the alternatives page, shortest first
+    std::vector<std::shared_ptr<world::Route>> alternatives;
+    // expires with the app, results posted by the search are dropped once it has
+    std::shared_ptr<const void> lifetime = std::make_shared<int>(0);
+    bool searching = false;
+    // the arrival page picks a new arrival for the route being flown
+    bool diverting = false;
     std::string fmsText;
     bool fromFMS = false;
 
@@ -65,8 +83,17 @@ private:
 
     void showArrivalPage();
     void onArrivalEntered(const std::string &arrival);
+    void showMatches(std::shared_ptr<TextArea> field, std::shared_ptr<Widget> above);
+    void onMatchesFound(const std::string &query, const AirportSearch::Results &airports);
+
+    void showSearchPage();
+    void startSearch();
+    void onRouteSearched(std::shared_ptr<world::Route> found, const std::string &error);
 
     void showRoute();
+    void startAlternativesSearch();
+    void onAlternativesSearched(std::vector<std::shared_ptr<world::Route>> found,
+            std::vector<std::string> descriptions, const std::string &error);
 
     void reset();
     void showError(const std::string &msg);
@@ -42,9 +42,11 @@ YouTubeLiveApp::YouTubeLiveApp(FuncsPtr appFuncs):
 
 YouTubeLiveApp::~YouTubeLiveApp() {
     shuttingDown = true;
+    cancelDownload = true;
     stopAutoRefresh();
-    if (fetchThread.joinable()) {
-        fetchThread.join();
+    if (fetchJob) {
+        fetchJob->cancel();
+        fetchJob->wait();
     }
 }
 
@@ -205,11 +207,7 @@ void YouTubeLiveApp::triggerRefresh() {
         commentsList->add("Loading live chat messages...", -1);
     }
 
-    if (fetchThread.joinable()) {
-        fetchThread.join();
-    }
-
-    fetchThread = std::thread([this, apiKey, videoId]() {
+    fetchJob = platform::Executor::shared().submit("youtube", platform::Executor::Priority::NORMAL, [this, apiKey, videoId]() {
         runFetch(apiKey, videoId);
     });
 }
@@ -312,10 +310,9 @@ void YouTubeLiveApp::runFetch(const std::string &apiKey, const std::string &vide
 
 YouTubeLiveApp::LiveData YouTubeLiveApp::downloadLiveData(const std::string &apiKey, const std::string &videoId) {
     LiveData result;
-    bool cancel = false;
 
     std::string videosUrl = "https://www.googleapis.com/youtube/v3/videos?part=liveStreamingDetails&id=" + videoId + "&key=" + apiKey;
-    std::string videoResponse = httpClient.get(videosUrl, cancel);
+    std::string videoResponse = httpClient.get(videosUrl, cancelDownload);
 
     auto videoJson = nlohmann::json::parse(videoResponse);
     if (!videoJson.contains("items") || videoJson["items"].empty()) {
@@ -335,7 +332,7 @@ YouTubeLiveApp::LiveData YouTubeLiveApp::downloadLiveData(const std::string &api
         if (details.contains("activeLiveChatId")) {
             std::string chatId = details["activeLiveChatId"].get<std::string>();
             std::string chatUrl = "https://www.googleapis.com/youtube/v3/liveChat/messages?part=snippet,authorDetails&maxResults=" + std::to_string(kMaxComments) + "&liveChatId=" + chatId + "&key=" + apiKey;
-            std::string chatResponse = httpClient.get(chatUrl, cancel);
+            std::string chatResponse = httpClient.get(chatUrl, cancelDownload);
             auto chatJson = nlohmann::json::parse(chatResponse);
             if (chatJson.contains("items")) {
                 for (const auto &msg : chatJson["items"]) {
@@ -19,7 +19,6 @@
 
 #include <atomic>
 #include <string>
-#include <thread>
 #include <vector>
 #include <memory>
 #include "App.h"
@@ -31,6 +30,7 @@
 #include "src/gui_toolkit/widgets/Label.h"
 #include "src/gui_toolkit/widgets/List.h"
 #include "src/charts/RESTClient.h"
+#include "src/platform/Executor.h"
 
 namespace avitab {
 
@@ -73,7 +73,9 @@ private:
     std::shared_ptr<List> commentsList;
 
     std::unique_ptr<Timer> refreshTimer;
-    std::thread fetchThread;
+    std::shared_ptr<platform::Executor::Job> fetchJob;
+    // aborts a running download when the app is destroyed
+    bool cancelDownload = false;
     std::atomic<bool> requestInProgress{false};
     std::atomic<bool> autoRefreshEnabled{false};
     std::atomic<bool> shuttingDown{false};
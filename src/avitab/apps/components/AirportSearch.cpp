@@ -0,0 +1,137 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "AirportSearch.h"
+#include "src/platform/Platform.h"
+#include "src/Logger.h"
+
+namespace avitab {
+
+AirportSearch::AirportSearch(GUIPoster toGUI, ResultsCallback onResults):
+    toGUI(toGUI),
+    onResults(onResults)
+{
+    // one query at a time, the newest one is the only one that matters
+    platform::Executor::shared().setQueueLimit("airportsearch", 1);
+}
+
+void AirportSearch::setQuery(std::shared_ptr<world::World> world, const std::string &query) {
+    if (query == currentQuery && currentTicket) {
+        return;
+    }
+    submit(world, query, platform::Executor::Clock::now() + std::chrono::milliseconds(DEBOUNCE_MILLIS));
+}
+
+void AirportSearch::searchNow(std::shared_ptr<world::World> world, const std::string &query) {
+    submit(world, query, platform::Executor::Clock::now());
+}
+
+void AirportSearch::cancel() {
+    // expiring the ticket drops the results of a query that is already running
+    currentTicket.reset();
+    currentQuery.clear();
+    if (pendingJob) {
+        pendingJob->cancel();
+        pendingJob.reset();
+    }
+}
+
+void AirportSearch::submit(std::shared_ptr<world::World> world, const std::string &query, platform::Executor::Clock::time_point notBefore) {
+    cancel();
+
+    auto ticket = std::make_shared<int>(0);
+    currentTicket = ticket;
+    currentQuery = query;
+
+    Ticket weakTicket = ticket;
+    auto prev = previous;
+    auto post = toGUI;
+    auto cb = onResults;
+    pendingJob = platform::Executor::shared().submitAt("airportsearch", platform::Executor::Priority::INTERACTIVE, notBefore,
+            [world, query, prev, weakTicket, post, cb] { run(world, query, prev, weakTicket, post, cb); });
+}
+
+void AirportSearch::run(std::shared_ptr<world::World> world, const std::string &query, std::shared_ptr<Previous> previous,
+        Ticket ticket, GUIPoster toGUI, ResultsCallback onResults)
+{
+    // only saves the work of a query that was dropped, the results are checked again on the GUI thread
+    if (ticket.expired()) {
+        return;
+    }
+
+    Results results;
+    if (world && !query.empty()) {
+        bool refined;
+        {
+            std::lock_guard<std::mutex> lock(previous->mutex);
+            refined = (previous->world == world.get()) && refine(query, previous->query, previous->results, results);
+        }
+
+        if (!refined) {
+            try {
+                results = world->findAirport(query);
+            } catch (const std::exception &e) {
+                logger::warn("Airport search for '%s' failed: %s", query.c_str(), e.what());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(previous->mutex);
+        previous->world = world.get();
+        previous->query = query;
+        previous->results = results;
+    }
+
+    // the callback belongs to the owner of the search, so it's only touched there
+    toGUI([ticket, onResults, query, results] {
+        if (!ticket.expired()) {
+            onResults(query, results);
+        }
+    });
+}
+
+bool AirportSearch::refine(const std::string &query, const std::string &previousQuery, const Results &previousResults, Results &results) {
+    std::string key = platform::lower(query);
+    std::string previousKey = platform::lower(previousQuery);
+    if (previousKey.empty() || key.compare(0, previousKey.size(), previousKey) != 0) {
+        return false;
+    }
+    if (key == previousKey) {
+        results = previousResults;
+        return true;
+    }
+
+    // Word searches may match words in any order, so only single words are
+    // refined. Those matched the previous query, so a match of the longer one
+    // contains it in its ID or name.
+    if (key.find(' ') != std::string::npos || previousResults.size() >= world::World::MAX_SEARCH_RESULTS) {
+        return false;
+    }
+
+    for (auto &airport: previousResults) {
+        if (platform::lower(airport->getID()).find(key) != std::string::npos ||
+                platform::lower(airport->getName()).find(key) != std::string::npos) {
+            results.push_back(airport);
+        }
+    }
+    return true;
+}
+
+AirportSearch::~AirportSearch() {
+    cancel();
+}
+
+} /* namespace avitab */
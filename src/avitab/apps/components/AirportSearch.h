@@ -0,0 +1,83 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include "src/world/World.h"
+#include "src/platform/Executor.h"
+
+namespace avitab {
+
+/*
+ * Finds airports while the user types without blocking the GUI thread.
+ * A query runs in the background once the input paused for DEBOUNCE_MILLIS,
+ * a newer query cancels the older ones that haven't started and drops the
+ * results of those that did. A query that only appends to the previous one
+ * filters its results instead of asking the world again, unless those were
+ * cut off at World::MAX_SEARCH_RESULTS.
+ */
+class AirportSearch {
+public:
+    using Results = std::vector<std::shared_ptr<world::Airport>>;
+    // runs a function on the GUI thread later, called from a background thread
+    using GUIPoster = std::function<void(std::function<void()>)>;
+    // called on the GUI thread, only for the current query of a search that still exists
+    using ResultsCallback = std::function<void(const std::string &query, const Results &results)>;
+
+    static constexpr const int DEBOUNCE_MILLIS = 300;
+
+    AirportSearch(GUIPoster toGUI, ResultsCallback onResults);
+    ~AirportSearch();
+
+    // for every change of the input, repeated queries are ignored
+    void setQuery(std::shared_ptr<world::World> world, const std::string &query);
+    // without waiting for more input, e.g. when the input is confirmed
+    void searchNow(std::shared_ptr<world::World> world, const std::string &query);
+    void cancel();
+
+private:
+    // Identifies a query, expires when a newer one starts or the search is destroyed.
+    // Only reliable on the GUI thread, then the search is alive as long as it hasn't expired.
+    using Ticket = std::weak_ptr<const void>;
+
+    // the last completed query, shared with the jobs that may outlive the search
+    struct Previous {
+        std::mutex mutex;
+        const world::World *world = nullptr;
+        std::string query;
+        Results results;
+    };
+
+    GUIPoster toGUI;
+    ResultsCallback onResults;
+    std::shared_ptr<Previous> previous = std::make_shared<Previous>();
+    std::shared_ptr<const void> currentTicket;
+    std::string currentQuery;
+    std::shared_ptr<platform::Executor::Job> pendingJob;
+
+    void submit(std::shared_ptr<world::World> world, const std::string &query, platform::Executor::Clock::time_point notBefore);
+    static void run(std::shared_ptr<world::World> world, const std::string &query, std::shared_ptr<Previous> previous,
+            Ticket ticket, GUIPoster toGUI, ResultsCallback onResults);
+    static bool refine(const std::string &query, const std::string &previousQuery, const Results &previousResults, Results &results);
+};
+
+} /* namespace avitab */
@@ -62,9 +62,33 @@ void FileChooser::show(std::shared_ptr<Container> parent) {
 
 void FileChooser::showDirectory() {
     window->setCaption(captionPrefix + fsBrowser.rtrimmed(56 - captionPrefix.size()));
-    currentEntries = fsBrowser.entries();
-    if (selectDirOnly) removeFiles();
+    currentEntries.clear();
     showCurrentEntries();
+    fsBrowser.listAsync([this] (FilesystemBrowser::Ticket ticket, std::vector<platform::DirEntry> entries, bool complete) {
+        api->executeLater([this, ticket, entries, complete] {
+            if (!ticket.expired()) {
+                onEntries(entries, complete);
+            }
+        });
+    });
+}
+
+void FileChooser::onEntries(const std::vector<platform::DirEntry> &entries, bool complete) {
+    if (complete) {
+        currentEntries = entries;
+        if (selectDirOnly) removeFiles();
+        showCurrentEntries();
+        return;
+    }
+
+    for (auto &entry: entries) {
+        if (selectDirOnly && !entry.isDirectory) {
+            continue;
+        }
+        Widget::Symbol smb = entry.isDirectory ? Window::Symbol::DIRECTORY : Window::Symbol::FILE;
+        list->add(entry.utf8Name, smb, currentEntries.size());
+        currentEntries.push_back(entry);
+    }
 }
 
 void FileChooser::removeFiles() {
@@ -60,6 +60,7 @@ private:
     std::vector<platform::DirEntry> currentEntries;
 
     void showDirectory();
+    void onEntries(const std::vector<platform::DirEntry> &entries, bool complete);
     void removeFiles();
     void showCurrentEntries();
     void onListSelect(int data);
@@ -58,8 +58,29 @@ void FileSelect::setFilterRegex(const std::string ext) {
 
 void FileSelect::showDirectory() {
     window->setCaption(captionPrefix + fsBrowser.rtrimmed(70 - captionPrefix.size()));
-    currentEntries = fsBrowser.entries();
+    currentEntries.clear();
     showCurrentEntries();
+    fsBrowser.listAsync([this] (FilesystemBrowser::Ticket ticket, std::vector<platform::DirEntry> entries, bool complete) {
+        api().executeLater([this, ticket, entries, complete] {
+            if (!ticket.expired()) {
+                onEntries(entries, complete);
+            }
+        });
+    });
+}
+
+void FileSelect::onEntries(const std::vector<platform::DirEntry> &entries, bool complete) {
+    if (complete) {
+        currentEntries = entries;
+        showCurrentEntries();
+        return;
+    }
+
+    for (auto &entry: entries) {
+        Widget::Symbol smb = entry.isDirectory ? Window::Symbol::DIRECTORY : Window::Symbol::FILE;
+        list->add(entry.utf8Name, smb, currentEntries.size());
+        currentEntries.push_back(entry);
+    }
 }
 
 void FileSelect::showCurrentEntries() {
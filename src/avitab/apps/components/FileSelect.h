@@ -50,6 +50,7 @@ private:
     std::vector<platform::DirEntry> currentEntries;
     SelectCallback selectCallback;
 
+    void onEntries(const std::vector<platform::DirEntry> &entries, bool complete);
     void showCurrentEntries();
     void onDown();
     void onUp();
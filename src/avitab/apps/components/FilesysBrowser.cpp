@@ -15,11 +15,28 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include "FilesysBrowser.h"
 #include "src/Logger.h"
 
 namespace avitab {
 
+namespace {
+
+struct CachedListing {
+    int64_t modTime;
+    uint64_t lastUsed;
+    std::vector<platform::DirEntry> entries; // unfiltered, sorted
+};
+
+std::mutex cacheMutex;
+std::map<std::string, CachedListing> listingCache;
+uint64_t cacheClock = 0;
+
+}
+
 FilesystemBrowser::FilesystemBrowser(const std::string &path) {
     try {
         cwd = platform::realPath(path);
@@ -39,6 +56,14 @@ FilesystemBrowser::FilesystemBrowser() {
     }
 }
 
+FilesystemBrowser::~FilesystemBrowser() {
+    currentTicket.reset();
+    for (auto &job: listers) {
+        job->cancel();
+        job->wait();
+    }
+}
+
 void FilesystemBrowser::goUp() {
     try {
         std::string up(platform::realPath(platform::parentPath(cwd)));
@@ -99,14 +124,14 @@ std::string FilesystemBrowser::rtrimmed(const size_t max) {
 }
 
 std::vector<platform::DirEntry> FilesystemBrowser::entries(bool applyFilter, bool sort) {
-    items.clear();
+    std::vector<platform::DirEntry> items;
     try {
         items = platform::readDirectory(cwd);
         if (applyFilter) {
-            filterEntries();
+            filterEntries(items, filterRegex);
         }
         if (sort) {
-            sortEntries();
+            sortEntries(items);
         }
     } catch (const std::exception &e) {
         logger::verbose("Couldn't read directory %s: %s", cwd.c_str(), e.what());
@@ -115,6 +140,111 @@ std::vector<platform::DirEntry> FilesystemBrowser::entries(bool applyFilter, boo
     return items;
 }
 
+void FilesystemBrowser::listAsync(EntriesCallback onEntries) {
+    // expiring the previous ticket makes its lister stop at the next entry
+    auto ticket = std::make_shared<int>(0);
+    currentTicket = ticket;
+
+    listers.erase(std::remove_if(listers.begin(), listers.end(), [] (const auto &job) {
+        return job->isDone();
+    }), listers.end());
+
+    std::string dir = cwd;
+    std::regex filter = filterRegex;
+    Ticket weakTicket = ticket;
+    listers.push_back(platform::Executor::shared().submit("fslist", platform::Executor::Priority::INTERACTIVE,
+            [dir, filter, weakTicket, onEntries] { list(dir, filter, weakTicket, onEntries); }));
+}
+
+void FilesystemBrowser::list(const std::string &dir, const std::regex &filter, Ticket ticket, EntriesCallback onEntries) {
+    std::vector<platform::DirEntry> items;
+    int64_t modTime = getModTime(dir);
+
+    if (!getCached(dir, modTime, items)) {
+        std::vector<platform::DirEntry> batch;
+        auto lastBatch = platform::measureTime();
+        bool readAll = false;
+        try {
+            platform::readDirectory(dir, [&] (const platform::DirEntry &entry) {
+                if (ticket.expired()) {
+                    return false;
+                }
+                items.push_back(entry);
+                batch.push_back(entry);
+                // slow directories show something quickly, fast ones don't flood the GUI
+                if (batch.size() >= BATCH_SIZE || platform::getElapsedMillis(lastBatch) >= 100) {
+                    filterEntries(batch, filter);
+                    if (!batch.empty()) {
+                        onEntries(ticket, std::move(batch), false);
+                    }
+                    batch.clear();
+                    lastBatch = platform::measureTime();
+                }
+                return true;
+            });
+            readAll = true;
+        } catch (const std::exception &e) {
+            logger::verbose("Couldn't read directory %s: %s", dir.c_str(), e.what());
+        }
+
+        if (ticket.expired()) {
+            return;
+        }
+
+        sortEntries(items);
+        if (readAll) {
+            putCached(dir, modTime, items);
+        }
+    }
+
+    filterEntries(items, filter);
+    onEntries(ticket, std::move(items), true);
+}
+
+int64_t FilesystemBrowser::getModTime(const std::string &dir) {
+    std::error_code ec;
+    auto modTime = fs::last_write_time(fs::u8path(dir), ec);
+    if (ec) {
+        return 0;
+    }
+    return modTime.time_since_epoch().count();
+}
+
+bool FilesystemBrowser::getCached(const std::string &dir, int64_t modTime, std::vector<platform::DirEntry> &items) {
+    if (modTime == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = listingCache.find(dir);
+    if (it == listingCache.end()) {
+        return false;
+    }
+    if (it->second.modTime != modTime) {
+        listingCache.erase(it);
+        return false;
+    }
+
+    it->second.lastUsed = ++cacheClock;
+    items = it->second.entries;
+    return true;
+}
+
+void FilesystemBrowser::putCached(const std::string &dir, int64_t modTime, const std::vector<platform::DirEntry> &items) {
+    if (modTime == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (listingCache.size() >= CACHED_DIRECTORIES && listingCache.find(dir) == listingCache.end()) {
+        auto oldest = std::min_element(listingCache.begin(), listingCache.end(), [] (const auto &a, const auto &b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        listingCache.erase(oldest);
+    }
+    listingCache[dir] = CachedListing { modTime, ++cacheClock, items };
+}
+
 bool FilesystemBrowser::validate(const std::string &path) {
     try {
         return platform::fileExists(path);
@@ -124,17 +254,17 @@ bool FilesystemBrowser::validate(const std::string &path) {
     return false;
 }
 
-void FilesystemBrowser::filterEntries() {
-    auto iter = std::remove_if(std::begin(items), std::end(items), [this] (const auto &a) -> bool {
+void FilesystemBrowser::filterEntries(std::vector<platform::DirEntry> &items, const std::regex &filter) {
+    auto iter = std::remove_if(std::begin(items), std::end(items), [&filter] (const auto &a) -> bool {
         if (a.isDirectory) {
             return false;
         }
-        return !std::regex_search(a.utf8Name, filterRegex);
+        return !std::regex_search(a.utf8Name, filter);
     });
     items.erase(iter, std::end(items));
 }
 
-void FilesystemBrowser::sortEntries() {
+void FilesystemBrowser::sortEntries(std::vector<platform::DirEntry> &items) {
     auto comparator = [] (const platform::DirEntry &a, const platform::DirEntry &b) -> bool {
         if (a.isDirectory && !b.isDirectory) {
             return true;
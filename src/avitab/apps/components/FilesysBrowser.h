@@ -21,7 +21,10 @@
 #include <vector>
 #include <string>
 #include <regex>
+#include <memory>
+#include <functional>
 #include "src/platform/Platform.h"
+#include "src/platform/Executor.h"
 
 namespace avitab {
 
@@ -29,6 +32,14 @@ class FilesystemBrowser {
 public:
     FilesystemBrowser(const std::string &path);
     FilesystemBrowser();
+    ~FilesystemBrowser();
+
+    // Identifies a listAsync call, expires when a newer one starts or the browser is destroyed.
+    // Only check it on the GUI thread, then the browser is alive as long as it hasn't expired.
+    using Ticket = std::weak_ptr<const void>;
+    // Called from a background thread. While reading, entries are the filtered entries read
+    // since the previous call. The last call has complete set and all entries, sorted.
+    using EntriesCallback = std::function<void(Ticket ticket, std::vector<platform::DirEntry> entries, bool complete)>;
 
     void goUp();
     void goDown(const std::string &sdir);
@@ -39,15 +50,28 @@ public:
     std::string path(bool addSeparator = true);
     std::string rtrimmed(const size_t max);
     std::vector<platform::DirEntry> entries(bool applyFilter = true, bool sort = true);
+    // Lists the current directory without blocking the caller. Unchanged directories
+    // are served from a cache shared by all browsers, validated by their modification time.
+    void listAsync(EntriesCallback onEntries);
 
 private:
+    // entries are delivered in batches of this size while reading
+    static constexpr const size_t BATCH_SIZE = 200;
+    static constexpr const size_t CACHED_DIRECTORIES = 32;
+
     bool validate(const std::string &path);
-    void filterEntries();
-    void sortEntries();
+    static void filterEntries(std::vector<platform::DirEntry> &items, const std::regex &filter);
+    static void sortEntries(std::vector<platform::DirEntry> &items);
+    static void list(const std::string &dir, const std::regex &filter, Ticket ticket, EntriesCallback onEntries);
+    static bool getCached(const std::string &dir, int64_t modTime, std::vector<platform::DirEntry> &items);
+    static void putCached(const std::string &dir, int64_t modTime, const std::vector<platform::DirEntry> &items);
+    static int64_t getModTime(const std::string &dir);
 
     std::string cwd;
     std::regex filterRegex;
-    std::vector<platform::DirEntry> items;
+
+    std::shared_ptr<const void> currentTicket;
+    std::vector<std::shared_ptr<platform::Executor::Job>> listers;
 };
 
 } /* namespace avitab */
@@ -21,12 +21,26 @@
 #include <functional>
 #include <future>
 #include <stdexcept>
+#include <string>
+#include <atomic>
+#include "src/platform/Executor.h"
 
 namespace apis {
 
 struct BaseCall {
+    // where the call runs, chosen by the service that created it
+    std::string lane;
+    platform::Executor::Priority priority = platform::Executor::Priority::NORMAL;
+
     virtual void exec() = 0;
+
+    // a call cancelled before it started is dropped without calling back
+    void cancel() { cancelled = true; }
+    bool isCancelled() const { return cancelled; }
+
     virtual ~BaseCall() = default;
+private:
+    std::atomic_bool cancelled { false };
 };
 
 template <typename Result>
@@ -44,6 +58,9 @@ public:
     }
 
     void exec() override {
+        if (isCancelled()) {
+            return;
+        }
         try {
             promise.set_value(runCb());
         } catch (const std::exception &e) {
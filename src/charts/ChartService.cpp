@@ -16,8 +16,12 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <array>
+#include <exception>
 #include "ChartService.h"
-#include "src/platform/CrashHandler.h"
+#include "src/platform/Executor.h"
+#include "src/platform/BandwidthScheduler.h"
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
 #include "src/charts/Crypto.h"
@@ -34,11 +38,17 @@ ChartService::ChartService(const std::string &programPath) {
     localFile= std::make_shared<localfile::LocalFileAPI>(programPath + "/charts/");
 
     keepAlive = true;
-    apiThread = std::make_unique<std::thread>(&ChartService::workLoop, this);
+    // the provider APIs keep state, so each runs one call at a time unless configured otherwise
+    setProviderConcurrency(Provider::NAVIGRAPH, 1);
+    setProviderConcurrency(Provider::CHARTFOX, 1);
+    setProviderConcurrency(Provider::LOCALFILE, 1);
 
     std::string calibrationPath = programPath + "/MapTiles/Mercator/Calibration";
+    fileHashes = std::make_unique<FileHashIndex>(calibrationPath + ".idx");
+    fileHashes->pruneMissing();
     if (platform::fileExists(calibrationPath)) {
         scanJsonFiles(calibrationPath);
+        fileHashes->store();
         logger::info(" Found %d calibration files", jsonFileHashes.size());
     } else {
         logger::info("Calibration folder does not exist at:");
@@ -56,6 +66,19 @@ void ChartService::setUseChartFox(bool use) {
     useChartFox = chartFox ? use : false;
 }
 
+void ChartService::setProviderConcurrency(Provider provider, size_t maxCalls) {
+    platform::Executor::shared().setQueueLimit(getLane(provider), maxCalls);
+}
+
+std::string ChartService::getLane(Provider provider) {
+    switch (provider) {
+    case Provider::NAVIGRAPH:   return "charts.navigraph";
+    case Provider::CHARTFOX:    return "charts.chartfox";
+    case Provider::LOCALFILE:   return "charts.localfile";
+    }
+    return EXECUTOR_QUEUE;
+}
+
 std::shared_ptr<navigraph::NavigraphAPI> ChartService::getNavigraph() {
     return navigraph;
 }
@@ -72,6 +95,7 @@ std::shared_ptr<APICall<bool>> ChartService::loginNavigraph() {
 
         return true;
     });
+    call->lane = getLane(Provider::NAVIGRAPH);
     return call;
 }
 
@@ -80,31 +104,72 @@ std::shared_ptr<APICall<bool>> ChartService::verifyChartFoxAccess() {
         if (chartFox) return chartFox->isAuthenticated();
         return false;
     });
+    call->lane = getLane(Provider::CHARTFOX);
     return call;
 }
 
 std::shared_ptr<APICall<ChartService::ChartList>> ChartService::getChartsFor(const std::string &icao) {
     auto call = std::make_shared<APICall<ChartList>>([this, icao] {
-        ChartList res;
+        // the providers are asked in parallel, each in its lane, so a slow one doesn't delay the others
+        std::array<ChartList, NUM_PROVIDERS> lists;
+        std::array<std::exception_ptr, NUM_PROVIDERS> errors;
+        std::vector<std::shared_ptr<platform::Executor::Job>> jobs;
+        auto request = [&lists, &errors, &jobs] (Provider provider, std::function<ChartList()> getCharts) {
+            size_t i = (size_t) provider;
+            jobs.push_back(platform::Executor::shared().submit(getLane(provider), platform::Executor::Priority::INTERACTIVE,
+                    [&lists, &errors, i, getCharts] {
+                try {
+                    lists[i] = getCharts();
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }));
+        };
 
-        if (useNavigraph && navigraph->hasChartsFor(icao)) {
-            auto charts = navigraph->getChartsFor(icao);
-            res.insert(res.end(), charts.begin(), charts.end());
+        // stored lists are shown right away, old ones are refreshed for the next request
+        if (useNavigraph) {
+            request(Provider::NAVIGRAPH, [this, icao] {
+                if (!navigraph->hasChartsFor(icao)) {
+                    return ChartList();
+                }
+                auto charts = navigraph->getChartsFor(icao);
+                if (navigraph->isListStale(icao)) {
+                    runLater(Provider::NAVIGRAPH, [this, icao] { navigraph->refreshChartsFor(icao); });
+                }
+                return charts;
+            });
         }
 
         if (useChartFox) {
-            auto charts = chartFox->getChartsFor(icao);
-            res.insert(res.end(), charts.begin(), charts.end());
+            request(Provider::CHARTFOX, [this, icao] {
+                auto charts = chartFox->getChartsFor(icao);
+                if (chartFox->isListStale(icao)) {
+                    runLater(Provider::CHARTFOX, [this, icao] { chartFox->refreshChartsFor(icao); });
+                }
+                return charts;
+            });
         }
 
         if (useLocalFile) {
-            auto charts = localFile->getChartsFor(icao);
-            res.insert(res.end(), charts.begin(), charts.end());
+            request(Provider::LOCALFILE, [this, icao] { return localFile->getChartsFor(icao); });
+        }
+
+        for (auto &job: jobs) {
+            job->wait();
         }
 
+        ChartList res;
+        for (size_t i = 0; i < NUM_PROVIDERS; i++) {
+            if (errors[i]) {
+                std::rethrow_exception(errors[i]);
+            }
+            res.insert(res.end(), lists[i].begin(), lists[i].end());
+        }
         return res;
     });
 
+    call->lane = EXECUTOR_QUEUE;
+    call->priority = platform::Executor::Priority::INTERACTIVE;
     return call;
 }
 
@@ -114,8 +179,7 @@ std::shared_ptr<APICall<std::shared_ptr<Chart>>> ChartService::loadChart(std::sh
         if (bgChart) {
             chartFox->loadChart(bgChart);
             auto blob = bgChart->getChartData();
-            auto in = std::string((char *)blob.data(), blob.size());
-            auto hash = crypto.sha256String(in);
+            auto hash = crypto.sha256String(blob->data(), blob->size());
             std::string localCalibrationMetadata = getCalibrationMetadataForHash(hash);
             if (localCalibrationMetadata != "") {
                 // Use local calibration metadata, overriding any Chartfox georef
@@ -138,6 +202,14 @@ std::shared_ptr<APICall<std::shared_ptr<Chart>>> ChartService::loadChart(std::sh
         return chart;
     });
 
+    if (std::dynamic_pointer_cast<chartfox::ChartFoxChart>(chart)) {
+        call->lane = getLane(Provider::CHARTFOX);
+    } else if (std::dynamic_pointer_cast<navigraph::NavigraphChart>(chart)) {
+        call->lane = getLane(Provider::NAVIGRAPH);
+    } else {
+        call->lane = getLane(Provider::LOCALFILE);
+    }
+    call->priority = platform::Executor::Priority::INTERACTIVE;
     return call;
 }
 
@@ -145,6 +217,7 @@ std::shared_ptr<APICall<std::string>> ChartService::getChartFoxDonationLink() {
     auto call = std::make_shared<APICall<std::string>>([this] {
         return chartFox->getDonationLink();
     });
+    call->lane = getLane(Provider::CHARTFOX);
 
     return call;
 }
@@ -154,57 +227,112 @@ void ChartService::submitCall(std::shared_ptr<BaseCall> call) {
     if (!keepAlive) {
         return;
     }
-    pendingCalls.push_back(call);
-    workCondition.notify_one();
+
+    runningCalls.erase(std::remove_if(runningCalls.begin(), runningCalls.end(),
+            [] (const std::shared_ptr<platform::Executor::Job> &job) { return job->isDone(); }), runningCalls.end());
+    std::string lane = call->lane.empty() ? EXECUTOR_QUEUE : call->lane;
+    runningCalls.push_back(platform::Executor::shared().submit(lane, call->priority, [call] {
+        try {
+            call->exec();
+        } catch (const std::exception &e) {
+            logger::warn("Oof! Uncaught exception in charts API: %s", e.what());
+        }
+    }));
 }
 
-bool ChartService::hasWork() {
-    // gets called with locked mutex
-    if (!keepAlive) {
-        return true;
+void ChartService::prefetchCharts(const std::string &departure, const std::string &destination) {
+    std::vector<std::string> airports;
+    for (auto &icao: {departure, destination}) {
+        if (!icao.empty() && std::find(airports.begin(), airports.end(), icao) == airports.end()) {
+            airports.push_back(icao);
+        }
     }
 
-    return !pendingCalls.empty();
-}
-
-void ChartService::workLoop() {
-    crash::ThreadCookie crashCookie;
+    for (auto &icao: airports) {
+        bool isDeparture = (icao == departure);
+        bool isDestination = (icao == destination);
 
-    while (keepAlive) {
-        using namespace std::chrono_literals;
+        // runs behind interactive calls in the provider's lane, limited so that a large airport doesn't pull all its charts
+        auto prefetch = [this, icao, isDeparture, isDestination] (ChartList charts, std::function<void(std::shared_ptr<Chart>)> fetch) {
+            size_t count = 0;
+            for (auto &chart: charts) {
+                if (!keepAlive || count >= MAX_PREFETCH_CHARTS) {
+                    break;
+                }
+                if (!shouldPrefetch(*chart, isDeparture, isDestination)) {
+                    continue;
+                }
+                try {
+                    fetch(chart);
+                } catch (const std::exception &e) {
+                    logger::warn("Couldn't prefetch chart %s of %s: %s", chart->getIndex().c_str(), icao.c_str(), e.what());
+                }
+                count++;
+            }
+            logger::verbose("Prefetched %d charts for %s", (int) count, icao.c_str());
+        };
 
-        std::unique_lock<std::mutex> lock(mutex);
-        workCondition.wait_for(lock, std::chrono::seconds(1), [this] () { return hasWork(); });
+        if (useNavigraph) {
+            runLater(Provider::NAVIGRAPH, [this, icao, prefetch] {
+                if (!navigraph->hasChartsFor(icao)) {
+                    return;
+                }
+                if (navigraph->isListStale(icao)) {
+                    navigraph->refreshChartsFor(icao);
+                }
+                prefetch(navigraph->getChartsFor(icao), [this] (std::shared_ptr<Chart> chart) {
+                    navigraph->prefetchChartImages(std::dynamic_pointer_cast<navigraph::NavigraphChart>(chart));
+                });
+            });
+        }
 
-        if (!keepAlive) {
-            break;
+        if (useChartFox) {
+            runLater(Provider::CHARTFOX, [this, icao, prefetch] {
+                if (chartFox->isListStale(icao)) {
+                    chartFox->refreshChartsFor(icao);
+                }
+                prefetch(chartFox->getChartsFor(icao), [this] (std::shared_ptr<Chart> chart) {
+                    chartFox->prefetchChart(std::dynamic_pointer_cast<chartfox::ChartFoxChart>(chart));
+                });
+            });
         }
+    }
+}
 
-        // create copy to work on while locked so we can work unlocked
-        std::vector<std::shared_ptr<BaseCall>> callsCopy;
-        std::swap(callsCopy, pendingCalls);
-        lock.unlock();
+bool ChartService::shouldPrefetch(const Chart &chart, bool departure, bool destination) {
+    // the charts don't tell their runways, so the categories used on the ground and in the terminal area are taken
+    switch (chart.getCategory()) {
+    case ChartCategory::APT: return true;
+    case ChartCategory::DEP: return departure;
+    case ChartCategory::ARR: return destination;
+    case ChartCategory::APP: return destination;
+    default:                 return false;
+    }
+}
 
-        for (auto call: callsCopy) {
-            try {
-                call->exec();
-            } catch (const std::exception &e) {
-                logger::warn("Oof! Uncaught exception in charts API: %s", e.what());
-            }
-        }
+void ChartService::runLater(Provider provider, std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!keepAlive) {
+        return;
     }
+    runningCalls.push_back(platform::Executor::shared().submit(getLane(provider), platform::Executor::Priority::BACKGROUND, [task] {
+        platform::BandwidthScheduler::Scope scope(platform::BandwidthScheduler::Traffic::BACKGROUND);
+        task();
+    }));
 }
 
 void ChartService::stop() {
-    if (apiThread) {
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            keepAlive = false;
-            pendingCalls.clear();
-            workCondition.notify_one();
-        }
-        apiThread->join();
-        apiThread.reset();
+    std::vector<std::shared_ptr<platform::Executor::Job>> calls;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keepAlive = false;
+        std::swap(calls, runningCalls);
+    }
+    for (auto &job: calls) {
+        job->cancel();
+    }
+    for (auto &job: calls) {
+        job->wait();
     }
 }
 
@@ -216,14 +344,23 @@ void ChartService::scanJsonFiles(std::string dir) {
             // Recurse
             scanJsonFiles(fullPath);
         } else if (entry.utf8Name.find(".json") != std::string::npos) {
-            fs::ifstream jsonFile(fs::u8path(fullPath));
-            if (jsonFile.fail()) {
-                continue;
+            // unchanged files keep the hash found in them before, even if it is none
+            std::string hash;
+            if (!fileHashes->lookup(fullPath, hash)) {
+                fs::ifstream jsonFile(fs::u8path(fullPath));
+                if (jsonFile.fail()) {
+                    continue;
+                }
+                std::string jsonStr((std::istreambuf_iterator<char>(jsonFile)),
+                                     std::istreambuf_iterator<char>());
+                try {
+                    nlohmann::json json = nlohmann::json::parse(jsonStr);
+                    hash = json.value("/calibration/hash"_json_pointer, "");
+                } catch (const std::exception &e) {
+                    logger::warn("Invalid calibration file %s: %s", fullPath.c_str(), e.what());
+                }
+                fileHashes->update(fullPath, hash);
             }
-            std::string jsonStr((std::istreambuf_iterator<char>(jsonFile)),
-                                 std::istreambuf_iterator<char>());
-            nlohmann::json json = nlohmann::json::parse(jsonStr);
-            std::string hash = json.value("/calibration/hash"_json_pointer, "");
             if (hash.length() == 64) {
                 if (jsonFileHashes.count(hash) == 1) {
                     LOG_INFO(0, "Duplicate hash %s", hash.c_str());
@@ -237,7 +374,15 @@ void ChartService::scanJsonFiles(std::string dir) {
 }
 
 std::string ChartService::getCalibrationMetadataForFile(std::string utf8ChartFileName) const {
-    std::string hash = crypto.getFileSha256(utf8ChartFileName);
+    // hashing a large document takes a while, so it's only done again once the file changed
+    std::string hash;
+    if (!fileHashes->lookup(utf8ChartFileName, hash)) {
+        hash = crypto.getFileSha256(utf8ChartFileName);
+        if (hash.length() == 64) {
+            fileHashes->update(utf8ChartFileName, hash);
+            fileHashes->store();
+        }
+    }
     return getCalibrationMetadataForHash(hash);
 }
 
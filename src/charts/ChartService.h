@@ -19,13 +19,14 @@
 
 #include <vector>
 #include <memory>
-#include <thread>
 #include "APICall.h"
 #include "Chart.h"
 #include "src/charts/liblocalfile/LocalFileAPI.h"
 #include "src/charts/libnavigraph/NavigraphAPI.h"
 #include "src/charts/libchartfox/ChartFoxAPI.h"
 #include "src/charts/Crypto.h"
+#include "src/charts/FileHashIndex.h"
+#include "src/platform/Executor.h"
 
 namespace apis {
 
@@ -33,12 +34,20 @@ class ChartService {
 public:
     using ChartList = std::vector<std::shared_ptr<Chart>>;
 
+    enum class Provider {
+        NAVIGRAPH,
+        CHARTFOX,
+        LOCALFILE,
+    };
+
     ChartService(const std::string &programPath);
     ~ChartService();
 
     // synchronous calls
     void setUseNavigraph(bool use);
     void setUseChartFox(bool use);
+    // more than one call at a time only works for providers that don't share state between calls
+    void setProviderConcurrency(Provider provider, size_t maxCalls);
     void stop();
 
     // asynchronous calls
@@ -47,6 +56,8 @@ public:
     std::shared_ptr<APICall<ChartList>> getChartsFor(const std::string &icao);
     std::shared_ptr<APICall<std::shared_ptr<Chart>>> loadChart(std::shared_ptr<Chart> chart);
     std::shared_ptr<APICall<std::string>> getChartFoxDonationLink();
+    // fetches the lists and the most used charts of a flight's airports in the background
+    void prefetchCharts(const std::string &departure, const std::string &destination);
 
     // state
     std::shared_ptr<navigraph::NavigraphAPI> getNavigraph();
@@ -65,19 +76,24 @@ private:
     bool useChartFox = false;
     bool useLocalFile = true;
 
+    // calls that aren't bound to a provider, they don't limit each other
+    static constexpr const char *EXECUTOR_QUEUE = "charts";
+    static constexpr const size_t NUM_PROVIDERS = 3;
+    static constexpr const size_t MAX_PREFETCH_CHARTS = 12;
+
     std::mutex mutex;
-    std::condition_variable workCondition;
     std::atomic_bool keepAlive { false };
-    std::unique_ptr<std::thread> apiThread;
-    std::vector<std::shared_ptr<BaseCall>> pendingCalls;
+    std::vector<std::shared_ptr<platform::Executor::Job>> runningCalls;
 
     Crypto crypto;
     std::map<std::string, std::string> jsonFileHashes;
+    // content hashes of calibration files and charts by path, size and modification time
+    std::unique_ptr<FileHashIndex> fileHashes;
 
     void scanJsonFiles(std::string dir);
-
-    bool hasWork();
-    void workLoop();
+    static std::string getLane(Provider provider);
+    void runLater(Provider provider, std::function<void()> task);
+    static bool shouldPrefetch(const Chart &chart, bool departure, bool destination);
 };
 
 } // namespace apis
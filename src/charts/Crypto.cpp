@@ -21,12 +21,11 @@
 #include <mbedtls/md.h>
 #include <mbedtls/rsa.h>
 #include <stdexcept>
-#include <iomanip>
 #include <fstream>
 #include <memory>
-#include <sstream>
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
 #include "Crypto.h"
 
 namespace apis {
@@ -56,6 +55,10 @@ std::vector<uint8_t> Crypto::generateRandom(size_t len) {
 }
 
 std::vector<uint8_t> Crypto::sha256(const std::string& in) const {
+    return sha256((const uint8_t *) in.data(), in.size());
+}
+
+std::vector<uint8_t> Crypto::sha256(const uint8_t *data, size_t len) const {
     const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
     if (!info) {
         throw std::runtime_error("Couldn't find SHA256");
@@ -64,18 +67,27 @@ std::vector<uint8_t> Crypto::sha256(const std::string& in) const {
     size_t size = mbedtls_md_get_size(info);
 
     std::vector<uint8_t> hash(size);
-    mbedtls_md(info, (uint8_t *) in.data(), in.size(), hash.data());
+    mbedtls_md(info, data, len, hash.data());
 
     return hash;
 }
 
 std::string Crypto::sha256String(const std::string& in) const {
-    auto hash = sha256(in);
-    std::ostringstream buffer;
-    buffer << std::hex << std::setfill('0');
-    for(int i : hash)
-        buffer << std::setw(2) << i;
-    return buffer.str();
+    return sha256String((const uint8_t *) in.data(), in.size());
+}
+
+std::string Crypto::sha256String(const uint8_t *data, size_t len) const {
+    return toHex(sha256(data, len));
+}
+
+std::string Crypto::toHex(const std::vector<uint8_t> &in) {
+    static const char digits[] = "0123456789abcdef";
+    std::string res(in.size() * 2, '0');
+    for (size_t i = 0; i < in.size(); i++) {
+        res[2 * i] = digits[in[i] >> 4];
+        res[2 * i + 1] = digits[in[i] & 0x0F];
+    }
+    return res;
 }
 
 std::string Crypto::urlEncode(const std::string& in) {
@@ -203,20 +215,34 @@ std::string Crypto::aesDecrypt(const std::string& in, const std::string& key) {
 }
 
 std::string Crypto::getFileSha256(const std::string &utf8Path) const {
-    fs::ifstream ifs (utf8Path, std::ios::in|std::ios::binary|std::ios::ate);
-    if (!ifs.is_open()) {
+    try {
+        // hashing large documents shouldn't need a copy of them
+        platform::MappedFile file(utf8Path);
+        const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+        if (!info) {
+            throw std::runtime_error("Couldn't find SHA256");
+        }
+
+        // fed in chunks so that the mapping's read-ahead stays just ahead of the hash
+        mbedtls_md_context_t ctx;
+        mbedtls_md_init(&ctx);
+        std::vector<uint8_t> hash(mbedtls_md_get_size(info));
+        int err = mbedtls_md_setup(&ctx, info, 0);
+        err = err ? err : mbedtls_md_starts(&ctx);
+        const uint8_t *data = (const uint8_t *) file.data();
+        for (size_t pos = 0; !err && pos < file.size(); pos += FILE_HASH_CHUNK) {
+            err = mbedtls_md_update(&ctx, data + pos, std::min(FILE_HASH_CHUNK, file.size() - pos));
+        }
+        err = err ? err : mbedtls_md_finish(&ctx, hash.data());
+        mbedtls_md_free(&ctx);
+        if (err) {
+            throw std::runtime_error("Hash error");
+        }
+        return toHex(hash);
+    } catch (const std::exception &e) {
         LOG_ERROR("Unable to open file '%s'", utf8Path.c_str());
         return "No file !";
     }
-
-    std::streampos size = ifs.tellg();
-    auto fileBytes = std::unique_ptr<char[]>(new char[size]);
-    ifs.seekg (0, std::ios::beg);
-    ifs.read (fileBytes.get(), size);
-    ifs.close();
-
-    auto hash = sha256String(std::string(fileBytes.get(), size));
-    return hash;
 }
 
 Crypto::~Crypto() {
@@ -32,7 +32,9 @@ class Crypto {
 public:
     Crypto();
     std::vector<uint8_t> sha256(const std::string &in) const;
+    std::vector<uint8_t> sha256(const uint8_t *data, size_t len) const;
     std::string sha256String(const std::string& in) const;
+    std::string sha256String(const uint8_t *data, size_t len) const;
     std::vector<uint8_t> generateRandom(size_t len);
     std::string urlEncode(const std::string &in);
     std::string base64URLEncode(const std::vector<uint8_t> &in);
@@ -42,8 +44,11 @@ public:
     std::string aesEncrypt(const std::string &in, const std::string &key);
     std::string aesDecrypt(const std::string &in, const std::string &key);
     std::string getFileSha256(const std::string &utf8Path) const;
+    static std::string toHex(const std::vector<uint8_t> &in);
     virtual ~Crypto();
 private:
+    static constexpr const size_t FILE_HASH_CHUNK = 1024 * 1024;
+
     mbedtls_aes_context aesCtx {};
     mbedtls_entropy_context entropySource {};
     mbedtls_ctr_drbg_context randomGenerator {};
@@ -0,0 +1,173 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <cstring>
+#include "FileHashIndex.h"
+#include "src/Logger.h"
+#include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
+
+namespace apis {
+
+FileHashIndex::FileHashIndex(const std::string &indexFile):
+    indexFile(indexFile)
+{
+    load();
+}
+
+bool FileHashIndex::lookup(const std::string &utf8Path, std::string &value) const {
+    uint64_t size;
+    int64_t modTime;
+    if (!getFileStamp(utf8Path, size, modTime)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(utf8Path);
+    if (it == entries.end() || it->second.size != size || it->second.modTime != modTime) {
+        return false;
+    }
+    value = it->second.value;
+    return true;
+}
+
+void FileHashIndex::update(const std::string &utf8Path, const std::string &value) {
+    uint64_t size;
+    int64_t modTime;
+    if (!getFileStamp(utf8Path, size, modTime)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[utf8Path] = Entry { size, modTime, value };
+    dirty = true;
+}
+
+void FileHashIndex::pruneMissing() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end(); ) {
+        if (platform::fileExists(it->first)) {
+            ++it;
+        } else {
+            it = entries.erase(it);
+            dirty = true;
+        }
+    }
+}
+
+bool FileHashIndex::getFileStamp(const std::string &utf8Path, uint64_t &size, int64_t &modTime) {
+    std::error_code ec;
+    fs::path path = fs::u8path(utf8Path);
+    size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    modTime = fs::last_write_time(path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+void FileHashIndex::load() {
+    if (!platform::fileExists(indexFile)) {
+        return;
+    }
+
+    try {
+        platform::MappedFile file(indexFile);
+        const char *pos = file.data();
+        const char *end = pos + file.size();
+
+        auto get = [&pos, end] (void *value, size_t len) {
+            if ((size_t) (end - pos) < len) {
+                throw std::runtime_error("Truncated index");
+            }
+            std::memcpy(value, pos, len);
+            pos += len;
+        };
+        auto getU32 = [&get] () {
+            uint32_t value;
+            get(&value, sizeof(value));
+            return value;
+        };
+        auto getString = [&getU32, &pos, end] () {
+            uint32_t len = getU32();
+            if ((size_t) (end - pos) < len) {
+                throw std::runtime_error("Truncated index");
+            }
+            std::string str(pos, len);
+            pos += len;
+            return str;
+        };
+
+        if (getU32() != FILE_MAGIC || getU32() != FILE_VERSION) {
+            throw std::runtime_error("Unknown index format");
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t count = getU32();
+        for (uint32_t i = 0; i < count; i++) {
+            std::string path = getString();
+            Entry entry;
+            get(&entry.size, sizeof(entry.size));
+            get(&entry.modTime, sizeof(entry.modTime));
+            entry.value = getString();
+            entries.emplace(std::move(path), std::move(entry));
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't load file index %s: %s", indexFile.c_str(), e.what());
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+    }
+}
+
+void FileHashIndex::store() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!dirty) {
+        return;
+    }
+
+    // a crash never leaves a truncated index behind
+    try {
+        platform::writeFileAtomically(indexFile, [this] (std::ostream &stream) {
+            auto put = [&stream] (const void *value, size_t len) {
+                stream.write(reinterpret_cast<const char *>(value), len);
+            };
+            auto putU32 = [&put] (uint32_t value) {
+                put(&value, sizeof(value));
+            };
+            auto putString = [&put, &putU32] (const std::string &str) {
+                putU32(str.size());
+                put(str.data(), str.size());
+            };
+
+            putU32(FILE_MAGIC);
+            putU32(FILE_VERSION);
+            putU32(entries.size());
+            for (auto &it: entries) {
+                putString(it.first);
+                put(&it.second.size, sizeof(it.second.size));
+                put(&it.second.modTime, sizeof(it.second.modTime));
+                putString(it.second.value);
+            }
+        });
+        dirty = false;
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't store file index %s: %s", indexFile.c_str(), e.what());
+    }
+}
+
+} // namespace apis
@@ -0,0 +1,62 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <mutex>
+
+namespace apis {
+
+// Persistent map from file paths to values derived from the files' content,
+// e.g. their hash. A value is only returned while the file's size and
+// modification time still match those seen when it was stored.
+class FileHashIndex {
+public:
+    explicit FileHashIndex(const std::string &indexFile);
+
+    bool lookup(const std::string &utf8Path, std::string &value) const;
+    void update(const std::string &utf8Path, const std::string &value);
+
+    // drops the entries of files that no longer exist
+    void pruneMissing();
+
+    // writes the index if it changed since it was loaded or last stored
+    void store();
+
+private:
+    static constexpr const uint32_t FILE_MAGIC = 0x58494843; // "CHIX"
+    static constexpr const uint32_t FILE_VERSION = 1;
+
+    struct Entry {
+        uint64_t size;
+        int64_t modTime;
+        std::string value;
+    };
+
+    std::string indexFile;
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    bool dirty = false;
+
+    void load();
+    static bool getFileStamp(const std::string &utf8Path, uint64_t &size, int64_t &modTime);
+};
+
+} // namespace apis
@@ -18,12 +18,58 @@
 #include <sstream>
 #include <stdexcept>
 #include <cstring>
+#include <array>
+#include <mutex>
 #include <curl/curl.h>
 #include "RESTClient.h"
+#include "RequestStats.h"
 #include "src/Logger.h"
 
 namespace apis {
 
+namespace {
+
+// DNS results, TLS sessions and open connections shared by all clients
+class CurlShare {
+public:
+    CurlShare() {
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, onLock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, onUnlock);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+
+    CURLSH *get() {
+        return share;
+    }
+
+    ~CurlShare() {
+        curl_share_cleanup(share);
+    }
+
+private:
+    CURLSH *share = nullptr;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> mutexes;
+
+    static void onLock(CURL *, curl_lock_data data, curl_lock_access, void *user) {
+        static_cast<CurlShare *>(user)->mutexes.at(data).lock();
+    }
+
+    static void onUnlock(CURL *, curl_lock_data data, void *user) {
+        static_cast<CurlShare *>(user)->mutexes.at(data).unlock();
+    }
+};
+
+}
+
+CURLSH *RESTClient::getShare() {
+    static CurlShare share;
+    return share.get();
+}
+
 HTTPException::HTTPException(int status) {
     this->status = status;
     errorString = std::string("HTTP status ") + std::to_string(status);
@@ -37,6 +83,12 @@ int HTTPException::getStatusCode() const {
     return status;
 }
 
+RESTClient::~RESTClient() {
+    if (handle) {
+        curl_easy_cleanup(handle);
+    }
+}
+
 void RESTClient::setVerbose(bool verbose) {
     this->verbose = verbose;
 }
@@ -61,6 +113,25 @@ std::string RESTClient::get(const std::string& url, bool &cancel) {
 }
 
 std::vector<uint8_t> RESTClient::getBinary(const std::string& url, bool& cancel) {
+    sink = nullptr;
+    performGet(url, cancel);
+    LOG_VERBOSE(verbose, "HTTP request: Done, %d bytes", downloadBuf.size());
+    return std::move(downloadBuf);
+}
+
+void RESTClient::getStreamed(const std::string &url, bool &cancel, const DataSink &dataSink) {
+    sink = dataSink;
+    try {
+        performGet(url, cancel);
+    } catch (...) {
+        sink = nullptr;
+        throw;
+    }
+    sink = nullptr;
+    LOG_VERBOSE(verbose, "HTTP request: Done, streamed");
+}
+
+void RESTClient::performGet(const std::string &url, bool &cancel) {
     auto it = url.find('?');
     if (it != std::string::npos) {
         LOG_VERBOSE(verbose, "GET '%s'", url.substr(0, it).c_str());
@@ -71,6 +142,10 @@ std::vector<uint8_t> RESTClient::getBinary(const std::string& url, bool& cancel)
 
     CURL *curl = createCURL(url, cancel);
 
+    platform::BandwidthScheduler::Transfer transfer(platform::BandwidthScheduler::Traffic::CHART);
+    curl_easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE, (curl_off_t) transfer.getMaxSpeed());
+    bandwidth = &transfer;
+
     curl_slist *list = nullptr;
     if (!bearer.empty()) {
         list = curl_slist_append(list, std::string("Authorization: Bearer " + bearer).c_str());
@@ -85,6 +160,8 @@ std::vector<uint8_t> RESTClient::getBinary(const std::string& url, bool& cancel)
     }
 
     CURLcode code = curl_easy_perform(curl);
+    RequestStats::shared().recordTransfer(curl, code);
+    bandwidth = nullptr;
     bearer.clear();
     basicAuth.clear();
 
@@ -93,13 +170,17 @@ std::vector<uint8_t> RESTClient::getBinary(const std::string& url, bool& cancel)
         list = nullptr;
     }
 
+    if (sinkError) {
+        std::exception_ptr error = sinkError;
+        sinkError = nullptr;
+        std::rethrow_exception(error);
+    }
+
     if (code != CURLE_OK) {
         if (code == CURLE_ABORTED_BY_CALLBACK) {
-            curl_easy_cleanup(curl);
             logger::info("HTTP request: Cancelled");
             throw std::out_of_range("Cancelled");
         } else {
-            curl_easy_cleanup(curl);
             logger::warn("HTTP request: Error %s", curl_easy_strerror(code));
             throw std::runtime_error(std::string("GET_BIN error: ") + curl_easy_strerror(code));
         }
@@ -108,7 +189,6 @@ std::vector<uint8_t> RESTClient::getBinary(const std::string& url, bool& cancel)
     long httpStatus = 0;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpStatus);
     if (httpStatus != 200) {
-        curl_easy_cleanup(curl);
         logger::warn("HTTP request: Status %d", httpStatus);
         throw HTTPException(httpStatus);
     }
@@ -117,11 +197,6 @@ std::vector<uint8_t> RESTClient::getBinary(const std::string& url, bool& cancel)
     if (curl_easy_header(curl, "Content-Type", 0, CURLH_HEADER, -1, &h) == CURLHE_OK) {
         contentType = h->value;
     }
-
-    curl_easy_cleanup(curl);
-    LOG_VERBOSE(verbose, "HTTP request: Done, %d bytes", downloadBuf.size());
-
-    return downloadBuf;
 }
 
 std::string RESTClient::post(const std::string& url, const std::map<std::string, std::string> fields, bool& cancel) {
@@ -149,6 +224,7 @@ std::string RESTClient::post(const std::string& url, const std::map<std::string,
     curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, fieldStr.c_str());
 
     CURLcode code = curl_easy_perform(curl);
+    RequestStats::shared().recordTransfer(curl, code);
     basicAuth.clear();
     bearer.clear();
 
@@ -159,10 +235,8 @@ std::string RESTClient::post(const std::string& url, const std::map<std::string,
 
     if (code != CURLE_OK) {
         if (code == CURLE_ABORTED_BY_CALLBACK) {
-            curl_easy_cleanup(curl);
             throw std::out_of_range("Cancelled");
         } else {
-            curl_easy_cleanup(curl);
             throw std::runtime_error(std::string("POST error: ") + curl_easy_strerror(code));
         }
     }
@@ -201,12 +275,9 @@ std::string RESTClient::post(const std::string& url, const std::map<std::string,
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpStatus);
     std::string content = std::string((char *) downloadBuf.data(), downloadBuf.size());
     if (httpStatus != 200) {
-        curl_easy_cleanup(curl);
         throw HTTPException(httpStatus);
     }
 
-    curl_easy_cleanup(curl);
-
     return content;
 }
 
@@ -225,13 +296,12 @@ std::string RESTClient::getRedirect(const std::string& url, bool& cancel) {
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
 
     CURLcode code = curl_easy_perform(curl);
+    RequestStats::shared().recordTransfer(curl, code);
 
     if (code != CURLE_OK) {
         if (code == CURLE_ABORTED_BY_CALLBACK) {
-            curl_easy_cleanup(curl);
             throw std::out_of_range("Cancelled");
         } else {
-            curl_easy_cleanup(curl);
             throw std::runtime_error(std::string("GET_REDIRECT error: ") + curl_easy_strerror(code));
         }
     }
@@ -244,7 +314,6 @@ std::string RESTClient::getRedirect(const std::string& url, bool& cancel) {
         redirURL = redir;
     }
 
-    curl_easy_cleanup(curl);
     return redirURL;
 }
 
@@ -261,13 +330,12 @@ long RESTClient::head(const std::string& url, bool& cancel) {
     curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
 
     CURLcode code = curl_easy_perform(curl);
+    RequestStats::shared().recordTransfer(curl, code);
 
     if (code != CURLE_OK) {
         if (code == CURLE_ABORTED_BY_CALLBACK) {
-            curl_easy_cleanup(curl);
             throw std::out_of_range("Cancelled");
         } else {
-            curl_easy_cleanup(curl);
             throw std::runtime_error(std::string("HEAD error: ") + curl_easy_strerror(code));
         }
     }
@@ -275,16 +343,30 @@ long RESTClient::head(const std::string& url, bool& cancel) {
     long fileTime = -1;
     curl_easy_getinfo(curl, CURLINFO_FILETIME, &fileTime);
 
-    curl_easy_cleanup(curl);
-
     return fileTime;
 }
 
 CURL* RESTClient::createCURL(const std::string &url, bool &cancel) {
     cancel = false;
     downloadBuf.clear();
+    sinkError = nullptr;
+
+    // the handle is reused so that it can keep its connection open,
+    // only the cookies of the previous request are dropped
+    if (!handle) {
+        handle = curl_easy_init();
+        if (!handle) {
+            throw std::runtime_error("Couldn't create HTTP handle");
+        }
+    } else {
+        curl_easy_reset(handle);
+        curl_easy_setopt(handle, CURLOPT_COOKIELIST, "ALL");
+    }
 
-    CURL *curl = curl_easy_init();
+    CURL *curl = handle;
+    curl_easy_setopt(curl, CURLOPT_SHARE, getShare());
+    // only takes effect if curl was built with HTTP/2 support
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "AviTab " AVITAB_VERSION_STR);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
@@ -292,7 +374,7 @@ CURL* RESTClient::createCURL(const std::string &url, bool &cancel) {
     curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
     curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, onProgress);
     curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &cancel);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &downloadBuf);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) this);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, onData);
 
     if (!cookieJar.empty()) {
@@ -325,15 +407,41 @@ std::string RESTClient::toPOSTString(const std::map<std::string, std::string> fi
     return res.str();
 }
 
-size_t RESTClient::onData(void* buffer, size_t size, size_t nmemb, void* vecPtr) {
-    std::vector<uint8_t> *vec = reinterpret_cast<std::vector<uint8_t> *>(vecPtr);
-    if (!vec) {
+size_t RESTClient::onData(void* buffer, size_t size, size_t nmemb, void* clientPtr) {
+    RESTClient *client = reinterpret_cast<RESTClient *>(clientPtr);
+    if (!client) {
         return 0;
     }
-    size_t pos = vec->size();
-    vec->resize(pos + size * nmemb);
-    std::memcpy(vec->data() + pos, buffer, size * nmemb);
-    return size * nmemb;
+    size_t len = size * nmemb;
+    if (client->bandwidth) {
+        client->bandwidth->onReceived(len);
+    }
+
+    // error pages are kept in the buffer and never reach the sink
+    long httpStatus = 0;
+    curl_easy_getinfo(client->handle, CURLINFO_RESPONSE_CODE, &httpStatus);
+    if (client->sink && httpStatus == 200) {
+        try {
+            client->sink(reinterpret_cast<const uint8_t *>(buffer), len);
+        } catch (...) {
+            client->sinkError = std::current_exception();
+            return 0;
+        }
+        return len;
+    }
+
+    std::vector<uint8_t> &vec = client->downloadBuf;
+    if (vec.empty()) {
+        // avoids growing large responses step by step
+        curl_off_t length = -1;
+        if (curl_easy_getinfo(client->handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) == CURLE_OK && length > 0 && length <= MAX_PREALLOCATION) {
+            vec.reserve(length);
+        }
+    }
+    size_t pos = vec.size();
+    vec.resize(pos + len);
+    std::memcpy(vec.data() + pos, buffer, len);
+    return len;
 }
 
 int RESTClient::onProgress(void* client, curl_off_t dlTotal, curl_off_t dlNow, curl_off_t ulTotal, curl_off_t ulNow) {
@@ -22,8 +22,11 @@
 #include <cstdint>
 #include <string>
 #include <map>
+#include <functional>
+#include <exception>
 #include <stdexcept>
 #include <curl/curl.h>
+#include "src/platform/BandwidthScheduler.h"
 #undef MessageBox
 
 namespace apis {
@@ -44,12 +47,23 @@ private:
 
 class RESTClient {
 public:
+    // receives the body of a successful response in chunks as they arrive
+    using DataSink = std::function<void(const uint8_t *data, size_t size)>;
+
+    RESTClient() = default;
+    RESTClient(const RESTClient &other) = delete;
+    RESTClient &operator=(const RESTClient &other) = delete;
+    ~RESTClient();
+
     void setVerbose(bool verbose);
     void setReferrer(const std::string &ref);
     void setBasicAuth(const std::string &basic);
     void setBearer(const std::string &token);
     std::string get(const std::string &url, bool &cancel);
     std::vector<uint8_t> getBinary(const std::string &url, bool &cancel);
+    // like getBinary, but without keeping the body in memory. Exceptions thrown
+    // by the sink abort the transfer and are passed on to the caller.
+    void getStreamed(const std::string &url, bool &cancel, const DataSink &sink);
     std::string post(const std::string &url, const std::map<std::string, std::string> fields, bool &cancel);
     std::string getRedirect(const std::string &url, bool &cancel);
     long head(const std::string &Turl, bool &cancel);
@@ -58,15 +72,24 @@ public:
     std::map<std::string, std::string> getCookies() const;
 
 private:
+    // larger announced lengths aren't trusted for reserving the buffer
+    static constexpr const curl_off_t MAX_PREALLOCATION = 512 * 1024 * 1024;
+
     bool verbose = true;
     std::vector<uint8_t> downloadBuf;
+    DataSink sink;
+    platform::BandwidthScheduler::Transfer *bandwidth = nullptr;
+    std::exception_ptr sinkError;
     std::string contentType;
     std::map<std::string, std::string> cookieJar;
     std::string referrer;
     std::string bearer;
     std::string basicAuth;
+    CURL *handle = nullptr;
 
+    static CURLSH *getShare();
     CURL *createCURL(const std::string &url, bool &cancel);
+    void performGet(const std::string &url, bool &cancel);
     std::string toPOSTString(const std::map<std::string, std::string> fields);
 
     static size_t onData(void *buffer, size_t size, size_t nmemb, void *resPtr);
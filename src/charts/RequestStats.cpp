@@ -0,0 +1,182 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include "RequestStats.h"
+
+namespace apis {
+
+constexpr const std::array<int, 8> RequestStats::LATENCY_BUCKETS_MS;
+
+RequestStats &RequestStats::shared() {
+    static RequestStats stats;
+    return stats;
+}
+
+void RequestStats::recordTransfer(CURL *curl, CURLcode result) {
+    char *urlPtr = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &urlPtr);
+    std::string url = urlPtr ? urlPtr : "";
+
+    long status = 0;
+    curl_off_t bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+
+    // curl reports the phases as times since the start of the request
+    double dns = getTimeMs(curl, CURLINFO_NAMELOOKUP_TIME_T);
+    double connect = getTimeMs(curl, CURLINFO_CONNECT_TIME_T);
+    double tls = getTimeMs(curl, CURLINFO_APPCONNECT_TIME_T);
+    double firstByte = getTimeMs(curl, CURLINFO_STARTTRANSFER_TIME_T);
+    double total = getTimeMs(curl, CURLINFO_TOTAL_TIME_T);
+
+    bool failed = (result != CURLE_OK) || status >= 400;
+    if (result == CURLE_ABORTED_BY_CALLBACK) {
+        // cancelled by AviTab, says nothing about the server
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Endpoint &endpoint = endpoints[getHost(url)];
+    endpoint.requests++;
+    endpoint.bytes += bytes;
+    endpoint.statusCodes[result == CURLE_OK ? status : 0]++;
+    endpoint.dnsMs += dns;
+    endpoint.connectMs += std::max(0.0, connect - dns);
+    endpoint.tlsMs += (tls > 0) ? std::max(0.0, tls - connect) : 0;
+    endpoint.firstByteMs += firstByte;
+    endpoint.totalMs += total;
+
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS_MS.size() && total > LATENCY_BUCKETS_MS[bucket]) {
+        bucket++;
+    }
+    endpoint.latency[bucket]++;
+
+    if (failedUrlSet.erase(url) > 0) {
+        endpoint.retries++;
+        failedUrls.erase(std::find(failedUrls.begin(), failedUrls.end(), url));
+    }
+    if (failed) {
+        endpoint.failures++;
+        failedUrls.push_back(url);
+        failedUrlSet.insert(url);
+        if (failedUrls.size() > MAX_FAILED_URLS) {
+            failedUrlSet.erase(failedUrls.front());
+            failedUrls.pop_front();
+        }
+    }
+}
+
+void RequestStats::recordCacheLookup(const std::string &cache, bool hit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Cache &entry = caches[cache];
+    if (hit) {
+        entry.hits++;
+    } else {
+        entry.misses++;
+    }
+}
+
+std::map<std::string, RequestStats::Endpoint> RequestStats::getEndpoints() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return endpoints;
+}
+
+std::map<std::string, RequestStats::Cache> RequestStats::getCaches() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return caches;
+}
+
+void RequestStats::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    endpoints.clear();
+    caches.clear();
+    failedUrls.clear();
+    failedUrlSet.clear();
+}
+
+int RequestStats::Endpoint::latencyPercentileMs(double fraction) const {
+    uint64_t needed = (uint64_t) (fraction * requests + 0.5);
+    uint64_t count = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS_MS.size(); i++) {
+        count += latency[i];
+        if (count >= needed) {
+            return LATENCY_BUCKETS_MS[i];
+        }
+    }
+    return -1;
+}
+
+std::string RequestStats::formatReport() {
+    auto endpointsCopy = getEndpoints();
+    auto cachesCopy = getCaches();
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(0);
+    if (endpointsCopy.empty()) {
+        out << "No requests yet\n";
+    }
+    for (auto &it: endpointsCopy) {
+        const Endpoint &e = it.second;
+        double n = std::max<uint64_t>(1, e.requests);
+        out << it.first << ": " << e.requests << " requests, " << e.failures << " failed, "
+            << e.retries << " retried, " << (e.bytes / 1024) << " KiB\n";
+        out << "  avg ms: dns " << e.dnsMs / n << ", connect " << e.connectMs / n << ", tls " << e.tlsMs / n
+            << ", first byte " << e.firstByteMs / n << ", total " << e.totalMs / n << "\n";
+
+        auto percentile = [&e] (double fraction) {
+            int ms = e.latencyPercentileMs(fraction);
+            return (ms < 0 ? ">" + std::to_string(LATENCY_BUCKETS_MS.back()) : "<" + std::to_string(ms)) + " ms";
+        };
+        out << "  p50 " << percentile(0.5) << ", p95 " << percentile(0.95) << ", status";
+        for (auto &status: e.statusCodes) {
+            out << " " << (status.first ? std::to_string(status.first) : "error") << ": " << status.second;
+        }
+        out << "\n";
+    }
+
+    for (auto &it: cachesCopy) {
+        uint64_t lookups = it.second.hits + it.second.misses;
+        out << "Cache " << it.first << ": " << it.second.hits << "/" << lookups << " hits";
+        if (lookups > 0) {
+            out << " (" << (100.0 * it.second.hits / lookups) << "%)";
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+std::string RequestStats::getHost(const std::string &url) {
+    size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    size_t end = url.find_first_of("/?#", start);
+    std::string host = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    return host.empty() ? "unknown" : host;
+}
+
+double RequestStats::getTimeMs(CURL *curl, CURLINFO info) {
+    curl_off_t micros = 0;
+    if (curl_easy_getinfo(curl, info, &micros) != CURLE_OK) {
+        return 0;
+    }
+    return micros / 1000.0;
+}
+
+} // namespace apis
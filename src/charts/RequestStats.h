@@ -0,0 +1,84 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <array>
+#include <mutex>
+#include <curl/curl.h>
+
+namespace apis {
+
+// Timings, sizes and results of the HTTP requests per host and the hit ratio
+// of the response caches, to diagnose slow providers and tile servers.
+class RequestStats {
+public:
+    // upper bounds of the latency histogram's buckets, the last one is open
+    static constexpr const std::array<int, 8> LATENCY_BUCKETS_MS {{ 50, 100, 200, 500, 1000, 2000, 5000, 10000 }};
+
+    struct Endpoint {
+        uint64_t requests = 0;
+        uint64_t failures = 0;      // transfer errors and HTTP status >= 400
+        uint64_t retries = 0;       // requests for a URL that failed before
+        uint64_t bytes = 0;
+        // sums in milliseconds, divide by requests for the average
+        double dnsMs = 0, connectMs = 0, tlsMs = 0, firstByteMs = 0, totalMs = 0;
+        std::array<uint64_t, LATENCY_BUCKETS_MS.size() + 1> latency {};
+        std::map<long, uint64_t> statusCodes;   // 0 for transfer errors
+
+        // upper bound of the bucket that contains the given fraction of the requests
+        int latencyPercentileMs(double fraction) const;
+    };
+
+    struct Cache {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    static RequestStats &shared();
+
+    // called after a finished or failed transfer, takes the timings from the handle
+    void recordTransfer(CURL *curl, CURLcode result);
+    void recordCacheLookup(const std::string &cache, bool hit);
+
+    std::map<std::string, Endpoint> getEndpoints();
+    std::map<std::string, Cache> getCaches();
+    // multi-line text for display
+    std::string formatReport();
+    void reset();
+
+private:
+    static constexpr const size_t MAX_FAILED_URLS = 128;
+
+    std::mutex mutex;
+    std::map<std::string, Endpoint> endpoints;
+    std::map<std::string, Cache> caches;
+    // recently failed URLs to recognize retries, oldest first
+    std::deque<std::string> failedUrls;
+    std::set<std::string> failedUrlSet;
+
+    static std::string getHost(const std::string &url);
+    static double getTimeMs(CURL *curl, CURLINFO info);
+};
+
+} // namespace apis
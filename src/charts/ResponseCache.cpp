@@ -0,0 +1,152 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cctype>
+#include <cinttypes>
+#include <cstdio>
+#include "ResponseCache.h"
+#include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
+#include "src/Logger.h"
+#include "RequestStats.h"
+
+namespace apis {
+
+ResponseCache::ResponseCache(const std::string &directory, std::chrono::seconds maxAge):
+    directory(directory),
+    maxAge(maxAge)
+{
+    std::string trimmed = directory.substr(0, directory.find_last_not_of("/\\") + 1);
+    size_t sep = trimmed.find_last_of("/\\");
+    if (sep != std::string::npos && sep > 0) {
+        sep = trimmed.find_last_of("/\\", sep - 1);
+    }
+    statsName = (sep == std::string::npos) ? trimmed : trimmed.substr(sep + 1);
+
+    try {
+        platform::mkpath(directory);
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't create response cache %s: %s", directory.c_str(), e.what());
+    }
+}
+
+bool ResponseCache::contains(const std::string &key) const {
+    return platform::fileExists(getPath(key));
+}
+
+bool ResponseCache::load(const std::string &key, std::vector<uint8_t> &data, bool &stale) const {
+    std::string path = getPath(key);
+    std::error_code ec;
+    auto modified = fs::last_write_time(fs::u8path(path), ec);
+    if (ec) {
+        RequestStats::shared().recordCacheLookup(statsName, false);
+        return false;
+    }
+
+    try {
+        platform::MappedFile file(path);
+        data.assign(file.data(), file.data() + file.size());
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't read cached response %s: %s", path.c_str(), e.what());
+        RequestStats::shared().recordCacheLookup(statsName, false);
+        return false;
+    }
+    RequestStats::shared().recordCacheLookup(statsName, true);
+
+    stale = (fs::file_time_type::clock::now() - modified) > maxAge;
+    return true;
+}
+
+void ResponseCache::store(const std::string &key, const std::vector<uint8_t> &data) {
+    // readers never see a partial entry
+    std::string path = getPath(key);
+    try {
+        platform::writeFileAtomically(path, data.data(), data.size());
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't store response %s: %s", path.c_str(), e.what());
+    }
+}
+
+bool ResponseCache::storeStreamed(const std::string &key, const std::function<void(std::ostream &out)> &write) {
+    std::string path = getPath(key);
+    // errors of the producer are passed on, only failing to store is reported here
+    bool producerFailed = false;
+    try {
+        platform::writeFileAtomically(path, [&write, &producerFailed] (std::ostream &out) {
+            try {
+                write(out);
+            } catch (...) {
+                producerFailed = true;
+                throw;
+            }
+        });
+    } catch (...) {
+        if (producerFailed) {
+            throw;
+        }
+        logger::warn("Couldn't store response %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ResponseCache::prune(std::chrono::hours unusedFor) {
+    auto now = fs::file_time_type::clock::now();
+    size_t removed = 0;
+    try {
+        for (auto &entry: platform::readDirectory(directory)) {
+            if (entry.isDirectory) {
+                continue;
+            }
+            std::string path = directory + entry.utf8Name;
+            std::error_code ec;
+            auto modified = fs::last_write_time(fs::u8path(path), ec);
+            if (!ec && now - modified > unusedFor) {
+                platform::removeFile(path);
+                removed++;
+            }
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't prune response cache %s: %s", directory.c_str(), e.what());
+    }
+
+    if (removed > 0) {
+        logger::verbose("Removed %d old responses from %s", (int) removed, directory.c_str());
+    }
+}
+
+std::string ResponseCache::fingerprint(const std::string &text) {
+    // FNV-1a, only needs to tell revisions apart
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c: text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016" PRIx64, hash);
+    return buf;
+}
+
+std::string ResponseCache::getPath(const std::string &key) const {
+    std::string name;
+    for (char c: key) {
+        name += std::isalnum((unsigned char) c) || c == '-' || c == '.' ? c : '_';
+    }
+    return directory + name;
+}
+
+} // namespace apis
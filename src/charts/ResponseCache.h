@@ -0,0 +1,61 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <functional>
+
+namespace apis {
+
+/*
+ * Responses of the chart providers stored on disk by key, so that they can
+ * be shown right away and without a connection. Entries older than the
+ * given age are still returned, but marked as stale so that the caller can
+ * refresh them while the user already sees the stored ones.
+ */
+class ResponseCache {
+public:
+    ResponseCache(const std::string &directory, std::chrono::seconds maxAge);
+
+    bool contains(const std::string &key) const;
+    bool load(const std::string &key, std::vector<uint8_t> &data, bool &stale) const;
+    void store(const std::string &key, const std::vector<uint8_t> &data);
+    // for large entries that are written to the stream as they arrive, e.g. downloads.
+    // Exceptions of write are passed on, nothing is stored in that case.
+    bool storeStreamed(const std::string &key, const std::function<void(std::ostream &out)> &write);
+
+    // removes entries that weren't stored again for the given time
+    void prune(std::chrono::hours unusedFor);
+
+    // short id that changes with the text, e.g. for the revision of a chart's metadata
+    static std::string fingerprint(const std::string &text);
+
+private:
+    std::string directory;
+    std::chrono::seconds maxAge;
+    // the last two directory names, e.g. Navigraph/lists, for the request statistics
+    std::string statsName;
+
+    std::string getPath(const std::string &key) const;
+};
+
+} // namespace apis
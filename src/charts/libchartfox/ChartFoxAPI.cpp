@@ -33,11 +33,14 @@ bool ChartFoxAPI::isSupported() {
 
 ChartFoxAPI::ChartFoxAPI(const std::string &cacheDirectory):
     cacheDirectory(cacheDirectory),
-    oauth(std::make_shared<ChartFoxOAuth2Client>(CHARTFOX_CLIENT_ID))
+    oauth(std::make_shared<ChartFoxOAuth2Client>(CHARTFOX_CLIENT_ID)),
+    listCache(cacheDirectory + "lists/", std::chrono::hours(LIST_MAX_AGE_HOURS)),
+    chartCache(cacheDirectory + "charts/", std::chrono::hours(UNUSED_CHART_HOURS))
 {
     if (!platform::fileExists(cacheDirectory)) {
         platform::mkdir(cacheDirectory);
     }
+    chartCache.prune(std::chrono::hours(UNUSED_CHART_HOURS));
 
     oauth->setCacheDirectory(cacheDirectory);
 }
@@ -58,6 +61,8 @@ bool ChartFoxAPI::isAuthenticated() {
 
 void ChartFoxAPI::logout() {
     charts.clear();
+    staleLists.clear();
+    listCache.prune(std::chrono::hours(0));
     oauth->logout();
 }
 
@@ -101,82 +106,186 @@ ChartFoxAPI::ChartsList ChartFoxAPI::getChartsFor(const std::string& icao) {
         return res;
     }
 
-#if 1
-    // this version uses the grouped charts API
-    try {
-        std::string url = std::string("https://api.chartfox.org/v2/airports/") + icao + "/charts/grouped";
-        while (!url.empty()) {
-            std::string response = oauth->get(url);
-            nlohmann::json respJson = nlohmann::json::parse(response);
-            for (auto chartGroup: respJson.at("data")) {
-                int code = 1;
-                for (auto& chartJson: chartGroup.items()) {
-                    try {
-                        auto chart = std::make_shared<ChartFoxChart>(chartJson.value(), code);
-                        res.push_back(chart);
-                        charts.insert(std::make_pair(icao, chart));
-                        ++code;
-                    } catch (const std::exception &e) {
-                        logger::verbose("Ignoring chart: %s", e.what());
-                    }
-                }
-            }
-            try {
-                url = respJson.at("meta").at("next_page_url");
-            } catch (const std::exception &e) {
-                url.clear();
+    std::vector<uint8_t> stored;
+    bool stale = false;
+    if (listCache.load(icao, stored, stale)) {
+        try {
+            res = parseChartList(icao, std::string(stored.begin(), stored.end()));
+            if (stale) {
+                staleLists.insert(icao);
             }
+            return res;
+        } catch (const std::exception &e) {
+            logger::warn("Ignoring stored charts of %s: %s", icao.c_str(), e.what());
         }
+    }
+
+    try {
+        std::string content = fetchChartList(icao);
+        res = parseChartList(icao, content);
+        listCache.store(icao, std::vector<uint8_t>(content.begin(), content.end()));
     } catch (const std::exception &e) {
         logger::warn("Error fetching charts for %s: %s", icao.c_str(), e.what());
     }
-#else
-    // this version uses the non-grouped charts API
+
+    return res;
+}
+
+bool ChartFoxAPI::isListStale(const std::string &icao) const {
+    return staleLists.count(icao) > 0;
+}
+
+void ChartFoxAPI::refreshChartsFor(const std::string &icao) {
     try {
-        std::string url = std::string("https://api.chartfox.org/v2/airports/") + icao + "/charts";
-        while (!url.empty()) {
-            std::string response = oauth->get(url);
-            nlohmann::json respJson = nlohmann::json::parse(response);
-            for (auto chartJson: respJson.at("data")) {
-                auto chart = std::make_shared<ChartFoxChart>(chartJson);
-                res.push_back(chart);
-                charts.insert(std::make_pair(icao, chart));
-            }
-            try {
-                url = respJson.at("meta").at("next_page_url");
-            } catch (const std::exception &e) {
-                url.clear();
-            }
-        }
+        std::string content = fetchChartList(icao);
+        charts.erase(icao);
+        parseChartList(icao, content);
+        listCache.store(icao, std::vector<uint8_t>(content.begin(), content.end()));
+        staleLists.erase(icao);
     } catch (const std::exception &e) {
-        logger::warn("Error fetching charts for %s: %s", icao.c_str(), e.what());
+        logger::warn("Error refreshing charts for %s: %s", icao.c_str(), e.what());
+    }
+}
+
+std::string ChartFoxAPI::fetchChartList(const std::string &icao) {
+    // the chart groups of all pages of the grouped charts API
+    nlohmann::json pages = nlohmann::json::array();
+    std::string url = std::string("https://api.chartfox.org/v2/airports/") + icao + "/charts/grouped";
+    while (!url.empty()) {
+        std::string response = oauth->get(url);
+        nlohmann::json respJson = nlohmann::json::parse(response);
+        pages.push_back(respJson.at("data"));
+        try {
+            url = respJson.at("meta").at("next_page_url");
+        } catch (const std::exception &e) {
+            url.clear();
+        }
     }
-#endif
+    return pages.dump();
+}
 
+ChartFoxAPI::ChartsList ChartFoxAPI::parseChartList(const std::string &icao, const std::string &content) {
+    ChartsList res;
+    nlohmann::json pages = nlohmann::json::parse(content);
+    for (auto &page: pages) {
+        for (auto &chartGroup: page) {
+            int code = 1;
+            for (auto& chartJson: chartGroup.items()) {
+                try {
+                    auto chart = std::make_shared<ChartFoxChart>(chartJson.value(), code);
+                    res.push_back(chart);
+                    charts.insert(std::make_pair(icao, chart));
+                    ++code;
+                } catch (const std::exception &e) {
+                    logger::verbose("Ignoring chart: %s", e.what());
+                }
+            }
+        }
+    }
     return res;
 }
 
 void ChartFoxAPI::loadChart(std::shared_ptr<ChartFoxChart> chart) {
+    if (chart->getChartData() || loadStoredChart(chart)) {
+        return;
+    }
+
+    std::string chartUrl = getChartURL(chart);
+    if (chartUrl.empty()) {
+        return;
+    }
+
+    if (downloadChart(chart, chartUrl) && loadStoredChart(chart)) {
+        return;
+    }
+
+    // the store isn't writable, so the chart can only be kept in memory
+    auto blob = oauth->getBinary(chartUrl);
+    chart->setChartData(std::move(blob), oauth->getContentType(), chart->getCalibrationMetadata());
+}
+
+void ChartFoxAPI::prefetchChart(std::shared_ptr<ChartFoxChart> chart) {
+    if (chart->getChartData() || chartCache.contains(getChartKey(*chart) + ".json")) {
+        return;
+    }
+
+    std::string chartUrl = getChartURL(chart);
+    if (!chartUrl.empty()) {
+        downloadChart(chart, chartUrl);
+    }
+}
+
+std::string ChartFoxAPI::getChartURL(std::shared_ptr<ChartFoxChart> chart) {
     auto chartUrl = chart->getURL();
-    auto chartGeoref = chart->getCalibrationMetadata();
     if (chartUrl.empty()) {
         try {
             std::string url = std::string("https://api.chartfox.org/v2/charts/") + chart->getID();
             std::string response = oauth->get(url);
             nlohmann::json respJson = nlohmann::json::parse(response);
             chartUrl = encodeUrl(respJson.at("url"));
-            chartGeoref = nlohmann::to_string(respJson.at("georefs"));
+            std::string chartGeoref = nlohmann::to_string(respJson.at("georefs"));
             chart->setURL(chartUrl);
             chart->setCalibrationMetadata(chartGeoref);
             logger::info("georefs=%s", chartGeoref.c_str());
         } catch (const std::exception &e) {
             logger::warn("Unable to obtain URL for chart: %s, %s", chart->getICAO().c_str(), chart->getName().c_str());
-            return;
+            return "";
         }
     }
-    auto blob = oauth->getBinary(chartUrl);
-    auto type = oauth->getContentType();
-    chart->setChartData(blob, type, chartGeoref);
+    return chartUrl;
+}
+
+bool ChartFoxAPI::downloadChart(std::shared_ptr<ChartFoxChart> chart, const std::string &chartUrl) {
+    // chart documents can be large, so they go straight to the store instead of through memory
+    bool stored = chartCache.storeStreamed(getChartKey(*chart), [this, &chartUrl] (std::ostream &out) {
+        oauth->getStreamed(chartUrl, [&out] (const uint8_t *data, size_t size) {
+            out.write(reinterpret_cast<const char *>(data), size);
+            if (!out) {
+                throw std::runtime_error("Write error");
+            }
+        });
+    });
+    if (stored) {
+        storeChart(chart, oauth->getContentType());
+    }
+    return stored;
+}
+
+bool ChartFoxAPI::loadStoredChart(std::shared_ptr<ChartFoxChart> chart) {
+    std::string key = getChartKey(*chart);
+    std::vector<uint8_t> metaData, blob;
+    bool stale = false;
+    if (!chartCache.load(key + ".json", metaData, stale) || !chartCache.load(key, blob, stale)) {
+        return false;
+    }
+
+    try {
+        nlohmann::json meta = nlohmann::json::parse(metaData.begin(), metaData.end());
+        std::string georef = meta.at("georefs");
+        chart->setCalibrationMetadata(georef);
+        chart->setChartData(std::move(blob), meta.at("type"), georef);
+    } catch (const std::exception &e) {
+        logger::warn("Ignoring stored chart %s: %s", chart->getID().c_str(), e.what());
+        return false;
+    }
+    return true;
+}
+
+void ChartFoxAPI::storeChart(std::shared_ptr<ChartFoxChart> chart, const std::string &type) {
+    std::string key = getChartKey(*chart);
+    nlohmann::json meta = {
+        { "type", type },
+        { "georefs", chart->getCalibrationMetadata() },
+    };
+    std::string metaStr = meta.dump();
+
+    // stored after the document, it marks the entry as complete
+    chartCache.store(key + ".json", std::vector<uint8_t>(metaStr.begin(), metaStr.end()));
+}
+
+std::string ChartFoxAPI::getChartKey(const ChartFoxChart &chart) {
+    // a new revision of the chart is stored under a new key
+    return chart.getID() + "_" + chart.getRevision();
 }
 
 } /* namespace chartfox */
@@ -21,6 +21,7 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <set>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
@@ -28,6 +29,7 @@
 #include "src/libimg/Image.h"
 #include "src/libimg/TTFStamper.h"
 #include "src/charts/APICall.h"
+#include "src/charts/ResponseCache.h"
 #include "ChartFoxOAuth2Client.h"
 #include "ChartFoxChart.h"
 
@@ -47,18 +49,37 @@ public:
     void cancelAuth();
     void logout();
 
+    // stored lists are returned even if they are old, isListStale tells if they should be refreshed
     ChartsList getChartsFor(const std::string &icao);
+    bool isListStale(const std::string &icao) const;
+    void refreshChartsFor(const std::string &icao);
     void loadChart(std::shared_ptr<ChartFoxChart> chart);
+    // only downloads the chart into the store, without keeping it in memory
+    void prefetchChart(std::shared_ptr<ChartFoxChart> chart);
     std::string getDonationLink();
 
 private:
     std::string encodeUrl(std::string url);
 
 private:
+    static constexpr const int LIST_MAX_AGE_HOURS = 24;
+    static constexpr const int UNUSED_CHART_HOURS = 90 * 24;
+
     std::string cacheDirectory;
     std::shared_ptr<ChartFoxOAuth2Client> oauth;
 
     std::multimap<std::string, std::shared_ptr<ChartFoxChart>> charts;
+    // chart lists by airport and chart documents by revision
+    apis::ResponseCache listCache, chartCache;
+    std::set<std::string> staleLists;
+
+    std::string fetchChartList(const std::string &icao);
+    ChartsList parseChartList(const std::string &icao, const std::string &content);
+    bool loadStoredChart(std::shared_ptr<ChartFoxChart> chart);
+    std::string getChartURL(std::shared_ptr<ChartFoxChart> chart);
+    bool downloadChart(std::shared_ptr<ChartFoxChart> chart, const std::string &chartUrl);
+    void storeChart(std::shared_ptr<ChartFoxChart> chart, const std::string &type);
+    static std::string getChartKey(const ChartFoxChart &chart);
 };
 
 } /* namespace chartfox */
@@ -18,12 +18,14 @@
 #include <nlohmann/json.hpp>
 #include <sstream>
 #include "ChartFoxChart.h"
+#include "src/charts/ResponseCache.h"
 #include "src/maps/sources/DownloadedSource.h"
 #include "src/Logger.h"
 
 namespace chartfox {
 
 ChartFoxChart::ChartFoxChart(const nlohmann::json &json, int icode) {
+    revision = apis::ResponseCache::fingerprint(json.dump());
     icao = json.at("airport_icao");
     id = json.at("id");
     name = json.at("name");
@@ -78,6 +80,10 @@ std::string ChartFoxChart::getID() const {
     return id;
 }
 
+std::string ChartFoxChart::getRevision() const {
+    return revision;
+}
+
 void ChartFoxChart::setURL(const std::string u) {
     url = u;
 }
@@ -87,7 +93,7 @@ std::string ChartFoxChart::getURL() const {
 }
 
 std::shared_ptr<img::TileSource> ChartFoxChart::createTileSource(bool nightMode) {
-    if (chartData.empty()) {
+    if (!chartData || chartData->empty()) {
         throw std::runtime_error("Chart not loaded");
     }
 
@@ -105,13 +111,13 @@ void ChartFoxChart::changeNightMode(std::shared_ptr<img::TileSource> src, bool n
     docSource->setNightMode(nightMode);
 }
 
-void ChartFoxChart::setChartData(const std::vector<uint8_t> &blob, const std::string type, const std::string &georef) {
-    chartData = blob;
+void ChartFoxChart::setChartData(std::vector<uint8_t> &&blob, const std::string type, const std::string &georef) {
+    chartData = std::make_shared<const std::vector<uint8_t>>(std::move(blob));
     chartType = type;
     chartGeoref = georef;
 }
 
-const std::vector<uint8_t> ChartFoxChart::getChartData() const {
+std::shared_ptr<const std::vector<uint8_t>> ChartFoxChart::getChartData() const {
     return chartData;
 }
 
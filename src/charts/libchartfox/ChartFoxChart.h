@@ -41,21 +41,25 @@ public:
     std::string getCalibrationMetadata() const;
 
     std::string getID() const;
+    // changes whenever the chart's metadata changes
+    std::string getRevision() const;
 
     void setURL(const std::string url);
     std::string getURL() const;
 
-    void setChartData(const std::vector<uint8_t> &blob, const std::string type, const std::string &georef);
-    const std::vector<uint8_t> getChartData() const;
+    void setChartData(std::vector<uint8_t> &&blob, const std::string type, const std::string &georef);
+    // shared with the tile sources of the chart, nullptr until loaded
+    std::shared_ptr<const std::vector<uint8_t>> getChartData() const;
 
 private:
     std::string icao;
     std::string id;
+    std::string revision;
     std::string name;
     std::string code;
     apis::ChartCategory category;
     std::string url;
-    std::vector<uint8_t> chartData;
+    std::shared_ptr<const std::vector<uint8_t>> chartData;
     std::string chartType;
     std::string chartGeoref = "";
 };
@@ -169,6 +169,13 @@ std::vector<uint8_t> ChartFoxOAuth2Client::getBinary(const std::string& url)
     return res;
 }
 
+void ChartFoxOAuth2Client::getStreamed(const std::string& url, const apis::RESTClient::DataSink &sink)
+{
+    tryWithRelogin([this, &url, &sink] () {
+        restClient.getStreamed(url, restCancel, sink);
+    });
+}
+
 std::string ChartFoxOAuth2Client::getContentType() const
 {
     return restClient.getContentType();
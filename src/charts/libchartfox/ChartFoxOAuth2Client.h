@@ -47,6 +47,7 @@ public:
 
     std::string get(const std::string &url);
     std::vector<uint8_t> getBinary(const std::string &url);
+    void getStreamed(const std::string &url, const apis::RESTClient::DataSink &sink);
     std::string getContentType() const;
     long getTimestamp(const std::string &url);
 
@@ -23,13 +23,18 @@
 #include "LocalFileAPI.h"
 #include "src/charts/Crypto.h"
 #include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
 #include "src/Logger.h"
 
 namespace localfile {
 
 LocalFileAPI::LocalFileAPI(const std::string chartsPath) {
     this->chartsPath = chartsPath;
+    this->indexFile = chartsPath + "Charts.idx";
     this->filter = std::regex("\\.(pdf|png|jpeg|jpg|bmp)$", std::regex::icase);
+
+    builder = platform::Executor::shared().submit("localcharts", platform::Executor::Priority::BACKGROUND,
+            [this] { buildIndex(); });
 }
 
 bool LocalFileAPI::isSupported() {
@@ -40,31 +45,228 @@ std::vector<std::shared_ptr<apis::Chart>> LocalFileAPI::getChartsFor(const std::
     std::vector<std::shared_ptr<apis::Chart>> charts;
     std::string path = chartsPath + icao + "/";
 
-    if (!platform::fileExists(path)) {
+    Folder folder;
+    if (!getFolder(icao, folder)) {
         return charts;
     }
 
+    size_t idx = 1;
+    for (auto &file: folder.files) {
+        charts.push_back(std::make_shared<LocalFileChart>(path, file, icao, idx++));
+    }
+
+    return charts;
+}
+
+bool LocalFileAPI::getFolder(const std::string &icao, Folder &folder) {
+    // adding or removing a file changes the folder's modification time, so that's all that needs to be checked
+    std::string path = chartsPath + icao + "/";
+    int64_t modTime;
+    if (!getModTime(path, modTime)) {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        dirty |= (folders.erase(icao) > 0);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        auto it = folders.find(icao);
+        if (it != folders.end() && it->second.modTime == modTime) {
+            folder = it->second;
+            return true;
+        }
+    }
+
     try {
-        std::vector<platform::DirEntry> entries = platform::readDirectory(path);
-        size_t idx = 1;
+        folder = scanFolder(path, modTime);
+    } catch (const std::exception &e) {
+        logger::verbose("Couldn't get local charts for %s: %s", icao.c_str(), e.what());
+        return false;
+    }
 
-        std::sort(entries.begin(), entries.end(), [] (const platform::DirEntry &a, const platform::DirEntry &b) -> bool {
-            return a.utf8Name < b.utf8Name;
-        });
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        folders[icao] = folder;
+        dirty = true;
+    }
+    storeIndex();
+    return true;
+}
+
+LocalFileAPI::Folder LocalFileAPI::scanFolder(const std::string &path, int64_t modTime) {
+    Folder folder;
+    folder.modTime = modTime;
+    for (auto &item: platform::readDirectory(path)) {
+        if (!item.isDirectory && std::regex_search(item.utf8Name, filter)) {
+            folder.files.push_back(item.utf8Name);
+        }
+    }
+    std::sort(folder.files.begin(), folder.files.end());
+    return folder;
+}
+
+void LocalFileAPI::buildIndex() {
+    loadIndex();
+    if (!platform::fileExists(chartsPath)) {
+        return;
+    }
 
-        for (auto item: entries) {
-            if (item.isDirectory || !std::regex_search(item.utf8Name, filter)) {
+    size_t scanned = 0;
+    try {
+        std::vector<std::string> present;
+        for (auto &entry: platform::readDirectory(chartsPath)) {
+            if (stopBuilder) {
+                return;
+            }
+            if (!entry.isDirectory) {
+                continue;
+            }
+            present.push_back(entry.utf8Name);
+
+            int64_t modTime;
+            std::string path = chartsPath + entry.utf8Name + "/";
+            if (!getModTime(path, modTime)) {
                 continue;
             }
+            {
+                std::lock_guard<std::mutex> lock(indexMutex);
+                auto it = folders.find(entry.utf8Name);
+                if (it != folders.end() && it->second.modTime == modTime) {
+                    continue;
+                }
+            }
+
+            Folder folder = scanFolder(path, modTime);
+            std::lock_guard<std::mutex> lock(indexMutex);
+            folders[entry.utf8Name] = std::move(folder);
+            dirty = true;
+            scanned++;
+        }
+
+        std::sort(present.begin(), present.end());
+        std::lock_guard<std::mutex> lock(indexMutex);
+        for (auto it = folders.begin(); it != folders.end(); ) {
+            if (std::binary_search(present.begin(), present.end(), it->first)) {
+                ++it;
+            } else {
+                it = folders.erase(it);
+                dirty = true;
+            }
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't index local charts: %s", e.what());
+    }
+
+    logger::verbose("Indexed local charts, %d folders changed", (int) scanned);
+    storeIndex();
+}
+
+bool LocalFileAPI::getModTime(const std::string &utf8Path, int64_t &modTime) {
+    std::error_code ec;
+    fs::path path = fs::u8path(utf8Path);
+    if (!fs::is_directory(path, ec)) {
+        return false;
+    }
+    modTime = fs::last_write_time(path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+void LocalFileAPI::loadIndex() {
+    if (!platform::fileExists(indexFile)) {
+        return;
+    }
+
+    std::unordered_map<std::string, Folder> loaded;
+    try {
+        platform::MappedFile file(indexFile);
+        const char *pos = file.data();
+        const char *end = pos + file.size();
+
+        auto get = [&pos, end] (void *value, size_t len) {
+            if ((size_t) (end - pos) < len) {
+                throw std::runtime_error("Truncated index");
+            }
+            std::memcpy(value, pos, len);
+            pos += len;
+        };
+        auto getU32 = [&get] () {
+            uint32_t value;
+            get(&value, sizeof(value));
+            return value;
+        };
+        auto getString = [&getU32, &pos, end] () {
+            uint32_t len = getU32();
+            if ((size_t) (end - pos) < len) {
+                throw std::runtime_error("Truncated index");
+            }
+            std::string str(pos, len);
+            pos += len;
+            return str;
+        };
 
-            auto chart = std::make_shared<LocalFileChart>(path, item.utf8Name, icao, idx++);
-            charts.push_back(chart);
+        if (getU32() != FILE_MAGIC || getU32() != FILE_VERSION) {
+            throw std::runtime_error("Unknown index format");
+        }
+
+        uint32_t count = getU32();
+        for (uint32_t i = 0; i < count; i++) {
+            std::string icao = getString();
+            Folder folder;
+            get(&folder.modTime, sizeof(folder.modTime));
+            uint32_t fileCount = getU32();
+            for (uint32_t j = 0; j < fileCount; j++) {
+                folder.files.push_back(getString());
+            }
+            loaded.emplace(std::move(icao), std::move(folder));
         }
     } catch (const std::exception &e) {
-        logger::verbose("Couldn't get local charts for %s: %s", icao.c_str(), e.what());
+        logger::warn("Couldn't load local chart index %s: %s", indexFile.c_str(), e.what());
+        return;
     }
 
-    return charts;
+    // folders scanned by requests in the meantime are newer
+    std::lock_guard<std::mutex> lock(indexMutex);
+    for (auto &it: loaded) {
+        folders.insert(std::move(it));
+    }
+}
+
+void LocalFileAPI::storeIndex() {
+    std::lock_guard<std::mutex> lock(indexMutex);
+    if (!dirty) {
+        return;
+    }
+
+    // a crash never leaves a truncated index behind
+    try {
+        platform::writeFileAtomically(indexFile, [this] (std::ostream &stream) {
+            auto put = [&stream] (const void *value, size_t len) {
+                stream.write(reinterpret_cast<const char *>(value), len);
+            };
+            auto putU32 = [&put] (uint32_t value) {
+                put(&value, sizeof(value));
+            };
+            auto putString = [&put, &putU32] (const std::string &str) {
+                putU32(str.size());
+                put(str.data(), str.size());
+            };
+
+            putU32(FILE_MAGIC);
+            putU32(FILE_VERSION);
+            putU32(folders.size());
+            for (auto &it: folders) {
+                putString(it.first);
+                put(&it.second.modTime, sizeof(it.second.modTime));
+                putU32(it.second.files.size());
+                for (auto &name: it.second.files) {
+                    putString(name);
+                }
+            }
+        });
+        dirty = false;
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't store local chart index %s: %s", indexFile.c_str(), e.what());
+    }
 }
 
 void LocalFileAPI::loadChart(std::shared_ptr<LocalFileChart> chart) {
@@ -72,6 +274,9 @@ void LocalFileAPI::loadChart(std::shared_ptr<LocalFileChart> chart) {
 }
 
 LocalFileAPI::~LocalFileAPI() {
+    stopBuilder = true;
+    builder->cancel();
+    builder->wait();
 }
 
 } // namespace localfile
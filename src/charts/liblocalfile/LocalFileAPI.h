@@ -19,10 +19,16 @@
 #ifndef AVITAB_LOCALFILEAPI_H
 #define AVITAB_LOCALFILEAPI_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <regex>
 #include "LocalFileChart.h"
+#include "src/platform/Executor.h"
 
 namespace localfile {
 
@@ -37,8 +43,33 @@ public:
     void loadChart(std::shared_ptr<LocalFileChart> chart);
 
 private:
+    static constexpr const uint32_t FILE_MAGIC = 0x5849434c; // "LCIX"
+    static constexpr const uint32_t FILE_VERSION = 1;
+
+    // the chart files of an airport's folder, valid while the folder's modification time is unchanged
+    struct Folder {
+        int64_t modTime = 0;
+        std::vector<std::string> files;
+    };
+
     std::string chartsPath;
+    std::string indexFile;
     std::regex filter;
+
+    // the index is built in the background, requests for airports that
+    // aren't indexed yet scan their folder themselves
+    std::mutex indexMutex;
+    std::unordered_map<std::string, Folder> folders;
+    bool dirty = false;
+    std::atomic_bool stopBuilder { false };
+    std::shared_ptr<platform::Executor::Job> builder;
+
+    void buildIndex();
+    bool getFolder(const std::string &icao, Folder &folder);
+    Folder scanFolder(const std::string &path, int64_t modTime);
+    static bool getModTime(const std::string &utf8Path, int64_t &modTime);
+    void loadIndex();
+    void storeIndex();
 };
 
 } // namespace localfile
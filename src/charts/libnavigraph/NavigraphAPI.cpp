@@ -18,6 +18,7 @@
 #include <sstream>
 #include <iomanip>
 #include <chrono>
+#include <cstring>
 #include <nlohmann/json.hpp>
 #include "NavigraphAPI.h"
 #include "src/platform/Platform.h"
@@ -29,11 +30,15 @@ namespace navigraph {
 NavigraphAPI::NavigraphAPI(const std::string &cacheDirectory):
     cacheDirectory(cacheDirectory),
     oidc(std::make_shared<OIDCClient>("charts-avitab", NAVIGRAPH_CLIENT_SECRET)),
-    stamper("DejaVuSans.ttf")
+    stamper("DejaVuSans.ttf"),
+    listCache(cacheDirectory + "lists/", std::chrono::hours(LIST_MAX_AGE_HOURS)),
+    imageCache(cacheDirectory + "charts/", std::chrono::hours(UNUSED_IMAGE_HOURS)),
+    tileDownloader(MAX_TILE_DOWNLOADS, MAX_TILE_DOWNLOADS)
 {
     if (!platform::fileExists(cacheDirectory)) {
         platform::mkdir(cacheDirectory);
     }
+    imageCache.prune(std::chrono::hours(UNUSED_IMAGE_HOURS));
 
     oidc->setCacheDirectory(cacheDirectory);
 }
@@ -72,18 +77,25 @@ NavigraphAPI::ChartsList NavigraphAPI::getChartsFor(const std::string& icao) {
         return res;
     }
 
+    std::vector<uint8_t> stored;
+    bool stale = false;
+    if (listCache.load(icao, stored, stale)) {
+        try {
+            res = parseChartList(icao, std::string(stored.begin(), stored.end()));
+            if (stale) {
+                staleLists.insert(icao);
+            }
+            return res;
+        } catch (const std::exception &e) {
+            logger::warn("Ignoring stored charts of %s: %s", icao.c_str(), e.what());
+        }
+    }
+
     // not cached -> load
     try {
-        std::string url = std::string("https://charts.api.navigraph.com/1/airports/") + icao + "/signedurls/charts.json";
-        std::string signedUrl = oidc->get(url);
-        std::string content = oidc->get(signedUrl);
-
-        nlohmann::json chartData = nlohmann::json::parse(content);
-        for (auto chartJson: chartData.at("charts")) {
-            auto chart = std::make_shared<NavigraphChart>(chartJson);
-            res.push_back(chart);
-            charts.insert(std::make_pair(icao, chart));
-        }
+        std::string content = fetchChartList(icao);
+        res = parseChartList(icao, content);
+        listCache.store(icao, std::vector<uint8_t>(content.begin(), content.end()));
     } catch (const std::exception &e) {
         logger::warn("Error fetching charts: %s", e.what());
     }
@@ -91,6 +103,40 @@ NavigraphAPI::ChartsList NavigraphAPI::getChartsFor(const std::string& icao) {
     return res;
 }
 
+bool NavigraphAPI::isListStale(const std::string &icao) const {
+    return staleLists.count(icao) > 0;
+}
+
+void NavigraphAPI::refreshChartsFor(const std::string &icao) {
+    try {
+        std::string content = fetchChartList(icao);
+        charts.erase(icao);
+        parseChartList(icao, content);
+        listCache.store(icao, std::vector<uint8_t>(content.begin(), content.end()));
+        staleLists.erase(icao);
+    } catch (const std::exception &e) {
+        logger::warn("Error refreshing charts of %s: %s", icao.c_str(), e.what());
+    }
+}
+
+std::string NavigraphAPI::fetchChartList(const std::string &icao) {
+    std::string url = std::string("https://charts.api.navigraph.com/1/airports/") + icao + "/signedurls/charts.json";
+    std::string signedUrl = oidc->get(url);
+    return oidc->get(signedUrl);
+}
+
+NavigraphAPI::ChartsList NavigraphAPI::parseChartList(const std::string &icao, const std::string &content) {
+    ChartsList res;
+    nlohmann::json chartData = nlohmann::json::parse(content);
+    for (auto chartJson: chartData.at("charts")) {
+        res.push_back(std::make_shared<NavigraphChart>(chartJson));
+    }
+    for (auto &chart: res) {
+        charts.insert(std::make_pair(icao, std::static_pointer_cast<NavigraphChart>(chart)));
+    }
+    return res;
+}
+
 std::shared_ptr<apis::Chart> NavigraphAPI::loadChartImages(std::shared_ptr<NavigraphChart> chart) {
     if (chart->isLoaded()) {
         return chart;
@@ -101,18 +147,43 @@ std::shared_ptr<apis::Chart> NavigraphAPI::loadChartImages(std::shared_ptr<Navig
         throw std::runtime_error("Cannot access this chart in demo mode");
     }
 
-    std::string airportUrl = std::string("https://charts.api.navigraph.com/1/airports/") + icao + "/signedurls/";
-
-    auto imgDay = getChartImageFromURL(airportUrl + chart->getFileDay());
-    auto imgNight = getChartImageFromURL(airportUrl + chart->getFileNight());
+    auto imgDay = getChartImage(*chart, chart->getFileDay());
+    auto imgNight = getChartImage(*chart, chart->getFileNight());
     chart->attachImages(std::move(imgDay), std::move(imgNight));
 
     return chart;
 }
 
+void NavigraphAPI::prefetchChartImages(std::shared_ptr<NavigraphChart> chart) {
+    if (chart->isLoaded() || !canAccess(chart->getICAO())) {
+        return;
+    }
+
+    for (auto &file: {chart->getFileDay(), chart->getFileNight()}) {
+        std::string key = getImageKey(*chart, file);
+        if (imageCache.contains(key)) {
+            continue;
+        }
+        // not decoded here, so at least make sure it's not an error page
+        auto pngData = downloadChartImage(*chart, file);
+        if (pngData.size() < 8 || std::memcmp(pngData.data(), "\x89PNG", 4) != 0) {
+            throw std::runtime_error("Invalid chart image");
+        }
+        imageCache.store(key, pngData);
+    }
+}
+
 void NavigraphAPI::logout() {
     airportJson.reset();
     charts.clear();
+    staleLists.clear();
+    // the stored charts belong to the account
+    listCache.prune(std::chrono::hours(0));
+    imageCache.prune(std::chrono::hours(0));
+    {
+        std::lock_guard<std::mutex> lock(tileTokenMutex);
+        tileToken.clear();
+    }
     oidc->logout();
 }
 
@@ -195,26 +266,77 @@ bool NavigraphAPI::canAccess(const std::string& icao) {
     }
 }
 
-std::unique_ptr<img::Image> NavigraphAPI::getChartImageFromURL(const std::string &url) {
-    auto signedUrl = oidc->get(url);
-    std::vector<uint8_t> pngData = oidc->getBinary(signedUrl);
+std::unique_ptr<img::Image> NavigraphAPI::getChartImage(const NavigraphChart &chart, const std::string &file) {
+    std::string key = getImageKey(chart, file);
+    std::vector<uint8_t> pngData;
+    bool stale = false;
+    bool downloaded = false;
+    if (!imageCache.load(key, pngData, stale)) {
+        pngData = downloadChartImage(chart, file);
+        downloaded = true;
+    }
+
     auto img = std::make_unique<img::Image>();
     img->loadEncodedData(pngData, false);
     logger::verbose("Chart decoded, %dx%d px", img->getWidth(), img->getHeight());
     if (img->getWidth()  == 0 || img->getHeight() == 0) {
         throw std::runtime_error("Invalid chart image");
     }
+    if (downloaded) {
+        imageCache.store(key, pngData);
+    }
 
     stamper.applyStamp(*img, 270);
 
     return img;
 }
 
-std::unique_ptr<img::Image> NavigraphAPI::getTileFromURL(const std::string &url, bool &cancel) {
+std::vector<uint8_t> NavigraphAPI::downloadChartImage(const NavigraphChart &chart, const std::string &file) {
+    std::string url = std::string("https://charts.api.navigraph.com/1/airports/") + chart.getICAO() + "/signedurls/" + file;
+    auto signedUrl = oidc->get(url);
+    return oidc->getBinary(signedUrl);
+}
+
+std::string NavigraphAPI::getImageKey(const NavigraphChart &chart, const std::string &file) {
+    // a new revision of the chart is stored under a new key
+    return chart.getICAO() + "_" + chart.getRevision() + "_" + file;
+}
+
+std::unique_ptr<img::Image> NavigraphAPI::getTileFromURL(const std::string &url, std::atomic_bool &cancel) {
+    std::string token;
+    {
+        std::lock_guard<std::mutex> lock(tileTokenMutex);
+        if (tileToken.empty()) {
+            tileToken = oidc->getAccessToken();
+        }
+        token = tileToken;
+    }
+
+    std::vector<uint8_t> pngData;
+    try {
+        pngData = tileDownloader.download(url, cancel, nullptr, {"Authorization: Bearer " + token});
+    } catch (const maps::DownloadError &e) {
+        if (e.getHttpStatus() != 401 && e.getHttpStatus() != 403) {
+            throw;
+        }
+        {
+            std::lock_guard<std::mutex> lock(tileTokenMutex);
+            if (tileToken == token) {
+                logger::info("Access token for tiles expired, refreshing");
+                tileToken = oidc->getAccessToken(token);
+            }
+            token = tileToken;
+        }
+        pngData = tileDownloader.download(url, cancel, nullptr, {"Authorization: Bearer " + token});
+    }
+
     auto img = std::make_unique<img::Image>();
-    std::vector<uint8_t> pngData = oidc->getBinary(url, cancel);
     img->loadEncodedData(pngData, false);
     return img;
 }
 
+int NavigraphAPI::getMaxTileDownloads() const {
+    return MAX_TILE_DOWNLOADS;
+}
+
 } /* namespace navigraph */
@@ -22,13 +22,17 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <set>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <nlohmann/json_fwd.hpp>
 #include "src/libimg/Image.h"
 #include "src/libimg/TTFStamper.h"
 #include "src/charts/APICall.h"
+#include "src/charts/ResponseCache.h"
+#include "src/maps/MultiDownloader.h"
 #include "OIDCClient.h"
 #include "NavigraphChart.h"
 
@@ -52,11 +56,22 @@ public:
     bool hasChartsFor(const std::string &icao);
     void logout();
 
+    // stored lists are returned even if they are old, isListStale tells if they should be refreshed
     ChartsList getChartsFor(const std::string &icao);
+    bool isListStale(const std::string &icao) const;
+    void refreshChartsFor(const std::string &icao);
     std::shared_ptr<apis::Chart> loadChartImages(std::shared_ptr<NavigraphChart> chart);
-    std::unique_ptr<img::Image> getTileFromURL(const std::string &url, bool &cancel);
+    // only downloads the images into the store, without decoding them
+    void prefetchChartImages(std::shared_ptr<NavigraphChart> chart);
+    // can be called from multiple threads, throws maps::DownloadError on failures
+    std::unique_ptr<img::Image> getTileFromURL(const std::string &url, std::atomic_bool &cancel);
+    int getMaxTileDownloads() const;
 
 private:
+    static constexpr const int LIST_MAX_AGE_HOURS = 24;
+    static constexpr const int UNUSED_IMAGE_HOURS = 90 * 24;
+    static constexpr const int MAX_TILE_DOWNLOADS = 6;
+
     std::string cacheDirectory;
     std::shared_ptr<OIDCClient> oidc;
     std::shared_ptr<nlohmann::json> airportJson;
@@ -64,11 +79,23 @@ private:
     bool demoMode = true;
 
     std::multimap<std::string, std::shared_ptr<NavigraphChart>> charts;
+    // chart lists by airport and chart images by revision
+    apis::ResponseCache listCache, imageCache;
+    std::set<std::string> staleLists;
+
+    // tiles are loaded in parallel on shared connections, next to the charts' requests
+    maps::MultiDownloader tileDownloader;
+    std::mutex tileTokenMutex;
+    std::string tileToken;
 
     void loadAirports();
     bool hasChartsSubscription();
     bool canAccess(const std::string &icao);
-    std::unique_ptr<img::Image> getChartImageFromURL(const std::string &url);
+    std::string fetchChartList(const std::string &icao);
+    ChartsList parseChartList(const std::string &icao, const std::string &content);
+    std::unique_ptr<img::Image> getChartImage(const NavigraphChart &chart, const std::string &file);
+    std::vector<uint8_t> downloadChartImage(const NavigraphChart &chart, const std::string &file);
+    static std::string getImageKey(const NavigraphChart &chart, const std::string &file);
 };
 
 } /* namespace navigraph */
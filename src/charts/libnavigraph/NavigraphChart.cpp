@@ -17,12 +17,14 @@
  */
 #include <nlohmann/json.hpp>
 #include "NavigraphChart.h"
+#include "src/charts/ResponseCache.h"
 #include "src/maps/sources/ImageSource.h"
 #include "src/Logger.h"
 
 namespace navigraph {
 
 NavigraphChart::NavigraphChart(const nlohmann::json &json) {
+    revision = apis::ResponseCache::fingerprint(json.dump());
     fileDay = json.at("file_day");
     fileNight = json.at("file_night");
     icao = json.at("icao_airport_identifier");
@@ -55,6 +57,10 @@ NavigraphChart::NavigraphChart(const nlohmann::json &json) {
     }
 }
 
+std::string NavigraphChart::getRevision() const {
+    return revision;
+}
+
 std::string NavigraphChart::getICAO() const {
     return icao;
 }
@@ -50,6 +50,8 @@ public: // used by NavigraphAPI
     bool isLoaded() const;
     std::string getFileDay() const;
     std::string getFileNight() const;
+    // changes whenever the chart's metadata changes
+    std::string getRevision() const;
     void attachImages(std::shared_ptr<img::Image> day, std::shared_ptr<img::Image> night);
 
 private:
@@ -59,6 +61,7 @@ private:
     std::string section;
     std::string desc;
     std::string index;
+    std::string revision;
 
     std::shared_ptr<img::Image> imgDay, imgNight;
 
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <nlohmann/json.hpp>
@@ -66,7 +67,7 @@ bool OIDCClient::relogin() {
     } catch (const apis::HTTPException &e) {
         // token no longer valid
         logger::verbose("Refresh token no longer valid");
-        logout();
+        clearTokens();
         return false;
     }
 
@@ -79,6 +80,37 @@ bool OIDCClient::relogin() {
     return true;
 }
 
+bool OIDCClient::needsRelogin() const {
+    // called with locked requestMutex
+    return accessToken.empty() || platform::Executor::Clock::now() >= accessTokenExpiry;
+}
+
+void OIDCClient::scheduleRefresh(int expiresInSeconds) {
+    // called with locked requestMutex
+    accessTokenExpiry = platform::Executor::Clock::now() + std::chrono::seconds(expiresInSeconds);
+    if (refreshJob) {
+        refreshJob->cancel();
+        refreshJob.reset();
+    }
+    if (stopRefresh) {
+        return;
+    }
+
+    // short-lived tokens are renewed halfway through instead of over and over again
+    int margin = std::min(REFRESH_MARGIN_SECONDS, expiresInSeconds / 2);
+    auto refreshAt = accessTokenExpiry - std::chrono::seconds(margin);
+    std::string expiringToken = accessToken;
+    refreshJob = platform::Executor::shared().submitAt("navigraph.auth", platform::Executor::Priority::BACKGROUND, refreshAt,
+            [this, expiringToken] {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        // a request might have renewed it already
+        if (accessToken == expiringToken && !refreshToken.empty()) {
+            logger::verbose("Renewing access token before it expires");
+            relogin();
+        }
+    });
+}
+
 std::string OIDCClient::startAuth(AuthCallback cb) {
     onAuth = cb;
     authPort = server.start();
@@ -146,22 +178,26 @@ void OIDCClient::onAuthReply(const std::map<std::string, std::string> &authInfo)
     replyFields["code_verifier"] = verifier;
     replyFields["redirect_uri"] = std::string("http://127.0.0.1:") + std::to_string(authPort);
 
-    restClient.setBasicAuth(crypto.base64BasicAuthEncode(clientId, clientSecret));
-    std::string reply = restClient.post("https://identity.api.navigraph.com/connect/token", replyFields, cancelToken);
-    handleToken(reply, restClient.getCookies());
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        restClient.setBasicAuth(crypto.base64BasicAuthEncode(clientId, clientSecret));
+        std::string reply = restClient.post("https://identity.api.navigraph.com/connect/token", replyFields, cancelToken);
+        handleToken(reply, restClient.getCookies());
+    }
 
     server.stop();
     onAuth();
 }
 
 void OIDCClient::handleToken(const std::string& inputJson, const std::map<std::string, std::string> &cookies) {
-    // could be called from either thread
+    // could be called from either thread, always with locked requestMutex
 
     nlohmann::json data = nlohmann::json::parse(inputJson);
     idToken = data.at("id_token");
     accessToken = data.at("access_token");
     refreshToken = data.at("refresh_token");
     cookieJar = cookies;
+    scheduleRefresh(data.value("expires_in", 3600));
 
     logger::verbose("Checking phase 2 token");
     loadIDToken(false);
@@ -206,6 +242,16 @@ std::string OIDCClient::getAccountName() const {
 }
 
 void OIDCClient::logout() {
+    std::lock_guard<std::mutex> lock(requestMutex);
+    clearTokens();
+}
+
+void OIDCClient::clearTokens() {
+    // called with locked requestMutex
+    if (refreshJob) {
+        refreshJob->cancel();
+        refreshJob.reset();
+    }
     platform::removeFile(tokenFile);
     accessToken.clear();
     idToken.clear();
@@ -241,9 +287,22 @@ long OIDCClient::getTimestamp(const std::string& url) {
     return res;
 }
 
+std::string OIDCClient::getAccessToken(const std::string &rejectedToken) {
+    std::lock_guard<std::mutex> lock(requestMutex);
+    // another thread might have refreshed the rejected token already
+    if (needsRelogin() || accessToken == rejectedToken) {
+        if (!relogin()) {
+            throw LoginException();
+        }
+    }
+    return accessToken;
+}
+
 void OIDCClient::tryWithRelogin(std::function<void()> f) {
-    // no login yet -> try using the refresh token
-    if (accessToken.empty()) {
+    std::lock_guard<std::mutex> lock(requestMutex);
+
+    // no login yet or the renewal didn't happen in time -> try using the refresh token
+    if (needsRelogin()) {
         if (!relogin()) {
             throw LoginException();
         }
@@ -305,6 +364,17 @@ void OIDCClient::storeTokens() {
 
 OIDCClient::~OIDCClient() {
     cancelToken = true;
+
+    std::shared_ptr<platform::Executor::Job> job;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        stopRefresh = true;
+        std::swap(job, refreshJob);
+    }
+    if (job) {
+        job->cancel();
+        job->wait();
+    }
 }
 
 } /* namespace navigraph */
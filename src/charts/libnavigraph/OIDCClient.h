@@ -23,8 +23,11 @@
 #include <map>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <chrono>
 #include <functional>
 #include "src/charts/Crypto.h"
+#include "src/platform/Executor.h"
 #include "src/charts/RESTClient.h"
 #include "AuthServer.h"
 
@@ -54,11 +57,18 @@ public:
     std::vector<uint8_t> getBinary(const std::string &url, bool &cancel);
     long getTimestamp(const std::string &url);
 
+    // For requests made outside of this client. Pass the token that the server
+    // rejected to get a refreshed one, throws LoginException if that fails.
+    std::string getAccessToken(const std::string &rejectedToken = "");
+
     void logout();
 
     virtual ~OIDCClient();
 
 private:
+    // access tokens are renewed this long before they expire, so requests don't wait for it
+    static constexpr const int REFRESH_MARGIN_SECONDS = 5 * 60;
+
     std::string cacheDir;
     std::string tokenFile;
     std::string accountName;
@@ -76,11 +86,21 @@ private:
     // state
     AuthCallback onAuth;
     std::string accessToken, idToken, refreshToken;
+    platform::Executor::Clock::time_point accessTokenExpiry;
     std::map<std::string, std::string> cookieJar;
+    std::shared_ptr<platform::Executor::Job> refreshJob;
+    bool stopRefresh = false;
 
     bool cancelToken = false;
 
+    // the REST client and the tokens are shared by all threads that make requests,
+    // so there is never more than one refresh in flight
+    std::mutex requestMutex;
+
     bool relogin();
+    bool needsRelogin() const;
+    void scheduleRefresh(int expiresInSeconds);
+    void clearTokens();
     void onAuthReply(const std::map<std::string, std::string> &authInfo);
     void handleToken(const std::string &inputJson, const std::map<std::string, std::string> &cookies);
     void loadIDToken(bool checkNonce);
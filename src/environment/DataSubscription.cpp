@@ -0,0 +1,40 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "DataSubscription.h"
+
+namespace avitab {
+
+DataSubscription::DataSubscription(const std::vector<std::string> &dataRefs):
+    dataRefs(dataRefs),
+    values(std::make_shared<std::vector<EnvData>>(dataRefs.size(), EnvData{}))
+{
+}
+
+const std::vector<std::string> &DataSubscription::getDataRefs() const {
+    return dataRefs;
+}
+
+DataSubscription::Values DataSubscription::getValues() const {
+    return std::atomic_load(&values);
+}
+
+void DataSubscription::publish(Values newValues) {
+    std::atomic_store(&values, newValues);
+}
+
+} /* namespace avitab */
@@ -0,0 +1,50 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "EnvData.h"
+
+namespace avitab {
+
+// Values of a set of datarefs that the environment refreshes once per frame, so
+// reading them never waits for the simulator. They are zero until the first refresh
+// and stay zero for datarefs the simulator doesn't have. Dropping the last reference
+// ends the subscription.
+class DataSubscription {
+public:
+    using Values = std::shared_ptr<const std::vector<EnvData>>;
+
+    explicit DataSubscription(const std::vector<std::string> &dataRefs);
+    const std::vector<std::string> &getDataRefs() const;
+
+    // Can be called from any thread, the values are in the order of the datarefs
+    Values getValues() const;
+
+    // Environment thread only
+    void publish(Values newValues);
+
+private:
+    const std::vector<std::string> dataRefs;
+    // only accessed through std::atomic_load and std::atomic_store
+    Values values;
+};
+
+} /* namespace avitab */
@@ -27,10 +27,8 @@ struct EnvData {
 };
 
 using AircraftID = unsigned int;
-const static AircraftID MAX_AI_AIRCRAFT = 19;
-
-using LocationPartIndex = unsigned int;
-const static LocationPartIndex NUM_LOCATION_PARTS = 4;
+const static AircraftID MAX_AI_AIRCRAFT = 19;     // legacy multiplayer datarefs
+const static AircraftID MAX_TCAS_TARGETS = 64;    // TCAS target arrays, including the user's aircraft
 
 
 } /* namespace avitab */
@@ -16,32 +16,74 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
+#include <algorithm>
+#include <sstream>
 #include "Environment.h"
 #include "src/Logger.h"
-#include "src/platform/CrashHandler.h"
+#include "src/platform/Executor.h"
+#include "src/platform/BandwidthScheduler.h"
+#include "src/platform/MemoryBudget.h"
+#include "src/platform/Platform.h"
 #include "src/libnavsql/SqlLoadManager.h"
+#include "src/libflatnav/FlatLoadManager.h"
 
 namespace avitab {
 
 void Environment::loadNavWorldInBackground() {
-    // try to create a SqlWorld instance to manage the world data.
-    // if this fails ask the subclass to provide the default in-memory parser variant
-    try {
-        auto wm = std::make_shared<sqlnav::SqlLoadManager>(getProgramPath() + "navdb/");
-        wm->init_or_throw([this] (std::string simCode) {
-            return this->canUseNavDb(simCode);
-        });
-        worldManager = wm;
-    } catch (const std::exception &e) {
-        logger::warn("Couldn't load Sqlite3 NAV database: %s - will fallback to file parsing if available", e.what());
-        worldManager = createParsingWorldManager();
+    // prefer the memory-mapped flat NAV database, then a SqlWorld instance to manage the world data.
+    // if neither can be used ask the subclass to provide the default in-memory parser variant
+    std::string navDbDir = getProgramPath() + "navdb/";
+    if (keepNavWorld(navDbDir)) {
+        return;
+    }
+
+    auto checkSimulator = [this] (std::string simCode) {
+        return this->canUseNavDb(simCode);
+    };
+    std::shared_ptr<world::LoadManager> manager;
+    if (platform::fileExists(navDbDir + flatnav::FILE_NAME)) {
+        try {
+            auto wm = std::make_shared<flatnav::FlatLoadManager>(navDbDir);
+            wm->init_or_throw(checkSimulator);
+            manager = wm;
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't load flat NAV database: %s - will try the Sqlite3 NAV database", e.what());
+        }
     }
+    if (!manager) {
+        try {
+            auto wm = std::make_shared<sqlnav::SqlLoadManager>(navDbDir);
+            wm->init_or_throw(checkSimulator);
+            manager = wm;
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't load Sqlite3 NAV database: %s - will fallback to file parsing if available", e.what());
+            manager = createParsingWorldManager();
+        }
+    }
+    worldManager = manager;
 
     std::string userfixes_file = settings->getGeneralSetting<std::string>("userfixes_file");
     worldManager->setUserFixesFilename(userfixes_file);
+    worldManager->setLazyProcedureLoading(settings->getGeneralSetting<bool>("lazy_cifp_loading"));
+    worldManager->setCacheDirectory(getProgramPath() + "navcache/");
+    worldManager->setProgressCallback([this] (const world::LoadPhase &phase) {
+        if (!phase.done) {
+            std::lock_guard<std::mutex> lock(loadStatusMutex);
+            navWorldLoadStatus = phase.name;
+        }
+    });
 
     worldManager->discoverSceneries();
-    navWorldFuture = std::async(std::launch::async, &Environment::loadNavWorldAsync, this);
+    auto loader = std::make_shared<std::packaged_task<std::shared_ptr<world::World>()>>([this, navDbDir] { return loadNavWorldAsync(navDbDir); });
+    navWorldFuture = loader->get_future();
+    navWorld.reset();
+    navWorldLoadAttempted = false;
+    navWorldJob = platform::Executor::shared().submit("navworld", platform::Executor::Priority::NORMAL, [loader] { (*loader)(); });
+}
+
+Environment::MagVarMap Environment::getMagneticVariations(std::vector<std::pair<double, double>> locations) {
+    return magVarCache.lookup(locations);
 }
 
 void Environment::loadConfig() {
@@ -56,6 +98,10 @@ void Environment::loadSettings() {
     std::string fname(getSettingsDir() + "/avitab.prf");
     logger::info("Settings file: %s", fname.c_str());
     settings = std::make_unique<Settings>(fname);
+    // 0 keeps the default that depends on the number of cores
+    platform::Executor::shared().setMaxThreads(std::max(0, settings->getGeneralSetting<int>("worker_threads")));
+    // KiB/s, 0 for no limit
+    platform::BandwidthScheduler::shared().setLimit(1024 * (int64_t) settings->getGeneralSetting<int>("max_download_kib_per_s"));
 }
 
 std::shared_ptr<Settings> Environment::getSettings() {
@@ -67,7 +113,12 @@ std::shared_ptr<world::LoadManager> Environment::getWorldManager() {
 }
 
 void Environment::loadUserFixes(std::string filename) {
-    worldManager->loadUserFixes(filename);
+    // large imports are parsed in the background, the map shows the previous
+    // fixes until the new ones replace them
+    auto manager = worldManager;
+    platform::Executor::shared().setQueueLimit("userfixes", 1);
+    userFixesJob = platform::Executor::shared().submit("userfixes", platform::Executor::Priority::NORMAL,
+            [manager, filename] () mutable { manager->loadUserFixes(filename); });
 }
 
 world::NavNodeList Environment::loadFlightPlan(const std::string filename) {
@@ -80,14 +131,96 @@ void Environment::setLastFrameTime(float t) {
 
 float Environment::getLastFrameTime() { return lastFrameTime; }
 
+void Environment::startTraceRecording(const std::string &utf8Path) {
+    try {
+        std::atomic_store(&traceRecorder, std::make_shared<FlightTraceWriter>(utf8Path));
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't start trace recording: %s", e.what());
+    }
+}
+
+void Environment::stopTraceRecording() {
+    std::atomic_store(&traceRecorder, std::shared_ptr<FlightTraceWriter>());
+}
+
+std::shared_ptr<FlightTraceWriter> Environment::getTraceRecorder() {
+    return std::atomic_load(&traceRecorder);
+}
+
+void Environment::startRemoteDisplay(int port) {
+    try {
+        // only local clients unless remoteDisplayBind opens it to the network, e.g. 0.0.0.0
+        std::string bindAddress = getConfig()->getString("/AviTab/remoteDisplayBind");
+        if (bindAddress.empty()) {
+            bindAddress = "127.0.0.1";
+        }
+        std::string token = getConfig()->getString("/AviTab/remoteDisplayToken");
+        std::atomic_store(&remoteDisplay, std::make_shared<RemoteDisplay>(port, bindAddress, token));
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't start remote display: %s", e.what());
+    }
+}
+
+void Environment::stopRemoteDisplay() {
+    std::atomic_store(&remoteDisplay, std::shared_ptr<RemoteDisplay>());
+}
+
+std::shared_ptr<RemoteDisplay> Environment::getRemoteDisplay() {
+    return std::atomic_load(&remoteDisplay);
+}
+
+void Environment::startMapStateExport() {
+    try {
+        std::atomic_store(&mapStateExport, std::make_shared<MapStateExport>());
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't start map state export: %s", e.what());
+    }
+}
+
+void Environment::stopMapStateExport() {
+    std::atomic_store(&mapStateExport, std::shared_ptr<MapStateExport>());
+}
+
+bool Environment::isMapStateExported() {
+    return std::atomic_load(&mapStateExport) != nullptr;
+}
+
+void Environment::publishMapState(const MapState &state) {
+    if (auto mapExport = std::atomic_load(&mapStateExport)) {
+        mapExport->publish(state);
+    }
+}
+
+void Environment::recordAircraftTrace(const AircraftSnapshot &snapshot) {
+    auto recorder = std::atomic_load(&traceRecorder);
+    if (!recorder) {
+        return;
+    }
+
+    std::vector<FlightTrace::AircraftPosition> aircraft;
+    aircraft.reserve(snapshot.locations.size());
+    for (auto &loc: snapshot.locations) {
+        aircraft.push_back({loc.longitude, loc.latitude, (float) loc.elevation, (float) loc.heading});
+    }
+    recorder->recordAircraft(aircraft);
+}
+
+void Environment::recordCommandTrace(const std::string &name, CommandState state) {
+    auto recorder = std::atomic_load(&traceRecorder);
+    if (recorder) {
+        recorder->recordCommand(name, (int) state);
+    }
+}
+
 void Environment::reloadMetar() {
     worldManager->reloadMetar();
 }
 
-std::shared_ptr<world::World> Environment::loadNavWorldAsync() {
-    crash::ThreadCookie crashCookie;
-
+std::shared_ptr<world::World> Environment::loadNavWorldAsync(const std::string &navDbDir) {
     auto data = worldManager;
+    // taken before loading so that files changed while loading are noticed
+    std::string fingerprint = fingerprintNavSources(navDbDir);
+    navWorldFingerprint.clear();
     logger::info("Loading nav data...");
     try {
         data->load();
@@ -95,10 +228,69 @@ std::shared_ptr<world::World> Environment::loadNavWorldAsync() {
         logger::error("Couldn't load nav data: %s", e.what());
         throw e;
     }
+    if (!data->shouldCancelLoading()) {
+        navWorldFingerprint = fingerprint;
+    }
     logger::info("Nav data ready");
     return data->getWorld();
 }
 
+bool Environment::keepNavWorld(const std::string &navDbDir) {
+    // the environment outlives disabling the plugin, so its world can be used again
+    if (!worldManager || !navWorldFuture.valid() || !isNavWorldReady()) {
+        return false;
+    }
+    try {
+        if (!navWorldFuture.get()) {
+            return false;
+        }
+    } catch (const std::exception &e) {
+        return false;
+    }
+
+    // the future is ready, so the loader is done with the fingerprint
+    if (navWorldFingerprint.empty() || navWorldFingerprint != fingerprintNavSources(navDbDir)) {
+        logger::info("Nav data changed, loading it again");
+        return false;
+    }
+
+    logger::info("Keeping the loaded nav data");
+    worldManager->resumeLoading();
+    auto manager = worldManager;
+    navWorldJob = platform::Executor::shared().submit("navworld", platform::Executor::Priority::NORMAL, [manager] { manager->reloadMetar(); });
+    std::string userfixes_file = settings->getGeneralSetting<std::string>("userfixes_file");
+    worldManager->setUserFixesFilename(userfixes_file);
+    loadUserFixes(userfixes_file);
+    return true;
+}
+
+std::string Environment::fingerprintNavSources(const std::string &navDbDir) {
+    // the manager that is used depends on the databases that exist
+    std::vector<std::string> files = worldManager->getSourceFiles();
+    if (files.empty()) {
+        return "";
+    }
+    files.push_back(navDbDir + flatnav::FILE_NAME);
+    files.push_back(navDbDir + sqlnav::FILE_NAME);
+
+    std::ostringstream fingerprint;
+    fingerprint << "lazy_cifp_loading=" << settings->getGeneralSetting<bool>("lazy_cifp_loading") << "\n";
+    for (auto &file: files) {
+        // missing files are recorded with size 0 so that adding them later is noticed
+        std::error_code ec;
+        auto path = fs::u8path(file);
+        uint64_t size = fs::file_size(path, ec);
+        int64_t mtime = 0;
+        if (ec) {
+            size = 0;
+        } else {
+            mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+        }
+        fingerprint << file << "|" << size << "|" << mtime << "\n";
+    }
+    return fingerprint.str();
+}
+
 bool Environment::isNavWorldReady() {
     if (!navWorldFuture.valid()) {
         // loading not requested
@@ -109,8 +301,20 @@ bool Environment::isNavWorldReady() {
     return state == std::future_status::ready;
 }
 
+std::string Environment::getNavWorldLoadStatus() {
+    std::lock_guard<std::mutex> lock(loadStatusMutex);
+    return navWorldLoadStatus;
+}
+
 void Environment::cancelNavWorldLoading() {
     worldManager->cancelLoading();
+    if (navWorldJob) {
+        navWorldJob->cancel();
+    }
+    if (userFixesJob) {
+        userFixesJob->cancel();
+        userFixesJob->wait();
+    }
     if (navWorldFuture.valid()) {
         // wait until the canceling is done to avoid race-conditions on destruction while loading
         navWorldFuture.wait();
@@ -142,16 +346,55 @@ void Environment::runInEnvironment(EnvironmentCallback cb) {
     envCallbacks.push_back(cb);
 }
 
+std::shared_ptr<DataSubscription> Environment::subscribeData(const std::vector<std::string> &dataRefs) {
+    auto subscription = std::make_shared<DataSubscription>(dataRefs);
+    std::lock_guard<std::mutex> lock(subscriptionMutex);
+    newSubscriptions.push_back(subscription);
+    return subscription;
+}
+
+std::vector<std::shared_ptr<DataSubscription>> Environment::takeNewSubscriptions() {
+    std::vector<std::shared_ptr<DataSubscription>> res;
+    std::lock_guard<std::mutex> lock(subscriptionMutex);
+    for (auto &weak: newSubscriptions) {
+        auto subscription = weak.lock();
+        if (subscription) {
+            res.push_back(subscription);
+        }
+    }
+    newSubscriptions.clear();
+    return res;
+}
+
 void Environment::runEnvironmentCallbacks() {
-    std::lock_guard<std::mutex> lock(envMutex);
-    if (!envCallbacks.empty()) {
-        for (auto &cb: envCallbacks) {
-            cb();
+    // runs every frame in all environments, the budget only checks every few seconds
+    platform::MemoryBudget::shared().poll();
+
+    EnvironmentCallback onFrame;
+    {
+        std::lock_guard<std::mutex> lock(envMutex);
+        if (!envCallbacks.empty()) {
+            for (auto &cb: envCallbacks) {
+                cb();
+            }
+            envCallbacks.clear();
         }
-        envCallbacks.clear();
+        if (!stopped) {
+            onFrame = frameCallback;
+        }
+    }
+
+    // unlocked, it may take a while and other threads shouldn't wait for it to queue callbacks
+    if (onFrame) {
+        onFrame();
     }
 }
 
+void Environment::setFrameCallback(EnvironmentCallback cb) {
+    std::lock_guard<std::mutex> lock(envMutex);
+    frameCallback = cb;
+}
+
 void Environment::pauseEnvironmentJobs() {
     std::lock_guard<std::mutex> lock(envMutex);
     stopped = true;
@@ -167,6 +410,70 @@ void Environment::enableAndPowerPanel() {
 void Environment::setIsInMenu(bool menu) {
 }
 
+AircraftLocations Environment::getAircraftLocations() {
+    auto snapshot = std::make_shared<AircraftSnapshot>();
+    AircraftID count = getActiveAircraftCount();
+    snapshot->locations.reserve(count);
+    for (AircraftID i = 0; i < count; ++i) {
+        snapshot->locations.push_back(getAircraftLocation(i));
+    }
+    snapshot->sampledAt = std::chrono::steady_clock::now();
+    return snapshot;
+}
+
+Location AircraftSnapshot::extrapolateUser(std::chrono::steady_clock::time_point at) const {
+    if (locations.empty()) {
+        return {};
+    }
+
+    Location loc = locations[0];
+    double seconds = std::chrono::duration<double>(at - sampledAt).count();
+    seconds = std::max(0.0, std::min(seconds, MAX_EXTRAPOLATION_SECONDS));
+    loc.latitude += userVelocity.latitude * seconds;
+    loc.longitude = std::remainder(loc.longitude + userVelocity.longitude * seconds, 360.0);
+    loc.elevation += userVelocity.elevation * seconds;
+    loc.heading = std::fmod(loc.heading + userVelocity.heading * seconds + 360.0, 360.0);
+    return loc;
+}
+
+void Environment::estimateUserVelocity(AircraftSnapshot &next, const AircraftSnapshot &prev) {
+    // about 2000 knots and a full turn in 10 seconds
+    constexpr const double MAX_DEGREES_PER_MINUTE = 0.6;
+    constexpr const double MAX_TURN_PER_SECOND = 36;
+
+    next.userVelocity = {};
+    if (next.locations.empty() || prev.locations.empty()) {
+        return;
+    }
+
+    double seconds = std::chrono::duration<double>(next.sampledAt - prev.sampledAt).count();
+    if (seconds <= 0 || seconds > 1) {
+        return;
+    }
+
+    const Location &a = prev.locations[0];
+    const Location &b = next.locations[0];
+    Location v;
+    v.latitude = (b.latitude - a.latitude) / seconds;
+    v.longitude = std::remainder(b.longitude - a.longitude, 360.0) / seconds;
+    v.elevation = (b.elevation - a.elevation) / seconds;
+    v.heading = std::remainder(b.heading - a.heading, 360.0) / seconds;
+
+    double cosLat = std::max(0.01, std::cos(b.latitude * M_PI / 180));
+    if (std::abs(v.latitude) > MAX_DEGREES_PER_MINUTE / 60 ||
+        std::abs(v.longitude * cosLat) > MAX_DEGREES_PER_MINUTE / 60 ||
+        std::abs(v.heading) > MAX_TURN_PER_SECOND) {
+        return;
+    }
+
+    // the samples are taken at the sim's frame times, smooth out their jitter
+    v.latitude = (v.latitude + prev.userVelocity.latitude) / 2;
+    v.longitude = (v.longitude + prev.userVelocity.longitude) / 2;
+    v.elevation = (v.elevation + prev.userVelocity.elevation) / 2;
+    v.heading = (v.heading + prev.userVelocity.heading) / 2;
+    next.userVelocity = v;
+}
+
 void Environment::onAircraftReload() {
 
 }
@@ -24,11 +24,24 @@
 #include <vector>
 #include <future>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include "src/world/LoadManager.h"
 #include "src/gui_toolkit/LVGLToolkit.h"
 #include "EnvData.h"
 #include "Config.h"
 #include "Settings.h"
+#include "MagVarCache.h"
+#include "DataSubscription.h"
+#include "FlightTrace.h"
+#include "RemoteDisplay.h"
+#include "MapStateExport.h"
+#include "WeatherStations.h"
+#include "src/platform/Executor.h"
+
+namespace maps {
+class OverlayTimings;
+}
 
 namespace avitab {
 
@@ -36,6 +49,23 @@ struct Location {
     double longitude{}, latitude{}, elevation{}, heading{};
 };
 
+// All aircraft as of one simulator frame, shared and never modified once published
+struct AircraftSnapshot {
+    // the user's aircraft first, then the other aircraft
+    std::vector<Location> locations;
+    // increases with every published snapshot, 0 if the environment doesn't publish any
+    uint64_t frame = 0;
+    std::chrono::steady_clock::time_point sampledAt;
+    // change of the user's aircraft per second, estimated from the previous snapshot
+    Location userVelocity;
+
+    // The user's aircraft moved on from the sample to the given time, at most by
+    // MAX_EXTRAPOLATION_SECONDS so that a paused or stalled simulator doesn't run away
+    Location extrapolateUser(std::chrono::steady_clock::time_point at) const;
+    static constexpr const double MAX_EXTRAPOLATION_SECONDS = 0.5;
+};
+using AircraftLocations = std::shared_ptr<const AircraftSnapshot>;
+
 enum class CommandState {
     START,
     CONTINUE,
@@ -57,10 +87,16 @@ public:
     std::shared_ptr<Config> getConfig();
     void loadSettings();
     std::shared_ptr<Settings> getSettings();
+    // Keeps the world of an earlier call while its files are unchanged, e.g. when
+    // the plugin is enabled again, and only reloads the user fixes and METAR then
     void loadNavWorldInBackground();
     bool isNavWorldReady();
+    // The phase the nav world load is in, for display while it isn't ready
+    std::string getNavWorldLoadStatus();
     virtual void onAircraftReload();
     virtual std::shared_ptr<LVGLToolkit> createGUIToolkit() = 0;
+    // whether createGUIToolkit can be called again for more tablets
+    virtual bool supportsMultipleGUIToolkits() { return false; }
     virtual void createMenu(const std::string &name) = 0;
     virtual void addMenuEntry(const std::string &label, MenuCallback cb) = 0;
     virtual void destroyMenu() = 0;
@@ -68,6 +104,8 @@ public:
     virtual void destroyCommands() = 0;
     void pauseEnvironmentJobs();
     void resumeEnvironmentJobs();
+    // called every frame after the queued callbacks, nullptr to remove
+    void setFrameCallback(EnvironmentCallback cb);
 
     // Can be called from any thread
     /**
@@ -76,16 +114,20 @@ public:
      * @param cb the callback to enqueue
      */
     void runInEnvironment(EnvironmentCallback cb);
+    // The environment refreshes the values every frame until the subscription is dropped
+    std::shared_ptr<DataSubscription> subscribeData(const std::vector<std::string> &dataRefs);
     virtual std::string getFontDirectory() = 0;
     virtual std::string getProgramPath() = 0;
     virtual std::string getDataRootPath() = 0;
     virtual std::string getSettingsDir() = 0;
     virtual std::string getFlightPlansPath() = 0;
     virtual std::string getEarthTexturePath() = 0;
-    // Getting magVar from XPlane is asynchronous and slow, so batch request
-    using MagVarMap = std::map<std::pair<double, double>, double>;
-    virtual MagVarMap getMagneticVariations(std::vector<std::pair<double, double>> locations) = 0;
+    // Served from a gridded cache, the simulator is only asked for grid nodes not seen before
+    using MagVarMap = MagVarCache::MagVarMap;
+    MagVarMap getMagneticVariations(std::vector<std::pair<double, double>> locations);
     virtual std::string getMETARForAirport(const std::string &icao) = 0;
+    // the weather of all stations for map overlays, nullptr without a bulk source
+    virtual std::shared_ptr<const WeatherStations> getWeatherStations() { return nullptr; }
     std::shared_ptr<world::World> getNavWorld();
     virtual std::string getAirplanePath() = 0;
     void cancelNavWorldLoading();
@@ -96,32 +138,79 @@ public:
     virtual void setIsInMenu(bool menu);
     virtual AircraftID getActiveAircraftCount() = 0;
     virtual Location getAircraftLocation(AircraftID id) = 0;
+    virtual AircraftLocations getAircraftLocations();
     virtual void updateMapExports(float lat, float lon, int zoom, float vrange) { /* default is no operation */ }
+    virtual void updateOverlayTimingExports(const maps::OverlayTimings &timings) { /* default is no operation */ }
     float getLastFrameTime();
+    // Records the aircraft and the commands into a FlightTrace until stopped,
+    // GUI input is recorded by the toolkit that gets the recorder
+    void startTraceRecording(const std::string &utf8Path);
+    void stopTraceRecording();
+    std::shared_ptr<FlightTraceWriter> getTraceRecorder();
+    // Streams the tablet to a client on another device until stopped,
+    // fed by the toolkit that gets the display
+    void startRemoteDisplay(int port);
+    void stopRemoteDisplay();
+    std::shared_ptr<RemoteDisplay> getRemoteDisplay();
+    // Shares the map state with other programs on this machine until stopped,
+    // publishMapState is a no-op before
+    void startMapStateExport();
+    void stopMapStateExport();
+    bool isMapStateExported();
+    void publishMapState(const MapState &state);
 
     virtual ~Environment() = default;
 
 protected:
     void runEnvironmentCallbacks();
+    // Subscriptions made since the last call that are still alive
+    std::vector<std::shared_ptr<DataSubscription>> takeNewSubscriptions();
     virtual std::shared_ptr<world::LoadManager> createParsingWorldManager() = 0;
     std::shared_ptr<world::LoadManager> getWorldManager();
     void setLastFrameTime(float t);
+    // fills next.userVelocity from the change since prev, zero after jumps like repositioning
+    static void estimateUserVelocity(AircraftSnapshot &next, const AircraftSnapshot &prev);
+    // no-ops unless a trace is being recorded
+    void recordAircraftTrace(const AircraftSnapshot &snapshot);
+    void recordCommandTrace(const std::string &name, CommandState state);
     virtual bool canUseNavDb(const std::string simCode) = 0;
+    // Getting magVar from XPlane is asynchronous and slow, so batch request
+    virtual MagVarMap sampleMagneticVariations(std::vector<std::pair<double, double>> locations) = 0;
 
 private:
     std::shared_ptr<Config> config;
     std::shared_ptr<Settings> settings;
     std::mutex envMutex;
     std::vector<EnvironmentCallback> envCallbacks;
+    EnvironmentCallback frameCallback;
+    std::mutex subscriptionMutex;
+    std::vector<std::weak_ptr<DataSubscription>> newSubscriptions;
     std::shared_future<std::shared_ptr<world::World>> navWorldFuture;
+    std::shared_ptr<platform::Executor::Job> navWorldJob;
+    std::shared_ptr<platform::Executor::Job> userFixesJob;
     std::shared_ptr<world::World> navWorld;
     std::shared_ptr<world::LoadManager> worldManager;
     std::atomic_bool navWorldLoadAttempted {false};
+    // of the files the loaded world was built from, empty unless it loaded completely
+    std::string navWorldFingerprint;
+    std::mutex loadStatusMutex;
+    std::string navWorldLoadStatus;
     std::atomic<float> lastFrameTime {};
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<FlightTraceWriter> traceRecorder;
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<RemoteDisplay> remoteDisplay;
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<MapStateExport> mapStateExport;
+    MagVarCache magVarCache {[this] (MagVarCache::Locations locations) {
+        return sampleMagneticVariations(locations);
+    }};
 
     bool stopped = false;
 
-    std::shared_ptr<world::World> loadNavWorldAsync();
+    std::shared_ptr<world::World> loadNavWorldAsync(const std::string &navDbDir);
+    bool keepNavWorld(const std::string &navDbDir);
+    std::string fingerprintNavSources(const std::string &navDbDir);
 };
 
 } /* namespace avitab */
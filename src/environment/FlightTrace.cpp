@@ -0,0 +1,218 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include "FlightTrace.h"
+#include "src/Logger.h"
+
+namespace avitab {
+
+FlightTraceWriter::FlightTraceWriter(const std::string &utf8Path):
+    stream(fs::u8path(utf8Path), std::ios::out | std::ios::binary)
+{
+    if (!stream) {
+        throw std::runtime_error("Couldn't create trace " + utf8Path);
+    }
+    put(FlightTrace::FILE_MAGIC);
+    put(FlightTrace::FILE_VERSION);
+    lastEventAt = std::chrono::steady_clock::now();
+    logger::info("Recording flight trace to %s", utf8Path.c_str());
+}
+
+void FlightTraceWriter::beginEvent(EventType type) {
+    auto now = std::chrono::steady_clock::now();
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - lastEventAt).count();
+    lastEventAt = now;
+    put((uint8_t) type);
+    put((uint32_t) std::min<int64_t>(delta, UINT32_MAX));
+}
+
+void FlightTraceWriter::recordAircraft(const std::vector<FlightTrace::AircraftPosition> &aircraft) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastAircraftAt < std::chrono::microseconds(1000000 / AIRCRAFT_RATE_HZ)) {
+        return;
+    }
+    lastAircraftAt = now;
+
+    beginEvent(EventType::AIRCRAFT);
+    put((uint16_t) std::min<size_t>(aircraft.size(), UINT16_MAX));
+    for (size_t i = 0; i < aircraft.size() && i < UINT16_MAX; i++) {
+        auto &plane = aircraft[i];
+        put((int32_t) std::lround(plane.longitude * 1e7));
+        put((int32_t) std::lround(plane.latitude * 1e7));
+        put(plane.elevation);
+        put(plane.heading);
+    }
+}
+
+void FlightTraceWriter::recordPointer(int x, int y, bool pressed) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (x == lastX && y == lastY && pressed == lastPressed) {
+        return;
+    }
+    lastX = x;
+    lastY = y;
+    lastPressed = pressed;
+
+    beginEvent(EventType::POINTER);
+    put((int16_t) x);
+    put((int16_t) y);
+    put((uint8_t) pressed);
+}
+
+void FlightTraceWriter::recordWheel(int dir) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    beginEvent(EventType::WHEEL);
+    put((int8_t) dir);
+}
+
+void FlightTraceWriter::recordKey(uint32_t c) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    beginEvent(EventType::KEY);
+    put(c);
+}
+
+void FlightTraceWriter::recordCommand(const std::string &name, int state) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    beginEvent(EventType::COMMAND);
+    put((uint8_t) state);
+    put((uint8_t) std::min<size_t>(name.size(), UINT8_MAX));
+    stream.write(name.data(), std::min<size_t>(name.size(), UINT8_MAX));
+}
+
+FlightTraceWriter::~FlightTraceWriter() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    stream.flush();
+    if (!stream) {
+        logger::warn("Flight trace is incomplete, write error");
+    }
+}
+
+FlightTraceReader::FlightTraceReader(const std::string &utf8Path):
+    file(utf8Path),
+    pos(file.data()),
+    end(file.data() + file.size())
+{
+    uint32_t header[2];
+    if (end - pos < (ptrdiff_t) sizeof(header)) {
+        throw std::runtime_error("Truncated trace");
+    }
+    std::memcpy(header, pos, sizeof(header));
+    pos += sizeof(header);
+    if (header[0] != FlightTrace::FILE_MAGIC || header[1] != FlightTrace::FILE_VERSION) {
+        throw std::runtime_error("Unknown trace format");
+    }
+
+    const char *at = pos;
+    FlightTrace::Event event;
+    while (readEvent(at, event, duration)) {
+    }
+}
+
+bool FlightTraceReader::next(FlightTrace::Event &event) {
+    return readEvent(pos, event, micros);
+}
+
+uint64_t FlightTraceReader::getDurationMicros() const {
+    return duration;
+}
+
+bool FlightTraceReader::readEvent(const char *&at, FlightTrace::Event &event, uint64_t &time) const {
+    const char *cur = at;
+    auto get = [&cur, this] (auto &value) {
+        if (end - cur < (ptrdiff_t) sizeof(value)) {
+            return false;
+        }
+        std::memcpy(&value, cur, sizeof(value));
+        cur += sizeof(value);
+        return true;
+    };
+
+    uint8_t type;
+    uint32_t delta;
+    if (!get(type) || !get(delta)) {
+        return false;
+    }
+    event.type = (FlightTrace::EventType) type;
+
+    switch (event.type) {
+    case FlightTrace::EventType::AIRCRAFT: {
+        uint16_t count;
+        if (!get(count)) {
+            return false;
+        }
+        event.aircraft.resize(count);
+        for (auto &plane: event.aircraft) {
+            int32_t lon, lat;
+            if (!get(lon) || !get(lat) || !get(plane.elevation) || !get(plane.heading)) {
+                return false;
+            }
+            plane.longitude = lon / 1e7;
+            plane.latitude = lat / 1e7;
+        }
+        break;
+    }
+    case FlightTrace::EventType::POINTER: {
+        int16_t x, y;
+        uint8_t pressed;
+        if (!get(x) || !get(y) || !get(pressed)) {
+            return false;
+        }
+        event.x = x;
+        event.y = y;
+        event.pressed = pressed;
+        break;
+    }
+    case FlightTrace::EventType::WHEEL: {
+        int8_t dir;
+        if (!get(dir)) {
+            return false;
+        }
+        event.x = dir;
+        break;
+    }
+    case FlightTrace::EventType::KEY:
+        if (!get(event.key)) {
+            return false;
+        }
+        break;
+    case FlightTrace::EventType::COMMAND: {
+        uint8_t state, len;
+        if (!get(state) || !get(len) || end - cur < len) {
+            return false;
+        }
+        event.state = state;
+        event.command.assign(cur, len);
+        cur += len;
+        break;
+    }
+    default:
+        logger::warn("Unknown event %d in trace", type);
+        return false;
+    }
+
+    time += delta;
+    event.micros = time;
+    at = cur;
+    return true;
+}
+
+} /* namespace avitab */
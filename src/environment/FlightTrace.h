@@ -0,0 +1,120 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
+
+namespace avitab {
+
+// Compact binary log of what AviTab saw during a flight: the aircraft positions,
+// GUI input and commands, so that a flight can be replayed without a simulator.
+// Each event is stored as its type, the microseconds since the previous event
+// and a fixed payload, positions as 1e-7 degrees.
+class FlightTrace {
+public:
+    enum class EventType: uint8_t {
+        AIRCRAFT = 1,
+        POINTER = 2,
+        WHEEL = 3,
+        KEY = 4,
+        COMMAND = 5,
+    };
+
+    struct AircraftPosition {
+        double longitude, latitude;
+        float elevation, heading;
+    };
+
+    struct Event {
+        EventType type;
+        // since the start of the recording
+        uint64_t micros;
+        // AIRCRAFT: the user's aircraft first, then the traffic
+        std::vector<AircraftPosition> aircraft;
+        // POINTER: x, y, pressed - WHEEL: direction - KEY: character
+        int32_t x, y;
+        bool pressed;
+        uint32_t key;
+        // COMMAND: name and state as CommandState
+        std::string command;
+        int state;
+    };
+
+    static constexpr const uint32_t FILE_MAGIC = 0x43525446; // "FTRC"
+    static constexpr const uint32_t FILE_VERSION = 1;
+};
+
+// Can be called from any thread, events are written in the order they arrive
+class FlightTraceWriter {
+public:
+    explicit FlightTraceWriter(const std::string &utf8Path);
+
+    // at most AIRCRAFT_RATE_HZ samples are stored, the others are skipped
+    void recordAircraft(const std::vector<FlightTrace::AircraftPosition> &aircraft);
+    // only changes of the pointer are stored
+    void recordPointer(int x, int y, bool pressed);
+    void recordWheel(int dir);
+    void recordKey(uint32_t c);
+    void recordCommand(const std::string &name, int state);
+
+    ~FlightTraceWriter();
+private:
+    using EventType = FlightTrace::EventType;
+    static constexpr const int AIRCRAFT_RATE_HZ = 20;
+
+    std::mutex writeMutex;
+    fs::ofstream stream;
+    std::chrono::steady_clock::time_point lastEventAt;
+    std::chrono::steady_clock::time_point lastAircraftAt;
+    int lastX = -1, lastY = -1;
+    bool lastPressed = false;
+
+    void beginEvent(EventType type);
+    template<typename T>
+    void put(T value) {
+        stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+};
+
+class FlightTraceReader {
+public:
+    explicit FlightTraceReader(const std::string &utf8Path);
+
+    // false once the trace is exhausted or the rest of it is truncated
+    bool next(FlightTrace::Event &event);
+
+    // total duration, scanned once when opening the trace
+    uint64_t getDurationMicros() const;
+private:
+    platform::MappedFile file;
+    const char *pos;
+    const char *end;
+    uint64_t micros = 0;
+    uint64_t duration = 0;
+
+    bool readEvent(const char *&at, FlightTrace::Event &event, uint64_t &time) const;
+};
+
+} /* namespace avitab */
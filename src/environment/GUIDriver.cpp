@@ -19,6 +19,8 @@
 #include "GUIDriver.h"
 #include "src/Logger.h"
 #include <cstring>
+#include <chrono>
+#include <algorithm>
 
 namespace avitab {
 
@@ -28,6 +30,9 @@ void GUIDriver::init(int width, int height) {
     bufferWidth = width;
     bufferHeight = height;
     buffer.resize(width * height);
+
+    memoryConsumer = platform::MemoryBudget::shared().addConsumer("gui_buffer", platform::MemoryBudget::Priority::FIXED,
+        [this] () { return (size_t) bufferWidth * bufferHeight * sizeof(uint32_t); });
 }
 
 WindowRect GUIDriver::getWindowRect() {
@@ -38,15 +43,78 @@ void GUIDriver::setResizeCallback(ResizeCallback cb) {
     onResize = cb;
 }
 
+void GUIDriver::setActivityCallback(ActivityCallback cb) {
+    onActivity = cb;
+}
+
+void GUIDriver::setSimFrameCallback(SimFrameCallback cb) {
+    onSimFrame = cb;
+}
+
+void GUIDriver::signalSimFrame() {
+    if (onSimFrame) {
+        onSimFrame();
+    }
+}
+
+bool GUIDriver::hasSimFrames() {
+    return false;
+}
+
+void GUIDriver::signalActivity() {
+    if (onActivity) {
+        onActivity();
+    }
+}
+
+void GUIDriver::markDrawn() {
+    bool wasShown = isShown();
+    lastDrawnAt = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (!wasShown) {
+        // let the GUI catch up with what happened while it was hidden
+        signalActivity();
+    }
+}
+
+bool GUIDriver::isShown() {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t drawnAt = lastDrawnAt;
+    return drawnAt != 0 && now - drawnAt < SHOWN_TIMEOUT_MS;
+}
+
 void GUIDriver::resize(int newWidth, int newHeight) {
+    newWidth = std::max(1, std::min(newWidth, MAX_WIDTH));
+    newHeight = std::max(1, std::min(newHeight, MAX_HEIGHT));
     bufferWidth = newWidth;
     bufferHeight = newHeight;
     buffer.resize(bufferWidth * bufferHeight);
+    {
+        std::lock_guard<std::mutex> lock(damageMutex);
+        damage = {};
+        damage.add(0, 0, newWidth - 1, newHeight - 1);
+    }
     if (onResize) {
         onResize(newWidth, newHeight);
     }
 }
 
+void GUIDriver::setRenderScale(float scale) {
+    scale = std::max(MIN_RENDER_SCALE, std::min(scale, MAX_RENDER_SCALE));
+    if (renderScale.exchange(scale) != scale) {
+        logger::verbose("GUI render scale %.2f", scale);
+        onRenderScaleChanged();
+    }
+}
+
+float GUIDriver::getRenderScale() {
+    return renderScale;
+}
+
+void GUIDriver::onRenderScaleChanged() {
+}
+
 void GUIDriver::createPanel(int left, int bottom, int width, int height, bool captureClicks) {
 }
 
@@ -67,6 +135,43 @@ void GUIDriver::blit(int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint3
                w * sizeof(uint32_t));
         data += w;
     }
+
+    std::lock_guard<std::mutex> lock(damageMutex);
+    damage.add(std::max(x1, 0), std::max(y1, 0), std::min(x2, bufferWidth - 1), std::min(y2, bufferHeight - 1));
+}
+
+GUIDriver::DirtyRect GUIDriver::takeDamage() {
+    std::lock_guard<std::mutex> lock(damageMutex);
+    DirtyRect taken = damage;
+    damage = {};
+    return taken;
+}
+
+bool GUIDriver::DirtyRect::empty() const {
+    return x2 < x1 || y2 < y1;
+}
+
+void GUIDriver::DirtyRect::add(int ax1, int ay1, int ax2, int ay2) {
+    if (empty()) {
+        x1 = ax1;
+        y1 = ay1;
+        x2 = ax2;
+        y2 = ay2;
+    } else {
+        x1 = std::min(x1, ax1);
+        y1 = std::min(y1, ay1);
+        x2 = std::max(x2, ax2);
+        y2 = std::max(y2, ay2);
+    }
+}
+
+void GUIDriver::DirtyRect::add(const DirtyRect &other) {
+    if (!other.empty()) {
+        add(other.x1, other.y1, other.x2, other.y2);
+    }
+}
+
+void GUIDriver::finishFrame() {
 }
 
 int GUIDriver::width() {
@@ -97,6 +202,7 @@ void GUIDriver::pushKeyInput(uint32_t c) {
     if (enableKeyInput) {
         keyInput.push(c);
     }
+    signalActivity();
 }
 
 uint32_t GUIDriver::popKeyPress() {
@@ -116,6 +222,7 @@ void GUIDriver::passLeftClick(bool down) {
 
 GUIDriver::~GUIDriver() {
     logger::verbose("Destroying GUI driver");
+    memoryConsumer.reset();
 }
 
 }
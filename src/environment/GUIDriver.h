@@ -25,6 +25,7 @@
 #include <mutex>
 #include <atomic>
 #include <functional>
+#include "src/platform/MemoryBudget.h"
 
 namespace avitab {
 
@@ -40,10 +41,22 @@ struct WindowRect {
 class GUIDriver {
 public:
     using ResizeCallback = std::function<void(int, int)>;
+    using ActivityCallback = std::function<void()>;
+    using SimFrameCallback = std::function<void()>;
+
+    // largest GUI, the same as LV_HOR_RES_MAX and LV_VER_RES_MAX
+    static constexpr const int MAX_WIDTH = 3840;
+    static constexpr const int MAX_HEIGHT = 2160;
+    static constexpr const float MIN_RENDER_SCALE = 0.5f;
+    static constexpr const float MAX_RENDER_SCALE = 2.0f;
 
     virtual void init(int width, int height);
 
     void setResizeCallback(ResizeCallback cb);
+    // called from any thread when there is new pointer, wheel or key input
+    void setActivityCallback(ActivityCallback cb);
+    // called from the render thread once per simulator frame that shows the tablet
+    void setSimFrameCallback(SimFrameCallback cb);
 
     virtual void createWindow(const std::string &title, const WindowRect &rect) = 0;
     virtual bool hasWindow() = 0;
@@ -54,12 +67,24 @@ public:
     virtual void hidePanel();
 
     virtual void blit(int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint32_t *data);
+    // called from the GUI thread once all areas of a frame were blitted
+    virtual void finishFrame();
     virtual void readPointerState(int &x, int &y, bool &pressed) = 0;
 
     virtual int getWheelDirection() = 0;
     virtual void setWantKeyInput(bool wantKeys);
     virtual uint32_t popKeyPress();
 
+    // whether the tablet was drawn recently, i.e. it's visible and powered
+    bool isShown();
+    // whether the driver calls the sim frame callback, i.e. frames can be paced to the simulator
+    virtual bool hasSimFrames();
+
+    // GUI pixels per window pixel relative to the driver's default. Only applies to drivers
+    // whose GUI follows the window size, the GUI is filtered to the window's size.
+    void setRenderScale(float scale);
+    float getRenderScale();
+
     virtual void setBrightness(float b) = 0;
     virtual float getBrightness() = 0;
 
@@ -67,18 +92,43 @@ public:
 
     virtual ~GUIDriver();
 protected:
+    // inclusive pixel area, empty if x2 < x1
+    struct DirtyRect {
+        int x1 = 0, y1 = 0, x2 = -1, y2 = -1;
+        bool empty() const;
+        void add(int ax1, int ay1, int ax2, int ay2);
+        void add(const DirtyRect &other);
+    };
+
     uint32_t *data();
     bool wantsKeyInput();
     void pushKeyInput(uint32_t c);
+    void signalActivity();
+    // to be called by the drivers whenever they draw the tablet
+    void markDrawn();
+    void signalSimFrame();
     int width();
     int height();
+    // clamped to MAX_WIDTH and MAX_HEIGHT
     void resize(int newWidth, int newHeight);
+    // called from the thread that set the render scale
+    virtual void onRenderScaleChanged();
+    // area of the buffer changed by blit() and resize() since the last call
+    DirtyRect takeDamage();
 private:
     ResizeCallback onResize;
+    ActivityCallback onActivity;
+    SimFrameCallback onSimFrame;
+    static constexpr const int SHOWN_TIMEOUT_MS = 1000;
+    std::atomic<int64_t> lastDrawnAt{0};
     std::mutex keyMutex;
     bool enableKeyInput = false;
     std::atomic_int bufferWidth{0}, bufferHeight{0};
+    std::atomic<float> renderScale{1.0f};
     std::vector<uint32_t> buffer;
+    std::mutex damageMutex;
+    DirtyRect damage;
+    platform::MemoryBudget::Registration memoryConsumer;
     std::queue<uint32_t> keyInput;
 };
 
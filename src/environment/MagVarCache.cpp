@@ -0,0 +1,125 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "MagVarCache.h"
+
+namespace avitab {
+
+MagVarCache::MagVarCache(Sampler sampler):
+    sampler(sampler),
+    grid(LAT_NODES * LON_NODES, 0),
+    known(LAT_NODES * LON_NODES, false)
+{
+}
+
+MagVarCache::MagVarMap MagVarCache::lookup(const Locations &locations) {
+    fillNodes(locations);
+
+    MagVarMap res;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &loc: locations) {
+        res[loc] = interpolate(loc.first, loc.second);
+    }
+    return res;
+}
+
+double MagVarCache::lookup(double latitude, double longitude) {
+    auto loc = std::make_pair(latitude, longitude);
+    return lookup(Locations{loc})[loc];
+}
+
+int MagVarCache::nodeIndex(int latNode, int lonNode) {
+    lonNode = ((lonNode % LON_NODES) + LON_NODES) % LON_NODES;
+    return latNode * LON_NODES + lonNode;
+}
+
+void MagVarCache::cellOf(double latitude, double longitude, int &latNode, int &lonNode, double &latFrac, double &lonFrac) {
+    double lat = std::clamp(latitude, -90.0, 90.0) + 90.0;
+    double lon = longitude + 180.0;
+    latNode = std::min((int) std::floor(lat), LAT_NODES - 2);
+    lonNode = (int) std::floor(lon);
+    latFrac = lat - latNode;
+    lonFrac = lon - lonNode;
+}
+
+void MagVarCache::fillNodes(const Locations &locations) {
+    std::vector<int> missing;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &loc: locations) {
+            int latNode, lonNode;
+            double latFrac, lonFrac;
+            cellOf(loc.first, loc.second, latNode, lonNode, latFrac, lonFrac);
+            for (int i: {nodeIndex(latNode, lonNode), nodeIndex(latNode, lonNode + 1),
+                         nodeIndex(latNode + 1, lonNode), nodeIndex(latNode + 1, lonNode + 1)}) {
+                if (!known[i]) {
+                    missing.push_back(i);
+                }
+            }
+        }
+    }
+
+    if (missing.empty()) {
+        return;
+    }
+
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+    // sampled without holding the lock because the sampler may have to wait for the simulator
+    Locations nodes;
+    nodes.reserve(missing.size());
+    for (int i: missing) {
+        nodes.emplace_back(i / LON_NODES - 90.0, i % LON_NODES - 180.0);
+    }
+    auto values = sampler(nodes);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t k = 0; k < missing.size(); k++) {
+        grid[missing[k]] = values[nodes[k]];
+        known[missing[k]] = true;
+    }
+}
+
+double MagVarCache::interpolate(double latitude, double longitude) const {
+    int latNode, lonNode;
+    double latFrac, lonFrac;
+    cellOf(latitude, longitude, latNode, lonNode, latFrac, lonFrac);
+
+    double v00 = grid[nodeIndex(latNode, lonNode)];
+    double v01 = grid[nodeIndex(latNode, lonNode + 1)];
+    double v10 = grid[nodeIndex(latNode + 1, lonNode)];
+    double v11 = grid[nodeIndex(latNode + 1, lonNode + 1)];
+
+    // near the magnetic poles neighbouring nodes can straddle +-180, so unwrap around the first corner
+    auto unwrap = [v00] (double v) {
+        return v00 + std::remainder(v - v00, 360.0);
+    };
+    v01 = unwrap(v01);
+    v10 = unwrap(v10);
+    v11 = unwrap(v11);
+
+    double south = v00 + (v01 - v00) * lonFrac;
+    double north = v10 + (v11 - v10) * lonFrac;
+    double res = south + (north - south) * latFrac;
+    return std::remainder(res, 360.0);
+}
+
+} /* namespace avitab */
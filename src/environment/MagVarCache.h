@@ -0,0 +1,61 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace avitab {
+
+/**
+ * Magnetic variation on a 1 degree grid. The grid nodes are sampled lazily
+ * in a single batch through the environment's own lookup and kept for the
+ * whole session, so repeated and bulk queries from any thread are answered
+ * by bilinear interpolation without another round-trip into the simulator.
+ */
+class MagVarCache {
+public:
+    using Locations = std::vector<std::pair<double, double>>;
+    using MagVarMap = std::map<std::pair<double, double>, double>;
+    using Sampler = std::function<MagVarMap(Locations)>;
+
+    explicit MagVarCache(Sampler sampler);
+
+    // latitude, longitude pairs in degrees, variations in degrees east
+    MagVarMap lookup(const Locations &locations);
+    double lookup(double latitude, double longitude);
+
+private:
+    static constexpr int LAT_NODES = 181;
+    static constexpr int LON_NODES = 360;
+
+    Sampler sampler;
+    std::mutex mutex;
+    std::vector<float> grid;
+    std::vector<bool> known;
+
+    static int nodeIndex(int latNode, int lonNode);
+    static void cellOf(double latitude, double longitude, int &latNode, int &lonNode, double &latFrac, double &lonFrac);
+    void fillNodes(const Locations &locations);
+    double interpolate(double latitude, double longitude) const;
+};
+
+} /* namespace avitab */
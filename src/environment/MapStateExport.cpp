@@ -0,0 +1,75 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+#include "MapStateExport.h"
+
+namespace avitab {
+
+// other processes see the same sequence counter, so it can't use a hidden lock
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "sequence must be lock free");
+static_assert(std::is_standard_layout<MapStateExport::Layout>::value, "layout is shared with other programs");
+
+MapStateExport::MapStateExport():
+    memory(NAME, sizeof(Layout)),
+    layout(new (memory.data()) Layout())
+{
+    layout->magic = MAGIC;
+    layout->version = VERSION;
+    layout->size = sizeof(Layout);
+}
+
+void MapStateExport::publish(const MapState &state) {
+    layout->sequence.store(++sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    layout->centerLat = state.centerLat;
+    layout->centerLon = state.centerLon;
+    layout->minLat = state.minLat;
+    layout->minLon = state.minLon;
+    layout->maxLat = state.maxLat;
+    layout->maxLon = state.maxLon;
+    layout->verticalRange = state.verticalRange;
+    layout->rotation = state.rotation;
+    layout->zoom = state.zoom;
+
+    size_t aircraftCount = std::min(state.aircraft.size(), MAX_AIRCRAFT);
+    for (size_t i = 0; i < aircraftCount; i++) {
+        auto &from = state.aircraft[i];
+        layout->aircraft[i] = { from.latitude, from.longitude, from.elevation, from.heading };
+    }
+    layout->aircraftCount = aircraftCount;
+
+    size_t routeCount = std::min(state.route.size(), MAX_ROUTE_POINTS);
+    for (size_t i = 0; i < routeCount; i++) {
+        auto &from = state.route[i];
+        auto &to = layout->route[i];
+        to.latitude = from.latitude;
+        to.longitude = from.longitude;
+        size_t len = std::min(from.ident.size(), IDENT_LENGTH - 1);
+        std::memcpy(to.ident, from.ident.data(), len);
+        std::memset(to.ident + len, 0, IDENT_LENGTH - len);
+    }
+    layout->routePointCount = routeCount;
+
+    layout->sequence.store(++sequence, std::memory_order_release);
+}
+
+} /* namespace avitab */
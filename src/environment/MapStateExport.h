@@ -0,0 +1,120 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include "src/platform/SharedMemory.h"
+
+namespace avitab {
+
+// What the map app shows, in the units of the map
+struct MapState {
+    struct Aircraft {
+        double latitude, longitude;
+        float elevation, heading;
+    };
+    struct RoutePoint {
+        double latitude, longitude;
+        std::string ident;
+    };
+
+    double centerLat = 0, centerLon = 0;
+    int zoom = 0;
+    float verticalRange = 0;
+    // clockwise in degrees
+    float rotation = 0;
+    double minLat = 0, minLon = 0, maxLat = 0, maxLon = 0;
+    // the user's aircraft first
+    std::vector<Aircraft> aircraft;
+    std::vector<RoutePoint> route;
+};
+
+/*
+ * Publishes the map state in shared memory so that other programs can follow
+ * the tablet without going through the simulator, e.g. moving maps or home
+ * cockpit displays. The memory is named "AviTabMapState" and holds one Layout,
+ * fixed-size and little endian. It shows the main tablet's map only, the other
+ * tablets don't publish. That single writer updates it with a seqlock,
+ * readers never block it and copy the layout like this:
+ *
+ *   do {
+ *       s1 = sequence (acquire)
+ *       copy the fields
+ *       acquire fence
+ *       s2 = sequence (relaxed)
+ *   } while (s1 is odd || s1 != s2)
+ *
+ * Lists longer than the arrays are cut off, the counts are never larger.
+ */
+class MapStateExport {
+public:
+    static constexpr const char *NAME = "AviTabMapState";
+    static constexpr const uint32_t MAGIC = 0x534d5641; // "AVMS"
+    static constexpr const uint32_t VERSION = 1;
+    static constexpr const size_t MAX_AIRCRAFT = 64;
+    static constexpr const size_t MAX_ROUTE_POINTS = 128;
+    static constexpr const size_t IDENT_LENGTH = 16;
+
+    struct Aircraft {
+        double latitude, longitude;
+        float elevation, heading;
+    };
+
+    struct RoutePoint {
+        double latitude, longitude;
+        // zero terminated, cut off if longer
+        char ident[IDENT_LENGTH];
+    };
+
+    struct Layout {
+        uint32_t magic;
+        uint32_t version;
+        // odd while the writer changes the fields below
+        std::atomic<uint32_t> sequence;
+        // of the whole layout, newer versions only append
+        uint32_t size;
+
+        double centerLat, centerLon;
+        double minLat, minLon, maxLat, maxLon;
+        float verticalRange;
+        float rotation;
+        int32_t zoom;
+        uint32_t aircraftCount;
+        uint32_t routePointCount;
+        uint32_t reserved;
+        Aircraft aircraft[MAX_AIRCRAFT];
+        RoutePoint route[MAX_ROUTE_POINTS];
+    };
+
+    // throws if the shared memory can't be created
+    MapStateExport();
+
+    // from a single thread
+    void publish(const MapState &state);
+
+private:
+    platform::SharedMemory memory;
+    Layout *layout;
+    uint32_t sequence = 0;
+};
+
+} /* namespace avitab */
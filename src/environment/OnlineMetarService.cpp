@@ -0,0 +1,316 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+#include <zlib.h>
+#include "OnlineMetarService.h"
+#include "src/charts/RESTClient.h"
+#include "src/platform/Platform.h"
+#include "src/platform/CrashHandler.h"
+#include "src/Logger.h"
+
+namespace avitab {
+
+// Inflates a gzipped CSV file as it arrives and indexes its rows by station
+class OnlineMetarService::BulkParser {
+    enum Column { STATION, TIME, LATITUDE, LONGITUDE, CATEGORY, WIND_DIR, WIND_SPEED, NUM_COLUMNS };
+
+public:
+    BulkParser(Index &index, Kind kind):
+        index(index),
+        timeColumn((kind == Kind::METAR) ? "observation_time" : "issue_time")
+    {
+        // 16: gzip header instead of zlib
+        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+            throw std::runtime_error("Can't initialize inflate");
+        }
+    }
+
+    void feed(const uint8_t *data, size_t size) {
+        stream.next_in = const_cast<Bytef *>(data);
+        stream.avail_in = size;
+        do {
+            stream.next_out = out;
+            stream.avail_out = sizeof(out);
+            int ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                throw std::runtime_error("Corrupt gzip data");
+            }
+            addText(reinterpret_cast<const char *>(out), sizeof(out) - stream.avail_out);
+            complete = (ret == Z_STREAM_END);
+            if (complete && stream.avail_in > 0) {
+                // concatenated gzip members
+                inflateReset(&stream);
+            } else if (complete || ret == Z_BUF_ERROR) {
+                break;
+            }
+        } while (stream.avail_in > 0 || stream.avail_out == 0);
+    }
+
+    void finish() {
+        if (!complete) {
+            throw std::runtime_error("Truncated gzip data");
+        }
+        if (!line.empty()) {
+            addLine();
+        }
+    }
+
+    ~BulkParser() {
+        inflateEnd(&stream);
+    }
+
+private:
+    Index &index;
+    std::string timeColumn;
+    z_stream stream {};
+    Bytef out[64 * 1024];
+    bool complete = false;
+    std::string line;
+    std::vector<std::string> fields;
+    int columns[NUM_COLUMNS] = { -1, -1, -1, -1, -1, -1, -1 };
+
+    void addText(const char *text, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            if (text[i] == '\n') {
+                addLine();
+            } else if (text[i] != '\r') {
+                line += text[i];
+            }
+        }
+    }
+
+    void addLine() {
+        fields.clear();
+        size_t start = 0;
+        while (true) {
+            size_t comma = line.find(',', start);
+            fields.push_back(line.substr(start, comma - start));
+            if (comma == std::string::npos) {
+                break;
+            }
+            start = comma + 1;
+        }
+        line.clear();
+
+        // a few lines of status messages come before the column names
+        if (fields.front() == "raw_text") {
+            const char *names[NUM_COLUMNS] = { "station_id", timeColumn.c_str(), "latitude", "longitude",
+                                               "flight_category", "wind_dir_degrees", "wind_speed_kt" };
+            for (size_t i = 0; i < fields.size(); i++) {
+                for (int c = 0; c < NUM_COLUMNS; c++) {
+                    if (fields[i] == names[c]) {
+                        columns[c] = i;
+                    }
+                }
+            }
+            return;
+        }
+        if (columns[STATION] < 0 || columns[TIME] < 0) {
+            return;
+        }
+
+        // ISO 8601 times, so the newest report compares greatest
+        auto &entry = index[field(STATION)];
+        if (field(TIME) < entry.time) {
+            return;
+        }
+        entry.text = fields.front();
+        entry.time = field(TIME);
+
+        // the position and weather of the station as given, the category isn't parsed from the text
+        auto &station = entry.station;
+        station.latitude = std::strtof(field(LATITUDE).c_str(), nullptr);
+        station.longitude = std::strtof(field(LONGITUDE).c_str(), nullptr);
+        station.category = WeatherStations::parseCategory(field(CATEGORY));
+        const std::string &windDir = field(WIND_DIR);
+        station.windDirection = (windDir.empty() || windDir == "VRB") ? -1 : std::atoi(windDir.c_str());
+        station.windSpeed = std::atoi(field(WIND_SPEED).c_str());
+        entry.located = !field(LATITUDE).empty() && !field(LONGITUDE).empty();
+    }
+
+    const std::string &field(Column c) const {
+        static const std::string missing;
+        int i = columns[c];
+        return (i >= 0 && i < (int) fields.size()) ? fields[i] : missing;
+    }
+};
+
+OnlineMetarService::OnlineMetarService(const std::string &cacheDir):
+    cacheDir(cacheDir),
+    metars(std::make_shared<const Index>()),
+    tafs(std::make_shared<const Index>()),
+    stations(std::make_shared<const WeatherStations>())
+{
+}
+
+OnlineMetarService::~OnlineMetarService() {
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        stopRequested = true;
+        cancelDownload = true;
+        control.notify_one();
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void OnlineMetarService::start() {
+    if (!worker.joinable()) {
+        worker = std::thread(&OnlineMetarService::run, this);
+    }
+}
+
+void OnlineMetarService::requestUpdate() {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    updateRequested = true;
+    control.notify_one();
+}
+
+bool OnlineMetarService::getReport(const std::string &icao, Report &report) const {
+    std::string id = platform::upper(icao);
+    report = {};
+
+    auto metarIndex = std::atomic_load(&metars);
+    auto metar = metarIndex->find(id);
+    if (metar != metarIndex->end()) {
+        report.metar = metar->second.text;
+        report.observed = metar->second.time;
+    }
+
+    auto tafIndex = std::atomic_load(&tafs);
+    auto taf = tafIndex->find(id);
+    if (taf != tafIndex->end()) {
+        report.taf = taf->second.text;
+    }
+
+    return !report.metar.empty() || !report.taf.empty();
+}
+
+size_t OnlineMetarService::getStationCount() const {
+    return std::atomic_load(&metars)->size();
+}
+
+std::shared_ptr<const WeatherStations> OnlineMetarService::getStations() const {
+    return std::atomic_load(&stations);
+}
+
+void OnlineMetarService::run() {
+    crash::ThreadCookie crashCookie;
+
+    loadCache(Kind::METAR);
+    loadCache(Kind::TAF);
+
+    while (!stopRequested) {
+        download(Kind::METAR);
+        download(Kind::TAF);
+
+        std::unique_lock<std::mutex> lock(controlMutex);
+        control.wait_for(lock, UPDATE_INTERVAL, [this] { return updateRequested || stopRequested; });
+        updateRequested = false;
+    }
+}
+
+void OnlineMetarService::download(Kind kind) {
+    std::string file = getCacheFile(kind);
+
+    try {
+        auto startAt = std::chrono::steady_clock::now();
+        auto index = std::make_shared<Index>();
+        BulkParser parser(*index, kind);
+
+        // the compressed file is kept as it came, a failed download never replaces a good cache
+        platform::mkpath(cacheDir);
+        platform::writeFileAtomically(file, [this, kind, &parser] (std::ostream &stream) {
+            apis::RESTClient client;
+            client.setVerbose(false);
+            client.getStreamed(getURL(kind), cancelDownload, [&stream, &parser] (const uint8_t *data, size_t size) {
+                stream.write(reinterpret_cast<const char *>(data), size);
+                parser.feed(data, size);
+            });
+            parser.finish();
+        });
+
+        size_t count = index->size();
+        publish(kind, index);
+
+        auto duration = std::chrono::steady_clock::now() - startAt;
+        logger::verbose("Downloaded %s of %d stations in %d millis", (kind == Kind::METAR) ? "METARs" : "TAFs",
+            (int) count, (int) std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+    } catch (const std::exception &e) {
+        // the previous reports stay until the next interval
+        logger::warn("Couldn't download %s: %s", getURL(kind), e.what());
+    }
+}
+
+void OnlineMetarService::loadCache(Kind kind) {
+    std::string file = getCacheFile(kind);
+    std::error_code ec;
+    auto modified = fs::last_write_time(fs::u8path(file), ec);
+    if (ec || fs::file_time_type::clock::now() - modified > MAX_CACHE_AGE) {
+        return;
+    }
+
+    try {
+        auto index = std::make_shared<Index>();
+        BulkParser parser(*index, kind);
+        fs::ifstream stream(fs::u8path(file), std::ios::in | std::ios::binary);
+        std::vector<char> buf(64 * 1024);
+        while (stream.read(buf.data(), buf.size()) || stream.gcount() > 0) {
+            parser.feed(reinterpret_cast<const uint8_t *>(buf.data()), stream.gcount());
+        }
+        parser.finish();
+
+        publish(kind, index);
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't load cached weather %s: %s", file.c_str(), e.what());
+    }
+}
+
+void OnlineMetarService::publish(Kind kind, std::shared_ptr<const Index> index) {
+    if (kind == Kind::TAF) {
+        std::atomic_store(&tafs, index);
+        return;
+    }
+
+    // the map's view of the weather is built once per refresh, not on each frame
+    auto grid = std::make_shared<WeatherStations>();
+    for (auto &it: *index) {
+        if (it.second.located) {
+            grid->add(it.second.station);
+        }
+    }
+    std::atomic_store(&metars, index);
+    std::atomic_store(&stations, std::shared_ptr<const WeatherStations>(grid));
+}
+
+const char *OnlineMetarService::getURL(Kind kind) {
+    switch (kind) {
+    case Kind::METAR:   return "https://aviationweather.gov/data/cache/metars.cache.csv.gz";
+    case Kind::TAF:     return "https://aviationweather.gov/data/cache/tafs.cache.csv.gz";
+    }
+    return "";
+}
+
+std::string OnlineMetarService::getCacheFile(Kind kind) const {
+    return cacheDir + ((kind == Kind::METAR) ? "metars.cache.csv.gz" : "tafs.cache.csv.gz");
+}
+
+} /* namespace avitab */
@@ -0,0 +1,104 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "WeatherStations.h"
+
+namespace avitab {
+
+/*
+ * METARs and TAFs of all stations worldwide, taken from the bulk files that
+ * aviationweather.gov refreshes every few minutes. A worker downloads them
+ * periodically and inflates and indexes them while they arrive. Lookups only
+ * read the latest complete index, so they never wait for the network.
+ */
+class OnlineMetarService {
+public:
+    struct Report {
+        std::string metar;
+        std::string observed;   // observation time of the METAR, e.g. 2024-05-01T12:20:00Z
+        std::string taf;
+    };
+
+    // The downloaded files are kept in cacheDir, so that recent reports are
+    // available right after a restart
+    explicit OnlineMetarService(const std::string &cacheDir);
+    ~OnlineMetarService();
+
+    // Loads the cached files and starts the worker
+    void start();
+
+    // Returns immediately, the worker downloads as soon as possible
+    void requestUpdate();
+
+    // Can be called from any thread, false if neither METAR nor TAF are known
+    bool getReport(const std::string &icao, Report &report) const;
+    size_t getStationCount() const;
+    // the latest located METARs by position, for drawing them on maps
+    std::shared_ptr<const WeatherStations> getStations() const;
+
+private:
+    static constexpr const auto UPDATE_INTERVAL = std::chrono::minutes(10);
+    // cached files older than this are outdated and not loaded at startup
+    static constexpr const auto MAX_CACHE_AGE = std::chrono::hours(3);
+
+    struct Entry {
+        std::string text;
+        std::string time;
+        WeatherStations::Station station {};
+        bool located = false;
+    };
+    using Index = std::unordered_map<std::string, Entry>;
+
+    enum class Kind {
+        METAR,
+        TAF
+    };
+    class BulkParser;
+
+    std::string cacheDir;
+
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<const Index> metars;
+    std::shared_ptr<const Index> tafs;
+    std::shared_ptr<const WeatherStations> stations;
+
+    std::mutex controlMutex;
+    std::condition_variable control;
+    bool updateRequested = false;
+    std::atomic_bool stopRequested { false };
+    bool cancelDownload = false;
+    std::thread worker;
+
+    void run();
+    void download(Kind kind);
+    void loadCache(Kind kind);
+    void publish(Kind kind, std::shared_ptr<const Index> index);
+    static const char *getURL(Kind kind);
+    std::string getCacheFile(Kind kind) const;
+};
+
+} /* namespace avitab */
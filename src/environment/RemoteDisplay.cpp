@@ -0,0 +1,535 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#ifndef _POSIX_SOURCE
+#define _POSIX_SOURCE
+#endif
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+#include "RemoteDisplay.h"
+#include "src/Logger.h"
+#include "src/platform/CrashHandler.h"
+
+#ifdef WIN32
+#include <windows.h>
+// close doesn't actually close sockets on Windows, there's a special API function for that <3
+#define close closesocket
+typedef int socklen_t;
+#endif
+
+#ifdef MSG_NOSIGNAL
+constexpr const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr const int SEND_FLAGS = 0;
+#endif
+
+namespace avitab {
+
+RemoteDisplay::RemoteDisplay(int port, const std::string &bindAddress, const std::string &token):
+    token(token)
+{
+    // the client drives the whole tablet, so it has to prove that it was set up by the user
+    if (token.empty()) {
+        throw std::runtime_error("Remote display needs a remoteDisplayToken");
+    }
+
+    sockaddr_in serverAddr {};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = inet_addr(bindAddress.c_str());
+    serverAddr.sin_port = htons(port);
+    if (serverAddr.sin_addr.s_addr == INADDR_NONE) {
+        throw std::runtime_error("Invalid remote display address " + bindAddress);
+    }
+
+    srvSock = socket(AF_INET, SOCK_STREAM, 0);
+    if (srvSock < 0) {
+        throw std::runtime_error("Couldn't create remote display socket");
+    }
+
+    int val = 1;
+    (void) setsockopt(srvSock, SOL_SOCKET, SO_REUSEADDR, (char *) &val, sizeof(val));
+
+    if (bind(srvSock, (sockaddr *) &serverAddr, sizeof(serverAddr)) < 0) {
+        close(srvSock);
+        throw std::runtime_error("Couldn't bind remote display socket to port " + std::to_string(port));
+    }
+
+    if (listen(srvSock, 2) < 0) {
+        close(srvSock);
+        throw std::runtime_error("Couldn't listen on remote display socket");
+    }
+
+    logger::info("Remote display listening on %s:%d", bindAddress.c_str(), port);
+    serverThread = std::make_unique<std::thread>(&RemoteDisplay::loop, this);
+}
+
+void RemoteDisplay::setInputCallback(InputCallback cb) {
+    std::lock_guard<std::mutex> lock(pointerMutex);
+    onInput = cb;
+}
+
+bool RemoteDisplay::hasClient() const {
+    return connected;
+}
+
+void RemoteDisplay::onBlit(int screenWidth, int screenHeight, int x1, int y1, int x2, int y2, const uint32_t *data) {
+    std::lock_guard<std::mutex> lock(frameMutex);
+    if (screenWidth != shadowWidth || screenHeight != shadowHeight) {
+        shadowWidth = screenWidth;
+        shadowHeight = screenHeight;
+        shadow.assign((size_t) shadowWidth * shadowHeight, 0);
+        sizeChanged = true;
+        dirty.clear();
+        addDirty(Rect {0, 0, shadowWidth - 1, shadowHeight - 1});
+    }
+
+    int cx1 = std::max(x1, 0);
+    int cy1 = std::max(y1, 0);
+    int cx2 = std::min(x2, shadowWidth - 1);
+    int cy2 = std::min(y2, shadowHeight - 1);
+    if (cx1 > cx2 || cy1 > cy2) {
+        return;
+    }
+
+    int stride = x2 - x1 + 1;
+    for (int y = cy1; y <= cy2; y++) {
+        const uint32_t *src = data + (y - y1) * stride + (cx1 - x1);
+        std::copy(src, src + (cx2 - cx1 + 1), shadow.begin() + (size_t) y * shadowWidth + cx1);
+    }
+
+    if (connected) {
+        addDirty(Rect {cx1, cy1, cx2, cy2});
+    }
+}
+
+void RemoteDisplay::addDirty(const Rect &rect) {
+    dirty.push_back(rect);
+    if (dirty.size() > MAX_DIRTY_RECTS) {
+        Rect bounds = dirty.front();
+        for (auto &r: dirty) {
+            bounds.x1 = std::min(bounds.x1, r.x1);
+            bounds.y1 = std::min(bounds.y1, r.y1);
+            bounds.x2 = std::max(bounds.x2, r.x2);
+            bounds.y2 = std::max(bounds.y2, r.y2);
+        }
+        dirty.assign(1, bounds);
+    }
+}
+
+void RemoteDisplay::onFrameFinished() {
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        if (dirty.empty() && !sizeChanged) {
+            return;
+        }
+        frameReady = true;
+    }
+    frameCondition.notify_one();
+}
+
+void RemoteDisplay::mergePointerState(int &x, int &y, bool &pressed) {
+    if (!connected) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pointerMutex);
+    auto idle = std::chrono::steady_clock::now() - pointerAt;
+    if (pointerPressed || idle < std::chrono::milliseconds(POINTER_HOLD_MS)) {
+        x = pointerX;
+        y = pointerY;
+        pressed = pointerPressed;
+    }
+}
+
+void RemoteDisplay::loop() {
+    crash::ThreadCookie crashCookie;
+
+    int client = -1;
+    while (keepAlive) {
+        if (client < 0) {
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            FD_SET(srvSock, &readSet);
+
+            timeval timeout {};
+            timeout.tv_usec = 1000 * 100;
+            if (select(srvSock + 1, &readSet, nullptr, nullptr, &timeout) < 0) {
+                break;
+            }
+            if (!FD_ISSET(srvSock, &readSet)) {
+                continue;
+            }
+            client = admitClient();
+            if (client < 0) {
+                continue;
+            }
+        }
+
+        {
+            // the new client starts with the whole screen
+            std::lock_guard<std::mutex> lock(frameMutex);
+            dirty.clear();
+            if (shadowWidth > 0 && shadowHeight > 0) {
+                addDirty(Rect {0, 0, shadowWidth - 1, shadowHeight - 1});
+                sizeChanged = true;
+                frameReady = true;
+            }
+            connected = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(clientMutex);
+            activeClient = client;
+        }
+        int next = serveClient(client);
+
+        connected = false;
+        {
+            std::lock_guard<std::mutex> lock(clientMutex);
+            activeClient = -1;
+            shutdown(client, 2);
+            close(client);
+        }
+        logger::info("Remote display client disconnected");
+        client = next;
+    }
+
+    if (client >= 0) {
+        close(client);
+    }
+    close(srvSock);
+}
+
+int RemoteDisplay::admitClient() {
+    sockaddr_in clientAddr {};
+    socklen_t clientLen = sizeof(clientAddr);
+    int client = accept(srvSock, (sockaddr *) &clientAddr, &clientLen);
+    if (client < 0) {
+        return -1;
+    }
+
+    int val = 1;
+    (void) setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (char *) &val, sizeof(val));
+#ifdef SO_NOSIGPIPE
+    (void) setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, (char *) &val, sizeof(val));
+#endif
+    // a client that stops reading makes send fail instead of blocking forever
+#ifdef WIN32
+    DWORD sendTimeout = SEND_TIMEOUT_MS;
+#else
+    timeval sendTimeout {};
+    sendTimeout.tv_sec = SEND_TIMEOUT_MS / 1000;
+    sendTimeout.tv_usec = (SEND_TIMEOUT_MS % 1000) * 1000;
+#endif
+    (void) setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (char *) &sendTimeout, sizeof(sendTimeout));
+
+    if (!authenticate(client)) {
+        logger::warn("Remote display client %s sent no valid token", inet_ntoa(clientAddr.sin_addr));
+        shutdown(client, 2);
+        close(client);
+        return -1;
+    }
+
+    logger::info("Remote display client %s connected", inet_ntoa(clientAddr.sin_addr));
+    return client;
+}
+
+bool RemoteDisplay::authenticate(int client) {
+    // 'K', u8 length, token, all within AUTH_TIMEOUT_MS
+    std::vector<uint8_t> in;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(AUTH_TIMEOUT_MS);
+    while (keepAlive) {
+        if (in.size() >= 2 && (in[0] != 'K' || in.size() > (size_t) in[1] + 2)) {
+            return false;
+        }
+        if (in.size() >= 2 && in.size() == (size_t) in[1] + 2) {
+            break;
+        }
+
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return false;
+        }
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(client, &readSet);
+        timeval timeout {};
+        timeout.tv_sec = left.count() / 1000000;
+        timeout.tv_usec = left.count() % 1000000;
+        if (select(client + 1, &readSet, nullptr, nullptr, &timeout) <= 0) {
+            return false;
+        }
+
+        // only read what belongs to the handshake, pointer messages may follow it
+        uint8_t buf[256];
+        size_t want = (in.size() < 2) ? 2 - in.size() : in[1] + 2 - in.size();
+        int n = recv(client, (char *) buf, want, 0);
+        if (n <= 0) {
+            return false;
+        }
+        in.insert(in.end(), buf, buf + n);
+    }
+    if (!keepAlive || in[1] != token.size()) {
+        return false;
+    }
+
+    // compare in constant time, so the token can't be guessed byte by byte
+    uint8_t diff = 0;
+    for (size_t i = 0; i < token.size(); i++) {
+        diff |= in[i + 2] ^ (uint8_t) token[i];
+    }
+    return diff == 0;
+}
+
+int RemoteDisplay::serveClient(int client) {
+    std::vector<uint8_t> out, in;
+    int fdMax = std::max(client, srvSock);
+
+    while (keepAlive) {
+        {
+            std::unique_lock<std::mutex> lock(frameMutex);
+            frameCondition.wait_for(lock, std::chrono::milliseconds(FRAME_WAIT_MS),
+                    [this] { return frameReady || !keepAlive; });
+        }
+
+        if (!sendFrame(client, out)) {
+            return -1;
+        }
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(client, &readSet);
+        FD_SET(srvSock, &readSet);
+        timeval timeout {};
+        if (select(fdMax + 1, &readSet, nullptr, nullptr, &timeout) < 0) {
+            return -1;
+        }
+        if (FD_ISSET(client, &readSet) && !readInput(client, in)) {
+            return -1;
+        }
+        if (FD_ISSET(srvSock, &readSet)) {
+            // another device wants the display, it replaces this one if it has the token
+            int next = admitClient();
+            if (next >= 0) {
+                return next;
+            }
+        }
+    }
+    return -1;
+}
+
+bool RemoteDisplay::sendFrame(int client, std::vector<uint8_t> &out) {
+    auto put16 = [&out] (uint32_t v) {
+        out.push_back(v & 0xFF);
+        out.push_back((v >> 8) & 0xFF);
+    };
+    auto put32 = [&out, &put16] (uint32_t v) {
+        put16(v & 0xFFFF);
+        put16(v >> 16);
+    };
+
+    std::vector<Rect> rects;
+    std::vector<std::vector<uint32_t>> pixels;
+    bool sendSize;
+    int width, height;
+    {
+        // only the copies are made under the lock, the GUI doesn't wait for the encoder
+        std::lock_guard<std::mutex> lock(frameMutex);
+        if (!frameReady) {
+            return true;
+        }
+        rects.swap(dirty);
+        sendSize = sizeChanged;
+        width = shadowWidth;
+        height = shadowHeight;
+        frameReady = false;
+        sizeChanged = false;
+
+        for (auto &r: rects) {
+            int w = r.x2 - r.x1 + 1;
+            pixels.emplace_back((size_t) w * (r.y2 - r.y1 + 1));
+            auto dst = pixels.back().begin();
+            for (int y = r.y1; y <= r.y2; y++) {
+                auto src = shadow.begin() + (size_t) y * shadowWidth + r.x1;
+                dst = std::copy(src, src + w, dst);
+            }
+        }
+    }
+
+    out.clear();
+    if (sendSize) {
+        out.insert(out.end(), {'A', 'V', 'T', '1'});
+        put16(width);
+        put16(height);
+    }
+    std::vector<uint8_t> image;
+    for (size_t i = 0; i < rects.size(); i++) {
+        auto &r = rects[i];
+        encodeQOI(pixels[i].data(), r.x2 - r.x1 + 1, r.y2 - r.y1 + 1, image);
+        out.push_back('R');
+        put16(r.x1);
+        put16(r.y1);
+        put32(image.size());
+        out.insert(out.end(), image.begin(), image.end());
+    }
+    out.push_back('F');
+
+    size_t sent = 0;
+    while (sent < out.size() && keepAlive) {
+        int n = send(client, (const char *) out.data() + sent, out.size() - sent, SEND_FLAGS);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+bool RemoteDisplay::readInput(int client, std::vector<uint8_t> &in) {
+    constexpr const size_t POINTER_MESSAGE_SIZE = 6;
+
+    char buf[256];
+    int n = recv(client, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        return false;
+    }
+    in.insert(in.end(), buf, buf + n);
+
+    size_t pos = 0;
+    bool gotInput = false;
+    while (pos < in.size()) {
+        if (in[pos] != 'P') {
+            logger::warn("Remote display client sent unknown message %d", in[pos]);
+            return false;
+        }
+        if (in.size() - pos < POINTER_MESSAGE_SIZE) {
+            break;
+        }
+        std::lock_guard<std::mutex> lock(pointerMutex);
+        pointerX = in[pos + 1] | (in[pos + 2] << 8);
+        pointerY = in[pos + 3] | (in[pos + 4] << 8);
+        pointerPressed = in[pos + 5] != 0;
+        pointerAt = std::chrono::steady_clock::now();
+        pos += POINTER_MESSAGE_SIZE;
+        gotInput = true;
+    }
+    in.erase(in.begin(), in.begin() + pos);
+
+    if (gotInput) {
+        InputCallback cb;
+        {
+            std::lock_guard<std::mutex> lock(pointerMutex);
+            cb = onInput;
+        }
+        if (cb) {
+            cb();
+        }
+    }
+    return true;
+}
+
+void RemoteDisplay::encodeQOI(const uint32_t *pixels, int width, int height, std::vector<uint8_t> &out) {
+    // "Quite OK Image" format, see qoiformat.org. Lossless, and fast enough
+    // to encode on every frame as the GUI is mostly runs of the same colour.
+    auto put32be = [&out] (uint32_t v) {
+        out.push_back(v >> 24);
+        out.push_back((v >> 16) & 0xFF);
+        out.push_back((v >> 8) & 0xFF);
+        out.push_back(v & 0xFF);
+    };
+
+    out.clear();
+    out.insert(out.end(), {'q', 'o', 'i', 'f'});
+    put32be(width);
+    put32be(height);
+    out.push_back(4); // RGBA
+    out.push_back(0); // sRGB
+
+    uint32_t index[64] {};
+    uint32_t prev = 0xFF000000;
+    int run = 0;
+    size_t count = (size_t) width * height;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t px = pixels[i];
+        if (px == prev) {
+            if (++run == 62) {
+                out.push_back(0xC0 | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(0xC0 | (run - 1));
+            run = 0;
+        }
+
+        uint8_t a = px >> 24, r = (px >> 16) & 0xFF, g = (px >> 8) & 0xFF, b = px & 0xFF;
+        int hash = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+        if (index[hash] == px) {
+            out.push_back(hash);
+        } else if (a == (prev >> 24)) {
+            index[hash] = px;
+            int8_t dr = r - ((prev >> 16) & 0xFF);
+            int8_t dg = g - ((prev >> 8) & 0xFF);
+            int8_t db = b - (prev & 0xFF);
+            int8_t drg = dr - dg;
+            int8_t dbg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                out.push_back(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+            } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+                out.push_back(0x80 | (dg + 32));
+                out.push_back(((drg + 8) << 4) | (dbg + 8));
+            } else {
+                out.insert(out.end(), {0xFE, r, g, b});
+            }
+        } else {
+            index[hash] = px;
+            out.insert(out.end(), {0xFF, r, g, b, a});
+        }
+        prev = px;
+    }
+    if (run > 0) {
+        out.push_back(0xC0 | (run - 1));
+    }
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+RemoteDisplay::~RemoteDisplay() {
+    keepAlive = false;
+    frameCondition.notify_all();
+    {
+        // ends a send that waits for the client
+        std::lock_guard<std::mutex> lock(clientMutex);
+        if (activeClient >= 0) {
+            shutdown(activeClient, 2);
+        }
+    }
+    if (serverThread) {
+        serverThread->join();
+    }
+}
+
+} /* namespace avitab */
@@ -0,0 +1,122 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <chrono>
+#include <string>
+
+namespace avitab {
+
+/*
+ * Streams the tablet to a client on another device and feeds its pointer back
+ * into the GUI. One client is served at a time, a new connection that presents
+ * the shared token replaces the current one. The GUI thread copies the areas it flushes into a shadow frame,
+ * the server thread sends the areas changed since its last frame as soon as
+ * the GUI finished one, so a slow client skips frames instead of queueing them.
+ *
+ * Protocol over TCP, integers little endian:
+ *   client: 'K', u8 length, token                      first message, else the
+ *                                                      server closes the connection
+ *   server: 'A' 'V' 'T' '1', u16 width, u16 height     on connect and resize
+ *           'R', u16 x, u16 y, u32 size, QOI image     changed area
+ *           'F'                                        end of frame, present it
+ *   client: 'P', u16 x, u16 y, u8 pressed              pointer state
+ */
+class RemoteDisplay {
+public:
+    using InputCallback = std::function<void()>;
+
+    // Listens on the given IPv4 address, only clients that send the token are
+    // served. Throws if the address or port can't be used or the token is empty.
+    RemoteDisplay(int port, const std::string &bindAddress, const std::string &token);
+
+    // called from any thread when the client sent input
+    void setInputCallback(InputCallback cb);
+
+    // GUI thread: a flushed area of a screen of the given size, then the end of the frame
+    void onBlit(int screenWidth, int screenHeight, int x1, int y1, int x2, int y2, const uint32_t *data);
+    void onFrameFinished();
+
+    // replaces the local pointer state while the client uses its pointer
+    void mergePointerState(int &x, int &y, bool &pressed);
+
+    bool hasClient() const;
+
+    ~RemoteDisplay();
+
+private:
+    // the client owns the pointer this long after its last event
+    static constexpr const int POINTER_HOLD_MS = 500;
+    // rects are merged into their bounds beyond this many per frame
+    static constexpr const size_t MAX_DIRTY_RECTS = 16;
+    // how long the server thread waits for a frame before it polls the client
+    static constexpr const int FRAME_WAIT_MS = 10;
+    // a client that doesn't authenticate or stops reading this long is dropped
+    static constexpr const int AUTH_TIMEOUT_MS = 1000;
+    static constexpr const int SEND_TIMEOUT_MS = 2000;
+
+    struct Rect {
+        int x1, y1, x2, y2;
+    };
+
+    int srvSock = -1;
+    const std::string token;
+    std::atomic_bool keepAlive { true };
+    // the client being served, shut down by the destructor to end a blocked send
+    std::mutex clientMutex;
+    int activeClient = -1;
+    std::unique_ptr<std::thread> serverThread;
+    InputCallback onInput;
+
+    // shadow of the screen and the areas the client hasn't seen yet
+    mutable std::mutex frameMutex;
+    std::condition_variable frameCondition;
+    std::vector<uint32_t> shadow;
+    int shadowWidth = 0, shadowHeight = 0;
+    std::vector<Rect> dirty;
+    bool frameReady = false;
+    bool sizeChanged = false;
+    std::atomic_bool connected { false };
+
+    // last pointer state sent by the client
+    std::mutex pointerMutex;
+    int pointerX = 0, pointerY = 0;
+    bool pointerPressed = false;
+    std::chrono::steady_clock::time_point pointerAt;
+
+    void loop();
+    int admitClient();
+    bool authenticate(int client);
+    // returns the authenticated client that replaces this one, or -1
+    int serveClient(int client);
+    bool sendFrame(int client, std::vector<uint8_t> &out);
+    bool readInput(int client, std::vector<uint8_t> &in);
+    void addDirty(const Rect &rect);
+
+    static void encodeQOI(const uint32_t *pixels, int width, int height, std::vector<uint8_t> &out);
+};
+
+} /* namespace avitab */
@@ -19,6 +19,8 @@
 #include <nlohmann/json.hpp>
 #include <iomanip>
 #include <sstream>
+#include <chrono>
+#include <stdexcept>
 #include "Settings.h"
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
@@ -43,6 +45,7 @@ Settings::Settings(const std::string &settingsFile)
     database = std::make_shared<json>();
     init();
     load();
+    saveThread = std::make_unique<std::thread>(&Settings::saveLoop, this);
 
     // Handle older json databases which have since been updated.
     // The version number is only changed if a setting has been moved, renamed, or removed.
@@ -68,8 +71,16 @@ Settings::Settings(const std::string &settingsFile)
 
 Settings::~Settings()
 {
+    {
+        std::lock_guard<std::mutex> lock(saveMutex);
+        stopSaving = true;
+    }
+    saveCondition.notify_one();
+    saveThread->join();
+
     try {
-        saveAll();
+        saveOverlayConfig();
+        writeFile();
     } catch (...) {
         // can't rescue the process at this point
     }
@@ -78,6 +89,7 @@ Settings::~Settings()
 template<>
 bool Settings::getGeneralSetting(const std::string &id) {
     json::json_pointer jp("/general/" + id);
+    std::lock_guard<std::mutex> lock(databaseMutex);
     bool b = database->value(jp, false);
     return b;
 }
@@ -108,12 +120,17 @@ std::shared_ptr<maps::OverlayConfig> Settings::getOverlayConfig() {
 
 template<typename T>
 T Settings::getSetting(const std::string &ptr, T def) {
+    std::lock_guard<std::mutex> lock(databaseMutex);
     return database->value(json::json_pointer(ptr), def);
 }
 
 template<typename T>
 void Settings::setSetting(const std::string &id, const T value) {
-    (*database)[json::json_pointer(id)] = value;
+    {
+        std::lock_guard<std::mutex> lock(databaseMutex);
+        (*database)[json::json_pointer(id)] = value;
+    }
+    scheduleSave();
 }
 
 void Settings::init() {
@@ -122,7 +139,10 @@ void Settings::init() {
                                  { "show_calibration_msg_on_load", true },
                                  { "show_overlays_in_airport_app", false },
                                  { "show_overlays_in_charts_app", false },
-                                 { "show_fps", true } } },
+                                 { "document_tile_cache", true },
+                                 { "show_fps", true },
+                                 { "gui_render_scale_percent", 100 },
+                                 { "map_prefetch_minutes", 5 } } },
                   { "overlay", { { "my_aircraft", true } } } };
 }
 
@@ -156,6 +176,9 @@ void Settings::loadOverlayConfig() {
     overlayConfig->drawPOIs = getSetting("/overlay/POIs", false);
     overlayConfig->drawVRPs = getSetting("/overlay/VRPs", false);
     overlayConfig->drawMarkers = getSetting("/overlay/markers", false);
+    overlayConfig->drawWeather = getSetting("/overlay/weather", false);
+    overlayConfig->frameBudgetMs = getSetting("/overlay/frame_budget_ms", 0);
+    overlayConfig->showTimings = getSetting("/overlay/show_timings", false);
     overlayConfig->colorOtherAircraftBelow = colorStringToInt(getSetting("/overlay/colors/other_aircraft/below", std::string("GREEN")), "GREEN");
     overlayConfig->colorOtherAircraftSame = colorStringToInt(getSetting("/overlay/colors/other_aircraft/same", std::string("BLACK")), "BLACK");
     overlayConfig->colorOtherAircraftAbove = colorStringToInt(getSetting("/overlay/colors/other_aircraft/above", std::string("BLUE")), "BLUE");
@@ -175,6 +198,9 @@ void Settings::saveOverlayConfig() {
     setSetting("/overlay/POIs", overlayConfig->drawPOIs);
     setSetting("/overlay/VRPs", overlayConfig->drawVRPs);
     setSetting("/overlay/markers", overlayConfig->drawMarkers);
+    setSetting("/overlay/weather", overlayConfig->drawWeather);
+    setSetting("/overlay/frame_budget_ms", overlayConfig->frameBudgetMs);
+    setSetting("/overlay/show_timings", overlayConfig->showTimings);
     setSetting("/overlay/colors/other_aircraft/below", colorIntToString(overlayConfig->colorOtherAircraftBelow));
     setSetting("/overlay/colors/other_aircraft/same", colorIntToString(overlayConfig->colorOtherAircraftSame));
     setSetting("/overlay/colors/other_aircraft/above", colorIntToString(overlayConfig->colorOtherAircraftAbove));
@@ -182,32 +208,41 @@ void Settings::saveOverlayConfig() {
 
 void Settings::loadDocReadingConfig(const std::string appName, DocumentReadingConfig &config) {
     config.mouseWheelScrollsMultiPage = getSetting("/" + appName + "/docreading/mousewheelscroll", false);
+    config.continuousScroll = getSetting("/" + appName + "/docreading/continuousscroll", false);
 }
 
 void Settings::saveDocReadingConfig(const std::string appName, DocumentReadingConfig &config) {
     setSetting("/" + appName + "/docreading/mousewheelscroll", config.mouseWheelScrollsMultiPage);
+    setSetting("/" + appName + "/docreading/continuousscroll", config.continuousScroll);
 }
 
-void Settings::saveWindowRect(const WindowRect &rect) {
-    setSetting("/window/top", rect.top);
-    setSetting("/window/left", rect.left);
-    setSetting("/window/right", rect.right);
-    setSetting("/window/bottom", rect.bottom);
-    setSetting("/window/popped", rect.poppedOut);
-    setSetting("/window/valid", rect.valid);
+void Settings::saveWindowRect(const WindowRect &rect, int tablet) {
+    std::string key = windowKey(tablet);
+    setSetting(key + "/top", rect.top);
+    setSetting(key + "/left", rect.left);
+    setSetting(key + "/right", rect.right);
+    setSetting(key + "/bottom", rect.bottom);
+    setSetting(key + "/popped", rect.poppedOut);
+    setSetting(key + "/valid", rect.valid);
 }
 
-WindowRect Settings::getWindowRect() {
+WindowRect Settings::getWindowRect(int tablet) {
+    std::string key = windowKey(tablet);
     WindowRect rect;
-    rect.valid = getSetting("/window/valid", false);
-    rect.top = getSetting("/window/top", 0);
-    rect.left = getSetting("/window/left", 0);
-    rect.right = getSetting("/window/right", 0);
-    rect.bottom = getSetting("/window/bottom", 0);
-    rect.poppedOut = getSetting("/window/popped", false);
+    rect.valid = getSetting(key + "/valid", false);
+    rect.top = getSetting(key + "/top", 0);
+    rect.left = getSetting(key + "/left", 0);
+    rect.right = getSetting(key + "/right", 0);
+    rect.bottom = getSetting(key + "/bottom", 0);
+    rect.poppedOut = getSetting(key + "/popped", false);
     return rect;
 }
 
+std::string Settings::windowKey(int tablet) {
+    // the main tablet keeps the key of the time before there were more
+    return (tablet == 1) ? "/window" : "/window_" + std::to_string(tablet);
+}
+
 void Settings::upgrade1to2() {
     // version 1 preferences used the key 'pdfreading' which was changed to 'docreading' in version 2
     // to reflect the more general capabilities of the document reading apps
@@ -223,12 +258,51 @@ void Settings::upgrade1to2() {
 }
 
 void Settings::saveAll() {
+    saveOverlayConfig();
+    scheduleSave();
+}
+
+void Settings::scheduleSave() {
+    {
+        std::lock_guard<std::mutex> lock(saveMutex);
+        savePending = true;
+    }
+    saveCondition.notify_one();
+}
+
+void Settings::saveLoop() {
+    std::unique_lock<std::mutex> lock(saveMutex);
+    while (!stopSaving) {
+        saveCondition.wait(lock, [this] { return savePending || stopSaving; });
+
+        // coalesce bursts like dragging the window or toggling several overlays
+        while (savePending && !stopSaving) {
+            savePending = false;
+            saveCondition.wait_for(lock, std::chrono::milliseconds(SAVE_DELAY_MS), [this] { return savePending || stopSaving; });
+        }
+        if (stopSaving) {
+            // the destructor writes the final state
+            break;
+        }
+
+        lock.unlock();
+        writeFile();
+        lock.lock();
+    }
+}
+
+void Settings::writeFile() {
+    std::string content;
+    {
+        std::lock_guard<std::mutex> lock(databaseMutex);
+        content = database->dump(4);
+    }
+
+    // a crash never leaves truncated settings behind
     try {
-        saveOverlayConfig();
-        fs::ofstream fout(fs::u8path(filePath));
-        fout << std::setw(4) << *database;
+        platform::writeFileAtomically(filePath, content.data(), content.size());
     } catch (const std::exception &e) {
-        LOG_ERROR("Could not save user settings to %s", filePath.c_str());
+        LOG_ERROR("Could not save user settings to %s: %s", filePath.c_str(), e.what());
     }
 }
 
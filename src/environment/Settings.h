@@ -21,6 +21,9 @@
 #include <nlohmann/json_fwd.hpp>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "src/environment/GUIDriver.h"
 #include "src/maps/OverlayConfig.h"
 
@@ -40,24 +43,41 @@ public:
 
     struct DocumentReadingConfig {
         bool mouseWheelScrollsMultiPage = false;
+        bool continuousScroll = false;
     };
     void loadDocReadingConfig(const std::string appName, DocumentReadingConfig &config);
     void saveDocReadingConfig(const std::string appName, DocumentReadingConfig &config);
 
-    void saveWindowRect(const WindowRect &rect);
-    WindowRect getWindowRect();
+    // per tablet, see AviTab's "tablets" config
+    void saveWindowRect(const WindowRect &rect, int tablet = 1);
+    WindowRect getWindowRect(int tablet = 1);
 
+    // Changes are written by a background thread once no further change followed
+    // for SAVE_DELAY_MS, the destructor writes pending changes right away
     void saveAll();
 
 private:
     void init();
     void upgrade1to2();
     void load();
-    void save();
+    void scheduleSave();
+    void saveLoop();
+    void writeFile();
+    static std::string windowKey(int tablet);
 
 private:
+    static constexpr const int SAVE_DELAY_MS = 1000;
+
     const std::string filePath;
+    // guards database against the GUI, environment and save threads
+    std::mutex databaseMutex;
     std::shared_ptr<nlohmann::json> database;
+
+    std::mutex saveMutex;
+    std::condition_variable saveCondition;
+    bool savePending = false;
+    bool stopSaving = false;
+    std::unique_ptr<std::thread> saveThread;
     std::shared_ptr<maps::OverlayConfig> overlayConfig;
 
     void loadOverlayConfig();
@@ -34,9 +34,18 @@ void ToolEnvironment::destroyMenu() {
 }
 
 void ToolEnvironment::createCommand(const std::string& name, const std::string& desc, CommandCallback cb) {
+    commands[name] = cb;
 }
 
 void ToolEnvironment::destroyCommands() {
+    commands.clear();
+}
+
+void ToolEnvironment::runCommand(const std::string &name, CommandState state) {
+    auto it = commands.find(name);
+    if (it != commands.end() && it->second) {
+        it->second(state);
+    }
 }
 
 std::string ToolEnvironment::getAirplanePath() {
@@ -18,6 +18,7 @@
 #ifndef SRC_ENVIRONMENT_TOOLENVIRONMENT_H_
 #define SRC_ENVIRONMENT_TOOLENVIRONMENT_H_
 
+#include <map>
 #include "Environment.h"
 
 namespace avitab {
@@ -45,8 +46,13 @@ public:
     std::string getFontDirectory() override;
     std::string getEarthTexturePath() override;
 
+protected:
+    // runs a command created by createCommand, e.g. from a replayed trace
+    void runCommand(const std::string &name, CommandState state);
+
 private:
     std::string ourPath;
+    std::map<std::string, CommandCallback> commands;
 
 };
 
@@ -0,0 +1,71 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <algorithm>
+#include "WeatherStations.h"
+
+namespace avitab {
+
+void WeatherStations::add(const Station &station) {
+    int lat = (int) std::floor(station.latitude);
+    int lon = (int) std::floor(station.longitude);
+    cells[cellOf(lat, lon)].push_back(station);
+    count++;
+}
+
+void WeatherStations::forEachInArea(double minLat, double minLon, double maxLat, double maxLon,
+                                    const std::function<void(const Station &)> &f) const {
+    int lat0 = std::max(-90, (int) std::floor(minLat));
+    int lat1 = std::min(89, (int) std::floor(maxLat));
+    int lon0 = std::max(-180, (int) std::floor(minLon));
+    int lon1 = std::min(179, (int) std::floor(maxLon));
+    for (int lat = lat0; lat <= lat1; lat++) {
+        for (int lon = lon0; lon <= lon1; lon++) {
+            auto it = cells.find(cellOf(lat, lon));
+            if (it == cells.end()) {
+                continue;
+            }
+            for (auto &station: it->second) {
+                f(station);
+            }
+        }
+    }
+}
+
+size_t WeatherStations::size() const {
+    return count;
+}
+
+FlightCategory WeatherStations::parseCategory(const std::string &name) {
+    if (name == "VFR") {
+        return FlightCategory::VFR;
+    } else if (name == "MVFR") {
+        return FlightCategory::MVFR;
+    } else if (name == "IFR") {
+        return FlightCategory::IFR;
+    } else if (name == "LIFR") {
+        return FlightCategory::LIFR;
+    }
+    return FlightCategory::UNKNOWN;
+}
+
+int WeatherStations::cellOf(int lat, int lon) {
+    return (lat + 90) * 360 + (lon + 180);
+}
+
+} /* namespace avitab */
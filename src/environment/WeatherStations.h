@@ -0,0 +1,66 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+namespace avitab {
+
+enum class FlightCategory : uint8_t {
+    UNKNOWN,
+    VFR,
+    MVFR,
+    IFR,
+    LIFR,
+};
+
+/*
+ * The weather of all reporting stations as of one refresh, never modified once
+ * published. The stations are bucketed by whole degrees of latitude and longitude
+ * so that a map only visits the stations around its visible area.
+ */
+class WeatherStations {
+public:
+    struct Station {
+        float latitude, longitude;
+        FlightCategory category;
+        int16_t windDirection;  // degrees true the wind blows from, -1 if variable
+        int16_t windSpeed;      // knots
+    };
+
+    void add(const Station &station);
+    // calls f for the stations of the cells that intersect the area, so also a few just outside
+    void forEachInArea(double minLat, double minLon, double maxLat, double maxLon,
+                       const std::function<void(const Station &)> &f) const;
+    size_t size() const;
+
+    // "VFR", "MVFR", "IFR" or "LIFR" as given in the bulk files
+    static FlightCategory parseCategory(const std::string &name);
+
+private:
+    std::unordered_map<int, std::vector<Station>> cells;
+    size_t count = 0;
+
+    static int cellOf(int lat, int lon);
+};
+
+} /* namespace avitab */
@@ -31,16 +31,24 @@ namespace avitab {
 MsfsAddonEnvironment::MsfsAddonEnvironment()
 :   StandAloneEnvironment(),
     hSimConnect(NULL),
+    hSimEvent(CreateEvent(NULL, FALSE, FALSE, NULL)),
     nextSimUpdate(0)
 {
     resetLocations();
+    simThread = std::make_unique<std::thread>(&MsfsAddonEnvironment::simConnectLoop, this);
 }
 
 MsfsAddonEnvironment::~MsfsAddonEnvironment()
 {
+    keepRunning = false;
+    SetEvent(hSimEvent);
+    if (simThread) {
+        simThread->join();
+    }
     if (hSimConnect != NULL) {
         (void)SimConnect_Close(hSimConnect);
     }
+    CloseHandle(hSimEvent);
 }
 
 void MsfsAddonEnvironment::eventLoop()
@@ -48,19 +56,32 @@ void MsfsAddonEnvironment::eventLoop()
     while (driver->handleEvents()) {
         runEnvironmentCallbacks();
         setLastFrameTime(driver->getLastDrawTime() / 1000.0);
+    }
+    driver.reset();
+}
 
+void MsfsAddonEnvironment::simConnectLoop()
+{
+    while (keepRunning) {
         auto t = GetTickCount64();
         if (t >= nextSimUpdate) {
             if (hSimConnect == NULL) {
                 tryConnectToMsfsSim();
-                nextSimUpdate = t + 5000; // try again in 5s
+                nextSimUpdate = t + CONNECT_RETRY_MS;
             } else {
-                retrieveMsfsObjectData();
-                nextSimUpdate = t + 1000; // next update in 1s
+                requestTrafficData();
+                nextSimUpdate = t + TRAFFIC_PERIOD_MS;
             }
         }
+
+        if (hSimConnect != NULL) {
+            dispatchMsfsMessages();
+        }
+
+        t = GetTickCount64();
+        DWORD timeout = (t < nextSimUpdate) ? (DWORD) (nextSimUpdate - t) : 0;
+        WaitForSingleObject(hSimEvent, timeout);
     }
-    driver.reset();
 }
 
 AircraftID MsfsAddonEnvironment::getActiveAircraftCount()
@@ -74,8 +95,10 @@ Location MsfsAddonEnvironment::getAircraftLocation(AircraftID id)
     std::lock_guard<std::mutex> lock(stateMutex);
     if (id == 0) {
         return userLocation;
-    } else {
+    } else if (id - 1 < otherLocations.size()) {
         return otherLocations[id-1];
+    } else {
+        return Location{};
     }
 }
 
@@ -91,7 +114,7 @@ void MsfsAddonEnvironment::resetLocations()
 
 void MsfsAddonEnvironment::tryConnectToMsfsSim()
 {
-    if (SUCCEEDED(SimConnect_Open(&hSimConnect, "Avitab", NULL, 0, 0, 0)))
+    if (SUCCEEDED(SimConnect_Open(&hSimConnect, "Avitab", NULL, 0, hSimEvent, 0)))
     {
         LOG_INFO(1, "Connected to MS Flight Simulator!");
 
@@ -107,8 +130,13 @@ void MsfsAddonEnvironment::tryConnectToMsfsSim()
         SimConnect_AddToDataDefinition(hSimConnect, LOCATION_DEFINITION, "Plane Longitude", "degrees");
         SimConnect_AddToDataDefinition(hSimConnect, LOCATION_DEFINITION, "Plane Heading Degrees True", "degrees");
 
-        // Register for 1s updates about the user aircraft location
-        (void)SimConnect_RequestDataOnSimObject(hSimConnect,USER_AIRCRAFT_LOCATION, LOCATION_DEFINITION, SIMCONNECT_OBJECT_ID_USER, SIMCONNECT_PERIOD_SECOND);
+        // The user aircraft is sent every sim frame in which it moved, without its title
+        SimConnect_AddToDataDefinition(hSimConnect, USER_POSITION_DEFINITION, "Plane Altitude", "feet");
+        SimConnect_AddToDataDefinition(hSimConnect, USER_POSITION_DEFINITION, "Plane Latitude", "degrees");
+        SimConnect_AddToDataDefinition(hSimConnect, USER_POSITION_DEFINITION, "Plane Longitude", "degrees");
+        SimConnect_AddToDataDefinition(hSimConnect, USER_POSITION_DEFINITION, "Plane Heading Degrees True", "degrees");
+        (void)SimConnect_RequestDataOnSimObject(hSimConnect, USER_AIRCRAFT_LOCATION, USER_POSITION_DEFINITION, SIMCONNECT_OBJECT_ID_USER,
+                                                SIMCONNECT_PERIOD_SIM_FRAME, SIMCONNECT_DATA_REQUEST_FLAG_CHANGED);
 
     } else {
         LOG_INFO(1, "Did not connect to MS Flight Simulator, hSimConnect = %p", hSimConnect);
@@ -116,13 +144,17 @@ void MsfsAddonEnvironment::tryConnectToMsfsSim()
     }
 }
 
-void MsfsAddonEnvironment::retrieveMsfsObjectData()
+void MsfsAddonEnvironment::requestTrafficData()
 {
-    // Ask for updates about other aircraft locations - seems like this needs to be done every time an update is wanted
+    // Ask for updates about other aircraft locations - there's no period for requests by type,
+    // so this is repeated every time an update is wanted. All aircraft arrive in one batch.
     HRESULT hr = SimConnect_RequestDataOnSimObjectType(hSimConnect, OTHER_AIRCRAFT_LOCATIONS, LOCATION_DEFINITION, REQUEST_DATA_RANGE, SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT);
     LOG_VERBOSE(MSFS_VERBOSE_LOGGING, "SimConnect_RequestDataOnSimObjectType() -> %ld", hr);
+}
 
-    while (1) {
+void MsfsAddonEnvironment::dispatchMsfsMessages()
+{
+    while (hSimConnect != NULL) {
         // using SimConnect_GetNextDispatch() rather than the callback because we don't really know how many
         // callbacks we need to trigger, so we might as well poll and check the result codes
         SIMCONNECT_RECV* pData;
@@ -153,12 +185,12 @@ void CALLBACK MsfsAddonEnvironment::handleMsfsDispatch(SIMCONNECT_RECV* pData, D
 
     case SIMCONNECT_RECV_ID_SIMOBJECT_DATA: // user aircraft location
         LOG_VERBOSE(MSFS_VERBOSE_LOGGING, "Receiving sim object data");
-        updateAircraftLocation(reinterpret_cast<SIMCONNECT_RECV_SIMOBJECT_DATA *>(pData), true);
+        updateUserAircraftLocation(reinterpret_cast<SIMCONNECT_RECV_SIMOBJECT_DATA *>(pData));
         break;
 
     case SIMCONNECT_RECV_ID_SIMOBJECT_DATA_BYTYPE: // other aircraft locations
         LOG_VERBOSE(MSFS_VERBOSE_LOGGING, "Receiving sim object data by type");
-        updateAircraftLocation(reinterpret_cast<SIMCONNECT_RECV_SIMOBJECT_DATA *>(pData), false);
+        updateAircraftLocation(reinterpret_cast<SIMCONNECT_RECV_SIMOBJECT_DATA *>(pData));
         break;
 
     case SIMCONNECT_RECV_ID_EVENT: // some event (we subscribed to) has occurred
@@ -168,7 +200,17 @@ void CALLBACK MsfsAddonEnvironment::handleMsfsDispatch(SIMCONNECT_RECV* pData, D
     }
 }
 
-void MsfsAddonEnvironment::updateAircraftLocation(SIMCONNECT_RECV_SIMOBJECT_DATA *pObjData, bool isUserAircraft)
+void MsfsAddonEnvironment::updateUserAircraftLocation(SIMCONNECT_RECV_SIMOBJECT_DATA *pObjData)
+{
+    UserAircraftPosition *pPos = reinterpret_cast<UserAircraftPosition*>(&pObjData->dwData);
+    std::lock_guard<std::mutex> lock(stateMutex);
+    userLocation.latitude = pPos->latitude;
+    userLocation.longitude = pPos->longitude;
+    userLocation.elevation = pPos->altitude / world::M_TO_FT; // convert to meters
+    userLocation.heading = pPos->heading;
+}
+
+void MsfsAddonEnvironment::updateAircraftLocation(SIMCONNECT_RECV_SIMOBJECT_DATA *pObjData)
 {
     LOG_VERBOSE(MSFS_VERBOSE_LOGGING, "dwRequestID = %ld, dwObjectID = %ld, dwDefineID = %ld, dwFlags = %ld, dwentrynumber = %ld, dwoutof = %ld, dwDefineCount = %ld",
             pObjData->dwRequestID, pObjData->dwObjectID, pObjData->dwDefineID, pObjData->dwFlags, pObjData->dwentrynumber, pObjData->dwoutof, pObjData->dwDefineCount);
@@ -179,19 +221,12 @@ void MsfsAddonEnvironment::updateAircraftLocation(SIMCONNECT_RECV_SIMOBJECT_DATA
         LOG_VERBOSE(MSFS_VERBOSE_LOGGING, "Title=\"%s\", Lat=%f  Lon=%f  Alt=%f  Heading=%f",
                     pLoc->title, pLoc->latitude, pLoc->longitude, pLoc->altitude, pLoc->heading);
         std::lock_guard<std::mutex> lock(stateMutex);
-        if (isUserAircraft) {
-            userLocation.latitude = pLoc->latitude;
-            userLocation.longitude = pLoc->longitude;
-            userLocation.elevation = pLoc->altitude / world::M_TO_FT; // convert to meters
-            userLocation.heading = pLoc->heading;
-        } else {
-            size_t id = pObjData->dwentrynumber - 1;
-            otherLocations.resize(pObjData->dwoutof);
-            otherLocations[id].latitude = pLoc->latitude;
-            otherLocations[id].longitude = pLoc->longitude;
-            otherLocations[id].elevation = pLoc->altitude / world::M_TO_FT; // convert to meters;
-            otherLocations[id].heading = pLoc->heading;
-        }
+        size_t id = pObjData->dwentrynumber - 1;
+        otherLocations.resize(pObjData->dwoutof);
+        otherLocations[id].latitude = pLoc->latitude;
+        otherLocations[id].longitude = pLoc->longitude;
+        otherLocations[id].elevation = pLoc->altitude / world::M_TO_FT; // convert to meters;
+        otherLocations[id].heading = pLoc->heading;
     }
 }
 
@@ -18,6 +18,9 @@
 #ifndef SRC_ENVIRONMENT_STANDALONE_MSFSADDONENVIRONMENT_H_
 #define SRC_ENVIRONMENT_STANDALONE_MSFSADDONENVIRONMENT_H_
 
+#include <thread>
+#include <atomic>
+#include <memory>
 #include "src/environment/standalone/StandAloneEnvironment.h"
 #include <winsock2.h>
 #include <windows.h>
@@ -36,6 +39,15 @@ class MsfsAddonEnvironment : public StandAloneEnvironment
         double  heading;
     };
 
+    // same as SimObjectLocation without the title, sent every sim frame
+    struct UserAircraftPosition
+    {
+        double  altitude;
+        double  latitude;
+        double  longitude;
+        double  heading;
+    };
+
 public:
     MsfsAddonEnvironment();
     virtual ~MsfsAddonEnvironment();
@@ -49,14 +61,22 @@ private:
     void resetLocations();
 
 private:
+    void simConnectLoop();
     void tryConnectToMsfsSim();
-    void retrieveMsfsObjectData();
+    void requestTrafficData();
+    void dispatchMsfsMessages();
 
     void handleMsfsDispatch(SIMCONNECT_RECV* pData, DWORD cbData);
-    void updateAircraftLocation(SIMCONNECT_RECV_SIMOBJECT_DATA *pObjData, bool isUserAircraft);
+    void updateUserAircraftLocation(SIMCONNECT_RECV_SIMOBJECT_DATA *pObjData);
+    void updateAircraftLocation(SIMCONNECT_RECV_SIMOBJECT_DATA *pObjData);
 
 private:
+    // SimConnect is only used by its own thread, which sleeps on hSimEvent until
+    // SimConnect has messages or the next traffic request is due
+    std::unique_ptr<std::thread> simThread;
+    std::atomic_bool        keepRunning { true };
     HANDLE                  hSimConnect;
+    HANDLE                  hSimEvent;
     ULONGLONG               nextSimUpdate;
 
     std::mutex              stateMutex;
@@ -65,7 +85,8 @@ private:
 
 private:
     enum {
-        LOCATION_DEFINITION
+        LOCATION_DEFINITION,
+        USER_POSITION_DEFINITION,
     };
     enum {
         USER_AIRCRAFT_LOCATION,
@@ -77,6 +98,8 @@ private:
         EVENT_PAUSE_STATE,
     };
     static const DWORD REQUEST_DATA_RANGE = 200000; // in metres = 108 nm
+    static const ULONGLONG TRAFFIC_PERIOD_MS = 1000;
+    static const ULONGLONG CONNECT_RETRY_MS = 5000;
 };
 
 } /* namespace avitab */
@@ -17,6 +17,7 @@
  */
 #include <stdexcept>
 #include <chrono>
+#include <cstring>
 #include "GlfwGUIDriver.h"
 #include "src/Logger.h"
 
@@ -29,6 +30,52 @@
 
 namespace avitab {
 
+struct GlfwGUIDriver::UploadBuffer {
+    GLuint id = 0;
+    uint8_t *mapped = nullptr;
+#ifndef __APPLE__
+    // set once the GPU was told to read from the buffer
+    GLsync fence = nullptr;
+#endif
+};
+
+#ifndef __APPLE__
+namespace {
+// gl.h only declares GL 1.1, the rest has to be loaded from the driver
+struct {
+    PFNGLGENBUFFERSPROC genBuffers;
+    PFNGLDELETEBUFFERSPROC deleteBuffers;
+    PFNGLBINDBUFFERPROC bindBuffer;
+    PFNGLBUFFERSTORAGEPROC bufferStorage;
+    PFNGLMAPBUFFERRANGEPROC mapBufferRange;
+    PFNGLFENCESYNCPROC fenceSync;
+    PFNGLCLIENTWAITSYNCPROC clientWaitSync;
+    PFNGLDELETESYNCPROC deleteSync;
+} bufferGL;
+
+constexpr const GLuint64 FENCE_TIMEOUT_NS = 100 * 1000 * 1000;
+
+bool loadBufferStorage() {
+    if (!glfwExtensionSupported("GL_ARB_buffer_storage") || !glfwExtensionSupported("GL_ARB_sync")
+            || !glfwExtensionSupported("GL_ARB_pixel_buffer_object")) {
+        return false;
+    }
+
+    bufferGL.genBuffers = (PFNGLGENBUFFERSPROC) glfwGetProcAddress("glGenBuffers");
+    bufferGL.deleteBuffers = (PFNGLDELETEBUFFERSPROC) glfwGetProcAddress("glDeleteBuffers");
+    bufferGL.bindBuffer = (PFNGLBINDBUFFERPROC) glfwGetProcAddress("glBindBuffer");
+    bufferGL.bufferStorage = (PFNGLBUFFERSTORAGEPROC) glfwGetProcAddress("glBufferStorage");
+    bufferGL.mapBufferRange = (PFNGLMAPBUFFERRANGEPROC) glfwGetProcAddress("glMapBufferRange");
+    bufferGL.fenceSync = (PFNGLFENCESYNCPROC) glfwGetProcAddress("glFenceSync");
+    bufferGL.clientWaitSync = (PFNGLCLIENTWAITSYNCPROC) glfwGetProcAddress("glClientWaitSync");
+    bufferGL.deleteSync = (PFNGLDELETESYNCPROC) glfwGetProcAddress("glDeleteSync");
+
+    return bufferGL.genBuffers && bufferGL.deleteBuffers && bufferGL.bindBuffer && bufferGL.bufferStorage
+            && bufferGL.mapBufferRange && bufferGL.fenceSync && bufferGL.clientWaitSync && bufferGL.deleteSync;
+}
+}
+#endif
+
 void GlfwGUIDriver::init(int width, int height) {
     logger::verbose("Initializing GLFW driver...");
 
@@ -56,6 +103,11 @@ void GlfwGUIDriver::createWindow(const std::string& title, const WindowRect &rec
 
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1); // 1 to enable vsync and avoid tearing, 0 to benchmark
+
+    const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (mode && mode->refreshRate > 0) {
+        idleWait = 1.0 / mode->refreshRate;
+    }
     glfwSetWindowUserPointer(window, this);
     glfwSetCursorPosCallback(window, [] (GLFWwindow *wnd, double x, double y) {
         GlfwGUIDriver *us = (GlfwGUIDriver *) glfwGetWindowUserPointer(wnd);
@@ -68,6 +120,7 @@ void GlfwGUIDriver::createWindow(const std::string& title, const WindowRect &rec
         GlfwGUIDriver *us = (GlfwGUIDriver *) glfwGetWindowUserPointer(wnd);
         if (button == GLFW_MOUSE_BUTTON_LEFT) {
             us->mousePressed = (action == GLFW_PRESS);
+            us->signalActivity();
         }
     });
     glfwSetScrollCallback(window, [] (GLFWwindow *wnd, double x, double y) {
@@ -79,6 +132,7 @@ void GlfwGUIDriver::createWindow(const std::string& title, const WindowRect &rec
         } else {
             us->wheelDir = 0;
         }
+        us->signalActivity();
     });
     glfwSetKeyCallback(window, [] (GLFWwindow *wnd, int key, int scanCode, int action, int mods) {
         GlfwGUIDriver *us = (GlfwGUIDriver *) glfwGetWindowUserPointer(wnd);
@@ -98,15 +152,41 @@ void GlfwGUIDriver::createWindow(const std::string& title, const WindowRect &rec
     });
     glfwSetWindowSizeCallback(window, [] (GLFWwindow *wnd, int w, int h) {
         GlfwGUIDriver *us = (GlfwGUIDriver *) glfwGetWindowUserPointer(wnd);
-        us->resize(w / ZOOM, h / ZOOM);
-        glBindTexture(GL_TEXTURE_2D, us->textureId);
-        glTexImage2D(GL_TEXTURE_2D, 0,
-                GL_RGBA, us->width(), us->height(), 0,
-                GL_BGRA, GL_UNSIGNED_BYTE, us->data());
-        glBindTexture(GL_TEXTURE_2D, 0);
+        us->fitToWindow(w, h);
+    });
+    glfwSetFramebufferSizeCallback(window, [] (GLFWwindow *wnd, int w, int h) {
+        GlfwGUIDriver *us = (GlfwGUIDriver *) glfwGetWindowUserPointer(wnd);
+        us->needsPresent = true;
+    });
+    glfwSetWindowRefreshCallback(window, [] (GLFWwindow *wnd) {
+        GlfwGUIDriver *us = (GlfwGUIDriver *) glfwGetWindowUserPointer(wnd);
+        us->needsPresent = true;
     });
 
     createTexture();
+    createUploadBuffers();
+}
+
+void GlfwGUIDriver::fitToWindow(int winWidth, int winHeight) {
+    // called from main thread. The size is in screen coordinates rather than the framebuffer's
+    // pixels so that the GUI keeps its size on HiDPI screens, render() filters it to the pixels.
+    float scale = getRenderScale() / ZOOM;
+    resize(winWidth * scale, winHeight * scale);
+
+    // resize() damaged the whole buffer, the next render() fills the new texture
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glTexImage2D(GL_TEXTURE_2D, 0,
+            GL_RGBA, width(), height(), 0,
+            GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    destroyUploadBuffers();
+    createUploadBuffers();
+    needsPresent = true;
+}
+
+void GlfwGUIDriver::onRenderScaleChanged() {
+    scaleChanged = true;
 }
 
 void GlfwGUIDriver::createTexture() {
@@ -120,6 +200,48 @@ void GlfwGUIDriver::createTexture() {
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void GlfwGUIDriver::createUploadBuffers() {
+    // called from main thread. Without GL_ARB_buffer_storage the dirty areas are uploaded from the GUI buffer directly
+#ifndef __APPLE__
+    static bool supported = loadBufferStorage();
+    if (!supported) {
+        return;
+    }
+
+    GLsizeiptr size = (GLsizeiptr) width() * height() * sizeof(uint32_t);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    uploadBuffers.resize(UPLOAD_BUFFERS);
+    for (auto &buf: uploadBuffers) {
+        bufferGL.genBuffers(1, &buf.id);
+        bufferGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buf.id);
+        bufferGL.bufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        buf.mapped = (uint8_t *) bufferGL.mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+        if (!buf.mapped) {
+            bufferGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            logger::warn("Couldn't map upload buffers, using direct uploads");
+            destroyUploadBuffers();
+            supported = false;
+            return;
+        }
+    }
+    bufferGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    nextUpload = 0;
+#endif
+}
+
+void GlfwGUIDriver::destroyUploadBuffers() {
+#ifndef __APPLE__
+    for (auto &buf: uploadBuffers) {
+        if (buf.fence) {
+            bufferGL.deleteSync(buf.fence);
+        }
+        // deleting a buffer also unmaps it
+        bufferGL.deleteBuffers(1, &buf.id);
+    }
+#endif
+    uploadBuffers.clear();
+}
+
 bool GlfwGUIDriver::hasWindow() {
     return window != nullptr;
 }
@@ -136,8 +258,18 @@ bool GlfwGUIDriver::handleEvents() {
         onQuit();
         return false;
     }
-    render();
-    glfwPollEvents();
+    if (scaleChanged.exchange(false)) {
+        int winWidth, winHeight;
+        glfwGetWindowSize(window, &winWidth, &winHeight);
+        fitToWindow(winWidth, winHeight);
+    }
+    if (render()) {
+        glfwPollEvents();
+    } else {
+        // instead of spinning while nothing changes, sleep until there is input or a
+        // new GUI frame but at most a refresh interval so the environment keeps running
+        glfwWaitEventsTimeout(idleWait);
+    }
     return true;
 }
 
@@ -147,20 +279,72 @@ void GlfwGUIDriver::onQuit() {
     logger::verbose("Shutting down GLFW");
 
     if (window) {
+        destroyUploadBuffers();
         glfwDestroyWindow(window);
         window = nullptr;
     }
 }
 
-void GlfwGUIDriver::blit(int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint32_t* newData) {
-    // called from LVGL thread
-    GUIDriver::blit(x1, y1, x2, y2, newData);
+void GlfwGUIDriver::finishFrame() {
+    // called from LVGL thread, wakes the main thread if it's waiting for events
+    glfwPostEmptyEvent();
+}
 
-    std::lock_guard<std::mutex> lock(driverMutex);
-    needsRedraw = true;
+void GlfwGUIDriver::upload(const DirtyRect &rect) {
+    int w = rect.x2 - rect.x1 + 1;
+    int h = rect.y2 - rect.y1 + 1;
+    size_t offset = (size_t) rect.y1 * width() + rect.x1;
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width());
+
+#ifndef __APPLE__
+    if (!uploadBuffers.empty()) {
+        UploadBuffer &buf = uploadBuffers[nextUpload];
+        nextUpload = (nextUpload + 1) % uploadBuffers.size();
+        if (buf.fence) {
+            // only blocks if the GPU is still reading the upload from UPLOAD_BUFFERS frames ago
+            bufferGL.clientWaitSync(buf.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+            bufferGL.deleteSync(buf.fence);
+            buf.fence = nullptr;
+        }
+
+        // same layout as the GUI buffer so that the texture can be filled from the same offset
+        const uint32_t *src = data() + offset;
+        uint32_t *dst = reinterpret_cast<uint32_t *>(buf.mapped) + offset;
+        for (int y = 0; y < h; y++) {
+            std::memcpy(dst, src, w * sizeof(uint32_t));
+            src += width();
+            dst += width();
+        }
+
+        bufferGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buf.id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0,
+                rect.x1, rect.y1, w, h,
+                GL_BGRA, GL_UNSIGNED_BYTE, reinterpret_cast<const void *>(offset * sizeof(uint32_t)));
+        bufferGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        buf.fence = bufferGL.fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    } else
+#endif
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0,
+                rect.x1, rect.y1, w, h,
+                GL_BGRA, GL_UNSIGNED_BYTE, data() + offset);
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
 
-void GlfwGUIDriver::render() {
+bool GlfwGUIDriver::render() {
+    // called from main thread
+    markDrawn();
+
+    DirtyRect dirty = takeDamage();
+    bool present = needsPresent.exchange(false);
+    if (dirty.empty() && !present) {
+        // the window still shows the last frame
+        return false;
+    }
+
     auto startAt = std::chrono::steady_clock::now();
 
     int winWidth, winHeight;
@@ -177,18 +361,12 @@ void GlfwGUIDriver::render() {
     glBindTexture(GL_TEXTURE_2D, textureId);
     glEnable(GL_TEXTURE_2D);
 
-    {
-        std::lock_guard<std::mutex> lock(driverMutex);
-        if (needsRedraw) {
-            glTexSubImage2D(GL_TEXTURE_2D, 0,
-                    0, 0,
-                    width(), height(),
-                    GL_BGRA, GL_UNSIGNED_BYTE, data());
-            needsRedraw = false;
-        }
+    if (!dirty.empty()) {
+        upload(dirty);
     }
 
-    glColor3f(brightness, brightness, brightness);
+    float b = brightness;
+    glColor3f(b, b, b);
 
     glBegin(GL_QUADS);
         glTexCoord2i(0, 0);  glVertex2i(0, 0);
@@ -204,12 +382,29 @@ void GlfwGUIDriver::render() {
     lastDrawTime = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
 
     glfwSwapBuffers(window);
+    return true;
 }
 
 uint32_t GlfwGUIDriver::getLastDrawTime() {
     return lastDrawTime;
 }
 
+void GlfwGUIDriver::injectPointer(int x, int y, bool pressed) {
+    mouseX = x;
+    mouseY = y;
+    mousePressed = pressed;
+    signalActivity();
+}
+
+void GlfwGUIDriver::injectWheel(int dir) {
+    wheelDir = dir;
+    signalActivity();
+}
+
+void GlfwGUIDriver::injectKey(uint32_t c) {
+    pushKeyInput(c);
+}
+
 void GlfwGUIDriver::readPointerState(int &x, int &y, bool &pressed) {
     // called from LVGL thread
     x = mouseX;
@@ -224,7 +419,9 @@ int GlfwGUIDriver::getWheelDirection() {
 }
 
 void GlfwGUIDriver::setBrightness(float b) {
-    brightness = b;
+    if (brightness.exchange(b) != b) {
+        needsPresent = true;
+    }
 }
 
 float GlfwGUIDriver::getBrightness() {
@@ -235,6 +432,7 @@ GlfwGUIDriver::~GlfwGUIDriver() {
     std::lock_guard<std::mutex> lock(driverMutex);
 
     if (window) {
+        destroyUploadBuffers();
         glfwDestroyWindow(window);
     }
     glDeleteTextures(1, &textureId);
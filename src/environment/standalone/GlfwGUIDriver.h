@@ -37,26 +37,49 @@ public:
 
     bool handleEvents();
     uint32_t getLastDrawTime();
+    // input from a replayed trace, handled like input from the window
+    void injectPointer(int x, int y, bool pressed);
+    void injectWheel(int dir);
+    void injectKey(uint32_t c);
 
-    void blit(int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint32_t *newData) override;
+    void finishFrame() override;
     void readPointerState(int &x, int &y, bool &pressed) override;
     int getWheelDirection() override;
     ~GlfwGUIDriver();
+protected:
+    void onRenderScaleChanged() override;
 private:
+    // window pixels per GUI pixel at render scale 1
     static constexpr const float ZOOM = 1.5f;
+    // persistently mapped buffers that dirty areas are copied to, the GPU can still
+    // read from the previous ones while the next is filled
+    static constexpr const int UPLOAD_BUFFERS = 3;
+    struct UploadBuffer;
 
     std::mutex driverMutex;
     GLFWwindow *window {};
     GLuint textureId{};
+    std::vector<UploadBuffer> uploadBuffers;
+    size_t nextUpload = 0;
+    // longest wait for events while there's nothing to draw
+    double idleWait = 1.0 / 60;
     std::atomic<uint32_t> lastDrawTime {0};
-    float brightness = 1;
-    bool needsRedraw = false;
+    std::atomic<float> brightness {1};
+    // the window must be drawn again even though the GUI didn't change
+    std::atomic_bool needsPresent {true};
+    // applied by the main thread that owns the GL context
+    std::atomic_bool scaleChanged {false};
 
     std::atomic_int mouseX {0}, mouseY {0}, wheelDir {0};
     bool mousePressed {false};
 
     void createTexture();
-    void render();
+    void createUploadBuffers();
+    void destroyUploadBuffers();
+    void fitToWindow(int winWidth, int winHeight);
+    void upload(const DirtyRect &rect);
+    // false if nothing changed and the frame was skipped
+    bool render();
     void onQuit();
 };
 
@@ -16,15 +16,23 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+#include <sstream>
 #include "StandAloneEnvironment.h"
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
 #include "src/libxdata/XData.h"
+#include "src/platform/FrameProfiler.h"
+#include "src/platform/Tracer.h"
 
 namespace avitab {
 
 StandAloneEnvironment::StandAloneEnvironment() : ToolEnvironment() {
     xplaneRootPath = findXPlaneInstallationPath();
+    onlineMetar = std::make_unique<OnlineMetarService>(getProgramPath() + "METAR/");
+    onlineMetar->start();
 }
 
 std::string StandAloneEnvironment::findXPlaneInstallationPath() {
@@ -74,12 +82,107 @@ std::string StandAloneEnvironment::getFlightPlansPath() {
     return xplaneRootPath + "/Output/FMS Plans/";
 }
 
+void StandAloneEnvironment::replayTrace(const std::string &utf8Path) {
+    replay = std::make_unique<FlightTraceReader>(utf8Path);
+    hasReplayEvent = replay->next(replayEvent);
+    logger::info("Replaying %s, %.1f seconds", utf8Path.c_str(), replay->getDurationMicros() / 1e6);
+}
+
 void StandAloneEnvironment::eventLoop() {
+    platform::Tracer::setThreadName("main");
+    if (replay) {
+        replayEventLoop();
+    } else {
+        while (driver->handleEvents()) {
+            runEnvironmentCallbacks();
+            setLastFrameTime(driver->getLastDrawTime() / 1000.0);
+        }
+    }
+    driver.reset();
+}
+
+void StandAloneEnvironment::replayEventLoop() {
+    std::vector<float> frameMs;
+    std::clock_t cpuStart = std::clock();
+    auto startAt = std::chrono::steady_clock::now();
+    auto frameAt = startAt;
+
+    // the trace's timestamps drive the replay, so every run sees the same input at the same time
     while (driver->handleEvents()) {
+        auto now = std::chrono::steady_clock::now();
+        frameMs.push_back(std::chrono::duration<float, std::milli>(now - frameAt).count());
+        frameAt = now;
+
+        applyReplayEvents(std::chrono::duration_cast<std::chrono::microseconds>(now - startAt).count());
         runEnvironmentCallbacks();
         setLastFrameTime(driver->getLastDrawTime() / 1000.0);
+
+        if (!hasReplayEvent) {
+            driver->killWindow();
+        }
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startAt).count();
+    double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    printReplayStatistics(frameMs, wallSeconds, cpuSeconds);
+}
+
+void StandAloneEnvironment::applyReplayEvents(uint64_t micros) {
+    while (hasReplayEvent && replayEvent.micros <= micros) {
+        switch (replayEvent.type) {
+        case FlightTrace::EventType::AIRCRAFT:
+            applyReplayAircraft(replayEvent.aircraft);
+            break;
+        case FlightTrace::EventType::POINTER:
+            driver->injectPointer(replayEvent.x, replayEvent.y, replayEvent.pressed);
+            break;
+        case FlightTrace::EventType::WHEEL:
+            driver->injectWheel(replayEvent.x);
+            break;
+        case FlightTrace::EventType::KEY:
+            driver->injectKey(replayEvent.key);
+            break;
+        case FlightTrace::EventType::COMMAND:
+            runCommand(replayEvent.command, (CommandState) replayEvent.state);
+            break;
+        }
+        hasReplayEvent = replay->next(replayEvent);
+    }
+}
+
+void StandAloneEnvironment::applyReplayAircraft(const std::vector<FlightTrace::AircraftPosition> &aircraft) {
+    auto prev = std::atomic_load(&replayAircraft);
+    auto next = std::make_shared<AircraftSnapshot>();
+    for (auto &plane: aircraft) {
+        next->locations.push_back({plane.longitude, plane.latitude, plane.elevation, plane.heading});
+    }
+    next->frame = prev ? prev->frame + 1 : 1;
+    next->sampledAt = std::chrono::steady_clock::now();
+    if (prev) {
+        estimateUserVelocity(*next, *prev);
+    }
+    std::atomic_store(&replayAircraft, next);
+}
+
+void StandAloneEnvironment::printReplayStatistics(std::vector<float> &frameMs, double wallSeconds, double cpuSeconds) {
+    if (frameMs.empty()) {
+        return;
+    }
+
+    std::sort(frameMs.begin(), frameMs.end());
+    auto percentile = [&frameMs] (double p) {
+        return frameMs[std::min(frameMs.size() - 1, (size_t) (p / 100 * frameMs.size()))];
+    };
+
+    std::printf("Replay: %.1f s, %zu frames, %.1f fps\n", wallSeconds, frameMs.size(), frameMs.size() / wallSeconds);
+    std::printf("Frame time ms: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f\n",
+            percentile(50), percentile(95), percentile(99), frameMs.back());
+    std::printf("CPU: %.1f s, %.0f%% of one core\n", cpuSeconds, cpuSeconds / wallSeconds * 100);
+    for (int i = 0; i < platform::FrameProfiler::NUM_STAGES; i++) {
+        auto stage = static_cast<platform::FrameProfiler::Stage>(i);
+        std::printf("Stage %-10s ms (recent): p50 %.2f  p95 %.2f\n", platform::FrameProfiler::getStageName(stage),
+                platform::FrameProfiler::getPercentile(stage, 50), platform::FrameProfiler::getPercentile(stage, 95));
     }
-    driver.reset();
 }
 
 std::shared_ptr<world::LoadManager> StandAloneEnvironment::createParsingWorldManager() {
@@ -91,7 +194,7 @@ std::shared_ptr<LVGLToolkit> StandAloneEnvironment::createGUIToolkit() {
     return std::make_shared<LVGLToolkit>(driver);
 }
 
-Environment::MagVarMap StandAloneEnvironment::getMagneticVariations(std::vector<std::pair<double, double>> locations) {
+Environment::MagVarMap StandAloneEnvironment::sampleMagneticVariations(std::vector<std::pair<double, double>> locations) {
     Environment::MagVarMap zeros;
     for (auto location : locations) {
         zeros[location] = 0;
@@ -100,14 +203,50 @@ Environment::MagVarMap StandAloneEnvironment::getMagneticVariations(std::vector<
 }
 
 std::string StandAloneEnvironment::getMETARForAirport(const std::string &icao) {
-    return "METAR";
+    OnlineMetarService::Report report;
+    if (!onlineMetar->getReport(icao, report)) {
+        return "No weather information available";
+    }
+
+    std::stringstream str;
+    if (!report.metar.empty()) {
+        str << "Weather, observed " << report.observed << ":\n" << report.metar << "\n";
+    }
+    if (!report.taf.empty()) {
+        str << (report.metar.empty() ? "" : "\n") << "Forecast:\n" << report.taf << "\n";
+    }
+    return str.str();
+}
+
+std::shared_ptr<const WeatherStations> StandAloneEnvironment::getWeatherStations() {
+    return onlineMetar->getStations();
 }
 
 AircraftID StandAloneEnvironment::getActiveAircraftCount() {
+    if (replay) {
+        auto snapshot = std::atomic_load(&replayAircraft);
+        return snapshot ? snapshot->locations.size() : 0;
+    }
     return 4;
 }
 
+AircraftLocations StandAloneEnvironment::getAircraftLocations() {
+    if (replay) {
+        auto snapshot = std::atomic_load(&replayAircraft);
+        return snapshot ? snapshot : std::make_shared<AircraftSnapshot>();
+    }
+    return ToolEnvironment::getAircraftLocations();
+}
+
 Location StandAloneEnvironment::getAircraftLocation(AircraftID id) {
+    if (replay) {
+        auto snapshot = std::atomic_load(&replayAircraft);
+        if (!snapshot || id >= snapshot->locations.size()) {
+            return {};
+        }
+        return snapshot->locations[id];
+    }
+
     static unsigned int t = 0;
     static Location loc[4];
     static double vel[4];
@@ -21,7 +21,10 @@
 #include "GlfwGUIDriver.h"
 #include <memory>
 #include <map>
+#include <vector>
 #include "src/environment/ToolEnvironment.h"
+#include "src/environment/FlightTrace.h"
+#include "src/environment/OnlineMetarService.h"
 
 namespace avitab {
 
@@ -29,6 +32,9 @@ class StandAloneEnvironment: public ToolEnvironment {
 public:
     StandAloneEnvironment();
 
+    // Replays the trace instead of simulating aircraft, eventLoop then returns
+    // at the end of the trace and prints frame time and CPU statistics
+    void replayTrace(const std::string &utf8Path);
     void eventLoop();
 
     // Must be called from the environment thread - do not call from GUI thread!
@@ -41,22 +47,36 @@ public:
     std::string getEarthTexturePath() override;
     std::string getFlightPlansPath() override;
     std::string getMETARForAirport(const std::string &icao) override;
-    Environment::MagVarMap getMagneticVariations(std::vector<std::pair<double, double>> locations) override;
+    std::shared_ptr<const WeatherStations> getWeatherStations() override;
     AircraftID getActiveAircraftCount() override;
     Location getAircraftLocation(AircraftID id) override;
+    AircraftLocations getAircraftLocations() override;
 
     virtual ~StandAloneEnvironment();
 
 protected:
     bool canUseNavDb(const std::string simCode) override;
+    Environment::MagVarMap sampleMagneticVariations(std::vector<std::pair<double, double>> locations) override;
 
 protected:
     std::string xplaneRootPath;
     std::shared_ptr<GlfwGUIDriver> driver;
 
 private:
+    // there is no simulator to ask for the weather
+    std::unique_ptr<OnlineMetarService> onlineMetar;
+    std::unique_ptr<FlightTraceReader> replay;
+    FlightTrace::Event replayEvent;
+    bool hasReplayEvent = false;
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<AircraftSnapshot> replayAircraft;
 
     std::string findXPlaneInstallationPath();
+    void replayEventLoop();
+    // applies the events up to the given time since the start of the replay
+    void applyReplayEvents(uint64_t micros);
+    void applyReplayAircraft(const std::vector<FlightTrace::AircraftPosition> &aircraft);
+    static void printReplayStatistics(std::vector<float> &frameMs, double wallSeconds, double cpuSeconds);
 };
 
 } /* namespace avitab */
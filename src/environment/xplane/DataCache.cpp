@@ -35,42 +35,20 @@ EnvData DataCache::getData(const std::string& dataRef) {
     return toEnvData(ref);
 }
 
-EnvData DataCache::getLocationData(const AircraftID plane, const LocationPartIndex part) {
-
-    if (locationRefCache.empty()) {
-        // populate location references first time only
-        locationRefCache.push_back(XPLMFindDataRef("sim/flightmodel/position/latitude"));
-        locationRefCache.push_back(XPLMFindDataRef("sim/flightmodel/position/longitude"));
-        locationRefCache.push_back(XPLMFindDataRef("sim/flightmodel/position/elevation"));
-        locationRefCache.push_back(XPLMFindDataRef("sim/flightmodel/position/psi"));
-        std::string b0("sim/multiplayer/position/plane");
-        for (int i = 1; i < 10; ++i) {
-            char d = '0' + i;
-            locationRefCache.push_back(XPLMFindDataRef((b0 + d + "_lat").c_str()));
-            locationRefCache.push_back(XPLMFindDataRef((b0 + d + "_lon").c_str()));
-            locationRefCache.push_back(XPLMFindDataRef((b0 + d + "_el").c_str()));
-            locationRefCache.push_back(XPLMFindDataRef((b0 + d +"_psi").c_str()));
-        }
-        std::string b1("sim/multiplayer/position/plane1");
-        for (int i = 0; i < 10; ++i) {
-            char d = '0' + i;
-            locationRefCache.push_back(XPLMFindDataRef((b1 + d + "_lat").c_str()));
-            locationRefCache.push_back(XPLMFindDataRef((b1 + d + "_lon").c_str()));
-            locationRefCache.push_back(XPLMFindDataRef((b1 + d + "_el").c_str()));
-            locationRefCache.push_back(XPLMFindDataRef((b1 + d + "_psi").c_str()));
-        }
+XPLMDataRef DataCache::findDataRef(const std::string &dataRef) {
+    auto iter = refCache.find(dataRef);
+    if (iter != refCache.end()) {
+        return iter->second;
     }
 
-    XPLMDataRef ref = nullptr;
-    size_t id = plane * NUM_LOCATION_PARTS + part;
-    if ((plane <= MAX_AI_AIRCRAFT) && (part < NUM_LOCATION_PARTS)) {
-        ref = locationRefCache[id];
-    }
-    if (!ref) {
-        std::string invalid("location entry " + std::to_string(id));
-        throw std::runtime_error("Invalid ref: " + invalid);
+    XPLMDataRef ref = XPLMFindDataRef(dataRef.c_str());
+    if (ref) {
+        logger::verbose("Caching data ref %s", dataRef.c_str());
+        refCache.insert(std::make_pair(dataRef, ref));
+    } else {
+        logger::warn("Data ref %s not available", dataRef.c_str());
     }
-    return toEnvData(ref);
+    return ref;
 }
 
 XPLMDataRef DataCache::createDataRef(const std::string& dataRef) {
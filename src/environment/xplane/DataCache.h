@@ -30,13 +30,13 @@ namespace avitab {
 class DataCache {
 public:
     EnvData getData(const std::string &dataRef);
-    EnvData getLocationData(const AircraftID plane, const LocationPartIndex part);
+    // nullptr if the simulator doesn't have the dataref
+    XPLMDataRef findDataRef(const std::string &dataRef);
+    EnvData toEnvData(XPLMDataRef ref);
 private:
     std::map<std::string, XPLMDataRef> refCache;
-    std::vector<XPLMDataRef> locationRefCache;
 
     XPLMDataRef createDataRef(const std::string &dataRef);
-    EnvData toEnvData(XPLMDataRef ref);
 };
 
 } /* namespace avitab */
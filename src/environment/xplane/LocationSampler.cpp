@@ -0,0 +1,154 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <XPLM/XPLMPlanes.h>
+#include <algorithm>
+#include "LocationSampler.h"
+#include "src/Logger.h"
+
+namespace avitab {
+
+void LocationSampler::sample(std::vector<Location> &locs) {
+    if (!resolved) {
+        resolve();
+        resolved = true;
+    }
+
+    snapshot.count = 0;
+    sampleUser();
+    if (!sampleTcasTargets()) {
+        sampleAiAircraft();
+    }
+
+    locs.resize(snapshot.count);
+    for (size_t i = 0; i < snapshot.count; ++i) {
+        Location &loc = locs[i];
+        loc.latitude = snapshot.latitude[i];
+        loc.longitude = snapshot.longitude[i];
+        loc.elevation = snapshot.elevation[i];
+        loc.heading = snapshot.heading[i];
+    }
+}
+
+void LocationSampler::resolve() {
+    userRefs.latitude = findRef("sim/flightmodel/position/latitude");
+    userRefs.longitude = findRef("sim/flightmodel/position/longitude");
+    userRefs.elevation = findRef("sim/flightmodel/position/elevation");
+    userRefs.heading = findRef("sim/flightmodel/position/psi");
+
+    for (AircraftID i = 1; i <= MAX_AI_AIRCRAFT; ++i) {
+        std::string base = "sim/multiplayer/position/plane" + std::to_string(i);
+        PlaneRefs &refs = aiRefs[i - 1];
+        refs.latitude = findRef(base + "_lat");
+        refs.longitude = findRef(base + "_lon");
+        refs.elevation = findRef(base + "_el");
+        refs.heading = findRef(base + "_psi");
+    }
+
+    tcasLat = findArrayRef("sim/cockpit2/tcas/targets/position/lat");
+    tcasLon = findArrayRef("sim/cockpit2/tcas/targets/position/lon");
+    tcasEle = findArrayRef("sim/cockpit2/tcas/targets/position/ele");
+    tcasPsi = findArrayRef("sim/cockpit2/tcas/targets/position/psi");
+    tcasCount = findRef("sim/cockpit2/tcas/indicators/tcas_num_acf");
+    logger::verbose("TCAS target arrays %s", tcasLat ? "available" : "not available");
+}
+
+void LocationSampler::sampleUser() {
+    // the user's aircraft always comes from the double precision position
+    snapshot.add(readDouble(userRefs.latitude), readDouble(userRefs.longitude),
+                 readDouble(userRefs.elevation), readFloat(userRefs.heading));
+}
+
+bool LocationSampler::sampleTcasTargets() {
+    // Since X-Plane 11.50 all traffic, including that of TCAS override plugins for online
+    // networks, is available as arrays that can be read in one call each. Slot 0 is the user.
+    if (!tcasLat || !tcasLon || !tcasEle || !tcasPsi) {
+        return false;
+    }
+
+    int n = XPLMGetDatavf(tcasLat, tcasLatBuf.data(), 0, MAX_TCAS_TARGETS);
+    if (n <= 0) {
+        return false;
+    }
+    n = std::min(n, XPLMGetDatavf(tcasLon, tcasLonBuf.data(), 0, n));
+    n = std::min(n, XPLMGetDatavf(tcasEle, tcasEleBuf.data(), 0, n));
+    n = std::min(n, XPLMGetDatavf(tcasPsi, tcasPsiBuf.data(), 0, n));
+    if (tcasCount) {
+        // older versions only have the arrays, unused slots are skipped below
+        n = std::min(n, XPLMGetDatai(tcasCount));
+    }
+
+    for (int i = 1; i < n; ++i) {
+        if (tcasLatBuf[i] == 0 && tcasLonBuf[i] == 0) {
+            continue;
+        }
+        snapshot.add(tcasLatBuf[i], tcasLonBuf[i], tcasEleBuf[i], tcasPsiBuf[i]);
+    }
+    return true;
+}
+
+void LocationSampler::sampleAiAircraft() {
+    int total, active;
+    XPLMPluginID controller;
+    XPLMCountAircraft(&total, &active, &controller);
+    int others = std::min(std::max(active - 1, 0), (int) MAX_AI_AIRCRAFT);
+
+    for (int i = 0; i < others; ++i) {
+        const PlaneRefs &refs = aiRefs[i];
+        if (!refs.latitude || !refs.longitude || !refs.elevation || !refs.heading) {
+            continue;
+        }
+        snapshot.add(readDouble(refs.latitude), readDouble(refs.longitude),
+                     readDouble(refs.elevation), readFloat(refs.heading));
+    }
+}
+
+void LocationSampler::Snapshot::add(double lat, double lon, double ele, double psi) {
+    latitude[count] = lat;
+    longitude[count] = lon;
+    elevation[count] = ele;
+    heading[count] = psi;
+    ++count;
+}
+
+XPLMDataRef LocationSampler::findRef(const std::string &name) {
+    return XPLMFindDataRef(name.c_str());
+}
+
+XPLMDataRef LocationSampler::findArrayRef(const std::string &name) {
+    XPLMDataRef ref = XPLMFindDataRef(name.c_str());
+    if (ref && !(XPLMGetDataRefTypes(ref) & xplmType_FloatArray)) {
+        return nullptr;
+    }
+    return ref;
+}
+
+double LocationSampler::readDouble(XPLMDataRef ref) {
+    if (!ref) {
+        return 0;
+    }
+    return XPLMGetDatad(ref);
+}
+
+float LocationSampler::readFloat(XPLMDataRef ref) {
+    if (!ref) {
+        return 0;
+    }
+    return XPLMGetDataf(ref);
+}
+
+} /* namespace avitab */
@@ -0,0 +1,73 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <XPLM/XPLMDataAccess.h>
+#include "src/environment/EnvData.h"
+#include "src/environment/Environment.h"
+
+namespace avitab {
+
+// Reads the positions of the user's and all other aircraft once per flight loop.
+// The datarefs are resolved on the first call, missing ones are skipped instead
+// of throwing. This class may only be used by the environment thread.
+class LocationSampler {
+public:
+    // replaces the contents of locs, the user's aircraft is always first
+    void sample(std::vector<Location> &locs);
+
+private:
+    // one column per part, the user's aircraft first
+    struct Snapshot {
+        std::array<double, MAX_TCAS_TARGETS> latitude {};
+        std::array<double, MAX_TCAS_TARGETS> longitude {};
+        std::array<double, MAX_TCAS_TARGETS> elevation {};
+        std::array<double, MAX_TCAS_TARGETS> heading {};
+        size_t count = 0;
+
+        void add(double lat, double lon, double ele, double psi);
+    };
+
+    struct PlaneRefs {
+        XPLMDataRef latitude {}, longitude {}, elevation {}, heading {};
+    };
+
+    bool resolved = false;
+    PlaneRefs userRefs;
+    // legacy multiplayer datarefs, index 0 is plane1
+    std::array<PlaneRefs, MAX_AI_AIRCRAFT> aiRefs;
+    // TCAS target arrays, available since X-Plane 11.50
+    XPLMDataRef tcasLat {}, tcasLon {}, tcasEle {}, tcasPsi {}, tcasCount {};
+    Snapshot snapshot;
+    std::array<float, MAX_TCAS_TARGETS> tcasLatBuf {}, tcasLonBuf {}, tcasEleBuf {}, tcasPsiBuf {};
+
+    void resolve();
+    void sampleUser();
+    bool sampleTcasTargets();
+    void sampleAiAircraft();
+
+    static XPLMDataRef findRef(const std::string &name);
+    static XPLMDataRef findArrayRef(const std::string &name);
+    static double readDouble(XPLMDataRef ref);
+    static float readFloat(XPLMDataRef ref);
+};
+
+} /* namespace avitab */
@@ -22,10 +22,14 @@
 #include <stdexcept>
 #include <chrono>
 #include <sstream>
+#include <algorithm>
 #include "XPlaneEnvironment.h"
 #include "XPlaneGUIDriver.h"
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
+#include "src/platform/FrameProfiler.h"
+#include "src/platform/Metrics.h"
+#include "src/platform/Tracer.h"
 #include "src/libxdata/XData.h"
 
 namespace avitab {
@@ -34,6 +38,7 @@ XPlaneEnvironment::XPlaneEnvironment() {
     XPLMDebugString("AviTab version " AVITAB_VERSION_STR "\n");
 
     // Called by the X-Plane thread via StartPlugin
+    platform::Tracer::setThreadName("xplane");
     pluginPath = getPluginPath();
     xplanePrefsDir = findPreferencesDir();
     flightLoopId = createFlightLoop();
@@ -49,8 +54,6 @@ XPlaneEnvironment::XPlaneEnvironment() {
         getMetar = nullptr;
     }
 
-    updatePlaneCount();
-
     panelEnabled = std::make_shared<int>(0);
     panelPowered = std::make_shared<int>(0);
     brightness = std::make_shared<float>(1);
@@ -84,6 +87,25 @@ XPlaneEnvironment::XPlaneEnvironment() {
     mapVerticalRangeRef = std::make_unique<DataRefExport<float>>("avitab/map/vertical_range", this,
         [] (void *self) { return (reinterpret_cast<XPlaneEnvironment *>(self))->getMapVerticalRange(); });
 
+    for (int i = 0; i < maps::OverlayTimings::NUM_LAYERS; i++) {
+        std::string name = std::string("avitab/map/overlay_ms/") +
+                           maps::OverlayTimings::getLayerName(static_cast<maps::OverlayTimings::Layer>(i));
+        overlayTimingRefs.push_back(std::make_unique<DataRefExport<float>>(name + "_p50", this,
+            [i] (void *self) { return (reinterpret_cast<XPlaneEnvironment *>(self))->getOverlayTiming(i, false); }));
+        overlayTimingRefs.push_back(std::make_unique<DataRefExport<float>>(name + "_p95", this,
+            [i] (void *self) { return (reinterpret_cast<XPlaneEnvironment *>(self))->getOverlayTiming(i, true); }));
+    }
+
+    // the profiler is lock-free, so these are read directly
+    for (int i = 0; i < platform::FrameProfiler::NUM_STAGES; i++) {
+        auto stage = static_cast<platform::FrameProfiler::Stage>(i);
+        std::string name = std::string("avitab/profile_ms/") + platform::FrameProfiler::getStageName(stage);
+        for (int percentile: {50, 95, 99}) {
+            profileRefs.push_back(std::make_unique<DataRefExport<float>>(name + "_p" + std::to_string(percentile), this,
+                [stage, percentile] (void *) { return platform::FrameProfiler::getPercentile(stage, percentile); }));
+        }
+    }
+
     XPLMScheduleFlightLoop(flightLoopId, -1, true);
 }
 
@@ -140,6 +162,11 @@ std::shared_ptr<LVGLToolkit> XPlaneEnvironment::createGUIToolkit() {
     return std::make_shared<LVGLToolkit>(driver);
 }
 
+bool XPlaneEnvironment::supportsMultipleGUIToolkits() {
+    // every driver has its own window, panel area and draw callback
+    return true;
+}
+
 void XPlaneEnvironment::createMenu(const std::string& name) {
     XPLMMenuID pluginMenu = XPLMFindPluginsMenu();
     subMenuIdx = XPLMAppendMenuItem(pluginMenu, name.c_str(), nullptr, 0);
@@ -185,6 +212,7 @@ void XPlaneEnvironment::createCommand(const std::string& name, const std::string
     }
 
     RegisteredCommand cmdInfo;
+    cmdInfo.name = name;
     cmdInfo.callback = cb;
     cmdInfo.inBefore = true;
     cmdInfo.refCon = this;
@@ -200,13 +228,20 @@ int XPlaneEnvironment::handleCommand(XPLMCommandRef cmd, XPLMCommandPhase phase,
         return 1;
     }
 
-    CommandCallback f = us->commandHandlers[cmd].callback;
+    auto &handler = us->commandHandlers[cmd];
+    CommandCallback f = handler.callback;
     if (f) {
+        CommandState state;
         switch (phase) {
-        case xplm_CommandBegin:     f(CommandState::START); break;
-        case xplm_CommandContinue:  f(CommandState::CONTINUE); break;
-        case xplm_CommandEnd:       f(CommandState::END); break;
+        case xplm_CommandBegin:     state = CommandState::START; break;
+        case xplm_CommandContinue:  state = CommandState::CONTINUE; break;
+        default:                    state = CommandState::END; break;
+        }
+        // continue phases arrive every frame while held, the trace replays them from start to end
+        if (state != CommandState::CONTINUE) {
+            us->recordCommandTrace(handler.name, state);
         }
+        f(state);
     }
 
     return 1;
@@ -249,48 +284,128 @@ std::string XPlaneEnvironment::getFlightPlansPath() {
 }
 
 float XPlaneEnvironment::onFlightLoop(float elapsedSinceLastCall, float elapseSinceLastLoop, int count) {
-    std::vector<Location> activeAircraftLocations;
+    platform::TraceSpan span("flight_loop");
 
-    updatePlaneCount();
-    for (AircraftID i = 0; i <= otherAircraftCount; ++i) {
-        try {
-            Location loc;
-            loc.latitude = dataCache.getLocationData(i, 0).doubleValue;
-            loc.longitude = dataCache.getLocationData(i, 1).doubleValue;
-            loc.elevation = dataCache.getLocationData(i, 2).doubleValue;
-            loc.heading = dataCache.getLocationData(i, 3).floatValue;
-            activeAircraftLocations.push_back(loc);
-        } catch (const std::exception &e) {
-            // silently ignore to avoid flooding the log
-            // can fail with TCAS override, more than 19 AI aircraft
-        }
+    // Readers only ever get the published buffer, so once the spare one isn't
+    // referenced by anyone else it can be refilled in place
+    if (!spareAircraftLocations || spareAircraftLocations.use_count() > 1) {
+        spareAircraftLocations = std::make_shared<AircraftSnapshot>();
     }
+    // pairs with the release of the readers dropping their last reference
+    std::atomic_thread_fence(std::memory_order_acquire);
 
-    {
-        std::lock_guard<std::mutex> lock(stateMutex);
-        aircraftLocations = activeAircraftLocations;
-    }
+    locationSampler.sample(spareAircraftLocations->locations);
+    spareAircraftLocations->frame = ++aircraftFrame;
+    spareAircraftLocations->sampledAt = std::chrono::steady_clock::now();
+    estimateUserVelocity(*spareAircraftLocations, *std::atomic_load(&aircraftLocations));
+    recordAircraftTrace(*spareAircraftLocations);
+    spareAircraftLocations = std::atomic_exchange(&aircraftLocations, spareAircraftLocations);
 
     setLastFrameTime(dataCache.getData("sim/operation/misc/frame_rate_period").floatValue);
+    refreshDataSubscriptions();
+    refreshMetricExports();
 
     runEnvironmentCallbacks();
     return -1;
 }
 
+void XPlaneEnvironment::refreshMetricExports() {
+    // metrics are registered on first use, so new ones are exported as they appear
+    size_t generation = platform::Metrics::getGeneration();
+    if (generation == exportedMetricsGeneration) {
+        return;
+    }
+    auto settings = getSettings();
+    if (!settings) {
+        return;
+    }
+    exportedMetricsGeneration = generation;
+    if (!settings->getGeneralSetting<bool>("export_metrics")) {
+        return;
+    }
+
+    // the metrics are lock-free and live forever, so the references stay valid
+    auto snapshot = platform::Metrics::snapshot();
+    for (auto &it: snapshot.counters) {
+        if (exportedMetrics.insert(it.first).second) {
+            auto &counter = platform::Metrics::counter(it.first);
+            metricRefs.push_back(std::make_unique<DataRefExport<float>>("avitab/metrics/" + it.first, this,
+                [&counter] (void *) { return (float) counter.value(); }));
+        }
+    }
+    for (auto &it: snapshot.gauges) {
+        if (exportedMetrics.insert(it.first).second) {
+            auto &gauge = platform::Metrics::gauge(it.first);
+            metricRefs.push_back(std::make_unique<DataRefExport<float>>("avitab/metrics/" + it.first, this,
+                [&gauge] (void *) { return (float) gauge.value(); }));
+        }
+    }
+    for (auto &it: snapshot.histograms) {
+        if (exportedMetrics.insert(it.first).second) {
+            auto &histogram = platform::Metrics::histogram(it.first);
+            std::string name = "avitab/metrics/" + it.first;
+            metricRefs.push_back(std::make_unique<DataRefExport<float>>(name + "_p50", this,
+                [&histogram] (void *) { return (float) histogram.summarize().p50; }));
+            metricRefs.push_back(std::make_unique<DataRefExport<float>>(name + "_p95", this,
+                [&histogram] (void *) { return (float) histogram.summarize().p95; }));
+            metricRefs.push_back(std::make_unique<DataRefExport<float>>(name + "_p99", this,
+                [&histogram] (void *) { return (float) histogram.summarize().p99; }));
+        }
+    }
+}
+
+void XPlaneEnvironment::refreshDataSubscriptions() {
+    for (auto &subscription: takeNewSubscriptions()) {
+        ActiveSubscription active;
+        active.subscription = subscription;
+        for (auto &name: subscription->getDataRefs()) {
+            active.refs.push_back(dataCache.findDataRef(name));
+        }
+        dataSubscriptions.push_back(std::move(active));
+    }
+
+    for (auto it = dataSubscriptions.begin(); it != dataSubscriptions.end(); ) {
+        auto subscription = it->subscription.lock();
+        if (!subscription) {
+            it = dataSubscriptions.erase(it);
+            continue;
+        }
+
+        // same as the aircraft snapshot: refill the spare values once no reader holds them
+        auto &values = it->spareValues;
+        if (!values || values.use_count() > 1) {
+            values = std::make_shared<std::vector<EnvData>>(it->refs.size());
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        for (size_t i = 0; i < it->refs.size(); ++i) {
+            (*values)[i] = it->refs[i] ? dataCache.toEnvData(it->refs[i]) : EnvData{};
+        }
+
+        auto published = subscription->getValues();
+        subscription->publish(values);
+        values = std::const_pointer_cast<std::vector<EnvData>>(published);
+        ++it;
+    }
+}
+
 AircraftID XPlaneEnvironment::getActiveAircraftCount() {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    return (otherAircraftCount + 1);
+    return std::atomic_load(&aircraftLocations)->locations.size();
 }
 
 Location XPlaneEnvironment::getAircraftLocation(AircraftID id) {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    if (id < aircraftLocations.size()) {
-        return aircraftLocations[id];
+    auto snapshot = std::atomic_load(&aircraftLocations);
+    if (id < snapshot->locations.size()) {
+        return snapshot->locations[id];
     } else {
         return nullLocation;
     }
 }
 
+AircraftLocations XPlaneEnvironment::getAircraftLocations() {
+    return std::atomic_load(&aircraftLocations);
+}
+
 EnvData XPlaneEnvironment::getData(const std::string& dataRef) {
     std::promise<EnvData> dataPromise;
     auto futureData = dataPromise.get_future();
@@ -307,7 +422,7 @@ EnvData XPlaneEnvironment::getData(const std::string& dataRef) {
     return futureData.get();
 }
 
-Environment::MagVarMap XPlaneEnvironment::getMagneticVariations(std::vector<std::pair<double, double>> locations) {
+Environment::MagVarMap XPlaneEnvironment::sampleMagneticVariations(std::vector<std::pair<double, double>> locations) {
     std::promise<MagVarMap> dataPromise;
     auto futureData = dataPromise.get_future();
 
@@ -350,8 +465,7 @@ std::string XPlaneEnvironment::getMETARForAirport(const std::string &icao) {
         if (!airport) {
             throw std::invalid_argument("No such airport");
         }
-        timestamp = airport->getMetarTimestamp();
-        metar = airport->getMetarString();
+        airport->getCurrentMetar(timestamp, metar);
     }
 
     if (metar.empty()) {
@@ -393,6 +507,20 @@ void XPlaneEnvironment::updateMapExports(float lat, float lon, int zoom, float v
     mapVerticalRange = vrange;
 }
 
+void XPlaneEnvironment::updateOverlayTimingExports(const maps::OverlayTimings &timings) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    for (int i = 0; i < maps::OverlayTimings::NUM_LAYERS; i++) {
+        auto layer = static_cast<maps::OverlayTimings::Layer>(i);
+        overlayTimingsP50[i] = timings.getPercentile(layer, 50);
+        overlayTimingsP95[i] = timings.getPercentile(layer, 95);
+    }
+}
+
+float XPlaneEnvironment::getOverlayTiming(int layer, bool p95) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return p95 ? overlayTimingsP95[layer] : overlayTimingsP50[layer];
+}
+
 float XPlaneEnvironment::getMapLatitude() {
     std::lock_guard<std::mutex> lock(stateMutex);
     return mapLatitude;
@@ -431,18 +559,4 @@ void XPlaneEnvironment::onAircraftReload() {
     reloadAircraftPath();
 }
 
-void XPlaneEnvironment::updatePlaneCount() {
-    int tmp1, active;
-    XPLMPluginID tmp2;
-    XPLMCountAircraft(&tmp1, &active, &tmp2);
-    if (active > 0) {
-        otherAircraftCount = active - 1;
-        if (otherAircraftCount > MAX_AI_AIRCRAFT) {
-            otherAircraftCount = MAX_AI_AIRCRAFT;
-        }
-    } else {
-        otherAircraftCount = 0;
-    }
-}
-
 } /* namespace avitab */
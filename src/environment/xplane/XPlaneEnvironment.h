@@ -25,10 +25,13 @@
 #include <vector>
 #include <atomic>
 #include <map>
+#include <set>
 #include <thread>
 #include "src/gui_toolkit/LVGLToolkit.h"
 #include "src/environment/Environment.h"
+#include "src/maps/OverlayTimings.h"
 #include "DataCache.h"
+#include "LocationSampler.h"
 #include "DataRefExport.h"
 
 namespace avitab {
@@ -40,6 +43,7 @@ public:
     // Must be called from the environment thread - do not call from GUI thread!
     std::shared_ptr<world::LoadManager> createParsingWorldManager() override;
     std::shared_ptr<LVGLToolkit> createGUIToolkit() override;
+    bool supportsMultipleGUIToolkits() override;
     void createMenu(const std::string &name) override;
     void addMenuEntry(const std::string &label, MenuCallback cb) override;
     void destroyMenu() override;
@@ -55,18 +59,20 @@ public:
     std::string getEarthTexturePath() override;
     std::string getAirplanePath() override;
     std::string getFlightPlansPath() override;
-    Environment::MagVarMap getMagneticVariations(std::vector<std::pair<double, double>> locations) override;
     std::string getMETARForAirport(const std::string &icao) override;
     void enableAndPowerPanel() override;
     void setIsInMenu(bool menu) override;
     AircraftID getActiveAircraftCount() override;
     Location getAircraftLocation(AircraftID id) override;
+    AircraftLocations getAircraftLocations() override;
     void updateMapExports(float lat, float lon, int zoom, float vrange) override;
+    void updateOverlayTimingExports(const maps::OverlayTimings &timings) override;
 
     ~XPlaneEnvironment();
 
 protected:
     bool canUseNavDb(const std::string simCode) override;
+    Environment::MagVarMap sampleMagneticVariations(std::vector<std::pair<double, double>> locations) override;
 
 private:
     // Exported datarefs relating to the overlayed map status
@@ -83,10 +89,22 @@ private:
     std::unique_ptr<DataRefExport<int>> mapZoomRef;
     std::unique_ptr<DataRefExport<float>> mapVerticalRangeRef;
 
+    // Exported datarefs with the median and 95th percentile render time of each overlay layer
+    float getOverlayTiming(int layer, bool p95);
+    float overlayTimingsP50[maps::OverlayTimings::NUM_LAYERS] {};
+    float overlayTimingsP95[maps::OverlayTimings::NUM_LAYERS] {};
+    std::vector<std::unique_ptr<DataRefExport<float>>> overlayTimingRefs;
+    std::vector<std::unique_ptr<DataRefExport<float>>> profileRefs;
+    // avitab/metrics/..., only with the export_metrics setting
+    std::vector<std::unique_ptr<DataRefExport<float>>> metricRefs;
+    std::set<std::string> exportedMetrics;
+    size_t exportedMetricsGeneration = 0;
+
 private:
     using GetMetarPtr = void(*)(const char *id, XPLMFixedString150_t *outMETAR);
 
     struct RegisteredCommand {
+        std::string name;
         CommandCallback callback;
         bool inBefore;
         void *refCon;
@@ -95,9 +113,23 @@ private:
     // Cached data
     GetMetarPtr getMetar{};
     DataCache dataCache;
+    LocationSampler locationSampler;
     std::string pluginPath, xplanePrefsDir, xplaneRootPath;
     int xplaneVersion;
-    std::vector<Location> aircraftLocations;
+    // Published snapshot of all aircraft, only accessed through std::atomic_load and
+    // std::atomic_exchange so that readers never lock. The spare buffer is the one the
+    // flight loop fills next, it's only reused once no reader holds on to it anymore.
+    std::shared_ptr<AircraftSnapshot> aircraftLocations = std::make_shared<AircraftSnapshot>();
+    std::shared_ptr<AircraftSnapshot> spareAircraftLocations;
+    uint64_t aircraftFrame = 0;
+
+    // environment thread only, refs are nullptr for datarefs the sim doesn't have
+    struct ActiveSubscription {
+        std::weak_ptr<DataSubscription> subscription;
+        std::vector<XPLMDataRef> refs;
+        std::shared_ptr<std::vector<EnvData>> spareValues;
+    };
+    std::vector<ActiveSubscription> dataSubscriptions;
     Location nullLocation { 0, 0, 0, 0 };
     std::string aircraftPath;
 
@@ -120,12 +152,11 @@ private:
     std::string findPreferencesDir();
     XPLMFlightLoopID createFlightLoop();
     float onFlightLoop(float elapsedSinceLastCall, float elapseSinceLastLoop, int count);
+    void refreshDataSubscriptions();
+    void refreshMetricExports();
     static int handleCommand(XPLMCommandRef cmd, XPLMCommandPhase phase, void *ref);
     EnvData getData(const std::string &dataRef);
     void reloadAircraftPath();
-
-    unsigned int otherAircraftCount;
-    void updatePlaneCount();
 };
 
 } /* namespace avitab */
@@ -18,6 +18,7 @@
 #include <XPLM/XPLMGraphics.h>
 #include <XPLM/XPLMDisplay.h>
 #include <XPLM/XPLMUtilities.h>
+#include <XPLM/XPLMProcessing.h>
 #ifdef __APPLE__
 #include <OpenGL/gl.h>
 #else
@@ -25,9 +26,11 @@
 #include <GL/glext.h>
 #endif
 #include <stdexcept>
+#include <algorithm>
 #include "XPlaneGUIDriver.h"
 #include "MonitorBoundsDecider.h"
 #include "src/Logger.h"
+#include "src/platform/FrameProfiler.h"
 
 namespace avitab {
 
@@ -58,6 +61,9 @@ void XPlaneGUIDriver::init(int width, int height) {
     logger::verbose("Initializing X-Plane GUI driver");
     GUIDriver::init(width, height);
     setupKeyboard();
+    for (auto &frame: frames) {
+        frame.pixels.assign(data(), data() + this->width() * this->height());
+    }
     XPLMGenerateTextureNumbers(&textureId, 1);
 
     XPLMBindTexture2d(textureId, 0);
@@ -279,13 +285,67 @@ void XPlaneGUIDriver::killWindow() {
 }
 
 void XPlaneGUIDriver::blit(int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint32_t* data) {
-    GUIDriver::blit(x1, y1, x2, y2, data);
+    // called from the GUI thread, only touches the frame it owns
+    int w = width();
+    int cx1 = std::max(x1, 0);
+    int cy1 = std::max(y1, 0);
+    int cx2 = std::min(x2, w - 1);
+    int cy2 = std::min(y2, height() - 1);
+    if (cx1 > cx2 || cy1 > cy2) {
+        return;
+    }
 
-    std::lock_guard<std::mutex> lock(drawMutex);
-    needsRedraw = true;
+    uint32_t *fb = frames[drawFrame].pixels.data();
+    int stride = x2 - x1 + 1;
+    for (int y = cy1; y <= cy2; y++) {
+        const uint32_t *src = data + (y - y1) * stride + (cx1 - x1);
+        std::copy(src, src + (cx2 - cx1 + 1), fb + y * w + cx1);
+    }
+    frameRect.add(cx1, cy1, cx2, cy2);
+}
+
+void XPlaneGUIDriver::finishFrame() {
+    if (frameRect.empty()) {
+        return;
+    }
+
+    // If the render thread didn't take the previous frame yet, this one has to
+    // carry its changes as well. Should it take it right after this check,
+    // we only upload a bit more than needed.
+    if (latestFrame & FRESH_FRAME) {
+        pendingUpload.add(frameRect);
+    } else {
+        pendingUpload = frameRect;
+    }
+
+    int published = drawFrame;
+    frames[published].uploadRect = pendingUpload;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if ((int) i != published) {
+            frames[i].staleRect.add(frameRect);
+        }
+    }
+    frameRect = {};
+
+    drawFrame = latestFrame.exchange(published | FRESH_FRAME) & FRAME_INDEX_MASK;
+
+    // bring the new frame up to date, the published one is only read from now on
+    Frame &next = frames[drawFrame];
+    const DirtyRect &stale = next.staleRect;
+    if (!stale.empty()) {
+        int w = width();
+        const uint32_t *src = frames[published].pixels.data();
+        for (int y = stale.y1; y <= stale.y2; y++) {
+            size_t offset = y * w + stale.x1;
+            std::copy(src + offset, src + offset + (stale.x2 - stale.x1 + 1), next.pixels.data() + offset);
+        }
+    }
+    next.staleRect = {};
 }
 
 void XPlaneGUIDriver::onDraw() {
+    platform::ScopedFrameTiming timing(platform::FrameProfiler::SIM_DRAW);
+    onTabletDrawn();
     if (!window) {
         logger::warn("No window in onDraw");
         return;
@@ -314,6 +374,19 @@ void XPlaneGUIDriver::onDraw() {
     renderWindowTexture(left, top, right, bottom);
 }
 
+void XPlaneGUIDriver::onTabletDrawn() {
+    markDrawn();
+    int cycle = XPLMGetCycleNumber();
+    if (cycle != lastDrawnCycle) {
+        lastDrawnCycle = cycle;
+        signalSimFrame();
+    }
+}
+
+bool XPlaneGUIDriver::hasSimFrames() {
+    return true;
+}
+
 void XPlaneGUIDriver::onDrawPanel() {
     if (*panelEnabled == 0) {
         return;
@@ -338,6 +411,8 @@ void XPlaneGUIDriver::onDrawPanel() {
         return;
     }
 
+    onTabletDrawn();
+
     bool gotAnyTrigger = false;
     for (auto idx: vrTriggerIndices) {
         int triggerVal = 0;
@@ -363,14 +438,26 @@ void XPlaneGUIDriver::onDrawPanel() {
 }
 
 void XPlaneGUIDriver::redrawTexture() {
-    std::lock_guard<std::mutex> lock(drawMutex);
-    if (needsRedraw) {
-        glTexSubImage2D(GL_TEXTURE_2D, 0,
-                0, 0,
-                width(), height(),
-                GL_BGRA, GL_UNSIGNED_BYTE, data());
-        needsRedraw = false;
+    // only the GUI thread sets FRESH_FRAME, so it's still set when we swap
+    if (!(latestFrame & FRESH_FRAME)) {
+        return;
     }
+    shownFrame = latestFrame.exchange(shownFrame) & FRAME_INDEX_MASK;
+
+    const Frame &frame = frames[shownFrame];
+    const DirtyRect &rect = frame.uploadRect;
+    if (rect.empty()) {
+        return;
+    }
+
+    // upload only the changed area, reading it directly from the frame's rows
+    int w = width();
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+            rect.x1, rect.y1,
+            rect.x2 - rect.x1 + 1, rect.y2 - rect.y1 + 1,
+            GL_BGRA, GL_UNSIGNED_BYTE, frame.pixels.data() + rect.y1 * w + rect.x1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
 
 void XPlaneGUIDriver::correctRatio(int &left, int &top, int& right, int& bottom, bool center) {
@@ -489,6 +576,7 @@ bool XPlaneGUIDriver::onClick(int x, int y, XPLMMouseStatus status) {
         mouseY = guiY;
     }
 
+    signalActivity();
     return true;
 }
 
@@ -502,6 +590,7 @@ bool XPlaneGUIDriver::onMouseWheel(int x, int y, int wheel, int clicks) {
         mouseX = px;
         mouseY = py;
         mouseWheel = clicks;
+        signalActivity();
         return true;
     }
     return false;
@@ -552,6 +641,8 @@ bool XPlaneGUIDriver::onClickCapture(int x, int y, XPLMMouseStatus status) {
         isInWindow = false;
     }
 
+    signalActivity();
+
     if (isInWindow) {
         mouseX = (tx - left) / (right - left) * width();
         mouseY = (top - ty) / (top - bottom) * height();
@@ -590,6 +681,7 @@ bool XPlaneGUIDriver::onMouseWheelCapture(int x, int y, int wheel, int clicks) {
         mouseX = (guiX - left) / (right - left) * width();
         mouseY = (top - guiY) / (top - bottom) * height();
         mouseWheel = clicks;
+        signalActivity();
         return true;
     }
     return false;
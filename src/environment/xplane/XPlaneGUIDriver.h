@@ -23,6 +23,7 @@
 #include <XPLM/XPLMDataAccess.h>
 #include <atomic>
 #include <mutex>
+#include <array>
 #include <memory>
 #include <vector>
 #include "src/environment/GUIDriver.h"
@@ -49,15 +50,38 @@ public:
 
     void readPointerState(int &x, int &y, bool &pressed) override;
     void blit(int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint32_t *data) override;
+    void finishFrame() override;
 
     int getWheelDirection() override;
     void setBrightness(float b) override;
     float getBrightness() override;
 
     void passLeftClick(bool down) override;
+    bool hasSimFrames() override;
 
     ~XPlaneGUIDriver();
 private:
+    struct Frame {
+        std::vector<uint32_t> pixels;
+        // area that changed since the frame the render thread took before this one
+        DirtyRect uploadRect;
+        // area that changed in later frames, copied in before the GUI thread draws on it again
+        DirtyRect staleRect;
+    };
+
+    // Triple buffered frames: the GUI thread draws one, the render thread shows
+    // one and the third is the latest complete frame, swapped in by either
+    // thread without waiting for the other.
+    static constexpr const int FRAME_INDEX_MASK = 0x3;
+    static constexpr const int FRESH_FRAME = 0x4;
+    std::array<Frame, 3> frames;
+    int drawFrame = 0;
+    int shownFrame = 1;
+    // index of the latest frame, FRESH_FRAME is set until the render thread takes it
+    std::atomic_int latestFrame {2};
+    // GUI thread only: area changed in drawFrame and area published but not yet taken
+    DirtyRect frameRect, pendingUpload;
+
     WindowRect lastRect{};
     std::shared_ptr<float> brightness;
     DataRefImport<bool> isVrEnabled;
@@ -70,16 +94,17 @@ private:
     std::atomic_int mouseX {0}, mouseY {0};
     std::atomic_bool mousePressed {false};
     std::atomic_int mouseWheel {0};
-    std::mutex drawMutex;
-    bool needsRedraw = false;
     std::unique_ptr<DataRefExport<int>> panelLeftRef, panelBottomRef, panelWidthRef, panelHeightRef;
     int panelLeft = 0, panelBottom = 0, panelWidth = 0, panelHeight = 0;
     std::vector<int> vrTriggerIndices;
     bool mouseDownFromTrigger = false;
     bool hasPanel = false;
+    // window and panel can both be drawn in the same sim frame
+    int lastDrawnCycle = -1;
 
     void onDraw();
     void onDrawPanel();
+    void onTabletDrawn();
     void redrawTexture();
     void renderWindowTexture(int left, int top, int right, int bottom);
     void correctRatio(int &left, int &top, int &right, int &bottom, bool center);
@@ -0,0 +1,229 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <lvgl/lvgl.h>
+#include "GUILoop.h"
+#include "LVGLToolkit.h"
+#include "src/platform/Platform.h"
+#include "src/platform/CrashHandler.h"
+#include "src/platform/FrameProfiler.h"
+#include "src/platform/Tracer.h"
+#include "src/Logger.h"
+
+namespace avitab {
+
+GUILoop &GUILoop::shared() {
+    static GUILoop loop;
+    return loop;
+}
+
+void GUILoop::addSurface(LVGLToolkit *surface, std::function<void()> init) {
+    {
+        std::lock_guard<std::mutex> lock(surfacesMutex);
+        initLVGL();
+        init();
+        surfaces.push_back(surface);
+
+        if (!guiThread) {
+            guiThread = std::make_unique<std::thread>(&GUILoop::run, this);
+        }
+    }
+
+    // the new surface's first frame is due right away
+    wakeUpLoop();
+}
+
+void GUILoop::removeSurface(LVGLToolkit *surface, std::function<void()> detach) {
+    std::unique_ptr<std::thread> thread;
+    {
+        std::lock_guard<std::mutex> lock(surfacesMutex);
+        surfaces.erase(std::remove(surfaces.begin(), surfaces.end(), surface), surfaces.end());
+        if (surfaces.empty()) {
+            thread = std::move(guiThread);
+        } else {
+            detach();
+        }
+    }
+
+    if (thread) {
+        wakeUpLoop();
+        thread->join();
+        detach();
+    }
+}
+
+void GUILoop::initLVGL() {
+    if (lvglIsInitialized) {
+        return;
+    }
+
+    // LVGL does not support de-initialization so we can only do this once
+    lv_log_register_print_cb([] (lv_log_level_t level, const char *file, uint32_t line, const char *msg) {
+        switch (level) {
+            case LV_LOG_LEVEL_WARN:
+                logger::warn("GUI: %s:%d %s", file, line, msg);
+                break;
+            case LV_LOG_LEVEL_ERROR:
+                logger::error("GUI: %s:%d %s", file, line, msg);
+                break;
+            default:
+                logger::verbose("GUI: %s:%d %s", file, line, msg);
+                break;
+        }
+    });
+
+    lv_init();
+
+    lv_theme_t *theme = lv_theme_night_init(210, LV_FONT_DEFAULT);
+    lv_theme_set_current(theme);
+    lvglIsInitialized = true;
+}
+
+void GUILoop::run() {
+    crash::ThreadCookie crashCookie;
+    platform::Tracer::setThreadName("gui");
+
+    logger::verbose("LVGL thread has id %d", std::this_thread::get_id());
+
+    // chrono clocks run at 64Hz precision in mingw, use something custom
+    auto frameAt = platform::measureTime();
+    while (true) {
+        int waitMillis;
+        {
+            std::lock_guard<std::mutex> lock(surfacesMutex);
+            if (surfaces.empty()) {
+                break;
+            }
+
+            int elapsedMillis = std::max(platform::getElapsedMillis(frameAt), 1);
+            frameAt = platform::measureTime();
+            lv_tick_inc(elapsedMillis);
+            waitMillis = runFrame(elapsedMillis);
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait_for(lock, std::chrono::milliseconds(waitMillis), [this] { return wakeLoop; });
+        wakeLoop = false;
+    }
+
+    logger::verbose("LVGL thread destroyed");
+}
+
+int GUILoop::runFrame(int elapsedMillis) {
+    // Stopped surfaces take no part anymore. Once all are stopped, LVGL doesn't
+    // run at all so that no timer waits for the stopped environment.
+    bool anyActive = false;
+    dueSurfaces.clear();
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        for (LVGLToolkit *surface: surfaces) {
+            if (!surface->guiActive) {
+                continue;
+            }
+            anyActive = true;
+            surface->idleMillis += elapsedMillis;
+            surface->sinceFrameMillis += elapsedMillis;
+
+            // a paced surface waits for its simulator frame, the others for input and tasks
+            bool signalled = surface->pacedWait ? surface->frameDue : surface->wakeRequested;
+            if (signalled || surface->sinceFrameMillis >= surface->framePeriodMillis) {
+                surface->sinceFrameMillis = 0;
+                surface->frameDue = false;
+                surface->wakeRequested = false;
+                dueSurfaces.push_back(surface);
+            }
+        }
+    }
+
+    if (!anyActive) {
+        return STOPPED_PERIOD_MS;
+    }
+
+    for (LVGLToolkit *surface: surfaces) {
+        if (surface->guiActive) {
+            bool due = std::find(dueSurfaces.begin(), dueSurfaces.end(), surface) != dueSurfaces.end();
+            surface->setRefreshEnabled(due);
+        }
+    }
+
+    // first run the actual GUI tasks, i.e. let LVGL do its animations etc.
+    try {
+        platform::ScopedFrameTiming timing(platform::FrameProfiler::LVGL);
+        lv_task_handler();
+        for (LVGLToolkit *surface: dueSurfaces) {
+            surface->finishFrame();
+        }
+    } catch (const std::exception &e) {
+        logger::error("Exception in GUI: %s", e.what());
+    }
+
+    // then run the surfaces' own tasks
+    for (LVGLToolkit *surface: dueSurfaces) {
+        try {
+            surface->runFrameTasks();
+        } catch (const std::exception &e) {
+            logger::error("Exception in GUI: %s", e.what());
+        }
+    }
+
+    int waitMillis = STOPPED_PERIOD_MS;
+    for (LVGLToolkit *surface: surfaces) {
+        if (!surface->guiActive) {
+            continue;
+        }
+
+        bool paced;
+        int periodMillis;
+        surface->planNextFrame(paced, periodMillis);
+
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        surface->pacedWait = paced;
+        surface->framePeriodMillis = periodMillis;
+        waitMillis = std::min(waitMillis, std::max(periodMillis - surface->sinceFrameMillis, 0));
+    }
+    return waitMillis;
+}
+
+void GUILoop::wakeUp(LVGLToolkit *surface) {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        surface->wakeRequested = true;
+        wakeLoop = wakeLoop || !surface->pacedWait;
+    }
+    wakeCondition.notify_one();
+}
+
+void GUILoop::signalFrameDue(LVGLToolkit *surface) {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        surface->frameDue = true;
+        wakeLoop = wakeLoop || surface->pacedWait;
+    }
+    wakeCondition.notify_one();
+}
+
+void GUILoop::wakeUpLoop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeLoop = true;
+    }
+    wakeCondition.notify_one();
+}
+
+} /* namespace avitab */
@@ -0,0 +1,76 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+namespace avitab {
+
+class LVGLToolkit;
+
+// Runs LVGL and the frames of all GUI surfaces in one thread since LVGL isn't
+// thread-safe. Each surface keeps its own pace: the loop sleeps until the next
+// surface is due and only the due surfaces' displays refresh. The thread runs
+// while there are surfaces.
+class GUILoop {
+public:
+    static GUILoop &shared();
+
+    // init and detach run while no frame is running, so they can create and
+    // delete LVGL objects. Called from the environment thread.
+    void addSurface(LVGLToolkit *surface, std::function<void()> init);
+    // the loop doesn't call the surface anymore once this returns, joins the thread
+    // after the last surface
+    void removeSurface(LVGLToolkit *surface, std::function<void()> detach);
+
+    // can be called from any thread
+    void wakeUp(LVGLToolkit *surface);
+    void signalFrameDue(LVGLToolkit *surface);
+    // without making a surface due, e.g. to notice that one stopped
+    void wakeUpLoop();
+
+private:
+    // loop period while all surfaces are stopped
+    static const int STOPPED_PERIOD_MS = 500;
+
+    // held while a frame runs
+    std::mutex surfacesMutex;
+    std::vector<LVGLToolkit *> surfaces;
+    // gets called with locked surfacesMutex
+    std::vector<LVGLToolkit *> dueSurfaces;
+    std::unique_ptr<std::thread> guiThread;
+    bool lvglIsInitialized = false;
+
+    // also guards the surfaces' frame scheduling
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    bool wakeLoop = false;
+
+    GUILoop() = default;
+    void initLVGL();
+    void run();
+    // gets called with locked surfacesMutex, returns the milliseconds until the next surface is due
+    int runFrame(int elapsedMillis);
+};
+
+} /* namespace avitab */
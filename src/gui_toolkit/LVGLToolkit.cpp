@@ -15,79 +15,118 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <cmath>
+#include <algorithm>
 #include <chrono>
 #include <lvgl/lvgl.h>
 #include "LVGLToolkit.h"
+#include "GUILoop.h"
 #include "widgets/Keyboard.h"
 #include "src/platform/Platform.h"
-#include "src/platform/CrashHandler.h"
+#include "src/platform/FrameProfiler.h"
+#include "src/environment/FlightTrace.h"
+#include "src/environment/RemoteDisplay.h"
 #include "src/Logger.h"
 
 namespace avitab {
 
 namespace {
-bool lvglIsInitialized = false;
-lv_disp_buf_t lvDispBuf;
-lv_disp_drv_t lvDriver;
-lv_indev_drv_t inputDriver;
+// LVGL refreshes one display after the other and flushes them synchronously,
+// so all displays can share one draw buffer
 std::vector<uint32_t> tmpBuffer;
 }
 
+// LVGL can't remove displays and input devices, the ones of detached surfaces are reused
+struct LVGLToolkit::SurfaceSlot {
+    lv_disp_buf_t dispBuf;
+    lv_disp_drv_t dispDriver;
+    lv_indev_drv_t inputDriver;
+    lv_disp_t *display = nullptr;
+    lv_indev_t *input = nullptr;
+    lv_task_prio_t refreshPriority = LV_TASK_PRIO_MID;
+    bool refreshEnabled = true;
+    bool inUse = false;
+};
+
 LVGLToolkit::LVGLToolkit(std::shared_ptr<GUIDriver> drv):
     driver(drv)
 {
     driver->init(INITIAL_WIDTH, INITIAL_HEIGHT);
+    driver->setActivityCallback([this] () {
+        idleMillis = 0;
+        wakeGuiLoop();
+    });
+    driver->setSimFrameCallback([this] () { onSimFrame(); });
 
-    if (!lvglIsInitialized) {
-        // LVGL does not support de-initialization so we can only do this once
-        lv_log_register_print_cb([] (lv_log_level_t level, const char *file, uint32_t line, const char *msg) {
-            switch (level) {
-                case LV_LOG_LEVEL_WARN:
-                    logger::warn("GUI: %s:%d %s", file, line, msg);
-                    break;
-                case LV_LOG_LEVEL_ERROR:
-                    logger::error("GUI: %s:%d %s", file, line, msg);
-                    break;
-                default:
-                    logger::verbose("GUI: %s:%d %s", file, line, msg);
-                    break;
-            }
-        });
-
-        lv_init();
+    guiActive = true;
+    GUILoop::shared().addSurface(this, [this] { attachSurface(); });
+}
 
-        lv_theme_t *theme = lv_theme_night_init(210, LV_FONT_DEFAULT);
-        lv_theme_set_current(theme);
-        lvglIsInitialized = true;
+LVGLToolkit::SurfaceSlot *LVGLToolkit::acquireSlot() {
+    // gets called with the GUI loop paused
+    static std::vector<std::unique_ptr<SurfaceSlot>> slots;
+    for (auto &slot: slots) {
+        if (!slot->inUse) {
+            slot->inUse = true;
+            return slot.get();
+        }
     }
 
+    slots.push_back(std::make_unique<SurfaceSlot>());
+    slots.back()->inUse = true;
+    return slots.back().get();
+}
+
+void LVGLToolkit::attachSurface() {
+    // gets called with the GUI loop paused
+    slot = acquireSlot();
     initDisplayDriver();
     initInputDriver();
 
-    // if keepAlive if true, the window was hidden without us noticing
-    // so it's enough to re-create it without starting rendering again
+    // the screen is the active one of our display
+    lv_disp_set_default(slot->display);
     mainScreen = std::make_shared<Screen>();
-    guiActive = true;
-    guiThread = std::make_unique<std::thread>(&LVGLToolkit::guiLoop, this);
+}
+
+void LVGLToolkit::detachSurface() {
+    // gets called with the GUI loop paused
+    if (!slot) {
+        return;
+    }
+
+    // LVGL keeps copies of the drivers
+    mainScreen.reset();
+    slot->display->driver.user_data = nullptr;
+    slot->input->driver.user_data = nullptr;
+    setRefreshEnabled(true);
+    slot->inUse = false;
+    slot = nullptr;
 }
 
 void LVGLToolkit::initDisplayDriver() {
     static_assert(sizeof(lv_color_t) == sizeof(uint32_t), "Invalid lvgl color type");
-    bool isUpdate = (lvDriver.buffer != nullptr);
+    static_assert(GUIDriver::MAX_WIDTH == LV_HOR_RES_MAX && GUIDriver::MAX_HEIGHT == LV_VER_RES_MAX,
+                  "GUI driver and LVGL limits differ");
+    bool isUpdate = (slot->display != nullptr);
 
-    tmpBuffer.resize(LV_HOR_RES_MAX * LV_VER_RES_MAX);
-    lv_disp_buf_init(&lvDispBuf, tmpBuffer.data(), nullptr, tmpBuffer.size());
+    if (tmpBuffer.empty()) {
+        tmpBuffer.resize(LV_HOR_RES_MAX * LV_VER_RES_MAX);
+    }
+    lv_disp_buf_init(&slot->dispBuf, tmpBuffer.data(), nullptr, tmpBuffer.size());
 
+    lv_disp_drv_t &lvDriver = slot->dispDriver;
     lv_disp_drv_init(&lvDriver);
 
     lvDriver.user_data = this;
     lvDriver.hor_res = INITIAL_WIDTH;
     lvDriver.ver_res = INITIAL_HEIGHT;
-    lvDriver.buffer = &lvDispBuf;
+    lvDriver.buffer = &slot->dispBuf;
 
     lvDriver.flush_cb = [] (lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *data) {
         LVGLToolkit *us = (LVGLToolkit *) drv->user_data;
         if (!us) {
+            // the display of a detached surface, LVGL waits for this before it refreshes again
+            lv_disp_flush_ready(drv);
             return;
         }
 
@@ -96,27 +135,38 @@ void LVGLToolkit::initDisplayDriver() {
         int x2 = area->x2;
         int y2 = area->y2;
 
-        us->driver->blit(x1, y1, x2, y2, reinterpret_cast<const uint32_t *>(data));
+        {
+            platform::ScopedFrameTiming timing(platform::FrameProfiler::BLIT);
+            us->driver->blit(x1, y1, x2, y2, reinterpret_cast<const uint32_t *>(data));
+            if (auto remote = std::atomic_load(&us->remoteDisplay)) {
+                remote->onBlit(drv->hor_res, drv->ver_res, x1, y1, x2, y2, reinterpret_cast<const uint32_t *>(data));
+            }
+        }
         lv_disp_flush_ready(drv);
     };
 
     driver->setResizeCallback([this] (int w, int h) {
-        executeLater([w, h] {
-            lvDriver.hor_res = std::min(w, LV_HOR_RES_MAX);
-            lvDriver.ver_res = std::min(h, LV_VER_RES_MAX);
-            lv_disp_drv_update(lv_disp_get_default(), &lvDriver);
+        executeLater([this, w, h] {
+            if (!slot) {
+                return;
+            }
+            slot->dispDriver.hor_res = std::min(w, LV_HOR_RES_MAX);
+            slot->dispDriver.ver_res = std::min(h, LV_VER_RES_MAX);
+            lv_disp_drv_update(slot->display, &slot->dispDriver);
         });
     });
 
     if (isUpdate) {
-        lv_disp_drv_update(lv_disp_get_default(), &lvDriver);
+        lv_disp_drv_update(slot->display, &lvDriver);
     } else {
-        lv_disp_drv_register(&lvDriver);
+        slot->display = lv_disp_drv_register(&lvDriver);
+        slot->refreshPriority = (lv_task_prio_t) slot->display->refr_task->prio;
     }
 }
 
 void LVGLToolkit::initInputDriver() {
-    bool isUpdate = (inputDriver.read_cb != nullptr);
+    lv_indev_drv_t &inputDriver = slot->inputDriver;
+    bool isUpdate = (slot->input != nullptr);
 
     if (!isUpdate) {
         lv_indev_drv_init(&inputDriver);
@@ -124,15 +174,23 @@ void LVGLToolkit::initInputDriver() {
 
     inputDriver.type = LV_INDEV_TYPE_POINTER;
     inputDriver.user_data = this;
+    inputDriver.disp = slot->display;
     inputDriver.read_cb = [] (lv_indev_drv_t  *drv, lv_indev_data_t *data) -> bool {
         LVGLToolkit *us = (LVGLToolkit *) drv->user_data;
         if (!us) {
             return false;
         }
 
+        // LVGL handles the input right after reading it, widgets created by the
+        // event handlers go to our display
+        lv_disp_set_default(us->slot->display);
+
         int x, y;
         bool pressed;
-        us->driver->readPointerState(x, y, pressed);
+        us->readPointerState(x, y, pressed);
+        if (auto recorder = std::atomic_load(&us->traceRecorder)) {
+            recorder->recordPointer(x, y, pressed);
+        }
         data->state = pressed ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
         data->point.x = x;
         data->point.y = y;
@@ -140,20 +198,26 @@ void LVGLToolkit::initInputDriver() {
     };
 
     if (isUpdate) {
-        lv_indev_drv_update(lv_indev_get_next(nullptr), &inputDriver);
+        lv_indev_drv_update(slot->input, &inputDriver);
     } else {
-        lv_indev_drv_register(&inputDriver);
+        slot->input = lv_indev_drv_register(&inputDriver);
     }
 }
 
 void LVGLToolkit::createNativeWindow(const std::string& title, const WindowRect &rect) {
     driver->createWindow(title, rect);
+    wakeGuiLoop();
 }
 
 bool LVGLToolkit::hasNativeWindow() {
     return driver->hasWindow();
 }
 
+bool LVGLToolkit::isTabletShown() {
+    auto remote = std::atomic_load(&remoteDisplay);
+    return driver->isShown() || (remote && remote->hasClient());
+}
+
 WindowRect LVGLToolkit::getNativeWindowRect() {
     return driver->getWindowRect();
 }
@@ -164,6 +228,7 @@ void LVGLToolkit::pauseNativeWindow() {
 
 void LVGLToolkit::createPanel(int left, int bottom, int width, int height, bool captureClicks) {
     driver->createPanel(left, bottom, width, height, captureClicks);
+    wakeGuiLoop();
 }
 
 void LVGLToolkit::hidePanel() {
@@ -172,14 +237,13 @@ void LVGLToolkit::hidePanel() {
 
 void LVGLToolkit::signalStop() {
     guiActive = false;
+    GUILoop::shared().wakeUpLoop();
 }
 
 void LVGLToolkit::destroyNativeWindow() {
-    if (guiThread) {
+    if (slot) {
         guiActive = false;
-        guiThread->join();
-        guiThread.reset();
-        mainScreen.reset();
+        GUILoop::shared().removeSurface(this, [this] { detachSurface(); });
         driver->setWantKeyInput(false);
         driver->hidePanel();
         driver->killWindow();
@@ -202,50 +266,122 @@ float LVGLToolkit::getBrightness() {
     return driver->getBrightness();
 }
 
-void LVGLToolkit::guiLoop() {
-    using namespace std::chrono_literals;
-    crash::ThreadCookie crashCookie;
+void LVGLToolkit::setRefreshEnabled(bool enable) {
+    // a surface that isn't due keeps its invalid areas until its next frame
+    if (enable != slot->refreshEnabled) {
+        lv_task_set_prio(slot->display->refr_task, enable ? slot->refreshPriority : LV_TASK_PRIO_OFF);
+        slot->refreshEnabled = enable;
+    }
+}
 
-    logger::verbose("LVGL thread has id %d", std::this_thread::get_id());
+void LVGLToolkit::finishFrame() {
+    driver->finishFrame();
+    if (auto remote = std::atomic_load(&remoteDisplay)) {
+        remote->onFrameFinished();
+    }
+}
 
-    while (guiActive) {
-        // chrono clocks run at 64Hz precision in mingw, use something custom
-        auto startAt = platform::measureTime();
+void LVGLToolkit::runFrameTasks() {
+    // widgets created by the tasks go to our display
+    lv_disp_set_default(slot->display);
+    runPendingTasks();
+    handleMouseWheel();
+    handleKeyboard();
+}
 
-        try {
-            // first run the actual GUI tasks, i.e. let LVGL do its animations etc.
-            lv_task_handler();
+void LVGLToolkit::planNextFrame(bool &paced, int &periodMillis) {
+    int x, y;
+    bool pressed;
+    readPointerState(x, y, pressed);
+    if (pressed || lv_anim_count_running() > 0 || !backgroundTasks.empty()) {
+        idleMillis = 0;
+    }
 
-            // then run our own tasks
-            // To prevent race-conditions since a task could
-            // use the environment mutex or create new tasks,
-            // let's work on a copy. This also prevents
-            // deadlocks if a task decides to use the environment
-            // mutex by doing something in the environment
-            std::vector<GUITask> tasks;
-            {
-                std::lock_guard<std::recursive_mutex> lock(guiMutex);
-                tasks = pendingTasks;
-                pendingTasks.clear();
-            }
+    bool active = idleMillis < ACTIVE_LINGER_MS;
+    bool shown = driver->isShown();
+    auto remote = std::atomic_load(&remoteDisplay);
+    bool shownRemotely = remote && remote->hasClient();
+
+    // Render in step with the simulator so that no frame is drawn that is never
+    // displayed, input and new tasks wait for the next due frame. The period
+    // covers the tablet being hidden while we wait.
+    paced = active && shown && driver->hasSimFrames() && framePacing != FRAME_PACING_OFF;
+    if (paced) {
+        periodMillis = IDLE_PERIOD_MS;
+    } else if (active) {
+        periodMillis = ACTIVE_PERIOD_MS;
+    } else if (shown || shownRemotely) {
+        periodMillis = IDLE_PERIOD_MS;
+    } else {
+        periodMillis = HIDDEN_PERIOD_MS;
+    }
+}
 
-            for (GUITask &task: tasks) {
-                task();
-            }
+void LVGLToolkit::onSimFrame() {
+    int64_t periodUs = platform::getElapsedMicros(lastSimFrameAt);
+    lastSimFrameAt = platform::measureTime();
+    if (periodUs > 0 && periodUs < 1000000) {
+        simFramePeriodUs = (simFramePeriodUs == 0) ? periodUs : (simFramePeriodUs * 7 + periodUs) / 8;
+    }
 
-            handleMouseWheel();
-            handleKeyboard();
-        } catch (const std::exception &e) {
-            logger::error("Exception in GUI: %s", e.what());
+    int simFrames = framePacing;
+    if (simFrames == FRAME_PACING_OFF) {
+        return;
+    } else if (simFrames == FRAME_PACING_AUTO) {
+        simFrames = 1;
+        if (simFramePeriodUs > 0) {
+            simFrames = std::lround(AUTO_PACING_PERIOD_US / simFramePeriodUs);
         }
+    }
+    simFrames = std::max(1, std::min(simFrames, MAX_PACING_FRAMES));
 
-        std::this_thread::sleep_for(1ms);
-        auto elapsedMillis = platform::getElapsedMillis(startAt);
+    if (++simFramesSinceDue < simFrames) {
+        return;
+    }
+    simFramesSinceDue = 0;
 
-        lv_tick_inc(std::max(elapsedMillis, 1));
+    GUILoop::shared().signalFrameDue(this);
+}
+
+void LVGLToolkit::setFramePacing(int simFrames) {
+    if (simFrames < FRAME_PACING_OFF) {
+        simFrames = FRAME_PACING_OFF;
     }
+    logger::verbose("GUI frame pacing: %d", simFrames);
+    framePacing = simFrames;
+}
+
+void LVGLToolkit::setRenderScale(float scale) {
+    driver->setRenderScale(scale);
+}
 
-    logger::verbose("LVGL thread destroyed");
+float LVGLToolkit::getRenderScale() {
+    return driver->getRenderScale();
+}
+
+void LVGLToolkit::wakeGuiLoop() {
+    GUILoop::shared().wakeUp(this);
+}
+
+void LVGLToolkit::setTraceRecorder(std::shared_ptr<FlightTraceWriter> recorder) {
+    std::atomic_store(&traceRecorder, recorder);
+}
+
+void LVGLToolkit::setRemoteDisplay(std::shared_ptr<RemoteDisplay> display) {
+    if (display) {
+        display->setInputCallback([this] () {
+            idleMillis = 0;
+            wakeGuiLoop();
+        });
+    }
+    std::atomic_store(&remoteDisplay, display);
+}
+
+void LVGLToolkit::readPointerState(int &x, int &y, bool &pressed) {
+    driver->readPointerState(x, y, pressed);
+    if (auto remote = std::atomic_load(&remoteDisplay)) {
+        remote->mergePointerState(x, y, pressed);
+    }
 }
 
 void LVGLToolkit::sendLeftClick(bool down) {
@@ -254,10 +390,15 @@ void LVGLToolkit::sendLeftClick(bool down) {
 
 void LVGLToolkit::handleMouseWheel() {
     int dir = driver->getWheelDirection();
+    if (dir != 0) {
+        if (auto recorder = std::atomic_load(&traceRecorder)) {
+            recorder->recordWheel(dir);
+        }
+    }
     if (dir != 0 && onMouseWheel) {
         int x, y;
         bool pressed;
-        driver->readPointerState(x, y, pressed);
+        readPointerState(x, y, pressed);
         onMouseWheel(dir, x, y);
     }
 }
@@ -268,7 +409,11 @@ void LVGLToolkit::handleKeyboard() {
 
     // then process keys
     uint32_t c = 0;
+    auto recorder = std::atomic_load(&traceRecorder);
     while ((c = driver->popKeyPress()) != 0) {
+        if (recorder) {
+            recorder->recordKey(c);
+        }
         if (keyboard) {
             auto ta = lv_kb_get_ta(keyboard);
             auto keyb = (Keyboard *) lv_obj_get_user_data(keyboard);
@@ -323,17 +468,50 @@ lv_obj_t *LVGLToolkit::searchActiveKeyboard(lv_obj_t* obj) {
     return nullptr;
 }
 
-void LVGLToolkit::executeLater(GUITask func) {
-    std::lock_guard<std::recursive_mutex> lock(guiMutex);
+void LVGLToolkit::executeLater(GUITask func, TaskPriority priority) {
     if (guiActive) {
-        pendingTasks.push_back(func);
+        taskQueues[static_cast<size_t>(priority)].push(std::move(func));
+        wakeGuiLoop();
+    }
+}
+
+void LVGLToolkit::runPendingTasks() {
+    // Only the tasks queued so far run, tasks queued by them run in the next
+    // loop. No lock is held while they run, so they can use the environment
+    // or queue new tasks.
+    std::vector<GUITask> tasks;
+    taskQueues[static_cast<size_t>(TaskPriority::INPUT)].popAll(tasks);
+
+    std::vector<GUITask> newBackgroundTasks;
+    taskQueues[static_cast<size_t>(TaskPriority::BACKGROUND)].popAll(newBackgroundTasks);
+    for (auto &task: newBackgroundTasks) {
+        backgroundTasks.push_back(std::move(task));
+    }
+
+    if (tasks.empty() && backgroundTasks.empty()) {
+        return;
+    }
+
+    platform::ScopedFrameTiming timing(platform::FrameProfiler::GUI_TASKS);
+    for (GUITask &task: tasks) {
+        task();
+    }
+
+    auto startAt = platform::measureTime();
+    while (!backgroundTasks.empty()) {
+        GUITask task = std::move(backgroundTasks.front());
+        backgroundTasks.pop_front();
+        task();
+        if (platform::getElapsedMillis(startAt) >= BACKGROUND_BUDGET_MS) {
+            break;
+        }
     }
 }
 
 LVGLToolkit::~LVGLToolkit() {
     logger::verbose("~LVGLToolkit");
-    inputDriver.user_data = nullptr;
-    lvDriver.user_data = nullptr;
+    driver->setActivityCallback(nullptr);
+    driver->setSimFrameCallback(nullptr);
     destroyNativeWindow();
 }
 
@@ -19,21 +19,34 @@
 #define SRC_GUI_TOOLKIT_LVGLTOOLKIT_H_
 
 #include <atomic>
-#include <thread>
 #include <memory>
 #include <functional>
 #include <mutex>
 #include <vector>
+#include <deque>
+#include <array>
 #include "src/environment/GUIDriver.h"
 #include "src/gui_toolkit/widgets/Screen.h"
+#include "src/gui_toolkit/TaskQueue.h"
+#include "src/platform/Platform.h"
 
 namespace avitab {
 
+class FlightTraceWriter;
+class RemoteDisplay;
+
+// One GUI surface, i.e. an LVGL display with its own driver, input and screen.
+// All surfaces of the process run in the GUILoop's thread.
 class LVGLToolkit {
 public:
     using GUITask = std::function<void()>;
     using MouseWheelCallback = std::function<void(int, int, int)>;
 
+    // derive the pacing from the simulator's frame rate
+    static constexpr const int FRAME_PACING_AUTO = 0;
+    // run the GUI loop on its own clock
+    static constexpr const int FRAME_PACING_OFF = -1;
+
     LVGLToolkit(std::shared_ptr<GUIDriver> drv);
 
     void setMouseWheelCallback(MouseWheelCallback cb);
@@ -42,33 +55,97 @@ public:
     void hidePanel();
     void pauseNativeWindow();
     bool hasNativeWindow();
+    bool isTabletShown();
     WindowRect getNativeWindowRect();
     void signalStop();
     void destroyNativeWindow();
     void setBrightness(float b);
     float getBrightness();
     void sendLeftClick(bool down);
+    // While the user interacts, render one frame every simFrames simulator frames
+    // instead of as fast as possible. Only applies to drivers with sim frames.
+    void setFramePacing(int simFrames);
+    // GUI resolution relative to the window, see GUIDriver::setRenderScale
+    void setRenderScale(float scale);
+    float getRenderScale();
+    // GUI input is recorded into the trace while set, nullptr stops recording
+    void setTraceRecorder(std::shared_ptr<FlightTraceWriter> recorder);
+    // the screen is streamed to the display and its pointer input used while set
+    void setRemoteDisplay(std::shared_ptr<RemoteDisplay> display);
 
     std::shared_ptr<Screen> &screen();
 
-    void executeLater(GUITask func);
+    // can be called from any thread
+    void executeLater(GUITask func, TaskPriority priority = TaskPriority::INPUT);
 
     ~LVGLToolkit();
 private:
+    friend class GUILoop;
+    struct SurfaceSlot;
+
     static const int INITIAL_WIDTH = 800;
     static const int INITIAL_HEIGHT = 480;
 
+    // loop periods while the user interacts or LVGL animates, while the tablet
+    // is just showing something and while it isn't visible at all
+    static const int ACTIVE_PERIOD_MS = 1;
+    static const int IDLE_PERIOD_MS = 50;
+    static const int HIDDEN_PERIOD_MS = 500;
+    // keep the active period for a while after the last input
+    static const int ACTIVE_LINGER_MS = 1000;
+    // time per loop for background tasks, the rest waits for the next loop
+    static const int BACKGROUND_BUDGET_MS = 10;
+    // automatic pacing aims for this frame period, i.e. 30 frames per second
+    static const int AUTO_PACING_PERIOD_US = 33333;
+    static const int MAX_PACING_FRAMES = 8;
+
     MouseWheelCallback onMouseWheel;
-    std::recursive_mutex guiMutex;
-    std::vector<GUITask> pendingTasks;
+    std::array<TaskQueue, 2> taskQueues;
+    // popped background tasks that didn't fit into the budget, GUI thread only
+    std::deque<GUITask> backgroundTasks;
     std::shared_ptr<GUIDriver> driver;
-    std::unique_ptr<std::thread> guiThread;
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<FlightTraceWriter> traceRecorder;
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<RemoteDisplay> remoteDisplay;
+    // the LVGL display and input device, nullptr while not part of the GUI loop
+    SurfaceSlot *slot = nullptr;
     std::atomic_bool guiActive;
     std::shared_ptr<Screen> mainScreen;
 
+    // frame scheduling, guarded by the GUILoop's wake lock
+    // set on input and new tasks
+    bool wakeRequested = false;
+    // set by the sim thread every framePacing sim frames
+    bool frameDue = false;
+    // whether the next frame waits for frameDue rather than for wakeRequested
+    bool pacedWait = false;
+    int framePeriodMillis = 0;
+    int sinceFrameMillis = 0;
+
+    std::atomic_int framePacing{FRAME_PACING_AUTO};
+    // sim thread only
+    int simFramesSinceDue = 0;
+    float simFramePeriodUs = 0;
+    decltype(platform::measureTime()) lastSimFrameAt{};
+    std::atomic_int idleMillis{0};
+
+    static SurfaceSlot *acquireSlot();
+    void attachSurface();
+    void detachSurface();
     void initDisplayDriver();
     void initInputDriver();
-    void guiLoop();
+
+    // called by the GUILoop in the GUI thread
+    void setRefreshEnabled(bool enable);
+    void finishFrame();
+    void runFrameTasks();
+    void planNextFrame(bool &paced, int &periodMillis);
+
+    void runPendingTasks();
+    void wakeGuiLoop();
+    void onSimFrame();
+    void readPointerState(int &x, int &y, bool &pressed);
     void handleMouseWheel();
     void handleKeyboard();
 
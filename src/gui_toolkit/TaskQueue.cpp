@@ -0,0 +1,87 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TaskQueue.h"
+
+namespace avitab {
+
+TaskQueue::TaskQueue():
+    head(&stub),
+    tail(&stub)
+{
+}
+
+void TaskQueue::push(Task task) {
+    Node *node = new Node();
+    node->task = std::move(task);
+    pushNode(node);
+}
+
+void TaskQueue::pushNode(Node *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *prev = head.exchange(node, std::memory_order_acq_rel);
+    // the queue is briefly disconnected here, popNode stops at prev until the link is set
+    prev->next.store(node, std::memory_order_release);
+}
+
+TaskQueue::Node *TaskQueue::popNode() {
+    Node *first = tail;
+    Node *next = first->next.load(std::memory_order_acquire);
+
+    if (first == &stub) {
+        if (!next) {
+            return nullptr;
+        }
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        tail = next;
+        return first;
+    }
+
+    if (first != head.load(std::memory_order_acquire)) {
+        // a producer is between its exchange and the link
+        return nullptr;
+    }
+
+    // first is the last node, put the stub behind it so that it can be taken
+    pushNode(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next) {
+        tail = next;
+        return first;
+    }
+    return nullptr;
+}
+
+void TaskQueue::popAll(std::vector<Task> &out) {
+    Node *node;
+    while ((node = popNode()) != nullptr) {
+        out.push_back(std::move(node->task));
+        delete node;
+    }
+}
+
+TaskQueue::~TaskQueue() {
+    std::vector<Task> remaining;
+    popAll(remaining);
+}
+
+} /* namespace avitab */
@@ -0,0 +1,68 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace avitab {
+
+// Order in which the GUI thread runs pending tasks. Tasks of the same
+// priority keep their order, background tasks only run for a time budget
+// per loop so that input stays responsive while e.g. chart lists arrive.
+enum class TaskPriority {
+    INPUT,
+    BACKGROUND,
+};
+
+/*
+ * Lock-free multi-producer, single-consumer FIFO of GUI tasks, see
+ * Dmitry Vyukov's intrusive MPSC node-based queue. Any thread can push,
+ * only the GUI thread may pop.
+ */
+class TaskQueue {
+public:
+    using Task = std::function<void()>;
+
+    TaskQueue();
+    TaskQueue(const TaskQueue &other) = delete;
+    TaskQueue &operator=(const TaskQueue &other) = delete;
+
+    void push(Task task);
+
+    // moves all tasks that are completely pushed to out, in order
+    void popAll(std::vector<Task> &out);
+
+    ~TaskQueue();
+private:
+    struct Node {
+        std::atomic<Node *> next {nullptr};
+        Task task;
+    };
+
+    // producers append at head, the consumer takes from tail
+    std::atomic<Node *> head;
+    Node *tail;
+    Node stub;
+
+    void pushNode(Node *node);
+    Node *popNode();
+};
+
+} /* namespace avitab */
@@ -22,11 +22,14 @@
 namespace avitab {
 
 Timer::Timer(TimerFunc callback, int periodMs):
-    func(callback)
+    func(callback),
+    display(lv_disp_get_default())
 {
     logger::verbose("Creating timer in thread %d", std::this_thread::get_id());
     task = lv_task_create([] (lv_task_t *tsk) {
         Timer *tmr = (Timer *)(tsk->user_data);
+        // widgets created by the timer go to the surface that created it
+        lv_disp_set_default(tmr->display);
         bool wantContinue = tmr->func();
         if (!wantContinue) {
             tmr->stop();
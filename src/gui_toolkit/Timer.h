@@ -34,6 +34,8 @@ public:
 private:
     TimerFunc func;
     lv_task_t *task;
+    // the display that was the default one when the timer was created, i.e. its surface's
+    lv_disp_t *display;
 };
 
 } /* namespace avitab */
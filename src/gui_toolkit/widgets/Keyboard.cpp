@@ -45,6 +45,9 @@ Keyboard::Keyboard(WidgetPtr parent, std::shared_ptr<TextArea> target):
             }
         } else if (ev == LV_EVENT_VALUE_CHANGED) {
             lv_kb_def_event_cb(ref, ev);
+            if (us && us->onChange) {
+                us->onChange();
+            }
         }
     });
 
@@ -63,6 +66,10 @@ void Keyboard::setOnOk(Callback cb) {
     onOk = cb;
 }
 
+void Keyboard::setOnChange(Callback cb) {
+    onChange = cb;
+}
+
 void Keyboard::hideEnterKey() {
     static const char* defaultMapWithoutEnter[] = {
         "1#", "q", "w", "e", "r", "t", "y", "u", "i", "o", "p", LV_SYMBOL_BACKSPACE, "\n",
@@ -32,6 +32,8 @@ public:
     void setTarget(std::shared_ptr<TextArea> target);
     void setOnCancel(Callback cb);
     void setOnOk(Callback cb);
+    // called after each key press, the text may be unchanged, e.g. after moving the cursor
+    void setOnChange(Callback cb);
     void hideEnterKey();
     void setNumericLayout();
 
@@ -40,6 +42,7 @@ private:
     std::shared_ptr<TextArea> targetText;
     Callback onCancel;
     Callback onOk;
+    Callback onChange;
 };
 
 } /* namespace avitab */
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include "List.h"
 
 namespace avitab {
@@ -26,6 +27,18 @@ List::List(WidgetPtr parent):
     lv_obj_set_user_data(lst, this);
     lv_list_set_anim_time(lst, 0);
     setObj(lst);
+
+    lv_obj_t *scrl = lv_page_get_scrl(lst);
+    lv_obj_set_user_data(scrl, this);
+    origScrlSignal = lv_obj_get_signal_cb(scrl);
+    lv_obj_set_signal_cb(scrl, [] (lv_obj_t *scrl, lv_signal_t sign, void *param) -> lv_res_t {
+        List *us = reinterpret_cast<List *>(lv_obj_get_user_data(scrl));
+        lv_res_t res = us->origScrlSignal(scrl, sign, param);
+        if (res == LV_RES_OK && sign == LV_SIGNAL_CORD_CHG) {
+            us->onScroll();
+        }
+        return res;
+    });
 }
 
 void List::setCallback(ListCallback cb) {
@@ -37,24 +50,101 @@ void List::add(const std::string& entry, int data) {
 }
 
 void List::add(const std::string& entry, Symbol smb, int data) {
-    lv_obj_t *btn = lv_list_add_btn(obj(), symbolToLVSymbol(smb), entry.c_str());
+    entries.push_back(Entry{entry, smb, data});
+
+    // rows beyond the window are created once they are scrolled near
+    if (firstRow + rows.size() == entries.size() - 1 && rows.size() < WINDOW_ROWS) {
+        rows.push_back(createRow(entries.size() - 1));
+    }
+}
+
+lv_obj_t *List::createRow(size_t index) {
+    const Entry &entry = entries.at(index);
+    lv_obj_t *btn = lv_list_add_btn(obj(), symbolToLVSymbol(entry.symbol), entry.text.c_str());
 
-    lv_obj_set_user_data(btn, reinterpret_cast<void *>(data));
+    lv_obj_set_user_data(btn, reinterpret_cast<void *>(index));
 
     lv_obj_set_event_cb(btn, [] (lv_obj_t *obj, lv_event_t ev) {
         if (ev == LV_EVENT_CLICKED) {
             lv_obj_t *listObj = lv_obj_get_parent(lv_obj_get_parent(obj));
-            void *list = lv_obj_get_user_data(listObj);
-            if (list) {
-                int usrData = reinterpret_cast<intptr_t>(lv_obj_get_user_data(obj));
-                reinterpret_cast<List *>(list)->onSelect(usrData);
+            List *list = reinterpret_cast<List *>(lv_obj_get_user_data(listObj));
+            if (list && list->onSelect) {
+                size_t idx = reinterpret_cast<uintptr_t>(lv_obj_get_user_data(obj));
+                list->onSelect(list->entries.at(idx).data);
             }
         }
     });
+
+    return btn;
+}
+
+void List::onScroll() {
+    if (shifting || rows.empty()) {
+        return;
+    }
+
+    lv_obj_t *scrl = lv_page_get_scrl(obj());
+    int rowHeight = std::max(1, (int) lv_obj_get_height(rows.front()));
+    int margin = rowHeight * MARGIN_ROWS;
+    int viewTop = -lv_obj_get_y(scrl);
+    int viewBottom = viewTop + lv_obj_get_height(obj());
+
+    size_t endRow = firstRow + rows.size();
+    int rowsBottom = lv_obj_get_y(rows.back()) + lv_obj_get_height(rows.back());
+    if (endRow < entries.size() && rowsBottom - viewBottom < margin) {
+        shiftDown(std::min(SHIFT_ROWS, entries.size() - endRow));
+    } else if (firstRow > 0 && viewTop - lv_obj_get_y(rows.front()) < margin) {
+        shiftUp(std::min(SHIFT_ROWS, firstRow));
+    }
+}
+
+void List::shiftDown(size_t count) {
+    // keeps the remaining rows in place on the screen while the top ones move to the bottom
+    shifting = true;
+    lv_obj_t *scrl = lv_page_get_scrl(obj());
+    lv_obj_t *anchor = rows.at(std::min(count, rows.size() - 1));
+    lv_coord_t anchorY = lv_obj_get_y(anchor);
+
+    for (size_t i = 0; i < count; i++) {
+        rows.push_back(createRow(firstRow + rows.size()));
+        if (rows.size() > WINDOW_ROWS) {
+            lv_obj_del(rows.front());
+            rows.pop_front();
+            firstRow++;
+        }
+    }
+
+    lv_obj_set_y(scrl, lv_obj_get_y(scrl) + (anchorY - lv_obj_get_y(anchor)));
+    shifting = false;
+}
+
+void List::shiftUp(size_t count) {
+    shifting = true;
+    lv_obj_t *scrl = lv_page_get_scrl(obj());
+    lv_obj_t *anchor = rows.front();
+    lv_coord_t anchorY = lv_obj_get_y(anchor);
+
+    for (size_t i = 0; i < count; i++) {
+        firstRow--;
+        lv_obj_t *btn = createRow(firstRow);
+        // the list's layout puts the background-most child on top
+        lv_obj_move_background(btn);
+        rows.push_front(btn);
+        if (rows.size() > WINDOW_ROWS) {
+            lv_obj_del(rows.back());
+            rows.pop_back();
+        }
+    }
+
+    lv_obj_set_y(scrl, lv_obj_get_y(scrl) - (lv_obj_get_y(anchor) - anchorY));
+    shifting = false;
 }
 
 void List::clear() {
     lv_list_clean(obj());
+    rows.clear();
+    entries.clear();
+    firstRow = 0;
 }
 
 void List::scrollUp() {
@@ -65,4 +155,11 @@ void List::scrollDown() {
     lv_list_up(obj());
 }
 
+List::~List() {
+    // the object outlives this part of the widget
+    lv_obj_t *scrl = lv_page_get_scrl(obj());
+    lv_obj_set_signal_cb(scrl, origScrlSignal);
+    lv_obj_set_user_data(scrl, nullptr);
+}
+
 } /* namespace avitab */
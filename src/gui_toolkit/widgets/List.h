@@ -19,11 +19,15 @@
 #define SRC_GUI_TOOLKIT_WIDGETS_LIST_H_
 
 #include <string>
+#include <vector>
+#include <deque>
 #include <functional>
 #include "Widget.h"
 
 namespace avitab {
 
+// Only a window of the entries around the visible part has buttons, they are
+// moved along when the list is scrolled so that long lists open quickly.
 class List: public Widget {
 public:
     using ListCallback = std::function<void(int)>;
@@ -37,8 +41,33 @@ public:
 
     void scrollUp();
     void scrollDown();
+
+    ~List();
 private:
+    // buttons that exist at most, shifted by SHIFT_ROWS when fewer than
+    // MARGIN_ROWS are left beyond the visible part
+    static constexpr const size_t WINDOW_ROWS = 48;
+    static constexpr const size_t SHIFT_ROWS = 16;
+    static constexpr const size_t MARGIN_ROWS = 8;
+
+    struct Entry {
+        std::string text;
+        Symbol symbol;
+        int data;
+    };
+
     ListCallback onSelect;
+    std::vector<Entry> entries;
+    // buttons from top to bottom, for the entries starting at firstRow
+    std::deque<lv_obj_t *> rows;
+    size_t firstRow = 0;
+    bool shifting = false;
+    lv_signal_cb_t origScrlSignal = nullptr;
+
+    lv_obj_t *createRow(size_t index);
+    void onScroll();
+    void shiftDown(size_t count);
+    void shiftUp(size_t count);
 };
 
 } /* namespace avitab */
@@ -36,6 +36,22 @@ void PixMap::draw(const uint32_t* pix, int dataWidth, int dataHeight) {
     lv_img_set_src(obj(), &image);
 }
 
+void PixMap::invalidateArea(int x0, int y0, int x1, int y1) {
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    lv_area_t coords;
+    lv_obj_get_coords(obj(), &coords);
+
+    lv_area_t area;
+    area.x1 = coords.x1 + x0;
+    area.y1 = coords.y1 + y0;
+    area.x2 = coords.x1 + x1 - 1;
+    area.y2 = coords.y1 + y1 - 1;
+    lv_inv_area(lv_obj_get_disp(obj()), &area);
+}
+
 void PixMap::panLeft() {
     int x = lv_obj_get_x(obj()) + image.header.w * PAN_FACTOR;
     if (x < image.header.w / 2) {
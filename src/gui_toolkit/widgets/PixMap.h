@@ -28,6 +28,8 @@ public:
     PixMap(WidgetPtr parent);
     void draw(const uint32_t *pix, int dataWidth, int dataHeight);
     void draw(const img::Image &img);
+    // redraw only a part of the image, with exclusive end coordinates
+    void invalidateArea(int x0, int y0, int x1, int y1);
     void panLeft();
     void panRight();
     void panUp();
@@ -0,0 +1,70 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FlatLoadManager.h"
+#include "src/Logger.h"
+
+namespace flatnav {
+
+FlatLoadManager::FlatLoadManager(std::string dbdir)
+{
+    logger::info("Looking for flat NAV database file in %s", dbdir.c_str());
+    dbfile = dbdir + FILE_NAME;
+}
+
+void FlatLoadManager::init_or_throw(std::function<bool(const std::string simCode)> fn)
+{
+    // opening the file only maps it, the pages are read as the world uses them
+    beginPhase("flat NAV database");
+    // the file format has its own version, checked when it is opened
+    file = std::make_shared<FlatNavFile>(dbfile);
+
+    auto simulator = file->getSimulator();
+    logger::info("NAV data from flat db version %u for %s compiled from %s", file->getDbVersion(), simulator.c_str(), file->getSource().c_str());
+    if (!fn(simulator)) {
+        logger::warn("Note that %s was not expected by the simulator, so NAV data may not be correct.", simulator.c_str());
+    }
+    flatWorld = std::make_shared<FlatWorld>(file);
+    endPhase(file->airports.size() + file->fixes.size());
+
+    beginPhase("airport search");
+    flatWorld->buildAirportSearch();
+    endPhase(flatWorld->getAirportCount());
+}
+
+void FlatLoadManager::discoverSceneries()
+{
+    // not used in flat implementation
+}
+
+void FlatLoadManager::load()
+{
+    // the file is mapped in init_or_throw, only user data is loaded here
+    beginPhase("user fixes");
+    loadUserFixes();
+    endPhase();
+    logLoadPhases();
+}
+
+void FlatLoadManager::reloadMetar()
+{
+    // TODO: reloadMetar() should not be part of the NAV world - this should be the responsibility of the Environment
+    LOG_ERROR("NOT-YET-IMPLEMENTED: FlatLoadManager::reloadMetar()");
+}
+
+} /* namespace flatnav */
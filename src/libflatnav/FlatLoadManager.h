@@ -0,0 +1,48 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "src/world/LoadManager.h"
+#include "FlatWorld.h"
+#include "FlatNavFile.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace flatnav {
+
+// Loads the flat NAV database that AviTab-buildnavdb writes next to the SQL database
+class FlatLoadManager : public world::LoadManager {
+public:
+    FlatLoadManager(std::string dbdir);
+    void init_or_throw(std::function<bool(const std::string simCode)> fn);
+
+    std::shared_ptr<world::World> getWorld() override { return flatWorld; }
+
+    void discoverSceneries() override;
+    void load() override;
+    void reloadMetar() override;
+    std::vector<std::string> getSourceFiles() override { return {dbfile}; }
+
+private:
+    std::string dbfile;
+    std::shared_ptr<FlatNavFile> file;
+    std::shared_ptr<FlatWorld> flatWorld;
+};
+
+}
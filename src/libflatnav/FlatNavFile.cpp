@@ -0,0 +1,138 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include "FlatNavFile.h"
+
+namespace flatnav {
+
+namespace {
+
+void checkRange(uint32_t first, uint32_t count, uint32_t size, const char *what) {
+    if (first > size || count > size - first) {
+        throw std::runtime_error(std::string("Invalid range of ") + what);
+    }
+}
+
+template<typename T>
+void checkOffsets(const FlatNavFile::Table<uint32_t> &offsets, uint32_t entries, const FlatNavFile::Table<T> &target, const char *what) {
+    if (offsets.size() != entries + 1) {
+        throw std::runtime_error(std::string("Wrong number of offsets of ") + what);
+    }
+    for (uint32_t i = 0; i < entries; i++) {
+        if (offsets[i] > offsets[i + 1]) {
+            throw std::runtime_error(std::string("Unordered offsets of ") + what);
+        }
+    }
+    if (offsets[entries] > target.size()) {
+        throw std::runtime_error(std::string("Invalid offsets of ") + what);
+    }
+}
+
+} /* namespace */
+
+FlatNavFile::FlatNavFile(const std::string &utf8Path):
+    file(std::make_unique<platform::MappedFile>(utf8Path))
+{
+    if (file->size() < sizeof(FileHeader)) {
+        throw std::runtime_error("Truncated NAV database");
+    }
+    header = reinterpret_cast<const FileHeader *>(file->data());
+    if (header->magic != FILE_MAGIC || header->version != FILE_VERSION) {
+        throw std::runtime_error("Unknown NAV database format");
+    }
+
+    mapSection(STRINGS, strings);
+    if (strings.size() == 0 || strings[strings.size() - 1] != '\0') {
+        throw std::runtime_error("Invalid string table");
+    }
+
+    mapSection(AIRPORTS, airports);
+    mapSection(RUNWAYS, runways);
+    mapSection(COMMS, comms);
+    mapSection(HELIPADS, helipads);
+    mapSection(FIXES, fixes);
+    mapSection(TERMINAL_FIXES, terminalFixes);
+    mapSection(FIXES_BY_ID, fixesById);
+    mapSection(GRID_OFFSETS, gridOffsets);
+    mapSection(GRID_NODES, gridNodes);
+    mapSection(LOD_OFFSETS, lodOffsets);
+    mapSection(LOD_CELLS, lodCells);
+    mapSection(AIRWAYS, airways);
+    mapSection(AIRWAY_OFFSETS, airwayOffsets);
+    mapSection(AIRWAY_LEGS, airwayLegs);
+    mapSection(PROCEDURES, procedures);
+    mapSection(TRANSITIONS, transitions);
+    mapSection(FIX_REFS, fixRefs);
+    mapSection(ENTRY_OFFSETS, entryOffsets);
+    mapSection(ENTRY_PROCEDURES, entryProcedures);
+
+    checkRanges();
+}
+
+template<typename T>
+void FlatNavFile::mapSection(Section section, Table<T> &table) {
+    auto &ref = header->sections[section];
+    if (ref.offset % alignof(T) != 0 || ref.offset > file->size() || ref.count > (file->size() - ref.offset) / sizeof(T)) {
+        throw std::runtime_error("Invalid section " + std::to_string(section));
+    }
+    table.data = reinterpret_cast<const T *>(file->data() + ref.offset);
+    table.count = ref.count;
+}
+
+void FlatNavFile::checkRanges() const {
+    // a pass over the small tables only, the references to single fixes are
+    // checked where they are used so that opening the file doesn't read all of it
+    for (auto &a: airports) {
+        checkRange(a.firstRunway, a.runwayCount, runways.size(), "runways");
+        checkRange(a.firstComm, a.commCount, comms.size(), "comms");
+        checkRange(a.firstHelipad, a.helipadCount, helipads.size(), "helipads");
+        checkRange(a.firstTerminalFix, a.terminalFixCount, terminalFixes.size(), "terminal fixes");
+        checkRange(a.firstProcedure, a.procedureCount, procedures.size(), "procedures");
+    }
+    for (auto &p: procedures) {
+        checkRange(p.firstFix, p.fixCount, fixRefs.size(), "procedure fixes");
+        checkRange(p.firstTransition, p.transitionCount, transitions.size(), "transitions");
+    }
+    for (auto &t: transitions) {
+        checkRange(t.firstFix, t.fixCount, fixRefs.size(), "transition fixes");
+    }
+
+    checkOffsets(gridOffsets, GRID_CELLS, gridNodes, "grid");
+    checkOffsets(lodOffsets, LOD_TABLES, lodCells, "LOD cells");
+    checkOffsets(airwayOffsets, fixes.size(), airwayLegs, "airway legs");
+    checkOffsets(entryOffsets, fixes.size(), entryProcedures, "entry procedures");
+}
+
+const char *FlatNavFile::getString(StringRef ref) const {
+    // the table ends with a zero, so every offset within it is a valid string
+    return (ref < strings.size()) ? strings.data + ref : "";
+}
+
+uint32_t FlatNavFile::getDbVersion() const {
+    return header->dbVersion;
+}
+
+std::string FlatNavFile::getSimulator() const {
+    return getString(header->simulator);
+}
+
+std::string FlatNavFile::getSource() const {
+    return getString(header->source);
+}
+
+} /* namespace flatnav */
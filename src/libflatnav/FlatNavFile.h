@@ -0,0 +1,81 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include "FlatNavFormat.h"
+#include "src/platform/MappedFile.h"
+
+namespace flatnav {
+
+// A flat NAV database mapped into memory. The constructor checks that the
+// sections and the ranges between them are within the file and throws if
+// they aren't, the records can then be used without further checks.
+class FlatNavFile {
+public:
+    template<typename T>
+    struct Table {
+        const T *data = nullptr;
+        uint32_t count = 0;
+
+        const T &operator[](uint32_t i) const { return data[i]; }
+        const T *begin() const { return data; }
+        const T *end() const { return data + count; }
+        uint32_t size() const { return count; }
+    };
+
+    explicit FlatNavFile(const std::string &utf8Path);
+
+    const char *getString(StringRef ref) const;
+    uint32_t getDbVersion() const;
+    std::string getSimulator() const;
+    std::string getSource() const;
+
+    Table<AirportRecord> airports;
+    Table<RunwayRecord> runways;
+    Table<CommRecord> comms;
+    Table<HelipadRecord> helipads;
+    Table<FixRecord> fixes;
+    Table<uint32_t> terminalFixes;
+    Table<uint32_t> fixesById;
+    Table<uint32_t> gridOffsets;
+    Table<uint32_t> gridNodes;
+    Table<uint32_t> lodOffsets;
+    Table<LodRecord> lodCells;
+    Table<AirwayRecord> airways;
+    Table<uint32_t> airwayOffsets;
+    Table<AirwayLeg> airwayLegs;
+    Table<ProcedureRecord> procedures;
+    Table<TransitionRecord> transitions;
+    Table<uint32_t> fixRefs;
+    Table<uint32_t> entryOffsets;
+    Table<uint32_t> entryProcedures;
+
+private:
+    std::unique_ptr<platform::MappedFile> file;
+    const FileHeader *header = nullptr;
+    Table<char> strings;
+
+    template<typename T>
+    void mapSection(Section section, Table<T> &table);
+    void checkRanges() const;
+};
+
+} /* namespace flatnav */
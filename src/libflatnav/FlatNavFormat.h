@@ -0,0 +1,214 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Layout of the flat NAV database written by AviTab-buildnavdb and mapped
+ * read-only by FlatWorld. The file is a header followed by sections of
+ * fixed-size records, each aligned to 8 bytes. All values are in the byte
+ * order of the machine that wrote the file, which is little-endian on all
+ * supported platforms.
+ *
+ * Records refer to each other by their index in a section. Where a record
+ * owns a range of another section, e.g. the runways of an airport, the range
+ * is contiguous and given by its first index and count.
+ */
+namespace flatnav {
+
+constexpr const uint32_t FILE_MAGIC = 0x464e5641; // "AVNF"
+constexpr const uint32_t FILE_VERSION = 1;
+constexpr const char *FILE_NAME = "avitab_navdb.flat";
+
+// no record, e.g. a runway without ILS
+constexpr const uint32_t NONE = 0xFFFFFFFF;
+
+// byte offset into the STRINGS section, which starts with the empty string at 0
+using StringRef = uint32_t;
+
+enum Section: uint32_t {
+    STRINGS,            // char, zero-terminated strings
+    AIRPORTS,           // AirportRecord, sorted by ident
+    RUNWAYS,            // RunwayRecord, both ends of a runway next to each other
+    COMMS,              // CommRecord
+    HELIPADS,           // HelipadRecord
+    FIXES,              // FixRecord, the ILS of the airports after the fixes of the fix table
+    TERMINAL_FIXES,     // uint32_t fix index, ranges of AirportRecord
+    FIXES_BY_ID,        // uint32_t fix index, sorted by region then ident, without ILS
+    GRID_OFFSETS,       // uint32_t, GRID_CELLS + 1 offsets into GRID_NODES
+    GRID_NODES,         // uint32_t node reference, see GRID_FIX_BIT
+    LOD_OFFSETS,        // uint32_t, LOD_TABLES + 1 offsets into LOD_CELLS
+    LOD_CELLS,          // LodRecord, sorted by key within each table
+    AIRWAYS,            // AirwayRecord
+    AIRWAY_OFFSETS,     // uint32_t, one per fix + 1, offsets into AIRWAY_LEGS
+    AIRWAY_LEGS,        // AirwayLeg, grouped by the fix they leave from
+    PROCEDURES,         // ProcedureRecord, ranges of AirportRecord
+    TRANSITIONS,        // TransitionRecord, ranges of ProcedureRecord
+    FIX_REFS,           // uint32_t fix index, ranges of procedures and transitions
+    ENTRY_OFFSETS,      // uint32_t, one per fix + 1, offsets into ENTRY_PROCEDURES
+    ENTRY_PROCEDURES,   // uint32_t procedure index, STARs and approaches starting at the fix
+    NUM_SECTIONS
+};
+
+struct SectionRef {
+    uint64_t offset;    // from the start of the file
+    uint32_t count;     // records, or bytes for STRINGS
+    uint32_t reserved;
+};
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dbVersion; // of the SQL database the file was built from
+    StringRef simulator;
+    StringRef source;
+    uint32_t reserved;
+    SectionRef sections[NUM_SECTIONS];
+};
+
+// airport flags
+constexpr const uint32_t AIRPORT_TOWERED = 1;
+
+struct AirportRecord {
+    double latitude, longitude;
+    StringRef ident, name, region, country;
+    int32_t elevation;  // feet
+    uint32_t flags;
+    uint32_t firstRunway, runwayCount;
+    uint32_t firstComm, commCount;
+    uint32_t firstHelipad, helipadCount;
+    uint32_t firstTerminalFix, terminalFixCount;
+    uint32_t firstProcedure, procedureCount;
+};
+
+struct RunwayRecord {
+    double latitude, longitude;
+    StringRef name;
+    float heading;
+    float length, width; // metres, length without the displaced thresholds
+    int32_t elevation;
+    uint32_t ils;       // fix index or NONE
+    uint32_t surface;   // world::Runway::SurfaceMaterial
+    uint32_t reserved;
+};
+
+struct CommRecord {
+    StringRef name;
+    int32_t frequency;  // Hz
+    uint32_t type;      // world::Airport::ATCFrequency
+};
+
+struct HelipadRecord {
+    double latitude, longitude;
+    int32_t number;
+    uint32_t reserved;
+};
+
+enum FixKind: uint32_t {
+    KIND_WAYPOINT,
+    KIND_NDB,
+    KIND_VOR,           // with DME, only the DME if FIX_DME_ONLY
+    KIND_ILS,
+};
+
+// fix flags
+constexpr const uint32_t FIX_GLOBAL = 1;     // in the grid, not only a terminal fix
+constexpr const uint32_t FIX_DME_ONLY = 2;
+constexpr const uint32_t FIX_LOC_ONLY = 4;
+
+struct FixRecord {
+    double latitude, longitude;
+    StringRef ident, region;
+    StringRef name;     // of the navaid, the ILS type for ILS
+    int32_t frequency;  // kHz for NDB, 10 kHz for VOR, kHz for ILS
+    int32_t range;
+    int32_t dmeRange;   // ILS only
+    float heading;      // runway heading of an ILS
+    float magVar;       // of a VOR or ILS
+    uint32_t kind;      // FixKind
+    uint32_t flags;
+};
+
+// grid cells are 1 degree squares, the cell of a location is at
+// (floor(lat) + 90) * GRID_COLUMNS + floor(lon) + 180
+constexpr const int GRID_ROWS = 180;
+constexpr const int GRID_COLUMNS = 360;
+constexpr const uint32_t GRID_CELLS = GRID_ROWS * GRID_COLUMNS;
+// a node reference with this bit is a fix index, otherwise an airport index.
+// the airports of a cell come before its fixes.
+constexpr const uint32_t GRID_FIX_BIT = 0x80000000;
+
+// The most significant airport of each cell at the levels of world::AirportLOD,
+// one table for each [towered][level], cells keyed by row << 16 | column
+constexpr const int LOD_LEVELS = 7;
+constexpr const double LOD_CELL_DEGREES[LOD_LEVELS] = {0.25, 0.5, 1, 2, 4, 8, 16};
+constexpr const int LOD_TABLES = 2 * LOD_LEVELS;
+
+struct LodRecord {
+    uint32_t key;
+    uint32_t airport;
+    float score;
+};
+
+// airway levels
+constexpr const uint32_t AIRWAY_LOWER = 1;
+constexpr const uint32_t AIRWAY_UPPER = 2;
+
+struct AirwayRecord {
+    StringRef name;
+    uint32_t levels;
+};
+
+struct AirwayLeg {
+    uint32_t toFix;
+    uint32_t airway;
+};
+
+enum ProcedureType: uint32_t {
+    PROC_SID = 1,
+    PROC_STAR = 2,
+    PROC_APPROACH = 3,
+};
+
+// one variant of a procedure, the variants of a procedure have the same name and
+// are next to each other. fixes that are not in the file are left out.
+struct ProcedureRecord {
+    uint32_t airport;
+    uint32_t type;      // ProcedureType
+    StringRef name;
+    StringRef runway;   // empty if the variant is used for all runways
+    uint32_t firstFix, fixCount;
+    uint32_t firstTransition, transitionCount;
+};
+
+struct TransitionRecord {
+    StringRef name;
+    uint32_t firstFix, fixCount;
+};
+
+static_assert(sizeof(FileHeader) == 24 + 16 * NUM_SECTIONS, "FileHeader must not be padded");
+static_assert(sizeof(AirportRecord) == 80, "AirportRecord must not be padded");
+static_assert(sizeof(RunwayRecord) == 48, "RunwayRecord must not be padded");
+static_assert(sizeof(CommRecord) == 12, "CommRecord must not be padded");
+static_assert(sizeof(HelipadRecord) == 24, "HelipadRecord must not be padded");
+static_assert(sizeof(FixRecord) == 56, "FixRecord must not be padded");
+static_assert(sizeof(LodRecord) == 12, "LodRecord must not be padded");
+static_assert(sizeof(ProcedureRecord) == 32, "ProcedureRecord must not be padded");
+
+} /* namespace flatnav */
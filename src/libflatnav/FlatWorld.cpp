@@ -0,0 +1,797 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FlatWorld.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <set>
+#include "procs/FlatSID.h"
+#include "procs/FlatSTAR.h"
+#include "procs/FlatApproach.h"
+#include "src/world/routing/RouteFinder.h"
+#include "src/world/graph/Corridor.h"
+#include "src/platform/Platform.h"
+#include "src/Logger.h"
+
+namespace flatnav {
+
+FlatWorld::FlatWorld(std::shared_ptr<const FlatNavFile> f)
+:   world::World(),
+    file(f)
+{
+    airportNodes.resize(file->airports.size());
+    airportLastUse.resize(file->airports.size());
+    fixNodes.resize(file->fixes.size());
+    fixLastUse.resize(file->fixes.size());
+    airwayEdges.resize(file->airways.size());
+
+    // the node counts follow from the grid offsets, no records need to be read
+    for (int row = 0; row < GRID_ROWS; ++row) {
+        for (int col = 0; col < GRID_COLUMNS; ++col) {
+            uint32_t cell = row * GRID_COLUMNS + col;
+            uint32_t nodes = file->gridOffsets[cell + 1] - file->gridOffsets[cell];
+            if (nodes > 0) {
+                density.add(row - 90, col - 180, nodes);
+            }
+        }
+    }
+
+    memoryConsumer = platform::MemoryBudget::shared().addConsumer("nav_nodes", platform::MemoryBudget::Priority::NAV_DATA,
+        [this] () {
+            std::lock_guard<std::mutex> guard(nodeGuard);
+            return cachedNodes * APPROX_NODE_BYTES;
+        },
+        [this] (size_t bytes) { return trimNodes(bytes); });
+}
+
+FlatWorld::~FlatWorld()
+{
+    memoryConsumer.reset();
+}
+
+void FlatWorld::buildAirportSearch()
+{
+    for (uint32_t i = 0; i < file->airports.size(); ++i) {
+        auto &a = file->airports[i];
+        airportSearch.add(i, file->getString(a.ident), file->getString(a.name));
+    }
+    airportSearch.build();
+}
+
+size_t FlatWorld::getAirportCount() const
+{
+    return file->airports.size();
+}
+
+const FlatNavFile &FlatWorld::getFile() const
+{
+    return *file;
+}
+
+int FlatWorld::maxDensity(const world::Location &bottomLeft, const world::Location &topRight)
+{
+    // nodes are grouped by integer lat/lon 'squares'.
+    int d = density.maxInArea(bottomLeft, topRight);
+
+    // pretend that each grid area has 'max' nodes in it, and report the total number of visible nodes that
+    // would be seen if this was the case.
+    float mapArea = (topRight.longitude > bottomLeft.longitude)
+                    ? (topRight.latitude - bottomLeft.latitude) * (topRight.longitude - bottomLeft.longitude)
+                    : (topRight.latitude - bottomLeft.latitude) * (360 + topRight.longitude - bottomLeft.longitude);
+    return (int)(mapArea * d);
+}
+
+inline unsigned distance(int x1, int y1, int x2, int y2) {
+    int dx = x2 - x1;
+    int dy = y2 - y1;
+    return (unsigned)std::sqrt((dx * dx) + (dy * dy));
+}
+
+inline uint32_t gridCell(int lonx, int laty) {
+    int col = ((lonx + 180) % GRID_COLUMNS + GRID_COLUMNS) % GRID_COLUMNS;
+    return (uint32_t)((laty + 90) * GRID_COLUMNS + col);
+}
+
+inline bool acceptsUserFix(const std::shared_ptr<world::Fix> &fix, int filter) {
+    if (fix->isUserFix()) {
+        return (filter & world::World::VISIT_USER_FIXES);
+    } else if (fix->isNavaid()) {
+        return (filter & world::World::VISIT_NAVAIDS);
+    } else {
+        return (filter & world::World::VISIT_FIXES);
+    }
+}
+
+bool FlatWorld::acceptsRecord(uint32_t ref, int filter) const
+{
+    if (ref & GRID_FIX_BIT) {
+        uint32_t index = ref & ~GRID_FIX_BIT;
+        if (index >= file->fixes.size()) {
+            return false;
+        }
+        if (file->fixes[index].kind == KIND_WAYPOINT) {
+            return (filter & world::World::VISIT_FIXES);
+        } else {
+            return (filter & world::World::VISIT_NAVAIDS);
+        }
+    }
+    if (ref >= file->airports.size()) {
+        return false;
+    }
+    if (file->airports[ref].flags & AIRPORT_TOWERED) {
+        return (filter & world::World::VISIT_TOWERED_AIRPORTS);
+    } else {
+        return (filter & world::World::VISIT_OTHER_AIRPORTS);
+    }
+}
+
+world::Location FlatWorld::getRecordLocation(uint32_t ref) const
+{
+    // only called for references accepted by acceptsRecord
+    if (ref & GRID_FIX_BIT) {
+        auto &f = file->fixes[ref & ~GRID_FIX_BIT];
+        return world::Location(f.latitude, f.longitude);
+    }
+    auto &a = file->airports[ref];
+    return world::Location(a.latitude, a.longitude);
+}
+
+void FlatWorld::visitNodes(const world::Location &bottomLeft, const world::Location &topRight, NodeAcceptor callback, int filter)
+{
+    // nodes are grouped by integer lat/lon 'squares'.
+    int latl = std::max((int)std::floor(bottomLeft.latitude), -90);
+    int lath = std::min((int)std::ceil(topRight.latitude), 89);
+    int lonl = (int)std::floor(bottomLeft.longitude);
+    int lonh = (int)std::ceil(topRight.longitude);
+
+    // the area might span the -180/180 meridian. bias it here, normalise again in iteration
+    if (lonh < lonl) { lonh += 360; }
+
+    int latc = (lath + latl) / 2;
+    int lonc = (lonh + lonl) / 2;
+
+    // create an ordered list of areas to visit starting from the ones nearest the centre of the map
+    std::vector<std::vector<uint32_t>> visitOrder;
+    for (int laty = latl; laty <= lath; ++laty) {
+        for (int lonx = lonl; lonx <= lonh; ++lonx) {
+            auto d = distance(lonx, laty, lonc, latc);
+            if ((d + 1) > visitOrder.size()) visitOrder.resize(d + 1);
+            visitOrder[d].push_back(gridCell(lonx, laty));
+        }
+    }
+
+    // the records are filtered in place, only the nodes reported are created. the
+    // callbacks run without the lock, the nodes are kept until the visit after next.
+    std::vector<const world::NavNode *> picks;
+    {
+        std::lock_guard<std::mutex> guard(nodeGuard);
+        ++useClock;
+        for (auto &outer: visitOrder) {
+            for (auto cell: outer) {
+                for (uint32_t i = file->gridOffsets[cell]; i < file->gridOffsets[cell + 1]; ++i) {
+                    uint32_t ref = file->gridNodes[i];
+                    if (!acceptsRecord(ref, filter)) continue;
+                    if (!getRecordLocation(ref).isInArea(bottomLeft, topRight)) continue;
+                    if (auto node = useGridNode(ref)) picks.push_back(node);
+                }
+            }
+        }
+        for (auto &f: addedFixes) {
+            if (f->getLocation().isInArea(bottomLeft, topRight) && acceptsUserFix(f, filter)) {
+                picks.push_back(f.get());
+            }
+        }
+        if (cachedNodes > MAX_CACHED_NODES) {
+            // evict down to three quarters of the limit, so that this doesn't run after every visit
+            evictNodes(MAX_CACHED_NODES / 4 * 3);
+        }
+    }
+
+    for (auto node: picks) {
+        callback(node);
+    }
+    if (filter & VISIT_USER_FIXES) {
+        userFixIndex.visit(bottomLeft, topRight, callback);
+    }
+}
+
+void FlatWorld::visitAlongRoute(const world::Route &route, double bufferNm, NodeAcceptor callback, int filter)
+{
+    world::Corridor corridor(route.getPathLocations(), bufferNm / world::KM_TO_NM * 1000);
+
+    // the lat/lon squares under the corridor, each once so that no node is reported twice
+    std::set<uint32_t> squares;
+    for (auto &area: corridor.getAreas()) {
+        int latl = std::max((int)std::floor(area.minLat), -90);
+        int lath = std::min((int)std::floor(area.maxLat), 89);
+        int lonl = (int)std::floor(area.minLon);
+        int lonh = std::min((int)std::floor(area.maxLon), 179);
+        for (int laty = latl; laty <= lath; ++laty) {
+            for (int lonx = lonl; lonx <= lonh; ++lonx) {
+                squares.insert(gridCell(lonx, laty));
+            }
+        }
+    }
+
+    std::vector<const world::NavNode *> picks;
+    {
+        std::lock_guard<std::mutex> guard(nodeGuard);
+        ++useClock;
+        for (auto cell: squares) {
+            for (uint32_t i = file->gridOffsets[cell]; i < file->gridOffsets[cell + 1]; ++i) {
+                uint32_t ref = file->gridNodes[i];
+                if (!acceptsRecord(ref, filter)) continue;
+                if (!corridor.contains(getRecordLocation(ref))) continue;
+                if (auto node = useGridNode(ref)) picks.push_back(node);
+            }
+        }
+        for (auto &f: addedFixes) {
+            if (acceptsUserFix(f, filter) && corridor.contains(f->getLocation())) {
+                picks.push_back(f.get());
+            }
+        }
+    }
+
+    for (auto node: picks) {
+        callback(node);
+    }
+    if (filter & VISIT_USER_FIXES) {
+        userFixIndex.visitCorridor(corridor, callback);
+    }
+}
+
+void FlatWorld::visitMajorAirports(const world::Location &bottomLeft, const world::Location &topRight, double cellDegrees, NodeAcceptor callback, int filter)
+{
+    // the same selection as world::AirportLOD, from the tables built with the file
+    bool wantTowered = filter & world::World::VISIT_TOWERED_AIRPORTS;
+    bool wantOther = filter & world::World::VISIT_OTHER_AIRPORTS;
+    if (!wantTowered && !wantOther) {
+        return;
+    }
+
+    int l = 0;
+    while (l < LOD_LEVELS - 1 && LOD_CELL_DEGREES[l] < cellDegrees) {
+        l++;
+    }
+    double size = LOD_CELL_DEGREES[l];
+    int columns = (int)std::round(360 / size);
+
+    int row0 = (int)std::floor((std::max(bottomLeft.latitude, -90.0) + 90) / size);
+    int row1 = (int)std::floor((std::min(topRight.latitude, 90.0) + 90) / size);
+    int col0 = (int)std::floor((bottomLeft.longitude + 180) / size);
+    int col1 = (int)std::floor((topRight.longitude + 180) / size);
+    // the area might span the -180/180 meridian. bias it here, normalise again in the iteration
+    if (col1 < col0) { col1 += columns; }
+    col1 = std::min(col1, col0 + columns - 1);
+
+    auto findCell = [this] (int table, uint32_t key) -> const LodRecord * {
+        auto first = file->lodCells.begin() + file->lodOffsets[table];
+        auto last = file->lodCells.begin() + file->lodOffsets[table + 1];
+        auto it = std::lower_bound(first, last, key, [] (const LodRecord &r, uint32_t k) { return r.key < k; });
+        return (it != last && it->key == key) ? it : nullptr;
+    };
+
+    std::vector<const world::NavNode *> picks;
+    {
+        std::lock_guard<std::mutex> guard(nodeGuard);
+        ++useClock;
+        for (int row = row0; row <= row1; row++) {
+            for (int c = col0; c <= col1; c++) {
+                uint32_t col = ((c % columns) + columns) % columns;
+                uint32_t key = ((uint32_t)row << 16) | col;
+
+                // the more significant of the selected partitions represents the cell
+                const LodRecord *best = nullptr;
+                for (int towered = 0; towered < 2; towered++) {
+                    if (!(towered ? wantTowered : wantOther)) {
+                        continue;
+                    }
+                    auto pick = findCell(towered * LOD_LEVELS + l, key);
+                    if (pick && (!best || pick->score > best->score)) {
+                        best = pick;
+                    }
+                }
+                if (best) {
+                    if (auto node = useGridNode(best->airport)) picks.push_back(node);
+                }
+            }
+        }
+    }
+
+    for (auto node: picks) {
+        callback(node);
+    }
+}
+
+uint32_t FlatWorld::getNodeRevision() const
+{
+    // the file holds every node, only user fixes are added later
+    return nodeRevision;
+}
+
+void FlatWorld::prefetchAlong(const std::vector<std::vector<world::Location>> &paths)
+{
+    // nothing to load ahead, the OS pages in the parts of the file that are visited
+}
+
+std::shared_ptr<world::Airport> FlatWorld::findAirportByID(const std::string &id) const
+{
+    std::string cleanId = platform::upper(id);
+    cleanId.erase(std::remove(cleanId.begin(), cleanId.end(), ' '), cleanId.end());
+
+    // the airports are sorted by ident
+    auto &airports = file->airports;
+    auto it = std::lower_bound(airports.begin(), airports.end(), cleanId, [this] (const AirportRecord &a, const std::string &key) {
+        return std::strcmp(file->getString(a.ident), key.c_str()) < 0;
+    });
+    if (it == airports.end() || cleanId != file->getString(it->ident)) {
+        return nullptr;
+    }
+    return getAirport(it - airports.begin());
+}
+
+std::shared_ptr<world::Fix> FlatWorld::findFixByRegionAndID(const std::string &region, const std::string &id) const
+{
+    std::string r(region);
+    r.erase(std::remove(r.begin(), r.end(), ' '), r.end());
+    std::string i(id);
+    i.erase(std::remove(i.begin(), i.end(), ' '), i.end());
+
+    // the fixes are sorted by region, then ident
+    auto compare = [this] (uint32_t fix, const std::string &region, const std::string &ident) {
+        if (fix >= file->fixes.size()) {
+            return 1;
+        }
+        auto &f = file->fixes[fix];
+        int c = std::strcmp(file->getString(f.region), region.c_str());
+        return (c != 0) ? c : std::strcmp(file->getString(f.ident), ident.c_str());
+    };
+    auto &byId = file->fixesById;
+    auto it = std::lower_bound(byId.begin(), byId.end(), 0, [&compare, &r, &i] (uint32_t fix, int) {
+        return compare(fix, r, i) < 0;
+    });
+    if (it == byId.end() || compare(*it, r, i) != 0) {
+        return nullptr;
+    }
+    return getFix(*it);
+}
+
+std::vector<std::shared_ptr<world::Airport>> FlatWorld::findAirport(const std::string &keyWord) const
+{
+    std::vector<std::shared_ptr<world::Airport>> airports;
+    for (auto index: airportSearch.search(keyWord, world::World::MAX_SEARCH_RESULTS)) {
+        if (auto a = getAirport(index)) {
+            airports.push_back(a);
+        }
+    }
+    return airports;
+}
+
+std::shared_ptr<world::Airport> FlatWorld::getAirport(uint32_t index) const
+{
+    std::lock_guard<std::mutex> guard(nodeGuard);
+    return airportNode(index);
+}
+
+std::shared_ptr<world::Fix> FlatWorld::getFix(uint32_t index) const
+{
+    std::lock_guard<std::mutex> guard(nodeGuard);
+    return fixNode(index);
+}
+
+world::NavNodeList FlatWorld::getFixList(uint32_t firstRef, uint32_t count) const
+{
+    world::NavNodeList nodes;
+    std::lock_guard<std::mutex> guard(nodeGuard);
+    for (uint32_t i = firstRef; i < firstRef + count; ++i) {
+        if (auto f = fixNode(file->fixRefs[i])) {
+            nodes.push_back(f);
+        }
+    }
+    return nodes;
+}
+
+const world::NavNode *FlatWorld::useGridNode(uint32_t ref) const
+{
+    if (ref & GRID_FIX_BIT) {
+        return fixNode(ref & ~GRID_FIX_BIT).get();
+    }
+    return airportNode(ref).get();
+}
+
+std::shared_ptr<world::Airport> FlatWorld::airportNode(uint32_t index) const
+{
+    if (index >= airportNodes.size()) {
+        return nullptr;
+    }
+    auto &node = airportNodes[index];
+    if (!node) {
+        node = createAirport(index);
+        ++cachedNodes;
+    }
+    airportLastUse[index] = useClock;
+    return node;
+}
+
+std::shared_ptr<world::Fix> FlatWorld::fixNode(uint32_t index) const
+{
+    if (index >= fixNodes.size()) {
+        return nullptr;
+    }
+    auto &node = fixNodes[index];
+    if (!node) {
+        node = createFix(index);
+        ++cachedNodes;
+    }
+    fixLastUse[index] = useClock;
+    return node;
+}
+
+std::shared_ptr<world::Airport> FlatWorld::createAirport(uint32_t index) const
+{
+    auto &rec = file->airports[index];
+
+    auto region = lookupRegion(file->getString(rec.region));
+    region->setName(file->getString(rec.country));
+
+    auto a = std::make_shared<world::Airport>(file->getString(rec.ident));
+    a->setName(file->getString(rec.name));
+    a->setRegion(region);
+    a->setElevation(rec.elevation);
+    a->setLocation(world::Location(rec.latitude, rec.longitude));
+
+    for (uint32_t i = rec.firstComm; i < rec.firstComm + rec.commCount; ++i) {
+        auto &c = file->comms[i];
+        world::Frequency frequency(c.frequency, 6, world::Frequency::Unit::MHZ, file->getString(c.name));
+        a->addATCFrequency(static_cast<world::Airport::ATCFrequency>(c.type), frequency);
+    }
+
+    // the two ends of each runway are next to each other
+    for (uint32_t i = rec.firstRunway; i + 1 < rec.firstRunway + rec.runwayCount; i += 2) {
+        std::shared_ptr<world::Runway> ends[2];
+        for (int e = 0; e < 2; ++e) {
+            auto &r = file->runways[i + e];
+            auto rwy = std::make_shared<world::Runway>(file->getString(r.name));
+            rwy->setHeading(r.heading);
+            rwy->setWidth(r.width);
+            rwy->setLength(r.length);
+            rwy->setLocation(world::Location(r.latitude, r.longitude));
+            rwy->setSurfaceType(static_cast<world::Runway::SurfaceMaterial>(r.surface));
+            rwy->setElevation(r.elevation);
+            if (r.ils != NONE) {
+                // the ILS is also one of the terminal fixes, which keep it
+                if (auto ils = fixNode(r.ils)) {
+                    rwy->attachILSData(ils);
+                }
+            }
+            a->addRunway(rwy);
+            ends[e] = rwy;
+        }
+        a->addRunwayEnds(ends[0], ends[1]);
+    }
+
+    for (uint32_t i = rec.firstHelipad; i < rec.firstHelipad + rec.helipadCount; ++i) {
+        auto &h = file->helipads[i];
+        auto heliport = std::make_shared<world::Heliport>("H" + std::to_string(h.number));
+        heliport->setLocation(world::Location(h.latitude, h.longitude));
+        a->addHeliport(heliport);
+    }
+
+    for (uint32_t i = rec.firstTerminalFix; i < rec.firstTerminalFix + rec.terminalFixCount; ++i) {
+        if (auto f = fixNode(file->terminalFixes[i])) {
+            a->addTerminalFix(f);
+        }
+    }
+
+    if (rec.procedureCount > 0) {
+        // weak references, so that the airport keeps neither itself nor the world alive
+        std::weak_ptr<const FlatWorld> weakWorld = std::static_pointer_cast<const FlatWorld>(shared_from_this());
+        std::weak_ptr<world::Airport> weakAirport = a;
+        a->setProcedureLoader([weakWorld, weakAirport, index] () {
+            auto w = weakWorld.lock();
+            auto airport = weakAirport.lock();
+            if (w && airport) {
+                w->loadProcedures(airport, index);
+            }
+        });
+    }
+
+    return a;
+}
+
+std::shared_ptr<world::Fix> FlatWorld::createFix(uint32_t index) const
+{
+    auto &rec = file->fixes[index];
+
+    auto region = lookupRegion(file->getString(rec.region));
+    auto f = std::make_shared<world::Fix>(region, file->getString(rec.ident), world::Location(rec.latitude, rec.longitude));
+    f->setGlobal(rec.flags & FIX_GLOBAL);
+
+    std::string name = file->getString(rec.name);
+    switch (rec.kind) {
+    case KIND_NDB: {
+        world::Frequency frequency(rec.frequency, 0, world::Frequency::Unit::KHZ, name);
+        f->attachNDB(std::make_shared<world::NDB>(frequency, rec.range));
+        break;
+    }
+    case KIND_VOR: {
+        world::Frequency frequency(rec.frequency, 2, world::Frequency::Unit::MHZ, name);
+        if (!(rec.flags & FIX_DME_ONLY)) {
+            auto vor = std::make_shared<world::VOR>(frequency, rec.range);
+            vor->setBearing(rec.magVar);
+            f->attachVOR(vor);
+        }
+        f->attachDME(std::make_shared<world::DME>(frequency, rec.range));
+        break;
+    }
+    case KIND_ILS: {
+        world::Frequency frequency(rec.frequency, 3, world::Frequency::Unit::MHZ, name);
+        auto ils = std::make_shared<world::ILSLocalizer>(frequency, rec.range);
+        ils->setRunwayHeading(rec.heading);
+        ils->setRunwayHeadingMagnetic(rec.heading + rec.magVar);
+        ils->setLocalizerOnly(rec.flags & FIX_LOC_ONLY);
+        f->attachILSLocalizer(ils);
+        if (rec.dmeRange) {
+            f->attachDME(std::make_shared<world::DME>(frequency, rec.dmeRange));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    // ILS aren't part of the airway network, the other fixes are linked by their index
+    if (rec.kind != KIND_ILS) {
+        f->setGraphIndex(index + 1);
+    }
+    return f;
+}
+
+void FlatWorld::loadProcedures(std::shared_ptr<world::Airport> airport, uint32_t index) const
+{
+    // a named procedure has one record per variant, they are combined here
+    std::weak_ptr<const FlatWorld> weakWorld = std::static_pointer_cast<const FlatWorld>(shared_from_this());
+    std::map<std::string, std::shared_ptr<FlatSID>> sids;
+    std::map<std::string, std::shared_ptr<FlatSTAR>> stars;
+    std::map<std::string, std::shared_ptr<FlatApproach>> apprs;
+
+    auto &rec = file->airports[index];
+    for (uint32_t i = rec.firstProcedure; i < rec.firstProcedure + rec.procedureCount; ++i) {
+        auto &p = file->procedures[i];
+        std::string name = file->getString(p.name);
+        if (p.type == PROC_SID) {
+            auto &sid = sids[name];
+            if (!sid) {
+                sid = std::make_shared<FlatSID>(name, weakWorld);
+            }
+            sid->addVariant(i);
+        } else if (p.type == PROC_STAR) {
+            auto &star = stars[name];
+            if (!star) {
+                star = std::make_shared<FlatSTAR>(name, weakWorld);
+            }
+            star->addVariant(i);
+        } else if (p.type == PROC_APPROACH) {
+            auto &appr = apprs[name];
+            if (!appr) {
+                appr = std::make_shared<FlatApproach>(name, weakWorld);
+            }
+            appr->addVariant(i);
+        } else {
+            logger::warn("Procedure %s @ %s has unknown type %u", name.c_str(), airport->getID().c_str(), p.type);
+        }
+    }
+
+    for (auto &p: sids) {
+        airport->addSID(p.second);
+    }
+    for (auto &p: stars) {
+        airport->addSTAR(p.second);
+    }
+    for (auto &p: apprs) {
+        airport->addApproach(p.second);
+    }
+}
+
+world::World::ConnectionList FlatWorld::getConnections(std::shared_ptr<world::NavNode> from)
+{
+    std::lock_guard<std::mutex> guard(graphGuard);
+
+    if (from->isAirport()) {
+        // an airport leads to the last fix of each variant of its SIDs
+        auto &id = from->getID();
+        auto cit = airportConnections.find(id);
+        if (cit != airportConnections.end()) {
+            return cit->second;
+        }
+        auto airport = std::dynamic_pointer_cast<world::Airport>(from);
+        std::vector<world::World::Connection> conns;
+        for (auto &sid: airport->getSIDs()) {
+            auto flatSid = std::dynamic_pointer_cast<FlatSID>(sid);
+            if (!flatSid) {
+                continue;
+            }
+            for (auto fix: flatSid->getExitFixes()) {
+                if (auto to = getFix(fix)) {
+                    conns.emplace_back(from, sid, to);
+                }
+            }
+        }
+        auto list = std::make_shared<const std::vector<world::World::Connection>>(std::move(conns));
+        airportConnections[id] = list;
+        return list;
+    }
+
+    uint32_t graphIndex = from->getGraphIndex();
+    if (!from->isFix() || (graphIndex == 0) || (graphIndex > file->fixes.size())) {
+        return noConnection;
+    }
+    uint32_t index = graphIndex - 1;
+    auto cit = fixConnections.find(index);
+    if (cit != fixConnections.end()) {
+        return cit->second;
+    }
+
+    std::vector<world::World::Connection> conns;
+    for (uint32_t i = file->airwayOffsets[index]; i < file->airwayOffsets[index + 1]; ++i) {
+        auto &leg = file->airwayLegs[i];
+        auto to = getFix(leg.toFix);
+        if (!to || (leg.airway >= airwayEdges.size())) {
+            continue;
+        }
+        auto &edges = getAirwayEdges(leg.airway);
+        if (edges.lower) {
+            conns.emplace_back(from, edges.lower, to);
+        }
+        if (edges.upper) {
+            conns.emplace_back(from, edges.upper, to);
+        }
+    }
+
+    // the STARs and approaches starting here lead to their airports
+    for (uint32_t i = file->entryOffsets[index]; i < file->entryOffsets[index + 1]; ++i) {
+        uint32_t proc = file->entryProcedures[i];
+        if (proc >= file->procedures.size()) {
+            continue;
+        }
+        auto &p = file->procedures[proc];
+        auto airport = getAirport(p.airport);
+        if (!airport) {
+            continue;
+        }
+        std::shared_ptr<world::NavEdge> via;
+        if (p.type == PROC_STAR) {
+            via = airport->getSTARByName(file->getString(p.name));
+        } else {
+            via = airport->getApproachByName(file->getString(p.name));
+        }
+        if (via) {
+            conns.emplace_back(from, via, airport);
+        }
+    }
+    auto list = std::make_shared<const std::vector<world::World::Connection>>(std::move(conns));
+    fixConnections[index] = list;
+    return list;
+}
+
+const FlatWorld::AirwayEdges &FlatWorld::getAirwayEdges(uint32_t airway)
+{
+    // called with graphGuard held, an airway usable at both levels has an edge for each
+    auto &edges = airwayEdges[airway];
+    if (!edges.lower && !edges.upper) {
+        auto &rec = file->airways[airway];
+        std::string name = file->getString(rec.name);
+        if (rec.levels & AIRWAY_LOWER) {
+            edges.lower = std::make_shared<world::Airway>(name, world::AirwayLevel::LOWER);
+        }
+        if (rec.levels & AIRWAY_UPPER) {
+            edges.upper = std::make_shared<world::Airway>(name, world::AirwayLevel::UPPER);
+        }
+    }
+    return edges;
+}
+
+bool FlatWorld::areConnected(std::shared_ptr<world::NavNode> from, const std::shared_ptr<world::NavNode> to)
+{
+    for (auto &c: *getConnections(from)) {
+        if (c.to == to) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FlatWorld::addRegion(const std::string &code)
+{
+    lookupRegion(code);
+}
+
+std::shared_ptr<world::Region> FlatWorld::getRegion(const std::string &code)
+{
+    return lookupRegion(code);
+}
+
+std::shared_ptr<world::Region> FlatWorld::lookupRegion(const std::string &code) const
+{
+    std::lock_guard<std::mutex> guard(regionGuard);
+    auto &region = regions[code];
+    if (!region) {
+        region = std::make_shared<world::Region>(code);
+    }
+    return region;
+}
+
+void FlatWorld::addFix(std::shared_ptr<world::Fix> f)
+{
+    f->setGlobal(true);
+    std::lock_guard<std::mutex> guard(nodeGuard);
+    addedFixes.push_back(f);
+    ++nodeRevision;
+}
+
+void FlatWorld::setUserFixes(const std::vector<std::shared_ptr<world::Fix>> &fixes)
+{
+    userFixIndex.replace(fixes);
+    ++nodeRevision;
+}
+
+std::shared_ptr<world::RouteFinder> FlatWorld::getRouteFinder()
+{
+    // searches hold their own references to the lists, dropping the cache only means they are rebuilt
+    {
+        std::lock_guard<std::mutex> guard(graphGuard);
+        if (fixConnections.size() > MAX_CACHED_CONNECTIONS) {
+            fixConnections.clear();
+            airportConnections.clear();
+        }
+    }
+    return std::make_shared<world::RouteFinder>(shared_from_this());
+}
+
+size_t FlatWorld::trimNodes(size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(nodeGuard);
+    size_t nodes = (bytes + APPROX_NODE_BYTES - 1) / APPROX_NODE_BYTES;
+    size_t before = cachedNodes;
+    evictNodes(cachedNodes > nodes ? cachedNodes - nodes : 0);
+    return (before - cachedNodes) * APPROX_NODE_BYTES;
+}
+
+void FlatWorld::evictNodes(size_t target)
+{
+    // called with nodeGuard held. nodes shared with anyone else stay, e.g. the fixes of
+    // a route, those kept by airports or those pinned by the map, so the airports go
+    // first to release their fixes.
+    size_t before = cachedNodes;
+    auto evict = [this, target] (auto &nodes, const std::vector<uint32_t> &lastUse) {
+        for (size_t i = 0; i < nodes.size() && cachedNodes > target; ++i) {
+            if (nodes[i] && (lastUse[i] + 1 < useClock) && (nodes[i].use_count() == 1)) {
+                nodes[i].reset();
+                --cachedNodes;
+            }
+        }
+    };
+    evict(airportNodes, airportLastUse);
+    evict(fixNodes, fixLastUse);
+    if (cachedNodes < before) {
+        logger::verbose("Released %zu NAV nodes, %zu remain cached", before - cachedNodes, cachedNodes);
+    }
+}
+
+} /* namespace flatnav */
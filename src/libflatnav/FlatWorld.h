@@ -0,0 +1,140 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "src/world/World.h"
+#include "src/world/graph/DensityPyramid.h"
+#include "src/world/graph/AirportSearchIndex.h"
+#include "src/world/graph/UserFixIndex.h"
+#include "src/platform/MemoryBudget.h"
+#include "FlatNavFile.h"
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+
+namespace flatnav {
+
+/*
+ * A world over a memory-mapped flat NAV database. Searches and visits read the
+ * records in place, the NavNodes handed out are created from their records on
+ * first use and shared until they are no longer visited, so that each record
+ * has a single node while it is in use, e.g. by the route finder.
+ */
+class FlatWorld : public world::World {
+public:
+    FlatWorld(std::shared_ptr<const FlatNavFile> file);
+    FlatWorld() = delete;
+    virtual ~FlatWorld();
+
+    int maxDensity(const world::Location &bottomLeft, const world::Location &topRight) override;
+    void visitNodes(const world::Location &bottomLeft, const world::Location &topRight, NodeAcceptor callback, int filter) override;
+    void visitAlongRoute(const world::Route &route, double bufferNm, NodeAcceptor callback, int filter) override;
+    void visitMajorAirports(const world::Location &bottomLeft, const world::Location &topRight, double cellDegrees, NodeAcceptor callback, int filter) override;
+    uint32_t getNodeRevision() const override;
+    void prefetchAlong(const std::vector<std::vector<world::Location>> &paths) override;
+
+    std::shared_ptr<world::Airport> findAirportByID(const std::string &id) const override;
+    std::shared_ptr<world::Fix> findFixByRegionAndID(const std::string &region, const std::string &id) const override;
+    std::vector<std::shared_ptr<world::Airport>> findAirport(const std::string &keyWord) const override;
+
+    world::World::ConnectionList getConnections(std::shared_ptr<world::NavNode> from) override;
+    bool areConnected(std::shared_ptr<world::NavNode> from, const std::shared_ptr<world::NavNode> to) override;
+
+    void addRegion(const std::string &code) override;
+    std::shared_ptr<world::Region> getRegion(const std::string &id) override;
+
+    void addFix(std::shared_ptr<world::Fix> fix) override;
+    void setUserFixes(const std::vector<std::shared_ptr<world::Fix>> &fixes) override;
+
+    std::shared_ptr<world::RouteFinder> getRouteFinder() override;
+
+    // called once by the load manager before the world is used
+    void buildAirportSearch();
+    size_t getAirportCount() const;
+
+    // the nodes of records, nullptr for an invalid index
+    std::shared_ptr<world::Airport> getAirport(uint32_t index) const;
+    std::shared_ptr<world::Fix> getFix(uint32_t index) const;
+    world::NavNodeList getFixList(uint32_t firstRef, uint32_t count) const;
+    const FlatNavFile &getFile() const;
+
+private:
+    std::shared_ptr<const FlatNavFile> file;
+
+    // Regions indexed by their codes, created as they are used
+    mutable std::map<std::string, std::shared_ptr<world::Region>> regions;
+    mutable std::mutex regionGuard;
+
+    // node counts of each lon/lat area, counted from the grid once
+    world::DensityPyramid density;
+    world::AirportSearchIndex airportSearch;
+
+    // The nodes created so far by record index and the value of useClock when each was
+    // last visited. Visited nodes are kept until the visit after the next, since callers may
+    // refer to them until they visit again, the others only while someone else shares them.
+    mutable std::mutex nodeGuard;
+    mutable std::vector<std::shared_ptr<world::Airport>> airportNodes;
+    mutable std::vector<std::shared_ptr<world::Fix>> fixNodes;
+    mutable std::vector<uint32_t> airportLastUse, fixLastUse;
+    mutable size_t cachedNodes = 0;
+    uint32_t useClock = 0;
+    // fixes added one at a time aren't in the file, they are visited along with the grid
+    std::vector<std::shared_ptr<world::Fix>> addedFixes;
+    world::UserFixIndex userFixIndex;
+    std::atomic<uint32_t> nodeRevision { 0 };
+
+    // The airway edges and the connections built from them on demand. The lists are never
+    // changed once built, so searches can keep using them after the cache was dropped.
+    struct AirwayEdges {
+        std::shared_ptr<world::Airway> lower, upper;
+    };
+    std::mutex graphGuard;
+    std::vector<AirwayEdges> airwayEdges;
+    std::unordered_map<uint32_t, world::World::ConnectionList> fixConnections;
+    std::unordered_map<std::string, world::World::ConnectionList> airportConnections;
+    const world::World::ConnectionList noConnection = std::make_shared<const std::vector<world::World::Connection>>();
+
+    static constexpr const size_t MAX_CACHED_NODES = 200000;
+    static constexpr const size_t MAX_CACHED_CONNECTIONS = 50000;
+    // rough average of a cached node with its names and edges, for the memory accounting
+    static constexpr const size_t APPROX_NODE_BYTES = 300;
+
+    platform::MemoryBudget::Registration memoryConsumer;
+
+    // called with nodeGuard held, create the node of a record if needed and mark it as used
+    std::shared_ptr<world::Airport> airportNode(uint32_t index) const;
+    std::shared_ptr<world::Fix> fixNode(uint32_t index) const;
+    std::shared_ptr<world::Airport> createAirport(uint32_t index) const;
+    std::shared_ptr<world::Fix> createFix(uint32_t index) const;
+    const world::NavNode *useGridNode(uint32_t ref) const;
+    // evicts the nodes not used by the last two visits nor by anyone else until at most target are cached
+    void evictNodes(size_t target);
+    size_t trimNodes(size_t bytes);
+
+    // the grid node references of a cell that pass the filter, read from the records only
+    bool acceptsRecord(uint32_t ref, int filter) const;
+    world::Location getRecordLocation(uint32_t ref) const;
+    std::shared_ptr<world::Region> lookupRegion(const std::string &code) const;
+
+    void loadProcedures(std::shared_ptr<world::Airport> airport, uint32_t index) const;
+    const AirwayEdges &getAirwayEdges(uint32_t airway);
+};
+
+} /* namespace flatnav */
@@ -0,0 +1,155 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FlatProcedure.h"
+#include "../FlatWorld.h"
+#include <algorithm>
+#include <cstring>
+
+namespace flatnav {
+
+FlatProcedure::FlatProcedure(std::weak_ptr<const FlatWorld> w)
+:   world(w)
+{
+}
+
+void FlatProcedure::addVariant(uint32_t procIndex)
+{
+    variants.push_back(procIndex);
+}
+
+std::vector<uint32_t> FlatProcedure::getEntryFixes() const
+{
+    std::vector<uint32_t> res;
+    auto w = world.lock();
+    if (!w) {
+        return res;
+    }
+    auto &file = w->getFile();
+    for (auto v: variants) {
+        auto &p = file.procedures[v];
+        if (p.fixCount > 0) {
+            uint32_t fix = file.fixRefs[p.firstFix];
+            if (std::find(res.begin(), res.end(), fix) == res.end()) {
+                res.push_back(fix);
+            }
+        }
+    }
+    return res;
+}
+
+std::vector<uint32_t> FlatProcedure::getExitFixes() const
+{
+    std::vector<uint32_t> res;
+    auto w = world.lock();
+    if (!w) {
+        return res;
+    }
+    auto &file = w->getFile();
+    for (auto v: variants) {
+        auto &p = file.procedures[v];
+        if (p.fixCount > 0) {
+            uint32_t fix = file.fixRefs[p.firstFix + p.fixCount - 1];
+            if (std::find(res.begin(), res.end(), fix) == res.end()) {
+                res.push_back(fix);
+            }
+        }
+    }
+    return res;
+}
+
+world::NavNodeList FlatProcedure::getWaypoints(std::string runway, std::string transition) const
+{
+    auto w = world.lock();
+    if (!w) {
+        return world::NavNodeList();
+    }
+    auto &file = w->getFile();
+
+    // as with the SQL database, the variants of the runway are candidates and the
+    // first of them with the named transition is used, else the first of them
+    std::vector<uint32_t> candidates;
+    for (auto v: variants) {
+        const char *rwy = file.getString(file.procedures[v].runway);
+        if ((runway == rwy) || (*rwy == '\0')) {
+            candidates.push_back(v);
+        }
+    }
+    if (candidates.empty()) {
+        return world::NavNodeList();
+    }
+
+    uint32_t selected = candidates.front();
+    std::vector<uint32_t> tfixes;
+    bool found = false;
+    for (auto v: candidates) {
+        auto &p = file.procedures[v];
+        for (uint32_t t = p.firstTransition; t < p.firstTransition + p.transitionCount && !found; ++t) {
+            auto &tr = file.transitions[t];
+            if (transition == file.getString(tr.name)) {
+                tfixes.assign(file.fixRefs.begin() + tr.firstFix, file.fixRefs.begin() + tr.firstFix + tr.fixCount);
+                selected = v;
+                found = true;
+            }
+        }
+        if (found) {
+            break;
+        }
+    }
+
+    // combine variant and transition
+    auto &p = file.procedures[selected];
+    std::vector<uint32_t> fxs(file.fixRefs.begin() + p.firstFix, file.fixRefs.begin() + p.firstFix + p.fixCount);
+    insertTransition(fxs, tfixes);
+    if (fxs.empty()) {
+        return world::NavNodeList();
+    }
+
+    // remove duplicates
+    std::vector<uint32_t> clean;
+    clean.push_back(fxs.front());
+    for (auto f: fxs) {
+        if (f != clean.back()) {
+            clean.push_back(f);
+        }
+    }
+
+    world::NavNodeList nodes;
+    for (auto f: clean) {
+        if (auto fix = w->getFix(f)) {
+            nodes.push_back(fix);
+        }
+    }
+    return nodes;
+}
+
+std::vector<world::NavNodeList> FlatProcedure::getVariantPaths() const
+{
+    std::vector<world::NavNodeList> paths;
+    auto w = world.lock();
+    if (!w) {
+        return paths;
+    }
+    for (auto v: variants) {
+        auto &p = w->getFile().procedures[v];
+        paths.push_back(w->getFixList(p.firstFix, p.fixCount));
+    }
+    return paths;
+}
+
+} /* namespace flatnav */
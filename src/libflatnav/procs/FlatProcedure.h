@@ -0,0 +1,53 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "src/world/graph/NavNode.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flatnav {
+
+class FlatWorld;
+
+class FlatProcedure
+{
+public:
+    FlatProcedure(std::weak_ptr<const FlatWorld> world);
+
+    // index of a ProcedureRecord with the name of this procedure
+    void addVariant(uint32_t procIndex);
+
+    // the first and last fix of each variant, where the procedure joins the airway network
+    std::vector<uint32_t> getEntryFixes() const;
+    std::vector<uint32_t> getExitFixes() const;
+
+protected:
+    world::NavNodeList getWaypoints(std::string runway, std::string transition) const;
+    std::vector<world::NavNodeList> getVariantPaths() const;
+    virtual void insertTransition(std::vector<uint32_t> &fixes, const std::vector<uint32_t> &trfixes) const = 0;
+
+private:
+    // weak pointer, the world's airports own their procedures
+    std::weak_ptr<const FlatWorld> world;
+    std::vector<uint32_t> variants;
+};
+
+}
@@ -0,0 +1,49 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FlatSID.h"
+
+namespace flatnav {
+
+FlatSID::FlatSID(std::string name, std::weak_ptr<const FlatWorld> world)
+:   world::SID(name), FlatProcedure(world)
+{
+}
+
+world::NavNodeList FlatSID::getWaypoints(std::shared_ptr<world::Runway> departureRwy, std::string sidTransName) const
+{
+    return FlatProcedure::getWaypoints(departureRwy->getID(), sidTransName);
+}
+
+void FlatSID::insertTransition(std::vector<uint32_t> &fixes, const std::vector<uint32_t> &trfixes) const
+{
+    // SID transitions are appended
+    fixes.insert(fixes.end(), trfixes.begin(), trfixes.end());
+}
+
+std::vector<world::NavNodeList> FlatSID::getPaths() const
+{
+    return getVariantPaths();
+}
+
+std::string FlatSID::toDebugString() const
+{
+    return std::string();
+}
+
+} /* namespace flatnav */
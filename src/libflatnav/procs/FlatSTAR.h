@@ -0,0 +1,38 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "src/world/models/airport/procs/STAR.h"
+#include "FlatProcedure.h"
+
+namespace flatnav {
+
+class FlatSTAR : public world::STAR, public FlatProcedure
+{
+public:
+    FlatSTAR(std::string name, std::weak_ptr<const FlatWorld> world);
+
+    world::NavNodeList getWaypoints(std::shared_ptr<world::Runway> arrivalRwy, std::string starTransName) const override;
+    void insertTransition(std::vector<uint32_t> &fixes, const std::vector<uint32_t> &trfixes) const override;
+
+    std::vector<world::NavNodeList> getPaths() const override;
+    std::string toDebugString() const override;
+
+};
+
+}
@@ -0,0 +1,152 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "BlockCodec.h"
+
+namespace img {
+
+namespace {
+
+inline uint16_t read16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+inline uint32_t read32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+inline uint32_t rgb565ToARGB(uint16_t c) {
+    uint32_t r = (c >> 11) & 0x1F;
+    uint32_t g = (c >> 5) & 0x3F;
+    uint32_t b = c & 0x1F;
+    r = (r << 3) | (r >> 2);
+    g = (g << 2) | (g >> 4);
+    b = (b << 3) | (b >> 2);
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+inline uint32_t mix(uint32_t c0, uint32_t c1, int w0, int w1) {
+    int div = w0 + w1;
+    uint32_t res = 0xFF000000;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t ch = (((c0 >> shift) & 0xFF) * w0 + ((c1 >> shift) & 0xFF) * w1) / div;
+        res |= ch << shift;
+    }
+    return res;
+}
+
+void decodeColors(const uint8_t *block, bool fourColors, bool punchThrough, uint32_t out[16]) {
+    uint16_t c0 = read16(block);
+    uint16_t c1 = read16(block + 2);
+    uint32_t indices = read32(block + 4);
+
+    uint32_t palette[4];
+    palette[0] = rgb565ToARGB(c0);
+    palette[1] = rgb565ToARGB(c1);
+    if (fourColors || c0 > c1) {
+        palette[2] = mix(palette[0], palette[1], 2, 1);
+        palette[3] = mix(palette[0], palette[1], 1, 2);
+    } else {
+        palette[2] = mix(palette[0], palette[1], 1, 1);
+        palette[3] = punchThrough ? 0 : 0xFF000000;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        out[i] = palette[(indices >> (2 * i)) & 3];
+    }
+}
+
+void decodeAlpha(const uint8_t *block, uint32_t out[16]) {
+    uint32_t a0 = block[0];
+    uint32_t a1 = block[1];
+
+    uint32_t palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i <= 6; i++) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+    } else {
+        for (int i = 1; i <= 4; i++) {
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    // 16 indices of 3 bits each
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= (uint64_t) block[2 + i] << (8 * i);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t alpha = palette[(indices >> (3 * i)) & 7];
+        out[i] = (out[i] & 0x00FFFFFF) | (alpha << 24);
+    }
+}
+
+inline uint32_t composite(uint32_t fore, uint32_t back) {
+    uint32_t a = fore >> 24;
+    if (a == 0xFF) {
+        return fore;
+    }
+    uint32_t res = 0xFF000000;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t f = (fore >> shift) & 0xFF;
+        uint32_t b = (back >> shift) & 0xFF;
+        res |= ((f * a + b * (255 - a) + 127) / 255) << shift;
+    }
+    return res;
+}
+
+} // namespace
+
+size_t getBlockBytes(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC1A:
+        return 8;
+    case BlockFormat::BC3:
+        return 16;
+    }
+    return 16;
+}
+
+void decodeBlock(BlockFormat format, const uint8_t *block, uint32_t background, uint32_t out[BLOCK_DIM * BLOCK_DIM]) {
+    switch (format) {
+    case BlockFormat::BC1:
+        decodeColors(block, false, false, out);
+        break;
+    case BlockFormat::BC1A:
+        decodeColors(block, false, true, out);
+        break;
+    case BlockFormat::BC3:
+        decodeColors(block + 8, true, false, out);
+        decodeAlpha(block, out);
+        break;
+    }
+
+    if ((background >> 24) == 0xFF) {
+        for (int i = 0; i < BLOCK_DIM * BLOCK_DIM; i++) {
+            out[i] = composite(out[i], background);
+        }
+    }
+}
+
+} /* namespace img */
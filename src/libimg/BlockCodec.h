@@ -0,0 +1,40 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace img {
+
+// S3TC / DXT block formats that images can keep in memory instead of pixels
+enum class BlockFormat {
+    BC1,    // DXT1, opaque
+    BC1A,   // DXT1 with 1 bit alpha
+    BC3,    // DXT5
+};
+
+constexpr const int BLOCK_DIM = 4;
+
+size_t getBlockBytes(BlockFormat format);
+
+// Decodes one block into 4x4 ARGB pixels. If background is opaque, the
+// pixels are composited onto it.
+void decodeBlock(BlockFormat format, const uint8_t *block, uint32_t background, uint32_t out[BLOCK_DIM * BLOCK_DIM]);
+
+} /* namespace img */
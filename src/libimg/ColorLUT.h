@@ -0,0 +1,54 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+namespace img {
+
+// Maps each colour channel of ARGB pixels through a table, alpha is kept.
+// The entries are stored shifted to the position of their channel.
+struct ColorLUT {
+    uint32_t red[256] {};
+    uint32_t green[256] {};
+    uint32_t blue[256] {};
+
+    // the same curve for all colour channels
+    void setCurve(const uint8_t curve[256]) {
+        for (int i = 0; i < 256; i++) {
+            red[i] = (uint32_t) curve[i] << 16;
+            green[i] = (uint32_t) curve[i] << 8;
+            blue[i] = curve[i];
+        }
+    }
+
+    // scales all channels, e.g. to dim white paper for use at night
+    static ColorLUT brightness(float factor) {
+        uint8_t curve[256];
+        for (int i = 0; i < 256; i++) {
+            curve[i] = (uint8_t) std::clamp((int) std::lround(i * factor), 0, 255);
+        }
+        ColorLUT lut;
+        lut.setCurve(curve);
+        return lut;
+    }
+};
+
+} /* namespace img */
@@ -0,0 +1,149 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include "DDSFile.h"
+
+namespace img {
+
+namespace {
+
+constexpr const size_t HEADER_SIZE = 128; // magic and DDS_HEADER
+constexpr const size_t HEIGHT_OFFSET = 12;
+constexpr const size_t WIDTH_OFFSET = 16;
+constexpr const size_t MIP_COUNT_OFFSET = 28;
+constexpr const size_t PIXEL_FLAGS_OFFSET = 80;
+constexpr const size_t FOURCC_OFFSET = 84;
+constexpr const uint32_t DDPF_FOURCC = 0x4;
+
+inline uint32_t read32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+}
+
+DDSFile::DDSFile(const std::string &utf8Path):
+    file(std::make_unique<platform::MappedFile>(utf8Path))
+{
+    auto data = (const uint8_t *) file->data();
+    size_t size = file->size();
+
+    if (size < HEADER_SIZE || std::memcmp(data, "DDS ", 4) != 0) {
+        throw std::runtime_error("Not a DDS file: " + utf8Path);
+    }
+
+    if (!(read32(data + PIXEL_FLAGS_OFFSET) & DDPF_FOURCC)) {
+        throw std::runtime_error("Uncompressed DDS: " + utf8Path);
+    }
+
+    const uint8_t *fourCC = data + FOURCC_OFFSET;
+    if (std::memcmp(fourCC, "DXT1", 4) == 0) {
+        format = BlockFormat::BC1;
+    } else if (std::memcmp(fourCC, "DXT5", 4) == 0) {
+        format = BlockFormat::BC3;
+    } else {
+        throw std::runtime_error("Unsupported DDS format: " + utf8Path);
+    }
+
+    int width = read32(data + WIDTH_OFFSET);
+    int height = read32(data + HEIGHT_OFFSET);
+    int mipCount = std::max(1, (int) read32(data + MIP_COUNT_OFFSET));
+    if (width <= 0 || height <= 0) {
+        throw std::runtime_error("Invalid DDS dimensions: " + utf8Path);
+    }
+
+    // the levels follow each other, each half the size of the previous one
+    size_t offset = HEADER_SIZE;
+    for (int i = 0; i < mipCount; i++) {
+        size_t blocksX = (width + BLOCK_DIM - 1) / BLOCK_DIM;
+        size_t blocksY = (height + BLOCK_DIM - 1) / BLOCK_DIM;
+        size_t levelSize = blocksX * blocksY * getBlockBytes(format);
+        if (offset + levelSize > size) {
+            break;
+        }
+        mipLevels.push_back(MipLevel {width, height, offset, levelSize});
+        offset += levelSize;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    if (mipLevels.empty()) {
+        throw std::runtime_error("Truncated DDS file: " + utf8Path);
+    }
+}
+
+BlockFormat DDSFile::getFormat() const {
+    return format;
+}
+
+int DDSFile::getMipCount() const {
+    return mipLevels.size();
+}
+
+int DDSFile::getMipWidth(int mipLevel) const {
+    return getLevel(mipLevel).width;
+}
+
+int DDSFile::getMipHeight(int mipLevel) const {
+    return getLevel(mipLevel).height;
+}
+
+const DDSFile::MipLevel &DDSFile::getLevel(int mipLevel) const {
+    if (mipLevel < 0 || mipLevel >= (int) mipLevels.size()) {
+        throw std::runtime_error("Invalid mip level");
+    }
+    return mipLevels[mipLevel];
+}
+
+std::vector<uint8_t> DDSFile::copyBlocks(int mipLevel) const {
+    auto &level = getLevel(mipLevel);
+    auto data = (const uint8_t *) file->data() + level.offset;
+    return std::vector<uint8_t>(data, data + level.size);
+}
+
+void DDSFile::decodeRegion(int mipLevel, int x, int y, int width, int height, uint32_t background, uint32_t *dst, int dstStride) const {
+    auto &level = getLevel(mipLevel);
+    if (x < 0 || y < 0 || x + width > level.width || y + height > level.height) {
+        throw std::runtime_error("Invalid DDS region");
+    }
+
+    auto blocks = (const uint8_t *) file->data() + level.offset;
+    size_t blockBytes = getBlockBytes(format);
+    int blocksPerRow = (level.width + BLOCK_DIM - 1) / BLOCK_DIM;
+    uint32_t block[BLOCK_DIM * BLOCK_DIM];
+
+    for (int by = y / BLOCK_DIM; by * BLOCK_DIM < y + height; by++) {
+        int y0 = std::max(y, by * BLOCK_DIM);
+        int y1 = std::min(y + height, (by + 1) * BLOCK_DIM);
+        for (int bx = x / BLOCK_DIM; bx * BLOCK_DIM < x + width; bx++) {
+            int x0 = std::max(x, bx * BLOCK_DIM);
+            int x1 = std::min(x + width, (bx + 1) * BLOCK_DIM);
+
+            decodeBlock(format, blocks + ((size_t) by * blocksPerRow + bx) * blockBytes, background, block);
+
+            for (int row = y0; row < y1; row++) {
+                uint32_t *out = dst + (size_t) (row - y) * dstStride + (x0 - x);
+                const uint32_t *blockRow = block + (row - by * BLOCK_DIM) * BLOCK_DIM + (x0 - bx * BLOCK_DIM);
+                std::memcpy(out, blockRow, (x1 - x0) * sizeof(uint32_t));
+            }
+        }
+    }
+}
+
+} /* namespace img */
@@ -0,0 +1,61 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include "BlockCodec.h"
+#include "src/platform/MappedFile.h"
+
+namespace img {
+
+// A memory-mapped DDS texture with BC1 (DXT1) or BC3 (DXT5) blocks. Mip levels
+// are found from the header, so reading one doesn't touch the larger ones.
+// The constructor throws for other formats, see DDSImage for those.
+class DDSFile {
+public:
+    explicit DDSFile(const std::string &utf8Path);
+
+    BlockFormat getFormat() const;
+    int getMipCount() const;
+    int getMipWidth(int mipLevel) const;
+    int getMipHeight(int mipLevel) const;
+
+    // the blocks of a whole mip level, see Image::setCompressedBlocks
+    std::vector<uint8_t> copyBlocks(int mipLevel) const;
+
+    // Decodes only the blocks that cover the region into dst, composited onto background if it is opaque
+    void decodeRegion(int mipLevel, int x, int y, int width, int height, uint32_t background, uint32_t *dst, int dstStride) const;
+
+private:
+    struct MipLevel {
+        int width, height;
+        size_t offset, size;
+    };
+
+    std::unique_ptr<platform::MappedFile> file;
+    BlockFormat format = BlockFormat::BC1;
+    std::vector<MipLevel> mipLevels;
+
+    const MipLevel &getLevel(int mipLevel) const;
+};
+
+} /* namespace img */
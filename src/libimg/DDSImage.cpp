@@ -22,7 +22,7 @@
 
 namespace img {
 
-DDSImage::DDSImage(const std::string& utf8Path, int mipLevel) {
+DDSImage::DDSImage(const std::string& utf8Path, int mipLevel, bool keepCompressed) {
     std::string nativePath = platform::UTF8ToACP(utf8Path);
 
     detexTexture **textures;
@@ -34,10 +34,27 @@ DDSImage::DDSImage(const std::string& utf8Path, int mipLevel) {
     bool success = false;
 
     if (mipLevel < numMipsLoaded) {
-        resize(textures[mipLevel]->width, textures[mipLevel]->height, 0);
-        uint8_t *buffer = (uint8_t *) getPixels();
-        if (detexDecompressTextureLinear(textures[mipLevel], buffer, DETEX_PIXEL_FORMAT_BGRA8)) {
+        detexTexture *texture = textures[mipLevel];
+        bool isBlockFormat = false;
+        BlockFormat format = BlockFormat::BC1;
+        switch (texture->format) {
+        case DETEX_TEXTURE_FORMAT_BC1:  format = BlockFormat::BC1;  isBlockFormat = true; break;
+        case DETEX_TEXTURE_FORMAT_BC1A: format = BlockFormat::BC1A; isBlockFormat = true; break;
+        case DETEX_TEXTURE_FORMAT_BC3:  format = BlockFormat::BC3;  isBlockFormat = true; break;
+        default: break;
+        }
+
+        if (keepCompressed && isBlockFormat) {
+            size_t size = (size_t) texture->width_in_blocks * texture->height_in_blocks * getBlockBytes(format);
+            std::vector<uint8_t> blocks(texture->data, texture->data + size);
+            setCompressedBlocks(format, std::move(blocks), texture->width, texture->height);
             success = true;
+        } else {
+            resize(texture->width, texture->height, 0);
+            uint8_t *buffer = (uint8_t *) getPixels();
+            if (detexDecompressTextureLinear(texture, buffer, DETEX_PIXEL_FORMAT_BGRA8)) {
+                success = true;
+            }
         }
     }
 
@@ -52,4 +69,16 @@ DDSImage::DDSImage(const std::string& utf8Path, int mipLevel) {
     }
 }
 
+DDSImage::DDSImage(const DDSFile &file, int mipLevel, bool keepCompressed) {
+    int width = file.getMipWidth(mipLevel);
+    int height = file.getMipHeight(mipLevel);
+
+    if (keepCompressed) {
+        setCompressedBlocks(file.getFormat(), file.copyBlocks(mipLevel), width, height);
+    } else {
+        resize(width, height, 0);
+        file.decodeRegion(mipLevel, 0, 0, width, height, 0, getPixels(), width);
+    }
+}
+
 } /* namespace img */
@@ -20,12 +20,16 @@
 
 #include <string>
 #include "Image.h"
+#include "DDSFile.h"
 
 namespace img {
 
 class DDSImage: public Image {
 public:
-    DDSImage(const std::string &utf8Path, int mipLevel);
+    // keepCompressed stores BC1 and BC3 textures as blocks, see Image::setCompressedBlocks
+    DDSImage(const std::string &utf8Path, int mipLevel, bool keepCompressed = false);
+    // only reads the given mip level from the mapped file
+    DDSImage(const DDSFile &file, int mipLevel, bool keepCompressed = false);
 };
 
 } /* namespace img */
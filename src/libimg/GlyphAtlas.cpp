@@ -0,0 +1,301 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "GlyphAtlas.h"
+#include "TTFStamper.h"
+#include "PixelKernels.h"
+#include "src/Logger.h"
+#include "src/platform/Platform.h"
+
+namespace {
+std::string fontDir;
+std::mutex atlasesMutex;
+std::map<std::string, std::unique_ptr<img::GlyphAtlas>> atlases;
+
+// returns 0 for invalid sequences, i is advanced beyond the sequence
+uint32_t nextCodepoint(const std::string &text, size_t &i) {
+    uint8_t c = text[i++];
+    if (c < 0x80) {
+        return c;
+    }
+
+    int extra = 0;
+    uint32_t cp = 0;
+    if ((c & 0xE0) == 0xC0) {
+        extra = 1;
+        cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        extra = 2;
+        cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        extra = 3;
+        cp = c & 0x07;
+    } else {
+        return 0;
+    }
+
+    for (int k = 0; k < extra; k++) {
+        if (i >= text.size() || (text[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (text[i++] & 0x3F);
+    }
+    return cp;
+}
+}
+
+namespace img {
+
+GlyphAtlas &GlyphAtlas::forFont(const std::string &fontName) {
+    std::lock_guard<std::mutex> lock(atlasesMutex);
+    auto &atlas = atlases[fontName];
+    if (!atlas) {
+        atlas.reset(new GlyphAtlas(fontName));
+    }
+    return *atlas;
+}
+
+void GlyphAtlas::setFontDirectory(const std::string &dir) {
+    fontDir = dir;
+}
+
+GlyphAtlas::GlyphAtlas(const std::string &fontName) {
+    auto error = FT_Init_FreeType(&ft);
+    if (error) {
+        throw std::runtime_error("Couldn't init freetype");
+    }
+
+    error = FT_New_Face(ft, platform::UTF8ToACP(fontDir + fontName).c_str(), 0, &fontFace);
+    if (error) {
+        logger::verbose("Couldn't load desired font, using fallback font");
+        loadInternalFont();
+    }
+}
+
+void GlyphAtlas::loadInternalFont() {
+    const char *encodedFont = GetDefaultCompressedFontDataTTFBase85();
+
+    // decode
+    size_t compressedSize = ((strlen(encodedFont) + 4) / 5) * 4;
+    std::vector<uint8_t> compressedData(compressedSize);
+    Decode85((const uint8_t *) encodedFont, compressedData.data());
+
+    // uncompress
+    size_t uncompressedSize = stb_decompress_length(compressedData.data());
+    fontData.resize(uncompressedSize);
+    stb_decompress(fontData.data(), compressedData.data(), compressedData.size());
+
+    auto error = FT_New_Memory_Face(ft, fontData.data(), fontData.size(), 0, &fontFace);
+    if (error) {
+        throw std::runtime_error("Couldn't load font");
+    }
+}
+
+int GlyphAtlas::getTextWidth(const std::string &text, int size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return textWidthLocked(text, size);
+}
+
+void GlyphAtlas::drawText(Image &dst, const std::string &text, int size, int x, int y, uint32_t color) {
+    std::lock_guard<std::mutex> lock(mutex);
+    drawTextLocked(dst, text, size, x, y, color);
+}
+
+void GlyphAtlas::drawLabels(Image &dst, const std::vector<TextLabel> &labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &label: labels) {
+        int textWidth = textWidthLocked(label.text, label.size);
+        int xOffset = 0;
+        if (label.align == Align::CENTRE) {
+            xOffset = -textWidth / 2;
+        } else if (label.align == Align::RIGHT) {
+            xOffset = -textWidth;
+        }
+        if (label.bgColor & 0xFF000000) {
+            dst.fillRectangle(label.x + xOffset - 1, label.y, label.x + xOffset + textWidth, label.y + label.size, label.bgColor);
+        }
+        drawTextLocked(dst, label.text, label.size, label.x + xOffset, label.y, label.fgColor);
+    }
+}
+
+GlyphAtlas::Stats GlyphAtlas::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats res = stats;
+    res.glyphs = glyphs.size();
+    res.pages = pages.size();
+    return res;
+}
+
+int GlyphAtlas::textWidthLocked(const std::string &text, int size) {
+    int width = 0;
+    for (size_t i = 0; i < text.size(); ) {
+        uint32_t codepoint = nextCodepoint(text, i);
+        width += getGlyph(size, codepoint).advance;
+    }
+    return width;
+}
+
+void GlyphAtlas::drawTextLocked(Image &dst, const std::string &text, int size, int x, int y, uint32_t color) {
+    int textWidth = textWidthLocked(text, size);
+
+    // glyphs are clipped to the text box like they were on a stamp of that size
+    int clipX0 = std::max(x, 0);
+    int clipY0 = std::max(y, 0);
+    int clipX1 = std::min(x + textWidth, dst.getWidth());
+    int clipY1 = std::min(y + size, dst.getHeight());
+    if (clipX0 >= clipX1 || clipY0 >= clipY1) {
+        return;
+    }
+
+    uint32_t *dstPtr = dst.getPixels();
+    int dstWidth = dst.getWidth();
+    std::vector<uint32_t> row;
+
+    int penX = x;
+    for (size_t i = 0; i < text.size(); ) {
+        uint32_t codepoint = nextCodepoint(text, i);
+        Glyph glyph = getGlyph(size, codepoint);
+        if (!glyph.valid) {
+            continue;
+        }
+
+        int gx0 = std::max(penX + glyph.offsetX, clipX0);
+        int gx1 = std::min(penX + glyph.offsetX + glyph.width, clipX1);
+        int gy0 = std::max(y + glyph.offsetY, clipY0);
+        int gy1 = std::min(y + glyph.offsetY + glyph.height, clipY1);
+
+        if (gx0 < gx1) {
+            row.resize(gx1 - gx0);
+            const uint8_t *coverage = pages[glyph.page].coverage.data();
+            for (int py = gy0; py < gy1; py++) {
+                const uint8_t *src = coverage + (glyph.atlasY + py - y - glyph.offsetY) * PAGE_SIZE
+                                              + (glyph.atlasX + gx0 - penX - glyph.offsetX);
+                for (size_t k = 0; k < row.size(); k++) {
+                    row[k] = (src[k] << 24) | (color & 0x00FFFFFF);
+                }
+                blendRow(dstPtr + py * dstWidth + gx0, row.data(), row.size());
+            }
+        }
+
+        penX += glyph.advance;
+    }
+}
+
+GlyphAtlas::Glyph GlyphAtlas::getGlyph(int size, uint32_t codepoint) {
+    GlyphKey key = std::make_tuple(size, codepoint);
+    auto it = glyphs.find(key);
+    if (it != glyphs.end()) {
+        stats.hits++;
+        return it->second;
+    }
+
+    stats.misses++;
+    Glyph glyph = renderGlyph(size, codepoint);
+    glyphs[key] = glyph;
+    return glyph;
+}
+
+GlyphAtlas::Glyph GlyphAtlas::renderGlyph(int size, uint32_t codepoint) {
+    Glyph glyph;
+    if (codepoint == 0 || size <= 0) {
+        return glyph;
+    }
+
+    if (size != currentSize) {
+        FT_Set_Pixel_Sizes(fontFace, 0, size);
+        currentSize = size;
+    }
+
+    auto error = FT_Load_Char(fontFace, codepoint, FT_LOAD_RENDER);
+    if (error) {
+        return glyph;
+    }
+
+    auto slot = fontFace->glyph;
+    double baseline = std::abs(fontFace->descender) * size / fontFace->units_per_EM;
+
+    glyph.advance = slot->advance.x / 64;
+    glyph.width = slot->bitmap.width;
+    glyph.height = slot->bitmap.rows;
+    glyph.offsetX = slot->bitmap_left;
+    glyph.offsetY = size - slot->bitmap_top - baseline;
+
+    if (glyph.width == 0 || glyph.height == 0) {
+        // spaces only advance the pen
+        glyph.width = glyph.height = 0;
+        return glyph;
+    }
+
+    if (!allocate(glyph.width, glyph.height, glyph)) {
+        logger::warn("Glyph %u at size %d doesn't fit into the atlas", codepoint, size);
+        glyph.width = glyph.height = 0;
+        return glyph;
+    }
+
+    uint8_t *dst = pages[glyph.page].coverage.data() + glyph.atlasY * PAGE_SIZE + glyph.atlasX;
+    for (int y = 0; y < glyph.height; y++) {
+        std::memcpy(dst + y * PAGE_SIZE, slot->bitmap.buffer + y * slot->bitmap.pitch, glyph.width);
+    }
+    glyph.valid = true;
+    return glyph;
+}
+
+bool GlyphAtlas::allocate(int width, int height, Glyph &glyph) {
+    if (width > PAGE_SIZE || height > PAGE_SIZE) {
+        return false;
+    }
+
+    // shelf packing: glyphs of one label tend to have similar heights
+    for (size_t i = 0; i < pages.size(); i++) {
+        Page &page = pages[i];
+        if (page.shelfX + width > PAGE_SIZE) {
+            page.shelfY += page.shelfHeight;
+            page.shelfX = 0;
+            page.shelfHeight = 0;
+        }
+        if (page.shelfY + height <= PAGE_SIZE) {
+            glyph.page = i;
+            glyph.atlasX = page.shelfX;
+            glyph.atlasY = page.shelfY;
+            page.shelfX += width;
+            page.shelfHeight = std::max(page.shelfHeight, height);
+            return true;
+        }
+    }
+
+    if (pages.size() >= MAX_PAGES) {
+        // start over, the glyphs in use will be rendered again on demand
+        logger::verbose("Glyph atlas full, clearing %zu glyphs", glyphs.size());
+        glyphs.clear();
+        pages.clear();
+    }
+
+    pages.emplace_back();
+    pages.back().coverage.resize(PAGE_SIZE * PAGE_SIZE);
+    return allocate(width, height, glyph);
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    FT_Done_Face(fontFace);
+    FT_Done_FreeType(ft);
+}
+
+} /* namespace img */
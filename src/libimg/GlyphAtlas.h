@@ -0,0 +1,99 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "Image.h"
+
+namespace img {
+
+// Process-wide cache of rendered glyphs for one font. Glyphs are rasterized
+// once per (size, codepoint) into 8 bit coverage pages, so drawing a label
+// only blits the cached coverage in the text color.
+class GlyphAtlas {
+public:
+    struct Stats {
+        size_t glyphs = 0;
+        size_t pages = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    static GlyphAtlas &forFont(const std::string &fontName);
+    static void setFontDirectory(const std::string &dir);
+
+    int getTextWidth(const std::string &text, int size);
+
+    // draws the text into the box at x, y with the text width and a height of size
+    void drawText(Image &dst, const std::string &text, int size, int x, int y, uint32_t color);
+    void drawLabels(Image &dst, const std::vector<TextLabel> &labels);
+
+    Stats getStats();
+
+    GlyphAtlas(const GlyphAtlas &other) = delete;
+    void operator=(const GlyphAtlas &other) = delete;
+    ~GlyphAtlas();
+
+private:
+    static constexpr const int PAGE_SIZE = 512;
+    static constexpr const size_t MAX_PAGES = 8;
+
+    struct Glyph {
+        bool valid = false;
+        int page = 0, atlasX = 0, atlasY = 0;
+        int width = 0, height = 0;
+        int offsetX = 0, offsetY = 0;
+        int advance = 0;
+    };
+
+    struct Page {
+        std::vector<uint8_t> coverage;
+        int shelfX = 0, shelfY = 0, shelfHeight = 0;
+    };
+
+    using GlyphKey = std::tuple<int, uint32_t>;
+
+    std::mutex mutex;
+    FT_Library ft{};
+    FT_Face fontFace{};
+    std::vector<uint8_t> fontData;
+    int currentSize = 0;
+
+    std::map<GlyphKey, Glyph> glyphs;
+    std::vector<Page> pages;
+    Stats stats;
+
+    explicit GlyphAtlas(const std::string &fontName);
+    void loadInternalFont();
+
+    // these get called with locked mutex
+    Glyph getGlyph(int size, uint32_t codepoint);
+    Glyph renderGlyph(int size, uint32_t codepoint);
+    bool allocate(int width, int height, Glyph &glyph);
+    int textWidthLocked(const std::string &text, int size);
+    void drawTextLocked(Image &dst, const std::string &text, int size, int x, int y, uint32_t color);
+};
+
+} /* namespace img */
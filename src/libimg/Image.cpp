@@ -16,24 +16,166 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#define STBI_WINDOWS_UTF8
 #include <stb/stb_image.h>
-#include <stb/stb_image_resize2.h>
 #include <stdexcept>
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
 #include <fstream>
 #include <algorithm>
-#include <array>
+#include <iterator>
 #include "Image.h"
+#include "QoiCodec.h"
+#include "JpegCodec.h"
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
-#include "TTFStamper.h"
+#include "src/platform/MappedFile.h"
+#include "src/platform/StatCache.h"
+#include "GlyphAtlas.h"
+#include "PixelKernels.h"
+#include "SpriteCache.h"
+#include "PixelPool.h"
+#include "PathRasterizer.h"
+
+namespace {
+const char *TEXT_FONT = "Inconsolata.ttf";
+
+// Liang-Barsky clipping of a segment to [xmin, xmax] x [ymin, ymax], false if nothing is left
+bool clipSegment(float &x0, float &y0, float &x1, float &y1, float xmin, float ymin, float xmax, float ymax) {
+    float t0 = 0, t1 = 1;
+    float dx = x1 - x0, dy = y1 - y0;
+    const float p[4] = {-dx, dx, -dy, dy};
+    const float q[4] = {x0 - xmin, xmax - x0, y0 - ymin, ymax - y0};
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0) {
+            if (q[i] < 0) {
+                return false;
+            }
+            continue;
+        }
+        float t = q[i] / p[i];
+        if (p[i] < 0) {
+            t0 = std::max(t0, t);
+        } else {
+            t1 = std::min(t1, t);
+        }
+        if (t0 > t1) {
+            return false;
+        }
+    }
+    float sx = x0, sy = y0;
+    x0 = sx + t0 * dx;
+    y0 = sy + t0 * dy;
+    x1 = sx + t1 * dx;
+    y1 = sy + t1 * dy;
+    return true;
+}
+}
 
 namespace img {
 
+namespace {
+
+// Row and pixel operations of the blits, chosen once per call from the source's alpha kind
+struct OpaqueBlit {
+    static void row(uint32_t *dst, const uint32_t *src, int count) {
+        std::memcpy(dst, src, count * sizeof(uint32_t));
+    }
+    static void pixel(uint32_t &dst, uint32_t src) {
+        dst = src;
+    }
+};
+
+struct MaskBlit {
+    static void row(uint32_t *dst, const uint32_t *src, int count) {
+        for (int i = 0; i < count; i++) {
+            if (src[i] & 0xFF000000) {
+                dst[i] = src[i];
+            }
+        }
+    }
+    static void pixel(uint32_t &dst, uint32_t src) {
+        if (src & 0xFF000000) {
+            dst = src;
+        }
+    }
+};
+
+struct AlphaBlit {
+    static void row(uint32_t *dst, const uint32_t *src, int count) {
+        blendRow(dst, src, count);
+    }
+    static void pixel(uint32_t &dst, uint32_t src) {
+        if (src & 0xFF000000) {
+            dst = blendColors(dst, src);
+        }
+    }
+};
+
+template<typename Blit>
+void blitRect(uint32_t *dst, int dstStride, const uint32_t *src, int srcStride, int w, int h) {
+    for (int y = 0; y < h; y++) {
+        Blit::row(dst + (ptrdiff_t) y * dstStride, src + (ptrdiff_t) y * srcStride, w);
+    }
+}
+
+// nearest neighbour rotation around the source's center, see Image::blendImage
+template<typename Blit>
+void blitRotated(uint32_t *dst, int dstWidth, int dstHeight, const uint32_t *src, int srcWidth, int srcHeight,
+                 int dstX, int dstY, double angle)
+{
+    int cx = srcWidth / 2;
+    int cy = srcHeight / 2;
+
+    double theta = -angle * M_PI / 180.0;
+    double cosTheta = std::cos(theta);
+    double sinTheta = std::sin(theta);
+
+    int y0 = std::max(dstY, 0), y1 = std::min(dstY + srcHeight, dstHeight);
+    int x0 = std::max(dstX, 0), x1 = std::min(dstX + srcWidth, dstWidth);
+    for (int y = y0; y < y1; y++) {
+        uint32_t *row = dst + (ptrdiff_t) y * dstWidth;
+        for (int x = x0; x < x1; x++) {
+            int x2 = cosTheta * (x - dstX - cx) - sinTheta * (y - dstY - cy) + cx;
+            int y2 = sinTheta * (x - dstX - cx) + cosTheta * (y - dstY - cy) + cy;
+            if (x2 < 0 || x2 >= srcWidth || y2 < 0 || y2 >= srcHeight) {
+                continue;
+            }
+            Blit::pixel(row[x], src[y2 * srcWidth + x2]);
+        }
+    }
+}
+
+// The anti-aliased shapes share a rasterizer per thread that only covers the shape
+// within the image. fill() leaves its buffers cleared, so reusing it is cheap.
+PathRasterizer &shapeRasterizer(int width, int height) {
+    thread_local PathRasterizer rasterizer(0, 0);
+    rasterizer.resize(width, height);
+    return rasterizer;
+}
+
+// pixels touched by the points as x, y pairs around pixel centres plus the margin, false if outside
+bool shapeBounds(const float *xy, size_t count, float margin, int width, int height, int &x0, int &y0, int &x1, int &y1) {
+    float minX = xy[0], maxX = xy[0], minY = xy[1], maxY = xy[1];
+    for (size_t i = 1; i < count; i++) {
+        minX = std::min(minX, xy[2 * i]);
+        maxX = std::max(maxX, xy[2 * i]);
+        minY = std::min(minY, xy[2 * i + 1]);
+        maxY = std::max(maxY, xy[2 * i + 1]);
+    }
+    if (!std::isfinite(minX) || !std::isfinite(maxX) || !std::isfinite(minY) || !std::isfinite(maxY)) {
+        return false;
+    }
+
+    x0 = (int) std::max(std::floor(minX + 0.5f - margin), 0.0f);
+    y0 = (int) std::max(std::floor(minY + 0.5f - margin), 0.0f);
+    x1 = (int) std::min(std::ceil(maxX + 0.5f + margin) + 1, (float) width);
+    y1 = (int) std::min(std::ceil(maxY + 0.5f + margin) + 1, (float) height);
+    return x0 < x1 && y0 < y1;
+}
+
+}
+
 Image::Image():
     pixels(std::make_unique<std::vector<uint32_t>>())
 {
@@ -53,64 +195,161 @@ Image::Image(Image&& other)
 }
 
 Image& Image::operator =(Image&& other) {
+    if (this == &other) {
+        return *this;
+    }
     width = other.width;
     height = other.height;
+    alphaKnown = other.alphaKnown;
+    alphaKind = other.alphaKind;
+    PixelPool::shared().release(std::move(pixels));
     pixels = std::move(other.pixels);
+    compressed = std::move(other.compressed);
+    expanded = other.expanded.load();
     encodedData = std::move(other.encodedData);
     return *this;
 }
 
 void Image::loadImageFile(const std::string& utf8Path) {
-    int nChannels = 4;
-    int nComponents = 0;
-    int imgWidth, imgHeight;
-    uint8_t *decodedData = stbi_load(utf8Path.c_str(), &imgWidth, &imgHeight, &nComponents, nChannels);
-
-    if (!decodedData) {
-        throw std::runtime_error("Couldn't load image " + utf8Path + ": " + stbi_failure_reason());
+    try {
+        platform::MappedFile file(utf8Path);
+        decode(reinterpret_cast<const uint8_t *>(file.data()), file.size());
+    } catch (const std::exception &e) {
+        throw std::runtime_error("Couldn't load image " + utf8Path + ": " + e.what());
     }
+}
 
-    setPixels(decodedData, imgWidth, imgHeight);
+void Image::loadEncodedData(const std::vector<uint8_t>& encodedImage, bool keepData) {
+    try {
+        decode(encodedImage.data(), encodedImage.size());
+    } catch (const std::exception &e) {
+        encodedData.reset();
+        throw std::runtime_error(std::string("Couldn't decode image: ") + e.what());
+    }
 
-    stbi_image_free(decodedData);
+    if (keepData) {
+        encodedData = std::make_unique<std::vector<uint8_t>>(encodedImage);
+    } else {
+        encodedData.reset();
+    }
 }
 
-void Image::loadEncodedData(const std::vector<uint8_t>& encodedImage, bool keepData) {
-    encodedData = std::make_unique<std::vector<uint8_t>>(encodedImage);
+void Image::decode(const uint8_t *data, size_t size) {
+    compressed.reset();
+    alphaKnown = false;
+
+    // the decoders resize the pixels, which then fit into the recycled buffer
+    int w = 0, h = 0;
+    if (readQOIDimensions(data, size, w, h) || readJPEGDimensions(data, size, w, h)) {
+        allocatePixels((size_t) w * h);
+    }
+
+    if (isQOI(data, size)) {
+        decodeQOI(data, size, *pixels, width, height);
+        if (isOpaqueQOI(data, size)) {
+            setAlphaKind(AlphaKind::OPAQUE);
+        }
+        return;
+    }
+
+    // libjpeg writes the rows straight into the pixels, stb_image needs its own buffer
+    if (isJPEG(data, size) && decodeJPEG(data, size, *pixels, width, height)) {
+        setAlphaKind(AlphaKind::OPAQUE);
+        return;
+    }
 
     int nChannels = 4;
     int nComponents = 0;
     int imgWidth, imgHeight;
-    uint8_t *decodedData = stbi_load_from_memory(encodedData->data(), encodedData->size(),
-            &imgWidth, &imgHeight, &nComponents, nChannels);
+    uint8_t *decodedData = stbi_load_from_memory(data, size, &imgWidth, &imgHeight, &nComponents, nChannels);
 
     if (!decodedData) {
-        encodedData.reset();
-        throw std::runtime_error(std::string("Couldn't decode image: ") + stbi_failure_reason());
+        throw std::runtime_error(stbi_failure_reason());
     }
 
     setPixels(decodedData, imgWidth, imgHeight);
+    if (nComponents == 1 || nComponents == 3) {
+        // grey or RGB without alpha, stb_image filled in 255
+        setAlphaKind(AlphaKind::OPAQUE);
+    }
 
     stbi_image_free(decodedData);
+}
 
-    if (!keepData) {
-        encodedData.reset();
+void Image::setPixels(uint8_t* data, int srcWidth, int srcHeight) {
+    compressed.reset();
+    alphaKnown = false;
+    allocatePixels((size_t) srcWidth * srcHeight);
+    rgbaToArgbRow(pixels->data(), data, srcWidth * srcHeight);
+    this->width = srcWidth;
+    this->height = srcHeight;
+}
+
+void Image::setCompressedBlocks(BlockFormat format, std::vector<uint8_t> &&blocks, int srcWidth, int srcHeight) {
+    size_t blocksX = (srcWidth + BLOCK_DIM - 1) / BLOCK_DIM;
+    size_t blocksY = (srcHeight + BLOCK_DIM - 1) / BLOCK_DIM;
+    if (blocks.size() < blocksX * blocksY * getBlockBytes(format)) {
+        throw std::runtime_error("Not enough data for compressed image");
     }
+
+    compressed = std::make_unique<CompressedBlocks>();
+    compressed->format = format;
+    compressed->data = std::move(blocks);
+    expanded = false;
+    PixelPool::shared().release(std::move(pixels));
+    pixels = std::make_unique<std::vector<uint32_t>>();
+    alphaKnown = false;
+    width = srcWidth;
+    height = srcHeight;
 }
 
-void Image::setPixels(uint8_t* data, int srcWidth, int srcHeight) {
-    pixels->resize(srcWidth * srcHeight);
-    uint32_t *dstData = pixels->data();
+bool Image::isCompressed() const {
+    return compressed != nullptr;
+}
 
-    for (int i = 0; i < srcWidth * srcHeight * 4; i += 4) {
-        uint32_t argb = (data[i + 3] << 24) |
-                        (data[i + 0] << 16) |
-                        (data[i + 1] << 8)  |
-                        data[i + 2];
-        dstData[i / 4] = argb;
+size_t Image::getMemorySize() const {
+    if (compressed) {
+        size_t expandedBytes = expanded ? (size_t) width * height * sizeof(uint32_t) : 0;
+        return compressed->data.size() + expandedBytes;
+    }
+    return pixels->size() * sizeof(uint32_t);
+}
+
+void Image::expand() const {
+    if (!compressed || expanded) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(expandMutex);
+    if (!expanded) {
+        allocatePixels((size_t) width * height);
+        decodeRegion(pixels->data(), width, 0, 0, width, height);
+        expanded = true;
+    }
+}
+
+void Image::decodeRegion(uint32_t *dst, int dstStride, int srcX, int srcY, int w, int h) const {
+    size_t blockBytes = getBlockBytes(compressed->format);
+    int blocksPerRow = (width + BLOCK_DIM - 1) / BLOCK_DIM;
+    uint32_t block[BLOCK_DIM * BLOCK_DIM];
+
+    for (int by = srcY / BLOCK_DIM; by * BLOCK_DIM < srcY + h; by++) {
+        int y0 = std::max(srcY, by * BLOCK_DIM);
+        int y1 = std::min(srcY + h, (by + 1) * BLOCK_DIM);
+        for (int bx = srcX / BLOCK_DIM; bx * BLOCK_DIM < srcX + w; bx++) {
+            int x0 = std::max(srcX, bx * BLOCK_DIM);
+            int x1 = std::min(srcX + w, (bx + 1) * BLOCK_DIM);
+
+            const uint8_t *blockData = compressed->data.data() + (by * blocksPerRow + bx) * blockBytes;
+            decodeBlock(compressed->format, blockData, compressed->background, block);
+
+            for (int y = y0; y < y1; y++) {
+                uint32_t *row = dst + (y - srcY) * dstStride + (x0 - srcX);
+                const uint32_t *blockRow = block + (y - by * BLOCK_DIM) * BLOCK_DIM + (x0 - bx * BLOCK_DIM);
+                std::memcpy(row, blockRow, (x1 - x0) * sizeof(uint32_t));
+            }
+        }
     }
-    this->width = srcWidth;
-    this->height = srcHeight;
 }
 
 void Image::storeAndClearEncodedData(const std::string& utf8Path) {
@@ -123,23 +362,52 @@ void Image::storeAndClearEncodedData(const std::string& utf8Path) {
 
     fs::ofstream stream(fs::u8path(utf8Path), std::ios::out | std::ios::binary);
     stream.write(reinterpret_cast<const char *>(encodedData->data()), encodedData->size());
+    if (stream) {
+        platform::StatCache::shared().noteCreated(utf8Path, false);
+    }
 
     encodedData.reset();
 }
 
+void Image::encodeQOI() {
+    encodedData = std::make_unique<std::vector<uint8_t>>(img::encodeQOI(getPixels(), width, height));
+}
+
+void Image::setEncodedData(std::vector<uint8_t> &&data) {
+    encodedData = std::make_unique<std::vector<uint8_t>>(std::move(data));
+}
+
+std::vector<uint8_t> Image::takeEncodedData() {
+    if (!encodedData) {
+        return {};
+    }
+
+    std::vector<uint8_t> res = std::move(*encodedData);
+    encodedData.reset();
+    return res;
+}
 
 void Image::resize(int newWidth, int newHeight, uint32_t color) {
-    int oldSize = this->width * this->height;
+    compressed.reset();
     this->width = newWidth;
     this->height = newHeight;
-    int newSize = this->width * this->height;
-    if (newSize >= oldSize) {
-        std::fill(pixels->begin(), pixels->end(), color);
-        pixels->resize(newSize, color);
-    } else {
-        pixels->resize(newSize);
-        std::fill(pixels->begin(), pixels->end(), color);
+    allocatePixels((size_t) newWidth * newHeight);
+    std::fill(pixels->begin(), pixels->end(), color);
+    setAlphaFromColor(color);
+}
+
+void Image::allocatePixels(size_t count) const {
+    if (pixels && pixels->capacity() >= count) {
+        pixels->resize(count);
+        return;
     }
+    auto &pool = PixelPool::shared();
+    pool.release(std::move(pixels));
+    pixels = pool.acquire(count);
+}
+
+Image::~Image() {
+    PixelPool::shared().release(std::move(pixels));
 }
 
 int Image::getWidth() const {
@@ -151,22 +419,72 @@ int Image::getHeight() const {
 }
 
 const uint32_t* Image::getPixels() const {
+    expand();
     return pixels->data();
 }
 
 uint32_t* Image::getPixels() {
+    // the pixels are about to change, the blocks would be stale
+    expand();
+    compressed.reset();
+    alphaKnown = false;
     return pixels->data();
 }
 
+AlphaKind Image::getAlphaKind() const {
+    if (compressed) {
+        return AlphaKind::TRANSLUCENT;
+    }
+    if (alphaKnown) {
+        return alphaKind;
+    }
+
+    bool opaque = true;
+    const uint32_t *px = pixels->data();
+    size_t count = pixels->size();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t a = px[i] >> 24;
+        if (a != 0xFF) {
+            opaque = false;
+            if (a != 0) {
+                setAlphaKind(AlphaKind::TRANSLUCENT);
+                return alphaKind;
+            }
+        }
+    }
+    setAlphaKind(opaque ? AlphaKind::OPAQUE : AlphaKind::MASK);
+    return alphaKind;
+}
+
+bool Image::isOpaque() const {
+    return getAlphaKind() == AlphaKind::OPAQUE;
+}
+
+void Image::setAlphaKind(AlphaKind kind) const {
+    alphaKind = kind;
+    alphaKnown = true;
+}
+
+void Image::setAlphaFromColor(uint32_t color) const {
+    uint32_t alpha = color >> 24;
+    setAlphaKind(alpha == 0xFF ? AlphaKind::OPAQUE : (alpha == 0 ? AlphaKind::MASK : AlphaKind::TRANSLUCENT));
+}
+
 void Image::clear(uint32_t background) {
+    compressed.reset();
     std::fill(pixels->begin(), pixels->end(), background);
+    setAlphaFromColor(background);
 }
 
-void Image::scale(int newWidth, int newHeight) {
+void Image::scale(int newWidth, int newHeight, ResampleFilter filter) {
+    bool opaque = isOpaque();
     Image scaled(newWidth, newHeight, 0);
 
-    stbir_resize_uint8_linear((uint8_t *) getPixels(), width, height, 0,
-                       (uint8_t *) scaled.getPixels(), newWidth, newHeight, 0, STBIR_RGBA);
+    resample(getPixels(), width, height, width, scaled.getPixels(), newWidth, newHeight, newWidth, filter);
+    if (opaque) {
+        // the filter weights sum up to one, so the alpha stays 255
+        scaled.setAlphaKind(AlphaKind::OPAQUE);
+    }
 
     *this = std::move(scaled);
 }
@@ -181,33 +499,17 @@ void Image::drawPixel(int x, int y, uint32_t color) {
 }
 
 void Image::blendPixel(int x, int y, uint32_t foreCol) {
-    if (x < 0 || x >= width || y < 0 || y >= height) {
+    uint32_t alpha = foreCol >> 24;
+    if (x < 0 || x >= width || y < 0 || y >= height || alpha == 0) {
         return;
     }
 
-    // background
     uint32_t *data = getPixels();
-    uint32_t color = data[y * width + x];
-    float ba = (int) ((color >> 24) & 0xFF) / 255.0;
-    float br = (int) ((color >> 16) & 0xFF) / 255.0;
-    float bg = (int) ((color >>  8) & 0xFF) / 255.0;
-    float bb = (int) ((color >>  0) & 0xFF) / 255.0;
-
-    // foreground
-    float fa = (int) ((foreCol >> 24) & 0xFF) / 255.0;
-    float fr = (int) ((foreCol >> 16) & 0xFF) / 255.0;
-    float fg = (int) ((foreCol >>  8) & 0xFF) / 255.0;
-    float fb = (int) ((foreCol >>  0) & 0xFF) / 255.0;
-
-    float a = fa + ba * (1 - fa);
-    float r = (fr * fa + br * ba * (1 - fa)) / a;
-    float g = (fg * fa + bg * ba * (1 - fa)) / a;
-    float b = (fb * fa + bb * ba * (1 - fa)) / a;
-
-    data[y * width + x] =  (uint8_t(a * 255) << 24)
-            | (uint8_t(r * 255) << 16)
-            | (uint8_t(g * 255) << 8)
-            | (uint8_t(b * 255) << 0);
+    if (alpha == 0xFF) {
+        data[y * width + x] = foreCol;
+    } else {
+        data[y * width + x] = blendColors(data[y * width + x], foreCol);
+    }
 }
 
 void Image::drawLine(int x1, int y1, int x2, int y2, uint32_t color) {
@@ -253,7 +555,25 @@ void Image::drawImage(const Image& src, int dstX, int dstY) {
         return;
     }
 
+    // only uses what is already known, drawing shouldn't scan the source
+    bool keepOpaque = alphaKnown && alphaKind == AlphaKind::OPAQUE && src.alphaKnown && src.alphaKind == AlphaKind::OPAQUE;
     uint32_t *dstPtr = getPixels();
+    if (keepOpaque) {
+        setAlphaKind(AlphaKind::OPAQUE);
+    }
+
+    if (src.isCompressed()) {
+        // only decode the visible part
+        int x0 = std::max(0, dstX);
+        int y0 = std::max(0, dstY);
+        int x1 = std::min(width, dstX + srcWidth);
+        int y1 = std::min(height, dstY + srcHeight);
+        if (x0 < x1 && y0 < y1) {
+            src.decodeRegion(dstPtr + y0 * width + x0, width, x0 - dstX, y0 - dstY, x1 - x0, y1 - y0);
+        }
+        return;
+    }
+
     const uint32_t *srcPtr = src.getPixels();
 
     for (int srcY = 0; srcY < srcHeight; srcY++) {
@@ -285,134 +605,104 @@ void Image::drawImage(const Image& src, int dstX, int dstY) {
     }
 }
 
-void Image::plot(int x, int y, float brightness) {
-    int alpha = (int)(brightness * 255);
-    int color = (alpha << 24) | (drawLineAAColor & 0x00FFFFFF);
-    blendPixel(x, y, color);
+void Image::drawScaledRegion(const Image &src, int srcX, int srcY, int srcW, int srcH, int dstX, int dstY, int dstW, int dstH) {
+    if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0) {
+        return;
+    }
+
+    if (srcX < 0 || srcY < 0 || srcX + srcW > src.getWidth() || srcY + srcH > src.getHeight()) {
+        throw std::runtime_error("Source region out of bounds");
+    }
+
+    if (dstX < 0 || dstY < 0 || dstX + dstW > width || dstY + dstH > height) {
+        throw std::runtime_error("Destination region out of bounds");
+    }
+
+    if (src.isCompressed()) {
+        Image region(srcW, srcH, 0);
+        src.decodeRegion(region.getPixels(), srcW, srcX, srcY, srcW, srcH);
+        drawScaledRegion(region, 0, 0, srcW, srcH, dstX, dstY, dstW, dstH);
+        return;
+    }
+
+    // this runs for placeholder tiles in every frame, so use the cheap filters:
+    // averaging when shrinking children, bilinear when enlarging a parent
+    auto filter = (dstW <= srcW && dstH <= srcH) ? ResampleFilter::AREA : ResampleFilter::BILINEAR;
+    const uint32_t *srcPtr = src.getPixels() + srcY * src.getWidth() + srcX;
+    uint32_t *dstPtr = getPixels() + dstY * width + dstX;
+    resample(srcPtr, srcW, srcH, src.getWidth(), dstPtr, dstW, dstH, width, filter);
 }
 
-// From https://rosettacode.org/wiki/Xiaolin_Wu%27s_line_algorithm#C.2B.2B
 void Image::drawLineAA(float x0, float y0, float x1, float y1, uint32_t color) {
-    drawLineAAColor = color;
-
-    auto ipart = [](float x) -> int {return int(std::floor(x));};
-    auto round = [](float x) -> float {return std::round(x);};
-    auto fpart = [](float x) -> float {return x - std::floor(x);};
-    auto rfpart = [=](float x) -> float {return 1 - fpart(x);};
-
-    const bool steep = abs(y1 - y0) > abs(x1 - x0);
-    if (steep) {
-        std::swap(x0,y0);
-        std::swap(x1,y1);
-    }
-    if (x0 > x1) {
-        std::swap(x0,x1);
-        std::swap(y0,y1);
-    }
-
-    const float dx = x1 - x0;
-    const float dy = y1 - y0;
-    const float gradient = (dx == 0) ? 1 : dy/dx;
-
-    int xpx11;
-    float intery;
-    {
-        const float xend = round(x0);
-        const float yend = y0 + gradient * (xend - x0);
-        const float xgap = rfpart(x0 + 0.5);
-        xpx11 = int(xend);
-        const int ypx11 = ipart(yend);
-        if (steep) {
-            plot(ypx11,     xpx11, rfpart(yend) * xgap);
-            plot(ypx11 + 1, xpx11,  fpart(yend) * xgap);
-        } else {
-            plot(xpx11, ypx11,    rfpart(yend) * xgap);
-            plot(xpx11, ypx11 + 1, fpart(yend) * xgap);
-        }
-        intery = yend + gradient;
-    }
-
-    int xpx12;
-    {
-        const float xend = round(x1);
-        const float yend = y1 + gradient * (xend - x1);
-        const float xgap = rfpart(x1 + 0.5);
-        xpx12 = int(xend);
-        const int ypx12 = ipart(yend);
-        if (steep) {
-            plot(ypx12,     xpx12, rfpart(yend) * xgap);
-            plot(ypx12 + 1, xpx12,  fpart(yend) * xgap);
-        } else {
-            plot(xpx12, ypx12,    rfpart(yend) * xgap);
-            plot(xpx12, ypx12 + 1, fpart(yend) * xgap);
-        }
+    // Long lines such as ILS cones at high zoom are mostly off-screen. The margin keeps
+    // the partial coverage of the cut ends outside, so the visible pixels don't change.
+    const float margin = 2;
+    if (!clipSegment(x0, y0, x1, y1, -margin, -margin, width - 1 + margin, height - 1 + margin)) {
+        return;
     }
 
-    if (steep) {
-        for (int x = xpx11 + 1; x < xpx12; x++) {
-            plot(ipart(intery),     x, rfpart(intery));
-            plot(ipart(intery) + 1, x,  fpart(intery));
-            intery += gradient;
-        }
-    } else {
-        for (int x = xpx11 + 1; x < xpx12; x++) {
-            plot(x, ipart(intery),     rfpart(intery));
-            plot(x, ipart(intery) + 1,  fpart(intery));
-            intery += gradient;
-        }
+    float xy[4] = {x0, y0, x1, y1};
+    strokePolyline(xy, 2, 1, color);
+}
+
+void Image::fillPolygon(const float *xy, size_t count, uint32_t color) {
+    int x0, y0, x1, y1;
+    if (count < 3 || !shapeBounds(xy, count, 0, width, height, x0, y0, x1, y1)) {
+        return;
+    }
+
+    PathRasterizer &rasterizer = shapeRasterizer(x1 - x0, y1 - y0);
+    float dx = 0.5f - x0, dy = 0.5f - y0;
+    rasterizer.moveTo(xy[0] + dx, xy[1] + dy);
+    for (size_t i = 1; i < count; i++) {
+        rasterizer.lineTo(xy[2 * i] + dx, xy[2 * i + 1] + dy);
     }
+    rasterizer.fill(*this, color, x0, y0);
+}
+
+void Image::strokePolyline(const float *xy, size_t count, float lineWidth, uint32_t color) {
+    int x0, y0, x1, y1;
+    if (count < 2 || !shapeBounds(xy, count, lineWidth / 2, width, height, x0, y0, x1, y1)) {
+        return;
+    }
+
+    std::vector<float> shifted(xy, xy + 2 * count);
+    for (size_t i = 0; i < count; i++) {
+        shifted[2 * i] += 0.5f - x0;
+        shifted[2 * i + 1] += 0.5f - y0;
+    }
+    PathRasterizer &rasterizer = shapeRasterizer(x1 - x0, y1 - y0);
+    rasterizer.addStroke(shifted.data(), count, lineWidth);
+    rasterizer.fill(*this, color, x0, y0);
 }
 
 void Image::drawCircle(int x_centre, int y_centre, int radius, uint32_t color) {
-    // Anti-aliased, by considering all pixels in the enclosing square, but with several
-    // short-cuts so that obvious transparent pixels don't take time.
-    // A lot of pythagoras, but try not to do too many sqrts.
-    float coarseInnerLimitSquared = pow((radius - 1.5), 2);
-    float coarseOuterLimitSquared = pow((radius + 1.5), 2);
-    float fineInnerLimitSquared = pow((radius - 0.5), 2);
-    float fineOuterLimitSquared = pow((radius + 0.5), 2);
-    for (int y = -radius - 1; y <= radius + 1; y++) {
-        int xRange = sqrt(coarseOuterLimitSquared - pow(abs(y),2));
-        for (int x = -xRange; x <= xRange; x++) {
-            float dSquared = (x * x) + (y * y);
-            if ((x < 0) && (dSquared < coarseInnerLimitSquared)) {
-                x = -x; // Shortcut to mirrored right hand side inside ring
-                continue;
-            }
-            // Anti-aliasing : how many of the 4 (2x2) subpixels contain part of the ring
-            int total = 0;
-            for (float ys = y - 0.25; ys <= y + 0.25; ys += 0.5) {
-                for (float xs = x - 0.25; xs <= x + 0.25; xs += 0.5) {
-                    dSquared = (xs * xs) + (ys * ys);
-                    if ((dSquared > fineInnerLimitSquared) && (dSquared < fineOuterLimitSquared)) {
-                        total++;
-                    }
-                }
-            }
-            int alpha = (total * 255) / 4;
-            int colorAA = (alpha << 24) | (color & 0x00FFFFFF);
-            blendPixel(x_centre + x, y_centre + y, colorAA);
-        }
+    // Rings are cached like the filled circles, they are rendered one pixel beyond the radius
+    if (radius < 0) {
+        return;
     }
+    auto key = SpriteCache::makeKey(SpriteKind::RING, radius, color);
+    auto sprite = SpriteCache::shared().get(key, [radius, color] () {
+        int extent = radius + 1;
+        auto ring = std::make_shared<Image>(extent * 2 + 1, extent * 2 + 1, 0x00FFFFFF);
+        ring->drawCircleCacheImage(extent, extent, radius, color);
+        return ring;
+    });
+    blendImage0(*sprite, x_centre - radius - 1, y_centre - radius - 1);
+}
+
+void Image::drawCircleCacheImage(int x_centre, int y_centre, int radius, uint32_t color) {
+    // a one pixel wide ring centered on the radius
+    PathRasterizer &rasterizer = shapeRasterizer(width, height);
+    rasterizer.addRing(x_centre + 0.5f, y_centre + 0.5f, radius, 1);
+    rasterizer.fill(*this, color);
 }
 
 void Image::fillCircleCacheImage(int x_centre, int y_centre, int radius, uint32_t color) {
-    float d;
-    int alpha;
-    for (int y = y_centre - radius; y <= y_centre + radius; y++) {
-        for (int x = x_centre - radius; x <= x_centre + radius; x++) {
-            d = sqrt(pow((x - x_centre), 2) + pow((y - y_centre), 2));
-            if (d > (radius + 0.5)) {
-                alpha = 0; // Definitely outside
-            } else if (d < (radius - 0.5)) {
-                alpha = 255; // Definitely inside
-            } else {
-                alpha = ((radius + 0.5) - d) * 255; // Border, so alpha blend for anti-aliasing
-            }
-            int colorAA = (alpha << 24) | (color & 0x00FFFFFF);
-            blendPixel(x, y, colorAA);
-        }
-    }
+    // the edge is half a pixel beyond the radius, so the outermost pixels are half covered
+    PathRasterizer &rasterizer = shapeRasterizer(width, height);
+    rasterizer.addCircle(x_centre + 0.5f, y_centre + 0.5f, radius + 0.5f);
+    rasterizer.fill(*this, color);
 }
 
 void Image::fillCircle(int x_centre, int y_centre, int radius, uint32_t color) {
@@ -421,122 +711,20 @@ void Image::fillCircle(int x_centre, int y_centre, int radius, uint32_t color) {
     if (radius <= 0) {
         return;
     }
-    uint64_t key = (uint64_t)(radius) << 32 | color;
-    std::shared_ptr<img::Image> pImage;
-    auto it = circleCache.find(key);
-    if (it != circleCache.end()) {
-        pImage = it->second;
-    } else {
-        pImage = std::make_shared<img::Image>(radius * 2 + 1, radius * 2 + 1, 0x00FFFFFF);
-        pImage->fillCircleCacheImage(radius, radius, radius, color);
-        circleCache.insert(std::make_pair(key, pImage));
-    }
-    blendImage0(*pImage, x_centre - radius, y_centre - radius);
-}
-
-// This class is a representation of a classic line equation ax + by + c
-// It is used in rectangle fills to determine whether a point is inside or outside
-// a rectangle bounding line. And how far away from the line it is so as to determine
-// appropriate alpha blend for anti-aliasing
-class LineEquation {
-public:
-    LineEquation(int x1, int y1, int x2, int y2, int ref_x, int ref_y) {
-        if ((x1 == x2) && (y1 == y2)) {
-            LOG_WARN("Attempt to construct line with 2 identical points");
-            x1++;
-        }
-        a = y1 - y2;
-        b = x2 - x1;
-        c = x1 * y2 - x2 * y1;
-        normalAdjust = 10 / sqrt(a * a + b * b);
-        refOffsetSign = (computeDistance(ref_x, ref_y) >= 0);
-    }
-    int getIntensity(int x, int y) {
-        // Return a value between 0 and 4, which is the multiplicative
-        // contribution to alphas blend from this line instance.
-        int intensity;
-        int distance = (int)(computeDistance(x, y) * normalAdjust);
-        bool sameSign = ((distance >= 0) == refOffsetSign);
-        bool throughPixel = abs(distance) < 7;
-        if (throughPixel) {
-            int offset = abs(distance);
-            if (sameSign) {
-                intensity = 2 + (offset * 2) / 7;
-            } else {
-                intensity = 2 - (offset * 2) / 7;
-            }
-            return intensity;
-        } else {
-            if (sameSign) {
-                return 4;
-            } else {
-                return 0;
-            }
-        }
-    }
-private:
-    int a;
-    int b;
-    int c;
-    int refOffsetSign;
-    float normalAdjust;
-
-    int computeDistance(int x, int y) {
-        return a * x + b * y + c;
-    }
-};
+    auto key = SpriteCache::makeKey(SpriteKind::FILLED_CIRCLE, radius, color);
+    auto sprite = SpriteCache::shared().get(key, [radius, color] () {
+        auto circle = std::make_shared<Image>(radius * 2 + 1, radius * 2 + 1, 0x00FFFFFF);
+        circle->fillCircleCacheImage(radius, radius, radius, color);
+        return circle;
+    });
+    blendImage0(*sprite, x_centre - radius, y_centre - radius);
+}
 
 // Fill rotated rectangle, given 4 points
 // Points must be in an order where successive points create each one of the bounding lines
 void Image::fillRectangle(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color) {
-    if (((x0 == x1) && (y0 == y1)) || ((x0 == x2) && (y0 == y2)) || ((x0 == x3) && (y0 == y3)) ||
-        ((x1 == x2) && (y1 == y2)) || ((x1 == x3) && (y1 == y3)) || ((x2 == x3) && (y2 == y3))) {
-        LOG_WARN("Requested with some identical points, skipping, fix calling code");
-        return;
-    }
-    int xCentre = (x0 + x1 + x2 + x3) / 4;
-    int yCentre = (y0 + y1 + y2 + y3) / 4;
-
-    int xMin = std::min({x0, x1, x2, x3});
-    xMin = std::max(0, xMin);
-    int xMax = std::max({x0, x1, x2, x3});
-    xMax = std::min(width, xMax);
-    int yMin = std::min({y0, y1, y2, y3});
-    yMin = std::max(0, yMin);
-    int yMax = std::max({y0, y1, y2, y3});
-    yMax = std::min(width, yMax);
-
-    std::array<LineEquation, 4> lines = {
-        LineEquation(x0, y0, x1, y1, xCentre, yCentre),
-        LineEquation(x1, y1, x2, y2, xCentre, yCentre),
-        LineEquation(x2, y2, x3, y3, xCentre, yCentre),
-        LineEquation(x3, y3, x0, y0, xCentre, yCentre)
-    };
-
-    // Loop through all possible pixels and ask each of the 4 LineEquations for a
-    // inside/outside/border multiplicative contribution (0-4) to the alpha blend.
-    bool beenInside;
-    for(int y = yMin - 1; y <= yMax + 1; y++) {
-        beenInside = false;
-        for(int x = xMin - 1; x <= xMax + 1; x++) {
-            int alpha = 1;
-            for (auto line: lines) {
-                alpha *= line.getIntensity(x,y);
-            }
-
-            if (alpha == 0) {
-                if (beenInside) {
-                    break; // Short circuit if done this row
-                }
-            } else {
-                if (alpha == 256) {
-                    alpha = 255;
-                }
-                blendPixel(x, y, (color & 0x00FFFFFF) | (alpha << 24));
-                beenInside = true;
-            }
-        }
-    }
+    const float xy[8] = {(float) x0, (float) y0, (float) x1, (float) y1, (float) x2, (float) y2, (float) x3, (float) y3};
+    fillPolygon(xy, 4, color);
 }
 
 void Image::drawRectangle(int x0, int y0, int x1, int y1, uint32_t color) {
@@ -564,6 +752,28 @@ void Image::fillRectangle(int x0, int y0, int x1, int y1, uint32_t color) {
     }
 }
 
+void Image::scroll(int dx, int dy) {
+    if (std::abs(dx) >= width || std::abs(dy) >= height || (dx == 0 && dy == 0)) {
+        return;
+    }
+
+    uint32_t *ptr = getPixels();
+    int copyWidth = width - std::abs(dx);
+    int srcX = dx < 0 ? -dx : 0;
+    int dstX = dx > 0 ? dx : 0;
+
+    if (dy > 0) {
+        // bottom-up so that rows are not overwritten before they are moved
+        for (int y = height - 1; y >= dy; y--) {
+            std::memmove(ptr + y * width + dstX, ptr + (y - dy) * width + srcX, copyWidth * sizeof(uint32_t));
+        }
+    } else {
+        for (int y = 0; y < height + dy; y++) {
+            std::memmove(ptr + y * width + dstX, ptr + (y - dy) * width + srcX, copyWidth * sizeof(uint32_t));
+        }
+    }
+}
+
 void Image::copyTo(Image& dst, int srcX, int srcY) {
     int copyWidth = dst.getWidth();
     int copyHeight = dst.getHeight();
@@ -594,112 +804,117 @@ void Image::blendImage(const Image& src, int dstX, int dstY, double angle) {
         return;
     }
 
-    // Rotation center
-    int cx = srcWidth / 2;
-    int cy = srcHeight / 2;
-
-    double theta = -angle * M_PI / 180.0;
-    double cosTheta = std::cos(theta);
-    double sinTheta = std::sin(theta);
-
-    for (int y = dstY; y < dstY + srcHeight; y++) {
-        for (int x = dstX; x < dstX + srcWidth; x++) {
-            if (x < 0 || x >= width || y < 0 || y >= height) {
-                continue;
-            }
-
-            int x2 = cosTheta * (x - dstX - cx) - sinTheta * (y - dstY - cy) + cx;
-            int y2 = sinTheta * (x - dstX - cx) + cosTheta * (y - dstY - cy) + cy;
-            if (x2 < 0 || x2 >= srcWidth || y2 < 0 || y2 >= srcHeight) {
-                continue;
-            }
-
-            const uint32_t *s = src.getPixels() + y2 * srcWidth + x2;
-            if (*s & 0xFF000000) {
-                blendPixel(x, y, *s);
-            }
-        }
+    AlphaKind kind = src.getAlphaKind();
+    const uint32_t *srcPtr = src.getPixels();
+    uint32_t *dstPtr = getPixels();
+    switch (kind) {
+    case AlphaKind::OPAQUE:
+        blitRotated<OpaqueBlit>(dstPtr, width, height, srcPtr, srcWidth, srcHeight, dstX, dstY, angle);
+        break;
+    case AlphaKind::MASK:
+        blitRotated<MaskBlit>(dstPtr, width, height, srcPtr, srcWidth, srcHeight, dstX, dstY, angle);
+        break;
+    case AlphaKind::TRANSLUCENT:
+        blitRotated<AlphaBlit>(dstPtr, width, height, srcPtr, srcWidth, srcHeight, dstX, dstY, angle);
+        break;
     }
 }
 
 void Image::blendImage270(const Image& src, int dstX, int dstY) {
     int srcWidth = src.getWidth();
     int srcHeight = src.getHeight();
-    if (srcWidth == 0 || srcHeight == 0) {
+
+    // the source is rotated, so it covers srcHeight x srcWidth pixels
+    int x0 = std::max(dstX, 0);
+    int x1 = std::min(dstX + srcHeight, width);
+    int y0 = std::max(dstY, 0);
+    int y1 = std::min(dstY + srcWidth, height);
+    if (x0 >= x1 || y0 >= y1) {
         return;
     }
 
-    const uint32_t *srcPtr = src.getPixels();
+    // rotate the visible part into rows, the last row belongs to y0
+    int rowWidth = x1 - x0;
+    int rows = y1 - y0;
+    std::vector<uint32_t> rotated(rowWidth * rows);
+    const uint32_t *srcPtr = src.getPixels() + (x0 - dstX) * srcWidth + (srcWidth - y1 + dstY);
+    transposeRect(rotated.data(), rowWidth, srcPtr, srcWidth, rowWidth, rows);
 
-    for (int y = dstY; y < dstY + srcWidth; y++) {
-        int srcX = srcWidth - 1 - (y - dstY);
-        for (int x = dstX; x < dstX + srcHeight; x++) {
-            int srcY = x - dstX;
-            if (srcX < 0 || srcX >= srcWidth|| srcY < 0 || srcY >= srcHeight) {
-                continue;
-            }
-            uint32_t srcColor = srcPtr[srcY * srcWidth + srcX];
-            if (srcColor & 0xFF000000) {
-                blendPixel(x, y, srcColor);
-            }
-        }
+    uint32_t *dstPtr = getPixels();
+    for (int y = y0; y < y1; y++) {
+        blendRow(dstPtr + y * width + x0, rotated.data() + (y1 - 1 - y) * rowWidth, rowWidth);
     }
 }
 
 void Image::blendImage0(const Image& src, int dstX, int dstY) {
+    blendImage0(src, dstX, dstY, BlendMode::NORMAL, 1);
+}
+
+void Image::blendImage0(const Image& src, int dstX, int dstY, BlendMode mode, float opacity) {
     int srcWidth = src.getWidth();
     int srcHeight = src.getHeight();
-    if (srcWidth == 0 || srcHeight == 0) {
+
+    int x0 = std::max(dstX, 0);
+    int x1 = std::min(dstX + srcWidth, width);
+    int y0 = std::max(dstY, 0);
+    int y1 = std::min(dstY + srcHeight, height);
+    if (x0 >= x1 || y0 >= y1) {
         return;
     }
 
-    //uint32_t *dstPtr = getPixels();
     const uint32_t *srcPtr = src.getPixels();
+    AlphaKind kind = src.getAlphaKind();
+    bool wasOpaque = alphaKnown && alphaKind == AlphaKind::OPAQUE;
+    uint32_t *dstPtr = getPixels();
+    uint32_t *dstStart = dstPtr + y0 * width + x0;
+    const uint32_t *srcStart = srcPtr + (y0 - dstY) * srcWidth + (x0 - dstX);
 
-    for (int y = dstY; y < dstY + srcHeight; y++) {
-        for (int x = dstX; x < dstX + srcWidth; x++) {
-            int srcX = x - dstX;
-            int srcY = y - dstY;
-            if (srcX < 0 || srcX >= srcWidth|| srcY < 0 || srcY >= srcHeight) {
-                continue;
-            }
-            uint32_t srcColor = srcPtr[srcY * srcWidth + srcX];
-            if (srcColor & 0xFF000000) {
-                blendPixel(x, y, srcColor);
-            }
+    if (mode != BlendMode::NORMAL || opacity < 1) {
+        for (int y = y0; y < y1; y++) {
+            blendRowMode(dstPtr + y * width + x0, srcPtr + (y - dstY) * srcWidth + (x0 - dstX), x1 - x0, mode, opacity);
         }
+    } else if (kind == AlphaKind::OPAQUE) {
+        blitRect<OpaqueBlit>(dstStart, width, srcStart, srcWidth, x1 - x0, y1 - y0);
+    } else if (kind == AlphaKind::MASK) {
+        blitRect<MaskBlit>(dstStart, width, srcStart, srcWidth, x1 - x0, y1 - y0);
+    } else {
+        blitRect<AlphaBlit>(dstStart, width, srcStart, srcWidth, x1 - x0, y1 - y0);
+    }
+
+    if (wasOpaque) {
+        // blending never lowers the alpha of an opaque background
+        setAlphaKind(AlphaKind::OPAQUE);
     }
 }
 
 void Image::alphaBlend(uint32_t color) {
-    // background
-    float ba = (int) ((color >> 24) & 0xFF) / 255.0;
-    float br = (int) ((color >> 16) & 0xFF) / 255.0;
-    float bg = (int) ((color >>  8) & 0xFF) / 255.0;
-    float bb = (int) ((color >>  0) & 0xFF) / 255.0;
-
-
-    for (int y = 0; y < height; y++) {
-        uint32_t *ptr = getPixels() + y * width;
-        for (int x = 0; x < width; x++) {
-            int foreCol = ptr[x];
-
-            // foreground
-            float fa = (int) ((foreCol >> 24) & 0xFF) / 255.0;
-            float fr = (int) ((foreCol >> 16) & 0xFF) / 255.0;
-            float fg = (int) ((foreCol >>  8) & 0xFF) / 255.0;
-            float fb = (int) ((foreCol >>  0) & 0xFF) / 255.0;
-
-            float a = fa + ba * (1 - fa);
-            float r = (fr * fa + br * ba * (1 - fa)) / a;
-            float g = (fg * fa + bg * ba * (1 - fa)) / a;
-            float b = (fb * fa + bb * ba * (1 - fa)) / a;
-
-            ptr[x] =  (uint8_t(a * 255) << 24)
-                    | (uint8_t(r * 255) << 16)
-                    | (uint8_t(g * 255) << 8)
-                    | (uint8_t(b * 255) << 0);
+    if (compressed && !expanded && (color >> 24) == 0xFF) {
+        // composite when decoding, blending twice onto an opaque color changes nothing
+        if ((compressed->background >> 24) != 0xFF) {
+            compressed->background = color;
         }
+        return;
+    }
+
+    blendRowOnto(getPixels(), color, width * height);
+}
+
+void Image::mapColors(const ColorLUT &lut, int x, int y, int w, int h) {
+    int x0 = std::max(0, x);
+    int y0 = std::max(0, y);
+    int x1 = std::min(width, x + w);
+    int y1 = std::min(height, y + h);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    uint32_t *ptr = getPixels();
+    if (x0 == 0 && x1 == width) {
+        mapColorsRow(ptr + y0 * width, lut, (y1 - y0) * width);
+        return;
+    }
+    for (int row = y0; row < y1; row++) {
+        mapColorsRow(ptr + row * width + x0, lut, x1 - x0);
     }
 }
 
@@ -728,18 +943,17 @@ void Image::rotate90(Image &dst) {
     int xOffset = width / 2 - dst.height / 2;
     int yOffset = height / 2 - dst.width / 2;
 
-    for (int y = 0; y < dst.height; y++) {
-        int srcX = xOffset + y;
-
-        for (int x = 0; x < dst.width; x++) {
-            int srcY = width - 1 - yOffset - x;
-            if (srcX < 0 || srcX >= width || srcY < 0 || srcY >= height) {
-                continue;
-            }
-
-            dstPtr[y * dst.width + x] = srcPtr[srcY * width + srcX];
-        }
+    // dst(x, y) = src(xOffset + y, width - 1 - yOffset - x), clipped to the source
+    int x0 = std::max(0, width - yOffset - height);
+    int x1 = std::min(dst.width, width - yOffset);
+    int y0 = std::max(0, -xOffset);
+    int y1 = std::min(dst.height, width - xOffset);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
     }
+
+    const uint32_t *srcStart = srcPtr + (width - 1 - yOffset - x0) * width + (xOffset + y0);
+    transposeRect(dstPtr + y0 * dst.width + x0, dst.width, srcStart, -width, x1 - x0, y1 - y0);
 }
 
 void Image::rotate180(Image &dst) {
@@ -749,17 +963,19 @@ void Image::rotate180(Image &dst) {
     uint32_t *srcPtr = getPixels();
     uint32_t *dstPtr = dst.getPixels();
 
+    // dst(x, y) = src(width - 1 - x, height - 1 - yOffset - y)
+    int x0 = std::max(xOffset, 0);
+    int x1 = std::min(dst.width, width);
+    if (x0 >= x1) {
+        return;
+    }
+
     for (int y = 0; y < dst.height; y++) {
         int srcY = height - 1 - yOffset - y;
-        int startX = xOffset;
-        for (int x = startX; x < dst.width; x++) {
-            int srcX = width - x - 1;
-            if (srcX < 0 || srcX >= width || srcY < 0 || srcY >= height) {
-                continue;
-            }
-
-            dstPtr[y * dst.width + x] = srcPtr[srcY * width + srcX];
+        if (srcY < 0 || srcY >= height) {
+            continue;
         }
+        reverseRow(dstPtr + y * dst.width + x0, srcPtr + srcY * width + (width - x1), x1 - x0);
     }
 }
 
@@ -770,17 +986,18 @@ void Image::rotate270(Image &dst) {
     int xOffset = width / 2 - dst.height / 2;
     int yOffset = height / 2 - dst.width / 2;
 
-    for (int y = 0; y < dst.height; y++) {
-        int srcX = height - 1 - xOffset - y;
-
-        for (int x = 0; x < dst.width; x++) {
-            int srcY = yOffset + x;
-            if (srcX < 0 || srcX >= width || srcY < 0 || srcY >= height) {
-                continue;
-            }
-            dstPtr[y * dst.width + x] = srcPtr[srcY * width + srcX];
-        }
+    // dst(x, y) = src(height - 1 - xOffset - y, yOffset + x), clipped to the source
+    int x0 = std::max(0, -yOffset);
+    int x1 = std::min(dst.width, height - yOffset);
+    int y0 = std::max(0, height - xOffset - width);
+    int y1 = std::min(dst.height, height - xOffset);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
     }
+
+    // walk the destination rows bottom up so the source columns increase
+    const uint32_t *srcStart = srcPtr + (yOffset + x0) * width + (height - xOffset - y1);
+    transposeRect(dstPtr + (y1 - 1) * dst.width + x0, -dst.width, srcStart, width, x1 - x0, y1 - y0);
 }
 
 void Image::rotate(Image& dst, int angle) {
@@ -793,30 +1010,39 @@ void Image::rotate(Image& dst, int angle) {
     }
 }
 
+void Image::rotateBilinear(Image &dst, double angle) {
+    double rad = angle * M_PI / 180.0;
+    double c = std::cos(rad);
+    double s = std::sin(rad);
+
+    // same centers as rotate0, so that small angles don't shift the image
+    int srcCX = width / 2, srcCY = height / 2;
+    int dstCX = dst.width / 2, dstCY = dst.height / 2;
+
+    const uint32_t *srcPtr = getPixels();
+    uint32_t *dstPtr = dst.getPixels();
+
+    // dst(x, y) = src(srcC + R(-angle) * (x, y) - dstC), stepping along the source direction of dst's rows
+    for (int y = 0; y < dst.height; y++) {
+        double dx = -dstCX;
+        double dy = y - dstCY;
+        double u = srcCX + dx * c + dy * s;
+        double v = srcCY - dx * s + dy * c;
+        affineRow(dstPtr + y * dst.width, srcPtr, width, height, u, v, c, -s, dst.width);
+    }
+}
+
 void Image::drawText(const std::string &text, int size, int x, int y, uint32_t fgColor, uint32_t bgColor, Align al) {
     // x, y, is top left corner
-    static TTFStamper textBox("Inconsolata.ttf");
-    textBox.setSize(size);
-    textBox.setColor(fgColor & 0x00FFFFFF);
-    textBox.setText(text);
-    auto textWidth = textBox.getTextWidth(text);
-    int xOffset = 0;
-    if (al == Align::CENTRE) {
-        xOffset = -textWidth / 2;
-    } else if (al == Align::RIGHT) {
-        xOffset = -textWidth;
-    }
-    if (bgColor & 0xFF000000) {
-        fillRectangle(x + xOffset - 1, y, x + xOffset + textWidth, y + size, bgColor);
-    }
-    textBox.applyStamp(*this, x + xOffset, y);
+    drawTexts({TextLabel{text, size, x, y, fgColor, bgColor, al}});
+}
+
+void Image::drawTexts(const std::vector<TextLabel> &labels) {
+    GlyphAtlas::forFont(TEXT_FONT).drawLabels(*this, labels);
 }
 
 int Image::getTextWidth(const std::string text, int size) {
-    static TTFStamper dummyBox("Inconsolata.ttf");
-    dummyBox.setSize(size);
-    dummyBox.setText(text.c_str());
-    return dummyBox.getTextWidth(text);
+    return GlyphAtlas::forFont(TEXT_FONT).getTextWidth(text, size);
 }
 
 } /* namespace img */
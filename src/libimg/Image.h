@@ -23,6 +23,12 @@
 #include <cstdint>
 #include <string>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include "BlockCodec.h"
+#include "Resampler.h"
+#include "ColorLUT.h"
+#include "PixelKernels.h"
 
 namespace img {
 
@@ -48,6 +54,22 @@ enum class Align {
     RIGHT
 };
 
+// How an image uses its alpha channel, so that drawing it can skip the blending
+enum class AlphaKind : uint8_t {
+    OPAQUE,         // all pixels have alpha 255
+    MASK,           // alpha is either 0 or 255
+    TRANSLUCENT,    // anything else
+};
+
+struct TextLabel {
+    std::string text;
+    int size;
+    int x, y;
+    uint32_t fgColor;
+    uint32_t bgColor;
+    Align align;
+};
+
 class Image {
 public:
     Image();
@@ -61,33 +83,61 @@ public:
     void loadImageFile(const std::string &utf8Path);
     void loadEncodedData(const std::vector<uint8_t> &encodedImage, bool keepData);
     void setPixels(uint8_t *data, int srcWidth, int srcHeight);
+    // Keep DXT blocks instead of pixels. Drawing the image only decodes the blocks
+    // that are needed, other pixel access expands the whole image.
+    void setCompressedBlocks(BlockFormat format, std::vector<uint8_t> &&blocks, int srcWidth, int srcHeight);
+    bool isCompressed() const;
+    size_t getMemorySize() const;
+
+    // Encode the pixels so that rendered images can be stored like loaded ones
+    void encodeQOI();
 
     // No effect if not loaded via loadEncodedData!
     void storeAndClearEncodedData(const std::string &utf8Path);
+    std::vector<uint8_t> takeEncodedData();
+    // Keep the data that the image was rendered from instead, e.g. a vector tile
+    void setEncodedData(std::vector<uint8_t> &&data);
 
     int getWidth() const;
     int getHeight() const;
     const uint32_t *getPixels() const;
+    // the caller may change the pixels, so this forgets the alpha kind
     uint32_t *getPixels();
 
+    // Known from decoding and filling, otherwise found by looking at the pixels once.
+    // Compressed images are reported as translucent rather than decoding them.
+    AlphaKind getAlphaKind() const;
+    bool isOpaque() const;
+
     void clear(uint32_t background = 0xFFFFFFFF);
-    void scale(int newWidth, int newHeight);
+    void scale(int newWidth, int newHeight, ResampleFilter filter = ResampleFilter::LANCZOS3);
     void drawPixel(int x, int y, uint32_t color);
     void drawLine(int x1, int y1, int x2, int y2, uint32_t color);
     void drawLineAA(float x0, float y0, float x1, float y1, uint32_t color);
     void drawImage(const Image &src, int dstX, int dstY);
+    // scale a region of src into a region of this image, both must be inside their images
+    void drawScaledRegion(const Image &src, int srcX, int srcY, int srcW, int srcH, int dstX, int dstY, int dstW, int dstH);
     void copyTo(Image &dst, int srcX, int srcY);
+    // move the content by dx/dy, the exposed strips keep their old pixels
+    void scroll(int dx, int dy);
     void blendImage(const Image &src, int dstX, int dstY, double angle);
     void blendImage270(const Image &src, int dstX, int dstY);
     void blendImage0(const Image &src, int dstX, int dstY);
+    void blendImage0(const Image &src, int dstX, int dstY, BlendMode mode, float opacity);
     void alphaBlend(uint32_t color);
+    // map the colours of a region through the table, the region is clipped to the image
+    void mapColors(const ColorLUT &lut, int x, int y, int w, int h);
     void blendPixel(int x, int y, uint32_t color);
     void fillCircle(int x, int y, int radius, uint32_t color);
     void drawCircle(int x, int y, int radius, uint32_t color);
     void drawRectangle(int x0, int y0, int x1, int y1, uint32_t color);
     void fillRectangle(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color);
     void fillRectangle(int x0, int y0, int x1, int y1, uint32_t color);
+    // anti-aliased, count points as x, y pairs where integer positions are pixel centres
+    void fillPolygon(const float *xy, size_t count, uint32_t color);
+    void strokePolyline(const float *xy, size_t count, float lineWidth, uint32_t color);
     void drawText(const std::string &text, int size, int x, int y, uint32_t fgColor, uint32_t bgColor, Align al);
+    void drawTexts(const std::vector<TextLabel> &labels);
     int  getTextWidth(const std::string text, int size);
 
     // the source image must be square with edge len = max(srcWidth, srcHeight)
@@ -96,19 +146,40 @@ public:
     void rotate180(Image &dst);
     void rotate270(Image &dst);
     void rotate(Image &dst, int angle);
+    // clockwise by any angle in degrees around the centers of both images, bilinearly filtered
+    void rotateBilinear(Image &dst, double angle);
 
-    virtual ~Image() = default;
+    virtual ~Image();
 private:
     int width = 0;
     int height = 0;
-    uint32_t drawLineAAColor = 0;
     std::unique_ptr<std::vector<uint8_t>> encodedData;
-    std::unique_ptr<std::vector<uint32_t>> pixels;
-
-    std::map<uint64_t, std::shared_ptr<img::Image>> circleCache;
 
+    struct CompressedBlocks {
+        BlockFormat format = BlockFormat::BC1;
+        std::vector<uint8_t> data;
+        uint32_t background = 0;
+    };
+
+    // Compressed images are expanded on the first direct pixel access. Images in shared caches
+    // are read by several threads, so const access keeps the blocks for readers still decoding
+    // them and the first reader fills the pixels under expandMutex. Writers drop the blocks.
+    mutable std::unique_ptr<std::vector<uint32_t>> pixels;
+    std::unique_ptr<CompressedBlocks> compressed;
+    mutable std::mutex expandMutex;
+    mutable std::atomic_bool expanded { false };
+    mutable bool alphaKnown = false;
+    mutable AlphaKind alphaKind = AlphaKind::TRANSLUCENT;
+
+    void expand() const;
+    void setAlphaKind(AlphaKind kind) const;
+    void setAlphaFromColor(uint32_t color) const;
+    // sets the pixel count, taking a recycled buffer if the current one is too small
+    void allocatePixels(size_t count) const;
+    void decode(const uint8_t *data, size_t size);
+    void decodeRegion(uint32_t *dst, int dstStride, int srcX, int srcY, int w, int h) const;
     void fillCircleCacheImage(int x_centre, int y_centre, int radius, uint32_t color);
-    void plot(int x, int y, float brightness);
+    void drawCircleCacheImage(int x_centre, int y_centre, int radius, uint32_t color);
 };
 
 } /* namespace img */
@@ -0,0 +1,184 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <csetjmp>
+#include <cstdio>
+#include "JpegCodec.h"
+#include "src/Logger.h"
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace img {
+
+namespace {
+
+// libjpeg's default handler exits the process, this one jumps back to the decoder
+struct ErrorManager {
+    jpeg_error_mgr mgr;
+    jmp_buf jump;
+};
+
+void onError(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    logger::verbose("libjpeg: %s", message);
+    longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1);
+}
+
+void onMessage(j_common_ptr cinfo, int level) {
+    // warnings about corrupt data still produce usable tiles
+}
+
+// reads from memory, jpeg_mem_src isn't available in every libjpeg version
+void initSource(j_decompress_ptr cinfo) {
+}
+
+boolean fillInputBuffer(j_decompress_ptr cinfo) {
+    // truncated data: insert an EOI marker like libjpeg's own sources do
+    static const JOCTET EOI[] = {0xFF, JPEG_EOI};
+    cinfo->src->next_input_byte = EOI;
+    cinfo->src->bytes_in_buffer = sizeof(EOI);
+    return TRUE;
+}
+
+void skipInputData(j_decompress_ptr cinfo, long count) {
+    if (count <= 0) {
+        return;
+    }
+    if ((size_t) count > cinfo->src->bytes_in_buffer) {
+        fillInputBuffer(cinfo);
+        return;
+    }
+    cinfo->src->next_input_byte += count;
+    cinfo->src->bytes_in_buffer -= count;
+}
+
+void termSource(j_decompress_ptr cinfo) {
+}
+
+// RGB pixels at the start of the row to ARGB in place, backwards so that no source byte is overwritten early
+void expandRGBRow(uint32_t *row, int width) {
+    const uint8_t *rgb = reinterpret_cast<const uint8_t *>(row);
+    for (int x = width - 1; x >= 0; x--) {
+        const uint8_t *px = rgb + 3 * x;
+        row[x] = 0xFF000000 | (px[0] << 16) | (px[1] << 8) | px[2];
+    }
+}
+
+} // namespace
+
+bool isJPEG(const uint8_t *data, size_t size) {
+    return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+bool readJPEGDimensions(const uint8_t *data, size_t size, int &width, int &height) {
+    if (!isJPEG(data, size)) {
+        return false;
+    }
+
+    // the segments before the first scan all have a length, so they can be skipped
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            // fill byte
+            pos++;
+            continue;
+        }
+
+        size_t len = (data[pos + 2] << 8) | data[pos + 3];
+        bool isFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (isFrame) {
+            if (pos + 9 > size) {
+                return false;
+            }
+            height = (data[pos + 5] << 8) | data[pos + 6];
+            width = (data[pos + 7] << 8) | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+        pos += 2 + len;
+    }
+    return false;
+}
+
+bool decodeJPEG(const uint8_t *data, size_t size, std::vector<uint32_t> &pixels, int &width, int &height) {
+    jpeg_decompress_struct cinfo;
+    ErrorManager err;
+    jpeg_source_mgr src;
+
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = onError;
+    err.mgr.emit_message = onMessage;
+
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+
+    src.next_input_byte = data;
+    src.bytes_in_buffer = size;
+    src.init_source = initSource;
+    src.fill_input_buffer = fillInputBuffer;
+    src.skip_input_data = skipInputData;
+    src.resync_to_restart = jpeg_resync_to_restart;
+    src.term_source = termSource;
+    cinfo.src = &src;
+
+    jpeg_read_header(&cinfo, TRUE);
+
+#if defined(JCS_EXTENSIONS) && (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || defined(_WIN32))
+    // libjpeg-turbo writes B, G, R, A bytes, which are ARGB words on little endian machines
+    cinfo.out_color_space = JCS_EXT_BGRA;
+    constexpr const bool expand = false;
+#else
+    cinfo.out_color_space = JCS_RGB;
+    constexpr const bool expand = true;
+#endif
+
+    jpeg_start_decompress(&cinfo);
+
+    int w = cinfo.output_width;
+    int h = cinfo.output_height;
+    pixels.resize((size_t) w * h);
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint32_t *row = pixels.data() + (size_t) cinfo.output_scanline * w;
+        JSAMPROW rows[] = {reinterpret_cast<JSAMPROW>(row)};
+        if (jpeg_read_scanlines(&cinfo, rows, 1) != 1) {
+            break;
+        }
+        if (expand) {
+            expandRGBRow(row, w);
+        }
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    width = w;
+    height = h;
+    return true;
+}
+
+} /* namespace img */
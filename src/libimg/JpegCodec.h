@@ -0,0 +1,38 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace img {
+
+// JPEG decoding through libjpeg straight into the ARGB pixels of Image,
+// most online map tiles are JPEGs.
+
+bool isJPEG(const uint8_t *data, size_t size);
+
+// the dimensions from the first frame header, without decoding anything
+bool readJPEGDimensions(const uint8_t *data, size_t size, int &width, int &height);
+
+// false if libjpeg can't decode the image, e.g. for colour spaces it can't
+// convert to RGB. width and height are only changed on success.
+bool decodeJPEG(const uint8_t *data, size_t size, std::vector<uint32_t> &pixels, int &width, int &height);
+
+} /* namespace img */
@@ -0,0 +1,279 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <algorithm>
+#include "PathRasterizer.h"
+#include "PixelKernels.h"
+
+namespace img {
+
+namespace {
+
+// corners of a polygon that stays within 0.1 pixels of the circle
+int circleCorners(float radius) {
+    float maxError = std::min(0.1f / radius, 1.0f);
+    int corners = (int) std::ceil(M_PI / std::acos(1 - maxError));
+    return std::max(8, std::min(corners, 256));
+}
+
+}
+
+PathRasterizer::PathRasterizer(int width, int height) {
+    resize(width, height);
+}
+
+void PathRasterizer::resize(int newWidth, int newHeight) {
+    clearSpans();
+    width = newWidth;
+    height = newHeight;
+    size_t needed = (size_t) (width + 2) * height;
+    if (area.size() < needed) {
+        area.resize(needed, 0.0f);
+    }
+    spanMin.assign(height, width + 2);
+    spanMax.assign(height, -1);
+    coverage.resize(width);
+    resetBounds();
+}
+
+void PathRasterizer::resetBounds() {
+    minRow = height;
+    maxRow = -1;
+}
+
+void PathRasterizer::clearSpans() {
+    for (int y = minRow; y <= maxRow; y++) {
+        if (spanMin[y] <= spanMax[y]) {
+            float *row = &area[y * (width + 2)];
+            std::fill(row + spanMin[y], row + spanMax[y] + 1, 0.0f);
+        }
+        spanMin[y] = width + 2;
+        spanMax[y] = -1;
+    }
+    resetBounds();
+}
+
+void PathRasterizer::moveTo(float x, float y) {
+    closePath();
+    startX = curX = x;
+    startY = curY = y;
+}
+
+void PathRasterizer::lineTo(float x, float y) {
+    addLine(curX, curY, x, y);
+    curX = x;
+    curY = y;
+}
+
+void PathRasterizer::closePath() {
+    if (curX != startX || curY != startY) {
+        addLine(curX, curY, startX, startY);
+    }
+    curX = startX;
+    curY = startY;
+}
+
+void PathRasterizer::addStroke(const float *xy, size_t count, float lineWidth) {
+    closePath();
+    float half = lineWidth / 2;
+
+    // a quad per segment, all with the same winding so that they merge
+    for (size_t i = 1; i < count; i++) {
+        float x0 = xy[2 * i - 2], y0 = xy[2 * i - 1];
+        float x1 = xy[2 * i], y1 = xy[2 * i + 1];
+        float len = std::hypot(x1 - x0, y1 - y0);
+        if (len == 0) {
+            continue;
+        }
+        float nx = -(y1 - y0) / len * half;
+        float ny = (x1 - x0) / len * half;
+        addLine(x0 + nx, y0 + ny, x1 + nx, y1 + ny);
+        addLine(x1 + nx, y1 + ny, x1 - nx, y1 - ny);
+        addLine(x1 - nx, y1 - ny, x0 - nx, y0 - ny);
+        addLine(x0 - nx, y0 - ny, x0 + nx, y0 + ny);
+    }
+
+    // the joints are rounded off, lines thinner than a pixel don't show gaps there
+    if (half > 0.75f) {
+        for (size_t i = 1; i + 1 < count; i++) {
+            addDot(xy[2 * i], xy[2 * i + 1], half);
+        }
+    }
+}
+
+void PathRasterizer::addDot(float x, float y, float radius) {
+    // an octagon, wound like the stroke quads
+    addPolygon(x, y, radius, 8, false);
+}
+
+void PathRasterizer::addCircle(float x, float y, float radius) {
+    closePath();
+    if (radius > 0) {
+        addPolygon(x, y, radius, circleCorners(radius), false);
+    }
+}
+
+void PathRasterizer::addRing(float x, float y, float radius, float lineWidth) {
+    closePath();
+    float outer = radius + lineWidth / 2;
+    float inner = radius - lineWidth / 2;
+    if (outer <= 0) {
+        return;
+    }
+    addPolygon(x, y, outer, circleCorners(outer), false);
+    if (inner > 0) {
+        // the opposite winding cuts out the inside
+        addPolygon(x, y, inner, circleCorners(inner), true);
+    }
+}
+
+void PathRasterizer::addPolygon(float x, float y, float radius, int corners, bool reverse) {
+    float step = (reverse ? 2 : -2) * (float) M_PI / corners;
+    float px = x + radius, py = y;
+    for (int i = 1; i <= corners; i++) {
+        float nx = x + radius * std::cos(i * step);
+        float ny = y + radius * std::sin(i * step);
+        addLine(px, py, nx, ny);
+        px = nx;
+        py = ny;
+    }
+}
+
+void PathRasterizer::addLine(float x0, float y0, float x1, float y1) {
+    if (y0 == y1 || std::isnan(x0) || std::isnan(x1)) {
+        return;
+    }
+
+    float dir = 1;
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        dir = -1;
+    }
+
+    float top = std::max(y0, 0.0f);
+    float bottom = std::min(y1, (float) height);
+    if (top >= bottom) {
+        return;
+    }
+
+    float dxdy = (x1 - x0) / (y1 - y0);
+    float x = x0 + (top - y0) * dxdy;
+    int firstRow = (int) top;
+    int row = firstRow;
+    for (; row < bottom; row++) {
+        float dy = std::min((float) (row + 1), bottom) - std::max((float) row, top);
+        float xNext = x + dxdy * dy;
+        // what lies left of the image still counts for the pixels right of it
+        float cx0 = std::min(std::max(x, 0.0f), (float) width);
+        float cx1 = std::min(std::max(xNext, 0.0f), (float) width);
+        accumulate(&area[row * (width + 2)], cx0, cx1, dy * dir);
+        spanMin[row] = std::min(spanMin[row], (int) std::floor(std::min(cx0, cx1)));
+        spanMax[row] = std::max(spanMax[row], std::min((int) std::ceil(std::max(cx0, cx1)) + 1, width + 1));
+        x = xNext;
+    }
+    minRow = std::min(minRow, firstRow);
+    maxRow = std::max(maxRow, row - 1);
+}
+
+void PathRasterizer::accumulate(float *row, float x0, float x1, float d) {
+    // distributes the signed area that the line's part in this row covers to
+    // the right of it, fill() sums it up along the row
+    float xl = std::min(x0, x1), xr = std::max(x0, x1);
+    int il = (int) std::floor(xl);
+    int ir = (int) std::ceil(xr);
+
+    if (ir <= il + 1) {
+        float mid = 0.5f * (x0 + x1) - il;
+        row[il] += d - d * mid;
+        row[il + 1] += d * mid;
+        return;
+    }
+
+    float s = 1.0f / (xr - xl);
+    float fl = xl - il;
+    float a0 = 0.5f * s * (1 - fl) * (1 - fl);
+    float fr = xr - ir + 1;
+    float am = 0.5f * s * fr * fr;
+    row[il] += d * a0;
+    if (ir == il + 2) {
+        row[il + 1] += d * (1 - a0 - am);
+    } else {
+        float a1 = s * (1.5f - fl);
+        row[il + 1] += d * (a1 - a0);
+        for (int i = il + 2; i < ir - 1; i++) {
+            row[i] += d * s;
+        }
+        float a2 = a1 + (ir - il - 3) * s;
+        row[ir - 1] += d * (1 - a2 - am);
+    }
+    row[ir] += d * am;
+}
+
+void PathRasterizer::fill(Image &dst, uint32_t color, int dstX, int dstY) {
+    closePath();
+
+    uint32_t *pixels = dst.getPixels();
+    int dstWidth = dst.getWidth();
+    int dstHeight = dst.getHeight();
+    uint32_t alpha = color >> 24;
+    uint32_t rgb = color & 0x00FFFFFF;
+
+    for (int y = minRow; y <= maxRow; y++) {
+        int first = spanMin[y];
+        int last = spanMax[y];
+        if (first > last) {
+            continue;
+        }
+        spanMin[y] = width + 2;
+        spanMax[y] = -1;
+
+        // the sum after the last touched entry is 0, so only the span has coverage
+        float *row = &area[y * (width + 2)];
+        int lastPixel = std::min(last, width - 1);
+        int count = lastPixel - first + 1;
+        coverageRow(coverage.data(), row + first, count);
+        // sums past the last column are only left over from clipping
+        std::fill(row + std::max(first, lastPixel + 1), row + last + 1, 0.0f);
+
+        int outY = y + dstY;
+        if (outY < 0 || outY >= dstHeight) {
+            continue;
+        }
+        uint32_t *out = &pixels[outY * dstWidth];
+        int from = std::max(0, -(first + dstX));
+        int to = std::min(count, dstWidth - (first + dstX));
+        for (int i = from; i < to; i++) {
+            uint32_t c = coverage[i];
+            if (c == 0) {
+                continue;
+            }
+            int x = first + i + dstX;
+            if (c == 255 && alpha == 0xFF) {
+                out[x] = color;
+            } else {
+                uint32_t a = (alpha * c + 127) / 255;
+                out[x] = blendColors(out[x], (a << 24) | rgb);
+            }
+        }
+    }
+
+    resetBounds();
+}
+
+} /* namespace img */
@@ -0,0 +1,78 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "Image.h"
+
+namespace img {
+
+/*
+ * Anti-aliased scanline rasterizer for filled polygons and stroked lines,
+ * e.g. to render vector map tiles. Paths are accumulated as signed area per
+ * pixel and composited into an image with fill(), so the cost is linear in
+ * the path length plus the pixels covered. Overlapping paths of the same
+ * winding are merged, opposite windings cut holes like in vector tiles.
+ * Coordinates outside of the area are clipped.
+ */
+class PathRasterizer {
+public:
+    PathRasterizer(int width, int height);
+
+    // discards the paths added so far, the buffers are kept so that a
+    // rasterizer can be reused for shapes of different sizes
+    void resize(int width, int height);
+
+    void moveTo(float x, float y);
+    void lineTo(float x, float y);
+    void closePath();
+
+    // outline of a line of the given width through count points as x, y pairs
+    void addStroke(const float *xy, size_t count, float lineWidth);
+
+    // a polygon close enough to the circle that the difference doesn't show
+    void addCircle(float x, float y, float radius);
+    // the part of a stroke of the given width around the circle
+    void addRing(float x, float y, float radius, float lineWidth);
+
+    // blends everything added since the last fill into the image with the color,
+    // the rasterizer's origin is at dstX, dstY and it is clipped to the image
+    void fill(Image &dst, uint32_t color, int dstX = 0, int dstY = 0);
+
+private:
+    int width = 0, height = 0;
+    // width + 2 entries per row, the line accumulation writes up to two past the last pixel.
+    // Everything is 0 outside of the spans, so the buffer can be larger than needed.
+    std::vector<float> area;
+    // the touched entries of each row, fill() only walks these
+    std::vector<int> spanMin, spanMax;
+    std::vector<uint8_t> coverage;
+    int minRow = 0, maxRow = -1;
+    float startX = 0, startY = 0, curX = 0, curY = 0;
+
+    void addLine(float x0, float y0, float x1, float y1);
+    void accumulate(float *row, float x0, float x1, float d);
+    void addDot(float x, float y, float radius);
+    void addPolygon(float x, float y, float radius, int corners, bool reverse);
+    void clearSpans();
+    void resetBounds();
+};
+
+} /* namespace img */
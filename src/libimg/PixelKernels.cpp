@@ -0,0 +1,995 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "PixelKernels.h"
+#include "src/Logger.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#   define AVITAB_KERNELS_X86 1
+#   include <immintrin.h>
+#elif defined(__aarch64__)
+#   define AVITAB_KERNELS_NEON 1
+#   include <arm_neon.h>
+#endif
+
+namespace img {
+
+namespace {
+
+// 32 x 32 pixels are 4 KiB per block on both sides, which fits into L1 together
+constexpr const int TRANSPOSE_BLOCK = 32;
+
+// Row strides that are a multiple of this many bytes alias in the cache
+constexpr const ptrdiff_t CONFLICT_STRIDE_BYTES = 2048;
+
+inline bool isConflictStride(ptrdiff_t stride) {
+    return ((stride < 0 ? -stride : stride) * (ptrdiff_t) sizeof(uint32_t)) % CONFLICT_STRIDE_BYTES == 0;
+}
+
+struct Kernels {
+    const char *name;
+    void (*blendRow)(uint32_t *dst, const uint32_t *src, int count);
+    void (*blendRowOnto)(uint32_t *pixels, uint32_t background, int count);
+    void (*reverseRow)(uint32_t *dst, const uint32_t *src, int count);
+    void (*transposeRect)(uint32_t *dst, ptrdiff_t dstStride, const uint32_t *src, ptrdiff_t srcStride, int width, int height);
+    void (*rgbaToArgbRow)(uint32_t *dst, const uint8_t *src, int count);
+    void (*mapColorsRow)(uint32_t *pixels, const ColorLUT &lut, int count);
+    void (*premultiplyRow)(float *dst, const uint32_t *src, int count);
+    void (*convolveRow)(float *dst, const float *src, const int *starts, const float *weights, int taps, int count);
+    void (*accumulateRow)(float *dst, const float *src, float weight, int count);
+    void (*unpremultiplyRow)(uint32_t *dst, const float *src, int count);
+    void (*gradientRow)(float *diff, float *smooth, const float *src, int count);
+    void (*shadeRow)(float *shade, const float *diffAbove, const float *diff, const float *diffBelow,
+                     const float *smoothAbove, const float *smoothBelow, const ShadeLight &light, int count);
+    void (*affineRow)(uint32_t *dst, const uint32_t *src, int width, int height, int32_t u, int32_t v, int32_t du, int32_t dv, int count);
+    void (*coverageRow)(uint8_t *coverage, float *area, int count);
+};
+
+// Bilinear sampling works on 16.16 fixed point positions with 7 bit weights,
+// so that the channel differences times the weights fit into 16 bit lanes.
+constexpr const int AFFINE_WEIGHT_BITS = 7;
+
+// top left, top right, bottom left and bottom right texel around the position,
+// replicating the border and all 0 further than a pixel outside the image
+inline void fetchQuad(const uint32_t *src, int width, int height, int32_t u, int32_t v, uint32_t quad[4]) {
+    int x = u >> 16;
+    int y = v >> 16;
+    if (x < -1 || y < -1 || x >= width || y >= height) {
+        quad[0] = quad[1] = quad[2] = quad[3] = 0;
+        return;
+    }
+    int x0 = std::max(x, 0), x1 = std::min(x + 1, width - 1);
+    const uint32_t *row0 = src + std::max(y, 0) * width;
+    const uint32_t *row1 = src + std::min(y + 1, height - 1) * width;
+    quad[0] = row0[x0];
+    quad[1] = row0[x1];
+    quad[2] = row1[x0];
+    quad[3] = row1[x1];
+}
+
+inline int affineWeight(int32_t pos) {
+    return (pos >> (16 - AFFINE_WEIGHT_BITS)) & ((1 << AFFINE_WEIGHT_BITS) - 1);
+}
+
+// The scalar versions are the reference: the vector code performs the same
+// float operations in the same order, so both produce the same pixels.
+
+void blendRowScalar(uint32_t *dst, const uint32_t *src, int count) {
+    for (int i = 0; i < count; i++) {
+        if (src[i] & 0xFF000000) {
+            dst[i] = blendColors(dst[i], src[i]);
+        }
+    }
+}
+
+void blendRowOntoScalar(uint32_t *pixels, uint32_t background, int count) {
+    for (int i = 0; i < count; i++) {
+        pixels[i] = blendColors(background, pixels[i]);
+    }
+}
+
+void reverseRowScalar(uint32_t *dst, const uint32_t *src, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = src[count - 1 - i];
+    }
+}
+
+void transposeRectScalar(uint32_t *dst, ptrdiff_t dstStride, const uint32_t *src, ptrdiff_t srcStride, int width, int height) {
+    for (int y = 0; y < height; y++) {
+        uint32_t *dstRow = dst + y * dstStride;
+        for (int x = 0; x < width; x++) {
+            dstRow[x] = src[x * srcStride + y];
+        }
+    }
+}
+
+void rgbaToArgbRowScalar(uint32_t *dst, const uint8_t *src, int count) {
+    for (int i = 0; i < count; i++) {
+        const uint8_t *px = src + 4 * i;
+        dst[i] = ((uint32_t) px[3] << 24) | (px[0] << 16) | (px[1] << 8) | px[2];
+    }
+}
+
+void mapColorsRowScalar(uint32_t *pixels, const ColorLUT &lut, int count) {
+    // table lookups don't vectorise without gathers, this is the version for SSE2 and NEON too
+    for (int i = 0; i < count; i++) {
+        uint32_t c = pixels[i];
+        pixels[i] = (c & 0xFF000000) | lut.red[(c >> 16) & 0xFF] | lut.green[(c >> 8) & 0xFF] | lut.blue[c & 0xFF];
+    }
+}
+
+void premultiplyRowScalar(float *dst, const uint32_t *src, int count) {
+    for (int i = 0; i < count; i++) {
+        float a = (src[i] >> 24) & 0xFF;
+        float scale = a / 255.0f;
+        dst[4 * i + 0] = ((src[i] >>  0) & 0xFF) * scale;
+        dst[4 * i + 1] = ((src[i] >>  8) & 0xFF) * scale;
+        dst[4 * i + 2] = ((src[i] >> 16) & 0xFF) * scale;
+        dst[4 * i + 3] = a;
+    }
+}
+
+void convolveRowScalar(float *dst, const float *src, const int *starts, const float *weights, int taps, int count) {
+    for (int i = 0; i < count; i++) {
+        const float *s = src + 4 * starts[i];
+        const float *w = weights + i * taps;
+        float sum[4] = {0, 0, 0, 0};
+        for (int k = 0; k < taps; k++) {
+            for (int c = 0; c < 4; c++) {
+                sum[c] += w[k] * s[4 * k + c];
+            }
+        }
+        for (int c = 0; c < 4; c++) {
+            dst[4 * i + c] = sum[c];
+        }
+    }
+}
+
+void accumulateRowScalar(float *dst, const float *src, float weight, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] += weight * src[i];
+    }
+}
+
+inline uint32_t clampChannel(float v) {
+    int c = (int) std::lround(v);
+    return std::min(std::max(c, 0), 255);
+}
+
+void unpremultiplyRowScalar(uint32_t *dst, const float *src, int count) {
+    for (int i = 0; i < count; i++) {
+        const float *s = src + 4 * i;
+        uint32_t a = clampChannel(s[3]);
+        if (a == 0) {
+            dst[i] = 0;
+            continue;
+        }
+        float scale = 255.0f / s[3];
+        dst[i] = (a << 24)
+                | (clampChannel(s[2] * scale) << 16)
+                | (clampChannel(s[1] * scale) << 8)
+                | (clampChannel(s[0] * scale) << 0);
+    }
+}
+
+void gradientRowScalar(float *diff, float *smooth, const float *src, int count) {
+    for (int i = 0; i < count; i++) {
+        diff[i] = src[i + 2] - src[i];
+        smooth[i] = (src[i] + src[i + 2]) + 2 * src[i + 1];
+    }
+}
+
+void shadeRowScalar(float *shade, const float *diffAbove, const float *diff, const float *diffBelow,
+                    const float *smoothAbove, const float *smoothBelow, const ShadeLight &light, int count)
+{
+    for (int i = 0; i < count; i++) {
+        float dx = ((diffAbove[i] + diffBelow[i]) + 2 * diff[i]) * light.scaleX;
+        float dy = (smoothBelow[i] - smoothAbove[i]) * light.scaleY;
+        // the normal (-dx, -dy, 1) is only normalized here
+        float lit = (light.z - light.x * dx) - light.y * dy;
+        float len = std::sqrt((1 + dx * dx) + dy * dy);
+        shade[i] = std::max(lit / len, 0.0f);
+    }
+}
+
+void affineRowScalar(uint32_t *dst, const uint32_t *src, int width, int height, int32_t u, int32_t v, int32_t du, int32_t dv, int count) {
+    for (int i = 0; i < count; i++, u += du, v += dv) {
+        uint32_t quad[4];
+        fetchQuad(src, width, height, u, v, quad);
+        int fx = affineWeight(u);
+        int fy = affineWeight(v);
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int tl = (quad[0] >> shift) & 0xFF, tr = (quad[1] >> shift) & 0xFF;
+            int bl = (quad[2] >> shift) & 0xFF, br = (quad[3] >> shift) & 0xFF;
+            int top = tl + (((tr - tl) * fx) >> AFFINE_WEIGHT_BITS);
+            int bottom = bl + (((br - bl) * fx) >> AFFINE_WEIGHT_BITS);
+            out |= (uint32_t) (top + (((bottom - top) * fy) >> AFFINE_WEIGHT_BITS)) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+void coverageRowScalar(uint8_t *coverage, float *area, int count) {
+    float sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += area[i];
+        area[i] = 0;
+        coverage[i] = (uint8_t) (int) (std::min(std::abs(sum), 1.0f) * 255 + 0.5f);
+    }
+}
+
+#ifdef AVITAB_KERNELS_X86
+
+inline __m128 channelSSE2(__m128i px, int shift) {
+    __m128i ch = _mm_and_si128(_mm_srl_epi32(px, _mm_cvtsi32_si128(shift)), _mm_set1_epi32(0xFF));
+    return _mm_div_ps(_mm_cvtepi32_ps(ch), _mm_set1_ps(255.0f));
+}
+
+inline __m128i packChannelSSE2(__m128 val, int shift) {
+    __m128i ch = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(val, _mm_set1_ps(255.0f))), _mm_set1_epi32(0xFF));
+    return _mm_sll_epi32(ch, _mm_cvtsi32_si128(shift));
+}
+
+inline __m128i blendSSE2(__m128i back, __m128i fore) {
+    __m128 ba = channelSSE2(back, 24), br = channelSSE2(back, 16), bg = channelSSE2(back, 8), bb = channelSSE2(back, 0);
+    __m128 fa = channelSSE2(fore, 24), fr = channelSSE2(fore, 16), fg = channelSSE2(fore, 8), fb = channelSSE2(fore, 0);
+
+    __m128 inv = _mm_sub_ps(_mm_set1_ps(1.0f), fa);
+    __m128 a = _mm_add_ps(fa, _mm_mul_ps(ba, inv));
+    __m128 r = _mm_div_ps(_mm_add_ps(_mm_mul_ps(fr, fa), _mm_mul_ps(_mm_mul_ps(br, ba), inv)), a);
+    __m128 g = _mm_div_ps(_mm_add_ps(_mm_mul_ps(fg, fa), _mm_mul_ps(_mm_mul_ps(bg, ba), inv)), a);
+    __m128 b = _mm_div_ps(_mm_add_ps(_mm_mul_ps(fb, fa), _mm_mul_ps(_mm_mul_ps(bb, ba), inv)), a);
+
+    return _mm_or_si128(_mm_or_si128(packChannelSSE2(a, 24), packChannelSSE2(r, 16)),
+                        _mm_or_si128(packChannelSSE2(g, 8), packChannelSSE2(b, 0)));
+}
+
+void blendRowSSE2(uint32_t *dst, const uint32_t *src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i fore = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i transparent = _mm_cmpeq_epi32(_mm_srli_epi32(fore, 24), _mm_setzero_si128());
+        if (_mm_movemask_epi8(transparent) == 0xFFFF) {
+            continue;
+        }
+        __m128i back = _mm_loadu_si128((const __m128i *) (dst + i));
+        __m128i res = blendSSE2(back, fore);
+        res = _mm_or_si128(_mm_and_si128(transparent, back), _mm_andnot_si128(transparent, res));
+        _mm_storeu_si128((__m128i *) (dst + i), res);
+    }
+    blendRowScalar(dst + i, src + i, count - i);
+}
+
+void blendRowOntoSSE2(uint32_t *pixels, uint32_t background, int count) {
+    __m128i back = _mm_set1_epi32(background);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i fore = _mm_loadu_si128((const __m128i *) (pixels + i));
+        _mm_storeu_si128((__m128i *) (pixels + i), blendSSE2(back, fore));
+    }
+    blendRowOntoScalar(pixels + i, background, count - i);
+}
+
+void reverseRowSSE2(uint32_t *dst, const uint32_t *src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + count - 4 - i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    reverseRowScalar(dst + i, src, count - i);
+}
+
+void rgbaToArgbRowSSE2(uint32_t *dst, const uint8_t *src, int count) {
+    // the bytes are little endian ABGR words, so only R and B change places
+    const __m128i keep = _mm_set1_epi32(0xFF00FF00);
+    const __m128i low = _mm_set1_epi32(0x000000FF);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + 4 * i));
+        __m128i swapped = _mm_or_si128(_mm_and_si128(v, keep),
+                _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, low), 16), _mm_and_si128(_mm_srli_epi32(v, 16), low)));
+        _mm_storeu_si128((__m128i *) (dst + i), swapped);
+    }
+    rgbaToArgbRowScalar(dst + i, src + 4 * i, count - i);
+}
+
+void transposeRectSSE2(uint32_t *dst, ptrdiff_t dstStride, const uint32_t *src, ptrdiff_t srcStride, int width, int height) {
+    int fullWidth = width & ~3;
+    int fullHeight = height & ~3;
+
+    for (int y = 0; y < fullHeight; y += 4) {
+        for (int x = 0; x < fullWidth; x += 4) {
+            const uint32_t *s = src + x * srcStride + y;
+            __m128i r0 = _mm_loadu_si128((const __m128i *) s);
+            __m128i r1 = _mm_loadu_si128((const __m128i *) (s + srcStride));
+            __m128i r2 = _mm_loadu_si128((const __m128i *) (s + 2 * srcStride));
+            __m128i r3 = _mm_loadu_si128((const __m128i *) (s + 3 * srcStride));
+
+            __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+            uint32_t *d = dst + y * dstStride + x;
+            _mm_storeu_si128((__m128i *) d, _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) (d + dstStride), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) (d + 2 * dstStride), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i *) (d + 3 * dstStride), _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+
+    // right edge of the full rows, then the remaining rows
+    transposeRectScalar(dst + fullWidth, dstStride, src + fullWidth * srcStride, srcStride, width - fullWidth, fullHeight);
+    transposeRectScalar(dst + fullHeight * dstStride, dstStride, src + fullHeight, srcStride, width, height - fullHeight);
+}
+
+void premultiplyRowSSE2(float *dst, const uint32_t *src, int count) {
+    const __m128 alphaLane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (int i = 0; i < count; i++) {
+        __m128i px = _mm_cvtsi32_si128(src[i]);
+        px = _mm_unpacklo_epi16(_mm_unpacklo_epi8(px, _mm_setzero_si128()), _mm_setzero_si128());
+        __m128 v = _mm_cvtepi32_ps(px);
+        __m128 scale = _mm_div_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), _mm_set1_ps(255.0f));
+        // keep the alpha lane as it is
+        scale = _mm_or_ps(_mm_and_ps(alphaLane, one), _mm_andnot_ps(alphaLane, scale));
+        _mm_storeu_ps(dst + 4 * i, _mm_mul_ps(v, scale));
+    }
+}
+
+void convolveRowSSE2(float *dst, const float *src, const int *starts, const float *weights, int taps, int count) {
+    for (int i = 0; i < count; i++) {
+        const float *s = src + 4 * starts[i];
+        const float *w = weights + i * taps;
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < taps; k++) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + 4 * k)));
+        }
+        _mm_storeu_ps(dst + 4 * i, sum);
+    }
+}
+
+void accumulateRowSSE2(float *dst, const float *src, float weight, int count) {
+    __m128 w = _mm_set1_ps(weight);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+    }
+    accumulateRowScalar(dst + i, src + i, weight, count - i);
+}
+
+void unpremultiplyRowSSE2(uint32_t *dst, const float *src, int count) {
+    const __m128 alphaLane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (int i = 0; i < count; i++) {
+        __m128 v = _mm_loadu_ps(src + 4 * i);
+        __m128 alpha = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+        if (_mm_cvtss_f32(alpha) < 0.5f) {
+            dst[i] = 0;
+            continue;
+        }
+        __m128 scale = _mm_div_ps(_mm_set1_ps(255.0f), alpha);
+        scale = _mm_or_ps(_mm_and_ps(alphaLane, one), _mm_andnot_ps(alphaLane, scale));
+        // the saturating packs clamp overshooting filters to 0..255
+        __m128i c = _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+        c = _mm_packs_epi32(c, c);
+        c = _mm_packus_epi16(c, c);
+        dst[i] = _mm_cvtsi128_si32(c);
+    }
+}
+
+void gradientRowSSE2(float *diff, float *smooth, const float *src, int count) {
+    const __m128 two = _mm_set1_ps(2.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 left = _mm_loadu_ps(src + i);
+        __m128 mid = _mm_loadu_ps(src + i + 1);
+        __m128 right = _mm_loadu_ps(src + i + 2);
+        _mm_storeu_ps(diff + i, _mm_sub_ps(right, left));
+        _mm_storeu_ps(smooth + i, _mm_add_ps(_mm_add_ps(left, right), _mm_mul_ps(two, mid)));
+    }
+    gradientRowScalar(diff + i, smooth + i, src + i, count - i);
+}
+
+void shadeRowSSE2(float *shade, const float *diffAbove, const float *diff, const float *diffBelow,
+                  const float *smoothAbove, const float *smoothBelow, const ShadeLight &light, int count)
+{
+    const __m128 two = _mm_set1_ps(2.0f), one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+    const __m128 lx = _mm_set1_ps(light.x), ly = _mm_set1_ps(light.y), lz = _mm_set1_ps(light.z);
+    const __m128 sx = _mm_set1_ps(light.scaleX), sy = _mm_set1_ps(light.scaleY);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(diffAbove + i), _mm_loadu_ps(diffBelow + i)), _mm_mul_ps(two, _mm_loadu_ps(diff + i)));
+        __m128 dx = _mm_mul_ps(sum, sx);
+        __m128 dy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(smoothBelow + i), _mm_loadu_ps(smoothAbove + i)), sy);
+        __m128 lit = _mm_sub_ps(_mm_sub_ps(lz, _mm_mul_ps(lx, dx)), _mm_mul_ps(ly, dy));
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(one, _mm_mul_ps(dx, dx)), _mm_mul_ps(dy, dy)));
+        _mm_storeu_ps(shade + i, _mm_max_ps(_mm_div_ps(lit, len), zero));
+    }
+    shadeRowScalar(shade + i, diffAbove + i, diff + i, diffBelow + i, smoothAbove + i, smoothBelow + i, light, count - i);
+}
+
+void affineRowSSE2(uint32_t *dst, const uint32_t *src, int width, int height, int32_t u, int32_t v, int32_t du, int32_t dv, int count) {
+    // two pixels per step with their four channels in 16 bit lanes
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        uint32_t a[4], b[4];
+        fetchQuad(src, width, height, u, v, a);
+        fetchQuad(src, width, height, u + du, v + dv, b);
+        short fxA = affineWeight(u), fyA = affineWeight(v);
+        short fxB = affineWeight(u + du), fyB = affineWeight(v + dv);
+
+        __m128i tl = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, b[0], a[0]), zero);
+        __m128i tr = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, b[1], a[1]), zero);
+        __m128i bl = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, b[2], a[2]), zero);
+        __m128i br = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, b[3], a[3]), zero);
+        __m128i fx = _mm_set_epi16(fxB, fxB, fxB, fxB, fxA, fxA, fxA, fxA);
+        __m128i fy = _mm_set_epi16(fyB, fyB, fyB, fyB, fyA, fyA, fyA, fyA);
+
+        __m128i top = _mm_add_epi16(tl, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(tr, tl), fx), AFFINE_WEIGHT_BITS));
+        __m128i bottom = _mm_add_epi16(bl, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(br, bl), fx), AFFINE_WEIGHT_BITS));
+        __m128i out = _mm_add_epi16(top, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bottom, top), fy), AFFINE_WEIGHT_BITS));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(out, out));
+
+        u += 2 * du;
+        v += 2 * dv;
+    }
+    affineRowScalar(dst + i, src, width, height, u, v, du, dv, count - i);
+}
+
+void coverageRowSSE2(uint8_t *coverage, float *area, int count) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    __m128 carry = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // prefix sum of the 4 lanes in two shifted additions, plus the sum so far
+        __m128 x = _mm_loadu_ps(area + i);
+        x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+        x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+        x = _mm_add_ps(x, carry);
+        carry = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_storeu_ps(area + i, _mm_setzero_ps());
+
+        __m128 c = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_and_ps(x, absMask), one), scale), half);
+        __m128i n = _mm_cvttps_epi32(c);
+        n = _mm_packs_epi32(n, n);
+        int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(n, n));
+        std::memcpy(coverage + i, &bytes, sizeof(bytes));
+    }
+    if (i < count) {
+        area[i] += _mm_cvtss_f32(carry);
+        coverageRowScalar(coverage + i, area + i, count - i);
+    }
+}
+
+#define AVITAB_AVX2 __attribute__((target("avx2")))
+
+AVITAB_AVX2 inline __m256 channelAVX2(__m256i px, int shift) {
+    __m256i ch = _mm256_and_si256(_mm256_srl_epi32(px, _mm_cvtsi32_si128(shift)), _mm256_set1_epi32(0xFF));
+    return _mm256_div_ps(_mm256_cvtepi32_ps(ch), _mm256_set1_ps(255.0f));
+}
+
+AVITAB_AVX2 inline __m256i packChannelAVX2(__m256 val, int shift) {
+    __m256i ch = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(val, _mm256_set1_ps(255.0f))), _mm256_set1_epi32(0xFF));
+    return _mm256_sll_epi32(ch, _mm_cvtsi32_si128(shift));
+}
+
+AVITAB_AVX2 inline __m256i blendAVX2(__m256i back, __m256i fore) {
+    __m256 ba = channelAVX2(back, 24), br = channelAVX2(back, 16), bg = channelAVX2(back, 8), bb = channelAVX2(back, 0);
+    __m256 fa = channelAVX2(fore, 24), fr = channelAVX2(fore, 16), fg = channelAVX2(fore, 8), fb = channelAVX2(fore, 0);
+
+    __m256 inv = _mm256_sub_ps(_mm256_set1_ps(1.0f), fa);
+    __m256 a = _mm256_add_ps(fa, _mm256_mul_ps(ba, inv));
+    __m256 r = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(fr, fa), _mm256_mul_ps(_mm256_mul_ps(br, ba), inv)), a);
+    __m256 g = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(fg, fa), _mm256_mul_ps(_mm256_mul_ps(bg, ba), inv)), a);
+    __m256 b = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(fb, fa), _mm256_mul_ps(_mm256_mul_ps(bb, ba), inv)), a);
+
+    return _mm256_or_si256(_mm256_or_si256(packChannelAVX2(a, 24), packChannelAVX2(r, 16)),
+                           _mm256_or_si256(packChannelAVX2(g, 8), packChannelAVX2(b, 0)));
+}
+
+AVITAB_AVX2 void blendRowAVX2(uint32_t *dst, const uint32_t *src, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i fore = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i transparent = _mm256_cmpeq_epi32(_mm256_srli_epi32(fore, 24), _mm256_setzero_si256());
+        if (_mm256_movemask_epi8(transparent) == -1) {
+            continue;
+        }
+        __m256i back = _mm256_loadu_si256((const __m256i *) (dst + i));
+        __m256i res = _mm256_blendv_epi8(blendAVX2(back, fore), back, transparent);
+        _mm256_storeu_si256((__m256i *) (dst + i), res);
+    }
+    blendRowSSE2(dst + i, src + i, count - i);
+}
+
+AVITAB_AVX2 void blendRowOntoAVX2(uint32_t *pixels, uint32_t background, int count) {
+    __m256i back = _mm256_set1_epi32(background);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i fore = _mm256_loadu_si256((const __m256i *) (pixels + i));
+        _mm256_storeu_si256((__m256i *) (pixels + i), blendAVX2(back, fore));
+    }
+    blendRowOntoSSE2(pixels + i, background, count - i);
+}
+
+AVITAB_AVX2 void reverseRowAVX2(uint32_t *dst, const uint32_t *src, int count) {
+    const __m256i order = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + count - 8 - i));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_permutevar8x32_epi32(v, order));
+    }
+    reverseRowSSE2(dst + i, src, count - i);
+}
+
+AVITAB_AVX2 void mapColorsRowAVX2(uint32_t *pixels, const ColorLUT &lut, int count) {
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const __m256i alphaMask = _mm256_set1_epi32(0xFF000000);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i *) (pixels + i));
+        __m256i r = _mm256_i32gather_epi32((const int *) lut.red, _mm256_and_si256(_mm256_srli_epi32(c, 16), mask), 4);
+        __m256i g = _mm256_i32gather_epi32((const int *) lut.green, _mm256_and_si256(_mm256_srli_epi32(c, 8), mask), 4);
+        __m256i b = _mm256_i32gather_epi32((const int *) lut.blue, _mm256_and_si256(c, mask), 4);
+        __m256i res = _mm256_or_si256(_mm256_and_si256(c, alphaMask), _mm256_or_si256(r, _mm256_or_si256(g, b)));
+        _mm256_storeu_si256((__m256i *) (pixels + i), res);
+    }
+    mapColorsRowScalar(pixels + i, lut, count - i);
+}
+
+AVITAB_AVX2 void accumulateRowAVX2(float *dst, const float *src, float weight, int count) {
+    __m256 w = _mm256_set1_ps(weight);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 acc = _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(w, _mm256_loadu_ps(src + i)));
+        _mm256_storeu_ps(dst + i, acc);
+    }
+    accumulateRowSSE2(dst + i, src + i, weight, count - i);
+}
+
+#endif /* AVITAB_KERNELS_X86 */
+
+#ifdef AVITAB_KERNELS_NEON
+
+inline float32x4_t channelNEON(uint32x4_t px, int shift) {
+    uint32x4_t ch = vandq_u32(vshlq_u32(px, vdupq_n_s32(-shift)), vdupq_n_u32(0xFF));
+    return vdivq_f32(vcvtq_f32_u32(ch), vdupq_n_f32(255.0f));
+}
+
+inline uint32x4_t packChannelNEON(float32x4_t val, int shift) {
+    // signed conversion to match the scalar code for NaN / out of range values
+    uint32x4_t ch = vreinterpretq_u32_s32(vcvtq_s32_f32(vmulq_f32(val, vdupq_n_f32(255.0f))));
+    return vshlq_u32(vandq_u32(ch, vdupq_n_u32(0xFF)), vdupq_n_s32(shift));
+}
+
+inline uint32x4_t blendNEON(uint32x4_t back, uint32x4_t fore) {
+    float32x4_t ba = channelNEON(back, 24), br = channelNEON(back, 16), bg = channelNEON(back, 8), bb = channelNEON(back, 0);
+    float32x4_t fa = channelNEON(fore, 24), fr = channelNEON(fore, 16), fg = channelNEON(fore, 8), fb = channelNEON(fore, 0);
+
+    // no fused multiply-add so the rounding matches the scalar code
+    float32x4_t inv = vsubq_f32(vdupq_n_f32(1.0f), fa);
+    float32x4_t a = vaddq_f32(fa, vmulq_f32(ba, inv));
+    float32x4_t r = vdivq_f32(vaddq_f32(vmulq_f32(fr, fa), vmulq_f32(vmulq_f32(br, ba), inv)), a);
+    float32x4_t g = vdivq_f32(vaddq_f32(vmulq_f32(fg, fa), vmulq_f32(vmulq_f32(bg, ba), inv)), a);
+    float32x4_t b = vdivq_f32(vaddq_f32(vmulq_f32(fb, fa), vmulq_f32(vmulq_f32(bb, ba), inv)), a);
+
+    return vorrq_u32(vorrq_u32(packChannelNEON(a, 24), packChannelNEON(r, 16)),
+                     vorrq_u32(packChannelNEON(g, 8), packChannelNEON(b, 0)));
+}
+
+void blendRowNEON(uint32_t *dst, const uint32_t *src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t fore = vld1q_u32(src + i);
+        uint32x4_t transparent = vceqq_u32(vshrq_n_u32(fore, 24), vdupq_n_u32(0));
+        if (vminvq_u32(transparent) == 0xFFFFFFFF) {
+            continue;
+        }
+        uint32x4_t back = vld1q_u32(dst + i);
+        vst1q_u32(dst + i, vbslq_u32(transparent, back, blendNEON(back, fore)));
+    }
+    blendRowScalar(dst + i, src + i, count - i);
+}
+
+void blendRowOntoNEON(uint32_t *pixels, uint32_t background, int count) {
+    uint32x4_t back = vdupq_n_u32(background);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(pixels + i, blendNEON(back, vld1q_u32(pixels + i)));
+    }
+    blendRowOntoScalar(pixels + i, background, count - i);
+}
+
+void reverseRowNEON(uint32_t *dst, const uint32_t *src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t v = vrev64q_u32(vld1q_u32(src + count - 4 - i));
+        vst1q_u32(dst + i, vextq_u32(v, v, 2));
+    }
+    reverseRowScalar(dst + i, src, count - i);
+}
+
+void rgbaToArgbRowNEON(uint32_t *dst, const uint8_t *src, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t px = vld4q_u8(src + 4 * i);
+        uint8x16_t red = px.val[0];
+        px.val[0] = px.val[2];
+        px.val[2] = red;
+        vst4q_u8(reinterpret_cast<uint8_t *>(dst + i), px);
+    }
+    rgbaToArgbRowScalar(dst + i, src + 4 * i, count - i);
+}
+
+void transposeRectNEON(uint32_t *dst, ptrdiff_t dstStride, const uint32_t *src, ptrdiff_t srcStride, int width, int height) {
+    int fullWidth = width & ~3;
+    int fullHeight = height & ~3;
+
+    for (int y = 0; y < fullHeight; y += 4) {
+        for (int x = 0; x < fullWidth; x += 4) {
+            const uint32_t *s = src + x * srcStride + y;
+            uint32x4x2_t t01 = vtrnq_u32(vld1q_u32(s), vld1q_u32(s + srcStride));
+            uint32x4x2_t t23 = vtrnq_u32(vld1q_u32(s + 2 * srcStride), vld1q_u32(s + 3 * srcStride));
+
+            uint32_t *d = dst + y * dstStride + x;
+            vst1q_u32(d, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+            vst1q_u32(d + dstStride, vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+            vst1q_u32(d + 2 * dstStride, vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+            vst1q_u32(d + 3 * dstStride, vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+        }
+    }
+
+    transposeRectScalar(dst + fullWidth, dstStride, src + fullWidth * srcStride, srcStride, width - fullWidth, fullHeight);
+    transposeRectScalar(dst + fullHeight * dstStride, dstStride, src + fullHeight, srcStride, width, height - fullHeight);
+}
+
+void premultiplyRowNEON(float *dst, const uint32_t *src, int count) {
+    const uint32x4_t alphaLane = {0, 0, 0, 0xFFFFFFFF};
+    for (int i = 0; i < count; i++) {
+        uint8x8_t bytes = vreinterpret_u8_u32(vdup_n_u32(src[i]));
+        float32x4_t v = vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(bytes))));
+        float32x4_t scale = vdivq_f32(vdupq_laneq_f32(v, 3), vdupq_n_f32(255.0f));
+        scale = vbslq_f32(alphaLane, vdupq_n_f32(1.0f), scale);
+        vst1q_f32(dst + 4 * i, vmulq_f32(v, scale));
+    }
+}
+
+void convolveRowNEON(float *dst, const float *src, const int *starts, const float *weights, int taps, int count) {
+    for (int i = 0; i < count; i++) {
+        const float *s = src + 4 * starts[i];
+        const float *w = weights + i * taps;
+        float32x4_t sum = vdupq_n_f32(0);
+        for (int k = 0; k < taps; k++) {
+            sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(s + 4 * k), w[k]));
+        }
+        vst1q_f32(dst + 4 * i, sum);
+    }
+}
+
+void accumulateRowNEON(float *dst, const float *src, float weight, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_n_f32(vld1q_f32(src + i), weight)));
+    }
+    accumulateRowScalar(dst + i, src + i, weight, count - i);
+}
+
+void unpremultiplyRowNEON(uint32_t *dst, const float *src, int count) {
+    const uint32x4_t alphaLane = {0, 0, 0, 0xFFFFFFFF};
+    for (int i = 0; i < count; i++) {
+        float32x4_t v = vld1q_f32(src + 4 * i);
+        float alpha = vgetq_lane_f32(v, 3);
+        if (alpha < 0.5f) {
+            dst[i] = 0;
+            continue;
+        }
+        float32x4_t scale = vbslq_f32(alphaLane, vdupq_n_f32(1.0f), vdupq_n_f32(255.0f / alpha));
+        // the saturating narrows clamp overshooting filters to 0..255
+        int32x4_t c = vcvtnq_s32_f32(vmulq_f32(v, scale));
+        uint8x8_t bytes = vqmovun_s16(vcombine_s16(vqmovn_s32(c), vqmovn_s32(c)));
+        dst[i] = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+    }
+}
+
+void gradientRowNEON(float *diff, float *smooth, const float *src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t left = vld1q_f32(src + i);
+        float32x4_t mid = vld1q_f32(src + i + 1);
+        float32x4_t right = vld1q_f32(src + i + 2);
+        vst1q_f32(diff + i, vsubq_f32(right, left));
+        vst1q_f32(smooth + i, vaddq_f32(vaddq_f32(left, right), vmulq_n_f32(mid, 2.0f)));
+    }
+    gradientRowScalar(diff + i, smooth + i, src + i, count - i);
+}
+
+void shadeRowNEON(float *shade, const float *diffAbove, const float *diff, const float *diffBelow,
+                  const float *smoothAbove, const float *smoothBelow, const ShadeLight &light, int count)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f), zero = vdupq_n_f32(0.0f), lz = vdupq_n_f32(light.z);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t sum = vaddq_f32(vaddq_f32(vld1q_f32(diffAbove + i), vld1q_f32(diffBelow + i)), vmulq_n_f32(vld1q_f32(diff + i), 2.0f));
+        float32x4_t dx = vmulq_n_f32(sum, light.scaleX);
+        float32x4_t dy = vmulq_n_f32(vsubq_f32(vld1q_f32(smoothBelow + i), vld1q_f32(smoothAbove + i)), light.scaleY);
+        float32x4_t lit = vsubq_f32(vsubq_f32(lz, vmulq_n_f32(dx, light.x)), vmulq_n_f32(dy, light.y));
+        float32x4_t len = vsqrtq_f32(vaddq_f32(vaddq_f32(one, vmulq_f32(dx, dx)), vmulq_f32(dy, dy)));
+        vst1q_f32(shade + i, vmaxq_f32(vdivq_f32(lit, len), zero));
+    }
+    shadeRowScalar(shade + i, diffAbove + i, diff + i, diffBelow + i, smoothAbove + i, smoothBelow + i, light, count - i);
+}
+
+void affineRowNEON(uint32_t *dst, const uint32_t *src, int width, int height, int32_t u, int32_t v, int32_t du, int32_t dv, int count) {
+    auto widen = [] (uint32_t p, uint32_t q) {
+        uint32x2_t pair = {p, q};
+        return vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(pair)));
+    };
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        uint32_t a[4], b[4];
+        fetchQuad(src, width, height, u, v, a);
+        fetchQuad(src, width, height, u + du, v + dv, b);
+        int16x8_t fx = vcombine_s16(vdup_n_s16(affineWeight(u)), vdup_n_s16(affineWeight(u + du)));
+        int16x8_t fy = vcombine_s16(vdup_n_s16(affineWeight(v)), vdup_n_s16(affineWeight(v + dv)));
+
+        int16x8_t tl = widen(a[0], b[0]), tr = widen(a[1], b[1]);
+        int16x8_t bl = widen(a[2], b[2]), br = widen(a[3], b[3]);
+
+        int16x8_t top = vaddq_s16(tl, vshrq_n_s16(vmulq_s16(vsubq_s16(tr, tl), fx), AFFINE_WEIGHT_BITS));
+        int16x8_t bottom = vaddq_s16(bl, vshrq_n_s16(vmulq_s16(vsubq_s16(br, bl), fx), AFFINE_WEIGHT_BITS));
+        int16x8_t out = vaddq_s16(top, vshrq_n_s16(vmulq_s16(vsubq_s16(bottom, top), fy), AFFINE_WEIGHT_BITS));
+        vst1_u32(dst + i, vreinterpret_u32_u8(vqmovun_s16(out)));
+
+        u += 2 * du;
+        v += 2 * dv;
+    }
+    affineRowScalar(dst + i, src, width, height, u, v, du, dv, count - i);
+}
+
+void coverageRowNEON(uint8_t *coverage, float *area, int count) {
+    const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f), half = vdupq_n_f32(0.5f);
+    float32x4_t carry = zero;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(area + i);
+        x = vaddq_f32(x, vextq_f32(zero, x, 3));
+        x = vaddq_f32(x, vextq_f32(zero, x, 2));
+        x = vaddq_f32(x, carry);
+        carry = vdupq_n_f32(vgetq_lane_f32(x, 3));
+        vst1q_f32(area + i, zero);
+
+        float32x4_t c = vaddq_f32(vmulq_n_f32(vminq_f32(vabsq_f32(x), one), 255.0f), half);
+        uint16x4_t n = vmovn_u32(vcvtq_u32_f32(c));
+        uint32_t bytes = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(n, n))), 0);
+        std::memcpy(coverage + i, &bytes, sizeof(bytes));
+    }
+    if (i < count) {
+        area[i] += vgetq_lane_f32(carry, 0);
+        coverageRowScalar(coverage + i, area + i, count - i);
+    }
+}
+
+#endif /* AVITAB_KERNELS_NEON */
+
+Kernels selectKernels() {
+#if defined(AVITAB_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"AVX2", blendRowAVX2, blendRowOntoAVX2, reverseRowAVX2, transposeRectSSE2, rgbaToArgbRowSSE2, mapColorsRowAVX2,
+                premultiplyRowSSE2, convolveRowSSE2, accumulateRowAVX2, unpremultiplyRowSSE2, gradientRowSSE2, shadeRowSSE2, affineRowSSE2, coverageRowSSE2};
+    }
+    return {"SSE2", blendRowSSE2, blendRowOntoSSE2, reverseRowSSE2, transposeRectSSE2, rgbaToArgbRowSSE2, mapColorsRowScalar,
+            premultiplyRowSSE2, convolveRowSSE2, accumulateRowSSE2, unpremultiplyRowSSE2, gradientRowSSE2, shadeRowSSE2, affineRowSSE2, coverageRowSSE2};
+#elif defined(AVITAB_KERNELS_NEON)
+    return {"NEON", blendRowNEON, blendRowOntoNEON, reverseRowNEON, transposeRectNEON, rgbaToArgbRowNEON, mapColorsRowScalar,
+            premultiplyRowNEON, convolveRowNEON, accumulateRowNEON, unpremultiplyRowNEON, gradientRowNEON, shadeRowNEON, affineRowNEON, coverageRowNEON};
+#else
+    return {"scalar", blendRowScalar, blendRowOntoScalar, reverseRowScalar, transposeRectScalar, rgbaToArgbRowScalar, mapColorsRowScalar,
+            premultiplyRowScalar, convolveRowScalar, accumulateRowScalar, unpremultiplyRowScalar, gradientRowScalar, shadeRowScalar, affineRowScalar, coverageRowScalar};
+#endif
+}
+
+const Kernels &kernels() {
+    static const Kernels selected = [] {
+        Kernels k = selectKernels();
+        logger::verbose("Using %s pixel kernels", k.name);
+        return k;
+    }();
+    return selected;
+}
+
+} // namespace
+
+uint32_t blendColors(uint32_t back, uint32_t fore) {
+    // background
+    float ba = (int) ((back >> 24) & 0xFF) / 255.0f;
+    float br = (int) ((back >> 16) & 0xFF) / 255.0f;
+    float bg = (int) ((back >>  8) & 0xFF) / 255.0f;
+    float bb = (int) ((back >>  0) & 0xFF) / 255.0f;
+
+    // foreground
+    float fa = (int) ((fore >> 24) & 0xFF) / 255.0f;
+    float fr = (int) ((fore >> 16) & 0xFF) / 255.0f;
+    float fg = (int) ((fore >>  8) & 0xFF) / 255.0f;
+    float fb = (int) ((fore >>  0) & 0xFF) / 255.0f;
+
+    float inv = 1 - fa;
+    float a = fa + ba * inv;
+    float r = (fr * fa + br * ba * inv) / a;
+    float g = (fg * fa + bg * ba * inv) / a;
+    float b = (fb * fa + bb * ba * inv) / a;
+
+    // only fully transparent on both sides gives a NaN, which ends up as 0 like in the vector code
+    return (((uint32_t) (int) (a * 255) & 0xFF) << 24)
+            | (((uint32_t) (int) (r * 255) & 0xFF) << 16)
+            | (((uint32_t) (int) (g * 255) & 0xFF) << 8)
+            | (((uint32_t) (int) (b * 255) & 0xFF) << 0);
+}
+
+void blendRow(uint32_t *dst, const uint32_t *src, int count) {
+    if (count > 0) {
+        kernels().blendRow(dst, src, count);
+    }
+}
+
+void blendRowMode(uint32_t *dst, const uint32_t *src, int count, BlendMode mode, float opacity) {
+    if (mode == BlendMode::NORMAL && opacity >= 1) {
+        blendRow(dst, src, count);
+        return;
+    }
+
+    opacity = std::max(0.0f, std::min(opacity, 1.0f));
+    for (int i = 0; i < count; i++) {
+        uint32_t back = dst[i];
+        uint32_t fore = src[i];
+        float fa = (int) ((fore >> 24) & 0xFF) / 255.0f * opacity;
+        if (fa <= 0) {
+            continue;
+        }
+        float ba = (int) ((back >> 24) & 0xFF) / 255.0f;
+
+        uint32_t color = 0;
+        for (int shift = 0; shift <= 16; shift += 8) {
+            float f = (int) ((fore >> shift) & 0xFF) / 255.0f;
+            float b = (int) ((back >> shift) & 0xFF) / 255.0f;
+            float mixed = f;
+            if (mode == BlendMode::MULTIPLY) {
+                mixed = f * b;
+            } else if (mode == BlendMode::SCREEN) {
+                mixed = f + b - f * b;
+            }
+            // the mode only applies where there is a background to combine with
+            float c = (1 - ba) * f + ba * mixed;
+            color |= ((uint32_t) (int) (c * 255) & 0xFF) << shift;
+        }
+
+        dst[i] = blendColors(back, (color & 0x00FFFFFF) | ((uint32_t) (int) (fa * 255) << 24));
+    }
+}
+
+void blendRowOnto(uint32_t *pixels, uint32_t background, int count) {
+    if (count > 0) {
+        kernels().blendRowOnto(pixels, background, count);
+    }
+}
+
+void reverseRow(uint32_t *dst, const uint32_t *src, int count) {
+    if (count > 0) {
+        kernels().reverseRow(dst, src, count);
+    }
+}
+
+void transposeRect(uint32_t *dst, ptrdiff_t dstStride, const uint32_t *src, ptrdiff_t srcStride, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    auto transpose = kernels().transposeRect;
+
+    if (!isConflictStride(srcStride) && !isConflictStride(dstStride)) {
+        // the vector kernels move strips of 4 rows, their source lines stay in L2
+        transpose(dst, dstStride, src, srcStride, width, height);
+        return;
+    }
+
+    // All rows of the strip map to the same few cache sets, so walk the
+    // target in square blocks that only keep 2 x 32 rows alive at a time.
+    for (int y = 0; y < height; y += TRANSPOSE_BLOCK) {
+        int blockHeight = std::min(TRANSPOSE_BLOCK, height - y);
+        for (int x = 0; x < width; x += TRANSPOSE_BLOCK) {
+            int blockWidth = std::min(TRANSPOSE_BLOCK, width - x);
+            transpose(dst + y * dstStride + x, dstStride, src + x * srcStride + y, srcStride, blockWidth, blockHeight);
+        }
+    }
+}
+
+void rgbaToArgbRow(uint32_t *dst, const uint8_t *src, int count) {
+    if (count > 0) {
+        kernels().rgbaToArgbRow(dst, src, count);
+    }
+}
+
+void mapColorsRow(uint32_t *pixels, const ColorLUT &lut, int count) {
+    if (count > 0) {
+        kernels().mapColorsRow(pixels, lut, count);
+    }
+}
+
+void premultiplyRow(float *dst, const uint32_t *src, int count) {
+    if (count > 0) {
+        kernels().premultiplyRow(dst, src, count);
+    }
+}
+
+void convolveRow(float *dst, const float *src, const int *starts, const float *weights, int taps, int count) {
+    if (count > 0) {
+        kernels().convolveRow(dst, src, starts, weights, taps, count);
+    }
+}
+
+void accumulateRow(float *dst, const float *src, float weight, int count) {
+    if (count > 0) {
+        kernels().accumulateRow(dst, src, weight, count);
+    }
+}
+
+void unpremultiplyRow(uint32_t *dst, const float *src, int count) {
+    if (count > 0) {
+        kernels().unpremultiplyRow(dst, src, count);
+    }
+}
+
+void gradientRow(float *diff, float *smooth, const float *src, int count) {
+    if (count > 0) {
+        kernels().gradientRow(diff, smooth, src, count);
+    }
+}
+
+void shadeRow(float *shade, const float *diffAbove, const float *diff, const float *diffBelow,
+              const float *smoothAbove, const float *smoothBelow, const ShadeLight &light, int count)
+{
+    if (count > 0) {
+        kernels().shadeRow(shade, diffAbove, diff, diffBelow, smoothAbove, smoothBelow, light, count);
+    }
+}
+
+void affineRow(uint32_t *dst, const uint32_t *src, int width, int height, double u, double v, double du, double dv, int count) {
+    if (count > 0 && width > 0 && height > 0) {
+        kernels().affineRow(dst, src, width, height, std::lround(u * 65536), std::lround(v * 65536),
+                            std::lround(du * 65536), std::lround(dv * 65536), count);
+    }
+}
+
+void coverageRow(uint8_t *coverage, float *area, int count) {
+    if (count > 0) {
+        kernels().coverageRow(coverage, area, count);
+    }
+}
+
+const char *getPixelKernelName() {
+    return kernels().name;
+}
+
+} /* namespace img */
@@ -0,0 +1,102 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "ColorLUT.h"
+
+namespace img {
+
+// Row kernels for the per-pixel work of Image. They dispatch at runtime to
+// SSE2, AVX2 or NEON code and fall back to the scalar reference versions.
+
+// fore over back, both as non-premultiplied ARGB
+uint32_t blendColors(uint32_t back, uint32_t fore);
+
+// dst[i] = src[i] over dst[i], fully transparent source pixels are skipped
+void blendRow(uint32_t *dst, const uint32_t *src, int count);
+
+enum class BlendMode {
+    NORMAL,
+    MULTIPLY,
+    SCREEN,
+};
+
+// dst[i] = src[i] combined with dst[i] through mode, then composited over dst[i]
+// with the source alpha scaled by opacity. NORMAL at full opacity is blendRow,
+// the other combinations only have a scalar version.
+void blendRowMode(uint32_t *dst, const uint32_t *src, int count, BlendMode mode, float opacity);
+
+// pixels[i] = pixels[i] over background
+void blendRowOnto(uint32_t *pixels, uint32_t background, int count);
+
+// dst[i] = src[count - 1 - i], the buffers must not overlap
+void reverseRow(uint32_t *dst, const uint32_t *src, int count);
+
+// dst[y * dstStride + x] = src[x * srcStride + y] for a width x height target,
+// negative strides flip the respective axis
+void transposeRect(uint32_t *dst, ptrdiff_t dstStride, const uint32_t *src, ptrdiff_t srcStride, int width, int height);
+
+// R, G, B, A bytes as decoded by stb_image to ARGB
+void rgbaToArgbRow(uint32_t *dst, const uint8_t *src, int count);
+
+// maps the colour channels of each pixel through the table, keeping alpha
+void mapColorsRow(uint32_t *pixels, const ColorLUT &lut, int count);
+
+// Resampling works on premultiplied float pixels with 4 channels in memory
+// order B, G, R, A. dst receives 4 * count floats.
+void premultiplyRow(float *dst, const uint32_t *src, int count);
+
+// dst pixel i = sum of weights[i * taps + k] * src pixel (starts[i] + k)
+void convolveRow(float *dst, const float *src, const int *starts, const float *weights, int taps, int count);
+
+// dst[i] += weight * src[i] for count floats
+void accumulateRow(float *dst, const float *src, float weight, int count);
+
+// converts count premultiplied float pixels back to ARGB, clamping each channel
+void unpremultiplyRow(uint32_t *dst, const float *src, int count);
+
+// Hillshading with Horn's method, split into a horizontal and a vertical pass.
+// diff[i] = src[i + 2] - src[i] and smooth[i] = src[i] + 2 * src[i + 1] + src[i + 2],
+// so src has count + 2 elevations
+void gradientRow(float *diff, float *smooth, const float *src, int count);
+
+// Direction towards the light and the factors that turn the summed differences into slopes
+struct ShadeLight {
+    float x, y, z;
+    float scaleX, scaleY;
+};
+
+// shade[i] = lighting in 0..1 of the pixel between the gradient rows above and below
+void shadeRow(float *shade, const float *diffAbove, const float *diff, const float *diffBelow,
+              const float *smoothAbove, const float *smoothBelow, const ShadeLight &light, int count);
+
+// dst[i] = src sampled bilinearly at pixel position (u + i * du, v + i * dv), where
+// integer positions are the pixels themselves. The border is extended by a pixel,
+// further outside is transparent. Positions are fixed point, so width and height
+// must stay below 32768.
+void affineRow(uint32_t *dst, const uint32_t *src, int width, int height, double u, double v, double du, double dv, int count);
+
+// coverage[i] = |area[0] + ... + area[i]| clamped to 1 and scaled to 0..255, the
+// signed area accumulation of PathRasterizer. Clears the area for the next path.
+void coverageRow(uint8_t *coverage, float *area, int count);
+
+const char *getPixelKernelName();
+
+} /* namespace img */
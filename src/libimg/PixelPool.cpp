@@ -0,0 +1,113 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "PixelPool.h"
+
+namespace img {
+
+PixelPool &PixelPool::shared() {
+    // never destroyed, images in static storage may return their buffers late during exit
+    static PixelPool *pool = new PixelPool();
+    return *pool;
+}
+
+PixelPool::PixelPool() {
+    memoryConsumer = platform::MemoryBudget::shared().addConsumer("pixel_pool", platform::MemoryBudget::Priority::DECODED_IMAGES,
+        [this] () { return getStats().bytes; },
+        [this] (size_t bytes) { return trim(bytes); });
+}
+
+PixelPool::Buffer PixelPool::acquire(size_t count) {
+    if (count >= MIN_POOLED_PIXELS && count <= MAX_POOLED_PIXELS) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = idle.lower_bound(count);
+        if (it != idle.end() && it->first <= count + count / MAX_SLACK_DIVISOR) {
+            Buffer buffer = std::move(it->second);
+            stats.bytes -= it->first * sizeof(uint32_t);
+            stats.buffers--;
+            stats.hits++;
+            idle.erase(it);
+            // within the capacity, so no allocation
+            buffer->resize(count);
+            return buffer;
+        }
+        stats.misses++;
+    }
+
+    auto buffer = std::make_unique<std::vector<uint32_t>>();
+    buffer->resize(count);
+    return buffer;
+}
+
+void PixelPool::release(Buffer buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    size_t capacity = buffer->capacity();
+    size_t bytes = capacity * sizeof(uint32_t);
+    if (capacity < MIN_POOLED_PIXELS || capacity > MAX_POOLED_PIXELS) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stats.bytes + bytes > budget) {
+        return;
+    }
+    buffer->clear();
+    idle.emplace(capacity, std::move(buffer));
+    stats.bytes += bytes;
+    stats.buffers++;
+}
+
+void PixelPool::setByteBudget(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+    }
+    size_t used = getStats().bytes;
+    if (used > bytes) {
+        trim(used - bytes);
+    }
+}
+
+size_t PixelPool::trim(size_t bytes) {
+    std::vector<Buffer> freed;
+    size_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // the largest first, they give back the most per buffer
+        while (released < bytes && !idle.empty()) {
+            auto it = std::prev(idle.end());
+            size_t size = it->first * sizeof(uint32_t);
+            freed.push_back(std::move(it->second));
+            idle.erase(it);
+            released += size;
+            stats.bytes -= size;
+            stats.buffers--;
+        }
+    }
+    // freed outside of the lock
+    return released;
+}
+
+PixelPool::Stats PixelPool::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+} /* namespace img */
@@ -0,0 +1,74 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <vector>
+#include "src/platform/MemoryBudget.h"
+
+namespace img {
+
+// Recycles the pixel buffers of large images such as tiles, so that panning
+// over a map doesn't keep allocating and freeing megabytes in the simulator's
+// heap. Buffers are only moved in and out, never copied.
+class PixelPool {
+public:
+    using Buffer = std::unique_ptr<std::vector<uint32_t>>;
+
+    // smaller images aren't worth it and are usually long lived
+    static constexpr const size_t MIN_POOLED_PIXELS = 128 * 128;
+    static constexpr const size_t MAX_POOLED_PIXELS = 4096 * 4096;
+    static constexpr const size_t DEFAULT_BUDGET_BYTES = 32 * 1024 * 1024;
+    // a recycled buffer may be this much larger than requested
+    static constexpr const size_t MAX_SLACK_DIVISOR = 4;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t buffers = 0;
+        size_t bytes = 0;
+    };
+
+    static PixelPool &shared();
+
+    // a buffer with count pixels of undefined content
+    Buffer acquire(size_t count);
+    // keeps the buffer for the next acquire if it is in the pooled range and fits the budget
+    void release(Buffer buffer);
+
+    void setByteBudget(size_t bytes);
+    // frees idle buffers until the given bytes are released, returns the bytes released
+    size_t trim(size_t bytes);
+    Stats getStats();
+
+private:
+    std::mutex mutex;
+    // idle buffers by capacity in pixels
+    std::multimap<size_t, Buffer> idle;
+    size_t budget = DEFAULT_BUDGET_BYTES;
+    Stats stats;
+    platform::MemoryBudget::Registration memoryConsumer;
+
+    PixelPool();
+};
+
+} /* namespace img */
@@ -0,0 +1,229 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <stdexcept>
+#include "QoiCodec.h"
+
+namespace img {
+
+namespace {
+
+constexpr const uint8_t QOI_OP_INDEX = 0x00;
+constexpr const uint8_t QOI_OP_DIFF = 0x40;
+constexpr const uint8_t QOI_OP_LUMA = 0x80;
+constexpr const uint8_t QOI_OP_RUN = 0xC0;
+constexpr const uint8_t QOI_OP_RGB = 0xFE;
+constexpr const uint8_t QOI_OP_RGBA = 0xFF;
+constexpr const uint8_t QOI_MASK_2 = 0xC0;
+
+constexpr const size_t HEADER_SIZE = 14;
+constexpr const size_t CHANNELS_OFFSET = 12;
+constexpr const uint8_t END_MARKER[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+constexpr const int MAX_DIMENSION = 16384;
+
+inline int hashColor(uint32_t argb) {
+    uint32_t a = argb >> 24, r = (argb >> 16) & 0xFF, g = (argb >> 8) & 0xFF, b = argb & 0xFF;
+    return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+}
+
+inline void writeBE32(std::vector<uint8_t> &out, uint32_t v) {
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+inline uint32_t readBE32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+}
+
+bool isQOI(const uint8_t *data, size_t size) {
+    return size >= HEADER_SIZE && std::memcmp(data, "qoif", 4) == 0;
+}
+
+bool isOpaqueQOI(const uint8_t *data, size_t size) {
+    return isQOI(data, size) && data[CHANNELS_OFFSET] == 3;
+}
+
+bool readQOIDimensions(const uint8_t *data, size_t size, int &width, int &height) {
+    if (!isQOI(data, size)) {
+        return false;
+    }
+    uint32_t w = readBE32(data + 4);
+    uint32_t h = readBE32(data + 8);
+    if (w == 0 || h == 0 || w > MAX_DIMENSION || h > MAX_DIMENSION) {
+        return false;
+    }
+    width = w;
+    height = h;
+    return true;
+}
+
+std::vector<uint8_t> encodeQOI(const uint32_t *pixels, int width, int height) {
+    std::vector<uint8_t> out;
+    size_t count = (size_t) width * height;
+    out.reserve(HEADER_SIZE + count + sizeof(END_MARKER));
+
+    out.insert(out.end(), {'q', 'o', 'i', 'f'});
+    writeBE32(out, width);
+    writeBE32(out, height);
+    out.push_back(4); // RGBA, RGB if all pixels turn out to be opaque
+    out.push_back(0); // sRGB with linear alpha
+
+    uint32_t index[64] = {};
+    uint32_t prev = 0xFF000000;
+    int run = 0;
+    uint32_t alphaAnd = 0xFF000000;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t px = pixels[i];
+        alphaAnd &= px;
+
+        if (px == prev) {
+            run++;
+            if (run == 62 || i + 1 == count) {
+                out.push_back(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0) {
+            out.push_back(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        int hash = hashColor(px);
+        if (index[hash] == px) {
+            out.push_back(QOI_OP_INDEX | hash);
+        } else {
+            index[hash] = px;
+
+            if ((px >> 24) == (prev >> 24)) {
+                int8_t dr = (int8_t) (((px >> 16) & 0xFF) - ((prev >> 16) & 0xFF));
+                int8_t dg = (int8_t) (((px >> 8) & 0xFF) - ((prev >> 8) & 0xFF));
+                int8_t db = (int8_t) ((px & 0xFF) - (prev & 0xFF));
+                int8_t dgr = dr - dg;
+                int8_t dgb = db - dg;
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+                } else if (dgr >= -8 && dgr <= 7 && dg >= -32 && dg <= 31 && dgb >= -8 && dgb <= 7) {
+                    out.push_back(QOI_OP_LUMA | (dg + 32));
+                    out.push_back(((dgr + 8) << 4) | (dgb + 8));
+                } else {
+                    out.push_back(QOI_OP_RGB);
+                    out.push_back(px >> 16);
+                    out.push_back(px >> 8);
+                    out.push_back(px);
+                }
+            } else {
+                out.push_back(QOI_OP_RGBA);
+                out.push_back(px >> 16);
+                out.push_back(px >> 8);
+                out.push_back(px);
+                out.push_back(px >> 24);
+            }
+        }
+
+        prev = px;
+    }
+
+    out.insert(out.end(), std::begin(END_MARKER), std::end(END_MARKER));
+    if (alphaAnd == 0xFF000000) {
+        // the channel count is only a hint for the decoder, the data is the same
+        out[CHANNELS_OFFSET] = 3;
+    }
+    return out;
+}
+
+void decodeQOI(const uint8_t *data, size_t size, std::vector<uint32_t> &pixels, int &width, int &height) {
+    if (!isQOI(data, size)) {
+        throw std::runtime_error("Not a QOI image");
+    }
+
+    uint32_t w = readBE32(data + 4);
+    uint32_t h = readBE32(data + 8);
+    if (w == 0 || h == 0 || w > MAX_DIMENSION || h > MAX_DIMENSION) {
+        throw std::runtime_error("Invalid QOI dimensions");
+    }
+
+    size_t count = (size_t) w * h;
+    pixels.resize(count);
+
+    uint32_t index[64] = {};
+    uint32_t px = 0xFF000000;
+    size_t pos = HEADER_SIZE;
+    size_t end = size - sizeof(END_MARKER);
+    int run = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (pos >= end) {
+                throw std::runtime_error("Truncated QOI image");
+            }
+            uint8_t op = data[pos++];
+            uint32_t a = px >> 24, r = (px >> 16) & 0xFF, g = (px >> 8) & 0xFF, b = px & 0xFF;
+
+            if (op == QOI_OP_RGB || op == QOI_OP_RGBA) {
+                size_t need = (op == QOI_OP_RGBA) ? 4 : 3;
+                if (pos + need > end) {
+                    throw std::runtime_error("Truncated QOI image");
+                }
+                r = data[pos++];
+                g = data[pos++];
+                b = data[pos++];
+                if (op == QOI_OP_RGBA) {
+                    a = data[pos++];
+                }
+            } else if ((op & QOI_MASK_2) == QOI_OP_INDEX) {
+                px = index[op];
+                pixels[i] = px;
+                continue;
+            } else if ((op & QOI_MASK_2) == QOI_OP_DIFF) {
+                r += ((op >> 4) & 0x03) - 2;
+                g += ((op >> 2) & 0x03) - 2;
+                b += (op & 0x03) - 2;
+            } else if ((op & QOI_MASK_2) == QOI_OP_LUMA) {
+                if (pos >= end) {
+                    throw std::runtime_error("Truncated QOI image");
+                }
+                uint8_t next = data[pos++];
+                int dg = (op & 0x3F) - 32;
+                r += dg - 8 + ((next >> 4) & 0x0F);
+                g += dg;
+                b += dg - 8 + (next & 0x0F);
+            } else {
+                run = op & 0x3F;
+            }
+
+            px = (a << 24) | ((r & 0xFF) << 16) | ((g & 0xFF) << 8) | (b & 0xFF);
+            index[hashColor(px)] = px;
+        }
+        pixels[i] = px;
+    }
+
+    width = w;
+    height = h;
+}
+
+} /* namespace img */
@@ -0,0 +1,43 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace img {
+
+// The "Quite OK Image" format: lossless and much faster than PNG, used for
+// tiles that are rendered locally and kept in the disk cache.
+
+bool isQOI(const uint8_t *data, size_t size);
+
+// true if the header says that there is no alpha channel
+bool isOpaqueQOI(const uint8_t *data, size_t size);
+
+// the dimensions from the header, false if they are invalid
+bool readQOIDimensions(const uint8_t *data, size_t size, int &width, int &height);
+
+// pixels are ARGB as in Image
+std::vector<uint8_t> encodeQOI(const uint32_t *pixels, int width, int height);
+
+// throws if the data is not a valid QOI image
+void decodeQOI(const uint8_t *data, size_t size, std::vector<uint32_t> &pixels, int &width, int &height);
+
+} /* namespace img */
@@ -19,24 +19,111 @@
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <algorithm>
 #include "Rasterizer.h"
 #include "src/Logger.h"
 
 namespace img {
 
+namespace {
+
+// fitz allocations carry their size, so a thread can tell how much memory an operation kept
+constexpr size_t ALLOC_HEADER = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+thread_local int64_t threadAllocated = 0;
+
+void *fitzMalloc(void *, size_t size) {
+    auto base = (char *) std::malloc(size + ALLOC_HEADER);
+    if (!base) {
+        return nullptr;
+    }
+    *(size_t *) base = size;
+    threadAllocated += size;
+    return base + ALLOC_HEADER;
+}
+
+void *fitzRealloc(void *user, void *old, size_t size) {
+    if (!old) {
+        return fitzMalloc(user, size);
+    }
+    auto oldBase = (char *) old - ALLOC_HEADER;
+    size_t oldSize = *(size_t *) oldBase;
+    auto base = (char *) std::realloc(oldBase, size + ALLOC_HEADER);
+    if (!base) {
+        return nullptr;
+    }
+    *(size_t *) base = size;
+    threadAllocated += (int64_t) size - (int64_t) oldSize;
+    return base + ALLOC_HEADER;
+}
+
+void fitzFree(void *, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    auto base = (char *) ptr - ALLOC_HEADER;
+    threadAllocated -= *(size_t *) base;
+    std::free(base);
+}
+
+void fitzLock(void *user, int lock) {
+    static_cast<std::mutex *>(user)[lock].lock();
+}
+
+void fitzUnlock(void *user, int lock) {
+    static_cast<std::mutex *>(user)[lock].unlock();
+}
+
+}
+
 Rasterizer::Rasterizer(const std::string &utf8Path) {
     initFitz();
     loadFile(utf8Path);
+    registerMemoryConsumer();
 }
 
-Rasterizer::Rasterizer(const std::vector<uint8_t> &data, const std::string type) {
+Rasterizer::Rasterizer(std::shared_ptr<const std::vector<uint8_t>> data, const std::string type):
+    dataBuf(data)
+{
     initFitz();
-    loadMemory(data, type);
+    openStream(dataBuf->data(), dataBuf->size(), type.empty() ? "application/pdf" : type);
+    registerMemoryConsumer();
+}
+
+void Rasterizer::registerMemoryConsumer() {
+    memoryConsumer = platform::MemoryBudget::shared().addConsumer("documents", platform::MemoryBudget::Priority::DOCUMENTS,
+        [this] () {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            return cachedBytes;
+        },
+        [this] (size_t bytes) { return trimPageCache(bytes); });
+}
+
+size_t Rasterizer::trimPageCache(size_t bytes) {
+    // the lists are dropped with a context of our own, ctx might be in use
+    fz_context *context = acquireRenderContext();
+    size_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        // the newest page is the one being read, it is always kept
+        while (released < bytes && pageCache.size() > 1) {
+            auto &oldest = pageCache.back();
+            released += oldest.bytes;
+            cachedBytes -= oldest.bytes;
+            fz_drop_display_list(context, oldest.list);
+            pageCache.pop_back();
+        }
+    }
+    releaseRenderContext(context);
+    return released;
 }
 
 void Rasterizer::initFitz() {
     logger::verbose("Init fitz in thread %d", std::this_thread::get_id());
-    ctx = fz_new_context(nullptr, nullptr, FZ_STORE_UNLIMITED);
+    fz_alloc_context alloc { nullptr, fitzMalloc, fitzRealloc, fitzFree };
+    fz_locks_context locks { fitzLocks, fitzLock, fitzUnlock };
+    ctx = fz_new_context(&alloc, &locks, FZ_STORE_UNLIMITED);
     if (!ctx) {
         throw std::runtime_error("Couldn't initialize fitz");
     }
@@ -50,22 +137,16 @@ void Rasterizer::initFitz() {
 }
 
 void Rasterizer::loadFile(const std::string& file) {
-    fz_try(ctx) {
-        doc = fz_open_document(ctx, file.c_str());
-    } fz_catch(ctx) {
-        throw std::runtime_error("Cannot open document: " + std::string(fz_caught_message(ctx)));
-    }
-
-    loadDocument();
+    // fitz reads the mapped pages directly, large manuals don't need a copy in memory
+    mappedFile = std::make_unique<platform::MappedFile>(file);
+    openStream((const unsigned char *) mappedFile->data(), mappedFile->size(), file);
 }
 
-void Rasterizer::loadMemory(const std::vector<uint8_t> &data, const std::string type) {
-    dataBuf = data;
-    const char *mimeType(type.empty() ? "application/pdf" : type.c_str());
-
+void Rasterizer::openStream(const unsigned char *data, size_t size, const std::string &magic) {
+    // magic is a MIME type or a file name, fitz picks the document handler by its extension
     fz_try(ctx) {
-        stream = fz_open_memory(ctx, dataBuf.data(), dataBuf.size());
-        doc = fz_open_document_with_stream(ctx, mimeType, stream);
+        stream = fz_open_memory(ctx, data, size);
+        doc = fz_open_document_with_stream(ctx, magic.c_str(), stream);
     } fz_catch(ctx) {
         if (stream) {
             fz_drop_stream(ctx, stream);
@@ -111,15 +192,15 @@ double Rasterizer::getAspectRatio(int page) {
     return (rect.x1 - rect.x0) / (rect.y1 - rect.y0);
 }
 
-int Rasterizer::getPageWidth(int page, int zoom) {
-    bool swapXY = (preRotateAngle % 180) == 90;
+int Rasterizer::getPageWidth(int page, int zoom, int angle) {
+    bool swapXY = (angle % 180) == 90;
     auto &rect = pageRects.at(page);
     int width = swapXY ? rect.y1 - rect.y0 : rect.x1 - rect.x0;
     return width * zoomToScale(zoom);
 }
 
-int Rasterizer::getPageHeight(int page, int zoom) {
-    bool swapXY = (preRotateAngle % 180) == 90;
+int Rasterizer::getPageHeight(int page, int zoom, int angle) {
+    bool swapXY = (angle % 180) == 90;
     auto &rect = pageRects.at(page);
     int height = swapXY ? rect.x1 - rect.x0 : rect.y1 - rect.y0;
     return height * zoomToScale(zoom);
@@ -129,22 +210,31 @@ int Rasterizer::getPageCount() const {
     return totalPages;
 }
 
-std::unique_ptr<Image> Rasterizer::loadTile(int page, int x, int y, int zoom, bool nightMode) {
-    loadPage(page);
-
-    if (logLoadTimes) {
-        logger::info("Loading tile %d, %d, %d, %d in thread %d", page, x, y, zoom, std::this_thread::get_id());
+std::unique_ptr<Image> Rasterizer::loadTile(int page, int x, int y, int zoom, int angle) {
+    // each loader thread renders with a context of its own, sharing the parsed pages
+    fz_context *context = acquireRenderContext();
+    fz_display_list *list = nullptr;
+    try {
+        list = loadPage(context, page, angle);
+        if (logLoadTimes) {
+            logger::info("Loading tile %d, %d, %d, %d in thread %d", page, x, y, zoom, std::this_thread::get_id());
+        }
+        auto image = renderRegion(context, list, page, tileSize * x, tileSize * y, tileSize, tileSize, zoomToScale(zoom), angle);
+        fz_drop_display_list(context, list);
+        releaseRenderContext(context);
+        return image;
+    } catch (...) {
+        if (list) {
+            fz_drop_display_list(context, list);
+        }
+        releaseRenderContext(context);
+        throw;
     }
+}
 
-    auto image = std::make_unique<Image>(tileSize, tileSize, 0);
-
-    int outStartX = tileSize * x;
-    int outStartY = tileSize * y;
-
-    int outWidth = image->getWidth();
-    int outHeight = image->getHeight();
-
-    float scale = zoomToScale(zoom);
+std::unique_ptr<Image> Rasterizer::renderRegion(fz_context *context, fz_display_list *list, int page, int outStartX, int outStartY,
+        int outWidth, int outHeight, float scale, int rotateAngle) {
+    auto image = std::make_unique<Image>(outWidth, outHeight, 0);
 
     fz_irect clipBox;
     clipBox.x0 = outStartX;
@@ -153,27 +243,27 @@ std::unique_ptr<Image> Rasterizer::loadTile(int page, int x, int y, int zoom, bo
     clipBox.y1 = outStartY + outHeight;
 
     fz_pixmap *pix = nullptr;
-    fz_try(ctx) {
+    fz_try(context) {
         uint8_t *outBuf = (uint8_t *) image->getPixels();
-        pix = fz_new_pixmap_with_data(ctx, fz_device_bgr(ctx), outWidth, outHeight, nullptr, 1, outWidth * 4, outBuf);
+        pix = fz_new_pixmap_with_data(context, fz_device_bgr(context), outWidth, outHeight, nullptr, 1, outWidth * 4, outBuf);
         pix->x = clipBox.x0;
         pix->y = clipBox.y0;
         pix->xres = 72; // fz_bound_page returned pixels with 72 dpi
         pix->yres = 72;
-    } fz_catch(ctx) {
-        throw std::runtime_error("Couldn't create pixmap: " + std::string(fz_caught_message(ctx)));
+    } fz_catch(context) {
+        throw std::runtime_error("Couldn't create pixmap: " + std::string(fz_caught_message(context)));
     }
 
     fz_device *dev = nullptr;
-    fz_try(ctx) {
-        auto &rect = pageRects.at(currentPageNum);
+    fz_try(context) {
+        auto &rect = pageRects.at(page);
         int currentPageWidth = rect.x1 - rect.x0;
         int currentPageHeight = rect.y1 - rect.y0;
 
         auto startAt = std::chrono::steady_clock::now();
 
         int translateX = 0, translateY = 0;
-        switch(preRotateAngle) {
+        switch(rotateAngle) {
         case 0:
             translateX = 0;
             translateY = 0;
@@ -191,97 +281,495 @@ std::unique_ptr<Image> Rasterizer::loadTile(int page, int x, int y, int zoom, bo
             translateY = currentPageWidth * scale;
             break;
         default:
-            LOG_ERROR("Invalid preRotateAngle %d", preRotateAngle);
+            LOG_ERROR("Invalid preRotateAngle %d", rotateAngle);
             break;
         }
 
         fz_matrix scaleMatrix = fz_scale(scale, scale);
-        fz_matrix rotateMatrix = fz_rotate(preRotateAngle);
+        fz_matrix rotateMatrix = fz_rotate(rotateAngle);
         fz_matrix rotateAndScaleMatrix = fz_concat(scaleMatrix, rotateMatrix);
         fz_matrix translateMatrix = fz_translate(translateX, translateY);
         fz_matrix transformMatrix = fz_concat(rotateAndScaleMatrix, translateMatrix);
 
-        dev = fz_new_draw_device_with_bbox(ctx, transformMatrix, pix, &clipBox);
+        dev = fz_new_draw_device_with_bbox(context, transformMatrix, pix, &clipBox);
 
         // pre-fill page with white
-        fz_path *path = fz_new_path(ctx);
-        fz_moveto(ctx, path, 0, 0);
-        fz_lineto(ctx, path, 0, currentPageHeight);
-        fz_lineto(ctx, path, currentPageWidth, currentPageHeight);
-        fz_lineto(ctx, path, currentPageWidth, 0);
-        fz_closepath(ctx, path);
+        fz_path *path = fz_new_path(context);
+        fz_moveto(context, path, 0, 0);
+        fz_lineto(context, path, 0, currentPageHeight);
+        fz_lineto(context, path, currentPageWidth, currentPageHeight);
+        fz_lineto(context, path, currentPageWidth, 0);
+        fz_closepath(context, path);
         float white = 1.0f;
-        if (nightMode) {
-            white = 0.6f;
-        }
-        fz_fill_path(ctx, dev, path, 0, fz_identity, fz_device_gray(ctx), &white, 1.0f, fz_default_color_params);
-        fz_drop_path(ctx, path);
+        fz_fill_path(context, dev, path, 0, fz_identity, fz_device_gray(context), &white, 1.0f, fz_default_color_params);
+        fz_drop_path(context, path);
 
         fz_rect pageRect;
         pageRect.x0 = 0;
         pageRect.y0 = 0;
         pageRect.x1 = currentPageWidth;
         pageRect.y1 = currentPageHeight;
-        fz_run_display_list(ctx, currentPageList, dev, fz_identity, pageRect, nullptr);
-        fz_close_device(ctx, dev);
-        fz_drop_device(ctx, dev);
+        fz_run_display_list(context, list, dev, fz_identity, pageRect, nullptr);
+        fz_close_device(context, dev);
+        fz_drop_device(context, dev);
 
         if (logLoadTimes) {
             auto endAt = std::chrono::steady_clock::now();
             auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(endAt - startAt).count();
             logger::info("Tile loaded in %d millis", dur);
         }
-    } fz_catch(ctx) {
+    } fz_catch(context) {
         if (dev) {
-            fz_drop_device(ctx, dev);
+            fz_drop_device(context, dev);
         }
-        fz_drop_pixmap(ctx, pix);
-        throw std::runtime_error("Couldn't render page: " + std::string(fz_caught_message(ctx)));
+        fz_drop_pixmap(context, pix);
+        throw std::runtime_error("Couldn't render page: " + std::string(fz_caught_message(context)));
     }
 
     if (pix) {
-        fz_drop_pixmap(ctx, pix);
+        fz_drop_pixmap(context, pix);
     }
 
     return image;
 }
 
-void Rasterizer::loadPage(int page) {
-    if (page == currentPageNum && currentPageList != nullptr) {
+std::shared_ptr<Image> Rasterizer::getPagePreview(int page, int angle) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    for (auto &entry: pageCache) {
+        if (entry.page == page && entry.preview && entry.previewAngle == angle) {
+            return entry.preview;
+        }
+    }
+
+    PageRequest request(page, angle);
+    if (std::find(previewQueue.begin(), previewQueue.end(), request) == previewQueue.end()) {
+        previewQueue.push_back(request);
+        startPreParser();
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Image> Rasterizer::getPageThumbnail(int page, int angle) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    for (auto it = thumbnails.begin(); it != thumbnails.end(); ++it) {
+        if (it->page == page && it->angle == angle) {
+            thumbnails.splice(thumbnails.begin(), thumbnails, it);
+            return it->image;
+        }
+    }
+
+    PageRequest request(page, angle);
+    if (std::find(thumbnailQueue.begin(), thumbnailQueue.end(), request) == thumbnailQueue.end()) {
+        thumbnailQueue.push_back(request);
+        startPreParser();
+    }
+    return nullptr;
+}
+
+void Rasterizer::startPreParser() {
+    // called with cacheMutex held
+    if (!preParser) {
+        preParser = std::make_unique<std::thread>(&Rasterizer::preParseLoop, this);
+    }
+    preParseCondition.notify_one();
+}
+
+fz_display_list *Rasterizer::loadPage(fz_context *context, int page, int angle) {
+    // returns a new reference to the page's list
+    bool switched;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        switched = (page != requestedPage || angle != requestedAngle);
+        requestedPage = page;
+        requestedAngle = angle;
+    }
+
+    fz_display_list *list = findCachedPage(context, page);
+    if (!list) {
+        // another thread might be parsing this page, then it is cached once it's done
+        std::lock_guard<std::mutex> docLock(docMutex);
+        list = findCachedPage(context, page);
+        if (!list) {
+            logger::verbose("Loading page %d in thread %d", (int) page, std::this_thread::get_id());
+            int64_t allocatedBefore = threadAllocated;
+            list = parsePage(context, page);
+            cachePage(context, page, list, (size_t) std::max<int64_t>(0, threadAllocated - allocatedBefore));
+            logger::verbose("Page %d rasterized", page);
+        }
+    }
+
+    if (switched) {
+        schedulePreParse(page, angle);
+    }
+    return list;
+}
+
+fz_context *Rasterizer::acquireRenderContext() {
+    {
+        std::lock_guard<std::mutex> lock(contextMutex);
+        if (!renderContexts.empty()) {
+            fz_context *context = renderContexts.back();
+            renderContexts.pop_back();
+            return context;
+        }
+    }
+    return cloneContext();
+}
+
+void Rasterizer::releaseRenderContext(fz_context *context) {
+    std::lock_guard<std::mutex> lock(contextMutex);
+    renderContexts.push_back(context);
+}
+
+fz_context *Rasterizer::cloneContext() {
+    // clones share the store and the allocator of ctx, which must not be used meanwhile
+    std::lock_guard<std::mutex> lock(cloneMutex);
+    fz_context *context = fz_clone_context(ctx);
+    if (!context) {
+        throw std::runtime_error("Couldn't clone fitz context");
+    }
+    return context;
+}
+
+int Rasterizer::getMaxConcurrentRenders() const {
+    // leave a core for the simulator
+    int cores = (int) std::thread::hardware_concurrency() - 1;
+    return std::max(1, std::min(cores, MAX_RENDER_THREADS));
+}
+
+fz_display_list *Rasterizer::parsePage(fz_context *context, int page) {
+    // called with docMutex held
+    fz_display_list *list = nullptr;
+    fz_try(context) {
+        list = fz_new_display_list_from_page_number(context, doc, page);
+    } fz_catch(context) {
+        throw std::runtime_error("Cannot parse page: " + std::string(fz_caught_message(context)));
+    }
+    return list;
+}
+
+fz_display_list *Rasterizer::findCachedPage(fz_context *context, int page) {
+    // returns a new reference to the page's list
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto it = pageCache.begin(); it != pageCache.end(); ++it) {
+        if (it->page == page) {
+            pageCache.splice(pageCache.begin(), pageCache, it);
+            return fz_keep_display_list(context, it->list);
+        }
+    }
+    return nullptr;
+}
+
+void Rasterizer::cachePage(fz_context *context, int page, fz_display_list *list, size_t bytes) {
+    // takes the given reference to the list, the caller keeps a reference of its own
+    fz_keep_display_list(context, list);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    pageCache.push_front(CachedPage {page, list, bytes});
+    cachedBytes += bytes;
+
+    // the newest page is always kept, even if it is larger than the limit
+    while (pageCache.size() > 1 && (pageCache.size() > MAX_CACHED_PAGES || cachedBytes > MAX_CACHED_BYTES)) {
+        auto &oldest = pageCache.back();
+        cachedBytes -= oldest.bytes;
+        fz_drop_display_list(context, oldest.list);
+        pageCache.pop_back();
+    }
+}
+
+void Rasterizer::schedulePreParse(int page, int angle) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    // only the neighbours of the latest page are of interest
+    preParseQueue.clear();
+    for (int next: {page + 1, page - 1}) {
+        if (next < 0 || next >= totalPages) {
+            continue;
+        }
+        bool cached = false;
+        for (auto &entry: pageCache) {
+            cached |= (entry.page == next);
+        }
+        if (!cached) {
+            preParseQueue.emplace_back(next, angle);
+        }
+    }
+    if (preParseQueue.empty()) {
+        return;
+    }
+
+    startPreParser();
+}
+
+void Rasterizer::preParseLoop() {
+    fz_context *parseCtx = nullptr;
+    try {
+        parseCtx = cloneContext();
+    } catch (const std::exception &e) {
+        logger::warn("%s, pages won't be parsed ahead", e.what());
         return;
     }
 
-    freeCurrentPage();
+    while (true) {
+        PageRequest request;
+        bool thumbnail = false;
+        {
+            std::unique_lock<std::mutex> lock(cacheMutex);
+            preParseCondition.wait(lock, [this] {
+                return stopPreParser || !previewQueue.empty() || !preParseQueue.empty() || !thumbnailQueue.empty();
+            });
+            if (stopPreParser) {
+                break;
+            }
+            // previews are shown while the tiles are loading, so they come first
+            if (!previewQueue.empty()) {
+                request = previewQueue.front();
+                previewQueue.pop_front();
+            } else if (!preParseQueue.empty()) {
+                request = preParseQueue.front();
+                preParseQueue.pop_front();
+            } else {
+                request = thumbnailQueue.front();
+                thumbnailQueue.pop_front();
+                thumbnail = true;
+            }
+        }
 
-    logger::verbose("Loading page %d in thread %d", (int) page, std::this_thread::get_id());
+        int page = request.first;
+        int angle = request.second;
 
-    fz_try(ctx) {
-        currentPageList = fz_new_display_list_from_page_number(ctx, doc, page);
-        currentPageNum = page;
-    } fz_catch(ctx) {
-        throw std::runtime_error("Cannot parse page: " + std::string(fz_caught_message(ctx)));
+        if (thumbnail) {
+            try {
+                renderThumbnail(parseCtx, page, angle);
+            } catch (const std::exception &e) {
+                logger::warn("Couldn't render thumbnail of page %d: %s", page, e.what());
+            }
+            continue;
+        }
+
+        fz_display_list *list = nullptr;
+        try {
+            {
+                std::lock_guard<std::mutex> docLock(docMutex);
+                list = findCachedPage(parseCtx, page);
+                if (!list) {
+                    int64_t allocatedBefore = threadAllocated;
+                    list = parsePage(parseCtx, page);
+                    cachePage(parseCtx, page, list, (size_t) std::max<int64_t>(0, threadAllocated - allocatedBefore));
+                    logger::verbose("Page %d parsed ahead", page);
+                }
+            }
+            renderPreview(parseCtx, list, page, angle);
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't parse page %d ahead: %s", page, e.what());
+        }
+
+        if (list) {
+            fz_drop_display_list(parseCtx, list);
+        }
     }
 
-    logger::verbose("Page %d rasterized", currentPageNum);
+    fz_drop_context(parseCtx);
 }
 
-float Rasterizer::zoomToScale(int zoom) const {
-    return std::pow(M_SQRT2, zoom);
+void Rasterizer::renderPreview(fz_context *context, fz_display_list *list, int page, int angle) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (auto &entry: pageCache) {
+            if (entry.page == page && entry.preview && entry.previewAngle == angle) {
+                return;
+            }
+        }
+    }
+
+    // the whole page at a resolution that is quick to render
+    auto &rect = pageRects.at(page);
+    float scale = PREVIEW_SIZE / std::max(rect.x1 - rect.x0, rect.y1 - rect.y0);
+    int width, height;
+    pageSize(page, angle, scale, width, height);
+    std::shared_ptr<Image> preview = renderRegion(context, list, page, 0, 0, width, height, scale, angle);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto &entry: pageCache) {
+        if (entry.page == page) {
+            entry.preview = preview;
+            entry.previewAngle = angle;
+        }
+    }
 }
 
-void Rasterizer::freeCurrentPage() {
-    if (currentPageList) {
-        fz_drop_display_list(ctx, currentPageList);
-        currentPageList = nullptr;
+std::vector<Rasterizer::TextWord> Rasterizer::extractPageText(int page) {
+    fz_context *context = acquireRenderContext();
+
+    fz_stext_page *text = nullptr;
+    {
+        std::lock_guard<std::mutex> docLock(docMutex);
+        fz_try(context) {
+            fz_stext_options options {};
+            text = fz_new_stext_page_from_page_number(context, doc, page, &options);
+        } fz_catch(context) {
+            text = nullptr;
+        }
+    }
+
+    if (!text) {
+        std::string error = fz_caught_message(context);
+        releaseRenderContext(context);
+        throw std::runtime_error("Cannot extract text: " + error);
+    }
+
+    std::vector<TextWord> words;
+    TextWord word {};
+    auto finishWord = [&words, &word] () {
+        if (!word.text.empty()) {
+            words.push_back(word);
+        }
+        word = TextWord {};
+    };
+
+    for (fz_stext_block *block = text->first_block; block; block = block->next) {
+        if (block->type != FZ_STEXT_BLOCK_TEXT) {
+            continue;
+        }
+        for (fz_stext_line *line = block->u.t.first_line; line; line = line->next) {
+            for (fz_stext_char *ch = line->first_char; ch; ch = ch->next) {
+                if (ch->c <= ' ') {
+                    finishWord();
+                    continue;
+                }
+                char utf8[FZ_UTFMAX];
+                int len = fz_runetochar(utf8, ch->c);
+                fz_rect box = fz_rect_from_quad(ch->quad);
+                if (word.text.empty()) {
+                    word.x0 = box.x0;
+                    word.y0 = box.y0;
+                    word.x1 = box.x1;
+                    word.y1 = box.y1;
+                } else {
+                    word.x0 = std::min(word.x0, box.x0);
+                    word.y0 = std::min(word.y0, box.y0);
+                    word.x1 = std::max(word.x1, box.x1);
+                    word.y1 = std::max(word.y1, box.y1);
+                }
+                word.text.append(utf8, len);
+            }
+            finishWord();
+        }
     }
+
+    fz_drop_stext_page(context, text);
+    releaseRenderContext(context);
+    return words;
 }
 
-void Rasterizer::setPreRotate(int angle) {
-    preRotateAngle = angle;
+void Rasterizer::pageToPixels(int page, float x, float y, int zoom, int angle, double &outX, double &outY) {
+    // the transformation of renderRegion
+    auto &rect = pageRects.at(page);
+    float width = rect.x1 - rect.x0;
+    float height = rect.y1 - rect.y0;
+    float scale = zoomToScale(zoom);
+
+    switch (angle) {
+    case 90:
+        outX = (height - y) * scale;
+        outY = x * scale;
+        break;
+    case 180:
+        outX = (width - x) * scale;
+        outY = (height - y) * scale;
+        break;
+    case 270:
+        outX = y * scale;
+        outY = (width - x) * scale;
+        break;
+    default:
+        outX = x * scale;
+        outY = y * scale;
+        break;
+    }
+}
+
+void Rasterizer::renderThumbnail(fz_context *context, int page, int angle) {
+    auto &rect = pageRects.at(page);
+    float scale = THUMBNAIL_SIZE / std::max(rect.x1 - rect.x0, rect.y1 - rect.y0);
+    int width, height;
+    pageSize(page, angle, scale, width, height);
+
+    std::shared_ptr<Image> preview;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (auto &entry: thumbnails) {
+            if (entry.page == page && entry.angle == angle) {
+                return;
+            }
+        }
+        for (auto &entry: pageCache) {
+            if (entry.page == page && entry.preview && entry.previewAngle == angle) {
+                preview = entry.preview;
+            }
+        }
+    }
+
+    std::shared_ptr<Image> image;
+    if (preview) {
+        // scaling down the preview is cheaper than rendering the page again
+        image = std::make_shared<Image>(width, height, 0);
+        image->drawScaledRegion(*preview, 0, 0, preview->getWidth(), preview->getHeight(), 0, 0, width, height);
+    } else {
+        // pages parsed for a thumbnail are dropped right away, the cache keeps those being read
+        fz_display_list *list = findCachedPage(context, page);
+        if (!list) {
+            std::lock_guard<std::mutex> docLock(docMutex);
+            list = parsePage(context, page);
+        }
+        try {
+            image = renderRegion(context, list, page, 0, 0, width, height, scale, angle);
+        } catch (...) {
+            fz_drop_display_list(context, list);
+            throw;
+        }
+        fz_drop_display_list(context, list);
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    thumbnails.push_front(Thumbnail {page, angle, image});
+    if (thumbnails.size() > MAX_THUMBNAILS) {
+        thumbnails.pop_back();
+    }
+}
+
+void Rasterizer::pageSize(int page, int angle, float scale, int &width, int &height) const {
+    auto &rect = pageRects.at(page);
+    bool swapXY = (angle % 180) == 90;
+    width = std::ceil((swapXY ? rect.y1 - rect.y0 : rect.x1 - rect.x0) * scale);
+    height = std::ceil((swapXY ? rect.x1 - rect.x0 : rect.y1 - rect.y0) * scale);
+}
+
+float Rasterizer::zoomToScale(int zoom) const {
+    return std::pow(M_SQRT2, zoom);
 }
 
 Rasterizer::~Rasterizer() {
-    freeCurrentPage();
+    memoryConsumer.reset();
+    if (preParser) {
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            stopPreParser = true;
+        }
+        preParseCondition.notify_one();
+        preParser->join();
+    }
+
+    for (auto &entry: pageCache) {
+        fz_drop_display_list(ctx, entry.list);
+    }
+    pageCache.clear();
+    for (fz_context *context: renderContexts) {
+        fz_drop_context(context);
+    }
+    renderContexts.clear();
     fz_drop_document(ctx, doc);
     if (stream) {
         fz_drop_stream(ctx, stream);
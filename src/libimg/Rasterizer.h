@@ -22,46 +22,147 @@
 #include <vector>
 #include <string>
 #include <atomic>
+#include <list>
+#include <deque>
+#include <utility>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <mupdf/fitz.h>
 #include "Image.h"
+#include "src/platform/MappedFile.h"
+#include "src/platform/MemoryBudget.h"
 
 namespace img {
 
 class Rasterizer {
 public:
+    // a run of text between spaces, bounded in unrotated page units
+    struct TextWord {
+        std::string text;
+        float x0, y0, x1, y1;
+    };
+
     Rasterizer(const std::string &utf8Path);
-    Rasterizer(const std::vector<uint8_t> &data, const std::string type);
+    // the data is shared, not copied
+    Rasterizer(std::shared_ptr<const std::vector<uint8_t>> data, const std::string type);
 
+    // The angle is the clockwise pre-rotation of the pages in multiples of 90 degrees.
+    // It is passed by the caller so that several views can share one document and
+    // its parsed pages while showing them rotated differently, see SharedDocuments.
     int getTileSize();
-    int getPageWidth(int page, int zoom);
-    int getPageHeight(int page, int zoom);
+    int getPageWidth(int page, int zoom, int angle);
+    int getPageHeight(int page, int zoom, int angle);
     double getAspectRatio(int page);
-    std::unique_ptr<Image> loadTile(int page, int x, int y, int zoom, bool nightMode);
-    void setPreRotate(int angle);
+    // can be called from several threads at once
+    std::unique_ptr<Image> loadTile(int page, int x, int y, int zoom, int angle);
+    int getMaxConcurrentRenders() const;
+    // The whole page at a low resolution, nullptr until it was rendered in the background
+    std::shared_ptr<Image> getPagePreview(int page, int angle);
+    // A small image of the page for page overviews, rendered in the background when
+    // nothing else is to be done. nullptr until it is available.
+    std::shared_ptr<Image> getPageThumbnail(int page, int angle);
+
+    // can be called from several threads at once, only parses the page's text
+    std::vector<TextWord> extractPageText(int page);
+    // position of a point given in page units on the pre-rotated page at the given zoom
+    void pageToPixels(int page, float x, float y, int zoom, int angle, double &outX, double &outY);
 
     int getPageCount() const;
 
     ~Rasterizer();
 private:
-    std::vector<uint8_t> dataBuf;
+    static constexpr const int MAX_RENDER_THREADS = 4;
+
+    // parsed pages kept for page flipping, the least recently used are dropped first
+    static constexpr const size_t MAX_CACHED_PAGES = 8;
+    static constexpr const size_t MAX_CACHED_BYTES = 64 * 1024 * 1024;
+    // longer side of the page previews in pixels
+    static constexpr const float PREVIEW_SIZE = 512;
+    // longer side of the thumbnails and how many of them are kept
+    static constexpr const float THUMBNAIL_SIZE = 128;
+    static constexpr const size_t MAX_THUMBNAILS = 64;
+
+    struct CachedPage {
+        int page;
+        fz_display_list *list;
+        // memory that fitz kept allocated while parsing the page
+        size_t bytes;
+        std::shared_ptr<Image> preview;
+        int previewAngle;
+    };
+
+    struct Thumbnail {
+        int page;
+        int angle;
+        std::shared_ptr<Image> image;
+    };
+
+    // the document's bytes, either a mapped file or shared downloaded data
+    std::unique_ptr<platform::MappedFile> mappedFile;
+    std::shared_ptr<const std::vector<uint8_t>> dataBuf;
     std::vector<fz_rect> pageRects;
     bool logLoadTimes = false;
     int tileSize = 1024;
     int totalPages = 0;
-    int currentPageNum = 0;
-    int preRotateAngle = 0;
     fz_context *ctx {};
     fz_stream *stream{};
     fz_document *doc{};
-    fz_display_list *currentPageList {};
+
+    // fitz objects are shared with the render and pre-parsing threads, which use clones of ctx
+    std::mutex fitzLocks[FZ_LOCK_MAX];
+    // a document can only be used by one thread at a time
+    std::mutex docMutex;
+    std::mutex cloneMutex;
+
+    // contexts of finished renders, reused by the next ones
+    std::mutex contextMutex;
+    std::vector<fz_context *> renderContexts;
+
+    std::mutex cacheMutex;
+    std::list<CachedPage> pageCache;
+    size_t cachedBytes = 0;
+    // registered once the document is open, dropped first when destroying
+    platform::MemoryBudget::Registration memoryConsumer;
+    // page and angle of the latest render, its neighbours are parsed ahead when it changes
+    int requestedPage = -1;
+    int requestedAngle = 0;
+
+    // pages next to the current one are parsed in the background, along with requested
+    // previews. The queues hold pages and the angle to render their previews with.
+    using PageRequest = std::pair<int, int>;
+    std::unique_ptr<std::thread> preParser;
+    std::condition_variable preParseCondition;
+    std::deque<PageRequest> preParseQueue;
+    std::deque<PageRequest> previewQueue;
+    // requested thumbnails, rendered when both other queues are empty
+    std::deque<PageRequest> thumbnailQueue;
+    // most recently used first, independent of pageCache to not evict the pages being read
+    std::list<Thumbnail> thumbnails;
+    bool stopPreParser = false;
 
     void initFitz();
     void loadFile(const std::string &file);
-    void loadMemory(const std::vector<uint8_t> &data, const std::string type);
+    void openStream(const unsigned char *data, size_t size, const std::string &magic);
     void loadDocument();
-    void loadPage(int page);
+    std::unique_ptr<Image> renderRegion(fz_context *context, fz_display_list *list, int page, int outStartX, int outStartY,
+            int outWidth, int outHeight, float scale, int rotateAngle);
+    void renderPreview(fz_context *context, fz_display_list *list, int page, int angle);
+    void renderThumbnail(fz_context *context, int page, int angle);
+    void startPreParser();
+    void pageSize(int page, int angle, float scale, int &width, int &height) const;
+    fz_display_list *loadPage(fz_context *context, int page, int angle);
+    fz_context *acquireRenderContext();
+    void releaseRenderContext(fz_context *context);
+    void registerMemoryConsumer();
+    size_t trimPageCache(size_t bytes);
+    fz_context *cloneContext();
+    fz_display_list *parsePage(fz_context *context, int page);
+    fz_display_list *findCachedPage(fz_context *context, int page);
+    void cachePage(fz_context *context, int page, fz_display_list *list, size_t bytes);
+    void schedulePreParse(int page, int angle);
+    void preParseLoop();
     float zoomToScale(int zoom) const;
-    void freeCurrentPage();
 };
 
 } /* namespace img */
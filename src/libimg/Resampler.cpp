@@ -0,0 +1,187 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include "Resampler.h"
+#include "PixelKernels.h"
+
+namespace img {
+
+namespace {
+
+// weights for one axis, taps are padded so every target pixel has the same count
+struct FilterBank {
+    int taps = 0;
+    std::vector<int> starts;
+    std::vector<float> weights;
+};
+
+constexpr const size_t MAX_CACHED_BANKS = 64;
+
+using BankKey = std::tuple<int, int, ResampleFilter>;
+std::mutex bankMutex;
+std::map<BankKey, std::shared_ptr<const FilterBank>> banks;
+
+double filterSupport(ResampleFilter filter) {
+    switch (filter) {
+    case ResampleFilter::AREA:      return 0.5;
+    case ResampleFilter::BILINEAR:  return 1.0;
+    case ResampleFilter::LANCZOS3:  return 3.0;
+    }
+    return 1.0;
+}
+
+double sinc(double x) {
+    if (x == 0) {
+        return 1;
+    }
+    x *= M_PI;
+    return std::sin(x) / x;
+}
+
+double filterWeight(ResampleFilter filter, double x) {
+    switch (filter) {
+    case ResampleFilter::AREA:
+        return (x >= -0.5 && x < 0.5) ? 1 : 0;
+    case ResampleFilter::BILINEAR:
+        x = std::abs(x);
+        return x < 1 ? 1 - x : 0;
+    case ResampleFilter::LANCZOS3:
+        return (x > -3 && x < 3) ? sinc(x) * sinc(x / 3) : 0;
+    }
+    return 0;
+}
+
+std::shared_ptr<const FilterBank> createBank(int srcSize, int dstSize, ResampleFilter filter) {
+    double scale = (double) srcSize / dstSize;
+    // when shrinking, the filter is stretched to cover all contributing source pixels
+    double filterScale = std::max(scale, 1.0);
+    double support = filterSupport(filter) * filterScale;
+
+    std::vector<int> starts(dstSize);
+    std::vector<std::vector<double>> rows(dstSize);
+    int taps = 1;
+
+    for (int i = 0; i < dstSize; i++) {
+        double center = (i + 0.5) * scale;
+        int first = std::max((int) std::floor(center - support), 0);
+        int last = std::min((int) std::ceil(center + support), srcSize);
+
+        double sum = 0;
+        auto &w = rows[i];
+        for (int x = first; x < last; x++) {
+            double weight = filterWeight(filter, (x + 0.5 - center) / filterScale);
+            w.push_back(weight);
+            sum += weight;
+        }
+
+        if (sum == 0) {
+            // the target pixel fell between the filter samples, use the nearest one
+            first = std::min((int) center, srcSize - 1);
+            w.assign(1, 1.0);
+            sum = 1;
+        }
+
+        for (auto &weight: w) {
+            weight /= sum;
+        }
+        starts[i] = first;
+        taps = std::max(taps, (int) w.size());
+    }
+
+    auto bank = std::make_shared<FilterBank>();
+    bank->taps = taps;
+    bank->starts.resize(dstSize);
+    bank->weights.assign(dstSize * taps, 0);
+    for (int i = 0; i < dstSize; i++) {
+        // move the window back at the end of the row so it stays inside the source
+        int start = std::min(starts[i], srcSize - taps);
+        int offset = starts[i] - start;
+        bank->starts[i] = start;
+        for (size_t k = 0; k < rows[i].size(); k++) {
+            bank->weights[i * taps + offset + k] = rows[i][k];
+        }
+    }
+    return bank;
+}
+
+std::shared_ptr<const FilterBank> getBank(int srcSize, int dstSize, ResampleFilter filter) {
+    BankKey key = std::make_tuple(srcSize, dstSize, filter);
+
+    std::lock_guard<std::mutex> lock(bankMutex);
+    auto it = banks.find(key);
+    if (it != banks.end()) {
+        return it->second;
+    }
+
+    if (banks.size() >= MAX_CACHED_BANKS) {
+        // callers use a handful of sizes, so starting over is cheaper than an LRU
+        banks.clear();
+    }
+
+    auto bank = createBank(srcSize, dstSize, filter);
+    banks[key] = bank;
+    return bank;
+}
+
+} // namespace
+
+void resample(const uint32_t *src, int srcWidth, int srcHeight, int srcStride,
+              uint32_t *dst, int dstWidth, int dstHeight, int dstStride,
+              ResampleFilter filter)
+{
+    if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+        return;
+    }
+
+    auto horizontal = getBank(srcWidth, dstWidth, filter);
+    auto vertical = getBank(srcHeight, dstHeight, filter);
+
+    int firstRow = vertical->starts.front();
+    int lastRow = vertical->starts.back() + vertical->taps;
+    int floatsPerRow = 4 * dstWidth;
+
+    // horizontal pass over all source rows that the vertical pass reads
+    std::vector<float> line(4 * srcWidth);
+    std::vector<float> rows((lastRow - firstRow) * floatsPerRow);
+    for (int y = firstRow; y < lastRow; y++) {
+        premultiplyRow(line.data(), src + y * srcStride, srcWidth);
+        convolveRow(rows.data() + (y - firstRow) * floatsPerRow, line.data(),
+                horizontal->starts.data(), horizontal->weights.data(), horizontal->taps, dstWidth);
+    }
+
+    std::vector<float> acc(floatsPerRow);
+    for (int y = 0; y < dstHeight; y++) {
+        std::fill(acc.begin(), acc.end(), 0.0f);
+        const float *weights = vertical->weights.data() + y * vertical->taps;
+        for (int k = 0; k < vertical->taps; k++) {
+            if (weights[k] != 0) {
+                int row = vertical->starts[y] + k - firstRow;
+                accumulateRow(acc.data(), rows.data() + row * floatsPerRow, weights[k], floatsPerRow);
+            }
+        }
+        unpremultiplyRow(dst + y * dstStride, acc.data(), dstWidth);
+    }
+}
+
+} /* namespace img */
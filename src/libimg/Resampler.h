@@ -0,0 +1,37 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace img {
+
+enum class ResampleFilter {
+    AREA,       // box filter, averages the covered source pixels
+    BILINEAR,   // triangle filter
+    LANCZOS3,   // windowed sinc, sharpest but widest
+};
+
+// Separable resampler for ARGB pixels. Alpha is premultiplied while filtering
+// so transparent pixels don't bleed their color. The filter weights only
+// depend on the sizes and the filter, so they are computed once and shared.
+void resample(const uint32_t *src, int srcWidth, int srcHeight, int srcStride,
+              uint32_t *dst, int dstWidth, int dstHeight, int dstStride,
+              ResampleFilter filter);
+
+} /* namespace img */
@@ -0,0 +1,77 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include "SharedDocuments.h"
+#include "src/Logger.h"
+#include "src/platform/Platform.h"
+
+namespace img {
+
+SharedDocuments &SharedDocuments::shared() {
+    static SharedDocuments documents;
+    return documents;
+}
+
+std::shared_ptr<Rasterizer> SharedDocuments::open(const std::string &utf8Path) {
+    // links and relative paths to the same file share it
+    std::string key = utf8Path;
+    try {
+        key = platform::realPath(utf8Path);
+    } catch (const std::exception &e) {
+        // the rasterizer reports missing files
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    purge();
+
+    auto rasterizer = files[key].lock();
+    if (rasterizer) {
+        logger::verbose("Sharing open document %s", utf8Path.c_str());
+        return rasterizer;
+    }
+
+    rasterizer = std::make_shared<Rasterizer>(utf8Path);
+    files[key] = rasterizer;
+    return rasterizer;
+}
+
+std::shared_ptr<Rasterizer> SharedDocuments::open(std::shared_ptr<const std::vector<uint8_t>> data, const std::string &type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    purge();
+
+    // the rasterizer keeps the data alive, so the address can't be reused while it is open
+    auto rasterizer = buffers[data.get()].lock();
+    if (rasterizer) {
+        return rasterizer;
+    }
+
+    rasterizer = std::make_shared<Rasterizer>(data, type);
+    buffers[data.get()] = rasterizer;
+    return rasterizer;
+}
+
+void SharedDocuments::purge() {
+    for (auto it = files.begin(); it != files.end();) {
+        it = it->second.expired() ? files.erase(it) : std::next(it);
+    }
+    for (auto it = buffers.begin(); it != buffers.end();) {
+        it = it->second.expired() ? buffers.erase(it) : std::next(it);
+    }
+}
+
+} /* namespace img */
@@ -0,0 +1,51 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "Rasterizer.h"
+
+namespace img {
+
+// Rasterizers of the open documents, so that several views of the same document
+// share one parser, its parsed pages and its previews instead of each opening it.
+// A document is closed when the last view releases its rasterizer.
+class SharedDocuments {
+public:
+    static SharedDocuments &shared();
+
+    std::shared_ptr<Rasterizer> open(const std::string &utf8Path);
+    // documents in memory are shared by their data, not by their content
+    std::shared_ptr<Rasterizer> open(std::shared_ptr<const std::vector<uint8_t>> data, const std::string &type);
+
+private:
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<Rasterizer>> files;
+    std::map<const std::vector<uint8_t> *, std::weak_ptr<Rasterizer>> buffers;
+
+    SharedDocuments() = default;
+    // gets called with locked mutex
+    void purge();
+};
+
+} /* namespace img */
@@ -0,0 +1,121 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include "SpriteCache.h"
+
+namespace img {
+
+SpriteCache &SpriteCache::shared() {
+    static SpriteCache cache;
+    return cache;
+}
+
+SpriteCache::SpriteCache() {
+    stats.budget = DEFAULT_BUDGET_BYTES;
+    memoryConsumer = platform::MemoryBudget::shared().addConsumer("sprites", platform::MemoryBudget::Priority::DECODED_IMAGES,
+        [this] () { return getStats().bytes; },
+        [this] (size_t bytes) { return trim(bytes); });
+}
+
+SpriteCache::Key SpriteCache::makeKey(SpriteKind kind, int size, uint32_t color, uint16_t variant) {
+    if (size < 0 || size >= (1 << 16)) {
+        throw std::runtime_error("Sprite size out of cache range");
+    }
+    if (variant > MAX_VARIANT) {
+        throw std::runtime_error("Sprite variant out of cache range");
+    }
+
+    Key key = (uint8_t) kind;
+    key = (key << 10) | variant;
+    key = (key << 16) | (uint32_t) size;
+    key = (key << 32) | color;
+    return key;
+}
+
+size_t SpriteCache::trim(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t released = 0;
+    while (released < bytes && lru.size() > 1) {
+        auto &entry = lru.back();
+        released += entry.bytes;
+        stats.bytes -= entry.bytes;
+        index.erase(entry.key);
+        lru.pop_back();
+        stats.evictions++;
+    }
+    return released;
+}
+
+void SpriteCache::setByteBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.budget = bytes;
+    evict();
+}
+
+std::shared_ptr<const Image> SpriteCache::get(Key key, const Renderer &render) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            stats.hits++;
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->img;
+        }
+        stats.misses++;
+    }
+
+    // render unlocked, a concurrent miss for the same key just renders twice
+    std::shared_ptr<const Image> img = render();
+    if (!img) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->img;
+    }
+
+    size_t bytes = img->getMemorySize();
+    lru.push_front(Entry{key, img, bytes});
+    index.insert(std::make_pair(key, lru.begin()));
+    stats.bytes += bytes;
+    evict();
+    return img;
+}
+
+SpriteCache::Stats SpriteCache::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats res = stats;
+    res.entries = index.size();
+    return res;
+}
+
+void SpriteCache::evict() {
+    // gets called with locked mutex, always keeps the most recent sprite
+    while (stats.bytes > stats.budget && lru.size() > 1) {
+        auto &entry = lru.back();
+        stats.bytes -= entry.bytes;
+        index.erase(entry.key);
+        lru.pop_back();
+        stats.evictions++;
+    }
+}
+
+} /* namespace img */
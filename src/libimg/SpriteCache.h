@@ -0,0 +1,93 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <functional>
+#include <unordered_map>
+#include "src/platform/MemoryBudget.h"
+#include "Image.h"
+
+namespace img {
+
+enum class SpriteKind : uint8_t {
+    FILLED_CIRCLE,
+    RING,
+    NAVAID,
+    AIRPORT,
+    VOR_ROSE,
+    DME,
+    TRAFFIC,
+    WEATHER_STATION,
+    WIND_BARB,
+};
+
+// LRU cache for small pre-rendered symbols, shared by all images and maps
+// and bounded by the number of bytes used for the sprite pixels
+class SpriteCache {
+public:
+    static constexpr const size_t DEFAULT_BUDGET_BYTES = 8 * 1024 * 1024;
+
+    // kind:6 | variant:10 | size:16 | color:32
+    using Key = uint64_t;
+    using Renderer = std::function<std::shared_ptr<Image>()>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+    static SpriteCache &shared();
+    static constexpr const int MAX_VARIANT = (1 << 10) - 1;
+    static Key makeKey(SpriteKind kind, int size, uint32_t color, uint16_t variant = 0);
+
+    void setByteBudget(size_t bytes);
+    // evicts the least recently used until the given bytes are released, returns the bytes released
+    size_t trim(size_t bytes);
+
+    // returns the cached sprite, rendering it on a miss
+    std::shared_ptr<const Image> get(Key key, const Renderer &render);
+    Stats getStats();
+
+private:
+    struct Entry {
+        Key key;
+        std::shared_ptr<const Image> img;
+        size_t bytes;
+    };
+    using EntryList = std::list<Entry>;
+
+    std::mutex mutex;
+    EntryList lru; // most recently used first
+    std::unordered_map<Key, EntryList::iterator> index;
+    Stats stats;
+    platform::MemoryBudget::Registration memoryConsumer;
+
+    SpriteCache();
+    void evict();
+};
+
+} /* namespace img */
@@ -15,120 +15,44 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
-#include <stdexcept>
-#include <cmath>
+#include <cstring>
 #include "TTFStamper.h"
-#include "src/Logger.h"
-#include "src/platform/Platform.h"
-
-namespace {
-std::string fontDir;
-}
+#include "GlyphAtlas.h"
 
 namespace img {
 
-TTFStamper::TTFStamper(const std::string &fontName) {
-    auto error = FT_Init_FreeType(&ft);
-    if (error) {
-        throw std::runtime_error("Couldn't init freetype");
-    }
-
-    error = FT_New_Face(ft, platform::UTF8ToACP(fontDir + fontName).c_str(), 0, &fontFace);
-    if (error) {
-        logger::verbose("Couldn't load desired font, using fallback font");
-        loadInternalFont();
-    }
-    setSize(fontSize);
+TTFStamper::TTFStamper(const std::string &fontName):
+    atlas(GlyphAtlas::forFont(fontName))
+{
 }
 
 void TTFStamper::setFontDirectory(const std::string& dir) {
-    fontDir = dir;
+    GlyphAtlas::setFontDirectory(dir);
 }
 
-void TTFStamper::loadInternalFont() {
-    const char *encodedFont = GetDefaultCompressedFontDataTTFBase85();
-
-    // decode
-    size_t compressedSize = ((strlen(encodedFont) + 4) / 5) * 4;
-    std::vector<uint8_t> compressedData(compressedSize);
-    Decode85((const uint8_t *) encodedFont, compressedData.data());
-
-    // uncompress
-    size_t uncompressedSize = stb_decompress_length(compressedData.data());
-    fontData.resize(uncompressedSize);
-    stb_decompress(fontData.data(), compressedData.data(), compressedData.size());
-
-    auto error = FT_New_Memory_Face(ft, fontData.data(), fontData.size(), 0, &fontFace);
-    if (error) {
-        throw std::runtime_error("Couldn't load font");
-    }
+void TTFStamper::preloadFont(const std::string &fontName) {
+    GlyphAtlas::forFont(fontName);
 }
 
 void TTFStamper::setSize(float size) {
-    if (size != fontSize) {
-        fontSize = size;
-        FT_Set_Pixel_Sizes(fontFace, 0, size);
-    }
+    fontSize = size;
 }
 
 void TTFStamper::setText(const std::string& newText) {
     text = newText;
-    width = calculateTextWidth();
+    width = atlas.getTextWidth(text, fontSize);
     if (width == 0) {
         stamp.resize(0, 0, 0);
         return;
     }
     stamp.resize(width, fontSize, COLOR_TRANSPARENT);
-
-    auto slot = fontFace->glyph;
-    double baseline = std::abs(fontFace->descender) * fontSize / fontFace->units_per_EM;
-
-    size_t penX = 0;
-    for (size_t i = 0; i < newText.size(); i++) {
-        auto error = FT_Load_Char(fontFace, newText[i], FT_LOAD_RENDER);
-        if (error) {
-            continue;
-        }
-
-        size_t charWidth = slot->bitmap.width;
-        size_t charHeight = slot->bitmap.rows;
-
-        for (size_t y = 0; y < charHeight; y++) {
-            for (size_t x = 0; x < charWidth; x++) {
-                auto val = slot->bitmap.buffer[y * charWidth + x];
-                int px = penX + slot->bitmap_left + x;
-                int py = fontSize - slot->bitmap_top - baseline + y;
-                stamp.drawPixel(px, py, val << 24 | color);
-            }
-        }
-        penX += slot->advance.x / 64;
-    }
+    atlas.drawText(stamp, text, fontSize, 0, 0, color);
 }
 
 void TTFStamper::setColor(uint32_t textColor) {
     color = textColor;
 }
 
-size_t TTFStamper::calculateTextWidth() {
-    if (text.empty()) {
-        return 0;
-    }
-
-    size_t xPos = 0;
-    auto slot = fontFace->glyph;
-
-    for (size_t i = 0; i < text.size(); i++) {
-        FT_UInt glyphIndex = FT_Get_Char_Index(fontFace, text[i]);
-        auto error = FT_Load_Glyph(fontFace, glyphIndex, FT_LOAD_BITMAP_METRICS_ONLY);
-        if (error) {
-            continue;
-        }
-
-        xPos += slot->advance.x / 64;
-    }
-    return xPos;
-}
-
 size_t TTFStamper::getTextWidth(const std::string &in) {
     return width;
 }
@@ -146,11 +70,6 @@ void TTFStamper::applyStamp(Image &dst, int x, int y)
     dst.blendImage0(stamp, x, y);
 }
 
-TTFStamper::~TTFStamper() {
-    FT_Done_Face(fontFace);
-    FT_Done_FreeType(ft);
-}
-
 // The following code is taken from ImgUi
 
 //-----------------------------------------------------------------------------
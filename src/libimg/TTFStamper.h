@@ -20,12 +20,12 @@
 
 #include <string>
 #include <vector>
-#include <ft2build.h>
-#include FT_FREETYPE_H
 #include "Image.h"
 
 namespace img {
 
+class GlyphAtlas;
+
 class TTFStamper {
 public:
     TTFStamper(const std::string &fontName);
@@ -35,21 +35,17 @@ public:
     void applyStamp(Image &dst, int angle);
     void applyStamp(Image &dst, int x, int y);
     static void setFontDirectory(const std::string &dir);
+    // loads the font so that the first stamper using it doesn't have to
+    static void preloadFont(const std::string &fontName);
     size_t getTextWidth(const std::string &in);
-    ~TTFStamper();
 private:
+    GlyphAtlas &atlas;
     int fontSize = 28;
-    FT_Library ft{};
-    FT_Face fontFace{};
 
-    std::vector<uint8_t> fontData;
     uint32_t color = 0x808080;
     std::string text;
     size_t width = 0;
     Image stamp;
-
-    size_t calculateTextWidth();
-    void loadInternalFont();
 };
 
 const char* GetDefaultCompressedFontDataTTFBase85();
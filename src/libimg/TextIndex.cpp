@@ -0,0 +1,299 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <fstream>
+#include "TextIndex.h"
+#include "src/Logger.h"
+#include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
+#include "src/platform/Executor.h"
+
+namespace img {
+
+TextIndex::TextIndex(Rasterizer &rasterizer, const std::string &cacheFile):
+    rasterizer(rasterizer),
+    cacheFile(cacheFile)
+{
+    builder = platform::Executor::shared().submit("textindex", platform::Executor::Priority::BACKGROUND,
+            [this] { build(); });
+}
+
+void TextIndex::build() {
+    if (loadFromFile()) {
+        indexedPages = rasterizer.getPageCount();
+        complete = true;
+        return;
+    }
+
+    int pageCount = rasterizer.getPageCount();
+    for (int page = 0; page < pageCount; page++) {
+        if (stopBuilder) {
+            return;
+        }
+        try {
+            addPage(page, rasterizer.extractPageText(page));
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't index page %d: %s", page, e.what());
+        }
+        indexedPages = page + 1;
+    }
+
+    complete = true;
+    logger::verbose("Indexed %d pages, %d terms", pageCount, (int) terms.size());
+    storeToFile();
+}
+
+void TextIndex::addPage(int page, const std::vector<Rasterizer::TextWord> &pageWords) {
+    std::vector<std::string> pageTerms;
+
+    std::lock_guard<std::mutex> lock(indexMutex);
+    for (auto &pageWord: pageWords) {
+        // all terms of a word share its bounds, e.g. "RWY" and "27" of "RWY-27"
+        pageTerms.clear();
+        splitTerms(pageWord.text, pageTerms);
+        for (auto &term: pageTerms) {
+            Word word { 0, page, pageWord.x0, pageWord.y0, pageWord.x1, pageWord.y1 };
+            addWord(internTerm(term), word);
+        }
+    }
+}
+
+void TextIndex::addWord(uint32_t term, const Word &word) {
+    postings.at(term).push_back(words.size());
+    words.push_back(word);
+    words.back().term = term;
+}
+
+uint32_t TextIndex::internTerm(const std::string &term) {
+    auto it = termIds.find(term);
+    if (it != termIds.end()) {
+        return it->second;
+    }
+
+    uint32_t id = terms.size();
+    terms.push_back(term);
+    termIds.emplace(term, id);
+    postings.emplace_back();
+    return id;
+}
+
+std::vector<TextIndex::Hit> TextIndex::search(const std::string &query, size_t maxHits) {
+    std::vector<std::string> queryTerms;
+    splitTerms(query, queryTerms);
+    if (queryTerms.empty()) {
+        return {};
+    }
+
+    std::lock_guard<std::mutex> lock(indexMutex);
+
+    std::vector<uint32_t> exactIds;
+    for (size_t i = 0; i + 1 < queryTerms.size(); i++) {
+        auto it = termIds.find(queryTerms[i]);
+        if (it == termIds.end()) {
+            return {};
+        }
+        exactIds.push_back(it->second);
+    }
+
+    const std::string &last = queryTerms.back();
+    std::vector<uint32_t> lastIds;
+    for (auto it = termIds.lower_bound(last); it != termIds.end() && it->first.compare(0, last.size(), last) == 0; ++it) {
+        lastIds.push_back(it->second);
+    }
+    if (lastIds.empty()) {
+        return {};
+    }
+    std::sort(lastIds.begin(), lastIds.end());
+
+    // candidate positions of the first term, in reading order
+    std::vector<uint32_t> starts;
+    if (exactIds.empty()) {
+        for (uint32_t id: lastIds) {
+            starts.insert(starts.end(), postings[id].begin(), postings[id].end());
+        }
+        std::sort(starts.begin(), starts.end());
+    } else {
+        starts = postings[exactIds.front()];
+    }
+
+    std::vector<Hit> hits;
+    size_t count = queryTerms.size();
+    for (uint32_t start: starts) {
+        if (hits.size() >= maxHits) {
+            break;
+        }
+        if (start + count > words.size()) {
+            continue;
+        }
+
+        const Word &first = words[start];
+        Hit hit { first.page, first.x0, first.y0, first.x1, first.y1 };
+        bool match = true;
+        for (size_t i = 1; i < count && match; i++) {
+            const Word &word = words[start + i];
+            if (word.page != first.page) {
+                match = false;
+            } else if (i + 1 < count) {
+                match = (word.term == exactIds[i]);
+            } else {
+                match = std::binary_search(lastIds.begin(), lastIds.end(), word.term);
+            }
+            hit.x0 = std::min(hit.x0, word.x0);
+            hit.y0 = std::min(hit.y0, word.y0);
+            hit.x1 = std::max(hit.x1, word.x1);
+            hit.y1 = std::max(hit.y1, word.y1);
+        }
+
+        if (match) {
+            hits.push_back(hit);
+        }
+    }
+
+    return hits;
+}
+
+int TextIndex::getIndexedPages() const {
+    return indexedPages;
+}
+
+bool TextIndex::isComplete() const {
+    return complete;
+}
+
+void TextIndex::splitTerms(const std::string &text, std::vector<std::string> &out) {
+    // ASCII is folded to lower case, other UTF-8 characters are kept as they are
+    std::string term;
+    for (char c: text) {
+        unsigned char u = c;
+        if (u >= 0x80 || std::isalnum(u)) {
+            term += (u < 0x80) ? (char) std::tolower(u) : c;
+        } else if (!term.empty()) {
+            out.push_back(term);
+            term.clear();
+        }
+    }
+    if (!term.empty()) {
+        out.push_back(term);
+    }
+}
+
+bool TextIndex::loadFromFile() {
+    if (cacheFile.empty() || !platform::fileExists(cacheFile)) {
+        return false;
+    }
+
+    try {
+        platform::MappedFile file(cacheFile);
+        const char *pos = file.data();
+        const char *end = pos + file.size();
+
+        auto get = [&pos, end] () {
+            uint32_t value;
+            if (end - pos < (ptrdiff_t) sizeof(value)) {
+                throw std::runtime_error("Truncated index");
+            }
+            std::memcpy(&value, pos, sizeof(value));
+            pos += sizeof(value);
+            return value;
+        };
+
+        if (get() != FILE_MAGIC || get() != FILE_VERSION) {
+            throw std::runtime_error("Unknown index format");
+        }
+        if ((int) get() != rasterizer.getPageCount()) {
+            throw std::runtime_error("Index of a different document");
+        }
+
+        std::lock_guard<std::mutex> lock(indexMutex);
+        uint32_t termCount = get();
+        for (uint32_t i = 0; i < termCount; i++) {
+            uint32_t len = get();
+            if ((size_t) (end - pos) < len) {
+                throw std::runtime_error("Truncated index");
+            }
+            internTerm(std::string(pos, len));
+            pos += len;
+        }
+
+        uint32_t wordCount = get();
+        if ((size_t) (end - pos) / sizeof(Word) < wordCount) {
+            throw std::runtime_error("Truncated index");
+        }
+        words.reserve(wordCount);
+        for (uint32_t i = 0; i < wordCount; i++) {
+            Word word;
+            std::memcpy(&word, pos, sizeof(word));
+            pos += sizeof(word);
+            if (word.term >= termCount) {
+                throw std::runtime_error("Invalid term");
+            }
+            addWord(word.term, word);
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't load text index %s: %s", cacheFile.c_str(), e.what());
+        std::lock_guard<std::mutex> lock(indexMutex);
+        terms.clear();
+        termIds.clear();
+        words.clear();
+        postings.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void TextIndex::storeToFile() {
+    if (cacheFile.empty()) {
+        return;
+    }
+
+    // a crash never leaves a truncated index behind
+    try {
+        platform::mkpath(platform::getDirNameFromPath(cacheFile));
+        platform::writeFileAtomically(cacheFile, [this] (std::ostream &stream) {
+            auto put = [&stream] (uint32_t value) {
+                stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+            };
+
+            std::lock_guard<std::mutex> lock(indexMutex);
+            put(FILE_MAGIC);
+            put(FILE_VERSION);
+            put(rasterizer.getPageCount());
+            put(terms.size());
+            for (auto &term: terms) {
+                put(term.size());
+                stream.write(term.data(), term.size());
+            }
+            put(words.size());
+            stream.write(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(Word));
+        });
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't store text index %s: %s", cacheFile.c_str(), e.what());
+    }
+}
+
+TextIndex::~TextIndex() {
+    stopBuilder = true;
+    builder->cancel();
+    builder->wait();
+}
+
+} /* namespace img */
@@ -0,0 +1,91 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "Rasterizer.h"
+#include "src/platform/Executor.h"
+
+namespace img {
+
+// Full-text index of a document, built from the pages' text in a background thread.
+// Terms are the lower case letters and digits between spaces and punctuation.
+class TextIndex {
+public:
+    // bounds in unrotated page units, see Rasterizer::pageToPixels
+    struct Hit {
+        int page;
+        float x0, y0, x1, y1;
+    };
+
+    // The index is stored in cacheFile once it is complete and loaded from there
+    // instead of parsing the document again. No file is used if cacheFile is empty.
+    TextIndex(Rasterizer &rasterizer, const std::string &cacheFile);
+
+    // Hits of the query's terms following each other in reading order, the
+    // last term also matches the start of longer ones. Can be used while the
+    // index is being built, then it only searches the pages indexed so far.
+    std::vector<Hit> search(const std::string &query, size_t maxHits);
+    int getIndexedPages() const;
+    bool isComplete() const;
+
+    ~TextIndex();
+private:
+    static constexpr const uint32_t FILE_MAGIC = 0x58444954; // "TIDX"
+    static constexpr const uint32_t FILE_VERSION = 1;
+
+    struct Word {
+        uint32_t term;
+        int32_t page;
+        float x0, y0, x1, y1;
+    };
+
+    Rasterizer &rasterizer;
+    std::string cacheFile;
+
+    // the builder appends whole pages, searches see them once they are complete
+    mutable std::mutex indexMutex;
+    std::vector<std::string> terms;
+    // term ids by term, sorted so that prefixes are neighbours
+    std::map<std::string, uint32_t> termIds;
+    // every term of the document in reading order
+    std::vector<Word> words;
+    // positions in words by term id
+    std::vector<std::vector<uint32_t>> postings;
+
+    std::atomic_int indexedPages { 0 };
+    std::atomic_bool complete { false };
+    std::atomic_bool stopBuilder { false };
+    std::shared_ptr<platform::Executor::Job> builder;
+
+    void build();
+    void addPage(int page, const std::vector<Rasterizer::TextWord> &pageWords);
+    void addWord(uint32_t term, const Word &word);
+    uint32_t internTerm(const std::string &term);
+    bool loadFromFile();
+    void storeToFile();
+    static void splitTerms(const std::string &text, std::vector<std::string> &out);
+};
+
+} /* namespace img */
@@ -16,7 +16,10 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
 #include "XTiffImage.h"
+#include "Resampler.h"
 #include "src/platform/Platform.h"
 #include "src/Logger.h"
 
@@ -27,6 +30,19 @@ namespace {
     void onTiffError(const char *, const char *, va_list) {
         throw std::runtime_error("TIFF error");
     }
+
+    // libtiff actually loads ABGR and there is no easy way to change that
+    void swapRedBlue(uint32_t *pixels, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            uint32_t c = pixels[i];
+            pixels[i] = (c & 0xFF00FF00) | ((c & 0x00FF0000) >> 16) | ((c & 0x000000FF) << 16);
+        }
+    }
+
+    img::ResampleFilter filterFor(int srcWidth, int dstWidth) {
+        // regions are scaled down in bands, the box filter doesn't reach across them
+        return (srcWidth > dstWidth) ? img::ResampleFilter::AREA : img::ResampleFilter::LANCZOS3;
+    }
 }
 
 namespace img {
@@ -50,6 +66,44 @@ void XTiffImage::loadTIFF(const std::string& utf8Path) {
         XTIFFClose(tif);
         throw std::runtime_error("TIFF has no height");
     }
+
+    // a single strip for the whole image is common, it can't be read in parts
+    hugeStrips = !TIFFIsTiled(tif) && (size_t) TIFFStripSize(tif) > MAX_STRIP_BYTES;
+
+    levels.push_back(Level {fullWidth, fullHeight, 0, nullptr});
+    findOverviews();
+}
+
+void XTiffImage::findOverviews() {
+    // overviews are stored as reduced-resolution images in the following directories,
+    // e.g. by gdaladdo. The reader stays on the main image afterwards.
+    try {
+        int count = TIFFNumberOfDirectories(tif);
+        for (int dir = 1; dir < count && TIFFSetDirectory(tif, dir); dir++) {
+            uint32_t subfileType = 0;
+            int width = 0, height = 0;
+            if (!TIFFGetField(tif, TIFFTAG_SUBFILETYPE, &subfileType) || !(subfileType & FILETYPE_REDUCEDIMAGE)) {
+                continue;
+            }
+            if (!TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) || !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height)) {
+                continue;
+            }
+            if (width <= 0 || height <= 0 || width >= fullWidth || (!TIFFIsTiled(tif) && (size_t) TIFFStripSize(tif) > MAX_STRIP_BYTES)) {
+                continue;
+            }
+            levels.push_back(Level {width, height, dir, nullptr});
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't read the TIFF overviews: %s", e.what());
+    }
+
+    if (!TIFFSetDirectory(tif, 0)) {
+        XTIFFClose(tif);
+        throw std::runtime_error("Couldn't read TIFF directory");
+    }
+
+    std::sort(levels.begin(), levels.end(), [] (const Level &a, const Level &b) { return a.width > b.width; });
+    logger::verbose("TIFF has %d overviews", (int) levels.size() - 1);
 }
 
 int XTiffImage::getFullWidth() {
@@ -65,31 +119,199 @@ void* XTiffImage::getXtiffHandle() {
 }
 
 void XTiffImage::loadFullImage() {
+    std::lock_guard<std::mutex> lock(tiffMutex);
+    decodeFullImage();
+}
+
+void XTiffImage::decodeFullImage() {
+    // called with tiffMutex held
     if (fullImageLoaded) {
         return;
     }
 
     resize(fullWidth, fullHeight, 0);
-    if (!TIFFReadRGBAImageOriented(tif, fullWidth, fullHeight, getPixels(), ORIENTATION_TOPLEFT, 0)) {
+    readPixels(0, 0, 0, fullWidth, fullHeight, getPixels());
+
+    for (auto &level: levels) {
+        if (level.directory == 0) {
+            level.memory = this;
+        }
+    }
+    fullImageLoaded = true;
+}
+
+void XTiffImage::readRegion(int x, int y, int width, int height, Image &dst) {
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > fullWidth || y + height > fullHeight) {
+        throw std::runtime_error("Invalid TIFF region");
+    }
+
+    std::lock_guard<std::mutex> lock(tiffMutex);
+
+    double reduction = (double) width / dst.getWidth();
+    Level level = chooseLevel(reduction);
+
+    // the zoomed out views of large images need overviews, which many files don't have
+    bool coarse = (double) fullWidth / level.width < GENERATED_OVERVIEW_FACTOR;
+    bool large = std::max(fullWidth, fullHeight) / GENERATED_OVERVIEW_FACTOR >= MIN_OVERVIEW_SIZE;
+    if (reduction >= GENERATED_OVERVIEW_FACTOR && coarse && large && !overviewBuilder) {
+        overviewBuilder = platform::Executor::shared().submit("overviews", platform::Executor::Priority::BACKGROUND,
+                [this] { buildOverviews(); });
+    }
+
+    if (level.directory == 0 && hugeStrips && !fullImageLoaded) {
+        decodeFullImage();
+        level = chooseLevel(reduction);
+    }
+
+    double scaleX = (double) level.width / fullWidth;
+    double scaleY = (double) level.height / fullHeight;
+    int x0 = std::floor(x * scaleX);
+    int y0 = std::floor(y * scaleY);
+    int x1 = std::min(level.width, std::max(x0 + 1, (int) std::ceil((x + width) * scaleX)));
+    int y1 = std::min(level.height, std::max(y0 + 1, (int) std::ceil((y + height) * scaleY)));
+    readLevel(level, x0, y0, x1 - x0, y1 - y0, dst);
+}
+
+XTiffImage::Level XTiffImage::chooseLevel(double reduction) const {
+    // the smallest level that still has at least the requested resolution
+    Level best = levels.front();
+    for (auto &level: levels) {
+        if ((double) fullWidth / level.width <= reduction * 1.01) {
+            best = level;
+        }
+    }
+    return best;
+}
+
+void XTiffImage::readLevel(const Level &level, int x, int y, int width, int height, Image &dst) {
+    int dstWidth = dst.getWidth();
+    int dstHeight = dst.getHeight();
+    auto filter = filterFor(width, dstWidth);
+
+    if (level.memory) {
+        auto src = level.memory->getPixels() + (size_t) y * level.width + x;
+        resample(src, width, height, level.width, dst.getPixels(), dstWidth, dstHeight, dstWidth, filter);
+        return;
+    }
+
+    // destination rows are decoded in bands, each from the source rows that map to them
+    int rowsPerBand = std::max(1, (int) ((double) BAND_PIXELS / width * dstHeight / height));
+    std::vector<uint32_t> band;
+    for (int row = 0; row < dstHeight; row += rowsPerBand) {
+        int rows = std::min(rowsPerBand, dstHeight - row);
+        int srcY0 = y + (int) ((int64_t) row * height / dstHeight);
+        int srcY1 = y + (int) ((int64_t) (row + rows) * height / dstHeight);
+        srcY1 = std::min(y + height, std::max(srcY0 + 1, srcY1));
+
+        band.resize((size_t) width * (srcY1 - srcY0));
+        readPixels(level.directory, x, srcY0, width, srcY1 - srcY0, band.data());
+        resample(band.data(), width, srcY1 - srcY0, width, dst.getPixels() + (size_t) row * dstWidth, dstWidth, rows, dstWidth, filter);
+    }
+}
+
+void XTiffImage::readPixels(int directory, int x, int y, int width, int height, uint32_t *raster) {
+    // called with tiffMutex held
+    if (TIFFCurrentDirectory(tif) != directory && !TIFFSetDirectory(tif, directory)) {
+        throw std::runtime_error("Couldn't read TIFF directory");
+    }
+
+    char error[1024] = "";
+    TIFFRGBAImage rgba {};
+    if (!TIFFRGBAImageBegin(&rgba, tif, 0, error)) {
+        throw std::runtime_error(std::string("Couldn't read TIFF: ") + error);
+    }
+
+    // libtiff only decodes the tiles or strips covering the region
+    rgba.req_orientation = ORIENTATION_TOPLEFT;
+    rgba.row_offset = y;
+    rgba.col_offset = x;
+    int ok = 0;
+    try {
+        ok = TIFFRGBAImageGet(&rgba, raster, width, height);
+    } catch (...) {
+        TIFFRGBAImageEnd(&rgba);
+        throw;
+    }
+    TIFFRGBAImageEnd(&rgba);
+
+    if (!ok) {
         throw std::runtime_error("Couldn't read TIFF");
     }
 
-    uint8_t *data = (uint8_t *) getPixels();
+    swapRedBlue(raster, (size_t) width * height);
+}
+
+void XTiffImage::buildOverviews() {
+    logger::info("Generating overviews for %dx%d TIFF", fullWidth, fullHeight);
 
-    // libtiff actually loads ARGB and there is no easy way to change that
-    for (int y = 0; y < fullHeight; y++) {
-        for (int x = 0; x < fullWidth; x++) {
-            int g = data[4 * x + 2];
-            data[4 * x + 2] = data[4 * x + 0];
-            data[4 * x + 0] = g;
+    int width = std::ceil((double) fullWidth / GENERATED_OVERVIEW_FACTOR);
+    int height = std::ceil((double) fullHeight / GENERATED_OVERVIEW_FACTOR);
+    auto overview = std::make_unique<Image>(width, height, 0);
+
+    // one pass over the largest overview of the file that is detailed enough, or the image itself.
+    // The lock is released between the bands so that tiles keep loading meanwhile.
+    Level source {};
+    try {
+        std::lock_guard<std::mutex> lock(tiffMutex);
+        source = chooseLevel(GENERATED_OVERVIEW_FACTOR);
+        if (source.directory == 0 && hugeStrips) {
+            decodeFullImage();
+            source = chooseLevel(GENERATED_OVERVIEW_FACTOR);
         }
-        data += 4 * fullWidth;
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't generate TIFF overviews: %s", e.what());
+        return;
     }
 
-    fullImageLoaded = true;
+    double srcRowsPerRow = (double) source.height / height;
+    int rowsPerBand = std::max(1, (int) (BAND_PIXELS / source.width / srcRowsPerRow));
+    try {
+        for (int row = 0; row < height; row += rowsPerBand) {
+            if (stopOverviewBuilder) {
+                return;
+            }
+            int rows = std::min(rowsPerBand, height - row);
+            int srcY0 = (int) ((int64_t) row * source.height / height);
+            int srcY1 = std::min(source.height, std::max(srcY0 + 1, (int) ((int64_t) (row + rows) * source.height / height)));
+
+            Image band(width, rows, 0);
+            {
+                std::lock_guard<std::mutex> lock(tiffMutex);
+                readLevel(source, 0, srcY0, source.width, srcY1 - srcY0, band);
+            }
+            std::copy(band.getPixels(), band.getPixels() + (size_t) width * rows, overview->getPixels() + (size_t) row * width);
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't generate TIFF overviews: %s", e.what());
+        return;
+    }
+
+    // the smaller levels are halvings of the first one
+    std::vector<std::unique_ptr<Image>> overviews;
+    overviews.push_back(std::move(overview));
+    while (std::max(overviews.back()->getWidth(), overviews.back()->getHeight()) > MIN_OVERVIEW_SIZE) {
+        auto &prev = *overviews.back();
+        auto next = std::make_unique<Image>((prev.getWidth() + 1) / 2, (prev.getHeight() + 1) / 2, 0);
+        resample(prev.getPixels(), prev.getWidth(), prev.getHeight(), prev.getWidth(),
+                next->getPixels(), next->getWidth(), next->getHeight(), next->getWidth(), ResampleFilter::AREA);
+        overviews.push_back(std::move(next));
+    }
+
+    std::lock_guard<std::mutex> lock(tiffMutex);
+    for (auto &image: overviews) {
+        levels.push_back(Level {image->getWidth(), image->getHeight(), -1, image.get()});
+        generatedOverviews.push_back(std::move(image));
+    }
+    std::sort(levels.begin(), levels.end(), [] (const Level &a, const Level &b) { return a.width > b.width; });
+    logger::info("Generated %d TIFF overviews", (int) overviews.size());
 }
 
 XTiffImage::~XTiffImage() {
+    if (overviewBuilder) {
+        stopOverviewBuilder = true;
+        overviewBuilder->cancel();
+        overviewBuilder->wait();
+    }
     XTIFFClose(tif);
 }
 
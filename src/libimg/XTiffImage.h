@@ -19,8 +19,13 @@
 #define SRC_LIBIMG_XTIFFIMAGE_H_
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <xtiffio.h>
 #include "Image.h"
+#include "src/platform/Executor.h"
 
 namespace img {
 
@@ -39,11 +44,47 @@ public:
     // loads the whole image into memory if not already done
     void loadFullImage();
 
+    // Decodes a region of the full image, scaled to the size of dst. Only the TIFF
+    // tiles or strips covering the region are read, from the smallest overview that
+    // still has the required resolution. Can be called from several threads.
+    void readRegion(int x, int y, int width, int height, Image &dst);
+
     ~XTiffImage();
 private:
+    // pixels decoded at once, bounds the memory needed for zoomed out regions
+    static constexpr const size_t BAND_PIXELS = 4 * 1024 * 1024;
+    // strips larger than this are decoded once for the whole image instead of for each region
+    static constexpr const size_t MAX_STRIP_BYTES = 64 * 1024 * 1024;
+    // files without overviews get generated ones from this reduction on, down to about a tile
+    static constexpr const int GENERATED_OVERVIEW_FACTOR = 8;
+    static constexpr const int MIN_OVERVIEW_SIZE = 512;
+
+    // the full image or one of its overviews
+    struct Level {
+        int width, height;
+        // TIFF directory or -1 if the level is in memory
+        int directory;
+        const Image *memory;
+    };
+
     int fullWidth = 0, fullHeight = 0;
     bool fullImageLoaded = false;
     TIFF *tif{};
+
+    // guards the TIFF handle and the levels, ordered by decreasing size
+    std::mutex tiffMutex;
+    std::vector<Level> levels;
+    bool hugeStrips = false;
+    std::vector<std::unique_ptr<Image>> generatedOverviews;
+    std::shared_ptr<platform::Executor::Job> overviewBuilder;
+    std::atomic_bool stopOverviewBuilder { false };
+
+    void findOverviews();
+    void decodeFullImage();
+    Level chooseLevel(double reduction) const;
+    void readLevel(const Level &level, int x, int y, int width, int height, Image &dst);
+    void readPixels(int directory, int x, int y, int width, int height, uint32_t *raster);
+    void buildOverviews();
 };
 
 } /* namespace img */
@@ -16,8 +16,10 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <cmath>
+#include <algorithm>
 #include "Stitcher.h"
 #include "src/Logger.h"
+#include "src/platform/FrameProfiler.h"
 
 namespace img {
 
@@ -35,10 +37,24 @@ Stitcher::Stitcher(std::shared_ptr<Image> dstImage, std::shared_ptr<TileSource>
     unrotatedImage = std::make_shared<Image>(max, max, 0);
 }
 
+void Stitcher::resizeUnrotatedImage() {
+    int w = dstImage->getWidth();
+    int h = dstImage->getHeight();
+    int side = freeRotation ? (int) std::ceil(std::sqrt((double) w * w + (double) h * h)) : std::max(w, h);
+    if (unrotatedImage->getWidth() != side || unrotatedImage->getHeight() != side) {
+        // resized in place, the overlays keep drawing onto the same image
+        unrotatedImage->resize(side, side, 0);
+    }
+}
+
 void Stitcher::setCacheDirectory(const std::string& utf8Path) {
     tileCache.setCacheDirectory(utf8Path);
 }
 
+void Stitcher::setCacheArchive(const std::string& utf8Path) {
+    tileCache.setCacheArchive(utf8Path);
+}
+
 void Stitcher::setRedrawCallback(RedrawCallback cb) {
     onRedraw = cb;
 }
@@ -47,6 +63,51 @@ void Stitcher::setPreRotateCallback(PreRotateCallback cb) {
     onPreRotate = cb;
 }
 
+int Stitcher::addLayer(std::shared_ptr<TileSource> source, const LayerOptions &options, const std::string &utf8CacheDir) {
+    auto layer = std::make_unique<Layer>();
+    layer->id = nextLayerId++;
+    layer->source = source;
+    layer->cache = std::make_unique<TileCache>(source);
+    layer->cache->setCacheDirectory(utf8CacheDir);
+    layer->options = options;
+
+    int id = layer->id;
+    layers.push_back(std::move(layer));
+    invalidateLayers();
+    return id;
+}
+
+void Stitcher::setLayerOptions(int id, const LayerOptions &options) {
+    for (auto &layer: layers) {
+        if (layer->id == id) {
+            layer->options = options;
+            invalidateLayers();
+            return;
+        }
+    }
+}
+
+void Stitcher::removeLayer(int id) {
+    auto it = std::find_if(layers.begin(), layers.end(), [id] (const std::unique_ptr<Layer> &l) { return l->id == id; });
+    if (it != layers.end()) {
+        layers.erase(it);
+        invalidateLayers();
+    }
+}
+
+void Stitcher::invalidateLayers() {
+    stackCache.clear();
+    composition.valid = false;
+    updateImage();
+}
+
+void Stitcher::cancelPendingRequests() {
+    tileCache.cancelPendingRequests();
+    for (auto &layer: layers) {
+        layer->cache->cancelPendingRequests();
+    }
+}
+
 void Stitcher::setCenter(double x, double y) {
     if (std::abs(centerX - x) > 0.00001 || std::abs(centerY - y) > 0.00001) {
         centerX = x;
@@ -62,7 +123,7 @@ img::Point<double> Stitcher::getCenter() const {
 bool Stitcher::nextPage() {
     if (page + 1 < tileSource->getPageCount()) {
         page++;
-        tileCache.cancelPendingRequests();
+        cancelPendingRequests();
         updateImage();
         return true;
     }
@@ -72,13 +133,37 @@ bool Stitcher::nextPage() {
 bool Stitcher::prevPage() {
     if (page > 0) {
         page--;
-        tileCache.cancelPendingRequests();
+        cancelPendingRequests();
         updateImage();
         return true;
     }
     return false;
 }
 
+bool Stitcher::setPage(int newPage) {
+    if (newPage < 0 || newPage >= tileSource->getPageCount()) {
+        return false;
+    }
+    if (newPage != page) {
+        page = newPage;
+        cancelPendingRequests();
+        updateImage();
+    }
+    return true;
+}
+
+void Stitcher::setContinuousPages(bool continuous) {
+    if (continuous != continuousPages) {
+        continuousPages = continuous;
+        composition.valid = false;
+        updateImage();
+    }
+}
+
+bool Stitcher::isContinuousPages() const {
+    return continuousPages;
+}
+
 int Stitcher::getPageCount() const {
     return tileSource->getPageCount();
 }
@@ -89,23 +174,31 @@ int Stitcher::getCurrentPage() const {
 
 void Stitcher::pan(int dx, int dy) {
     auto dim = tileSource->getTileDimensions(zoomLevel);
-    switch (rotAngle) {
-    case 0:
-        centerX += dx / (double) dim.x;
-        centerY += dy / (double) dim.y;
-        break;
-    case 90:
-        centerX += dy / (double) dim.y;
-        centerY -= dx / (double) dim.x;
-        break;
-    case 180:
-        centerX -= dx / (double) dim.x;
-        centerY -= dy / (double) dim.y;
-        break;
-    case 270:
-        centerX -= dy / (double) dim.y;
-        centerY += dx / (double) dim.x;
-        break;
+    if (isRightAngle(rotAngle)) {
+        switch ((int) rotAngle) {
+        case 0:
+            centerX += dx / (double) dim.x;
+            centerY += dy / (double) dim.y;
+            break;
+        case 90:
+            centerX += dy / (double) dim.y;
+            centerY -= dx / (double) dim.x;
+            break;
+        case 180:
+            centerX -= dx / (double) dim.x;
+            centerY -= dy / (double) dim.y;
+            break;
+        case 270:
+            centerX -= dy / (double) dim.y;
+            centerY += dx / (double) dim.x;
+            break;
+        }
+    } else {
+        // the pan direction on screen rotated back onto the map
+        double rad = rotAngle * M_PI / 180.0;
+        double c = std::cos(rad), s = std::sin(rad);
+        centerX += (dx * c + dy * s) / dim.x;
+        centerY += (dy * c - dx * s) / dim.y;
     }
     tileSource->constrainXY(centerX, centerY, zoomLevel);
     updateImage();
@@ -116,12 +209,14 @@ void Stitcher::setZoomLevel(int level) {
         return;
     }
 
+    zoomGestureActive = false;
+
     auto newCenterXY = tileSource->transformZoomedPoint(page, centerX, centerY, zoomLevel, level);
     centerX = newCenterXY.x;
     centerY = newCenterXY.y;
     zoomLevel = level;
 
-    tileCache.cancelPendingRequests();
+    cancelPendingRequests();
 
     updateImage();
 }
@@ -130,6 +225,45 @@ int Stitcher::getZoomLevel() {
     return zoomLevel;
 }
 
+void Stitcher::zoomBy(int delta) {
+    int target = (zoomGestureActive ? gestureZoom : zoomLevel) + delta;
+    target = std::max(tileSource->getMinZoomLevel(), std::min(target, tileSource->getMaxZoomLevel()));
+
+    if (!zoomGestureActive) {
+        if (target == zoomLevel) {
+            return;
+        }
+        // the current view including the overlays, it stays valid until the gesture ends
+        zoomSnapshot.resize(unrotatedImage->getWidth(), unrotatedImage->getHeight(), 0);
+        zoomSnapshot.drawImage(*unrotatedImage, 0, 0);
+        snapshotX = centerX;
+        snapshotY = centerY;
+        zoomGestureActive = true;
+    }
+
+    gestureZoom = target;
+    lastGestureStep = std::chrono::steady_clock::now();
+
+    if (std::abs(gestureZoom - zoomLevel) > MAX_ZOOM_GESTURE_DELTA) {
+        // too blurry or too small to be useful, so load the tiles right away
+        commitZoomGesture();
+    } else if (gestureZoom == zoomLevel) {
+        // back where it started, the composition is still there
+        zoomGestureActive = false;
+        updateImage();
+    } else {
+        updateImage();
+    }
+}
+
+bool Stitcher::isZooming() const {
+    return zoomGestureActive;
+}
+
+void Stitcher::commitZoomGesture() {
+    setZoomLevel(gestureZoom);
+}
+
 std::shared_ptr<Image> Stitcher::getPreRotatedImage() {
     return unrotatedImage;
 }
@@ -147,113 +281,758 @@ void Stitcher::convertSourceImageToRenderedCoords(int &x, int &y) {
     int unrotatedCentreY = unrotatedImage->getHeight() / 2;
     int dstCentreX = dstImage->getWidth() / 2;
     int dstCentreY = dstImage->getHeight() / 2;
-    int offsetX = unrotatedCentreX - dstCentreX;
-    int offsetY = unrotatedCentreY - dstCentreY;
-    x += offsetX;
-    y += offsetY;
+
+    // undo the rotation around the centers, see Image::rotateBilinear
+    double rad = rotAngle * M_PI / 180.0;
+    double c = std::cos(rad), s = std::sin(rad);
+    double dx = x - dstCentreX;
+    double dy = y - dstCentreY;
+    x = unrotatedCentreX + (int) std::lround(dx * c + dy * s);
+    y = unrotatedCentreY + (int) std::lround(dy * c - dx * s);
 }
 
 int Stitcher::getRotation() const {
+    return ((int) std::lround(rotAngle)) % 360;
+}
+
+double Stitcher::getRotationAngle() const {
     return rotAngle;
 }
 
 void Stitcher::rotateRight() {
-    rotAngle = (rotAngle + 90) % 360;
+    rotAngle = std::fmod(std::round(rotAngle / 90) * 90 + 90, 360);
     updateImage();
 }
 
-void Stitcher::forEachTileInView(std::function<void(int, int, img::Image &)> f) {
+void Stitcher::setRotation(double angle) {
+    angle = std::fmod(angle, 360);
+    if (angle < 0) {
+        angle += 360;
+    }
+
+    double delta = std::abs(angle - rotAngle);
+    delta = std::min(delta, 360 - delta);
+    if (delta < ROTATION_HYSTERESIS && !isRightAngle(angle)) {
+        return;
+    }
+
+    if (angle != rotAngle) {
+        rotAngle = angle;
+        if (!isRightAngle(angle)) {
+            // stays enlarged so that a heading passing through north doesn't resize it twice
+            freeRotation = true;
+        }
+        updateImage();
+    }
+}
+
+bool Stitcher::isRightAngle(double angle) {
+    return std::fmod(angle, 90) == 0;
+}
+
+Stitcher::ViewLayout Stitcher::computeLayout() const {
+    ViewLayout layout;
     auto dim = tileSource->getTileDimensions(zoomLevel);
-    int tileEdgeWidth = dim.x;
-    int tileEdgeHeight = dim.y;
+    layout.tileWidth = dim.x;
+    layout.tileHeight = dim.y;
     int dstWidth = unrotatedImage->getWidth();
     int dstHeight = unrotatedImage->getHeight();
 
     // The center pixel's position offset inside the center tile
-    int xOff = (centerX - (int) centerX) * tileEdgeWidth;
-    int yOff = (centerY - (int) centerY) * tileEdgeHeight;
+    layout.xOff = (centerX - (int) centerX) * layout.tileWidth;
+    layout.yOff = (centerY - (int) centerY) * layout.tileHeight;
 
     // Center tile's upper left position so that the center pixel's position will be at the image center
-    int centerPosX = dstWidth / 2 - xOff;
-    int centerPosY = dstHeight / 2 - yOff;
+    layout.centerPosX = dstWidth / 2 - layout.xOff;
+    layout.centerPosY = dstHeight / 2 - layout.yOff;
+
+    layout.radiusX = (dstWidth / 2.0) / layout.tileWidth + 1;
+    layout.radiusY = (dstHeight / 2.0) / layout.tileHeight + 1;
 
-    int radiusX = (dstWidth / 2.0) / tileEdgeWidth + 1;
-    int radiusY = (dstHeight / 2.0) / tileEdgeHeight + 1;
+    if (continuousPages && (size_t) page < pageRows.size()) {
+        layout.rowBase = pageRows[page];
+    }
+    return layout;
+}
 
-    emptyTile.resize(tileEdgeWidth, tileEdgeHeight, img::COLOR_TRANSPARENT);
-    errorTile.resize(tileEdgeWidth, tileEdgeHeight, img::COLOR_RED);
-    loadingTile.resize(tileEdgeWidth, tileEdgeHeight, img::COLOR_BLACK);
+void Stitcher::forEachTileInView(const ViewLayout &layout, std::function<void(const ViewTile &)> f) {
+    // load the tiles closest to the center first and drop those out of sight
+    if (continuousPages) {
+        int centerRow = layout.rowBase + (int) centerY;
+        int totalRows = pageRows.empty() ? 0 : pageRows.back();
+        int firstPage = page, lastPage = page, pageY;
+        locateRow(std::max(0, centerRow - layout.radiusY - 1), firstPage, pageY);
+        locateRow(std::min(totalRows - 1, centerRow + layout.radiusY + 1), lastPage, pageY);
+        firstPage = std::min(firstPage, page);
+        lastPage = std::max(lastPage, page);
 
-    pendingTiles = false;
+        double row = layout.rowBase + centerY;
+        tileCache.setStackedFocus(pageRows, firstPage, lastPage, centerX, row, zoomLevel, layout.radiusX, layout.radiusY);
+        for (auto &layer: layers) {
+            layer->cache->setStackedFocus(pageRows, firstPage, lastPage, centerX, row, zoomLevel, layout.radiusX, layout.radiusY);
+        }
+    } else {
+        tileCache.setFocus(page, centerX, centerY, zoomLevel, layout.radiusX, layout.radiusY);
+        for (auto &layer: layers) {
+            layer->cache->setFocus(page, centerX, centerY, zoomLevel, layout.radiusX, layout.radiusY);
+        }
+    }
+
+    for (int y = -layout.radiusY; y <= layout.radiusY; y++) {
+        for (int x = -layout.radiusX; x <= layout.radiusX; x++) {
+            ViewTile tile;
+            tile.x = layout.centerPosX + x * layout.tileWidth;
+            tile.y = layout.centerPosY + y * layout.tileHeight;
+            tile.page = page;
+            tile.tileX = ((int) centerX) + x;
+            tile.tileY = ((int) centerY) + y;
+            tile.row = layout.rowBase + tile.tileY;
+
+            if (continuousPages && !locateRow(tile.row, tile.page, tile.tileY)) {
+                // above the first or below the last page
+                tile.page = -1;
+            }
+
+            f(tile);
+        }
+    }
+
+    // Due to rounding and precision, the actual drawn center will be a few
+    // pixels off the requested center.
+    // Ensure that we return the actual drawn center instead of the requested one.
+    centerX = ((int) centerX) + layout.xOff / (double) layout.tileWidth;
+    centerY = ((int) centerY) + layout.yOff / (double) layout.tileHeight;
+}
+
+void Stitcher::updatePageRows() {
+    int pageCount = tileSource->getPageCount();
+    if (pageRowsZoom == zoomLevel && pageRows.size() == (size_t) pageCount + 1) {
+        return;
+    }
+
+    // every page starts in a new row, the rest of its last row stays empty
+    int tileHeight = std::max(1, tileSource->getTileDimensions(zoomLevel).y);
+    pageRows.clear();
+    pageRows.reserve(pageCount + 1);
+    int row = 0;
+    for (int i = 0; i < pageCount; i++) {
+        pageRows.push_back(row);
+        int height = tileSource->getPageDimensions(i, zoomLevel).y;
+        row += std::max(1, (height + tileHeight - 1) / tileHeight);
+    }
+    pageRows.push_back(row);
+    pageRowsZoom = zoomLevel;
+}
+
+bool Stitcher::locateRow(int row, int &rowPage, int &pageY) const {
+    if (pageRows.size() < 2 || row < 0 || row >= pageRows.back()) {
+        return false;
+    }
+
+    auto it = std::upper_bound(pageRows.begin(), pageRows.end(), row);
+    rowPage = (it - pageRows.begin()) - 1;
+    pageY = row - pageRows[rowPage];
+    return true;
+}
+
+void Stitcher::followCenterPage() {
+    // the page at the center becomes the current one without reloading anything
+    int lastPage = (int) pageRows.size() - 2;
+    if (lastPage < 0 || page > lastPage) {
+        return;
+    }
+
+    int row = pageRows[page] + (int) std::floor(centerY);
+    int rowPage = page, pageY;
+    if (!locateRow(row, rowPage, pageY)) {
+        rowPage = (row < 0) ? 0 : lastPage;
+    }
+
+    if (rowPage != page) {
+        centerY += pageRows[page] - pageRows[rowPage];
+        page = rowPage;
+    }
+}
+
+Image &Stitcher::resolveTile(int tilePage, int tileX, int tileY, bool &isFinal) {
+    isFinal = true;
+
+    if (tilePage < 0 || !tileSource->isTileValid(tilePage, tileX, tileY, zoomLevel)) {
+        return emptyTile;
+    }
+
+    std::shared_ptr<img::Image> tile;
+    try {
+        tile = tileCache.getTile(tilePage, tileX, tileY, zoomLevel);
+    } catch (const std::exception &e) {
+        // failed tiles are retried after a while, so keep checking them
+        isFinal = false;
+        return errorTile;
+    }
+
+    if (tile) {
+        // keep a reference until the tile is drawn in case the memory cache evicts it meanwhile
+        currentTile = tile;
+        return *tile;
+    }
+
+    isFinal = false;
+    pendingTiles = true;
+
+    // show a scaled version of cached tiles from a neighbouring zoom level until the tile arrives
+    if (drawFromParent(tilePage, tileX, tileY, placeholderTile) || drawFromChildren(tilePage, tileX, tileY, placeholderTile)) {
+        return placeholderTile;
+    }
+    // else a part of the page preview, if the source has one
+    if (drawFromPreview(tilePage, tileX, tileY, placeholderTile)) {
+        return placeholderTile;
+    }
+    return loadingTile;
+}
+
+std::shared_ptr<Image> Stitcher::resolveLayerTile(Layer &layer, int tilePage, int tileX, int tileY, bool &isFinal) {
+    isFinal = true;
+
+    auto &source = layer.source;
+    if (tilePage < 0 || zoomLevel < source->getMinZoomLevel() || zoomLevel > source->getMaxZoomLevel() ||
+        !source->isTileValid(tilePage, tileX, tileY, zoomLevel))
+    {
+        return nullptr;
+    }
 
-    for (int y = -radiusY; y <= radiusY; y++) {
-        for (int x = -radiusX; x <= radiusX; x++) {
-            int tileX = ((int) centerX) + x;
-            int tileY = ((int) centerY) + y;
+    std::shared_ptr<Image> tile;
+    try {
+        tile = layer.cache->getTile(tilePage, tileX, tileY, zoomLevel);
+    } catch (const std::exception &e) {
+        // drawn without the layer, retried like failed map tiles
+        isFinal = false;
+        return nullptr;
+    }
 
-            int tilePosX = centerPosX + x * tileEdgeWidth;
-            int tilePosY = centerPosY + y * tileEdgeHeight;
+    if (!tile) {
+        isFinal = false;
+        pendingTiles = true;
+    }
+    return tile;
+}
 
-            if (!tileSource->isTileValid(page, tileX, tileY, zoomLevel)) {
-                f(tilePosX, tilePosY, emptyTile);
+void Stitcher::drawStack(const Image &tile, const ViewTile &viewTile, bool &isFinal) {
+    int tilePage = viewTile.page, tileX = viewTile.tileX, tileY = viewTile.tileY;
+    int x = viewTile.x, y = viewTile.y;
+
+    // requested in stack order, the layer caches load in parallel to the map's
+    std::vector<std::shared_ptr<Image>> layerTiles;
+    layerTiles.reserve(layers.size());
+    for (auto &layer: layers) {
+        bool isLayerFinal = false;
+        layerTiles.push_back(resolveLayerTile(*layer, tilePage, tileX, tileY, isLayerFinal));
+        isFinal = isFinal && isLayerFinal;
+    }
+
+    auto sameInputs = [this, &layerTiles] (const StackEntry &entry) {
+        if (entry.inputs.front().lock() != currentTile) {
+            return false;
+        }
+        for (size_t i = 0; i < layerTiles.size(); i++) {
+            if (entry.inputs[i + 1].lock() != layerTiles[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (isFinal) {
+        for (auto &entry: stackCache) {
+            if (entry.page == tilePage && entry.zoom == zoomLevel && entry.x == tileX && entry.y == tileY && sameInputs(entry)) {
+                entry.lastUse = ++stackCacheClock;
+                composedImage.drawImage(*entry.image, x, y);
+                return;
+            }
+        }
+    }
+
+    // nothing below an opaque map tile would be visible
+    bool baseOpaque = tile.isOpaque();
+    stackTile.resize(tile.getWidth(), tile.getHeight(), img::COLOR_TRANSPARENT);
+    for (size_t i = 0; i < layers.size(); i++) {
+        if (baseOpaque || layers[i]->options.position != LayerPosition::BELOW) {
+            continue;
+        }
+        auto &layerTile = layerTiles[i];
+        if (layerTile && layerTile->getWidth() == tile.getWidth() && layerTile->getHeight() == tile.getHeight()) {
+            stackTile.blendImage0(*layerTile, 0, 0, layers[i]->options.blendMode, layers[i]->options.opacity);
+        }
+    }
+    stackTile.blendImage0(tile, 0, 0);
+    for (size_t i = 0; i < layers.size(); i++) {
+        if (layers[i]->options.position != LayerPosition::ABOVE) {
+            continue;
+        }
+        auto &layerTile = layerTiles[i];
+        if (layerTile && layerTile->getWidth() == tile.getWidth() && layerTile->getHeight() == tile.getHeight()) {
+            stackTile.blendImage0(*layerTile, 0, 0, layers[i]->options.blendMode, layers[i]->options.opacity);
+        }
+    }
+    composedImage.drawImage(stackTile, x, y);
+
+    if (!isFinal) {
+        return;
+    }
+
+    StackEntry entry { tilePage, zoomLevel, tileX, tileY, {}, nullptr, ++stackCacheClock };
+    entry.inputs.push_back(currentTile);
+    entry.inputs.insert(entry.inputs.end(), layerTiles.begin(), layerTiles.end());
+    entry.image = std::make_shared<Image>(stackTile.getWidth(), stackTile.getHeight(), 0);
+    entry.image->drawImage(stackTile, 0, 0);
+
+    // the same tile with older inputs can't be used anymore
+    stackCache.erase(std::remove_if(stackCache.begin(), stackCache.end(), [&entry] (const StackEntry &e) {
+        return e.page == entry.page && e.zoom == entry.zoom && e.x == entry.x && e.y == entry.y;
+    }), stackCache.end());
+    if (stackCache.size() >= STACK_CACHE_SIZE) {
+        auto oldest = std::min_element(stackCache.begin(), stackCache.end(), [] (const StackEntry &a, const StackEntry &b) {
+            return a.lastUse < b.lastUse;
+        });
+        stackCache.erase(oldest);
+    }
+    stackCache.push_back(std::move(entry));
+}
+
+void Stitcher::prepareComposition(const ViewLayout &layout) {
+    int width = unrotatedImage->getWidth();
+    int height = unrotatedImage->getHeight();
+
+    // pixel position of the composed image's upper left corner at this zoom level
+    int originX = ((int) centerX) * layout.tileWidth - layout.centerPosX;
+    int originY = (layout.rowBase + (int) centerY) * layout.tileHeight - layout.centerPosY;
+
+    auto colorMap = tileSource->getColorMap();
+
+    bool reuse = composition.valid && composition.colorMap == colorMap &&
+                 composedImage.getWidth() == width && composedImage.getHeight() == height &&
+                 (continuousPages || composition.page == page) && composition.zoom == zoomLevel &&
+                 composition.tileWidth == layout.tileWidth && composition.tileHeight == layout.tileHeight;
+
+    int dx = originX - composition.originX;
+    int dy = originY - composition.originY;
+    if (std::abs(dx) >= width || std::abs(dy) >= height) {
+        reuse = false;
+    }
+
+    if (!reuse || dx != 0 || dy != 0) {
+        markAllDirty();
+    }
+
+    if (!reuse) {
+        if (composedImage.getWidth() != width || composedImage.getHeight() != height) {
+            composedImage.resize(width, height, img::COLOR_TRANSPARENT);
+        }
+        composition.drawnTiles.clear();
+    } else if (dx != 0 || dy != 0) {
+        // keep what is still visible and redraw the tiles touching the exposed strips
+        composedImage.scroll(-dx, -dy);
+
+        int validX0 = std::max(0, -dx);
+        int validX1 = std::min(width, width - dx);
+        int validY0 = std::max(0, -dy);
+        int validY1 = std::min(height, height - dy);
+
+        for (auto it = composition.drawnTiles.begin(); it != composition.drawnTiles.end();) {
+            int x0 = std::max(0, it->first * layout.tileWidth - originX);
+            int y0 = std::max(0, it->second * layout.tileHeight - originY);
+            int x1 = std::min(width, (it->first + 1) * layout.tileWidth - originX);
+            int y1 = std::min(height, (it->second + 1) * layout.tileHeight - originY);
+
+            bool offscreen = x0 >= x1 || y0 >= y1;
+            bool intact = x0 >= validX0 && x1 <= validX1 && y0 >= validY0 && y1 <= validY1;
+            if (offscreen || !intact) {
+                it = composition.drawnTiles.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    composition.valid = true;
+    composition.page = page;
+    composition.zoom = zoomLevel;
+    composition.tileWidth = layout.tileWidth;
+    composition.tileHeight = layout.tileHeight;
+    composition.originX = originX;
+    composition.originY = originY;
+    composition.colorMap = colorMap;
+}
+
+bool Stitcher::drawFromParent(int tilePage, int tileX, int tileY, Image &dst) {
+    auto dim = tileSource->getTileDimensions(zoomLevel);
+
+    for (int parentZoom = zoomLevel - 1; parentZoom >= zoomLevel - MAX_PLACEHOLDER_ZOOM_DELTA; parentZoom--) {
+        if (parentZoom < tileSource->getMinZoomLevel()) {
+            break;
+        }
+
+        auto topLeft = tileSource->transformZoomedPoint(tilePage, tileX, tileY, zoomLevel, parentZoom);
+        auto bottomRight = tileSource->transformZoomedPoint(tilePage, tileX + 1, tileY + 1, zoomLevel, parentZoom);
+        int parentX = std::floor(topLeft.x);
+        int parentY = std::floor(topLeft.y);
+        if (std::floor(bottomRight.x - 0.0001) != parentX || std::floor(bottomRight.y - 0.0001) != parentY) {
+            // the tile spans several parents
+            continue;
+        }
+
+        auto parent = tileCache.peekTile(tilePage, parentX, parentY, parentZoom);
+        if (!parent) {
+            continue;
+        }
+
+        int srcX = std::round((topLeft.x - parentX) * parent->getWidth());
+        int srcY = std::round((topLeft.y - parentY) * parent->getHeight());
+        int srcW = std::max(1, (int) std::round((bottomRight.x - topLeft.x) * parent->getWidth()));
+        int srcH = std::max(1, (int) std::round((bottomRight.y - topLeft.y) * parent->getHeight()));
+        srcW = std::min(srcW, parent->getWidth() - srcX);
+        srcH = std::min(srcH, parent->getHeight() - srcY);
+        if (srcW <= 0 || srcH <= 0) {
+            continue;
+        }
+
+        dst.resize(dim.x, dim.y, img::COLOR_BLACK);
+        dst.drawScaledRegion(*parent, srcX, srcY, srcW, srcH, 0, 0, dim.x, dim.y);
+        return true;
+    }
+
+    return false;
+}
+
+bool Stitcher::drawFromChildren(int tilePage, int tileX, int tileY, Image &dst) {
+    int childZoom = zoomLevel + 1;
+    if (childZoom > tileSource->getMaxZoomLevel()) {
+        return false;
+    }
+
+    auto dim = tileSource->getTileDimensions(zoomLevel);
+    auto topLeft = tileSource->transformZoomedPoint(tilePage, tileX, tileY, zoomLevel, childZoom);
+    auto bottomRight = tileSource->transformZoomedPoint(tilePage, tileX + 1, tileY + 1, zoomLevel, childZoom);
+    double spanX = bottomRight.x - topLeft.x;
+    double spanY = bottomRight.y - topLeft.y;
+    if (spanX <= 0 || spanY <= 0) {
+        return false;
+    }
+
+    bool found = false;
+    for (int y = std::floor(topLeft.y); y < bottomRight.y; y++) {
+        for (int x = std::floor(topLeft.x); x < bottomRight.x; x++) {
+            // only children that lie completely inside this tile
+            int x0 = std::round((x - topLeft.x) / spanX * dim.x);
+            int y0 = std::round((y - topLeft.y) / spanY * dim.y);
+            int x1 = std::round((x + 1 - topLeft.x) / spanX * dim.x);
+            int y1 = std::round((y + 1 - topLeft.y) / spanY * dim.y);
+            if (x0 < 0 || y0 < 0 || x1 > dim.x || y1 > dim.y) {
                 continue;
             }
 
-            std::shared_ptr<img::Image> tile;
-            try {
-                tile = tileCache.getTile(page, tileX, tileY, zoomLevel);
-            } catch (const std::exception &e) {
-                f(tilePosX, tilePosY, errorTile);
+            auto child = tileCache.peekTile(tilePage, x, y, childZoom);
+            if (!child) {
                 continue;
             }
 
-            if (tile) {
-                f(tilePosX, tilePosY, *tile);
-            } else {
-                pendingTiles = true;
-                f(tilePosX, tilePosY, loadingTile);
+            if (!found) {
+                dst.resize(dim.x, dim.y, img::COLOR_BLACK);
+                found = true;
             }
+            dst.drawScaledRegion(*child, 0, 0, child->getWidth(), child->getHeight(), x0, y0, x1 - x0, y1 - y0);
         }
     }
 
-    // Due to rounding and precision, the actual drawn center will be a few
-    // pixels off the requested center.
-    // Ensure that we return the actual drawn center instead of the requested one.
-    centerX = ((int) centerX) + xOff / (double) tileEdgeWidth;
-    centerY = ((int) centerY) + yOff / (double) tileEdgeHeight;
+    return found;
 }
 
-void Stitcher::updateImage() {
-    forEachTileInView([this] (int x, int y, img::Image &tile) {
-        unrotatedImage->drawImage(tile, x, y);
+bool Stitcher::drawFromPreview(int tilePage, int tileX, int tileY, Image &dst) {
+    auto preview = tileSource->getPagePreview(tilePage);
+    if (!preview) {
+        return false;
+    }
+
+    auto dim = tileSource->getTileDimensions(zoomLevel);
+    auto pageDim = tileSource->getPageDimensions(tilePage, zoomLevel);
+    if (pageDim.x <= 0 || pageDim.y <= 0) {
+        return false;
+    }
+
+    // the part of the tile that lies on the page, in pixels of this zoom level
+    int x0 = std::max(0, tileX * dim.x);
+    int y0 = std::max(0, tileY * dim.y);
+    int x1 = std::min(pageDim.x, (tileX + 1) * dim.x);
+    int y1 = std::min(pageDim.y, (tileY + 1) * dim.y);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+
+    double scaleX = preview->getWidth() / (double) pageDim.x;
+    double scaleY = preview->getHeight() / (double) pageDim.y;
+    int srcX = std::min(preview->getWidth() - 1, (int) (x0 * scaleX));
+    int srcY = std::min(preview->getHeight() - 1, (int) (y0 * scaleY));
+    int srcW = std::max(1, std::min(preview->getWidth() - srcX, (int) std::round((x1 - x0) * scaleX)));
+    int srcH = std::max(1, std::min(preview->getHeight() - srcY, (int) std::round((y1 - y0) * scaleY)));
+
+    dst.resize(dim.x, dim.y, img::COLOR_TRANSPARENT);
+    dst.drawScaledRegion(*preview, srcX, srcY, srcW, srcH, x0 - tileX * dim.x, y0 - tileY * dim.y, x1 - x0, y1 - y0);
+    return true;
+}
+
+void Stitcher::drawZoomPreview() {
+    // the snapshot scaled about the center by the gesture's zoom factor
+    auto oldDim = tileSource->getTileDimensions(zoomLevel);
+    auto newDim = tileSource->getTileDimensions(gestureZoom);
+    auto newCenter = tileSource->transformZoomedPoint(page, centerX, centerY, zoomLevel, gestureZoom);
+    auto newRight = tileSource->transformZoomedPoint(page, centerX + 1, centerY, zoomLevel, gestureZoom);
+    double scale = (newRight.x - newCenter.x) * newDim.x / oldDim.x;
+    if (!(scale > 0)) {
+        scale = 1;
+    }
+
+    int width = unrotatedImage->getWidth();
+    int height = unrotatedImage->getHeight();
+    unrotatedImage->clear(img::COLOR_BLACK);
+
+    if (scale < 1) {
+        // the snapshot doesn't cover the view anymore, fill the border with the
+        // tiles of the new level that are in memory, but don't load any
+        int radiusX = (width / 2.0) / newDim.x + 1;
+        int radiusY = (height / 2.0) / newDim.y + 1;
+        auto colorMap = tileSource->getColorMap();
+        for (int y = -radiusY; y <= radiusY; y++) {
+            for (int x = -radiusX; x <= radiusX; x++) {
+                int tileX = ((int) newCenter.x) + x;
+                int tileY = ((int) newCenter.y) + y;
+                if (!tileSource->isTileValid(page, tileX, tileY, gestureZoom)) {
+                    continue;
+                }
+                auto tile = tileCache.peekTile(page, tileX, tileY, gestureZoom);
+                if (!tile) {
+                    continue;
+                }
+                int posX = width / 2 + (int) std::lround((tileX - newCenter.x) * newDim.x);
+                int posY = height / 2 + (int) std::lround((tileY - newCenter.y) * newDim.y);
+                unrotatedImage->drawImage(*tile, posX, posY);
+                if (colorMap) {
+                    unrotatedImage->mapColors(*colorMap, posX, posY, tile->getWidth(), tile->getHeight());
+                }
+            }
+        }
+    }
+
+    // where the snapshot lands, it moves along if the view was panned since
+    int snapWidth = zoomSnapshot.getWidth();
+    int snapHeight = zoomSnapshot.getHeight();
+    double x0 = width / 2 + ((snapshotX - centerX) * oldDim.x - snapWidth / 2) * scale;
+    double y0 = height / 2 + ((snapshotY - centerY) * oldDim.y - snapHeight / 2) * scale;
+
+    // the visible part of the snapshot and its target area, both inside the images
+    int srcX0 = std::max(0, (int) std::floor(-x0 / scale));
+    int srcY0 = std::max(0, (int) std::floor(-y0 / scale));
+    int srcX1 = std::min(snapWidth, (int) std::ceil((width - x0) / scale));
+    int srcY1 = std::min(snapHeight, (int) std::ceil((height - y0) / scale));
+    int dstX0 = std::max(0, (int) std::lround(x0 + srcX0 * scale));
+    int dstY0 = std::max(0, (int) std::lround(y0 + srcY0 * scale));
+    int dstX1 = std::min(width, (int) std::lround(x0 + srcX1 * scale));
+    int dstY1 = std::min(height, (int) std::lround(y0 + srcY1 * scale));
+    if (srcX0 < srcX1 && srcY0 < srcY1 && dstX0 < dstX1 && dstY0 < dstY1) {
+        unrotatedImage->drawScaledRegion(zoomSnapshot, srcX0, srcY0, srcX1 - srcX0, srcY1 - srcY0,
+                dstX0, dstY0, dstX1 - dstX0, dstY1 - dstY0);
+    }
+}
+
+void Stitcher::composeView() {
+    if (continuousPages) {
+        updatePageRows();
+        followCenterPage();
+    }
+    auto layout = computeLayout();
+
+    emptyTile.resize(layout.tileWidth, layout.tileHeight, img::COLOR_TRANSPARENT);
+    errorTile.resize(layout.tileWidth, layout.tileHeight, img::COLOR_RED);
+    loadingTile.resize(layout.tileWidth, layout.tileHeight, img::COLOR_BLACK);
+
+    prepareComposition(layout);
+
+    pendingTiles = false;
+    forEachTileInView(layout, [this] (const ViewTile &viewTile) {
+        int x = viewTile.x, y = viewTile.y;
+        auto key = std::make_pair(viewTile.tileX, viewTile.row);
+        if (composition.drawnTiles.count(key)) {
+            // already final in the composed image
+            return;
+        }
+
+        bool isFinal = false;
+        Image &tile = resolveTile(viewTile.page, viewTile.tileX, viewTile.tileY, isFinal);
+        if (layers.empty()) {
+            composedImage.drawImage(tile, x, y);
+        } else {
+            drawStack(tile, viewTile, isFinal);
+        }
+        if (composition.colorMap) {
+            composedImage.mapColors(*composition.colorMap, x, y, tile.getWidth(), tile.getHeight());
+        }
+        currentTile.reset();
+        addDirtyArea(x, y, x + tile.getWidth(), y + tile.getHeight());
+        if (isFinal) {
+            composition.drawnTiles.insert(key);
+        }
     });
 
+    // the overlays are drawn onto the unrotated image, so it has to start from the clean tiles
+    unrotatedImage->drawImage(composedImage, 0, 0);
+
     if (onPreRotate) {
         onPreRotate();
     }
+}
 
-    unrotatedImage->rotate(*dstImage, rotAngle);
+void Stitcher::updateImage() {
+    platform::ScopedFrameTiming timing(platform::FrameProfiler::STITCHER);
+    resizeUnrotatedImage();
+
+    dirtyX0 = dirtyY0 = dirtyX1 = dirtyY1 = 0;
+    allDirty = (rotAngle != lastRotAngle) || previewShown;
+    lastRotAngle = rotAngle;
+
+    if (zoomGestureActive) {
+        // the overlays are part of the snapshot, so the pre-rotate callback isn't needed
+        drawZoomPreview();
+        previewShown = true;
+        allDirty = true;
+    } else {
+        previewShown = false;
+        composeView();
+    }
+
+    if (isRightAngle(rotAngle)) {
+        unrotatedImage->rotate(*dstImage, (int) rotAngle);
+    } else {
+        unrotatedImage->rotateBilinear(*dstImage, rotAngle);
+    }
+
+    if (allDirty || rotAngle != 0) {
+        // rotations move everything, so only the plain copy is tracked
+        dirtyX0 = 0;
+        dirtyY0 = 0;
+        dirtyX1 = dstImage->getWidth();
+        dirtyY1 = dstImage->getHeight();
+    } else {
+        // same offsets as in the unrotated copy to the target image
+        int xOffset = unrotatedImage->getWidth() / 2 - dstImage->getWidth() / 2;
+        int yOffset = unrotatedImage->getHeight() / 2 - dstImage->getHeight() / 2;
+        dirtyX0 = std::max(0, dirtyX0 - xOffset);
+        dirtyY0 = std::max(0, dirtyY0 - yOffset);
+        dirtyX1 = std::min(dstImage->getWidth(), dirtyX1 - xOffset);
+        dirtyY1 = std::min(dstImage->getHeight(), dirtyY1 - yOffset);
+        if (dirtyX0 >= dirtyX1 || dirtyY0 >= dirtyY1) {
+            dirtyX0 = dirtyY0 = dirtyX1 = dirtyY1 = 0;
+        }
+    }
 
     if (onRedraw) {
         onRedraw();
     }
 }
 
+void Stitcher::addDirtyArea(int x0, int y0, int x1, int y1) {
+    if (dirtyX0 >= dirtyX1 || dirtyY0 >= dirtyY1) {
+        dirtyX0 = x0;
+        dirtyY0 = y0;
+        dirtyX1 = x1;
+        dirtyY1 = y1;
+    } else {
+        dirtyX0 = std::min(dirtyX0, x0);
+        dirtyY0 = std::min(dirtyY0, y0);
+        dirtyX1 = std::max(dirtyX1, x1);
+        dirtyY1 = std::max(dirtyY1, y1);
+    }
+}
+
+void Stitcher::markAllDirty() {
+    allDirty = true;
+}
+
+void Stitcher::getDirtyArea(int &x0, int &y0, int &x1, int &y1) const {
+    x0 = dirtyX0;
+    y0 = dirtyY0;
+    x1 = dirtyX1;
+    y1 = dirtyY1;
+}
+
 void Stitcher::doWork() {
+    if (zoomGestureActive) {
+        auto sinceStep = std::chrono::steady_clock::now() - lastGestureStep;
+        if (sinceStep >= std::chrono::milliseconds(ZOOM_SETTLE_MILLIS)) {
+            commitZoomGesture();
+        }
+        return;
+    }
+
     if (pendingTiles) {
         updateImage();
     } else {
         // when there is nothing to do, load all tiles from the memory
-        // cache anyways in order to touch the cache time so that
-        // the tiles in sight are not flushed
-        forEachTileInView([] (int x, int y, img::Image &tile) {
-            // do nothing, just touch the cache
+        // cache anyways so that the tiles in sight stay at the front
+        // of the LRU and are not evicted while other maps are used
+        forEachTileInView(computeLayout(), [this] (const ViewTile &viewTile) {
+            int tilePage = viewTile.page, tileX = viewTile.tileX, tileY = viewTile.tileY;
+            if (tilePage < 0 || !tileSource->isTileValid(tilePage, tileX, tileY, zoomLevel)) {
+                return;
+            }
+            try {
+                if (!tileCache.getTile(tilePage, tileX, tileY, zoomLevel)) {
+                    // evicted or an error tile being retried
+                    pendingTiles = true;
+                }
+                for (auto &layer: layers) {
+                    auto &source = layer->source;
+                    if (zoomLevel >= source->getMinZoomLevel() && zoomLevel <= source->getMaxZoomLevel() &&
+                        source->isTileValid(tilePage, tileX, tileY, zoomLevel) && !layer->cache->getTile(tilePage, tileX, tileY, zoomLevel))
+                    {
+                        pendingTiles = true;
+                    }
+                }
+            } catch (const std::exception &e) {
+                // already drawn as error tile
+            }
         });
     }
 }
 
+void Stitcher::prefetch(double x, double y, int zoom, int radius) {
+    if (zoom < tileSource->getMinZoomLevel() || zoom > tileSource->getMaxZoomLevel()) {
+        return;
+    }
+
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            tileCache.prefetch(page, ((int) x) + dx, ((int) y) + dy, zoom);
+        }
+    }
+}
+
+void Stitcher::startSeeding(const std::vector<TileCache::TileCoords> &tiles, int maxConcurrent) {
+    tileCache.startSeeding(tiles, maxConcurrent);
+}
+
+void Stitcher::stopSeeding() {
+    tileCache.stopSeeding();
+}
+
+TileCache::SeedProgress Stitcher::getSeedProgress() {
+    return tileCache.getSeedProgress();
+}
+
 void Stitcher::invalidateCache() {
     tileCache.invalidate();
+    for (auto &layer: layers) {
+        layer->cache->invalidate();
+    }
+    stackCache.clear();
+    composition.valid = false;
     updateImage();
 }
 
@@ -20,6 +20,10 @@
 
 #include <memory>
 #include <functional>
+#include <set>
+#include <vector>
+#include <utility>
+#include <chrono>
 #include "TileSource.h"
 #include "TileCache.h"
 #include "src/libimg/Image.h"
@@ -30,12 +34,39 @@ class Stitcher {
 public:
     using RedrawCallback = std::function<void(void)>;
     using PreRotateCallback = std::function<void(void)>;
+    static constexpr const int MAX_PLACEHOLDER_ZOOM_DELTA = 2;
+    static constexpr const size_t STACK_CACHE_SIZE = 64;
+    // changes of the free rotation below this many degrees don't redraw the map
+    static constexpr const double ROTATION_HYSTERESIS = 1.0;
+    // zoom gestures are committed after this pause or when they go further than the delta
+    static constexpr const int ZOOM_SETTLE_MILLIS = 300;
+    static constexpr const int MAX_ZOOM_GESTURE_DELTA = 2;
+
+    enum class LayerPosition {
+        BELOW,
+        ABOVE,
+    };
+
+    struct LayerOptions {
+        LayerPosition position = LayerPosition::ABOVE;
+        BlendMode blendMode = BlendMode::NORMAL;
+        float opacity = 1;
+    };
 
     Stitcher(std::shared_ptr<Image> dstImage, std::shared_ptr<TileSource> source);
     void setCacheDirectory(const std::string &utf8Path);
+    void setCacheArchive(const std::string &utf8Path);
     void setPreRotateCallback(PreRotateCallback cb);
     void setRedrawCallback(RedrawCallback cb);
 
+    // Additional sources with the same tiles and zoom levels, e.g. terrain relief or
+    // airspaces, that are blended with each tile of the map. The layers below the map
+    // come first in the order they were added, then the map, then the layers above.
+    // Tiles missing in a layer are left out of the stack. Returns an id for the layer.
+    int addLayer(std::shared_ptr<TileSource> source, const LayerOptions &options, const std::string &utf8CacheDir);
+    void setLayerOptions(int id, const LayerOptions &options);
+    void removeLayer(int id);
+
     void setCenter(double x, double y);
     img::Point<double> getCenter() const;
 
@@ -43,17 +74,52 @@ public:
     int getPageCount() const;
     bool nextPage();
     bool prevPage();
+    bool setPage(int newPage);
+
+    // Stack the pages below each other in one tile space so that panning scrolls from
+    // one page into the next, with the tiles of all pages in sight loaded and kept.
+    // The current page is then the one at the center and the center stays in its
+    // coordinates, so it changes while panning.
+    void setContinuousPages(bool continuous);
+    bool isContinuousPages() const;
 
     void pan(int dx, int dy);
     void setZoomLevel(int level);
     int getZoomLevel();
 
+    // Zoom steps that follow each other quickly, e.g. mouse wheel clicks: the view is
+    // scaled from the last image and the tiles of the new zoom level are only loaded
+    // once the gesture settled in doWork, so no tiles of the levels in between are
+    // requested. getZoomLevel stays at the old level until then.
+    void zoomBy(int delta);
+    bool isZooming() const;
+
+    // Request tiles around x/y at the given zoom with a priority below the visible tiles
+    void prefetch(double x, double y, int zoom, int radius);
+
+    // Fill the disk cache in the background, e.g. before a flight
+    void startSeeding(const std::vector<TileCache::TileCoords> &tiles, int maxConcurrent);
+    void stopSeeding();
+    TileCache::SeedProgress getSeedProgress();
+
     void invalidateCache();
     void updateImage();
+
+    // Area of the target image that changed in the last updateImage, with exclusive
+    // end coordinates, empty if nothing changed. It only knows about the tiles, so the
+    // pre-rotate callback has to call markAllDirty if anything draws onto the images.
+    void getDirtyArea(int &x0, int &y0, int &x1, int &y1) const;
+    void markAllDirty();
     void doWork();
 
+    // clockwise rotation of the map in degrees, rounded for the free rotation
     int getRotation() const;
+    double getRotationAngle() const;
     void rotateRight();
+    // Any angle, e.g. for a track-up map. Angles that aren't multiples of 90 degrees
+    // are filtered bilinearly and enlarge the pre-rotated image to the target's diagonal
+    // so that the corners stay covered.
+    void setRotation(double angle);
 
     std::shared_ptr<Image> getPreRotatedImage();
     std::shared_ptr<Image> getTargetImage();
@@ -61,20 +127,110 @@ public:
     void convertSourceImageToRenderedCoords(int &x, int &y);
 
 private:
+    struct ViewLayout {
+        int tileWidth = 0, tileHeight = 0;
+        int xOff = 0, yOff = 0;
+        int centerPosX = 0, centerPosY = 0;
+        int radiusX = 0, radiusY = 0;
+        // first tile row of the current page in the tile space
+        int rowBase = 0;
+    };
+
+    struct ViewTile {
+        // position in the composed image
+        int x, y;
+        int page, tileX, tileY;
+        // tileY in the tile space of the composition, differs for continuous pages
+        int row;
+    };
+
+    // State of composedImage so that only changed tiles need to be drawn
+    struct Composition {
+        bool valid = false;
+        int page = 0, zoom = 0;
+        int tileWidth = 0, tileHeight = 0;
+        int originX = 0, originY = 0;
+        std::shared_ptr<const ColorLUT> colorMap;
+        std::set<std::pair<int, int>> drawnTiles;
+    };
+
+    struct Layer {
+        int id;
+        std::shared_ptr<TileSource> source;
+        std::unique_ptr<TileCache> cache;
+        LayerOptions options;
+    };
+
+    struct StackEntry {
+        int page, zoom, x, y;
+        // the map tile and then one per layer, an entry is only valid while all are the same
+        std::vector<std::weak_ptr<Image>> inputs;
+        std::shared_ptr<Image> image;
+        uint64_t lastUse;
+    };
+
     int page = 0;
-    Image emptyTile, errorTile, loadingTile;
+    Image emptyTile, errorTile, loadingTile, placeholderTile;
+    std::shared_ptr<Image> currentTile;
+    Image composedImage;
+    Composition composition;
     std::shared_ptr<Image> unrotatedImage;
     std::shared_ptr<Image> dstImage;
     std::shared_ptr<TileSource> tileSource;
     TileCache tileCache;
+    std::vector<std::unique_ptr<Layer>> layers;
+    int nextLayerId = 0;
+    // composited stacks of final tiles, so that they aren't blended again on zoom or page changes
+    std::vector<StackEntry> stackCache;
+    uint64_t stackCacheClock = 0;
+    Image stackTile;
     RedrawCallback onRedraw;
     PreRotateCallback onPreRotate;
     int zoomLevel = 0;
     double centerX = 0, centerY = 0;
     bool pendingTiles = true;
-    int rotAngle = 0;
+    double rotAngle = 0;
+    bool freeRotation = false;
+
+    // the pre-rotated image at the start of a zoom gesture, at zoomLevel around snapshotX/Y
+    bool zoomGestureActive = false;
+    int gestureZoom = 0;
+    std::chrono::steady_clock::time_point lastGestureStep;
+    Image zoomSnapshot;
+    double snapshotX = 0, snapshotY = 0;
+    bool previewShown = false;
+
+    // first tile row of each page and the total rows at pageRowsZoom, for continuous pages
+    bool continuousPages = false;
+    std::vector<int> pageRows;
+    int pageRowsZoom = -1;
+
+    // changed area of composedImage in the current update, then of dstImage
+    int dirtyX0 = 0, dirtyY0 = 0, dirtyX1 = 0, dirtyY1 = 0;
+    bool allDirty = true;
+    double lastRotAngle = 0;
 
-    void forEachTileInView(std::function<void(int, int, img::Image &)> f);
+    ViewLayout computeLayout() const;
+    void resizeUnrotatedImage();
+    void commitZoomGesture();
+    void drawZoomPreview();
+    void composeView();
+    static bool isRightAngle(double angle);
+    void forEachTileInView(const ViewLayout &layout, std::function<void(const ViewTile &)> f);
+    void updatePageRows();
+    bool locateRow(int row, int &rowPage, int &pageY) const;
+    void followCenterPage();
+    Image &resolveTile(int tilePage, int tileX, int tileY, bool &isFinal);
+    std::shared_ptr<Image> resolveLayerTile(Layer &layer, int tilePage, int tileX, int tileY, bool &isFinal);
+    void drawStack(const Image &tile, const ViewTile &viewTile, bool &isFinal);
+    void blendLayers(LayerPosition position, const std::vector<std::shared_ptr<Image>> &layerTiles);
+    void cancelPendingRequests();
+    void invalidateLayers();
+    void prepareComposition(const ViewLayout &layout);
+    void addDirtyArea(int x0, int y0, int x1, int y1);
+    bool drawFromParent(int tilePage, int tileX, int tileY, Image &dst);
+    bool drawFromChildren(int tilePage, int tileX, int tileY, Image &dst);
+    bool drawFromPreview(int tilePage, int tileX, int tileY, Image &dst);
 };
 
 } /* namespace img */
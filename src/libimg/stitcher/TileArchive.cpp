@@ -0,0 +1,299 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <ctime>
+#include <algorithm>
+#include "TileArchive.h"
+#include "src/Logger.h"
+
+namespace img {
+
+TileArchive::TileArchive(const std::string &utf8Path, size_t maxBytes):
+    path(utf8Path),
+    maxBytes(maxBytes)
+{
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+    if (sqlite3_open_v2(path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+        logger::error("Couldn't open tile archive %s: %s", path.c_str(), sqlite3_errmsg(db));
+        sqlite3_close(db);
+        throw std::runtime_error("Couldn't open tile archive");
+    }
+
+    try {
+        sqlite3_busy_timeout(db, 2000);
+        exec("PRAGMA journal_mode=WAL");
+        exec("PRAGMA synchronous=NORMAL");
+        exec("CREATE TABLE IF NOT EXISTS tiles ("
+                "name TEXT PRIMARY KEY, data BLOB NOT NULL, size INTEGER NOT NULL, last_access INTEGER NOT NULL)");
+        exec("CREATE INDEX IF NOT EXISTS tiles_last_access ON tiles(last_access)");
+        exec("CREATE TABLE IF NOT EXISTS tile_meta ("
+                "name TEXT PRIMARY KEY, etag TEXT, last_modified TEXT, expires INTEGER NOT NULL)");
+
+        selectStmt = prepare("SELECT data FROM tiles WHERE name = ?");
+        existsStmt = prepare("SELECT 1 FROM tiles WHERE name = ?");
+        insertStmt = prepare("INSERT OR REPLACE INTO tiles (name, data, size, last_access) VALUES (?, ?, ?, ?)");
+        sizeStmt = prepare("SELECT size FROM tiles WHERE name = ?");
+        touchStmt = prepare("UPDATE tiles SET last_access = ? WHERE name = ?");
+        selectMetaStmt = prepare("SELECT etag, last_modified, expires FROM tile_meta WHERE name = ?");
+        insertMetaStmt = prepare("INSERT OR REPLACE INTO tile_meta (name, etag, last_modified, expires) VALUES (?, ?, ?, ?)");
+        totalBytes = queryTotalBytes();
+    } catch (...) {
+        sqlite3_finalize(selectStmt);
+        sqlite3_finalize(existsStmt);
+        sqlite3_finalize(insertStmt);
+        sqlite3_finalize(sizeStmt);
+        sqlite3_finalize(touchStmt);
+        sqlite3_finalize(selectMetaStmt);
+        sqlite3_finalize(insertMetaStmt);
+        sqlite3_close(db);
+        throw;
+    }
+
+    logger::verbose("Opened tile archive %s with %zu MB", path.c_str(), totalBytes / 1024 / 1024);
+}
+
+void TileArchive::exec(const std::string &sql) {
+    char *err = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+        std::string msg = err ? err : "unknown error";
+        sqlite3_free(err);
+        logger::error("Tile archive SQL '%s' failed: %s", sql.c_str(), msg.c_str());
+        throw std::runtime_error("Tile archive SQL error");
+    }
+}
+
+sqlite3_stmt *TileArchive::prepare(const std::string &sql) {
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        logger::error("Tile archive SQL prepare '%s' failed: %s", sql.c_str(), sqlite3_errmsg(db));
+        throw std::runtime_error("Tile archive SQL prepare error");
+    }
+    return stmt;
+}
+
+size_t TileArchive::queryTotalBytes() {
+    sqlite3_stmt *stmt = prepare("SELECT COALESCE(SUM(size), 0) FROM tiles");
+    size_t res = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        res = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return res;
+}
+
+bool TileArchive::load(const std::string &name, std::vector<uint8_t> &data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // tiles that were stored recently might still wait for the next batch
+    for (auto it = pendingWrites.rbegin(); it != pendingWrites.rend(); ++it) {
+        if (it->first == name) {
+            data = it->second;
+            return true;
+        }
+    }
+
+    sqlite3_reset(selectStmt);
+    sqlite3_bind_text(selectStmt, 1, name.c_str(), name.size(), SQLITE_TRANSIENT);
+    if (sqlite3_step(selectStmt) != SQLITE_ROW) {
+        return false;
+    }
+
+    auto blob = reinterpret_cast<const uint8_t *>(sqlite3_column_blob(selectStmt, 0));
+    int len = sqlite3_column_bytes(selectStmt, 0);
+    data.assign(blob, blob + len);
+    sqlite3_reset(selectStmt);
+
+    if (pendingTouches.empty()) {
+        firstTouchAt = std::time(nullptr);
+    }
+    pendingTouches.insert(name);
+    if (pendingTouches.size() >= TOUCH_BATCH_SIZE || std::time(nullptr) - firstTouchAt >= TOUCH_FLUSH_SECONDS) {
+        flushLocked();
+    }
+    return true;
+}
+
+bool TileArchive::contains(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry: pendingWrites) {
+        if (entry.first == name) {
+            return true;
+        }
+    }
+
+    sqlite3_reset(existsStmt);
+    sqlite3_bind_text(existsStmt, 1, name.c_str(), name.size(), SQLITE_TRANSIENT);
+    bool res = (sqlite3_step(existsStmt) == SQLITE_ROW);
+    sqlite3_reset(existsStmt);
+    return res;
+}
+
+void TileArchive::store(const std::string &name, std::vector<uint8_t> data) {
+    if (data.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingWrites.push_back(std::make_pair(name, std::move(data)));
+    if (pendingWrites.size() >= WRITE_BATCH_SIZE) {
+        flushLocked();
+    }
+}
+
+bool TileArchive::loadValidators(const std::string &name, TileValidators &validators) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = pendingValidators.rbegin(); it != pendingValidators.rend(); ++it) {
+        if (it->first == name) {
+            validators = it->second;
+            return true;
+        }
+    }
+
+    sqlite3_reset(selectMetaStmt);
+    sqlite3_bind_text(selectMetaStmt, 1, name.c_str(), name.size(), SQLITE_TRANSIENT);
+    if (sqlite3_step(selectMetaStmt) != SQLITE_ROW) {
+        sqlite3_reset(selectMetaStmt);
+        return false;
+    }
+
+    auto text = [this] (int col) {
+        auto str = reinterpret_cast<const char *>(sqlite3_column_text(selectMetaStmt, col));
+        return std::string(str ? str : "");
+    };
+    validators.etag = text(0);
+    validators.lastModified = text(1);
+    validators.expires = sqlite3_column_int64(selectMetaStmt, 2);
+    sqlite3_reset(selectMetaStmt);
+    return true;
+}
+
+void TileArchive::storeValidators(const std::string &name, const TileValidators &validators) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingValidators.push_back(std::make_pair(name, validators));
+    if (pendingValidators.size() >= WRITE_BATCH_SIZE) {
+        flushLocked();
+    }
+}
+
+void TileArchive::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    flushLocked();
+}
+
+void TileArchive::flushLocked() {
+    // gets called with locked mutex
+    if (pendingWrites.empty() && pendingTouches.empty() && pendingValidators.empty()) {
+        return;
+    }
+
+    sqlite3_int64 now = std::time(nullptr);
+    try {
+        exec("BEGIN");
+        for (auto &entry: pendingWrites) {
+            // a replaced tile only adds the difference to the total
+            size_t oldSize = 0;
+            sqlite3_reset(sizeStmt);
+            sqlite3_bind_text(sizeStmt, 1, entry.first.c_str(), entry.first.size(), SQLITE_STATIC);
+            if (sqlite3_step(sizeStmt) == SQLITE_ROW) {
+                oldSize = sqlite3_column_int64(sizeStmt, 0);
+            }
+            sqlite3_reset(sizeStmt);
+
+            sqlite3_reset(insertStmt);
+            sqlite3_bind_text(insertStmt, 1, entry.first.c_str(), entry.first.size(), SQLITE_STATIC);
+            sqlite3_bind_blob(insertStmt, 2, entry.second.data(), entry.second.size(), SQLITE_STATIC);
+            sqlite3_bind_int64(insertStmt, 3, entry.second.size());
+            sqlite3_bind_int64(insertStmt, 4, now);
+            if (sqlite3_step(insertStmt) != SQLITE_DONE) {
+                logger::warn("Couldn't store tile %s in archive: %s", entry.first.c_str(), sqlite3_errmsg(db));
+            } else {
+                totalBytes += entry.second.size();
+                totalBytes -= std::min(oldSize, totalBytes);
+            }
+        }
+        for (auto &name: pendingTouches) {
+            sqlite3_reset(touchStmt);
+            sqlite3_bind_int64(touchStmt, 1, now);
+            sqlite3_bind_text(touchStmt, 2, name.c_str(), name.size(), SQLITE_STATIC);
+            sqlite3_step(touchStmt);
+        }
+        for (auto &entry: pendingValidators) {
+            sqlite3_reset(insertMetaStmt);
+            sqlite3_bind_text(insertMetaStmt, 1, entry.first.c_str(), entry.first.size(), SQLITE_STATIC);
+            sqlite3_bind_text(insertMetaStmt, 2, entry.second.etag.c_str(), entry.second.etag.size(), SQLITE_STATIC);
+            sqlite3_bind_text(insertMetaStmt, 3, entry.second.lastModified.c_str(), entry.second.lastModified.size(), SQLITE_STATIC);
+            sqlite3_bind_int64(insertMetaStmt, 4, entry.second.expires);
+            sqlite3_step(insertMetaStmt);
+        }
+        exec("COMMIT");
+    } catch (const std::exception &e) {
+        logger::warn("Dropping %zu tiles for archive %s", pendingWrites.size(), path.c_str());
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+    sqlite3_reset(insertStmt);
+    sqlite3_reset(touchStmt);
+    sqlite3_reset(insertMetaStmt);
+
+    pendingWrites.clear();
+    pendingTouches.clear();
+    pendingValidators.clear();
+
+    if (totalBytes > maxBytes) {
+        trim();
+    }
+}
+
+void TileArchive::trim() {
+    // gets called with locked mutex, evicts until the archive is 10% below the cap
+    sqlite3_stmt *stmt = nullptr;
+    try {
+        stmt = prepare("DELETE FROM tiles WHERE name IN "
+                "(SELECT name FROM tiles ORDER BY last_access ASC LIMIT ?)");
+        totalBytes = queryTotalBytes();
+        while (totalBytes > maxBytes / 10 * 9) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, TRIM_BATCH_SIZE);
+            if (sqlite3_step(stmt) != SQLITE_DONE || sqlite3_changes(db) == 0) {
+                break;
+            }
+            totalBytes = queryTotalBytes();
+        }
+        exec("DELETE FROM tile_meta WHERE name NOT IN (SELECT name FROM tiles)");
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't trim tile archive %s", path.c_str());
+    }
+    sqlite3_finalize(stmt);
+}
+
+TileArchive::~TileArchive() {
+    try {
+        flush();
+    } catch (...) {
+        // nothing we can do at this point
+    }
+    sqlite3_finalize(selectStmt);
+    sqlite3_finalize(existsStmt);
+    sqlite3_finalize(insertStmt);
+    sqlite3_finalize(sizeStmt);
+    sqlite3_finalize(touchStmt);
+    sqlite3_finalize(selectMetaStmt);
+    sqlite3_finalize(insertMetaStmt);
+    sqlite3_close(db);
+}
+
+} /* namespace img */
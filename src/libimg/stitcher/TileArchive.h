@@ -0,0 +1,81 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <ctime>
+#include <mutex>
+#include <utility>
+#include <sqlite3/sqlite3.h>
+#include "TileSource.h"
+
+namespace img {
+
+// Single-file tile cache (SQLite, similar to MBTiles) as an alternative to
+// storing each tile as a separate file. Writes are batched into transactions
+// and the archive is trimmed to a size cap by evicting the least recently
+// used tiles. WAL mode allows several sessions to share the same file.
+class TileArchive {
+public:
+    static constexpr const size_t DEFAULT_MAX_BYTES = 2048ull * 1024 * 1024;
+
+    TileArchive(const std::string &utf8Path, size_t maxBytes = DEFAULT_MAX_BYTES);
+    bool load(const std::string &name, std::vector<uint8_t> &data);
+    bool contains(const std::string &name);
+    void store(const std::string &name, std::vector<uint8_t> data);
+    bool loadValidators(const std::string &name, TileValidators &validators);
+    void storeValidators(const std::string &name, const TileValidators &validators);
+    void flush();
+    ~TileArchive();
+
+private:
+    static constexpr const size_t WRITE_BATCH_SIZE = 32;
+    static constexpr const int TRIM_BATCH_SIZE = 256;
+    // read-only sessions write the access times after this many tiles or seconds
+    static constexpr const size_t TOUCH_BATCH_SIZE = 256;
+    static constexpr const int TOUCH_FLUSH_SECONDS = 60;
+
+    std::mutex mutex;
+    const std::string path;
+    const size_t maxBytes;
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *selectStmt = nullptr;
+    sqlite3_stmt *existsStmt = nullptr;
+    sqlite3_stmt *insertStmt = nullptr;
+    sqlite3_stmt *sizeStmt = nullptr;
+    sqlite3_stmt *touchStmt = nullptr;
+    sqlite3_stmt *selectMetaStmt = nullptr;
+    sqlite3_stmt *insertMetaStmt = nullptr;
+    size_t totalBytes = 0;
+
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> pendingWrites;
+    std::unordered_set<std::string> pendingTouches;
+    time_t firstTouchAt = 0;
+    std::vector<std::pair<std::string, TileValidators>> pendingValidators;
+
+    void exec(const std::string &sql);
+    sqlite3_stmt *prepare(const std::string &sql);
+    size_t queryTotalBytes();
+    void flushLocked();
+    void trim();
+};
+
+} /* namespace img */
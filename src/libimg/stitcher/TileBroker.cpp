@@ -0,0 +1,126 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "TileBroker.h"
+
+namespace img {
+
+TileBroker &TileBroker::shared() {
+    static TileBroker broker;
+    return broker;
+}
+
+std::shared_ptr<Image> TileBroker::load(const std::string &key, Loader loader) {
+    std::promise<std::shared_ptr<Image>> promise;
+    auto cancel = TileLoadCancel::get();
+    auto flight = std::make_shared<Flight>();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        auto loadedIt = loaded.find(key);
+        if (loadedIt != loaded.end()) {
+            auto img = loadedIt->second.lock();
+            if (img) {
+                return img;
+            }
+            loaded.erase(loadedIt);
+        }
+
+        auto flightIt = inFlight.find(key);
+        if (flightIt != inFlight.end() && !*flightIt->second->cancel) {
+            flightIt->second->callers.push_back(cancel);
+            auto result = flightIt->second->result;
+            lock.unlock();
+            // other callers keep the load running, so only this caller leaves
+            while (result.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready) {
+                if (*cancel) {
+                    throw std::out_of_range("Tile load cancelled");
+                }
+            }
+            return result.get();
+        }
+
+        // an abandoned load that is still winding down gets replaced
+        flight->result = promise.get_future().share();
+        flight->callers.push_back(cancel);
+        inFlight[key] = flight;
+    }
+
+    auto finish = [this, &key, &flight] () {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = inFlight.find(key);
+        if (it != inFlight.end() && it->second == flight) {
+            inFlight.erase(it);
+        }
+    };
+
+    std::shared_ptr<Image> img;
+    try {
+        TileLoadCancel::Scope cancelScope(flight->cancel);
+        img = loader();
+        promise.set_value(img);
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        finish();
+        throw;
+    }
+
+    finish();
+    if (img) {
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded[key] = img;
+        if (loaded.size() >= nextSweep) {
+            sweep();
+        }
+    }
+
+    if (*cancel) {
+        // the load was kept running for other callers
+        throw std::out_of_range("Tile load cancelled");
+    }
+    return img;
+}
+
+void TileBroker::cancelAbandoned() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry: inFlight) {
+        auto &flight = entry.second;
+        bool abandoned = std::all_of(flight->callers.begin(), flight->callers.end(),
+                [] (const TileLoadCancel::Token &token) { return *token == true; });
+        if (abandoned) {
+            *flight->cancel = true;
+        }
+    }
+}
+
+void TileBroker::sweep() {
+    // gets called with locked mutex
+    for (auto it = loaded.begin(); it != loaded.end();) {
+        if (it->second.expired()) {
+            it = loaded.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    nextSweep = std::max(SWEEP_THRESHOLD, 2 * loaded.size());
+}
+
+} /* namespace img */
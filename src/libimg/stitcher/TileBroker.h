@@ -0,0 +1,68 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "src/libimg/Image.h"
+#include "TileSource.h"
+
+namespace img {
+
+// Process-wide deduplication of tile loads. Caches over sources that share a
+// tile namespace get the same decoded image instead of loading it again.
+class TileBroker {
+public:
+    using Loader = std::function<std::shared_ptr<Image>()>;
+
+    static TileBroker &shared();
+
+    // Returns the image if another cache still holds it, waits for a load of
+    // the same key that is already running or else runs the loader.
+    // Exceptions of the loader are rethrown to every waiting caller. A caller
+    // whose load token gets set leaves with std::out_of_range.
+    std::shared_ptr<Image> load(const std::string &key, Loader loader);
+
+    // Cancels the running loads that no caller waits for anymore
+    void cancelAbandoned();
+
+private:
+    static constexpr const size_t SWEEP_THRESHOLD = 1024;
+
+    struct Flight {
+        std::shared_future<std::shared_ptr<Image>> result;
+        // the loader runs under its own token, set once every caller is gone
+        TileLoadCancel::Token cancel = std::make_shared<std::atomic_bool>(false);
+        std::vector<TileLoadCancel::Token> callers;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> inFlight;
+    std::unordered_map<std::string, std::weak_ptr<Image>> loaded;
+    size_t nextSweep = SWEEP_THRESHOLD;
+
+    TileBroker() = default;
+    void sweep();
+};
+
+} /* namespace img */
@@ -17,17 +17,31 @@
  */
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
 #include "TileCache.h"
 #include "src/platform/Platform.h"
 #include "src/platform/CrashHandler.h"
+#include "src/platform/BandwidthScheduler.h"
+#include "src/platform/Metrics.h"
+#include "src/platform/Tracer.h"
+#include "src/platform/StatCache.h"
+#include "src/platform/MappedFile.h"
 #include "src/Logger.h"
 
 namespace img {
 
-TileCache::TileCache(std::shared_ptr<TileSource> source):
-    tileSource(source)
+TileCache::TileCache(std::shared_ptr<TileSource> source, int maxLoaders):
+    tileSource(source),
+    memoryCache(TileMemoryCache::shared()),
+    cacheOwnerId(memoryCache.acquireOwnerId()),
+    sharedNamespace(source->getSharedTileNamespace())
 {
-    loaderThread = std::make_unique<std::thread>(&TileCache::loadLoop, this);
+    int numLoaders = std::max(1, std::min(maxLoaders, tileSource->getMaxConcurrentLoads()));
+    for (int i = 0; i < numLoaders; i++) {
+        loaderThreads.emplace_back(&TileCache::loadLoop, this);
+    }
 }
 
 void TileCache::setCacheDirectory(const std::string& utf8Path) {
@@ -35,6 +49,19 @@ void TileCache::setCacheDirectory(const std::string& utf8Path) {
     if (!platform::fileExists(cacheDir)) {
         platform::mkdir(cacheDir);
     }
+    if (!writerThread) {
+        writerThread = std::make_unique<std::thread>(&TileCache::writeLoop, this);
+    }
+}
+
+void TileCache::setCacheArchive(const std::string &utf8Path, size_t maxBytes) {
+    platform::mkpath(platform::getDirNameFromPath(utf8Path));
+    try {
+        auto archive = std::make_shared<TileArchive>(utf8Path, maxBytes);
+        std::atomic_store(&cacheArchive, archive);
+    } catch (const std::exception &e) {
+        logger::warn("Tile archive not available, using cache directory: %s", e.what());
+    }
 }
 
 std::shared_ptr<Image> TileCache::getTile(int page, int x, int y, int zoom) {
@@ -48,52 +75,184 @@ std::shared_ptr<Image> TileCache::getTile(int page, int x, int y, int zoom) {
 
     std::lock_guard<std::mutex> lock(cacheMutex);
 
-    // First check if this coords had a load error
-    auto errorIt = errorSet.find(TileCoords(page, x, y, zoom));
-    if (errorIt != errorSet.end()) {
+    // First check if this coords had a recent load error
+    if (isFailed(TileCoords(page, x, y, zoom))) {
         throw std::runtime_error("Corrupt tile");
     }
 
-    // Cache strategy: Check memory cache first
+    // Only the memory cache is checked here so that the caller never blocks
+    // on I/O. The loader threads will try the file cache before the source.
+    static auto &memoryHits = platform::Metrics::counter("tiles/memory_hits");
+    static auto &memoryMisses = platform::Metrics::counter("tiles/memory_misses");
     image = getFromMemory(page, x, y, zoom);
     if (image) {
+        memoryHits.add();
         return image;
     }
 
-    // Then check file cache
-    image = getFromDisk(page, x, y, zoom);
-    if (image) {
-        return image;
-    }
-
-    // Finally got a cache miss -> enqueue and return miss for now
+    memoryMisses.add();
     enqueue(page, x, y, zoom);
     return nullptr;
 }
 
-std::shared_ptr<Image> TileCache::getFromMemory(int page, int x, int y, int zoom) {
-    // gets called with locked mutex
-    auto it = memoryCache.find(tileSource->getUniqueTileName(page, x, y, zoom));
-    if (it == memoryCache.end()) {
+std::shared_ptr<Image> TileCache::peekTile(int page, int x, int y, int zoom) {
+    tileSource->constrainXY(x, y, zoom);
+    if (!tileSource->isTileValid(page, x, y, zoom)) {
         return nullptr;
     }
 
-    MemCacheEntry &entry = it->second;
-    std::get<1>(entry) = std::chrono::steady_clock::now();
-    return std::get<0>(entry);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return getFromMemory(page, x, y, zoom);
 }
 
-std::shared_ptr<Image> TileCache::getFromDisk(int page, int x, int y, int zoom) {
+void TileCache::prefetch(int page, int x, int y, int zoom) {
+    tileSource->constrainXY(x, y, zoom);
+    if (!tileSource->isTileValid(page, x, y, zoom)) {
+        return;
+    }
+
+    TileCoords coords(page, x, y, zoom);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (prefetchSet.size() >= MAX_PREFETCH_TILES ||
+            loadSet.count(coords) || inFlightSet.count(coords) || isFailed(coords)) {
+        return;
+    }
+
+    if (getFromMemory(page, x, y, zoom)) {
+        return;
+    }
+
+    if (prefetchSet.insert(coords).second) {
+        cacheCondition.notify_one();
+    }
+}
+
+bool TileCache::isFailed(const TileCoords &coords) {
     // gets called with locked mutex
-    std::string fileName = cacheDir + "/" + tileSource->getUniqueTileName(page, x, y, zoom);
-    if (!platform::fileExists(fileName)) {
+    auto it = failedTiles.find(coords);
+    if (it == failedTiles.end()) {
+        return false;
+    }
+    // expired entries are kept so that the backoff grows if the retry fails again
+    return std::chrono::steady_clock::now() < it->second.retryAt;
+}
+
+void TileCache::markFailed(const TileCoords &coords, TileLoadError::Kind kind) {
+    // gets called with locked mutex
+    auto now = std::chrono::steady_clock::now();
+
+    if (failedTiles.size() >= MAX_FAILED_TILES && !failedTiles.count(coords)) {
+        for (auto it = failedTiles.begin(); it != failedTiles.end();) {
+            if (it->second.retryAt <= now) {
+                it = failedTiles.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (failedTiles.size() >= MAX_FAILED_TILES) {
+            failedTiles.erase(failedTiles.begin());
+        }
+    }
+
+    auto &entry = failedTiles[coords];
+    if (entry.kind != kind) {
+        entry.failures = 0;
+    }
+    entry.kind = kind;
+    entry.failures++;
+    entry.retryAt = now + retryDelay(kind, entry.failures);
+}
+
+std::chrono::seconds TileCache::retryDelay(TileLoadError::Kind kind, int failures) {
+    using std::chrono::seconds;
+
+    seconds base, limit;
+    switch (kind) {
+    case TileLoadError::Kind::NOT_FOUND:
+        // most likely permanent, but servers do get new tiles eventually
+        base = seconds(3600);
+        limit = seconds(24 * 3600);
+        break;
+    case TileLoadError::Kind::NETWORK:
+        base = seconds(5);
+        limit = seconds(300);
+        break;
+    case TileLoadError::Kind::SERVER:
+        base = seconds(30);
+        limit = seconds(1800);
+        break;
+    case TileLoadError::Kind::DECODE:
+        base = seconds(600);
+        limit = seconds(24 * 3600);
+        break;
+    default:
+        base = seconds(60);
+        limit = seconds(3600);
+        break;
+    }
+
+    int doublings = std::min(failures - 1, 16);
+    return std::min(limit, base * (1 << doublings));
+}
+
+std::shared_ptr<Image> TileCache::getFromMemory(int page, int x, int y, int zoom) {
+    // gets called with locked mutex
+    return memoryCache.get(TileMemoryCache::makeKey(cacheOwnerId, page, x, y, zoom));
+}
+
+std::shared_ptr<Image> TileCache::getFromDisk(int page, int x, int y, int zoom) {
+    // gets called unlocked from the loader threads
+    auto archive = std::atomic_load(&cacheArchive);
+    if (!archive && cacheDir.empty()) {
         return nullptr;
     }
 
-    // upon loading: insert into memory cache for next access
+    std::string fileName = tileSource->getUniqueTileName(page, x, y, zoom);
     auto img = std::make_shared<Image>();
-    img->loadImageFile(fileName);
-    enterMemoryCache(page, x, y, zoom, img);
+    try {
+        if (tileSource->cachesTileData()) {
+            std::vector<uint8_t> data;
+            if (archive) {
+                if (!archive->load(fileName, data)) {
+                    return nullptr;
+                }
+            } else if (!findPendingWrite(fileName, data)) {
+                fileName = cacheDir + "/" + fileName;
+                if (!platform::StatCache::shared().exists(fileName)) {
+                    return nullptr;
+                }
+                platform::MappedFile file(fileName);
+                data.assign(file.data(), file.data() + file.size());
+            }
+            auto rendered = tileSource->renderTileData(data, zoom);
+            if (!rendered) {
+                throw std::runtime_error("Not rendered");
+            }
+            return std::shared_ptr<Image>(std::move(rendered));
+        } else if (archive) {
+            std::vector<uint8_t> data;
+            if (!archive->load(fileName, data)) {
+                return nullptr;
+            }
+            img->loadEncodedData(data, false);
+        } else {
+            std::vector<uint8_t> data;
+            if (findPendingWrite(fileName, data)) {
+                img->loadEncodedData(data, false);
+                return img;
+            }
+            fileName = cacheDir + "/" + fileName;
+            if (!platform::StatCache::shared().exists(fileName)) {
+                return nullptr;
+            }
+            img->loadImageFile(fileName);
+        }
+    } catch (const std::exception &e) {
+        // corrupt cache file: load from the source again, this will overwrite the file
+        logger::warn("Ignoring corrupt cached tile %s: %s", fileName.c_str(), e.what());
+        return nullptr;
+    }
 
     return img;
 }
@@ -101,128 +260,637 @@ std::shared_ptr<Image> TileCache::getFromDisk(int page, int x, int y, int zoom)
 void img::TileCache::enqueue(int page, int x, int y, int zoom) {
     // gets called with locked mutex
     TileCoords coords(page, x, y, zoom);
-    loadSet.insert(coords);
+    if (inFlightSet.find(coords) != inFlightSet.end()) {
+        // another worker is already loading this tile
+        return;
+    }
+    if (!loadSet.insert(coords).second) {
+        return;
+    }
+    loadQueue.push_back(coords);
+    std::push_heap(loadQueue.begin(), loadQueue.end(),
+            [this] (const TileCoords &a, const TileCoords &b) { return comparePriority(a, b); });
     cacheCondition.notify_one();
 }
 
+void TileCache::setFocus(int page, double centerX, double centerY, int zoom, int radiusX, int radiusY) {
+    Focus newFocus;
+    newFocus.firstPage = page;
+    newFocus.lastPage = page;
+    newFocus.x = centerX;
+    newFocus.y = centerY;
+    newFocus.zoom = zoom;
+    newFocus.radiusX = radiusX;
+    newFocus.radiusY = radiusY;
+    updateFocus(std::move(newFocus));
+}
+
+void TileCache::setStackedFocus(const std::vector<int> &firstRows, int firstPage, int lastPage,
+                                double centerX, double centerY, int zoom, int radiusX, int radiusY)
+{
+    Focus newFocus;
+    newFocus.firstPage = firstPage;
+    newFocus.lastPage = lastPage;
+    newFocus.x = centerX;
+    newFocus.y = centerY;
+    newFocus.zoom = zoom;
+    newFocus.radiusX = radiusX;
+    newFocus.radiusY = radiusY;
+    newFocus.firstRows = firstRows;
+    updateFocus(std::move(newFocus));
+}
+
+void TileCache::updateFocus(Focus &&newFocus) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (focus.firstPage == newFocus.firstPage && focus.lastPage == newFocus.lastPage &&
+            focus.zoom == newFocus.zoom && focus.x == newFocus.x && focus.y == newFocus.y &&
+            focus.radiusX == newFocus.radiusX && focus.radiusY == newFocus.radiusY &&
+            focus.firstRows == newFocus.firstRows) {
+        return;
+    }
+
+    focus = std::move(newFocus);
+    reprioritize();
+}
+
+double TileCache::focusRow(const TileCoords &coords) const {
+    // gets called with locked mutex, only for tiles of the focused zoom level
+    int page = std::get<0>(coords);
+    double y = std::get<2>(coords) + 0.5;
+    if (page >= 0 && (size_t) page < focus.firstRows.size()) {
+        y += focus.firstRows[page];
+    }
+    return y;
+}
+
+double TileCache::loadPriority(const TileCoords &coords) const {
+    // gets called with locked mutex, lower value = load earlier
+    int zoom = std::get<3>(coords);
+    double dx = std::get<1>(coords) + 0.5 - focus.x;
+    double dy = (zoom == focus.zoom ? focusRow(coords) : std::get<2>(coords) + 0.5) - focus.y;
+    double dist = dx * dx + dy * dy;
+    if (zoom != focus.zoom) {
+        // tiles of the visible zoom level always come first
+        dist += 1e9 * (1 + std::abs(zoom - focus.zoom));
+    }
+    return dist;
+}
+
+bool TileCache::comparePriority(const TileCoords &a, const TileCoords &b) const {
+    // max-heap comparison: true if a should be loaded after b
+    return loadPriority(a) > loadPriority(b);
+}
+
+bool TileCache::isStale(const TileCoords &coords) const {
+    // gets called with locked mutex
+    int page = std::get<0>(coords);
+    if (page < focus.firstPage || page > focus.lastPage) {
+        return true;
+    }
+
+    if (std::get<3>(coords) != focus.zoom) {
+        // other zoom levels are only kept around with lower priority
+        return false;
+    }
+
+    // allow one tile of margin so that tiles at the border are not dropped while panning
+    double dx = std::abs(std::get<1>(coords) + 0.5 - focus.x);
+    double dy = std::abs(focusRow(coords) - focus.y);
+    return dx > focus.radiusX + 1 || dy > focus.radiusY + 1;
+}
+
+void TileCache::reprioritize() {
+    // gets called with locked mutex
+    for (auto it = loadQueue.begin(); it != loadQueue.end(); ) {
+        if (isStale(*it)) {
+            loadSet.erase(*it);
+            it = loadQueue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    std::make_heap(loadQueue.begin(), loadQueue.end(),
+            [this] (const TileCoords &a, const TileCoords &b) { return comparePriority(a, b); });
+}
+
 bool TileCache::hasWork() {
     // gets called with locked mutex
     if (!keepAlive) {
         return true;
     }
 
-    return !loadSet.empty();
+    return !loadQueue.empty() || !prefetchSet.empty() || canSeed();
+}
+
+bool TileCache::canSeed() {
+    // gets called with locked mutex, always keep a worker for visible tiles if we have several
+    int maxSeeds = seedConcurrency;
+    if (loaderThreads.size() > 1) {
+        maxSeeds = std::min(maxSeeds, (int) loaderThreads.size() - 1);
+    }
+    return !seedQueue.empty() && activeSeeds < maxSeeds;
+}
+
+bool TileCache::takeJob(TileCoords &coords, bool &isSeed, bool &isPrefetch) {
+    // gets called with locked mutex
+    isSeed = false;
+    isPrefetch = false;
+    if (!loadQueue.empty()) {
+        std::pop_heap(loadQueue.begin(), loadQueue.end(),
+                [this] (const TileCoords &a, const TileCoords &b) { return comparePriority(a, b); });
+        coords = loadQueue.back();
+        loadQueue.pop_back();
+        loadSet.erase(coords);
+    } else if (!prefetchSet.empty()) {
+        coords = *prefetchSet.begin();
+        prefetchSet.erase(prefetchSet.begin());
+        isPrefetch = true;
+    } else if (canSeed()) {
+        coords = seedQueue.front();
+        seedQueue.pop_front();
+        activeSeeds++;
+        isSeed = true;
+        return true;
+    } else {
+        return false;
+    }
+
+    inFlightSet.insert(coords);
+    return true;
 }
 
 void TileCache::loadLoop() {
     crash::ThreadCookie crashCookie;
+    platform::Tracer::setThreadName("tile_loader");
 
     logger::verbose("TileCache spawned thread %d", std::this_thread::get_id());
     while (keepAlive) {
         TileCoords coords;
-        bool coordsValid = false;
+        bool isSeed = false;
+        bool isPrefetch = false;
+        auto token = std::make_shared<std::atomic_bool>(false);
         {
             std::unique_lock<std::mutex> lock(cacheMutex);
-            // also wake up each second to flush cache
-            cacheCondition.wait_for(lock, std::chrono::seconds(1), [this] () { return hasWork(); });
+            cacheCondition.wait(lock, [this] () { return hasWork(); });
 
             if (!keepAlive) {
                 break;
             }
 
-            auto it = loadSet.begin();
-            if (it != loadSet.end()) {
-                coords = *it;
-                loadSet.erase(it);
-                tileSource->resumeLoading();
-                coordsValid = true;
+            if (!takeJob(coords, isSeed, isPrefetch)) {
+                continue;
             }
+            loadTokens.insert(token);
+            tileSource->resumeLoading();
         }
+        TileLoadCancel::Scope cancelScope(token);
 
-        if (coordsValid) {
-            int page = std::get<0>(coords);
-            int x = std::get<1>(coords);
-            int y = std::get<2>(coords);
-            int zoom = std::get<3>(coords);
-            if (!getFromMemory(page, x, y, zoom)) {
-                // some sources load multiple x/y/zoom tiles at once, so it could already
-                // be loaded from another pair
-                loadAndCacheTile(page, x, y, zoom);
+        if (isSeed) {
+            {
+                platform::BandwidthScheduler::Scope scope(platform::BandwidthScheduler::Traffic::BACKGROUND);
+                platform::TraceSpan span("seed_tile");
+                seedTile(coords);
+            }
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            loadTokens.erase(token);
+            activeSeeds--;
+            if (seedQueue.empty() && activeSeeds == 0 && seedProgress.running) {
+                seedProgress.running = false;
+                logger::info("Tile seeding finished: %zu tiles, %zu failed", seedProgress.total, seedProgress.failed);
             }
+            cacheCondition.notify_one();
+            continue;
+        }
+
+        int page = std::get<0>(coords);
+        int x = std::get<1>(coords);
+        int y = std::get<2>(coords);
+        int zoom = std::get<3>(coords);
+        bool cached;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            cached = (getFromMemory(page, x, y, zoom) != nullptr);
+        }
+        // some sources load multiple x/y/zoom tiles at once, so it could already
+        // be loaded from another pair
+        if (!cached) {
+            platform::BandwidthScheduler::Scope scope(isPrefetch ?
+                    platform::BandwidthScheduler::Traffic::BACKGROUND : platform::BandwidthScheduler::Traffic::INTERACTIVE);
+            platform::TraceSpan span("load_tile");
+            loadAndCacheTile(page, x, y, zoom);
         }
 
-        flushCache();
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        loadTokens.erase(token);
+        inFlightSet.erase(coords);
     }
     logger::verbose("TileCache ending thread %d", std::this_thread::get_id());
 }
 
+void TileCache::startSeeding(const std::vector<TileCoords> &tiles, int maxConcurrent) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto &coords: tiles) {
+        int page = std::get<0>(coords);
+        int x = std::get<1>(coords);
+        int y = std::get<2>(coords);
+        int zoom = std::get<3>(coords);
+        tileSource->constrainXY(x, y, zoom);
+        if (tileSource->isTileValid(page, x, y, zoom)) {
+            seedQueue.push_back(TileCoords(page, x, y, zoom));
+            seedProgress.total++;
+        }
+    }
+    seedConcurrency = std::max(1, std::min(maxConcurrent, tileSource->getMaxConcurrentLoads()));
+    seedProgress.running = !seedQueue.empty() || activeSeeds > 0;
+    logger::info("Seeding %zu tiles", seedQueue.size());
+    cacheCondition.notify_all();
+}
+
+void TileCache::stopSeeding() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    seedQueue.clear();
+    seedProgress = SeedProgress{};
+}
+
+TileCache::SeedProgress TileCache::getSeedProgress() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return seedProgress;
+}
+
+bool TileCache::isOnDisk(const std::string &name) {
+    // gets called unlocked
+    auto archive = std::atomic_load(&cacheArchive);
+    if (archive) {
+        return archive->contains(name);
+    }
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        if (pendingWrites.count(name) || (currentWrite && currentWriteName == name)) {
+            return true;
+        }
+    }
+    return platform::StatCache::shared().exists(cacheDir + "/" + name);
+}
+
+void TileCache::seedTile(const TileCoords &coords) {
+    // gets called unlocked. Seeded tiles only go to disk so that they don't evict the visible ones.
+    int page = std::get<0>(coords);
+    int x = std::get<1>(coords);
+    int y = std::get<2>(coords);
+    int zoom = std::get<3>(coords);
+
+    bool failed = false;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        failed = isFailed(coords);
+    }
+
+    try {
+        std::string name = tileSource->getUniqueTileName(page, x, y, zoom);
+        if (!failed && !isOnDisk(name)) {
+            TileValidators validators;
+            auto image = loadFromSource(page, x, y, zoom, validators);
+            storeOnDisk(name, *image, validators);
+        }
+    } catch (const std::out_of_range &e) {
+        // cancelled by a view change: retry later
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (seedProgress.running) {
+            seedQueue.push_back(coords);
+        }
+        return;
+    } catch (const TileLoadError &e) {
+        logger::verbose("Couldn't seed tile %d/%d/%d: %s", zoom, x, y, e.what());
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        markFailed(coords, e.getKind());
+        failed = true;
+    } catch (const std::exception &e) {
+        logger::verbose("Couldn't seed tile %d/%d/%d: %s", zoom, x, y, e.what());
+        failed = true;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (seedProgress.running) {
+        seedProgress.done++;
+        if (failed) {
+            seedProgress.failed++;
+        }
+    }
+}
+
 void TileCache::loadAndCacheTile(int page, int x, int y, int zoom) {
     // gets called unlocked
     std::shared_ptr<Image> image;
+    bool fromSource = false, fromDisk = false;
+    TileValidators validators;
+    auto load = [this, page, x, y, zoom, &fromSource, &fromDisk, &validators] () -> std::shared_ptr<Image> {
+        // the loader threads try the file cache before the source
+        auto diskImage = getFromDisk(page, x, y, zoom);
+        if (diskImage) {
+            fromDisk = true;
+            return diskImage;
+        }
+        fromSource = true;
+        return loadFromSource(page, x, y, zoom, validators);
+    };
+
     try {
-        image = tileSource->loadTileImage(page, x, y, zoom);
+        if (sharedNamespace.empty()) {
+            image = load();
+        } else {
+            // another cache might be loading or holding the same tile
+            std::string key = sharedNamespace + "/" + tileSource->getUniqueTileName(page, x, y, zoom);
+            image = TileBroker::shared().load(key, load);
+        }
     } catch (const std::out_of_range &e) {
         // cancelled
         return;
+    } catch (const TileLoadError &e) {
+        logger::verbose("Marking tile %d/%d/%d as error: %s", zoom, x, y, e.what());
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        markFailed(TileCoords(page, x, y, zoom), e.getKind());
+        return;
     } catch (const std::exception &e) {
         // some error
         logger::verbose("Marking tile %d/%d/%d as error: %s", zoom, x, y, e.what());
-        errorSet.insert(TileCoords(page, x, y, zoom));
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        markFailed(TileCoords(page, x, y, zoom), TileLoadError::Kind::OTHER);
         return;
     }
 
-    std::string fileName = tileSource->getUniqueTileName(page, x, y, zoom);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        enterMemoryCache(page, x, y, zoom, image);
+    }
 
-    std::lock_guard<std::mutex> lock(cacheMutex);
-    enterMemoryCache(page, x, y, zoom, image);
-    image->storeAndClearEncodedData(cacheDir + "/" + fileName);
+    if (fromSource) {
+        storeOnDisk(tileSource->getUniqueTileName(page, x, y, zoom), *image, validators);
+    } else if (fromDisk && tileSource->supportsRevalidation()) {
+        // the cached version is shown meanwhile
+        revalidate(page, x, y, zoom);
+    }
+}
+
+std::unique_ptr<Image> TileCache::loadFromSource(int page, int x, int y, int zoom, TileValidators &validators) {
+    // gets called unlocked
+    if (tileSource->supportsRevalidation()) {
+        // without validators, this is an unconditional load that fills them
+        validators = TileValidators{};
+        auto image = tileSource->loadTileConditional(page, x, y, zoom, validators);
+        if (!image) {
+            throw std::runtime_error("Source returned no tile");
+        }
+        return image;
+    }
+    return tileSource->loadTileImage(page, x, y, zoom);
+}
+
+void TileCache::revalidate(int page, int x, int y, int zoom) {
+    // gets called unlocked
+    std::string name = tileSource->getUniqueTileName(page, x, y, zoom);
+    TileValidators validators;
+    if (!loadValidators(name, validators)) {
+        // cached before validators were stored, nothing to compare against
+        return;
+    }
+
+    if (validators.expires == 0 || validators.expires > (int64_t) std::time(nullptr)) {
+        return;
+    }
+
+    try {
+        std::shared_ptr<Image> image = tileSource->loadTileConditional(page, x, y, zoom, validators);
+        if (image) {
+            logger::verbose("Tile %d/%d/%d changed on the server", zoom, x, y);
+            {
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                enterMemoryCache(page, x, y, zoom, image);
+            }
+            storeOnDisk(name, *image, validators);
+        } else {
+            storeValidators(name, validators);
+        }
+    } catch (const std::exception &e) {
+        // keep using the stale tile
+        logger::verbose("Couldn't revalidate tile %d/%d/%d: %s", zoom, x, y, e.what());
+    }
+}
+
+void TileCache::storeOnDisk(const std::string &name, Image &img, const TileValidators &validators) {
+    // gets called unlocked
+    auto archive = std::atomic_load(&cacheArchive);
+    if (!archive && cacheDir.empty()) {
+        return;
+    }
+
+    if (tileSource->cachesRenderedTiles()) {
+        try {
+            img.encodeQOI();
+        } catch (const std::exception &e) {
+            logger::verbose("Couldn't encode tile %s: %s", name.c_str(), e.what());
+            return;
+        }
+    }
+
+    if (archive) {
+        // the archive batches its writes already
+        archive->store(name, img.takeEncodedData());
+        if (tileSource->supportsRevalidation()) {
+            storeValidators(name, validators);
+        }
+        return;
+    }
+
+    PendingWrite write;
+    write.data = img.takeEncodedData();
+    if (write.data.empty()) {
+        return;
+    }
+    write.hasValidators = tileSource->supportsRevalidation();
+    write.validators = validators;
+    queueWrite(name, std::move(write));
+}
+
+void TileCache::queueWrite(const std::string &name, PendingWrite &&write) {
+    // gets called unlocked, waits while the writer is too far behind
+    std::unique_lock<std::mutex> lock(writeMutex);
+    writeCondition.wait(lock, [this] () { return pendingWrites.size() < MAX_PENDING_WRITES || !keepAlive; });
+
+    auto it = pendingWrites.find(name);
+    if (it != pendingWrites.end()) {
+        it->second = std::move(write);
+        return;
+    }
+    pendingWrites.emplace(name, std::move(write));
+    writeOrder.push_back(name);
+    writeCondition.notify_all();
+}
+
+bool TileCache::findPendingWrite(const std::string &name, std::vector<uint8_t> &data) {
+    // gets called unlocked
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto it = pendingWrites.find(name);
+    if (it != pendingWrites.end()) {
+        data = it->second.data;
+        return true;
+    }
+    if (currentWrite && currentWriteName == name) {
+        data = currentWrite->data;
+        return true;
+    }
+    return false;
+}
+
+void TileCache::writeLoop() {
+    crash::ThreadCookie crashCookie;
+    platform::Tracer::setThreadName("tile_writer");
+
+    // pending tiles are still written when the cache is destroyed
+    std::unique_lock<std::mutex> lock(writeMutex);
+    while (true) {
+        writeCondition.wait(lock, [this] () { return !writeOrder.empty() || !keepAlive; });
+        if (writeOrder.empty()) {
+            break;
+        }
+
+        std::string name = std::move(writeOrder.front());
+        writeOrder.pop_front();
+        auto it = pendingWrites.find(name);
+        PendingWrite write = std::move(it->second);
+        pendingWrites.erase(it);
+
+        // the tile stays visible to findPendingWrite until the file is complete,
+        // a newer version queued meanwhile is written afterwards
+        currentWriteName = name;
+        currentWrite = &write;
+        lock.unlock();
+        writeTileFile(name, write);
+        lock.lock();
+        currentWrite = nullptr;
+
+        writeCondition.notify_all();
+    }
+}
+
+void TileCache::writeTileFile(const std::string &name, const PendingWrite &write) {
+    // gets called unlocked from the writer thread
+    platform::TraceSpan span("write_tile");
+    std::string path = cacheDir + "/" + name;
+
+    // readers never see a partial tile
+    try {
+        platform::mkpath(platform::getDirNameFromPath(path));
+        platform::writeFileAtomically(path, write.data.data(), write.data.size());
+        platform::StatCache::shared().noteCreated(path, false);
+    } catch (const std::exception &e) {
+        logger::verbose("Couldn't store tile %s: %s", name.c_str(), e.what());
+        return;
+    }
+
+    if (write.hasValidators) {
+        storeValidators(name, write.validators);
+    }
+}
+
+bool TileCache::loadValidators(const std::string &name, TileValidators &validators) {
+    // gets called unlocked
+    auto archive = std::atomic_load(&cacheArchive);
+    if (archive) {
+        return archive->loadValidators(name, validators);
+    }
+
+    fs::ifstream stream(fs::u8path(cacheDir + "/" + name + META_SUFFIX));
+    if (!stream) {
+        return false;
+    }
+
+    std::string expires;
+    std::getline(stream, validators.etag);
+    std::getline(stream, validators.lastModified);
+    std::getline(stream, expires);
+    try {
+        validators.expires = std::stoll(expires);
+    } catch (const std::exception &e) {
+        return false;
+    }
+    return true;
+}
+
+void TileCache::storeValidators(const std::string &name, const TileValidators &validators) {
+    // gets called unlocked
+    auto archive = std::atomic_load(&cacheArchive);
+    if (archive) {
+        archive->storeValidators(name, validators);
+        return;
+    }
+
+    fs::ofstream stream(fs::u8path(cacheDir + "/" + name + META_SUFFIX));
+    stream << validators.etag << "\n" << validators.lastModified << "\n" << validators.expires << "\n";
 }
 
 void TileCache::enterMemoryCache(int page, int x, int y, int zoom, std::shared_ptr<Image> img) {
     // gets called with locked mutex
-    auto timeStamp = std::chrono::steady_clock::now();
-    MemCacheEntry entry(img, timeStamp);
-    memoryCache.insert(std::make_pair(tileSource->getUniqueTileName(page, x, y, zoom), entry));
+    memoryCache.put(TileMemoryCache::makeKey(cacheOwnerId, page, x, y, zoom), img);
+    failedTiles.erase(TileCoords(page, x, y, zoom));
 }
 
-void TileCache::cancelPendingRequests() {
-    std::lock_guard<std::mutex> lock(cacheMutex);
+void TileCache::cancelLoads() {
+    // gets called with locked mutex. Other caches may share the source, so
+    // the loads are cancelled one by one where the source supports it.
+    for (auto &token: loadTokens) {
+        *token = true;
+    }
+    if (!sharedNamespace.empty()) {
+        // shared loads only stop when no other cache waits for them
+        TileBroker::shared().cancelAbandoned();
+    }
     tileSource->cancelPendingLoads();
-    errorSet.clear();
-    loadSet.clear();
 }
 
-void TileCache::flushCache() {
-    // gets called unlocked
+void TileCache::cancelPendingRequests() {
     std::lock_guard<std::mutex> lock(cacheMutex);
-    auto now = std::chrono::steady_clock::now();
-    for (auto it = memoryCache.begin(); it != memoryCache.end(); ) {
-        auto diff = now - std::get<1>(it->second);
-        if (std::chrono::duration_cast<std::chrono::seconds>(diff).count() >= CACHE_SECONDS) {
-            it = memoryCache.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    cancelLoads();
+    loadSet.clear();
+    loadQueue.clear();
+    prefetchSet.clear();
 }
 
 void TileCache::invalidate() {
     // gets called unlocked
     std::lock_guard<std::mutex> lock(cacheMutex);
-    tileSource->cancelPendingLoads();
-    memoryCache.clear();
-    errorSet.clear();
+    cancelLoads();
+    memoryCache.removeOwner(cacheOwnerId);
+    failedTiles.clear();
     loadSet.clear();
+    loadQueue.clear();
+    prefetchSet.clear();
+
+    // tiles of the old state must not reach the disk anymore, the one being written does
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    pendingWrites.clear();
+    writeOrder.clear();
+    writeCondition.notify_all();
 }
 
 TileCache::~TileCache() {
     {
         std::lock_guard<std::mutex> lock(cacheMutex);
         keepAlive = false;
-        tileSource->cancelPendingLoads();
-        cacheCondition.notify_one();
+        seedQueue.clear();
+        cancelLoads();
+        cacheCondition.notify_all();
+    }
+    for (auto &thread: loaderThreads) {
+        thread.join();
+    }
+    if (writerThread) {
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+            writeCondition.notify_all();
+        }
+        writerThread->join();
     }
-    loaderThread->join();
+    memoryCache.releaseOwnerId(cacheOwnerId);
 }
 
 } /* namespace img */
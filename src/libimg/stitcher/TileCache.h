@@ -25,51 +25,158 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <atomic>
 #include <set>
+#include <vector>
 #include <tuple>
 #include <chrono>
 #include "TileSource.h"
+#include "TileMemoryCache.h"
+#include "TileArchive.h"
+#include "TileBroker.h"
 
 namespace img {
 
 class TileCache {
 public:
-    TileCache(std::shared_ptr<TileSource> source);
+    static constexpr const int MAX_LOADER_THREADS = 4;
+    static constexpr const size_t MAX_PREFETCH_TILES = 128;
+    static constexpr const size_t MAX_FAILED_TILES = 4096;
+    static constexpr const size_t MAX_PENDING_WRITES = 256;
+    static constexpr const char *META_SUFFIX = ".meta";
+
+    // page, x, y, zoom
+    using TileCoords = std::tuple<int, int, int, int>;
+
+    struct SeedProgress {
+        size_t total = 0;
+        size_t done = 0;
+        size_t failed = 0;
+        bool running = false;
+    };
+
+    TileCache(std::shared_ptr<TileSource> source, int maxLoaders = MAX_LOADER_THREADS);
     void setCacheDirectory(const std::string &utf8Path);
+    void setCacheArchive(const std::string &utf8Path, size_t maxBytes = TileArchive::DEFAULT_MAX_BYTES);
+
     std::shared_ptr<Image> getTile(int page, int x, int y, int zoom);
+    // memory cache only, never enqueues a load
+    std::shared_ptr<Image> peekTile(int page, int x, int y, int zoom);
+    void prefetch(int page, int x, int y, int zoom);
+    void setFocus(int page, double centerX, double centerY, int zoom, int radiusX, int radiusY);
+    // For pages stacked below each other in one tile space, see Stitcher::setContinuousPages.
+    // firstRows holds the first tile row of each page at the zoom level, centerY is a row in
+    // that space and the pages from firstPage to lastPage are in view.
+    void setStackedFocus(const std::vector<int> &firstRows, int firstPage, int lastPage,
+                         double centerX, double centerY, int zoom, int radiusX, int radiusY);
     void cancelPendingRequests();
     void invalidate();
+
+    // Download tiles into the disk cache in the background. Tiles that are
+    // already cached are skipped, so restarting a job resumes it.
+    void startSeeding(const std::vector<TileCoords> &tiles, int maxConcurrent = 1);
+    void stopSeeding();
+    SeedProgress getSeedProgress();
+
     ~TileCache();
 private:
-    static constexpr const int CACHE_SECONDS = 30;
-    using TimeStamp = std::chrono::time_point<std::chrono::steady_clock>;
-    using TileCoords = std::tuple<int, int, int, int>;
-    using MemCacheEntry = std::tuple<std::shared_ptr<Image>, TimeStamp>;
+
+    // Negative cache entry: the tile is shown as error until retryAt
+    struct FailedTile {
+        TileLoadError::Kind kind = TileLoadError::Kind::OTHER;
+        int failures = 0;
+        std::chrono::steady_clock::time_point retryAt;
+    };
+
+    // a tile that the writer thread still has to put into the cache directory
+    struct PendingWrite {
+        std::vector<uint8_t> data;
+        bool hasValidators = false;
+        TileValidators validators;
+    };
+
+    struct Focus {
+        int firstPage = 0, lastPage = 0;
+        double x = 0, y = 0;
+        int zoom = 0;
+        int radiusX = 0, radiusY = 0;
+        // empty unless the pages are stacked
+        std::vector<int> firstRows;
+    };
 
     std::shared_ptr<TileSource> tileSource;
+    TileMemoryCache &memoryCache;
+    const uint32_t cacheOwnerId;
+    const std::string sharedNamespace;
     std::string cacheDir;
-    std::unique_ptr<std::thread> loaderThread;
+    // can be set while the loader threads run, read it with std::atomic_load
+    std::shared_ptr<TileArchive> cacheArchive;
+    std::vector<std::thread> loaderThreads;
 
     std::shared_ptr<Image> errorTile;
 
     std::mutex cacheMutex;
     std::condition_variable cacheCondition;
-    std::map<std::string, MemCacheEntry> memoryCache;
     std::set<TileCoords> loadSet;
-    std::set<TileCoords> errorSet;
+    std::vector<TileCoords> loadQueue; // heap ordered by loadPriority
+    Focus focus;
+    std::set<TileCoords> inFlightSet;
+    // of the loads and seeds that are running, set to cancel them
+    std::set<TileLoadCancel::Token> loadTokens;
+    std::set<TileCoords> prefetchSet; // only loaded when the load queue is empty
+    std::map<TileCoords, FailedTile> failedTiles;
+
+    std::deque<TileCoords> seedQueue;
+    SeedProgress seedProgress;
+    int seedConcurrency = 1;
+    int activeSeeds = 0;
 
     std::atomic_bool keepAlive { true };
 
+    // write-behind for the cache directory so that the loaders don't wait for the disk,
+    // a newer version of a tile replaces a pending one
+    std::mutex writeMutex;
+    std::condition_variable writeCondition;
+    std::map<std::string, PendingWrite> pendingWrites;
+    std::deque<std::string> writeOrder;
+    // taken from pendingWrites while its file is written
+    std::string currentWriteName;
+    const PendingWrite *currentWrite = nullptr;
+    std::unique_ptr<std::thread> writerThread;
+
     std::shared_ptr<Image> getFromMemory(int page, int x, int y, int zoom);
     std::shared_ptr<Image> getFromDisk(int page, int x, int y, int zoom);
     void enqueue(int page, int x, int y, int zoom);
+    bool isFailed(const TileCoords &coords);
+    void markFailed(const TileCoords &coords, TileLoadError::Kind kind);
+    static std::chrono::seconds retryDelay(TileLoadError::Kind kind, int failures);
+    double loadPriority(const TileCoords &coords) const;
+    bool isStale(const TileCoords &coords) const;
+    double focusRow(const TileCoords &coords) const;
+    void updateFocus(Focus &&newFocus);
+    bool comparePriority(const TileCoords &a, const TileCoords &b) const;
+    void reprioritize();
 
     void loadLoop();
     bool hasWork();
-    void flushCache();
+    bool canSeed();
+    bool takeJob(TileCoords &coords, bool &isSeed, bool &isPrefetch);
+    void seedTile(const TileCoords &coords);
+    bool isOnDisk(const std::string &name);
     void loadAndCacheTile(int page, int x, int y, int zoom);
     void enterMemoryCache(int page, int x, int y, int zoom, std::shared_ptr<Image> img);
+    // called with locked mutex, cancels the running loads of this cache only
+    void cancelLoads();
+    std::unique_ptr<Image> loadFromSource(int page, int x, int y, int zoom, TileValidators &validators);
+    void storeOnDisk(const std::string &name, Image &img, const TileValidators &validators);
+    void queueWrite(const std::string &name, PendingWrite &&write);
+    bool findPendingWrite(const std::string &name, std::vector<uint8_t> &data);
+    void writeLoop();
+    void writeTileFile(const std::string &name, const PendingWrite &write);
+    bool loadValidators(const std::string &name, TileValidators &validators);
+    void storeValidators(const std::string &name, const TileValidators &validators);
+    void revalidate(int page, int x, int y, int zoom);
 };
 
 } /* namespace img */
@@ -0,0 +1,185 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <functional>
+#include "TileMemoryCache.h"
+#include "src/platform/Metrics.h"
+
+namespace img {
+
+TileMemoryCache &TileMemoryCache::shared() {
+    static TileMemoryCache cache;
+    return cache;
+}
+
+TileMemoryCache::TileMemoryCache():
+    usedOwnerIds(MAX_OWNERS, false)
+{
+    stats.budget = DEFAULT_BUDGET_BYTES;
+    memoryConsumer = platform::MemoryBudget::shared().addConsumer("tiles", platform::MemoryBudget::Priority::DECODED_IMAGES,
+        [this] () { return getStats().bytes; },
+        [this] (size_t bytes) { return trim(bytes); });
+}
+
+TileMemoryCache::Key TileMemoryCache::makeKey(uint32_t owner, int page, int x, int y, int zoom) {
+    return Key{owner, page, zoom, x, y};
+}
+
+bool TileMemoryCache::Key::operator==(const Key &other) const {
+    return owner == other.owner && page == other.page && zoom == other.zoom && x == other.x && y == other.y;
+}
+
+size_t TileMemoryCache::KeyHash::operator()(const Key &key) const {
+    // neighbouring tiles differ in the low bits of x and y
+    uint64_t h = key.owner;
+    h = h * 1000003 + (uint32_t) key.page;
+    h = h * 1000003 + (uint32_t) key.zoom;
+    h = h * 1000003 + (uint32_t) key.x;
+    h = h * 1000003 + (uint32_t) key.y;
+    return std::hash<uint64_t>()(h);
+}
+
+uint32_t TileMemoryCache::acquireOwnerId() {
+    // ids are recycled so that they fit into the key
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < usedOwnerIds.size(); i++) {
+        if (!usedOwnerIds[i]) {
+            usedOwnerIds[i] = true;
+            return i;
+        }
+    }
+    throw std::runtime_error("Too many tile caches");
+}
+
+void TileMemoryCache::releaseOwnerId(uint32_t owner) {
+    removeOwner(owner);
+    std::lock_guard<std::mutex> lock(mutex);
+    usedOwnerIds.at(owner) = false;
+}
+
+size_t TileMemoryCache::byteSize(const Image &img) {
+    return img.getMemorySize();
+}
+
+size_t TileMemoryCache::trim(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t released = 0;
+    while (released < bytes && lru.size() > 1) {
+        auto &entry = lru.back();
+        released += entry.bytes;
+        stats.bytes -= entry.bytes;
+        index.erase(entry.key);
+        lru.pop_back();
+        stats.evictions++;
+    }
+    updateMetrics();
+    return released;
+}
+
+void TileMemoryCache::setByteBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.budget = bytes;
+    evict();
+}
+
+std::shared_ptr<Image> TileMemoryCache::get(Key key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+        stats.misses++;
+        return nullptr;
+    }
+
+    stats.hits++;
+    lru.splice(lru.begin(), lru, it->second);
+    auto img = it->second->img;
+
+    // compressed tiles grow when a reader expands them
+    size_t bytes = byteSize(*img);
+    if (bytes != it->second->bytes) {
+        stats.bytes = stats.bytes - it->second->bytes + bytes;
+        it->second->bytes = bytes;
+        evict();
+        updateMetrics();
+    }
+    return img;
+}
+
+void TileMemoryCache::put(Key key, std::shared_ptr<Image> img) {
+    if (!img) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    size_t bytes = byteSize(*img);
+    if (it != index.end()) {
+        stats.bytes -= it->second->bytes;
+        it->second->img = img;
+        it->second->bytes = bytes;
+        lru.splice(lru.begin(), lru, it->second);
+    } else {
+        lru.push_front(Entry{key, img, bytes});
+        index.insert(std::make_pair(key, lru.begin()));
+    }
+    stats.bytes += bytes;
+    evict();
+    updateMetrics();
+}
+
+void TileMemoryCache::removeOwner(uint32_t owner) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = lru.begin(); it != lru.end(); ) {
+        if (it->key.owner == owner) {
+            stats.bytes -= it->bytes;
+            index.erase(it->key);
+            it = lru.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    updateMetrics();
+}
+
+void TileMemoryCache::updateMetrics() {
+    // gets called with locked mutex
+    static auto &memoryBytes = platform::Metrics::gauge("tiles/memory_bytes");
+    static auto &memoryTiles = platform::Metrics::gauge("tiles/memory_tiles");
+    memoryBytes.set(stats.bytes);
+    memoryTiles.set(index.size());
+}
+
+TileMemoryCache::Stats TileMemoryCache::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats res = stats;
+    res.entries = index.size();
+    return res;
+}
+
+void TileMemoryCache::evict() {
+    // gets called with locked mutex, always keeps the most recent tile
+    while (stats.bytes > stats.budget && lru.size() > 1) {
+        auto &entry = lru.back();
+        stats.bytes -= entry.bytes;
+        index.erase(entry.key);
+        lru.pop_back();
+        stats.evictions++;
+    }
+}
+
+} /* namespace img */
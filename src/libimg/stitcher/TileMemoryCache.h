@@ -0,0 +1,94 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include "src/platform/MemoryBudget.h"
+#include "src/libimg/Image.h"
+
+namespace img {
+
+// LRU cache for decoded tiles, shared by all TileCache instances and
+// bounded by the number of bytes used for the pixels of the cached tiles
+class TileMemoryCache {
+public:
+    static constexpr const size_t DEFAULT_BUDGET_BYTES = 256 * 1024 * 1024;
+
+    struct Key {
+        uint32_t owner;
+        int page, zoom, x, y;
+        bool operator==(const Key &other) const;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+    static TileMemoryCache &shared();
+    static Key makeKey(uint32_t owner, int page, int x, int y, int zoom);
+
+    uint32_t acquireOwnerId();
+    void releaseOwnerId(uint32_t owner);
+
+    void setByteBudget(size_t bytes);
+    // evicts the least recently used until the given bytes are released, returns the bytes released
+    size_t trim(size_t bytes);
+    std::shared_ptr<Image> get(Key key);
+    void put(Key key, std::shared_ptr<Image> img);
+    void removeOwner(uint32_t owner);
+    Stats getStats();
+
+private:
+    static constexpr const size_t MAX_OWNERS = 1024;
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const;
+    };
+
+    struct Entry {
+        Key key;
+        std::shared_ptr<Image> img;
+        size_t bytes; // updated on lookups, compressed images grow when they are expanded
+    };
+    using EntryList = std::list<Entry>;
+
+    std::mutex mutex;
+    EntryList lru; // most recently used first
+    std::unordered_map<Key, EntryList::iterator, KeyHash> index;
+    std::vector<bool> usedOwnerIds;
+    Stats stats;
+    platform::MemoryBudget::Registration memoryConsumer;
+
+    TileMemoryCache();
+    static size_t byteSize(const Image &img);
+    void evict();
+    void updateMetrics();
+};
+
+} /* namespace img */
@@ -18,7 +18,12 @@
 #pragma once
 
 #include "src/libimg/Image.h"
+#include "src/libimg/ColorLUT.h"
 #include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <memory>
+#include <atomic>
 
 namespace img {
 
@@ -28,6 +33,53 @@ struct Point {
     T y {};
 };
 
+// Can be thrown by loadTileImage so that the cache knows when to retry a failed tile.
+// Other exceptions are treated as Kind::OTHER, std::out_of_range means cancelled.
+class TileLoadError: public std::runtime_error {
+public:
+    enum class Kind {
+        NOT_FOUND,  // the tile doesn't exist, e.g. HTTP 404
+        NETWORK,    // timeouts and connection problems
+        SERVER,     // server overloaded or failing, e.g. HTTP 429 or 5xx
+        DECODE,     // received data is not a valid image
+        OTHER,
+    };
+
+    TileLoadError(Kind kind, const std::string &msg): std::runtime_error(msg), kind(kind) { }
+    Kind getKind() const { return kind; }
+private:
+    Kind kind;
+};
+
+// HTTP style freshness information that the cache stores next to each tile
+struct TileValidators {
+    std::string etag;
+    std::string lastModified;
+    int64_t expires = 0; // unix time, 0 if the tile never expires
+};
+
+// Cancellation of the tile load running on the current thread. The cache sets up a token
+// for each load, sources that can stop a single load early check it or pass it to their
+// transfers and throw std::out_of_range once it's set.
+class TileLoadCancel {
+public:
+    using Token = std::shared_ptr<std::atomic_bool>;
+
+    // the token of the loads on this thread until the scope ends
+    class Scope {
+    public:
+        explicit Scope(Token token): previous(current) { current = token; }
+        ~Scope() { current = previous; }
+    private:
+        Token previous;
+    };
+
+    // a token that is never set if no load set one up
+    static Token get() { return current ? current : std::make_shared<std::atomic_bool>(false); }
+private:
+    static inline thread_local Token current;
+};
+
 class TileSource {
 public:
     // Basic information
@@ -47,6 +99,20 @@ public:
     // Control the underlying loader
     virtual void cancelPendingLoads() = 0;
     virtual void resumeLoading() = 0;
+    // Number of tiles that can be loaded in parallel. Sources returning more
+    // than one must allow concurrent calls to loadTileImage
+    virtual int getMaxConcurrentLoads() { return 1; }
+    // Non-empty if the unique tile names identify the same image across all
+    // instances, e.g. URLs. Caches then share loads through the TileBroker.
+    virtual std::string getSharedTileNamespace() { return ""; }
+    // Sources that render their tiles locally, the disk cache then stores them as QOI.
+    // Their unique tile names must identify the rendered content, e.g. by a file hash.
+    virtual bool cachesRenderedTiles() { return false; }
+    // Sources that render their tiles from compact data, e.g. vector tiles. Their images
+    // keep that data as their encoded data, so the disk cache stores it instead of the
+    // pixels and has the source render it again with renderTileData when loading.
+    virtual bool cachesTileData() { return false; }
+    virtual std::unique_ptr<img::Image> renderTileData(const std::vector<uint8_t> &data, int zoom) { return nullptr; }
 
     // Query and load tile information
     virtual int getPageCount() = 0;
@@ -54,10 +120,33 @@ public:
     virtual bool isTileValid(int page, int x, int y, int zoom) = 0;
     virtual std::string getUniqueTileName(int page, int x, int y, int zoom) = 0;
     virtual std::unique_ptr<img::Image> loadTileImage(int page, int x, int y, int zoom) = 0;
+    // A low resolution image of the whole page, scaled up for tiles that are still loading.
+    // Must not block, sources return nullptr until it is available.
+    virtual std::shared_ptr<img::Image> getPagePreview(int page) { return nullptr; }
+    // A small image of the page for page overviews, also nullptr until it is available
+    virtual std::shared_ptr<img::Image> getPageThumbnail(int page) { return nullptr; }
+    // Applied to the tiles when they are composed, e.g. for night mode. Changing
+    // it only redraws the view from the cached tiles.
+    virtual std::shared_ptr<const ColorLUT> getColorMap() { return nullptr; }
+
+    // Sources that can check whether a cached tile is still current. Returns nullptr
+    // if the tile described by the validators is unchanged, else the new tile.
+    // The validators are updated in both cases.
+    virtual bool supportsRevalidation() { return false; }
+    virtual std::unique_ptr<img::Image> loadTileConditional(int page, int x, int y, int zoom, TileValidators &validators) {
+        validators = TileValidators{};
+        return loadTileImage(page, x, y, zoom);
+    }
 
     // World position support
     virtual Point<double> worldToXY(double lon, double lat, int zoom) = 0;
     virtual Point<double> xyToWorld(double x, double y, int zoom) = 0;
+    // worldToXY for count positions at once, sources can override it with vectorised code
+    virtual void worldToXYBatch(const double *lons, const double *lats, Point<double> *xy, size_t count, int zoom) {
+        for (size_t i = 0; i < count; i++) {
+            xy[i] = worldToXY(lons[i], lats[i], zoom);
+        }
+    }
     virtual void attachCalibration1(double x, double y, double lat, double lon, int zoom) {}
     virtual void attachCalibration2(double x, double y, double lat, double lon, int zoom) {}
     virtual void attachCalibration3Point(double x, double y, double lat, double lon, int zoom) {}
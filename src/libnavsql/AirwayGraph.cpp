@@ -0,0 +1,89 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "AirwayGraph.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace sqlnav {
+
+void AirwayGraph::addAirway(int airwayId, const std::string &name, const std::string &type)
+{
+    if (airwayId <= 0) {
+        return;
+    }
+    if ((size_t)airwayId >= airways.size()) {
+        airways.resize(airwayId + 1);
+    }
+    auto &e = airways[airwayId];
+    if (type != "J") {
+        e.lower = std::make_shared<world::Airway>(name, world::AirwayLevel::LOWER);
+    }
+    if (type != "V") {
+        e.upper = std::make_shared<world::Airway>(name, world::AirwayLevel::UPPER);
+    }
+}
+
+void AirwayGraph::addLeg(int fromFix, int toFix, int airwayId)
+{
+    if ((airwayId <= 0) || ((size_t)airwayId >= airways.size())) {
+        return;
+    }
+    if (fixes.empty() || (fixes.back() != fromFix)) {
+        if (!fixes.empty() && (fixes.back() > fromFix)) {
+            throw std::runtime_error("Airway legs are not ordered by their from fix");
+        }
+        fixes.push_back(fromFix);
+        offsets.push_back((uint32_t)legs.size());
+    }
+    legs.push_back(Leg{toFix, (uint32_t)airwayId});
+}
+
+void AirwayGraph::build()
+{
+    offsets.push_back((uint32_t)legs.size());
+    fixes.shrink_to_fit();
+    offsets.shrink_to_fit();
+    legs.shrink_to_fit();
+}
+
+std::pair<const AirwayGraph::Leg *, const AirwayGraph::Leg *> AirwayGraph::legsFrom(int fixId) const
+{
+    auto it = std::lower_bound(fixes.begin(), fixes.end(), fixId);
+    if ((it == fixes.end()) || (*it != fixId)) {
+        return std::make_pair(nullptr, nullptr);
+    }
+    auto i = it - fixes.begin();
+    return std::make_pair(legs.data() + offsets[i], legs.data() + offsets[i + 1]);
+}
+
+std::shared_ptr<world::Airway> AirwayGraph::getLowerAirway(uint32_t airway) const
+{
+    return (airway < airways.size()) ? airways[airway].lower : nullptr;
+}
+
+std::shared_ptr<world::Airway> AirwayGraph::getUpperAirway(uint32_t airway) const
+{
+    return (airway < airways.size()) ? airways[airway].upper : nullptr;
+}
+
+size_t AirwayGraph::size() const
+{
+    return legs.size();
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "src/world/models/Airway.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sqlnav {
+
+/*
+ * The airway network of the NAV database kept in memory in compressed sparse
+ * row form, so that route finding doesn't need a query per visited fix. The
+ * legs are grouped by the fix they leave from, the fixes themselves are only
+ * referred to by their fix_id.
+ */
+class AirwayGraph {
+public:
+    struct Leg {
+        int toFix;
+        uint32_t airway;
+    };
+
+    // an airway of type 'B' is usable at both levels, so it has an edge for each
+    void addAirway(int airwayId, const std::string &name, const std::string &type);
+
+    // the legs must be added in order of their from fix, then build() before use
+    void addLeg(int fromFix, int toFix, int airwayId);
+    void build();
+
+    // the legs leaving a fix, an empty range if it isn't on an airway
+    std::pair<const Leg *, const Leg *> legsFrom(int fixId) const;
+
+    // the edges of an airway, at most one of them may be null
+    std::shared_ptr<world::Airway> getLowerAirway(uint32_t airway) const;
+    std::shared_ptr<world::Airway> getUpperAirway(uint32_t airway) const;
+
+    size_t size() const;
+
+private:
+    struct Edges {
+        std::shared_ptr<world::Airway> lower, upper;
+    };
+
+    // indexed by airway_id, which the translator numbers from 1
+    std::vector<Edges> airways;
+
+    // fixes[i] has the legs from offsets[i] to offsets[i + 1]
+    std::vector<int> fixes;
+    std::vector<uint32_t> offsets;
+    std::vector<Leg> legs;
+};
+
+}
@@ -37,8 +37,13 @@ static const char * createSearchTable =
         "airport_id INTEGER,"
         "fix_id INTEGER"
     ") STRICT;"
-    "CREATE INDEX idx_grid_search_ilonx ON grid_search(ilonx);"
-    "CREATE INDEX idx_grid_search_ilaty ON grid_search(ilaty);"
+;
+
+static const char * createSearchIndexes =
+    // SQLite uses a single index per table scan, so separate lon and lat indexes
+    // only narrow a cell lookup to a whole column of the grid. The composite index
+    // finds a cell in one range step and also covers the node ids.
+    "CREATE INDEX idx_grid_search_cell ON grid_search(ilonx, ilaty, airport_id, fix_id);"
 ;
 
 static const char * createCountTable =
@@ -47,8 +52,10 @@ static const char * createCountTable =
         "ilaty INTEGER,"
         "nodes INTEGER"
     ") STRICT;"
-    "CREATE INDEX idx_grid_count_ilonx ON grid_count(ilonx);"
-    "CREATE INDEX idx_grid_count_ilaty ON grid_count(ilaty);"
+;
+
+static const char * createCountIndexes =
+    "CREATE INDEX idx_grid_count_cell ON grid_count(ilonx, ilaty, nodes);"
 ;
 
 static const char * createAirportTable =
@@ -62,6 +69,9 @@ static const char * createAirportTable =
         "lonx REAL NOT NULL,"
         "laty REAL NOT NULL"
     ") STRICT;"
+;
+
+static const char * createAirportIndexes =
     "CREATE INDEX idx_airport_ident ON airport(ident);"
     "CREATE INDEX idx_airport_name ON airport(name);"
 ;
@@ -74,6 +84,9 @@ static const char * createComTable =
         "name TEXT,"
         "FOREIGN KEY(airport_id) REFERENCES airport(airport_id)"
     ") STRICT;"
+;
+
+static const char * createComIndexes =
     "CREATE INDEX idx_com_airport_id ON com(airport_id);"
 ;
 
@@ -94,6 +107,9 @@ static const char * createRunwayTable =
         "laty REAL NOT NULL,"
         "FOREIGN KEY(airport_id) REFERENCES airport(airport_id)"
     ") STRICT;"
+;
+
+static const char * createRunwayIndexes =
     "CREATE INDEX idx_runway_airport_id ON runway(airport_id);"
 ;
 
@@ -106,6 +122,9 @@ static const char * createStartTable =
         "laty REAL NOT NULL,"
         "FOREIGN KEY(airport_id) REFERENCES airport(airport_id)"
     ") STRICT;"
+;
+
+static const char * createStartIndexes =
     "CREATE INDEX idx_start_airport_id ON start(airport_id);"
     "CREATE INDEX idx_start_type ON start(type);"
 ;
@@ -121,6 +140,9 @@ static const char * createFixTable =
         "lonx REAL NOT NULL,"
         "laty REAL NOT NULL"
     ") STRICT;"
+;
+
+static const char * createFixIndexes =
     "CREATE INDEX idx_fix_airport_id ON fix(airport_id);"
     "CREATE INDEX idx_fix_ident ON fix(ident);"
     "CREATE INDEX idx_fix_region ON fix(region);"
@@ -141,6 +163,9 @@ static const char * createILSTable =
         "range INTEGER NOT NULL,"
         "dme_range INTEGER"
     ") STRICT;"
+;
+
+static const char * createILSIndexes =
     "CREATE INDEX idx_ils_ident ON ils(ident);"
     "CREATE INDEX idx_ils_loc_runway_end_id ON ils(runway_id);"
 ;
@@ -160,6 +185,9 @@ static const char * createVORTable =
         "mag_var REAL,"
         "dme_only INTEGER NOT NULL"
     ") STRICT;"
+;
+
+static const char * createVORIndexes =
     "CREATE INDEX idx_vor_ident ON vor(ident);"
     "CREATE INDEX idx_vor_airport_id ON vor(airport_id);"
 ;
@@ -177,6 +205,9 @@ static const char * createNDBTable =
         "range INTEGER,"
         "mag_var REAL"
     ") STRICT;"
+;
+
+static const char * createNDBIndexes =
     "CREATE INDEX idx_ndb_ident ON ndb(ident);"
     "CREATE INDEX idx_ndb_airport_id ON ndb(airport_id);"
 ;
@@ -196,8 +227,12 @@ static const char * createProcedureTable =
         "runway_name TEXT,"         // if blank, applies to all runways
         "initial_fix_id INTEGER,"   // initial fix (or 0 for SID that applies to all runways)
         "final_fix_id INTEGER,"     // final fix (or 0 for approach that applies to all runways)
-        "via_fixes TEXT"            // intermediate fix IDs, separated by ':', only used for route construction
+        "via_fixes TEXT,"           // intermediate fix IDs, separated by ':', only used for route construction
+        "fix_ids BLOB"              // all fix IDs from initial to final as packed 32 bit integers
     ") STRICT;"
+;
+
+static const char * createProcedureIndexes =
     "CREATE INDEX idx_proc_airport ON procedure(airport_id);"
     "CREATE INDEX idx_proc_name ON procedure(name);"
     "CREATE INDEX idx_proc_type ON procedure(type);"
@@ -211,8 +246,12 @@ static const char * createTransitionTable =
         "name TEXT,"                // name of the transition
         "initial_fix_id INTEGER,"   // initial fix
         "final_fix_id INTEGER,"     // final fix
-        "via_fixes TEXT"            // intermediate fix IDs, separated by :
+        "via_fixes TEXT,"           // intermediate fix IDs, separated by :
+        "fix_ids BLOB"              // all fix IDs from initial to final as packed 32 bit integers
     ") STRICT;"
+;
+
+static const char * createTransitionIndexes =
     "CREATE INDEX idx_transition_proc ON transition(procedure_id);"
 ;
 
@@ -225,17 +264,27 @@ static const char * createAirwayTable =
         "final_fix_id INTEGER,"     // final fix
         "via_fixes TEXT"            // intermediate fix IDs, separated by :
     ") STRICT;"
-    "CREATE INDEX idx_airway_name ON airway(name);"
-    "CREATE INDEX idx_airway_fixs ON airway(initial_fix_id);"
-    "CREATE INDEX idx_airway_fixe ON airway(final_fix_id);"
     "CREATE TABLE fix_airway ("
         "fix_id INTEGER,"
         "airway_id INTEGER,"
         "FOREIGN KEY(fix_id) REFERENCES fix(fix_id),"
         "FOREIGN KEY(airway_id) REFERENCES airway(airway_id)"
     ") STRICT;"
+    // one row per leg in its direction of travel, loaded wholesale for route finding
+    "CREATE TABLE airway_leg ("
+        "from_fix_id INTEGER,"
+        "to_fix_id INTEGER,"
+        "airway_id INTEGER"
+    ") STRICT;"
+;
+
+static const char * createAirwayIndexes =
+    "CREATE INDEX idx_airway_name ON airway(name);"
+    "CREATE INDEX idx_airway_fixs ON airway(initial_fix_id);"
+    "CREATE INDEX idx_airway_fixe ON airway(final_fix_id);"
     "CREATE INDEX idx_fix_id ON fix_airway(fix_id);"
     "CREATE INDEX idx_airway_id ON fix_airway(airway_id);"
+    "CREATE INDEX idx_airway_leg_from ON airway_leg(from_fix_id, to_fix_id, airway_id);"
 ;
 
 static const char * setDatabaseOptions(
@@ -262,4 +311,22 @@ static std::vector<const char *> tableCreateCommands = {
     setDatabaseOptions
 };
 
+// indexes are created separately so that a bulk load can insert all of the rows
+// first and then build each index in a single sorted pass.
+static std::vector<const char *> indexCreateCommands = {
+    createSearchIndexes,
+    createCountIndexes,
+    createAirportIndexes,
+    createComIndexes,
+    createRunwayIndexes,
+    createStartIndexes,
+    createFixIndexes,
+    createILSIndexes,
+    createVORIndexes,
+    createNDBIndexes,
+    createProcedureIndexes,
+    createTransitionIndexes,
+    createAirwayIndexes
+};
+
 } /* namespace NavDbSchema */
\ No newline at end of file
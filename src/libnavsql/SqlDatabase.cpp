@@ -53,16 +53,30 @@ SqlDatabase::SqlDatabase(const std::string &dbFilePath, bool readonly, bool crea
         throw std::runtime_error("NAV world SQL database not found");
     }
     if (readonly) {
-        // turn off journalling and synchronising for read-only databases
+        // turn off journalling and synchronising for read-only databases.
+        // the file is memory mapped so that all connections share the OS page cache,
+        // the page cache of each connection only needs to hold the hot index pages.
         std::string errMsg;
         int e = runscript("PRAGMA journal_mode = OFF;", errMsg);
         if (!e) e = runscript("PRAGMA synchronous = OFF;", errMsg);
+        if (!e) e = runscript("PRAGMA query_only = ON;", errMsg);
+        if (!e) e = runscript("PRAGMA mmap_size = 1073741824;", errMsg);
+        if (!e) e = runscript("PRAGMA cache_size = -16384;", errMsg);
+        if (!e) e = runscript("PRAGMA temp_store = MEMORY;", errMsg);
         if (e != 0) {
             logger::warn("Error code %d when configuring Avitab database: %s", e, errMsg.c_str());
         }
     } else if (create) {
-        // set up the tables ready for populating the NAV data
+        // set up the tables ready for populating the NAV data. the file is deleted
+        // if the build fails, so there is no need to journal or sync each commit.
         createTables();
+        std::string errMsg;
+        int e = runscript("PRAGMA journal_mode = MEMORY;", errMsg);
+        if (!e) e = runscript("PRAGMA synchronous = OFF;", errMsg);
+        if (!e) e = runscript("PRAGMA cache_size = -262144;", errMsg);
+        if (e != 0) {
+            logger::warn("Error code %d when configuring Avitab database: %s", e, errMsg.c_str());
+        }
     }
 }
 
@@ -108,4 +122,17 @@ void SqlDatabase::createTables()
     }
 }
 
+void SqlDatabase::createIndexes()
+{
+    for (auto s: NavDbSchema::indexCreateCommands)
+    {
+        std::string errMsg;
+        int e = runscript(s, errMsg);
+        if (e != 0) {
+            logger::error("Error code %d when creating Avitab NAVdb indexes: %s", e, errMsg.c_str());
+            throw std::runtime_error("Avitab database create error");
+        }
+    }
+}
+
 }
@@ -23,7 +23,7 @@
 
 namespace sqlnav {
 
-static constexpr int NAV_DB_VERSION = 2;
+static constexpr int NAV_DB_VERSION = 4;
 
 class SqlStatement;
 
@@ -37,6 +37,9 @@ public:
     std::shared_ptr<SqlStatement> compile(const std::string &statement);
     int runscript(const std::string &script, std::string &err);
 
+    // a newly created database has no indexes until the bulk load calls this
+    void createIndexes();
+
 private:
     void createTables();
 
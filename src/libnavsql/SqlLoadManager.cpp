@@ -18,18 +18,28 @@
 
 #include "SqlLoadManager.h"
 #include <stdexcept>
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include "loaders/AirportLoader.h"
 #include "loaders/FixLoader.h"
+#include "loaders/AreaLoader.h"
 #include "src/Logger.h"
 
 namespace sqlnav {
 
+// A connection and the statements compiled on it, only used by the thread that owns it
+struct SqlLoadManager::QueryPool {
+    std::shared_ptr<SqlDatabase> database;
+    std::map<int, std::shared_ptr<SqlStatement>> queries;
+};
+
+std::atomic<uint64_t> SqlLoadManager::nextInstanceId { 0 };
+
 SqlLoadManager::SqlLoadManager(std::string dbdir)
 {
     logger::info("Looking for SQL database file in  %s", dbdir.c_str());
-    std::string dbfile = dbdir + "avitab_navdb.sqlite";
+    dbfile = dbdir + FILE_NAME;
 
     database = std::make_shared<SqlDatabase>(dbfile, true);
 }
@@ -42,15 +52,33 @@ void SqlLoadManager::init_or_throw(std::function<bool(const std::string simCode)
     // these will throw an exception if DB schema does not support the searches
     // that's fine, it will be caught in the environment, and trigger a fallback
     // to the legacy NAV data loader (if one exists).
+    beginPhase("SQL searches");
     prepareSearches();
     checkMetadata(fn);
+    beginPhase("regions");
     populateRegions();
+    beginPhase("densities");
+    populateDensities();
+    beginPhase("airport search");
+    populateAirportSearch();
+    endPhase(airportSearch.size());
+    beginPhase("airway graph");
+    endPhase(populateAirwayGraph());
 }
 
 SqlLoadManager::~SqlLoadManager()
 {
     // stop background area loading before dismantling the load manager
     sqlworld->shutdown();
+
+    // no thread searches anymore, so their connections can be closed
+    std::lock_guard<std::mutex> guard(poolGuard);
+    for (auto &weakPool: pools) {
+        if (auto pool = weakPool.lock()) {
+            pool->queries.clear();
+            pool->database.reset();
+        }
+    }
 }
 
 void SqlLoadManager::discoverSceneries()
@@ -60,7 +88,11 @@ void SqlLoadManager::discoverSceneries()
 
 void SqlLoadManager::load()
 {
+    // the database is opened and indexed in init_or_throw, only user data is loaded here
+    beginPhase("user fixes");
     loadUserFixes();
+    endPhase();
+    logLoadPhases();
 }
 
 void SqlLoadManager::reloadMetar()
@@ -74,88 +106,167 @@ std::shared_ptr<world::Region> SqlLoadManager::getRegion(const std::string &id)
     return sqlworld->getRegion(id);
 }
 
-std::shared_ptr<SqlStatement> SqlLoadManager::GetSQL(Searches name, bool background)
+std::shared_ptr<SqlStatement> SqlLoadManager::GetSQL(Searches name)
+{
+    // each thread has its own connection, its statements are compiled on first use
+    auto &pool = getQueryPool();
+    auto it = pool.queries.find(name);
+    if (it != pool.queries.end()) {
+        return it->second;
+    }
+    auto sql = searchSql.find(name);
+    if (sql == searchSql.end()) {
+        return nullptr;
+    }
+    auto stmt = pool.database->compile(sql->second);
+    pool.queries[name] = stmt;
+    return stmt;
+}
+
+void SqlLoadManager::prepare(Searches name, const char *sql)
 {
-    auto &qtab = background ? backQueries : foreQueries;
-    if (qtab.find(name) == qtab.end()) return nullptr;
-    return qtab[name];
+    searchSql[name] = sql;
+}
+
+SqlLoadManager::QueryPool &SqlLoadManager::getQueryPool()
+{
+    // the pools are released with their thread, keyed by manager so that a
+    // reloaded database never gets the statements of the previous one
+    static thread_local std::map<uint64_t, std::shared_ptr<QueryPool>> threadPools;
+    auto &pool = threadPools[instanceId];
+    if (!pool) {
+        pool = std::make_shared<QueryPool>();
+        // the first thread, which initialises the manager, uses the connection opened by the constructor
+        pool->database = databaseTaken.exchange(true) ? std::make_shared<SqlDatabase>(dbfile, true) : database;
+
+        std::lock_guard<std::mutex> guard(poolGuard);
+        pools.erase(std::remove_if(pools.begin(), pools.end(),
+                [] (const std::weak_ptr<QueryPool> &p) { return p.expired(); }), pools.end());
+        pools.push_back(pool);
+    }
+    return *pool;
 }
 
 void SqlLoadManager::prepareSearches()
 {
-    foreQueries[METADATA] = database->compile(
+    prepare(METADATA,
         "SELECT db_version, target_simulator, data_source FROM metadata;");
 
-    foreQueries[REGION_CODES] = database->compile(
+    prepare(REGION_CODES,
         "SELECT name FROM region;");
 
-    foreQueries[MAX_NODE_DENISTY] = database->compile(
-        "SELECT MAX(nodes) FROM grid_count WHERE (ilonx BETWEEN ?1 AND ?3) AND (ilaty BETWEEN ?2 AND ?4);");
-
-    backQueries[NODES_IN_GRID] = database->compile(
-        "SELECT airport_id, fix_id FROM grid_search WHERE (ilonx = ?1) AND (ilaty = ?2);");
+    prepare(GRID_COUNTS,
+        "SELECT ilonx, ilaty, nodes FROM grid_count;");
+
+    // the area queries only return what the map needs, the details of the airports are
+    // loaded on first use with the per-airport queries below. the rows are prefixed with
+    // the airport_id so that they can be assigned to their airports.
+    prepare(AIRPORTS_IN_AREA,
+        "SELECT a.airport_id, a.ident, a.name, a.region, a.country, a.lonx, a.laty, a.altitude, "
+        "EXISTS (SELECT 1 FROM com c WHERE (c.airport_id = a.airport_id) AND (c.type = 'T')), "
+        "EXISTS (SELECT 1 FROM start s WHERE (s.airport_id = a.airport_id) AND (s.type = 'H')) "
+        "FROM grid_search g JOIN airport a ON a.airport_id = g.airport_id "
+        "WHERE (g.ilonx = ?1) AND (g.ilaty = ?2) ;");
+
+    // enough of each runway end for the summary of its airport
+    prepare(RUNWAYS_IN_AREA,
+        "SELECT r.airport_id, r.runway_id, r.runway_pair_id, r.length, r.surface, r.offset_threshold, r.lonx, r.laty "
+        "FROM grid_search g JOIN runway r ON r.airport_id = g.airport_id "
+        "WHERE (g.ilonx = ?1) AND (g.ilaty = ?2) ;");
+
+    // localizers are shown on the map, so they are loaded with the area. only those
+    // of known runway ends are used, as when loading a single airport.
+    prepare(LOCALIZERS_IN_AREA,
+        "SELECT i.airport_id, i.ident, i.name, i.runway_id, i.lonx, i.laty, i.frequency, i.loc_heading, "
+        "i.mag_var, i.range, i.dme_range "
+        "FROM grid_search g JOIN ils i ON i.airport_id = g.airport_id "
+        "JOIN runway r ON (r.runway_id = i.runway_id) AND (r.airport_id = i.airport_id) "
+        "WHERE (g.ilonx = ?1) AND (g.ilaty = ?2) ;");
+
+    // the fixes of the area itself, the terminal fixes are loaded with the airport details
+    prepare(FIXES_IN_AREA,
+        "SELECT f.ident, f.region, f.type, f.nav_id, f.lonx, f.laty, "
+        "n.ndb_id, n.name, n.frequency, n.range, "
+        "v.vor_id, v.name, v.type, v.frequency, v.range, v.mag_var, v.dme_only, f.fix_id "
+        "FROM grid_search g JOIN fix f ON f.fix_id = g.fix_id "
+        "LEFT JOIN ndb n ON (f.type = 'N') AND (n.ndb_id = f.nav_id) "
+        "LEFT JOIN vor v ON (f.type = 'V') AND (v.vor_id = f.nav_id) "
+        "WHERE (g.ilonx = ?1) AND (g.ilaty = ?2) AND g.fix_id ;");
 
     const char *airQ = "SELECT airport_id, ident, name, region, country, lonx, laty, altitude FROM airport WHERE airport_id = ?1 ;";
-    backQueries[AIRPORT_BY_ID] = database->compile(airQ);
-    foreQueries[AIRPORT_BY_ID] = database->compile(airQ);
+    prepare(AIRPORT_BY_ID, airQ);
 
-    foreQueries[AIRPORT_BY_ICAO] = database->compile(
+    prepare(AIRPORT_BY_ICAO,
         "SELECT airport_id, ident, name, region, country, lonx, laty, altitude FROM airport WHERE ident = ?1 ;");
 
-    foreQueries[AIRPORTS_BY_KEYWORD] = database->compile(
-        "SELECT airport_id FROM airport WHERE ident LIKE ?1 ;");
+    prepare(AIRPORT_SEARCH_TERMS,
+        "SELECT airport_id, ident, name FROM airport;");
 
     const char *comQ = "SELECT type, frequency, name FROM com WHERE airport_id = ?1 ;";
-    backQueries[COMMS_AT_AIRPORT] = database->compile(comQ);
-    foreQueries[COMMS_AT_AIRPORT] = database->compile(comQ);
+    prepare(COMMS_AT_AIRPORT, comQ);
 
     const char *rwyQ = "SELECT runway_id, name, runway_pair_id, length, width, surface, heading, altitude, offset_threshold, lonx, laty "
         "FROM runway WHERE airport_id = ?1 ;";
-    backQueries[RUNWAYS_AT_AIRPORT] = database->compile(rwyQ);
-    foreQueries[RUNWAYS_AT_AIRPORT] = database->compile(rwyQ);
+    prepare(RUNWAYS_AT_AIRPORT, rwyQ);
 
     const char *heliQ = "SELECT number, lonx, laty FROM start WHERE (airport_id = ?1) AND (type = 'H') ;";
-    backQueries[HELIPADS_AT_AIRPORT] = database->compile(heliQ);
-    foreQueries[HELIPADS_AT_AIRPORT] = database->compile(heliQ);
+    prepare(HELIPADS_AT_AIRPORT, heliQ);
 
     const char *locQ = "SELECT ident, name, runway_id, lonx, laty, frequency, loc_heading, mag_var, range, dme_range "
         "FROM ils WHERE airport_id = ?1 ;";
-    backQueries[LOCALIZERS_AT_AIRPORT] = database->compile(locQ);
-    foreQueries[LOCALIZERS_AT_AIRPORT] = database->compile(locQ);
-
-    const char *wptaQ = "SELECT fix_id FROM fix WHERE airport_id = ?1 ;";
-    backQueries[FIXES_AT_AIRPORT] = database->compile(wptaQ);
-    foreQueries[FIXES_AT_AIRPORT] = database->compile(wptaQ);
-
-    foreQueries[PROCEDURES_AT_AIRPORT] = database->compile(
-        "SELECT procedure_id, type, name, runway_name, initial_fix_id, final_fix_id, via_fixes FROM procedure WHERE airport_id = ?1 ;");
-
-    foreQueries[TRANSITIONS_BY_NAME_IN_PIDS] = database->compile(
-        "SELECT procedure_id, initial_fix_id, final_fix_id, via_fixes FROM transition "
-            "WHERE name = ?1 AND procedure_id IN (SELECT value FROM json_each(?2)) ;");
+    prepare(LOCALIZERS_AT_AIRPORT, locQ);
+
+    // the same columns as the fixes of an area
+    prepare(FIXES_AT_AIRPORT,
+        "SELECT f.ident, f.region, f.type, f.nav_id, f.lonx, f.laty, "
+        "n.ndb_id, n.name, n.frequency, n.range, "
+        "v.vor_id, v.name, v.type, v.frequency, v.range, v.mag_var, v.dme_only, f.fix_id "
+        "FROM fix f "
+        "LEFT JOIN ndb n ON (f.type = 'N') AND (n.ndb_id = f.nav_id) "
+        "LEFT JOIN vor v ON (f.type = 'V') AND (v.vor_id = f.nav_id) "
+        "WHERE f.airport_id = ?1 ;");
+
+    prepare(PROCEDURES_AT_AIRPORT,
+        "SELECT procedure_id, type, name, runway_name, fix_ids FROM procedure WHERE airport_id = ?1 ;");
+
+    prepare(TRANSITIONS_AT_AIRPORT,
+        "SELECT t.procedure_id, t.name, t.fix_ids FROM transition t "
+        "INNER JOIN procedure p ON p.procedure_id = t.procedure_id "
+        "WHERE p.airport_id = ?1 ;");
 
     const char *wptiQ = "SELECT ident, region, type, nav_id, lonx, laty FROM fix WHERE fix_id = ?1 ;";
-    backQueries[FIX_BY_ID] = database->compile(wptiQ);
-    foreQueries[FIX_BY_ID] = database->compile(wptiQ);
+    prepare(FIX_BY_ID, wptiQ);
 
-    foreQueries[FIX_BY_NAME] = database->compile(
-        "SELECT ident, region, type, nav_id, lonx, laty FROM fix WHERE region = ?1 AND ident = ?2 ;");
+    prepare(FIX_BY_NAME,
+        "SELECT ident, region, type, nav_id, lonx, laty, fix_id FROM fix WHERE region = ?1 AND ident = ?2 ;");
 
-    foreQueries[FIXES_BY_KEYS] = database->compile(
+    prepare(FIXES_BY_KEYS,
         "SELECT fix_id, ident, region, lonx, laty FROM fix WHERE fix_id IN (SELECT value FROM json_each(?1)) ;");
 
     const char *ndbQ = "SELECT name, frequency, range FROM ndb WHERE ndb_id = ?1 ;";
-    backQueries[NDB_BY_ID] = database->compile(ndbQ);
-    foreQueries[NDB_BY_ID] = database->compile(ndbQ);
+    prepare(NDB_BY_ID, ndbQ);
 
     const char *vorQ = "SELECT name, type, frequency, range, mag_var, dme_only FROM vor WHERE vor_id = ?1 ;";
-    backQueries[VOR_BY_ID] = database->compile(vorQ);
-    foreQueries[VOR_BY_ID] = database->compile(vorQ);
+    prepare(VOR_BY_ID, vorQ);
+
+    prepare(AIRWAYS,
+        "SELECT airway_id, name, type FROM airway ;");
+
+    // ordered by the index, so this is a single pass over it
+    prepare(AIRWAY_LEGS,
+        "SELECT from_fix_id, to_fix_id, airway_id FROM airway_leg ORDER BY from_fix_id ;");
+
+    // compile everything once on this thread, so that a schema without the tables or
+    // columns needed by any of the searches is rejected before it is used
+    auto &pool = getQueryPool();
+    for (auto &it: searchSql) {
+        pool.queries[it.first] = pool.database->compile(it.second);
+    }
 }
 
 void SqlLoadManager::checkMetadata(std::function<bool(std::string simCode)> checkDbSimulator)
 {
-    auto qry = foreQueries[METADATA];
+    auto qry = GetSQL(METADATA);
 
     // configure the query
     qry->initialize();
@@ -183,7 +294,7 @@ void SqlLoadManager::checkMetadata(std::function<bool(std::string simCode)> chec
 
 void SqlLoadManager::populateRegions()
 {
-    auto qry = foreQueries[REGION_CODES];
+    auto qry = GetSQL(REGION_CODES);
 
     // configure the query
     qry->initialize();
@@ -196,56 +307,79 @@ void SqlLoadManager::populateRegions()
     }
 }
 
-int SqlLoadManager::getMaxInAreas(int lonl, int latl, int lonh, int lath)
+void SqlLoadManager::populateDensities()
 {
-    // this query returns the maximum number of nodes from the set of grid areas
-    // covered by the search area. it typically takes 5-8ms. it could be a target
-    // for future optimisation - loading the table into memory in advance.
-    auto qry = foreQueries[MAX_NODE_DENISTY];
+    // the density of the visible area is needed on every map frame, so keep
+    // all grid counts in memory rather than querying them each time
+    auto qry = GetSQL(GRID_COUNTS);
+
+    // configure the query
     qry->initialize();
-    qry->bind(1, lonl);
-    qry->bind(2, latl);
-    qry->bind(3, lonh);
-    qry->bind(4, lath);
-    if (qry->step()) return 0;
-    auto n = qry->getInt(0);
-    return n;
+
+    // process the results
+    while (1) {
+        if (qry->step()) break;
+        sqlworld->addAreaCount(qry->getInt(0), qry->getInt(1), qry->getInt(2));
+    }
 }
 
-void SqlLoadManager::loadNodesInArea(int lonx, int laty)
+void SqlLoadManager::populateAirportSearch()
 {
-    std::vector<int> airports, fixes;
-    identifyNodesInArea(lonx, laty, airports, fixes);
-
-    for (auto id: airports) {
-        auto al = std::make_unique<AirportLoader>(std::dynamic_pointer_cast<SqlLoadManager>(shared_from_this()), id, true);
-        std::vector<std::shared_ptr<world::Fix>> ils_fixes;
-        auto a = al->load(&ils_fixes);
-        sqlworld->addAirport(a);
-        for (auto f: ils_fixes) {
-            sqlworld->addFix(f);
-        }
-    }
-    for (auto id: fixes) {
-        auto fl = std::make_unique<FixLoader>(std::dynamic_pointer_cast<SqlLoadManager>(shared_from_this()), id);
-        auto f = fl->load();
-        sqlworld->addFix(f);
+    // a LIKE query can't use an index and scans the whole airport table,
+    // so searches use an in-memory index over IDs and names instead
+    auto qry = GetSQL(AIRPORT_SEARCH_TERMS);
+
+    // configure the query
+    qry->initialize();
+
+    // process the results
+    while (1) {
+        if (qry->step()) break;
+        airportSearch.add(qry->getInt(0), qry->getString(1), qry->getString(2));
     }
+    airportSearch.build();
 }
 
-std::vector<std::shared_ptr<world::Airport>> SqlLoadManager::getMatchingAirports(const std::string &pattern)
+void SqlLoadManager::loadNodesInArea(int lonx, int laty)
+{
+    std::vector<std::shared_ptr<world::Airport>> airports;
+    std::vector<std::shared_ptr<world::Fix>> ils_fixes, fixes;
+    AreaLoader loader(std::dynamic_pointer_cast<SqlLoadManager>(shared_from_this()), lonx, laty);
+    loader.load(airports, ils_fixes, fixes);
+
+    // the area becomes visible to readers in one step
+    ils_fixes.insert(ils_fixes.end(), fixes.begin(), fixes.end());
+    sqlworld->addNodes(airports, ils_fixes);
+}
+
+size_t SqlLoadManager::populateAirwayGraph()
 {
-    std::string srch = std::string("%") + pattern + '%';
-    std::vector<int> ids;
-    auto qry = foreQueries[AIRPORTS_BY_KEYWORD];
+    // the whole network is a few MB, small enough to keep for complete route finding
+    auto graph = std::make_shared<AirwayGraph>();
+
+    auto qry = GetSQL(AIRWAYS);
     qry->initialize();
-    qry->bind(1, srch);
     while (1) {
         if (qry->step()) break;
-        auto id = qry->getInt(0);
-        ids.push_back(id);
+        graph->addAirway(qry->getInt(0), qry->getString(1), qry->getString(2));
     }
 
+    qry = GetSQL(AIRWAY_LEGS);
+    qry->initialize();
+    while (1) {
+        if (qry->step()) break;
+        graph->addLeg(qry->getInt(0), qry->getInt(1), qry->getInt(2));
+    }
+    graph->build();
+
+    sqlworld->setAirwayGraph(graph);
+    return graph->size();
+}
+
+std::vector<std::shared_ptr<world::Airport>> SqlLoadManager::getMatchingAirports(const std::string &pattern)
+{
+    auto ids = airportSearch.search(pattern, world::World::MAX_SEARCH_RESULTS);
+
     std::vector<std::shared_ptr<world::Airport>> airports;
     for (auto id: ids) {
         auto al = std::make_unique<AirportLoader>(std::dynamic_pointer_cast<SqlLoadManager>(shared_from_this()), id, false);
@@ -265,6 +399,14 @@ std::shared_ptr<world::Airport> SqlLoadManager::getAirport(const std::string &ic
 std::shared_ptr<world::Fix> SqlLoadManager::getFix(const std::string &region, const std::string &id)
 {
     auto fl = std::make_unique<FixLoader>(std::dynamic_pointer_cast<SqlLoadManager>(shared_from_this()), region, id);
+    auto f = fl->load();
+    // a route to or from this fix must meet the fixes of the airway graph as the same node
+    return f ? sqlworld->shareFix(f) : f;
+}
+
+std::shared_ptr<world::Fix> SqlLoadManager::getFixByKey(int fixKey)
+{
+    auto fl = std::make_unique<FixLoader>(std::dynamic_pointer_cast<SqlLoadManager>(shared_from_this()), fixKey);
     return fl->load();
 }
 
@@ -279,53 +421,72 @@ world::NavNodeList SqlLoadManager::getFixList(const std::vector<int> &fixKeys)
     return nodes;
 }
 
-std::vector<int> SqlLoadManager::getTransitionFixes(const std::string &ident, const std::vector<int> &pids, int &selectedPid)
+std::vector<int> SqlLoadManager::getTransitionFixes(int airportId, const std::string &ident, const std::vector<int> &pids, int &selectedPid)
 {
-    // create a json fragment to be used in the SQL query for a variable-length selection
-    std::ostringstream json;
-    json << '[';
-    for (auto i: pids) {
-        json << i << ',';
+    auto cache = getProcedureCache(airportId);
+    for (auto pid: pids) {
+        auto t = cache->transitions.find(std::make_pair(pid, ident));
+        if (t != cache->transitions.end()) {
+            selectedPid = pid;
+            return t->second;
+        }
     }
-    std::string srch = json.str();
-    srch.back() = ']';
-
-    auto qry = foreQueries[TRANSITIONS_BY_NAME_IN_PIDS];
-    qry->initialize();
-    qry->bind(1, ident);
-    qry->bind(2, srch);
+    // don't change the selectedPid, it has a default value in it
+    return std::vector<int>();
+}
 
-    // process the results - should be maximum of 1, but possibly none
-    if (qry->step()) {
-        // don't change the selectedPid, it has a default value in it
-        return std::vector<int>();
+world::NavNodeList SqlLoadManager::getProcedureRoute(int airportId, const std::string &key, const std::function<world::NavNodeList()> &resolve)
+{
+    auto cache = getProcedureCache(airportId);
+    {
+        std::lock_guard<std::mutex> lock(procedureGuard);
+        auto r = cache->routes.find(key);
+        if (r != cache->routes.end()) {
+            return r->second;
+        }
     }
-    selectedPid = qry->getInt(0);
-    auto f0 = qry->getInt(1);
-    auto fn = qry->getInt(2);
-    auto vias = qry->getString(3);
 
-    return toVector(f0, fn, vias);
+    // resolved without the lock, it runs queries and looks up the transitions again
+    auto route = resolve();
+    std::lock_guard<std::mutex> lock(procedureGuard);
+    cache->routes[key] = route;
+    return route;
 }
 
-void SqlLoadManager::identifyNodesInArea(int lonx, int laty, std::vector<int> &airports, std::vector<int> &fixes)
+std::shared_ptr<SqlLoadManager::ProcedureCache> SqlLoadManager::getProcedureCache(int airportId)
 {
-    auto qry = backQueries[NODES_IN_GRID];
+    {
+        std::lock_guard<std::mutex> lock(procedureGuard);
+        auto it = procedureCacheIndex.find(airportId);
+        if (it != procedureCacheIndex.end()) {
+            procedureCaches.splice(procedureCaches.begin(), procedureCaches, it->second);
+            return it->second->second;
+        }
+    }
 
-    // configure the query
+    // all transitions of the airport in one query, their fix lists are stored pre-packed
+    auto cache = std::make_shared<ProcedureCache>();
+    auto qry = GetSQL(TRANSITIONS_AT_AIRPORT);
     qry->initialize();
-    qry->bind(1, lonx);
-    qry->bind(2, laty);
+    qry->bind(1, airportId);
+    while (!qry->step()) {
+        auto key = std::make_pair(qry->getInt(0), qry->getString(1));
+        cache->transitions.emplace(key, qry->getIntArray(2));
+    }
 
-    // process the results (this version takes about 8ms on average)
-    while (1) {
-        if (qry->step()) break;
-        std::string node_type;
-        auto airport = qry->getInt(0);
-        auto fix = qry->getInt(1);
-        if (airport) airports.push_back(airport);
-        if (fix) fixes.push_back(fix);
+    std::lock_guard<std::mutex> lock(procedureGuard);
+    auto it = procedureCacheIndex.find(airportId);
+    if (it != procedureCacheIndex.end()) {
+        // another thread loaded it meanwhile
+        return it->second->second;
+    }
+    procedureCaches.emplace_front(airportId, cache);
+    procedureCacheIndex[airportId] = procedureCaches.begin();
+    while (procedureCaches.size() > MAX_PROCEDURE_AIRPORTS) {
+        procedureCacheIndex.erase(procedureCaches.back().first);
+        procedureCaches.pop_back();
     }
+    return cache;
 }
 
 std::vector<int> SqlLoadManager::toVector(int f0, int fn, std::string vias)
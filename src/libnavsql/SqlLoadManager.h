@@ -18,12 +18,22 @@
 #pragma once
 
 #include "src/world/LoadManager.h"
+#include "src/world/graph/AirportSearchIndex.h"
 #include "SqlWorld.h"
 #include "SqlDatabase.h"
 #include "SqlStatement.h"
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <vector>
 
 namespace sqlnav {
 
+constexpr const char *FILE_NAME = "avitab_navdb.sqlite";
+
 class SqlLoadManager : public world::LoadManager {
 public:
     SqlLoadManager(std::string dbdir);
@@ -36,55 +46,93 @@ public:
     void discoverSceneries() override;
     void load() override;
     void reloadMetar() override;
+    std::vector<std::string> getSourceFiles() override { return {dbfile}; }
 
     std::shared_ptr<world::Region> getRegion(const std::string &id);
 
-    int getMaxInAreas(int lonl, int latl, int lonh, int lath);
     void loadNodesInArea(int lonx, int laty); // called on background thread
 
     std::vector<std::shared_ptr<world::Airport>> getMatchingAirports(const std::string &pattern);
     std::shared_ptr<world::Airport> getAirport(const std::string &id);
     std::shared_ptr<world::Fix> getFix(const std::string &region, const std::string &id);
+    std::shared_ptr<world::Fix> getFixByKey(int fixKey);
 
     world::NavNodeList getFixList(const std::vector<int> &fixKeys);
-    std::vector<int> getTransitionFixes(const std::string &ident, const std::vector<int> &pids, int &selectedPid);
+    // the fixes of the named transition of the first procedure in pids that has one
+    std::vector<int> getTransitionFixes(int airportId, const std::string &ident, const std::vector<int> &pids, int &selectedPid);
+    // returns the cached route of a procedure of the airport, resolving it on a miss
+    world::NavNodeList getProcedureRoute(int airportId, const std::string &key, const std::function<world::NavNodeList()> &resolve);
 
     enum Searches {
         METADATA,
         REGION_CODES,
-        MAX_NODE_DENISTY,
-        NODES_IN_GRID,
+        GRID_COUNTS,
+        AIRPORTS_IN_AREA,
+        RUNWAYS_IN_AREA,
+        LOCALIZERS_IN_AREA,
+        FIXES_IN_AREA,
         AIRPORT_BY_ID,
         AIRPORT_BY_ICAO,
-        AIRPORTS_BY_KEYWORD,
+        AIRPORT_SEARCH_TERMS,
         COMMS_AT_AIRPORT,
         RUNWAYS_AT_AIRPORT,
         HELIPADS_AT_AIRPORT,
         LOCALIZERS_AT_AIRPORT,
         FIXES_AT_AIRPORT,
         PROCEDURES_AT_AIRPORT,
-        TRANSITIONS_BY_NAME_IN_PIDS,
+        TRANSITIONS_AT_AIRPORT,
         FIX_BY_ID,
         FIX_BY_NAME,
         FIXES_BY_KEYS,
         NDB_BY_ID,
-        VOR_BY_ID
+        VOR_BY_ID,
+        AIRWAYS,
+        AIRWAY_LEGS
     };
-    std::shared_ptr<SqlStatement> GetSQL(Searches name, bool background);
+    // Any thread may run the searches, each gets its own connection and statements
+    std::shared_ptr<SqlStatement> GetSQL(Searches name);
 
     static std::vector<int> toVector(int f0, int fn, std::string vias);
 
 protected:
     void prepareSearches();
+    void prepare(Searches name, const char *sql);
     void checkMetadata(std::function<bool(std::string simCode)> fn);
     void populateRegions();
-    void identifyNodesInArea(int lonx, int laty, std::vector<int> &airports, std::vector<int> &fixes);
+    void populateDensities();
+    void populateAirportSearch();
+    size_t populateAirwayGraph();
 
 private:
+    // the transitions of the procedures of an airport and the routes resolved from them
+    struct ProcedureCache {
+        std::map<std::pair<int, std::string>, std::vector<int>> transitions; // by procedure ID and name
+        std::map<std::string, world::NavNodeList> routes;
+    };
+    using ProcedureCacheList = std::list<std::pair<int, std::shared_ptr<ProcedureCache>>>;
+    static constexpr const size_t MAX_PROCEDURE_AIRPORTS = 16;
+
+    struct QueryPool;
+    QueryPool &getQueryPool();
+    std::shared_ptr<ProcedureCache> getProcedureCache(int airportId);
+
+    std::string dbfile;
     std::shared_ptr<SqlDatabase> database;
     std::shared_ptr<SqlWorld> sqlworld;
-    std::map<int, std::shared_ptr<SqlStatement>> backQueries;
-    std::map<int, std::shared_ptr<SqlStatement>> foreQueries;
+    // the SQL of each search, fixed once prepareSearches has run
+    std::map<int, std::string> searchSql;
+    // the connection and statements of each thread that has run a search are
+    // owned by the thread, these are closed if the manager goes away first
+    static std::atomic<uint64_t> nextInstanceId;
+    const uint64_t instanceId = nextInstanceId++;
+    std::atomic_bool databaseTaken { false };
+    std::mutex poolGuard;
+    std::vector<std::weak_ptr<QueryPool>> pools;
+    world::AirportSearchIndex airportSearch;
+    // most recently used airport first
+    std::mutex procedureGuard;
+    ProcedureCacheList procedureCaches;
+    std::unordered_map<int, ProcedureCacheList::iterator> procedureCacheIndex;
 };
 
 }
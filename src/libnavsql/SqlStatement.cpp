@@ -19,6 +19,8 @@
 #include "SqlStatement.h"
 #include "SqlDatabase.h"
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
 #include "src/Logger.h"
 
 namespace sqlnav {
@@ -36,11 +38,38 @@ SqlStatement::SqlStatement(std::shared_ptr<SqlDatabase> db, const std::string &s
 
 SqlStatement::~SqlStatement()
 {
+    finishRun();
+    if (runs) {
+        using ms = std::chrono::duration<double, std::milli>;
+        logger::verbose("SQL '%s': %lu runs, %.2f ms average, %.2f ms max", statement.c_str(), runs,
+            ms(totalTime).count() / runs, ms(maxTime).count());
+    }
     sqlite3_finalize(statementHandle);
 }
 
+void SqlStatement::finishRun()
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    ++runs;
+    totalTime += runTime;
+    maxTime = std::max(maxTime, runTime);
+
+    double millis = std::chrono::duration<double, std::milli>(runTime).count();
+    if (millis > SLOW_RUN_MILLIS) {
+        logger::verbose("Slow SQL (%.1f ms): %s", millis, statement.c_str());
+    }
+}
+
 void SqlStatement::initialize()
 {
+    // single row lookups don't step until done, so their run ends here
+    finishRun();
+    running = true;
+    runTime = {};
+
     auto re = sqlite3_reset(statementHandle);
     if (re != SQLITE_OK) {
         logger::error("SQL reset() returned %d", re);
@@ -93,10 +122,25 @@ void SqlStatement::bind<std::string>(int p, std::string s)
     }
 }
 
+template <>
+void SqlStatement::bind<std::vector<int>>(int p, std::vector<int> v)
+{
+    auto e = sqlite3_bind_blob(statementHandle, p, v.data(), v.size() * sizeof(int), SQLITE_TRANSIENT);
+    if (e != SQLITE_OK) {
+        logger::error("SQL bind_blob() returned %d", e);
+        throw std::runtime_error("NAV world SQL database statement bind error");
+    }
+}
+
 int SqlStatement::step()
 {
+    auto startAt = std::chrono::steady_clock::now();
     auto e = sqlite3_step(statementHandle);
-    if (e == SQLITE_DONE) return 1;
+    runTime += std::chrono::steady_clock::now() - startAt;
+    if (e == SQLITE_DONE) {
+        finishRun();
+        return 1;
+    }
     if (e != SQLITE_ROW) {
         logger::error("SQL step '%s' returned %d", statement.c_str(), e);
         throw std::runtime_error("NAV world SQL database statement bind error");
@@ -134,4 +178,14 @@ std::string SqlStatement::getString(int c)
     }
 }
 
+std::vector<int> SqlStatement::getIntArray(int c)
+{
+    const void *blob = sqlite3_column_blob(statementHandle, c);
+    std::vector<int> res(sqlite3_column_bytes(statementHandle, c) / sizeof(int));
+    if (blob && !res.empty()) {
+        std::memcpy(res.data(), blob, res.size() * sizeof(int));
+    }
+    return res;
+}
+
 }
@@ -19,6 +19,8 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <chrono>
 #include <sqlite3/sqlite3.h>
 
 namespace sqlnav {
@@ -43,6 +45,14 @@ public:
     float getFloat(int col);
     double getDouble(int col);
     std::string getString(int col);
+    // a BLOB of packed 32 bit integers, empty if the column is NULL
+    std::vector<int> getIntArray(int col);
+
+private:
+    // runs taking longer than this are logged
+    static constexpr const double SLOW_RUN_MILLIS = 20.0;
+
+    void finishRun();
 
 private:
     // hold a shared pointer to the database to ensure database is not closed until statement is no longer required
@@ -51,6 +61,13 @@ private:
     const std::string statement;
     sqlite3_stmt *statementHandle;
 
+    // time spent in sqlite3_step, per run (initialize to last step) and in total
+    bool running = false;
+    std::chrono::steady_clock::duration runTime {};
+    std::chrono::steady_clock::duration totalTime {};
+    std::chrono::steady_clock::duration maxTime {};
+    unsigned long runs = 0;
+
 };
 
 }
@@ -21,64 +21,75 @@
 #include <algorithm>
 #include <cassert>
 #include <thread>
+#include <set>
 #include "SqlLoadManager.h"
 #include "src/world/routing/RouteFinder.h"
+#include "src/world/graph/Corridor.h"
 #include "src/platform/Platform.h"
+#include "src/platform/Tracer.h"
 #include "src/Logger.h"
 
 namespace sqlnav {
 
 SqlWorld::SqlWorld(std::shared_ptr<SqlLoadManager> db)
 :   world::World(),
-    loadManager(db)
+    loadManager(db),
+    areaNodes(std::make_shared<const AreaMap>())
 {
-    asyncLoaderState = std::async(std::launch::async, [this] { backgroundLoader(); });
+    // each loader has its own database connection, so areas load in parallel
+    unsigned loaders = std::max(1u, std::min(std::thread::hardware_concurrency() / 2, MAX_AREA_LOADERS));
+    for (unsigned i = 0; i < loaders; ++i) {
+        loaderThreads.emplace_back([this] { backgroundLoader(); });
+    }
+
+    memoryConsumer = platform::MemoryBudget::shared().addConsumer("nav_areas", platform::MemoryBudget::Priority::NAV_DATA,
+        [this] () {
+            std::lock_guard<std::mutex> guard(navStateGuard);
+            return cachedNodes * APPROX_NODE_BYTES;
+        },
+        [this] (size_t bytes) { return trimAreas(bytes); });
 }
 
 SqlWorld::~SqlWorld()
 {
+    memoryConsumer.reset();
     shutdown();
 }
 
 void SqlWorld::shutdown()
 {
-    // wait for the background loader to become inactive
-    bool running = true;
-    while (running) {
-        {
-            std::unique_lock<std::mutex> lock(navStateGuard);
-            running = (backgroundLoadArea != nullptr);
+    // drop the areas that were not started yet and tell the loaders to exit
+    // once they have finished the area they are working on
+    {
+        std::lock_guard<std::mutex> guard(navStateGuard);
+        stopLoaders = true;
+        for (auto &area: pendingAreas) {
+            areaCached.erase(area);
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        pendingAreas.clear();
+        prefetchAreas.clear();
     }
-    // now notify the background loader to wake up, but without providing an
-    // area to load. this will cause it to exit from its work loop and terminate.
-    {
-        std::unique_lock<std::mutex> lock(backgroundLoaderGuard);
-        backgroundLoadControl.notify_one();
+    backgroundLoadControl.notify_all();
+
+    for (auto &t: loaderThreads) {
+        if (!t.joinable()) {
+            continue;
+        }
+        if (t.get_id() == std::this_thread::get_id()) {
+            // the load manager was released by one of the loaders, which
+            // returns without touching the world once this has finished
+            destroyedByLoader = true;
+            t.detach();
+        } else {
+            t.join();
+        }
     }
-    // wait until the future indicates that the background task completed
-    asyncLoaderState.wait();
 }
 
 int SqlWorld::maxDensity(const world::Location &bottomLeft, const world::Location &topRight)
 {
-    int d = 0;
-    auto loadMgr = loadManager.lock();
-
     // nodes are grouped by integer lat/lon 'squares'.
-    int latl = std::max((int)std::floor(bottomLeft.latitude), -90);
-    int lath = std::min((int)std::ceil(topRight.latitude), 89);
-    int lonl = (int)std::floor(bottomLeft.longitude);
-    int lonh = (int)std::ceil(topRight.longitude);
-
-    // the area might span the -180/+180 meridian. if so do 2 searches
-    if (lonl <= lonh) {
-        d = loadMgr->getMaxInAreas(lonl, latl, lonh, lath);
-    } else {
-        d = loadMgr->getMaxInAreas(lonh, latl, 180, lath);
-        d = std::max(d, loadMgr->getMaxInAreas(-180, latl, lonl, lath));
-    }
+    int d = density.maxInArea(bottomLeft, topRight);
 
     // pretend that each grid area has 'max' nodes in it, and report the total number of visible nodes that
     // would be seen if this was the case.
@@ -88,16 +99,63 @@ int SqlWorld::maxDensity(const world::Location &bottomLeft, const world::Locatio
     return (int)(mapArea * d);
 }
 
+void SqlWorld::visitMajorAirports(const world::Location &bottomLeft, const world::Location &topRight, double cellDegrees, NodeAcceptor callback, int filter)
+{
+    // airports are only known once their area was loaded by visitNodes, so this
+    // shows the major ones of the areas visited so far
+    std::vector<const world::NavNode *> picks;
+    {
+        std::lock_guard<std::mutex> guard(navStateGuard);
+        ++useClock;
+        airportLOD.visit(bottomLeft, topRight, cellDegrees, filter, [this, &picks] (const world::NavNode *node) {
+            // the caller may keep the node until its next visit, so its area must not be evicted
+            auto &loc = node->getLocation();
+            touchArea(std::make_pair((int)std::floor(loc.longitude), (int)std::floor(loc.latitude)));
+            picks.push_back(node);
+        });
+    }
+
+    // the touched areas can't be evicted before the next visit, so the callbacks don't need the lock
+    for (auto node: picks) {
+        callback(node);
+    }
+}
+
+uint32_t SqlWorld::getNodeRevision() const
+{
+    return nodeRevision;
+}
+
 inline unsigned distance(int x1, int y1, int x2, int y2) {
     int dx = x2 - x1;
     int dy = y2 - y1;
     return (unsigned)std::sqrt((dx * dx) + (dy * dy));
 }
 
+inline bool acceptsNode(const std::shared_ptr<world::NavNode> &node, int filter) {
+    if (node->isAirport()) {
+        if (std::dynamic_pointer_cast<world::Airport>(node)->hasControlTower()) {
+            return (filter & world::World::VISIT_TOWERED_AIRPORTS);
+        } else {
+            return (filter & world::World::VISIT_OTHER_AIRPORTS);
+        }
+    } else if (node->isFix()) {
+        auto f = std::dynamic_pointer_cast<world::Fix>(node);
+        if (f->isNavaid()) {
+            return (filter & world::World::VISIT_NAVAIDS);
+        } else if (f->isUserFix()) {
+            return (filter & world::World::VISIT_USER_FIXES);
+        } else {
+            return (filter & world::World::VISIT_FIXES);
+        }
+    }
+    return false;
+}
+
 void SqlWorld::visitNodes(const world::Location &bottomLeft, const world::Location &topRight, NodeAcceptor callback, int filter)
 {
-    // make sure nothing updates the NAV data state while we are searching
-    std::lock_guard<std::mutex> guard(navStateGuard);
+    // the nodes are searched in the latest published snapshot, which loaders don't modify
+    auto snapshot = std::atomic_load(&areaNodes);
 
     // nodes are grouped by integer lat/lon 'squares'.
     int latl = std::max((int)std::floor(bottomLeft.latitude), -90);
@@ -122,48 +180,102 @@ void SqlWorld::visitNodes(const world::Location &bottomLeft, const world::Locati
         }
     }
 
-    // iterate through the grid areas, closest ones first, report nodes we already have cached
-    // and trigger an async load of the first area not already loaded (if async loading is not already running)
-    for (auto outer: visitOrder) {
-        for (auto area: outer) {
-            auto cit = areaCached.find(area);
-            if (cit == areaCached.end()) {
-                // area has not been visited before, so we can try and load it
-                if (!backgroundLoadArea) {
-                    // there isn't a background load in progress - start one running
-                    backgroundLoadArea = std::make_unique<std::pair<int,int>>(area);
+    // the loader state is only locked to queue the areas not already loaded, closest ones first
+    {
+        std::lock_guard<std::mutex> guard(navStateGuard);
+        ++useClock;
+
+        // the queue follows the latest view, areas that no loader has started yet are queued again below
+        for (auto &area: pendingAreas) {
+            areaCached.erase(area);
+        }
+        pendingAreas.clear();
+
+        for (auto &outer: visitOrder) {
+            for (auto &area: outer) {
+                if (areaCached.find(area) != areaCached.end()) {
+                    // this area has been (or is being) cached, keep it for the nodes reported below
+                    touchArea(area);
+                } else if (!stopLoaders && pendingAreas.size() < MAX_PENDING_AREAS) {
+                    // area has not been visited before, so we can try and load it
+                    pendingAreas.push_back(area);
                     areaCached[area] = false;
-                    backgroundLoadControl.notify_one();
                 }
-                continue; // there won't be any nodes, so try the next area
             }
+        }
+        if (!pendingAreas.empty()) {
+            backgroundLoadControl.notify_all();
+        }
+    }
 
-            // this area has been (or is being) cached, so we can filter and report back to the caller
-            auto nit = areaNodes.find(area);
-            if (nit == areaNodes.end()) continue;
-            for (auto node: nit->second) {
+    // iterate through the grid areas, closest ones first, filter the snapshot's nodes and report back to the caller
+    for (auto &outer: visitOrder) {
+        for (auto &area: outer) {
+            auto nit = snapshot->find(area);
+            if (nit == snapshot->end()) continue;
+            for (auto &node: *nit->second) {
                 if (!node->getLocation().isInArea(bottomLeft, topRight)) continue;
-                bool accept = false;
-                if (node->isAirport()) {
-                    if (std::dynamic_pointer_cast<world::Airport>(node)->hasControlTower()) {
-                        accept = (filter & world::World::VISIT_TOWERED_AIRPORTS);
-                    } else {
-                        accept = (filter & world::World::VISIT_OTHER_AIRPORTS);
-                    }
-                } else if (node->isFix()) {
-                    auto f = std::dynamic_pointer_cast<world::Fix>(node);
-                    if (f->isNavaid()) {
-                        accept = (filter & world::World::VISIT_NAVAIDS);
-                    } else if (f->isUserFix()) {
-                        accept = (filter & world::World::VISIT_USER_FIXES);
-                    } else {
-                        accept = (filter & world::World::VISIT_FIXES);
-                    }
-                }
-                if (accept) callback(node.get());
+                if (acceptsNode(node, filter)) callback(node.get());
+            }
+        }
+    }
+
+    if (filter & VISIT_USER_FIXES) {
+        userFixIndex.visit(bottomLeft, topRight, callback);
+    }
+}
+
+void SqlWorld::visitAlongRoute(const world::Route &route, double bufferNm, NodeAcceptor callback, int filter)
+{
+    world::Corridor corridor(route.getPathLocations(), bufferNm / world::KM_TO_NM * 1000);
+    auto snapshot = std::atomic_load(&areaNodes);
+
+    // the lat/lon squares under the corridor, each once so that no node is reported twice
+    std::set<std::pair<int, int>> squares;
+    for (auto &area: corridor.getAreas()) {
+        int latl = std::max((int)std::floor(area.minLat), -90);
+        int lath = std::min((int)std::floor(area.maxLat), 89);
+        int lonl = (int)std::floor(area.minLon);
+        int lonh = std::min((int)std::floor(area.maxLon), 179);
+        for (int laty = latl; laty <= lath; ++laty) {
+            for (int lonx = lonl; lonx <= lonh; ++lonx) {
+                squares.insert(std::make_pair(lonx, laty));
+            }
+        }
+    }
+
+    // loaded squares are kept for the caller, the others are prefetched without replacing the view's queue
+    {
+        std::lock_guard<std::mutex> guard(navStateGuard);
+        ++useClock;
+        bool queued = false;
+        for (auto &area: squares) {
+            if (areaCached.find(area) != areaCached.end()) {
+                touchArea(area);
+            } else if (!stopLoaders && (prefetchAreas.size() < MAX_PREFETCH_AREAS) &&
+                       (std::find(prefetchAreas.begin(), prefetchAreas.end(), area) == prefetchAreas.end())) {
+                prefetchAreas.push_back(area);
+                queued = true;
+            }
+        }
+        if (queued) {
+            backgroundLoadControl.notify_all();
+        }
+    }
+
+    for (auto &area: squares) {
+        auto nit = snapshot->find(area);
+        if (nit == snapshot->end()) continue;
+        for (auto &node: *nit->second) {
+            if (acceptsNode(node, filter) && corridor.contains(node->getLocation())) {
+                callback(node.get());
             }
         }
     }
+
+    if (filter & VISIT_USER_FIXES) {
+        userFixIndex.visitCorridor(corridor, callback);
+    }
 }
 
 std::shared_ptr<world::Airport> SqlWorld::findAirportByID(const std::string &id) const
@@ -187,16 +299,165 @@ std::vector<std::shared_ptr<world::Airport>> SqlWorld::findAirport(const std::st
     return loadManager.lock()->getMatchingAirports(keyWord);
 }
 
-std::vector<world::World::Connection> &SqlWorld::getConnections(std::shared_ptr<world::NavNode> from)
+world::World::ConnectionList SqlWorld::getConnections(std::shared_ptr<world::NavNode> from)
 {
-    return noConnection;
+    std::lock_guard<std::mutex> guard(graphGuard);
+
+    if (from->isAirport()) {
+        auto &id = from->getID();
+        auto cit = airportConnections.find(id);
+        if (cit != airportConnections.end()) {
+            return cit->second;
+        }
+        auto eit = airportExits.find(id);
+        if (eit == airportExits.end()) {
+            return noConnection;
+        }
+        std::vector<world::World::Connection> conns;
+        for (auto &exit: eit->second) {
+            auto to = resolveFix(exit.second);
+            if (to) {
+                conns.emplace_back(from, exit.first, to);
+            }
+        }
+        auto list = std::make_shared<const std::vector<world::World::Connection>>(std::move(conns));
+        airportConnections[id] = list;
+        return list;
+    }
+
+    int fixId = from->getGraphIndex();
+    if (!from->isFix() || (fixId == 0)) {
+        return noConnection;
+    }
+    auto cit = fixConnections.find(fixId);
+    if (cit != fixConnections.end()) {
+        return cit->second;
+    }
+
+    std::vector<world::World::Connection> conns;
+    if (airwayGraph) {
+        auto legs = airwayGraph->legsFrom(fixId);
+        for (auto leg = legs.first; leg != legs.second; ++leg) {
+            auto to = resolveFix(leg->toFix);
+            if (!to) {
+                continue;
+            }
+            if (auto lower = airwayGraph->getLowerAirway(leg->airway)) {
+                conns.emplace_back(from, lower, to);
+            }
+            if (auto upper = airwayGraph->getUpperAirway(leg->airway)) {
+                conns.emplace_back(from, upper, to);
+            }
+        }
+    }
+    auto ait = airportEntries.find(fixId);
+    if (ait != airportEntries.end()) {
+        for (auto &entry: ait->second) {
+            if (auto airport = entry.second.lock()) {
+                conns.emplace_back(from, entry.first, airport);
+            }
+        }
+    }
+    auto list = std::make_shared<const std::vector<world::World::Connection>>(std::move(conns));
+    fixConnections[fixId] = list;
+    return list;
 }
 
 bool SqlWorld::areConnected(std::shared_ptr<world::NavNode> from, const std::shared_ptr<world::NavNode> to)
 {
+    for (auto &c: *getConnections(from)) {
+        if (c.to == to) {
+            return true;
+        }
+    }
     return false;
 }
 
+void SqlWorld::setAirwayGraph(std::shared_ptr<const AirwayGraph> graph)
+{
+    std::lock_guard<std::mutex> guard(graphGuard);
+    airwayGraph = graph;
+    fixConnections.clear();
+}
+
+std::shared_ptr<world::Fix> SqlWorld::shareFix(std::shared_ptr<world::Fix> fix)
+{
+    // the route finder compares nodes by pointer, so each fix_id has one node while it is in use
+    int fixId = fix->getGraphIndex();
+    if (fixId == 0) {
+        return fix;
+    }
+    std::lock_guard<std::mutex> guard(graphGuard);
+    auto &known = graphFixes[fixId];
+    if (auto existing = known.lock()) {
+        return existing;
+    }
+    known = fix;
+    return fix;
+}
+
+void SqlWorld::connectFromAirport(std::shared_ptr<world::Airport> airport, std::shared_ptr<world::NavEdge> via, int fixId)
+{
+    if (fixId == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(graphGuard);
+    auto &exits = airportExits[airport->getID()];
+    for (auto &exit: exits) {
+        if ((exit.first->getID() == via->getID()) && (exit.second == fixId)) {
+            return; // the airport was loaded before
+        }
+    }
+    exits.emplace_back(via, fixId);
+    airportConnections.erase(airport->getID());
+}
+
+void SqlWorld::connectToAirport(int fixId, std::shared_ptr<world::NavEdge> via, std::shared_ptr<world::Airport> airport)
+{
+    if (fixId == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(graphGuard);
+    auto &entries = airportEntries[fixId];
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [] (const auto &e) { return e.second.expired(); }), entries.end());
+    entries.emplace_back(via, airport);
+
+    // the fix's connections may have been built already. searches that already hold
+    // them keep the old list, later lookups get the one with the new entry.
+    auto cit = fixConnections.find(fixId);
+    if (cit != fixConnections.end()) {
+        if (auto from = graphFixes[fixId].lock()) {
+            auto conns = std::make_shared<std::vector<world::World::Connection>>(*cit->second);
+            conns->emplace_back(from, via, airport);
+            cit->second = conns;
+        } else {
+            fixConnections.erase(cit);
+        }
+    }
+}
+
+std::shared_ptr<world::Fix> SqlWorld::resolveFix(int fixId)
+{
+    // called with graphGuard held
+    if (fixId == 0) {
+        return nullptr;
+    }
+    auto &known = graphFixes[fixId];
+    if (auto existing = known.lock()) {
+        return existing;
+    }
+    auto mgr = loadManager.lock();
+    if (!mgr) {
+        return nullptr;
+    }
+    auto fix = mgr->getFixByKey(fixId);
+    if (fix) {
+        fix->setGlobal(true);
+        known = fix;
+    }
+    return fix;
+}
+
 void SqlWorld::addRegion(const std::string &code)
 {
     if (regions.find(code) == regions.end()) {
@@ -206,6 +467,8 @@ void SqlWorld::addRegion(const std::string &code)
 
 std::shared_ptr<world::Region> SqlWorld::getRegion(const std::string &code)
 {
+    // called by the area loaders concurrently
+    std::lock_guard<std::mutex> guard(regionGuard);
     if (regions.find(code) == regions.end()) {
         // this really should not happen, since the regions table should have been pre-populated
         // with all the region codes at startup. it suggests a malformed database. fix and continue.
@@ -215,66 +478,271 @@ std::shared_ptr<world::Region> SqlWorld::getRegion(const std::string &code)
     return regions[code];
 }
 
+thread_local bool SqlWorld::destroyedByLoader = false;
+
 void SqlWorld::backgroundLoader()
 {
-    // this loop runs in the background, and exits if it is woken up
-    // but given nothing to do
+    // this loop runs in the background, taking the nearest pending area each
+    // time, and exits when shutdown is requested
+    platform::Tracer::setThreadName("sql_loader");
     while (1) {
+        std::pair<int, int> area;
         {
             // block until there is something to be done
-            std::unique_lock<std::mutex> lock(backgroundLoaderGuard);
-            backgroundLoadControl.wait(lock);
+            std::unique_lock<std::mutex> lock(navStateGuard);
+            backgroundLoadControl.wait(lock, [this] {
+                return stopLoaders || !pendingAreas.empty() || !prefetchAreas.empty();
+            });
+            if (stopLoaders) {
+                break;
+            }
+            if (!pendingAreas.empty()) {
+                area = pendingAreas.front();
+                pendingAreas.pop_front();
+            } else {
+                area = prefetchAreas.front();
+                prefetchAreas.pop_front();
+                if (areaCached.find(area) != areaCached.end()) {
+                    continue; // visited in the meantime
+                }
+                areaCached[area] = false;
+            }
         }
 
-        std::pair<int, int> area;
-        {
+        auto mgr = loadManager.lock();
+        if (!mgr) {
             std::lock_guard<std::mutex> guard(navStateGuard);
-            if (!backgroundLoadArea) {
-                // if nothing was requested then exit the loop (thread will finish)
-                break;
-            }
-            area = *backgroundLoadArea;
+            areaCached.erase(area);
+            break;
         }
 
-        loadManager.lock()->loadNodesInArea(area.first, area.second);
+        try {
+            platform::TraceSpan span("load_nav_area");
+            mgr->loadNodesInArea(area.first, area.second);
+        } catch (const std::exception &e) {
+            // keep the area marked as cached so that it isn't retried on every frame
+            logger::warn("Couldn't load NAV area %d/%d: %s", area.first, area.second, e.what());
+        }
 
         {
             std::lock_guard<std::mutex> guard(navStateGuard);
             areaCached[area] = true;
-            backgroundLoadArea.reset();
+            areaLastUse[area] = useClock;
+            if (cachedNodes > MAX_CACHED_NODES) {
+                // evict down to three quarters of the limit, so that this doesn't run after every area
+                evictAreas(MAX_CACHED_NODES / 4 * 3);
+            }
+        }
+
+        // this can be the last reference, which destroys the world on this thread
+        mgr.reset();
+        if (destroyedByLoader) {
+            return;
+        }
+    }
+}
+
+void SqlWorld::prefetchAlong(const std::vector<std::vector<world::Location>> &paths)
+{
+    // the areas under each path and its neighbours, sampled at least every PREFETCH_STEP_DEGREES
+    std::set<std::pair<int, int>> seen;
+    std::vector<std::pair<int, int>> areas;
+    auto addAround = [&seen, &areas] (double lat, double lon) {
+        int x0 = (int)std::floor(lon);
+        int y0 = (int)std::floor(lat);
+        for (int y = y0 - 1; y <= y0 + 1; ++y) {
+            if (y < -90 || y > 89) continue;
+            for (int x = x0 - 1; x <= x0 + 1; ++x) {
+                auto area = std::make_pair((x >= 180) ? (x - 360) : ((x < -180) ? (x + 360) : x), y);
+                if (seen.insert(area).second) {
+                    areas.push_back(area);
+                }
+            }
+        }
+    };
+    for (auto &path: paths) {
+        for (size_t i = 0; i < path.size(); ++i) {
+            auto &from = path[i];
+            addAround(from.latitude, from.longitude);
+            if (i + 1 == path.size()) break;
+            auto &to = path[i + 1];
+            double dlat = to.latitude - from.latitude;
+            double dlon = std::remainder(to.longitude - from.longitude, 360.0);
+            int steps = (int)std::ceil(std::max(std::abs(dlat), std::abs(dlon)) / PREFETCH_STEP_DEGREES);
+            for (int s = 1; s < steps; ++s) {
+                addAround(from.latitude + dlat * s / steps, std::remainder(from.longitude + dlon * s / steps, 360.0));
+            }
+        }
+    }
+    if (areas.empty()) {
+        return;
+    }
+
+    // a long route is cut short, so the areas nearest the start (the aircraft) go first
+    auto origin = areas.front();
+    auto cellDistance = [&origin] (const std::pair<int, int> &a) {
+        int dx = std::abs(a.first - origin.first);
+        return std::max(std::min(dx, 360 - dx), std::abs(a.second - origin.second));
+    };
+    std::stable_sort(areas.begin(), areas.end(), [&cellDistance] (const std::pair<int, int> &a, const std::pair<int, int> &b) {
+        return cellDistance(a) < cellDistance(b);
+    });
+    if (areas.size() > MAX_PREFETCH_AREAS) {
+        areas.resize(MAX_PREFETCH_AREAS);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(navStateGuard);
+        if (stopLoaders) {
+            return;
+        }
+        // cached areas along the paths are kept, the others replace the previous prefetch
+        prefetchAreas.clear();
+        for (auto &area: areas) {
+            if (areaCached.find(area) == areaCached.end()) {
+                prefetchAreas.push_back(area);
+            } else {
+                touchArea(area);
+            }
+        }
+    }
+    backgroundLoadControl.notify_all();
+}
+
+void SqlWorld::touchArea(const std::pair<int, int> &area)
+{
+    // only loaded areas have an entry, the loader adds it when the area is done
+    auto it = areaLastUse.find(area);
+    if (it != areaLastUse.end()) {
+        it->second = useClock;
+    }
+}
+
+size_t SqlWorld::trimAreas(size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(navStateGuard);
+    size_t nodes = (bytes + APPROX_NODE_BYTES - 1) / APPROX_NODE_BYTES;
+    size_t before = cachedNodes;
+    evictAreas(cachedNodes > nodes ? cachedNodes - nodes : 0);
+    return (before - cachedNodes) * APPROX_NODE_BYTES;
+}
+
+void SqlWorld::evictAreas(size_t target)
+{
+    // called with navStateGuard held. the areas of the last two visits are kept, since
+    // the caller of a visit may still refer to their nodes until it visits again.
+    // callers that keep nodes for longer, like the map's NAV layer, pin them.
+    std::vector<std::pair<uint32_t, std::pair<int, int>>> candidates;
+    for (auto &lu: areaLastUse) {
+        if (lu.second + 1 < useClock) {
+            candidates.push_back(std::make_pair(lu.second, lu.first));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    size_t evicted = 0;
+    bool airportsEvicted = false;
+    auto next = std::make_shared<AreaMap>(*std::atomic_load(&areaNodes));
+    for (auto &c: candidates) {
+        if (cachedNodes <= target) break;
+        auto nit = next->find(c.second);
+        if (nit == next->end()) {
+            continue; // empty areas cost nothing to keep, but a query to reload
         }
+        for (auto &node: *nit->second) {
+            airportsEvicted |= node->isAirport();
+        }
+        cachedNodes -= nit->second->size();
+        next->erase(nit);
+        areaCached.erase(c.second);
+        areaLastUse.erase(c.second);
+        ++evicted;
+    }
+    if (evicted == 0) {
+        return;
     }
+    // readers still holding the previous snapshot keep its nodes alive
+    std::atomic_store(&areaNodes, std::shared_ptr<const AreaMap>(next));
+
+    // the LOD refers to the airports without owning them
+    if (airportsEvicted) {
+        airportLOD = world::AirportLOD();
+        for (auto &an: *next) {
+            for (auto &node: *an.second) {
+                if (node->isAirport()) {
+                    airportLOD.add(static_cast<const world::Airport *>(node.get()));
+                }
+            }
+        }
+    }
+    ++nodeRevision;
+    logger::verbose("Evicted %zu NAV areas, %zu nodes remain cached", evicted, cachedNodes);
 }
 
-void SqlWorld::addAirport(std::shared_ptr<world::Airport> a)
+void SqlWorld::addAreaCount(int lonx, int laty, int nodes)
 {
-    auto &loc = a->getLocation();
-    addNodeToArea(std::floor(loc.longitude), std::floor(loc.latitude), a);
+    density.add(laty, lonx, nodes);
 }
 
 void SqlWorld::addFix(std::shared_ptr<world::Fix> f)
 {
-    f->setGlobal(true);
-    auto &loc = f->getLocation();
-    addNodeToArea(std::floor(loc.longitude), std::floor(loc.latitude), f);
+    addNodes({}, {f});
+}
+
+void SqlWorld::setUserFixes(const std::vector<std::shared_ptr<world::Fix>> &fixes)
+{
+    userFixIndex.replace(fixes);
+    ++nodeRevision;
 }
 
 std::shared_ptr<world::RouteFinder> SqlWorld::getRouteFinder()
 {
-    // TODO: specialise a SqlWorld variant of this
+    // searches hold their own references to the lists, dropping the cache only means they are rebuilt
+    {
+        std::lock_guard<std::mutex> guard(graphGuard);
+        if (fixConnections.size() > MAX_CACHED_CONNECTIONS) {
+            fixConnections.clear();
+            airportConnections.clear();
+        }
+    }
     return std::make_shared<world::RouteFinder>(shared_from_this());
 }
 
-void SqlWorld::addNodeToArea(int lonx_idx, int laty_idx, std::shared_ptr<world::NavNode> node)
+void SqlWorld::addNodes(const std::vector<std::shared_ptr<world::Airport>> &airports, const std::vector<std::shared_ptr<world::Fix>> &fixes)
 {
+    // group the nodes by area before taking the lock, the airports first as before
+    std::map<std::pair<int, int>, NodeList> added;
+    auto addToArea = [&added] (std::shared_ptr<world::NavNode> node) {
+        auto &loc = node->getLocation();
+        added[std::make_pair((int)std::floor(loc.longitude), (int)std::floor(loc.latitude))].push_back(node);
+    };
+    for (auto &a: airports) {
+        addToArea(a);
+    }
+    for (auto &f: fixes) {
+        f->setGlobal(true);
+        addToArea(f);
+    }
+    if (added.empty()) {
+        return;
+    }
+
+    // publish a new snapshot, only the node lists of the changed areas are copied
     std::lock_guard<std::mutex> guard(navStateGuard);
-    auto area = std::make_pair(lonx_idx, laty_idx);
-    auto it = areaNodes.find(area);
-    if (areaNodes.find(area) == areaNodes.end()) {
-        areaNodes[area] = std::vector<std::shared_ptr<world::NavNode>>();
-        it = areaNodes.find(area);
+    auto next = std::make_shared<AreaMap>(*std::atomic_load(&areaNodes));
+    for (auto &an: added) {
+        auto &entry = (*next)[an.first];
+        auto list = entry ? std::make_shared<NodeList>(*entry) : std::make_shared<NodeList>();
+        list->insert(list->end(), an.second.begin(), an.second.end());
+        entry = list;
+        cachedNodes += an.second.size();
+        nodeRevision += an.second.size();
+    }
+    std::atomic_store(&areaNodes, std::shared_ptr<const AreaMap>(next));
+
+    for (auto &a: airports) {
+        airportLOD.add(a.get());
     }
-    it->second.push_back(node);
 }
 
 }
@@ -18,8 +18,18 @@
 #pragma once
 
 #include "src/world/World.h"
-#include <future>
+#include "src/world/graph/DensityPyramid.h"
+#include "src/world/graph/AirportLOD.h"
+#include "src/world/graph/UserFixIndex.h"
+#include "AirwayGraph.h"
+#include "src/platform/MemoryBudget.h"
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
 
 namespace sqlnav {
 
@@ -34,28 +44,46 @@ public:
 
     int maxDensity(const world::Location &bottomLeft, const world::Location &topRight) override;
     void visitNodes(const world::Location &bottomLeft, const world::Location &topRight, NodeAcceptor callback, int filter) override;
+    void visitAlongRoute(const world::Route &route, double bufferNm, NodeAcceptor callback, int filter) override;
+    void visitMajorAirports(const world::Location &bottomLeft, const world::Location &topRight, double cellDegrees, NodeAcceptor callback, int filter) override;
+    uint32_t getNodeRevision() const override;
+    void prefetchAlong(const std::vector<std::vector<world::Location>> &paths) override;
 
     std::shared_ptr<world::Airport> findAirportByID(const std::string &id) const override;
     std::shared_ptr<world::Fix> findFixByRegionAndID(const std::string &region, const std::string &id) const override;
     std::vector<std::shared_ptr<world::Airport>> findAirport(const std::string &keyWord) const override;
 
-    std::vector<world::World::Connection> &getConnections(std::shared_ptr<world::NavNode> from) override;
+    world::World::ConnectionList getConnections(std::shared_ptr<world::NavNode> from) override;
     bool areConnected(std::shared_ptr<world::NavNode> from, const std::shared_ptr<world::NavNode> to) override;
 
     void addRegion(const std::string &code) override;
     std::shared_ptr<world::Region> getRegion(const std::string &id) override;
 
     void addFix(std::shared_ptr<world::Fix> fix) override;
+    void setUserFixes(const std::vector<std::shared_ptr<world::Fix>> &fixes) override;
 
     std::shared_ptr<world::RouteFinder> getRouteFinder() override;
 
-    void addAirport(std::shared_ptr<world::Airport> a);
+    // adds the nodes of a loaded area, each to the area of its location
+    void addNodes(const std::vector<std::shared_ptr<world::Airport>> &airports, const std::vector<std::shared_ptr<world::Fix>> &fixes);
+    void addAreaCount(int lonx, int laty, int nodes);
+
+    // Route finding uses the airway graph, resolving its fixes by fix_id (the graph index of SQL fixes).
+    // Airports join it through their procedures, registered when they are loaded with them.
+    void setAirwayGraph(std::shared_ptr<const AirwayGraph> graph);
+    std::shared_ptr<world::Fix> shareFix(std::shared_ptr<world::Fix> fix);
+    void connectFromAirport(std::shared_ptr<world::Airport> airport, std::shared_ptr<world::NavEdge> via, int fixId);
+    void connectToAirport(int fixId, std::shared_ptr<world::NavEdge> via, std::shared_ptr<world::Airport> airport);
 
     void shutdown();
 
 protected:
     void backgroundLoader();
-    void addNodeToArea(int lonx_idx, int laty_idx, std::shared_ptr<world::NavNode> node);
+    void touchArea(const std::pair<int, int> &area);
+    std::shared_ptr<world::Fix> resolveFix(int fixId);
+    // evicts the least recently used areas until at most target nodes are cached
+    void evictAreas(size_t target);
+    size_t trimAreas(size_t bytes);
 
 private:
     // weak pointer prevents circular referencing to this objects owner
@@ -63,29 +91,75 @@ private:
 
     // Regions indexed by their codes
     std::map<std::string, std::shared_ptr<world::Region>> regions;
+    std::mutex regionGuard;
 
-    // A background thread is used to load NAV items from the SQL database. The in-memory
-    // cache of these nodes is protected from concurrent access by this mutex. In general
-    // the background task will only hold the mutex for short periods to update the collections.
-    // The foreground thread (apps) will claim the mutex for the duration of any API calls
-    // to obtain node information, giving it priority.
+    // A few background threads are used to load NAV items from the SQL database. This mutex
+    // protects the loader queues, the LRU state and the airport LOD, and serialises the
+    // publication of areaNodes. It is only ever held briefly, the foreground thread (apps)
+    // reports nodes to its callbacks without it.
     std::mutex navStateGuard;
 
-    // Cache of NavNodes in each lon/lat area on the globe
-    std::map<std::pair<int, int>, std::vector<std::shared_ptr<world::NavNode>>> areaNodes;
-    // If the map has an entry for an area, false means it is being loaded, true means it is available.
-    std::map<std::pair<int, int>, bool> areaCached;
-    // Non-null when an area is being loaded asynchronously, references the lon/lat pair being loaded.
-    std::unique_ptr<std::pair<int, int>> backgroundLoadArea;
+    // Node counts of each lon/lat area, loaded once from the grid_count table
+    world::DensityPyramid density;
 
-    // Connections between nodes (airports, heliports, runways, fixes)
-    std::map<std::shared_ptr<world::NavNode>, std::vector<world::World::Connection>> connections;
-    std::vector<world::World::Connection> noConnection;
+    // Most significant of the loaded airports for zoomed-out maps
+    world::AirportLOD airportLOD;
 
-    // used to synchronise with the background worker
-    std::future<void> asyncLoaderState;
-    std::mutex backgroundLoaderGuard;
+    // Cache of NavNodes in each lon/lat area on the globe. Published snapshots are never modified,
+    // loaders copy the map and the changed lists and swap the new one in with std::atomic_store,
+    // so readers take it with std::atomic_load and search it without any lock.
+    using NodeList = std::vector<std::shared_ptr<world::NavNode>>;
+    using AreaMap = std::map<std::pair<int, int>, std::shared_ptr<const NodeList>>;
+    std::shared_ptr<const AreaMap> areaNodes;
+    // If the map has an entry for an area, false means it is being loaded, true means it is available.
+    std::map<std::pair<int, int>, bool> areaCached;
+    // Areas waiting for a loader thread, nearest to the centre of the last visited view first.
+    // Their areaCached entries are false, as are those of the areas being loaded.
+    std::deque<std::pair<int, int>> pendingAreas;
+    // Areas along the aircraft track and route, loaded when no visited area is pending.
+    // They get no areaCached entry until a loader takes them, so a visit still queues them first.
+    std::deque<std::pair<int, int>> prefetchAreas;
+    // Value of useClock when each loaded area was last visited or prefetched, the
+    // least recently used are evicted once the cache holds more than MAX_CACHED_NODES
+    std::map<std::pair<int, int>, uint32_t> areaLastUse;
+    uint32_t useClock = 0;
+    size_t cachedNodes = 0;
+    // Incremented for each node added to the cache, see getNodeRevision
+    std::atomic<uint32_t> nodeRevision { 0 };
+
+    // user fixes are kept out of the areas so that they are never evicted
+    world::UserFixIndex userFixIndex;
+
+    // The airway network and the connections built from it on demand. The lists are never
+    // changed once built, so searches can keep using them after they were replaced or dropped.
+    std::mutex graphGuard;
+    std::shared_ptr<const AirwayGraph> airwayGraph;
+    std::unordered_map<int, std::weak_ptr<world::Fix>> graphFixes;
+    std::unordered_map<int, world::World::ConnectionList> fixConnections;
+    // SIDs by airport ID and the fixes they lead to, resolved on first use
+    std::unordered_map<std::string, std::vector<std::pair<std::shared_ptr<world::NavEdge>, int>>> airportExits;
+    std::unordered_map<std::string, world::World::ConnectionList> airportConnections;
+    // STARs and approaches by the fix they start at, airports that no longer exist are skipped
+    std::unordered_map<int, std::vector<std::pair<std::shared_ptr<world::NavEdge>, std::weak_ptr<world::Airport>>>> airportEntries;
+    const world::World::ConnectionList noConnection = std::make_shared<const std::vector<world::World::Connection>>();
+
+    static constexpr const size_t MAX_PENDING_AREAS = 32;
+    static constexpr const unsigned MAX_AREA_LOADERS = 4;
+    static constexpr const size_t MAX_PREFETCH_AREAS = 64;
+    static constexpr const double PREFETCH_STEP_DEGREES = 0.5;
+    static constexpr const size_t MAX_CACHED_NODES = 200000;
+    static constexpr const size_t MAX_CACHED_CONNECTIONS = 50000;
+    // rough average of a cached node with its names and edges, for the memory accounting
+    static constexpr const size_t APPROX_NODE_BYTES = 300;
+
+    // the loader threads wait on this with navStateGuard for pending areas
+    std::vector<std::thread> loaderThreads;
     std::condition_variable backgroundLoadControl;
+    bool stopLoaders = false;
+    // set on a loader thread whose release of the load manager destroyed the world
+    static thread_local bool destroyedByLoader;
+
+    platform::MemoryBudget::Registration memoryConsumer;
 };
 
 }
@@ -18,6 +18,7 @@
 
 #include "AirportLoader.h"
 #include "FixLoader.h"
+#include "NavDbCodes.h"
 #include "../SqlLoadManager.h"
 #include "../SqlWorld.h"
 #include "../SqlStatement.h"
@@ -26,6 +27,7 @@
 #include "../models/airports/procs/SqlApproach.h"
 #include "src/Logger.h"
 #include <sstream>
+#include <cmath>
 
 namespace sqlnav {
 
@@ -47,34 +49,18 @@ std::shared_ptr<world::Airport> AirportLoader::load(std::vector<std::shared_ptr<
     // one of 2 different searches may be used, both return the same set of columns
     std::shared_ptr<SqlStatement> q;
     if (icao_search) {
-        q = loadMgr->GetSQL(SqlLoadManager::Searches::AIRPORT_BY_ICAO, isBackgroundLoad);
+        q = loadMgr->GetSQL(SqlLoadManager::Searches::AIRPORT_BY_ICAO);
         q->initialize();
         q->bind(1, *icao_search);
     } else {
-        q = loadMgr->GetSQL(SqlLoadManager::Searches::AIRPORT_BY_ID, isBackgroundLoad);
+        q = loadMgr->GetSQL(SqlLoadManager::Searches::AIRPORT_BY_ID);
         q->initialize();
         q->bind(1, id_search);
     }
 
     // start with the basic airport information
     if (q->step()) return nullptr;
-    airport_id = q->getInt(0);
-    this->ident = q->getString(1);
-    auto name = q->getString(2);
-    this->region = q->getString(3);
-    auto country = q->getString(4);
-    auto lonx = q->getDouble(5);
-    auto laty = q->getDouble(6);
-    auto altitude = q->getInt(7);
-
-    auto r = loadMgr->getRegion(region);
-    r->setName(country);
-
-    a = std::make_shared<world::Airport>(ident);
-    a->setName(name);
-    a->setRegion(r);
-    a->setElevation(altitude);
-    a->setLocation(world::Location(laty, lonx));
+    addAirport(*q, 0);
 
     // add related info: comms, runways, heliports, navaids, fixes
     addComms();
@@ -89,138 +75,199 @@ std::shared_ptr<world::Airport> AirportLoader::load(std::vector<std::shared_ptr<
     return a;
 }
 
-inline world::Airport::ATCFrequency mapToATCclass(const std::string &type) {
-    // LNM populates its MSFS DB with these comms tags: A C D G T UC MC CPT CTR FSS RCD ATIS ASOS AWOS CTAF
-    if (type.size() == 1) {
-        switch (type[0]) {
-            case 'A': return world::Airport::ATCFrequency::APP;
-            case 'C': return world::Airport::ATCFrequency::CLD;
-            case 'D': return world::Airport::ATCFrequency::DEP;
-            case 'G': return world::Airport::ATCFrequency::GND;
-            case 'T': return world::Airport::ATCFrequency::TWR;
-            default:  return world::Airport::ATCFrequency::RECORDED;
-        };
+void AirportLoader::addAirport(SqlStatement &q, int col)
+{
+    airport_id = q.getInt(col + 0);
+    this->ident = q.getString(col + 1);
+    auto name = q.getString(col + 2);
+    this->region = q.getString(col + 3);
+    auto country = q.getString(col + 4);
+    auto lonx = q.getDouble(col + 5);
+    auto laty = q.getDouble(col + 6);
+    auto altitude = q.getInt(col + 7);
+
+    auto r = loadMgr->getRegion(region);
+    r->setName(country);
+
+    a = std::make_shared<world::Airport>(ident);
+    a->setName(name);
+    a->setRegion(r);
+    a->setElevation(altitude);
+    a->setLocation(world::Location(laty, lonx));
+}
+
+std::shared_ptr<world::Airport> AirportLoader::getAirport() const
+{
+    return a;
+}
+
+void AirportLoader::addFacilities(SqlStatement &q, int col)
+{
+    towered = q.getBool(col + 0);
+    heliports = q.getBool(col + 1);
+}
+
+void AirportLoader::addRunwaySummary(SqlStatement &q, int col)
+{
+    auto rid = q.getInt(col + 0);
+    auto pairid = q.getInt(col + 1);
+    RunwayEnd end;
+    end.length = q.getInt(col + 2) / world::M_TO_FT;
+    end.surface = mapToSurfaceMaterial(q.getString(col + 3));
+    end.offset = q.getFloat(col + 4);
+    end.location = world::Location(q.getDouble(col + 6), q.getDouble(col + 5));
+
+    // paired as in addRunway
+    auto p = endPairs.find(pairid);
+    if (p == endPairs.end()) {
+        auto &pair = endPairs[rid];
+        pair.ends[0] = end;
+        pair.n = 1;
+    } else if (p->second.n == 1) {
+        p->second.ends[1] = end;
+        p->second.n = 2;
     }
-    if (type.size() == 2) {
-        switch (type[0]) {
-            case 'U': return world::Airport::ATCFrequency::UNICOM;
-            case 'M': return world::Airport::ATCFrequency::MULTICOM;
-            default:  return world::Airport::ATCFrequency::RECORDED;
-        };
+}
+
+void AirportLoader::addAreaLocalizer(SqlStatement &q, int col, std::vector<std::shared_ptr<world::Fix>> &fixes)
+{
+    // the area query only returns localizers of known runway ends
+    auto f = createLocalizer(q, col);
+    if (!f) return;
+    areaLocalizers.emplace_back(q.getInt(col + 2), f);
+    fixes.push_back(f);
+}
+
+void AirportLoader::setDetailLoader()
+{
+    // the same as the airport would answer with its runways, see world::Airport
+    world::Airport::Summary summary;
+    summary.towered = towered;
+    summary.upLeft = a->getLocation();
+    summary.downRight = a->getLocation();
+    int ends = 0, waterEnds = 0;
+    for (auto &p: endPairs) {
+        if (p.second.n != 2) continue;
+        auto &pair = p.second.ends;
+        float length = pair[0].length - ((pair[0].offset + pair[1].offset) / world::M_TO_FT);
+        summary.longestRunwayLength = std::fmax(summary.longestRunwayLength, length);
+        for (auto &end: pair) {
+            ++ends;
+            if (end.surface == world::Runway::SurfaceMaterial::WATER) ++waterEnds;
+            if (world::Runway::isHardSurface(end.surface)) summary.hardRunway = true;
+            summary.upLeft.longitude = std::min(summary.upLeft.longitude, end.location.longitude);
+            summary.upLeft.latitude = std::max(summary.upLeft.latitude, end.location.latitude);
+            summary.downRight.longitude = std::max(summary.downRight.longitude, end.location.longitude);
+            summary.downRight.latitude = std::min(summary.downRight.latitude, end.location.latitude);
+        }
     }
-    if (type.size() == 3) {
-        switch (type[1]) {
-            case 'P': return world::Airport::ATCFrequency::CLD;         // CPT
-            case 'T': return world::Airport::ATCFrequency::CTR;         // CTR
-            case 'S': return world::Airport::ATCFrequency::FSS;         // FSS
-            default:  return world::Airport::ATCFrequency::RECORDED;
-        };
+    summary.onlyWaterRunways = (ends > 0) && (waterEnds == ends);
+    summary.onlyHeliports = (ends == 0) && heliports;
+
+    // the airport owns its loader, so the loader must not own the airport
+    std::weak_ptr<SqlLoadManager> weakMgr = loadMgr;
+    std::weak_ptr<world::Airport> weakAirport = a;
+    int id = airport_id;
+    auto localizers = std::move(areaLocalizers);
+    a->setDetailLoader(summary, [weakMgr, weakAirport, id, localizers] () {
+        auto mgr = weakMgr.lock();
+        auto airport = weakAirport.lock();
+        if (!mgr || !airport) return;
+        AirportLoader loader(mgr, id, true);
+        loader.loadDetails(airport, localizers);
+    });
+}
+
+void AirportLoader::loadDetails(std::shared_ptr<world::Airport> airport, const Localizers &localizers)
+{
+    a = airport;
+    airport_id = id_search;
+    addComms();
+    addRunways();
+    addHeliports();
+    addFixes();
+
+    // the localizers were loaded with the area, as the map shows them
+    for (auto &l: localizers) {
+        auto r = rws.find(l.first);
+        if (r != rws.end()) r->second->attachILSData(l.second);
+        a->addTerminalFix(l.second);
     }
-    return world::Airport::ATCFrequency::RECORDED;
 }
 
 void AirportLoader::addComms()
 {
-    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::COMMS_AT_AIRPORT, isBackgroundLoad);
+    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::COMMS_AT_AIRPORT);
     q->initialize();
     q->bind(1, airport_id);
 
-    // process the results, creating a Runway object for each row, and pairing them up
+    // process the results, adding a frequency for each row
     while (1) {
         if (q->step()) break;
-        auto type = q->getString(0);
-        auto f = q->getInt(1);
-        auto name = q->getString(2);
-        world::Frequency frequency(f, 6, world::Frequency::Unit::MHZ, name);
-        a->addATCFrequency(mapToATCclass(type), frequency);
+        addComm(*q, 0);
     }
 }
 
-inline world::Runway::SurfaceMaterial mapToSurfaceMaterial(const std::string &rwy) {
-    // LNM populates its MSFS DB with these surface tags: A B C CE CR D G GR I M OT S SN T UNKNOWN W
-    if (rwy.size() == 1) {
-        switch (rwy[0]) {
-            case 'A': return world::Runway::SurfaceMaterial::ASPHALT;
-            case 'B': return world::Runway::SurfaceMaterial::BITUMINOUS;
-            case 'D': return world::Runway::SurfaceMaterial::DIRT;
-            case 'G': return world::Runway::SurfaceMaterial::GRASS;
-            case 'I': return world::Runway::SurfaceMaterial::ICE;
-            case 'M': return world::Runway::SurfaceMaterial::TARMAC;
-            case 'S': return world::Runway::SurfaceMaterial::SAND;
-            case 'T': return world::Runway::SurfaceMaterial::TARMAC;
-            case 'W': return world::Runway::SurfaceMaterial::WATER;
-            default:  return world::Runway::SurfaceMaterial::UNKNOWN;
-        };
-    }
-    if (rwy.size() >= 2) {
-        switch (rwy[0]) {
-            case 'C': switch (rwy[1]) {
-                case 'E': return world::Runway::SurfaceMaterial::CONCRETE;
-                case 'R': return world::Runway::SurfaceMaterial::CORAL;
-                default:  return world::Runway::SurfaceMaterial::UNKNOWN;
-            }
-            case 'G': return world::Runway::SurfaceMaterial::GRAVEL;
-            case 'S': return world::Runway::SurfaceMaterial::SNOW;
-            default:  return world::Runway::SurfaceMaterial::UNKNOWN;
-        }
-    }
-    return world::Runway::SurfaceMaterial::UNKNOWN;
+void AirportLoader::addComm(SqlStatement &q, int col)
+{
+    auto type = q.getString(col + 0);
+    auto f = q.getInt(col + 1);
+    auto name = q.getString(col + 2);
+    world::Frequency frequency(f, 6, world::Frequency::Unit::MHZ, name);
+    a->addATCFrequency(mapToATCclass(type), frequency);
 }
 
 void AirportLoader::addRunways()
 {
-    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::RUNWAYS_AT_AIRPORT, isBackgroundLoad);
+    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::RUNWAYS_AT_AIRPORT);
     q->initialize();
     q->bind(1, airport_id);
 
-    struct RunwayPair {
-        RunwayPair() : n(0), offset_sum(0.0f) { }
-        RunwayPair(std::shared_ptr<world::Runway> r, float o) : n(1), forward(r), offset_sum(o) { }
-        void AddReverse(std::shared_ptr<world::Runway> r, float o) { ++n; reverse = r; offset_sum += o; }
-        int n;
-        std::shared_ptr<world::Runway> forward;
-        std::shared_ptr<world::Runway> reverse;
-        float offset_sum;
-    };
-
-    std::map<int, RunwayPair> pairs; // keyed by the id of the 'forward' runway
-
     // process the results, creating a Runway object for each row, and pairing them up
     while (1) {
         if (q->step()) break;
-        auto rid = q->getInt(0);
-        auto name = q->getString(1);
-        auto pairid = q->getInt(2);
-        auto length = q->getInt(3);
-        auto width = q->getInt(4);
-        auto surface = q->getString(5);
-        auto heading = q->getFloat(6);
-        auto altitude = q->getInt(7);
-        auto offset = q->getFloat(8);
-        auto lonx = q->getDouble(9);
-        auto laty = q->getDouble(10);
-
-        auto r = std::make_shared<world::Runway>(name);
-        r->setHeading(heading);
-        r->setWidth(width / world::M_TO_FT);
-        r->setLength(length / world::M_TO_FT);
-        world::Location loc(laty, lonx);
-        r->setLocation(loc);
-        r->setSurfaceType(mapToSurfaceMaterial(surface));
-        r->setElevation(altitude);
-        rws[rid] = r;
-
-        // do we already have this runway's opposite direction?
-        auto p = pairs.find(pairid);
-        if (p == pairs.end()) {
-            // not seen the opposite yet, so create a new entry in the map
-            pairs[rid] = RunwayPair(r, offset);
-        } else {
-            // there is an entry for the 'forward' runway, add this as the reverse
-            pairs[pairid].AddReverse(r, offset);
-        }
+        addRunway(*q, 0);
     }
+    pairRunways();
+}
 
+void AirportLoader::addRunway(SqlStatement &q, int col)
+{
+    auto rid = q.getInt(col + 0);
+    auto name = q.getString(col + 1);
+    auto pairid = q.getInt(col + 2);
+    auto length = q.getInt(col + 3);
+    auto width = q.getInt(col + 4);
+    auto surface = q.getString(col + 5);
+    auto heading = q.getFloat(col + 6);
+    auto altitude = q.getInt(col + 7);
+    auto offset = q.getFloat(col + 8);
+    auto lonx = q.getDouble(col + 9);
+    auto laty = q.getDouble(col + 10);
+
+    auto r = std::make_shared<world::Runway>(name);
+    r->setHeading(heading);
+    r->setWidth(width / world::M_TO_FT);
+    r->setLength(length / world::M_TO_FT);
+    world::Location loc(laty, lonx);
+    r->setLocation(loc);
+    r->setSurfaceType(mapToSurfaceMaterial(surface));
+    r->setElevation(altitude);
+    rws[rid] = r;
+
+    // do we already have this runway's opposite direction?
+    auto p = pairs.find(pairid);
+    if (p == pairs.end()) {
+        // not seen the opposite yet, so create a new entry in the map
+        pairs[rid] = RunwayPair(r, offset);
+    } else {
+        // there is an entry for the 'forward' runway, add this as the reverse
+        pairs[pairid].AddReverse(r, offset);
+    }
+}
+
+void AirportLoader::pairRunways()
+{
     // now add the runways to the airport, as pairs
     for (auto p: pairs) {
         if (p.second.n != 2) {
@@ -236,99 +283,109 @@ void AirportLoader::addRunways()
         a->addRunway(r2);
         a->addRunwayEnds(r1, r2);
     }
+    pairs.clear();
 }
 
 void AirportLoader::addHeliports()
 {
-    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::HELIPADS_AT_AIRPORT, isBackgroundLoad);
+    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::HELIPADS_AT_AIRPORT);
     q->initialize();
     q->bind(1, airport_id);
 
     while (1) {
         if (q->step()) break;
-        auto id = q->getInt(0);
-        auto lonx = q->getDouble(1);
-        auto laty = q->getDouble(2);
+        addHeliport(*q, 0);
+    }
+}
 
-        world::Location loc(laty, lonx);
-        std::ostringstream name;
-        name << 'H' << id;
+void AirportLoader::addHeliport(SqlStatement &q, int col)
+{
+    auto id = q.getInt(col + 0);
+    auto lonx = q.getDouble(col + 1);
+    auto laty = q.getDouble(col + 2);
 
-        auto h = std::make_shared<world::Heliport>(name.str());
-        h->setLocation(loc);
-        a->addHeliport(h);
-    }
+    world::Location loc(laty, lonx);
+    std::ostringstream name;
+    name << 'H' << id;
+
+    auto h = std::make_shared<world::Heliport>(name.str());
+    h->setLocation(loc);
+    a->addHeliport(h);
 }
 
 void AirportLoader::addLocalizers(std::vector<std::shared_ptr<world::Fix>> *fixes)
 {
-    // These XP names count as ILS: "ILS-CAT-I", "ILS-CAT-II", "ILS-CAT-III", "IGS", "LDA"
-    // These XP names count as localizer only: "LOC", "SDF"
-    // These XP names would seem to be additional navaids we should ignore: LP, LPV, GLS
-    if (fixIsLocOnly.size() == 0) {
-        fixIsLocOnly["ILS"] = false;
-        fixIsLocOnly["IGS"] = false;
-        fixIsLocOnly["LDA"] = false;
-        fixIsLocOnly["LOC"] = true;
-        fixIsLocOnly["SDF"] = true;
-    }
-
-    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::LOCALIZERS_AT_AIRPORT, isBackgroundLoad);
+    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::LOCALIZERS_AT_AIRPORT);
     q->initialize();
     q->bind(1, airport_id);
 
     // process the results, creating an ILSLocalizer object for qualifying rows
     while (1) {
         if (q->step()) break;
+        addLocalizer(*q, 0, fixes);
+    }
+}
 
-        // if we don't recognize the name (first 3 chars) then skip to the next one
-        auto ils_ident = q->getString(0);
-        auto name = q->getString(1);
-        auto description = name;
-        if (description.size() > 3) description.resize(3);
-        if (fixIsLocOnly.find(description) == fixIsLocOnly.end()) {
-            logger::warn("Fix %s (%s) is not recognised as ILS or LOC", ils_ident.c_str(), name.c_str());
-            continue;
-        }
+void AirportLoader::addLocalizer(SqlStatement &q, int col, std::vector<std::shared_ptr<world::Fix>> *fixes)
+{
+    auto f = createLocalizer(q, col);
+    if (!f) return;
+
+    // if we don't have a runway [end] with this ID then skip it
+    auto reid = q.getInt(col + 2);
+    if (rws.find(reid) == rws.end()) {
+        logger::warn("ILS/LOC %s has unknown runway end id %d", f->getID().c_str(), reid);
+        return;
+    }
 
-        // if we don't have a runway [end] with this ID then skip it
-        auto reid = q->getInt(2);
-        if (rws.find(reid) == rws.end()) {
-            logger::warn("ILS/LOC %s has unknown runway end id %d", ils_ident.c_str(), reid);
-            continue;
-        }
+    // link the ILS to its runway
+    rws[reid]->attachILSData(f);
 
-        auto lonx = q->getDouble(3);
-        auto laty = q->getDouble(4);
-        auto freq = q->getInt(5);
-        auto heading = q->getFloat(6);
-        auto magvar = q->getFloat(7);
-        auto range = q->getInt(8);
-        auto dme_range = q->getInt(9);
-
-        auto r = loadMgr->getRegion(region);
-        world::Location loc(laty, lonx);
-        auto f = std::make_shared<world::Fix>(r, ils_ident, loc);
-
-        world::Frequency ilsFrq(freq, 3, world::Frequency::Unit::MHZ, description);
-        auto ils = std::make_shared<world::ILSLocalizer>(ilsFrq, range);
-        ils->setRunwayHeading(heading);
-        ils->setRunwayHeadingMagnetic(heading + magvar);
-        ils->setLocalizerOnly(fixIsLocOnly[description]);
-        f->attachILSLocalizer(ils);
-
-        if (dme_range) {
-            auto dme = std::make_shared<world::DME>(ilsFrq, dme_range);
-            f->attachDME(dme);
-        }
+    // add the ILS to the list of fixes
+    a->addTerminalFix(f);
+    if (fixes) fixes->push_back(f);
+}
 
-        // link the ILS to its runway
-        rws[reid]->attachILSData(f);
+std::shared_ptr<world::Fix> AirportLoader::createLocalizer(SqlStatement &q, int col)
+{
+    // These XP names count as ILS: "ILS-CAT-I", "ILS-CAT-II", "ILS-CAT-III", "IGS", "LDA"
+    // These XP names count as localizer only: "LOC", "SDF"
+    // These XP names would seem to be additional navaids we should ignore: LP, LPV, GLS
 
-        // add the ILS to the list of fixes
-        a->addTerminalFix(f);
-        if (fixes) fixes->push_back(f);
+    // if we don't recognize the name (first 3 chars) then skip to the next one
+    auto ils_ident = q.getString(col + 0);
+    auto name = q.getString(col + 1);
+    auto description = name;
+    if (description.size() > 3) description.resize(3);
+    if (fixIsLocOnly.find(description) == fixIsLocOnly.end()) {
+        logger::warn("Fix %s (%s) is not recognised as ILS or LOC", ils_ident.c_str(), name.c_str());
+        return nullptr;
+    }
+
+    auto lonx = q.getDouble(col + 3);
+    auto laty = q.getDouble(col + 4);
+    auto freq = q.getInt(col + 5);
+    auto heading = q.getFloat(col + 6);
+    auto magvar = q.getFloat(col + 7);
+    auto range = q.getInt(col + 8);
+    auto dme_range = q.getInt(col + 9);
+
+    auto r = loadMgr->getRegion(region);
+    world::Location loc(laty, lonx);
+    auto f = std::make_shared<world::Fix>(r, ils_ident, loc);
+
+    world::Frequency ilsFrq(freq, 3, world::Frequency::Unit::MHZ, description);
+    auto ils = std::make_shared<world::ILSLocalizer>(ilsFrq, range);
+    ils->setRunwayHeading(heading);
+    ils->setRunwayHeadingMagnetic(heading + magvar);
+    ils->setLocalizerOnly(fixIsLocOnly.at(description));
+    f->attachILSLocalizer(ils);
+
+    if (dme_range) {
+        auto dme = std::make_shared<world::DME>(ilsFrq, dme_range);
+        f->attachDME(dme);
     }
+    return f;
 }
 
 void AirportLoader::addFixes()
@@ -336,24 +393,21 @@ void AirportLoader::addFixes()
     // don't bother with fixes when loading for a specific airport search
     if (!isBackgroundLoad) return;
 
-    // get a list of fixes associated with this airport ID
-    std::vector<int> fix_ids;
-
-    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::FIXES_AT_AIRPORT, isBackgroundLoad);
+    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::FIXES_AT_AIRPORT);
     q->initialize();
     q->bind(1, airport_id);
 
-    // extract the list of fix IDs associated with this airport
+    // one row per fix of this airport, with the NDB and VOR columns joined in
+    FixLoader fl(loadMgr, 0);
     while (1) {
         if (q->step()) break;
-        auto fid = q->getInt(0);
-        fix_ids.push_back(fid);
-    }
-
-    // load each fix in turn, and add to the vector of associated fixes
-    for (auto fid: fix_ids) {
-        auto fl = std::make_unique<FixLoader>(loadMgr, fid);
-        auto f = fl->load();
+        auto f = fl.createFix(*q, 0);
+        f->setGraphIndex(q->getInt(17));
+        if (q->getInt(6)) {
+            fl.addNDB(*q, 7);
+        } else if (q->getInt(10)) {
+            fl.addVORDME(*q, 11);
+        }
         a->addTerminalFix(f);
     }
 }
@@ -363,7 +417,7 @@ void AirportLoader::addProcedures()
     // only bother with procedures when loading for a specific airport search
     if (isBackgroundLoad) return;
 
-    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::PROCEDURES_AT_AIRPORT, isBackgroundLoad);
+    auto q = loadMgr->GetSQL(SqlLoadManager::Searches::PROCEDURES_AT_AIRPORT);
     q->initialize();
     q->bind(1, airport_id);
 
@@ -376,30 +430,28 @@ void AirportLoader::addProcedures()
     std::map<std::string, std::shared_ptr<SqlApproach>> apprs;
     while (1) {
         if (q->step()) break;
-        // procedure_id, type, name, runway_name, initial_fix, final_fix, via_fixes
+        // procedure_id, type, name, runway_name, fix_ids
         auto procId = q->getInt(0);
         auto type = q->getString(1);
         auto name = q->getString(2);
         auto runway = q->getString(3);
-        auto f0 = q->getInt(4);
-        auto fn = q->getInt(5);
-        auto vias = q->getString(6);
+        auto fixes = q->getIntArray(4);
 
         if (type == "1") { // SID
             if (sids.find(name) == sids.end()) {
-                sids[name] = std::make_shared<SqlSID>(name, loadMgr);
+                sids[name] = std::make_shared<SqlSID>(name, airport_id, loadMgr);
             }
-            sids[name]->addVariant(procId, runway, SqlLoadManager::toVector(f0, fn, vias));
+            sids[name]->addVariant(procId, runway, fixes);
         } else if (type == "2") { // STAR
             if (stars.find(name) == stars.end()) {
-                stars[name] = std::make_shared<SqlSTAR>(name, loadMgr);
+                stars[name] = std::make_shared<SqlSTAR>(name, airport_id, loadMgr);
             }
-            stars[name]->addVariant(procId, runway, SqlLoadManager::toVector(f0, fn, vias));
+            stars[name]->addVariant(procId, runway, fixes);
         } else if (type == "3") { // approach
             if (apprs.find(name) == apprs.end()) {
-                apprs[name] = std::make_shared<SqlApproach>(name, loadMgr);
+                apprs[name] = std::make_shared<SqlApproach>(name, airport_id, loadMgr);
             }
-            apprs[name]->addVariant(procId, runway, SqlLoadManager::toVector(f0, fn, vias));
+            apprs[name]->addVariant(procId, runway, fixes);
         } else {
             logger::warn("Procedure %s @ %s has unknown type %s", name.c_str(), ident.c_str(), type.c_str());
         }
@@ -414,8 +466,34 @@ void AirportLoader::addProcedures()
     for (auto p: apprs) {
         a->addApproach(p.second);
     }
+
+    // the procedures connect the airport to the airway graph used for route finding
+    auto world = std::dynamic_pointer_cast<SqlWorld>(loadMgr->getWorld());
+    if (!world) return;
+    for (auto p: sids) {
+        for (auto fixId: p.second->getExitFixes()) {
+            world->connectFromAirport(a, p.second, fixId);
+        }
+    }
+    for (auto p: stars) {
+        for (auto fixId: p.second->getEntryFixes()) {
+            world->connectToAirport(fixId, p.second, a);
+        }
+    }
+    for (auto p: apprs) {
+        for (auto fixId: p.second->getEntryFixes()) {
+            world->connectToAirport(fixId, p.second, a);
+        }
+    }
 }
 
-std::map<std::string, bool> AirportLoader::fixIsLocOnly;
+// filled here rather than on first use, areas are loaded by several threads
+const std::map<std::string, bool> AirportLoader::fixIsLocOnly = {
+    {"ILS", false},
+    {"IGS", false},
+    {"LDA", false},
+    {"LOC", true},
+    {"SDF", true},
+};
 
 } /* namespace sqlnav */
@@ -23,6 +23,7 @@ namespace sqlnav {
 
 class SqlLoadManager;
 class SqlWorld;
+class SqlStatement;
 
 class AirportLoader
 {
@@ -36,16 +37,37 @@ public:
 
     std::shared_ptr<world::Airport> load(std::vector<std::shared_ptr<world::Fix>> *ils_fixes = nullptr);
 
+    // Used by the AreaLoader to build the skeleton of an airport from the rows of its area
+    // queries, starting at col. The skeleton has a summary of the runways and tower for the map, everything else is
+    // loaded by loadDetails when the airport is first asked for it.
+    void addAirport(SqlStatement &q, int col);
+    void addFacilities(SqlStatement &q, int col);
+    void addRunwaySummary(SqlStatement &q, int col);
+    void addAreaLocalizer(SqlStatement &q, int col, std::vector<std::shared_ptr<world::Fix>> &fixes);
+    void setDetailLoader();
+    std::shared_ptr<world::Airport> getAirport() const;
+
+    using Localizers = std::vector<std::pair<int, std::shared_ptr<world::Fix>>>;
+    void loadDetails(std::shared_ptr<world::Airport> airport, const Localizers &localizers);
+
+    // the first 3 characters of ILS names that are recognised, true for localizers without glideslope
+    static const std::map<std::string, bool> fixIsLocOnly;
+
 private:
     void addComms();
+    void addComm(SqlStatement &q, int col);
     void addRunways();
+    void addRunway(SqlStatement &q, int col);
+    void pairRunways();
     void addHeliports();
+    void addHeliport(SqlStatement &q, int col);
     void addLocalizers(std::vector<std::shared_ptr<world::Fix>> *fixes);
+    void addLocalizer(SqlStatement &q, int col, std::vector<std::shared_ptr<world::Fix>> *fixes);
+    std::shared_ptr<world::Fix> createLocalizer(SqlStatement &q, int col);
     void addFixes();
     void addProcedures();
 
 private:
-    static std::map<std::string, bool> fixIsLocOnly;
     std::shared_ptr<SqlLoadManager> loadMgr;
     bool const isBackgroundLoad;
     int const id_search;
@@ -55,6 +77,33 @@ private:
     std::string ident;
     std::string region;
     std::map<int, std::shared_ptr<world::Runway>> rws;
+
+    struct RunwayPair {
+        RunwayPair() : n(0), offset_sum(0.0f) { }
+        RunwayPair(std::shared_ptr<world::Runway> r, float o) : n(1), forward(r), offset_sum(o) { }
+        void AddReverse(std::shared_ptr<world::Runway> r, float o) { ++n; reverse = r; offset_sum += o; }
+        int n;
+        std::shared_ptr<world::Runway> forward;
+        std::shared_ptr<world::Runway> reverse;
+        float offset_sum;
+    };
+    std::map<int, RunwayPair> pairs; // keyed by the id of the 'forward' runway
+
+    // the skeleton's runway ends, paired in the same way
+    struct RunwayEnd {
+        float length;
+        float offset;
+        world::Runway::SurfaceMaterial surface;
+        world::Location location;
+    };
+    struct RunwayEndPair {
+        int n = 0;
+        RunwayEnd ends[2];
+    };
+    std::map<int, RunwayEndPair> endPairs;
+    bool towered = false;
+    bool heliports = false;
+    Localizers areaLocalizers; // by runway_id
 };
 
 }
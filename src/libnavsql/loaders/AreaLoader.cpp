@@ -0,0 +1,124 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "AreaLoader.h"
+#include "AirportLoader.h"
+#include "FixLoader.h"
+#include "../SqlStatement.h"
+#include "src/Logger.h"
+#include "src/platform/Metrics.h"
+
+namespace sqlnav {
+
+AreaLoader::AreaLoader(std::shared_ptr<SqlLoadManager> db, int x, int y)
+:   loadMgr(db), lonx(x), laty(y)
+{
+}
+
+AreaLoader::~AreaLoader() = default;
+
+void AreaLoader::load(std::vector<std::shared_ptr<world::Airport>> &airports,
+                      std::vector<std::shared_ptr<world::Fix>> &ilsFixes,
+                      std::vector<std::shared_ptr<world::Fix>> &fixes)
+{
+    static auto &areasLoaded = platform::Metrics::counter("nav/areas_loaded");
+    areasLoaded.add();
+
+    loadAirports();
+    loadRunwaySummaries();
+    loadLocalizers(ilsFixes);
+    loadFixes(fixes);
+
+    for (auto id: airportOrder) {
+        auto &al = airportLoaders[id];
+        al->setDetailLoader();
+        airports.push_back(al->getAirport());
+    }
+}
+
+std::shared_ptr<SqlStatement> AreaLoader::query(SqlLoadManager::Searches search)
+{
+    auto q = loadMgr->GetSQL(search);
+    q->initialize();
+    q->bind(1, lonx);
+    q->bind(2, laty);
+    return q;
+}
+
+AirportLoader *AreaLoader::findAirport(int airport_id)
+{
+    auto it = airportLoaders.find(airport_id);
+    if (it == airportLoaders.end()) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+void AreaLoader::loadAirports()
+{
+    auto q = query(SqlLoadManager::Searches::AIRPORTS_IN_AREA);
+    while (1) {
+        if (q->step()) break;
+        auto id = q->getInt(0);
+        if (airportLoaders.find(id) != airportLoaders.end()) continue;
+        auto al = std::make_unique<AirportLoader>(loadMgr, id, true);
+        al->addAirport(*q, 0);
+        al->addFacilities(*q, 8);
+        airportLoaders[id] = std::move(al);
+        airportOrder.push_back(id);
+    }
+}
+
+void AreaLoader::loadRunwaySummaries()
+{
+    auto q = query(SqlLoadManager::Searches::RUNWAYS_IN_AREA);
+    while (1) {
+        if (q->step()) break;
+        auto al = findAirport(q->getInt(0));
+        if (al) al->addRunwaySummary(*q, 1);
+    }
+}
+
+void AreaLoader::loadLocalizers(std::vector<std::shared_ptr<world::Fix>> &ilsFixes)
+{
+    auto q = query(SqlLoadManager::Searches::LOCALIZERS_IN_AREA);
+    while (1) {
+        if (q->step()) break;
+        auto al = findAirport(q->getInt(0));
+        if (al) al->addAreaLocalizer(*q, 1, ilsFixes);
+    }
+}
+
+void AreaLoader::loadFixes(std::vector<std::shared_ptr<world::Fix>> &fixes)
+{
+    // one row per fix of the area, with the NDB and VOR columns joined in
+    auto q = query(SqlLoadManager::Searches::FIXES_IN_AREA);
+    FixLoader fl(loadMgr, 0);
+    while (1) {
+        if (q->step()) break;
+        auto f = fl.createFix(*q, 0);
+        f->setGraphIndex(q->getInt(17));
+        if (q->getInt(6)) {
+            fl.addNDB(*q, 7);
+        } else if (q->getInt(10)) {
+            fl.addVORDME(*q, 11);
+        }
+        fixes.push_back(f);
+    }
+}
+
+}
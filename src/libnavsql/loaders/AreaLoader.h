@@ -0,0 +1,63 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <map>
+#include "src/world/models/airport/Airport.h"
+#include "src/world/models/navaids/Fix.h"
+#include "../SqlLoadManager.h"
+
+namespace sqlnav {
+
+class AirportLoader;
+
+// Loads all nodes of a 1x1 degree area with one query per kind of row instead
+// of a set of queries per airport and fix, and assembles them in memory. Only
+// what the map shows is loaded, the airports load their details on first use.
+class AreaLoader
+{
+public:
+    AreaLoader(std::shared_ptr<SqlLoadManager> db, int lonx, int laty);
+    ~AreaLoader();
+
+    // the airports come with a summary of their runways and tower, their localizers
+    // are returned as ilsFixes
+    void load(std::vector<std::shared_ptr<world::Airport>> &airports,
+              std::vector<std::shared_ptr<world::Fix>> &ilsFixes,
+              std::vector<std::shared_ptr<world::Fix>> &fixes);
+
+private:
+    std::shared_ptr<SqlStatement> query(SqlLoadManager::Searches search);
+    AirportLoader *findAirport(int airport_id);
+
+    void loadAirports();
+    void loadRunwaySummaries();
+    void loadLocalizers(std::vector<std::shared_ptr<world::Fix>> &ilsFixes);
+    void loadFixes(std::vector<std::shared_ptr<world::Fix>> &fixes);
+
+private:
+    std::shared_ptr<SqlLoadManager> loadMgr;
+    int const lonx;
+    int const laty;
+    std::vector<int> airportOrder;
+    std::map<int, std::unique_ptr<AirportLoader>> airportLoaders;
+};
+
+}
@@ -27,19 +27,19 @@ namespace sqlnav {
 
 // for use during background area loading
 FixLoader::FixLoader(std::shared_ptr<SqlLoadManager> db, int i)
-:   loadMgr(db), isBackgroundLoad(true), id(i), region(nullptr), ident(nullptr)
+:   loadMgr(db), id(i), region(nullptr), ident(nullptr)
 {
 }
 
 // for use during foreground search by name and region
 FixLoader::FixLoader(std::shared_ptr<SqlLoadManager> db, const std::string &rg, const std::string &id)
-:   loadMgr(db), isBackgroundLoad(false), id(0), region(&rg), ident(&id)
+:   loadMgr(db), id(0), region(&rg), ident(&id)
 {
 }
 
 // for use during foreground load of list of fixes
 FixLoader::FixLoader(std::shared_ptr<SqlLoadManager> db)
-:   loadMgr(db), isBackgroundLoad(false), id(0), region(nullptr), ident(nullptr)
+:   loadMgr(db), id(0), region(nullptr), ident(nullptr)
 {
 }
 
@@ -47,12 +47,12 @@ std::shared_ptr<world::Fix> FixLoader::load()
 {
     std::shared_ptr<SqlStatement> q;
     if (ident && region) {
-        q = loadMgr->GetSQL(SqlLoadManager::Searches::FIX_BY_NAME, isBackgroundLoad);
+        q = loadMgr->GetSQL(SqlLoadManager::Searches::FIX_BY_NAME);
         q->initialize();
         q->bind(1, *region);
         q->bind(2, *ident);
     } else if (id) {
-        q = loadMgr->GetSQL(SqlLoadManager::Searches::FIX_BY_ID, isBackgroundLoad);
+        q = loadMgr->GetSQL(SqlLoadManager::Searches::FIX_BY_ID);
         q->initialize();
         q->bind(1, id);
     } else {
@@ -63,19 +63,11 @@ std::shared_ptr<world::Fix> FixLoader::load()
         return nullptr;
     }
 
-    int nav_id;
-    std::string ident, region, type;
-    double lonx, laty;
-    ident = q->getString(0);
-    region = q->getString(1);
-    type = q->getString(2);
-    nav_id = q->getInt(3);
-    lonx = q->getDouble(4);
-    laty = q->getDouble(5);
-
-    auto r = loadMgr->getRegion(region);
-    world::Location loc(laty, lonx);
-    f = std::make_shared<world::Fix>(r, ident, loc);
+    createFix(*q, 0);
+    // the route finder identifies fixes by their fix_id, see SqlWorld::getConnections
+    f->setGraphIndex(id ? id : q->getInt(6));
+    auto type = q->getString(2);
+    auto nav_id = q->getInt(3);
 
     // the fix might have an NDB, VOR, or DME associated with it
     if (nav_id) {
@@ -89,6 +81,20 @@ std::shared_ptr<world::Fix> FixLoader::load()
     return f;
 }
 
+std::shared_ptr<world::Fix> FixLoader::createFix(SqlStatement &q, int col)
+{
+    // ident, region, type, nav_id, lonx, laty
+    auto ident = q.getString(col + 0);
+    auto region = q.getString(col + 1);
+    auto lonx = q.getDouble(col + 4);
+    auto laty = q.getDouble(col + 5);
+
+    auto r = loadMgr->getRegion(region);
+    world::Location loc(laty, lonx);
+    f = std::make_shared<world::Fix>(r, ident, loc);
+    return f;
+}
+
 std::vector<std::shared_ptr<world::Fix>> FixLoader::loadAll(const std::vector<int> fixKeys)
 {
     // create a json fragment to be used in the SQL query for a variable-length selection
@@ -102,7 +108,7 @@ std::vector<std::shared_ptr<world::Fix>> FixLoader::loadAll(const std::vector<in
 
     // retrieve the results - not necessarily in the order we want them!
     std::map<int, std::shared_ptr<world::Fix>> fixes;
-    auto qry = loadMgr->GetSQL(SqlLoadManager::Searches::FIXES_BY_KEYS, false);
+    auto qry = loadMgr->GetSQL(SqlLoadManager::Searches::FIXES_BY_KEYS);
     qry->initialize();
     qry->bind(1, srch);
     while (1) {
@@ -116,6 +122,7 @@ std::vector<std::shared_ptr<world::Fix>> FixLoader::loadAll(const std::vector<in
         auto r = loadMgr->getRegion(region);
         world::Location loc(laty, lonx);
         fixes[id] = std::make_shared<world::Fix>(r, ident, loc);
+        fixes[id]->setGraphIndex(id);
     }
 
     // now create an ordered vector matching the request
@@ -131,13 +138,18 @@ std::vector<std::shared_ptr<world::Fix>> FixLoader::loadAll(const std::vector<in
 
 void FixLoader::addNDB(int id)
 {
-    auto qry = loadMgr->GetSQL(SqlLoadManager::Searches::NDB_BY_ID, isBackgroundLoad);
+    auto qry = loadMgr->GetSQL(SqlLoadManager::Searches::NDB_BY_ID);
     qry->initialize();
     qry->bind(1, id);
     if (qry->step()) return;
-    auto name = qry->getString(0);
-    auto freq = qry->getInt(1);
-    auto range = qry->getInt(2);
+    addNDB(*qry, 0);
+}
+
+void FixLoader::addNDB(SqlStatement &q, int col)
+{
+    auto name = q.getString(col + 0);
+    auto freq = q.getInt(col + 1);
+    auto range = q.getInt(col + 2);
 
     world::Frequency ndbFrq = world::Frequency(freq, 0, world::Frequency::Unit::KHZ, name);
     auto ndb = std::make_shared<world::NDB>(ndbFrq, range);
@@ -146,16 +158,21 @@ void FixLoader::addNDB(int id)
 
 void FixLoader::addVORDME(int id)
 {
-    auto qry = loadMgr->GetSQL(SqlLoadManager::Searches::VOR_BY_ID, isBackgroundLoad);
+    auto qry = loadMgr->GetSQL(SqlLoadManager::Searches::VOR_BY_ID);
     qry->initialize();
     qry->bind(1, id);
     if (qry->step()) return;
-    auto name = qry->getString(0);
-    auto type = qry->getString(1);
-    auto freq = qry->getInt(2);
-    auto range = qry->getInt(3);
-    auto mag_var = qry->getFloat(4);
-    auto dme_only = qry->getBool(5);
+    addVORDME(*qry, 0);
+}
+
+void FixLoader::addVORDME(SqlStatement &q, int col)
+{
+    auto name = q.getString(col + 0);
+    auto type = q.getString(col + 1);
+    auto freq = q.getInt(col + 2);
+    auto range = q.getInt(col + 3);
+    auto mag_var = q.getFloat(col + 4);
+    auto dme_only = q.getBool(col + 5);
 
     world::Frequency frequency = world::Frequency(freq, 2, world::Frequency::Unit::MHZ, name);
     if (!dme_only) {
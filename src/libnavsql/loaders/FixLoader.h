@@ -23,6 +23,7 @@ namespace sqlnav {
 
 class SqlLoadManager;
 class SqlWorld;
+class SqlStatement;
 
 class FixLoader
 {
@@ -39,13 +40,18 @@ public:
     std::shared_ptr<world::Fix> load();
     std::vector<std::shared_ptr<world::Fix>> loadAll(const std::vector<int> fixKeys);
 
+    // Used by the AreaLoader to build fixes from the rows of its area queries,
+    // the columns are the same as those of the per-fix queries starting at col
+    std::shared_ptr<world::Fix> createFix(SqlStatement &q, int col);
+    void addNDB(SqlStatement &q, int col);
+    void addVORDME(SqlStatement &q, int col);
+
 private:
     void addNDB(int navid);
     void addVORDME(int navid);
 
 private:
     std::shared_ptr<SqlLoadManager> loadMgr;
-    bool const isBackgroundLoad;
     int const id;
     const std::string * const region;
     const std::string * const ident;
@@ -0,0 +1,87 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include "src/world/models/airport/Airport.h"
+
+// The codes of the NAV database tables, shared by the loaders and the tools that convert the database
+namespace sqlnav {
+
+inline world::Airport::ATCFrequency mapToATCclass(const std::string &type) {
+    // LNM populates its MSFS DB with these comms tags: A C D G T UC MC CPT CTR FSS RCD ATIS ASOS AWOS CTAF
+    if (type.size() == 1) {
+        switch (type[0]) {
+            case 'A': return world::Airport::ATCFrequency::APP;
+            case 'C': return world::Airport::ATCFrequency::CLD;
+            case 'D': return world::Airport::ATCFrequency::DEP;
+            case 'G': return world::Airport::ATCFrequency::GND;
+            case 'T': return world::Airport::ATCFrequency::TWR;
+            default:  return world::Airport::ATCFrequency::RECORDED;
+        };
+    }
+    if (type.size() == 2) {
+        switch (type[0]) {
+            case 'U': return world::Airport::ATCFrequency::UNICOM;
+            case 'M': return world::Airport::ATCFrequency::MULTICOM;
+            default:  return world::Airport::ATCFrequency::RECORDED;
+        };
+    }
+    if (type.size() == 3) {
+        switch (type[1]) {
+            case 'P': return world::Airport::ATCFrequency::CLD;         // CPT
+            case 'T': return world::Airport::ATCFrequency::CTR;         // CTR
+            case 'S': return world::Airport::ATCFrequency::FSS;         // FSS
+            default:  return world::Airport::ATCFrequency::RECORDED;
+        };
+    }
+    return world::Airport::ATCFrequency::RECORDED;
+}
+
+inline world::Runway::SurfaceMaterial mapToSurfaceMaterial(const std::string &rwy) {
+    // LNM populates its MSFS DB with these surface tags: A B C CE CR D G GR I M OT S SN T UNKNOWN W
+    if (rwy.size() == 1) {
+        switch (rwy[0]) {
+            case 'A': return world::Runway::SurfaceMaterial::ASPHALT;
+            case 'B': return world::Runway::SurfaceMaterial::BITUMINOUS;
+            case 'D': return world::Runway::SurfaceMaterial::DIRT;
+            case 'G': return world::Runway::SurfaceMaterial::GRASS;
+            case 'I': return world::Runway::SurfaceMaterial::ICE;
+            case 'M': return world::Runway::SurfaceMaterial::TARMAC;
+            case 'S': return world::Runway::SurfaceMaterial::SAND;
+            case 'T': return world::Runway::SurfaceMaterial::TARMAC;
+            case 'W': return world::Runway::SurfaceMaterial::WATER;
+            default:  return world::Runway::SurfaceMaterial::UNKNOWN;
+        };
+    }
+    if (rwy.size() >= 2) {
+        switch (rwy[0]) {
+            case 'C': switch (rwy[1]) {
+                case 'E': return world::Runway::SurfaceMaterial::CONCRETE;
+                case 'R': return world::Runway::SurfaceMaterial::CORAL;
+                default:  return world::Runway::SurfaceMaterial::UNKNOWN;
+            }
+            case 'G': return world::Runway::SurfaceMaterial::GRAVEL;
+            case 'S': return world::Runway::SurfaceMaterial::SNOW;
+            default:  return world::Runway::SurfaceMaterial::UNKNOWN;
+        }
+    }
+    return world::Runway::SurfaceMaterial::UNKNOWN;
+}
+
+} /* namespace sqlnav */
@@ -20,8 +20,8 @@
 
 namespace sqlnav {
 
-SqlApproach::SqlApproach(std::string name, std::shared_ptr<SqlLoadManager> db)
-:   world::Approach(name), SqlProcedure(name, db)
+SqlApproach::SqlApproach(std::string name, int airportId, std::shared_ptr<SqlLoadManager> db)
+:   world::Approach(name), SqlProcedure(name, airportId, db)
 {
 }
 
@@ -36,6 +36,11 @@ void SqlApproach::insertTransition(std::vector<int> &fixes, const std::vector<in
     fixes.insert(fixes.begin(), trfixes.begin(), trfixes.end());
 }
 
+std::vector<world::NavNodeList> SqlApproach::getPaths() const
+{
+    return getVariantPaths();
+}
+
 std::string SqlApproach::toDebugString() const
 {
     return std::string();
@@ -25,11 +25,12 @@ namespace sqlnav {
 class SqlApproach : public world::Approach, public SqlProcedure
 {
 public:
-    SqlApproach(std::string name, std::shared_ptr<SqlLoadManager> db);
+    SqlApproach(std::string name, int airportId, std::shared_ptr<SqlLoadManager> db);
 
     world::NavNodeList getWaypoints(std::shared_ptr<world::Runway> arrivalRwy, std::string apprTransName) const override;
     void insertTransition(std::vector<int> &fixes, const std::vector<int> &trfixes) const override;
 
+    std::vector<world::NavNodeList> getPaths() const override;
     std::string toDebugString() const override;
 
 };
@@ -22,8 +22,8 @@
 
 namespace sqlnav {
 
-SqlProcedure::SqlProcedure(std::string n, std::shared_ptr<SqlLoadManager> db)
-:   name(n), loadMgr(db)
+SqlProcedure::SqlProcedure(std::string n, int airportId, std::shared_ptr<SqlLoadManager> db)
+:   name(n), airportId(airportId), loadMgr(db)
 {
 }
 
@@ -36,6 +36,28 @@ void SqlProcedure::addVariant(int pid, std::string runway, std::vector<int> fixe
     variants.push_back(v);
 }
 
+std::vector<int> SqlProcedure::getEntryFixes() const
+{
+    std::vector<int> res;
+    for (auto &v: variants) {
+        if (!v.fixes.empty() && (std::find(res.begin(), res.end(), v.fixes.front()) == res.end())) {
+            res.push_back(v.fixes.front());
+        }
+    }
+    return res;
+}
+
+std::vector<int> SqlProcedure::getExitFixes() const
+{
+    std::vector<int> res;
+    for (auto &v: variants) {
+        if (!v.fixes.empty() && (std::find(res.begin(), res.end(), v.fixes.back()) == res.end())) {
+            res.push_back(v.fixes.back());
+        }
+    }
+    return res;
+}
+
 world::NavNodeList SqlProcedure::getWaypoints(std::string runway, std::string transition) const
 {
     // a named procedure might have multiple variants. commonly these will be distinguished by
@@ -54,35 +76,47 @@ world::NavNodeList SqlProcedure::getWaypoints(std::string runway, std::string tr
         return world::NavNodeList();
     }
 
-    // get the transition fixes
-    int selectedPid = pids.front(); // default to using the first variant
-    auto tfixes = loadMgr->getTransitionFixes(transition, pids, selectedPid);
+    // the first variant's row ID tells the procedures of an airport apart
+    std::string key = std::to_string(variants.front().procId) + '/' + runway + '/' + transition;
+    return loadMgr->getProcedureRoute(airportId, key, [this, &pids, &transition] {
+        // get the transition fixes
+        int selectedPid = pids.front(); // default to using the first variant
+        auto tfixes = loadMgr->getTransitionFixes(airportId, transition, pids, selectedPid);
 
-    // get the procedure fixes for the transition that was selected
-    std::vector<int> fxs;
-    for (auto &v: variants) {
-        if (v.procId == selectedPid) {
-            fxs = v.fixes;
+        // get the procedure fixes for the transition that was selected
+        std::vector<int> fxs;
+        for (auto &v: variants) {
+            if (v.procId == selectedPid) {
+                fxs = v.fixes;
+            }
         }
-    }
 
-    // combine variant and transition
-    insertTransition(fxs, tfixes);
-    if (fxs.empty()) {
-        return world::NavNodeList();
-    }
+        // combine variant and transition
+        insertTransition(fxs, tfixes);
+        if (fxs.empty()) {
+            return world::NavNodeList();
+        }
 
-    // remove duplicates
-    std::vector<int> clean;
-    clean.push_back(fxs.front());
-    for (auto f: fxs) {
-        if (f != clean.back()) {
-            clean.push_back(f);
+        // remove duplicates
+        std::vector<int> clean;
+        clean.push_back(fxs.front());
+        for (auto f: fxs) {
+            if (f != clean.back()) {
+                clean.push_back(f);
+            }
         }
-    }
 
-    return loadMgr->getFixList(clean);
+        return loadMgr->getFixList(clean);
+    });
 }
 
+std::vector<world::NavNodeList> SqlProcedure::getVariantPaths() const
+{
+    std::vector<world::NavNodeList> paths;
+    for (auto &v: variants) {
+        paths.push_back(loadMgr->getFixList(v.fixes));
+    }
+    return paths;
+}
 
 } /* namespace sqlnav */
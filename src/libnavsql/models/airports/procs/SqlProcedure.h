@@ -28,16 +28,22 @@ class SqlLoadManager;
 class SqlProcedure
 {
 public:
-    SqlProcedure(std::string name, std::shared_ptr<SqlLoadManager> db);
+    SqlProcedure(std::string name, int airportId, std::shared_ptr<SqlLoadManager> db);
 
     void addVariant(int id, std::string runway, std::vector<int> fixes);
 
+    // the first and last fix of each variant, where the procedure joins the airway network
+    std::vector<int> getEntryFixes() const;
+    std::vector<int> getExitFixes() const;
+
 protected:
     world::NavNodeList getWaypoints(std::string runway, std::string transition) const;
+    std::vector<world::NavNodeList> getVariantPaths() const;
     virtual void insertTransition(std::vector<int> &fixes, const std::vector<int> &trfixes) const = 0;
 
 private:
     std::string name;
+    int airportId;
     std::shared_ptr<SqlLoadManager> loadMgr;
 
 private:
@@ -20,8 +20,8 @@
 
 namespace sqlnav {
 
-SqlSID::SqlSID(std::string name, std::shared_ptr<SqlLoadManager> db)
-:   world::SID(name), SqlProcedure(name, db)
+SqlSID::SqlSID(std::string name, int airportId, std::shared_ptr<SqlLoadManager> db)
+:   world::SID(name), SqlProcedure(name, airportId, db)
 {
 }
 
@@ -36,6 +36,11 @@ void SqlSID::insertTransition(std::vector<int> &fixes, const std::vector<int> &t
     fixes.insert(fixes.end(), trfixes.begin(), trfixes.end());
 }
 
+std::vector<world::NavNodeList> SqlSID::getPaths() const
+{
+    return getVariantPaths();
+}
+
 std::string SqlSID::toDebugString() const
 {
     return std::string();
@@ -25,11 +25,12 @@ namespace sqlnav {
 class SqlSID : public world::SID, public SqlProcedure
 {
 public:
-    SqlSID(std::string name, std::shared_ptr<SqlLoadManager> db);
+    SqlSID(std::string name, int airportId, std::shared_ptr<SqlLoadManager> db);
 
     world::NavNodeList getWaypoints(std::shared_ptr<world::Runway> departureRwy, std::string sidTransName) const override;
     void insertTransition(std::vector<int> &fixes, const std::vector<int> &trfixes) const override;
 
+    std::vector<world::NavNodeList> getPaths() const override;
     std::string toDebugString() const override;
 
 };
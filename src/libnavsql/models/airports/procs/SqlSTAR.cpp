@@ -20,8 +20,8 @@
 
 namespace sqlnav {
 
-SqlSTAR::SqlSTAR(std::string name, std::shared_ptr<SqlLoadManager> db)
-:   world::STAR(name), SqlProcedure(name, db)
+SqlSTAR::SqlSTAR(std::string name, int airportId, std::shared_ptr<SqlLoadManager> db)
+:   world::STAR(name), SqlProcedure(name, airportId, db)
 {
 }
 
@@ -36,6 +36,11 @@ void SqlSTAR::insertTransition(std::vector<int> &fixes, const std::vector<int> &
     fixes.insert(fixes.begin(), trfixes.begin(), trfixes.end());
 }
 
+std::vector<world::NavNodeList> SqlSTAR::getPaths() const
+{
+    return getVariantPaths();
+}
+
 std::string SqlSTAR::toDebugString() const
 {
     return std::string();
@@ -25,11 +25,12 @@ namespace sqlnav {
 class SqlSTAR : public world::STAR, public SqlProcedure
 {
 public:
-    SqlSTAR(std::string name, std::shared_ptr<SqlLoadManager> db);
+    SqlSTAR(std::string name, int airportId, std::shared_ptr<SqlLoadManager> db);
 
     world::NavNodeList getWaypoints(std::shared_ptr<world::Runway> arrivalRwy, std::string starTransName) const override;
     void insertTransition(std::vector<int> &fixes, const std::vector<int> &trfixes) const override;
 
+    std::vector<world::NavNodeList> getPaths() const override;
     std::string toDebugString() const override;
 
 };
@@ -0,0 +1,105 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "MetarUpdater.h"
+#include "src/platform/Platform.h"
+#include "src/platform/CrashHandler.h"
+#include "src/Logger.h"
+
+namespace xdata {
+
+MetarUpdater::MetarUpdater(std::shared_ptr<XWorld> world, const std::string &metarFile):
+    world(world),
+    metarFile(metarFile)
+{
+}
+
+MetarUpdater::~MetarUpdater() {
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        stopRequested = true;
+        control.notify_one();
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void MetarUpdater::update() {
+    std::lock_guard<std::mutex> lock(updateMutex);
+
+    std::error_code ec;
+    auto path = fs::u8path(metarFile);
+    auto size = fs::file_size(path, ec);
+    if (ec) {
+        // metar is optional
+        return;
+    }
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return;
+    }
+    int64_t modified = static_cast<int64_t>(mtime.time_since_epoch().count());
+    if (modified == lastModified && size == lastSize) {
+        return;
+    }
+
+    try {
+        auto startAt = std::chrono::steady_clock::now();
+        MetarLoader loader(world, [this] { return stopRequested.load(); });
+        size_t updated = loader.load(metarFile, records);
+        lastModified = modified;
+        lastSize = size;
+
+        auto duration = std::chrono::steady_clock::now() - startAt;
+        logger::verbose("Updated METAR of %d airports in %d millis", (int) updated,
+            (int) std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+    } catch (const std::exception &e) {
+        // keep the old modification time so the next check tries again
+        logger::warn("Error parsing METAR: %s", e.what());
+    }
+}
+
+void MetarUpdater::start() {
+    if (!worker.joinable()) {
+        worker = std::thread(&MetarUpdater::run, this);
+    }
+}
+
+void MetarUpdater::requestUpdate() {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    updateRequested = true;
+    control.notify_one();
+}
+
+void MetarUpdater::run() {
+    crash::ThreadCookie crashCookie;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(controlMutex);
+            control.wait_for(lock, POLL_INTERVAL, [this] { return updateRequested || stopRequested; });
+            if (stopRequested) {
+                break;
+            }
+            updateRequested = false;
+        }
+        update();
+    }
+}
+
+} /* namespace xdata */
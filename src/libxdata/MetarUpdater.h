@@ -0,0 +1,73 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "XWorld.h"
+#include "loaders/MetarLoader.h"
+
+namespace xdata {
+
+/*
+ * Keeps the METARs of the airports in sync with METAR.rwx.
+ * A worker checks the modification time of the file periodically or when
+ * asked to, and only re-reads it when it changed. Records that are the same
+ * as last time are skipped, so only airports with a new report are touched.
+ */
+class MetarUpdater {
+public:
+    MetarUpdater(std::shared_ptr<XWorld> world, const std::string &metarFile);
+    ~MetarUpdater();
+
+    // Applies a changed file on the calling thread, used for the initial load
+    void update();
+
+    // Starts the worker that watches the file
+    void start();
+
+    // Returns immediately, the worker checks the file as soon as possible
+    void requestUpdate();
+
+private:
+    static constexpr const auto POLL_INTERVAL = std::chrono::seconds(30);
+
+    std::shared_ptr<XWorld> world;
+    std::string metarFile;
+
+    std::mutex updateMutex;
+    MetarRecords records;
+    int64_t lastModified = 0;
+    uintmax_t lastSize = 0;
+
+    std::mutex controlMutex;
+    std::condition_variable control;
+    bool updateRequested = false;
+    std::atomic_bool stopRequested { false };
+    std::thread worker;
+
+    void run();
+};
+
+} /* namespace xdata */
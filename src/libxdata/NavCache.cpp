@@ -0,0 +1,505 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <map>
+#include "NavCache.h"
+
+namespace xdata {
+namespace navcache {
+
+namespace {
+
+constexpr const char MAGIC[8] = {'A', 'V', 'N', 'A', 'V', 'C', 'C', '\0'};
+constexpr const char END_MAGIC[8] = {'A', 'V', 'N', 'A', 'V', 'E', 'N', 'D'};
+
+// bump whenever one of the parser data structures changes
+constexpr uint32_t FORMAT_VERSION = 2;
+
+// records in the procedure section, the end record has no airport
+constexpr uint8_t PROCEDURES_NEXT = 1;
+constexpr uint8_t PROCEDURES_END = 0;
+
+// The snapshot is a local cache, so values are stored in native byte order.
+struct Output {
+    fs::ofstream &out;
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type put(T value) {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void put(const std::string &str) {
+        put(static_cast<uint32_t>(str.size()));
+        out.write(str.data(), str.size());
+    }
+
+    template<typename T>
+    void put(const std::vector<T> &vec) {
+        put(static_cast<uint32_t>(vec.size()));
+        for (auto &entry: vec) {
+            put(entry);
+        }
+    }
+
+    template<typename T>
+    void put(const std::map<std::string, T> &map) {
+        put(static_cast<uint32_t>(map.size()));
+        for (auto &entry: map) {
+            put(entry.first);
+            put(entry.second);
+        }
+    }
+
+    void put(const SourceFile &src) {
+        put(src.path);
+        put(src.size);
+        put(src.mtime);
+    }
+
+    void put(const AirportData::Frequency &frq) {
+        put(frq.code);
+        put(frq.desc);
+        put(frq.frq);
+    }
+
+    void put(const AirportData::RunwayEnd &end) {
+        put(end.name);
+        put(end.latitude);
+        put(end.longitude);
+        put(end.displace);
+    }
+
+    void put(const AirportData::RunwayData &rwy) {
+        put(rwy.width);
+        put(rwy.surfaceTypeCode);
+        put(rwy.ends);
+    }
+
+    void put(const AirportData::HeliportData &heli) {
+        put(heli.name);
+        put(heli.latitude);
+        put(heli.longitude);
+        put(heli.surfaceTypeCode);
+    }
+
+    void put(const AirportData &port) {
+        put(port.id);
+        put(port.name);
+        put(port.elevation);
+        put(port.icaoCode);
+        put(port.latitude);
+        put(port.longitude);
+        put(port.region);
+        put(port.country);
+        put(port.frequencies);
+        put(port.runways);
+        put(port.heliports);
+    }
+
+    void put(const FixData &fix) {
+        put(fix.id);
+        put(fix.latitude);
+        put(fix.longitude);
+        put(fix.terminalAreaId);
+        put(fix.icaoRegion);
+        put(fix.col27);
+        put(fix.col28);
+        put(fix.col29);
+    }
+
+    void put(const NavaidData &nav) {
+        put(nav.type);
+        put(nav.latitude);
+        put(nav.longitude);
+        put(nav.elevation);
+        put(nav.radio);
+        put(nav.range);
+        put(nav.bearing);
+        put(nav.bearingMagnetic);
+        put(nav.id);
+        put(nav.terminalRegion);
+        put(nav.icaoRegion);
+        put(nav.name);
+    }
+
+    void put(const AirwayData &awy) {
+        put(awy.beginID);
+        put(awy.beginIcaoRegion);
+        put(awy.beginType);
+        put(awy.endID);
+        put(awy.endIcaoRegion);
+        put(awy.endType);
+        put(awy.dirRestriction);
+        put(awy.level);
+        put(awy.base);
+        put(awy.top);
+        put(awy.name);
+    }
+
+    void put(const CIFPData::FixInRegion &fix) {
+        put(fix.id);
+        put(fix.region);
+        put(fix.sectionCode);
+        put(fix.subSectionCode);
+    }
+
+    void put(const CIFPData::RunwayTransition &t) { put(t.fixes); }
+    void put(const CIFPData::CommonRoute &t) { put(t.fixes); }
+    void put(const CIFPData::EnrouteTransition &t) { put(t.fixes); }
+    void put(const CIFPData::ApproachTransition &t) { put(t.fixes); }
+
+    void put(const CIFPData &proc) {
+        put(proc.type);
+        put(proc.id);
+        put(proc.runwayTransitions);
+        put(proc.commonRoutes);
+        put(proc.enrouteTransitions);
+        put(proc.approachTransitions);
+        put(proc.approach);
+        put(proc.rwyInfo.elevation);
+        put(proc.rwyInfo.ilsCategory);
+    }
+};
+
+struct Input {
+    const char *&pos;
+    const char *end;
+
+    void need(size_t n) {
+        if (static_cast<size_t>(end - pos) < n) {
+            throw std::runtime_error("Truncated nav cache");
+        }
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type get(T &value) {
+        need(sizeof(value));
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+    }
+
+    uint32_t getCount() {
+        uint32_t n;
+        get(n);
+        // every element takes at least one byte, so this catches garbage early
+        need(n);
+        return n;
+    }
+
+    void get(std::string &str) {
+        uint32_t len;
+        get(len);
+        need(len);
+        str.assign(pos, len);
+        pos += len;
+    }
+
+    template<typename T>
+    void get(std::vector<T> &vec) {
+        uint32_t n = getCount();
+        vec.clear();
+        vec.resize(n);
+        for (auto &entry: vec) {
+            get(entry);
+        }
+    }
+
+    template<typename T>
+    void get(std::map<std::string, T> &map) {
+        uint32_t n = getCount();
+        map.clear();
+        for (uint32_t i = 0; i < n; ++i) {
+            std::string key;
+            get(key);
+            get(map[key]);
+        }
+    }
+
+    void get(SourceFile &src) {
+        get(src.path);
+        get(src.size);
+        get(src.mtime);
+    }
+
+    void get(AirportData::Frequency &frq) {
+        get(frq.code);
+        get(frq.desc);
+        get(frq.frq);
+    }
+
+    void get(AirportData::RunwayEnd &end) {
+        get(end.name);
+        get(end.latitude);
+        get(end.longitude);
+        get(end.displace);
+    }
+
+    void get(AirportData::RunwayData &rwy) {
+        get(rwy.width);
+        get(rwy.surfaceTypeCode);
+        get(rwy.ends);
+    }
+
+    void get(AirportData::HeliportData &heli) {
+        get(heli.name);
+        get(heli.latitude);
+        get(heli.longitude);
+        get(heli.surfaceTypeCode);
+    }
+
+    void get(AirportData &port) {
+        get(port.id);
+        get(port.name);
+        get(port.elevation);
+        get(port.icaoCode);
+        get(port.latitude);
+        get(port.longitude);
+        get(port.region);
+        get(port.country);
+        get(port.frequencies);
+        get(port.runways);
+        get(port.heliports);
+    }
+
+    void get(FixData &fix) {
+        get(fix.id);
+        get(fix.latitude);
+        get(fix.longitude);
+        get(fix.terminalAreaId);
+        get(fix.icaoRegion);
+        get(fix.col27);
+        get(fix.col28);
+        get(fix.col29);
+    }
+
+    void get(NavaidData &nav) {
+        get(nav.type);
+        get(nav.latitude);
+        get(nav.longitude);
+        get(nav.elevation);
+        get(nav.radio);
+        get(nav.range);
+        get(nav.bearing);
+        get(nav.bearingMagnetic);
+        get(nav.id);
+        get(nav.terminalRegion);
+        get(nav.icaoRegion);
+        get(nav.name);
+    }
+
+    void get(AirwayData &awy) {
+        get(awy.beginID);
+        get(awy.beginIcaoRegion);
+        get(awy.beginType);
+        get(awy.endID);
+        get(awy.endIcaoRegion);
+        get(awy.endType);
+        get(awy.dirRestriction);
+        get(awy.level);
+        get(awy.base);
+        get(awy.top);
+        get(awy.name);
+    }
+
+    void get(CIFPData::FixInRegion &fix) {
+        get(fix.id);
+        get(fix.region);
+        get(fix.sectionCode);
+        get(fix.subSectionCode);
+    }
+
+    void get(CIFPData::RunwayTransition &t) { get(t.fixes); }
+    void get(CIFPData::CommonRoute &t) { get(t.fixes); }
+    void get(CIFPData::EnrouteTransition &t) { get(t.fixes); }
+    void get(CIFPData::ApproachTransition &t) { get(t.fixes); }
+
+    void get(CIFPData &proc) {
+        get(proc.type);
+        get(proc.id);
+        get(proc.runwayTransitions);
+        get(proc.commonRoutes);
+        get(proc.enrouteTransitions);
+        get(proc.approachTransitions);
+        get(proc.approach);
+        get(proc.rwyInfo.elevation);
+        get(proc.rwyInfo.ilsCategory);
+    }
+};
+
+}
+
+bool SourceFile::operator==(const SourceFile &other) const {
+    return path == other.path && size == other.size && mtime == other.mtime;
+}
+
+SourceFile describeFile(const std::string &utf8Path) {
+    SourceFile src;
+    src.path = utf8Path;
+
+    std::error_code ec;
+    auto path = fs::u8path(utf8Path);
+    auto size = fs::file_size(path, ec);
+    if (ec) {
+        return src;
+    }
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return src;
+    }
+    src.size = size;
+    src.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    return src;
+}
+
+std::string getSnapshotName(const std::string &utf8Path) {
+    // FNV-1a, unlike std::hash it doesn't change between builds
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c: utf8Path) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+
+    static const char *hex = "0123456789abcdef";
+    std::string name(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        name[i] = hex[hash & 0xF];
+        hash >>= 4;
+    }
+    return name + ".bin";
+}
+
+Writer::Writer(const std::string &utf8Path, const Sources &sources):
+    path(utf8Path),
+    tmpPath(platform::makeTempPath(utf8Path))
+{
+    out.open(fs::u8path(tmpPath), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Couldn't create nav cache " + tmpPath);
+    }
+
+    Output o{out};
+    out.write(MAGIC, sizeof(MAGIC));
+    o.put(FORMAT_VERSION);
+    o.put(sources);
+}
+
+Writer::~Writer() {
+    if (!committed) {
+        out.close();
+        std::error_code ec;
+        fs::remove(fs::u8path(tmpPath), ec);
+    }
+}
+
+void Writer::write(const std::vector<AirportData> &airports) {
+    Output{out}.put(airports);
+}
+
+void Writer::write(const std::vector<FixData> &fixes) {
+    Output{out}.put(fixes);
+}
+
+void Writer::write(const std::vector<NavaidData> &navaids) {
+    Output{out}.put(navaids);
+}
+
+void Writer::write(const std::vector<AirwayData> &airways) {
+    Output{out}.put(airways);
+}
+
+void Writer::writeProcedures(const std::string &airportId, const std::vector<CIFPData> &procedures) {
+    Output o{out};
+    o.put(PROCEDURES_NEXT);
+    o.put(airportId);
+    o.put(procedures);
+}
+
+void Writer::commit() {
+    Output o{out};
+    o.put(PROCEDURES_END);
+    out.write(END_MAGIC, sizeof(END_MAGIC));
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Couldn't write nav cache " + tmpPath);
+    }
+
+    fs::rename(fs::u8path(tmpPath), fs::u8path(path));
+    committed = true;
+}
+
+Reader::Reader(const std::string &utf8Path, const Sources &sources):
+    file(std::make_unique<platform::MappedFile>(utf8Path))
+{
+    pos = file->data();
+    end = pos + file->size();
+
+    // the end marker is written last, so its presence means the file is complete
+    if (file->size() < sizeof(MAGIC) + sizeof(END_MAGIC) ||
+        std::memcmp(pos, MAGIC, sizeof(MAGIC)) != 0 ||
+        std::memcmp(end - sizeof(END_MAGIC), END_MAGIC, sizeof(END_MAGIC)) != 0) {
+        throw std::runtime_error("Incomplete nav cache");
+    }
+    pos += sizeof(MAGIC);
+    end -= sizeof(END_MAGIC);
+
+    Input in{pos, end};
+    uint32_t version;
+    in.get(version);
+    if (version != FORMAT_VERSION) {
+        throw std::runtime_error("Nav cache has an old format");
+    }
+
+    Sources cached;
+    in.get(cached);
+    if (cached != sources) {
+        throw std::runtime_error("Nav data changed since the cache was written");
+    }
+}
+
+void Reader::read(std::vector<AirportData> &airports) {
+    Input{pos, end}.get(airports);
+}
+
+void Reader::read(std::vector<FixData> &fixes) {
+    Input{pos, end}.get(fixes);
+}
+
+void Reader::read(std::vector<NavaidData> &navaids) {
+    Input{pos, end}.get(navaids);
+}
+
+void Reader::read(std::vector<AirwayData> &airways) {
+    Input{pos, end}.get(airways);
+}
+
+bool Reader::readProcedures(std::string &airportId, std::vector<CIFPData> &procedures) {
+    Input in{pos, end};
+    uint8_t record;
+    in.get(record);
+    if (record == PROCEDURES_END) {
+        return false;
+    }
+    in.get(airportId);
+    in.get(procedures);
+    return true;
+}
+
+} /* namespace navcache */
+} /* namespace xdata */
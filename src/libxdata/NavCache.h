@@ -0,0 +1,93 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
+#include "parsers/objects/AirportData.h"
+#include "parsers/objects/FixData.h"
+#include "parsers/objects/NavaidData.h"
+#include "parsers/objects/AirwayData.h"
+#include "parsers/objects/CIFPData.h"
+
+namespace xdata {
+
+// Binary snapshot of the parsed nav data files. A snapshot is only used if
+// all of its source files still have the same size and modification time,
+// otherwise the text files are parsed again and a new snapshot is written.
+namespace navcache {
+
+struct SourceFile {
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    bool operator==(const SourceFile &other) const;
+};
+
+using Sources = std::vector<SourceFile>;
+
+// Missing files are recorded with size 0 so that adding them later is noticed
+SourceFile describeFile(const std::string &utf8Path);
+
+// Stable file name for a snapshot that belongs to a single source file
+std::string getSnapshotName(const std::string &utf8Path);
+
+class Writer {
+public:
+    // Writes to a temporary file that replaces the snapshot in commit()
+    Writer(const std::string &utf8Path, const Sources &sources);
+    ~Writer();
+
+    void write(const std::vector<AirportData> &airports);
+    void write(const std::vector<FixData> &fixes);
+    void write(const std::vector<NavaidData> &navaids);
+    void write(const std::vector<AirwayData> &airways);
+    void writeProcedures(const std::string &airportId, const std::vector<CIFPData> &procedures);
+    void commit();
+
+private:
+    std::string path, tmpPath;
+    fs::ofstream out;
+    bool committed = false;
+};
+
+class Reader {
+public:
+    // Throws if the snapshot is missing, incomplete or built from other sources
+    Reader(const std::string &utf8Path, const Sources &sources);
+
+    void read(std::vector<AirportData> &airports);
+    void read(std::vector<FixData> &fixes);
+    void read(std::vector<NavaidData> &navaids);
+    void read(std::vector<AirwayData> &airways);
+    // Returns false after the last airport
+    bool readProcedures(std::string &airportId, std::vector<CIFPData> &procedures);
+
+private:
+    std::unique_ptr<platform::MappedFile> file;
+    const char *pos = nullptr;
+    const char *end = nullptr;
+};
+
+} /* namespace navcache */
+} /* namespace xdata */
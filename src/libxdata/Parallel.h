@@ -0,0 +1,90 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <vector>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include "src/platform/CrashHandler.h"
+
+namespace xdata {
+
+// Number of workers used for the parse stages of the nav data load
+inline size_t getParseConcurrency() {
+    size_t n = std::thread::hardware_concurrency();
+    return std::max<size_t>(1, std::min<size_t>(n, 16));
+}
+
+// Calls fn(i) for i in [0, count) on up to `workers` threads and returns the
+// results in index order, so callers can merge them deterministically.
+// The first exception thrown by fn stops the remaining work and is rethrown.
+template<typename T, typename F>
+std::vector<T> parallelMap(size_t count, size_t workers, F fn) {
+    std::vector<T> results(count);
+    workers = std::min(workers, count);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            results[i] = fn(i);
+        }
+        return results;
+    }
+
+    std::atomic_size_t next { 0 };
+    std::atomic_bool failed { false };
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto work = [&] () {
+        crash::ThreadCookie crashCookie;
+        while (!failed) {
+            size_t i = next++;
+            if (i >= count) {
+                break;
+            }
+            try {
+                results[i] = fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::future<void>> tasks;
+    for (size_t w = 1; w < workers; ++w) {
+        tasks.push_back(std::async(std::launch::async, work));
+    }
+    work();
+    for (auto &task: tasks) {
+        task.wait();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return results;
+}
+
+} /* namespace xdata */
@@ -17,14 +17,18 @@
  */
 #include <chrono>
 #include <thread>
+#include <future>
+#include <mutex>
 
 #include "XData.h"
 #include "loaders/FixLoader.h"
 #include "loaders/NavaidLoader.h"
 #include "loaders/AirwayLoader.h"
 #include "loaders/CIFPLoader.h"
-#include "loaders/MetarLoader.h"
 #include "parsers/CustomSceneryParser.h"
+#include "Parallel.h"
+#include "NavCache.h"
+#include "src/platform/CrashHandler.h"
 #include "src/Logger.h"
 
 namespace xdata {
@@ -68,109 +72,484 @@ void XData::discoverSceneries() {
     }
 }
 
+std::vector<std::string> XData::getSourceFiles() {
+    // the METAR and user fixes are loaded again anyway
+    std::vector<std::string> files;
+    files.push_back(xplaneRoot + "Custom Scenery/scenery_packs.ini");
+    files.push_back(xplaneRoot + "Custom Data/earth_nav.dat");
+    files.push_back(findDefaultAirportFile());
+    files.push_back(navDataPath + "earth_fix.dat");
+    files.push_back(navDataPath + "earth_nav.dat");
+    files.push_back(navDataPath + "earth_awy.dat");
+    files.insert(files.end(), customSceneries.begin(), customSceneries.end());
+    // lazy procedures are read later, but the airports that have them are found now
+    for (auto &id: scanProcedureFiles()) {
+        files.push_back(navDataPath + "CIFP/" + id + ".dat");
+    }
+    return files;
+}
+
 std::shared_ptr<world::World> XData::getWorld() {
     return xworld;
 }
 
+static uint64_t getFileSize(const std::string &path) {
+    return navcache::describeFile(path).size;
+}
+
 void XData::load() {
     auto startAt = std::chrono::steady_clock::now();
-    logger::verbose("Loading airports...");
-    loadAirports();
-    logger::verbose("Loading fixes...");
-    loadFixes();
-    logger::verbose("Loading navaids...");
-    loadNavaids();
-    logger::verbose("Loading airways...");
-    loadAirways();
-    logger::verbose("Loading CIFP...");
-    loadProcedures();
-    logger::verbose("Attempting to load user fixes...");
+
+    beginPhase("CIFP index");
+    auto cifpIds = scanProcedureFiles();
+    auto sources = describeSources(cifpIds);
+    endPhase(cifpIds.size());
+
+    bool loaded = false;
+    auto snapshot = openSnapshot(sources);
+    if (snapshot) {
+        beginPhase("snapshot");
+        try {
+            size_t records = loadSnapshot(*snapshot, getParseConcurrency(), cifpIds);
+            endPhase(records, getFileSize(getSnapshotPath()));
+            loaded = true;
+        } catch (const std::exception &e) {
+            if (shouldCancelLoading()) {
+                throw;
+            }
+            // discard whatever was linked before the snapshot turned out broken
+            logger::warn("Couldn't load nav data snapshot, parsing files: %s", e.what());
+            xworld = std::make_shared<xdata::XWorld>();
+        }
+    }
+
+    if (!loaded) {
+        parseNavData(getParseConcurrency(), cifpIds, sources);
+    }
+    pruneScenerySnapshots();
+
+    beginPhase("user fixes");
     loadUserFixes();
-    auto duration = std::chrono::steady_clock::now() - startAt;
-    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    endPhase(0, userFixesFilename.empty() ? 0 : getFileSize(userFixesFilename));
 
+    beginPhase("METAR");
     loadMetar();
+    endPhase(0, getFileSize(xplaneRoot + "METAR.rwx"));
 
-    logger::verbose("Build node network...");
+    beginPhase("node network");
     xworld->registerNavNodes();
+    endPhase();
+
+    beginPhase("route landmarks");
+    xworld->buildRouteLandmarks();
+    endPhase();
+
+    auto duration = std::chrono::steady_clock::now() - startAt;
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
     logger::info("Loaded nav data in %.2f seconds", millis / 1000.0f);
+    logLoadPhases();
 }
 
-void XData::loadAirports() {
-    const AirportLoader loader(shared_from_this());
+void XData::parseNavData(size_t workers, const std::set<std::string> &cifpIds, const navcache::Sources &sources) {
+    auto snapshot = createSnapshot(sources);
 
-    loadCustomScenery(loader);
+    // The files are parsed concurrently, but they are linked into the world
+    // one after the other in the same order as before so that the result
+    // doesn't depend on thread timing.
+    auto parseAsync = [] (auto fn) {
+        return std::async(std::launch::async, [fn] () {
+            crash::ThreadCookie crashCookie;
+            return fn();
+        });
+    };
+    auto self = shared_from_this();
+    auto fixes = parseAsync([self, path = navDataPath + "earth_fix.dat"] () { return FixLoader(self).parse(path); });
+    auto navaids = parseAsync([self, path = navDataPath + "earth_nav.dat"] () { return NavaidLoader(self).parse(path); });
+    auto airways = parseAsync([self, path = navDataPath + "earth_awy.dat"] () { return AirwayLoader(self).parse(path); });
 
-    logger::verbose("Loading default apt.dat");
+    // the fix, navaid and airway files are parsed while the airports load,
+    // so their phases only measure what is left of the parsing and the linking
+    beginPhase("airports");
+    size_t airportCount = loadAirports(workers, snapshot.get());
+    uint64_t airportBytes = getFileSize(findDefaultAirportFile());
+    for (auto &aptDatPath: customSceneries) {
+        airportBytes += getFileSize(aptDatPath);
+    }
+    endPhase(airportCount, airportBytes);
+
+    beginPhase("fixes");
+    auto fixData = fixes.get();
+    if (snapshot) {
+        snapshot->write(fixData);
+    }
+    FixLoader(self).link(fixData);
+    endPhase(fixData.size(), getFileSize(navDataPath + "earth_fix.dat"));
+
+    beginPhase("navaids");
+    auto navaidData = navaids.get();
+    if (snapshot) {
+        snapshot->write(navaidData);
+    }
+    NavaidLoader(self).link(navaidData);
+    endPhase(navaidData.size(), getFileSize(navDataPath + "earth_nav.dat"));
+
+    beginPhase("airways");
+    auto airwayData = airways.get();
+    if (snapshot) {
+        snapshot->write(airwayData);
+    }
+    AirwayLoader(self).link(airwayData);
+    endPhase(airwayData.size(), getFileSize(navDataPath + "earth_awy.dat"));
+
+    beginPhase("CIFP");
+    size_t procedureCount = loadProcedures(workers, cifpIds, snapshot.get());
+    uint64_t procedureBytes = 0;
+    for (auto &src: sources) {
+        if (src.path.find("/CIFP/") != std::string::npos) {
+            procedureBytes += src.size;
+        }
+    }
+    endPhase(procedureCount, procedureBytes);
+
+    if (snapshot) {
+        try {
+            snapshot->commit();
+            logger::info("Saved nav data snapshot");
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't save nav data snapshot: %s", e.what());
+        }
+    }
+}
+
+size_t XData::loadSnapshot(navcache::Reader &snapshot, size_t workers, const std::set<std::string> &cifpIds) {
+    auto self = shared_from_this();
+
+    const AirportLoader airportLoader(self);
+    loadCustomScenery(airportLoader, workers);
+
+    std::vector<AirportData> airports;
+    snapshot.read(airports);
+    airportLoader.link(airports);
+
+    std::vector<FixData> fixes;
+    snapshot.read(fixes);
+    FixLoader(self).link(fixes);
+
+    std::vector<NavaidData> navaids;
+    snapshot.read(navaids);
+    NavaidLoader(self).link(navaids);
+
+    std::vector<AirwayData> airways;
+    snapshot.read(airways);
+    AirwayLoader(self).link(airways);
+
+    size_t records = airports.size() + fixes.size() + navaids.size() + airways.size();
+    if (lazyProcedures) {
+        deferProcedures(findProcedureAirports(cifpIds));
+        return records;
+    }
+
+    CIFPLoader cifpLoader(self);
+    std::string airportId;
+    std::vector<CIFPData> procedures;
+    while (snapshot.readProcedures(airportId, procedures)) {
+        auto airport = xworld->findAirportByID(airportId);
+        if (airport) {
+            cifpLoader.link(airport, procedures);
+        }
+        records += procedures.size();
+    }
+    return records;
+}
+
+navcache::Sources XData::describeSources(const std::set<std::string> &cifpIds) const {
+    navcache::Sources sources;
+
+    // a snapshot without procedures must not be used for an eager load
+    navcache::SourceFile mode;
+    mode.path = "lazy_cifp_loading";
+    mode.size = lazyProcedures ? 1 : 0;
+    sources.push_back(mode);
+
+    // custom sceneries have their own snapshots, see loadCustomScenery
+    sources.push_back(navcache::describeFile(findDefaultAirportFile()));
+    sources.push_back(navcache::describeFile(navDataPath + "earth_fix.dat"));
+    sources.push_back(navcache::describeFile(navDataPath + "earth_nav.dat"));
+    sources.push_back(navcache::describeFile(navDataPath + "earth_awy.dat"));
+
+    if (!lazyProcedures) {
+        for (auto &id: cifpIds) {
+            sources.push_back(navcache::describeFile(navDataPath + "CIFP/" + id + ".dat"));
+        }
+    }
+    return sources;
+}
+
+std::string XData::getSnapshotPath() const {
+    return cacheDirectory + "navdata.bin";
+}
+
+std::string XData::getScenerySnapshotDir() const {
+    return cacheDirectory + "sceneries/";
+}
+
+bool XData::readScenerySnapshot(const std::string &aptDatPath, std::vector<AirportData> &airports) const {
+    std::string path = getScenerySnapshotDir() + navcache::getSnapshotName(aptDatPath);
+    if (cacheDirectory.empty() || !platform::fileExists(path)) {
+        return false;
+    }
+
+    try {
+        navcache::Reader reader(path, {navcache::describeFile(aptDatPath)});
+        reader.read(airports);
+        return true;
+    } catch (const std::exception &e) {
+        airports.clear();
+        return false;
+    }
+}
+
+void XData::writeScenerySnapshot(const std::string &aptDatPath, const std::vector<AirportData> &airports) const {
+    if (cacheDirectory.empty()) {
+        return;
+    }
+
+    try {
+        platform::mkpath(getScenerySnapshotDir());
+        navcache::Writer writer(getScenerySnapshotDir() + navcache::getSnapshotName(aptDatPath), {navcache::describeFile(aptDatPath)});
+        writer.write(airports);
+        writer.commit();
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't save snapshot for %s: %s", aptDatPath.c_str(), e.what());
+    }
+}
+
+void XData::pruneScenerySnapshots() const {
+    std::string dir = getScenerySnapshotDir();
+    if (cacheDirectory.empty() || !platform::fileExists(dir)) {
+        return;
+    }
+
+    std::set<std::string> current;
+    for (auto &aptDatPath: customSceneries) {
+        current.insert(navcache::getSnapshotName(aptDatPath));
+    }
+
+    try {
+        for (auto &entry: platform::readDirectory(dir)) {
+            if (!entry.isDirectory && current.count(entry.utf8Name) == 0) {
+                platform::removeFile(dir + entry.utf8Name);
+            }
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't clean up scenery snapshots: %s", e.what());
+    }
+}
+
+std::unique_ptr<navcache::Reader> XData::openSnapshot(const navcache::Sources &sources) {
+    if (cacheDirectory.empty() || !platform::fileExists(getSnapshotPath())) {
+        return nullptr;
+    }
+
+    try {
+        return std::make_unique<navcache::Reader>(getSnapshotPath(), sources);
+    } catch (const std::exception &e) {
+        logger::info("Not using nav data snapshot: %s", e.what());
+        return nullptr;
+    }
+}
 
+std::unique_ptr<navcache::Writer> XData::createSnapshot(const navcache::Sources &sources) {
+    if (cacheDirectory.empty()) {
+        return nullptr;
+    }
+
+    try {
+        platform::mkpath(cacheDirectory);
+        return std::make_unique<navcache::Writer>(getSnapshotPath(), sources);
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't create nav data snapshot: %s", e.what());
+        return nullptr;
+    }
+}
+
+std::string XData::findDefaultAirportFile() const {
     std::string x11Path = xplaneRoot + "Resources/default scenery/default apt dat/Earth nav data/apt.dat";
     std::string x12Path = xplaneRoot + "Global Scenery/Global Airports/Earth nav data/apt.dat";
 
     if (platform::fileExists(x11Path)) {
-        loader.load(x11Path);
+        return x11Path;
     } else if (platform::fileExists(x12Path)) {
-        loader.load(x12Path);
+        return x12Path;
+    }
+    return "";
+}
+
+size_t XData::loadAirports(size_t workers, navcache::Writer *snapshot) {
+    const AirportLoader loader(shared_from_this());
+
+    size_t count = loadCustomScenery(loader, workers);
+
+    logger::verbose("Loading default apt.dat");
+
+    std::vector<AirportData> airports;
+    std::string aptDatPath = findDefaultAirportFile();
+    if (!aptDatPath.empty()) {
+        airports = loader.parse(aptDatPath, workers);
     } else {
         logger::error("Couldn't find apt.dat");
     }
+
+    if (snapshot) {
+        snapshot->write(airports);
+    }
+    loader.link(airports);
+    return count + airports.size();
 }
 
-void XData::loadCustomScenery(const AirportLoader& loader) {
-    for (auto &aptDatPath: customSceneries) {
+size_t XData::loadCustomScenery(const AirportLoader& loader, size_t workers) {
+    // Custom sceneries are usually small, so each one is parsed as a whole.
+    // Every scenery has its own snapshot, so adding or updating a pack only
+    // parses that pack again. Linking keeps the scenery_packs.ini order.
+    auto sceneries = parallelMap<std::vector<AirportData>>(customSceneries.size(), workers, [this, &loader] (size_t i) {
+        auto &aptDatPath = customSceneries[i];
         try {
+            std::vector<AirportData> airports;
+            if (readScenerySnapshot(aptDatPath, airports)) {
+                return airports;
+            }
             logger::info("Loading custom scenery airport for %s", aptDatPath.c_str());
-            loader.load(aptDatPath);
+            airports = loader.parse(aptDatPath);
+            writeScenerySnapshot(aptDatPath, airports);
+            return airports;
+        } catch (const std::exception &e) {
+            logger::warn("Unable to parse custom scenery: %s", e.what());
+            return std::vector<AirportData>{};
+        }
+    });
+
+    size_t count = 0;
+    for (auto &airports: sceneries) {
+        try {
+            loader.link(airports);
+            count += airports.size();
         } catch (const std::exception &e) {
             logger::warn("Unable to parse custom scenery: %s", e.what());
         }
     }
+    return count;
 }
 
-void XData::loadFixes() {
-    FixLoader loader(shared_from_this());
-    loader.load(navDataPath + "earth_fix.dat");
+std::set<std::string> XData::scanProcedureFiles() {
+    std::set<std::string> ids;
+    try {
+        for (auto &entry: platform::readDirectory(navDataPath + "CIFP")) {
+            auto &name = entry.utf8Name;
+            if (!entry.isDirectory && name.size() > 4 && name.compare(name.size() - 4, 4, ".dat") == 0) {
+                ids.insert(name.substr(0, name.size() - 4));
+            }
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't list CIFP directory: %s", e.what());
+    }
+    return ids;
 }
 
-void XData::loadNavaids() {
-    NavaidLoader loader(shared_from_this());
-    loader.load(navDataPath + "earth_nav.dat");
+std::vector<std::shared_ptr<world::Airport>> XData::findProcedureAirports(const std::set<std::string> &cifpIds) {
+    // only airports that actually have a CIFP file are attempted
+    std::vector<std::shared_ptr<world::Airport>> airports;
+    xworld->forEachAirport([&airports, &cifpIds] (std::shared_ptr<world::Airport> ap) {
+        if (cifpIds.count(ap->getID()) > 0) {
+            airports.push_back(ap);
+        }
+    });
+    return airports;
 }
 
-void XData::loadAirways() {
-    AirwayLoader loader(shared_from_this());
-    loader.load(navDataPath + "earth_awy.dat");
-}
+size_t XData::loadProcedures(size_t workers, const std::set<std::string> &cifpIds, navcache::Writer *snapshot) {
+    auto airports = findProcedureAirports(cifpIds);
 
-void XData::loadProcedures() {
+    if (lazyProcedures) {
+        deferProcedures(airports);
+        return 0;
+    }
+
+    // parse a batch of airports concurrently, then link it before the next
+    // batch so that only a bounded number of parsed procedures is kept around
     CIFPLoader loader(shared_from_this());
-    xworld->forEachAirport([this, &loader] (std::shared_ptr<world::Airport> ap) {
-        try {
-            loader.load(ap, navDataPath + "CIFP/" + ap->getID() + ".dat");
-        } catch (const std::exception &e) {
-            // many airports do not have CIFP data, so ignore silently
+    const size_t batchSize = 64 * workers;
+    size_t records = 0;
+    for (size_t start = 0; start < airports.size(); start += batchSize) {
+        size_t count = std::min(batchSize, airports.size() - start);
+        auto procedures = parallelMap<std::vector<CIFPData>>(count, workers, [this, &loader, &airports, start] (size_t i) {
+            try {
+                return loader.parse(navDataPath + "CIFP/" + airports[start + i]->getID() + ".dat");
+            } catch (const std::exception &e) {
+                logger::warn("Can't parse CIFP for %s: %s", airports[start + i]->getID().c_str(), e.what());
+                return std::vector<CIFPData>{};
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            if (snapshot) {
+                snapshot->writeProcedures(airports[start + i]->getID(), procedures[i]);
+            }
+            records += procedures[i].size();
+            try {
+                loader.link(airports[start + i], procedures[i]);
+            } catch (const std::exception &e) {
+                // cancellation is checked below
+            }
         }
+
         if (shouldCancelLoading()) {
             throw std::runtime_error("Cancelled");
         }
-    });
+    }
+    return records;
 }
 
-void XData::loadMetar() {
-    using namespace std::placeholders;
+void XData::deferProcedures(const std::vector<std::shared_ptr<world::Airport>> &airports) {
+    logger::verbose("Deferring CIFP for %d airports until first use", (int) airports.size());
 
-    logger::verbose("Loading METAR...");
+    // The loaders only keep weak references so that the airports don't keep
+    // the load manager alive. The mutex serializes the loads because linking
+    // adds connections to the shared world graph.
+    std::weak_ptr<world::LoadManager> weakMgr = shared_from_this();
+    auto mutex = std::make_shared<std::mutex>();
+    for (auto &ap: airports) {
+        std::weak_ptr<world::Airport> weakAirport = ap;
+        std::string path = navDataPath + "CIFP/" + ap->getID() + ".dat";
+        ap->setProcedureLoader([weakMgr, weakAirport, path, mutex] () {
+            auto mgr = weakMgr.lock();
+            auto airport = weakAirport.lock();
+            if (!mgr || !airport) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(*mutex);
+            try {
+                CIFPLoader loader(mgr);
+                loader.load(airport, path);
+            } catch (const std::exception &e) {
+                logger::warn("Can't load CIFP for %s: %s", airport->getID().c_str(), e.what());
+            }
+        });
+    }
+}
 
-    try {
-        MetarLoader loader(shared_from_this());
-        loader.load(xplaneRoot + "METAR.rwx");
-    } catch (const std::exception &e) {
-        // metar is optional, so only log
-        logger::warn("Error parsing METAR: %s", e.what());
+void XData::loadMetar() {
+    if (!metarUpdater) {
+        metarUpdater = std::make_unique<MetarUpdater>(xworld, xplaneRoot + "METAR.rwx");
     }
+    metarUpdater->update();
+    metarUpdater->start();
 }
 
 void XData::reloadMetar() {
-    loadMetar();
+    // new reports are applied by the updater's worker, don't block the caller
+    if (metarUpdater) {
+        metarUpdater->requestUpdate();
+    }
 }
 
 } /* namespace xdata */
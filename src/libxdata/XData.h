@@ -21,9 +21,12 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <set>
 #include "src/world/LoadManager.h"
 #include "src/libxdata/XWorld.h"
 #include "src/libxdata/loaders/AirportLoader.h"
+#include "src/libxdata/NavCache.h"
+#include "src/libxdata/MetarUpdater.h"
 
 namespace xdata {
 
@@ -35,22 +38,38 @@ public:
     void discoverSceneries() override;
     void load() override;
     void reloadMetar() override;
+    std::vector<std::string> getSourceFiles() override;
 private:
     std::string xplaneRoot;
     std::string navDataPath;
     std::shared_ptr<xdata::XWorld> xworld;
     std::vector<std::string> customSceneries;
     std::string userFixesFilename;
+    std::unique_ptr<MetarUpdater> metarUpdater;
 
     std::string determineNavDataPath();
 
-    void loadAirports();
-    void loadFixes();
-    void loadNavaids();
-    void loadAirways();
-    void loadProcedures();
+    std::string findDefaultAirportFile() const;
+
+    void parseNavData(size_t workers, const std::set<std::string> &cifpIds, const navcache::Sources &sources);
+    size_t loadAirports(size_t workers, navcache::Writer *snapshot);
+    size_t loadCustomScenery(const AirportLoader& loader, size_t workers);
+    size_t loadProcedures(size_t workers, const std::set<std::string> &cifpIds, navcache::Writer *snapshot);
+    std::set<std::string> scanProcedureFiles();
+    std::vector<std::shared_ptr<world::Airport>> findProcedureAirports(const std::set<std::string> &cifpIds);
+    void deferProcedures(const std::vector<std::shared_ptr<world::Airport>> &airports);
     void loadMetar();
-    void loadCustomScenery(const AirportLoader& loader);
+
+    navcache::Sources describeSources(const std::set<std::string> &cifpIds) const;
+    std::string getSnapshotPath() const;
+    std::unique_ptr<navcache::Reader> openSnapshot(const navcache::Sources &sources);
+    std::unique_ptr<navcache::Writer> createSnapshot(const navcache::Sources &sources);
+    size_t loadSnapshot(navcache::Reader &snapshot, size_t workers, const std::set<std::string> &cifpIds);
+
+    std::string getScenerySnapshotDir() const;
+    bool readScenerySnapshot(const std::string &aptDatPath, std::vector<AirportData> &airports) const;
+    void writeScenerySnapshot(const std::string &aptDatPath, const std::vector<AirportData> &airports) const;
+    void pruneScenerySnapshots() const;
 
 };
 
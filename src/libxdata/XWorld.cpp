@@ -27,7 +27,8 @@
 
 namespace xdata {
 
-XWorld::XWorld()
+XWorld::XWorld():
+    arena(std::make_shared<world::Arena>())
 {
 }
 
@@ -53,12 +54,14 @@ std::vector<std::shared_ptr<world::Airport>> XWorld::findAirport(const std::stri
         res.push_back(directfind);
     }
 
-    for (auto &it: airports) {
-        if (platform::lower(it.second->getName()).find(key) != std::string::npos) {
-            res.push_back(it.second);
-            if (res.size() >= MAX_SEARCH_RESULTS) {
-                break;
-            }
+    for (auto idx: airportSearch.search(key, MAX_SEARCH_RESULTS)) {
+        auto &ap = airportList.at(idx);
+        if (ap == directfind) {
+            continue;
+        }
+        res.push_back(ap);
+        if (res.size() >= MAX_SEARCH_RESULTS) {
+            break;
         }
     }
 
@@ -79,16 +82,16 @@ std::shared_ptr<world::Fix> XWorld::findFixByRegionAndID(const std::string& regi
 }
 
 void XWorld::forEachAirport(std::function<void(std::shared_ptr<world::Airport>)> f) {
-    for (auto it: airports) {
-        f(it.second);
+    for (auto &ap: airportList) {
+        f(ap);
     }
 }
 
 std::shared_ptr<world::Region> XWorld::findOrCreateRegion(const std::string& id) {
     auto iter = regions.find(id);
     if (iter == regions.end()) {
-        auto ptr = std::make_shared<world::Region>(id);
-        regions.insert(std::make_pair(id, ptr));
+        auto ptr = create<world::Region>(id);
+        regions.insert(std::make_pair(std::string_view(ptr->getId()), ptr));
         return ptr;
     }
     return iter->second;
@@ -97,8 +100,9 @@ std::shared_ptr<world::Region> XWorld::findOrCreateRegion(const std::string& id)
 std::shared_ptr<world::Airport> XWorld::findOrCreateAirport(const std::string& id) {
     auto iter = airports.find(id);
     if (iter == airports.end()) {
-        auto ptr = std::make_shared<world::Airport>(id);
-        airports.insert(std::make_pair(id, ptr));
+        auto ptr = create<world::Airport>(id);
+        airports.insert(std::make_pair(std::string_view(ptr->getID()), ptr));
+        airportList.push_back(ptr);
         return ptr;
     }
     return iter->second;
@@ -114,22 +118,23 @@ std::shared_ptr<world::Airway> XWorld::findOrCreateAirway(const std::string& nam
     }
 
     // not found -> insert
-    auto awy = std::make_shared<world::Airway>(name, lvl);
-    airways.insert(std::make_pair(name, awy));
+    auto awy = create<world::Airway>(name, lvl);
+    airways.insert(std::make_pair(std::string_view(awy->getID()), awy));
     return awy;
 }
 
-std::vector<world::World::Connection> &XWorld::getConnections(std::shared_ptr<world::NavNode> from) {
-    auto iter = connections.find(from);
-    if (iter != connections.end()) {
-        return iter->second;
+world::World::ConnectionList XWorld::getConnections(std::shared_ptr<world::NavNode> from) {
+    std::lock_guard<std::mutex> lock(graphMutex);
+    uint32_t index = from->getGraphIndex();
+    if (index == 0 || index > connections.size()) {
+        return noConnection;
     }
-    return noConnection;
+    return connections[index - 1];
 }
 
 bool XWorld::areConnected(std::shared_ptr<world::NavNode> from, const std::shared_ptr<world::NavNode> to) {
-    for (auto &c: getConnections(from)) {
-        if (c.second == to) {
+    for (auto &c: *getConnections(from)) {
+        if (c.to == to) {
             return true;
         }
     }
@@ -149,17 +154,51 @@ std::shared_ptr<world::Region> XWorld::getRegion(const std::string &id) {
 }
 
 void XWorld::connectTo(std::shared_ptr<world::NavNode> from, std::shared_ptr<world::NavEdge> via, std::shared_ptr<world::NavNode> to) {
-    auto iter = connections.find(from);
-    if (iter == connections.end()) {
-        connections[from] = std::vector<world::World::Connection>();
-        iter = connections.find(from);
+    std::lock_guard<std::mutex> lock(graphMutex);
+    uint32_t index = getOrAssignGraphIndex(from);
+    uint32_t toIndex = getOrAssignGraphIndex(to);
+    auto &list = connections[index - 1];
+    if (list.use_count() > 1) {
+        // a search is using the list, it keeps the one it has
+        list = std::make_shared<std::vector<world::World::Connection>>(*list);
+    }
+    list->emplace_back(from, via, to);
+    if (via->isProcedure() && to->isAirport()) {
+        auto &fixes = arrivals[toIndex - 1];
+        if (std::find(fixes.begin(), fixes.end(), from) == fixes.end()) {
+            fixes.push_back(from);
+        }
+    }
+}
+
+uint32_t XWorld::getOrAssignGraphIndex(const std::shared_ptr<world::NavNode> &n) {
+    // nodes that are only reached are numbered too, so that the route landmarks cover them
+    uint32_t index = n->getGraphIndex();
+    if (index == 0) {
+        connections.push_back(std::make_shared<std::vector<world::World::Connection>>());
+        graphLocations.push_back(n->getLocation());
+        index = connections.size();
+        n->setGraphIndex(index);
+    }
+    return index;
+}
+
+std::vector<std::shared_ptr<world::NavNode>> XWorld::getArrivalFixes(const std::shared_ptr<world::NavNode> &airport) const {
+    std::lock_guard<std::mutex> lock(graphMutex);
+    uint32_t index = airport->getGraphIndex();
+    if (index == 0) {
+        return {};
     }
-    (iter->second).push_back(std::make_pair(via, to));
+    auto it = arrivals.find(index - 1);
+    if (it == arrivals.end()) {
+        return {};
+    }
+    return it->second;
 }
 
 void XWorld::addFix(std::shared_ptr<world::Fix> fix) {
     fix->setGlobal(true);
-    fixes.insert(std::make_pair(fix->getID(), fix));
+    fixes.insert(std::make_pair(std::string_view(fix->getID()), fix));
     // fixes may be added after the initial loading of the NAV world.
     // if so, register the node independently here
     if (allNodesRegistered) {
@@ -167,47 +206,78 @@ void XWorld::addFix(std::shared_ptr<world::Fix> fix) {
     }
 }
 
+void XWorld::setUserFixes(const std::vector<std::shared_ptr<world::Fix>> &fixes) {
+    userFixIndex.replace(fixes);
+    ++nodeRevision;
+}
+
 std::shared_ptr<world::RouteFinder> XWorld::getRouteFinder() {
-    return std::make_shared<world::RouteFinder>(shared_from_this());
+    auto finder = std::make_shared<world::RouteFinder>(shared_from_this());
+    if (!routeLandmarks.empty()) {
+        finder->setLandmarks(routeLandmarks, [this] (const std::shared_ptr<world::NavNode> &airport) {
+            return getArrivalFixes(airport);
+        });
+    }
+    return finder;
+}
+
+void XWorld::buildRouteLandmarks() {
+    // the bounds only need the airways: a route uses procedures just to leave the
+    // departure and to reach the arrival, and the finder accounts for the latter.
+    std::lock_guard<std::mutex> lock(graphMutex);
+    size_t count = connections.size();
+    for (auto level: {world::AirwayLevel::LOWER, world::AirwayLevel::UPPER}) {
+        std::vector<uint32_t> offsets(1, 0);
+        std::vector<world::RouteLandmarks::Edge> edges;
+        for (size_t n = 0; n < count; ++n) {
+            for (auto &c: *connections[n]) {
+                if (!c.via->isProcedure() && c.via->supportsLevel(level)) {
+                    edges.emplace_back(c.to->getGraphIndex() - 1, c.distance);
+                }
+            }
+            offsets.push_back(edges.size());
+        }
+        routeLandmarks[level] = std::make_shared<const world::RouteLandmarks>(graphLocations, offsets, edges);
+    }
 }
 
 void XWorld::registerNavNodes() {
     if (allNodesRegistered) return;
-    for (auto it: airports) {
-        registerNode(it.second);
+    for (size_t i = 0; i < airportList.size(); i++) {
+        registerNode(airportList[i]);
+        airportSearch.add(i, airportList[i]->getID(), airportList[i]->getName());
     }
+    airportSearch.build();
     for (auto it: fixes) {
         registerNode(it.second);
     }
+    nodeIndex.build();
     allNodesRegistered = true;
 }
 
 void XWorld::registerNode(std::shared_ptr<world::NavNode> n) {
     auto &loc = n->getLocation();
-    int lat = (int) loc.latitude;
-    int lon = (int) loc.longitude;
-    allNodes[std::make_pair(lat, lon)].push_back(n);
+    int lat = (int) std::floor(loc.latitude);
+    int lon = (int) std::floor(loc.longitude);
+    density.add(lat, lon);
+    nodeIndex.add(n);
+    if (n->isAirport()) {
+        airportLOD.add(static_cast<const world::Airport *>(n.get()));
+    }
+    ++nodeRevision;
 }
 
-int XWorld::maxDensity(const world::Location &bottomLeft, const world::Location &topRight) {
-    int m = 0;
+uint32_t XWorld::getNodeRevision() const {
+    return nodeRevision;
+}
+
+void XWorld::prefetchAlong(const std::vector<std::vector<world::Location>> &paths) {
+    // all nodes are loaded up front
+}
 
+int XWorld::maxDensity(const world::Location &bottomLeft, const world::Location &topRight) {
     // nodes are grouped by integer lat/lon 'squares'.
-    int latl = std::max((int)std::floor(bottomLeft.latitude), -90);
-    int lath = std::min((int)std::ceil(topRight.latitude), 89);
-    int lonl = (int)std::floor(bottomLeft.longitude);
-    int lonh = (int)std::ceil(topRight.longitude);
-
-    // the area might span the -180/180 meridian. bias it here, normalise again in the iteration
-    if (lonh < lonl) { lonh += 360; }
-    for (int laty = latl; laty <= lath; ++laty) {
-        for (int lonx = lonl; lonx <= lonh; ++lonx) {
-            int normx = (lonx >= 180) ? (lonx - 360) : lonx;
-            auto it = allNodes.find(std::make_pair(laty, normx));
-            if (it == allNodes.end()) continue;
-            m = std::max(m, (int)it->second.size());
-        }
-    }
+    int m = density.maxInArea(bottomLeft, topRight);
 
     // pretend that each grid area has 'max' nodes in it, and report the total number of visible nodes that
     // would be seen if this was the case.
@@ -218,46 +288,22 @@ int XWorld::maxDensity(const world::Location &bottomLeft, const world::Location
 }
 
 void XWorld::visitNodes(const world::Location& bottomLeft, const world::Location &topRight, NodeAcceptor callback, int filter) {
-    // nodes are grouped by integer lat/lon 'squares'.
-    int latl = std::min((int)std::floor(bottomLeft.latitude), -90);
-    int lath = std::min((int)std::ceil(topRight.latitude), 89);
-    int lonl = (int)std::floor(bottomLeft.longitude);
-    int lonh = (int)std::ceil(topRight.longitude);
-
-    // the area might span the -180/180 meridian. bias it here, normalise again in iteration
-    if (lonh < lonl) { lonh += 360; }
-
-    for (int laty = latl; laty <= lath; ++laty) {
-        for (int lonx = lonl; lonx <= lonh; ++lonx) {
-            int normx = (lonx >= 180) ? (lonx - 360) : lonx;
-            std::pair<int, int> key = std::make_pair(laty, normx);
-            auto it = allNodes.find(key);
-            if (it == allNodes.end()) {
-                continue;
-            }
-            for (auto node: it->second) {
-                if (!node->getLocation().isInArea(bottomLeft, topRight)) continue;
-                bool accept = false;
-                if (node->isAirport()) {
-                    if (std::dynamic_pointer_cast<world::Airport>(node)->hasControlTower()) {
-                        accept = (filter & world::World::VISIT_TOWERED_AIRPORTS);
-                    } else {
-                        accept = (filter & world::World::VISIT_OTHER_AIRPORTS);
-                    }
-                } else if (node->isFix()) {
-                    auto f = std::dynamic_pointer_cast<world::Fix>(node);
-                    if (f->isNavaid()) {
-                        accept = (filter & world::World::VISIT_NAVAIDS);
-                    } else if (f->isUserFix()) {
-                        accept = (filter & world::World::VISIT_USER_FIXES);
-                    } else {
-                        accept = (filter & world::World::VISIT_FIXES);
-                    }
-                }
-                if (accept) callback(node.get());
-            }
-        }
+    nodeIndex.visit(bottomLeft, topRight, filter, callback);
+    if (filter & VISIT_USER_FIXES) {
+        userFixIndex.visit(bottomLeft, topRight, callback);
     }
 }
 
+void XWorld::visitAlongRoute(const world::Route &route, double bufferNm, NodeAcceptor callback, int filter) {
+    world::Corridor corridor(route.getPathLocations(), bufferNm / world::KM_TO_NM * 1000);
+    nodeIndex.visitCorridor(corridor, filter, callback);
+    if (filter & VISIT_USER_FIXES) {
+        userFixIndex.visitCorridor(corridor, callback);
+    }
+}
+
+void XWorld::visitMajorAirports(const world::Location &bottomLeft, const world::Location &topRight, double cellDegrees, NodeAcceptor callback, int filter) {
+    airportLOD.visit(bottomLeft, topRight, cellDegrees, filter, callback);
+}
+
 } /* namespace xdata */
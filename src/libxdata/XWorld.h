@@ -17,11 +17,22 @@
  */
 #pragma once
 
-#include <map>
+#include <unordered_map>
+#include <deque>
+#include <vector>
 #include <string>
+#include <string_view>
 #include <functional>
 #include <atomic>
+#include <mutex>
 #include "src/world/World.h"
+#include "src/world/graph/SpatialIndex.h"
+#include "src/world/graph/UserFixIndex.h"
+#include "src/world/graph/DensityPyramid.h"
+#include "src/world/graph/AirportLOD.h"
+#include "src/world/graph/AirportSearchIndex.h"
+#include "src/world/routing/RouteFinder.h"
+#include "src/world/Arena.h"
 
 namespace xdata {
 
@@ -33,18 +44,23 @@ public:
 
     int maxDensity(const world::Location &bottomLeft, const world::Location &topRight) override;
     void visitNodes(const world::Location &bottomLeft, const world::Location &topRight, NodeAcceptor callback, int filter) override;
+    void visitAlongRoute(const world::Route &route, double bufferNm, NodeAcceptor callback, int filter) override;
+    void visitMajorAirports(const world::Location &bottomLeft, const world::Location &topRight, double cellDegrees, NodeAcceptor callback, int filter) override;
+    uint32_t getNodeRevision() const override;
+    void prefetchAlong(const std::vector<std::vector<world::Location>> &paths) override;
 
     std::shared_ptr<world::Airport> findAirportByID(const std::string &id) const override;
     std::shared_ptr<world::Fix> findFixByRegionAndID(const std::string &region, const std::string &id) const override;
     std::vector<std::shared_ptr<world::Airport>> findAirport(const std::string &keyWord) const override;
 
-    std::vector<world::World::Connection> &getConnections(std::shared_ptr<world::NavNode> from) override;
+    world::World::ConnectionList getConnections(std::shared_ptr<world::NavNode> from) override;
     bool areConnected(std::shared_ptr<world::NavNode> from, const std::shared_ptr<world::NavNode> to) override;
 
     void addRegion(const std::string &code) override;
     std::shared_ptr<world::Region> getRegion(const std::string &id) override;
 
     void addFix(std::shared_ptr<world::Fix> fix) override;
+    void setUserFixes(const std::vector<std::shared_ptr<world::Fix>> &fixes) override;
 
     std::shared_ptr<world::RouteFinder> getRouteFinder() override;
 
@@ -54,30 +70,66 @@ public:
     std::shared_ptr<world::Airway> findOrCreateAirway(const std::string &name, world::AirwayLevel lvl);
     void connectTo(std::shared_ptr<world::NavNode> from, std::shared_ptr<world::NavEdge> via, std::shared_ptr<world::NavNode> to);
 
+    // model objects of this world are allocated from its arena
+    template<typename T, typename... Args>
+    std::shared_ptr<T> create(Args&&... args) {
+        return world::makeInArena<T>(arena, std::forward<Args>(args)...);
+    }
+
     void registerNavNodes();
+    // precomputes the route search lower bounds, once all airways are linked
+    void buildRouteLandmarks();
 
 private:
     void registerNode(std::shared_ptr<world::NavNode> n);
+    // called with graphMutex held
+    uint32_t getOrAssignGraphIndex(const std::shared_ptr<world::NavNode> &n);
+    std::vector<std::shared_ptr<world::NavNode>> getArrivalFixes(const std::shared_ptr<world::NavNode> &airport) const;
 
 private:
     bool allNodesRegistered { false };
+    std::atomic<uint32_t> nodeRevision { 0 };
+
+    std::shared_ptr<world::Arena> arena;
+
+    // The keys are views of the interned IDs of the objects they map to
 
     // Unique IDs
-    std::map<std::string, std::shared_ptr<world::Region>> regions;
-    std::map<std::string, std::shared_ptr<world::Airport>> airports;
+    std::unordered_map<std::string_view, std::shared_ptr<world::Region>> regions;
+    std::unordered_map<std::string_view, std::shared_ptr<world::Airport>> airports;
+    // Airports in insertion order so that iterating them stays deterministic
+    std::vector<std::shared_ptr<world::Airport>> airportList;
 
     // Unique only within region
-    std::multimap<std::string, std::shared_ptr<world::Fix>> fixes;
+    std::unordered_multimap<std::string_view, std::shared_ptr<world::Fix>> fixes;
 
     // Unique within airway level
-    std::multimap<std::string, std::shared_ptr<world::Airway>> airways;
+    std::unordered_multimap<std::string_view, std::shared_ptr<world::Airway>> airways;
 
     // To search by location
-    std::map<std::pair<int, int>, world::NavNodeList> allNodes;
-
-    // Connections between nodes (airports, heliports, runways, fixes)
-    std::map<std::shared_ptr<world::NavNode>, std::vector<world::World::Connection>> connections;
-    std::vector<world::World::Connection> noConnection;
+    world::SpatialIndex nodeIndex;
+    world::UserFixIndex userFixIndex;
+    // Number of nodes in each integer lat/lon square, to estimate density
+    world::DensityPyramid density;
+    // Most significant airports for zoomed-out maps
+    world::AirportLOD airportLOD;
+    // Airport search by ID and name, keys are positions in airportList
+    world::AirportSearchIndex airportSearch;
+
+    // Lazily loaded procedures link airports while searches read the graph, so everything
+    // below up to the landmarks is guarded by graphMutex. A list a search holds is never
+    // changed, connecting more nodes to it replaces it with a copy.
+    mutable std::mutex graphMutex;
+    // Connections between nodes (airports, heliports, runways, fixes), indexed by graph index - 1.
+    std::deque<std::shared_ptr<std::vector<world::World::Connection>>> connections;
+    const world::World::ConnectionList noConnection = std::make_shared<const std::vector<world::World::Connection>>();
+    std::vector<world::Location> graphLocations;
+
+    // nodes with procedures leading to each airport, by airport graph index - 1
+    std::unordered_map<uint32_t, std::vector<std::shared_ptr<world::NavNode>>> arrivals;
+
+    // route search lower bounds over the airway network of each level
+    world::RouteFinder::LandmarkMap routeLandmarks;
 };
 
 } /* namespace xdata */
@@ -18,6 +18,7 @@
 #include <cmath>
 #include <limits>
 #include "AirportLoader.h"
+#include "src/libxdata/Parallel.h"
 #include "src/Logger.h"
 
 namespace xdata {
@@ -53,8 +54,36 @@ AirportLoader::AirportLoader(std::shared_ptr<world::LoadManager> mgr):
 }
 
 void AirportLoader::load(const std::string& file) const {
+    link(parse(file));
+}
+
+std::vector<AirportData> AirportLoader::parse(const std::string& file, size_t parts) const {
     AirportParser parser(file);
-    parser.setAcceptor([this] (const AirportData &data) {
+    auto bounds = parser.splitIntoBlocks(parts);
+    auto mappedFile = parser.getFile();
+
+    auto blocks = parallelMap<std::vector<AirportData>>(bounds.size() - 1, parts, [this, &bounds, &mappedFile] (size_t i) {
+        std::vector<AirportData> airports;
+        AirportParser blockParser(mappedFile, bounds[i], bounds[i + 1]);
+        blockParser.setAcceptor([this, &airports] (const AirportData &data) {
+            airports.push_back(data);
+            if (loadMgr->shouldCancelLoading()) {
+                throw std::runtime_error("Cancelled");
+            }
+        });
+        blockParser.loadAirports();
+        return airports;
+    });
+
+    std::vector<AirportData> airports;
+    for (auto &block: blocks) {
+        airports.insert(airports.end(), std::make_move_iterator(block.begin()), std::make_move_iterator(block.end()));
+    }
+    return airports;
+}
+
+void AirportLoader::link(const std::vector<AirportData> &airports) const {
+    for (auto &data: airports) {
         try {
             onAirportLoaded(data);
         } catch (const std::exception &e) {
@@ -63,8 +92,7 @@ void AirportLoader::load(const std::string& file) const {
         if (loadMgr->shouldCancelLoading()) {
             throw std::runtime_error("Cancelled");
         }
-    });
-    parser.loadAirports();
+    }
 }
 
 void AirportLoader::onAirportLoaded(const AirportData& port) const {
@@ -121,7 +149,7 @@ void AirportLoader::onAirportLoaded(const AirportData& port) const {
     }
 
     for (auto &entry: port.heliports) {
-        auto heliport = std::make_shared<world::Heliport>(entry.name);
+        auto heliport = world->create<world::Heliport>(entry.name);
         heliport->setLocation(world::Location(entry.latitude, entry.longitude));
         airport->addHeliport(heliport);
     }
@@ -142,7 +170,7 @@ void AirportLoader::onAirportLoaded(const AirportData& port) const {
 
         std::shared_ptr<world::Runway> end0;
         for (auto end = entry.ends.begin(); end != entry.ends.end(); ++end) {
-            auto rwy = std::make_shared<world::Runway>(end->name);
+            auto rwy = world->create<world::Runway>(end->name);
             rwy->setLocation(world::Location(end->latitude, end->longitude));
             rwy->setWidth(entry.width);
             rwy->setSurfaceType(mapToSurfaceMaterial(entry.surfaceTypeCode));
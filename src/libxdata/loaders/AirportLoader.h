@@ -19,6 +19,7 @@
 #define SRC_LIBXDATA_LOADERS_AIRPORTLOADER_H_
 
 #include <memory>
+#include <vector>
 #include "src/world/LoadManager.h"
 #include "../parsers/AirportParser.h"
 #include "../XWorld.h"
@@ -29,6 +30,11 @@ class AirportLoader {
 public:
     AirportLoader(std::shared_ptr<world::LoadManager> mgr);
     void load(const std::string &file) const;
+
+    // parse() only reads the file, splitting it into up to `parts` blocks that
+    // are parsed concurrently. link() adds the airports in file order.
+    std::vector<AirportData> parse(const std::string &file, size_t parts = 1) const;
+    void link(const std::vector<AirportData> &airports) const;
 private:
     std::shared_ptr<world::LoadManager> const loadMgr;
     std::shared_ptr<XWorld> world;
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <stdexcept>
 #include "AirwayLoader.h"
 #include "src/libxdata/parsers/AirwayParser.h"
 #include "src/Logger.h"
@@ -27,8 +28,24 @@ AirwayLoader::AirwayLoader(std::shared_ptr<world::LoadManager> mgr):
 }
 
 void AirwayLoader::load(const std::string& file) {
+    link(parse(file));
+}
+
+std::vector<AirwayData> AirwayLoader::parse(const std::string& file) const {
+    std::vector<AirwayData> airways;
     AirwayParser parser(file);
-    parser.setAcceptor([this] (const AirwayData &data) {
+    parser.setAcceptor([this, &airways] (const AirwayData &data) {
+        airways.push_back(data);
+        if (loadMgr->shouldCancelLoading()) {
+            throw std::runtime_error("Cancelled");
+        }
+    });
+    parser.loadAirways();
+    return airways;
+}
+
+void AirwayLoader::link(const std::vector<AirwayData> &airways) {
+    for (auto &data: airways) {
         try {
             onAirwayLoaded(data);
         } catch (const std::exception &e) {
@@ -37,8 +54,7 @@ void AirwayLoader::load(const std::string& file) {
         if (loadMgr->shouldCancelLoading()) {
             throw std::runtime_error("Cancelled");
         }
-    });
-    parser.loadAirways();
+    }
 }
 
 void AirwayLoader::onAirwayLoaded(const AirwayData& airway) {
@@ -19,6 +19,7 @@
 #define SRC_LIBXDATA_LOADERS_AIRWAYLOADER_H_
 
 #include <memory>
+#include <vector>
 #include "src/world/LoadManager.h"
 #include "../parsers/objects/AirwayData.h"
 #include "../XWorld.h"
@@ -29,6 +30,11 @@ class AirwayLoader {
 public:
     AirwayLoader(std::shared_ptr<world::LoadManager> mgr);
     void load(const std::string &file);
+
+    // parse() only reads the file and may run on any thread,
+    // link() adds the results to the world and must run on the loading thread
+    std::vector<AirwayData> parse(const std::string &file) const;
+    void link(const std::vector<AirwayData> &airways);
 private:
     std::shared_ptr<world::LoadManager> const loadMgr;
     std::shared_ptr<XWorld> world;
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <stdexcept>
 #include "CIFPLoader.h"
 #include "../parsers/CIFPParser.h"
 #include "../models/airports/procs/XSID.h"
@@ -30,8 +31,24 @@ CIFPLoader::CIFPLoader(std::shared_ptr<world::LoadManager> mgr):
 }
 
 void CIFPLoader::load(std::shared_ptr<world::Airport> airport, const std::string& file) {
+    link(airport, parse(file));
+}
+
+std::vector<CIFPData> CIFPLoader::parse(const std::string& file) const {
+    std::vector<CIFPData> procedures;
     CIFPParser parser(file);
-    parser.setAcceptor([this, airport] (const CIFPData &cifp) {
+    parser.setAcceptor([this, &procedures] (const CIFPData &cifp) {
+        procedures.push_back(cifp);
+        if (loadMgr->shouldCancelLoading()) {
+            throw std::runtime_error("Cancelled");
+        }
+    });
+    parser.loadCIFP();
+    return procedures;
+}
+
+void CIFPLoader::link(std::shared_ptr<world::Airport> airport, const std::vector<CIFPData> &procedures) {
+    for (auto &cifp: procedures) {
         try {
             onProcedureLoaded(airport, cifp);
         } catch (const std::exception &e) {
@@ -40,8 +57,7 @@ void CIFPLoader::load(std::shared_ptr<world::Airport> airport, const std::string
         if (loadMgr->shouldCancelLoading()) {
             throw std::runtime_error("Cancelled");
         }
-    });
-    parser.loadCIFP();
+    }
 }
 
 void CIFPLoader::onProcedureLoaded(std::shared_ptr<world::Airport> airport, const CIFPData& procedure) {
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "src/world/LoadManager.h"
 #include "src/world/models/airport/Airport.h"
 #include "../parsers/objects/CIFPData.h"
@@ -32,6 +33,11 @@ class CIFPLoader {
 public:
     CIFPLoader(std::shared_ptr<world::LoadManager> mgr);
     void load(std::shared_ptr<world::Airport> airport, const std::string &file);
+
+    // parse() only reads the file and may run on any thread,
+    // link() attaches the procedures and must run on the loading thread
+    std::vector<CIFPData> parse(const std::string &file) const;
+    void link(std::shared_ptr<world::Airport> airport, const std::vector<CIFPData> &procedures);
 private:
     std::shared_ptr<world::LoadManager> const loadMgr;
     std::shared_ptr<XWorld> world;
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <stdexcept>
 #include "FixLoader.h"
 #include "src/libxdata/parsers/FixParser.h"
 #include "src/Logger.h"
@@ -27,8 +28,24 @@ FixLoader::FixLoader(std::shared_ptr<world::LoadManager> mgr):
 }
 
 void FixLoader::load(const std::string& file) {
+    link(parse(file));
+}
+
+std::vector<FixData> FixLoader::parse(const std::string& file) const {
+    std::vector<FixData> fixes;
     FixParser parser(file);
-    parser.setAcceptor([this] (const FixData &data) {
+    parser.setAcceptor([this, &fixes] (const FixData &data) {
+        fixes.push_back(data);
+        if (loadMgr->shouldCancelLoading()) {
+            throw std::runtime_error("Cancelled");
+        }
+    });
+    parser.loadFixes();
+    return fixes;
+}
+
+void FixLoader::link(const std::vector<FixData> &fixes) {
+    for (auto &data: fixes) {
         try {
             onFixLoaded(data);
         } catch (const std::exception &e) {
@@ -37,8 +54,7 @@ void FixLoader::load(const std::string& file) {
         if (loadMgr->shouldCancelLoading()) {
             throw std::runtime_error("Cancelled");
         }
-    });
-    parser.loadFixes();
+    }
 }
 
 void FixLoader::onFixLoaded(const FixData& fix) {
@@ -55,7 +71,7 @@ void FixLoader::loadEnrouteFix(const FixData& fix) {
     auto region = world->findOrCreateRegion(fix.icaoRegion);
     world::Location loc(fix.latitude, fix.longitude);
 
-    fixModel = std::make_shared<world::Fix>(region, fix.id, loc);
+    fixModel = world->create<world::Fix>(region, fix.id, loc);
     world->addFix(fixModel);
 }
 
@@ -65,7 +81,7 @@ void FixLoader::loadTerminalFix(const FixData& fix) {
     auto region = world->findOrCreateRegion(fix.icaoRegion);
     world::Location loc(fix.latitude, fix.longitude);
 
-    fixModel = std::make_shared<world::Fix>(region, fix.id, loc);
+    fixModel = world->create<world::Fix>(region, fix.id, loc);
 
     auto airport = world->findAirportByID(fix.terminalAreaId);
     if (!airport) {
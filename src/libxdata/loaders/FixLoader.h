@@ -19,6 +19,7 @@
 #define SRC_LIBXDATA_LOADERS_FIXLOADER_H_
 
 #include <memory>
+#include <vector>
 #include "src/world/LoadManager.h"
 #include "../XWorld.h"
 #include "src/libxdata/parsers/objects/FixData.h"
@@ -29,6 +30,11 @@ class FixLoader {
 public:
     FixLoader(std::shared_ptr<world::LoadManager> mgr);
     void load(const std::string &file);
+
+    // parse() only reads the file and may run on any thread,
+    // link() adds the results to the world and must run on the loading thread
+    std::vector<FixData> parse(const std::string &file) const;
+    void link(const std::vector<FixData> &fixes);
 private:
     std::shared_ptr<world::LoadManager> const loadMgr;
     std::shared_ptr<XWorld> world;
@@ -15,37 +15,52 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <stdexcept>
 #include "MetarLoader.h"
 #include "src/libxdata/parsers/MetarParser.h"
 #include "src/Logger.h"
 
 namespace xdata {
 
-MetarLoader::MetarLoader(std::shared_ptr<world::LoadManager> mgr):
-    loadMgr(mgr), world(std::dynamic_pointer_cast<XWorld>(mgr->getWorld()))
+MetarLoader::MetarLoader(std::shared_ptr<XWorld> world, std::function<bool()> cancelled):
+    world(world), cancelled(cancelled)
 {
 }
 
-void MetarLoader::load(const std::string& file) {
+size_t MetarLoader::load(const std::string& file, MetarRecords &known) {
+    size_t updated = 0;
     MetarParser parser(file);
-    parser.setAcceptor([this] (const MetarData &data) {
+    parser.setAcceptor([this, &known, &updated] (const MetarData &data) {
         try {
-            onMetarLoaded(data);
+            if (onMetarLoaded(data, known)) {
+                ++updated;
+            }
         } catch (const std::exception &e) {
             logger::warn("Can't parse METAR for %s: %s", data.icaoCode.c_str(), e.what());
         }
-        if (loadMgr->shouldCancelLoading()) {
+        if (cancelled && cancelled()) {
             throw std::runtime_error("Cancelled");
         }
     });
     parser.loadMetar();
+    return updated;
 }
 
-void MetarLoader::onMetarLoaded(const MetarData& metar) {
+bool MetarLoader::onMetarLoaded(const MetarData& metar, MetarRecords &known) {
+    std::string record = metar.timestamp + '\n' + metar.metar;
+    auto &last = known[metar.icaoCode];
+    if (last == record) {
+        // most stations don't report again between two downloads
+        return false;
+    }
+    last = std::move(record);
+
     auto airport = world->findAirportByID(metar.icaoCode);
     if (airport) {
         airport->setCurrentMetar(metar.timestamp, metar.metar);
+        return true;
     }
+    return false;
 }
 
 } /* namespace xdata */
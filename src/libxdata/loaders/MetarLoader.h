@@ -19,21 +19,29 @@
 #define SRC_LIBXDATA_LOADERS_METARLOADER_H_
 
 #include <memory>
-#include "src/world/LoadManager.h"
+#include <string>
+#include <functional>
+#include <unordered_map>
 #include "../XWorld.h"
 #include "../parsers/objects/MetarData.h"
 
 namespace xdata {
 
+// The timestamp and METAR last seen for each ICAO code
+using MetarRecords = std::unordered_map<std::string, std::string>;
+
 class MetarLoader {
 public:
-    MetarLoader(std::shared_ptr<world::LoadManager> mgr);
-    void load(const std::string &file);
+    MetarLoader(std::shared_ptr<XWorld> world, std::function<bool()> cancelled);
+
+    // Applies the records that differ from the known ones and updates them,
+    // returns the number of airports that got a new METAR
+    size_t load(const std::string &file, MetarRecords &known);
 private:
-    std::shared_ptr<world::LoadManager> const loadMgr;
     std::shared_ptr<XWorld> world;
+    std::function<bool()> cancelled;
 
-    void onMetarLoaded(const MetarData &metar);
+    bool onMetarLoaded(const MetarData &metar, MetarRecords &known);
 };
 
 } /* namespace xdata */
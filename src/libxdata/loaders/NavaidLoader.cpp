@@ -15,6 +15,8 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <stdexcept>
+#include <sstream>
 #include "NavaidLoader.h"
 #include "src/libxdata/parsers/NavaidParser.h"
 #include "src/world/models/navaids/Fix.h"
@@ -28,8 +30,24 @@ NavaidLoader::NavaidLoader(std::shared_ptr<world::LoadManager> mgr):
 }
 
 void NavaidLoader::load(const std::string& file) {
+    link(parse(file));
+}
+
+std::vector<NavaidData> NavaidLoader::parse(const std::string& file) const {
+    std::vector<NavaidData> navaids;
     NavaidParser parser(file);
-    parser.setAcceptor([this] (const NavaidData &data) {
+    parser.setAcceptor([this, &navaids] (const NavaidData &data) {
+        navaids.push_back(data);
+        if (loadMgr->shouldCancelLoading()) {
+            throw std::runtime_error("Cancelled");
+        }
+    });
+    parser.loadNavaids();
+    return navaids;
+}
+
+void NavaidLoader::link(const std::vector<NavaidData> &navaids) {
+    for (auto &data: navaids) {
         try {
             onNavaidLoaded(data);
         } catch (const std::exception &e) {
@@ -38,8 +56,7 @@ void NavaidLoader::load(const std::string& file) {
         if (loadMgr->shouldCancelLoading()) {
             throw std::runtime_error("Cancelled");
         }
-    });
-    parser.loadNavaids();
+    }
 }
 
 void NavaidLoader::onNavaidLoaded(const NavaidData& navaid) {
@@ -56,7 +73,7 @@ void NavaidLoader::onNavaidLoaded(const NavaidData& navaid) {
     if (!fix || dontPair) {
         world::Location location(navaid.latitude, navaid.longitude);
         auto region = world->findOrCreateRegion(navaid.icaoRegion);
-        fix = std::make_shared<world::Fix>(region, navaid.id, location);
+        fix = world->create<world::Fix>(region, navaid.id, location);
         world->addFix(fix);
     }
 
@@ -18,6 +18,7 @@
 
 #include "ProcedureOptions.h"
 #include <sstream>
+#include <algorithm>
 
 namespace xdata {
 
@@ -44,6 +45,30 @@ void ProcedureOptions::attachEnrouteTransitions(const world::NavNodeList& nodes)
     enrouteTransitions.push_back(nodes);
 }
 
+std::vector<world::NavNodeList> ProcedureOptions::getOptionPaths() const
+{
+    std::vector<world::NavNodeList> paths;
+
+    for (auto &it: runwayTransitions) {
+        paths.push_back(it.second);
+        auto &path = paths.back();
+        if (std::find(path.begin(), path.end(), it.first) == path.end()) {
+            path.insert(path.begin(), it.first);
+        }
+    }
+
+    for (auto &it: commonRoutes) {
+        paths.push_back(it.second);
+        auto &path = paths.back();
+        if (it.first && std::find(path.begin(), path.end(), it.first) == path.end()) {
+            path.insert(path.begin(), it.first);
+        }
+    }
+
+    paths.insert(paths.end(), enrouteTransitions.begin(), enrouteTransitions.end());
+    return paths;
+}
+
 std::string ProcedureOptions::toDebugString() const
 {
     std::stringstream res;
@@ -37,6 +37,9 @@ public:
 
     std::string toDebugString() const;
 
+protected:
+    std::vector<world::NavNodeList> getOptionPaths() const;
+
 protected:
     std::map<std::shared_ptr<world::Runway>, world::NavNodeList> runwayTransitions;
     std::map<std::shared_ptr<world::NavNode>, world::NavNodeList> commonRoutes;
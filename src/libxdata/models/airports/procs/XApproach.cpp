@@ -70,6 +70,25 @@ world::NavNodeList XApproach::getWaypoints(std::shared_ptr<world::Runway> arriva
     return waypoints;
 }
 
+std::vector<world::NavNodeList> XApproach::getPaths() const
+{
+    std::vector<world::NavNodeList> paths;
+    for (auto &it: transitions) {
+        paths.push_back(it.second);
+    }
+
+    // the missed approach after the runway isn't drawn, same as in getWaypoints
+    world::NavNodeList finalApproach;
+    for (auto &node: approach) {
+        finalApproach.push_back(node);
+        if (node->isRunway()) {
+            break;
+        }
+    }
+    paths.push_back(finalApproach);
+    return paths;
+}
+
 std::string XApproach::toDebugString() const
 {
     std::stringstream res;
@@ -30,6 +30,7 @@ public:
     XApproach(const std::string &id);
 
     world::NavNodeList getWaypoints(std::shared_ptr<world::Runway> arrivalRwy, std::string appTransName) const override;
+    std::vector<world::NavNodeList> getPaths() const override;
     std::string toDebugString() const override;
 
     void addTransition(const std::string &id, const world::NavNodeList &nodes);
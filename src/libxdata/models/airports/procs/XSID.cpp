@@ -141,6 +141,11 @@ world::NavNodeList XSID::getWaypoints(std::shared_ptr<world::Runway> departureRw
     }
 }
 
+std::vector<world::NavNodeList> XSID::getPaths() const
+{
+    return getOptionPaths();
+}
+
 std::string XSID::toDebugString() const
 {
     return ProcedureOptions::toDebugString();
@@ -145,6 +145,11 @@ world::NavNodeList XSTAR::getWaypoints(std::shared_ptr<world::Runway> arrivalRwy
     return world::NavNodeList();
 }
 
+std::vector<world::NavNodeList> XSTAR::getPaths() const
+{
+    return getOptionPaths();
+}
+
 std::string XSTAR::toDebugString() const
 {
     return ProcedureOptions::toDebugString();
@@ -31,6 +31,7 @@ public:
     XSTAR(const std::string &id);
 
     world::NavNodeList getWaypoints(std::shared_ptr<world::Runway> arrivalRwy, std::string starTransName) const override;
+    std::vector<world::NavNodeList> getPaths() const override;
     std::string toDebugString() const override;
 
     void iterate(std::function<void(std::shared_ptr<world::Runway>, std::shared_ptr<world::Fix>, std::shared_ptr<world::NavNode>)> f) const;
@@ -19,6 +19,8 @@
 #include "src/libxdata/parsers/objects/AirportData.h"
 #include "src/world/models/airport/Runway.h"
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 
 namespace xdata {
 
@@ -28,6 +30,11 @@ AirportParser::AirportParser(const std::string& file):
     header = parser.parseHeader();
 }
 
+AirportParser::AirportParser(std::shared_ptr<const platform::MappedFile> file, size_t begin, size_t end):
+    parser(file, begin, end)
+{
+}
+
 void AirportParser::setAcceptor(Acceptor a) {
     acceptor = a;
 }
@@ -39,7 +46,75 @@ std::string AirportParser::getHeader() const {
 void AirportParser::loadAirports() {
     using namespace std::placeholders;
     curPort = {};
-    parser.eachLine(std::bind(&AirportParser::parseLine, this));
+    parser.eachRow(&AirportParser::isUsedRow, std::bind(&AirportParser::parseLine, this));
+    finishAirport(); // blocks and files without a trailing 99
+}
+
+std::vector<size_t> AirportParser::splitIntoBlocks(size_t parts) const {
+    auto file = parser.getFile();
+    size_t begin = parser.getOffset();
+    size_t end = file->size();
+    const char *data = file->data();
+
+    // airport, seaplane base and heliport headers: 1, 16 and 17
+    auto isAirportHeader = [data, end] (size_t pos) {
+        auto isBlank = [data, end] (size_t p) { return p >= end || data[p] == ' ' || data[p] == '\t'; };
+        if (pos >= end || data[pos] != '1') {
+            return false;
+        }
+        if (isBlank(pos + 1)) {
+            return true;
+        }
+        return pos + 1 < end && (data[pos + 1] == '6' || data[pos + 1] == '7') && isBlank(pos + 2);
+    };
+
+    std::vector<size_t> bounds;
+    bounds.push_back(begin);
+    size_t chunk = (end - begin) / std::max<size_t>(parts, 1);
+    for (size_t i = 1; i < parts && chunk > 0; ++i) {
+        size_t pos = std::max(begin + i * chunk, bounds.back());
+        while (pos < end) {
+            auto nl = static_cast<const char *>(std::memchr(data + pos, '\n', end - pos));
+            if (!nl) {
+                pos = end;
+                break;
+            }
+            pos = nl - data + 1;
+            if (isAirportHeader(pos)) {
+                break;
+            }
+        }
+        if (pos >= end) {
+            break;
+        }
+        if (pos > bounds.back()) {
+            bounds.push_back(pos);
+        }
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+std::shared_ptr<const platform::MappedFile> AirportParser::getFile() const {
+    return parser.getFile();
+}
+
+bool AirportParser::isUsedRow(int rowCode) {
+    // taxiways, pavement, markings, lights, signs and the taxi network are most
+    // of a modern apt.dat, none of them are used
+    switch (rowCode) {
+    case 1:
+    case 16:
+    case 17:
+    case 99:
+    case 100:
+    case 101:
+    case 102:
+    case 1302:
+        return true;
+    default:
+        return (rowCode >= 50 && rowCode <= 56) || (rowCode >= 1050 && rowCode <= 1056);
+    }
 }
 
 void AirportParser::parseLine() {
@@ -19,6 +19,8 @@
 #define SRC_LIBXDATA_PARSERS_AIRPORTPARSER_H_
 
 #include <string>
+#include <vector>
+#include <memory>
 #include <functional>
 #include "src/world/parsers/BaseParser.h"
 #include "objects/AirportData.h"
@@ -30,15 +32,23 @@ public:
     using Acceptor = std::function<void(const AirportData &)>;
 
     AirportParser(const std::string &file);
+    // parse the airport blocks in [begin, end) of a file that was opened before
+    AirportParser(std::shared_ptr<const platform::MappedFile> file, size_t begin, size_t end);
     void setAcceptor(Acceptor a);
     std::string getHeader() const;
     void loadAirports();
+
+    // Split the remaining data into at most `parts` ranges that start at
+    // airport headers. Returns the range boundaries as file offsets.
+    std::vector<size_t> splitIntoBlocks(size_t parts) const;
+    std::shared_ptr<const platform::MappedFile> getFile() const;
 private:
     Acceptor acceptor;
     std::string header;
     world::BaseParser parser;
     AirportData curPort;
 
+    static bool isUsedRow(int rowCode);
     void parseLine();
     void startAirport();
     void parseRunway();
@@ -21,6 +21,9 @@
 #include <curl/curl.h>
 #include "Downloader.h"
 #include "src/Logger.h"
+#include "src/charts/RequestStats.h"
+#include "src/platform/BandwidthScheduler.h"
+#include "src/platform/Metrics.h"
 
 namespace maps {
 
@@ -35,7 +38,7 @@ void Downloader::setHideURLs(bool hide) {
     hideURLs = hide;
 }
 
-std::vector<uint8_t> Downloader::download(const std::string& url, bool &cancel) {
+std::vector<uint8_t> Downloader::download(const std::string& url, std::atomic_bool &cancel) {
     if (!hideURLs) {
         logger::verbose("Downloading '%s'", url.c_str());
     } else {
@@ -43,8 +46,10 @@ std::vector<uint8_t> Downloader::download(const std::string& url, bool &cancel)
     }
 
     std::vector<uint8_t> downloadBuf;
+    platform::BandwidthScheduler::Transfer bandwidth(platform::BandwidthScheduler::Traffic::INTERACTIVE);
 
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE, (curl_off_t) bandwidth.getMaxSpeed());
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "AviTab " AVITAB_VERSION_STR);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
@@ -58,19 +63,20 @@ std::vector<uint8_t> Downloader::download(const std::string& url, bool &cancel)
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, onData);
 
     CURLcode code = curl_easy_perform(curl);
+    apis::RequestStats::shared().recordTransfer(curl, code);
 
     if (code != CURLE_OK) {
         if (code == CURLE_ABORTED_BY_CALLBACK) {
             throw std::out_of_range("Cancelled");
         } else {
-            throw std::runtime_error(std::string("Download error: ") + curl_easy_strerror(code));
+            throw DownloadError(std::string("Download error: ") + curl_easy_strerror(code), 0, code == CURLE_OPERATION_TIMEDOUT);
         }
     }
 
     long httpStatus = 0;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpStatus);
     if (httpStatus != 200) {
-        throw std::runtime_error(std::string("Download error - HTTP status " + std::to_string(httpStatus)));
+        throw DownloadError(std::string("Download error - HTTP status " + std::to_string(httpStatus)), httpStatus, false);
     }
 
     return downloadBuf;
@@ -81,6 +87,8 @@ size_t Downloader::onData(void* buffer, size_t size, size_t nmemb, void* vecPtr)
     if (!vec) {
         return 0;
     }
+    static auto &downloaded = platform::Metrics::counter("net/downloaded_bytes");
+    downloaded.add(size * nmemb);
     size_t pos = vec->size();
     vec->resize(pos + size * nmemb);
     std::memcpy(vec->data() + pos, buffer, size * nmemb);
@@ -88,7 +96,7 @@ size_t Downloader::onData(void* buffer, size_t size, size_t nmemb, void* vecPtr)
 }
 
 int Downloader::onProgress(void* client, curl_off_t dlTotal, curl_off_t dlNow, curl_off_t ulTotal, curl_off_t ulNow) {
-    bool *cancel = reinterpret_cast<bool *>(client);
+    std::atomic_bool *cancel = reinterpret_cast<std::atomic_bool *>(client);
     return *cancel;
 }
 
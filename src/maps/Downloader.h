@@ -22,15 +22,38 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <atomic>
+#include <stdexcept>
 #include <curl/curl.h>
 
 namespace maps {
 
+class DownloadError: public std::runtime_error {
+public:
+    DownloadError(const std::string &msg, long httpStatus, bool timeout):
+        std::runtime_error(msg), httpStatus(httpStatus), timeout(timeout) { }
+
+    // 0 if the transfer itself failed
+    long getHttpStatus() const { return httpStatus; }
+    bool isTimeout() const { return timeout; }
+private:
+    long httpStatus;
+    bool timeout;
+};
+
+// Validators for a conditional request and the caching headers of the response
+struct HttpCacheInfo {
+    std::string etag;
+    std::string lastModified;
+    long maxAge = -1; // from Cache-Control, -1 if not sent
+    bool notModified = false;
+};
+
 class Downloader {
 public:
     Downloader();
     void setHideURLs(bool hide);
-    std::vector<uint8_t> download(const std::string &url, bool &cancel);
+    std::vector<uint8_t> download(const std::string &url, std::atomic_bool &cancel);
     ~Downloader();
 private:
     CURL *curl = nullptr;
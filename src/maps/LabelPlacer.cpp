@@ -0,0 +1,91 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include "LabelPlacer.h"
+
+namespace maps {
+
+void LabelPlacer::declutter(const std::vector<std::shared_ptr<OverlayedNode>> &nodes, int width, int height) {
+    struct Candidate {
+        OverlayedNode *node;
+        OverlayedNode::LabelPriority priority;
+        int distance;
+        OverlayedNode::TextBox box;
+    };
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(nodes.size());
+    for (auto &on: nodes) {
+        OverlayedNode::TextBox box;
+        on->setTextHidden(false);
+        if (!on->getTextBox(box)) {
+            continue;
+        }
+        // prefer labels near the middle of the view when priorities are equal
+        int distance = std::abs((box.x0 + box.x1) / 2 - width / 2) + std::abs((box.y0 + box.y1) / 2 - height / 2);
+        candidates.push_back(Candidate{on.get(), on->getLabelPriority(), distance, box});
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [] (const Candidate &a, const Candidate &b) {
+        if (a.priority != b.priority) {
+            return a.priority > b.priority;
+        }
+        return a.distance < b.distance;
+    });
+
+    reset(width, height);
+    for (auto &c: candidates) {
+        c.node->setTextHidden(!place(c.box));
+    }
+}
+
+void LabelPlacer::reset(int width, int height) {
+    columns = (width + CELL_SIZE - 1) / CELL_SIZE;
+    rows = (height + CELL_SIZE - 1) / CELL_SIZE;
+    occupied.assign(columns * rows, 0);
+}
+
+bool LabelPlacer::place(const OverlayedNode::TextBox &box) {
+    if (box.x1 < 0 || box.y1 < 0) {
+        // entirely off-screen, keeps nothing else from being shown
+        return true;
+    }
+    int c0 = std::max(box.x0 / CELL_SIZE, 0);
+    int c1 = std::min(box.x1 / CELL_SIZE, columns - 1);
+    int r0 = std::max(box.y0 / CELL_SIZE, 0);
+    int r1 = std::min(box.y1 / CELL_SIZE, rows - 1);
+    if (c0 > c1 || r0 > r1) {
+        // entirely off-screen, keeps nothing else from being shown
+        return true;
+    }
+
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            if (occupied[r * columns + c]) {
+                return false;
+            }
+        }
+    }
+    for (int r = r0; r <= r1; r++) {
+        std::fill(occupied.begin() + r * columns + c0, occupied.begin() + r * columns + c1 + 1, 1);
+    }
+    return true;
+}
+
+} /* namespace maps */
@@ -0,0 +1,48 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "OverlayedNode.h"
+
+namespace maps {
+
+/*
+ * Greedy label placement: labels are offered in priority order and each one
+ * is kept only if its box does not touch a box that was kept before it.
+ * Occupancy is tracked on a coarse screen grid, so every test is bounded by
+ * the size of the label rather than the number of labels already placed.
+ */
+class LabelPlacer {
+public:
+    // hides the compact text of every node that would overlap a more important one
+    void declutter(const std::vector<std::shared_ptr<OverlayedNode>> &nodes, int width, int height);
+
+private:
+    static constexpr const int CELL_SIZE = 4;
+
+    int columns = 0, rows = 0;
+    std::vector<uint8_t> occupied;
+
+    void reset(int width, int height);
+    bool place(const OverlayedNode::TextBox &box);
+};
+
+} /* namespace maps */
@@ -0,0 +1,401 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include "MultiDownloader.h"
+#include "src/platform/CrashHandler.h"
+#include "src/Logger.h"
+#include "src/charts/RequestStats.h"
+#include "src/platform/BandwidthScheduler.h"
+#include "src/platform/Metrics.h"
+#include "src/platform/Tracer.h"
+
+namespace maps {
+
+MultiDownloader::MultiDownloader(int maxConnectionsPerHost, int maxConnections) {
+    multi = curl_multi_init();
+    if (!multi) {
+        throw std::runtime_error("Couldn't initialize curl");
+    }
+
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) maxConnectionsPerHost);
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long) maxConnections);
+}
+
+void MultiDownloader::setHideURLs(bool hide) {
+    hideURLs = hide;
+}
+
+std::vector<uint8_t> MultiDownloader::download(const std::string &url, std::atomic_bool &cancel, HttpCacheInfo *cacheInfo,
+                                              const std::vector<std::string> &requestHeaders) {
+    logDownload(url);
+
+    Transfer transfer;
+    start(transfer, url, cancel, cacheInfo, requestHeaders);
+    waitFinished(transfer);
+    release(transfer);
+    return takeResult(transfer, cacheInfo);
+}
+
+std::vector<uint8_t> MultiDownloader::downloadHedged(const std::string &url, const std::string &hedgeURL,
+                                                    std::chrono::milliseconds hedgeAfter, std::atomic_bool &cancel,
+                                                    HttpCacheInfo *cacheInfo, HedgeOutcome &outcome) {
+    logDownload(url);
+    outcome = HedgeOutcome{};
+
+    Transfer primary, hedge;
+    start(primary, url, cancel, cacheInfo, {});
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    if (!doneCondition.wait_for(lock, hedgeAfter, [&primary] { return primary.finished; })) {
+        lock.unlock();
+        logDownload(hedgeURL);
+        try {
+            start(hedge, hedgeURL, cancel, cacheInfo, {});
+            outcome.hedged = true;
+        } catch (const std::out_of_range &e) {
+            // shutting down, the primary gets cancelled as well
+        }
+        lock.lock();
+
+        // the first answer wins, a failure waits for the other transfer
+        doneCondition.wait(lock, [&primary, &hedge, &outcome] {
+            if (primary.finished && (isAnswer(primary) || !outcome.hedged || hedge.finished)) {
+                return true;
+            }
+            return outcome.hedged && hedge.finished && isAnswer(hedge);
+        });
+        outcome.hedgeWon = outcome.hedged && hedge.finished && isAnswer(hedge) &&
+                           !(primary.finished && isAnswer(primary));
+    }
+    lock.unlock();
+
+    if (outcome.hedged) {
+        Transfer &loser = outcome.hedgeWon ? primary : hedge;
+        loser.abandoned = true;
+        curl_multi_wakeup(multi);
+        waitFinished(loser);
+        release(hedge);
+    }
+    release(primary);
+
+    return takeResult(outcome.hedgeWon ? hedge : primary, cacheInfo);
+}
+
+void MultiDownloader::logDownload(const std::string &url) {
+    if (!hideURLs) {
+        logger::verbose("Downloading '%s'", url.c_str());
+    } else {
+        logger::verbose("Downloading...");
+    }
+}
+
+void MultiDownloader::start(Transfer &transfer, const std::string &url, std::atomic_bool &cancel,
+                            const HttpCacheInfo *cacheInfo, const std::vector<std::string> &requestHeaders) {
+    transfer.easy = takeHandle();
+    transfer.cancel = &cancel;
+    transfer.bandwidth = std::make_unique<platform::BandwidthScheduler::Transfer>(platform::BandwidthScheduler::Traffic::INTERACTIVE);
+
+    CURL *curl = transfer.easy;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "AviTab " AVITAB_VERSION_STR);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    // all encodings that curl can decode, vector tiles compress well
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+
+    // prefer multiplexing on an existing connection over opening a new one
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE, (curl_off_t) transfer.bandwidth->getMaxSpeed());
+
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, onProgress);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void *) &transfer);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &transfer.data);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, onData);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *) &transfer);
+
+    for (auto &header: requestHeaders) {
+        transfer.headers = curl_slist_append(transfer.headers, header.c_str());
+    }
+    if (cacheInfo) {
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, onHeader);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *) &transfer);
+        if (!cacheInfo->etag.empty()) {
+            transfer.headers = curl_slist_append(transfer.headers, ("If-None-Match: " + cacheInfo->etag).c_str());
+        }
+        if (!cacheInfo->lastModified.empty()) {
+            transfer.headers = curl_slist_append(transfer.headers, ("If-Modified-Since: " + cacheInfo->lastModified).c_str());
+        }
+    }
+    if (transfer.headers) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer.headers);
+    }
+
+    bool stopped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = !keepAlive;
+        if (!stopped) {
+            pendingTransfers.push_back(&transfer);
+            if (!worker.joinable()) {
+                // started on demand as many sources are created without ever loading a tile
+                worker = std::thread(&MultiDownloader::run, this);
+            }
+        }
+    }
+    if (stopped) {
+        release(transfer);
+        throw std::out_of_range("Cancelled");
+    }
+    curl_multi_wakeup(multi);
+}
+
+void MultiDownloader::waitFinished(Transfer &transfer) {
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCondition.wait(lock, [&transfer] { return transfer.finished; });
+}
+
+void MultiDownloader::release(Transfer &transfer) {
+    returnHandle(transfer.easy);
+    curl_slist_free_all(transfer.headers);
+    transfer.headers = nullptr;
+    transfer.bandwidth.reset();
+}
+
+std::vector<uint8_t> MultiDownloader::takeResult(Transfer &transfer, HttpCacheInfo *cacheInfo) {
+    if (transfer.result != CURLE_OK) {
+        if (transfer.result == CURLE_ABORTED_BY_CALLBACK) {
+            throw std::out_of_range("Cancelled");
+        } else {
+            throw DownloadError(std::string("Download error: ") + curl_easy_strerror(transfer.result), 0,
+                                transfer.result == CURLE_OPERATION_TIMEDOUT);
+        }
+    }
+
+    if (cacheInfo) {
+        *cacheInfo = transfer.response;
+        if (transfer.httpStatus == 304) {
+            cacheInfo->notModified = true;
+            return {};
+        }
+    }
+
+    if (transfer.httpStatus != 200) {
+        throw DownloadError(std::string("Download error - HTTP status " + std::to_string(transfer.httpStatus)),
+                            transfer.httpStatus, false);
+    }
+
+    return std::move(transfer.data);
+}
+
+bool MultiDownloader::isAnswer(const Transfer &transfer) {
+    // client errors like 404 would be the same on every server
+    long status = transfer.httpStatus;
+    return transfer.result == CURLE_OK && status > 0 && status < 500 && status != 429;
+}
+
+void MultiDownloader::run() {
+    crash::ThreadCookie crashCookie;
+    platform::Tracer::setThreadName("downloader");
+
+    while (keepAlive) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto transfer: pendingTransfers) {
+                if (curl_multi_add_handle(multi, transfer->easy) == CURLM_OK) {
+                    activeTransfers.insert(transfer);
+                } else {
+                    finish(transfer, CURLE_FAILED_INIT);
+                }
+            }
+            pendingTransfers.clear();
+        }
+
+        // losers of hedged requests
+        for (auto it = activeTransfers.begin(); it != activeTransfers.end();) {
+            Transfer *transfer = *it;
+            if (transfer->abandoned) {
+                curl_multi_remove_handle(multi, transfer->easy);
+                it = activeTransfers.erase(it);
+                finish(transfer, CURLE_ABORTED_BY_CALLBACK);
+            } else {
+                ++it;
+            }
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int queued = 0;
+        CURLMsg *msg;
+        while ((msg = curl_multi_info_read(multi, &queued))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            // msg becomes invalid when the handle is removed
+            CURL *easy = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            char *priv = nullptr;
+            curl_easy_getinfo(easy, CURLINFO_PRIVATE, &priv);
+            Transfer *transfer = reinterpret_cast<Transfer *>(priv);
+
+            curl_multi_remove_handle(multi, easy);
+            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &transfer->httpStatus);
+            apis::RequestStats::shared().recordTransfer(easy, result);
+            activeTransfers.erase(transfer);
+            finish(transfer, result);
+        }
+
+        curl_multi_poll(multi, nullptr, 0, POLL_TIMEOUT_MS, nullptr);
+    }
+
+    // fail everything that is still running so that no caller keeps waiting
+    for (auto transfer: activeTransfers) {
+        curl_multi_remove_handle(multi, transfer->easy);
+        finish(transfer, CURLE_ABORTED_BY_CALLBACK);
+    }
+    activeTransfers.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto transfer: pendingTransfers) {
+        finish(transfer, CURLE_ABORTED_BY_CALLBACK);
+    }
+    pendingTransfers.clear();
+}
+
+void MultiDownloader::finish(Transfer *transfer, CURLcode result) {
+    {
+        std::lock_guard<std::mutex> lock(doneMutex);
+        transfer->result = result;
+        transfer->finished = true;
+    }
+    doneCondition.notify_all();
+}
+
+CURL *MultiDownloader::takeHandle() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idleHandles.empty()) {
+            CURL *easy = idleHandles.back();
+            idleHandles.pop_back();
+            return easy;
+        }
+    }
+
+    CURL *easy = curl_easy_init();
+    if (!easy) {
+        throw std::runtime_error("Couldn't initialize curl");
+    }
+    return easy;
+}
+
+void MultiDownloader::returnHandle(CURL *easy) {
+    curl_easy_reset(easy);
+    std::lock_guard<std::mutex> lock(mutex);
+    idleHandles.push_back(easy);
+}
+
+size_t MultiDownloader::onHeader(char *buffer, size_t size, size_t nitems, void *transferPtr) {
+    Transfer *transfer = reinterpret_cast<Transfer *>(transferPtr);
+    std::string line(buffer, size * nitems);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+        line.pop_back();
+    }
+
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        // new response after a redirect
+        transfer->response = HttpCacheInfo{};
+        return size * nitems;
+    }
+
+    auto colon = line.find(':');
+    if (colon == std::string::npos) {
+        return size * nitems;
+    }
+
+    std::string key = line.substr(0, colon);
+    std::transform(key.begin(), key.end(), key.begin(), [] (unsigned char c) { return std::tolower(c); });
+    size_t valueStart = line.find_first_not_of(' ', colon + 1);
+    std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+
+    if (key == "etag") {
+        transfer->response.etag = value;
+    } else if (key == "last-modified") {
+        transfer->response.lastModified = value;
+    } else if (key == "cache-control") {
+        std::string lower = value;
+        std::transform(lower.begin(), lower.end(), lower.begin(), [] (unsigned char c) { return std::tolower(c); });
+        auto pos = lower.find("max-age=");
+        if (lower.find("no-cache") != std::string::npos || lower.find("no-store") != std::string::npos) {
+            transfer->response.maxAge = 0;
+        } else if (pos != std::string::npos) {
+            try {
+                transfer->response.maxAge = std::stol(lower.substr(pos + 8));
+            } catch (const std::exception &e) {
+                // ignore malformed header
+            }
+        }
+    }
+
+    return size * nitems;
+}
+
+size_t MultiDownloader::onData(void* buffer, size_t size, size_t nmemb, void* vecPtr) {
+    std::vector<uint8_t> *vec = reinterpret_cast<std::vector<uint8_t> *>(vecPtr);
+    if (!vec) {
+        return 0;
+    }
+    static auto &downloaded = platform::Metrics::counter("net/downloaded_bytes");
+    downloaded.add(size * nmemb);
+    size_t pos = vec->size();
+    vec->resize(pos + size * nmemb);
+    std::memcpy(vec->data() + pos, buffer, size * nmemb);
+    return size * nmemb;
+}
+
+int MultiDownloader::onProgress(void* client, curl_off_t dlTotal, curl_off_t dlNow, curl_off_t ulTotal, curl_off_t ulNow) {
+    Transfer *transfer = reinterpret_cast<Transfer *>(client);
+    return *transfer->cancel || transfer->abandoned;
+}
+
+MultiDownloader::~MultiDownloader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        keepAlive = false;
+    }
+    curl_multi_wakeup(multi);
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    for (auto easy: idleHandles) {
+        curl_easy_cleanup(easy);
+    }
+    curl_multi_cleanup(multi);
+}
+
+} /* namespace maps */
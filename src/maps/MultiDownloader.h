@@ -0,0 +1,118 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <vector>
+#include <set>
+#include <memory>
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <curl/curl.h>
+#include "Downloader.h"
+#include "src/platform/BandwidthScheduler.h"
+
+namespace maps {
+
+// Runs all transfers on one curl multi handle so that they share connections,
+// use HTTP/2 multiplexing where available and respect per-host limits.
+// download() can be called from multiple threads at once.
+class MultiDownloader {
+public:
+    struct HedgeOutcome {
+        // the request was also sent to the second URL
+        bool hedged = false;
+        // the result is the second URL's
+        bool hedgeWon = false;
+    };
+
+    MultiDownloader(int maxConnectionsPerHost, int maxConnections);
+    void setHideURLs(bool hide);
+
+    // Blocks until the transfer finished, throws std::out_of_range if cancelled
+    // and DownloadError on failures. If cacheInfo is given, its validators are
+    // sent and it receives the caching headers. A 304 then returns no data
+    // and sets notModified. requestHeaders are sent as they are, e.g. for authorization.
+    std::vector<uint8_t> download(const std::string &url, std::atomic_bool &cancel, HttpCacheInfo *cacheInfo = nullptr,
+                                  const std::vector<std::string> &requestHeaders = {});
+
+    // Like download, but if the first URL didn't answer within hedgeAfter, the request
+    // is also sent to hedgeURL. The first answer wins and the other transfer is cancelled.
+    // Server errors and network failures aren't answers, the other transfer is awaited then.
+    // If both fail, the first URL's error is thrown.
+    std::vector<uint8_t> downloadHedged(const std::string &url, const std::string &hedgeURL,
+                                        std::chrono::milliseconds hedgeAfter, std::atomic_bool &cancel,
+                                        HttpCacheInfo *cacheInfo, HedgeOutcome &outcome);
+
+    ~MultiDownloader();
+private:
+    static constexpr const int POLL_TIMEOUT_MS = 100;
+
+    struct Transfer {
+        CURL *easy = nullptr;
+        struct curl_slist *headers = nullptr;
+        std::unique_ptr<platform::BandwidthScheduler::Transfer> bandwidth;
+        std::atomic_bool *cancel = nullptr;
+        // lost a hedged race, the worker removes it
+        std::atomic_bool abandoned { false };
+        std::vector<uint8_t> data;
+        HttpCacheInfo response;
+        CURLcode result = CURLE_OK;
+        long httpStatus = 0;
+        // guarded by doneMutex
+        bool finished = false;
+    };
+
+    CURLM *multi = nullptr;
+    std::atomic_bool hideURLs { false };
+    std::atomic_bool keepAlive { true };
+    std::thread worker;
+
+    std::mutex mutex;
+    std::vector<Transfer *> pendingTransfers;
+    std::vector<CURL *> idleHandles;
+
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+
+    // only accessed by the worker
+    std::set<Transfer *> activeTransfers;
+
+    void start(Transfer &transfer, const std::string &url, std::atomic_bool &cancel, const HttpCacheInfo *cacheInfo,
+               const std::vector<std::string> &requestHeaders);
+    void waitFinished(Transfer &transfer);
+    void release(Transfer &transfer);
+    std::vector<uint8_t> takeResult(Transfer &transfer, HttpCacheInfo *cacheInfo);
+    void logDownload(const std::string &url);
+    static bool isAnswer(const Transfer &transfer);
+
+    void run();
+    void finish(Transfer *transfer, CURLcode result);
+    CURL *takeHandle();
+    void returnHandle(CURL *easy);
+
+    static size_t onHeader(char *buffer, size_t size, size_t nitems, void *transferPtr);
+    static size_t onData(void *buffer, size_t size, size_t nmemb, void *resPtr);
+    static int onProgress(void *client, curl_off_t dlTotal, curl_off_t dlNow, curl_off_t ulTotal, curl_off_t ulNow);
+};
+
+} /* namespace maps */
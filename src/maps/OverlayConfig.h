@@ -19,6 +19,7 @@
 #define SRC_MAPS_OVERLAY_CONFIG_H_
 
 #include <string>
+#include <cstdint>
 
 namespace maps {
 
@@ -39,6 +40,20 @@ struct OverlayConfig {
     bool drawPOIs = false;
     bool drawVRPs = false;
     bool drawMarkers = false;
+    bool drawWeather = false;
+    // diagnostics, not part of what is drawn and so left out of ==
+    int frameBudgetMs = 0; // 0: draw every layer on every frame
+    bool showTimings = false;
+
+    bool operator==(const OverlayConfig &o) const {
+        return drawMyAircraft == o.drawMyAircraft && drawOtherAircraft == o.drawOtherAircraft &&
+               drawRoute == o.drawRoute && colorOtherAircraftBelow == o.colorOtherAircraftBelow &&
+               colorOtherAircraftSame == o.colorOtherAircraftSame && colorOtherAircraftAbove == o.colorOtherAircraftAbove &&
+               drawAirports == o.drawAirports && drawAirstrips == o.drawAirstrips &&
+               drawHeliportsSeaports == o.drawHeliportsSeaports && drawVORs == o.drawVORs &&
+               drawNDBs == o.drawNDBs && drawILSs == o.drawILSs && drawWaypoints == o.drawWaypoints &&
+               drawPOIs == o.drawPOIs && drawVRPs == o.drawVRPs && drawMarkers == o.drawMarkers && drawWeather == o.drawWeather;
+    }
 };
 
 } /* namespace maps */
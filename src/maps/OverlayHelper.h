@@ -18,6 +18,7 @@
 #ifndef SRC_MAPS_OVERLAY_HELPER_H_
 #define SRC_MAPS_OVERLAY_HELPER_H_
 
+#include <cstddef>
 #include <memory>
 #include "OverlayConfig.h"
 #include "src/libimg/Image.h"
@@ -37,6 +38,8 @@ public:
     virtual void fastPolarToCartesian(float radius, int angleDegrees, double& x, double& y) const = 0;
     virtual void positionToPixel(double lat, double lon, int &px, int &py) const = 0;
     virtual void positionToPixel(double lat, double lon, int &px, int &py, int zoomLevel) const = 0;
+    // positionToPixel for count positions at once
+    virtual void positionsToPixels(const double *lats, const double *lons, size_t count, int *px, int *py) const = 0;
 
     virtual ~IOverlayHelper() = default;
 };
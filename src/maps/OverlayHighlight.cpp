@@ -26,6 +26,7 @@ void OverlayHighlight::reset()
 {
     active = false;
     distance = FAR_FAR_AWAY;
+    node.reset();
 }
 
 void OverlayHighlight::activate(int x, int y)
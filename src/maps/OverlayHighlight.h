@@ -30,6 +30,9 @@ public:
     void select();
     void highlight();
 
+    // the node that select() would pick, null if inactive
+    std::shared_ptr<OverlayedNode> getNode() const { return active ? node : nullptr; }
+
     virtual ~OverlayHighlight() = default;
 
 private:
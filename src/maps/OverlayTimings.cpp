@@ -0,0 +1,76 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include "OverlayTimings.h"
+
+namespace maps {
+
+const char *OverlayTimings::getLayerName(Layer layer) {
+    switch (layer) {
+    case NAV_WORLD:         return "nav";
+    case WEATHER:           return "weather";
+    case ROUTE:             return "route";
+    case SCRIPTS:           return "scripts";
+    case SCALE:             return "scale";
+    case OTHER_AIRCRAFT:    return "traffic";
+    case AIRCRAFT:          return "aircraft";
+    case CALIBRATION:       return "calibration";
+    case COMPASS:           return "compass";
+    case FRAME:             return "frame";
+    default:                return "?";
+    }
+}
+
+void OverlayTimings::record(Layer layer, double ms) {
+    Samples &s = layers[layer];
+    s.ms[s.next] = ms;
+    s.next = (s.next + 1) % WINDOW_SIZE;
+    s.count = std::min(s.count + 1, WINDOW_SIZE);
+}
+
+void OverlayTimings::recordDeferred(Layer layer) {
+    layers[layer].deferred++;
+}
+
+float OverlayTimings::getPercentile(Layer layer, float percentile) const {
+    const Samples &s = layers[layer];
+    if (s.count == 0) {
+        return 0;
+    }
+
+    std::array<float, WINDOW_SIZE> sorted;
+    std::copy(s.ms.begin(), s.ms.begin() + s.count, sorted.begin());
+    size_t rank = std::lround(std::clamp(percentile, 0.0f, 100.0f) / 100 * (s.count - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + s.count);
+    return sorted[rank];
+}
+
+float OverlayTimings::getLast(Layer layer) const {
+    const Samples &s = layers[layer];
+    if (s.count == 0) {
+        return 0;
+    }
+    return s.ms[(s.next + WINDOW_SIZE - 1) % WINDOW_SIZE];
+}
+
+uint32_t OverlayTimings::getDeferredCount(Layer layer) const {
+    return layers[layer].deferred;
+}
+
+} /* namespace maps */
@@ -0,0 +1,57 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace maps {
+
+/*
+ * Render time statistics of the map overlays. Every layer keeps a rolling
+ * window of its most recent draw times, from which percentiles are taken.
+ */
+class OverlayTimings {
+public:
+    // in drawing order, FRAME covers all layers drawn before the map is rotated
+    enum Layer { NAV_WORLD, WEATHER, ROUTE, SCRIPTS, SCALE, OTHER_AIRCRAFT, AIRCRAFT, CALIBRATION, COMPASS, FRAME, NUM_LAYERS };
+
+    static const char *getLayerName(Layer layer);
+
+    void record(Layer layer, double ms);
+    void recordDeferred(Layer layer);
+
+    // percentile in [0, 100] of the recorded window, 0 if nothing was recorded yet
+    float getPercentile(Layer layer, float percentile) const;
+    float getLast(Layer layer) const;
+    uint32_t getDeferredCount(Layer layer) const;
+
+private:
+    static constexpr const size_t WINDOW_SIZE = 64;
+
+    struct Samples {
+        std::array<float, WINDOW_SIZE> ms {};
+        size_t count = 0;
+        size_t next = 0;
+        uint32_t deferred = 0;
+    };
+    std::array<Samples, NUM_LAYERS> layers;
+};
+
+} /* namespace maps */
@@ -20,9 +20,17 @@
 #include <cmath>
 #include "OverlayedAirport.h"
 #include "src/world/World.h"
+#include "src/libimg/SpriteCache.h"
 
 namespace maps {
 
+namespace {
+// the flat projection around an airport, good enough for its extent
+constexpr const double METRES_PER_DEGREE = 6371000.0 * M_PI / 180.0;
+// distance of the points that give the pixels per metre, so that rounding them to whole pixels doesn't matter
+constexpr const double BASIS_DISTANCE = 10000;
+}
+
 OverlayedAirport::OverlayedAirport(IOverlayHelper *h, const world::Airport *a):
     OverlayedNode(h, true),
     airport(a)
@@ -48,11 +56,9 @@ void OverlayedAirport::drawGraphic() {
         if ((type == AerodromeType::HELIPORT) || (type == AerodromeType::SEAPORT) || (type == AerodromeType::AIRSTRIP)) {
             drawAirportICAORing();
         } else {
-            int xCentre = 0;
-            int yCentre = 0;
-            getRunwaysCentre(overlayHelper->getZoomLevel(), xCentre, yCentre);
-            int maxDistance = getMaxRunwayDistanceFromCentre(overlayHelper->getZoomLevel(), xCentre, yCentre);
-            if (maxDistance > ICAO_CIRCLE_RADIUS) {
+            Basis basis = getBasis(overlayHelper->getZoomLevel());
+            float pixelsPerMetre = std::max(std::hypot(basis.eastX, basis.eastY), std::hypot(basis.northX, basis.northY));
+            if (getGeometry().extent * pixelsPerMetre > ICAO_CIRCLE_RADIUS) {
                 drawAirportICAOGeographicRunways();
             } else {
                 drawAirportICAOCircleAndRwyPattern();
@@ -61,11 +67,7 @@ void OverlayedAirport::drawGraphic() {
     }
 }
 
-void OverlayedAirport::drawText(bool detailed) {
-    // Allow detailed text to be rendered for hotspots, even if just blob
-    if (isBlob() && !detailed) {
-        return;
-    }
+int OverlayedAirport::getTextTop() {
     // Place text below southern airport boundary and below symbol
     int yOffset = posY + ICAO_CIRCLE_RADIUS;
     auto &locDownRight = airport->getLocationDownRight();
@@ -74,18 +76,41 @@ void OverlayedAirport::drawText(bool detailed) {
         overlayHelper->positionToPixel(locDownRight.latitude, locDownRight.longitude, xIgnored, yOffset);
         yOffset += ICAO_CIRCLE_RADIUS;
     }
+    return yOffset;
+}
+
+bool OverlayedAirport::getTextBox(TextBox &box) {
+    if (isBlob()) {
+        return false;
+    }
+    box = getLabelBox(airport->getID(), 14, posX, getTextTop(), img::Align::CENTRE);
+    return true;
+}
+
+OverlayedNode::LabelPriority OverlayedAirport::getLabelPriority() const {
+    return airport->hasControlTower() ? LabelPriority::TOWERED_AIRFIELD : LabelPriority::AIRFIELD;
+}
+
+void OverlayedAirport::drawText(bool detailed) {
+    // Allow detailed text to be rendered for hotspots, even if just blob
+    if (isBlob() && !detailed) {
+        return;
+    }
+    int yOffset = getTextTop();
 
     auto mapImage = overlayHelper->getMapImage();
 
     if (detailed) {
-        std::string nameAndID = airport->getName() + " (" + airport->getID() + ")";
-        std::string elevationFeet = std::to_string(airport->getElevation());
-        int rwyLengthHundredsFeet = (airport->getLongestRunwayLength() * world::M_TO_FT) / 100.0;
-        std::string rwyLength = (rwyLengthHundredsFeet == 0) ? "" : (" " + std::to_string(rwyLengthHundredsFeet));
-        std::string atcInfo = airport->getInitialATCContactInfo();
-        std::string airportInfo = " " + elevationFeet + rwyLength + " " + atcInfo + " ";
-        mapImage->drawText(nameAndID,   14, posX, yOffset,      color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
-        mapImage->drawText(airportInfo, 12, posX, yOffset + 14, color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
+        if (detailedName.empty()) {
+            detailedName = airport->getName() + " (" + airport->getID() + ")";
+            std::string elevationFeet = std::to_string(airport->getElevation());
+            int rwyLengthHundredsFeet = (airport->getLongestRunwayLength() * world::M_TO_FT) / 100.0;
+            std::string rwyLength = (rwyLengthHundredsFeet == 0) ? "" : (" " + std::to_string(rwyLengthHundredsFeet));
+            std::string atcInfo = airport->getInitialATCContactInfo();
+            detailedInfo = " " + elevationFeet + rwyLength + " " + atcInfo + " ";
+        }
+        mapImage->drawText(detailedName, 14, posX, yOffset,      color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
+        mapImage->drawText(detailedInfo, 12, posX, yOffset + 14, color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
     } else {
         mapImage->drawText(airport->getID(), 14, posX, yOffset, color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
     }
@@ -124,125 +149,261 @@ void OverlayedAirport::drawAirportBlob() {
     }
 }
 
-void OverlayedAirport::getRunwaysCentre(int zoomLevel, int& xCentre, int &yCentre) {
+const OverlayedAirport::Geometry &OverlayedAirport::getGeometry() {
+    if (geometry) {
+        return *geometry;
+    }
+
+    geometry = std::make_unique<Geometry>();
     auto &locUpLeft    = airport->getLocationUpLeft();
     auto &locDownRight = airport->getLocationDownRight();
-    double latitudeCentre  = (locUpLeft.latitude +  locDownRight.latitude) / 2;
-    double longitudeCentre = (locUpLeft.longitude + locDownRight.longitude) / 2;
-    overlayHelper->positionToPixel(latitudeCentre, longitudeCentre, xCentre, yCentre, zoomLevel);
-}
-
-int OverlayedAirport::getMaxRunwayDistanceFromCentre(int zoomLevel, int xCentre, int yCentre) {
-    int maxDistance = 0;
-    airport->forEachRunway([this, zoomLevel, xCentre, yCentre, &maxDistance] (const std::shared_ptr<world::Runway> rwy) {
-        auto loc = rwy->getLocation();
-        int x, y;
-        overlayHelper->positionToPixel(loc.latitude, loc.longitude, x, y, zoomLevel);
-        maxDistance = std::max(maxDistance, (x - xCentre) * (x - xCentre) + (y - yCentre) * (y - yCentre));
+    if (locUpLeft.isValid() && locDownRight.isValid()) {
+        geometry->centreLat = (locUpLeft.latitude +  locDownRight.latitude) / 2;
+        geometry->centreLon = (locUpLeft.longitude + locDownRight.longitude) / 2;
+    } else {
+        geometry->centreLat = airport->getLocation().latitude;
+        geometry->centreLon = airport->getLocation().longitude;
+    }
+    geometry->cosLat = std::cos(geometry->centreLat * M_PI / 180.0);
+
+    Geometry &geo = *geometry;
+    auto toLocal = [&geo] (const world::Location &loc, float &east, float &north) {
+        east = (loc.longitude - geo.centreLon) * geo.cosLat * METRES_PER_DEGREE;
+        north = (loc.latitude - geo.centreLat) * METRES_PER_DEGREE;
+    };
+
+    airport->forEachRunwayPair([&geo, &toLocal] (const std::shared_ptr<world::Runway> rwy1, const std::shared_ptr<world::Runway> rwy2) {
+        RunwayShape shape;
+        toLocal(rwy1->getLocation(), shape.east1, shape.north1);
+        toLocal(rwy2->getLocation(), shape.east2, shape.north2);
+        shape.length = rwy1->getLength();
+        shape.width = rwy1->getWidth();
+        shape.surfColor = rwy1->hasHardSurface() ? img::COLOR_DARK_GREY :
+            rwy1->isWater() ? img::COLOR_ICAO_BLUE : img::COLOR_DARK_GREEN;
+        geo.runways.push_back(shape);
+    });
+
+    airport->forEachRunway([&geo, &toLocal] (const std::shared_ptr<world::Runway> rwy) {
+        float east, north;
+        toLocal(rwy->getLocation(), east, north);
+        if (!std::isnan(east) && !std::isnan(north)) {
+            geo.extent = std::max(geo.extent, std::hypot(east, north));
+        }
     });
-    return std::sqrt(maxDistance);
+
+    return geo;
+}
+
+OverlayedAirport::Basis OverlayedAirport::getBasis(int zoomLevel) {
+    auto &geo = getGeometry();
+    int cx, cy, ex, ey, nx, ny;
+    overlayHelper->positionToPixel(geo.centreLat, geo.centreLon, cx, cy, zoomLevel);
+    overlayHelper->positionToPixel(geo.centreLat, geo.centreLon + BASIS_DISTANCE / (METRES_PER_DEGREE * geo.cosLat), ex, ey, zoomLevel);
+    overlayHelper->positionToPixel(geo.centreLat + BASIS_DISTANCE / METRES_PER_DEGREE, geo.centreLon, nx, ny, zoomLevel);
+
+    Basis basis;
+    basis.eastX = (ex - cx) / BASIS_DISTANCE;
+    basis.eastY = (ey - cy) / BASIS_DISTANCE;
+    basis.northX = (nx - cx) / BASIS_DISTANCE;
+    basis.northY = (ny - cy) / BASIS_DISTANCE;
+    return basis;
 }
 
 void OverlayedAirport::drawAirportICAOGeographicRunways() {
-    drawRunwayRectangles(10, color);
-    drawRunwayRectangles( 3, img::COLOR_WHITE);
-}
-
-void OverlayedAirport::drawRunwayRectangles(float size, uint32_t rectColor) {
-    airport->forEachRunwayPair([this, size, rectColor](const std::shared_ptr<world::Runway> rwy1, const std::shared_ptr<world::Runway> rwy2) {
-        auto loc1 = rwy1->getLocation();
-        auto loc2 = rwy2->getLocation();
-        int x1, y1, x2, y2;
-        overlayHelper->positionToPixel(loc1.latitude, loc1.longitude, x1, y1);
-        overlayHelper->positionToPixel(loc2.latitude, loc2.longitude, x2, y2);
-        float angleDegrees = atan2((float)(y2 - y1), (float)(x2 - x1)) * 180.0 / M_PI;
-        float angleClockwiseCorner =      angleDegrees + 45;
-        float angleAnticlockwiseCorner  = angleDegrees - 45;
-        int xc = size * cos(angleClockwiseCorner * M_PI / 180.0);
-        int yc = size * sin(angleClockwiseCorner * M_PI / 180.0);
-        int xa = size * cos(angleAnticlockwiseCorner * M_PI / 180.0);
-        int ya = size * sin(angleAnticlockwiseCorner * M_PI / 180.0);
-        auto mapImage = overlayHelper->getMapImage();
-        mapImage->fillRectangle(x2 + xc, y2 + yc, x2 + xa, y2 + ya, x1 - xc, y1 - yc, x1 - xa, y1 - ya, rectColor);
-    });
+    auto &geo = getGeometry();
+    int xCentre, yCentre;
+    overlayHelper->positionToPixel(geo.centreLat, geo.centreLon, xCentre, yCentre);
+    drawDiagram(DiagramStyle::ICAO_RUNWAYS, xCentre, yCentre);
 }
 
-void OverlayedAirport::drawAirportICAORing() {
+void OverlayedAirport::drawDiagram(DiagramStyle style, int centreX, int centreY) {
+    auto &geo = getGeometry();
+    if (geo.runways.empty()) {
+        return;
+    }
+
+    // the pattern is scaled into the circle, the highest zoom level only gives its shape
+    int zoomLevel = (style == DiagramStyle::PATTERN) ? overlayHelper->getMaxZoomLevel() : overlayHelper->getZoomLevel();
+    Basis basis = getBasis(zoomLevel);
     auto mapImage = overlayHelper->getMapImage();
 
-    mapImage->fillCircle(posX, posY, ICAO_RING_RADIUS, color);
-    mapImage->fillCircle(posX, posY, ICAO_RING_RADIUS - 3, img::COLOR_WHITE);
+    // the rounded projections differ a bit from place to place, only a visible change counts
+    auto sameBasis = [&geo] (const Basis &a, const Basis &b) {
+        float diff = std::max({std::abs(a.eastX - b.eastX), std::abs(a.eastY - b.eastY),
+                               std::abs(a.northX - b.northX), std::abs(a.northY - b.northY)});
+        return diff * geo.extent < 1;
+    };
+    if (diagram.image && diagram.style == style && diagram.zoomLevel == zoomLevel && sameBasis(diagram.basis, basis)) {
+        mapImage->blendImage0(*diagram.image, centreX - diagram.originX, centreY - diagram.originY);
+        return;
+    }
+
+    // runway ends in pixels relative to the centre
+    std::vector<float> ends;
+    ends.reserve(geo.runways.size() * 4);
+    for (auto &rwy: geo.runways) {
+        ends.push_back(rwy.east1 * basis.eastX + rwy.north1 * basis.northX);
+        ends.push_back(rwy.east1 * basis.eastY + rwy.north1 * basis.northY);
+        ends.push_back(rwy.east2 * basis.eastX + rwy.north2 * basis.northX);
+        ends.push_back(rwy.east2 * basis.eastY + rwy.north2 * basis.northY);
+    }
+
+    float margin = 2;
+    if (style == DiagramStyle::PATTERN) {
+        float maxDistance = 0;
+        for (size_t i = 0; i < ends.size(); i += 2) {
+            maxDistance = std::max(maxDistance, std::hypot(ends[i], ends[i + 1]));
+        }
+        if (maxDistance == 0) {
+            return;
+        }
+        float scale = (ICAO_CIRCLE_RADIUS - 4) / maxDistance;
+        for (auto &v: ends) {
+            v *= scale;
+        }
+    } else if (style == DiagramStyle::ICAO_RUNWAYS) {
+        margin += 10;
+    } else {
+        float pixelsPerMetre = std::max(std::hypot(basis.eastX, basis.eastY), std::hypot(basis.northX, basis.northY));
+        for (auto &rwy: geo.runways) {
+            if (!std::isnan(rwy.width)) {
+                margin = std::max(margin, rwy.width * 1.1f * pixelsPerMetre + 2);
+            }
+        }
+    }
+
+    float minX = 0, minY = 0, maxX = 0, maxY = 0;
+    for (size_t i = 0; i < ends.size(); i += 2) {
+        if (std::isnan(ends[i]) || std::isnan(ends[i + 1])) {
+            continue;
+        }
+        minX = std::min(minX, ends[i]);
+        maxX = std::max(maxX, ends[i]);
+        minY = std::min(minY, ends[i + 1]);
+        maxY = std::max(maxY, ends[i + 1]);
+    }
+    int originX = (int) std::ceil(margin - minX);
+    int originY = (int) std::ceil(margin - minY);
+    int width = originX + (int) std::ceil(maxX + margin) + 1;
+    int height = originY + (int) std::ceil(maxY + margin) + 1;
+
+    if (width > MAX_DIAGRAM_SIZE || height > MAX_DIAGRAM_SIZE) {
+        diagram = Diagram();
+        drawRunways(*mapImage, style, ends, centreX, centreY);
+        return;
+    }
+
+    diagram.image = std::make_shared<img::Image>(width, height, 0x00FFFFFF);
+    drawRunways(*diagram.image, style, ends, originX, originY);
+    diagram.style = style;
+    diagram.zoomLevel = zoomLevel;
+    diagram.basis = basis;
+    diagram.originX = originX;
+    diagram.originY = originY;
+    mapImage->blendImage0(*diagram.image, centreX - originX, centreY - originY);
+}
+
+void OverlayedAirport::drawRunways(img::Image &dst, DiagramStyle style, const std::vector<float> &ends, float originX, float originY) {
+    switch (style) {
+    case DiagramStyle::GEOGRAPHIC:
+        // Draw the runways as on the ground, but with slightly exaggerated widths for visibility
+        for (size_t i = 0; i < geometry->runways.size(); i++) {
+            auto &rwy = geometry->runways[i];
+            if (std::isnan(rwy.length) || (rwy.length == 0) || std::isnan(rwy.width) || (rwy.width == 0)) {
+                continue;
+            }
+            float x1 = originX + ends[4 * i], y1 = originY + ends[4 * i + 1];
+            float x2 = originX + ends[4 * i + 2], y2 = originY + ends[4 * i + 3];
+            float aspectRatio = rwy.length / (rwy.width * 1.1);
+            float xo = (x1 - x2) / aspectRatio;
+            float yo = (y1 - y2) / aspectRatio;
+            if ((std::abs(xo) < 1) && (std::abs(yo) < 1)) {
+                const float xy[4] = {x1, y1, x2, y2};
+                dst.strokePolyline(xy, 2, 1, rwy.surfColor);
+            } else {
+                const float xy[8] = {x1 + yo, y1 - xo, x1 - yo, y1 + xo, x2 - yo, y2 + xo, x2 + yo, y2 - xo};
+                dst.fillPolygon(xy, 4, rwy.surfColor);
+            }
+        }
+        break;
+    case DiagramStyle::ICAO_RUNWAYS:
+        drawRunwayRectangles(dst, ends, originX, originY, 10, color);
+        drawRunwayRectangles(dst, ends, originX, originY,  3, img::COLOR_WHITE);
+        break;
+    case DiagramStyle::PATTERN:
+        for (size_t i = 0; i < ends.size(); i += 4) {
+            const float xy[4] = {originX + ends[i], originY + ends[i + 1], originX + ends[i + 2], originY + ends[i + 3]};
+            dst.strokePolyline(xy, 2, 1, img::COLOR_WHITE);
+        }
+        break;
+    }
+}
+
+void OverlayedAirport::drawRunwayRectangles(img::Image &dst, const std::vector<float> &ends, float originX, float originY, float size, uint32_t rectColor) {
+    for (size_t i = 0; i < ends.size(); i += 4) {
+        float x1 = originX + ends[i], y1 = originY + ends[i + 1];
+        float x2 = originX + ends[i + 2], y2 = originY + ends[i + 3];
+        float angle = std::atan2(y2 - y1, x2 - x1);
+        float xc = size * std::cos(angle + M_PI / 4);
+        float yc = size * std::sin(angle + M_PI / 4);
+        float xa = size * std::cos(angle - M_PI / 4);
+        float ya = size * std::sin(angle - M_PI / 4);
+        const float xy[8] = {x2 + xc, y2 + yc, x2 + xa, y2 + ya, x1 - xc, y1 - yc, x1 - xa, y1 - ya};
+        dst.fillPolygon(xy, 4, rectColor);
+    }
+}
+
+void OverlayedAirport::drawAirportICAORing() {
+    RingSymbol symbol = RingSymbol::NONE;
     if (airport->hasOnlyHeliports()) {
-        // Draw 'H'
-        mapImage->drawLine(posX - 3, posY - 5, posX - 3, posY + 5, color); // Left vertical
-        mapImage->drawLine(posX + 3, posY - 5, posX + 3, posY + 5, color); // Right vertical
-        mapImage->drawLine(posX - 3, posY    , posX + 3, posY    , color); // Horizonatal
+        symbol = RingSymbol::HELIPORT;
     } else if (airport->hasOnlyWaterRunways()) {
+        symbol = RingSymbol::WATER;
+    }
+
+    auto key = img::SpriteCache::makeKey(img::SpriteKind::AIRPORT, ICAO_RING_RADIUS, color, (uint8_t) symbol);
+    uint32_t ringColor = color;
+    auto ring = img::SpriteCache::shared().get(key, [ringColor, symbol] () {
+        return createICAORing(ringColor, symbol);
+    });
+
+    auto mapImage = overlayHelper->getMapImage();
+    mapImage->blendImage0(*ring, posX - ICAO_RING_RADIUS, posY - ICAO_RING_RADIUS);
+}
+
+std::shared_ptr<img::Image> OverlayedAirport::createICAORing(uint32_t color, RingSymbol symbol) {
+    int c = ICAO_RING_RADIUS;
+    auto ring = std::make_shared<img::Image>(2 * c + 1, 2 * c + 1, 0x00FFFFFF);
+
+    ring->fillCircle(c, c, ICAO_RING_RADIUS, color);
+    ring->fillCircle(c, c, ICAO_RING_RADIUS - 3, img::COLOR_WHITE);
+    if (symbol == RingSymbol::HELIPORT) {
+        // Draw 'H'
+        ring->drawLine(c - 3, c - 5, c - 3, c + 5, color); // Left vertical
+        ring->drawLine(c + 3, c - 5, c + 3, c + 5, color); // Right vertical
+        ring->drawLine(c - 3, c    , c + 3, c    , color); // Horizonatal
+    } else if (symbol == RingSymbol::WATER) {
         // Draw anchor
-        mapImage->drawLine(  posX - 3, posY - 4, posX + 3, posY - 4, color); // Top
-        mapImage->drawLine(  posX    , posY - 4, posX    , posY + 4, color); // Vertical
-        mapImage->drawLineAA(posX    , posY + 4, posX + 4, posY + 1, color); // Right bottom
-        mapImage->drawLineAA(posX    , posY + 4, posX - 4, posY + 1, color); // Left bottom
+        ring->drawLine(  c - 3, c - 4, c + 3, c - 4, color); // Top
+        ring->drawLine(  c    , c - 4, c    , c + 4, color); // Vertical
+        ring->drawLineAA(c    , c + 4, c + 4, c + 1, color); // Right bottom
+        ring->drawLineAA(c    , c + 4, c - 4, c + 1, color); // Left bottom
     }
+    return ring;
 }
 
 void OverlayedAirport::drawAirportGeographicRunways() {
-    // Draw the runways as on the ground, but with slightly exaggerated widths for visibility
-    airport->forEachRunwayPair([this] (const std::shared_ptr<world::Runway> rwy1, const std::shared_ptr<world::Runway> rwy2) {
-        auto loc1 = rwy1->getLocation();
-        auto loc2 = rwy2->getLocation();
-        int px1, py1, px2, py2;
-        overlayHelper->positionToPixel(loc1.latitude, loc1.longitude, px1, py1);
-        overlayHelper->positionToPixel(loc2.latitude, loc2.longitude, px2, py2);
-        float rwyLength = rwy1->getLength();
-        float rwyWidth = rwy1->getWidth();
-        if (std::isnan(rwyLength) || (rwyLength == 0)) {
-            return;
-        }
-        if (std::isnan(rwyWidth) || (rwyWidth == 0)) {
-            return;
-        }
-        float aspectRatio = rwyLength / (rwyWidth * 1.1);
-        uint32_t surfColor = rwy1->hasHardSurface() ? img::COLOR_DARK_GREY :
-            rwy1->isWater() ? img::COLOR_ICAO_BLUE : img::COLOR_DARK_GREEN;
-        int xo = (px1 - px2) / aspectRatio;
-        int yo = (py1 - py2) / aspectRatio;
-        auto mapImage = overlayHelper->getMapImage();
-        if ((xo == 0) && (yo == 0)) {
-            mapImage->drawLineAA(px1, py1, px2, py2, surfColor);
-        } else {
-            mapImage->fillRectangle(px1 + yo, py1 - xo, px1 - yo, py1 + xo, px2 - yo, py2 + xo, px2 + yo, py2 - xo, surfColor);
-        }
-   });
+    auto &geo = getGeometry();
+    int xCentre, yCentre;
+    overlayHelper->positionToPixel(geo.centreLat, geo.centreLon, xCentre, yCentre);
+    drawDiagram(DiagramStyle::GEOGRAPHIC, xCentre, yCentre);
 }
 
 void OverlayedAirport::drawAirportICAOCircleAndRwyPattern() {
     auto mapImage = overlayHelper->getMapImage();
     mapImage->fillCircle(posX, posY, ICAO_CIRCLE_RADIUS, color);
-    // Scale up to fill circle - calculate pixels at higher resolution zoom level and scale down.
-    int xCentre = 0;
-    int yCentre = 0;
-    getRunwaysCentre(overlayHelper->getMaxZoomLevel(), xCentre, yCentre);
-    int maxDistance = getMaxRunwayDistanceFromCentre(overlayHelper->getMaxZoomLevel(), xCentre, yCentre);
-    if (maxDistance == 0) {
-        return;
-    }
-    float scale = (float)maxDistance / (float)(ICAO_CIRCLE_RADIUS - 4);
-    xCentre /= scale;
-    yCentre /= scale;
-
-    airport->forEachRunwayPair([this, mapImage, xCentre, yCentre, scale](const std::shared_ptr<world::Runway> rwy1, const std::shared_ptr<world::Runway> rwy2) {
-        auto loc1 = rwy1->getLocation();
-        auto loc2 = rwy2->getLocation();
-        int px1, py1, px2, py2;
-        overlayHelper->positionToPixel(loc1.latitude, loc1.longitude, px1, py1, overlayHelper->getMaxZoomLevel());
-        overlayHelper->positionToPixel(loc2.latitude, loc2.longitude, px2, py2, overlayHelper->getMaxZoomLevel());
-        px1 /= scale;
-        px2 /= scale;
-        py1 /= scale;
-        py2 /= scale;
-        mapImage->drawLineAA(px1 - xCentre + posX, py1 - yCentre + posY, px2 - xCentre + posX, py2 - yCentre + posY, img::COLOR_WHITE);
-    });
+    // the runway lines are scaled to fill the circle
+    drawDiagram(DiagramStyle::PATTERN, posX, posY);
 }
 
 } /* namespace maps */
@@ -18,6 +18,8 @@
 #ifndef SRC_MAPS_OVERLAYED_AIRPORT_H_
 #define SRC_MAPS_OVERLAYED_AIRPORT_H_
 
+#include <memory>
+#include <vector>
 #include "OverlayedNode.h"
 #include "src/world/models/airport/Airport.h"
 
@@ -32,6 +34,8 @@ public:
     std::string getID() const override;
     void drawGraphic() override;
     void drawText(bool detailed) override;
+    bool getTextBox(TextBox &box) override;
+    LabelPriority getLabelPriority() const override;
 
 private:
 
@@ -42,9 +46,55 @@ private:
         HELIPORT
     };
 
+    enum class RingSymbol : uint8_t {
+        NONE,
+        HELIPORT,
+        WATER
+    };
+
+    enum class DiagramStyle : uint8_t {
+        GEOGRAPHIC,     // runways as on the ground
+        ICAO_RUNWAYS,   // outlined runways of a fixed width
+        PATTERN,        // runway lines scaled into the ICAO circle
+    };
+
+    // runway ends in metres east and north of the airport's centre
+    struct RunwayShape {
+        float east1, north1, east2, north2;
+        float length, width;
+        uint32_t surfColor;
+    };
+
+    // The runways in local metres, built on first use since the data doesn't change
+    struct Geometry {
+        double centreLat = 0, centreLon = 0;
+        double cosLat = 1;
+        std::vector<RunwayShape> runways;
+        // largest distance of a runway end from the centre
+        float extent = 0;
+    };
+
+    // pixels per metre east and north around the airport
+    struct Basis {
+        float eastX = 0, eastY = 0, northX = 0, northY = 0;
+    };
+
+    // rendered runways, redrawn when the zoom or the map rotation changes
+    struct Diagram {
+        std::shared_ptr<img::Image> image;
+        DiagramStyle style = DiagramStyle::GEOGRAPHIC;
+        int zoomLevel = -1;
+        Basis basis;
+        // position of the centre in the image
+        int originX = 0, originY = 0;
+    };
+
     const world::Airport *airport;
     AerodromeType type = AerodromeType::AIRPORT;
     uint32_t color = 0;
+    std::unique_ptr<Geometry> geometry;
+    Diagram diagram;
+    std::string detailedName, detailedInfo;
 
     AerodromeType getAerodromeType();
     uint32_t getAirportColor();
@@ -52,12 +102,16 @@ private:
     void drawAirportBlob();
     void drawAirportICAOCircleAndRwyPattern();
     void drawAirportICAORing();
+    static std::shared_ptr<img::Image> createICAORing(uint32_t color, RingSymbol symbol);
     void drawAirportICAOGeographicRunways();
     void drawAirportGeographicRunways();
-    void getRunwaysCentre(int zoomLevel, int & xCentre, int & yCentre);
-    int getMaxRunwayDistanceFromCentre(int zoomLevel, int xCentre, int yCentre);
-    void drawRunwayRectangles(float size, uint32_t rectColor);
+    const Geometry &getGeometry();
+    Basis getBasis(int zoomLevel);
+    void drawDiagram(DiagramStyle style, int centreX, int centreY);
+    void drawRunways(img::Image &dst, DiagramStyle style, const std::vector<float> &ends, float originX, float originY);
+    void drawRunwayRectangles(img::Image &dst, const std::vector<float> &ends, float originX, float originY, float size, uint32_t rectColor);
     bool isBlob();
+    int getTextTop();
 
     static constexpr const int ICAO_CIRCLE_RADIUS = 15;
     static constexpr const int DRAW_BLOB_RUNWAYS_AT_MAPWIDTHNM = 200;
@@ -66,6 +120,8 @@ private:
     static constexpr const int BLOB_SIZE_DIVIDEND = DRAW_BLOB_RUNWAYS_AT_MAPWIDTHNM * MAX_BLOB_SIZE;
     static constexpr const int DRAW_GEOGRAPHIC_RUNWAYS_AT_MAPWIDTHNM = 5;
     static constexpr const int ICAO_RING_RADIUS = 12;
+    // larger diagrams are drawn directly instead of keeping them as sprites
+    static constexpr const int MAX_DIAGRAM_SIZE = 1024;
 };
 
 } /* namespace maps */
@@ -17,6 +17,7 @@
  */
 
 #include "OverlayedDME.h"
+#include "src/libimg/SpriteCache.h"
 
 namespace maps {
 
@@ -36,12 +37,19 @@ void OverlayedDME::drawGraphic()
 {
     if (!enabled) return;
 
-    double r = 8;
-    auto mapImage = overlayHelper->getMapImage();
-    mapImage->drawLine(posX - r, posY - r, posX + r, posY - r, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX + r, posY - r, posX + r, posY + r, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX + r, posY + r, posX - r, posY + r, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX - r, posY + r, posX - r, posY - r, img::COLOR_ICAO_VOR_DME);
+    auto key = img::SpriteCache::makeKey(img::SpriteKind::DME, BOX_RADIUS, img::COLOR_ICAO_VOR_DME);
+    auto box = img::SpriteCache::shared().get(key, createDMEIcon);
+    overlayHelper->getMapImage()->blendImage0(*box, posX - BOX_RADIUS, posY - BOX_RADIUS);
+}
+
+std::shared_ptr<img::Image> OverlayedDME::createDMEIcon() {
+    int r = BOX_RADIUS;
+    auto box = std::make_shared<img::Image>(2 * r + 1, 2 * r + 1, 0);
+    box->drawLine(0, 0, 2 * r, 0, img::COLOR_ICAO_VOR_DME);
+    box->drawLine(2 * r, 0, 2 * r, 2 * r, img::COLOR_ICAO_VOR_DME);
+    box->drawLine(2 * r, 2 * r, 0, 2 * r, img::COLOR_ICAO_VOR_DME);
+    box->drawLine(0, 2 * r, 0, 0, img::COLOR_ICAO_VOR_DME);
+    return box;
 }
 
 void OverlayedDME::drawText(bool detailed)
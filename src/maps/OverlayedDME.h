@@ -37,6 +37,8 @@ private:
     const world::DME * const navDME;
 
     static constexpr const int MARGIN = 60;
+    static constexpr const int BOX_RADIUS = 8;
+    static std::shared_ptr<img::Image> createDMEIcon();
 };
 
 } /* namespace maps */
@@ -26,14 +26,25 @@ OverlayedFix::OverlayedFix(IOverlayHelper *h, const world::Fix *f):
     OverlayedNode(h, false),
     fix(f)
 {
-    auto &loc = fix->getLocation();
-    overlayHelper->positionToPixel(loc.latitude, loc.longitude, posX, posY);
 }
 
 std::string OverlayedFix::getID() const {
     return fix->getID();
 }
 
+bool OverlayedFix::getTextBox(TextBox &box) {
+    if (!enabled) {
+        return false;
+    }
+    auto hs = getClickHotspot();
+    box = getLabelBox(getID(), 12, hs.first, hs.second, img::Align::CENTRE);
+    return true;
+}
+
+OverlayedNode::LabelPriority OverlayedFix::getLabelPriority() const {
+    return LabelPriority::NAVAID;
+}
+
 void OverlayedFix::drawNavTextBox(const std::string &type, const std::string &id, const std::string &freq, int x, int y, uint32_t color, const std::string &ilsHeadingMagnetic) {
     auto mapImage = overlayHelper->getMapImage();
     // x, y is top left corner of rectangular border. If type is not required, pass in as ""
@@ -28,6 +28,9 @@ class OverlayedFix : public OverlayedNode {
 
 public:
     std::string getID() const override;
+    // the navaids draw their ID centred on the click hotspot
+    bool getTextBox(TextBox &box) override;
+    LabelPriority getLabelPriority() const override;
 
 protected:
     OverlayedFix(IOverlayHelper *h, const world::Fix *f);
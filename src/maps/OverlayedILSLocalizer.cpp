@@ -37,6 +37,7 @@ void OverlayedILSLocalizer::configure(const OverlayConfig &cfg, const world::Loc
 {
     OverlayedFix::configure(cfg, loc);
     if (linkedDME) {
+        linkedDME->setPosition(posX, posY);
         linkedDME->configure(cfg, loc);
     }
     enabled = navILS && cfg.drawILSs && cfg.drawAirports;
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <cstdio>
 #include <cstring>
 #include <algorithm>
 #include <cmath>
@@ -26,7 +27,9 @@
 #include "OverlayedILSLocalizer.h"
 #include "OverlayedWaypoint.h"
 #include "OverlayedUserFix.h"
+#include "src/libimg/SpriteCache.h"
 #include "src/Logger.h"
+#include "src/platform/FrameProfiler.h"
 
 constexpr static bool DBG_OVERLAYS = false;
 constexpr static int INVALID_CLICK = -9999;
@@ -56,7 +59,10 @@ OverlayedMap::OverlayedMap(std::shared_ptr<img::Stitcher> stitchedMap, std::shar
     stitcher->setRedrawCallback([this] () {
         copyrightStamp.applyStamp(*(stitcher->getTargetImage()), 0);
         if (tileSource->isDocumentSource() && tileSource->supportsWorldCoords()) {
+            auto start = std::chrono::steady_clock::now();
             drawCompass();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            timings.record(OverlayTimings::COMPASS, elapsed.count());
         }
         if (onOverlaysDrawn) {
             onOverlaysDrawn();
@@ -72,7 +78,8 @@ OverlayedMap::OverlayedMap(std::shared_ptr<img::Stitcher> stitchedMap, std::shar
     otherAircraftColors[RelativeHeight::same] = overlayConfig->colorOtherAircraftSame;
     otherAircraftColors[RelativeHeight::above] = overlayConfig->colorOtherAircraftAbove;
 
-    overlayNodeCache = std::make_shared<NavNodeToOverlayMap>();
+    drawTarget = mapImage;
+    planeLocations = std::make_shared<avitab::AircraftSnapshot>();
 }
 
 void OverlayedMap::setRedrawCallback(OverlaysDrawnCallback cb) {
@@ -83,6 +90,14 @@ void OverlayedMap::setGetRouteCallback(GetRouteCallback cb) {
     getRoute = cb;
 }
 
+void OverlayedMap::setGetProcedureCallback(GetProcedureCallback cb) {
+    getProcedure = cb;
+}
+
+void OverlayedMap::setGetWeatherCallback(GetWeatherCallback cb) {
+    getWeather = cb;
+}
+
 void OverlayedMap::loadOverlayIcons(const std::string& path) {
     std::string planeIconName = "if_icon-plane_211875.png";
     try {
@@ -94,6 +109,7 @@ void OverlayedMap::loadOverlayIcons(const std::string& path) {
 
 void OverlayedMap::setNavWorld(std::shared_ptr<world::World> world) {
     navWorld = world;
+    navLayerValid = false;
 }
 
 void OverlayedMap::centerOnWorldPos(double latitude, double longitude) {
@@ -109,23 +125,36 @@ void OverlayedMap::centerOnWorldPos(double latitude, double longitude) {
     }
 }
 
-void OverlayedMap::setPlaneLocations(std::vector<avitab::Location> &locs) {
-    if (!tileSource->supportsWorldCoords()) {
+void OverlayedMap::setPlaneLocations(avitab::AircraftLocations locs) {
+    if (!tileSource->supportsWorldCoords() || !locs) {
+        return;
+    }
+
+    if (locs == planeLocations) {
+        // no new sample, but the extrapolated aircraft moves on
+        const auto &v = locs->userVelocity;
+        if (v.latitude != 0 || v.longitude != 0 || v.heading != 0) {
+            stitcher->updateImage();
+        }
         return;
     }
 
+    // snapshots are immutable, so the previous one can be compared and then dropped
     bool movement = false;
-    for (size_t i = 0; i < locs.size(); ++i) {
-        if (i < planeLocations.size()) {
-            double deltaLat = std::abs(locs[i].latitude - planeLocations[i].latitude);
-            double deltaLon = std::abs(locs[i].longitude - planeLocations[i].longitude);
-            double deltaHeading = std::abs(locs[i].heading - planeLocations[i].heading);
+    for (size_t i = 0; i < locs->locations.size(); ++i) {
+        if (i < planeLocations->locations.size()) {
+            double deltaLat = std::abs(locs->locations[i].latitude - planeLocations->locations[i].latitude);
+            double deltaLon = std::abs(locs->locations[i].longitude - planeLocations->locations[i].longitude);
+            double deltaHeading = std::abs(locs->locations[i].heading - planeLocations->locations[i].heading);
             movement |= (deltaLat > 0.0000001 || deltaLon > 0.0000001 || deltaHeading > 0.1);
         } else {
             movement = true;
         }
     }
+    movement |= (locs->locations.size() != planeLocations->locations.size());
     planeLocations = locs;
+    updateGroundSpeed();
+    prefetchNavAreas();
 
     if (movement) {
         stitcher->updateImage();
@@ -137,9 +166,112 @@ void OverlayedMap::centerOnPlane() {
         return;
     }
 
-    if (!planeLocations.empty()) {
-        centerOnWorldPos(planeLocations[0].latitude, planeLocations[0].longitude);
+    if (!planeLocations->locations.empty()) {
+        centerOnWorldPos(planeLocations->locations[0].latitude, planeLocations->locations[0].longitude);
+        prefetchAlongTrack();
+    }
+}
+
+void OverlayedMap::setPrefetchMinutes(int minutes) {
+    prefetchMinutes = minutes;
+}
+
+void OverlayedMap::updateGroundSpeed() {
+    if (planeLocations->locations.empty()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    world::Location loc(planeLocations->locations[0].latitude, planeLocations->locations[0].longitude);
+    if (!speedSampleLocation.isValid()) {
+        speedSampleLocation = loc;
+        speedSampleTime = now;
+        return;
+    }
+
+    double seconds = std::chrono::duration<double>(now - speedSampleTime).count();
+    if (seconds < 1) {
+        return;
+    }
+
+    double nm = speedSampleLocation.distanceTo(loc) / 1000 * world::KM_TO_NM;
+    double knots = nm / (seconds / 3600);
+    // smooth out jitter, but discard jumps caused by repositioning
+    groundSpeedKnots = (knots > 2000) ? 0 : (groundSpeedKnots + knots) / 2;
+    speedSampleLocation = loc;
+    speedSampleTime = now;
+}
+
+void OverlayedMap::prefetchAlongTrack() {
+    if (prefetchMinutes <= 0 || groundSpeedKnots < MIN_PREFETCH_SPEED_KNOTS) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastPrefetchTime < std::chrono::seconds(PREFETCH_INTERVAL_SECONDS)) {
+        return;
+    }
+    lastPrefetchTime = now;
+
+    const auto &plane = planeLocations->locations[0];
+    double distanceNM = groundSpeedKnots * prefetchMinutes / 60.0;
+    double heading = plane.heading * M_PI / 180;
+    int zoom = stitcher->getZoomLevel();
+
+    for (int step = 1; step <= PREFETCH_STEPS; step++) {
+        double degrees = distanceNM * step / PREFETCH_STEPS / MAX_NM_PER_DEGREE;
+        double lat = plane.latitude + degrees * std::cos(heading);
+        double lon = plane.longitude + degrees * std::sin(heading) / std::max(0.01, std::cos(lat * M_PI / 180));
+        if (lat < -85 || lat > 85) {
+            break;
+        }
+        if (lon > 180) {
+            lon -= 360;
+        } else if (lon < -180) {
+            lon += 360;
+        }
+
+        auto xy = tileSource->worldToXY(lon, lat, zoom);
+        stitcher->prefetch(xy.x, xy.y, zoom, 1);
+        auto xyOut = tileSource->worldToXY(lon, lat, zoom - 1);
+        stitcher->prefetch(xyOut.x, xyOut.y, zoom - 1, 0);
+    }
+}
+
+void OverlayedMap::prefetchNavAreas() {
+    // NAV worlds that load areas on demand warm those along the track and the route,
+    // whether or not the map follows the plane
+    if (!navWorld || planeLocations->locations.empty()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastNavPrefetchTime < std::chrono::seconds(PREFETCH_INTERVAL_SECONDS)) {
+        return;
+    }
+    lastNavPrefetchTime = now;
+
+    std::vector<std::vector<world::Location>> paths(1);
+    const auto &plane = planeLocations->locations[0];
+    paths[0].emplace_back(plane.latitude, plane.longitude);
+    if (prefetchMinutes > 0 && groundSpeedKnots >= MIN_PREFETCH_SPEED_KNOTS) {
+        double degrees = groundSpeedKnots * prefetchMinutes / 60.0 / MAX_NM_PER_DEGREE;
+        double heading = plane.heading * M_PI / 180;
+        double lat = std::max(-85.0, std::min(85.0, plane.latitude + degrees * std::cos(heading)));
+        double lon = plane.longitude + degrees * std::sin(heading) / std::max(0.01, std::cos(lat * M_PI / 180));
+        paths[0].emplace_back(lat, std::remainder(lon, 360.0));
+    }
+
+    auto route = getRoute ? getRoute() : nullptr;
+    if (route) {
+        paths.emplace_back();
+        auto &routePath = paths.back();
+        route->iterateRoute([&routePath] (const std::shared_ptr<world::NavEdge>, const std::shared_ptr<world::NavNode> node) {
+            routePath.push_back(node->getLocation());
+        });
     }
+
+    navWorld->prefetchAlong(paths);
 }
 
 void OverlayedMap::getCenterLocation(double& latitude, double& longitude) {
@@ -152,6 +284,13 @@ float OverlayedMap::getVerticalRange() const {
     return (float)rangeKM * 1000;
 }
 
+void OverlayedMap::getVisibleArea(double &minLat, double &minLon, double &maxLat, double &maxLon) const {
+    minLat = this->minLat;
+    minLon = this->minLon;
+    maxLat = this->maxLat;
+    maxLon = this->maxLon;
+}
+
 bool OverlayedMap::mouse(int x, int y, bool down)
 {
     bool wasClick = false;
@@ -179,14 +318,13 @@ void OverlayedMap::pan(int dx, int dy, int relx, int rely) {
 }
 
 void OverlayedMap::zoomIn() {
-    int zoomLevel = stitcher->getZoomLevel();
-    stitcher->setZoomLevel(zoomLevel + 1);
+    // several steps in a row only load the tiles of the last level, see Stitcher::zoomBy
+    stitcher->zoomBy(1);
     lastClickX = lastClickY = INVALID_CLICK;
 }
 
 void OverlayedMap::zoomOut() {
-    int zoomLevel = stitcher->getZoomLevel();
-    stitcher->setZoomLevel(zoomLevel - 1);
+    stitcher->zoomBy(-1);
     lastClickX = lastClickY = INVALID_CLICK;
 }
 
@@ -208,65 +346,307 @@ void OverlayedMap::drawOverlays() {
     if ((mapImage->getWidth() == 0) || (mapImage->getHeight() == 0)) {
         return;
     }
+
+    // the overlays and the compass can change anywhere, also when they disappear
+    bool drawsOverlays = tileSource->supportsWorldCoords() || calibrationStep != 0 || overlayConfig->showTimings;
+    if (drawsOverlays || drewOverlays) {
+        stitcher->markAllDirty();
+    }
+    drewOverlays = drawsOverlays;
+
+    platform::ScopedFrameTiming profilerTiming(platform::FrameProfiler::OVERLAYS);
+
+    auto frameStart = std::chrono::steady_clock::now();
     if (tileSource->supportsWorldCoords()) {
         updateMapAttributes();
-        drawRoute();
-        drawNavWorldOverlays();
-        drawScale();
-        drawOtherAircraftOverlay();
-        drawAircraftOverlay();
+        drawTimedLayer(OverlayTimings::NAV_WORLD, frameStart, [this] { drawNavWorldOverlays(); });
+        drawTimedLayer(OverlayTimings::WEATHER, frameStart, [this] { drawWeatherOverlay(); });
+        drawTimedLayer(OverlayTimings::ROUTE, frameStart, [this] { drawProcedure(); drawRoute(); });
+        drawTimedLayer(OverlayTimings::SCRIPTS, frameStart, [this] { drawScriptOverlays(); });
+        drawTimedLayer(OverlayTimings::SCALE, frameStart, [this] { drawScale(); });
+        drawTimedLayer(OverlayTimings::OTHER_AIRCRAFT, frameStart, [this] { drawOtherAircraftOverlay(); });
+        drawTimedLayer(OverlayTimings::AIRCRAFT, frameStart, [this] { drawAircraftOverlay(); });
+    }
+    drawTimedLayer(OverlayTimings::CALIBRATION, frameStart, [this] { drawCalibrationOverlay(); });
+
+    std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+    timings.record(OverlayTimings::FRAME, frameTime.count());
+
+    if (overlayConfig->showTimings) {
+        drawTimings();
+    }
+}
+
+void OverlayedMap::drawTimedLayer(OverlayTimings::Layer layer, std::chrono::steady_clock::time_point frameStart,
+                                  const std::function<void()> &draw) {
+    // Only the decorations are subject to the budget. A layer is predicted to take
+    // its median time and is never deferred on two frames in a row, so it can
+    // flicker under load but does not disappear.
+    bool deferrable = (layer == OverlayTimings::SCALE) || (layer == OverlayTimings::OTHER_AIRCRAFT);
+    if (deferrable && (overlayConfig->frameBudgetMs > 0) && !layerDeferred[layer]) {
+        std::chrono::duration<double, std::milli> used = std::chrono::steady_clock::now() - frameStart;
+        if (used.count() + timings.getPercentile(layer, 50) > overlayConfig->frameBudgetMs) {
+            LOG_INFO(DBG_OVERLAYS, "deferring %s after %.2f ms", OverlayTimings::getLayerName(layer), used.count());
+            layerDeferred[layer] = true;
+            timings.recordDeferred(layer);
+            return;
+        }
+    }
+    layerDeferred[layer] = false;
+
+    auto start = std::chrono::steady_clock::now();
+    draw();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    timings.record(layer, elapsed.count());
+}
+
+void OverlayedMap::drawTimings() {
+    int y = 5;
+    for (int i = 0; i < OverlayTimings::NUM_LAYERS; i++) {
+        auto layer = static_cast<OverlayTimings::Layer>(i);
+        char line[96];
+        snprintf(line, sizeof(line), "%-11s %6.2f %6.2f ms %5u",
+                 OverlayTimings::getLayerName(layer),
+                 timings.getPercentile(layer, 50), timings.getPercentile(layer, 95),
+                 (unsigned) timings.getDeferredCount(layer));
+        mapImage->drawText(line, 10, 5, y, img::COLOR_BLACK, img::COLOR_TRANSPARENT_WHITE, img::Align::LEFT);
+        y += 12;
     }
-    drawCalibrationOverlay();
+}
+
+const OverlayTimings &OverlayedMap::getOverlayTimings() const {
+    return timings;
 }
 
 void OverlayedMap::drawAircraftOverlay() {
-    if (!overlayConfig->drawMyAircraft || planeLocations.empty()) {
+    if (!overlayConfig->drawMyAircraft || planeLocations->locations.empty()) {
         return;
     }
 
+    // drawn where the aircraft is now rather than at the last sample, so that it
+    // moves smoothly even if the simulator publishes fewer frames than we draw
+    avitab::Location plane = planeLocations->extrapolateUser(std::chrono::steady_clock::now());
+
     int px = 0, py = 0;
-    positionToPixel(planeLocations[0].latitude, planeLocations[0].longitude, px, py);
+    positionToPixel(plane.latitude, plane.longitude, px, py);
 
     px -= planeIcon.getWidth() / 2;
     py -= planeIcon.getHeight() / 2;
 
-    mapImage->blendImage(planeIcon, px, py, planeLocations[0].heading + getNorthOffset());
+    mapImage->blendImage(planeIcon, px, py, plane.heading + getNorthOffset());
 }
 
 void OverlayedMap::drawOtherAircraftOverlay() {
-    if (!overlayConfig->drawOtherAircraft || (planeLocations.size() < 2)) {
+    if (!overlayConfig->drawOtherAircraft || (planeLocations->locations.size() < 2)) {
         return;
     }
 
-    int px = 0, py = 0;
-
-    for (size_t i = 1; i < planeLocations.size(); ++i) {
-        bool isAbove = (planeLocations[i].elevation > (planeLocations[0].elevation + 30));
-        bool isBelow = (planeLocations[i].elevation < (planeLocations[0].elevation - 30));
+    const auto &planes = planeLocations->locations;
+    size_t count = planes.size() - 1;
+    trafficLats.resize(count);
+    trafficLons.resize(count);
+    trafficX.resize(count);
+    trafficY.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        trafficLats[i] = planes[i + 1].latitude;
+        trafficLons[i] = planes[i + 1].longitude;
+    }
+    positionsToPixels(trafficLats.data(), trafficLons.data(), count, trafficX.data(), trafficY.data());
+
+    int w = mapImage->getWidth();
+    int h = mapImage->getHeight();
+    std::vector<img::TextLabel> labels;
+
+    for (size_t i = 1; i < planes.size(); ++i) {
+        int px = trafficX[i - 1];
+        int py = trafficY[i - 1];
+        if (px < -TRAFFIC_CULL_MARGIN || py < -TRAFFIC_CULL_MARGIN ||
+            px >= w + TRAFFIC_CULL_MARGIN || py >= h + TRAFFIC_CULL_MARGIN) {
+            continue;
+        }
+        bool isAbove = (planes[i].elevation > (planes[0].elevation + 30));
+        bool isBelow = (planes[i].elevation < (planes[0].elevation - 30));
         uint32_t color = (isAbove ? otherAircraftColors[RelativeHeight::above]
-                                  : (isBelow ? otherAircraftColors[RelativeHeight::below] 
+                                  : (isBelow ? otherAircraftColors[RelativeHeight::below]
                                              : otherAircraftColors[RelativeHeight::same]));
-        positionToPixel(planeLocations[i].latitude, planeLocations[i].longitude, px, py);
-        mapImage->drawCircle(px, py, 6, color);
-        mapImage->drawCircle(px, py, 7, color);
-        double ax, ay, tx, ty, rx, ry;
-        fastPolarToCartesian(12.0, static_cast<int>(planeLocations[i].heading + getNorthOffset()), ax, ay);
-        fastPolarToCartesian(3.0, static_cast<int>(planeLocations[i].heading + getNorthOffset()), tx, ty);
-        fastPolarToCartesian(2.0, static_cast<int>(planeLocations[i].heading + getNorthOffset()) + 90, rx, ry);
-        mapImage->drawLineAA(px + tx + rx, py + ty + ry, px + ax, py + ay, color);
-        mapImage->drawLineAA(px + tx - rx, py + ty - ry, px + ax, py + ay, color);
-        unsigned int flightLevel = static_cast<unsigned int>(planeLocations[i].elevation * world::M_TO_FT + 50.0) / 100.0;
+
+        // one pre-rendered symbol per colour and whole degree of heading
+        int heading = static_cast<int>(planes[i].heading + getNorthOffset()) % 360;
+        if (heading < 0) {
+            heading += 360;
+        }
+        auto key = img::SpriteCache::makeKey(img::SpriteKind::TRAFFIC, TRAFFIC_ICON_EXTENT, color, heading);
+        auto icon = img::SpriteCache::shared().get(key, [this, color, heading] () { return createTrafficIcon(color, heading); });
+        mapImage->blendImage0(*icon, px - TRAFFIC_ICON_EXTENT, py - TRAFFIC_ICON_EXTENT);
+
+        unsigned int flightLevel = static_cast<unsigned int>(planes[i].elevation * world::M_TO_FT + 50.0) / 100.0;
         std::string flText = "---";
         flText[0] = '0' + (flightLevel / 100) % 10;
         flText[1] = '0' + (flightLevel / 10) % 10;
         flText[2] = '0' + (flightLevel / 1) % 10;
         if (isAbove) {
-            mapImage->drawText(flText, 12, px, py - 17, color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
+            labels.push_back({flText, 12, px, py - 17, color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE});
         }
         if (isBelow) {
-            mapImage->drawText(flText, 12, px, py + 7, color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
+            labels.push_back({flText, 12, px, py + 7, color, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE});
+        }
+    }
+
+    // all flight levels in one pass, on top of the aircraft symbols
+    mapImage->drawTexts(labels);
+}
+
+std::shared_ptr<img::Image> OverlayedMap::createTrafficIcon(uint32_t color, int heading) const {
+    int c = TRAFFIC_ICON_EXTENT;
+    auto icon = std::make_shared<img::Image>(2 * c + 1, 2 * c + 1, 0);
+    icon->drawCircle(c, c, 6, color);
+    icon->drawCircle(c, c, 7, color);
+    double ax, ay, tx, ty, rx, ry;
+    fastPolarToCartesian(12.0, heading, ax, ay);
+    fastPolarToCartesian(3.0, heading, tx, ty);
+    fastPolarToCartesian(2.0, heading + 90, rx, ry);
+    icon->drawLineAA(c + tx + rx, c + ty + ry, c + ax, c + ay, color);
+    icon->drawLineAA(c + tx - rx, c + ty - ry, c + ax, c + ay, color);
+    return icon;
+}
+
+void OverlayedMap::drawWeatherOverlay() {
+    if (!overlayConfig->drawWeather || !getWeather || mapWidthNM > MAPWIDTH_LIMIT_WEATHER) {
+        return;
+    }
+
+    auto stations = getWeather();
+    if (!stations) {
+        return;
+    }
+
+    weatherStations.clear();
+    weatherLats.clear();
+    weatherLons.clear();
+    stations->forEachInArea(minLat, minLon, maxLat, maxLon, [this] (const avitab::WeatherStations::Station &station) {
+        weatherStations.push_back(&station);
+        weatherLats.push_back(station.latitude);
+        weatherLons.push_back(station.longitude);
+    });
+    size_t count = weatherStations.size();
+    weatherX.resize(count);
+    weatherY.resize(count);
+    positionsToPixels(weatherLats.data(), weatherLons.data(), count, weatherX.data(), weatherY.data());
+
+    // the first station in each cell wins so that dense areas stay readable
+    int w = mapImage->getWidth();
+    int h = mapImage->getHeight();
+    int cellsX = w / WEATHER_CELL_PIXELS + 1;
+    int cellsY = h / WEATHER_CELL_PIXELS + 1;
+    weatherCellUsed.assign(cellsX * cellsY, false);
+
+    bool drawWind = mapWidthNM <= MAPWIDTH_LIMIT_WIND;
+    int northOffset = static_cast<int>(getNorthOffset());
+    int r = WEATHER_ICON_RADIUS;
+    int b = WEATHER_BARB_EXTENT;
+
+    for (size_t i = 0; i < count; i++) {
+        int px = weatherX[i];
+        int py = weatherY[i];
+        if (px < 0 || py < 0 || px >= w || py >= h) {
+            continue;
+        }
+        int cell = (py / WEATHER_CELL_PIXELS) * cellsX + px / WEATHER_CELL_PIXELS;
+        if (weatherCellUsed[cell]) {
+            continue;
+        }
+        weatherCellUsed[cell] = true;
+
+        const auto &station = *weatherStations[i];
+        if (drawWind && station.windDirection >= 0 && station.windSpeed >= MIN_WIND_KNOTS) {
+            // one pre-rendered barb per 10 degrees and 5 knots
+            int direction = ((station.windDirection + northOffset) % 360 + 360) % 360;
+            direction = ((direction + 5) / 10) % 36;
+            int speed = std::min((station.windSpeed + 2) / 5, MAX_WIND_STEPS);
+            int variant = direction * (MAX_WIND_STEPS + 1) + speed;
+            auto key = img::SpriteCache::makeKey(img::SpriteKind::WIND_BARB, b, img::COLOR_BLACK, variant);
+            auto barb = img::SpriteCache::shared().get(key, [this, direction, speed] () {
+                return createWindBarbIcon(direction * 10, speed * 5);
+            });
+            mapImage->blendImage0(*barb, px - b, py - b);
+        }
+
+        auto category = station.category;
+        auto key = img::SpriteCache::makeKey(img::SpriteKind::WEATHER_STATION, r, 0, static_cast<int>(category));
+        auto icon = img::SpriteCache::shared().get(key, [this, category] () { return createWeatherStationIcon(category); });
+        mapImage->blendImage0(*icon, px - r, py - r);
+    }
+}
+
+std::shared_ptr<img::Image> OverlayedMap::createWeatherStationIcon(avitab::FlightCategory category) const {
+    uint32_t color;
+    switch (category) {
+    case avitab::FlightCategory::VFR:   color = img::COLOR_DARK_GREEN; break;
+    case avitab::FlightCategory::MVFR:  color = img::COLOR_BLUE; break;
+    case avitab::FlightCategory::IFR:   color = img::COLOR_LIGHT_RED; break;
+    case avitab::FlightCategory::LIFR:  color = 0xFFFF00FF; break;
+    default:                            color = img::COLOR_DARK_GREY; break;
+    }
+
+    int r = WEATHER_ICON_RADIUS;
+    auto icon = std::make_shared<img::Image>(2 * r + 1, 2 * r + 1, 0);
+    if (category == avitab::FlightCategory::UNKNOWN) {
+        icon->drawCircle(r, r, r - 1, color);
+    } else {
+        icon->fillCircle(r, r, r - 1, color);
+    }
+    icon->drawCircle(r, r, r, img::COLOR_BLACK);
+    return icon;
+}
+
+std::shared_ptr<img::Image> OverlayedMap::createWindBarbIcon(int direction, int speed) const {
+    // the staff points to where the wind comes from, with a pennant per 50 knots,
+    // a feather per 10 knots and a half feather for 5 knots at its outer end
+    int c = WEATHER_BARB_EXTENT;
+    auto icon = std::make_shared<img::Image>(2 * c + 1, 2 * c + 1, 0);
+    uint32_t color = img::COLOR_BLACK;
+
+    double sx, sy, ex, ey, fx, fy;
+    fastPolarToCartesian(WEATHER_ICON_RADIUS, direction, sx, sy);
+    fastPolarToCartesian(c - 1, direction, ex, ey);
+    icon->drawLineAA(c + sx, c + sy, c + ex, c + ey, color);
+
+    int featherAngle = (direction + 60) % 360;
+    double step = 3.0;
+    double along = c - 1;
+    int pennants = speed / 50;
+    int feathers = (speed % 50) / 10;
+    bool half = (speed % 10) >= 5;
+
+    for (int i = 0; i < pennants; i++) {
+        double ax, ay, bx, by;
+        fastPolarToCartesian(along, direction, ax, ay);
+        fastPolarToCartesian(along - 2 * step, direction, bx, by);
+        fastPolarToCartesian(9, featherAngle, fx, fy);
+        float poly[] = {
+            (float) (c + ax), (float) (c + ay),
+            (float) (c + ax + fx), (float) (c + ay + fy),
+            (float) (c + bx), (float) (c + by),
+        };
+        icon->fillPolygon(poly, 3, color);
+        along -= 2 * step + 1;
+    }
+    for (int i = 0; i < feathers; i++) {
+        fastPolarToCartesian(along, direction, sx, sy);
+        fastPolarToCartesian(9, featherAngle, fx, fy);
+        icon->drawLineAA(c + sx, c + sy, c + sx + fx, c + sy + fy, color);
+        along -= step;
+    }
+    if (half) {
+        if (pennants == 0 && feathers == 0) {
+            // a lone half feather is set off from the end so it isn't mistaken for a full one
+            along -= step;
         }
+        fastPolarToCartesian(along, direction, sx, sy);
+        fastPolarToCartesian(5, featherAngle, fx, fy);
+        icon->drawLineAA(c + sx, c + sy, c + sx + fx, c + sy + fy, color);
     }
+    return icon;
 }
 
 void OverlayedMap::drawCalibrationOverlay() {
@@ -295,6 +675,115 @@ void OverlayedMap::drawCalibrationOverlay() {
     mapImage->drawLine(centerX, centerY + r / 2, centerX, centerY - r / 2, color);
 }
 
+bool OverlayedMap::NavLayerKey::operator==(const NavLayerKey &o) const {
+    return world == o.world && nodeRevision == o.nodeRevision && page == o.page && zoom == o.zoom &&
+           width == o.width && height == o.height && northOffset == o.northOffset &&
+           nodeFilter == o.nodeFilter && showText == o.showText &&
+           showDetailedText == o.showDetailedText && config == o.config &&
+           lodCellDegrees == o.lodCellDegrees;
+}
+
+bool OverlayedMap::ScriptLayerKey::operator==(const ScriptLayerKey &o) const {
+    return revision == o.revision && page == o.page && zoom == o.zoom &&
+           width == o.width && height == o.height && northOffset == o.northOffset;
+}
+
+void OverlayedMap::drawScriptOverlays() {
+    auto snapshot = ScriptOverlays::shared().get();
+    if (snapshot->layers.empty()) {
+        scriptLayerValid = false;
+        return;
+    }
+
+    ScriptLayerKey key;
+    key.revision = snapshot->revision;
+    key.page = stitcher->getCurrentPage();
+    key.zoom = stitcher->getZoomLevel();
+    key.width = mapImage->getWidth();
+    key.height = mapImage->getHeight();
+    key.northOffset = getNorthOffset();
+
+    auto center = stitcher->getCenter();
+    auto dim = tileSource->getTileDimensions(key.zoom);
+    int dx = std::lround((center.x - scriptLayerCenter.x) * dim.x);
+    int dy = std::lround((center.y - scriptLayerCenter.y) * dim.y);
+
+    if (!scriptLayerValid || !(key == scriptLayerKey) || std::abs(dx) > NAV_LAYER_MARGIN || std::abs(dy) > NAV_LAYER_MARGIN) {
+        scriptLayerKey = key;
+        scriptLayerValid = true;
+        scriptLayerCenter = center;
+        buildScriptLayer(*snapshot);
+        dx = dy = 0;
+    }
+
+    mapImage->blendImage0(*scriptLayer, -NAV_LAYER_MARGIN - dx, -NAV_LAYER_MARGIN - dy);
+}
+
+void OverlayedMap::buildScriptLayer(const ScriptOverlays::Snapshot &snapshot) {
+    int w = mapImage->getWidth() + 2 * NAV_LAYER_MARGIN;
+    int h = mapImage->getHeight() + 2 * NAV_LAYER_MARGIN;
+    if (!scriptLayer) {
+        scriptLayer = std::make_shared<img::Image>();
+    }
+    scriptLayer->resize(w, h, 0);
+    scriptLayer->clear(0);
+
+    const int r = SCRIPT_SYMBOL_RADIUS;
+    std::vector<img::TextLabel> labels;
+    for (auto &entry: snapshot.layers) {
+        const ScriptDrawList &list = *entry.second;
+
+        // all points of a layer are projected at once, the commands only refer to them
+        size_t count = list.lats.size();
+        scriptX.resize(count);
+        scriptY.resize(count);
+        positionsToPixels(list.lats.data(), list.lons.data(), count, scriptX.data(), scriptY.data());
+        for (size_t i = 0; i < count; i++) {
+            scriptX[i] += NAV_LAYER_MARGIN;
+            scriptY[i] += NAV_LAYER_MARGIN;
+        }
+
+        // the segments are clipped to the layer by drawLineAA
+        for (auto &line: list.polylines) {
+            for (uint32_t i = line.first + 1; i < line.first + line.count; i++) {
+                scriptLayer->drawLineAA(scriptX[i - 1], scriptY[i - 1], scriptX[i], scriptY[i], line.color);
+            }
+        }
+
+        for (auto &symbol: list.symbols) {
+            int x = scriptX[symbol.point];
+            int y = scriptY[symbol.point];
+            // the layer's margin is wider than the view moves, so symbols at its edge can be dropped
+            if (x < r || y < r || x >= w - r || y >= h - r) {
+                continue;
+            }
+            switch (symbol.shape) {
+            case ScriptDrawList::Shape::SQUARE:
+                scriptLayer->fillRectangle(x - r, y - r, x + r, y + r, symbol.color);
+                break;
+            case ScriptDrawList::Shape::TRIANGLE:
+                scriptLayer->drawLineAA(x, y - r, x + r, y + r, symbol.color);
+                scriptLayer->drawLineAA(x + r, y + r, x - r, y + r, symbol.color);
+                scriptLayer->drawLineAA(x - r, y + r, x, y - r, symbol.color);
+                break;
+            default:
+                scriptLayer->fillCircle(x, y, r, symbol.color);
+                break;
+            }
+        }
+
+        for (auto &label: list.labels) {
+            int x = scriptX[label.point];
+            int y = scriptY[label.point];
+            if (x >= 0 && y >= 0 && x < w && y < h) {
+                labels.push_back({label.text, SCRIPT_TEXT_SIZE, x + r + 2, y - SCRIPT_TEXT_SIZE / 2,
+                                  label.color, img::COLOR_TRANSPARENT, img::Align::LEFT});
+            }
+        }
+    }
+    scriptLayer->drawTexts(labels);
+}
+
 void OverlayedMap::drawNavWorldOverlays() {
     if (!navWorld) {
         return;
@@ -327,10 +816,19 @@ void OverlayedMap::drawNavWorldOverlays() {
     LOG_INFO(DBG_OVERLAYS,"Estimating %d nodes in (%0.2f,%0.2f) -> (%0.2f,%0.2f)",
                     maxNodeDensity, searchMin.longitude, searchMin.latitude,
                     searchMax.longitude, searchMax.latitude);
+    double lodCellDegrees = 0;
     if (maxNodeDensity > MAX_VISIT_OBJECTS_IN_FRAME) {
-        return;
-    }
-    if (maxNodeDensity > DENSITY_LIMIT_AIRFIELDS) {
+        // too many nodes to show, fall back to the most significant airport of each cell
+        nodeFilter &= (world::World::VISIT_TOWERED_AIRPORTS | world::World::VISIT_OTHER_AIRPORTS);
+        if (!nodeFilter) {
+            return;
+        }
+        double spanLon = maxLon - minLon;
+        if (spanLon <= 0) {
+            spanLon += 360;
+        }
+        lodCellDegrees = LOD_CELL_PIXELS * spanLon / mapImage->getWidth();
+    } else if (maxNodeDensity > DENSITY_LIMIT_AIRFIELDS) {
         nodeFilter &= ~(world::World::VISIT_OTHER_AIRPORTS);
     }
     if (maxNodeDensity > DENSITY_LIMIT_NAVAIDS) {
@@ -347,68 +845,196 @@ void OverlayedMap::drawNavWorldOverlays() {
     }
 
     // All the short-circuit tests have been done now, and we know that at least some
-    // overlays should be displayed. Get the qualifying NAV nodes from the world data
-    // and reuse the associated overlay where available, or create a new overlay if not.
-
-    int reusedOverlays = 0; // this is only used for cache hit statistics
-    std::shared_ptr<NavNodeToOverlayMap> nodes = std::make_shared<NavNodeToOverlayMap>();
-
-    navWorld->visitNodes(searchMin, searchMax,
-                        [this, &reusedOverlays, nodes] (const world::NavNode *node) {
-                            // coarse filtering has been done by the NAV world, but
-                            // further detailed filtering is needed here
-                            if (!isOverlayConfigured(node)) return;
-                            // did we already see this NAV item in the previous frame?
-                            // if so then we can just reuse its overlay node
-                            std::shared_ptr<OverlayedNode> on;
-                            auto i = overlayNodeCache->find(node);
-                            if (i == overlayNodeCache->end()) {
-                                on = makeOverlayedNode(node);
-                            } else {
-                                on = (*overlayNodeCache)[node];
-                                ++reusedOverlays;
-                            }
-                            if (on) {
-                                (*nodes)[node] = on;
-                                on->configure(*(overlayConfig.get()), node->getLocation());
-                            }
-                        },
-                        nodeFilter);
-
+    // overlays should be displayed. Everything that decides what the layer contains
+    // goes into its key, only the position of the view is checked separately.
+    NavLayerKey key;
+    key.world = navWorld.get();
+    key.nodeRevision = navWorld->getNodeRevision();
+    key.page = stitcher->getCurrentPage();
+    key.zoom = stitcher->getZoomLevel();
+    key.width = mapImage->getWidth();
+    key.height = mapImage->getHeight();
+    key.northOffset = getNorthOffset();
+    key.nodeFilter = nodeFilter;
+    key.showText = (maxNodeDensity < DENSITY_LIMIT_SHOW_TEXT);
     // decide whether all nodes should show their detailed text, this will be based
     // on the reported node density
-    const bool showDetailedText = (maxNodeDensity < DENSITY_LIMIT_DETAILED_TEXT);
+    key.showDetailedText = (maxNodeDensity < DENSITY_LIMIT_DETAILED_TEXT);
+    key.config = *overlayConfig;
+    key.lodCellDegrees = lodCellDegrees;
 
-    // work out which highlights are active, and initialise them
+    auto center = stitcher->getCenter();
+    auto dim = tileSource->getTileDimensions(key.zoom);
+    int dx = std::lround((center.x - navLayerCenter.x) * dim.x);
+    int dy = std::lround((center.y - navLayerCenter.y) * dim.y);
+
+    bool rebuilt = false;
+    if (!navLayerValid || !(key == navLayerKey) || std::abs(dx) > NAV_LAYER_MARGIN || std::abs(dy) > NAV_LAYER_MARGIN) {
+        buildNavLayer(key);
+        navLayerCenter = center;
+        dx = dy = 0;
+        rebuilt = true;
+    }
+
+    // work out which highlights are active, and initialise them. The reference points
+    // move with the view, so the layer has to be rendered again if they pick other nodes.
     for (size_t i = 0; i < NUM_HIGHLIGHT_NODES; ++i) {
         highlights[i].reset();
     }
-    if (!showDetailedText) {
+    if (!key.showDetailedText) {
+        int ox = NAV_LAYER_MARGIN + dx;
+        int oy = NAV_LAYER_MARGIN + dy;
         if (lastClickX > 0) {
-            highlights[LAST_CLICK].activate(lastClickX, lastClickY);
+            highlights[LAST_CLICK].activate(lastClickX + ox, lastClickY + oy);
         }
-        if (overlayConfig->drawMyAircraft && !planeLocations.empty()) {
+        if (overlayConfig->drawMyAircraft && !planeLocations->locations.empty()) {
             int x, y;
-            positionToPixel(planeLocations[0].latitude, planeLocations[0].longitude, x, y);
-            highlights[USER_PLANE].activate(x, y);
+            positionToPixel(planeLocations->locations[0].latitude, planeLocations->locations[0].longitude, x, y);
+            highlights[USER_PLANE].activate(x + ox, y + oy);
         }
-        highlights[MAP_CENTER].activate(mapImage->getWidth() / 2, mapImage->getHeight() / 2);
+        highlights[MAP_CENTER].activate(mapImage->getWidth() / 2 + ox, mapImage->getHeight() / 2 + oy);
+    }
+    bool highlightsChanged = false;
+    for (size_t i = 0; i < NUM_HIGHLIGHT_NODES; ++i) {
+        for (auto &on: navLayerFixes) {
+            highlights[i].update(on);
+        }
+        for (auto &on: navLayerAerodromes) {
+            highlights[i].update(on);
+        }
+        if (highlights[i].getNode() != navLayerHighlights[i]) {
+            navLayerHighlights[i] = highlights[i].getNode();
+            highlightsChanged = true;
+        }
+    }
+
+    if (rebuilt || highlightsChanged) {
+        renderNavLayer(dx, dy);
+    }
+
+    mapImage->blendImage0(*navLayer, -NAV_LAYER_MARGIN - dx, -NAV_LAYER_MARGIN - dy);
+}
+
+void OverlayedMap::buildNavLayer(const NavLayerKey &key) {
+    navLayerKey = key;
+    navLayerValid = true;
+
+    // The layer extends beyond the map image, so search the area it covers
+    double marginDegrees = (double)MAX_ILS_RANGE_NM / MAX_NM_PER_DEGREE;
+    int w = mapImage->getWidth();
+    int h = mapImage->getHeight();
+    double lats[4], lons[4];
+    pixelToPosition(-NAV_LAYER_MARGIN, -NAV_LAYER_MARGIN, lats[0], lons[0]);
+    pixelToPosition(w + NAV_LAYER_MARGIN - 1, -NAV_LAYER_MARGIN, lats[1], lons[1]);
+    pixelToPosition(-NAV_LAYER_MARGIN, h + NAV_LAYER_MARGIN - 1, lats[2], lons[2]);
+    pixelToPosition(w + NAV_LAYER_MARGIN - 1, h + NAV_LAYER_MARGIN - 1, lats[3], lons[3]);
+    world::Location searchMin(*std::min_element(lats, lats + 4) - marginDegrees, *std::min_element(lons, lons + 4) - marginDegrees);
+    world::Location searchMax(*std::max_element(lats, lats + 4) + marginDegrees, *std::max_element(lons, lons + 4) + marginDegrees);
+
+    // Get the qualifying NAV nodes from the world data and reuse the associated overlay
+    // where available, or create a new overlay if not.
+    int reusedOverlays = 0; // this is only used for cache hit statistics
+    size_t previousOverlays = overlayNodeCache.size();
+    uint32_t generation = ++overlayGeneration;
+
+    if (!navLayer) {
+        navLayer = std::make_shared<img::Image>();
+    }
+    navLayer->resize(w + 2 * NAV_LAYER_MARGIN, h + 2 * NAV_LAYER_MARGIN, 0);
+    drawTarget = navLayer;
+    pixelOffsetX = pixelOffsetY = NAV_LAYER_MARGIN;
+
+    auto &scratch = navLayerScratch;
+    scratch.nodes.clear();
+    scratch.overlays.clear();
+    world::World::NodeAcceptor acceptor = [this, &reusedOverlays, &scratch, generation] (const world::NavNode *node) {
+        // coarse filtering has been done by the NAV world, but
+        // further detailed filtering is needed here
+        if (!isOverlayConfigured(node)) return;
+        // did we already see this NAV item in the previous layer?
+        // if so then we can just reuse its overlay node
+        auto i = overlayNodeCache.find(node);
+        if (i == overlayNodeCache.end()) {
+            i = overlayNodeCache.emplace(node, CachedOverlay {node->weak_from_this().lock(), makeOverlayedNode(node), 0}).first;
+        } else if (i->second.generation == generation) {
+            return; // visited twice
+        } else {
+            ++reusedOverlays;
+        }
+        i->second.generation = generation;
+        if (i->second.overlay) {
+            scratch.nodes.push_back(node);
+            scratch.overlays.push_back(i->second.overlay);
+        }
+    };
+    if (key.lodCellDegrees > 0) {
+        navWorld->visitMajorAirports(searchMin, searchMax, key.lodCellDegrees, acceptor, key.nodeFilter);
+    } else {
+        navWorld->visitNodes(searchMin, searchMax, acceptor, key.nodeFilter);
     }
 
-    // split the collection of nodes into fixes and aerodromes, and find the ones to be highlighted
-    std::vector<std::shared_ptr<OverlayedNode>> fixes;
-    std::vector<std::shared_ptr<OverlayedNode>> aerodromes;
-    for (auto on: *nodes) {
-        if (on.second->isAirfield()) {
-            aerodromes.push_back(on.second);
+    // Drop the overlays that this layer doesn't show. Those that are still referenced,
+    // e.g. by a highlight, are destroyed once released.
+    for (auto it = overlayNodeCache.begin(); it != overlayNodeCache.end(); ) {
+        if (it->second.generation != generation) {
+            it = overlayNodeCache.erase(it);
         } else {
-            fixes.push_back(on.second);
+            ++it;
         }
-        for (size_t i = 0; i < NUM_HIGHLIGHT_NODES; ++i) {
-            highlights[i].update(on.second);
+    }
+
+    // project all accepted nodes in one go, then let them configure themselves
+    size_t count = scratch.nodes.size();
+    scratch.lats.resize(count);
+    scratch.lons.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        auto &loc = scratch.nodes[i]->getLocation();
+        scratch.lats[i] = loc.latitude;
+        scratch.lons[i] = loc.longitude;
+    }
+    scratch.px.resize(count);
+    scratch.py.resize(count);
+    positionsToPixels(scratch.lats.data(), scratch.lons.data(), count, scratch.px.data(), scratch.py.data());
+    for (size_t i = 0; i < count; i++) {
+        auto &on = scratch.overlays[i];
+        on->setPosition(scratch.px[i], scratch.py[i]);
+        on->configure(*(overlayConfig.get()), scratch.nodes[i]->getLocation());
+    }
+
+    // split the collection of nodes into fixes and aerodromes
+    navLayerFixes.clear();
+    navLayerAerodromes.clear();
+    for (auto &on: scratch.overlays) {
+        if (on->isAirfield()) {
+            navLayerAerodromes.push_back(on);
+        } else {
+            navLayerFixes.push_back(on);
         }
     }
 
+    // Lay out the compact labels once per layer so that they don't overlap. Highlighted
+    // nodes draw their detailed text on top of everything, so they don't take part.
+    if (key.showText && !key.showDetailedText) {
+        labelPlacer.declutter(scratch.overlays, navLayer->getWidth(), navLayer->getHeight());
+    } else {
+        for (auto &on: scratch.overlays) {
+            on->setTextHidden(false);
+        }
+    }
+
+    drawTarget = mapImage;
+    pixelOffsetX = pixelOffsetY = 0;
+
+    LOG_INFO(DBG_OVERLAYS, "zoom = %2d, nm/pix = %0.3f, mapWidth = %0.1f nm, maxNodes = %d, actual = %d (%d/%d from cache)",
+        stitcher->getZoomLevel(), mapScaleNMperPixel, mapWidthNM, maxNodeDensity, (int) count, reusedOverlays, (int) previousOverlays);
+}
+
+void OverlayedMap::renderNavLayer(int dx, int dy) {
+    navLayer->clear(0);
+    drawTarget = navLayer;
+    pixelOffsetX = NAV_LAYER_MARGIN + dx;
+    pixelOffsetY = NAV_LAYER_MARGIN + dy;
+
     // the nearest nodes have been identified, now mark them as selected
     for (size_t i = 0; i < NUM_HIGHLIGHT_NODES; ++i) {
         highlights[i].select();
@@ -416,31 +1042,26 @@ void OverlayedMap::drawNavWorldOverlays() {
 
     // Render the list of visible OverlayedNodes:
     // Fix graphics, aerodrome graphics, then fix text and aerodrome text, then highlighted text
-    for (auto on: fixes) {
+    for (auto &on: navLayerFixes) {
         on->drawGraphic();
     }
-    for (auto on: aerodromes) {
+    for (auto &on: navLayerAerodromes) {
         on->drawGraphic();
     }
-    if (maxNodeDensity < DENSITY_LIMIT_SHOW_TEXT) {
-        for (auto on: fixes) {
-            if (!on->isHighlighted()) on->drawText(showDetailedText);
+    if (navLayerKey.showText) {
+        for (auto &on: navLayerFixes) {
+            if (!on->isHighlighted() && !on->isTextHidden()) on->drawText(navLayerKey.showDetailedText);
         }
-        for (auto on: aerodromes) {
-            if (!on->isHighlighted()) on->drawText(showDetailedText);
+        for (auto &on: navLayerAerodromes) {
+            if (!on->isHighlighted() && !on->isTextHidden()) on->drawText(navLayerKey.showDetailedText);
         }
     }
     for (size_t i = 0; i < NUM_HIGHLIGHT_NODES; ++i) {
         highlights[i].highlight();
     }
 
-    LOG_INFO(DBG_OVERLAYS, "zoom = %2d, nm/pix = %0.3f, mapWidth = %0.1f nm, maxNodes = %d, actual = %d (%d/%d from cache)",
-        stitcher->getZoomLevel(), mapScaleNMperPixel, mapWidthNM, maxNodeDensity, nodes->size(), reusedOverlays, overlayNodeCache->size());
-
-    // Keep this frame's overlays for next time. The previous cache will be disposed of and
-    // and the overlay shared pointers released, which will result in the overlay being destroyed
-    // if it wasn't reused in this frame.
-    overlayNodeCache = nodes;
+    drawTarget = mapImage;
+    pixelOffsetX = pixelOffsetY = 0;
 }
 
 int OverlayedMap::getMapDensity() const {
@@ -502,15 +1123,25 @@ void OverlayedMap::positionToPixel(double lat, double lon, int& px, int& py) con
 }
 
 void OverlayedMap::positionToPixel(double lat, double lon, int& px, int& py, int zoomLevel) const {
+    tileToPixel(tileSource->worldToXY(lon, lat, zoomLevel), zoomLevel, px, py);
+}
+
+void OverlayedMap::positionsToPixels(const double *lats, const double *lons, size_t count, int *px, int *py) const {
+    int zoomLevel = stitcher->getZoomLevel();
+    std::vector<img::Point<double>> tileXY(count);
+    tileSource->worldToXYBatch(lons, lats, tileXY.data(), count, zoomLevel);
+    for (size_t i = 0; i < count; i++) {
+        tileToPixel(tileXY[i], zoomLevel, px[i], py[i]);
+    }
+}
+
+void OverlayedMap::tileToPixel(img::Point<double> tileXY, int zoomLevel, int &px, int &py) const {
     auto mapWidth = tileSource->getPageDimensions(0, zoomLevel).x;
     auto dim = tileSource->getTileDimensions(zoomLevel);
 
     // Center tile num
     auto centerXY = stitcher->getCenter();
 
-    // Target tile num
-    auto tileXY = tileSource->worldToXY(lon, lat, zoomLevel);
-
     // Adjust for wrapping at the -180/180 meridian
     if (tileXY.x > (centerXY.x + (mapWidth / 2))) {
         tileXY.x -= mapWidth;
@@ -518,8 +1149,8 @@ void OverlayedMap::positionToPixel(double lat, double lon, int& px, int& py, int
         tileXY.x += mapWidth;
     }
 
-    px = mapImage->getWidth() / 2 + (tileXY.x - centerXY.x) * dim.x;
-    py = mapImage->getHeight() / 2 + (tileXY.y - centerXY.y) * dim.y;
+    px = mapImage->getWidth() / 2 + (tileXY.x - centerXY.x) * dim.x + pixelOffsetX;
+    py = mapImage->getHeight() / 2 + (tileXY.y - centerXY.y) * dim.y + pixelOffsetY;
 }
 
 void OverlayedMap::updateMapAttributes()
@@ -589,8 +1220,8 @@ void OverlayedMap::polarToCartesian(float radius, float angleDegrees, double& x,
 }
 
 bool OverlayedMap::isAreaVisible(int xmin, int ymin, int xmax, int ymax) const {
-    return (xmax > 0) && (xmin < mapImage->getWidth()) &&
-           (ymax > 0) && (ymin < mapImage->getHeight());
+    return (xmax > 0) && (xmin < drawTarget->getWidth()) &&
+           (ymax > 0) && (ymin < drawTarget->getHeight());
 }
 
 int OverlayedMap::getZoomLevel() const {
@@ -623,6 +1254,7 @@ void OverlayedMap::setCalibrationPoint1(double lat, double lon) {
     tileSource->attachCalibration1(center.x, center.y, lat, lon, stitcher->getZoomLevel());
 
     calibrationStep = 2;
+    navLayerValid = false;
     updateImage();
 }
 
@@ -631,6 +1263,7 @@ void OverlayedMap::setCalibrationPoint2(double lat, double lon) {
     tileSource->attachCalibration2(center.x, center.y, lat, lon, stitcher->getZoomLevel());
 
     calibrationStep = 3;
+    navLayerValid = false;
     updateImage();
 }
 
@@ -638,12 +1271,14 @@ void OverlayedMap::setCalibrationPoint3(double lat, double lon) {
     auto center = stitcher->getCenter();
     tileSource->attachCalibration3Point(center.x, center.y, lat, lon, stitcher->getZoomLevel());
     calibrationStep = 0;
+    navLayerValid = false;
     updateImage();
 }
 
 void OverlayedMap::setCalibrationAngle(double angle) {
     tileSource->attachCalibration3Angle(angle);
     calibrationStep = 0;
+    navLayerValid = false;
     updateImage();
 }
 
@@ -652,7 +1287,7 @@ int OverlayedMap::getCalibrationStep() const {
 }
 
 std::shared_ptr<img::Image> OverlayedMap::getMapImage() {
-    return mapImage;
+    return drawTarget;
 }
 
 void OverlayedMap::drawRoute() {
@@ -666,6 +1301,17 @@ void OverlayedMap::drawRoute() {
     overlayedRoute->draw(route);
 }
 
+void OverlayedMap::drawProcedure() {
+    auto procedure = getProcedure ? getProcedure() : nullptr;
+    if (!procedure || !overlayConfig->drawRoute) {
+        return;
+    }
+    if (!overlayedProcedure) {
+        overlayedProcedure = std::make_unique<OverlayedProcedure>(static_cast<IOverlayHelper *>(this));
+    }
+    overlayedProcedure->draw(procedure);
+}
+
 bool maps::OverlayedMap::isOverlayConfigured(const world::NavNode *nn) const {
     if (auto a = dynamic_cast<const world::Airport *>(nn)) {
         // use config settings to filter heliports/seaports and airfields
@@ -708,6 +1354,9 @@ std::shared_ptr<OverlayedNode> OverlayedMap::makeOverlayedNode(world::NavNode co
             on = std::make_shared<OverlayedWaypoint>(static_cast<IOverlayHelper *>(this), f);
         }
     }
+    if (on) {
+        on->pinNode(nn->weak_from_this().lock());
+    }
     return on;
 }
 
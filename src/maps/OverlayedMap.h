@@ -20,6 +20,8 @@
 
 #include <memory>
 #include <functional>
+#include <chrono>
+#include <unordered_map>
 #include "src/libimg/stitcher/Stitcher.h"
 #include "src/world/World.h"
 #include "src/libimg/TTFStamper.h"
@@ -28,7 +30,11 @@
 #include "OverlayConfig.h"
 #include "OverlayedNode.h"
 #include "OverlayedRoute.h"
+#include "OverlayedProcedure.h"
 #include "OverlayHighlight.h"
+#include "LabelPlacer.h"
+#include "OverlayTimings.h"
+#include "ScriptOverlays.h"
 
 namespace maps {
 
@@ -36,11 +42,15 @@ class OverlayedMap : public IOverlayHelper {
 public:
     using OverlaysDrawnCallback = std::function<void(void)>;
     using GetRouteCallback = std::function<std::shared_ptr<world::Route>(void)>;
+    using GetProcedureCallback = std::function<std::shared_ptr<world::Procedure>(void)>;
+    using GetWeatherCallback = std::function<std::shared_ptr<const avitab::WeatherStations>(void)>;
 
     OverlayedMap(std::shared_ptr<img::Stitcher> stitchedMap, std::shared_ptr<OverlayConfig> overlays);
     void loadOverlayIcons(const std::string &path);
     void setRedrawCallback(OverlaysDrawnCallback cb);
     void setGetRouteCallback(GetRouteCallback cb);
+    void setGetProcedureCallback(GetProcedureCallback cb);
+    void setGetWeatherCallback(GetWeatherCallback cb);
     void setNavWorld(std::shared_ptr<world::World> world);
 
     bool mouse(int px, int py, bool down);
@@ -48,9 +58,12 @@ public:
 
     void centerOnWorldPos(double latitude, double longitude);
     void centerOnPlane();
-    void setPlaneLocations(std::vector<avitab::Location> &locs);
+    void setPrefetchMinutes(int minutes);
+    void setPlaneLocations(avitab::AircraftLocations locs);
     void getCenterLocation(double &latitude, double &longitude);
     float getVerticalRange() const;
+    // bounds of the shown area, rotated maps included
+    void getVisibleArea(double &minLat, double &minLon, double &maxLat, double &maxLon) const;
 
     void updateImage();
     void zoomIn();
@@ -65,6 +78,8 @@ public:
     int getCalibrationStep() const;
     std::string getCalibrationReport() const;
 
+    const OverlayTimings &getOverlayTimings() const;
+
     // Call periodically to refresh tiles that were pending
     void doWork();
 
@@ -79,6 +94,7 @@ public:
     void fastPolarToCartesian(float radius, int angleDegrees, double& x, double& y) const override;
     void positionToPixel(double lat, double lon, int &px, int &py) const override;
     void positionToPixel(double lat, double lon, int &px, int &py, int zoomLevel) const override;
+    void positionsToPixels(const double *lats, const double *lons, size_t count, int *px, int *py) const override;
 
 private:
     // Highlighted nodes
@@ -104,37 +120,136 @@ private:
 
     OverlaysDrawnCallback onOverlaysDrawn;
 
-    using NavNodeToOverlayMap = std::map<const world::NavNode *, std::shared_ptr<OverlayedNode>>;
-    std::shared_ptr<NavNodeToOverlayMap> overlayNodeCache;
+    // The overlays of the NAV nodes in the last layer, reused by the next one. Each rebuild
+    // stamps the entries it visits with its generation and drops the others afterwards.
+    // The entries pin their node, so that a node evicted by the world isn't freed
+    // and its address reused while the layer still shows it.
+    struct CachedOverlay {
+        std::shared_ptr<const world::NavNode> node;
+        std::shared_ptr<OverlayedNode> overlay;
+        uint32_t generation;
+    };
+    std::unordered_map<const world::NavNode *, CachedOverlay> overlayNodeCache;
+    uint32_t overlayGeneration = 0;
+
+    // reused by each rebuild so that it doesn't allocate once the vectors are large enough
+    struct NavLayerScratch {
+        std::vector<const world::NavNode *> nodes;
+        std::vector<std::shared_ptr<OverlayedNode>> overlays;
+        std::vector<double> lats, lons;
+        std::vector<int> px, py;
+    } navLayerScratch;
+
+    // The NAV overlays are rendered into their own transparent layer that covers the map
+    // image plus a margin. It is reused, shifted by whole pixels, until the view leaves
+    // the margin or anything else that affects the rendering changes.
+    struct NavLayerKey {
+        const world::World *world;
+        uint32_t nodeRevision;
+        int page, zoom, width, height;
+        double northOffset;
+        int nodeFilter;
+        bool showText, showDetailedText;
+        OverlayConfig config;
+        double lodCellDegrees;  // 0 unless only the major airports are shown
+
+        bool operator==(const NavLayerKey &o) const;
+    };
+    std::shared_ptr<img::Image> navLayer;
+    NavLayerKey navLayerKey {};
+    bool navLayerValid = false;
+    img::Point<double> navLayerCenter;
+    std::vector<std::shared_ptr<OverlayedNode>> navLayerFixes, navLayerAerodromes;
+    std::shared_ptr<OverlayedNode> navLayerHighlights[NUM_HIGHLIGHT_NODES];
+    LabelPlacer labelPlacer;
+
+    // The scripts' overlays get a layer of the same kind, rebuilt when they or the view change
+    struct ScriptLayerKey {
+        uint64_t revision;
+        int page, zoom, width, height;
+        double northOffset;
+
+        bool operator==(const ScriptLayerKey &o) const;
+    };
+    std::shared_ptr<img::Image> scriptLayer;
+    ScriptLayerKey scriptLayerKey {};
+    bool scriptLayerValid = false;
+    img::Point<double> scriptLayerCenter;
+    std::vector<int> scriptX, scriptY;
+
+    // the image the overlay nodes draw on and the shift applied to their pixel positions,
+    // only different from the map image while the NAV layer is rendered
+    std::shared_ptr<img::Image> drawTarget;
+    int pixelOffsetX = 0, pixelOffsetY = 0;
 
     std::unique_ptr<OverlayedRoute> overlayedRoute;
     GetRouteCallback getRoute;
+    std::unique_ptr<OverlayedProcedure> overlayedProcedure;
+    GetProcedureCallback getProcedure;
+
+    GetWeatherCallback getWeather;
+    std::vector<const avitab::WeatherStations::Station *> weatherStations;
+    std::vector<double> weatherLats, weatherLons;
+    std::vector<int> weatherX, weatherY;
+    std::vector<bool> weatherCellUsed;
+    std::shared_ptr<img::Image> createWeatherStationIcon(avitab::FlightCategory category) const;
+    std::shared_ptr<img::Image> createWindBarbIcon(int direction, int speed) const;
 
     float sinTable[360];
     float cosTable[360];
 
     std::shared_ptr<world::World> navWorld;
-    std::vector<avitab::Location> planeLocations;
+    avitab::AircraftLocations planeLocations;
     img::Image planeIcon;
     enum RelativeHeight { below, same, above, total };
     uint32_t otherAircraftColors[RelativeHeight::total];
+    std::vector<double> trafficLats, trafficLons;
+    std::vector<int> trafficX, trafficY;
+    std::shared_ptr<img::Image> createTrafficIcon(uint32_t color, int heading) const;
 
     int calibrationStep = 0;
 
+    // render times of the overlay layers, and the layers skipped on the last frame to meet the budget
+    OverlayTimings timings;
+    bool layerDeferred[OverlayTimings::NUM_LAYERS] {};
+    bool drewOverlays = false;
+
+    // track-based tile prefetching while following the plane
+    int prefetchMinutes = DEFAULT_PREFETCH_MINUTES;
+    double groundSpeedKnots = 0;
+    world::Location speedSampleLocation;
+    std::chrono::steady_clock::time_point speedSampleTime;
+    std::chrono::steady_clock::time_point lastPrefetchTime;
+    std::chrono::steady_clock::time_point lastNavPrefetchTime;
+
+    void updateGroundSpeed();
+    void prefetchAlongTrack();
+    void prefetchNavAreas();
+
     void drawOverlays();
+    void drawTimedLayer(OverlayTimings::Layer layer, std::chrono::steady_clock::time_point frameStart,
+                        const std::function<void()> &draw);
+    void drawTimings();
     void drawAircraftOverlay();
     void drawOtherAircraftOverlay();
     void drawNavWorldOverlays();
+    void drawWeatherOverlay();
+    void buildNavLayer(const NavLayerKey &key);
+    void renderNavLayer(int dx, int dy);
     void drawCalibrationOverlay();
     void drawScale();
     void drawCompass();
     void drawRoute();
+    void drawProcedure();
+    void drawScriptOverlays();
+    void buildScriptLayer(const ScriptOverlays::Snapshot &snapshot);
 
     std::shared_ptr<OverlayedNode> makeOverlayedNode(const world::NavNode *);
     bool isOverlayConfigured(const world::NavNode *) const;
 
     void updateMapAttributes();
     void pixelToPosition(int px, int py, double &lat, double &lon) const;
+    void tileToPixel(img::Point<double> tileXY, int zoomLevel, int &px, int &py) const;
     float cosDegrees(int angleDegrees) const;
     float sinDegrees(int angleDegrees) const;
     void polarToCartesian(float radius, float angleRadians, double& x, double& y);
@@ -146,13 +261,32 @@ private:
     static constexpr const int DENSITY_LIMIT_AIRFIELDS = 15000;
     static constexpr const int DENSITY_LIMIT_NAVAIDS = 6000;
     static constexpr const int DENSITY_LIMIT_FIXES = 3000;
-    static constexpr const int DENSITY_LIMIT_SHOW_TEXT = 400;
+    // compact labels are decluttered, so they can be shown up to the density where airports become blobs
+    static constexpr const int DENSITY_LIMIT_SHOW_TEXT = 1200;
     static constexpr const int DENSITY_LIMIT_DETAILED_TEXT = 200;
     // user fixes are generally shown unless significantly zoomed out
     static constexpr const int MAPWIDTH_LIMIT_USERFIXES = 2000;
 
     static constexpr const int MAX_NM_PER_DEGREE = 60; // at the equator, OK for our needs
     static constexpr const int MAX_ILS_RANGE_NM = 18; // 18nm is max ILS range in XP11 dataset
+    static constexpr const int LOD_CELL_PIXELS = 48; // zoomed out, one airport per cell of about this size
+    static constexpr const int NAV_LAYER_MARGIN = 128; // pixels the view can move before the NAV layer is rebuilt
+    static constexpr const int TRAFFIC_ICON_EXTENT = 13; // the heading arrow is 12 pixels long
+    static constexpr const int TRAFFIC_CULL_MARGIN = 30; // icon and flight level label around the position
+    static constexpr const int WEATHER_ICON_RADIUS = 5;
+    static constexpr const int WEATHER_BARB_EXTENT = 24; // staff and feathers around the station
+    static constexpr const int WEATHER_CELL_PIXELS = 20; // one station per cell of about this size
+    static constexpr const int MAPWIDTH_LIMIT_WEATHER = 3000; // no stations when zoomed out further
+    static constexpr const int MAPWIDTH_LIMIT_WIND = 600; // no wind barbs when zoomed out further
+    static constexpr const int MIN_WIND_KNOTS = 3; // calm below, no barb
+    static constexpr const int MAX_WIND_STEPS = 20; // barbs in 5 knot steps up to 100 knots
+    static constexpr const int SCRIPT_SYMBOL_RADIUS = 4;
+    static constexpr const int SCRIPT_TEXT_SIZE = 12;
+
+    static constexpr const int DEFAULT_PREFETCH_MINUTES = 5;
+    static constexpr const int PREFETCH_INTERVAL_SECONDS = 5;
+    static constexpr const int PREFETCH_STEPS = 8;
+    static constexpr const double MIN_PREFETCH_SPEED_KNOTS = 30;
 };
 
 } /* namespace maps */
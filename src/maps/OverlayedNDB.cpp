@@ -17,39 +17,34 @@
  */
 
 #include "OverlayedNDB.h"
+#include "src/libimg/SpriteCache.h"
 #include <cmath>
 
 namespace maps {
 
-img::Image OverlayedNDB::ndbIcon;
-int OverlayedNDB::radius;
-
 OverlayedNDB::OverlayedNDB(IOverlayHelper *h, const world::Fix *f):
     OverlayedFix(h, f),
     navNDB(f->getNDB().get())
 {
-    if (ndbIcon.getHeight() == 0) {
-        createNDBIcon();
-    }
 }
 
-void OverlayedNDB::createNDBIcon() {
+std::shared_ptr<img::Image> OverlayedNDB::createNDBIcon() {
     int angleStep[] = {2, 30, 24, 20, 15};
     int numRings = (int)(sizeof(angleStep) / sizeof(angleStep[0]));
     int bgSize = (numRings + 2) * 14;
-    ndbIcon.resize(bgSize * 2 + 1, bgSize * 2 + 1, 0);
-    ndbIcon.fillCircle(bgSize, bgSize, 4, img::COLOR_ICAO_MAGENTA);
+    auto ndbIcon = std::make_shared<img::Image>(bgSize * 2 + 1, bgSize * 2 + 1, 0);
+    ndbIcon->fillCircle(bgSize, bgSize, 4, img::COLOR_ICAO_MAGENTA);
     for (int ring = 0; ring < numRings; ring++) {
         int r = (ring + 1) * 14;
         for (int angleDegrees = 0; angleDegrees < 360; angleDegrees += angleStep[ring]) {
             LOG_INFO(0, "ring = %d, radius = %d, angle = %d", ring, r, angleDegrees);
             int dx = r * cos(angleDegrees * M_PI / 180.0);
             int dy = r * sin(angleDegrees * M_PI / 180.0);
-            ndbIcon.fillCircle(bgSize + dx, bgSize + dy, 4, img::COLOR_ICAO_MAGENTA);
+            ndbIcon->fillCircle(bgSize + dx, bgSize + dy, 4, img::COLOR_ICAO_MAGENTA);
         }
     }
-    ndbIcon.scale(53, 53);
-    radius = ndbIcon.getWidth() / 2;
+    ndbIcon->scale(ICON_SIZE, ICON_SIZE);
+    return ndbIcon;
 }
 
 void OverlayedNDB::configure(const OverlayConfig &cfg, const world::Location &loc)
@@ -63,7 +58,9 @@ void OverlayedNDB::drawGraphic()
     if (!enabled) return;
 
     auto mapImage = overlayHelper->getMapImage();
-    mapImage->blendImage0(ndbIcon, posX - radius, posY - radius);
+    auto key = img::SpriteCache::makeKey(img::SpriteKind::NAVAID, ICON_SIZE, img::COLOR_ICAO_MAGENTA);
+    auto ndbIcon = img::SpriteCache::shared().get(key, createNDBIcon);
+    mapImage->blendImage0(*ndbIcon, posX - radius, posY - radius);
 }
 
 void OverlayedNDB::drawText(bool detailed)
@@ -36,9 +36,9 @@ public:
 private:
     const world::NDB * const navNDB;
 
-    static img::Image ndbIcon;
-    static int radius;
-    static void createNDBIcon();
+    static constexpr const int ICON_SIZE = 53;
+    static constexpr const int radius = ICON_SIZE / 2;
+    static std::shared_ptr<img::Image> createNDBIcon();
 };
 
 } /* namespace maps */
@@ -24,16 +24,38 @@
 namespace maps {
 
 OverlayedNode::OverlayedNode(IOverlayHelper *h, bool a)
-:   overlayHelper(h), enabled(true), airfield(a), highlight(false), posX(0), posY(0)
+:   overlayHelper(h), enabled(true), airfield(a), highlight(false), textHidden(false), posX(0), posY(0)
 {
 }
 
 void OverlayedNode::configure(const OverlayConfig &cfg, const world::Location &loc)
 {
-    overlayHelper->positionToPixel(loc.latitude, loc.longitude, posX, posY);
     highlight = false;
 }
 
+bool OverlayedNode::getTextBox(TextBox &box)
+{
+    return false;
+}
+
+OverlayedNode::LabelPriority OverlayedNode::getLabelPriority() const
+{
+    return LabelPriority::FIX;
+}
+
+OverlayedNode::TextBox OverlayedNode::getLabelBox(const std::string &text, int size, int x, int y, img::Align align) const
+{
+    // same box as the background that drawText fills
+    int width = overlayHelper->getMapImage()->getTextWidth(text, size);
+    int xOffset = 0;
+    if (align == img::Align::CENTRE) {
+        xOffset = -width / 2;
+    } else if (align == img::Align::RIGHT) {
+        xOffset = -width;
+    }
+    return TextBox{x + xOffset - 1, y, x + xOffset + width, y + size};
+}
+
 int OverlayedNode::getHotspotDistance(int x, int y) const {
     if (!enabled) return 1 << 15; // sufficiently big to not be selected!
 
@@ -36,8 +36,31 @@ public:
     virtual void drawGraphic() = 0;
     virtual void drawText(bool detailed) = 0;
 
+    struct TextBox {
+        int x0, y0, x1, y1;
+    };
+    // higher priorities get their labels placed first when decluttering
+    enum class LabelPriority {
+        FIX,
+        USER_FIX,
+        NAVAID,
+        AIRFIELD,
+        TOWERED_AIRFIELD
+    };
+
+    // screen area covered by drawText(false), false if that draws nothing
+    virtual bool getTextBox(TextBox &box);
+    virtual LabelPriority getLabelPriority() const;
+
+    // the map projects all nodes of a layer in one batch before configuring them
+    void setPosition(int x, int y) { posX = x; posY = y; }
     void setHighlighted() { highlight = true; }
     void clearHighlighted() { highlight = false; }
+    void setTextHidden(bool hidden) { textHidden = hidden; }
+    bool isTextHidden() const { return textHidden; }
+
+    // keeps the node alive while the overlay refers to it, the world may evict it meanwhile
+    void pinNode(std::shared_ptr<const world::NavNode> node) { pinnedNode = std::move(node); }
 
     bool isAirfield() const { return airfield; }
     bool isHighlighted() const { return highlight; }
@@ -47,6 +70,7 @@ public:
 protected:
     using Hotspot = std::pair<int, int>;
     virtual Hotspot getClickHotspot() const { return Hotspot(posX, posY); }
+    TextBox getLabelBox(const std::string &text, int size, int x, int y, img::Align align) const;
 
 protected:
     OverlayedNode() = delete;
@@ -57,6 +81,8 @@ protected:
     bool enabled;           // true if overlay is enabled (some overlays are instantiated even when not configured)
     bool const airfield;    // used when sorting for drawing order
     bool highlight;         // true if the overlay is selected for highlighting
+    std::shared_ptr<const world::NavNode> pinnedNode;
+    bool textHidden;        // true if the label collides with a more important one
     int posX, posY;         // pixel coordinates of the item, could be off-screen
 };
 
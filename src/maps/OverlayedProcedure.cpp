@@ -0,0 +1,155 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include "OverlayedProcedure.h"
+
+namespace maps {
+
+OverlayedProcedure::OverlayedProcedure(IOverlayHelper *h):
+    overlayHelper(h)
+{
+}
+
+void OverlayedProcedure::draw(std::shared_ptr<world::Procedure> procedure) {
+    if (procedure != cachedProcedure) {
+        resolve(procedure);
+    }
+    if (paths.empty()) {
+        return;
+    }
+
+    int dx = 0, dy = 0;
+    if (!isCached(dx, dy)) {
+        project();
+    }
+
+    auto mapImage = overlayHelper->getMapImage();
+    for (auto &path: paths) {
+        if (!overlayHelper->isAreaVisible(path.xmin + dx, path.ymin + dy, path.xmax + dx, path.ymax + dy)) {
+            continue;
+        }
+
+        shifted.resize(path.xy.size());
+        for (size_t i = 0; i < path.xy.size(); i += 2) {
+            shifted[i] = path.xy[i] + dx;
+            shifted[i + 1] = path.xy[i + 1] + dy;
+        }
+
+        size_t count = shifted.size() / 2;
+        mapImage->strokePolyline(shifted.data(), count, LINE_WIDTH, img::COLOR_ICAO_MAGENTA);
+        for (size_t i = 0; i < count; i++) {
+            mapImage->fillCircle((int) shifted[2 * i], (int) shifted[2 * i + 1], FIX_RADIUS, img::COLOR_ICAO_MAGENTA);
+        }
+    }
+}
+
+void OverlayedProcedure::resolve(std::shared_ptr<world::Procedure> procedure) {
+    cachedProcedure = procedure;
+    cachedZoom = -1;
+    paths.clear();
+
+    for (auto &nodes: procedure->getPaths()) {
+        Path path;
+        for (auto &node: nodes) {
+            if (!node) {
+                continue;
+            }
+            auto &loc = node->getLocation();
+            path.lats.push_back(loc.latitude);
+            path.lons.push_back(loc.longitude);
+        }
+        if (!path.lats.empty()) {
+            paths.push_back(std::move(path));
+        }
+    }
+}
+
+bool OverlayedProcedure::isCached(int &dx, int &dy) const {
+    if ((overlayHelper->getZoomLevel() != cachedZoom) || anchors.empty()) {
+        return false;
+    }
+
+    // the truncation of the projected positions can differ by a pixel between anchors
+    for (size_t i = 0; i < anchors.size(); i++) {
+        int x, y;
+        overlayHelper->positionToPixel(anchors[i].latitude, anchors[i].longitude, x, y);
+        int ax = x - anchorPixels[i].first;
+        int ay = y - anchorPixels[i].second;
+        if (i == 0) {
+            dx = ax;
+            dy = ay;
+        } else if ((std::abs(ax - dx) > 1) || (std::abs(ay - dy) > 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void OverlayedProcedure::project() {
+    cachedZoom = overlayHelper->getZoomLevel();
+
+    // the first fix and those furthest west and east, the latter are the first to wrap
+    // around the -180/+180 longitude discontinuity when the view is panned
+    world::Location first(paths[0].lats[0], paths[0].lons[0]);
+    world::Location west = first, east = first;
+    std::pair<int, int> firstPixel, westPixel, eastPixel;
+
+    std::vector<int> px, py;
+    for (size_t p = 0; p < paths.size(); p++) {
+        auto &path = paths[p];
+        size_t count = path.lats.size();
+        px.resize(count);
+        py.resize(count);
+        overlayHelper->positionsToPixels(path.lats.data(), path.lons.data(), count, px.data(), py.data());
+        if (p == 0) {
+            firstPixel = westPixel = eastPixel = std::make_pair(px[0], py[0]);
+        }
+
+        path.xy.resize(2 * count);
+        path.xmin = path.xmax = px[0];
+        path.ymin = path.ymax = py[0];
+        for (size_t i = 0; i < count; i++) {
+            path.xy[2 * i] = px[i];
+            path.xy[2 * i + 1] = py[i];
+            path.xmin = std::min(path.xmin, px[i]);
+            path.xmax = std::max(path.xmax, px[i]);
+            path.ymin = std::min(path.ymin, py[i]);
+            path.ymax = std::max(path.ymax, py[i]);
+            if (px[i] < westPixel.first) {
+                west = world::Location(path.lats[i], path.lons[i]);
+                westPixel = std::make_pair(px[i], py[i]);
+            }
+            if (px[i] > eastPixel.first) {
+                east = world::Location(path.lats[i], path.lons[i]);
+                eastPixel = std::make_pair(px[i], py[i]);
+            }
+        }
+
+        // the line and the fix dots reach a bit beyond the fixes
+        path.xmin -= FIX_RADIUS;
+        path.ymin -= FIX_RADIUS;
+        path.xmax += FIX_RADIUS;
+        path.ymax += FIX_RADIUS;
+    }
+
+    anchors = {first, west, east};
+    anchorPixels = {firstPixel, westPixel, eastPixel};
+}
+
+} /* namespace maps */
@@ -0,0 +1,62 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "OverlayHelper.h"
+#include "src/world/models/airport/procs/Procedure.h"
+
+namespace maps {
+
+// Draws all branches of a SID, STAR or approach. The fixes are resolved once per
+// procedure and projected once per zoom level, so a frame only strokes the lines.
+class OverlayedProcedure {
+public:
+    OverlayedProcedure(IOverlayHelper *h);
+    void draw(std::shared_ptr<world::Procedure> procedure);
+
+private:
+    static constexpr const float LINE_WIDTH = 3;
+    static constexpr const int FIX_RADIUS = 3;
+
+    struct Path {
+        std::vector<double> lats, lons;
+        // projected as x, y pairs with their bounds
+        std::vector<float> xy;
+        int xmin, ymin, xmax, ymax;
+    };
+
+    IOverlayHelper * const overlayHelper;
+
+    std::shared_ptr<world::Procedure> cachedProcedure;
+    std::vector<Path> paths;
+
+    // Panning only moves the projected paths, which shows as the same offset of the
+    // anchors: the first fix and those furthest west and east.
+    int cachedZoom = -1;
+    std::vector<world::Location> anchors;
+    std::vector<std::pair<int, int>> anchorPixels;
+    std::vector<float> shifted;
+
+    void resolve(std::shared_ptr<world::Procedure> procedure);
+    bool isCached(int &dx, int &dy) const;
+    void project();
+};
+
+} /* namespace maps */
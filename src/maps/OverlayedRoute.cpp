@@ -29,8 +29,68 @@ OverlayedRoute::OverlayedRoute(IOverlayHelper *h):
 }
 
 void OverlayedRoute::draw(std::shared_ptr<world::Route> route) {
+    int dx = 0, dy = 0;
+    if (!isCached(route, dx, dy)) {
+        project(route);
+    }
+
+    for (auto &line: lines) {
+        for (size_t i = 1; i < line.size(); i++) {
+            drawLeg(line[i - 1].x + dx, line[i - 1].y + dy, line[i].x + dx, line[i].y + dy);
+        }
+    }
+
+    auto mapImage = overlayHelper->getMapImage();
+    for (auto &mark: marks) {
+        if (!overlayHelper->isAreaVisible(mark.xmin + dx, mark.ymin + dy, mark.xmax + dx, mark.ymax + dy)) {
+            continue;
+        }
+        // Draw node graphic
+        if (mark.dot) {
+            mapImage->fillCircle(mark.from.x + dx, mark.from.y + dy, 3, img::COLOR_BLACK);
+        }
+        if (mark.annotation) {
+            int off = mark.annotation->getWidth() / 2;
+            mapImage->blendImage0(*mark.annotation, mark.mid.x + dx - off, mark.mid.y + dy - off);
+        }
+    }
+
+    // Draw last node
+    mapImage->fillCircle(lastNode.x + dx, lastNode.y + dy, 3, img::COLOR_BLACK);
+}
+
+bool OverlayedRoute::isCached(const std::shared_ptr<world::Route> &route, int &dx, int &dy) const {
+    if ((route != cachedRoute) || (overlayHelper->getZoomLevel() != cachedZoom) || anchors.empty()) {
+        return false;
+    }
+
+    // the truncation of the projected positions can differ by a pixel between anchors
+    for (size_t i = 0; i < anchors.size(); i++) {
+        int x, y;
+        overlayHelper->positionToPixel(anchors[i].latitude, anchors[i].longitude, x, y);
+        int ax = x - anchorPixels[i].x;
+        int ay = y - anchorPixels[i].y;
+        if (i == 0) {
+            dx = ax;
+            dy = ay;
+        } else if ((std::abs(ax - dx) > 1) || (std::abs(ay - dy) > 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void OverlayedRoute::project(std::shared_ptr<world::Route> route) {
+    cachedRoute = route;
+    cachedZoom = overlayHelper->getZoomLevel();
+    lines.clear();
+    marks.clear();
+    anchors.clear();
+    anchorPixels.clear();
+
+    std::vector<Point> line;
     world::Location toLoc;
-    route->iterateLegs([this, &toLoc] (
+    route->iterateLegs([this, &toLoc, &line] (
             const std::shared_ptr<world::NavNode> from,
             const std::shared_ptr<world::NavEdge> via,
             const std::shared_ptr<world::NavNode> to,
@@ -40,17 +100,45 @@ void OverlayedRoute::draw(std::shared_ptr<world::Route> route) {
 
         auto fromLoc = from->getLocation();
         toLoc = to->getLocation();
-        drawLeg(fromLoc, toLoc, distanceNm, initialTrueBearing, initialMagneticBearing);
+        projectLeg(fromLoc, toLoc, distanceNm, initialTrueBearing, initialMagneticBearing, line);
     });
+    lines.push_back(simplify(line));
 
-    // Draw last node
-    int toX, toY;
-    overlayHelper->positionToPixel(toLoc.latitude, toLoc.longitude, toX, toY);
-    overlayHelper->getMapImage()->fillCircle(toX, toY, 3, img::COLOR_BLACK);
+    overlayHelper->positionToPixel(toLoc.latitude, toLoc.longitude, lastNode.x, lastNode.y);
+
+    // the first waypoint and those furthest west and east, the latter are the first to wrap
+    // around the -180/+180 longitude discontinuity when the view is panned
+    world::Location west = route->getStart()->getLocation();
+    world::Location east = west;
+    Point westPixel {0, 0}, eastPixel {0, 0};
+    bool first = true;
+    route->iterateRoute([&] (const std::shared_ptr<world::NavEdge>, const std::shared_ptr<world::NavNode> node) {
+        auto &loc = node->getLocation();
+        Point p;
+        overlayHelper->positionToPixel(loc.latitude, loc.longitude, p.x, p.y);
+        if (first) {
+            anchors.push_back(loc);
+            anchorPixels.push_back(p);
+            westPixel = eastPixel = p;
+            first = false;
+        }
+        if (p.x < westPixel.x) {
+            west = loc;
+            westPixel = p;
+        }
+        if (p.x > eastPixel.x) {
+            east = loc;
+            eastPixel = p;
+        }
+    });
+    anchors.push_back(west);
+    anchorPixels.push_back(westPixel);
+    anchors.push_back(east);
+    anchorPixels.push_back(eastPixel);
 }
 
-void OverlayedRoute::drawLeg(world::Location &from, world::Location &to, double distance,
-                             double trueBearing, double magneticBearing) {
+void OverlayedRoute::projectLeg(world::Location &from, world::Location &to, double distance,
+                                double trueBearing, double magneticBearing, std::vector<Point> &line) {
     world::Location crossingPoint(0,0);
     if (((from.longitude * to.longitude) < 0) && (std::abs(from.longitude - to.longitude) > 180)) {
         // this leg of the route crosses the -180/+180 longitude discontinuity. it needs special
@@ -68,36 +156,45 @@ void OverlayedRoute::drawLeg(world::Location &from, world::Location &to, double
     overlayHelper->positionToPixel(from.latitude, from.longitude, fromX, fromY);
     overlayHelper->positionToPixel(to.latitude, to.longitude, toX, toY);
 
+    if (line.empty()) {
+        line.push_back(Point {fromX, fromY});
+    }
+
     std::pair<int, int> legDims(0,0);
+    int xmin = std::min(fromX, toX), xmax = std::max(fromX, toX);
+    int ymin = std::min(fromY, toY), ymax = std::max(fromY, toY);
     if (crossingPoint.longitude == 0) {
         // the leg doesn't cross the -180/+180 longitude discontinuity - easy!
-        legDims = drawLeg(fromX, fromY, toX, toY);
+        line.push_back(Point {toX, toY});
+        legDims = std::make_pair(xmax - xmin, ymax - ymin);
         midX = (fromX + toX) / 2;
         midY = (fromY + toY) / 2;
     } else {
-        // the leg crosses the-180/+180 longitude discontinuity. draw the 2 parts of the leg
-        // separately. additionally the midpoint is most likely not the same as the crossing
+        // the leg crosses the-180/+180 longitude discontinuity. the 2 parts of the leg are
+        // separate lines. additionally the midpoint is most likely not the same as the crossing
         // point and needs to be calculated using the 2 parts of the leg.
         int crossX, crossY;
         overlayHelper->positionToPixel(crossingPoint.latitude, crossingPoint.longitude, crossX, crossY);
-        legDims = drawLeg(fromX, fromY, crossX, crossY);
+        line.push_back(Point {crossX, crossY});
+        lines.push_back(simplify(line));
+        legDims = std::make_pair(std::abs(crossX - fromX), std::abs(crossY - fromY));
+        xmin = std::min(fromX, crossX), xmax = std::max(fromX, crossX);
+        ymin = std::min(fromY, crossY), ymax = std::max(fromY, crossY);
         int deltaX = (crossX - fromX);
         int deltaY = (crossY - fromY);
         crossingPoint.longitude = -crossingPoint.longitude;
         overlayHelper->positionToPixel(crossingPoint.latitude, crossingPoint.longitude, crossX, crossY);
-        auto leg2Dims = drawLeg(crossX, crossY, toX, toY);
-        legDims.first += leg2Dims.first;
-        legDims.second += leg2Dims.second;
+        line.clear();
+        line.push_back(Point {crossX, crossY});
+        line.push_back(Point {toX, toY});
+        legDims.first += std::abs(toX - crossX);
+        legDims.second += std::abs(toY - crossY);
         midX = fromX + ((deltaX + toX - crossX) / 2);
         midY = fromY + ((deltaY + toY - crossY) / 2);
     }
 
-    auto mapImage = overlayHelper->getMapImage();
-
-    // Draw node graphic
-    if ((legDims.first > 6) || (legDims.second > 6)) {
-        mapImage->fillCircle(fromX, fromY, 3, img::COLOR_BLACK);
-    }
+    LegMark mark {xmin, ymin, xmax, ymax, Point {fromX, fromY}, Point {midX, midY}, false, nullptr};
+    mark.dot = (legDims.first > 6) || (legDims.second > 6);
 
     // Draw distance/track annotation text, rotated appropriately
     // We cache the rotated image of this annotation, since the rotation is expensive
@@ -114,9 +211,70 @@ void OverlayedRoute::drawLeg(world::Location &from, world::Location &to, double
     }
 
     if (pImage->getWidth() < legDims.first || pImage->getHeight() < legDims.second) {
-        int off = pImage->getWidth() / 2;
-        mapImage->blendImage0(*pImage, midX - off, midY - off);
+        mark.annotation = pImage;
+    }
+
+    // legs too short for either don't need a mark, most of them when zoomed out
+    if (mark.dot || mark.annotation) {
+        marks.push_back(mark);
+    }
+}
+
+std::vector<OverlayedRoute::Point> OverlayedRoute::simplify(const std::vector<Point> &line) {
+    // Douglas-Peucker: a run of points is replaced by its end points unless one of them is
+    // further than the tolerance from the line between them, then the run is split there
+    if (line.size() < 3) {
+        return line;
     }
+
+    std::vector<bool> keep(line.size(), false);
+    keep.front() = keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> runs;
+    runs.emplace_back(0, line.size() - 1);
+    while (!runs.empty()) {
+        auto run = runs.back();
+        runs.pop_back();
+        auto &a = line[run.first];
+        auto &b = line[run.second];
+        double vx = b.x - a.x;
+        double vy = b.y - a.y;
+        double len2 = vx * vx + vy * vy;
+
+        size_t furthest = run.first;
+        double maxDist2 = 0;
+        for (size_t i = run.first + 1; i < run.second; i++) {
+            double wx = line[i].x - a.x;
+            double wy = line[i].y - a.y;
+            double dist2;
+            if (len2 == 0) {
+                dist2 = wx * wx + wy * wy;
+            } else {
+                // distance to the segment, points beyond the ends must be kept as well
+                double t = std::max(0.0, std::min(1.0, (wx * vx + wy * vy) / len2));
+                double ex = wx - t * vx;
+                double ey = wy - t * vy;
+                dist2 = ex * ex + ey * ey;
+            }
+            if (dist2 > maxDist2) {
+                maxDist2 = dist2;
+                furthest = i;
+            }
+        }
+
+        if (maxDist2 > SIMPLIFY_TOLERANCE * SIMPLIFY_TOLERANCE) {
+            keep[furthest] = true;
+            runs.emplace_back(run.first, furthest);
+            runs.emplace_back(furthest, run.second);
+        }
+    }
+
+    std::vector<Point> res;
+    for (size_t i = 0; i < line.size(); i++) {
+        if (keep[i]) {
+            res.push_back(line[i]);
+        }
+    }
+    return res;
 }
 
 std::pair<int, int> OverlayedRoute::drawLeg(int x0, int y0, int x1, int y1) {
@@ -155,8 +313,10 @@ std::shared_ptr<img::Image> OverlayedRoute::createRouteAnnotation(int distance,
     std::shared_ptr<img::Image> img  = std::make_shared<img::Image>(size, size, 0x00FFFFFF);
     std::shared_ptr<img::Image> rImg = std::make_shared<img::Image>(size, size, 0x00FFFFFF);
     int origin = (size - textSize) / 2;
-    img->drawText(d, font, size / 2, origin, img::COLOR_BLACK, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
-    img->drawText(b, font, size / 2, origin + font + 7, img::COLOR_BLACK, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE);
+    img->drawTexts({
+        {d, font, size / 2, origin, img::COLOR_BLACK, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE},
+        {b, font, size / 2, origin + font + 7, img::COLOR_BLACK, img::COLOR_TRANSPARENT_WHITE, img::Align::CENTRE},
+    });
     rImg->blendImage(*img, 0, 0, rotAngle);
     return rImg;
 }
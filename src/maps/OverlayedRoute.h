@@ -18,6 +18,8 @@
 #ifndef SRC_MAPS_OVERLAYED_ROUTE_H_
 #define SRC_MAPS_OVERLAYED_ROUTE_H_
 
+#include <vector>
+#include <map>
 #include "OverlayHelper.h"
 #include "src/world/graph/NavNode.h"
 #include "src/world/routing/Route.h"
@@ -32,11 +34,40 @@ public:
     void draw(std::shared_ptr<world::Route> route);
 
 private:
+    // pixels that the simplified line may be away from the legs it replaces
+    static constexpr const int SIMPLIFY_TOLERANCE = 1;
+
+    struct Point {
+        int x, y;
+    };
+
+    // the waypoint dot and annotation of a leg that is long enough to show them
+    struct LegMark {
+        int xmin, ymin, xmax, ymax;
+        Point from, mid;
+        bool dot;
+        std::shared_ptr<img::Image> annotation;
+    };
+
     IOverlayHelper * const overlayHelper;
     std::map<uint32_t, std::shared_ptr<img::Image>> routeAnnotationCache;
 
-    void drawLeg(world::Location &from, world::Location &to, double distance,
-                 double trueBearing, double magneticBearing);
+    // The route projected at the zoom level and view it was cached for. Panning only
+    // moves it, which shows as the same offset of the anchor waypoints.
+    std::shared_ptr<world::Route> cachedRoute;
+    int cachedZoom = -1;
+    std::vector<world::Location> anchors;
+    std::vector<Point> anchorPixels;
+    // simplified, split where the route crosses the -180/+180 longitude discontinuity
+    std::vector<std::vector<Point>> lines;
+    std::vector<LegMark> marks;
+    Point lastNode {0, 0};
+
+    bool isCached(const std::shared_ptr<world::Route> &route, int &dx, int &dy) const;
+    void project(std::shared_ptr<world::Route> route);
+    void projectLeg(world::Location &from, world::Location &to, double distance,
+                    double trueBearing, double magneticBearing, std::vector<Point> &line);
+    static std::vector<Point> simplify(const std::vector<Point> &line);
     std::pair<int, int> drawLeg(int x0, int y0, int x1, int y1);
     std::shared_ptr<img::Image> createRouteAnnotation(int distance, int trueBearing, int magBearing);
 };
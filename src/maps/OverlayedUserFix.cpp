@@ -17,57 +17,62 @@
  */
 
 #include "OverlayedUserFix.h"
+#include "src/libimg/SpriteCache.h"
 #include <cstdlib>
 
 namespace maps {
 
-img::Image OverlayedUserFix::POIIcon;
-img::Image OverlayedUserFix::VRPIcon;
-img::Image OverlayedUserFix::MarkerIcon;
 std::vector<std::string> OverlayedUserFix::textLines;
 
 OverlayedUserFix::OverlayedUserFix(IOverlayHelper *h, const world::Fix *f):
     OverlayedFix(h, f){
-    if (POIIcon.getHeight() == 0) {
-        createIcons();
-    }
 }
 
-void OverlayedUserFix::createIcons() {
+std::shared_ptr<img::Image> OverlayedUserFix::createIcon(world::UserFix::Type type) {
     int r = RADIUS;
     int xc = r;
     int yc = r;
 
-    POIIcon.resize(r * 2 + 1, r * 2 + 1, 0);
-    POIIcon.fillCircle(xc, yc, r,   POI_FILL_COLOR);
-    POIIcon.fillCircle(xc, yc, r/2, POI_TEXT_COLOR);
-    POIIcon.drawCircle(xc, yc, r,   POI_TEXT_COLOR);
-    POIIcon.drawLine(0, r, 2 * r, r, POI_TEXT_COLOR);
-    POIIcon.drawLine(r, 0, r, 2 * r, POI_TEXT_COLOR);
-
-    VRPIcon.resize(r * 2 + 1, r * 2 + 1, 0);
-    VRPIcon.fillCircle(xc, yc, r, img::COLOR_WHITE);
-    VRPIcon.drawCircle(xc, yc, r, VRP_COLOR);
-    // Draw a +
-    VRPIcon.drawLine(0, r, 2 * r, r, VRP_COLOR);
-    VRPIcon.drawLine(r, 0, r, 2 * r, VRP_COLOR);
-
-    MarkerIcon.resize(r * 2 + 1, r * 2 + 1, 0);
-    MarkerIcon.fillCircle(xc, yc, r, img::COLOR_WHITE);
-    MarkerIcon.drawCircle(xc, yc, r, MARKER_COLOR);
-    MarkerIcon.drawCircle(xc, yc, r / 2, MARKER_COLOR);
+    auto icon = std::make_shared<img::Image>(r * 2 + 1, r * 2 + 1, 0);
+    if (type == world::UserFix::Type::POI) {
+        icon->fillCircle(xc, yc, r,   POI_FILL_COLOR);
+        icon->fillCircle(xc, yc, r/2, POI_TEXT_COLOR);
+        icon->drawCircle(xc, yc, r,   POI_TEXT_COLOR);
+        icon->drawLine(0, r, 2 * r, r, POI_TEXT_COLOR);
+        icon->drawLine(r, 0, r, 2 * r, POI_TEXT_COLOR);
+    } else if (type == world::UserFix::Type::VRP) {
+        icon->fillCircle(xc, yc, r, img::COLOR_WHITE);
+        icon->drawCircle(xc, yc, r, VRP_COLOR);
+        // Draw a +
+        icon->drawLine(0, r, 2 * r, r, VRP_COLOR);
+        icon->drawLine(r, 0, r, 2 * r, VRP_COLOR);
+    } else {
+        icon->fillCircle(xc, yc, r, img::COLOR_WHITE);
+        icon->drawCircle(xc, yc, r, MARKER_COLOR);
+        icon->drawCircle(xc, yc, r / 2, MARKER_COLOR);
+    }
+    return icon;
 }
 
 void OverlayedUserFix::drawGraphic() {
     auto type = fix->getUserFix()->getType();
-    auto mapImage = overlayHelper->getMapImage();
-    if (type == world::UserFix::Type::POI) {
-        mapImage->blendImage0(POIIcon, posX - RADIUS, posY - RADIUS);
-    } else if (type == world::UserFix::Type::VRP) {
-        mapImage->blendImage0(VRPIcon, posX - RADIUS, posY - RADIUS);
-    } else if (type == world::UserFix::Type::MARKER) {
-        mapImage->blendImage0(MarkerIcon, posX - RADIUS, posY - RADIUS);
+    if (type != world::UserFix::Type::POI && type != world::UserFix::Type::VRP
+            && type != world::UserFix::Type::MARKER) {
+        return;
     }
+
+    auto key = img::SpriteCache::makeKey(img::SpriteKind::NAVAID, RADIUS, 0, 1 + (uint8_t) type);
+    auto icon = img::SpriteCache::shared().get(key, [type] () { return createIcon(type); });
+    overlayHelper->getMapImage()->blendImage0(*icon, posX - RADIUS, posY - RADIUS);
+}
+
+bool OverlayedUserFix::getTextBox(TextBox &box) {
+    // user fixes only have detailed text
+    return false;
+}
+
+OverlayedNode::LabelPriority OverlayedUserFix::getLabelPriority() const {
+    return LabelPriority::USER_FIX;
 }
 
 void OverlayedUserFix::drawText(bool detailed) {
@@ -31,15 +31,14 @@ public:
 
     void drawGraphic() override;
     void drawText(bool detailed) override;
+    bool getTextBox(TextBox &box) override;
+    LabelPriority getLabelPriority() const override;
 
 private:
     void splitNameToLines();
 
-    static void createIcons();
+    static std::shared_ptr<img::Image> createIcon(world::UserFix::Type type);
 
-    static img::Image POIIcon;
-    static img::Image VRPIcon;
-    static img::Image MarkerIcon;
     static std::vector<std::string> textLines;
 
     const static int RADIUS = 6;
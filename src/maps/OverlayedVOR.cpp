@@ -17,6 +17,7 @@
  */
 
 #include "OverlayedVOR.h"
+#include "src/libimg/SpriteCache.h"
 
 namespace maps {
 
@@ -33,6 +34,7 @@ void OverlayedVOR::configure(const OverlayConfig &cfg, const world::Location &lo
 {
     OverlayedFix::configure(cfg, loc);
     if (linkedDME) {
+        linkedDME->setPosition(posX, posY);
         linkedDME->configure(cfg, loc);
     }
     enabled = navVOR && cfg.drawVORs;
@@ -42,50 +44,61 @@ void OverlayedVOR::drawGraphic()
 {
     if (!enabled) return;
 
-    double r = 8;
-
     if (linkedDME) {
         linkedDME->drawGraphic();
     }
 
-    auto mapImage = overlayHelper->getMapImage();
-    mapImage->drawLine(posX - r / 20, posY - r / 20, posX + r / 20, posY + r / 20, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX - r / 20, posY + r / 20, posX + r / 20, posY - r / 20, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX + r / 2, posY - r, posX + r, posY, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX + r, posY, posX + r / 2, posY + r, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX + r / 2, posY + r, posX - r / 2, posY + r, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX - r / 2, posY + r, posX - r, posY, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX - r, posY, posX - r / 2, posY - r, img::COLOR_ICAO_VOR_DME);
-    mapImage->drawLine(posX - r / 2, posY - r, posX + r / 2, posY - r, img::COLOR_ICAO_VOR_DME);
+    // The rose only depends on its rotation, so it is rendered once per bearing
+    // and shared by all VORs through the sprite cache
+    int bearing = (int)navVOR->getBearing();
+    bearing += overlayHelper->getNorthOffset();
+    int rotation = ((bearing % 360) + 360) % 360;
+    auto key = img::SpriteCache::makeKey(img::SpriteKind::VOR_ROSE, CIRCLE_RADIUS, img::COLOR_ICAO_VOR_DME, rotation);
+    auto rose = img::SpriteCache::shared().get(key, [this, rotation] () { return createRose(rotation); });
+    overlayHelper->getMapImage()->blendImage0(*rose, posX - ROSE_EXTENT, posY - ROSE_EXTENT);
+}
+
+std::shared_ptr<img::Image> OverlayedVOR::createRose(int rotation) const {
+    auto rose = std::make_shared<img::Image>(ROSE_EXTENT * 2 + 1, ROSE_EXTENT * 2 + 1, 0);
+    double r = 8;
+    int c = ROSE_EXTENT;
+
+    rose->drawLine(c - r / 20, c - r / 20, c + r / 20, c + r / 20, img::COLOR_ICAO_VOR_DME);
+    rose->drawLine(c - r / 20, c + r / 20, c + r / 20, c - r / 20, img::COLOR_ICAO_VOR_DME);
+    rose->drawLine(c + r / 2, c - r, c + r, c, img::COLOR_ICAO_VOR_DME);
+    rose->drawLine(c + r, c, c + r / 2, c + r, img::COLOR_ICAO_VOR_DME);
+    rose->drawLine(c + r / 2, c + r, c - r / 2, c + r, img::COLOR_ICAO_VOR_DME);
+    rose->drawLine(c - r / 2, c + r, c - r, c, img::COLOR_ICAO_VOR_DME);
+    rose->drawLine(c - r, c, c - r / 2, c - r, img::COLOR_ICAO_VOR_DME);
+    rose->drawLine(c - r / 2, c - r, c + r / 2, c - r, img::COLOR_ICAO_VOR_DME);
 
-    mapImage->drawCircle(posX, posY, CIRCLE_RADIUS, img::COLOR_ICAO_VOR_DME);
+    rose->drawCircle(c, c, CIRCLE_RADIUS, img::COLOR_ICAO_VOR_DME);
 
     // Draw ticks
     const float BIG_TICK_SCALE = 0.84;
     const float SMALL_TICK_SCALE = 0.92;
-    int bearing = (int)navVOR->getBearing();
-    bearing += overlayHelper->getNorthOffset();
     for (int deg = 0; deg <= 360; deg += 10) {
         double inner_x, inner_y, outer_x, outer_y;
         float tickScale = (deg%30 == 0) ? BIG_TICK_SCALE : SMALL_TICK_SCALE;
-        overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS * tickScale, deg + bearing, inner_x, inner_y);
-        overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS, deg + bearing, outer_x, outer_y);
+        overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS * tickScale, deg + rotation, inner_x, inner_y);
+        overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS, deg + rotation, outer_x, outer_y);
 
         if (deg == 0) {
-            mapImage->drawLineAA(posX, posY, posX + outer_x, posY + outer_y, img::COLOR_ICAO_VOR_DME);
+            rose->drawLineAA(c, c, c + outer_x, c + outer_y, img::COLOR_ICAO_VOR_DME);
         } else {
-            mapImage->drawLineAA(posX + inner_x, posY + inner_y, posX + outer_x, posY + outer_y, img::COLOR_ICAO_VOR_DME);
+            rose->drawLineAA(c + inner_x, c + inner_y, c + outer_x, c + outer_y, img::COLOR_ICAO_VOR_DME);
         }
 
         if ((deg % 90) == 0) {
             double inner1_x, inner1_y, inner2_x, inner2_y;
-            overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS * BIG_TICK_SCALE, deg + bearing - 2, inner1_x, inner1_y);
-            overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS * BIG_TICK_SCALE, deg + bearing + 2, inner2_x, inner2_y);
-            mapImage->drawLineAA(posX + inner1_x, posY + inner1_y, posX + outer_x,  posY + outer_y,  img::COLOR_ICAO_VOR_DME);
-            mapImage->drawLineAA(posX + inner2_x, posY + inner2_y, posX + outer_x,  posY + outer_y,  img::COLOR_ICAO_VOR_DME);
-            mapImage->drawLineAA(posX + inner1_x, posY + inner1_y, posX + inner2_x, posY + inner2_y, img::COLOR_ICAO_VOR_DME);
+            overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS * BIG_TICK_SCALE, deg + rotation - 2, inner1_x, inner1_y);
+            overlayHelper->fastPolarToCartesian(CIRCLE_RADIUS * BIG_TICK_SCALE, deg + rotation + 2, inner2_x, inner2_y);
+            rose->drawLineAA(c + inner1_x, c + inner1_y, c + outer_x,  c + outer_y,  img::COLOR_ICAO_VOR_DME);
+            rose->drawLineAA(c + inner2_x, c + inner2_y, c + outer_x,  c + outer_y,  img::COLOR_ICAO_VOR_DME);
+            rose->drawLineAA(c + inner1_x, c + inner1_y, c + inner2_x, c + inner2_y, img::COLOR_ICAO_VOR_DME);
         }
     }
+    return rose;
 }
 
 void OverlayedVOR::drawText(bool detailed)
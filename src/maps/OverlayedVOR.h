@@ -38,7 +38,10 @@ private:
     const world::VOR * const navVOR;
     std::unique_ptr<OverlayedDME> linkedDME;
 
+    std::shared_ptr<img::Image> createRose(int rotation) const;
+
     static constexpr const int CIRCLE_RADIUS = 70;
+    static constexpr const int ROSE_EXTENT = CIRCLE_RADIUS + 2; // the ring and the ticks reach one pixel beyond the radius
     static constexpr const int MARGIN = CIRCLE_RADIUS;
 };
 
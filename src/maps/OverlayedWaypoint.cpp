@@ -37,4 +37,13 @@ void OverlayedWaypoint::drawText(bool detailed) {
     mapImage->drawText(fix->getID(), 10, posX + 6, posY - 6, color, 0, img::Align::LEFT);
 }
 
+bool OverlayedWaypoint::getTextBox(TextBox &box) {
+    box = getLabelBox(fix->getID(), 10, posX + 6, posY - 6, img::Align::LEFT);
+    return true;
+}
+
+OverlayedNode::LabelPriority OverlayedWaypoint::getLabelPriority() const {
+    return LabelPriority::FIX;
+}
+
 } /* namespace maps */
@@ -29,6 +29,8 @@ public:
 
     void drawGraphic() override;
     void drawText(bool detailed) override;
+    bool getTextBox(TextBox &box) override;
+    LabelPriority getLabelPriority() const override;
 
 private:
     static constexpr const uint32_t color = img::COLOR_BLACK;
@@ -0,0 +1,48 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "ScriptOverlays.h"
+
+namespace maps {
+
+ScriptOverlays &ScriptOverlays::shared() {
+    static ScriptOverlays instance;
+    return instance;
+}
+
+void ScriptOverlays::setLayer(const std::string &name, std::shared_ptr<const ScriptDrawList> list) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto prev = std::atomic_load(&current);
+    if (!list && prev->layers.count(name) == 0) {
+        return;
+    }
+
+    auto next = std::make_shared<Snapshot>(*prev);
+    if (list) {
+        next->layers[name] = list;
+    } else {
+        next->layers.erase(name);
+    }
+    next->revision = prev->revision + 1;
+    std::atomic_store(&current, std::shared_ptr<const Snapshot>(next));
+}
+
+std::shared_ptr<const ScriptOverlays::Snapshot> ScriptOverlays::get() const {
+    return std::atomic_load(&current);
+}
+
+} /* namespace maps */
@@ -0,0 +1,83 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace maps {
+
+// Draw commands of a script in world coordinates, never modified once published
+struct ScriptDrawList {
+    enum class Shape: uint32_t { CIRCLE, SQUARE, TRIANGLE, NUM_SHAPES };
+
+    struct Polyline {
+        uint32_t first, count;
+        uint32_t color;
+    };
+
+    struct Symbol {
+        uint32_t point;
+        Shape shape;
+        uint32_t color;
+    };
+
+    struct Label {
+        uint32_t point;
+        uint32_t color;
+        std::string text;
+    };
+
+    // all commands refer to these points by index, checked by whoever builds the list
+    std::vector<double> lats, lons;
+    std::vector<Polyline> polylines;
+    std::vector<Symbol> symbols;
+    std::vector<Label> labels;
+};
+
+/*
+ * The named overlay layers submitted by scripts. The scripts publish whole
+ * layers, the maps draw the latest set of them. Readers get an immutable
+ * snapshot without locking, its revision changes whenever a layer does.
+ */
+class ScriptOverlays {
+public:
+    using Layers = std::map<std::string, std::shared_ptr<const ScriptDrawList>>;
+
+    struct Snapshot {
+        Layers layers;
+        uint64_t revision = 0;
+    };
+
+    static ScriptOverlays &shared();
+
+    // replaces the layer, nullptr removes it
+    void setLayer(const std::string &name, std::shared_ptr<const ScriptDrawList> list);
+    std::shared_ptr<const Snapshot> get() const;
+
+private:
+    // only serializes the writers
+    std::mutex writeMutex;
+    std::shared_ptr<const Snapshot> current = std::make_shared<Snapshot>();
+};
+
+} /* namespace maps */
@@ -0,0 +1,135 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <set>
+#include <cmath>
+#include <algorithm>
+#include "TileSeedPlanner.h"
+
+namespace maps {
+
+namespace {
+
+constexpr const double NM_PER_DEGREE = 60;
+constexpr const double MAX_MERCATOR_LAT = 85;
+
+using TileSet = std::set<img::TileCache::TileCoords>;
+
+void addArea(img::TileSource &source, TileSet &tiles, double minLat, double minLon, double maxLat, double maxLon, int zoom) {
+    minLat = std::max(minLat, -MAX_MERCATOR_LAT);
+    maxLat = std::min(maxLat, MAX_MERCATOR_LAT);
+
+    // y grows southwards for all world sources
+    auto topLeft = source.worldToXY(minLon, maxLat, zoom);
+    auto bottomRight = source.worldToXY(maxLon, minLat, zoom);
+
+    int x0 = std::floor(std::min(topLeft.x, bottomRight.x));
+    int x1 = std::floor(std::max(topLeft.x, bottomRight.x));
+    int y0 = std::floor(std::min(topLeft.y, bottomRight.y));
+    int y1 = std::floor(std::max(topLeft.y, bottomRight.y));
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (source.isTileValid(0, x, y, zoom)) {
+                tiles.insert(img::TileCache::TileCoords(0, x, y, zoom));
+            }
+        }
+    }
+}
+
+void addCircle(img::TileSource &source, TileSet &tiles, const world::Location &loc, double radiusNM, int zoom) {
+    double dLat = radiusNM / NM_PER_DEGREE;
+    double dLon = dLat / std::max(0.01, std::cos(loc.latitude * M_PI / 180));
+    addArea(source, tiles, loc.latitude - dLat, loc.longitude - dLon, loc.latitude + dLat, loc.longitude + dLon, zoom);
+}
+
+std::vector<img::TileCache::TileCoords> toVector(const TileSet &tiles) {
+    return std::vector<img::TileCache::TileCoords>(tiles.begin(), tiles.end());
+}
+
+} // namespace
+
+std::vector<img::TileCache::TileCoords> tilesAlongRoute(img::TileSource &source, const world::Route &route,
+        double bufferNM, int minZoom, int maxZoom) {
+    TileSet tiles;
+    if (!source.supportsWorldCoords()) {
+        return {};
+    }
+
+    std::vector<world::Location> points;
+    route.iterateRoute([&points] (const std::shared_ptr<world::NavEdge>, const std::shared_ptr<world::NavNode> node) {
+        if (node) {
+            points.push_back(node->getLocation());
+        }
+    });
+
+    minZoom = std::max(minZoom, source.getMinZoomLevel());
+    maxZoom = std::min(maxZoom, source.getMaxZoomLevel());
+    double stepNM = std::max(bufferNM, 1.0);
+
+    for (int zoom = minZoom; zoom <= maxZoom; zoom++) {
+        for (size_t i = 0; i < points.size(); i++) {
+            addCircle(source, tiles, points[i], bufferNM, zoom);
+            if (i + 1 == points.size()) {
+                break;
+            }
+
+            // sample the leg so that the buffer circles overlap
+            auto &from = points[i];
+            auto &to = points[i + 1];
+            double legNM = from.distanceTo(to) / 1000 * world::KM_TO_NM;
+            int steps = std::ceil(legNM / stepNM);
+            double dLon = to.longitude - from.longitude;
+            if (dLon > 180) {
+                dLon -= 360;
+            } else if (dLon < -180) {
+                dLon += 360;
+            }
+            for (int s = 1; s < steps; s++) {
+                double f = (double) s / steps;
+                double lon = from.longitude + f * dLon;
+                if (lon > 180) {
+                    lon -= 360;
+                } else if (lon < -180) {
+                    lon += 360;
+                }
+                world::Location loc(from.latitude + f * (to.latitude - from.latitude), lon);
+                addCircle(source, tiles, loc, bufferNM, zoom);
+            }
+        }
+    }
+
+    return toVector(tiles);
+}
+
+std::vector<img::TileCache::TileCoords> tilesInArea(img::TileSource &source, const world::Location &bottomLeft,
+        const world::Location &topRight, int minZoom, int maxZoom) {
+    TileSet tiles;
+    if (!source.supportsWorldCoords()) {
+        return {};
+    }
+
+    minZoom = std::max(minZoom, source.getMinZoomLevel());
+    maxZoom = std::min(maxZoom, source.getMaxZoomLevel());
+    for (int zoom = minZoom; zoom <= maxZoom; zoom++) {
+        addArea(source, tiles, bottomLeft.latitude, bottomLeft.longitude, topRight.latitude, topRight.longitude, zoom);
+    }
+
+    return toVector(tiles);
+}
+
+} /* namespace maps */
@@ -0,0 +1,36 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <vector>
+#include "src/libimg/stitcher/TileCache.h"
+#include "src/libimg/stitcher/TileSource.h"
+#include "src/world/routing/Route.h"
+#include "src/world/models/Location.h"
+
+namespace maps {
+
+// Compute the tiles needed to cover an area for offline use with TileCache::startSeeding
+
+std::vector<img::TileCache::TileCoords> tilesAlongRoute(img::TileSource &source, const world::Route &route,
+        double bufferNM, int minZoom, int maxZoom);
+
+std::vector<img::TileCache::TileCoords> tilesInArea(img::TileSource &source, const world::Location &bottomLeft,
+        const world::Location &topRight, int minZoom, int maxZoom);
+
+} /* namespace maps */
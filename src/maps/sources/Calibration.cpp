@@ -18,6 +18,7 @@
 #include <stdexcept>
 #include <cmath>
 #include "Calibration.h"
+#include "ProjectionKernels.h"
 #include "src/Logger.h"
 
 namespace maps {
@@ -259,6 +260,7 @@ void Calibration::calculateLocalCalibration() {
         leWorldToPixels.initialiseFrom2PointsAndAngleW2P(regX1, regY1, xy1.second, xy1.first,
                                                          regX2, regY2, xy2.second, xy2.first,
                                                          northOffsetAngle);
+        compileTransforms();
         define2PAThirdVertex();
 
     } else if (!std::isnan(regX3) && std::isnan(northOffsetAngle)) {
@@ -277,6 +279,7 @@ void Calibration::calculateLocalCalibration() {
                                                  xy2.second, xy2.first, regX2, regY2,
                                                  xy3.second, xy3.first, regX3, regY3);
 
+        compileTransforms();
         northOffsetAngle = leWorldToPixels.getAngleDegrees();
         LOG_INFO(1, "Calculated northOffsetAngle = %4.10f", northOffsetAngle);
 
@@ -319,6 +322,7 @@ void Calibration::calculateChartfoxCalibration(double k, double transformAngle,
      */
     lePixelsToWorld.initialiseFromChartfoxP2W(k, transformAngle, tx, ty, aspectRatio);
     leWorldToPixels.initialiseFromChartfoxW2P(k, transformAngle, tx, ty, aspectRatio);
+    compileTransforms();
     northOffsetAngle = transformAngle * 180 / M_PI;
     if (checkNoNanCoefficients()) {
         isCalibrated = true;
@@ -544,51 +548,41 @@ double Calibration::invMercator(double lat) const {
     return std::atan(std::sinh(lat * M_PI / 180.0)) * 180.0 / M_PI;
 }
 
-std::pair<double, double> Calibration::latLonToEPSG3857(double lat, double lon) const {
-    double lon3857 = lon * 20037508.34 / 180;
-    double lat3857 = std::log(std::tan((90 + lat) * M_PI / 360)) / (M_PI / 180);
-    lat3857 = lat3857 * 20037508.34 / 180;
-    return std::pair<double, double>(lat3857, lon3857);
-}
+void Calibration::compileTransforms() {
+    // EPSG:3857 is the Mercator projection in metres, the local calibrations use degrees
+    double unitsPerDegree = isChartfoxGeoreferenced ? 20037508.34 / 180 : 1;
+    ordinateScale = unitsPerDegree * 180.0 / M_PI;
+
+    auto &w = worldToPixelsCoeffs;
+    leWorldToPixels.getCoeffs(w.ax, w.bx, w.cx, w.ay, w.by, w.cy);
+    w.ax *= unitsPerDegree;
+    w.ay *= unitsPerDegree;
 
-std::pair<double, double> Calibration::EPSG3857toLatLon(double lat3857, double lon3857) const {
-    double lon = lon3857 *  180 / 20037508.34 ;
-    double lat = std::atan(std::exp(lat3857 * M_PI / 20037508.34)) * 360 / M_PI - 90;
-    return std::pair<double, double>(lat, lon);
+    auto &p = pixelsToWorldCoeffs;
+    lePixelsToWorld.getCoeffs(p.ax, p.bx, p.cx, p.ay, p.by, p.cy);
+    p.ax /= unitsPerDegree; p.bx /= unitsPerDegree; p.cx /= unitsPerDegree;
+    p.ay /= ordinateScale;  p.by /= ordinateScale;  p.cy /= ordinateScale;
 }
 
 img::Point<double> Calibration::worldToPixels(double lon, double lat) const {
-    LOG_INFO(0, "lat,lon = %9.9lf, %9.9lf", lat, lon);
-
-    std::pair<double, double> yx;
-    yx = isChartfoxGeoreferenced ? latLonToEPSG3857(lat, lon) : mercator(lat, lon);
-    LOG_INFO(0, "x,y =     %9.9lf, %9.9lf", yx.second, yx.first);
-
-    auto r = leWorldToPixels.getResult(yx.second, yx.first);
-    double x = r.first;
-    double y = r.second;
+    img::Point<double> pixels;
+    worldToPixels(&lon, &lat, &pixels, 1);
+    return pixels;
+}
 
-    LOG_INFO(0, "x,y =     %9.9lf,%9.9lf", x, y);
-    return img::Point<double>{x, y};
+void Calibration::worldToPixels(const double *lons, const double *lats, img::Point<double> *pixels, size_t count,
+                                double scaleX, double scaleY) const {
+    AffineCoeffs c = worldToPixelsCoeffs;
+    c.ax *= scaleX; c.bx *= scaleX; c.cx *= scaleX;
+    c.ay *= scaleY; c.by *= scaleY; c.cy *= scaleY;
+    mercatorToAffine(lons, lats, pixels, count, c, ordinateScale);
 }
 
 img::Point<double> Calibration::pixelsToWorld(double x, double y) const {
-    LOG_INFO(0, "x,y =     %9.9lf,%9.9lf", x, y);
-
-    auto r = lePixelsToWorld.getResult(x, y);
-    double lat = r.second;
-    double lon = r.first;
-    LOG_INFO(0, "lat,lon = %9.9lf,%9.9lf", lat, lon);
-
-    if (isChartfoxGeoreferenced) {
-        auto r = EPSG3857toLatLon(lat, lon);
-        lat = r.first;
-        lon = r.second;
-    } else {
-        lat = invMercator(lat);
-    }
-
-    LOG_INFO(0, "lat,lon = %4.10f,%4.10f", lat, lon);
+    auto &p = pixelsToWorldCoeffs;
+    double lon = p.ax * x + p.bx * y + p.cx;
+    double ordinate = p.ay * x + p.by * y + p.cy;
+    double lat = std::atan(std::sinh(ordinate)) * 180.0 / M_PI;
     return img::Point<double>{lon, lat};
 }
 
@@ -22,6 +22,7 @@
 #include <string>
 #include "src/libimg/stitcher/TileSource.h"
 #include "LinearEquation.h"
+#include "ProjectionKernels.h"
 #include <nlohmann/json.hpp>
 
 namespace maps {
@@ -44,6 +45,9 @@ public:
     bool hasCalibration() const;
 
     img::Point<double> worldToPixels(double lon, double lat) const;
+    // batch worldToPixels, the results are multiplied by scaleX and scaleY
+    void worldToPixels(const double *lons, const double *lats, img::Point<double> *pixels, size_t count,
+                       double scaleX = 1, double scaleY = 1) const;
     img::Point<double> pixelsToWorld(double x, double y) const;
     int getPreRotate() const;
     double getNorthOffset() const;
@@ -65,13 +69,19 @@ private:
     LinearEquation leWorldToPixels;
     LinearEquation lePixelsToWorld;
 
+    // The equations fused with the projection's units, compiled whenever they change:
+    // pixels are the affine transform of (lon, ordinateScale * Mercator ordinate),
+    // (lon, ordinate in radians) is the affine transform of the pixels
+    AffineCoeffs worldToPixelsCoeffs{};
+    double ordinateScale = 1;
+    AffineCoeffs pixelsToWorldCoeffs{};
+
     void calculateLocalCalibration();
     void calculateChartfoxCalibration(double k, double transformAngle, double tx, double ty, double aspectRatio);
+    void compileTransforms();
     std::pair<double, double> rotate(double x, double y, double angleDegrees) const;
     std::string getKmlTagData(const std::string kml, const std::string tag) const;
     std::pair<double, double> mercator(double lat, double lon) const;
-    std::pair<double, double> latLonToEPSG3857(double lat, double lon) const;
-    std::pair<double, double> EPSG3857toLatLon(double lat3857, double lon3857) const;
     double invMercator(double lat) const;
     void define2PAThirdVertex();
     double getTriangleInnerAngleA(double a, double b, double c) const;
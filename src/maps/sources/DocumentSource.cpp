@@ -18,35 +18,39 @@
 #include <stdexcept>
 #include <sstream>
 #include "DocumentSource.h"
+#include "src/libimg/SharedDocuments.h"
 #include "src/Logger.h"
 #include "src/platform/Platform.h"
 
 namespace maps {
 
 DocumentSource::DocumentSource(const std::string& file)
-:   rasterizer(file)
+:   rasterizer(img::SharedDocuments::shared().open(file))
 {
+    // rendered tiles are cached by content so that they survive renamed and updated files
+    apis::Crypto crypto;
+    documentHash = crypto.getFileSha256(file);
 }
- 
-DocumentSource::DocumentSource(const std::vector<uint8_t> &data, const std::string type)
-:   rasterizer(data, type)
+
+DocumentSource::DocumentSource(std::shared_ptr<const std::vector<uint8_t>> data, const std::string type)
+:   rasterizer(img::SharedDocuments::shared().open(data, type))
 {
+    apis::Crypto crypto;
+    documentHash = crypto.sha256String(data->data(), data->size());
 }
 
 void DocumentSource::loadProvidedCalibrationMetadata(std::string calibrationMetadata) {
     if ((calibrationMetadata == "") || (calibrationMetadata == "[]")) {
         logger::warn("No calibration metadata");
     } else {
-        calibration.fromJsonString(calibrationMetadata, rasterizer.getAspectRatio(0));
+        calibration.fromJsonString(calibrationMetadata, rasterizer->getAspectRatio(0));
         rotateAngle = calibration.getPreRotate();
-        rasterizer.setPreRotate(rotateAngle);
     }
 
 }
 
 void DocumentSource::rotateFromCalibration() {
     rotateAngle = calibration.getPreRotate();
-    rasterizer.setPreRotate(rotateAngle);
 }
 
 int DocumentSource::getMinZoomLevel() {
@@ -62,9 +66,9 @@ int DocumentSource::getInitialZoomLevel() {
 }
 
 img::Point<double> DocumentSource::suggestInitialCenter(int page) {
-    int tileSize = rasterizer.getTileSize();
-    double width = rasterizer.getPageWidth(page, getInitialZoomLevel());
-    double height = rasterizer.getPageHeight(page, getInitialZoomLevel());
+    int tileSize = rasterizer->getTileSize();
+    double width = rasterizer->getPageWidth(page, getInitialZoomLevel(), rotateAngle);
+    double height = rasterizer->getPageHeight(page, getInitialZoomLevel(), rotateAngle);
 
     return img::Point<double>{width / tileSize / 2.0, height / tileSize / 2.0};
 }
@@ -78,15 +82,15 @@ std::string DocumentSource::getCalibrationReport() {
 }
 
 img::Point<int> DocumentSource::getTileDimensions(int zoom) {
-    int tileSize = rasterizer.getTileSize();
+    int tileSize = rasterizer->getTileSize();
     return img::Point<int>{tileSize, tileSize};
 }
 
 img::Point<double> DocumentSource::transformZoomedPoint(int page, double oldX, double oldY, int oldZoom, int newZoom) {
-    double oldWidth = rasterizer.getPageWidth(page, oldZoom);
-    double newWidth = rasterizer.getPageWidth(page, newZoom);
-    double oldHeight = rasterizer.getPageHeight(page, oldZoom);
-    double newHeight = rasterizer.getPageHeight(page, newZoom);
+    double oldWidth = rasterizer->getPageWidth(page, oldZoom, rotateAngle);
+    double newWidth = rasterizer->getPageWidth(page, newZoom, rotateAngle);
+    double oldHeight = rasterizer->getPageHeight(page, oldZoom, rotateAngle);
+    double newHeight = rasterizer->getPageHeight(page, newZoom, rotateAngle);
 
     double x = oldX / oldWidth * newWidth;
     double y = oldY / oldHeight * newHeight;
@@ -95,11 +99,11 @@ img::Point<double> DocumentSource::transformZoomedPoint(int page, double oldX, d
 }
 
 int DocumentSource::getPageCount() {
-    return rasterizer.getPageCount();
+    return rasterizer->getPageCount();
 }
 
 bool DocumentSource::isTileValid(int page, int x, int y, int zoom) {
-    if (page < 0 || page >= rasterizer.getPageCount()) {
+    if (page < 0 || page >= rasterizer->getPageCount()) {
         return false;
     }
 
@@ -107,9 +111,9 @@ bool DocumentSource::isTileValid(int page, int x, int y, int zoom) {
         return false;
     }
 
-    int tileSize = rasterizer.getTileSize();
+    int tileSize = rasterizer->getTileSize();
 
-    if (x * tileSize >= rasterizer.getPageWidth(page, zoom) || y * tileSize >= rasterizer.getPageHeight(page, zoom)) {
+    if (x * tileSize >= rasterizer->getPageWidth(page, zoom, rotateAngle) || y * tileSize >= rasterizer->getPageHeight(page, zoom, rotateAngle)) {
         return false;
     }
 
@@ -118,12 +122,29 @@ bool DocumentSource::isTileValid(int page, int x, int y, int zoom) {
 
 std::string DocumentSource::getUniqueTileName(int page, int x, int y, int zoom) {
     std::ostringstream nameStream;
-    nameStream << zoom << "/" << x << "/" << y << "/" << page;
+    nameStream << "documents/" << documentHash << "/" << rotateAngle << "/" << zoom << "/" << x << "/" << y << "/" << page << ".qoi";
     return nameStream.str();
 }
 
+bool DocumentSource::cachesRenderedTiles() {
+    return !documentHash.empty();
+}
+
 std::unique_ptr<img::Image> DocumentSource::loadTileImage(int page, int x, int y, int zoom) {
-    return rasterizer.loadTile(page, x, y, zoom, nightMode);
+    return rasterizer->loadTile(page, x, y, zoom, rotateAngle);
+}
+
+std::shared_ptr<img::Image> DocumentSource::getPagePreview(int page) {
+    return rasterizer->getPagePreview(page, rotateAngle);
+}
+
+std::shared_ptr<img::Image> DocumentSource::getPageThumbnail(int page) {
+    return rasterizer->getPageThumbnail(page, rotateAngle);
+}
+
+int DocumentSource::getMaxConcurrentLoads() {
+    // tiles of the same page are rendered in parallel from the shared display list
+    return rasterizer->getMaxConcurrentRenders();
 }
 
 void DocumentSource::cancelPendingLoads() {
@@ -133,25 +154,31 @@ void DocumentSource::resumeLoading() {
 }
 
 img::Point<int> DocumentSource::getPageDimensions(int page, int zoom) {
-    return img::Point<int>{rasterizer.getPageWidth(page, zoom), rasterizer.getPageHeight(page, zoom)};
+    return img::Point<int>{rasterizer->getPageWidth(page, zoom, rotateAngle), rasterizer->getPageHeight(page, zoom, rotateAngle)};
 }
 
 img::Point<double> DocumentSource::worldToXY(double lon, double lat, int zoom) {
-    int tileSize = rasterizer.getTileSize();
+    int tileSize = rasterizer->getTileSize();
 
     auto normXY = calibration.worldToPixels(lon, lat);
 
-    double x = normXY.x * rasterizer.getPageWidth(0, zoom) / tileSize;
-    double y = normXY.y * rasterizer.getPageHeight(0, zoom) / tileSize;
+    double x = normXY.x * rasterizer->getPageWidth(0, zoom, rotateAngle) / tileSize;
+    double y = normXY.y * rasterizer->getPageHeight(0, zoom, rotateAngle) / tileSize;
 
     return img::Point<double>{x, y};
 }
 
+void DocumentSource::worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) {
+    double tileSize = rasterizer->getTileSize();
+    calibration.worldToPixels(lons, lats, xy, count,
+            rasterizer->getPageWidth(0, zoom, rotateAngle) / tileSize, rasterizer->getPageHeight(0, zoom, rotateAngle) / tileSize);
+}
+
 img::Point<double> DocumentSource::xyToWorld(double x, double y, int zoom) {
-    int tileSize = rasterizer.getTileSize();
+    int tileSize = rasterizer->getTileSize();
 
-    double normX = x * tileSize / rasterizer.getPageWidth(0, zoom);
-    double normY = y * tileSize / rasterizer.getPageHeight(0, zoom);
+    double normX = x * tileSize / rasterizer->getPageWidth(0, zoom, rotateAngle);
+    double normY = y * tileSize / rasterizer->getPageHeight(0, zoom, rotateAngle);
 
     return calibration.pixelsToWorld(normX, normY);
 }
@@ -159,13 +186,60 @@ img::Point<double> DocumentSource::xyToWorld(double x, double y, int zoom) {
 void DocumentSource::rotate() {
     rotateAngle = (rotateAngle + 90) % 360;
     calibration.setPreRotate(rotateAngle);
-    rasterizer.setPreRotate(rotateAngle);
 }
 
 void DocumentSource::setNightMode(bool night) {
     nightMode = night;
 }
 
+void DocumentSource::setNightColorMap(std::shared_ptr<const img::ColorLUT> lut) {
+    nightColors = lut;
+}
+
+std::shared_ptr<const img::ColorLUT> DocumentSource::getColorMap() {
+    // the pages are rendered for day use, night mode only changes their colours
+    if (nightMode) {
+        return nightColors;
+    }
+    return nullptr;
+}
+
+void DocumentSource::startTextIndex(const std::string &cacheDir) {
+    if (textIndex) {
+        return;
+    }
+
+    // like the rendered tiles, the index is found by the document's content
+    std::string cacheFile;
+    if (!cacheDir.empty() && !documentHash.empty()) {
+        cacheFile = cacheDir + documentHash + ".idx";
+    }
+    textIndex = std::make_unique<img::TextIndex>(*rasterizer, cacheFile);
+}
+
+std::vector<img::TextIndex::Hit> DocumentSource::findText(const std::string &query, size_t maxHits) {
+    if (!textIndex) {
+        return {};
+    }
+    return textIndex->search(query, maxHits);
+}
+
+int DocumentSource::getIndexedPages() {
+    if (!textIndex) {
+        return 0;
+    }
+    return textIndex->getIndexedPages();
+}
+
+img::Point<double> DocumentSource::hitToXY(const img::TextIndex::Hit &hit, int zoom) {
+    int tileSize = rasterizer->getTileSize();
+
+    double x, y;
+    rasterizer->pageToPixels(hit.page, (hit.x0 + hit.x1) / 2, (hit.y0 + hit.y1) / 2, zoom, rotateAngle, x, y);
+
+    return img::Point<double>{x / tileSize, y / tileSize};
+}
+
 double DocumentSource::getNorthOffsetAngle() {
    return calibration.getNorthOffset();
 }
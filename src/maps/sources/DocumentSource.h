@@ -20,9 +20,11 @@
 #include <string>
 #include <vector>
 #include <atomic>
+#include <memory>
 #include "Calibration.h"
 #include "src/libimg/stitcher/TileSource.h"
 #include "src/libimg/Rasterizer.h"
+#include "src/libimg/TextIndex.h"
 #include "src/charts/Crypto.h"
 #include "src/charts/ChartService.h"
 
@@ -31,7 +33,7 @@ namespace maps {
 class DocumentSource: public img::TileSource {
 public:
     DocumentSource(const std::string& file);
-    DocumentSource(const std::vector<uint8_t> &data, const std::string type);
+    DocumentSource(std::shared_ptr<const std::vector<uint8_t>> data, const std::string type);
 
     int getMinZoomLevel() override;
     int getMaxZoomLevel() override;
@@ -44,32 +46,56 @@ public:
     img::Point<int> getPageDimensions(int page, int zoom) override;
     bool isTileValid(int page, int x, int y, int zoom) override;
     std::string getUniqueTileName(int page, int x, int y, int zoom) override;
+    bool cachesRenderedTiles() override;
     std::unique_ptr<img::Image> loadTileImage(int page, int x, int y, int zoom) override;
+    int getMaxConcurrentLoads() override;
+    std::shared_ptr<img::Image> getPagePreview(int page) override;
+    std::shared_ptr<img::Image> getPageThumbnail(int page) override;
     void cancelPendingLoads() override;
     void resumeLoading() override;
 
     bool supportsWorldCoords() override;
     std::string getCalibrationReport() override;
     img::Point<double> worldToXY(double lon, double lat, int zoom) override;
+    void worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) override;
     img::Point<double> xyToWorld(double x, double y, int zoom) override;
 
     void setNightMode(bool night);
+    void setNightColorMap(std::shared_ptr<const img::ColorLUT> lut);
+    std::shared_ptr<const img::ColorLUT> getColorMap() override;
     void rotate() override;
     double getNorthOffsetAngle() override;
     bool isDocumentSource() override { return true; };
 
+    // Full-text search: the index is built in the background and kept in cacheDir, if given
+    void startTextIndex(const std::string &cacheDir);
+    std::vector<img::TextIndex::Hit> findText(const std::string &query, size_t maxHits);
+    // progress of the index in pages, the page count once it is complete
+    int getIndexedPages();
+    // centre of a hit in tile coordinates
+    img::Point<double> hitToXY(const img::TextIndex::Hit &hit, int zoom);
+
 protected:
     void loadProvidedCalibrationMetadata(std::string calibrationMetadata);
     void rotateFromCalibration();
 
 protected:
-    img::Rasterizer rasterizer;
+    // shared with other sources showing the same document, see img::SharedDocuments
+    std::shared_ptr<img::Rasterizer> rasterizer;
     Calibration calibration;
+    // rotation of this view only, the rasterizer renders any angle it is asked for
+    std::atomic_int rotateAngle { 0 };
 
 private:
+    // white paper at night, as grey as the page fill of earlier versions
+    static constexpr const float NIGHT_BRIGHTNESS = 0.6f;
+
+    std::string documentHash;
     bool nightMode = false;
-    int rotateAngle = 0;
+    std::shared_ptr<const img::ColorLUT> nightColors = std::make_shared<const img::ColorLUT>(img::ColorLUT::brightness(NIGHT_BRIGHTNESS));
 
+    // declared after the rasterizer as it uses it until it is destroyed
+    std::unique_ptr<img::TextIndex> textIndex;
 };
 
 } /* namespace maps */
@@ -20,7 +20,7 @@
 
 namespace maps {
 
-DownloadedSource::DownloadedSource(const std::vector<uint8_t> &data, const std::string type, std::string calibrationMetadata)
+DownloadedSource::DownloadedSource(std::shared_ptr<const std::vector<uint8_t>> data, const std::string type, std::string calibrationMetadata)
 :   DocumentSource(data, type)
 {
     loadProvidedCalibrationMetadata(calibrationMetadata);
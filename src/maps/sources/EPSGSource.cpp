@@ -19,6 +19,7 @@
 #include <stdexcept>
 #include <cmath>
 #include "EPSGSource.h"
+#include "ProjectionKernels.h"
 #include "src/platform/Platform.h"
 
 namespace maps {
@@ -38,6 +39,9 @@ EPSGSource::EPSGSource(const std::string& tilePathUTF8):
             }
         }
     }
+
+    // checking each tile's file is slow on large trees
+    tileIndex = std::make_unique<TileTreeIndex>(tilePathUTF8, ".png");
 }
 
 int EPSGSource::getMinZoomLevel() {
@@ -111,6 +115,10 @@ bool EPSGSource::isTileValid(int page, int x, int y, int zoom) {
         return false;
     }
 
+    if (tileIndex->isReady()) {
+        return tileIndex->hasTile(x, y, zoom);
+    }
+
     return true;
 }
 
@@ -132,27 +140,15 @@ std::unique_ptr<img::Image> EPSGSource::loadTileImage(int page, int x, int y, in
 }
 
 img::Point<double> EPSGSource::worldToXY(double lon, double lat, int zoom) {
-    double zp = std::pow(2.0, zoom);
-    double x = (lon + 180.0) / 360.0 * zp;
-    double y = (1.0 - std::log(std::tan(lat * M_PI / 180.0) +
-           1.0 / std::cos(lat * M_PI / 180.0)) / M_PI) / 2.0 * zp;
-    return img::Point<double>{x, y};
+    return webMercatorToXY(lon, lat, std::pow(2.0, zoom));
 }
 
-img::Point<double> EPSGSource::xyToWorld(double x, double y, int zoom) {
-    double zp = std::pow(2.0, zoom);
-    double plainLon = x / zp * 360.0 - 180;
-    double lon = std::fmod(plainLon, 360.0);
-    if (lon > 180.0) {
-        lon -= 360.0;
-    } else if (lon <= -180.0) {
-        lon += 360.0;
-    }
-
-    double n = M_PI - 2.0 * M_PI * y / zp;
-    double lat = 180.0 / M_PI * std::atan(0.5 * (std::exp(n) - std::exp(-n)));
+void EPSGSource::worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) {
+    webMercatorToXY(lons, lats, xy, count, std::pow(2.0, zoom));
+}
 
-    return img::Point<double>{lon, lat};
+img::Point<double> EPSGSource::xyToWorld(double x, double y, int zoom) {
+    return webMercatorToWorld(x, y, std::pow(2.0, zoom));
 }
 
 } /* namespace maps */
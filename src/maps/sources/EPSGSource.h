@@ -20,7 +20,9 @@
 
 #include <string>
 #include <limits>
+#include <memory>
 #include "src/libimg/stitcher/TileSource.h"
+#include "TileTreeIndex.h"
 
 namespace maps {
 
@@ -51,11 +53,13 @@ public:
     // If world position is supported
     img::Point<double> worldToXY(double lon, double lat, int zoom) override;
     img::Point<double> xyToWorld(double x, double y, int zoom) override;
+    void worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) override;
 
 private:
     int minLevel = std::numeric_limits<int>::max();
     int maxLevel = std::numeric_limits<int>::min();
     std::string tilePath;
+    std::unique_ptr<TileTreeIndex> tileIndex;
 };
 
 } /* namespace maps */
@@ -18,6 +18,7 @@
 #include <stdexcept>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
 #include <geovalues.h>
 #include "GeoTIFFSource.h"
 #include "src/Logger.h"
@@ -128,11 +129,19 @@ std::unique_ptr<img::Image> GeoTIFFSource::loadTileImage(int page, int x, int y,
 
     auto scale = zoomToScale(zoom);
 
-    tiff.loadFullImage();
+    // only the part of the image covered by the tile is decoded
+    int srcSize = tileSize / scale;
+    int srcX = x * srcSize;
+    int srcY = y * srcSize;
+    int srcWidth = std::min(srcSize, tiff.getFullWidth() - srcX);
+    int srcHeight = std::min(srcSize, tiff.getFullHeight() - srcY);
 
-    auto img = std::make_unique<img::Image>(tileSize / scale, tileSize / scale, 0);
-    tiff.copyTo(*img, x * tileSize / scale, y * tileSize / scale);
-    img->scale(tileSize, tileSize);
+    // tiles at the right and bottom edges are partially transparent
+    img::Image region(std::max(1, (int) (srcWidth * scale)), std::max(1, (int) (srcHeight * scale)), 0);
+    tiff.readRegion(srcX, srcY, srcWidth, srcHeight, region);
+
+    auto img = std::make_unique<img::Image>(tileSize, tileSize, 0);
+    region.copyTo(*img, 0, 0);
 
     return img;
 }
@@ -0,0 +1,178 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <algorithm>
+#include "HillshadeSource.h"
+#include "src/libimg/PixelKernels.h"
+#include "src/platform/Tracer.h"
+
+namespace maps {
+
+HillshadeSource::HillshadeSource(
+        std::vector<std::string> tileServers, std::string url,
+        size_t maxZoom, size_t tileSize, float opacity,
+        std::string copyrightInfo, std::string name, std::string protocol):
+    OnlineSlippySource(tileServers, url, 0, maxZoom, tileSize, tileSize, copyrightInfo, name, protocol),
+    tileSize(tileSize),
+    alpha(std::min(std::max(opacity, 0.0f), 1.0f) * 255)
+{
+    buildTints();
+}
+
+void HillshadeSource::buildTints() {
+    struct Stop {
+        float elevation;
+        uint32_t color;
+    };
+    static const Stop stops[] = {
+        {    0, 0x7DA877 },
+        {  300, 0xA9C58E },
+        {  800, 0xD9D4A0 },
+        { 1500, 0xCFAE7F },
+        { 2500, 0xAD8A6C },
+        { 3500, 0xB8AEA8 },
+        { 5000, 0xFFFFFF },
+    };
+    constexpr const size_t numStops = sizeof(stops) / sizeof(stops[0]);
+
+    int count = stops[numStops - 1].elevation / TINT_STEP + 1;
+    tints.resize(count);
+    for (int i = 0; i < count; i++) {
+        float elevation = i * TINT_STEP;
+        size_t s = 1;
+        while (s < numStops - 1 && stops[s].elevation < elevation) {
+            s++;
+        }
+        float t = (elevation - stops[s - 1].elevation) / (stops[s].elevation - stops[s - 1].elevation);
+        t = std::min(std::max(t, 0.0f), 1.0f);
+        uint32_t color = 0;
+        for (int shift = 0; shift <= 16; shift += 8) {
+            float from = (stops[s - 1].color >> shift) & 0xFF;
+            float to = (stops[s].color >> shift) & 0xFF;
+            color |= (uint32_t) (from + (to - from) * t) << shift;
+        }
+        tints[i] = color;
+    }
+}
+
+std::string HillshadeSource::getUniqueTileName(int page, int x, int y, int zoom) {
+    // the cache holds the rendered relief, not the elevation tiles
+    return OnlineSlippySource::getUniqueTileName(page, x, y, zoom) + ".relief" + std::to_string(RENDER_VERSION);
+}
+
+std::string HillshadeSource::getSharedTileNamespace() {
+    return "relief:" + std::to_string(alpha);
+}
+
+bool HillshadeSource::cachesRenderedTiles() {
+    return true;
+}
+
+std::unique_ptr<img::Image> HillshadeSource::loadTileConditional(int page, int x, int y, int zoom, img::TileValidators &validators) {
+    std::vector<uint8_t> data;
+    if (!downloadTile(x, y, zoom, validators, data)) {
+        return nullptr;
+    }
+
+    img::Image elevation;
+    try {
+        elevation.loadEncodedData(data, false);
+    } catch (const std::runtime_error &e) {
+        throw img::TileLoadError(img::TileLoadError::Kind::DECODE, e.what());
+    }
+    return renderTile(elevation, y, zoom);
+}
+
+std::unique_ptr<img::Image> HillshadeSource::renderTile(img::Image &elevation, int y, int zoom) {
+    platform::TraceSpan span("render_relief_tile");
+    int w = elevation.getWidth();
+    int h = elevation.getHeight();
+    if (w < 2 || h < 2) {
+        throw img::TileLoadError(img::TileLoadError::Kind::DECODE, "Elevation tile too small");
+    }
+
+    // elevations with a border that repeats the edge, the neighbouring tiles aren't loaded
+    int stride = w + 2;
+    std::vector<float> heights(stride * (h + 2));
+    const uint32_t *src = elevation.getPixels();
+    for (int row = 0; row < h; row++) {
+        float *dst = &heights[(row + 1) * stride + 1];
+        for (int col = 0; col < w; col++) {
+            uint32_t px = src[row * w + col];
+            dst[col] = ((px >> 16) & 0xFF) * 256.0f + ((px >> 8) & 0xFF) + (px & 0xFF) / 256.0f - 32768.0f;
+        }
+        dst[-1] = dst[0];
+        dst[w] = dst[w - 1];
+    }
+    std::copy_n(&heights[stride], stride, &heights[0]);
+    std::copy_n(&heights[h * stride], stride, &heights[(h + 1) * stride]);
+
+    // horizontal pass for all rows, then the vertical pass row by row
+    std::vector<float> diff(w * (h + 2)), smooth(w * (h + 2));
+    for (int row = 0; row < h + 2; row++) {
+        img::gradientRow(&diff[row * w], &smooth[row * w], &heights[row * stride], w);
+    }
+
+    // pixels are square in web mercator, their size depends on the latitude of the tile
+    double lat = xyToWorld(0, y + 0.5, zoom).y;
+    double cellSize = 40075016.686 * std::cos(lat * M_PI / 180) / (w * std::pow(2.0, zoom));
+    float scale = EXAGGERATION / (8 * std::max(cellSize, 0.01));
+
+    float azimuth = SUN_AZIMUTH_DEG * M_PI / 180;
+    float altitude = SUN_ALTITUDE_DEG * M_PI / 180;
+    img::ShadeLight light;
+    light.x = std::sin(azimuth) * std::cos(altitude);
+    // y points south in the tile
+    light.y = -std::cos(azimuth) * std::cos(altitude);
+    light.z = std::sin(altitude);
+    light.scaleX = scale;
+    light.scaleY = scale;
+
+    auto image = std::make_unique<img::Image>(w, h, img::COLOR_TRANSPARENT);
+    uint32_t *out = image->getPixels();
+    std::vector<float> shade(w);
+    for (int row = 0; row < h; row++) {
+        img::shadeRow(shade.data(), &diff[row * w], &diff[(row + 1) * w], &diff[(row + 2) * w],
+                      &smooth[row * w], &smooth[(row + 2) * w], light, w);
+
+        const float *rowHeights = &heights[(row + 1) * stride + 1];
+        for (int col = 0; col < w; col++) {
+            if (rowHeights[col] <= 0) {
+                // sea level and below stays transparent
+                continue;
+            }
+            // flat terrain keeps the tint, slopes facing the sun get brighter
+            float factor = std::min(shade[col] / light.z, 1.3f);
+            size_t idx = std::min((size_t) (rowHeights[col] / TINT_STEP), tints.size() - 1);
+            uint32_t tint = tints[idx];
+            uint32_t color = alpha << 24;
+            for (int shift = 0; shift <= 16; shift += 8) {
+                float c = ((tint >> shift) & 0xFF) * factor;
+                color |= (uint32_t) std::min(c, 255.0f) << shift;
+            }
+            out[row * w + col] = color;
+        }
+    }
+
+    if (w != tileSize || h != tileSize) {
+        image->scale(tileSize, tileSize);
+    }
+    return image;
+}
+
+} /* namespace maps */
@@ -0,0 +1,62 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "OnlineSlippySource.h"
+
+namespace maps {
+
+/*
+ * Terrain relief generated from elevation tiles in the Terrarium encoding,
+ * i.e. (R * 256 + G + B / 256) - 32768 meters. The elevations are tinted by
+ * height and shaded with light from the north west. The rendered tiles are
+ * stored in the disk cache, so each elevation tile is only shaded once.
+ * Meant to be drawn as a layer of another web mercator map, see Stitcher::setLayer.
+ */
+class HillshadeSource: public OnlineSlippySource {
+public:
+    HillshadeSource(std::vector<std::string> tileServers, std::string url,
+           size_t maxZoom, size_t tileSize, float opacity,
+           std::string copyrightInfo, std::string name, std::string protocol = "https");
+
+    std::string getUniqueTileName(int page, int x, int y, int zoom) override;
+    std::string getSharedTileNamespace() override;
+    bool cachesRenderedTiles() override;
+    std::unique_ptr<img::Image> loadTileConditional(int page, int x, int y, int zoom, img::TileValidators &validators) override;
+
+private:
+    // part of the tile names, to be increased when the rendering changes
+    static constexpr const int RENDER_VERSION = 1;
+    static constexpr const float EXAGGERATION = 2.0f;
+    static constexpr const float SUN_AZIMUTH_DEG = 315;
+    static constexpr const float SUN_ALTITUDE_DEG = 45;
+    // meters per entry of the tint table
+    static constexpr const int TINT_STEP = 10;
+
+    int tileSize;
+    uint32_t alpha;
+    std::vector<uint32_t> tints;
+
+    std::unique_ptr<img::Image> renderTile(img::Image &elevation, int y, int zoom);
+    void buildTints();
+};
+
+} /* namespace maps */
@@ -20,6 +20,7 @@
 #include <cmath>
 #include <cstdio>
 #include <memory>
+#include <algorithm>
 #include "ImageSource.h"
 #include "src/Logger.h"
 
@@ -32,7 +33,9 @@ ImageSource::ImageSource(std::shared_ptr<img::Image> image):
 
 void ImageSource::changeImage(std::shared_ptr<img::Image> newImage) {
     if (image->getWidth() == newImage->getWidth() && image->getHeight() == newImage->getHeight()) {
+        std::lock_guard<std::mutex> lock(pyramidMutex);
         image = newImage;
+        pyramid.clear();
     }
 }
 
@@ -140,14 +143,36 @@ std::unique_ptr<img::Image> ImageSource::loadTileImage(int page, int x, int y, i
         throw std::runtime_error("Invalid page for image");
     }
 
-    auto scale = zoomToScale(zoom);
+    // every other zoom level halves the scale
+    int level = std::max(0, -zoom / 2);
+    auto source = getPyramidLevel(level);
+    auto scale = zoomToScale(zoom) * (1 << level);
+
     auto tile = std::make_unique<img::Image>(TILE_SIZE / scale, TILE_SIZE / scale, 0);
-    image->copyTo(*tile, x * TILE_SIZE / scale, y * TILE_SIZE / scale);
+    source->copyTo(*tile, x * TILE_SIZE / scale, y * TILE_SIZE / scale);
     tile->scale(TILE_SIZE, TILE_SIZE);
 
     return tile;
 }
 
+std::shared_ptr<img::Image> ImageSource::getPyramidLevel(int level) {
+    std::lock_guard<std::mutex> lock(pyramidMutex);
+    if (pyramid.empty()) {
+        pyramid.push_back(image);
+    }
+
+    while ((int) pyramid.size() <= level) {
+        auto &prev = *pyramid.back();
+        int width = std::max(1, prev.getWidth() / 2);
+        int height = std::max(1, prev.getHeight() / 2);
+        auto next = std::make_shared<img::Image>(width, height, 0);
+        next->drawScaledRegion(prev, 0, 0, prev.getWidth(), prev.getHeight(), 0, 0, width, height);
+        pyramid.push_back(next);
+    }
+
+    return pyramid[level];
+}
+
 void ImageSource::cancelPendingLoads() {
 }
 
@@ -164,6 +189,11 @@ img::Point<double> ImageSource::worldToXY(double lon, double lat, int zoom) {
     return img::Point<double>{x, y};
 }
 
+void ImageSource::worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) {
+    auto scale = zoomToScale(zoom);
+    calibration.worldToPixels(lons, lats, xy, count, scale / TILE_SIZE, scale / TILE_SIZE);
+}
+
 img::Point<double> ImageSource::xyToWorld(double x, double y, int zoom) {
     auto scale = zoomToScale(zoom);
     double normX = x * TILE_SIZE / scale;
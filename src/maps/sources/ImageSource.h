@@ -20,6 +20,8 @@
 
 #include <memory>
 #include <string>
+#include <vector>
+#include <mutex>
 #include "src/libimg/stitcher/TileSource.h"
 #include "src/libimg/Rasterizer.h"
 #include "Calibration.h"
@@ -51,6 +53,7 @@ public:
     void attachCalibration2(double x, double y, double lat, double lon, int zoom) override;
     void attachCalibration3Angle(double angle) override;
     img::Point<double> worldToXY(double lon, double lat, int zoom) override;
+    void worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) override;
     img::Point<double> xyToWorld(double x, double y, int zoom) override;
 
 private:
@@ -58,7 +61,13 @@ private:
     std::shared_ptr<img::Image> image;
     Calibration calibration;
 
+    // image halved once per level, so that zoomed out tiles are scaled from
+    // at most twice their size instead of from the full image
+    std::mutex pyramidMutex;
+    std::vector<std::shared_ptr<img::Image>> pyramid;
+
     float zoomToScale(int zoom);
+    std::shared_ptr<img::Image> getPyramidLevel(int level);
 };
 
 } /* namespace maps */
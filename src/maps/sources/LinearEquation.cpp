@@ -217,9 +217,9 @@ std::pair<double,double> LinearEquation::getResult(double x, double y) const {
 
 void LinearEquation::getCoeffs(double &_ax, double &_bx, double &_cx,
                                double &_ay, double &_by, double &_cy) const {
-    _ax = ay;
-    _bx = by;
-    _cx = cy;
+    _ax = ax;
+    _bx = bx;
+    _cx = cx;
     _ay = ay;
     _by = by;
     _cy = cy;
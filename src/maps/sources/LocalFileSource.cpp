@@ -43,24 +43,24 @@ LocalFileSource::LocalFileSource(const std::string& file, std::string calibratio
 }
 
 void LocalFileSource::attachCalibration1(double x, double y, double lat, double lon, int zoom) {
-    int tileSize = rasterizer.getTileSize();
-    double normX = x * tileSize / rasterizer.getPageWidth(0, zoom);
-    double normY = y * tileSize / rasterizer.getPageHeight(0, zoom);
+    int tileSize = rasterizer->getTileSize();
+    double normX = x * tileSize / rasterizer->getPageWidth(0, zoom, rotateAngle);
+    double normY = y * tileSize / rasterizer->getPageHeight(0, zoom, rotateAngle);
     calibration.setPoint1(normX, normY, lat, lon);
 }
 
 void LocalFileSource::attachCalibration2(double x, double y, double lat, double lon, int zoom) {
-    int tileSize = rasterizer.getTileSize();
-    double normX = x * tileSize / rasterizer.getPageWidth(0, zoom);
-    double normY = y * tileSize / rasterizer.getPageHeight(0, zoom);
+    int tileSize = rasterizer->getTileSize();
+    double normX = x * tileSize / rasterizer->getPageWidth(0, zoom, rotateAngle);
+    double normY = y * tileSize / rasterizer->getPageHeight(0, zoom, rotateAngle);
     calibration.setPoint2(normX, normY, lat, lon);
 }
 
 void LocalFileSource::attachCalibration3Point(double x, double y, double lat, double lon, int zoom)
 {
-    int tileSize = rasterizer.getTileSize();
-    double normX = x * tileSize / rasterizer.getPageWidth(0, zoom);
-    double normY = y * tileSize / rasterizer.getPageHeight(0, zoom);
+    int tileSize = rasterizer->getTileSize();
+    double normX = x * tileSize / rasterizer->getPageWidth(0, zoom, rotateAngle);
+    double normY = y * tileSize / rasterizer->getPageHeight(0, zoom, rotateAngle);
     calibration.setPoint3(normX, normY, lat, lon);
 
     try {
@@ -89,7 +89,7 @@ void LocalFileSource::findAndLoadCalibration() {
         logger::info("Loaded co-located json calibration file for %s", utf8FileName.c_str());
         std::string jsonStr((std::istreambuf_iterator<char>(jsonFile)),
                              std::istreambuf_iterator<char>());
-        calibration.fromJsonString(jsonStr, rasterizer.getAspectRatio(0));
+        calibration.fromJsonString(jsonStr, rasterizer->getAspectRatio(0));
     } else {
         // Try a co-located name-matched Google Earth KML file for calibration
         std::string kmlFileName = utf8FileName + ".kml";
@@ -109,7 +109,7 @@ void LocalFileSource::findAndLoadCalibration() {
             std::string calibrationMetadata = chartService->getCalibrationMetadataForFile(utf8FileName);
             if (calibrationMetadata != "") {
                 logger::info("Loaded hash-mapped json calibration file for %s", utf8FileName.c_str());
-                calibration.fromJsonString(calibrationMetadata, rasterizer.getAspectRatio(0));
+                calibration.fromJsonString(calibrationMetadata, rasterizer->getAspectRatio(0));
             } else {
                 logger::warn("No json or kml calibration file for %s", utf8FileName.c_str());
                 return;
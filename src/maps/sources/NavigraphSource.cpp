@@ -19,6 +19,8 @@
 #include <stdexcept>
 #include <cmath>
 #include "NavigraphSource.h"
+#include "OnlineSlippySource.h"
+#include "ProjectionKernels.h"
 
 namespace maps {
 
@@ -70,27 +72,15 @@ img::Point<double> NavigraphSource::transformZoomedPoint(int page, double oldX,
 }
 
 img::Point<double> NavigraphSource::worldToXY(double lon, double lat, int zoom) {
-    double zp = std::pow(2.0, zoom);
-    double x = (lon + 180.0) / 360.0 * zp;
-    double y = (1.0 - std::log(std::tan(lat * M_PI / 180.0) +
-           1.0 / std::cos(lat * M_PI / 180.0)) / M_PI) / 2.0 * zp;
-    return img::Point<double>{x, y};
+    return webMercatorToXY(lon, lat, std::pow(2.0, zoom));
 }
 
-img::Point<double> NavigraphSource::xyToWorld(double x, double y, int zoom) {
-    double zp = std::pow(2.0, zoom);
-    double plainLon = x / zp * 360.0 - 180;
-    double lon = std::fmod(plainLon, 360.0);
-    if (lon > 180.0) {
-        lon -= 360.0;
-    } else if (lon <= -180.0) {
-        lon += 360.0;
-    }
-
-    double n = M_PI - 2.0 * M_PI * y / zp;
-    double lat = 180.0 / M_PI * std::atan(0.5 * (std::exp(n) - std::exp(-n)));
+void NavigraphSource::worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) {
+    webMercatorToXY(lons, lats, xy, count, std::pow(2.0, zoom));
+}
 
-    return img::Point<double>{lon, lat};
+img::Point<double> NavigraphSource::xyToWorld(double x, double y, int zoom) {
+    return webMercatorToWorld(x, y, std::pow(2.0, zoom));
 }
 
 int NavigraphSource::getPageCount() {
@@ -153,10 +143,12 @@ std::string NavigraphSource::getUniqueTileName(int page, int x, int y, int zoom)
 }
 
 std::unique_ptr<img::Image> NavigraphSource::loadTileImage(int page, int x, int y, int zoom) {
-    cancelToken = false;
     std::string path = getUniqueTileName(page, x, y, zoom);
-    auto image = navigraph->getTileFromURL("https://enroute-bitmap.charts.api-v2.navigraph.com/styles" + path, cancelToken);
-    return image;
+    try {
+        return navigraph->getTileFromURL("https://enroute-bitmap.charts.api-v2.navigraph.com/styles" + path, cancelToken);
+    } catch (const DownloadError &e) {
+        throw img::TileLoadError(OnlineSlippySource::classifyError(e), e.what());
+    }
 }
 
 void NavigraphSource::cancelPendingLoads() {
@@ -167,6 +159,15 @@ void NavigraphSource::resumeLoading() {
     cancelToken = false;
 }
 
+int NavigraphSource::getMaxConcurrentLoads() {
+    return navigraph->getMaxTileDownloads();
+}
+
+std::string NavigraphSource::getSharedTileNamespace() {
+    // the unique tile names are the paths of the tiles, including the style
+    return "navigraph";
+}
+
 std::string NavigraphSource::getCopyrightInfo() {
     return "(c) Navigraph | Jeppesen - Not for Navigational Use";
 }
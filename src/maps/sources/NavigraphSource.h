@@ -18,6 +18,7 @@
 #ifndef SRC_MAPS_SOURCES_NAVIGRAPHSOURCE_H_
 #define SRC_MAPS_SOURCES_NAVIGRAPHSOURCE_H_
 
+#include <atomic>
 #include "src/libimg/stitcher/TileSource.h"
 #include "src/charts/libnavigraph/NavigraphAPI.h"
 
@@ -46,6 +47,8 @@ public:
     // Control the underlying loader
     void cancelPendingLoads() override;
     void resumeLoading() override;
+    int getMaxConcurrentLoads() override;
+    std::string getSharedTileNamespace() override;
 
     // Query and load tile information
     int getPageCount() override;
@@ -57,13 +60,14 @@ public:
     // If world position is supported
     img::Point<double> worldToXY(double lon, double lat, int zoom) override;
     img::Point<double> xyToWorld(double x, double y, int zoom) override;
+    void worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) override;
 
     std::string getCopyrightInfo() override;
 private:
     std::shared_ptr<navigraph::NavigraphAPI> navigraph;
     bool dayMode;
     NavigraphMapType type;
-    bool cancelToken = false;
+    std::atomic_bool cancelToken { false };
 };
 
 } /* namespace maps */
@@ -104,6 +104,18 @@ static void validateUrl(const std::string &url, std::string mapName) {
     }
 }
 
+static void validateType(const std::string &type, const std::string &style,
+                         std::string mapName) {
+    if (type != "raster" && type != "vector") {
+        throw std::runtime_error("unsupported type '" + type + "' for " +
+                                 mapName + ". Only raster and vector are supported");
+    }
+    if (type == "vector" && style.empty()) {
+        throw std::runtime_error("the vector map " + mapName +
+                                 " requires a style");
+    }
+}
+
 static void validateProtocol(const std::string &protocol, std::string mapName) {
     auto toLowerCase = [](std::string str) {
         std::transform(str.begin(), str.end(), str.begin(),
@@ -152,6 +164,10 @@ void from_json(const nlohmann::json &j, OnlineSlippyMapConfig &c) {
     parse_json_key<size_t>(j, "max_zoom_level", c.maxZoomLevel, 16, c.name);
     parse_json_key<size_t>(j, "tile_width_px", c.tileWidthPx, 256, c.name);
     parse_json_key<size_t>(j, "tile_height_px", c.tileHeightPx, 256, c.name);
+    parse_json_key<long>(j, "max_age_seconds", c.maxAgeSeconds, -1, c.name);
+    parse_json_key<bool>(j, "hedge_requests", c.hedgeRequests, true, c.name);
+    parse_json_key<std::string>(j, "type", c.type, "raster", c.name);
+    parse_json_key<std::string>(j, "style", c.style, "", c.name);
 
     sanitizeTileServers(c.servers);
     sanitizeUrl(c.url);
@@ -168,6 +184,14 @@ void from_json(const nlohmann::json &j, OnlineSlippyMapConfig &c) {
     logger::verbose("    Max zoom level: %u", c.maxZoomLevel);
     logger::verbose("    Tile width: %upx", c.tileWidthPx);
     logger::verbose("    Tile height: %upx", c.tileHeightPx);
+    if (c.maxAgeSeconds >= 0) {
+        logger::verbose("    Tile max age: %lds", c.maxAgeSeconds);
+    }
+    logger::verbose("    Hedged requests: %s", c.hedgeRequests ? "yes" : "no");
+    logger::verbose("    Map type: %s", c.type.c_str());
+    if (!c.style.empty()) {
+        logger::verbose("    Vector style: '%s'", c.style.c_str());
+    }
 
     // The validation functions throw exceptions, so call them after the
     // verbose print out so in the case of an exception, the user can look
@@ -176,6 +200,7 @@ void from_json(const nlohmann::json &j, OnlineSlippyMapConfig &c) {
     validateTileServers(c.servers, c.name);
     validateUrl(c.url, c.name);
     validateProtocol(c.protocol, c.name);
+    validateType(c.type, c.style, c.name);
 }
 
 } // namespace maps
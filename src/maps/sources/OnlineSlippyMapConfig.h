@@ -37,6 +37,10 @@ struct OnlineSlippyMapConfig {
     size_t maxZoomLevel;
     size_t tileWidthPx;
     size_t tileHeightPx;
+    long maxAgeSeconds; // negative to follow the server's caching headers
+    bool hedgeRequests; // slow tiles are also requested from another server
+    std::string type; // "raster" or "vector"
+    std::string style; // vector maps only, relative to the config file
     bool enabled;
 };
 
@@ -16,11 +16,14 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "OnlineSlippySource.h"
-#include <sstream>
+#include "ProjectionKernels.h"
+#include "src/platform/BandwidthScheduler.h"
+#include "src/platform/Metrics.h"
 #include <stdexcept>
 #include <cmath>
 #include <algorithm>
 #include <regex>
+#include <ctime>
 
 namespace maps {
 
@@ -57,6 +60,9 @@ OnlineSlippySource::OnlineSlippySource(
     // are printed in lower case.
     std::transform(this->protocol.begin(), this->protocol.end(), this->protocol.begin(),
                    [](unsigned char c) { return std::tolower(c); });
+
+    downloader = std::make_unique<MultiDownloader>(DOWNLOADS_PER_SERVER, MAX_CONCURRENT_DOWNLOADS);
+    mirrors.resize(this->tileServers.size());
 }
 
 int OnlineSlippySource::getMinZoomLevel() {
@@ -122,27 +128,15 @@ void OnlineSlippySource::constrainXY(double &x, double &, int zoom) {
 }
 
 img::Point<double> OnlineSlippySource::worldToXY(double lon, double lat, int zoom) {
-    double zp = std::pow(2.0, zoom);
-    double x = (lon + 180.0) / 360.0 * zp;
-    double y = (1.0 - std::log(std::tan(lat * M_PI / 180.0) +
-           1.0 / std::cos(lat * M_PI / 180.0)) / M_PI) / 2.0 * zp;
-    return img::Point<double>{x, y};
+    return webMercatorToXY(lon, lat, std::pow(2.0, zoom));
 }
 
-img::Point<double> OnlineSlippySource::xyToWorld(double x, double y, int zoom) {
-    double zp = std::pow(2.0, zoom);
-    double plainLon = x / zp * 360.0 - 180;
-    double lon = std::fmod(plainLon, 360.0);
-    if (lon > 180.0) {
-        lon -= 360.0;
-    } else if (lon <= -180.0) {
-        lon += 360.0;
-    }
-
-    double n = M_PI - 2.0 * M_PI * y / zp;
-    double lat = 180.0 / M_PI * std::atan(0.5 * (std::exp(n) - std::exp(-n)));
+void OnlineSlippySource::worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) {
+    webMercatorToXY(lons, lats, xy, count, std::pow(2.0, zoom));
+}
 
-    return img::Point<double>{lon, lat};
+img::Point<double> OnlineSlippySource::xyToWorld(double x, double y, int zoom) {
+    return webMercatorToWorld(x, y, std::pow(2.0, zoom));
 }
 
 int OnlineSlippySource::getPageCount() {
@@ -181,39 +175,39 @@ inline void searchAndReplace(std::string &str, const std::string &search, const
     }
 }
 
-std::string OnlineSlippySource::getTileURL(bool randomHost, int x, int y, int zoom) {
+static std::string fillPlaceholders(const std::string &url, int x, int y, int zoom) {
     std::string tileUrl = url;
 
     // Replace url placeholders with correct values
     searchAndReplace(tileUrl, "{z}", std::to_string(zoom));
     searchAndReplace(tileUrl, "{x}", std::to_string(x));
     searchAndReplace(tileUrl, "{y}", std::to_string(y));
+    return tileUrl;
+}
 
-    if (++hostIndex == tileServers.size()) {
-        hostIndex = 0;
-    }
+std::string OnlineSlippySource::getServerTileURL(size_t server, int x, int y, int zoom) {
+    return tileServers[server] + fillPlaceholders(url, x, y, zoom);
+}
 
-    std::ostringstream nameStream;
+std::string OnlineSlippySource::getTileURL(bool randomHost, int x, int y, int zoom) {
     if (randomHost) {
-        nameStream << tileServers[hostIndex];
-    } else {
-        std::regex replaceChars("[=/#]");
-        tileUrl = tileUrl.replace(0, 1, ""); // Remove leading '/'
-        if (tileUrl.find("?") != std::string::npos) {
-            // If there's a query string, massage tileUrl
-            std::string hostPath = tileUrl.substr(0, tileUrl.find("?"));
-            std::string queryString = tileUrl.substr(tileUrl.find("?") + 1, std::string::npos);
-            hostPath = std::regex_replace(hostPath, replaceChars, "_");
-            queryString = std::regex_replace(queryString, replaceChars, "_");
-            tileUrl = queryString + "/" + hostPath;
-        } else {
-            tileUrl = std::regex_replace(tileUrl, replaceChars, "_");
-        }
-        nameStream << tileServers[0] << "/";
+        return getServerTileURL(hostIndex++ % tileServers.size(), x, y, zoom);
     }
 
-    nameStream << tileUrl;
-    return nameStream.str();
+    std::string tileUrl = fillPlaceholders(url, x, y, zoom);
+    std::regex replaceChars("[=/#]");
+    tileUrl = tileUrl.replace(0, 1, ""); // Remove leading '/'
+    if (tileUrl.find("?") != std::string::npos) {
+        // If there's a query string, massage tileUrl
+        std::string hostPath = tileUrl.substr(0, tileUrl.find("?"));
+        std::string queryString = tileUrl.substr(tileUrl.find("?") + 1, std::string::npos);
+        hostPath = std::regex_replace(hostPath, replaceChars, "_");
+        queryString = std::regex_replace(queryString, replaceChars, "_");
+        tileUrl = queryString + "/" + hostPath;
+    } else {
+        tileUrl = std::regex_replace(tileUrl, replaceChars, "_");
+    }
+    return tileServers[0] + "/" + tileUrl;
 }
 
 std::string OnlineSlippySource::getUniqueTileName(int page, int x, int y, int zoom) {
@@ -226,20 +220,226 @@ std::string OnlineSlippySource::getUniqueTileName(int page, int x, int y, int zo
 }
 
 std::unique_ptr<img::Image> OnlineSlippySource::loadTileImage(int page, int x, int y, int zoom) {
-    cancelToken = false;
-    std::string path = getTileURL(true, x, y, zoom);
-    auto data = downloader.download(protocol + "://" + path, cancelToken);
+    img::TileValidators validators;
+    return loadTileConditional(page, x, y, zoom, validators);
+}
+
+bool OnlineSlippySource::supportsRevalidation() {
+    return true;
+}
+
+std::unique_ptr<img::Image> OnlineSlippySource::loadTileConditional(int page, int x, int y, int zoom, img::TileValidators &validators) {
+    std::vector<uint8_t> data;
+    if (!downloadTile(x, y, zoom, validators, data)) {
+        return nullptr;
+    }
+
     auto image = std::make_unique<img::Image>();
-    image->loadEncodedData(data, true);
+    try {
+        image->loadEncodedData(data, true);
+    } catch (const std::runtime_error &e) {
+        throw img::TileLoadError(img::TileLoadError::Kind::DECODE, e.what());
+    }
     return image;
 }
 
+bool OnlineSlippySource::downloadTile(int x, int y, int zoom, img::TileValidators &validators, std::vector<uint8_t> &data) {
+    HttpCacheInfo cacheInfo;
+    cacheInfo.etag = validators.etag;
+    cacheInfo.lastModified = validators.lastModified;
+
+    // only visible tiles are worth the extra requests, prefetching and seeding can wait
+    auto hedgeAfter = getHedgeDelay();
+    bool hedge = hedging && hedgeAfter.count() > 0 &&
+            platform::BandwidthScheduler::currentTraffic(platform::BandwidthScheduler::Traffic::INTERACTIVE) ==
+            platform::BandwidthScheduler::Traffic::INTERACTIVE;
+
+    size_t primary, secondary = 0;
+    {
+        std::lock_guard<std::mutex> lock(mirrorMutex);
+        primary = pickMirror(tileServers.size());
+        if (hedge) {
+            secondary = pickMirror(primary);
+        }
+        mirrors[primary].inFlight++;
+    }
+
+    // each transfer has its own token, cancelling a tile leaves the others running
+    auto cancel = img::TileLoadCancel::get();
+    MultiDownloader::HedgeOutcome outcome;
+    auto startedAt = std::chrono::steady_clock::now();
+    auto elapsedMs = [startedAt] () {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startedAt).count();
+    };
+
+    try {
+        std::string url = protocol + "://" + getServerTileURL(primary, x, y, zoom);
+        if (hedge) {
+            std::string hedgeUrl = protocol + "://" + getServerTileURL(secondary, x, y, zoom);
+            data = downloader->downloadHedged(url, hedgeUrl, hedgeAfter, *cancel, &cacheInfo, outcome);
+        } else {
+            data = downloader->download(url, *cancel, &cacheInfo);
+        }
+    } catch (const DownloadError &e) {
+        endMirrorRequest(primary);
+        auto kind = classifyError(e);
+        bool failed = (kind == img::TileLoadError::Kind::NETWORK || kind == img::TileLoadError::Kind::SERVER);
+        double ms = elapsedMs();
+        recordMirror(primary, ms, failed);
+        if (outcome.hedged) {
+            // both servers failed
+            recordMirror(secondary, ms - hedgeAfter.count(), failed);
+        }
+        throw img::TileLoadError(kind, e.what());
+    } catch (const std::out_of_range &e) {
+        endMirrorRequest(primary);
+        throw;
+    }
+    endMirrorRequest(primary);
+
+    static auto &hedged = platform::Metrics::counter("tiles/hedged_requests");
+    static auto &hedgeWins = platform::Metrics::counter("tiles/hedge_wins");
+    double ms = elapsedMs();
+    if (outcome.hedgeWon) {
+        // the primary didn't answer in time, its real latency is at least this
+        recordMirror(primary, ms, false);
+        recordMirror(secondary, ms - hedgeAfter.count(), false);
+        hedgeWins.add();
+    } else {
+        recordMirror(primary, ms, false);
+    }
+    if (outcome.hedged) {
+        hedged.add();
+    }
+
+    long age = maxAge >= 0 ? maxAge.load() : (cacheInfo.maxAge >= 0 ? cacheInfo.maxAge : DEFAULT_MAX_AGE);
+    int64_t expires = (int64_t) std::time(nullptr) + age;
+
+    if (cacheInfo.notModified) {
+        // keep the old validators if the server didn't repeat them
+        if (!cacheInfo.etag.empty()) {
+            validators.etag = cacheInfo.etag;
+        }
+        if (!cacheInfo.lastModified.empty()) {
+            validators.lastModified = cacheInfo.lastModified;
+        }
+        validators.expires = expires;
+        return false;
+    }
+
+    validators.etag = cacheInfo.etag;
+    validators.lastModified = cacheInfo.lastModified;
+    validators.expires = expires;
+    return true;
+}
+
+void OnlineSlippySource::setMaxAge(long seconds) {
+    maxAge = seconds;
+}
+
+void OnlineSlippySource::setHedgedRequests(bool hedge) {
+    hedging = hedge;
+}
+
+size_t OnlineSlippySource::pickMirror(size_t exclude) {
+    // gets called with locked mirrorMutex. Servers without samples are tried first,
+    // requests in flight count so that similar servers share the load.
+    size_t count = tileServers.size();
+    size_t first = hostIndex++ % count;
+    if (mirrorRequests++ % MIRROR_PROBE_INTERVAL == 0 && first != exclude) {
+        return first;
+    }
+
+    size_t best = count;
+    double bestCost = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t server = (first + i) % count;
+        if (server == exclude) {
+            continue;
+        }
+        auto &mirror = mirrors[server];
+        double cost = mirror.latencyMs * (1.0 + (double) mirror.inFlight / DOWNLOADS_PER_SERVER) /
+                        (1.0 - std::min(mirror.errorRate, 0.9));
+        if (best == count || cost < bestCost) {
+            best = server;
+            bestCost = cost;
+        }
+    }
+    return best == count ? first : best;
+}
+
+void OnlineSlippySource::endMirrorRequest(size_t server) {
+    std::lock_guard<std::mutex> lock(mirrorMutex);
+    mirrors[server].inFlight--;
+}
+
+void OnlineSlippySource::recordMirror(size_t server, double latencyMs, bool failed) {
+    std::lock_guard<std::mutex> lock(mirrorMutex);
+    auto &mirror = mirrors[server];
+    if (!mirror.hasSamples) {
+        mirror.latencyMs = latencyMs;
+        mirror.hasSamples = true;
+    } else {
+        mirror.latencyMs += MIRROR_SMOOTHING * (latencyMs - mirror.latencyMs);
+    }
+    mirror.errorRate += MIRROR_SMOOTHING * ((failed ? 1.0 : 0.0) - mirror.errorRate);
+
+    if (!failed) {
+        if (recentLatencies.size() < LATENCY_WINDOW) {
+            recentLatencies.push_back(latencyMs);
+        } else {
+            recentLatencies[nextLatency] = latencyMs;
+            nextLatency = (nextLatency + 1) % LATENCY_WINDOW;
+        }
+    }
+}
+
+std::chrono::milliseconds OnlineSlippySource::getHedgeDelay() {
+    // the 90th percentile of the recent latencies, zero if hedging isn't possible yet
+    if (tileServers.size() < 2) {
+        return std::chrono::milliseconds(0);
+    }
+
+    std::vector<double> latencies;
+    {
+        std::lock_guard<std::mutex> lock(mirrorMutex);
+        if (recentLatencies.size() < MIN_HEDGE_SAMPLES) {
+            return std::chrono::milliseconds(0);
+        }
+        latencies = recentLatencies;
+    }
+
+    auto p90 = latencies.begin() + latencies.size() * 9 / 10;
+    std::nth_element(latencies.begin(), p90, latencies.end());
+    return std::chrono::milliseconds(std::max(MIN_HEDGE_DELAY_MS, (int) *p90));
+}
+
+img::TileLoadError::Kind OnlineSlippySource::classifyError(const DownloadError &e) {
+    long status = e.getHttpStatus();
+    if (status == 404 || status == 410 || status == 204) {
+        return img::TileLoadError::Kind::NOT_FOUND;
+    } else if (status == 429 || status >= 500) {
+        return img::TileLoadError::Kind::SERVER;
+    } else if (status == 0 || e.isTimeout()) {
+        return img::TileLoadError::Kind::NETWORK;
+    }
+    return img::TileLoadError::Kind::OTHER;
+}
+
 void OnlineSlippySource::cancelPendingLoads() {
-    cancelToken = true;
+    // the cache cancels the transfers through their load tokens
 }
 
 void OnlineSlippySource::resumeLoading() {
-    cancelToken = false;
+}
+
+int OnlineSlippySource::getMaxConcurrentLoads() {
+    return std::min(MAX_CONCURRENT_DOWNLOADS, DOWNLOADS_PER_SERVER * (int) tileServers.size());
+}
+
+std::string OnlineSlippySource::getSharedTileNamespace() {
+    // the unique tile names are the URLs of the tiles
+    return "slippy";
 }
 
 std::string OnlineSlippySource::getCopyrightInfo() {
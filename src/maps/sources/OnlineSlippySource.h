@@ -18,8 +18,14 @@
 #ifndef SRC_MAPS_OPENTOPOSOURCE_H_
 #define SRC_MAPS_OPENTOPOSOURCE_H_
 
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 #include "src/libimg/stitcher/TileSource.h"
 #include "src/maps/Downloader.h"
+#include "src/maps/MultiDownloader.h"
 
 namespace maps {
 
@@ -43,6 +49,8 @@ public:
     // Control the underlying loader
     void cancelPendingLoads() override;
     void resumeLoading() override;
+    int getMaxConcurrentLoads() override;
+    std::string getSharedTileNamespace() override;
 
     // Query and load tile information
     int getPageCount() override;
@@ -51,17 +59,61 @@ public:
     std::string getTileURL(bool randomHost, int x, int y, int zoom);
     std::string getUniqueTileName(int page, int x, int y, int zoom) override;
     std::unique_ptr<img::Image> loadTileImage(int page, int x, int y, int zoom) override;
+    bool supportsRevalidation() override;
+    std::unique_ptr<img::Image> loadTileConditional(int page, int x, int y, int zoom, img::TileValidators &validators) override;
+
+    // Overrides the server's Cache-Control max-age for cached tiles, negative to follow the server
+    void setMaxAge(long seconds);
+    // With several tile servers, visible tiles that take longer than most are also requested from another one
+    void setHedgedRequests(bool hedge);
 
     // If world position is supported
     img::Point<double> worldToXY(double lon, double lat, int zoom) override;
     img::Point<double> xyToWorld(double x, double y, int zoom) override;
+    void worldToXYBatch(const double *lons, const double *lats, img::Point<double> *xy, size_t count, int zoom) override;
 
     std::string getCopyrightInfo() override;
     const std::string name;
+
+    static img::TileLoadError::Kind classifyError(const DownloadError &e);
+protected:
+    // false if the tile described by the validators is unchanged, the validators are updated in both cases
+    bool downloadTile(int x, int y, int zoom, img::TileValidators &validators, std::vector<uint8_t> &data);
 private:
-    bool cancelToken = false;
-    uint8_t hostIndex = 0;
-    Downloader downloader;
+    // polite limit for parallel requests per tile server
+    static constexpr const int DOWNLOADS_PER_SERVER = 2;
+    static constexpr const int MAX_CONCURRENT_DOWNLOADS = 6;
+    // used if neither the config nor the server specify a max-age
+    static constexpr const long DEFAULT_MAX_AGE = 7 * 24 * 3600;
+    // weight of a new sample in the smoothed latency and error rate of a server
+    static constexpr const double MIRROR_SMOOTHING = 0.2;
+    // every nth request goes to the next server in turn so that a server recovers from a bad record
+    static constexpr const size_t MIRROR_PROBE_INTERVAL = 32;
+    // latencies of the recent requests, hedging starts once there are enough of them
+    static constexpr const size_t LATENCY_WINDOW = 64;
+    static constexpr const size_t MIN_HEDGE_SAMPLES = 16;
+    static constexpr const int MIN_HEDGE_DELAY_MS = 50;
+
+    // one tile server, smoothed over the recent requests
+    struct Mirror {
+        double latencyMs = 0;
+        double errorRate = 0;
+        bool hasSamples = false;
+        int inFlight = 0;
+    };
+
+    std::atomic<size_t> hostIndex { 0 };
+    std::atomic<long> maxAge { -1 };
+    std::atomic_bool hedging { true };
+
+    std::mutex mirrorMutex;
+    std::vector<Mirror> mirrors;
+    std::vector<double> recentLatencies;
+    size_t nextLatency = 0;
+    size_t mirrorRequests = 0;
+
+    // all tile requests of this source share the connections to the servers
+    std::unique_ptr<MultiDownloader> downloader;
     std::vector<std::string> tileServers;
     std::string url;
     size_t minZoom;
@@ -70,6 +122,12 @@ private:
     int tileHeight = 256;
     std::string copyrightInfo;
     std::string protocol = "https";
+
+    std::string getServerTileURL(size_t server, int x, int y, int zoom);
+    size_t pickMirror(size_t exclude);
+    void endMirrorRequest(size_t server);
+    void recordMirror(size_t server, double latencyMs, bool failed);
+    std::chrono::milliseconds getHedgeDelay();
 };
 
 } /* namespace maps */
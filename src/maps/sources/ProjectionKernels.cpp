@@ -0,0 +1,309 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cmath>
+#include <algorithm>
+#include "ProjectionKernels.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#   define AVITAB_PROJECTION_SSE2 1
+#   include <emmintrin.h>
+#elif defined(__aarch64__)
+#   define AVITAB_PROJECTION_NEON 1
+#   include <arm_neon.h>
+#endif
+
+namespace maps {
+
+namespace {
+
+static_assert(sizeof(img::Point<double>) == 2 * sizeof(double), "points are stored as x, y pairs");
+
+// sin(x) by its Taylor series up to x^21: |x| <= pi / 2 after clamping, where
+// the first omitted term is below 1e-17
+constexpr const double SIN_COEFFS[] = {
+    -1.0 / 6,                   1.0 / 120,                  -1.0 / 5040,
+    1.0 / 362880,               -1.0 / 39916800,            1.0 / 6227020800,
+    -1.0 / 1307674368000,       1.0 / 355687428096000,      -1.0 / 121645100408832000,
+    1.0 / 51090942171709440000.0,
+};
+
+// log(1 + f) = f - (f^2 / 2 - s * (f^2 / 2 + R(s^2))) with s = f / (2 + f), the
+// minimax polynomial R and the split ln(2) are the ones used by fdlibm
+constexpr const double LG1 = 6.666666666666735130e-01;
+constexpr const double LG2 = 3.999999999940941908e-01;
+constexpr const double LG3 = 2.857142874366239149e-01;
+constexpr const double LG4 = 2.222219843214978396e-01;
+constexpr const double LG5 = 1.818357216161805012e-01;
+constexpr const double LG6 = 1.531383769920937332e-01;
+constexpr const double LG7 = 1.479819860511658591e-01;
+constexpr const double LN2_HI = 6.93147180369123816490e-01;
+constexpr const double LN2_LO = 1.90821492927058770002e-10;
+
+// keeps 1 - sin(lat) away from 0, about 1e-4 m from the pole
+constexpr const double MAX_LATITUDE = 89.999999999;
+
+// the latitude where Web Mercator's square world ends, i.e. the ordinate is +-pi
+constexpr const double WEB_MERCATOR_LATITUDE = 85.05112877980659;
+
+// Cubic Hermite interpolation of a function from its values and its exact
+// derivatives at equidistant samples. The error grows with the fourth power
+// of the step, the ordinate's steep rise towards the poles needs 4096 steps.
+template<size_t N>
+class HermiteTable {
+public:
+    template<typename F, typename D>
+    HermiteTable(double from, double to, F f, D derivative):
+        from(from),
+        to(to),
+        step((to - from) / N),
+        invStep(N / (to - from))
+    {
+        for (size_t i = 0; i <= N; i++) {
+            double x = from + i * step;
+            values[i] = f(x);
+            slopes[i] = derivative(x) * step;
+        }
+    }
+
+    bool covers(double x) const {
+        // also false for NaN
+        return x >= from && x <= to;
+    }
+
+    double operator()(double x) const {
+        double u = (x - from) * invStep;
+        size_t i = std::min((size_t) u, N - 1);
+        double t = u - i;
+        double t2 = t * t;
+        double t3 = t2 * t;
+        return (2 * t3 - 3 * t2 + 1) * values[i] + (t3 - 2 * t2 + t) * slopes[i]
+             + (3 * t2 - 2 * t3) * values[i + 1] + (t3 - t2) * slopes[i + 1];
+    }
+
+private:
+    double from, to, step, invStep;
+    double values[N + 1];
+    double slopes[N + 1];
+};
+
+// ordinate by latitude in degrees
+const HermiteTable<4096> &ordinateTable() {
+    static const HermiteTable<4096> table(-WEB_MERCATOR_LATITUDE, WEB_MERCATOR_LATITUDE,
+        [] (double lat) { return std::atanh(std::sin(lat * M_PI / 180.0)); },
+        [] (double lat) { return M_PI / 180.0 / std::cos(lat * M_PI / 180.0); });
+    return table;
+}
+
+// latitude in degrees by ordinate, the inverse is much flatter
+const HermiteTable<2048> &latitudeTable() {
+    static const HermiteTable<2048> table(-M_PI, M_PI,
+        [] (double n) { return 180.0 / M_PI * std::atan(std::sinh(n)); },
+        [] (double n) { return 180.0 / M_PI / std::cosh(n); });
+    return table;
+}
+
+inline double webMercatorOrdinate(const HermiteTable<4096> &table, double lat) {
+    if (table.covers(lat)) {
+        return table(lat);
+    }
+    double phi = lat * M_PI / 180.0;
+    return std::log(std::tan(phi) + 1.0 / std::cos(phi));
+}
+
+void mercatorToAffineScalar(const double *lons, const double *lats, img::Point<double> *xy, size_t count,
+                            const AffineCoeffs &c, double ordinateScale) {
+    for (size_t i = 0; i < count; i++) {
+        double phi = lats[i] * M_PI / 180.0;
+        double y = std::log(std::tan(phi) + 1.0 / std::cos(phi)) * ordinateScale;
+        xy[i].x = c.ax * lons[i] + c.bx * y + c.cx;
+        xy[i].y = c.ay * lons[i] + c.by * y + c.cy;
+    }
+}
+
+#ifdef AVITAB_PROJECTION_SSE2
+
+inline __m128d sinSSE2(__m128d x) {
+    __m128d x2 = _mm_mul_pd(x, x);
+    __m128d p = _mm_set1_pd(SIN_COEFFS[9]);
+    for (int k = 8; k >= 0; k--) {
+        p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SIN_COEFFS[k]));
+    }
+    return _mm_add_pd(x, _mm_mul_pd(_mm_mul_pd(x, x2), p));
+}
+
+// natural logarithm of positive, normal numbers
+inline __m128d logSSE2(__m128d x) {
+    const __m128d one = _mm_set1_pd(1.0);
+    __m128i bits = _mm_castpd_si128(x);
+    __m128i biased = _mm_shuffle_epi32(_mm_srli_epi64(bits, 52), _MM_SHUFFLE(3, 3, 2, 0));
+    __m128d k = _mm_sub_pd(_mm_cvtepi32_pd(biased), _mm_set1_pd(1023.0));
+
+    // mantissa in [1, 2), then moved to [sqrt(2) / 2, sqrt(2))
+    __m128d m = _mm_or_pd(_mm_and_pd(x, _mm_castsi128_pd(_mm_set1_epi64x(0x000FFFFFFFFFFFFFLL))), one);
+    __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(M_SQRT2));
+    m = _mm_sub_pd(m, _mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))));
+    k = _mm_add_pd(k, _mm_and_pd(big, one));
+
+    __m128d f = _mm_sub_pd(m, one);
+    __m128d s = _mm_div_pd(f, _mm_add_pd(f, _mm_set1_pd(2.0)));
+    __m128d z = _mm_mul_pd(s, s);
+    __m128d w = _mm_mul_pd(z, z);
+    __m128d t1 = _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(LG2), _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(LG4),
+                    _mm_mul_pd(w, _mm_set1_pd(LG6))))));
+    __m128d t2 = _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(LG1), _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(LG3),
+                    _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(LG5), _mm_mul_pd(w, _mm_set1_pd(LG7))))))));
+    __m128d r = _mm_add_pd(t1, t2);
+    __m128d hfsq = _mm_mul_pd(_mm_set1_pd(0.5), _mm_mul_pd(f, f));
+    __m128d inner = _mm_add_pd(_mm_mul_pd(s, _mm_add_pd(hfsq, r)), _mm_mul_pd(k, _mm_set1_pd(LN2_LO)));
+    return _mm_sub_pd(_mm_mul_pd(k, _mm_set1_pd(LN2_HI)), _mm_sub_pd(_mm_sub_pd(hfsq, inner), f));
+}
+
+void mercatorToAffineSSE2(const double *lons, const double *lats, img::Point<double> *xy, size_t count,
+                          const AffineCoeffs &c, double ordinateScale) {
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d toRadians = _mm_set1_pd(M_PI / 180.0);
+    const __m128d maxLat = _mm_set1_pd(MAX_LATITUDE);
+    // ln(tan(pi / 4 + phi / 2)) = atanh(sin(phi)) = 0.5 * ln((1 + sin(phi)) / (1 - sin(phi)))
+    const __m128d scale = _mm_set1_pd(0.5 * ordinateScale);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d lon = _mm_loadu_pd(lons + i);
+        __m128d lat = _mm_max_pd(_mm_min_pd(_mm_loadu_pd(lats + i), maxLat), _mm_sub_pd(_mm_setzero_pd(), maxLat));
+        __m128d s = sinSSE2(_mm_mul_pd(lat, toRadians));
+        __m128d y = _mm_mul_pd(logSSE2(_mm_div_pd(_mm_add_pd(one, s), _mm_sub_pd(one, s))), scale);
+        __m128d rx = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(c.ax), lon), _mm_mul_pd(_mm_set1_pd(c.bx), y)), _mm_set1_pd(c.cx));
+        __m128d ry = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(c.ay), lon), _mm_mul_pd(_mm_set1_pd(c.by), y)), _mm_set1_pd(c.cy));
+        _mm_storeu_pd(&xy[i].x, _mm_unpacklo_pd(rx, ry));
+        _mm_storeu_pd(&xy[i + 1].x, _mm_unpackhi_pd(rx, ry));
+    }
+    mercatorToAffineScalar(lons + i, lats + i, xy + i, count - i, c, ordinateScale);
+}
+
+#endif /* AVITAB_PROJECTION_SSE2 */
+
+#ifdef AVITAB_PROJECTION_NEON
+
+inline float64x2_t sinNEON(float64x2_t x) {
+    float64x2_t x2 = vmulq_f64(x, x);
+    float64x2_t p = vdupq_n_f64(SIN_COEFFS[9]);
+    for (int k = 8; k >= 0; k--) {
+        p = vaddq_f64(vmulq_f64(p, x2), vdupq_n_f64(SIN_COEFFS[k]));
+    }
+    return vaddq_f64(x, vmulq_f64(vmulq_f64(x, x2), p));
+}
+
+inline float64x2_t logNEON(float64x2_t x) {
+    const float64x2_t one = vdupq_n_f64(1.0);
+    uint64x2_t bits = vreinterpretq_u64_f64(x);
+    float64x2_t k = vsubq_f64(vcvtq_f64_u64(vshrq_n_u64(bits, 52)), vdupq_n_f64(1023.0));
+
+    uint64x2_t mantissa = vandq_u64(bits, vdupq_n_u64(0x000FFFFFFFFFFFFFULL));
+    float64x2_t m = vreinterpretq_f64_u64(vorrq_u64(mantissa, vreinterpretq_u64_f64(one)));
+    uint64x2_t big = vcgtq_f64(m, vdupq_n_f64(M_SQRT2));
+    m = vbslq_f64(big, vmulq_f64(m, vdupq_n_f64(0.5)), m);
+    k = vbslq_f64(big, vaddq_f64(k, one), k);
+
+    float64x2_t f = vsubq_f64(m, one);
+    float64x2_t s = vdivq_f64(f, vaddq_f64(f, vdupq_n_f64(2.0)));
+    float64x2_t z = vmulq_f64(s, s);
+    float64x2_t w = vmulq_f64(z, z);
+    float64x2_t t1 = vmulq_f64(w, vaddq_f64(vdupq_n_f64(LG2), vmulq_f64(w, vaddq_f64(vdupq_n_f64(LG4),
+                        vmulq_f64(w, vdupq_n_f64(LG6))))));
+    float64x2_t t2 = vmulq_f64(z, vaddq_f64(vdupq_n_f64(LG1), vmulq_f64(w, vaddq_f64(vdupq_n_f64(LG3),
+                        vmulq_f64(w, vaddq_f64(vdupq_n_f64(LG5), vmulq_f64(w, vdupq_n_f64(LG7))))))));
+    float64x2_t r = vaddq_f64(t1, t2);
+    float64x2_t hfsq = vmulq_f64(vdupq_n_f64(0.5), vmulq_f64(f, f));
+    float64x2_t inner = vaddq_f64(vmulq_f64(s, vaddq_f64(hfsq, r)), vmulq_f64(k, vdupq_n_f64(LN2_LO)));
+    return vsubq_f64(vmulq_f64(k, vdupq_n_f64(LN2_HI)), vsubq_f64(vsubq_f64(hfsq, inner), f));
+}
+
+void mercatorToAffineNEON(const double *lons, const double *lats, img::Point<double> *xy, size_t count,
+                          const AffineCoeffs &c, double ordinateScale) {
+    const float64x2_t one = vdupq_n_f64(1.0);
+    const float64x2_t toRadians = vdupq_n_f64(M_PI / 180.0);
+    const float64x2_t maxLat = vdupq_n_f64(MAX_LATITUDE);
+    const float64x2_t scale = vdupq_n_f64(0.5 * ordinateScale);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        float64x2_t lon = vld1q_f64(lons + i);
+        float64x2_t lat = vmaxq_f64(vminq_f64(vld1q_f64(lats + i), maxLat), vnegq_f64(maxLat));
+        float64x2_t s = sinNEON(vmulq_f64(lat, toRadians));
+        float64x2_t y = vmulq_f64(logNEON(vdivq_f64(vaddq_f64(one, s), vsubq_f64(one, s))), scale);
+        float64x2x2_t out;
+        out.val[0] = vaddq_f64(vaddq_f64(vmulq_n_f64(lon, c.ax), vmulq_n_f64(y, c.bx)), vdupq_n_f64(c.cx));
+        out.val[1] = vaddq_f64(vaddq_f64(vmulq_n_f64(lon, c.ay), vmulq_n_f64(y, c.by)), vdupq_n_f64(c.cy));
+        vst2q_f64(&xy[i].x, out);
+    }
+    mercatorToAffineScalar(lons + i, lats + i, xy + i, count - i, c, ordinateScale);
+}
+
+#endif /* AVITAB_PROJECTION_NEON */
+
+} // namespace
+
+void mercatorToAffine(const double *lons, const double *lats, img::Point<double> *xy, size_t count,
+                      const AffineCoeffs &coeffs, double ordinateScale) {
+#if defined(AVITAB_PROJECTION_SSE2)
+    mercatorToAffineSSE2(lons, lats, xy, count, coeffs, ordinateScale);
+#elif defined(AVITAB_PROJECTION_NEON)
+    mercatorToAffineNEON(lons, lats, xy, count, coeffs, ordinateScale);
+#else
+    mercatorToAffineScalar(lons, lats, xy, count, coeffs, ordinateScale);
+#endif
+}
+
+AffineCoeffs webMercatorCoeffs(double tiles) {
+    // x = (lon + 180) / 360 * tiles, y = (1 - ordinate / pi) / 2 * tiles
+    return AffineCoeffs{tiles / 360.0, 0, tiles / 2, 0, -tiles / (2 * M_PI), tiles / 2};
+}
+
+void webMercatorToXY(const double *lons, const double *lats, img::Point<double> *xy, size_t count, double tiles) {
+    // a table lookup is cheaper than the vector kernels' log and sin polynomials
+    auto &table = ordinateTable();
+    double xScale = tiles / 360.0;
+    double yScale = -tiles / (2 * M_PI);
+    double offset = tiles / 2;
+    for (size_t i = 0; i < count; i++) {
+        xy[i].x = xScale * lons[i] + offset;
+        xy[i].y = yScale * webMercatorOrdinate(table, lats[i]) + offset;
+    }
+}
+
+img::Point<double> webMercatorToXY(double lon, double lat, double tiles) {
+    img::Point<double> xy;
+    webMercatorToXY(&lon, &lat, &xy, 1, tiles);
+    return xy;
+}
+
+img::Point<double> webMercatorToWorld(double x, double y, double tiles) {
+    double plainLon = x / tiles * 360.0 - 180;
+    double lon = std::fmod(plainLon, 360.0);
+    if (lon > 180.0) {
+        lon -= 360.0;
+    } else if (lon <= -180.0) {
+        lon += 360.0;
+    }
+
+    double n = M_PI - 2.0 * M_PI * y / tiles;
+    auto &table = latitudeTable();
+    double lat = table.covers(n) ? table(n) : 180.0 / M_PI * std::atan(std::sinh(n));
+
+    return img::Point<double>{lon, lat};
+}
+
+} /* namespace maps */
@@ -0,0 +1,51 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include "src/libimg/stitcher/TileSource.h"
+
+namespace maps {
+
+// x' = ax * x + bx * y + cx, y' = ay * x + by * y + cy
+struct AffineCoeffs {
+    double ax, bx, cx;
+    double ay, by, cy;
+};
+
+// Batch projection of positions given in degrees: xy[i] is the affine transform of
+// (lons[i], ordinateScale * ln(tan(pi / 4 + lats[i] / 2))), i.e. of the Mercator
+// projection. Uses SSE2 or NEON where available, latitudes are clamped just short
+// of the poles by the vector code.
+void mercatorToAffine(const double *lons, const double *lats, img::Point<double> *xy, size_t count,
+                      const AffineCoeffs &coeffs, double ordinateScale);
+
+// the transform that mercatorToAffine needs for Web Mercator tile coordinates, with
+// tiles being the number of tiles along each axis
+AffineCoeffs webMercatorCoeffs(double tiles);
+
+// Web Mercator tile coordinates of positions given in degrees. Within the Web Mercator
+// latitude range the ordinate is interpolated from a table shared by all zoom levels,
+// off by less than 1e-10, i.e. 0.01 pixels of 256 pixel tiles at zoom 20.
+void webMercatorToXY(const double *lons, const double *lats, img::Point<double> *xy, size_t count, double tiles);
+img::Point<double> webMercatorToXY(double lon, double lat, double tiles);
+
+// the inverse, longitudes are wrapped to (-180, 180]
+img::Point<double> webMercatorToWorld(double x, double y, double tiles);
+
+} /* namespace maps */
@@ -0,0 +1,256 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include "TileTreeIndex.h"
+#include "src/Logger.h"
+#include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
+
+namespace maps {
+
+TileTreeIndex::TileTreeIndex(const std::string &rootPath, const std::string &extension):
+    rootPath(rootPath),
+    extension(extension),
+    indexFile(rootPath + "/Tiles.idx")
+{
+    builder = platform::Executor::shared().submit("tiletree", platform::Executor::Priority::BACKGROUND,
+            [this] { build(); });
+}
+
+bool TileTreeIndex::isReady() const {
+    return ready;
+}
+
+bool TileTreeIndex::hasTile(int x, int y, int zoom) const {
+    auto levelIt = levels.find(zoom);
+    if (levelIt == levels.end()) {
+        return false;
+    }
+
+    auto columnIt = levelIt->second.find(x);
+    if (columnIt == levelIt->second.end()) {
+        return false;
+    }
+
+    const Column &column = columnIt->second;
+    if (y < column.minY) {
+        return false;
+    }
+    size_t bit = y - column.minY;
+    if (bit / 64 >= column.bits.size()) {
+        return false;
+    }
+    return (column.bits[bit / 64] >> (bit % 64)) & 1;
+}
+
+void TileTreeIndex::build() {
+    std::unordered_map<int32_t, Level> previous;
+    loadFromFile(previous);
+
+    bool changed = false;
+    size_t columns = 0;
+    try {
+        for (auto &entry: platform::readDirectory(rootPath)) {
+            int32_t zoom;
+            if (!entry.isDirectory || !parseNumber(entry.utf8Name, zoom)) {
+                continue;
+            }
+            Level &level = levels[zoom];
+            changed |= scanLevel(rootPath + "/" + entry.utf8Name, previous[zoom], level);
+            if (stopBuilder) {
+                return;
+            }
+            columns += level.size();
+        }
+    } catch (const std::exception &e) {
+        // without a complete index, every tile is treated as present
+        logger::warn("Couldn't index tiles in %s: %s", rootPath.c_str(), e.what());
+        return;
+    }
+
+    // levels that disappeared also change the index
+    for (auto &it: previous) {
+        changed |= !it.second.empty() && levels.find(it.first) == levels.end();
+    }
+
+    ready = true;
+    logger::verbose("Indexed %d tile directories in %d levels of %s", (int) columns, (int) levels.size(), rootPath.c_str());
+    if (changed) {
+        storeToFile();
+    }
+}
+
+bool TileTreeIndex::scanLevel(const std::string &path, const Level &previous, Level &level) {
+    bool changed = false;
+    for (auto &entry: platform::readDirectory(path)) {
+        if (stopBuilder) {
+            return false;
+        }
+
+        int32_t x;
+        if (!entry.isDirectory || !parseNumber(entry.utf8Name, x)) {
+            continue;
+        }
+
+        // adding or removing a tile changes its directory's modification time
+        std::string columnPath = path + "/" + entry.utf8Name;
+        std::error_code ec;
+        int64_t modTime = fs::last_write_time(fs::u8path(columnPath), ec).time_since_epoch().count();
+        auto it = previous.find(x);
+        if (!ec && it != previous.end() && it->second.modTime == modTime) {
+            level.emplace(x, it->second);
+            continue;
+        }
+
+        level.emplace(x, scanColumn(columnPath, modTime));
+        changed = true;
+    }
+
+    return changed || level.size() != previous.size();
+}
+
+TileTreeIndex::Column TileTreeIndex::scanColumn(const std::string &path, int64_t modTime) {
+    std::vector<int32_t> ys;
+    for (auto &entry: platform::readDirectory(path)) {
+        const std::string &name = entry.utf8Name;
+        if (entry.isDirectory || name.size() <= extension.size() ||
+                name.compare(name.size() - extension.size(), extension.size(), extension) != 0) {
+            continue;
+        }
+        int32_t y;
+        if (parseNumber(name.substr(0, name.size() - extension.size()), y)) {
+            ys.push_back(y);
+        }
+    }
+
+    Column column;
+    column.modTime = modTime;
+    if (ys.empty()) {
+        return column;
+    }
+
+    auto range = std::minmax_element(ys.begin(), ys.end());
+    column.minY = *range.first;
+    column.bits.resize((size_t) (*range.second - column.minY) / 64 + 1);
+    for (int32_t y: ys) {
+        size_t bit = y - column.minY;
+        column.bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+    return column;
+}
+
+bool TileTreeIndex::parseNumber(const std::string &str, int32_t &number) {
+    if (str.empty() || str.size() > 9 || !std::all_of(str.begin(), str.end(), [] (char c) { return c >= '0' && c <= '9'; })) {
+        return false;
+    }
+    number = std::stoi(str);
+    return true;
+}
+
+void TileTreeIndex::loadFromFile(std::unordered_map<int32_t, Level> &loaded) {
+    if (!platform::fileExists(indexFile)) {
+        return;
+    }
+
+    try {
+        platform::MappedFile file(indexFile);
+        const char *pos = file.data();
+        const char *end = pos + file.size();
+
+        auto get = [&pos, end] (void *value, size_t len) {
+            if ((size_t) (end - pos) < len) {
+                throw std::runtime_error("Truncated index");
+            }
+            std::memcpy(value, pos, len);
+            pos += len;
+        };
+        auto getU32 = [&get] () {
+            uint32_t value;
+            get(&value, sizeof(value));
+            return value;
+        };
+
+        if (getU32() != FILE_MAGIC || getU32() != FILE_VERSION) {
+            throw std::runtime_error("Unknown index format");
+        }
+
+        uint32_t levelCount = getU32();
+        for (uint32_t i = 0; i < levelCount; i++) {
+            Level &level = loaded[(int32_t) getU32()];
+            uint32_t columnCount = getU32();
+            for (uint32_t j = 0; j < columnCount; j++) {
+                int32_t x = (int32_t) getU32();
+                Column column;
+                get(&column.modTime, sizeof(column.modTime));
+                column.minY = (int32_t) getU32();
+                uint32_t words = getU32();
+                if ((size_t) (end - pos) / sizeof(uint64_t) < words) {
+                    throw std::runtime_error("Truncated index");
+                }
+                column.bits.resize(words);
+                get(column.bits.data(), words * sizeof(uint64_t));
+                level.emplace(x, std::move(column));
+            }
+        }
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't load tile index %s: %s", indexFile.c_str(), e.what());
+        loaded.clear();
+    }
+}
+
+void TileTreeIndex::storeToFile() {
+    // a crash never leaves a truncated index behind
+    try {
+        platform::writeFileAtomically(indexFile, [this] (std::ostream &stream) {
+            auto put = [&stream] (const void *value, size_t len) {
+                stream.write(reinterpret_cast<const char *>(value), len);
+            };
+            auto putU32 = [&put] (uint32_t value) {
+                put(&value, sizeof(value));
+            };
+
+            putU32(FILE_MAGIC);
+            putU32(FILE_VERSION);
+            putU32(levels.size());
+            for (auto &level: levels) {
+                putU32(level.first);
+                putU32(level.second.size());
+                for (auto &it: level.second) {
+                    putU32(it.first);
+                    put(&it.second.modTime, sizeof(it.second.modTime));
+                    putU32(it.second.minY);
+                    putU32(it.second.bits.size());
+                    put(it.second.bits.data(), it.second.bits.size() * sizeof(uint64_t));
+                }
+            }
+        });
+    } catch (const std::exception &e) {
+        // tile trees can be read-only, the index is then built on every run
+        logger::verbose("Couldn't store tile index %s: %s", indexFile.c_str(), e.what());
+    }
+}
+
+TileTreeIndex::~TileTreeIndex() {
+    stopBuilder = true;
+    builder->cancel();
+    builder->wait();
+}
+
+} /* namespace maps */
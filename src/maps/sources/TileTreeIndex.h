@@ -0,0 +1,73 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include "src/platform/Executor.h"
+
+namespace maps {
+
+// The tiles that exist in a zoom/x/y tree of files, built in a background thread.
+// The index is stored in the tree's root so that later runs only need to list
+// the x directories that changed since.
+class TileTreeIndex {
+public:
+    TileTreeIndex(const std::string &rootPath, const std::string &extension);
+
+    bool isReady() const;
+
+    // only answers once the index is ready
+    bool hasTile(int x, int y, int zoom) const;
+
+    ~TileTreeIndex();
+private:
+    static constexpr const uint32_t FILE_MAGIC = 0x58495454; // "TTIX"
+    static constexpr const uint32_t FILE_VERSION = 1;
+
+    // presence bits of the y values of one x directory, starting at minY
+    struct Column {
+        int64_t modTime = 0;
+        int32_t minY = 0;
+        std::vector<uint64_t> bits;
+    };
+    using Level = std::unordered_map<int32_t, Column>;
+
+    std::string rootPath;
+    std::string extension;
+    std::string indexFile;
+
+    // only written by the builder before ready is set
+    std::unordered_map<int32_t, Level> levels;
+    std::atomic_bool ready { false };
+    std::atomic_bool stopBuilder { false };
+    std::shared_ptr<platform::Executor::Job> builder;
+
+    void build();
+    bool scanLevel(const std::string &path, const Level &previous, Level &level);
+    Column scanColumn(const std::string &path, int64_t modTime);
+    static bool parseNumber(const std::string &str, int32_t &number);
+    void loadFromFile(std::unordered_map<int32_t, Level> &loaded);
+    void storeToFile();
+};
+
+} /* namespace maps */
@@ -0,0 +1,250 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include "VectorTile.h"
+
+namespace maps {
+
+namespace {
+
+// Minimal protocol buffers reader, just enough for the vector tile schema
+class PbfReader {
+public:
+    enum WireType { VARINT = 0, FIXED64 = 1, BYTES = 2, FIXED32 = 5 };
+
+    PbfReader(const uint8_t *data, size_t size): pos(data), end(data + size) { }
+
+    bool next(uint32_t &field, uint32_t &wireType) {
+        if (pos >= end) {
+            return false;
+        }
+        uint64_t key = varint();
+        field = key >> 3;
+        wireType = key & 0x7;
+        return true;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= end) {
+                throw std::runtime_error("Truncated varint");
+            }
+            uint8_t byte = *pos++;
+            value |= (uint64_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Invalid varint");
+    }
+
+    PbfReader bytes() {
+        uint64_t len = varint();
+        if (len > (uint64_t) (end - pos)) {
+            throw std::runtime_error("Truncated field");
+        }
+        PbfReader sub(pos, len);
+        pos += len;
+        return sub;
+    }
+
+    std::string string() {
+        PbfReader sub = bytes();
+        return std::string(reinterpret_cast<const char *>(sub.pos), sub.end - sub.pos);
+    }
+
+    template<typename T>
+    T fixed() {
+        T value;
+        if ((size_t) (end - pos) < sizeof(value)) {
+            throw std::runtime_error("Truncated field");
+        }
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+
+    void skip(uint32_t wireType) {
+        switch (wireType) {
+        case VARINT:  varint(); break;
+        case FIXED64: fixed<uint64_t>(); break;
+        case BYTES:   bytes(); break;
+        case FIXED32: fixed<uint32_t>(); break;
+        default:      throw std::runtime_error("Unsupported wire type");
+        }
+    }
+
+    const uint8_t *data() const { return pos; }
+    size_t size() const { return end - pos; }
+
+private:
+    const uint8_t *pos;
+    const uint8_t *end;
+};
+
+std::string formatNumber(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.15g", value);
+    return buf;
+}
+
+std::string decodeValue(PbfReader msg) {
+    std::string value;
+    uint32_t field, wireType;
+    while (msg.next(field, wireType)) {
+        switch (field) {
+        case 1:  value = msg.string(); break;
+        case 2:  value = formatNumber(msg.fixed<float>()); break;
+        case 3:  value = formatNumber(msg.fixed<double>()); break;
+        case 4:  value = std::to_string((int64_t) msg.varint()); break;
+        case 5:  value = std::to_string(msg.varint()); break;
+        case 6: {
+            uint64_t v = msg.varint();
+            value = std::to_string((int64_t) ((v >> 1) ^ -(v & 1)));
+            break;
+        }
+        case 7:  value = msg.varint() ? "true" : "false"; break;
+        default: msg.skip(wireType); break;
+        }
+    }
+    return value;
+}
+
+VectorTile::Feature decodeFeature(PbfReader msg) {
+    VectorTile::Feature feature;
+    uint32_t field, wireType;
+    while (msg.next(field, wireType)) {
+        if (field == 2 && wireType == PbfReader::BYTES) {
+            PbfReader tags = msg.bytes();
+            while (tags.size() > 0) {
+                feature.tags.push_back(tags.varint());
+            }
+        } else if (field == 3 && wireType == PbfReader::VARINT) {
+            uint64_t type = msg.varint();
+            feature.type = (type <= 3) ? (VectorTile::GeomType) type : VectorTile::GeomType::UNKNOWN;
+        } else if (field == 4 && wireType == PbfReader::BYTES) {
+            PbfReader geometry = msg.bytes();
+            feature.geometry = geometry.data();
+            feature.geometrySize = geometry.size();
+        } else {
+            msg.skip(wireType);
+        }
+    }
+    if (feature.tags.size() % 2 != 0) {
+        throw std::runtime_error("Invalid feature tags");
+    }
+    return feature;
+}
+
+VectorTile::Layer decodeLayer(PbfReader msg) {
+    VectorTile::Layer layer;
+    uint32_t field, wireType;
+    while (msg.next(field, wireType)) {
+        switch (field) {
+        case 1:  layer.name = msg.string(); break;
+        case 2:  layer.features.push_back(decodeFeature(msg.bytes())); break;
+        case 3:  layer.keys.push_back(msg.string()); break;
+        case 4:  layer.values.push_back(decodeValue(msg.bytes())); break;
+        case 5:  layer.extent = msg.varint(); break;
+        default: msg.skip(wireType); break;
+        }
+    }
+
+    if (layer.extent == 0) {
+        throw std::runtime_error("Invalid layer extent");
+    }
+    // checked once here so that the renderer can use the tags without checks
+    for (auto &feature: layer.features) {
+        for (size_t i = 0; i < feature.tags.size(); i += 2) {
+            if (feature.tags[i] >= layer.keys.size() || feature.tags[i + 1] >= layer.values.size()) {
+                throw std::runtime_error("Invalid feature tags");
+            }
+        }
+    }
+    return layer;
+}
+
+}
+
+VectorTile::VectorTile(const uint8_t *data, size_t size) {
+    if (size >= 2 && data[0] == 0x1F && data[1] == 0x8B) {
+        // served without Content-Encoding, the downloader can't know that it has to inflate it
+        throw std::runtime_error("Compressed vector tile");
+    }
+
+    PbfReader msg(data, size);
+    uint32_t field, wireType;
+    while (msg.next(field, wireType)) {
+        if (field == 3 && wireType == PbfReader::BYTES) {
+            layers.push_back(decodeLayer(msg.bytes()));
+        } else {
+            msg.skip(wireType);
+        }
+    }
+}
+
+const std::vector<VectorTile::Layer> &VectorTile::getLayers() const {
+    return layers;
+}
+
+void VectorTile::decodeGeometry(const Feature &feature, float scale, std::vector<float> &xy, std::vector<uint32_t> &partEnds) {
+    enum Command { MOVE_TO = 1, LINE_TO = 2, CLOSE_PATH = 7 };
+
+    PbfReader msg(feature.geometry, feature.geometrySize);
+    auto zigzag = [] (uint64_t v) { return (int32_t) ((v >> 1) ^ -(v & 1)); };
+
+    // the coordinates are deltas to the previous point, even across parts
+    int32_t x = 0, y = 0;
+    bool inPart = false;
+    uint32_t firstPoint = xy.size() / 2;
+    size_t firstPart = partEnds.size();
+    while (msg.size() > 0) {
+        uint32_t cmd = msg.varint();
+        uint32_t id = cmd & 0x7;
+        uint32_t count = cmd >> 3;
+        if (id == MOVE_TO || id == LINE_TO) {
+            for (uint32_t i = 0; i < count; i++) {
+                if (id == MOVE_TO && inPart) {
+                    partEnds.push_back(xy.size() / 2);
+                }
+                x += zigzag(msg.varint());
+                y += zigzag(msg.varint());
+                xy.push_back(x * scale);
+                xy.push_back(y * scale);
+                inPart = true;
+            }
+        } else if (id == CLOSE_PATH) {
+            // rings are closed explicitly so that lines and rings draw alike
+            if (inPart) {
+                uint32_t start = (partEnds.size() > firstPart) ? partEnds.back() : firstPoint;
+                xy.push_back(xy[2 * start]);
+                xy.push_back(xy[2 * start + 1]);
+            }
+        } else {
+            throw std::runtime_error("Invalid geometry command");
+        }
+    }
+    if (inPart) {
+        partEnds.push_back(xy.size() / 2);
+    }
+}
+
+} /* namespace maps */
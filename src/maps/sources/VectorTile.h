@@ -0,0 +1,65 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace maps {
+
+/*
+ * Decoder for Mapbox Vector Tiles, version 2 of the specification.
+ * The layers and attributes are decoded right away, the geometries only
+ * when they are drawn. The tile refers to the encoded data, so that must
+ * outlive it. Throws std::runtime_error for invalid data.
+ */
+class VectorTile {
+public:
+    enum class GeomType { UNKNOWN = 0, POINT = 1, LINESTRING = 2, POLYGON = 3 };
+
+    struct Feature {
+        GeomType type = GeomType::UNKNOWN;
+        // pairs of indices into the layer's keys and values
+        std::vector<uint32_t> tags;
+        const uint8_t *geometry = nullptr;
+        size_t geometrySize = 0;
+    };
+
+    struct Layer {
+        std::string name;
+        uint32_t extent = 4096;
+        std::vector<std::string> keys;
+        // numbers and booleans are converted to strings
+        std::vector<std::string> values;
+        std::vector<Feature> features;
+    };
+
+    VectorTile(const uint8_t *data, size_t size);
+    const std::vector<Layer> &getLayers() const;
+
+    // Appends the feature's points scaled by scale as x, y pairs to xy and the
+    // end of each part (line or polygon ring) in points to partEnds
+    static void decodeGeometry(const Feature &feature, float scale, std::vector<float> &xy, std::vector<uint32_t> &partEnds);
+
+private:
+    std::vector<Layer> layers;
+};
+
+} /* namespace maps */
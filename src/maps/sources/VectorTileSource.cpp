@@ -0,0 +1,210 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+#include "VectorTileSource.h"
+#include "VectorTile.h"
+#include "src/libimg/PathRasterizer.h"
+#include "src/platform/Platform.h"
+#include "src/platform/Tracer.h"
+#include "src/Logger.h"
+
+namespace maps {
+
+VectorTileSource::VectorTileSource(
+        std::vector<std::string> tileServers, std::string url,
+        size_t minZoom, size_t maxZoom, size_t tileSize,
+        std::string copyrightInfo, std::string name, std::string protocol,
+        const std::string &utf8StyleFile):
+    OnlineSlippySource(tileServers, url, minZoom, maxZoom, tileSize, tileSize, copyrightInfo, name, protocol),
+    tileSize(tileSize),
+    styleFile(utf8StyleFile)
+{
+    loadStyle(utf8StyleFile);
+
+    rulesByZoom.resize(maxZoom + 1);
+    for (size_t zoom = 0; zoom <= maxZoom; zoom++) {
+        for (size_t i = 0; i < rules.size(); i++) {
+            if ((int) zoom >= rules[i].minZoom && (int) zoom <= rules[i].maxZoom) {
+                rulesByZoom[zoom].push_back(i);
+            }
+        }
+    }
+}
+
+void VectorTileSource::loadStyle(const std::string &utf8StyleFile) {
+    fs::ifstream stream(fs::u8path(utf8StyleFile));
+    if (!stream) {
+        throw std::runtime_error("Couldn't open style " + utf8StyleFile);
+    }
+
+    try {
+        auto style = nlohmann::json::parse(stream);
+        background = parseColor(style.value("background", "#FFFFFF"));
+        for (auto &entry: style.at("rules")) {
+            Rule rule;
+            rule.layer = entry.at("layer").get<std::string>();
+            std::string type = entry.value("type", "fill");
+            if (type == "fill") {
+                rule.kind = Rule::Kind::FILL;
+            } else if (type == "line") {
+                rule.kind = Rule::Kind::LINE;
+            } else {
+                throw std::runtime_error("Unknown rule type '" + type + "'");
+            }
+            rule.color = parseColor(entry.at("color").get<std::string>());
+            rule.width = entry.value("width", 1.0f);
+            rule.minZoom = entry.value("min_zoom", 0);
+            rule.maxZoom = entry.value("max_zoom", 30);
+
+            if (entry.contains("filter")) {
+                auto &filter = entry.at("filter");
+                if (!filter.is_object() || filter.size() != 1) {
+                    throw std::runtime_error("Filters must have exactly one key");
+                }
+                rule.filterKey = filter.begin().key();
+                rule.filterValues = filter.begin().value().get<std::vector<std::string>>();
+            }
+            rules.push_back(rule);
+        }
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error("Invalid style " + utf8StyleFile + ": " + e.what());
+    }
+
+    logger::verbose("Loaded %d vector style rules from %s", (int) rules.size(), utf8StyleFile.c_str());
+}
+
+uint32_t VectorTileSource::parseColor(const std::string &color) {
+    // #RRGGBB or #AARRGGBB
+    if ((color.size() != 7 && color.size() != 9) || color[0] != '#' ||
+        color.find_first_not_of("0123456789abcdefABCDEF", 1) != std::string::npos)
+    {
+        throw std::runtime_error("Invalid color '" + color + "'");
+    }
+    uint32_t value = std::stoul(color.substr(1), nullptr, 16);
+    return (color.size() == 7) ? (0xFF000000 | value) : value;
+}
+
+std::string VectorTileSource::getSharedTileNamespace() {
+    // the same vector tiles look different with another style
+    return "vector:" + styleFile;
+}
+
+bool VectorTileSource::cachesTileData() {
+    return true;
+}
+
+std::unique_ptr<img::Image> VectorTileSource::loadTileConditional(int page, int x, int y, int zoom, img::TileValidators &validators) {
+    std::vector<uint8_t> data;
+    if (!downloadTile(x, y, zoom, validators, data)) {
+        return nullptr;
+    }
+
+    auto image = renderTileData(data, zoom);
+    image->setEncodedData(std::move(data));
+    return image;
+}
+
+std::unique_ptr<img::Image> VectorTileSource::renderTileData(const std::vector<uint8_t> &data, int zoom) {
+    platform::TraceSpan span("render_vector_tile");
+    try {
+        return renderTile(data, zoom);
+    } catch (const std::runtime_error &e) {
+        throw img::TileLoadError(img::TileLoadError::Kind::DECODE, e.what());
+    }
+}
+
+std::unique_ptr<img::Image> VectorTileSource::renderTile(const std::vector<uint8_t> &data, int zoom) {
+    VectorTile tile(data.data(), data.size());
+    auto image = std::make_unique<img::Image>(tileSize, tileSize, background);
+    if (zoom < 0 || zoom >= (int) rulesByZoom.size()) {
+        return image;
+    }
+
+    img::PathRasterizer rasterizer(tileSize, tileSize);
+    std::vector<float> xy;
+    std::vector<uint32_t> partEnds;
+    std::vector<bool> valueMatches;
+
+    for (size_t ruleIdx: rulesByZoom[zoom]) {
+        const Rule &rule = rules[ruleIdx];
+        for (auto &layer: tile.getLayers()) {
+            if (layer.name != rule.layer) {
+                continue;
+            }
+
+            // the filter is resolved to the layer's tables once instead of comparing strings per feature
+            uint32_t filterKey = 0;
+            if (!rule.filterKey.empty()) {
+                auto it = std::find(layer.keys.begin(), layer.keys.end(), rule.filterKey);
+                if (it == layer.keys.end()) {
+                    continue;
+                }
+                filterKey = it - layer.keys.begin();
+                valueMatches.assign(layer.values.size(), false);
+                for (size_t i = 0; i < layer.values.size(); i++) {
+                    auto &values = rule.filterValues;
+                    valueMatches[i] = std::find(values.begin(), values.end(), layer.values[i]) != values.end();
+                }
+            }
+
+            float scale = (float) tileSize / layer.extent;
+            for (auto &feature: layer.features) {
+                if (feature.type == VectorTile::GeomType::POINT || feature.type == VectorTile::GeomType::UNKNOWN) {
+                    continue;
+                }
+                if (rule.kind == Rule::Kind::FILL && feature.type != VectorTile::GeomType::POLYGON) {
+                    continue;
+                }
+                if (!rule.filterKey.empty()) {
+                    bool match = false;
+                    for (size_t i = 0; i < feature.tags.size() && !match; i += 2) {
+                        match = (feature.tags[i] == filterKey && valueMatches[feature.tags[i + 1]]);
+                    }
+                    if (!match) {
+                        continue;
+                    }
+                }
+
+                xy.clear();
+                partEnds.clear();
+                VectorTile::decodeGeometry(feature, scale, xy, partEnds);
+
+                uint32_t start = 0;
+                for (uint32_t end: partEnds) {
+                    if (rule.kind == Rule::Kind::LINE) {
+                        rasterizer.addStroke(&xy[2 * start], end - start, rule.width);
+                    } else if (end > start) {
+                        rasterizer.moveTo(xy[2 * start], xy[2 * start + 1]);
+                        for (uint32_t i = start + 1; i < end; i++) {
+                            rasterizer.lineTo(xy[2 * i], xy[2 * i + 1]);
+                        }
+                    }
+                    start = end;
+                }
+            }
+        }
+        // everything of one rule at once, overlapping features merge instead of blending twice
+        rasterizer.fill(*image, rule.color);
+    }
+
+    return image;
+}
+
+} /* namespace maps */
@@ -0,0 +1,75 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "OnlineSlippySource.h"
+
+namespace maps {
+
+/*
+ * Online map made of Mapbox Vector Tiles that are rendered on the loader
+ * threads. The style is a JSON file with the background color and a list of
+ * rules, drawn in their order:
+ *   {"layer": "water", "type": "fill", "color": "#aad3df"}
+ *   {"layer": "transportation", "filter": {"class": ["motorway", "trunk"]},
+ *    "type": "line", "color": "#e892a2", "width": 2.5, "min_zoom": 5, "max_zoom": 20}
+ * The disk cache keeps the vector tiles, so changing the style only renders
+ * the tiles again instead of downloading them.
+ */
+class VectorTileSource: public OnlineSlippySource {
+public:
+    VectorTileSource(std::vector<std::string> tileServers, std::string url,
+           size_t minZoom, size_t maxZoom, size_t tileSize,
+           std::string copyrightInfo, std::string name, std::string protocol,
+           const std::string &utf8StyleFile);
+
+    std::string getSharedTileNamespace() override;
+    bool cachesTileData() override;
+    std::unique_ptr<img::Image> renderTileData(const std::vector<uint8_t> &data, int zoom) override;
+    std::unique_ptr<img::Image> loadTileConditional(int page, int x, int y, int zoom, img::TileValidators &validators) override;
+
+private:
+    struct Rule {
+        enum class Kind { FILL, LINE };
+
+        std::string layer;
+        // features match if the key has any of the values, all match without a key
+        std::string filterKey;
+        std::vector<std::string> filterValues;
+        Kind kind = Kind::FILL;
+        uint32_t color = 0;
+        float width = 1;
+        int minZoom = 0, maxZoom = 30;
+    };
+
+    int tileSize;
+    std::string styleFile;
+    uint32_t background = img::COLOR_WHITE;
+    std::vector<Rule> rules;
+    // indices of the rules that apply to each zoom level, in drawing order
+    std::vector<std::vector<size_t>> rulesByZoom;
+
+    void loadStyle(const std::string &utf8StyleFile);
+    std::unique_ptr<img::Image> renderTile(const std::vector<uint8_t> &data, int zoom);
+    static uint32_t parseColor(const std::string &color);
+};
+
+} /* namespace maps */
@@ -23,6 +23,7 @@
 #include <memory>
 #include "src/libimg/DDSImage.h"
 #include "src/platform/Platform.h"
+#include "src/platform/StatCache.h"
 #include "src/Logger.h"
 
 namespace maps {
@@ -111,7 +112,8 @@ std::unique_ptr<img::Image> XPlaneSource::loadTileImage(int page, int x, int y,
     std::snprintf(name, max_len, "%+03d%+04d.dds", -y * 10 + 80, x * 10 - 180);
     std::string path = baseDir + name;
 
-    if (!platform::fileExists(path)) {
+    // the ocean tiles are missing, one listing answers for all of them
+    if (!platform::StatCache::shared().exists(path)) {
         auto dim = getTileDimensions(zoom);
         return std::make_unique<img::Image>(dim.x, dim.y, WATER_COLOR);
     }
@@ -122,10 +124,18 @@ std::unique_ptr<img::Image> XPlaneSource::loadTileImage(int page, int x, int y,
         mipLevel = 0;
     }
 
-    std::unique_ptr<img::Image> image = std::make_unique<img::DDSImage>(path, mipLevel);
+    // keep the DXT blocks in memory unless the tile has to be scaled up anyways
+    bool scaleUp = zoom > MAX_MIPMAP_LVL;
+    std::unique_ptr<img::Image> image;
+    auto file = openFile(path);
+    if (file && mipLevel < file->getMipCount()) {
+        image = std::make_unique<img::DDSImage>(*file, mipLevel, !scaleUp);
+    } else {
+        image = std::make_unique<img::DDSImage>(path, mipLevel, !scaleUp);
+    }
     image->alphaBlend(WATER_COLOR);
 
-    if (zoom > MAX_MIPMAP_LVL) {
+    if (scaleUp) {
         auto dim = getTileDimensions(zoom);
         image->scale(dim.x, dim.y);
     }
@@ -133,12 +143,41 @@ std::unique_ptr<img::Image> XPlaneSource::loadTileImage(int page, int x, int y,
     return image;
 }
 
+std::shared_ptr<const img::DDSFile> XPlaneSource::openFile(const std::string &path) {
+    std::lock_guard<std::mutex> lock(filesMutex);
+
+    for (auto it = openFiles.begin(); it != openFiles.end(); ++it) {
+        if (it->first == path) {
+            openFiles.splice(openFiles.begin(), openFiles, it);
+            return it->second;
+        }
+    }
+
+    std::shared_ptr<const img::DDSFile> file;
+    try {
+        file = std::make_shared<const img::DDSFile>(path);
+    } catch (const std::exception &e) {
+        logger::verbose("%s, using the generic loader", e.what());
+    }
+
+    openFiles.emplace_front(path, file);
+    if (openFiles.size() > MAX_OPEN_FILES) {
+        openFiles.pop_back();
+    }
+    return file;
+}
+
 void XPlaneSource::cancelPendingLoads() {
 }
 
 void XPlaneSource::resumeLoading() {
 }
 
+int XPlaneSource::getMaxConcurrentLoads() {
+    // each tile is an independent DDS file, decoding is stateless
+    return 2;
+}
+
 img::Point<double> XPlaneSource::worldToXY(double lon, double lat, int zoom) {
     double x = (lon + 180) / 10;
     double y = (-lat + 90) / 10;
@@ -19,7 +19,11 @@
 #define SRC_MAPS_XPLANESOURCE_H_
 
 #include <string>
+#include <list>
+#include <mutex>
+#include <memory>
 #include "src/libimg/stitcher/TileSource.h"
+#include "src/libimg/DDSFile.h"
 
 namespace maps {
 
@@ -41,6 +45,7 @@ public:
     std::unique_ptr<img::Image> loadTileImage(int page, int x, int y, int zoom) override;
     void cancelPendingLoads() override;
     void resumeLoading() override;
+    int getMaxConcurrentLoads() override;
 
     bool supportsWorldCoords() override;
     img::Point<double> worldToXY(double lon, double lat, int zoom) override;
@@ -48,8 +53,16 @@ public:
 private:
     const uint32_t WATER_COLOR = 0xFF064273;
     const int MAX_MIPMAP_LVL = 6;
+    // the files of the tiles around the view, each zoom level reads another mip level of them
+    static constexpr const size_t MAX_OPEN_FILES = 16;
 
     std::string baseDir;
+
+    // most recently used first, nullptr for files that need the generic DDS loader
+    std::mutex filesMutex;
+    std::list<std::pair<std::string, std::shared_ptr<const img::DDSFile>>> openFiles;
+
+    std::shared_ptr<const img::DDSFile> openFile(const std::string &path);
 };
 
 } /* namespace maps */
@@ -0,0 +1,123 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <thread>
+#include "BandwidthScheduler.h"
+
+namespace platform {
+
+namespace {
+    // -1 if the thread has no Scope
+    thread_local int threadTraffic = -1;
+}
+
+constexpr const std::array<int, BandwidthScheduler::NUM_TRAFFIC> BandwidthScheduler::WEIGHTS;
+
+BandwidthScheduler &BandwidthScheduler::shared() {
+    static BandwidthScheduler scheduler;
+    return scheduler;
+}
+
+BandwidthScheduler::Traffic BandwidthScheduler::currentTraffic(Traffic defaultTraffic) {
+    return threadTraffic >= 0 ? (Traffic) threadTraffic : defaultTraffic;
+}
+
+void BandwidthScheduler::setLimit(int64_t bytesPerSecond) {
+    std::lock_guard<std::mutex> lock(mutex);
+    limit = std::max<int64_t>(0, bytesPerSecond);
+}
+
+int64_t BandwidthScheduler::getSpeed(Traffic traffic) const {
+    size_t index = (size_t) traffic;
+    if (limit == 0) {
+        bool othersActive = false;
+        for (size_t i = 0; i < index; i++) {
+            othersActive |= (active[i] > 0);
+        }
+        return (traffic == Traffic::BACKGROUND && othersActive) ? BACKGROUND_YIELD_SPEED : 0;
+    }
+
+    int weights = 0;
+    for (size_t i = 0; i < NUM_TRAFFIC; i++) {
+        if (active[i] > 0 || i == index) {
+            weights += WEIGHTS[i];
+        }
+    }
+    return std::max<int64_t>(1, limit * WEIGHTS[index] / weights);
+}
+
+BandwidthScheduler::Scope::Scope(Traffic traffic):
+    previous(threadTraffic)
+{
+    threadTraffic = (int) traffic;
+}
+
+BandwidthScheduler::Scope::~Scope() {
+    threadTraffic = previous;
+}
+
+BandwidthScheduler::Transfer::Transfer(Traffic defaultTraffic):
+    traffic(currentTraffic(defaultTraffic))
+{
+    auto &scheduler = shared();
+    std::lock_guard<std::mutex> lock(scheduler.mutex);
+    scheduler.active[(size_t) traffic]++;
+}
+
+BandwidthScheduler::Transfer::~Transfer() {
+    auto &scheduler = shared();
+    std::lock_guard<std::mutex> lock(scheduler.mutex);
+    scheduler.active[(size_t) traffic]--;
+}
+
+int64_t BandwidthScheduler::Transfer::getMaxSpeed() const {
+    auto &scheduler = shared();
+    std::lock_guard<std::mutex> lock(scheduler.mutex);
+    int64_t speed = scheduler.getSpeed(traffic);
+    // the downloads of a kind split its share
+    return speed / std::max(1, scheduler.active[(size_t) traffic]);
+}
+
+void BandwidthScheduler::Transfer::onReceived(size_t bytes) {
+    auto &scheduler = shared();
+    std::chrono::milliseconds wait(0);
+    {
+        std::lock_guard<std::mutex> lock(scheduler.mutex);
+        int64_t speed = scheduler.getSpeed(traffic);
+        if (speed == 0) {
+            return;
+        }
+
+        // token bucket of the traffic kind, allows bursts of up to a quarter second
+        Bucket &bucket = scheduler.buckets[(size_t) traffic];
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - bucket.refilled).count();
+        bucket.tokens = std::min(bucket.tokens + elapsed * speed, speed / 4.0);
+        bucket.refilled = now;
+        bucket.tokens -= bytes;
+        if (bucket.tokens < 0) {
+            wait = std::chrono::milliseconds(std::min<int64_t>(MAX_WAIT_MS, (int64_t) (-bucket.tokens * 1000 / speed)));
+        }
+    }
+
+    if (wait.count() > 0) {
+        std::this_thread::sleep_for(wait);
+    }
+}
+
+} /* namespace platform */
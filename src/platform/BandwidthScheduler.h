@@ -0,0 +1,100 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <mutex>
+#include <chrono>
+
+namespace platform {
+
+/*
+ * Shares the download bandwidth between the kinds of traffic so that large
+ * chart downloads and background work don't starve the map tiles. With a
+ * limit, each kind with running downloads gets a share by its weight. Without
+ * one, only background traffic is slowed down while others are downloading.
+ *
+ * Downloads on the curl easy interface report their received data and get
+ * throttled right away, others only get a maximum speed when they start.
+ */
+class BandwidthScheduler {
+public:
+    enum class Traffic {
+        INTERACTIVE,    // map tiles in view
+        CHART,          // charts being opened and API calls
+        BACKGROUND,     // prefetching and seeding
+    };
+
+    // the traffic kind of downloads started on the calling thread while it exists
+    class Scope {
+    public:
+        explicit Scope(Traffic traffic);
+        ~Scope();
+    private:
+        int previous;
+    };
+
+    // one running download
+    class Transfer {
+    public:
+        // the default applies if the thread has no Scope
+        explicit Transfer(Traffic defaultTraffic);
+        Transfer(const Transfer &) = delete;
+        Transfer &operator=(const Transfer &) = delete;
+        ~Transfer();
+
+        // for CURLOPT_MAX_RECV_SPEED_LARGE, 0 if unlimited
+        int64_t getMaxSpeed() const;
+        // blocks as long as the traffic kind is over its share
+        void onReceived(size_t bytes);
+    private:
+        Traffic traffic;
+    };
+
+    static BandwidthScheduler &shared();
+
+    // the traffic kind of the calling thread, the default if it has no Scope
+    static Traffic currentTraffic(Traffic defaultTraffic);
+
+    // bytes per second, 0 for no limit
+    void setLimit(int64_t bytesPerSecond);
+
+private:
+    static constexpr const size_t NUM_TRAFFIC = 3;
+    static constexpr const std::array<int, NUM_TRAFFIC> WEIGHTS {{ 6, 3, 1 }};
+    // what background traffic gets while the others are downloading, without a limit
+    static constexpr const int64_t BACKGROUND_YIELD_SPEED = 256 * 1024;
+    static constexpr const int MAX_WAIT_MS = 500;
+
+    struct Bucket {
+        double tokens = 0;
+        std::chrono::steady_clock::time_point refilled;
+    };
+
+    std::mutex mutex;
+    int64_t limit = 0;
+    std::array<int, NUM_TRAFFIC> active {};
+    std::array<Bucket, NUM_TRAFFIC> buckets;
+
+    // called with locked mutex
+    int64_t getSpeed(Traffic traffic) const;
+};
+
+} /* namespace platform */
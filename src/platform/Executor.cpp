@@ -0,0 +1,263 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include "Executor.h"
+#include "CrashHandler.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "src/Logger.h"
+
+namespace platform {
+
+Executor &Executor::shared() {
+    static Executor executor(0);
+    return executor;
+}
+
+Executor::Executor(size_t maxThreads) {
+    setMaxThreads(maxThreads);
+}
+
+size_t Executor::defaultThreadCount() {
+    // leave most cores to the simulator
+    size_t cores = std::thread::hardware_concurrency();
+    return std::max<size_t>(2, std::min(cores / 2, MAX_DEFAULT_THREADS));
+}
+
+void Executor::setMaxThreads(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxThreads = (count > 0) ? count : defaultThreadCount();
+}
+
+void Executor::setQueueLimit(const std::string &queue, size_t maxConcurrent) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queueLimits[queue] = std::max<size_t>(1, maxConcurrent);
+    condition.notify_all();
+}
+
+std::shared_ptr<Executor::Job> Executor::submit(const std::string &queue, Priority priority, Task task) {
+    return submitAt(queue, priority, Clock::time_point{}, std::move(task));
+}
+
+std::shared_ptr<Executor::Job> Executor::submitAt(const std::string &queue, Priority priority, Clock::time_point notBefore, Task task) {
+    auto job = std::make_shared<Job>();
+    job->executor = this;
+    job->queue = queue;
+    job->priority = priority;
+    job->notBefore = notBefore;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) {
+        job->state = Job::State::CANCELLED;
+        return job;
+    }
+
+    job->task = std::move(task);
+    pending[(size_t) priority].push_back(job);
+    updatePendingMetric();
+    if (idleWorkers == 0 && workers.size() < maxThreads) {
+        workers.emplace_back(&Executor::workLoop, this);
+    }
+    condition.notify_all();
+    return job;
+}
+
+bool Executor::canRun(const Job &job) {
+    // called with locked mutex
+    if (job.notBefore > Clock::now()) {
+        return false;
+    }
+    auto limit = queueLimits.find(job.queue);
+    if (limit != queueLimits.end() && runningByQueue[job.queue] >= limit->second) {
+        return false;
+    }
+    if (job.priority == Priority::BACKGROUND) {
+        size_t maxBackground = std::max<size_t>(1, maxThreads - 1);
+        return runningBackground < maxBackground;
+    }
+    return true;
+}
+
+std::shared_ptr<Executor::Job> Executor::takeNext() {
+    // called with locked mutex
+    for (auto &jobs: pending) {
+        for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+            if (canRun(**it)) {
+                auto job = *it;
+                jobs.erase(it);
+                updatePendingMetric();
+                return job;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void Executor::updatePendingMetric() {
+    // called with locked mutex
+    static auto &pendingJobs = Metrics::gauge("executor/pending_jobs");
+    size_t count = 0;
+    for (auto &jobs: pending) {
+        count += jobs.size();
+    }
+    pendingJobs.set(count);
+}
+
+Executor::Clock::time_point Executor::nextScheduledTime() {
+    // called with locked mutex
+    auto next = Clock::time_point::max();
+    for (auto &jobs: pending) {
+        for (auto &job: jobs) {
+            if (job->notBefore > Clock::now()) {
+                next = std::min(next, job->notBefore);
+            }
+        }
+    }
+    return next;
+}
+
+void Executor::run(std::shared_ptr<Job> job, std::unique_lock<std::mutex> &lock) {
+    // called with locked mutex, unlocks it while the job runs
+    job->state = Job::State::RUNNING;
+    job->runner = std::this_thread::get_id();
+    runningByQueue[job->queue]++;
+    if (job->priority == Priority::BACKGROUND) {
+        runningBackground++;
+    }
+    Task task = std::move(job->task);
+    job->task = nullptr;
+
+    lock.unlock();
+    try {
+        TraceSpan span(Tracer::isEnabled() ? Tracer::intern(job->queue) : nullptr);
+        task();
+    } catch (const std::exception &e) {
+        logger::error("Job in queue %s failed: %s", job->queue.c_str(), e.what());
+    }
+    task = nullptr;
+    lock.lock();
+
+    job->state = Job::State::DONE;
+    job->runner = std::thread::id();
+    runningByQueue[job->queue]--;
+    if (job->priority == Priority::BACKGROUND) {
+        runningBackground--;
+    }
+    condition.notify_all();
+}
+
+void Executor::workLoop() {
+    crash::ThreadCookie crashCookie;
+    Tracer::setThreadName("executor");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        auto job = takeNext();
+        if (job) {
+            run(job, lock);
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+        idleWorkers++;
+        auto next = nextScheduledTime();
+        if (next == Clock::time_point::max()) {
+            condition.wait(lock);
+        } else {
+            condition.wait_until(lock, next);
+        }
+        idleWorkers--;
+    }
+}
+
+void Executor::shutdown() {
+    std::vector<Task> cancelledTasks;
+    std::vector<std::thread> stoppedWorkers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (auto &jobs: pending) {
+            for (auto &job: jobs) {
+                job->state = Job::State::CANCELLED;
+                cancelledTasks.push_back(std::move(job->task));
+            }
+            jobs.clear();
+        }
+        std::swap(stoppedWorkers, workers);
+        condition.notify_all();
+    }
+
+    // the tasks' captures are released outside of the lock since they might submit jobs
+    cancelledTasks.clear();
+    for (auto &worker: stoppedWorkers) {
+        worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+}
+
+Executor::~Executor() {
+    shutdown();
+}
+
+bool Executor::Job::cancel() {
+    Task cancelledTask;
+    {
+        std::lock_guard<std::mutex> lock(executor->mutex);
+        if (state != State::QUEUED) {
+            return state == State::CANCELLED;
+        }
+        auto &jobs = executor->pending[(size_t) priority];
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                [this] (const std::shared_ptr<Job> &job) { return job.get() == this; }), jobs.end());
+        state = State::CANCELLED;
+        cancelledTask = std::move(task);
+        executor->condition.notify_all();
+    }
+    return true;
+}
+
+void Executor::Job::wait() {
+    std::unique_lock<std::mutex> lock(executor->mutex);
+    if (runner == std::this_thread::get_id()) {
+        return;
+    }
+
+    while (state == State::QUEUED || state == State::RUNNING) {
+        if (state == State::QUEUED && executor->canRun(*this)) {
+            // waiting for a busy pool from within a job could otherwise deadlock
+            auto &jobs = executor->pending[(size_t) priority];
+            auto it = std::find_if(jobs.begin(), jobs.end(),
+                    [this] (const std::shared_ptr<Job> &job) { return job.get() == this; });
+            auto self = *it;
+            jobs.erase(it);
+            executor->run(self, lock);
+        } else {
+            executor->condition.wait(lock);
+        }
+    }
+}
+
+bool Executor::Job::isDone() {
+    std::lock_guard<std::mutex> lock(executor->mutex);
+    return state == State::DONE || state == State::CANCELLED;
+}
+
+} /* namespace platform */
@@ -0,0 +1,119 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <map>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace platform {
+
+/*
+ * Bounded set of worker threads shared by the subsystems for their one-off
+ * jobs, so that AviTab doesn't start a thread per job and doesn't compete
+ * with the simulator for more cores than allowed. Workers are started on
+ * demand up to the thread limit.
+ *
+ * Jobs run by priority and then in the order they were submitted. Each job
+ * belongs to a named queue that can limit how many of its jobs run at the
+ * same time, a limit of 1 runs them one after another. Background jobs never
+ * occupy all workers, so long ones can't hold up the others. Jobs can also
+ * be scheduled for later, e.g. to renew something before it expires.
+ */
+class Executor {
+public:
+    using Task = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    enum class Priority {
+        INTERACTIVE,    // the user is waiting for the result
+        NORMAL,
+        BACKGROUND,     // caches, indexes and other optional work
+    };
+
+    class Job {
+    public:
+        // false if the job already started, then it has to be stopped by other means
+        bool cancel();
+        // runs the job on the calling thread if no worker picked it up yet.
+        // Returns immediately when called from within the job itself.
+        void wait();
+        bool isDone();
+    private:
+        friend class Executor;
+        enum class State { QUEUED, RUNNING, DONE, CANCELLED };
+
+        Executor *executor = nullptr;
+        std::string queue;
+        Priority priority = Priority::NORMAL;
+        Task task;
+        Clock::time_point notBefore {};
+        State state = State::QUEUED;
+        std::thread::id runner;
+    };
+
+    // the instance used by all subsystems
+    static Executor &shared();
+
+    explicit Executor(size_t maxThreads);
+
+    // a lower limit doesn't stop running workers, 0 selects a limit from the core count
+    void setMaxThreads(size_t count);
+    void setQueueLimit(const std::string &queue, size_t maxConcurrent);
+    std::shared_ptr<Job> submit(const std::string &queue, Priority priority, Task task);
+    // the job stays queued until the given time, waiting for it doesn't run it earlier
+    std::shared_ptr<Job> submitAt(const std::string &queue, Priority priority, Clock::time_point notBefore, Task task);
+
+    // cancels queued jobs and stops the workers once the running jobs are done,
+    // jobs submitted afterwards start new workers
+    void shutdown();
+
+    ~Executor();
+
+private:
+    static constexpr const size_t MAX_DEFAULT_THREADS = 4;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::array<std::deque<std::shared_ptr<Job>>, 3> pending;
+    std::map<std::string, size_t> queueLimits;
+    std::map<std::string, size_t> runningByQueue;
+    size_t runningBackground = 0;
+    size_t maxThreads = 1;
+    size_t idleWorkers = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    static size_t defaultThreadCount();
+    bool canRun(const Job &job);
+    std::shared_ptr<Job> takeNext();
+    void updatePendingMetric();
+    Clock::time_point nextScheduledTime();
+    void run(std::shared_ptr<Job> job, std::unique_lock<std::mutex> &lock);
+    void workLoop();
+};
+
+} /* namespace platform */
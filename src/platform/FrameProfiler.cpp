@@ -0,0 +1,88 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include "FrameProfiler.h"
+#include "Metrics.h"
+#include "Tracer.h"
+
+namespace platform {
+
+std::array<FrameProfiler::Samples, FrameProfiler::NUM_STAGES> FrameProfiler::stages;
+
+const char *FrameProfiler::getStageName(Stage stage) {
+    switch (stage) {
+    case LVGL:              return "lvgl";
+    case GUI_TASKS:         return "tasks";
+    case BLIT:              return "blit";
+    case STITCHER:          return "stitcher";
+    case OVERLAYS:          return "overlays";
+    case SIM_DRAW:          return "sim_draw";
+    default:                return "?";
+    }
+}
+
+void FrameProfiler::record(Stage stage, float ms) {
+    // the window only covers the last frames, the histograms cover the whole session
+    static auto histograms = [] {
+        std::array<Histogram *, NUM_STAGES> res;
+        for (int i = 0; i < NUM_STAGES; i++) {
+            res[i] = &Metrics::histogram(std::string("frame_us/") + getStageName(static_cast<Stage>(i)));
+        }
+        return res;
+    }();
+    histograms[stage]->record(std::lround(ms * 1000));
+
+    Samples &s = stages[stage];
+    uint32_t slot = s.next.fetch_add(1, std::memory_order_relaxed) % WINDOW_SIZE;
+    s.ms[slot].store(ms, std::memory_order_relaxed);
+}
+
+float FrameProfiler::getPercentile(Stage stage, float percentile) {
+    const Samples &s = stages[stage];
+    size_t count = std::min<size_t>(s.next.load(std::memory_order_relaxed), WINDOW_SIZE);
+    if (count == 0) {
+        return 0;
+    }
+
+    // a sample might be replaced while copying, that's fine for statistics
+    std::array<float, WINDOW_SIZE> sorted;
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = s.ms[i].load(std::memory_order_relaxed);
+    }
+    size_t rank = std::lround(std::clamp(percentile, 0.0f, 100.0f) / 100 * (count - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + count);
+    return sorted[rank];
+}
+
+ScopedFrameTiming::ScopedFrameTiming(FrameProfiler::Stage stage):
+    stage(stage),
+    startAt(measureTime())
+{
+}
+
+ScopedFrameTiming::~ScopedFrameTiming() {
+    int64_t micros = getElapsedMicros(startAt);
+    FrameProfiler::record(stage, micros / 1000.0f);
+    if (Tracer::isEnabled()) {
+        int64_t now = Tracer::nowMicros();
+        Tracer::record(FrameProfiler::getStageName(stage), now - micros, now);
+    }
+}
+
+} /* namespace platform */
@@ -0,0 +1,67 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Platform.h"
+
+namespace platform {
+
+/*
+ * Time statistics of the stages that make up a tablet frame. Any thread can
+ * record without locking: every stage keeps a ring of its most recent
+ * durations, from which the percentiles are taken.
+ */
+class FrameProfiler {
+public:
+    // The stages nest: LVGL covers everything in LVGL tasks, e.g. BLIT and the
+    // apps' STITCHER updates, which cover their OVERLAYS. SIM_DRAW is the upload
+    // and drawing of the tablet in the simulator's draw callback.
+    enum Stage { LVGL, GUI_TASKS, BLIT, STITCHER, OVERLAYS, SIM_DRAW, NUM_STAGES };
+
+    static const char *getStageName(Stage stage);
+
+    static void record(Stage stage, float ms);
+
+    // percentile in [0, 100] of the recorded window, 0 if nothing was recorded yet
+    static float getPercentile(Stage stage, float percentile);
+
+private:
+    static constexpr const size_t WINDOW_SIZE = 128;
+
+    struct Samples {
+        std::array<std::atomic<float>, WINDOW_SIZE> ms {};
+        std::atomic<uint32_t> next {0};
+    };
+    static std::array<Samples, NUM_STAGES> stages;
+};
+
+// records the time until the end of the enclosing scope
+class ScopedFrameTiming {
+public:
+    explicit ScopedFrameTiming(FrameProfiler::Stage stage);
+    ~ScopedFrameTiming();
+private:
+    FrameProfiler::Stage stage;
+    decltype(measureTime()) startAt;
+};
+
+} /* namespace platform */
@@ -0,0 +1,132 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#include <stdexcept>
+#include <sstream>
+#include "MappedFile.h"
+#include "Platform.h"
+
+namespace platform {
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &utf8Path) {
+    std::wstring widePath = fs::u8path(utf8Path).wstring();
+    HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Couldn't open file: " + utf8Path);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        readFallback(utf8Path);
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        readFallback(utf8Path);
+        return;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    base = static_cast<const char *>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    mapped = true;
+}
+
+MappedFile::~MappedFile() {
+    if (mapped) {
+        UnmapViewOfFile(base);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+    }
+}
+#else
+MappedFile::MappedFile(const std::string &utf8Path) {
+    int fd = open(utf8Path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Couldn't open file: " + utf8Path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        readFallback(utf8Path);
+        return;
+    }
+
+    void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        readFallback(utf8Path);
+        return;
+    }
+
+    // the parsers walk the data front to back exactly once
+    madvise(view, st.st_size, MADV_SEQUENTIAL);
+
+    base = static_cast<const char *>(view);
+    length = static_cast<size_t>(st.st_size);
+    mapped = true;
+}
+
+MappedFile::~MappedFile() {
+    if (mapped) {
+        munmap(const_cast<char *>(base), length);
+    }
+}
+#endif
+
+void MappedFile::readFallback(const std::string &utf8Path) {
+    fs::ifstream stream(fs::u8path(utf8Path), std::ios::in | std::ios::binary);
+    if (!stream) {
+        throw std::runtime_error("Couldn't open file: " + utf8Path);
+    }
+    std::ostringstream content;
+    content << stream.rdbuf();
+    fallback = content.str();
+    base = fallback.data();
+    length = fallback.size();
+}
+
+const char *MappedFile::data() const {
+    return base;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+} /* namespace platform */
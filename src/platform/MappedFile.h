@@ -0,0 +1,50 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace platform {
+
+// Read-only view of a whole file, memory-mapped where the OS allows it.
+// Falls back to reading the file into memory, e.g. for empty files.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &utf8Path);
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+    ~MappedFile();
+
+    const char *data() const;
+    size_t size() const;
+
+private:
+    const char *base = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::string fallback;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+
+    void readFallback(const std::string &utf8Path);
+};
+
+} /* namespace platform */
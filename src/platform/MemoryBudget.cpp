@@ -0,0 +1,135 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <map>
+#include "MemoryBudget.h"
+#include "Platform.h"
+#include "Metrics.h"
+#include "src/Logger.h"
+
+namespace platform {
+
+MemoryBudget &MemoryBudget::shared() {
+    static MemoryBudget instance;
+    return instance;
+}
+
+MemoryBudget::Registration MemoryBudget::addConsumer(const std::string &name, Priority priority, UsageFunc usage, ShrinkFunc shrink) {
+    std::lock_guard<std::mutex> lock(consumersMutex);
+    uint64_t id = nextId++;
+    consumers.push_back(Consumer {id, name, priority, usage, shrink});
+    std::stable_sort(consumers.begin(), consumers.end(), [] (const Consumer &a, const Consumer &b) {
+        return a.priority < b.priority;
+    });
+    return Registration(this, [id] (MemoryBudget *budget) { budget->removeConsumer(id); });
+}
+
+void MemoryBudget::removeConsumer(uint64_t id) {
+    std::lock_guard<std::mutex> lock(consumersMutex);
+    consumers.erase(std::remove_if(consumers.begin(), consumers.end(), [id] (const Consumer &c) {
+        return c.id == id;
+    }), consumers.end());
+}
+
+void MemoryBudget::setBudget(size_t bytes) {
+    budget = bytes;
+}
+
+size_t MemoryBudget::getBudget() {
+    return budget;
+}
+
+void MemoryBudget::poll() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastCheck < CHECK_INTERVAL || (checkJob && !checkJob->isDone())) {
+        return;
+    }
+    lastCheck = now;
+    checkJob = Executor::shared().submit("memory", Executor::Priority::BACKGROUND, [this] { check(); });
+}
+
+void MemoryBudget::check() {
+    // consumers of the same kind, e.g. all documents, share their gauge
+    std::map<std::string, size_t> byName;
+    size_t total = 0;
+    for (auto &usage: getUsage()) {
+        byName[usage.name] += usage.bytes;
+        total += usage.bytes;
+    }
+    for (auto &it: byName) {
+        Metrics::gauge("memory/" + it.first + "_bytes").set(it.second);
+    }
+    static auto &totalBytes = Metrics::gauge("memory/accounted_bytes");
+    totalBytes.set(total);
+
+    size_t excess = 0;
+    if (budget > 0 && total > budget) {
+        excess = total - budget;
+    }
+    size_t available = getAvailableMemory();
+    if (available > 0 && available < LOW_MEMORY_BYTES) {
+        excess = std::max(excess, LOW_MEMORY_BYTES - available);
+    }
+
+    if (excess > 0) {
+        size_t released = relieve(excess);
+        logger::info("Memory: %zu MB accounted, %zu MB available, released %zu MB",
+                total >> 20, available >> 20, released >> 20);
+    }
+}
+
+size_t MemoryBudget::relieve(size_t bytes) {
+    static auto &releasedBytes = Metrics::counter("memory/released_bytes");
+
+    std::lock_guard<std::mutex> lock(consumersMutex);
+    size_t released = 0;
+    for (auto &consumer: consumers) {
+        if (released >= bytes) {
+            break;
+        }
+        if (consumer.priority == Priority::FIXED || !consumer.shrink) {
+            continue;
+        }
+        size_t freed = consumer.shrink(bytes - released);
+        if (freed > 0) {
+            logger::verbose("Memory: %s released %zu KB", consumer.name.c_str(), freed >> 10);
+        }
+        released += freed;
+    }
+    releasedBytes.add(released);
+    return released;
+}
+
+std::vector<MemoryBudget::Usage> MemoryBudget::getUsage() {
+    std::lock_guard<std::mutex> lock(consumersMutex);
+    std::vector<Usage> result;
+    for (auto &consumer: consumers) {
+        result.push_back(Usage {consumer.name, consumer.priority, consumer.usage()});
+    }
+    return result;
+}
+
+size_t MemoryBudget::getTotalUsage() {
+    size_t total = 0;
+    for (auto &usage: getUsage()) {
+        total += usage.bytes;
+    }
+    return total;
+}
+
+} /* namespace platform */
@@ -0,0 +1,108 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include "Executor.h"
+
+namespace platform {
+
+/*
+ * Accounting of the memory held by AviTab's subsystems and a global budget for it.
+ * Subsystems register as consumers that report their usage and, if they can,
+ * release memory on request. When the total exceeds the budget or the system
+ * runs low on memory, the consumers are shrunk in the order of their priority
+ * so that the cheapest data to rebuild goes first.
+ */
+class MemoryBudget {
+public:
+    // shrunk in this order, FIXED consumers are only accounted
+    enum class Priority {
+        DECODED_IMAGES,
+        DOCUMENTS,
+        NAV_DATA,
+        FIXED,
+    };
+
+    using UsageFunc = std::function<size_t()>;
+    // asked to release at least the given bytes, returns how many it released
+    using ShrinkFunc = std::function<size_t(size_t)>;
+    // the consumer is removed when the registration is dropped, the functions aren't
+    // called anymore after that. Drop it before the data the functions use.
+    using Registration = std::shared_ptr<void>;
+
+    struct Usage {
+        std::string name;
+        Priority priority;
+        size_t bytes;
+    };
+
+    static MemoryBudget &shared();
+
+    Registration addConsumer(const std::string &name, Priority priority, UsageFunc usage, ShrinkFunc shrink = nullptr);
+
+    // 0 means no budget, the consumers are then only shrunk when the system runs low
+    void setBudget(size_t bytes);
+    size_t getBudget();
+
+    // To be called regularly, e.g. every frame. Checks the usage every few seconds,
+    // on a background thread so that the caller doesn't wait for the consumers.
+    void poll();
+
+    // releases the given bytes right away, e.g. when the simulator reports low memory
+    size_t relieve(size_t bytes);
+
+    std::vector<Usage> getUsage();
+    size_t getTotalUsage();
+
+private:
+    static constexpr const std::chrono::seconds CHECK_INTERVAL { 2 };
+    // below this much free physical memory, the caches give back the difference
+    static constexpr const size_t LOW_MEMORY_BYTES = 512 * 1024 * 1024;
+
+    struct Consumer {
+        uint64_t id;
+        std::string name;
+        Priority priority;
+        UsageFunc usage;
+        ShrinkFunc shrink;
+    };
+
+    // held while the consumers' functions run, so that they can't be removed meanwhile
+    std::mutex consumersMutex;
+    std::vector<Consumer> consumers;
+    uint64_t nextId = 1;
+    std::atomic<size_t> budget { 0 };
+
+    // poll's state, only used by the thread calling it
+    std::chrono::steady_clock::time_point lastCheck;
+    std::shared_ptr<Executor::Job> checkJob;
+
+    MemoryBudget() = default;
+    void removeConsumer(uint64_t id);
+    void check();
+};
+
+} /* namespace platform */
@@ -0,0 +1,218 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <cstdio>
+#include "Metrics.h"
+#include "src/Logger.h"
+
+namespace platform {
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    std::atomic<size_t> generation {0};
+};
+
+Registry &registry() {
+    static Registry instance;
+    return instance;
+}
+
+template<typename T>
+T &lookup(std::map<std::string, std::unique_ptr<T>> &metrics, const std::string &name) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto &metric = metrics[name];
+    if (!metric) {
+        metric = std::make_unique<T>();
+        reg.generation++;
+    }
+    return *metric;
+}
+
+size_t shardIndex() {
+    static std::atomic<size_t> nextShard {0};
+    thread_local size_t shard = nextShard++;
+    return shard;
+}
+
+}
+
+void Counter::add(int64_t n) {
+    shards[shardIndex() % SHARDS].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+int64_t Counter::value() const {
+    int64_t total = 0;
+    for (auto &shard: shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Gauge::set(int64_t v) {
+    current.store(v, std::memory_order_relaxed);
+}
+
+void Gauge::add(int64_t n) {
+    current.fetch_add(n, std::memory_order_relaxed);
+}
+
+int64_t Gauge::value() const {
+    return current.load(std::memory_order_relaxed);
+}
+
+int Histogram::bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (int) value;
+    }
+    int exponent = 63;
+    while (!(value >> exponent)) {
+        exponent--;
+    }
+    int shift = exponent - SUB_BUCKET_BITS;
+    int sub = (value >> shift) & (SUB_BUCKETS - 1);
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+int64_t Histogram::bucketValue(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    // middle of the bucket
+    int shift = bucket / SUB_BUCKETS - 1;
+    int sub = bucket % SUB_BUCKETS;
+    uint64_t lower = (uint64_t) (SUB_BUCKETS + sub) << shift;
+    return (int64_t) (lower + ((uint64_t) 1 << shift) / 2);
+}
+
+void Histogram::record(int64_t value) {
+    if (value < 0) {
+        value = 0;
+    }
+    buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    int64_t prevMax = max.load(std::memory_order_relaxed);
+    while (value > prevMax && !max.compare_exchange_weak(prevMax, value, std::memory_order_relaxed)) {
+    }
+}
+
+Histogram::Summary Histogram::summarize() const {
+    // values recorded while copying might be counted partially, that's fine for statistics
+    std::array<uint64_t, NUM_BUCKETS> counts;
+    uint64_t total = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    Summary summary;
+    summary.count = total;
+    summary.max = max.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return summary;
+    }
+    summary.mean = (double) sum.load(std::memory_order_relaxed) / total;
+
+    auto percentile = [&counts, total, &summary] (double p) {
+        uint64_t rank = (uint64_t) (p / 100 * (total - 1));
+        uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen > rank) {
+                return std::min(bucketValue(i), summary.max);
+            }
+        }
+        return summary.max;
+    };
+    summary.p50 = percentile(50);
+    summary.p95 = percentile(95);
+    summary.p99 = percentile(99);
+    return summary;
+}
+
+Counter &Metrics::counter(const std::string &name) {
+    return lookup(registry().counters, name);
+}
+
+Gauge &Metrics::gauge(const std::string &name) {
+    return lookup(registry().gauges, name);
+}
+
+Histogram &Metrics::histogram(const std::string &name) {
+    return lookup(registry().histograms, name);
+}
+
+Metrics::Snapshot Metrics::snapshot() {
+    Registry &reg = registry();
+    Snapshot result;
+
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto &it: reg.counters) {
+        result.counters.emplace_back(it.first, it.second->value());
+    }
+    for (auto &it: reg.gauges) {
+        result.gauges.emplace_back(it.first, it.second->value());
+    }
+    for (auto &it: reg.histograms) {
+        result.histograms.emplace_back(it.first, it.second->summarize());
+    }
+    return result;
+}
+
+size_t Metrics::getGeneration() {
+    return registry().generation;
+}
+
+std::string Metrics::format(const Snapshot &snapshot) {
+    std::ostringstream out;
+    for (auto &it: snapshot.counters) {
+        out << it.first << ": " << it.second << "\n";
+    }
+    for (auto &it: snapshot.gauges) {
+        out << it.first << ": " << it.second << "\n";
+    }
+    for (auto &it: snapshot.histograms) {
+        auto &h = it.second;
+        char line[160];
+        std::snprintf(line, sizeof(line), "%s: n=%llu mean=%.1f p50=%lld p95=%lld p99=%lld max=%lld\n",
+                it.first.c_str(), (unsigned long long) h.count, h.mean,
+                (long long) h.p50, (long long) h.p95, (long long) h.p99, (long long) h.max);
+        out << line;
+    }
+    return out.str();
+}
+
+void Metrics::logSnapshot() {
+    std::istringstream lines(format(snapshot()));
+    std::string line;
+    while (std::getline(lines, line)) {
+        logger::info("metrics %s", line.c_str());
+    }
+}
+
+} /* namespace platform */
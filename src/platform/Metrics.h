@@ -0,0 +1,108 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace platform {
+
+// Any thread can add without locking, each thread mostly hits its own shard
+class Counter {
+public:
+    void add(int64_t n = 1);
+    int64_t value() const;
+private:
+    static constexpr const size_t SHARDS = 16;
+    struct alignas(64) Shard {
+        std::atomic<int64_t> value {0};
+    };
+    std::array<Shard, SHARDS> shards;
+};
+
+class Gauge {
+public:
+    void set(int64_t v);
+    void add(int64_t n);
+    int64_t value() const;
+private:
+    std::atomic<int64_t> current {0};
+};
+
+// HDR-style histogram of non-negative values: exact up to SUB_BUCKETS, above
+// that SUB_BUCKETS buckets per power of two, i.e. at most 12.5% off
+class Histogram {
+public:
+    struct Summary {
+        uint64_t count = 0;
+        double mean = 0;
+        int64_t p50 = 0, p95 = 0, p99 = 0, max = 0;
+    };
+
+    void record(int64_t value);
+    Summary summarize() const;
+private:
+    static constexpr const int SUB_BUCKET_BITS = 3;
+    static constexpr const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets {};
+    std::atomic<uint64_t> count {0};
+    std::atomic<int64_t> sum {0};
+    std::atomic<int64_t> max {0};
+
+    static int bucketOf(uint64_t value);
+    static int64_t bucketValue(int bucket);
+};
+
+/*
+ * Registry of named metrics. They are created on first use and live until the
+ * process ends, so call sites look them up once and keep the reference:
+ *
+ *   static auto &hits = platform::Metrics::counter("tiles/memory_hits");
+ *   hits.add();
+ *
+ * By convention, names end in the unit where there is one, e.g. _bytes or _us.
+ */
+class Metrics {
+public:
+    static Counter &counter(const std::string &name);
+    static Gauge &gauge(const std::string &name);
+    static Histogram &histogram(const std::string &name);
+
+    // everything registered so far, each kind sorted by name
+    struct Snapshot {
+        std::vector<std::pair<std::string, int64_t>> counters;
+        std::vector<std::pair<std::string, int64_t>> gauges;
+        std::vector<std::pair<std::string, Histogram::Summary>> histograms;
+    };
+    static Snapshot snapshot();
+    // increases whenever a metric is registered
+    static size_t getGeneration();
+
+    // one line per metric
+    static std::string format(const Snapshot &snapshot);
+    static void logSnapshot();
+};
+
+} /* namespace platform */
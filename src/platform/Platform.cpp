@@ -19,10 +19,14 @@
 #   define WIN32_LEAN_AND_MEAN
 #   include <windows.h>
 #   include <shellapi.h>
+#   include <process.h>
 #else
 #   include <unistd.h>
 #   include <uuid/uuid.h>
 #endif
+#ifdef __APPLE__
+#   include <mach/mach.h>
+#endif
 
 #include <locale>
 #include <codecvt>
@@ -36,7 +40,11 @@
 #include <regex>
 #include <fstream>
 #include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <atomic>
 #include "Platform.h"
+#include "StatCache.h"
 #include "src/Logger.h"
 
 /*
@@ -88,6 +96,19 @@ int getElapsedMillis(int64_t startAt)  {
     return elapsed;
 }
 
+int64_t getElapsedMicros(int64_t startAt)  {
+    LARGE_INTEGER endAt, frq;
+    QueryPerformanceCounter(&endAt);
+    QueryPerformanceFrequency(&frq);
+
+    int64_t elapsed = endAt.QuadPart - startAt;
+
+    elapsed *= 1000000;
+    elapsed /= frq.QuadPart;
+
+    return elapsed;
+}
+
 #else
 std::chrono::time_point<std::chrono::steady_clock> measureTime() {
     return std::chrono::steady_clock::now();
@@ -97,6 +118,11 @@ int getElapsedMillis(std::chrono::time_point<std::chrono::steady_clock> startAt)
     auto endAt = measureTime();
     return std::chrono::duration_cast<std::chrono::milliseconds>(endAt - startAt).count();
 }
+
+int64_t getElapsedMicros(std::chrono::time_point<std::chrono::steady_clock> startAt) {
+    auto endAt = measureTime();
+    return std::chrono::duration_cast<std::chrono::microseconds>(endAt - startAt).count();
+}
 #endif
 
 constexpr size_t getMaxPathLen() {
@@ -144,7 +170,14 @@ std::string UTF8ToACP(const std::string& utf8) {
 
 std::vector<DirEntry> readDirectory(const std::string& utf8Path) {
     std::vector<DirEntry> entries;
+    readDirectory(utf8Path, [&entries] (const DirEntry &entry) {
+        entries.push_back(entry);
+        return true;
+    });
+    return entries;
+}
 
+void readDirectory(const std::string& utf8Path, const std::function<bool(const DirEntry &)> &onEntry) {
 #ifdef _WIN32
     // this fragment deals with a notional filesystem root directory which allows
     // traversal to other drives
@@ -157,30 +190,84 @@ std::vector<DirEntry> readDirectory(const std::string& utf8Path) {
                     DirEntry entry;
                     entry.utf8Name = drive;
                     entry.isDirectory = true;
-                    entries.push_back(entry);
+                    if (!onEntry(entry)) {
+                        return;
+                    }
                 }
             }
             ldbitmap >>= 1;
             ++drive[0];
         }
-        return entries; // return list of drives only, no further enumeration
+        return; // list of drives only, no further enumeration
     }
-#endif
-    auto path = fs::u8path(utf8Path);
-    for (auto &e: fs::directory_iterator(path)) {
-        std::string name = e.path().filename().string();
 
-        if (name.empty() || name[0] == '.') {
+    // the native API returns the attributes with the names, fetched in large batches
+    std::string search = utf8Path;
+    if (!search.empty() && search.back() != '\\' && search.back() != '/') {
+        search += '\\';
+    }
+    search += '*';
+    wchar_t pattern[AVITAB_PATH_LEN_MAX];
+    if (MultiByteToWideChar(CP_UTF8, 0, search.c_str(), -1, pattern, AVITAB_PATH_LEN_MAX) == 0) {
+        throw std::runtime_error("Invalid path: " + utf8Path);
+    }
+
+    WIN32_FIND_DATAW data;
+    HANDLE handle = FindFirstFileExW(pattern, FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Couldn't read directory " + utf8Path);
+    }
+    std::unique_ptr<void, decltype(&FindClose)> closer(handle, &FindClose);
+
+    do {
+        char name[AVITAB_PATH_LEN_MAX];
+        if (WideCharToMultiByte(CP_UTF8, 0, data.cFileName, -1, name, sizeof(name), nullptr, nullptr) == 0) {
+            continue;
+        }
+        if (name[0] == '\0' || name[0] == '.') {
             continue;
         }
 
         DirEntry entry;
         entry.utf8Name = name;
-        entry.isDirectory = e.is_directory();
-        entries.push_back(entry);
+        entry.isDirectory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        if (!onEntry(entry)) {
+            return;
+        }
+    } while (FindNextFileW(handle, &data));
+#else
+    // readdir fetches the entries in large batches and mostly knows their type
+    DIR *dir = opendir(utf8Path.c_str());
+    if (!dir) {
+        throw std::runtime_error("Couldn't read directory " + utf8Path);
     }
+    struct DirCloser {
+        void operator()(DIR *d) const { closedir(d); }
+    };
+    std::unique_ptr<DIR, DirCloser> closer(dir);
 
-    return entries;
+    while (dirent *e = readdir(dir)) {
+        if (e->d_name[0] == '\0' || e->d_name[0] == '.') {
+            continue;
+        }
+
+        DirEntry entry;
+        entry.utf8Name = e->d_name;
+        if (e->d_type == DT_DIR) {
+            entry.isDirectory = true;
+        } else if (e->d_type == DT_UNKNOWN || e->d_type == DT_LNK) {
+            // links count as what they point to
+            struct stat st;
+            std::string fullPath = utf8Path + "/" + e->d_name;
+            entry.isDirectory = (stat(fullPath.c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+        } else {
+            entry.isDirectory = false;
+        }
+        if (!onEntry(entry)) {
+            return;
+        }
+    }
+#endif
 }
 
 std::string realPath(const std::string& utf8Path) {
@@ -226,6 +313,7 @@ void mkdir(const std::string& utf8Path) {
     auto path = fs::u8path(utf8Path);
     try {
         fs::create_directory(path);
+        StatCache::shared().noteCreated(utf8Path, true);
     } catch (const std::exception &e) {
         LOG_ERROR("%s", e.what());
     }
@@ -235,6 +323,10 @@ void mkpath(const std::string& utf8Path) {
     auto path = fs::u8path(utf8Path);
     try {
         fs::create_directories(path);
+        // the parents might have been created as well
+        for (size_t end = utf8Path.size(); end != std::string::npos && end > 0; end = utf8Path.find_last_of("/\\", end - 1)) {
+            StatCache::shared().noteCreated(utf8Path.substr(0, end), true);
+        }
     } catch (const std::exception &e) {
         LOG_ERROR("%s", e.what());
     }
@@ -243,6 +335,43 @@ void mkpath(const std::string& utf8Path) {
 void removeFile(const std::string& utf8Path) {
     auto path = fs::u8path(utf8Path);
     fs::remove(path);
+    StatCache::shared().noteRemoved(utf8Path);
+}
+
+std::string makeTempPath(const std::string& utf8Path) {
+    // the pid keeps other instances apart, the counter other threads
+    static std::atomic<unsigned> counter{0};
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = getpid();
+#endif
+    return utf8Path + ".tmp." + std::to_string(pid) + "." + std::to_string(counter++);
+}
+
+void writeFileAtomically(const std::string& utf8Path, const std::function<void(std::ostream &out)> &write) {
+    auto tmpPath = fs::u8path(makeTempPath(utf8Path));
+    try {
+        {
+            fs::ofstream stream(tmpPath, std::ios::out | std::ios::binary);
+            write(stream);
+            stream.close();
+            if (!stream) {
+                throw std::runtime_error("Write error");
+            }
+        }
+        fs::rename(tmpPath, fs::u8path(utf8Path));
+    } catch (...) {
+        std::error_code ec;
+        fs::remove(tmpPath, ec);
+        throw;
+    }
+}
+
+void writeFileAtomically(const std::string& utf8Path, const void *data, size_t size) {
+    writeFileAtomically(utf8Path, [data, size] (std::ostream &out) {
+        out.write(reinterpret_cast<const char *>(data), size);
+    });
 }
 
 std::string getLocalTime(const std::string &format) {
@@ -350,6 +479,35 @@ std::string getMachineID() {
 #endif
 }
 
+size_t getAvailableMemory() {
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) {
+        return 0;
+    }
+    return status.ullAvailPhys;
+#elif defined(__APPLE__)
+    vm_statistics64_data_t stats;
+    mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+    if (host_statistics64(mach_host_self(), HOST_VM_INFO64, (host_info64_t) &stats, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return (size_t) (stats.free_count + stats.inactive_count) * vm_page_size;
+#else
+    std::ifstream memInfo("/proc/meminfo");
+    std::string key;
+    size_t kiloBytes;
+    std::string unit;
+    while (memInfo >> key >> kiloBytes >> unit) {
+        if (key == "MemAvailable:") {
+            return kiloBytes * 1024;
+        }
+    }
+    return 0;
+#endif
+}
+
 void openBrowser(const std::string& url) {
     logger::info("Opening browser: %s", url.c_str());
 #ifdef _WIN32
@@ -23,6 +23,7 @@
 #include <cstdarg>
 #include <chrono>
 #include <fstream>
+#include <functional>
 
 // OS X does not support std::filesystem before Catalina
 
@@ -78,9 +79,11 @@ Platform getPlatform();
 #ifdef _WIN32
 int64_t measureTime();
 int getElapsedMillis(int64_t startAt);
+int64_t getElapsedMicros(int64_t startAt);
 #else
 std::chrono::time_point<std::chrono::steady_clock> measureTime();
 int getElapsedMillis(std::chrono::time_point<std::chrono::steady_clock> startAt);
+int64_t getElapsedMicros(std::chrono::time_point<std::chrono::steady_clock> startAt);
 #endif
 
 constexpr size_t getMaxPathLen();
@@ -96,6 +99,8 @@ constexpr const char FS_SEP = '/';
 
 std::string getProgramPath();
 std::vector<DirEntry> readDirectory(const std::string &utf8Path);
+// calls onEntry for each entry as it is read, stops early when it returns false
+void readDirectory(const std::string &utf8Path, const std::function<bool(const DirEntry &)> &onEntry);
 std::string parentPath(const std::string &utf8Path);
 std::string realPath(const std::string &utf8Path);
 std::string getFileNameFromPath(const std::string &utf8Path);
@@ -104,6 +109,12 @@ bool fileExists(const std::string &utf8Path);
 void mkdir(const std::string &utf8Path);
 void mkpath(const std::string &utf8Path);
 void removeFile(const std::string &utf8Path);
+// a name next to utf8Path that no other thread or process writes to at the same time
+std::string makeTempPath(const std::string &utf8Path);
+// writes into a temporary file first and renames it over utf8Path, so readers never see a
+// partial file. Throws on failure, the temporary file is removed then
+void writeFileAtomically(const std::string &utf8Path, const std::function<void(std::ostream &out)> &write);
+void writeFileAtomically(const std::string &utf8Path, const void *data, size_t size);
 
 std::string getLocalTime(const std::string &format);
 std::string getClipboardContent();
@@ -116,6 +127,8 @@ std::string lower(const std::string &in);
 std::string upper(const std::string &in);
 
 std::string getMachineID();
+// physical memory that can still be used without swapping, 0 if unknown
+size_t getAvailableMemory();
 
 void openBrowser(const std::string &url);
 
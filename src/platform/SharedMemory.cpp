@@ -0,0 +1,100 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#include <stdexcept>
+#include "SharedMemory.h"
+#include "Platform.h"
+
+namespace platform {
+
+#ifdef _WIN32
+SharedMemory::SharedMemory(const std::string &name, size_t size) {
+    // the session namespace doesn't need extra privileges, unlike Global
+    std::wstring wideName = fs::u8path("Local\\" + name).wstring();
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                        0, (DWORD) size, wideName.c_str());
+    if (!mapping) {
+        throw std::runtime_error("Couldn't create shared memory " + name);
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!view) {
+        CloseHandle(mapping);
+        throw std::runtime_error("Couldn't map shared memory " + name);
+    }
+
+    mappingHandle = mapping;
+    base = view;
+    length = size;
+}
+
+SharedMemory::~SharedMemory() {
+    UnmapViewOfFile(base);
+    CloseHandle(mappingHandle);
+}
+#else
+SharedMemory::SharedMemory(const std::string &name, size_t size):
+    shmName("/" + name)
+{
+    int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Couldn't create shared memory " + name);
+    }
+
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(shmName.c_str());
+        throw std::runtime_error("Couldn't size shared memory " + name);
+    }
+
+    void *view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        shm_unlink(shmName.c_str());
+        throw std::runtime_error("Couldn't map shared memory " + name);
+    }
+
+    base = view;
+    length = size;
+}
+
+SharedMemory::~SharedMemory() {
+    munmap(base, length);
+    // readers keep their mappings, new ones won't find a stale region
+    shm_unlink(shmName.c_str());
+}
+#endif
+
+void *SharedMemory::data() {
+    return base;
+}
+
+size_t SharedMemory::size() const {
+    return length;
+}
+
+} /* namespace platform */
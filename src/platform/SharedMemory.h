@@ -0,0 +1,48 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace platform {
+
+// Named memory that other processes on this machine can map, e.g. to read
+// state that AviTab publishes. Created zero-filled if it doesn't exist yet.
+// The name is a plain identifier, the prefix each OS wants is added here.
+class SharedMemory {
+public:
+    SharedMemory(const std::string &name, size_t size);
+    SharedMemory(const SharedMemory &other) = delete;
+    SharedMemory &operator=(const SharedMemory &other) = delete;
+    ~SharedMemory();
+
+    void *data();
+    size_t size() const;
+
+private:
+    void *base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *mappingHandle = nullptr;
+#else
+    std::string shmName;
+#endif
+};
+
+} /* namespace platform */
@@ -0,0 +1,121 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <algorithm>
+#include "StartupTasks.h"
+#include "src/Logger.h"
+
+namespace platform {
+
+void StartupTasks::add(const std::string &name, Task task, const std::vector<std::string> &dependencies) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started) {
+        throw std::logic_error("Startup tasks already started");
+    }
+
+    size_t id = nodes.size();
+    Node node;
+    node.name = name;
+    node.task = std::move(task);
+    for (auto &dep: dependencies) {
+        auto it = std::find_if(nodes.begin(), nodes.end(), [&dep] (const Node &n) { return n.name == dep; });
+        if (it == nodes.end()) {
+            throw std::invalid_argument("Unknown startup task " + dep);
+        }
+        it->dependents.push_back(id);
+        node.pendingDependencies++;
+    }
+    nodes.push_back(std::move(node));
+}
+
+void StartupTasks::start(size_t maxConcurrent) {
+    std::lock_guard<std::mutex> lock(mutex);
+    started = true;
+    startedAt = measureTime();
+    Executor::shared().setQueueLimit(EXECUTOR_QUEUE, maxConcurrent);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].pendingDependencies == 0) {
+            submit(i);
+        }
+    }
+}
+
+bool StartupTasks::isDone() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finished == nodes.size();
+}
+
+void StartupTasks::wait() {
+    // a task's dependents are submitted before its job is done, so this also waits for them
+    std::unique_lock<std::mutex> lock(mutex);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        auto job = jobs[i];
+        lock.unlock();
+        job->wait();
+        lock.lock();
+    }
+}
+
+void StartupTasks::submit(size_t id) {
+    // called with locked mutex
+    jobs.push_back(Executor::shared().submit(EXECUTOR_QUEUE, Executor::Priority::INTERACTIVE, [this, id] { run(id); }));
+}
+
+void StartupTasks::run(size_t id) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Node &node = nodes[id];
+    Task task = std::move(node.task);
+    node.task = nullptr;
+    lock.unlock();
+
+    auto taskStart = measureTime();
+    try {
+        task();
+    } catch (const std::exception &e) {
+        logger::error("Startup task %s failed: %s", node.name.c_str(), e.what());
+    }
+    int64_t micros = getElapsedMicros(taskStart);
+    task = nullptr;
+    lock.lock();
+
+    node.micros = micros;
+    for (size_t dependent: node.dependents) {
+        if (--nodes[dependent].pendingDependencies == 0) {
+            submit(dependent);
+        }
+    }
+    if (++finished == nodes.size()) {
+        logTimings();
+    }
+}
+
+void StartupTasks::logTimings() {
+    int64_t total = 0;
+    for (auto &node: nodes) {
+        logger::info("Startup task %s took %.1f ms", node.name.c_str(), node.micros / 1000.0);
+        total += node.micros;
+    }
+    logger::info("Startup tasks took %.1f ms, %.1f ms if run one after another",
+            getElapsedMicros(startedAt) / 1000.0, total / 1000.0);
+}
+
+StartupTasks::~StartupTasks() {
+    wait();
+}
+
+} /* namespace platform */
@@ -0,0 +1,74 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include "Platform.h"
+#include "Executor.h"
+
+namespace platform {
+
+/*
+ * Runs independent initialisation steps on a few threads of the shared
+ * executor, the waiting thread helps with those not started yet. Every task
+ * starts as soon as the tasks it depends on have finished. Exceptions are
+ * logged and count as finished so that dependents still run. The time of
+ * each task is logged once all are done.
+ */
+class StartupTasks {
+public:
+    using Task = std::function<void()>;
+
+    // dependencies are names of tasks added before
+    void add(const std::string &name, Task task, const std::vector<std::string> &dependencies = {});
+
+    // returns immediately, no tasks may be added afterwards
+    void start(size_t maxConcurrent);
+    bool isDone();
+    void wait();
+
+    ~StartupTasks();
+
+private:
+    static constexpr const char *EXECUTOR_QUEUE = "startup";
+
+    struct Node {
+        std::string name;
+        Task task;
+        std::vector<size_t> dependents;
+        size_t pendingDependencies = 0;
+        int64_t micros = 0;
+    };
+
+    std::mutex mutex;
+    std::vector<Node> nodes;
+    size_t finished = 0;
+    bool started = false;
+    std::vector<std::shared_ptr<Executor::Job>> jobs;
+    decltype(measureTime()) startedAt {};
+
+    void submit(size_t id);
+    void run(size_t id);
+    void logTimings();
+};
+
+} /* namespace platform */
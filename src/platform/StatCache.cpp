@@ -0,0 +1,154 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include "StatCache.h"
+#include "Platform.h"
+
+namespace platform {
+
+StatCache &StatCache::shared() {
+    static StatCache instance;
+    return instance;
+}
+
+bool StatCache::exists(const std::string &utf8Path) {
+    std::string dir, name;
+    if (!splitPath(utf8Path, dir, name)) {
+        return fileExists(utf8Path);
+    }
+
+    auto now = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = listings.find(dir);
+        if (it != listings.end() && it->second.expiresAt > now) {
+            return it->second.isDirectoryByName.count(name) > 0;
+        }
+    }
+
+    // listed unlocked so that a large directory doesn't hold up checks in others
+    Listing listing = readListing(dir);
+    listing.expiresAt = now + EXPIRY;
+    bool res = listing.isDirectoryByName.count(name) > 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    makeRoom(now);
+    listings[dir] = std::move(listing);
+    return res;
+}
+
+void StatCache::noteCreated(const std::string &utf8Path, bool isDirectory) {
+    std::string path = trimSeparators(utf8Path);
+    std::string dir, name;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (splitPath(path, dir, name)) {
+        auto it = listings.find(dir);
+        if (it != listings.end()) {
+            it->second.isDirectoryByName[name] = isDirectory;
+        }
+    }
+    // a cached listing of a directory from before it existed is empty, so it needs no update
+}
+
+void StatCache::noteRemoved(const std::string &utf8Path) {
+    std::string path = trimSeparators(utf8Path);
+    std::string dir, name;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (splitPath(path, dir, name)) {
+        auto it = listings.find(dir);
+        if (it != listings.end()) {
+            it->second.isDirectoryByName.erase(name);
+        }
+    }
+    listings.erase(path);
+}
+
+void StatCache::invalidate(const std::string &utf8Path) {
+    std::string path = trimSeparators(utf8Path);
+    std::string dir, name;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (splitPath(path, dir, name)) {
+        listings.erase(dir);
+    }
+    listings.erase(path);
+}
+
+void StatCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    listings.clear();
+}
+
+std::string StatCache::trimSeparators(const std::string &utf8Path) {
+    std::string path = utf8Path;
+    while (path.size() > 1 && (path.back() == '/' || path.back() == FS_SEP)) {
+        path.pop_back();
+    }
+    return path;
+}
+
+bool StatCache::splitPath(const std::string &utf8Path, std::string &dir, std::string &name) {
+#ifdef _WIN32
+    size_t sep = utf8Path.find_last_of("/\\");
+#else
+    size_t sep = utf8Path.rfind('/');
+#endif
+    if (sep == std::string::npos || sep + 1 == utf8Path.size()) {
+        return false;
+    }
+
+    name = utf8Path.substr(sep + 1);
+    // hidden files aren't listed, relative components need the real file system
+    if (name[0] == '.') {
+        return false;
+    }
+    dir = utf8Path.substr(0, std::max<size_t>(sep, 1));
+    return true;
+}
+
+StatCache::Listing StatCache::readListing(const std::string &dir) {
+    Listing listing;
+    try {
+        readDirectory(dir, [&listing] (const DirEntry &entry) {
+            listing.isDirectoryByName.emplace(entry.utf8Name, entry.isDirectory);
+            return true;
+        });
+    } catch (const std::exception &e) {
+        // missing or unreadable: nothing in it exists until it's invalidated or expires
+        listing.isDirectoryByName.clear();
+    }
+    return listing;
+}
+
+void StatCache::makeRoom(Clock::time_point now) {
+    // called locked
+    if (listings.size() < MAX_LISTINGS) {
+        return;
+    }
+    for (auto it = listings.begin(); it != listings.end(); ) {
+        if (it->second.expiresAt <= now) {
+            it = listings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (listings.size() >= MAX_LISTINGS) {
+        listings.clear();
+    }
+}
+
+} /* namespace platform */
@@ -0,0 +1,69 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+namespace platform {
+
+/*
+ * Answers existence checks from cached directory listings instead of a system
+ * call per query. The first check in a directory lists it at once and all
+ * further checks in it are lookups until the listing expires. Code that
+ * creates or removes files must report it to keep the listings current,
+ * the platform's mkdir, mkpath and removeFile do that themselves.
+ */
+class StatCache {
+public:
+    static StatCache &shared();
+
+    // like fileExists, but files created by others show up only after the expiry
+    bool exists(const std::string &utf8Path);
+
+    // update the listing of the containing directory if it is cached
+    void noteCreated(const std::string &utf8Path, bool isDirectory);
+    void noteRemoved(const std::string &utf8Path);
+
+    // drops the listings of the path itself and the directory containing it
+    void invalidate(const std::string &utf8Path);
+    void clear();
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr const std::chrono::seconds EXPIRY { 10 };
+    static constexpr const size_t MAX_LISTINGS = 512;
+
+    struct Listing {
+        Clock::time_point expiresAt;
+        std::unordered_map<std::string, bool> isDirectoryByName;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Listing> listings;
+
+    StatCache() = default;
+    static std::string trimSeparators(const std::string &utf8Path);
+    static bool splitPath(const std::string &utf8Path, std::string &dir, std::string &name);
+    static Listing readListing(const std::string &dir);
+    void makeRoom(Clock::time_point now);
+};
+
+} /* namespace platform */
@@ -0,0 +1,174 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <chrono>
+#include "Tracer.h"
+#include "Platform.h"
+#include "src/Logger.h"
+
+namespace platform {
+
+namespace {
+
+constexpr const size_t SPANS_PER_THREAD = 16384;
+
+struct Span {
+    const char *name;
+    int64_t start;
+    int64_t duration;
+};
+
+struct ThreadSpans {
+    int tid = 0;
+    std::string name;
+
+    // only contended while a trace is written
+    std::mutex mutex;
+    std::vector<Span> ring;
+    uint64_t count = 0;
+};
+
+struct Registry {
+    std::mutex mutex;
+    // kept after the threads exit so that their spans can still be written
+    std::vector<std::shared_ptr<ThreadSpans>> threads;
+    std::set<std::string> names;
+    int nextTid = 1;
+};
+
+Registry &registry() {
+    static Registry instance;
+    return instance;
+}
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+ThreadSpans &threadSpans() {
+    thread_local std::shared_ptr<ThreadSpans> spans = [] {
+        auto res = std::make_shared<ThreadSpans>();
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        res->tid = reg.nextTid++;
+        res->name = "thread " + std::to_string(res->tid);
+        reg.threads.push_back(res);
+        return res;
+    }();
+    return *spans;
+}
+
+void writeJsonString(std::ostream &out, const char *str) {
+    out << '"';
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        } else if ((unsigned char) *c >= 0x20) {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+}
+
+std::atomic_bool Tracer::enabled { false };
+
+void Tracer::start() {
+    logger::info("Span tracing started");
+    enabled = true;
+}
+
+void Tracer::stop() {
+    enabled = false;
+}
+
+void Tracer::setThreadName(const std::string &name) {
+    ThreadSpans &spans = threadSpans();
+    std::lock_guard<std::mutex> lock(spans.mutex);
+    spans.name = name;
+}
+
+const char *Tracer::intern(const std::string &name) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.names.insert(name).first->c_str();
+}
+
+int64_t Tracer::nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Tracer::record(const char *name, int64_t startMicros, int64_t endMicros) {
+    ThreadSpans &spans = threadSpans();
+    std::lock_guard<std::mutex> lock(spans.mutex);
+    Span span { name, startMicros, endMicros - startMicros };
+    if (spans.ring.size() < SPANS_PER_THREAD) {
+        spans.ring.push_back(span);
+    } else {
+        spans.ring[spans.count % SPANS_PER_THREAD] = span;
+    }
+    spans.count++;
+}
+
+bool Tracer::writeChromeTrace(const std::string &utf8Path) {
+    std::vector<std::shared_ptr<ThreadSpans>> threads;
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        threads = reg.threads;
+    }
+
+    fs::ofstream out(fs::u8path(utf8Path), std::ios::out | std::ios::trunc);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    size_t total = 0;
+    for (auto &thread: threads) {
+        // copied so that the thread can continue while the file is written
+        std::string threadName;
+        std::vector<Span> ring;
+        {
+            std::lock_guard<std::mutex> lock(thread->mutex);
+            threadName = thread->name;
+            ring = thread->ring;
+        }
+
+        out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread->tid << ",\"args\":{\"name\":";
+        writeJsonString(out, threadName.c_str());
+        out << "}}";
+        first = false;
+
+        for (auto &span: ring) {
+            out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->tid << ",\"ts\":" << span.start << ",\"dur\":" << span.duration << ",\"name\":";
+            writeJsonString(out, span.name);
+            out << "}";
+        }
+        total += ring.size();
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        logger::warn("Couldn't write span trace to %s", utf8Path.c_str());
+        return false;
+    }
+    logger::info("Wrote %d spans of %d threads to %s", (int) total, (int) threads.size(), utf8Path.c_str());
+    return true;
+}
+
+} /* namespace platform */
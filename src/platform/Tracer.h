@@ -0,0 +1,79 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+
+namespace platform {
+
+/*
+ * Records spans of work on all threads for deep profiling sessions. Each thread
+ * appends to a ring of its own, so only the most recent spans are kept and the
+ * threads don't wait for each other. The rings can be written as Chrome trace
+ * JSON at any time, which chrome://tracing and ui.perfetto.dev can open.
+ * Nothing is recorded and a span costs a single check while tracing is off.
+ */
+class Tracer {
+public:
+    static void start();
+    static void stop();
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // names the calling thread in the trace
+    static void setThreadName(const std::string &name);
+
+    // span names must outlive the tracer, other names are copied by intern
+    static const char *intern(const std::string &name);
+
+    static void record(const char *name, int64_t startMicros, int64_t endMicros);
+    static int64_t nowMicros();
+
+    // writes the spans recorded so far, false if the file couldn't be written
+    static bool writeChromeTrace(const std::string &utf8Path);
+
+private:
+    static std::atomic_bool enabled;
+};
+
+// records the time until the end of the enclosing scope as a span
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name):
+        name(Tracer::isEnabled() ? name : nullptr),
+        startAt(this->name ? Tracer::nowMicros() : 0)
+    {
+    }
+
+    ~TraceSpan() {
+        if (name) {
+            Tracer::record(name, startAt, Tracer::nowMicros());
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+private:
+    const char *name;
+    int64_t startAt;
+};
+
+} /* namespace platform */
@@ -17,30 +17,471 @@
  */
 
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <cstring>
 #include "Runtime.h"
 #include "src/Logger.h"
+#include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
+#include "src/charts/Crypto.h"
+#include "src/world/World.h"
+#include "src/maps/ScriptOverlays.h"
 
 namespace js {
 
 Runtime::Runtime() {
-#if 0 // experimental
     runtime = JS_NewRuntime();
     if (!runtime) {
         throw std::runtime_error("Couldn't initialize QuickJS");
     }
+    JS_SetMemoryLimit(runtime, MEMORY_LIMIT);
+    JS_SetMaxStackSize(runtime, STACK_LIMIT);
+    JS_SetInterruptHandler(runtime, &Runtime::onInterrupt, this);
 
+    // only the language's intrinsics, QuickJS' std and os modules aren't linked
     ctx = JS_NewContext(runtime);
     if (!ctx) {
+        JS_FreeRuntime(runtime);
         throw std::runtime_error("Couldn't create QuickJS context");
     }
-#endif
+    JS_SetContextOpaque(ctx, this);
+    installBindings();
+}
+
+void Runtime::installBindings() {
+    JSValue global = JS_GetGlobalObject(ctx);
+    JSValue avitab = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, avitab, "log", JS_NewCFunction(ctx, &Runtime::jsLog, "log", 1));
+    JS_SetPropertyStr(ctx, avitab, "onFrame", JS_NewCFunction(ctx, &Runtime::jsOnFrame, "onFrame", 1));
+    JS_SetPropertyStr(ctx, avitab, "findNodes", JS_NewCFunction(ctx, &Runtime::jsFindNodes, "findNodes", 3));
+    JS_SetPropertyStr(ctx, avitab, "setOverlay", JS_NewCFunction(ctx, &Runtime::jsSetOverlay, "setOverlay", 2));
+    JS_SetPropertyStr(ctx, global, "avitab", avitab);
+    JS_FreeValue(ctx, global);
+}
+
+void Runtime::setBytecodeCache(const std::string &utf8Dir) {
+    cacheDir = utf8Dir;
+    if (!cacheDir.empty()) {
+        platform::mkpath(cacheDir);
+    }
+}
+
+void Runtime::setFrameBudget(std::chrono::microseconds budget) {
+    frameBudget = budget;
+}
+
+void Runtime::setWorld(std::shared_ptr<world::World> navWorld) {
+    world = navWorld;
+}
+
+void Runtime::loadScripts(const std::string &utf8Dir) {
+    std::vector<std::string> names;
+    try {
+        for (auto &entry: platform::readDirectory(utf8Dir)) {
+            auto &name = entry.utf8Name;
+            if (!entry.isDirectory && name.size() > 3 && name.compare(name.size() - 3, 3, ".js") == 0) {
+                names.push_back(name);
+            }
+        }
+    } catch (const std::exception &e) {
+        logger::verbose("No scripts in %s: %s", utf8Dir.c_str(), e.what());
+        return;
+    }
+    std::sort(names.begin(), names.end());
+
+    for (auto &name: names) {
+        try {
+            platform::MappedFile file(utf8Dir + name);
+            runScript(name, std::string(file.data(), file.size()));
+        } catch (const std::exception &e) {
+            logger::warn("Couldn't read script %s: %s", name.c_str(), e.what());
+        }
+    }
+}
+
+bool Runtime::runScript(const std::string &name, const std::string &source) {
+    JSValue function = compile(name, source);
+    if (JS_IsException(function)) {
+        logException(name);
+        return false;
+    }
+
+    currentScript = name;
+    startBudget(LOAD_BUDGET);
+    JSValue res = JS_EvalFunction(ctx, function);
+    deadline = std::chrono::steady_clock::time_point::max();
+    currentScript.clear();
+
+    bool ok = !JS_IsException(res);
+    if (ok) {
+        logger::info("Loaded script %s", name.c_str());
+    } else {
+        logException(name);
+    }
+    JS_FreeValue(ctx, res);
+    return ok;
+}
+
+JSValue Runtime::compile(const std::string &name, const std::string &source) {
+    std::string cacheFile;
+    if (!cacheDir.empty()) {
+        // the name is part of the bytecode, it's used in the stack traces
+        apis::Crypto crypto;
+        std::string key = std::to_string(BYTECODE_VERSION) + "\n" + name + "\n" + source;
+        cacheFile = cacheDir + crypto.sha256String(key) + ".qjsc";
+
+        JSValue cached = loadBytecode(cacheFile);
+        if (!JS_IsException(cached)) {
+            return cached;
+        }
+    }
+
+    JSValue function = JS_Eval(ctx, source.c_str(), source.size(), name.c_str(), JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+    if (!cacheFile.empty() && !JS_IsException(function)) {
+        storeBytecode(cacheFile, function);
+    }
+    return function;
+}
+
+JSValue Runtime::loadBytecode(const std::string &path) {
+    if (!platform::fileExists(path)) {
+        return JS_EXCEPTION;
+    }
+
+    try {
+        platform::MappedFile file(path);
+        JSValue function = JS_ReadObject(ctx, reinterpret_cast<const uint8_t *>(file.data()), file.size(), JS_READ_OBJ_BYTECODE);
+        if (JS_IsException(function)) {
+            // stale or damaged, compiled again and overwritten
+            JS_FreeValue(ctx, JS_GetException(ctx));
+            logger::verbose("Ignoring cached bytecode %s", path.c_str());
+        }
+        return function;
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't read cached bytecode %s: %s", path.c_str(), e.what());
+        return JS_EXCEPTION;
+    }
+}
+
+void Runtime::storeBytecode(const std::string &path, JSValueConst function) {
+    size_t size = 0;
+    uint8_t *data = JS_WriteObject(ctx, &size, function, JS_WRITE_OBJ_BYTECODE);
+    if (!data) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return;
+    }
+
+    // a crash never leaves a truncated file behind
+    try {
+        platform::writeFileAtomically(path, data, size);
+    } catch (const std::exception &e) {
+        logger::warn("Couldn't store bytecode %s: %s", path.c_str(), e.what());
+    }
+    js_free(ctx, data);
+}
+
+bool Runtime::hasFrameHandlers() const {
+    return !frameHandlers.empty();
+}
+
+void Runtime::runFrame(const FrameState &state) {
+    if (frameHandlers.empty()) {
+        return;
+    }
+
+    JSValue stateObj = createFrameObject(state);
+    startBudget(frameBudget);
+
+    // the handlers take turns going first, so that a slow one doesn't always starve the same others
+    size_t count = frameHandlers.size();
+    size_t start = firstHandler++ % count;
+    std::vector<size_t> removed;
+    for (size_t i = 0; i < count && std::chrono::steady_clock::now() < deadline; i++) {
+        size_t idx = (start + i) % count;
+        currentScript = frameHandlers[idx].script;
+        interrupted = false;
+        JSValue res = JS_Call(ctx, frameHandlers[idx].function, JS_UNDEFINED, 1, &stateObj);
+
+        // looked up again, the call might have added handlers
+        Handler &handler = frameHandlers[idx];
+        if (JS_IsException(res)) {
+            if (interrupted) {
+                JS_FreeValue(ctx, JS_GetException(ctx));
+                if (++handler.overruns >= MAX_OVERRUNS) {
+                    logger::warn("Removing frame handler of %s, it keeps exceeding the frame budget", handler.script.c_str());
+                    removed.push_back(idx);
+                }
+            } else {
+                logException(handler.script);
+            }
+        } else {
+            handler.overruns = 0;
+        }
+        JS_FreeValue(ctx, res);
+    }
+    currentScript.clear();
+    deadline = std::chrono::steady_clock::time_point::max();
+    JS_FreeValue(ctx, stateObj);
+
+    std::sort(removed.rbegin(), removed.rend());
+    for (size_t idx: removed) {
+        JS_FreeValue(ctx, frameHandlers[idx].function);
+        frameHandlers.erase(frameHandlers.begin() + idx);
+    }
+}
+
+JSValue Runtime::createFrameObject(const FrameState &state) {
+    JSValue obj = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, obj, "time", JS_NewFloat64(ctx, state.timeSeconds));
+    JS_SetPropertyStr(ctx, obj, "frameTime", JS_NewFloat64(ctx, state.frameTime));
+
+    JSValue aircraft = JS_NewArray(ctx);
+    for (size_t i = 0; i < state.aircraft.size(); i++) {
+        auto &src = state.aircraft[i];
+        JSValue ac = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, ac, "latitude", JS_NewFloat64(ctx, src.latitude));
+        JS_SetPropertyStr(ctx, ac, "longitude", JS_NewFloat64(ctx, src.longitude));
+        JS_SetPropertyStr(ctx, ac, "elevation", JS_NewFloat64(ctx, src.elevation));
+        JS_SetPropertyStr(ctx, ac, "heading", JS_NewFloat64(ctx, src.heading));
+        JS_SetPropertyUint32(ctx, aircraft, i, ac);
+    }
+    JS_SetPropertyStr(ctx, obj, "aircraft", aircraft);
+    return obj;
+}
+
+void Runtime::startBudget(std::chrono::microseconds budget) {
+    interrupted = false;
+    deadline = std::chrono::steady_clock::now() + budget;
+}
+
+int Runtime::onInterrupt(JSRuntime *rt, void *opaque) {
+    // QuickJS calls this every few thousand instructions
+    Runtime *us = reinterpret_cast<Runtime *>(opaque);
+    if (std::chrono::steady_clock::now() >= us->deadline) {
+        us->interrupted = true;
+        return 1;
+    }
+    return 0;
+}
+
+void Runtime::logException(const std::string &script) {
+    JSValue exception = JS_GetException(ctx);
+    const char *msg = JS_ToCString(ctx, exception);
+    std::string stack;
+    if (JS_IsError(ctx, exception)) {
+        JSValue stackVal = JS_GetPropertyStr(ctx, exception, "stack");
+        const char *stackStr = JS_ToCString(ctx, stackVal);
+        if (stackStr) {
+            stack = stackStr;
+            JS_FreeCString(ctx, stackStr);
+        }
+        JS_FreeValue(ctx, stackVal);
+    }
+    logger::warn("Script %s failed: %s\n%s", script.c_str(), msg ? msg : "?", stack.c_str());
+    if (msg) {
+        JS_FreeCString(ctx, msg);
+    }
+    JS_FreeValue(ctx, exception);
+}
+
+Runtime &Runtime::fromContext(JSContext *context) {
+    return *reinterpret_cast<Runtime *>(JS_GetContextOpaque(context));
+}
+
+JSValue Runtime::jsLog(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv) {
+    Runtime &us = fromContext(context);
+    std::string line;
+    for (int i = 0; i < argc; i++) {
+        const char *str = JS_ToCString(context, argv[i]);
+        if (!str) {
+            return JS_EXCEPTION;
+        }
+        line += (i > 0 ? " " : "") + std::string(str);
+        JS_FreeCString(context, str);
+    }
+    logger::info("[%s] %s", us.currentScript.c_str(), line.c_str());
+    return JS_UNDEFINED;
+}
+
+JSValue Runtime::jsOnFrame(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv) {
+    Runtime &us = fromContext(context);
+    if (argc < 1 || !JS_IsFunction(context, argv[0])) {
+        return JS_ThrowTypeError(context, "onFrame expects a function");
+    }
+    Handler handler;
+    handler.script = us.currentScript;
+    handler.function = JS_DupValue(context, argv[0]);
+    us.frameHandlers.push_back(handler);
+    return JS_UNDEFINED;
+}
+
+JSValue Runtime::jsFindNodes(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv) {
+    // one call for all nodes around a location instead of a call per node and property
+    Runtime &us = fromContext(context);
+    double lat, lon, radiusNm;
+    if (argc < 3 || JS_ToFloat64(context, &lat, argv[0]) || JS_ToFloat64(context, &lon, argv[1]) || JS_ToFloat64(context, &radiusNm, argv[2])) {
+        return JS_ThrowTypeError(context, "findNodes expects latitude, longitude and radius in nm");
+    }
+    if (!us.world) {
+        return JS_ThrowTypeError(context, "The navigation data isn't loaded yet");
+    }
+
+    double dLat = radiusNm / world::KM_TO_NM / world::LAT_TO_KM;
+    double dLon = dLat / std::max(0.01, std::cos(lat * M_PI / 180));
+    world::Location bottomLeft(lat - dLat, lon - dLon);
+    world::Location topRight(lat + dLat, lon + dLon);
+
+    JSValue nodes = JS_NewArray(context);
+    uint32_t count = 0;
+    us.world->visitNodes(bottomLeft, topRight, [context, nodes, &count] (const world::NavNode *node) {
+        if (count >= MAX_FOUND_NODES) {
+            return;
+        }
+        auto &loc = node->getLocation();
+        JSValue obj = JS_NewObject(context);
+        JS_SetPropertyStr(context, obj, "id", JS_NewString(context, node->getID().c_str()));
+        JS_SetPropertyStr(context, obj, "latitude", JS_NewFloat64(context, loc.latitude));
+        JS_SetPropertyStr(context, obj, "longitude", JS_NewFloat64(context, loc.longitude));
+        JS_SetPropertyStr(context, obj, "airport", JS_NewBool(context, node->isAirport()));
+        JS_SetPropertyUint32(context, nodes, count++, obj);
+    }, world::World::VISIT_EVERYTHING);
+    return nodes;
+}
+
+namespace {
+
+// Copies the elements of a typed array property, empty if the property is missing.
+// Copied right away since the next getter that runs could detach the buffer.
+template<typename T>
+bool getTypedArray(JSContext *context, JSValueConst obj, const char *prop, std::vector<T> &out) {
+    out.clear();
+    JSValue arr = JS_GetPropertyStr(context, obj, prop);
+    if (JS_IsUndefined(arr)) {
+        return true;
+    }
+
+    size_t offset = 0, length = 0, elementSize = 0;
+    JSValue buffer = JS_GetTypedArrayBuffer(context, arr, &offset, &length, &elementSize);
+    JS_FreeValue(context, arr);
+    if (JS_IsException(buffer)) {
+        return false;
+    }
+
+    size_t size = 0;
+    uint8_t *bytes = JS_GetArrayBuffer(context, &size, buffer);
+    JS_FreeValue(context, buffer);
+    if (!bytes || elementSize != sizeof(T) || offset + length > size) {
+        JS_ThrowTypeError(context, "%s has the wrong type", prop);
+        return false;
+    }
+    out.resize(length / sizeof(T));
+    std::memcpy(out.data(), bytes + offset, out.size() * sizeof(T));
+    return true;
+}
+
+}
+
+JSValue Runtime::jsSetOverlay(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv) {
+    Runtime &us = fromContext(context);
+    const char *nameStr = (argc >= 1) ? JS_ToCString(context, argv[0]) : nullptr;
+    if (!nameStr) {
+        return JS_ThrowTypeError(context, "setOverlay expects a name and the draw commands");
+    }
+    std::string name = nameStr;
+    JS_FreeCString(context, nameStr);
+
+    if (argc < 2 || JS_IsNull(argv[1]) || JS_IsUndefined(argv[1])) {
+        maps::ScriptOverlays::shared().setLayer(name, nullptr);
+        us.overlayNames.erase(name);
+        return JS_UNDEFINED;
+    }
+
+    std::vector<double> points;
+    std::vector<uint32_t> lines, symbols, labelPoints;
+    JSValueConst cmds = argv[1];
+    if (!getTypedArray(context, cmds, "points", points) ||
+        !getTypedArray(context, cmds, "lines", lines) ||
+        !getTypedArray(context, cmds, "symbols", symbols) ||
+        !getTypedArray(context, cmds, "labelPoints", labelPoints))
+    {
+        return JS_EXCEPTION;
+    }
+    if (points.size() % 2 != 0 || lines.size() % 3 != 0 || symbols.size() % 3 != 0 || labelPoints.size() % 2 != 0) {
+        return JS_ThrowRangeError(context, "Incomplete draw command");
+    }
+
+    size_t pointCount = points.size() / 2;
+    if (pointCount > MAX_OVERLAY_POINTS) {
+        return JS_ThrowRangeError(context, "Too many points, at most %d are allowed", (int) MAX_OVERLAY_POINTS);
+    }
+
+    // everything is checked here, the maps draw the list without further checks
+    auto list = std::make_shared<maps::ScriptDrawList>();
+    list->lats.resize(pointCount);
+    list->lons.resize(pointCount);
+    for (size_t i = 0; i < pointCount; i++) {
+        list->lats[i] = points[2 * i];
+        list->lons[i] = points[2 * i + 1];
+    }
+
+    for (size_t i = 0; i < lines.size(); i += 3) {
+        uint32_t first = lines[i], count = lines[i + 1];
+        if (first > pointCount || count > pointCount - first) {
+            return JS_ThrowRangeError(context, "Line %d refers to missing points", (int) (i / 3));
+        }
+        list->polylines.push_back({first, count, lines[i + 2]});
+    }
+
+    using Shape = maps::ScriptDrawList::Shape;
+    for (size_t i = 0; i < symbols.size(); i += 3) {
+        if (symbols[i] >= pointCount || symbols[i + 1] >= (uint32_t) Shape::NUM_SHAPES) {
+            return JS_ThrowRangeError(context, "Invalid symbol %d", (int) (i / 3));
+        }
+        list->symbols.push_back({symbols[i], (Shape) symbols[i + 1], symbols[i + 2]});
+    }
+
+    size_t labelCount = labelPoints.size() / 2;
+    if (labelCount > 0) {
+        JSValue texts = JS_GetPropertyStr(context, cmds, "labelTexts");
+        if (!JS_IsArray(context, texts)) {
+            JS_FreeValue(context, texts);
+            return JS_ThrowTypeError(context, "labelTexts must be an array");
+        }
+        for (size_t i = 0; i < labelCount; i++) {
+            if (labelPoints[2 * i] >= pointCount) {
+                JS_FreeValue(context, texts);
+                return JS_ThrowRangeError(context, "Label %d refers to a missing point", (int) i);
+            }
+            JSValue text = JS_GetPropertyUint32(context, texts, i);
+            const char *str = JS_ToCString(context, text);
+            JS_FreeValue(context, text);
+            if (!str) {
+                JS_FreeValue(context, texts);
+                return JS_EXCEPTION;
+            }
+            list->labels.push_back({labelPoints[2 * i], labelPoints[2 * i + 1], str});
+            JS_FreeCString(context, str);
+        }
+        JS_FreeValue(context, texts);
+    }
+
+    maps::ScriptOverlays::shared().setLayer(name, list);
+    us.overlayNames.insert(name);
+    return JS_UNDEFINED;
 }
 
 Runtime::~Runtime() {
-#if 0 // experimental
+    for (auto &name: overlayNames) {
+        maps::ScriptOverlays::shared().setLayer(name, nullptr);
+    }
+    for (auto &handler: frameHandlers) {
+        JS_FreeValue(ctx, handler.function);
+    }
+    frameHandlers.clear();
     JS_FreeContext(ctx);
     JS_FreeRuntime(runtime);
-#endif
 }
 
 }
@@ -20,18 +20,114 @@
 #define AVITAB_RUNTIME_H
 
 #include <quickjs.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <chrono>
+
+namespace world {
+class World;
+}
 
 namespace js {
 
+// What the scripts see of the environment, handed to them as one object per
+// frame so that they don't call back into native code for every value
+struct FrameState {
+    struct Aircraft {
+        double latitude, longitude, elevation, heading;
+    };
+
+    double timeSeconds = 0;
+    float frameTime = 0;
+    // the user's aircraft first, then the others
+    std::vector<Aircraft> aircraft;
+};
+
+/*
+ * Sandboxed QuickJS engine for scripted extensions. Scripts only get the
+ * language itself and the avitab object: no files, no network and limited
+ * memory. A script registers handlers with avitab.onFrame(fn), which get the
+ * FrameState every frame. All handlers together must finish within the frame
+ * budget, they are interrupted otherwise and removed if they keep overrunning.
+ *
+ * Scripts draw on the maps with avitab.setOverlay(name, commands), which
+ * replaces a whole layer at once. The commands are typed arrays so that a
+ * layer with thousands of elements is a single call:
+ *   points:      Float64Array of latitude, longitude pairs
+ *   lines:       Uint32Array of first point, point count, color triples
+ *   symbols:     Uint32Array of point, shape, color triples
+ *   labelPoints: Uint32Array of point, color pairs
+ *   labelTexts:  array of strings, one per label point
+ * Colors are ARGB. avitab.setOverlay(name, null) removes the layer.
+ *
+ * The runtime must be used by the thread that created it.
+ */
 class Runtime final {
 public:
     Runtime();
+
+    // compiled scripts are stored there by the hash of their source, nothing is stored if empty
+    void setBytecodeCache(const std::string &utf8Dir);
+    void setFrameBudget(std::chrono::microseconds budget);
+    // used by avitab.findNodes, queries fail while it is null
+    void setWorld(std::shared_ptr<world::World> navWorld);
+
+    // runs the .js files of the directory, sorted by name
+    void loadScripts(const std::string &utf8Dir);
+    // false if the script failed, the reason is logged
+    bool runScript(const std::string &name, const std::string &source);
+
+    bool hasFrameHandlers() const;
+    void runFrame(const FrameState &state);
+
     ~Runtime();
 private:
-#if 0 // experimental
-    JSRuntime *runtime;
-    JSContext *ctx;
-#endif
+    static constexpr const size_t MEMORY_LIMIT = 32 * 1024 * 1024;
+    static constexpr const size_t STACK_LIMIT = 256 * 1024;
+    // the top level code of a script only runs once, so it can take longer than a frame
+    static constexpr const std::chrono::milliseconds LOAD_BUDGET { 500 };
+    // a handler that is interrupted this many frames in a row is removed
+    static constexpr const int MAX_OVERRUNS = 3;
+    static constexpr const int MAX_FOUND_NODES = 500;
+    static constexpr const size_t MAX_OVERLAY_POINTS = 200000;
+    // part of the cache key, to be increased when the QuickJS version changes
+    static constexpr const int BYTECODE_VERSION = 1;
+
+    struct Handler {
+        std::string script;
+        JSValue function;
+        int overruns = 0;
+    };
+
+    JSRuntime *runtime = nullptr;
+    JSContext *ctx = nullptr;
+    std::string cacheDir;
+    std::chrono::microseconds frameBudget { 2000 };
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    bool interrupted = false;
+    std::string currentScript;
+    std::vector<Handler> frameHandlers;
+    size_t firstHandler = 0;
+    std::shared_ptr<world::World> world;
+    // removed when the runtime goes away
+    std::set<std::string> overlayNames;
+
+    void installBindings();
+    JSValue compile(const std::string &name, const std::string &source);
+    JSValue loadBytecode(const std::string &path);
+    void storeBytecode(const std::string &path, JSValueConst function);
+    JSValue createFrameObject(const FrameState &state);
+    void logException(const std::string &script);
+    void startBudget(std::chrono::microseconds budget);
+
+    static Runtime &fromContext(JSContext *context);
+    static int onInterrupt(JSRuntime *rt, void *opaque);
+    static JSValue jsLog(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv);
+    static JSValue jsOnFrame(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv);
+    static JSValue jsFindNodes(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv);
+    static JSValue jsSetOverlay(JSContext *context, JSValueConst thisVal, int argc, JSValueConst *argv);
 };
 
 }
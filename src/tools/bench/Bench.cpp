@@ -0,0 +1,314 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2023 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Micro-benchmarks for the image kernels and the stitcher, so that performance
+// regressions show up before a release. Usage:
+//   AviTab-bench [name filter] [--pdf document] [--dds texture]
+// The document and texture benchmarks only run when a file is given.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "src/libimg/Image.h"
+#include "src/libimg/TTFStamper.h"
+#include "src/libimg/BlockCodec.h"
+#include "src/libimg/DDSImage.h"
+#include "src/libimg/Rasterizer.h"
+#include "src/libimg/stitcher/Stitcher.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const int RUNS = 5;
+constexpr const double MIN_RUN_SECONDS = 0.05;
+
+std::string nameFilter;
+
+// Runs f often enough for each run to take MIN_RUN_SECONDS and prints the
+// median and the fastest time per call over RUNS runs
+void bench(const std::string &name, const std::function<void()> &f) {
+    if (name.find(nameFilter) == std::string::npos) {
+        return;
+    }
+
+    auto timeCalls = [&f] (size_t calls) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < calls; i++) {
+            f();
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    size_t calls = 1;
+    double seconds = timeCalls(calls);
+    while (seconds < MIN_RUN_SECONDS && calls < (1u << 30)) {
+        calls = (seconds > 0) ? std::max(calls * 2, (size_t) (calls * MIN_RUN_SECONDS * 1.2 / seconds)) : calls * 10;
+        seconds = timeCalls(calls);
+    }
+
+    std::vector<double> perCall;
+    for (int run = 0; run < RUNS; run++) {
+        perCall.push_back(timeCalls(calls) / calls * 1e9);
+    }
+    std::sort(perCall.begin(), perCall.end());
+    std::printf("%-36s %14.0f ns %14.0f ns min %10zu calls\n", name.c_str(), perCall[RUNS / 2], perCall[0], calls);
+    std::fflush(stdout);
+}
+
+// Quadtree of 256x256 tiles with a pattern, loaded without I/O so that the
+// stitcher and its cache are measured instead of a decoder or the network
+class SyntheticSource: public img::TileSource {
+public:
+    static constexpr const int TILE_SIZE = 256;
+
+    int getMinZoomLevel() override { return 0; }
+    int getMaxZoomLevel() override { return 12; }
+    int getInitialZoomLevel() override { return 4; }
+    img::Point<double> suggestInitialCenter(int page) override {
+        double size = TILE_SIZE << getInitialZoomLevel();
+        return img::Point<double>{size / 2, size / 2};
+    }
+    img::Point<int> getTileDimensions(int zoom) override { return img::Point<int>{TILE_SIZE, TILE_SIZE}; }
+    bool supportsWorldCoords() override { return false; }
+    img::Point<double> transformZoomedPoint(int page, double oldX, double oldY, int oldZoom, int newZoom) override {
+        double factor = std::ldexp(1.0, newZoom - oldZoom);
+        return img::Point<double>{oldX * factor, oldY * factor};
+    }
+    void cancelPendingLoads() override { }
+    void resumeLoading() override { }
+    int getMaxConcurrentLoads() override { return 4; }
+    int getPageCount() override { return 1; }
+    img::Point<int> getPageDimensions(int page, int zoom) override {
+        return img::Point<int>{TILE_SIZE << zoom, TILE_SIZE << zoom};
+    }
+    bool isTileValid(int page, int x, int y, int zoom) override {
+        return page == 0 && x >= 0 && y >= 0 && x < (1 << zoom) && y < (1 << zoom);
+    }
+    std::string getUniqueTileName(int page, int x, int y, int zoom) override {
+        return std::to_string(zoom) + "/" + std::to_string(x) + "/" + std::to_string(y);
+    }
+    std::unique_ptr<img::Image> loadTileImage(int page, int x, int y, int zoom) override {
+        uint32_t color = 0xFF000000 | ((x * 40) & 0xFF) << 16 | ((y * 40) & 0xFF) << 8 | ((zoom * 20) & 0xFF);
+        auto tile = std::make_unique<img::Image>(TILE_SIZE, TILE_SIZE, color);
+        for (int i = 0; i < TILE_SIZE; i += 32) {
+            tile->drawLine(i, 0, i, TILE_SIZE - 1, img::COLOR_WHITE);
+            tile->drawLine(0, i, TILE_SIZE - 1, i, img::COLOR_WHITE);
+        }
+        return tile;
+    }
+    img::Point<double> worldToXY(double lon, double lat, int zoom) override { return img::Point<double>{lon, lat}; }
+    img::Point<double> xyToWorld(double x, double y, int zoom) override { return img::Point<double>{x, y}; }
+};
+
+// Updates the view until all visible tiles are final, i.e. an update changes nothing
+void settle(img::Stitcher &stitcher) {
+    for (int i = 0; i < 100000; i++) {
+        stitcher.updateImage();
+        int x0, y0, x1, y1;
+        stitcher.getDirtyArea(x0, y0, x1, y1);
+        if (x0 >= x1 || y0 >= y1) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+img::Image makePattern(int width, int height) {
+    img::Image image(width, height, 0x80336699);
+    for (int i = 0; i < std::max(width, height); i += 7) {
+        image.drawLine(i, 0, 0, i, 0xFFFF8000);
+    }
+    return image;
+}
+
+void benchImage() {
+    img::Image screen(800, 480, img::COLOR_WHITE);
+    img::Image icon = makePattern(64, 64);
+
+    bench("image/blendImage0", [&] { screen.blendImage0(icon, 100, 100); });
+    bench("image/blendImage/37deg", [&] { screen.blendImage(icon, 100, 100, 37); });
+    bench("image/alphaBlend", [&] { screen.alphaBlend(0x40000000); });
+    bench("image/drawImage", [&] { screen.drawImage(icon, 100, 100); });
+
+    img::Image square = makePattern(1024, 1024);
+    img::Image rotated(1024, 1024, 0);
+    bench("image/rotate/0/1024", [&] { square.rotate(rotated, 0); });
+    bench("image/rotate/90/1024", [&] { square.rotate(rotated, 90); });
+    bench("image/rotate/180/1024", [&] { square.rotate(rotated, 180); });
+
+    // includes copying the source since scale works in place
+    img::Image scaled;
+    auto scaleWith = [&] (img::ResampleFilter filter) {
+        return [&scaled, &square, filter] {
+            scaled.resize(square.getWidth(), square.getHeight(), 0);
+            scaled.drawImage(square, 0, 0);
+            scaled.scale(512, 512, filter);
+        };
+    };
+    bench("image/scale/area/1024->512", scaleWith(img::ResampleFilter::AREA));
+    bench("image/scale/bilinear/1024->512", scaleWith(img::ResampleFilter::BILINEAR));
+    bench("image/scale/lanczos3/1024->512", scaleWith(img::ResampleFilter::LANCZOS3));
+
+    bench("image/fillCircle/r20", [&] { screen.fillCircle(400, 240, 20, 0x80FF0000); });
+    bench("image/fillCircle/r200", [&] { screen.fillCircle(400, 240, 200, 0x80FF0000); });
+    bench("image/drawLineAA/diagonal", [&] { screen.drawLineAA(3.5f, 2.25f, 790.5f, 470.75f, img::COLOR_BLACK); });
+    bench("image/drawLineAA/clipped", [&] { screen.drawLineAA(-5000.0f, -3000.0f, 6000.0f, 4000.0f, img::COLOR_BLACK); });
+    bench("image/fillRectangle/rotated", [&] { screen.fillRectangle(100, 300, 400, 100, 450, 175, 150, 375, 0x80FF0000); });
+    bench("image/drawText/14px", [&] {
+        screen.drawText("EDDF RWY 25C ILS 110.55", 14, 100, 100, img::COLOR_BLACK, img::COLOR_WHITE, img::Align::LEFT);
+    });
+    std::vector<img::TextLabel> labels;
+    for (int i = 0; i < 50; i++) {
+        labels.push_back(img::TextLabel{"WPT" + std::to_string(i), 12, (i * 97) % 760, (i * 53) % 460,
+                                        img::COLOR_BLACK, img::COLOR_TRANSPARENT, img::Align::CENTRE});
+    }
+    bench("image/drawTexts/50 labels", [&] { screen.drawTexts(labels); });
+}
+
+void benchStamper() {
+    img::Image screen(800, 480, img::COLOR_WHITE);
+    img::TTFStamper stamper("Inconsolata.ttf");
+    stamper.setSize(20);
+    stamper.setColor(img::COLOR_ICAO_MAGENTA);
+
+    bench("ttf/setText", [&] { stamper.setText("FL350 N0450"); });
+    bench("ttf/applyStamp", [&] { stamper.applyStamp(screen, 100, 100); });
+    bench("ttf/applyStamp/270deg", [&] { stamper.applyStamp(screen, 270); });
+}
+
+void benchBlocks(const std::string &ddsPath) {
+    // 256x256 texture worth of pseudo-random blocks
+    constexpr const int BLOCKS = 64 * 64;
+    std::vector<uint8_t> data(BLOCKS * 16);
+    uint32_t seed = 12345;
+    for (auto &b: data) {
+        seed = seed * 1664525 + 1013904223;
+        b = seed >> 24;
+    }
+    uint32_t out[img::BLOCK_DIM * img::BLOCK_DIM];
+
+    bench("dds/decodeBlock/bc1/256x256", [&] {
+        for (int i = 0; i < BLOCKS; i++) {
+            img::decodeBlock(img::BlockFormat::BC1, data.data() + i * 8, 0, out);
+        }
+    });
+    bench("dds/decodeBlock/bc3/256x256", [&] {
+        for (int i = 0; i < BLOCKS; i++) {
+            img::decodeBlock(img::BlockFormat::BC3, data.data() + i * 16, 0, out);
+        }
+    });
+
+    if (!ddsPath.empty()) {
+        img::DDSFile file(ddsPath);
+        bench("dds/DDSImage/mip0", [&] { img::DDSImage image(file, 0); });
+        bench("dds/DDSImage/mip2", [&] { img::DDSImage image(file, 2); });
+    }
+}
+
+void benchRasterizer(const std::string &pdfPath) {
+    if (pdfPath.empty()) {
+        return;
+    }
+
+    img::Rasterizer rasterizer(pdfPath);
+    bench("rasterizer/loadTile/zoom0", [&] { rasterizer.loadTile(0, 0, 0, 0, 0); });
+    bench("rasterizer/loadTile/zoom2", [&] { rasterizer.loadTile(0, 1, 1, 2, 0); });
+}
+
+void benchStitcher() {
+    auto source = std::make_shared<SyntheticSource>();
+    auto target = std::make_shared<img::Image>(512, 512, 0);
+    img::Stitcher stitcher(target, source);
+    settle(stitcher);
+
+    // tiles stay in the memory cache, so this measures the composition
+    int step = 0;
+    bench("stitcher/pan/cached", [&] {
+        int dir = (step++ / 16) % 2 ? -1 : 1;
+        stitcher.pan(dir * 24, dir * 12);
+        stitcher.updateImage();
+    });
+
+    stitcher.rotateRight();
+    bench("stitcher/pan/rotated", [&] {
+        int dir = (step++ / 16) % 2 ? -1 : 1;
+        stitcher.pan(dir * 24, dir * 12);
+        stitcher.updateImage();
+    });
+    stitcher.rotateRight();
+    stitcher.rotateRight();
+    stitcher.rotateRight();
+
+    // each zoom level change loads new tiles through the cache's loaders
+    int zoom = 4;
+    bench("stitcher/zoom/settle", [&] {
+        zoom = (zoom >= 9) ? 4 : zoom + 1;
+        stitcher.setZoomLevel(zoom);
+        settle(stitcher);
+    });
+
+    // long flight: keep panning in one direction so that tiles are always new
+    bench("stitcher/pan/uncached/settle", [&] {
+        stitcher.pan(64, 32);
+        settle(stitcher);
+    });
+
+    // track-up: the heading changes by more than the hysteresis every frame
+    double heading = 0;
+    bench("stitcher/rotate/free", [&] {
+        heading = std::fmod(heading + 7.3, 360);
+        stitcher.setRotation(heading);
+    });
+}
+
+} /* namespace */
+
+int main(int argc, char *argv[]) {
+    std::string pdfPath, ddsPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--pdf" && i + 1 < argc) {
+            pdfPath = argv[++i];
+        } else if (arg == "--dds" && i + 1 < argc) {
+            ddsPath = argv[++i];
+        } else {
+            nameFilter = arg;
+        }
+    }
+
+    try {
+        benchImage();
+        benchStamper();
+        benchBlocks(ddsPath);
+        benchRasterizer(pdfPath);
+        benchStitcher();
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
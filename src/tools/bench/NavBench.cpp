@@ -0,0 +1,242 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2023 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Loads nav data and runs fixed query workloads against it, so that XWorld,
+// SqlWorld and changes to either can be compared. Usage:
+//   AviTab-navbench [--xplane <X-Plane root>] [--navdb <navdb directory>] [--cache <directory>]
+// Each given data set is loaded and measured in turn.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <utility>
+#include "src/libxdata/XData.h"
+#include "src/libnavsql/SqlLoadManager.h"
+#include "src/world/World.h"
+#include "src/world/routing/RouteFinder.h"
+#include "src/world/models/navaids/Fix.h"
+
+#ifdef _WIN32
+#   include <windows.h>
+#   include <psapi.h>
+#else
+#   include <sys/resource.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const int VIEWPORTS_PER_SIZE = 200;
+constexpr const size_t MAX_FIX_LOOKUPS = 2000;
+
+const std::vector<std::string> AIRPORT_KEYWORDS = {
+    "FRANKFURT", "KENNEDY", "HEATHROW", "INTL", "SAN", "MUNICH", "EDD", "KS", "O'HARE", "SYDNEY",
+};
+
+const std::vector<std::pair<std::string, std::string>> CITY_PAIRS = {
+    {"EDDF", "EDDM"}, {"EGLL", "LFPG"}, {"EHAM", "LOWW"}, {"LEMD", "LEBL"}, {"KJFK", "KBOS"},
+    {"KSFO", "KSEA"}, {"KJFK", "KLAX"}, {"CYYZ", "KORD"}, {"YSSY", "YMML"}, {"EDDF", "LTFM"},
+};
+
+double millisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double peakMemoryMB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#   ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#   else
+    return usage.ru_maxrss / 1024.0;
+#   endif
+#endif
+}
+
+// median of the samples in ms, sorts them
+double median(std::vector<double> &samples) {
+    if (samples.empty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+void printPhases(const world::LoadManager &manager) {
+    for (auto &phase: manager.getLoadPhases()) {
+        std::printf("  %-24s %9.1f ms %10zu records %8.1f MB\n", phase.name.c_str(),
+            phase.seconds * 1000, phase.records, phase.bytes / (1024.0 * 1024.0));
+    }
+}
+
+void benchViewports(world::World &world, std::vector<std::pair<std::string, std::string>> &fixIds) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> latDist(-60, 70);
+    std::uniform_real_distribution<double> lonDist(-180, 180);
+
+    for (double size: {0.5, 2.0, 8.0, 30.0}) {
+        std::vector<double> samples;
+        size_t nodes = 0;
+        for (int i = 0; i < VIEWPORTS_PER_SIZE; i++) {
+            double lat = latDist(rng);
+            double lon = lonDist(rng);
+            world::Location bottomLeft(lat - size / 2, lon - size / 2);
+            world::Location topRight(lat + size / 2, lon + size / 2);
+
+            auto start = Clock::now();
+            world.visitNodes(bottomLeft, topRight, [&nodes, &fixIds] (const world::NavNode *node) {
+                nodes++;
+                if (node->isFix() && fixIds.size() < MAX_FIX_LOOKUPS) {
+                    auto fix = static_cast<const world::Fix *>(node);
+                    if (fix->getRegion()) {
+                        fixIds.emplace_back(fix->getRegion()->getId(), fix->getID());
+                    }
+                }
+            }, world::World::VISIT_EVERYTHING);
+            samples.push_back(millisSince(start));
+        }
+        std::printf("  visitNodes %5.1f deg      %9.3f ms median %10zu nodes\n", size, median(samples), nodes / VIEWPORTS_PER_SIZE);
+    }
+}
+
+void benchSearches(world::World &world, const std::vector<std::pair<std::string, std::string>> &fixIds) {
+    for (auto &keyword: AIRPORT_KEYWORDS) {
+        auto start = Clock::now();
+        auto results = world.findAirport(keyword);
+        double ms = millisSince(start);
+        std::printf("  findAirport %-12s %9.3f ms %10zu results\n", keyword.c_str(), ms, results.size());
+    }
+
+    std::vector<double> samples;
+    size_t found = 0;
+    for (auto &id: fixIds) {
+        auto start = Clock::now();
+        if (world.findFixByRegionAndID(id.first, id.second)) {
+            found++;
+        }
+        samples.push_back(millisSince(start));
+    }
+    std::printf("  findFixByRegionAndID     %9.3f ms median %10zu of %zu found\n", median(samples), found, fixIds.size());
+}
+
+void benchRoutes(world::World &world) {
+    for (auto level: {world::AirwayLevel::LOWER, world::AirwayLevel::UPPER}) {
+        for (auto &pair: CITY_PAIRS) {
+            auto departure = world.findAirportByID(pair.first);
+            auto arrival = world.findAirportByID(pair.second);
+            if (!departure || !arrival) {
+                std::printf("  route %s-%s: airports not found\n", pair.first.c_str(), pair.second.c_str());
+                continue;
+            }
+
+            auto finder = world.getRouteFinder();
+            finder->setDeparture(departure);
+            finder->setArrival(arrival);
+            finder->setAirwayLevel(level);
+            size_t expanded = 0;
+            finder->setProgressCallback([&expanded] (const world::RouteFinder::SearchProgress &progress) {
+                expanded = progress.nodesExpanded;
+            });
+
+            auto start = Clock::now();
+            std::string result;
+            try {
+                auto route = finder->find();
+                result = std::to_string(route->getPathLocations().size()) + " waypoints, "
+                       + std::to_string((int) (route->getRouteDistance() / 1000)) + " km";
+            } catch (const std::exception &e) {
+                result = std::string("failed: ") + e.what();
+            }
+            double ms = millisSince(start);
+            std::printf("  route %s-%s %-5s       %9.1f ms %10zu+ expanded, %s\n", pair.first.c_str(), pair.second.c_str(),
+                level == world::AirwayLevel::UPPER ? "upper" : "lower", ms, expanded, result.c_str());
+        }
+    }
+}
+
+void run(const std::string &name, std::shared_ptr<world::LoadManager> manager, const std::string &cacheDir) {
+    std::printf("%s\n", name.c_str());
+    if (!cacheDir.empty()) {
+        manager->setCacheDirectory(cacheDir);
+    }
+
+    auto start = Clock::now();
+    manager->discoverSceneries();
+    manager->load();
+    std::printf("  load                     %9.1f ms, peak memory %.1f MB\n", millisSince(start), peakMemoryMB());
+    printPhases(*manager);
+
+    auto world = manager->getWorld();
+    std::vector<std::pair<std::string, std::string>> fixIds;
+    benchViewports(*world, fixIds);
+    benchSearches(*world, fixIds);
+    benchRoutes(*world);
+    std::printf("  peak memory              %9.1f MB\n", peakMemoryMB());
+}
+
+} /* namespace */
+
+int main(int argc, char *argv[]) {
+    std::string xplaneRoot, navDbDir, cacheDir;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--xplane") {
+            xplaneRoot = argv[i + 1];
+        } else if (arg == "--navdb") {
+            navDbDir = argv[i + 1];
+        } else if (arg == "--cache") {
+            cacheDir = argv[i + 1];
+        }
+    }
+
+    if (xplaneRoot.empty() && navDbDir.empty()) {
+        std::fprintf(stderr, "Usage: %s [--xplane <X-Plane root>] [--navdb <navdb directory>] [--cache <directory>]\n", argv[0]);
+        return 1;
+    }
+
+    try {
+        if (!xplaneRoot.empty()) {
+            run("XWorld " + xplaneRoot, std::make_shared<xdata::XData>(xplaneRoot), cacheDir);
+        }
+        if (!navDbDir.empty()) {
+            auto manager = std::make_shared<sqlnav::SqlLoadManager>(navDbDir);
+            manager->init_or_throw([] (const std::string simCode) { return true; });
+            run("SqlWorld " + navDbDir, manager, cacheDir);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
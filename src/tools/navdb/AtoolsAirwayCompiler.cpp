@@ -25,6 +25,7 @@ AtoolsDbAirwayCompiler::AtoolsDbAirwayCompiler(std::shared_ptr<sqlnav::SqlDataba
 {
     awyvals = std::make_unique<std::ostringstream>();
     fixawyvals = std::make_unique<std::ostringstream>();
+    legvals = std::make_unique<std::ostringstream>();
 }
 
 AtoolsDbAirwayCompiler::~AtoolsDbAirwayCompiler()
@@ -105,6 +106,11 @@ void AtoolsDbAirwayCompiler::generate(FixSequence &legs)
         *fixawyvals << "(" << f << "," << id << "),";
     }
 
+    // the sequence is in the direction of travel, so each leg is a directed edge of the graph
+    for (auto f = legs.begin(), t = std::next(legs.begin()); t != legs.end(); ++f, ++t) {
+        *legvals << "(" << *f << "," << *t << "," << id << "),";
+    }
+
     // code here to generate value insertions for the tables
     auto initialFix = legs.front();
     legs.pop_front();
@@ -130,4 +136,6 @@ void AtoolsDbAirwayCompiler::update()
     awyvals = std::make_unique<std::ostringstream>();
     o->exec_insert("fix_airway", fixawyvals->str());
     fixawyvals = std::make_unique<std::ostringstream>();
+    o->exec_insert("airway_leg", legvals->str());
+    legvals = std::make_unique<std::ostringstream>();
 }
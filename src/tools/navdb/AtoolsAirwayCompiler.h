@@ -51,6 +51,7 @@ private:
     int rowCount;
     std::unique_ptr<std::ostringstream> awyvals;
     std::unique_ptr<std::ostringstream> fixawyvals;
+    std::unique_ptr<std::ostringstream> legvals;
 
     std::string name;
     std::string type;
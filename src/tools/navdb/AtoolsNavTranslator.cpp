@@ -20,37 +20,64 @@
 #include <map>
 #include <cmath>
 #include <sstream>
-#include <iomanip>
 #include <vector>
 #include <algorithm>
+#include <future>
+#include <filesystem>
 #include "AtoolsNavTranslator.h"
 #include "AtoolsProcCompiler.h"
 #include "AtoolsAirwayCompiler.h"
 #include "src/libnavsql/SqlStatement.h"
+#include "src/libnavsql/SqlLoadManager.h"
 #include "src/Logger.h"
 
-static inline std::string quoted(std::string &s);
+template<typename... COLS>
+static inline void insert_row(std::shared_ptr<sqlnav::SqlStatement> &ins, COLS... cols);
 
-AtoolsDbNavTranslator::AtoolsDbNavTranslator(std::shared_ptr<sqlnav::SqlDatabase> o, std::shared_ptr<sqlnav::SqlDatabase> i)
-:   avi(o), lnm(i), next_fix_id(1)
+AtoolsDbNavTranslator::AtoolsDbNavTranslator(std::shared_ptr<sqlnav::SqlDatabase> o, std::shared_ptr<sqlnav::SqlDatabase> i, const std::string &ipath)
+:   avi(o), lnm(i), lnmPath(ipath), next_fix_id(1)
 {
 }
 
 void AtoolsDbNavTranslator::translate()
 {
+    // the tables are populated in two large transactions. the first loads the
+    // extracted tables before any index exists, the indexes are then built in
+    // one pass each before the procedures and airways are compiled, since those
+    // stages look up runways and fixes in the new database.
+    run_script("BEGIN TRANSACTION;", "start transaction");
     compile_metadata();
+
+    // the com, start and ILS tables don't allocate fix IDs, so they are read on their
+    // own source connections while the waypoints and navaids are extracted in order.
+    auto readSource = [this] (auto reader) {
+        return std::async(std::launch::async, [this, reader] {
+            return reader(std::make_shared<sqlnav::SqlDatabase>(lnmPath, true));
+        });
+    };
+    auto comms = readSource(&AtoolsDbNavTranslator::read_comms);
+    auto starts = readSource(&AtoolsDbNavTranslator::read_starts);
+    auto ilss = readSource(&AtoolsDbNavTranslator::read_ilss);
+
     extract_waypoints();
     extract_airports();
-    extract_comms();
     extract_runways();
-    extract_starts();
-    extract_ilss();
     extract_vors();
     extract_ndbs();
+    extract_comms(comms.get());
+    extract_starts(starts.get());
+    extract_ilss(ilss.get());
+    run_script("COMMIT;", "commit extracted tables");
+
+    std::cout << "Building indexes ..." << std::endl;
+    avi->createIndexes();
+
+    run_script("BEGIN TRANSACTION;", "start transaction");
     compile_procedures();
     compile_airways();
     compile_regions();
     compile_grid_counts();
+    run_script("COMMIT;", "commit compiled tables");
     optimize();
 }
 
@@ -71,6 +98,28 @@ void AtoolsDbNavTranslator::exec_insert(const std::string &table, const std::str
     }
 }
 
+std::shared_ptr<sqlnav::SqlStatement> AtoolsDbNavTranslator::prepare_insert(const std::string &table, int columns)
+{
+    std::ostringstream sql;
+    sql << "INSERT INTO " << table << " VALUES (";
+    for (int c = 1; c <= columns; ++c) {
+        sql << ((c > 1) ? ",?" : "?") << c;
+    }
+    sql << ");";
+    return avi->compile(sql.str());
+}
+
+void AtoolsDbNavTranslator::run_script(const std::string &script, const std::string &what)
+{
+    std::string errMsg;
+    int e = avi->runscript(script, errMsg);
+    if (e != 0) {
+        std::cerr << "Error code " << e << " when trying to " << what << std::endl;
+        std::cerr << "Message was: " << errMsg << std::endl;
+        throw std::runtime_error("Avitab database write error");
+    }
+}
+
 void AtoolsDbNavTranslator::compile_metadata()
 {
     // read the LNM metadata to make sure we recognise the version,
@@ -96,9 +145,8 @@ void AtoolsDbNavTranslator::compile_metadata()
         throw std::runtime_error("Unsupported LNM database source");
     }
 
-    std::ostringstream sql;
-    sql << "(2,'" << source << "','LNM');";
-    exec_insert("metadata", sql.str());
+    auto ins = prepare_insert("metadata", 3);
+    insert_row(ins, sqlnav::NAV_DB_VERSION, source, std::string("LNM"));
 }
 
 void AtoolsDbNavTranslator::extract_waypoints()
@@ -108,8 +156,8 @@ void AtoolsDbNavTranslator::extract_waypoints()
     // is used by Avitab for all non-airport point locations.
 
     std::cout << "Will extract waypoints (fixes) ..." << std::endl;
-    std::unique_ptr<std::ostringstream> fixvals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> gsvals = std::make_unique<std::ostringstream>();
+    auto fix_ins = prepare_insert("fix", 8);
+    auto gs_ins = prepare_insert("grid_search", 4);
     int rows = 0;
     int max_fix_id = 0;
 
@@ -135,33 +183,23 @@ void AtoolsDbNavTranslator::extract_waypoints()
 
         if (fix_id > max_fix_id) { max_fix_id = fix_id; }
 
-        *fixvals << std::setprecision(8)
-            << "(" << fix_id << "," << airport_id << "," << nav_id << ",'"
-            << quoted(ident) << "','" << quoted(region) << "','" << quoted(type) << "'," << lonx << "," << laty << "),";
+        insert_row(fix_ins, fix_id, airport_id, nav_id, ident, region, type, lonx, laty);
 
         if (airport_id) {
             add_airport_fix(airport_id, ident, fix_id);
         } else {
             add_global_region_fix(region, ident, fix_id);
+            add_global_fix_location(ident, fix_id, lonx, laty);
 
             // only fixes that are not associated with an airport are returned in the grid searches.
             int ilonx = (int)std::floor(lonx);
             int ilaty = (int)std::floor(laty);
-            *gsvals << "(" << ilonx << "," << ilaty << ",0," << fix_id << "),";
+            insert_row(gs_ins, ilonx, ilaty, 0, fix_id);
 
             add_grid_area_node(ilonx, ilaty);
         }
-
-        if ((++rows % 1000) == 0) {
-            exec_insert("fix", fixvals->str());
-            fixvals = std::make_unique<std::ostringstream>();
-            exec_insert("grid_search", gsvals->str());
-            gsvals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from fixes table" << std::endl;
-        }
+        ++rows;
     }
-    exec_insert("fix", fixvals->str());
-    exec_insert("grid_search", gsvals->str());
     next_fix_id = max_fix_id + 1;
     std::cout << "Extracted " << rows << " waypoints. (Next fix id will be " << next_fix_id << ")" << std::endl;
 }
@@ -172,9 +210,9 @@ void AtoolsDbNavTranslator::extract_airports()
     // into the Avitab DB. Also add an entry to the grid_search table, and a fix (may be used in procedures).
 
     std::cout << "Will extract airports ..." << std::endl;
-    std::unique_ptr<std::ostringstream> avals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> fixvals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> gsvals = std::make_unique<std::ostringstream>();
+    auto apt_ins = prepare_insert("airport", 8);
+    auto fix_ins = prepare_insert("fix", 8);
+    auto gs_ins = prepare_insert("grid_search", 4);
     int rows = 0;
 
     auto lnm_qry = lnm->compile(
@@ -199,46 +237,24 @@ void AtoolsDbNavTranslator::extract_airports()
         int ilonx = (int)std::floor(lonx);
         int ilaty = (int)std::floor(laty);
 
-        *avals << std::setprecision(8)
-            << "(" << id << ",'" << quoted(ident) << "','" << quoted(name) << "','"
-            << quoted(region) << "','" << quoted(country) << "'," << altitude << "," << lonx << "," << laty << "),";
+        insert_row(apt_ins, id, ident, name, region, country, altitude, lonx, laty);
 
         auto fix_id = next_fix_id++;
         add_global_region_fix(region, ident, fix_id);
-        *fixvals << "(" << fix_id << "," << id << ",0,'"
-            << quoted(ident) << "','" << quoted(region) << "','A'," << lonx << "," << laty << "),";
+        insert_row(fix_ins, fix_id, id, 0, ident, region, std::string("A"), lonx, laty);
 
-        *gsvals << "(" << ilonx << "," << ilaty << "," << id << ",0),";
+        insert_row(gs_ins, ilonx, ilaty, id, 0);
 
         add_grid_area_node(ilonx, ilaty);
-
-        if ((++rows % 1000) == 0) {
-            // insert every 1000 transactions
-            exec_insert("airport", avals->str());
-            avals = std::make_unique<std::ostringstream>();
-            exec_insert("fix", fixvals->str());
-            fixvals = std::make_unique<std::ostringstream>();
-            exec_insert("grid_search", gsvals->str());
-            gsvals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from airports table" << std::endl;
-        }
+        ++rows;
     }
-    exec_insert("airport", avals->str());
-    exec_insert("fix", fixvals->str());
-    exec_insert("grid_search", gsvals->str());
     std::cout << "Extracted " << rows << " airports. (Next fix id will be " << next_fix_id << ")" << std::endl;
 }
 
-void AtoolsDbNavTranslator::extract_comms()
+std::vector<AtoolsDbNavTranslator::ComRow> AtoolsDbNavTranslator::read_comms(std::shared_ptr<sqlnav::SqlDatabase> src)
 {
-    // read all of the LNM com table records and copy required columns only
-    // into the Avitab DB.
-
-    std::cout << "Will extract comms ..." << std::endl;
-    std::unique_ptr<std::ostringstream> vals = std::make_unique<std::ostringstream>();
-    int rows = 0;
-
-    auto lnm_qry = lnm->compile("SELECT airport_id, type, frequency, name FROM com;");
+    std::vector<ComRow> rows;
+    auto lnm_qry = src->compile("SELECT airport_id, type, frequency, name FROM com;");
     lnm_qry->initialize();
     while (1) {
         int r = lnm_qry->step();
@@ -248,25 +264,25 @@ void AtoolsDbNavTranslator::extract_comms()
             throw std::runtime_error("LNM database read error");
         }
         auto id = lnm_qry->getInt(0);
-        auto type = lnm_qry->getString(1);
-        auto frequency = lnm_qry->getInt(2);
-        auto name = lnm_qry->getString(3);
-
         if (!id) {
             logger::info("COM table entry has invalid airport ID");
             continue;
         }
+        rows.push_back({id, lnm_qry->getString(1), lnm_qry->getInt(2), lnm_qry->getString(3)});
+    }
+    return rows;
+}
 
-        *vals << "(" << id << ",'" << type << "'," << frequency << ",'" << quoted(name) << "'),";
+void AtoolsDbNavTranslator::extract_comms(const std::vector<ComRow> &rows)
+{
+    // copy the LNM com table records, read in the background, into the Avitab DB.
 
-        if ((++rows % 1000) == 0) {
-            exec_insert("com", vals->str());
-            vals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from coms table" << std::endl;
-        }
+    std::cout << "Will extract comms ..." << std::endl;
+    auto ins = prepare_insert("com", 4);
+    for (auto &c: rows) {
+        insert_row(ins, c.airport_id, c.type, c.frequency, c.name);
     }
-    exec_insert("com", vals->str());
-    std::cout << "Extracted " << rows << " com entries." << std::endl;
+    std::cout << "Extracted " << rows.size() << " com entries." << std::endl;
 }
 
 inline std::string normalizeRunwayName(std::string rwyIdent)
@@ -284,8 +300,8 @@ void AtoolsDbNavTranslator::extract_runways()
     // into the Avitab DB.
 
     std::cout << "Will extract runways ..." << std::endl;
-    std::unique_ptr<std::ostringstream> rvals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> fixvals = std::make_unique<std::ostringstream>();
+    auto rwy_ins = prepare_insert("runway", 13);
+    auto fix_ins = prepare_insert("fix", 8);
     int rows = 0;
 
     auto lnm_qry = lnm->compile(
@@ -334,50 +350,32 @@ void AtoolsDbNavTranslator::extract_runways()
         auto primaryFixId = next_fix_id++;
         std::string primaryFixName = std::string("RW") + primaryName;
         add_airport_fix(airportId, primaryFixName, primaryFixId);
-        *fixvals << std::setprecision(8)
-            << "(" << primaryFixId << "," << airportId << ",0,'"
-            << primaryFixName << "','" << quoted(region) << "','R'," << primaryLonx << "," << primaryLaty << "),";
+        insert_row(fix_ins, primaryFixId, airportId, 0, primaryFixName, region, std::string("R"), primaryLonx, primaryLaty);
 
         auto oppositeFixId = next_fix_id++;
         std::string oppositeFixName = std::string("RW") + oppositeName;
         add_airport_fix(airportId, oppositeFixName, oppositeFixId);
-        *fixvals << std::setprecision(8)
-            << "(" << oppositeFixId << "," << airportId << ",0,'"
-            << oppositeFixName << "','" << quoted(region) << "','R'," << oppositeLonx << "," << oppositeLaty << "),";
+        insert_row(fix_ins, oppositeFixId, airportId, 0, oppositeFixName, region, std::string("R"), oppositeLonx, oppositeLaty);
 
         // create 2 rows in the Avitab runway database, 1 for each runway direction
-        *rvals << std::setprecision(8)
-            << "(" << primaryId << ",'" << primaryName << "'," << airportId << "," << oppositeId << "," << primaryFixId << ","
-            << length << "," << width << ",'" << surface << "',"
-            << primaryHeading << "," << primaryAltitude << "," << primaryOffset << "," << primaryLonx << "," << primaryLaty << "),";
-        *rvals << std::setprecision(8)
-            << "(" << oppositeId << ",'" << oppositeName << "'," << airportId << "," << primaryId << "," << oppositeFixId << ","
-            << length << "," << width << ",'" << surface << "',"
-            << oppositeHeading << "," << oppositeAltitude << "," << oppositeOffset << "," << oppositeLonx << "," << oppositeLaty << "),";
-
-        if ((++rows % 500) == 0) {
-            exec_insert("runway", rvals->str());
-            rvals = std::make_unique<std::ostringstream>();
-            exec_insert("fix", fixvals->str());
-            fixvals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from runways table" << std::endl;
-        }
+        insert_row(rwy_ins, primaryId, primaryName, airportId, oppositeId, primaryFixId,
+                   length, width, surface,
+                   primaryHeading, primaryAltitude, primaryOffset, primaryLonx, primaryLaty);
+        insert_row(rwy_ins, oppositeId, oppositeName, airportId, primaryId, oppositeFixId,
+                   length, width, surface,
+                   oppositeHeading, oppositeAltitude, oppositeOffset, oppositeLonx, oppositeLaty);
+
+        add_runway_location({primaryId, airportId, oppositeId, primaryHeading, primaryLonx, primaryLaty});
+        add_runway_location({oppositeId, airportId, primaryId, oppositeHeading, oppositeLonx, oppositeLaty});
+        ++rows;
     }
-    exec_insert("runway", rvals->str());
-    exec_insert("fix", fixvals->str());
     std::cout << "Extracted " << rows << " runways pairs. (Next fix id will be " << next_fix_id << ")" << std::endl;
 }
 
-void AtoolsDbNavTranslator::extract_starts()
+std::vector<AtoolsDbNavTranslator::StartRow> AtoolsDbNavTranslator::read_starts(std::shared_ptr<sqlnav::SqlDatabase> src)
 {
-    // read all of the LNM start table records and copy required columns only
-    // into the Avitab DB.
-
-    std::cout << "Will extract starts ..." << std::endl;
-    std::unique_ptr<std::ostringstream> vals = std::make_unique<std::ostringstream>();
-    int rows = 0;
-
-    auto lnm_qry = lnm->compile(
+    std::vector<StartRow> rows;
+    auto lnm_qry = src->compile(
         "SELECT airport_id, type, number, lonx, laty FROM start;"
     );
     lnm_qry->initialize();
@@ -389,42 +387,32 @@ void AtoolsDbNavTranslator::extract_starts()
             throw std::runtime_error("LNM database read error");
         }
         auto airport_id = lnm_qry->getInt(0);
-        auto type = lnm_qry->getString(1);
-        auto number = lnm_qry->getInt(2);
-        auto lonx = lnm_qry->getDouble(3);
-        auto laty = lnm_qry->getDouble(4);
-
         if (!airport_id) {
             logger::info("Start table entry has invalid airport ID");
             continue;
         }
-
-        *vals << std::setprecision(8) << "(" << airport_id << ",'" << type << "'," << number << "," << lonx << "," << laty << "),";
-
-        if ((++rows % 1000) == 0) {
-            exec_insert("start", vals->str());
-            vals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from starts table" << std::endl;
-        }
+        rows.push_back({airport_id, lnm_qry->getString(1), lnm_qry->getInt(2), lnm_qry->getDouble(3), lnm_qry->getDouble(4)});
     }
-    exec_insert("start", vals->str());
-    std::cout << "Extracted " << rows << " starts." << std::endl;
+    return rows;
 }
 
-void AtoolsDbNavTranslator::extract_ilss()
+void AtoolsDbNavTranslator::extract_starts(const std::vector<StartRow> &rows)
 {
-    // read all of the LNM ILS table records and copy required columns only
-    // into the Avitab DB.
-
-    // LNM databases have some ILS records without valid airport or runway end entries.
-    std::vector<int> floatingILS;
+    // copy the LNM start table records, read in the background, into the Avitab DB.
 
-    std::cout << "Will extract ILSs ..." << std::endl;
-    std::unique_ptr<std::ostringstream> vals = std::make_unique<std::ostringstream>();
-    int rows = 0;
+    std::cout << "Will extract starts ..." << std::endl;
+    auto ins = prepare_insert("start", 5);
+    for (auto &s: rows) {
+        insert_row(ins, s.airport_id, s.type, s.number, s.lonx, s.laty);
+    }
+    std::cout << "Extracted " << rows.size() << " starts." << std::endl;
+}
 
-    auto lnm_qry = lnm->compile(
-        "SELECT i.ils_id, i.ident, i.name, i.loc_airport_ident, a.airport_id, i.loc_runway_end_id, "
+std::vector<AtoolsDbNavTranslator::IlsRow> AtoolsDbNavTranslator::read_ilss(std::shared_ptr<sqlnav::SqlDatabase> src)
+{
+    std::vector<IlsRow> rows;
+    auto lnm_qry = src->compile(
+        "SELECT i.ils_id, i.ident, i.name, a.airport_id, i.loc_runway_end_id, "
                 "i.lonx, i.laty, i.frequency, i.loc_heading, i.mag_var, i.range, i.dme_range "
         "FROM ils AS i LEFT JOIN airport AS a ON i.loc_airport_ident = a.ident;"
     );
@@ -436,46 +424,51 @@ void AtoolsDbNavTranslator::extract_ilss()
             std::cerr << "Error code " << r << " when reading LNM ILS table" << std::endl;
             throw std::runtime_error("LNM database read error");
         }
-        auto ils_id = lnm_qry->getInt(0);
-        auto ident = lnm_qry->getString(1);
-        auto name = lnm_qry->getString(2);
-        auto loc_airport_ident = lnm_qry->getString(3);
-        auto airport_id = lnm_qry->getInt(4);
-        auto loc_runway_end_id = lnm_qry->getInt(5);
-        auto lonx = lnm_qry->getDouble(6);
-        auto laty = lnm_qry->getDouble(7);
-        auto frequency = lnm_qry->getInt(8);
-        auto loc_heading = lnm_qry->getDouble(9);
-        auto mag_var = lnm_qry->getDouble(10);
-        auto range = lnm_qry->getInt(11);
-        auto dme_range = lnm_qry->getInt(12);
+        IlsRow i;
+        i.ils_id = lnm_qry->getInt(0);
+        i.ident = lnm_qry->getString(1);
+        i.name = lnm_qry->getString(2);
+        i.airport_id = lnm_qry->getInt(3);
+        i.runway_id = lnm_qry->getInt(4);
+        i.lonx = lnm_qry->getDouble(5);
+        i.laty = lnm_qry->getDouble(6);
+        i.frequency = lnm_qry->getInt(7);
+        i.loc_heading = lnm_qry->getDouble(8);
+        i.mag_var = lnm_qry->getDouble(9);
+        i.range = lnm_qry->getInt(10);
+        i.dme_range = lnm_qry->getInt(11);
+        rows.push_back(i);
+    }
+    return rows;
+}
+
+void AtoolsDbNavTranslator::extract_ilss(const std::vector<IlsRow> &rows)
+{
+    // copy the LNM ILS table records, read in the background, into the Avitab DB.
+
+    // LNM databases have some ILS records without valid airport or runway end entries.
+    std::vector<const IlsRow *> floatingILS;
 
+    std::cout << "Will extract ILSs ..." << std::endl;
+    auto ins = prepare_insert("ils", 12);
+    for (auto &i: rows) {
         // insert the ILS record even if it is incomplete, it will be updated later
-        *vals << std::setprecision(8)
-            << "(" << ils_id << ",'" << ident << "','" << name << "'," << airport_id << ","
-            << loc_runway_end_id << "," << lonx << "," << laty << "," << frequency << "," << loc_heading << ","
-            << mag_var << "," << range << "," << dme_range << "),";
+        insert_row(ins, i.ils_id, i.ident, i.name, i.airport_id, i.runway_id, i.lonx, i.laty,
+                   i.frequency, i.loc_heading, i.mag_var, i.range, i.dme_range);
 
         // if the table links are incomplete add this to the list for later fxing up
-        if (!airport_id || !loc_runway_end_id) {
-            floatingILS.push_back(ils_id);
-        }
-
-        if ((++rows % 1000) == 0) {
-            exec_insert("ils", vals->str());
-            vals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from ILS table" << std::endl;
+        if (!i.airport_id || !i.runway_id) {
+            floatingILS.push_back(&i);
         }
     }
-    exec_insert("ils", vals->str());
     std::cout << "Looking for airports for " << floatingILS.size() << " orphaned ILSs ..." << std::endl;
     logger::info("ILS source data has %d orphans (no airport) - will attempt adoptions.", floatingILS.size());
     int fixed = 0;
-    for (auto ils_id: floatingILS) {
-        fixed += fixup_ils(ils_id);
+    for (auto ils: floatingILS) {
+        fixed += fixup_ils(*ils);
     }
 
-    std::cout << "Extracted " << rows << " ILSs "
+    std::cout << "Extracted " << rows.size() << " ILSs "
             << "(fixed " << fixed << " of " << floatingILS.size() << " without a designated airport)." << std::endl;
 }
 
@@ -485,9 +478,9 @@ void AtoolsDbNavTranslator::extract_vors()
     // into the Avitab DB.
 
     std::cout << "Will extract VORs ..." << std::endl;
-    std::unique_ptr<std::ostringstream> vals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> fixvals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> gsvals = std::make_unique<std::ostringstream>();
+    auto vor_ins = prepare_insert("vor", 12);
+    auto fix_ins = prepare_insert("fix", 8);
+    auto gs_ins = prepare_insert("grid_search", 4);
     int rows = 0;
 
     auto lnm_qry = lnm->compile(
@@ -514,42 +507,28 @@ void AtoolsDbNavTranslator::extract_vors()
         auto mag_var = lnm_qry->getDouble(10);
         auto dme_only = lnm_qry->getInt(11);
 
-        *vals << std::setprecision(8)
-            << "(" << id << ",'" << ident << "','" << quoted(name) << "','"
-            << region << "'," << airport_id << ",'" << type << "'," << lonx << "," << laty << ","
-            << frequency << "," << range << "," << mag_var << "," << dme_only << "),";
+        insert_row(vor_ins, id, ident, name, region, airport_id, type, lonx, laty,
+                   frequency, range, mag_var, dme_only);
 
         if (!global_region_fix(region, ident)) {
             // create a new fix for this VOR - it isn't associated with a waypoint
             auto fix_id = next_fix_id++;
-            *fixvals << std::setprecision(8)
-                << "(" << fix_id << "," << airport_id << "," << id << ",'"
-                << quoted(ident) << "','" << quoted(region) << "','V'," << lonx << "," << laty << "),";
+            insert_row(fix_ins, fix_id, airport_id, id, ident, region, std::string("V"), lonx, laty);
             add_global_region_fix(region, ident, fix_id);
 
             if (airport_id == 0) {
+                add_global_fix_location(ident, fix_id, lonx, laty);
+
                 // only fixes that are not associated with an airport are returned in the grid searches.
                 int ilonx = (int)std::floor(lonx);
                 int ilaty = (int)std::floor(laty);
-                *gsvals << "(" << ilonx << "," << ilaty << ",0," << fix_id << "),";
+                insert_row(gs_ins, ilonx, ilaty, 0, fix_id);
 
                 add_grid_area_node(ilonx, ilaty);
             }
         }
-
-        if ((++rows % 1000) == 0) {
-            exec_insert("vor", vals->str());
-            vals = std::make_unique<std::ostringstream>();
-            exec_insert("fix", fixvals->str());
-            fixvals = std::make_unique<std::ostringstream>();
-            exec_insert("grid_search", gsvals->str());
-            gsvals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from VOR/DME table" << std::endl;
-        }
+        ++rows;
     }
-    exec_insert("vor", vals->str());
-    exec_insert("fix", fixvals->str());
-    exec_insert("grid_search", gsvals->str());
     std::cout << "Extracted " << rows << " VOR/DMEs. (Next fix id will be " << next_fix_id << ")" << std::endl;
 }
 
@@ -559,9 +538,9 @@ void AtoolsDbNavTranslator::extract_ndbs()
     // into the Avitab DB.
 
     std::cout << "Will extract NDBs ..." << std::endl;
-    std::unique_ptr<std::ostringstream> vals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> fixvals = std::make_unique<std::ostringstream>();
-    std::unique_ptr<std::ostringstream> gsvals = std::make_unique<std::ostringstream>();
+    auto ndb_ins = prepare_insert("ndb", 10);
+    auto fix_ins = prepare_insert("fix", 8);
+    auto gs_ins = prepare_insert("grid_search", 4);
     int rows = 0;
 
     auto lnm_qry = lnm->compile(
@@ -586,42 +565,28 @@ void AtoolsDbNavTranslator::extract_ndbs()
         auto range = lnm_qry->getInt(8);
         auto mag_var = lnm_qry->getDouble(9);
 
-        *vals << std::setprecision(8)
-            << "(" << id << ",'" << ident << "','" << quoted(name) << "','"
-            << region << "'," << airport_id << "," << lonx << "," << laty << ","
-            << frequency << "," << range << "," << mag_var << "),";
+        insert_row(ndb_ins, id, ident, name, region, airport_id, lonx, laty,
+                   frequency, range, mag_var);
 
         if (!global_region_fix(region, ident)) {
             // create a new fix for this NDB - it isn't associated with a waypoint
             auto fix_id = next_fix_id++;
-            *fixvals << std::setprecision(8)
-                << "(" << fix_id << "," << airport_id << "," << id << ",'"
-                << quoted(ident) << "','" << quoted(region) << "','V'," << lonx << "," << laty << "),";
+            insert_row(fix_ins, fix_id, airport_id, id, ident, region, std::string("V"), lonx, laty);
             add_global_region_fix(region, ident, fix_id);
 
             if (airport_id == 0) {
+                add_global_fix_location(ident, fix_id, lonx, laty);
+
                 // only fixes that are not associated with an airport are returned in the grid searches.
                 int ilonx = (int)std::floor(lonx);
                 int ilaty = (int)std::floor(laty);
-                *gsvals << "(" << ilonx << "," << ilaty << ",0," << fix_id << "),";
+                insert_row(gs_ins, ilonx, ilaty, 0, fix_id);
 
                 add_grid_area_node(ilonx, ilaty);
             }
         }
-
-        if ((++rows % 1000) == 0) {
-            exec_insert("ndb", vals->str());
-            vals = std::make_unique<std::ostringstream>();
-            exec_insert("fix", fixvals->str());
-            fixvals = std::make_unique<std::ostringstream>();
-            exec_insert("grid_search", gsvals->str());
-            gsvals = std::make_unique<std::ostringstream>();
-            //std::cout << "Copied " << rows << " rows from NDB table" << std::endl;
-        }
+        ++rows;
     }
-    exec_insert("ndb", vals->str());
-    exec_insert("fix", fixvals->str());
-    exec_insert("grid_search", gsvals->str());
     std::cout << "Extracted " << rows << " NDBs. (Next fix id will be " << next_fix_id << ")" << std::endl;
 }
 
@@ -648,9 +613,6 @@ void AtoolsDbNavTranslator::compile_procedures()
                             "INNER JOIN airport AS a ON r.airport_id = a.airport_id "
                             "WHERE r.airport_id = ?1 ;");
 
-    fix_qry = avi->compile("SELECT fix_id, lonx, laty "
-                           "FROM fix WHERE ident = ?1 AND airport_id = 0;");
-
     auto prq = lnm->compile("SELECT approach_id, arinc_name, type, suffix, runway_name, fix_type, fix_region, fix_ident "
                             "FROM approach WHERE airport_id = ?1;");
 
@@ -838,29 +800,23 @@ void AtoolsDbNavTranslator::compile_airways()
 
 void AtoolsDbNavTranslator::compile_regions()
 {
-    std::ostringstream sql;
+    auto ins = prepare_insert("region", 1);
     int rows = 0;
     for (auto ri: global_region_fix_ids) {
-        sql << "('" << ri.first << "'),";
+        insert_row(ins, ri.first);
         ++rows;
     }
-    exec_insert("region", sql.str());
     std::cout << "Compiled " << rows << " regions." << std::endl;
 }
 
 void AtoolsDbNavTranslator::compile_grid_counts()
 {
-    std::unique_ptr<std::ostringstream> vals = std::make_unique<std::ostringstream>();
+    auto ins = prepare_insert("grid_count", 3);
     int rows = 0;
     for (auto gci: grid_totals) {
-        *vals << "(" << gci.first.first << "," << gci.first.second << "," << gci.second << "),";
-        if ((++rows % 1000) == 0) {
-            exec_insert("grid_count", vals->str());
-            vals = std::make_unique<std::ostringstream>();
-            //std::cout << "Written " << rows << " rows to grid_count table" << std::endl;
-        }
+        insert_row(ins, gci.first.first, gci.first.second, gci.second);
+        ++rows;
     }
-    exec_insert("grid_count", vals->str());
     std::cout << "Compiled " << rows << " grid area counts." << std::endl;
 }
 
@@ -878,145 +834,370 @@ void AtoolsDbNavTranslator::optimize()
     std::cout << "Finished by optimizing Avitab NAV database - now ready for use." << std::endl;
 }
 
-int AtoolsDbNavTranslator::fixup_ils(int ils_id)
+bool AtoolsDbNavTranslator::can_apply_delta(const std::string &previousPath)
 {
-    // this ILS record didn't have IDs for the airport and/or runway that it is associated with
-    // we try to figure out where is belongs by using lon/lat searches (and possibly other info?)
+    if (!std::filesystem::exists(previousPath)) {
+        return false;
+    }
+    try {
+        auto prev = std::make_shared<sqlnav::SqlDatabase>(previousPath, true);
+        auto qry = prev->compile("SELECT db_version FROM metadata;");
+        qry->initialize();
+        if (qry->step()) {
+            return false;
+        }
+        return qry->getInt(0) == sqlnav::NAV_DB_VERSION;
+    } catch (const std::exception &e) {
+        std::cerr << "Can't read previous Avitab database: " << e.what() << std::endl;
+        return false;
+    }
+}
 
-    // first get the ILS lon/lat and heading for the ILS
-    auto ils_qry = avi->compile("SELECT ident, lonx, laty, loc_heading FROM ils WHERE ils_id = ?1;");
-    ils_qry->initialize();
-    ils_qry->bind(1, ils_id);
-    int r = ils_qry->step();
-    if (r) {
-        std::cerr << "Error code " << r << " when reading ILS table for fixing up" << std::endl;
-        throw std::runtime_error("Avitab database read error");
+void AtoolsDbNavTranslator::apply_delta(const std::string &previousPath)
+{
+    // the tables whose rows have ids, in the order of their references. the fixes
+    // refer to airports, runways and procedures to fixes and so on.
+    static const std::vector<KeyedTable> keyedTables = {
+        {"airport", "airport_id", {{"ident", nullptr}}},
+        {"vor", "vor_id", {{"ident", nullptr}, {"region", nullptr}, {"type", nullptr}, {"airport_id", "airport"}}},
+        {"ndb", "ndb_id", {{"ident", nullptr}, {"region", nullptr}, {"airport_id", "airport"}}},
+        {"fix", "fix_id", {{"ident", nullptr}, {"region", nullptr}, {"type", nullptr}, {"airport_id", "airport"}}},
+        {"runway", "runway_id", {{"airport_id", "airport"}, {"name", nullptr}}},
+        {"ils", "ils_id", {{"airport_id", "airport"}, {"ident", nullptr}}},
+        {"procedure", "procedure_id", {{"airport_id", "airport"}, {"type", nullptr}, {"name", nullptr}, {"runway_name", nullptr}}},
+        {"transition", "transition_id", {{"procedure_id", "procedure"}, {"name", nullptr}}},
+        {"airway", "airway_id", {{"name", nullptr}, {"type", nullptr}, {"initial_fix_id", "fix"}, {"final_fix_id", "fix"}}},
+    };
+
+    // grid_count is derived from grid_search, so it is refreshed afterwards
+    static const std::vector<DeltaTable> deltaTables = {
+        {"metadata", "db_version", {}},
+        {"airport", "airport_id", {{"airport_id", "airport"}}},
+        {"com", "airport_id", {{"airport_id", "airport"}}},
+        {"start", "airport_id", {{"airport_id", "airport"}}},
+        {"vor", "vor_id", {{"vor_id", "vor"}, {"airport_id", "airport"}}},
+        {"ndb", "ndb_id", {{"ndb_id", "ndb"}, {"airport_id", "airport"}}},
+        {"fix", "fix_id", {{"fix_id", "fix"}, {"airport_id", "airport"}, {"nav_id", "navaid"}}},
+        {"runway", "runway_id", {{"runway_id", "runway"}, {"airport_id", "airport"}, {"runway_pair_id", "runway"}, {"fix_id", "fix"}}},
+        {"ils", "ils_id", {{"ils_id", "ils"}, {"airport_id", "airport"}, {"runway_id", "runway"}}},
+        {"grid_search", "ilonx, ilaty", {{"airport_id", "airport"}, {"fix_id", "fix"}}},
+        {"region", "name", {}},
+        {"procedure", "procedure_id", {{"procedure_id", "procedure"}, {"airport_id", "airport"}, {"initial_fix_id", "fix"}, {"final_fix_id", "fix"}}},
+        {"transition", "transition_id", {{"transition_id", "transition"}, {"procedure_id", "procedure"}, {"initial_fix_id", "fix"}, {"final_fix_id", "fix"}}},
+        {"airway", "airway_id", {{"airway_id", "airway"}, {"initial_fix_id", "fix"}, {"final_fix_id", "fix"}}},
+        {"fix_airway", "airway_id", {{"fix_id", "fix"}, {"airway_id", "airway"}}},
+        {"airway_leg", "airway_id", {{"from_fix_id", "fix"}, {"to_fix_id", "fix"}, {"airway_id", "airway"}}},
+    };
+
+    std::cout << "Will apply differences to " << previousPath << " ..." << std::endl;
+    std::string quotedPath;
+    for (char c: previousPath) {
+        quotedPath += c;
+        if (c == '\'') quotedPath += c;
+    }
+    run_script("ATTACH DATABASE '" + quotedPath + "' AS prev;", "attach previous database");
+
+    // replaced rows are deleted before their dependents, so foreign keys are only checked at the end
+    run_script("BEGIN TRANSACTION; PRAGMA defer_foreign_keys = ON;", "start transaction");
+    for (auto &t: keyedTables) {
+        map_stable_ids(t);
     }
-    auto ilsident = ils_qry->getString(0);
-    auto lonx = ils_qry->getDouble(1);
-    auto laty = ils_qry->getDouble(2);
-    auto loc_heading = ils_qry->getDouble(3);
-
-    int ils_heading = ((int)loc_heading % 360);
-
-    struct columns {
-        int rid, aid, pid;
-        std::string name;
-        std::string aident;
-        double heading, lonx, laty;
-        double match;
+    for (auto &t: deltaTables) {
+        create_next_table(t);
+    }
+    remap_via_fixes("procedure");
+    remap_via_fixes("transition");
+    remap_via_fixes("airway");
+    pack_fix_ids("procedure");
+    pack_fix_ids("transition");
+    for (auto &t: deltaTables) {
+        apply_table_delta(t);
+    }
+    refresh_grid_counts();
+    run_script("COMMIT;", "commit differences");
+
+    run_script("PRAGMA prev.optimize; DETACH DATABASE prev;", "optimize previous database");
+    std::cout << "Finished updating Avitab NAV database - now ready for use." << std::endl;
+}
+
+void AtoolsDbNavTranslator::map_stable_ids(const KeyedTable &t)
+{
+    std::string select = std::string("SELECT ") + t.id;
+    for (auto &k: t.key) {
+        select += std::string(", ") + k.column;
+    }
+    auto selectFrom = [&select, &t] (const std::string &schema) {
+        return select + " FROM " + schema + "." + t.table + " ORDER BY " + t.id + ";";
     };
-    std::vector<columns> results;
 
-    // search for runways in the vicinity and chose the most likely one
-    auto rwy_qry = avi->compile(
-        "SELECT r.runway_id, r.airport_id, r.runway_pair_id, "
-        "r.name, a.ident, r.heading, r.lonx, r.laty "
-        "FROM runway AS r "
-        "INNER JOIN airport AS a ON r.airport_id = a.airport_id "
-        "WHERE (r.lonx BETWEEN ?1 AND ?2) AND (r.laty BETWEEN ?3 AND ?4);");
-    rwy_qry->initialize();
-    constexpr double search_margin = 0.5;
-    rwy_qry->bind(1, lonx - search_margin);
-    rwy_qry->bind(2, lonx + search_margin);
-    rwy_qry->bind(3, laty - search_margin);
-    rwy_qry->bind(4, laty + search_margin);
-    while (1) {
-        if (rwy_qry->step()) break;
-        columns x;
-        x.rid = rwy_qry->getInt(0);
-        x.aid = rwy_qry->getInt(1);
-        x.pid = rwy_qry->getInt(2);
-        x.name = rwy_qry->getString(3);
-        x.aident = rwy_qry->getString(4);
-        x.heading = rwy_qry->getDouble(5);
-        x.lonx = rwy_qry->getDouble(6);
-        x.laty = rwy_qry->getDouble(7);
-        auto hdg_diff = std::abs(x.heading - ils_heading);
-        // the matching one is chosen by a formula that favours the heading over the distance
-        x.match = (hdg_diff * hdg_diff + 1) * ((x.lonx - lonx) * (x.lonx - lonx)) + ((x.laty - laty) * (x.laty - laty));
-        results.push_back(x);
+    // keys can repeat, e.g. for fixes of the same name in a region. the nth row
+    // of a key is matched with the nth row of that key in the previous database.
+    auto makeKey = [this, &t] (std::shared_ptr<sqlnav::SqlStatement> &qry, bool translated, std::unordered_map<std::string, int> &seen) {
+        std::string key;
+        for (size_t c = 0; c < t.key.size(); ++c) {
+            if (t.key[c].ref) {
+                int id = qry->getInt(c + 1);
+                if (translated) {
+                    auto &ids = stable_ids[t.key[c].ref];
+                    auto i = ids.find(id);
+                    if (i != ids.end()) id = i->second;
+                }
+                key += std::to_string(id);
+            } else {
+                key += qry->getString(c + 1);
+            }
+            key += '\x1f';
+        }
+        key += std::to_string(seen[key]++);
+        return key;
+    };
+
+    std::unordered_map<std::string, int> previous;
+    std::unordered_map<std::string, int> seen;
+    int max_id = 0;
+    auto prev_qry = avi->compile(selectFrom("prev"));
+    prev_qry->initialize();
+    while (!prev_qry->step()) {
+        int id = prev_qry->getInt(0);
+        previous[makeKey(prev_qry, false, seen)] = id;
+        max_id = std::max(max_id, id);
     }
 
-    std::sort(results.begin(), results.end(), [](auto const& l, auto const& r){
-        return l.match < r.match;
-    });
+    // rows that are new get ids above all of the previous ones
+    auto &ids = stable_ids[t.table];
+    run_script(std::string("CREATE TEMP TABLE map_") + t.table + " (new_id INTEGER PRIMARY KEY, old_id INTEGER);", "create id map");
+    auto map_ins = prepare_insert(std::string("temp.map_") + t.table, 2);
+    seen.clear();
+    int rows = 0, matched = 0;
+    auto qry = avi->compile(selectFrom("main"));
+    qry->initialize();
+    while (!qry->step()) {
+        int id = qry->getInt(0);
+        auto p = previous.find(makeKey(qry, true, seen));
+        int stable_id = (p != previous.end()) ? p->second : ++max_id;
+        if (p != previous.end()) ++matched;
+        ids[id] = stable_id;
+        insert_row(map_ins, id, stable_id);
+        ++rows;
+    }
+    std::cout << "Matched " << matched << " of " << rows << " " << t.table << " rows with the previous database." << std::endl;
+}
 
-    if (results.size()) {
-        // the first entry is the runway selected. also find the opposite runway so we can
-        // check that the ILS is located in a believable position.
-        auto i = results.begin();
-        int z = i->pid;
-        auto j = std::find_if(results.begin(), results.end(), [z](auto const& i){
-            return i.rid == z;
-        });
+void AtoolsDbNavTranslator::create_next_table(const DeltaTable &t)
+{
+    // the translated rows with the ids of the previous database
+    auto remap = [] (const std::string &column, const std::string &table) {
+        return "COALESCE((SELECT old_id FROM temp.map_" + table + " WHERE new_id = " + column + "), " + column + ")";
+    };
+
+    std::string columns;
+    auto qry = avi->compile(std::string("SELECT name FROM pragma_table_info('") + t.table + "', 'main');");
+    qry->initialize();
+    while (!qry->step()) {
+        auto column = qry->getString(0);
+        std::string expr = column;
+        for (auto &r: t.refs) {
+            if (column != r.column) continue;
+            if (std::string(r.ref) == "navaid") {
+                // fixes of VORs and NDBs refer to those tables by their type
+                expr = "CASE type WHEN 'V' THEN " + remap(column, "vor") + " WHEN 'N' THEN " + remap(column, "ndb") + " ELSE " + column + " END";
+            } else {
+                expr = remap(column, r.ref);
+            }
+        }
+        columns += (columns.empty() ? "" : ", ") + expr + " AS " + column;
+    }
+    run_script(std::string("CREATE TEMP TABLE next_") + t.table + " AS SELECT " + columns + " FROM main." + t.table + ";", "create remapped table");
+}
+
+void AtoolsDbNavTranslator::remap_via_fixes(const std::string &table)
+{
+    auto &fix_ids = stable_ids["fix"];
+    std::vector<std::pair<int, std::string>> updates;
+    auto qry = avi->compile("SELECT rowid, via_fixes FROM temp.next_" + table + " WHERE via_fixes <> '';");
+    qry->initialize();
+    while (!qry->step()) {
+        std::istringstream v(qry->getString(1));
+        std::ostringstream vias;
+        int fix;
+        while (v >> fix) {
+            auto i = fix_ids.find(fix);
+            vias << ((i != fix_ids.end()) ? i->second : fix) << ':';
+            char c;
+            v >> c;
+        }
+        updates.emplace_back(qry->getInt(0), vias.str());
+    }
+
+    auto upd = avi->compile("UPDATE temp.next_" + table + " SET via_fixes = ?1 WHERE rowid = ?2;");
+    for (auto &u: updates) {
+        insert_row(upd, u.second, u.first);
+    }
+}
+
+void AtoolsDbNavTranslator::pack_fix_ids(const std::string &table)
+{
+    // the packed fix lists are rebuilt from the remapped columns
+    std::vector<std::pair<int, std::vector<int>>> updates;
+    auto qry = avi->compile("SELECT rowid, initial_fix_id, final_fix_id, via_fixes FROM temp.next_" + table + ";");
+    qry->initialize();
+    while (!qry->step()) {
+        updates.emplace_back(qry->getInt(0), sqlnav::SqlLoadManager::toVector(qry->getInt(1), qry->getInt(2), qry->getString(3)));
+    }
+
+    auto upd = avi->compile("UPDATE temp.next_" + table + " SET fix_ids = ?1 WHERE rowid = ?2;");
+    for (auto &u: updates) {
+        insert_row(upd, u.second, u.first);
+    }
+}
+
+void AtoolsDbNavTranslator::apply_table_delta(const DeltaTable &t)
+{
+    // groups with any row that was added, removed or changed are replaced as a whole
+    std::string table(t.table);
+    std::string group(t.group);
+    run_script("CREATE TEMP TABLE changed_" + table + " AS "
+               "SELECT " + group + " FROM (SELECT * FROM prev." + table + " EXCEPT SELECT * FROM temp.next_" + table + ") "
+               "UNION "
+               "SELECT " + group + " FROM (SELECT * FROM temp.next_" + table + " EXCEPT SELECT * FROM prev." + table + ");",
+               "find changed rows");
+
+    int groups = count_rows("SELECT COUNT(*) FROM temp.changed_" + table + ";");
+    if (groups == 0) {
+        std::cout << "No changes in " << table << " table." << std::endl;
+        return;
+    }
+
+    std::string changed = "(" + group + ") IN (SELECT " + group + " FROM temp.changed_" + table + ")";
+    int removed = count_rows("SELECT COUNT(*) FROM prev." + table + " WHERE " + changed + ";");
+    int added = count_rows("SELECT COUNT(*) FROM temp.next_" + table + " WHERE " + changed + ";");
+    run_script("DELETE FROM prev." + table + " WHERE " + changed + ";"
+               "INSERT INTO prev." + table + " SELECT * FROM temp.next_" + table + " WHERE " + changed + ";",
+               "update " + table + " table");
+    std::cout << "Replaced " << removed << " rows by " << added << " in " << groups << " changed groups of " << table << " table." << std::endl;
+}
+
+void AtoolsDbNavTranslator::refresh_grid_counts()
+{
+    std::string changed = "(ilonx, ilaty) IN (SELECT ilonx, ilaty FROM temp.changed_grid_search)";
+    run_script("DELETE FROM prev.grid_count WHERE " + changed + ";"
+               "INSERT INTO prev.grid_count SELECT ilonx, ilaty, COUNT(*) FROM prev.grid_search WHERE " + changed + " GROUP BY ilonx, ilaty;",
+               "refresh grid area counts");
+    std::cout << "Refreshed " << count_rows("SELECT COUNT(*) FROM temp.changed_grid_search;") << " grid area counts." << std::endl;
+}
+
+int AtoolsDbNavTranslator::count_rows(const std::string &sql)
+{
+    auto qry = avi->compile(sql);
+    qry->initialize();
+    if (qry->step()) {
+        throw std::runtime_error("Avitab database read error");
+    }
+    return qry->getInt(0);
+}
+
+int AtoolsDbNavTranslator::fixup_ils(const IlsRow &ils)
+{
+    // this ILS record didn't have IDs for the airport and/or runway that it is associated with
+    // we try to figure out where is belongs by using lon/lat searches (and possibly other info?)
+    int ils_heading = ((int)ils.loc_heading % 360);
+
+    // search the runway ends in the vicinity and chose the most likely one
+    constexpr double search_margin = 0.5;
+    const RunwayLocation *best = nullptr;
+    double best_match = 0.0;
+    for (int ilonx = (int)std::floor(ils.lonx - search_margin); ilonx <= (int)std::floor(ils.lonx + search_margin); ++ilonx) {
+        for (int ilaty = (int)std::floor(ils.laty - search_margin); ilaty <= (int)std::floor(ils.laty + search_margin); ++ilaty) {
+            auto cell = runway_cells.find(std::make_pair(ilonx, ilaty));
+            if (cell == runway_cells.end()) continue;
+            for (auto rid: cell->second) {
+                auto &x = runway_locations.at(rid);
+                if ((std::abs(x.lonx - ils.lonx) > search_margin) || (std::abs(x.laty - ils.laty) > search_margin)) continue;
+                auto hdg_diff = std::abs(x.heading - ils_heading);
+                // the matching one is chosen by a formula that favours the heading over the distance
+                double match = (hdg_diff * hdg_diff + 1) * ((x.lonx - ils.lonx) * (x.lonx - ils.lonx)) + ((x.laty - ils.laty) * (x.laty - ils.laty));
+                if (!best || (match < best_match)) {
+                    best = &x;
+                    best_match = match;
+                }
+            }
+        }
+    }
 
-        double rlsq = ((j->lonx - i->lonx) * (j->lonx - i->lonx)) + ((j->laty - i->laty) * (j->laty - i->laty));
-        double rclonx = (i->lonx + j->lonx) / 2;
-        double rclaty = (i->laty + j->laty) / 2;
-        double dsq_from_rc = ((rclonx - i->lonx) * (rclonx - i->lonx)) + ((rclaty - i->laty) * (rclaty - i->laty));
-        if (dsq_from_rc < rlsq) {
-            std::ostringstream update;
-            update << "UPDATE ils SET airport_id = " << i->aid << ", runway_id = " << i->rid
-            << " WHERE ils_id = " << ils_id << ";";
-            std::string errMsg;
-            int e = avi->runscript(update.str(), errMsg);
-            if (e != 0) {
-                std::cerr << "Error code " << e << " when updating Avitab ils table" << std::endl;
-                std::cerr << "Message was: " << errMsg << std::endl;
-                throw std::runtime_error("Avitab database update error");
+    if (best) {
+        // also find the opposite runway end so we can check that the ILS is located in a believable position.
+        auto i = best;
+        auto j = runway_locations.find(i->pair_id);
+        if (j != runway_locations.end()) {
+            double rlsq = ((j->second.lonx - i->lonx) * (j->second.lonx - i->lonx)) + ((j->second.laty - i->laty) * (j->second.laty - i->laty));
+            double rclonx = (i->lonx + j->second.lonx) / 2;
+            double rclaty = (i->laty + j->second.laty) / 2;
+            double dsq_from_rc = ((rclonx - i->lonx) * (rclonx - i->lonx)) + ((rclaty - i->laty) * (rclaty - i->laty));
+            if (dsq_from_rc < rlsq) {
+                std::ostringstream update;
+                update << "UPDATE ils SET airport_id = " << i->airport_id << ", runway_id = " << i->runway_id
+                << " WHERE ils_id = " << ils.ils_id << ";";
+                std::string errMsg;
+                int e = avi->runscript(update.str(), errMsg);
+                if (e != 0) {
+                    std::cerr << "Error code " << e << " when updating Avitab ils table" << std::endl;
+                    std::cerr << "Message was: " << errMsg << std::endl;
+                    throw std::runtime_error("Avitab database update error");
+                }
+                logger::info("Attached ILS %s at [%f,%f] to airport, id=%d", ils.ident.c_str(), ils.lonx, ils.laty, i->airport_id);
+                return 1;
             }
-            logger::info("Attached ILS %s at [%f,%f] to airport, id=%d", ilsident.c_str(), lonx, laty, i->aid);
-            return 1;
         }
-        logger::warn("Could not find plausible airport for ILS %s at [%f,%f]", ilsident.c_str(), lonx, laty);
+        logger::warn("Could not find plausible airport for ILS %s at [%f,%f]", ils.ident.c_str(), ils.lonx, ils.laty);
         return 0;
     }
-    logger::warn("Could not find any airport for ILS %s at [%f,%f]", ilsident.c_str(), lonx, laty);
+    logger::warn("Could not find any airport for ILS %s at [%f,%f]", ils.ident.c_str(), ils.lonx, ils.laty);
     return 0;
 }
 
 void AtoolsDbNavTranslator::add_global_region_fix(const std::string &r, const std::string &f, int fid)
 {
-    if (global_region_fix_ids.find(r) == global_region_fix_ids.end()) {
-        global_region_fix_ids[r] = std::map<std::string, int>();
-    }
-    if (global_region_fix_ids[r].find(f) == global_region_fix_ids[r].end()) {
-        global_region_fix_ids[r][f] = fid;
-    } else {
-        logger::info("Global fix %s/%s previously added with id=%d", r.c_str(), f.c_str(), global_region_fix_ids[r][f]);
+    auto i = global_region_fix_ids[r].emplace(f, fid);
+    if (!i.second) {
+        logger::info("Global fix %s/%s previously added with id=%d", r.c_str(), f.c_str(), i.first->second);
     }
 }
 
 void AtoolsDbNavTranslator::add_airport_fix(int a, const std::string &f, int fid)
 {
-    if (airport_fix_ids.find(a) == airport_fix_ids.end()) {
-        airport_fix_ids[a] = std::map<std::string, int>();
-    }
-    if (airport_fix_ids[a].find(f) == airport_fix_ids[a].end()) {
-        airport_fix_ids[a][f] = fid;
-    } else {
-        logger::info("Airport fix %d/%s previously added with id=%d", a, f.c_str(), airport_fix_ids[a][f]);
+    auto i = airport_fix_ids[a].emplace(f, fid);
+    if (!i.second) {
+        logger::info("Airport fix %d/%s previously added with id=%d", a, f.c_str(), i.first->second);
     }
 }
 
 int AtoolsDbNavTranslator::global_region_fix(const std::string &r, const std::string &f)
 {
-    if (global_region_fix_ids.find(r) == global_region_fix_ids.end()) {
+    auto ri = global_region_fix_ids.find(r);
+    if (ri == global_region_fix_ids.end()) {
         return 0;
     }
-    if (global_region_fix_ids[r].find(f) == global_region_fix_ids[r].end()) {
+    auto fi = ri->second.find(f);
+    if (fi == ri->second.end()) {
         return 0;
     }
-    return global_region_fix_ids[r][f];
+    return fi->second;
+}
+
+void AtoolsDbNavTranslator::add_global_fix_location(const std::string &f, int fid, double lonx, double laty)
+{
+    global_ident_fixes[f].push_back({fid, lonx, laty});
 }
 
 int AtoolsDbNavTranslator::find_fix(const std::string &fname, const std::string &region, int airport_id, double lonx, double laty)
 {
     // first look at the table of airport-owned fixes, if found these take precedence
-    if ((airport_fix_ids.find(airport_id) != airport_fix_ids.end())
-            && (airport_fix_ids[airport_id].find(fname) != airport_fix_ids[airport_id].end())) {
-        return airport_fix_ids[airport_id][fname];
+    auto ai = airport_fix_ids.find(airport_id);
+    if (ai != airport_fix_ids.end()) {
+        auto fi = ai->second.find(fname);
+        if (fi != ai->second.end()) {
+            return fi->second;
+        }
     }
 
     // next look at the fixes within the defined region
@@ -1025,38 +1206,22 @@ int AtoolsDbNavTranslator::find_fix(const std::string &fname, const std::string
     }
 
     // the named fix isn't owned by the airport, or in the airport's region
-    // so we'll query the DB fix table to find the nearest matching (global) fix
-    struct fixinfo {
-        int id;
-        int airport_id;
-        std::string region;
-        double deltalonx, deltalaty;
-    };
-    std::vector<fixinfo> fixes;
+    // so we'll use the nearest matching (global) fix
+    auto gi = global_ident_fixes.find(fname);
+    if (gi == global_ident_fixes.end()) return 0;
 
-    fix_qry->initialize();
-    fix_qry->bind(1, fname);
-    while (1) {
-        int r = fix_qry->step();
-        if (r > 0) break;
-        if (r < 0) {
-            std::cerr << "Error code " << r << " when reading AVI fix table" << std::endl;
-            throw std::runtime_error("AVI database read error");
-        }
-        fixinfo fi;
-        fi.id = fix_qry->getInt(0);
-        fi.deltalonx = fix_qry->getDouble(1) - lonx;
-        fi.deltalaty = fix_qry->getDouble(2) - laty;
-        fixes.push_back(fi);
-    }
-    if (fixes.empty()) return 0;
-
-    std::sort(fixes.begin(), fixes.end(), [] (auto const& l, auto const& r) {
-        auto dl = (l.deltalonx * l.deltalonx) + (l.deltalaty * l.deltalaty);
-        auto dr = (r.deltalonx * r.deltalonx) + (r.deltalaty * r.deltalaty);
+    auto nearest = std::min_element(gi->second.begin(), gi->second.end(), [lonx, laty] (auto const& l, auto const& r) {
+        auto dl = ((l.lonx - lonx) * (l.lonx - lonx)) + ((l.laty - laty) * (l.laty - laty));
+        auto dr = ((r.lonx - lonx) * (r.lonx - lonx)) + ((r.laty - laty) * (r.laty - laty));
         return dl < dr;
     });
-    return fixes.front().id;
+    return nearest->fix_id;
+}
+
+void AtoolsDbNavTranslator::add_runway_location(const RunwayLocation &rwy)
+{
+    runway_locations[rwy.runway_id] = rwy;
+    runway_cells[std::make_pair((int)std::floor(rwy.lonx), (int)std::floor(rwy.laty))].push_back(rwy.runway_id);
 }
 
 void AtoolsDbNavTranslator::add_grid_area_node(int ilonx, int ilaty)
@@ -1068,19 +1233,12 @@ void AtoolsDbNavTranslator::add_grid_area_node(int ilonx, int ilaty)
     ++grid_totals[k];
 }
 
-static inline std::string quoted(std::string &s)
+template<typename... COLS>
+static inline void insert_row(std::shared_ptr<sqlnav::SqlStatement> &ins, COLS... cols)
 {
-    if (s.find('\'') == std::string::npos) return s;
-    std::string p, q(s);
-    while (q.size()) {
-        auto i = q.find('\'');
-        if (i == std::string::npos) {
-            p += q;
-            return p;
-        }
-        p += q.substr(0, i+1);
-        p += '\'';
-        q.erase(0, i+1);
-    }
-    return p;
+    // bind each column to the next statement parameter and run the insert
+    ins->initialize();
+    int p = 0;
+    (ins->bind(++p, cols), ...);
+    ins->step();
 }
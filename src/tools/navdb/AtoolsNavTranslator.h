@@ -20,24 +20,62 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include "src/libnavsql/SqlDatabase.h"
+#include "src/libnavsql/SqlStatement.h"
 
 class AtoolsDbNavTranslator : public std::enable_shared_from_this<AtoolsDbNavTranslator>
 {
 public:
-    AtoolsDbNavTranslator(std::shared_ptr<sqlnav::SqlDatabase> targ, std::shared_ptr<sqlnav::SqlDatabase> src);
+    AtoolsDbNavTranslator(std::shared_ptr<sqlnav::SqlDatabase> targ, std::shared_ptr<sqlnav::SqlDatabase> src, const std::string &srcPath);
     void translate();
 
+    // Applies the differences between the translated database and the NAV database at
+    // previousPath to the latter, in a single transaction. Rows are matched by stable
+    // keys such as idents, so the ids of unchanged rows are kept. Only possible if the
+    // previous database was built with the same schema version.
+    static bool can_apply_delta(const std::string &previousPath);
+    void apply_delta(const std::string &previousPath);
+
     void exec_insert(const std::string &table, const std::string &values);
 
 private:
+    // rows of the source tables that don't allocate fix IDs. these are read on
+    // worker threads while the fix producing tables are being extracted.
+    struct ComRow {
+        int airport_id;
+        std::string type;
+        int frequency;
+        std::string name;
+    };
+    struct StartRow {
+        int airport_id;
+        std::string type;
+        int number;
+        double lonx, laty;
+    };
+    struct IlsRow {
+        int ils_id;
+        std::string ident, name;
+        int airport_id, runway_id;
+        double lonx, laty;
+        int frequency;
+        double loc_heading, mag_var;
+        int range, dme_range;
+    };
+
+    static std::vector<ComRow> read_comms(std::shared_ptr<sqlnav::SqlDatabase> src);
+    static std::vector<StartRow> read_starts(std::shared_ptr<sqlnav::SqlDatabase> src);
+    static std::vector<IlsRow> read_ilss(std::shared_ptr<sqlnav::SqlDatabase> src);
+
     void compile_metadata();
     void extract_waypoints();
     void extract_airports();
-    void extract_comms();
+    void extract_comms(const std::vector<ComRow> &rows);
     void extract_runways();
-    void extract_starts();
-    void extract_ilss();
+    void extract_starts(const std::vector<StartRow> &rows);
+    void extract_ilss(const std::vector<IlsRow> &rows);
     void extract_vors();
     void extract_ndbs();
     void compile_procedures();
@@ -46,24 +84,70 @@ private:
     void compile_grid_counts();
     void optimize();
 
-    int fixup_ils(int ils_id);
+    int fixup_ils(const IlsRow &ils);
+
+    std::shared_ptr<sqlnav::SqlStatement> prepare_insert(const std::string &table, int columns);
+    void run_script(const std::string &script, const std::string &what);
 
     void add_global_region_fix(const std::string &region, const std::string &fname, int fid);
     void add_airport_fix(int airport_id, const std::string &fname, int fid);
     int global_region_fix(const std::string &region, const std::string &fname);
+    void add_global_fix_location(const std::string &fname, int fid, double lonx, double laty);
     int find_fix(const std::string &fname, const std::string &region, int airport_id, double lonx, double laty);
 
     void add_grid_area_node(int ilonx, int ilaty);
 
+    struct FixLocation {
+        int fix_id;
+        double lonx, laty;
+    };
+    struct RunwayLocation {
+        int runway_id, airport_id, pair_id;
+        double heading, lonx, laty;
+    };
+    void add_runway_location(const RunwayLocation &rwy);
+
+    // the columns identifying a row across builds, ref names the table whose id a column holds
+    struct KeyColumn {
+        const char *column;
+        const char *ref;
+    };
+    struct KeyedTable {
+        const char *table;
+        const char *id;
+        std::vector<KeyColumn> key;
+    };
+    // a table is updated in groups of rows, all of which are replaced if any of them changed
+    struct DeltaTable {
+        const char *table;
+        const char *group;
+        std::vector<KeyColumn> refs;
+    };
+    void map_stable_ids(const KeyedTable &t);
+    void create_next_table(const DeltaTable &t);
+    void remap_via_fixes(const std::string &table);
+    void pack_fix_ids(const std::string &table);
+    void apply_table_delta(const DeltaTable &t);
+    void refresh_grid_counts();
+    int count_rows(const std::string &sql);
+
 private:
     std::shared_ptr<sqlnav::SqlDatabase> avi;
     std::shared_ptr<sqlnav::SqlDatabase> lnm;
+    const std::string lnmPath;
 
     // these are used for attaching orphaned VORs and NDBs when scanning those tables
     // and when processing SID/STAR/approach procedures
-    std::map<std::string, std::map<std::string, int>> global_region_fix_ids;
-    std::map<int, std::map<std::string, int>> airport_fix_ids;
-    std::shared_ptr<sqlnav::SqlStatement> fix_qry;
+    std::unordered_map<std::string, std::unordered_map<std::string, int>> global_region_fix_ids;
+    std::unordered_map<int, std::unordered_map<std::string, int>> airport_fix_ids;
+
+    // fixes that aren't owned by an airport, by name, for procedure legs that
+    // name a fix outside of the airport's region. the nearest one is chosen.
+    std::unordered_map<std::string, std::vector<FixLocation>> global_ident_fixes;
+
+    // runway ends by id and by grid area, for adopting orphaned ILSs
+    std::unordered_map<int, RunwayLocation> runway_locations;
+    std::map<std::pair<int, int>, std::vector<int>> runway_cells;
 
     // count of all searchable nodes in each grid area
     std::map<std::pair<int, int>, int> grid_totals;
@@ -71,4 +155,7 @@ private:
     // fix ids mostly match atools waypoints, extras follow these
     int next_fix_id;
 
+    // ids of the previous database by table and translated id, for delta updates
+    std::map<std::string, std::unordered_map<int, int>> stable_ids;
+
 };
@@ -172,7 +172,8 @@ int AtoolsDbProcedureCompiler::generateSid(const std::string &ident, Runway depa
     auto vstr = viasToString(vias, vdbg);
     //std::cout << "SID " << ident << " from RW (id=" << departing_runway << ") to " << (*fixes)[fn] << " via " << vdbg << std::endl;
     *procvals << "(" << id << "," << airportId << ",1,'" << ident << "','"
-            << departing_runway.name << "'," << departing_runway.fixId << "," << fn << ",'" << vstr << "'),";
+            << departing_runway.name << "'," << departing_runway.fixId << "," << fn << ",'" << vstr << "',"
+            << fixIdsToBlob(departing_runway.fixId, vias, fn) << "),";
     ++rowCount;
 
     return id;
@@ -190,7 +191,8 @@ int AtoolsDbProcedureCompiler::generateStar(const std::string &ident, Runway arr
     auto vstr = viasToString(vias, vdbg);
     //std::cout << "STAR " << ident << " from " << (*fixes)[f0] << " to RW (id=" << arrival_runway << ") via " << vdbg << std::endl;
     *procvals << "(" << id << "," << airportId << ",2,'" << ident << "','"
-            << arrival_runway.name << "'," << f0 << "," << fn << ",'" << vstr << "'),";
+            << arrival_runway.name << "'," << f0 << "," << fn << ",'" << vstr << "',"
+            << fixIdsToBlob(f0, vias, fn) << "),";
     ++rowCount;
 
     return id;
@@ -204,7 +206,8 @@ int AtoolsDbProcedureCompiler::generateApproach(const std::string &ident, Runway
     auto vstr = viasToString(vias, vdbg);
     //std::cout << "Approach " << ident << " from " << (*fixes)[f0] << " to RW (id=" << landing_runway << ") via " << vdbg << std::endl;
     *procvals << "(" << id << "," << airportId << ",3,'" << ident << "','"
-            << landing_runway.name << "'," << f0 << "," << landing_runway.fixId << ",'" << vstr << "'),";
+            << landing_runway.name << "'," << f0 << "," << landing_runway.fixId << ",'" << vstr << "',"
+            << fixIdsToBlob(f0, vias, landing_runway.fixId) << "),";
     ++rowCount;
 
     return id;
@@ -222,7 +225,7 @@ void AtoolsDbProcedureCompiler::generateTransition(int procId, const std::string
     auto vstr = viasToString(vias, vdbg);
     //std::cout << "Transition " << ident << " from " << (*fixes)[f0] << " to " << (*fixes)[fn] << " via " << vdbg << std::endl;
     *transvals << "(" << id << "," << procId << ",'" << ident << "',"
-            << f0 << "," << fn << ",'" << vstr << "'),";
+            << f0 << "," << fn << ",'" << vstr << "'," << fixIdsToBlob(f0, vias, fn) << "),";
     ++rowCount;
 }
 
@@ -239,6 +242,24 @@ std::string AtoolsDbProcedureCompiler::viasToString(std::list<int> vias, std::st
     return s;
 }
 
+std::string AtoolsDbProcedureCompiler::fixIdsToBlob(int f0, const std::list<int> &vias, int fn)
+{
+    // SQL literal of the packed fix list, in the byte order that Avitab reads it back with
+    std::vector<int> ids(1, f0);
+    ids.insert(ids.end(), vias.begin(), vias.end());
+    ids.push_back(fn);
+
+    static const char *hex = "0123456789ABCDEF";
+    auto bytes = reinterpret_cast<const unsigned char *>(ids.data());
+    std::string s("X'");
+    for (size_t i = 0; i < ids.size() * sizeof(int); ++i) {
+        s += hex[bytes[i] >> 4];
+        s += hex[bytes[i] & 0xF];
+    }
+    s += '\'';
+    return s;
+}
+
 std::vector<AtoolsDbProcedureCompiler::Runway> AtoolsDbProcedureCompiler::matchingRunways(std::string proc_name)
 {
     std::vector<Runway> results;
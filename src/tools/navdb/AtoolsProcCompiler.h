@@ -59,6 +59,7 @@ private:
     int generateApproach(const std::string &ident, Runway landing_runway, std::list<int> vias);
     void generateTransition(int procId, const std::string &ident, std::list<int> vias);
     std::string viasToString(std::list<int> vias, std::string &dbg);
+    static std::string fixIdsToBlob(int f0, const std::list<int> &vias, int fn);
     std::vector<Runway> matchingRunways(std::string name);
     void debug_runways();
     void update();
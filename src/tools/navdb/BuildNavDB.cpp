@@ -22,7 +22,9 @@
 #include "src/Logger.h"
 #include "src/libnavsql/SqlDatabase.h"
 #include "src/libnavsql/SqlStatement.h"
+#include "src/libflatnav/FlatNavFormat.h"
 #include "AtoolsNavTranslator.h"
+#include "FlatNavWriter.h"
 
 int main(int argc, char *argv[])
 {
@@ -35,25 +37,46 @@ int main(int argc, char *argv[])
 
     std::string infile("input.sqlite");
     std::string outfile("avitab_navdb.sqlite");
+    bool delta = false;
 
-    if (argc > 1) {
-        infile = argv[1];
-        if (argc > 2) {
-            outfile = argv[2];
+    int arg = 1;
+    if ((argc > arg) && (std::string(argv[arg]) == "--delta")) {
+        delta = true;
+        ++arg;
+    }
+    if (argc > arg) {
+        infile = argv[arg];
+        if (argc > arg + 1) {
+            outfile = argv[arg + 1];
         }
     }
 
-    std::cout << "Removing output database during development phase" << std::endl;
-    std::remove(outfile.c_str());
+    if (delta && !AtoolsDbNavTranslator::can_apply_delta(outfile)) {
+        std::cout << "No previous database of this version, building a new one" << std::endl;
+        delta = false;
+    }
+    if (!delta) {
+        std::cout << "Removing output database during development phase" << std::endl;
+        std::remove(outfile.c_str());
+    }
 
+    // a delta update translates into memory and then only writes the differences to the output
     auto srcdb = std::make_shared<sqlnav::SqlDatabase>(infile, true);
-    auto navdb = std::make_shared<sqlnav::SqlDatabase>(outfile, false, true);
+    auto navdb = std::make_shared<sqlnav::SqlDatabase>(delta ? ":memory:" : outfile, false, true);
 
     // In the initial version of this tool, the only option is compiling the Avitab NAV
     // database from a LNM/atools database.
 
-    std::shared_ptr<AtoolsDbNavTranslator> worker = std::make_shared<AtoolsDbNavTranslator>(navdb, srcdb);
+    std::shared_ptr<AtoolsDbNavTranslator> worker = std::make_shared<AtoolsDbNavTranslator>(navdb, srcdb, infile);
     worker->translate();
+    if (delta) {
+        worker->apply_delta(outfile);
+        navdb = std::make_shared<sqlnav::SqlDatabase>(outfile, true);
+    }
+
+    // the flat file next to the output is used by AviTab instead of the SQL database when present
+    auto flatfile = std::filesystem::path(outfile).parent_path() / flatnav::FILE_NAME;
+    FlatNavWriter(navdb).write(flatfile.string());
 
     return 0;
 }
@@ -0,0 +1,627 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include "FlatNavWriter.h"
+#include "src/Logger.h"
+#include "src/world/World.h"
+#include "src/libnavsql/SqlLoadManager.h"
+#include "src/libnavsql/loaders/AirportLoader.h"
+#include "src/libnavsql/loaders/NavDbCodes.h"
+
+using namespace flatnav;
+
+FlatNavWriter::FlatNavWriter(std::shared_ptr<sqlnav::SqlDatabase> db)
+:   navdb(db)
+{
+    // offset 0 is the empty string
+    strings.push_back('\0');
+    stringRefs[""] = 0;
+}
+
+void FlatNavWriter::write(const std::string &outfile)
+{
+    std::cout << "Will write flat NAV database ..." << std::endl;
+    read_metadata();
+    read_airports();
+    read_comms();
+    read_runways();
+    read_helipads();
+    read_fixes();
+    read_localizers();
+    build_terminal_fixes();
+    read_airways();
+    read_procedures();
+    build_entries();
+    build_grid();
+    build_lod();
+    flatten_airports();
+
+    // written under another name first so that a failure never leaves a truncated file behind
+    std::string tmpfile = outfile + ".tmp";
+    write_file(tmpfile);
+    std::filesystem::rename(tmpfile, outfile);
+    std::cout << "Wrote " << airports.size() << " airports and " << fixes.size() << " fixes to " << outfile << std::endl;
+}
+
+std::shared_ptr<sqlnav::SqlStatement> FlatNavWriter::query(const char *sql)
+{
+    auto q = navdb->compile(sql);
+    q->initialize();
+    return q;
+}
+
+StringRef FlatNavWriter::intern(const std::string &s)
+{
+    auto it = stringRefs.find(s);
+    if (it != stringRefs.end()) {
+        return it->second;
+    }
+    StringRef ref = strings.size();
+    strings.append(s);
+    strings.push_back('\0');
+    stringRefs.emplace(s, ref);
+    return ref;
+}
+
+std::vector<uint32_t> FlatNavWriter::map_fixes(const std::vector<int> &fix_ids) const
+{
+    // as when loading from the SQL database, fixes that don't exist are left out
+    std::vector<uint32_t> res;
+    for (auto id: fix_ids) {
+        auto it = fixIndex.find(id);
+        if (it != fixIndex.end()) {
+            res.push_back(it->second);
+        }
+    }
+    return res;
+}
+
+void FlatNavWriter::read_metadata()
+{
+    auto q = query("SELECT db_version, target_simulator, data_source FROM metadata ;");
+    if (q->step()) {
+        throw std::runtime_error("NAV database has no metadata");
+    }
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.dbVersion = q->getInt(0);
+    header.simulator = intern(q->getString(1));
+    header.source = intern(q->getString(2));
+}
+
+void FlatNavWriter::read_airports()
+{
+    struct Row {
+        int airport_id;
+        std::string ident, name, region, country;
+        double lonx, laty;
+        int altitude;
+    };
+    std::vector<Row> rows;
+    auto q = query("SELECT airport_id, ident, name, region, country, lonx, laty, altitude FROM airport ;");
+    while (!q->step()) {
+        rows.push_back(Row{q->getInt(0), q->getString(1), q->getString(2), q->getString(3), q->getString(4),
+                           q->getDouble(5), q->getDouble(6), q->getInt(7)});
+    }
+
+    // sorted by ident, so that they can be found by a binary search
+    std::sort(rows.begin(), rows.end(), [] (const Row &a, const Row &b) {
+        return std::tie(a.ident, a.airport_id) < std::tie(b.ident, b.airport_id);
+    });
+
+    for (auto &r: rows) {
+        AirportRecord rec {};
+        rec.latitude = r.laty;
+        rec.longitude = r.lonx;
+        rec.ident = intern(r.ident);
+        rec.name = intern(r.name);
+        rec.region = intern(r.region);
+        rec.country = intern(r.country);
+        rec.elevation = r.altitude;
+        airportIndex[r.airport_id] = airports.size();
+        airports.push_back(rec);
+        airportIdents.push_back(r.ident);
+    }
+
+    longestRunways.resize(airports.size());
+    airportComms.resize(airports.size());
+    airportRunways.resize(airports.size());
+    airportHelipads.resize(airports.size());
+    airportTerminalFixes.resize(airports.size());
+    std::cout << "Read " << airports.size() << " airports." << std::endl;
+}
+
+void FlatNavWriter::read_comms()
+{
+    auto q = query("SELECT airport_id, type, frequency, name FROM com ;");
+    while (!q->step()) {
+        auto it = airportIndex.find(q->getInt(0));
+        if (it == airportIndex.end()) {
+            continue;
+        }
+        auto type = sqlnav::mapToATCclass(q->getString(1));
+        if (type == world::Airport::ATCFrequency::TWR) {
+            airports[it->second].flags |= AIRPORT_TOWERED;
+        }
+        CommRecord rec {};
+        rec.name = intern(q->getString(3));
+        rec.frequency = q->getInt(2);
+        rec.type = static_cast<uint32_t>(type);
+        airportComms[it->second].push_back(rec);
+    }
+}
+
+void FlatNavWriter::read_runways()
+{
+    // the ends are paired as by the SQL airport loader, ends without opposite are left out
+    struct End {
+        int runway_id;
+        RunwayRecord rec;
+        float offset;
+    };
+    struct Pair {
+        int n = 0;
+        End ends[2];
+    };
+    std::map<int, std::map<int, Pair>> pairs; // by airport, then by runway_id of the first end
+
+    auto q = query("SELECT airport_id, runway_id, name, runway_pair_id, length, width, surface, heading, altitude, offset_threshold, lonx, laty "
+                   "FROM runway ORDER BY airport_id, runway_id ;");
+    while (!q->step()) {
+        auto it = airportIndex.find(q->getInt(0));
+        if (it == airportIndex.end()) {
+            continue;
+        }
+        End end;
+        end.runway_id = q->getInt(1);
+        end.rec = RunwayRecord {};
+        end.rec.name = intern(q->getString(2));
+        end.rec.length = q->getInt(4) / world::M_TO_FT;
+        end.rec.width = q->getInt(5) / world::M_TO_FT;
+        end.rec.surface = static_cast<uint32_t>(sqlnav::mapToSurfaceMaterial(q->getString(6)));
+        end.rec.heading = q->getFloat(7);
+        end.rec.elevation = q->getInt(8);
+        end.offset = q->getFloat(9);
+        end.rec.longitude = q->getDouble(10);
+        end.rec.latitude = q->getDouble(11);
+        end.rec.ils = NONE;
+        runwayPaired[end.runway_id] = false;
+
+        auto &airportPairs = pairs[it->second];
+        auto p = airportPairs.find(q->getInt(3));
+        if (p == airportPairs.end()) {
+            auto &pair = airportPairs[end.runway_id];
+            pair.ends[0] = end;
+            pair.n = 1;
+        } else if (p->second.n == 1) {
+            p->second.ends[1] = end;
+            p->second.n = 2;
+        }
+    }
+
+    for (auto &ap: pairs) {
+        auto &list = airportRunways[ap.first];
+        for (auto &p: ap.second) {
+            if (p.second.n != 2) {
+                continue;
+            }
+            auto &ends = p.second.ends;
+            float length = ends[0].rec.length - ((ends[0].offset + ends[1].offset) / world::M_TO_FT);
+            for (auto &end: ends) {
+                end.rec.length = length;
+                runwayIndex[end.runway_id] = list.size();
+                runwayPaired[end.runway_id] = true;
+                list.push_back(end.rec);
+            }
+            longestRunways[ap.first] = std::fmax(longestRunways[ap.first], length);
+        }
+    }
+}
+
+void FlatNavWriter::read_helipads()
+{
+    auto q = query("SELECT airport_id, number, lonx, laty FROM start WHERE type = 'H' ;");
+    while (!q->step()) {
+        auto it = airportIndex.find(q->getInt(0));
+        if (it == airportIndex.end()) {
+            continue;
+        }
+        HelipadRecord rec {};
+        rec.number = q->getInt(1);
+        rec.longitude = q->getDouble(2);
+        rec.latitude = q->getDouble(3);
+        airportHelipads[it->second].push_back(rec);
+    }
+}
+
+void FlatNavWriter::read_fixes()
+{
+    auto q = query(
+        "SELECT f.fix_id, f.airport_id, f.ident, f.region, f.type, f.lonx, f.laty, "
+        "n.ndb_id, n.name, n.frequency, n.range, "
+        "v.vor_id, v.name, v.frequency, v.range, v.mag_var, v.dme_only "
+        "FROM fix f "
+        "LEFT JOIN ndb n ON (f.type = 'N') AND (n.ndb_id = f.nav_id) "
+        "LEFT JOIN vor v ON (f.type = 'V') AND (v.vor_id = f.nav_id) "
+        "ORDER BY f.fix_id ;");
+    while (!q->step()) {
+        FixRecord rec {};
+        auto ident = q->getString(2);
+        auto region = q->getString(3);
+        rec.ident = intern(ident);
+        rec.region = intern(region);
+        rec.longitude = q->getDouble(5);
+        rec.latitude = q->getDouble(6);
+        rec.kind = KIND_WAYPOINT;
+        if (q->getInt(7)) {
+            rec.kind = KIND_NDB;
+            rec.name = intern(q->getString(8));
+            rec.frequency = q->getInt(9);
+            rec.range = q->getInt(10);
+        } else if (q->getInt(11)) {
+            rec.kind = KIND_VOR;
+            rec.name = intern(q->getString(12));
+            rec.frequency = q->getInt(13);
+            rec.range = q->getInt(14);
+            rec.magVar = q->getFloat(15);
+            if (q->getBool(16)) {
+                rec.flags |= FIX_DME_ONLY;
+            }
+        }
+        fixIndex[q->getInt(0)] = fixes.size();
+        fixes.push_back(rec);
+        fixAirports.push_back(q->getInt(1));
+        fixRegions.push_back(region);
+        fixIdents.push_back(ident);
+    }
+
+    // the fixes of the grid are visible on their own, the others only at their airports
+    q = query("SELECT DISTINCT fix_id FROM grid_search WHERE fix_id ;");
+    while (!q->step()) {
+        auto it = fixIndex.find(q->getInt(0));
+        if (it != fixIndex.end()) {
+            fixes[it->second].flags |= FIX_GLOBAL;
+        }
+    }
+
+    fixesById.resize(fixes.size());
+    for (uint32_t i = 0; i < fixesById.size(); ++i) {
+        fixesById[i] = i;
+    }
+    std::sort(fixesById.begin(), fixesById.end(), [this] (uint32_t a, uint32_t b) {
+        return std::tie(fixRegions[a], fixIdents[a], a) < std::tie(fixRegions[b], fixIdents[b], b);
+    });
+    std::cout << "Read " << fixes.size() << " fixes." << std::endl;
+}
+
+void FlatNavWriter::read_localizers()
+{
+    auto q = query("SELECT airport_id, ident, name, runway_id, lonx, laty, frequency, loc_heading, mag_var, range, dme_range "
+                   "FROM ils ORDER BY ils_id ;");
+    size_t count = 0;
+    while (!q->step()) {
+        auto it = airportIndex.find(q->getInt(0));
+        if (it == airportIndex.end()) {
+            continue;
+        }
+
+        // the same ILS are skipped as by the SQL airport loader
+        auto ident = q->getString(1);
+        auto description = q->getString(2);
+        if (description.size() > 3) description.resize(3);
+        auto locOnly = sqlnav::AirportLoader::fixIsLocOnly.find(description);
+        if (locOnly == sqlnav::AirportLoader::fixIsLocOnly.end()) {
+            continue;
+        }
+        int runway_id = q->getInt(3);
+        auto paired = runwayPaired.find(runway_id);
+        if (paired == runwayPaired.end()) {
+            continue;
+        }
+
+        FixRecord rec {};
+        rec.ident = intern(ident);
+        rec.region = airports[it->second].region;
+        rec.name = intern(description);
+        rec.longitude = q->getDouble(4);
+        rec.latitude = q->getDouble(5);
+        rec.frequency = q->getInt(6);
+        rec.heading = q->getFloat(7);
+        rec.magVar = q->getFloat(8);
+        rec.range = q->getInt(9);
+        rec.dmeRange = q->getInt(10);
+        rec.kind = KIND_ILS;
+        rec.flags = FIX_GLOBAL | (locOnly->second ? FIX_LOC_ONLY : 0);
+
+        // only runways with both ends are kept, the ILS of others is just a terminal fix
+        if (paired->second) {
+            airportRunways[it->second][runwayIndex[runway_id]].ils = fixes.size();
+        }
+        fixes.push_back(rec);
+        fixAirports.push_back(q->getInt(0));
+        ++count;
+    }
+    std::cout << "Read " << count << " localizers." << std::endl;
+}
+
+void FlatNavWriter::build_terminal_fixes()
+{
+    for (uint32_t i = 0; i < fixes.size(); ++i) {
+        auto it = airportIndex.find(fixAirports[i]);
+        if (fixAirports[i] && (it != airportIndex.end())) {
+            airportTerminalFixes[it->second].push_back(i);
+        }
+    }
+}
+
+void FlatNavWriter::read_airways()
+{
+    std::unordered_map<int, uint32_t> airwayIndex;
+    auto q = query("SELECT airway_id, name, type FROM airway ;");
+    while (!q->step()) {
+        auto type = q->getString(2);
+        AirwayRecord rec {};
+        rec.name = intern(q->getString(1));
+        rec.levels = ((type != "J") ? AIRWAY_LOWER : 0) | ((type != "V") ? AIRWAY_UPPER : 0);
+        airwayIndex[q->getInt(0)] = airways.size();
+        airways.push_back(rec);
+    }
+
+    // compressed sparse rows, the legs of fix i are at airwayOffsets[i] .. airwayOffsets[i + 1]
+    std::vector<std::vector<AirwayLeg>> legs(fixes.size());
+    q = query("SELECT from_fix_id, to_fix_id, airway_id FROM airway_leg ;");
+    while (!q->step()) {
+        auto from = fixIndex.find(q->getInt(0));
+        auto to = fixIndex.find(q->getInt(1));
+        auto airway = airwayIndex.find(q->getInt(2));
+        if (from == fixIndex.end() || to == fixIndex.end() || airway == airwayIndex.end()) {
+            continue;
+        }
+        legs[from->second].push_back(AirwayLeg{to->second, airway->second});
+    }
+    for (auto &l: legs) {
+        airwayOffsets.push_back(airwayLegs.size());
+        airwayLegs.insert(airwayLegs.end(), l.begin(), l.end());
+    }
+    airwayOffsets.push_back(airwayLegs.size());
+    std::cout << "Read " << airways.size() << " airways with " << airwayLegs.size() << " legs." << std::endl;
+}
+
+void FlatNavWriter::read_procedures()
+{
+    struct Transition {
+        std::string name;
+        std::vector<uint32_t> fixes;
+    };
+    std::unordered_map<int, std::vector<Transition>> procTransitions;
+    auto q = query("SELECT procedure_id, name, fix_ids FROM transition ORDER BY transition_id ;");
+    while (!q->step()) {
+        procTransitions[q->getInt(0)].push_back(Transition{q->getString(1), map_fixes(q->getIntArray(2))});
+    }
+
+    struct Procedure {
+        uint32_t airport;
+        int type;
+        std::string name;
+        int procedure_id;
+        std::string runway;
+        std::vector<uint32_t> fixes;
+    };
+    std::vector<Procedure> procs;
+    q = query("SELECT procedure_id, airport_id, type, name, runway_name, fix_ids FROM procedure ;");
+    while (!q->step()) {
+        auto it = airportIndex.find(q->getInt(1));
+        int type = q->getInt(2);
+        if (it == airportIndex.end() || type < (int)PROC_SID || type > (int)PROC_APPROACH) {
+            continue;
+        }
+        procs.push_back(Procedure{it->second, type, q->getString(3), q->getInt(0), q->getString(4), map_fixes(q->getIntArray(5))});
+    }
+
+    // grouped by airport, the variants of a procedure next to each other
+    std::sort(procs.begin(), procs.end(), [] (const Procedure &a, const Procedure &b) {
+        return std::tie(a.airport, a.type, a.name, a.procedure_id) < std::tie(b.airport, b.type, b.name, b.procedure_id);
+    });
+    for (auto &p: procs) {
+        auto &airport = airports[p.airport];
+        if (airport.procedureCount == 0) {
+            airport.firstProcedure = procedures.size();
+        }
+        ++airport.procedureCount;
+
+        ProcedureRecord rec {};
+        rec.airport = p.airport;
+        rec.type = p.type;
+        rec.name = intern(p.name);
+        rec.runway = intern(p.runway);
+        rec.firstFix = fixRefs.size();
+        rec.fixCount = p.fixes.size();
+        fixRefs.insert(fixRefs.end(), p.fixes.begin(), p.fixes.end());
+        rec.firstTransition = transitions.size();
+        for (auto &t: procTransitions[p.procedure_id]) {
+            TransitionRecord tr {};
+            tr.name = intern(t.name);
+            tr.firstFix = fixRefs.size();
+            tr.fixCount = t.fixes.size();
+            fixRefs.insert(fixRefs.end(), t.fixes.begin(), t.fixes.end());
+            transitions.push_back(tr);
+        }
+        rec.transitionCount = transitions.size() - rec.firstTransition;
+        procedures.push_back(rec);
+    }
+    std::cout << "Read " << procedures.size() << " procedures with " << transitions.size() << " transitions." << std::endl;
+}
+
+void FlatNavWriter::build_entries()
+{
+    // STARs and approaches lead from their first fix to their airport, once for all variants
+    std::vector<std::vector<uint32_t>> entries(fixes.size());
+    for (uint32_t i = 0; i < procedures.size(); ++i) {
+        auto &p = procedures[i];
+        if ((p.type != PROC_STAR && p.type != PROC_APPROACH) || p.fixCount == 0) {
+            continue;
+        }
+        auto &list = entries[fixRefs[p.firstFix]];
+        bool known = std::any_of(list.begin(), list.end(), [this, &p] (uint32_t other) {
+            auto &o = procedures[other];
+            return o.airport == p.airport && o.type == p.type && o.name == p.name;
+        });
+        if (!known) {
+            list.push_back(i);
+        }
+    }
+    for (auto &l: entries) {
+        entryOffsets.push_back(entryProcedures.size());
+        entryProcedures.insert(entryProcedures.end(), l.begin(), l.end());
+    }
+    entryOffsets.push_back(entryProcedures.size());
+}
+
+void FlatNavWriter::build_grid()
+{
+    std::vector<std::vector<uint32_t>> cells(GRID_CELLS);
+    auto cellOf = [] (double lat, double lon) {
+        int row = std::min(std::max((int)std::floor(lat) + 90, 0), GRID_ROWS - 1);
+        int col = (((int)std::floor(lon) + 180) % GRID_COLUMNS + GRID_COLUMNS) % GRID_COLUMNS;
+        return row * GRID_COLUMNS + col;
+    };
+
+    // the airports of each cell first, as in the SQL world
+    for (uint32_t i = 0; i < airports.size(); ++i) {
+        cells[cellOf(airports[i].latitude, airports[i].longitude)].push_back(i);
+    }
+    for (uint32_t i = 0; i < fixes.size(); ++i) {
+        if (fixes[i].flags & FIX_GLOBAL) {
+            cells[cellOf(fixes[i].latitude, fixes[i].longitude)].push_back(i | GRID_FIX_BIT);
+        }
+    }
+    for (auto &c: cells) {
+        gridOffsets.push_back(gridNodes.size());
+        gridNodes.insert(gridNodes.end(), c.begin(), c.end());
+    }
+    gridOffsets.push_back(gridNodes.size());
+}
+
+void FlatNavWriter::build_lod()
+{
+    // the same significance as world::AirportLOD: the longest runway, plus 1000 m for a tower
+    std::unordered_map<uint32_t, LodRecord> tables[LOD_TABLES];
+    for (uint32_t i = 0; i < airports.size(); ++i) {
+        auto &a = airports[i];
+        int towered = (a.flags & AIRPORT_TOWERED) ? 1 : 0;
+        float score = longestRunways[i] + (towered ? 1000 : 0);
+        for (int l = 0; l < LOD_LEVELS; l++) {
+            uint32_t row = (uint32_t)std::floor((a.latitude + 90) / LOD_CELL_DEGREES[l]);
+            uint32_t col = (uint32_t)std::floor((a.longitude + 180) / LOD_CELL_DEGREES[l]);
+            uint32_t key = (row << 16) | col;
+            auto &table = tables[towered * LOD_LEVELS + l];
+            auto it = table.find(key);
+            if (it == table.end() || score > it->second.score) {
+                table[key] = LodRecord{key, i, score};
+            }
+        }
+    }
+
+    for (auto &table: tables) {
+        lodOffsets.push_back(lodCells.size());
+        size_t first = lodCells.size();
+        for (auto &cell: table) {
+            lodCells.push_back(cell.second);
+        }
+        std::sort(lodCells.begin() + first, lodCells.end(), [] (const LodRecord &a, const LodRecord &b) {
+            return a.key < b.key;
+        });
+    }
+    lodOffsets.push_back(lodCells.size());
+}
+
+void FlatNavWriter::flatten_airports()
+{
+    for (uint32_t i = 0; i < airports.size(); ++i) {
+        auto &a = airports[i];
+        a.firstRunway = runways.size();
+        a.runwayCount = airportRunways[i].size();
+        runways.insert(runways.end(), airportRunways[i].begin(), airportRunways[i].end());
+        a.firstComm = comms.size();
+        a.commCount = airportComms[i].size();
+        comms.insert(comms.end(), airportComms[i].begin(), airportComms[i].end());
+        a.firstHelipad = helipads.size();
+        a.helipadCount = airportHelipads[i].size();
+        helipads.insert(helipads.end(), airportHelipads[i].begin(), airportHelipads[i].end());
+        a.firstTerminalFix = terminalFixes.size();
+        a.terminalFixCount = airportTerminalFixes[i].size();
+        terminalFixes.insert(terminalFixes.end(), airportTerminalFixes[i].begin(), airportTerminalFixes[i].end());
+        if (a.procedureCount == 0) {
+            a.firstProcedure = procedures.size();
+        }
+    }
+}
+
+template<typename T>
+static std::pair<const char *, size_t> blob(const std::vector<T> &v)
+{
+    return std::make_pair(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+}
+
+void FlatNavWriter::write_file(const std::string &filename)
+{
+    // in the order of flatnav::Section
+    std::pair<const char *, size_t> blobs[NUM_SECTIONS] = {
+        std::make_pair(strings.data(), strings.size()),
+        blob(airports), blob(runways), blob(comms), blob(helipads), blob(fixes),
+        blob(terminalFixes), blob(fixesById), blob(gridOffsets), blob(gridNodes),
+        blob(lodOffsets), blob(lodCells), blob(airways), blob(airwayOffsets), blob(airwayLegs),
+        blob(procedures), blob(transitions), blob(fixRefs), blob(entryOffsets), blob(entryProcedures),
+    };
+    uint32_t counts[NUM_SECTIONS] = {
+        (uint32_t)strings.size(),
+        (uint32_t)airports.size(), (uint32_t)runways.size(), (uint32_t)comms.size(), (uint32_t)helipads.size(), (uint32_t)fixes.size(),
+        (uint32_t)terminalFixes.size(), (uint32_t)fixesById.size(), (uint32_t)gridOffsets.size(), (uint32_t)gridNodes.size(),
+        (uint32_t)lodOffsets.size(), (uint32_t)lodCells.size(), (uint32_t)airways.size(), (uint32_t)airwayOffsets.size(), (uint32_t)airwayLegs.size(),
+        (uint32_t)procedures.size(), (uint32_t)transitions.size(), (uint32_t)fixRefs.size(), (uint32_t)entryOffsets.size(), (uint32_t)entryProcedures.size(),
+    };
+
+    auto align = [] (uint64_t offset) { return (offset + 7) & ~(uint64_t)7; };
+    uint64_t offset = align(sizeof(FileHeader));
+    for (int s = 0; s < (int)NUM_SECTIONS; ++s) {
+        header.sections[s].offset = offset;
+        header.sections[s].count = counts[s];
+        offset = align(offset + blobs[s].second);
+    }
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    const char zeros[8] = {};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < (int)NUM_SECTIONS; ++s) {
+        out.write(zeros, header.sections[s].offset - written);
+        out.write(blobs[s].first, blobs[s].second);
+        written = header.sections[s].offset + blobs[s].second;
+    }
+    if (!out) {
+        throw std::runtime_error("Couldn't write " + filename);
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "src/libnavsql/SqlDatabase.h"
+#include "src/libnavsql/SqlStatement.h"
+#include "src/libflatnav/FlatNavFormat.h"
+
+// Writes the flat NAV database mapped by flatnav::FlatWorld, from a complete Avitab SQL NAV database
+class FlatNavWriter
+{
+public:
+    FlatNavWriter(std::shared_ptr<sqlnav::SqlDatabase> navdb);
+    void write(const std::string &outfile);
+
+private:
+    void read_metadata();
+    void read_airports();
+    void read_comms();
+    void read_runways();
+    void read_helipads();
+    void read_fixes();
+    void read_localizers();
+    void read_airways();
+    void read_procedures();
+    void build_terminal_fixes();
+    void build_grid();
+    void build_lod();
+    void build_entries();
+    void flatten_airports();
+    void write_file(const std::string &filename);
+
+    flatnav::StringRef intern(const std::string &s);
+    std::vector<uint32_t> map_fixes(const std::vector<int> &fix_ids) const;
+    std::shared_ptr<sqlnav::SqlStatement> query(const char *sql);
+
+    std::shared_ptr<sqlnav::SqlDatabase> navdb;
+    flatnav::FileHeader header {};
+
+    std::string strings;
+    std::unordered_map<std::string, flatnav::StringRef> stringRefs;
+
+    std::vector<flatnav::AirportRecord> airports;
+    std::vector<std::string> airportIdents;
+    std::vector<float> longestRunways;
+    std::vector<std::vector<flatnav::CommRecord>> airportComms;
+    std::vector<std::vector<flatnav::RunwayRecord>> airportRunways;
+    std::vector<std::vector<flatnav::HelipadRecord>> airportHelipads;
+    std::vector<std::vector<uint32_t>> airportTerminalFixes;
+    std::unordered_map<int, uint32_t> airportIndex;      // by airport_id
+    std::unordered_map<int, uint32_t> runwayIndex;      // by runway_id, position in the airport's runways
+    std::unordered_map<int, bool> runwayPaired;         // by runway_id, false for ends without opposite
+
+    std::vector<flatnav::FixRecord> fixes;
+    std::vector<std::string> fixRegions, fixIdents;
+    std::vector<int> fixAirports;                       // airport_id of each fix, 0 if none
+    std::unordered_map<int, uint32_t> fixIndex;         // by fix_id
+
+    std::vector<flatnav::RunwayRecord> runways;
+    std::vector<flatnav::CommRecord> comms;
+    std::vector<flatnav::HelipadRecord> helipads;
+    std::vector<uint32_t> terminalFixes;
+    std::vector<uint32_t> fixesById;
+    std::vector<uint32_t> gridOffsets, gridNodes;
+    std::vector<uint32_t> lodOffsets;
+    std::vector<flatnav::LodRecord> lodCells;
+    std::vector<flatnav::AirwayRecord> airways;
+    std::vector<uint32_t> airwayOffsets;
+    std::vector<flatnav::AirwayLeg> airwayLegs;
+    std::vector<flatnav::ProcedureRecord> procedures;
+    std::vector<flatnav::TransitionRecord> transitions;
+    std::vector<uint32_t> fixRefs;
+    std::vector<uint32_t> entryOffsets, entryProcedures;
+};
@@ -0,0 +1,62 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include "Arena.h"
+
+namespace world {
+
+Arena::Arena(size_t blockSize):
+    blockSize(blockSize)
+{
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto aligned = [align] (char *p) {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<char *>((addr + align - 1) & ~(uintptr_t) (align - 1));
+    };
+
+    char *p = cur ? aligned(cur) : nullptr;
+    if (!p || static_cast<size_t>(p - cur) + size > left) {
+        // oversized requests get a block of their own so the current one isn't wasted
+        size_t needed = size + align;
+        if (needed > blockSize / 4) {
+            blocks.push_back(std::unique_ptr<char[]>(new char[needed]));
+            capacity += needed;
+            return aligned(blocks.back().get());
+        }
+        blocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+        capacity += blockSize;
+        cur = blocks.back().get();
+        left = blockSize;
+        p = aligned(cur);
+    }
+
+    left -= (p - cur) + size;
+    cur = p + size;
+    return p;
+}
+
+size_t Arena::getCapacity() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return capacity;
+}
+
+} /* namespace world */
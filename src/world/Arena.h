@@ -0,0 +1,80 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+namespace world {
+
+// Bump allocator for the model objects of a world. Memory is never reused,
+// it is released in one go when the last object allocated from the arena is
+// gone. That makes loading cheaper and tearing a world down almost free of
+// allocator work, at the cost of keeping discarded objects around.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 1 << 20);
+
+    void *allocate(size_t size, size_t align);
+    size_t getCapacity();
+
+private:
+    const size_t blockSize;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *cur = nullptr;
+    size_t left = 0;
+    size_t capacity = 0;
+};
+
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(std::shared_ptr<Arena> arena): arena(arena) { }
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other): arena(other.arena) { }
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) {
+        // released with the arena
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+    // copies in the shared_ptr control blocks keep the arena alive
+    std::shared_ptr<Arena> arena;
+};
+
+template<typename T, typename... Args>
+std::shared_ptr<T> makeInArena(const std::shared_ptr<Arena> &arena, Args&&... args) {
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+}
+
+} /* namespace world */
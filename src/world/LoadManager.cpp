@@ -26,19 +26,90 @@ void LoadManager::cancelLoading() {
     loadCancelled = true;
 }
 
+void LoadManager::resumeLoading() {
+    loadCancelled = false;
+}
+
 bool LoadManager::shouldCancelLoading() const {
     return loadCancelled;
 }
 
+void LoadManager::setProgressCallback(ProgressCallback cb) {
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    progressCallback = cb;
+}
+
+std::vector<LoadPhase> LoadManager::getLoadPhases() const {
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    return phases;
+}
+
+void LoadManager::beginPhase(const std::string &name) {
+    endPhase();
+
+    LoadPhase phase;
+    ProgressCallback cb;
+    {
+        std::lock_guard<std::mutex> lock(phaseMutex);
+        phase.name = name;
+        phases.push_back(phase);
+        phaseStart = std::chrono::steady_clock::now();
+        cb = progressCallback;
+    }
+
+    logger::verbose("Loading %s...", name.c_str());
+    if (cb) {
+        cb(phase);
+    }
+}
+
+void LoadManager::endPhase(size_t records, uint64_t bytes) {
+    LoadPhase phase;
+    ProgressCallback cb;
+    {
+        std::lock_guard<std::mutex> lock(phaseMutex);
+        if (phases.empty() || phases.back().done) {
+            return;
+        }
+        auto &cur = phases.back();
+        cur.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - phaseStart).count();
+        cur.records = records;
+        cur.bytes = bytes;
+        cur.done = true;
+        phase = cur;
+        cb = progressCallback;
+    }
+
+    if (cb) {
+        cb(phase);
+    }
+}
+
+void LoadManager::logLoadPhases() const {
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    for (auto &phase: phases) {
+        logger::info("  %-14s %7.2f s %9d records %8.1f MB", phase.name.c_str(),
+            phase.seconds, (int) phase.records, phase.bytes / (1024.0 * 1024.0));
+    }
+}
+
 void LoadManager::setUserFixesFilename(std::string &filename) {
     userFixesFilename = filename;
 }
 
+void LoadManager::setLazyProcedureLoading(bool lazy) {
+    lazyProcedures = lazy;
+}
+
+void LoadManager::setCacheDirectory(const std::string &dir) {
+    cacheDirectory = dir;
+}
+
 void LoadManager::loadUserFixes(std::string &userFixesFilename) {
     try {
         UserFixLoader loader(shared_from_this());
-        loader.load(userFixesFilename);
-        logger::info("Loaded %s", userFixesFilename.c_str());
+        size_t count = loader.load(userFixesFilename);
+        logger::info("Loaded %d user fixes from %s", (int) count, userFixesFilename.c_str());
 
     } catch (const std::exception &e) {
         // User fixes are optional, so could be no CSV file or parse error
@@ -21,9 +21,24 @@
 #include "src/world/World.h"
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
 
 namespace world {
 
+// One step of loading the nav world, e.g. parsing the airports
+struct LoadPhase {
+    std::string name;
+    double seconds = 0;
+    size_t records = 0;
+    uint64_t bytes = 0;
+    bool done = false;
+};
+
 class LoadManager : public std::enable_shared_from_this<LoadManager> {
 public:
     virtual std::shared_ptr<World> getWorld() = 0;
@@ -31,22 +46,48 @@ public:
     virtual void discoverSceneries() = 0;
     virtual void load() = 0;
     virtual void reloadMetar() = 0;
+    // The files the world is loaded from. A loaded world is kept, e.g. when the plugin
+    // is enabled again, while none of them changed. Empty if that can't be told.
+    virtual std::vector<std::string> getSourceFiles() { return {}; }
 
     virtual NavNodeList loadFlightPlan(const std::string filename);
 
     void setUserFixesFilename(std::string &filename);
+    // parse CIFP procedures when an airport's procedures are first used
+    void setLazyProcedureLoading(bool lazy);
+    // where a binary snapshot of parsed nav data may be kept, empty to disable
+    void setCacheDirectory(const std::string &dir);
     void loadUserFixes(std::string &filename);
 
     void cancelLoading();
+    // allows loading after cancelLoading again, e.g. the lazy procedures of a kept world
+    void resumeLoading();
     bool shouldCancelLoading() const;
 
+    // Called on the loading thread when a phase starts and when it is done
+    using ProgressCallback = std::function<void(const LoadPhase &)>;
+    void setProgressCallback(ProgressCallback cb);
+    std::vector<LoadPhase> getLoadPhases() const;
+
 protected:
     void loadUserFixes();
 
+    // Phases don't nest, beginning a phase ends the one that is still running
+    void beginPhase(const std::string &name);
+    void endPhase(size_t records = 0, uint64_t bytes = 0);
+    void logLoadPhases() const;
+
 protected:
     std::atomic_bool loadCancelled { false };
     std::string userFixesFilename;
+    bool lazyProcedures = false;
+    std::string cacheDirectory;
 
+private:
+    mutable std::mutex phaseMutex;
+    std::vector<LoadPhase> phases;
+    std::chrono::steady_clock::time_point phaseStart;
+    ProgressCallback progressCallback;
 };
 
 } /* namespace world */
@@ -0,0 +1,46 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "StringPool.h"
+
+namespace world {
+
+StringPool &StringPool::global() {
+    static StringPool pool;
+    return pool;
+}
+
+const std::string &StringPool::intern(std::string_view str) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = index.find(str);
+    if (it != index.end()) {
+        return *it->second;
+    }
+
+    // deque never moves its elements, so the view in the index stays valid
+    const std::string &stored = storage.emplace_back(str);
+    index.emplace(std::string_view(stored), &stored);
+    return stored;
+}
+
+size_t StringPool::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return storage.size();
+}
+
+} /* namespace world */
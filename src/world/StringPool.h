@@ -0,0 +1,44 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+
+namespace world {
+
+// Stores one copy of each distinct identifier. The returned references stay
+// valid for the lifetime of the program, so they can be shared by all model
+// objects and used as string_view keys in the world's maps.
+class StringPool {
+public:
+    static StringPool &global();
+
+    const std::string &intern(std::string_view str);
+    size_t size();
+
+private:
+    std::mutex mutex;
+    std::deque<std::string> storage;
+    std::unordered_map<std::string_view, const std::string *> index;
+};
+
+} /* namespace world */
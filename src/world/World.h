@@ -18,6 +18,7 @@
 #pragma once
 
 #include <map>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <functional>
@@ -36,6 +37,7 @@ constexpr const double M_TO_FT = 3.28084;
 constexpr const double LAT_TO_KM = 111.133f;
 
 class RouteFinder;
+class Route;
 
 class World : public std::enable_shared_from_this<World>{
 public:
@@ -49,22 +51,44 @@ public:
     static constexpr const int VISIT_EVERYTHING = (VISIT_TOWERED_AIRPORTS | VISIT_OTHER_AIRPORTS | VISIT_NAVAIDS | VISIT_FIXES | VISIT_USER_FIXES);
 
     using NodeAcceptor = std::function<void(const world::NavNode *)>;
-    using Connection = std::pair<std::shared_ptr<NavEdge>, std::shared_ptr<NavNode>>;
+
+    struct Connection {
+        Connection(const std::shared_ptr<NavNode> &from, std::shared_ptr<NavEdge> via, std::shared_ptr<NavNode> to):
+            via(via), to(to), distance(from->getLocation().distanceTo(to->getLocation())) { }
+
+        std::shared_ptr<NavEdge> via;
+        std::shared_ptr<NavNode> to;
+        // great-circle length in metres, computed once when the nodes are linked
+        double distance;
+    };
+    using ConnectionList = std::shared_ptr<const std::vector<Connection>>;
 
     virtual int maxDensity(const world::Location &bottomLeft, const world::Location &topRight) = 0;
     virtual void visitNodes(const world::Location &bottomLeft, const world::Location &topRight, NodeAcceptor calllback, int filter) = 0;
+    // at most one airport, the most significant, per cell of at least cellDegrees
+    // each node within bufferNm of the route's legs, reported once. as with visitNodes,
+    // worlds that load nodes by area may miss those of areas not loaded yet
+    virtual void visitAlongRoute(const Route &route, double bufferNm, NodeAcceptor callback, int filter) = 0;
+    virtual void visitMajorAirports(const world::Location &bottomLeft, const world::Location &topRight, double cellDegrees, NodeAcceptor callback, int filter) = 0;
+    // changes whenever nodes are added, so clients can tell if an earlier visit is still complete
+    virtual uint32_t getNodeRevision() const = 0;
+    // hint that the areas along these paths, nearest to the start of the first one first, will be visited soon
+    virtual void prefetchAlong(const std::vector<std::vector<world::Location>> &paths) = 0;
 
     virtual std::shared_ptr<Airport> findAirportByID(const std::string &id) const = 0;
     virtual std::shared_ptr<Fix> findFixByRegionAndID(const std::string &region, const std::string &id) const = 0;
     virtual std::vector<std::shared_ptr<Airport>> findAirport(const std::string &keyWord) const = 0;
 
-    virtual std::vector<Connection> &getConnections(std::shared_ptr<NavNode> from) = 0;
+    // a snapshot that stays valid while the world links more nodes or drops its caches
+    virtual ConnectionList getConnections(std::shared_ptr<NavNode> from) = 0;
     virtual bool areConnected(std::shared_ptr<NavNode> from, const std::shared_ptr<NavNode> to) = 0;
 
     virtual void addRegion(const std::string &code) = 0;
     virtual std::shared_ptr<Region> getRegion(const std::string &code) = 0;
 
     virtual void addFix(std::shared_ptr<Fix> f) = 0;
+    // replaces all user fixes at once, visits see either the previous or the new set
+    virtual void setUserFixes(const std::vector<std::shared_ptr<Fix>> &fixes) = 0;
 
     virtual std::shared_ptr<RouteFinder> getRouteFinder() = 0;
 };
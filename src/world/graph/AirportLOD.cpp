@@ -0,0 +1,93 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include "AirportLOD.h"
+#include "src/world/World.h"
+
+namespace world {
+
+float AirportLOD::getSignificance(const Airport &airport) {
+    float score = airport.getLongestRunwayLength();
+    if (airport.hasControlTower()) {
+        score += TOWER_BONUS_METERS;
+    }
+    return score;
+}
+
+void AirportLOD::add(const Airport *airport) {
+    auto &loc = airport->getLocation();
+    int towered = airport->hasControlTower() ? 1 : 0;
+    float score = getSignificance(*airport);
+
+    for (int l = 0; l < NUM_LEVELS; l++) {
+        uint32_t row = (uint32_t) std::floor((loc.latitude + 90) / CELL_DEGREES[l]);
+        uint32_t col = (uint32_t) std::floor((loc.longitude + 180) / CELL_DEGREES[l]);
+        auto &cell = cells[towered][l][(row << 16) | col];
+        if (!cell.airport || score > cell.score) {
+            cell = Pick{airport, score};
+        }
+    }
+}
+
+void AirportLOD::visit(const Location &bottomLeft, const Location &topRight, double cellDegrees, int filter, const Visitor &visitor) const {
+    bool wantTowered = filter & World::VISIT_TOWERED_AIRPORTS;
+    bool wantOther = filter & World::VISIT_OTHER_AIRPORTS;
+    if (!wantTowered && !wantOther) {
+        return;
+    }
+
+    int l = 0;
+    while (l < NUM_LEVELS - 1 && CELL_DEGREES[l] < cellDegrees) {
+        l++;
+    }
+    double size = CELL_DEGREES[l];
+    int columns = (int) std::round(360 / size);
+
+    int row0 = (int) std::floor((std::max(bottomLeft.latitude, -90.0) + 90) / size);
+    int row1 = (int) std::floor((std::min(topRight.latitude, 90.0) + 90) / size);
+    int col0 = (int) std::floor((bottomLeft.longitude + 180) / size);
+    int col1 = (int) std::floor((topRight.longitude + 180) / size);
+    // the area might span the -180/180 meridian. bias it here, normalise again in the iteration
+    if (col1 < col0) { col1 += columns; }
+    col1 = std::min(col1, col0 + columns - 1);
+
+    for (int row = row0; row <= row1; row++) {
+        for (int c = col0; c <= col1; c++) {
+            uint32_t col = ((c % columns) + columns) % columns;
+            uint32_t key = ((uint32_t) row << 16) | col;
+
+            // the more significant of the selected partitions represents the cell
+            const Pick *best = nullptr;
+            for (int towered = 0; towered < 2; towered++) {
+                if (!(towered ? wantTowered : wantOther)) {
+                    continue;
+                }
+                auto it = cells[towered][l].find(key);
+                if (it != cells[towered][l].end() && (!best || it->second.score > best->score)) {
+                    best = &it->second;
+                }
+            }
+            if (best) {
+                visitor(best->airport);
+            }
+        }
+    }
+}
+
+} /* namespace world */
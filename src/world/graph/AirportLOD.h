@@ -0,0 +1,59 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include "src/world/models/airport/Airport.h"
+
+namespace world {
+
+/*
+ * Picks the most significant airport of each cell for a range of cell sizes,
+ * so that a zoomed-out map can show the major airports at a cost that only
+ * depends on the number of cells on screen. Towered and other airports are
+ * kept apart so the usual VISIT_ filter bits apply.
+ */
+class AirportLOD {
+public:
+    using Visitor = std::function<void(const NavNode *)>;
+
+    // the airport must be complete, its runways and frequencies decide its significance
+    void add(const Airport *airport);
+
+    // visits at most one airport per cell of at least cellDegrees, the area may span the -180/180 meridian
+    void visit(const Location &bottomLeft, const Location &topRight, double cellDegrees, int filter, const Visitor &visitor) const;
+
+private:
+    static constexpr const int NUM_LEVELS = 7;
+    static constexpr const double CELL_DEGREES[NUM_LEVELS] = {0.25, 0.5, 1, 2, 4, 8, 16};
+    static constexpr const int TOWER_BONUS_METERS = 1000;
+
+    struct Pick {
+        const Airport *airport;
+        float score;
+    };
+
+    // [towered][level], cells keyed by row * 65536 + column
+    std::unordered_map<uint32_t, Pick> cells[2][NUM_LEVELS];
+
+    static float getSignificance(const Airport &airport);
+};
+
+} /* namespace world */
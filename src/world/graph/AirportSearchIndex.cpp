@@ -0,0 +1,169 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cctype>
+#include "AirportSearchIndex.h"
+
+namespace world {
+
+void AirportSearchIndex::add(Key key, const std::string &id, const std::string &name) {
+    Entry e;
+    e.key = key;
+    e.id = id;
+    e.text = normalize(id) + " ";
+    e.nameStart = e.text.size();
+    e.text += normalize(name);
+    entries.push_back(std::move(e));
+}
+
+void AirportSearchIndex::build() {
+    trigrams.clear();
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        auto &text = entries[i].text;
+        for (size_t pos = 0; pos + 3 <= text.size(); pos++) {
+            auto &list = trigrams[trigramAt(text, pos)];
+            // entries are visited in order, so the lists stay sorted and a repeated
+            // trigram in the same text is always at the end of its list
+            if (list.empty() || list.back() != i) {
+                list.push_back(i);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    lastQuery.clear();
+    lastMatches.clear();
+}
+
+std::vector<AirportSearchIndex::Key> AirportSearchIndex::search(const std::string &keyWord, size_t maxResults) const {
+    std::string query = normalize(keyWord);
+    query.erase(0, query.find_first_not_of(' '));
+    query.erase(query.find_last_not_of(' ') + 1);
+    if (query.empty()) {
+        return {};
+    }
+
+    std::vector<uint32_t> matches;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!lastQuery.empty() && query.find(lastQuery) != std::string::npos) {
+            // refinement of the previous query: its matches are a superset of the new ones
+            matches = lastMatches;
+        } else {
+            matches = findCandidates(query);
+        }
+    }
+
+    matches.erase(std::remove_if(matches.begin(), matches.end(), [this, &query] (uint32_t i) {
+        return entries[i].text.find(query) == std::string::npos;
+    }), matches.end());
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        lastQuery = query;
+        lastMatches = matches;
+    }
+
+    std::vector<std::pair<int, uint32_t>> ranked;
+    ranked.reserve(matches.size());
+    for (auto i: matches) {
+        ranked.push_back(std::make_pair(rank(entries[i], query), i));
+    }
+
+    size_t count = std::min(ranked.size(), maxResults);
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+        [this] (const std::pair<int, uint32_t> &a, const std::pair<int, uint32_t> &b) {
+            if (a.first != b.first) {
+                return a.first < b.first;
+            }
+            return entries[a.second].id < entries[b.second].id;
+    });
+
+    std::vector<Key> res;
+    for (size_t i = 0; i < count; i++) {
+        res.push_back(entries[ranked[i].second].key);
+    }
+    return res;
+}
+
+size_t AirportSearchIndex::size() const {
+    return entries.size();
+}
+
+uint32_t AirportSearchIndex::trigramAt(const std::string &s, size_t pos) {
+    return ((uint8_t) s[pos] << 16) | ((uint8_t) s[pos + 1] << 8) | (uint8_t) s[pos + 2];
+}
+
+std::string AirportSearchIndex::normalize(const std::string &s) {
+    std::string res;
+    res.reserve(s.size());
+    for (char c: s) {
+        // only ASCII is folded, UTF-8 sequences in names are kept as they are
+        res.push_back((char) std::tolower((unsigned char) c));
+    }
+    return res;
+}
+
+std::vector<uint32_t> AirportSearchIndex::findCandidates(const std::string &query) const {
+    if (query.size() < 3) {
+        // too short for trigrams, every entry is a candidate
+        std::vector<uint32_t> all(entries.size());
+        for (uint32_t i = 0; i < all.size(); i++) {
+            all[i] = i;
+        }
+        return all;
+    }
+
+    std::vector<const std::vector<uint32_t> *> lists;
+    for (size_t pos = 0; pos + 3 <= query.size(); pos++) {
+        auto it = trigrams.find(trigramAt(query, pos));
+        if (it == trigrams.end()) {
+            return {};
+        }
+        lists.push_back(&it->second);
+    }
+
+    // intersect starting with the rarest trigram to keep the working set small
+    std::sort(lists.begin(), lists.end(), [] (auto a, auto b) { return a->size() < b->size(); });
+    std::vector<uint32_t> res = *lists.front();
+    std::vector<uint32_t> tmp;
+    for (size_t i = 1; i < lists.size() && !res.empty(); i++) {
+        tmp.clear();
+        std::set_intersection(res.begin(), res.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(tmp));
+        res.swap(tmp);
+    }
+    return res;
+}
+
+int AirportSearchIndex::rank(const Entry &e, const std::string &query) const {
+    size_t idLen = e.nameStart - 1;
+    if (query.size() <= idLen && e.text.compare(0, query.size(), query) == 0) {
+        return (query.size() == idLen) ? 0 : 1;
+    }
+
+    size_t pos = e.text.find(query, e.nameStart);
+    while (pos != std::string::npos) {
+        if (pos == e.nameStart || !std::isalnum((unsigned char) e.text[pos - 1])) {
+            return 2;
+        }
+        pos = e.text.find(query, pos + 1);
+    }
+    return 3;
+}
+
+} /* namespace world */
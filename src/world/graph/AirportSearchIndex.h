@@ -0,0 +1,70 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+namespace world {
+
+/*
+ * Search index over airport identifiers and names.
+ * Hits are found via trigram posting lists and then checked for a real
+ * substring match. They are ranked: exact ID, then ID prefix, then a word
+ * prefix of the name, then any other match, with ties ordered by ID.
+ * The matches of the previous query are kept, so a query that extends it
+ * (typing another character) only filters those matches instead of going
+ * back to the index.
+ */
+class AirportSearchIndex {
+public:
+    using Key = uint32_t;
+
+    // Keys are chosen by the owner, e.g. a position in its airport list
+    void add(Key key, const std::string &id, const std::string &name);
+    void build();
+
+    std::vector<Key> search(const std::string &keyWord, size_t maxResults) const;
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        Key key;
+        std::string id;
+        std::string text; // lower case "id name"
+        uint32_t nameStart;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams;
+
+    mutable std::mutex cacheMutex;
+    mutable std::string lastQuery;
+    mutable std::vector<uint32_t> lastMatches;
+
+    static uint32_t trigramAt(const std::string &s, size_t pos);
+    static std::string normalize(const std::string &s);
+    std::vector<uint32_t> findCandidates(const std::string &query) const;
+    int rank(const Entry &e, const std::string &query) const;
+};
+
+} /* namespace world */
@@ -0,0 +1,169 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include "Corridor.h"
+
+namespace world {
+
+namespace {
+
+Corridor::Area makeArea(double minLat, double minLon, double maxLat, double maxLon, size_t piece) {
+    Corridor::Area area;
+    area.minLat = minLat;
+    area.minLon = minLon;
+    area.maxLat = maxLat;
+    area.maxLon = maxLon;
+    area.piece = piece;
+    return area;
+}
+
+}
+
+Corridor::Corridor(const std::vector<Location> &path, double widthMetres) {
+    double width = std::min(widthMetres / EARTH_RADIUS_METRES, M_PI / 2);
+    sinWidth = std::sin(width);
+    cosWidth = std::cos(width);
+    double widthDegrees = width * 180 / M_PI;
+
+    auto toVec = [] (const Location &loc) {
+        double phi = loc.latitude * M_PI / 180.0;
+        double lambda = loc.longitude * M_PI / 180.0;
+        return Vec {std::cos(phi) * std::cos(lambda), std::cos(phi) * std::sin(lambda), std::sin(phi)};
+    };
+
+    if (path.size() == 1) {
+        auto p = toVec(path[0]);
+        addPiece(p, p, widthDegrees);
+    }
+
+    for (size_t i = 0; i + 1 < path.size(); ++i) {
+        auto a = toVec(path[i]);
+        auto b = toVec(path[i + 1]);
+        double dot = std::max(-1.0, std::min(1.0, a.x * b.x + a.y * b.y + a.z * b.z));
+        double theta = std::acos(dot);
+        double sinTheta = std::sin(theta);
+        int count = (int) std::ceil(theta * 180 / M_PI / MAX_PIECE_DEGREES);
+        if ((count <= 1) || (sinTheta < 1e-9)) {
+            addPiece(a, b, widthDegrees);
+            continue;
+        }
+
+        // the pieces end at evenly spaced points of the great circle from a to b
+        Vec from = a;
+        for (int s = 1; s <= count; ++s) {
+            double t = (double) s / count;
+            double wa = std::sin((1 - t) * theta) / sinTheta;
+            double wb = std::sin(t * theta) / sinTheta;
+            Vec to {wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z};
+            addPiece(from, to, widthDegrees);
+            from = to;
+        }
+    }
+}
+
+const std::vector<Corridor::Area> &Corridor::getAreas() const {
+    return areas;
+}
+
+bool Corridor::contains(const Location &loc) const {
+    double phi = loc.latitude * M_PI / 180.0;
+    double lambda = loc.longitude * M_PI / 180.0;
+    Vec p {std::cos(phi) * std::cos(lambda), std::cos(phi) * std::sin(lambda), std::sin(phi)};
+
+    for (auto &area: areas) {
+        if (loc.latitude < area.minLat || loc.latitude > area.maxLat ||
+            loc.longitude < area.minLon || loc.longitude > area.maxLon) {
+            continue;
+        }
+        if (isNear(pieces[area.piece], p)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Corridor::addPiece(const Vec &a, const Vec &b, double widthDegrees) {
+    Piece piece {a, b, {0, 0, 0}};
+    Vec n {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    double len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+    if (len > 1e-12) {
+        piece.normal = Vec {n.x / len, n.y / len, n.z / len};
+    }
+    size_t index = pieces.size();
+    pieces.push_back(piece);
+
+    double latA = std::asin(std::max(-1.0, std::min(1.0, a.z))) * 180 / M_PI;
+    double latB = std::asin(std::max(-1.0, std::min(1.0, b.z))) * 180 / M_PI;
+    double lonA = std::atan2(a.y, a.x) * 180 / M_PI;
+    double lonB = std::atan2(b.y, b.x) * 180 / M_PI;
+
+    double pad = widthDegrees + BULGE_DEGREES;
+    double minLat = std::max(-90.0, std::min(latA, latB) - pad);
+    double maxLat = std::min(90.0, std::max(latA, latB) + pad);
+
+    // longitudes shrink towards the poles, near them the corridor can reach any longitude
+    double cosLat = std::cos(std::max(std::abs(minLat), std::abs(maxLat)) * M_PI / 180);
+    double dLon = std::remainder(lonB - lonA, 360.0);
+    double lonPad = (cosLat > 1e-6) ? (pad / cosLat) : 360;
+    double minLon = lonA + std::min(0.0, dLon) - lonPad;
+    double maxLon = lonA + std::max(0.0, dLon) + lonPad;
+    if (maxLon - minLon >= 360) {
+        areas.push_back(makeArea(minLat, -180, maxLat, 180, index));
+        return;
+    }
+
+    if (minLon < -180) {
+        minLon += 360;
+        maxLon += 360;
+    }
+    if (maxLon > 180) {
+        areas.push_back(makeArea(minLat, minLon, maxLat, 180, index));
+        areas.push_back(makeArea(minLat, -180, maxLat, maxLon - 360, index));
+    } else {
+        areas.push_back(makeArea(minLat, minLon, maxLat, maxLon, index));
+    }
+}
+
+bool Corridor::isNear(const Piece &piece, const Vec &p) const {
+    auto dot = [] (const Vec &u, const Vec &v) {
+        return u.x * v.x + u.y * v.y + u.z * v.z;
+    };
+
+    // close to one of the ends
+    if ((dot(p, piece.a) >= cosWidth) || (dot(p, piece.b) >= cosWidth)) {
+        return true;
+    }
+
+    auto &n = piece.normal;
+    if (n.x == 0 && n.y == 0 && n.z == 0) {
+        return false;
+    }
+
+    // otherwise the nearest point must lie between the ends, a is before and b after it
+    auto tripleWithNormal = [&n] (const Vec &u, const Vec &v) {
+        Vec c {u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+        return c.x * n.x + c.y * n.y + c.z * n.z;
+    };
+    if ((tripleWithNormal(piece.a, p) < 0) || (tripleWithNormal(p, piece.b) < 0)) {
+        return false;
+    }
+    return std::abs(dot(p, n)) <= sinWidth;
+}
+
+} /* namespace world */
@@ -0,0 +1,69 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "src/world/models/Location.h"
+
+namespace world {
+
+/*
+ * The locations within a given distance of a path of great circle legs.
+ * Long legs are cut into pieces of a few degrees, each covered by a lat/lon
+ * area that spatial searches can prune with. A location inside one of the
+ * areas is then tested against the great circle piece of that area.
+ */
+class Corridor {
+public:
+    // within -180/180, an area that spans the meridian is split in two
+    struct Area {
+        double minLat, minLon, maxLat, maxLon;
+        size_t piece;
+    };
+
+    Corridor(const std::vector<Location> &path, double widthMetres);
+
+    const std::vector<Area> &getAreas() const;
+    bool contains(const Location &loc) const;
+
+private:
+    static constexpr const double MAX_PIECE_DEGREES = 2;
+    // a piece of at most MAX_PIECE_DEGREES bulges less than this beyond its ends
+    static constexpr const double BULGE_DEGREES = 0.1;
+    static constexpr const double EARTH_RADIUS_METRES = 6371000;
+
+    struct Vec {
+        double x, y, z;
+    };
+
+    struct Piece {
+        Vec a, b;
+        // unit normal of the great circle through a and b, zero for a single point
+        Vec normal;
+    };
+
+    double sinWidth, cosWidth;
+    std::vector<Piece> pieces;
+    std::vector<Area> areas;
+
+    void addPiece(const Vec &a, const Vec &b, double widthDegrees);
+    bool isNear(const Piece &piece, const Vec &p) const;
+};
+
+} /* namespace world */
@@ -0,0 +1,112 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cmath>
+#include "DensityPyramid.h"
+
+namespace world {
+
+DensityPyramid::DensityPyramid() {
+    for (int l = 0; l < NUM_LEVELS; l++) {
+        int size = CELL_DEGREES[l];
+        levels[l].resize((ROWS / size) * (COLUMNS / size), 0);
+    }
+}
+
+void DensityPyramid::add(int lat, int lon, int count) {
+    if (lat < -90 || lat > 89) {
+        return;
+    }
+    int row = lat + 90;
+    int col = ((lon + 180) % COLUMNS + COLUMNS) % COLUMNS;
+
+    auto &squares = levels[0];
+    int n = (squares[row * COLUMNS + col] += count);
+
+    // counts only grow, so the coarse levels can be kept up to date without a rebuild
+    for (int l = 1; l < NUM_LEVELS; l++) {
+        int size = CELL_DEGREES[l];
+        auto &cell = levels[l][(row / size) * (COLUMNS / size) + (col / size)];
+        cell = std::max(cell, n);
+    }
+}
+
+int DensityPyramid::getCount(int lat, int lon) const {
+    if (lat < -90 || lat > 89) {
+        return 0;
+    }
+    int col = ((lon + 180) % COLUMNS + COLUMNS) % COLUMNS;
+    return levels[0][(lat + 90) * COLUMNS + col];
+}
+
+int DensityPyramid::maxInArea(const Location &bottomLeft, const Location &topRight) const {
+    // same square selection as the original per-square search
+    int row0 = std::max((int)std::floor(bottomLeft.latitude), -90) + 90;
+    int row1 = std::min((int)std::ceil(topRight.latitude), 89) + 90;
+    int lonl = (int)std::floor(bottomLeft.longitude);
+    int lonh = (int)std::ceil(topRight.longitude);
+    if (row0 > row1) {
+        return 0;
+    }
+
+    // the area might span the -180/180 meridian. bias it, then split it into column ranges
+    if (lonh < lonl) { lonh += 360; }
+    if (lonh - lonl >= COLUMNS) {
+        return maxInSquares(NUM_LEVELS - 1, row0, row1, 0, COLUMNS - 1);
+    }
+    int col0 = ((lonl + 180) % COLUMNS + COLUMNS) % COLUMNS;
+    int col1 = col0 + (lonh - lonl);
+    if (col1 < COLUMNS) {
+        return maxInSquares(NUM_LEVELS - 1, row0, row1, col0, col1);
+    }
+    return std::max(maxInSquares(NUM_LEVELS - 1, row0, row1, col0, COLUMNS - 1),
+                    maxInSquares(NUM_LEVELS - 1, row0, row1, 0, col1 - COLUMNS));
+}
+
+int DensityPyramid::maxInSquares(int level, int row0, int row1, int col0, int col1) const {
+    int m = 0;
+    if (level == 0) {
+        auto &squares = levels[0];
+        for (int row = row0; row <= row1; row++) {
+            for (int col = col0; col <= col1; col++) {
+                m = std::max(m, squares[row * COLUMNS + col]);
+            }
+        }
+        return m;
+    }
+
+    // use the cells that are fully covered, descend into the partially covered ones
+    int size = CELL_DEGREES[level];
+    int columns = COLUMNS / size;
+    for (int r = row0 / size; r <= row1 / size; r++) {
+        int r0 = std::max(row0, r * size);
+        int r1 = std::min(row1, r * size + size - 1);
+        for (int c = col0 / size; c <= col1 / size; c++) {
+            int c0 = std::max(col0, c * size);
+            int c1 = std::min(col1, c * size + size - 1);
+            if (r1 - r0 + 1 == size && c1 - c0 + 1 == size) {
+                m = std::max(m, levels[level][r * columns + c]);
+            } else {
+                m = std::max(m, maxInSquares(level - 1, r0, r1, c0, c1));
+            }
+        }
+    }
+    return m;
+}
+
+} /* namespace world */
@@ -0,0 +1,53 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <vector>
+#include "src/world/models/Location.h"
+
+namespace world {
+
+/*
+ * Node counts per 1 degree lat/lon square, with 5 and 15 degree levels that
+ * hold the maximum of the squares below them. Finding the densest square of a
+ * large area only reads the coarse cells that are fully covered and descends
+ * at the edges.
+ */
+class DensityPyramid {
+public:
+    DensityPyramid();
+
+    // lat/lon are the south-west corner of the square
+    void add(int lat, int lon, int count = 1);
+    int getCount(int lat, int lon) const;
+
+    // highest count of the squares touched by the area, the area may span the -180/180 meridian
+    int maxInArea(const Location &bottomLeft, const Location &topRight) const;
+
+private:
+    static constexpr const int NUM_LEVELS = 3;
+    static constexpr const int CELL_DEGREES[NUM_LEVELS] = {1, 5, 15};
+    static constexpr const int ROWS = 180;
+    static constexpr const int COLUMNS = 360;
+
+    std::vector<int> levels[NUM_LEVELS];
+
+    int maxInSquares(int level, int row0, int row1, int col0, int col1) const;
+};
+
+} /* namespace world */
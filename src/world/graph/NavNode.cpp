@@ -29,4 +29,12 @@ bool NavNode::isGlobalFix() const {
     return false;
 }
 
+uint32_t NavNode::getGraphIndex() const {
+    return graphIndex;
+}
+
+void NavNode::setGraphIndex(uint32_t index) {
+    graphIndex = index;
+}
+
 } /* namespace world */
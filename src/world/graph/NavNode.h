@@ -19,12 +19,16 @@
 
 #include <string>
 #include <memory>
+#include <cstdint>
 #include <vector>
+#include <atomic>
 #include "src/world/models/Location.h"
 
 namespace world {
 
-class NavNode {
+// Nodes are always owned by shared pointers, so users of the raw pointers
+// passed by the visitors can keep a node alive beyond the next eviction.
+class NavNode: public std::enable_shared_from_this<NavNode> {
 public:
     virtual const std::string &getID() const = 0;
     virtual const Location& getLocation() const = 0;
@@ -33,7 +37,15 @@ public:
     virtual bool isRunway() const;
     virtual bool isGlobalFix() const;
 
+    // Dense index into the connection table of the owning world, 0 if the node isn't linked to any other
+    uint32_t getGraphIndex() const;
+    void setGraphIndex(uint32_t index);
+
     virtual ~NavNode() = default;
+
+private:
+    // assigned while searches may read it when procedures are loaded on first use
+    std::atomic<uint32_t> graphIndex { 0 };
 };
 
 using NavNodeList = std::vector<std::shared_ptr<NavNode>>;
@@ -0,0 +1,318 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include "SpatialIndex.h"
+#include "src/world/World.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#   define AVITAB_INDEX_SSE2 1
+#   include <emmintrin.h>
+#elif defined(__aarch64__)
+#   define AVITAB_INDEX_NEON 1
+#   include <arm_neon.h>
+#endif
+
+namespace world {
+
+static_assert((1 << SpatialIndex::TOWERED_AIRPORTS) == World::VISIT_TOWERED_AIRPORTS, "partition order");
+static_assert((1 << SpatialIndex::OTHER_AIRPORTS) == World::VISIT_OTHER_AIRPORTS, "partition order");
+static_assert((1 << SpatialIndex::FIXES) == World::VISIT_FIXES, "partition order");
+static_assert((1 << SpatialIndex::NAVAIDS) == World::VISIT_NAVAIDS, "partition order");
+static_assert((1 << SpatialIndex::USER_FIXES) == World::VISIT_USER_FIXES, "partition order");
+
+SpatialIndex::Partition SpatialIndex::partitionOf(const NavNode &node) {
+    if (node.isAirport()) {
+        auto &airport = static_cast<const Airport &>(node);
+        return airport.hasControlTower() ? TOWERED_AIRPORTS : OTHER_AIRPORTS;
+    }
+    auto fix = dynamic_cast<const Fix *>(&node);
+    if (fix && fix->isNavaid()) {
+        return NAVAIDS;
+    } else if (fix && fix->isUserFix()) {
+        return USER_FIXES;
+    }
+    return FIXES;
+}
+
+void SpatialIndex::add(std::shared_ptr<NavNode> node) {
+    auto &tree = trees[partitionOf(*node)];
+    tree.nodes.push_back(node);
+    tree.dirty = true;
+}
+
+void SpatialIndex::build() {
+    for (auto &tree: trees) {
+        if (tree.dirty) {
+            buildTree(tree);
+        }
+    }
+}
+
+size_t SpatialIndex::size() const {
+    size_t n = 0;
+    for (auto &tree: trees) {
+        n += tree.nodes.size();
+    }
+    return n;
+}
+
+uint64_t SpatialIndex::hilbertIndex(const Location &loc) {
+    constexpr uint32_t N = 1 << 16;
+    uint32_t x = std::min<uint32_t>(N - 1, (uint32_t) std::max(0.0, (loc.longitude + 180) / 360 * N));
+    uint32_t y = std::min<uint32_t>(N - 1, (uint32_t) std::max(0.0, (loc.latitude + 90) / 180 * N));
+
+    uint64_t d = 0;
+    for (uint32_t s = N / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += (uint64_t) s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = N - 1 - x;
+                y = N - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+void SpatialIndex::buildTree(Tree &tree) {
+    tree.dirty = false;
+    tree.levels.clear();
+
+    auto &nodes = tree.nodes;
+    std::vector<std::pair<uint64_t, size_t>> order;
+    order.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        order.emplace_back(hilbertIndex(nodes[i]->getLocation()), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    NavNodeList sorted;
+    sorted.reserve(nodes.size());
+    for (auto &o: order) {
+        sorted.push_back(std::move(nodes[o.second]));
+    }
+    nodes = std::move(sorted);
+
+    size_t padded = (nodes.size() + NODE_CAPACITY - 1) / NODE_CAPACITY * NODE_CAPACITY;
+    tree.lats.assign(padded, std::numeric_limits<float>::quiet_NaN());
+    tree.lons.assign(padded, std::numeric_limits<float>::quiet_NaN());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto &loc = nodes[i]->getLocation();
+        tree.lats[i] = loc.latitude;
+        tree.lons[i] = loc.longitude;
+    }
+
+    if (nodes.empty()) {
+        return;
+    }
+
+    // leaves bound consecutive runs of nodes, every level above bounds runs of boxes
+    std::vector<Box> leaves;
+    leaves.reserve((nodes.size() + NODE_CAPACITY - 1) / NODE_CAPACITY);
+    for (size_t first = 0; first < nodes.size(); first += NODE_CAPACITY) {
+        size_t last = std::min(first + NODE_CAPACITY, nodes.size());
+        Box box {tree.lats[first], tree.lons[first], tree.lats[first], tree.lons[first]};
+        for (size_t i = first + 1; i < last; i++) {
+            box.minLat = std::min<double>(box.minLat, tree.lats[i]);
+            box.minLon = std::min<double>(box.minLon, tree.lons[i]);
+            box.maxLat = std::max<double>(box.maxLat, tree.lats[i]);
+            box.maxLon = std::max<double>(box.maxLon, tree.lons[i]);
+        }
+        leaves.push_back(box);
+    }
+    tree.levels.push_back(std::move(leaves));
+
+    while (tree.levels.back().size() > 1) {
+        auto &below = tree.levels.back();
+        std::vector<Box> level;
+        level.reserve((below.size() + NODE_CAPACITY - 1) / NODE_CAPACITY);
+        for (size_t first = 0; first < below.size(); first += NODE_CAPACITY) {
+            size_t last = std::min(first + NODE_CAPACITY, below.size());
+            Box box = below[first];
+            for (size_t i = first + 1; i < last; i++) {
+                box.minLat = std::min(box.minLat, below[i].minLat);
+                box.minLon = std::min(box.minLon, below[i].minLon);
+                box.maxLat = std::max(box.maxLat, below[i].maxLat);
+                box.maxLon = std::max(box.maxLon, below[i].maxLon);
+            }
+            level.push_back(box);
+        }
+        tree.levels.push_back(std::move(level));
+    }
+}
+
+uint32_t SpatialIndex::cullLeaf(const float *lats, const float *lons, const float area[4]) {
+    uint32_t mask = 0;
+    // the NaN padding fails every compare
+#if defined(AVITAB_INDEX_SSE2)
+    __m128 minLat = _mm_set1_ps(area[0]);
+    __m128 minLon = _mm_set1_ps(area[1]);
+    __m128 maxLat = _mm_set1_ps(area[2]);
+    __m128 maxLon = _mm_set1_ps(area[3]);
+    for (size_t i = 0; i < NODE_CAPACITY; i += 4) {
+        __m128 lat = _mm_loadu_ps(lats + i);
+        __m128 lon = _mm_loadu_ps(lons + i);
+        __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(lat, minLat), _mm_cmple_ps(lat, maxLat)),
+                               _mm_and_ps(_mm_cmpge_ps(lon, minLon), _mm_cmple_ps(lon, maxLon)));
+        mask |= (uint32_t) _mm_movemask_ps(in) << i;
+    }
+#elif defined(AVITAB_INDEX_NEON)
+    float32x4_t minLat = vdupq_n_f32(area[0]);
+    float32x4_t minLon = vdupq_n_f32(area[1]);
+    float32x4_t maxLat = vdupq_n_f32(area[2]);
+    float32x4_t maxLon = vdupq_n_f32(area[3]);
+    const uint32_t bitsInit[4] = {1, 2, 4, 8};
+    uint32x4_t bits = vld1q_u32(bitsInit);
+    for (size_t i = 0; i < NODE_CAPACITY; i += 4) {
+        float32x4_t lat = vld1q_f32(lats + i);
+        float32x4_t lon = vld1q_f32(lons + i);
+        uint32x4_t in = vandq_u32(vandq_u32(vcgeq_f32(lat, minLat), vcleq_f32(lat, maxLat)),
+                                  vandq_u32(vcgeq_f32(lon, minLon), vcleq_f32(lon, maxLon)));
+        mask |= vaddvq_u32(vandq_u32(in, bits)) << i;
+    }
+#else
+    for (size_t i = 0; i < NODE_CAPACITY; i++) {
+        bool in = lats[i] >= area[0] && lats[i] <= area[2] && lons[i] >= area[1] && lons[i] <= area[3];
+        mask |= (uint32_t) in << i;
+    }
+#endif
+    return mask;
+}
+
+void SpatialIndex::visitTree(const Tree &tree, const std::vector<Box> &areas, const Corridor *corridor, const Visitor &visitor) {
+    if (tree.levels.empty() || areas.empty()) {
+        return;
+    }
+
+    // the float coordinates can be off by a rounding step, so the float tests use
+    // slightly larger areas and the nodes that pass are checked against the exact ones
+    constexpr double slack = 1e-4;
+    std::vector<Box> wide;
+    std::vector<std::array<float, 4>> leafAreas;
+    for (auto &area: areas) {
+        wide.push_back(Box {area.minLat - slack, area.minLon - slack, area.maxLat + slack, area.maxLon + slack});
+        auto &w = wide.back();
+        leafAreas.push_back({(float) w.minLat, (float) w.minLon, (float) w.maxLat, (float) w.maxLon});
+    }
+
+    auto overlaps = [] (const Box &a, const Box &b) {
+        return b.maxLat >= a.minLat && b.minLat <= a.maxLat &&
+               b.maxLon >= a.minLon && b.minLon <= a.maxLon;
+    };
+    auto overlapsAny = [&wide, &overlaps] (const Box &b) {
+        return std::any_of(wide.begin(), wide.end(), [&b, &overlaps] (const Box &w) { return overlaps(w, b); });
+    };
+    auto isInside = [&areas, corridor] (const Location &loc) {
+        bool inArea = std::any_of(areas.begin(), areas.end(), [&loc] (const Box &area) {
+            return loc.latitude >= area.minLat && loc.latitude <= area.maxLat &&
+                   loc.longitude >= area.minLon && loc.longitude <= area.maxLon;
+        });
+        return inArea && (!corridor || corridor->contains(loc));
+    };
+
+    // depth-first over (level, index) pairs, the root level has a single box
+    std::vector<std::pair<size_t, size_t>> stack;
+    stack.emplace_back(tree.levels.size() - 1, 0);
+    while (!stack.empty()) {
+        auto top = stack.back();
+        stack.pop_back();
+        size_t level = top.first;
+        size_t index = top.second;
+        auto &box = tree.levels[level][index];
+        if (!overlapsAny(box)) {
+            continue;
+        }
+
+        size_t first = index * NODE_CAPACITY;
+        if (level == 0) {
+            // a leaf is culled once per area it touches, each node is reported at most once
+            uint32_t mask = 0;
+            for (size_t a = 0; a < wide.size(); a++) {
+                if (overlaps(wide[a], box)) {
+                    mask |= cullLeaf(&tree.lats[first], &tree.lons[first], leafAreas[a].data());
+                }
+            }
+            while (mask) {
+                int bit = __builtin_ctz(mask);
+                mask &= mask - 1;
+                auto node = tree.nodes[first + bit].get();
+                if (isInside(node->getLocation())) {
+                    visitor(node);
+                }
+            }
+        } else {
+            size_t last = std::min(first + NODE_CAPACITY, tree.levels[level - 1].size());
+            for (size_t i = first; i < last; i++) {
+                stack.emplace_back(level - 1, i);
+            }
+        }
+    }
+}
+
+void SpatialIndex::visit(const Location &bottomLeft, const Location &topRight, int filter, const Visitor &visitor) {
+    // split the area into boxes within -180/180, it might span the meridian or
+    // extend past it because of search margins
+    std::vector<Box> areas;
+    double lat0 = bottomLeft.latitude;
+    double lat1 = topRight.latitude;
+    double lon0 = bottomLeft.longitude;
+    double lon1 = topRight.longitude;
+    if (lon0 > lon1) {
+        areas.push_back(Box {lat0, lon0, lat1, 180});
+        areas.push_back(Box {lat0, -180, lat1, lon1});
+    } else {
+        areas.push_back(Box {lat0, lon0, lat1, lon1});
+        if (lon0 < -180) {
+            areas.push_back(Box {lat0, lon0 + 360, lat1, 180});
+        }
+        if (lon1 > 180) {
+            areas.push_back(Box {lat0, -180, lat1, lon1 - 360});
+        }
+    }
+
+    visitAreas(areas, nullptr, filter, visitor);
+}
+
+void SpatialIndex::visitCorridor(const Corridor &corridor, int filter, const Visitor &visitor) {
+    std::vector<Box> areas;
+    for (auto &area: corridor.getAreas()) {
+        areas.push_back(Box {area.minLat, area.minLon, area.maxLat, area.maxLon});
+    }
+    visitAreas(areas, &corridor, filter, visitor);
+}
+
+void SpatialIndex::visitAreas(const std::vector<Box> &areas, const Corridor *corridor, int filter, const Visitor &visitor) {
+    for (int p = 0; p < NUM_PARTITIONS; p++) {
+        if (!(filter & (1 << p))) {
+            continue;
+        }
+        auto &tree = trees[p];
+        if (tree.dirty) {
+            buildTree(tree);
+        }
+        visitTree(tree, areas, corridor, visitor);
+    }
+}
+
+} /* namespace world */
@@ -0,0 +1,89 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <functional>
+#include "NavNode.h"
+#include "Corridor.h"
+
+namespace world {
+
+/*
+ * Static R-tree over NavNodes, one tree per node type so that filtered
+ * queries never touch the partitions that were not asked for.
+ * The trees are bulk-loaded in Hilbert order, adding nodes later only marks
+ * the partition for a rebuild on its next query.
+ * Leaves keep the node coordinates as float arrays next to the node list, so
+ * culling a leaf is a few vector compares and only visible nodes are touched.
+ */
+class SpatialIndex {
+public:
+    // Same order as the World::VISIT_ bits
+    enum Partition {
+        TOWERED_AIRPORTS,
+        OTHER_AIRPORTS,
+        FIXES,
+        NAVAIDS,
+        USER_FIXES,
+        NUM_PARTITIONS
+    };
+
+    using Visitor = std::function<void(const NavNode *)>;
+
+    static Partition partitionOf(const NavNode &node);
+
+    void add(std::shared_ptr<NavNode> node);
+    void build();
+
+    // Calls the visitor for each node in the area whose partition is selected by
+    // the World::VISIT_ filter. The area may span the -180/180 meridian.
+    void visit(const Location &bottomLeft, const Location &topRight, int filter, const Visitor &visitor);
+    // Same for the nodes inside the corridor, in a single sweep that reports each node once
+    void visitCorridor(const Corridor &corridor, int filter, const Visitor &visitor);
+
+    size_t size() const;
+
+private:
+    static constexpr const size_t NODE_CAPACITY = 16;
+
+    struct Box {
+        double minLat, minLon, maxLat, maxLon;
+    };
+
+    struct Tree {
+        NavNodeList nodes;                  // Hilbert order after build
+        std::vector<float> lats, lons;      // same order, padded with NaN to whole leaves
+        std::vector<std::vector<Box>> levels; // levels[0] bounds NODE_CAPACITY nodes each
+        bool dirty = false;
+    };
+
+    Tree trees[NUM_PARTITIONS];
+
+    static uint64_t hilbertIndex(const Location &loc);
+    // bit i is set if node i of the leaf could be inside the area
+    static uint32_t cullLeaf(const float *lats, const float *lons, const float area[4]);
+    static void buildTree(Tree &tree);
+    // visits the nodes inside any of the areas and, if given, inside the corridor
+    static void visitTree(const Tree &tree, const std::vector<Box> &areas, const Corridor *corridor, const Visitor &visitor);
+    void visitAreas(const std::vector<Box> &areas, const Corridor *corridor, int filter, const Visitor &visitor);
+};
+
+} /* namespace world */
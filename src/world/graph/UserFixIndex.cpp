@@ -0,0 +1,52 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "UserFixIndex.h"
+#include "src/world/World.h"
+
+namespace world {
+
+void UserFixIndex::replace(const std::vector<std::shared_ptr<Fix>> &fixes) {
+    auto index = std::make_shared<SpatialIndex>();
+    for (auto &fix: fixes) {
+        fix->setGlobal(true);
+        index->add(fix);
+    }
+    index->build();
+    std::atomic_store(&packed, index);
+}
+
+void UserFixIndex::visit(const Location &bottomLeft, const Location &topRight, const Visitor &visitor) const {
+    auto current = std::atomic_load(&packed);
+    if (current) {
+        current->visit(bottomLeft, topRight, World::VISIT_USER_FIXES, visitor);
+    }
+}
+
+void UserFixIndex::visitCorridor(const Corridor &corridor, const Visitor &visitor) const {
+    auto current = std::atomic_load(&packed);
+    if (current) {
+        current->visitCorridor(corridor, World::VISIT_USER_FIXES, visitor);
+    }
+}
+
+size_t UserFixIndex::size() const {
+    auto current = std::atomic_load(&packed);
+    return current ? current->size() : 0;
+}
+
+} /* namespace world */
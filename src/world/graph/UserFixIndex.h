@@ -0,0 +1,54 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include "SpatialIndex.h"
+#include "src/world/models/navaids/Fix.h"
+
+namespace world {
+
+/*
+ * The user fixes of a world, kept apart from the NAV data because imports can
+ * have hundreds of thousands of points and are replaced as a whole when the
+ * user loads another file. Each set is packed into its own spatial index before
+ * it is published, so visits never wait for a load and never see half a set:
+ * a visit that started on the previous set finishes on it.
+ */
+class UserFixIndex {
+public:
+    using Visitor = SpatialIndex::Visitor;
+
+    // takes the place of the current set, the fixes must not change afterwards
+    void replace(const std::vector<std::shared_ptr<Fix>> &fixes);
+
+    // the area may span the -180/180 meridian
+    void visit(const Location &bottomLeft, const Location &topRight, const Visitor &visitor) const;
+    void visitCorridor(const Corridor &corridor, const Visitor &visitor) const;
+
+    size_t size() const;
+
+private:
+    // only accessed through std::atomic_load and std::atomic_store. The index is
+    // built before it is published, so the visits don't modify it.
+    std::shared_ptr<SpatialIndex> packed;
+};
+
+} /* namespace world */
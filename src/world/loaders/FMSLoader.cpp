@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <sstream>
 #include <algorithm>
 #include "FMSLoader.h"
 #include "../models/Location.h"
@@ -34,15 +35,29 @@ NavNodeList FMSLoader::load(const std::string &fmsFilename) {
     logger::info("Loading %s", fmsFilename.c_str());
     FMSParser parser(fmsFilename);
     nodes.clear();
-    parser.setAcceptor([this] (const FlightPlanNodeData &data) {
+
+    // the whole plan is parsed first, so that the airports named in the header
+    // are looked up once before the waypoints are built
+    std::vector<FlightPlanNodeData> entries;
+    parser.setAcceptor([&entries] (const FlightPlanNodeData &data) {
+        entries.push_back(data);
+    });
+    parser.loadFMS();
+
+    for (auto &data: entries) {
+        onHeaderLoaded(data);
+    }
+    resolveAirports();
+
+    nodes.reserve(entries.size());
+    for (auto &data: entries) {
         try {
-            onFMSLoaded(data);
+            onWaypointLoaded(data);
         } catch (const std::exception &e) {
             logger::warn("Can't parse FMS %d %s: %s",
-                    data.lineNum, data.line.c_str(), e.what());
+                    data.lineNum, data.id.c_str(), e.what());
         }
-    });
-    parser.loadFMS();
+    }
 
     auto newEnd = std::unique(nodes.begin(), nodes.end());
     nodes.erase(newEnd, nodes.end());
@@ -55,7 +70,7 @@ NavNodeList FMSLoader::load(const std::string &fmsFilename) {
     return nodes;
 }
 
-void FMSLoader::onFMSLoaded(const FlightPlanNodeData &node) {
+void FMSLoader::onHeaderLoaded(const FlightPlanNodeData &node) {
     switch(node.type) {
 
         case FlightPlanNodeData::Type::CYCLE:     cycle = node.id; break;
@@ -69,7 +84,23 @@ void FMSLoader::onFMSLoaded(const FlightPlanNodeData &node) {
         case FlightPlanNodeData::Type::ADEP:      departureAirportName = node.id; break;
         case FlightPlanNodeData::Type::ADES:      arrivalAirportName = node.id; break;
         case FlightPlanNodeData::Type::DEPRWY:    departureRwyName = stripRWPrefix(node.id); break;
+        default: break;
+    }
+}
+
+void FMSLoader::resolveAirports() {
+    if (!departureAirportName.empty()) {
+        departureAirport = world->findAirportByID(departureAirportName);
+    }
+    if (arrivalAirportName == departureAirportName) {
+        arrivalAirport = departureAirport;
+    } else if (!arrivalAirportName.empty()) {
+        arrivalAirport = world->findAirportByID(arrivalAirportName);
+    }
+}
 
+void FMSLoader::onWaypointLoaded(const FlightPlanNodeData &node) {
+    switch(node.type) {
         case FlightPlanNodeData::Type::NDB:
         case FlightPlanNodeData::Type::VOR:
         case FlightPlanNodeData::Type::FIX:
@@ -87,13 +118,12 @@ void FMSLoader::onFMSLoaded(const FlightPlanNodeData &node) {
             break;
 
         default:
-            logger::warn("Unknown FlightPlanNodeData type %d", int(node.type));
+            // header entries were handled before the waypoints
             break;
     }
 }
 
 void FMSLoader::appendDeparture() {
-    departureAirport = world->findAirportByID(departureAirportName);
     if (departureAirport) {
         appendDepartureAirportOrRwy();
         appendSID();
@@ -103,7 +133,6 @@ void FMSLoader::appendDeparture() {
 }
 
 void FMSLoader::appendArrival() {
-    arrivalAirport = world->findAirportByID(arrivalAirportName);
     if (arrivalAirport) {
         appendSTAR();
         appendApproach();
@@ -31,7 +31,9 @@ public:
     FMSLoader(std::shared_ptr<World> worldPtr);
     NavNodeList load(const std::string &fmsFilename);
 private:
-    void onFMSLoaded(const FlightPlanNodeData &node);
+    void onHeaderLoaded(const FlightPlanNodeData &node);
+    void resolveAirports();
+    void onWaypointLoaded(const FlightPlanNodeData &node);
     void appendDeparture();
     void appendArrival();
     void appendDepartureAirportOrRwy();
@@ -15,6 +15,7 @@
  *   You should have received a copy of the GNU Affero General Public License
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <stdexcept>
 #include "UserFixLoader.h"
 #include "../parsers/UserFixParser.h"
 #include "../models/navaids/Fix.h"
@@ -29,9 +30,10 @@ UserFixLoader::UserFixLoader(std::shared_ptr<LoadManager> mgr):
 {
     // Create a dummy region for user fixes (they are normally not region coded)
     world->addRegion(USER_REGION);
+    region = world->getRegion(USER_REGION);
 }
 
-void UserFixLoader::load(const std::string& file) {
+size_t UserFixLoader::load(const std::string& file) {
     UserFixParser parser(file);
     parser.setAcceptor([this] (const UserFixData &data) {
         try {
@@ -44,19 +46,20 @@ void UserFixLoader::load(const std::string& file) {
         }
     });
     parser.loadUserFixes();
+    world->setUserFixes(fixes);
+    return fixes.size();
 }
 
 void UserFixLoader::onUserFixLoaded(const UserFixData& userfixdata) {
     // User fixes are unique, so create new fix each time
     // No region in LNM/PlanG csv format, so just use dummy one
-    auto region = world->getRegion(USER_REGION);
     Location location(userfixdata.latitude, userfixdata.longitude);
     auto fix = std::make_shared<Fix>(region, userfixdata.ident, location);
     auto userFix = std::make_shared<UserFix>();
     userFix->setType(userfixdata.type);
     userFix->setName(userfixdata.name);
     fix->attachUserFix(userFix);
-    world->addFix(fix);
+    fixes.push_back(fix);
 }
 
 } /* namespace world */
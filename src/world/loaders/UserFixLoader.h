@@ -19,6 +19,7 @@
 #define SRC_WORLD_LOADERS_USERFIXLOADER_H_
 
 #include <memory>
+#include <vector>
 #include "../LoadManager.h"
 #include "../World.h"
 
@@ -29,10 +30,13 @@ struct UserFixData;
 class UserFixLoader {
 public:
     UserFixLoader(std::shared_ptr<LoadManager> mgr);
-    void load(const std::string &file);
+    // replaces the world's user fixes with those of the file once it is parsed completely
+    size_t load(const std::string &file);
 private:
     std::shared_ptr<LoadManager> const loadMgr;
     std::shared_ptr<World> world;
+    std::shared_ptr<Region> region;
+    std::vector<std::shared_ptr<Fix>> fixes;
 
     void onUserFixLoaded(const UserFixData &navaid);
 };
@@ -16,17 +16,18 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "Airway.h"
+#include "src/world/StringPool.h"
 
 namespace world {
 
 Airway::Airway(const std::string& name, world::AirwayLevel lvl):
-    name(name),
+    name(&StringPool::global().intern(name)),
     level(lvl)
 {
 }
 
 const std::string& Airway::getID() const {
-    return name;
+    return *name;
 }
 
 bool Airway::supportsLevel(world::AirwayLevel level) const {
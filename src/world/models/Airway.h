@@ -32,7 +32,7 @@ public:
     bool isProcedure() const override;
 
 private:
-    std::string name;
+    const std::string *name; // interned
     AirwayLevel level;
 };
 
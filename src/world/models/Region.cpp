@@ -16,16 +16,17 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "Region.h"
+#include "src/world/StringPool.h"
 
 namespace world {
 
 Region::Region(const std::string& regionId):
-    id(regionId)
+    id(&StringPool::global().intern(regionId))
 {
 }
 
 const std::string& Region::getId() const {
-    return id;
+    return *id;
 }
 
 void Region::setName(const std::string& name) {
@@ -28,7 +28,7 @@ public:
     const std::string &getId() const;
     void setName(const std::string &name);
 private:
-    std::string id;
+    const std::string *id; // interned
     std::string name;
 };
 
@@ -22,12 +22,13 @@
 #include <sstream>
 #include "Airport.h"
 #include "src/world/models/navaids/Fix.h"
+#include "src/world/StringPool.h"
 #include "src/Logger.h"
 
 namespace world {
 
 Airport::Airport(const std::string& airportId):
-    id(airportId)
+    id(&StringPool::global().intern(airportId))
 {
 }
 
@@ -89,6 +90,7 @@ void Airport::addTerminalFix(std::shared_ptr<Fix> fix) {
 }
 
 std::shared_ptr<Fix> world::Airport::getTerminalFix(const std::string& id) {
+    loadDetails();
     auto it = terminalFixes.find(id);
     if (it == terminalFixes.end()) {
         return nullptr;
@@ -97,12 +99,13 @@ std::shared_ptr<Fix> world::Airport::getTerminalFix(const std::string& id) {
 }
 
 void Airport::setCurrentMetar(const std::string& timestamp, const std::string& metar) {
+    std::lock_guard<std::mutex> lock(metarMutex);
     metarTimestamp = timestamp;
     metarString = metar;
 }
 
 const std::string& Airport::getID() const {
-    return id;
+    return *id;
 }
 
 const std::string& Airport::getName() const {
@@ -110,22 +113,25 @@ const std::string& Airport::getName() const {
 }
 
 const std::vector<Frequency> &Airport::getATCFrequencies(ATCFrequency type) {
+    loadDetails();
     return atcFrequencies[type];
 }
 
 void Airport::attachILSData(const std::string& rwyName, std::weak_ptr<Fix> ils) {
     auto rwy = getRunwayAndFixName(rwyName);
     if (!rwy) {
-        throw std::runtime_error("Unknown runway " + rwyName + " for airport " + id);
+        throw std::runtime_error("Unknown runway " + rwyName + " for airport " + *id);
     }
     rwy->attachILSData(ils);
 }
 
 std::shared_ptr<Runway> Airport::getRunwayAndFixName(const std::string& name) {
-    auto rwy = getRunwayByName(name);
-    if (rwy) {
-        return rwy;
+    // also used while the details are loaded, so it doesn't trigger their loader
+    auto exact = runways.find(name);
+    if (exact != runways.end()) {
+        return exact->second;
     }
+    std::shared_ptr<Runway> rwy;
 
     int wantHeading = std::stoi(name.substr(0, 2)) * 10;
 
@@ -155,7 +161,7 @@ std::shared_ptr<Runway> Airport::getRunwayAndFixName(const std::string& name) {
             diff -= 360;
         }
         if (std::abs(diff) <= 30) {
-            logger::info("Renaming runway %s to %s for airport %s due to newer nav data", it->first.c_str(), name.c_str(), id.c_str());
+            logger::info("Renaming runway %s to %s for airport %s due to newer nav data", it->first.c_str(), name.c_str(), id->c_str());
             rwy = it->second;
             runways.erase(it);
             rwy->rename(name);
@@ -167,6 +173,7 @@ std::shared_ptr<Runway> Airport::getRunwayAndFixName(const std::string& name) {
 }
 
 const std::shared_ptr<Runway> Airport::getRunwayByName(const std::string& rw) const {
+    loadDetails();
     auto rwy = runways.find(rw);
     if (rwy == runways.end()) {
         return nullptr;
@@ -175,6 +182,7 @@ const std::shared_ptr<Runway> Airport::getRunwayByName(const std::string& rw) co
 }
 
 const std::shared_ptr<Runway> Airport::getOppositeRunwayEnd(const std::shared_ptr<Runway> rw) const {
+    loadDetails();
     std::string rwyName = rw->getID();
     for (auto &rwys: runwayPairs) {
         if (rwys.first->getID() == rwyName) {
@@ -188,18 +196,23 @@ const std::shared_ptr<Runway> Airport::getOppositeRunwayEnd(const std::shared_pt
 }
 
 void Airport::forEachRunway(std::function<void(const std::shared_ptr<Runway>)> f) const {
+    loadDetails();
     for (auto &rwy: runways) {
         f(rwy.second);
     }
 }
 
 void Airport::forEachRunwayPair(std::function<void(const std::shared_ptr<Runway>, const std::shared_ptr<Runway>)> f) const {
+    loadDetails();
     for (auto &rwys: runwayPairs) {
         f(rwys.first, rwys.second);
     }
 }
 
 float Airport::getLongestRunwayLength() const {
+    if (detailsPending) {
+        return summary.longestRunwayLength;
+    }
     float longestRunwayLength = 0;
     for (auto &rwy: runways) {
         longestRunwayLength = std::fmax(rwy.second->getLength(), longestRunwayLength); // Ignore NaN
@@ -208,10 +221,16 @@ float Airport::getLongestRunwayLength() const {
 }
 
 bool Airport::hasOnlyHeliports() const {
+    if (detailsPending) {
+        return summary.onlyHeliports;
+    }
     return runways.empty() && !heliports.empty();
 }
 
 bool Airport::hasOnlyWaterRunways() const {
+    if (detailsPending) {
+        return summary.onlyWaterRunways;
+    }
     bool foundWater = false;
     for (const auto &rwy: runways) {
         if (rwy.second->isWater()) {
@@ -224,10 +243,16 @@ bool Airport::hasOnlyWaterRunways() const {
 }
 
 bool Airport::hasControlTower() const {
+    if (detailsPending) {
+        return summary.towered;
+    }
     return (atcFrequencies.count(ATCFrequency::TWR) >= 1);
 }
 
 bool Airport::hasHardRunway() const {
+    if (detailsPending) {
+        return summary.hardRunway;
+    }
     for (const auto &rwy: runways) {
         if (rwy.second->hasHardSurface()) {
             return true;
@@ -248,7 +273,44 @@ void Airport::addApproach(std::shared_ptr<Approach> approach) {
     approaches.insert(std::make_pair(approach->getID(), approach));
 }
 
+void Airport::setProcedureLoader(ProcedureLoader loader) {
+    std::lock_guard<std::mutex> lock(procedureMutex);
+    procedureLoader = loader;
+}
+
+void Airport::loadProcedures() const {
+    std::lock_guard<std::mutex> lock(procedureMutex);
+    if (!procedureLoader) {
+        return;
+    }
+    auto loader = std::move(procedureLoader);
+    procedureLoader = nullptr;
+    loader();
+}
+
+void Airport::setDetailLoader(const Summary &summary, DetailLoader loader) {
+    std::lock_guard<std::mutex> lock(detailMutex);
+    this->summary = summary;
+    detailLoader = loader;
+    detailsPending = true;
+}
+
+void Airport::loadDetails() const {
+    if (!detailsPending) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(detailMutex);
+    if (!detailLoader) {
+        return;
+    }
+    auto loader = std::move(detailLoader);
+    detailLoader = nullptr;
+    loader();
+    detailsPending = false;
+}
+
 std::vector<std::shared_ptr<SID>> Airport::getSIDs() const {
+    loadProcedures();
     std::vector<std::shared_ptr<SID>> res;
     for (auto &it: sids) {
         res.push_back(it.second);
@@ -260,6 +322,7 @@ std::shared_ptr<SID> Airport::getSIDByName(std::string sidName) const {
     if (sidName.empty()) {
         return nullptr;
     }
+    loadProcedures();
     auto sid = sids.find(sidName);
     if (sid == sids.end()) {
         std::stringstream ss;
@@ -274,6 +337,7 @@ std::shared_ptr<SID> Airport::getSIDByName(std::string sidName) const {
 }
 
 std::vector<std::shared_ptr<STAR>> Airport::getSTARs() const {
+    loadProcedures();
     std::vector<std::shared_ptr<STAR>> res;
     for (auto &it: stars) {
         res.push_back(it.second);
@@ -285,6 +349,7 @@ std::shared_ptr<STAR> Airport::getSTARByName(std::string starName) const {
     if (starName.empty()) {
         return nullptr;
     }
+    loadProcedures();
     auto star = stars.find(starName);
     if (star == stars.end()) {
         std::stringstream ss;
@@ -299,6 +364,7 @@ std::shared_ptr<STAR> Airport::getSTARByName(std::string starName) const {
 }
 
 std::vector<std::shared_ptr<Approach>> Airport::getApproaches() const {
+    loadProcedures();
     std::vector<std::shared_ptr<Approach>> res;
     for (auto &it: approaches) {
         res.push_back(it.second);
@@ -310,6 +376,7 @@ std::shared_ptr<Approach> Airport::getApproachByName(std::string appName) const
     if (appName.empty()) {
         return nullptr;
     }
+    loadProcedures();
     auto approach = approaches.find(appName);
     if (approach == approaches.end()) {
         std::stringstream ss;
@@ -323,14 +390,22 @@ std::shared_ptr<Approach> Airport::getApproachByName(std::string appName) const
     return approach->second;
 }
 
-const std::string& Airport::getMetarTimestamp() const {
+std::string Airport::getMetarTimestamp() const {
+    std::lock_guard<std::mutex> lock(metarMutex);
     return metarTimestamp;
 }
 
-const std::string& Airport::getMetarString() const {
+std::string Airport::getMetarString() const {
+    std::lock_guard<std::mutex> lock(metarMutex);
     return metarString;
 }
 
+void Airport::getCurrentMetar(std::string &timestamp, std::string &metar) const {
+    std::lock_guard<std::mutex> lock(metarMutex);
+    timestamp = metarTimestamp;
+    metar = metarString;
+}
+
 const world::Location& Airport::getLocation() const {
     if (!location.isValid()) {
         // some airports do not have a location, try the first runway's location instead
@@ -349,14 +424,21 @@ const world::Location& Airport::getLocation() const {
 }
 
 const world::Location& Airport::getLocationUpLeft() const {
+    if (detailsPending) {
+        return summary.upLeft.isValid() ? summary.upLeft : getLocation();
+    }
     return (locationUpLeft.isValid()) ? locationUpLeft :getLocation();
 }
 
 const world::Location& Airport::getLocationDownRight() const {
+    if (detailsPending) {
+        return summary.upLeft.isValid() ? summary.downRight : getLocation();
+    }
     return (locationUpLeft.isValid()) ? locationDownRight : getLocation();
 }
 
 std::string Airport::getInitialATCContactInfo() const {
+    loadDetails();
     static const ATCFrequency prioritisedATCType[] {
         ATCFrequency::RECORDED,
         ATCFrequency::TWR,
@@ -24,6 +24,8 @@
 #include <vector>
 #include <set>
 #include <functional>
+#include <mutex>
+#include <atomic>
 #include "src/world/models/Location.h"
 #include "src/world/graph/NavNode.h"
 #include "src/world/models/Region.h"
@@ -73,8 +75,10 @@ public:
 
     const std::string& getName() const;
     const std::vector<Frequency> &getATCFrequencies(ATCFrequency type);
-    const std::string &getMetarTimestamp() const;
-    const std::string &getMetarString() const;
+    // copies, the METAR can be replaced by a background update at any time
+    std::string getMetarTimestamp() const;
+    std::string getMetarString() const;
+    void getCurrentMetar(std::string &timestamp, std::string &metar) const;
 
     void addRunway(std::shared_ptr<Runway> rwy);
     void forEachRunway(std::function<void(const std::shared_ptr<Runway>)> f) const;
@@ -97,6 +101,27 @@ public:
     void addSTAR(std::shared_ptr<STAR> star);
     void addApproach(std::shared_ptr<Approach> approach);
 
+    // Procedures can be attached on first use instead of while loading the world.
+    // The loader runs once, before the first procedure lookup.
+    using ProcedureLoader = std::function<void()>;
+    void setProcedureLoader(ProcedureLoader loader);
+    void loadProcedures() const;
+
+    // Airports can also be published with a summary for the map and load their frequencies,
+    // runways, heliports and terminal fixes on first use. The summary answers the runway and
+    // tower queries until then, the loader runs once, before the first detail lookup.
+    struct Summary {
+        bool towered = false;
+        bool onlyHeliports = false;
+        bool onlyWaterRunways = false;
+        bool hardRunway = false;
+        float longestRunwayLength = 0;
+        Location upLeft, downRight;
+    };
+    using DetailLoader = std::function<void()>;
+    void setDetailLoader(const Summary &summary, DetailLoader loader);
+    void loadDetails() const;
+
     std::vector<std::shared_ptr<SID>> getSIDs() const;
     std::vector<std::shared_ptr<STAR>> getSTARs() const;
     std::vector<std::shared_ptr<Approach>> getApproaches() const;
@@ -109,7 +134,7 @@ public:
     void operator=(const Airport &other) = delete;
 
 private:
-    std::string id; // either ICAO code or X + fictional id
+    const std::string *id; // interned, either ICAO code or X + fictional id
     std::string name;
     Location location;
     Location locationUpLeft;
@@ -128,7 +153,15 @@ private:
     std::map<std::string, std::shared_ptr<SID>> sids;
     std::map<std::string, std::shared_ptr<STAR>> stars;
     std::map<std::string, std::shared_ptr<Approach>> approaches;
+    mutable ProcedureLoader procedureLoader;
+    mutable std::mutex procedureMutex;
+
+    Summary summary;
+    mutable DetailLoader detailLoader;
+    mutable std::mutex detailMutex;
+    mutable std::atomic_bool detailsPending { false };
 
+    mutable std::mutex metarMutex;
     std::string metarTimestamp, metarString;
 
     std::shared_ptr<Runway> getRunwayAndFixName(const std::string &name);
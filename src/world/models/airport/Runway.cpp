@@ -18,16 +18,17 @@
 #include <stdexcept>
 #include "Runway.h"
 #include "src/world/models/navaids/Fix.h"
+#include "src/world/StringPool.h"
 
 namespace world {
 
 Runway::Runway(const std::string& name):
-    name(name)
+    name(&StringPool::global().intern(name))
 {
 }
 
 void Runway::rename(const std::string& newName) {
-    name = newName;
+    name = &StringPool::global().intern(newName);
 }
 
 void Runway::setWidth(float w) {
@@ -55,7 +56,7 @@ void Runway::setSurfaceType(SurfaceMaterial surfaceType) {
 }
 
 const std::string& Runway::getID() const {
-    return name;
+    return *name;
 }
 
 float Runway::getWidth() const {
@@ -123,6 +124,10 @@ const std::string Runway::getSurfaceTypeDescription() const {
 }
 
 bool Runway::hasHardSurface() const{
+    return isHardSurface(surfaceType);
+}
+
+bool Runway::isHardSurface(SurfaceMaterial surfaceType) {
     return ((surfaceType == SurfaceMaterial::ASPHALT) ||
             (surfaceType == SurfaceMaterial::BITUMINOUS) ||
             (surfaceType == SurfaceMaterial::CONCRETE) ||
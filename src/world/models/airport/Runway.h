@@ -69,6 +69,7 @@ public:
     float getWidth() const;
     bool hasHardSurface() const;
     bool isWater() const;
+    static bool isHardSurface(SurfaceMaterial surfaceType);
     SurfaceMaterial getSurfaceType() const;
     const std::string getSurfaceTypeDescription() const;
     void attachILSData(std::weak_ptr<Fix> ils);
@@ -76,7 +77,7 @@ public:
     // Optional, can return nullptr
     std::shared_ptr<Fix> getILSData() const;
 private:
-    std::string name;
+    const std::string *name; // interned
     Location location;
     float elevation = std::numeric_limits<float>::quiet_NaN(); // feet MSL
     float width = std::numeric_limits<float>::quiet_NaN(); // meters
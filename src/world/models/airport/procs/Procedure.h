@@ -37,6 +37,8 @@ public:
     bool isProcedure() const override { return true; }
 
     virtual NavNodeList getWaypoints(std::shared_ptr<world::Runway> runway, std::string appTransName) const = 0;
+    // every branch of the procedure, e.g. each runway and enroute transition, for drawing it as a whole
+    virtual std::vector<NavNodeList> getPaths() const = 0;
     virtual std::string toDebugString() const = 0;
 
 private:
@@ -16,18 +16,19 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "Fix.h"
+#include "src/world/StringPool.h"
 
 namespace world {
 
 Fix::Fix(std::shared_ptr<Region> region, std::string id, Location loc):
     region(region),
-    id(id),
+    id(&StringPool::global().intern(id)),
     location(loc)
 {
 }
 
 const std::string& Fix::getID() const {
-    return id;
+    return *id;
 }
 
 const Location& Fix::getLocation() const {
@@ -59,7 +59,7 @@ public:
 
 private:
     std::shared_ptr<Region> region;
-    std::string id;
+    const std::string *id; // interned
     Location location;
     bool global = false;
 
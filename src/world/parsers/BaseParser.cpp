@@ -16,7 +16,8 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "BaseParser.h"
-#include <iostream>
+#include <charconv>
+#include <cstring>
 #include <stdexcept>
 #include <limits>
 #include "src/Logger.h"
@@ -24,106 +25,150 @@
 
 namespace world {
 
-BaseParser::BaseParser(const std::string& file) {
-    stream.open(fs::u8path(file));
+namespace {
 
-    if (!stream) {
-        throw std::runtime_error("Couldn't open file: " + file);
+// same set as std::isspace in the C locale, without the locale lookup
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+}
+
+BaseParser::BaseParser(const std::string& file):
+    file(std::make_shared<platform::MappedFile>(file))
+{
+    filePos = this->file->data();
+    fileEnd = filePos + this->file->size();
+}
+
+BaseParser::BaseParser(std::shared_ptr<const platform::MappedFile> file, size_t begin, size_t end):
+    file(file)
+{
+    if (begin > end || end > file->size()) {
+        throw std::runtime_error("Invalid parser range");
     }
+    filePos = file->data() + begin;
+    fileEnd = file->data() + end;
 }
 
 std::string BaseParser::parseHeader() {
-    std::string line;
-
-    getLine(line);
+    std::string_view line = nextLine();
     if (line != "A" && line != "I") {
-        throw std::runtime_error("Unknown file format: " + line);
+        throw std::runtime_error("Unknown file format: " + std::string(line));
     }
 
-    getLine(line);
-
-    std::istringstream lineStr(line);
-    char origin;
-    std::string header;
+    startLine(nextLine());
+    skipWhiteSpace();
+    if (!isEOL()) {
+        ++linePos; // origin
+    }
+    version = parseInt();
 
-    lineStr >> origin >> version;
-    getline(lineStr, header);
+    std::string header(linePos, lineEnd);
+    linePos = lineEnd;
     return header;
 }
 
 void BaseParser::eachLine(LineFunctor f) {
-    std::string line;
-    while (getline(stream, line)) {
-        lineStream.str(line);
-        lineStream.seekg(0);
-        lineStream.clear();
+    while (filePos < fileEnd) {
+        startLine(nextLine());
+        f();
+    }
+}
+
+void BaseParser::eachRow(RowFilter wanted, LineFunctor f) {
+    while (filePos < fileEnd) {
+        const char *pos = filePos;
+        while (pos < fileEnd && (*pos == ' ' || *pos == '\t')) {
+            ++pos;
+        }
+        int rowCode = 0;
+        std::from_chars(pos, fileEnd, rowCode);
+        if (!wanted(rowCode)) {
+            auto nl = static_cast<const char *>(std::memchr(pos, '\n', fileEnd - pos));
+            filePos = nl ? nl + 1 : fileEnd;
+            continue;
+        }
+        startLine(nextLine());
         f();
     }
 }
 
 bool BaseParser::isEOL() {
-    return lineStream.peek() <= '\0';
+    return linePos >= lineEnd || *linePos == '\0';
 }
 
 std::string BaseParser::restOfLine() {
     skipWhiteSpace();
 
-    std::string rest;
-    std::getline(lineStream, rest);
+    std::string rest(linePos, lineEnd);
+    linePos = lineEnd;
     return rest;
 }
 
 std::string BaseParser::consumeLine() {
-    std::string line;
-    std::getline(stream, line);
-    return line;
+    return std::string(nextLine());
 }
 
 int BaseParser::parseInt() {
     skipWhiteSpace();
 
-    int res;
-    if (lineStream >> res) {
-        return res;
-    } else {
+    const char *start = linePos;
+    if (start < lineEnd && *start == '+' && start + 1 < lineEnd && start[1] != '-') {
+        ++start;
+    }
+
+    int res = 0;
+    auto result = std::from_chars(start, lineEnd, res);
+    if (result.ec == std::errc::invalid_argument) {
+        return 0;
+    }
+
+    linePos = result.ptr;
+    if (result.ec != std::errc()) {
         return 0;
     }
+    return res;
 }
 
 std::string BaseParser::parseWord() {
-    skipWhiteSpace();
-
-    std::string word;
-    lineStream >> word;
-    return word;
+    return std::string(nextToken());
 }
 
 std::string BaseParser::nextDelimitedWord(char delim) {
-    std::stringstream word;
-
-    char c = '\0';
+    std::string word;
 
-    while (lineStream >> c) {
+    while (linePos < lineEnd) {
+        char c = *linePos++;
         if (c == delim) {
             break;
         }
 
-        if (!std::isspace(c)) {
-            word << c;
+        if (!isSpace(c)) {
+            word += c;
         }
     }
 
-    return word.str();
+    return word;
 }
 
 std::string BaseParser::nextCSVValue() {
-    std::stringstream value;
-    lineStream >> std::noskipws; // Keep whitespace inside CSV values
+    // unquoted values are copied from the mapped line in one piece
+    const char *pos = linePos;
+    while (pos < lineEnd && *pos != ',' && *pos != '"') {
+        pos++;
+    }
+    if (pos == lineEnd || *pos == ',') {
+        std::string value(linePos, pos);
+        linePos = (pos == lineEnd) ? pos : pos + 1;
+        return value;
+    }
 
+    std::string value;
     bool inQuotes = false; // Ensure commas inside quoted fields are not separators
-    char c = '\0';
 
-    while (lineStream >> c) {
+    while (linePos < lineEnd) {
+        char c = *linePos++;
         if (c == '"') {
             inQuotes = !inQuotes;
             continue;
@@ -131,73 +176,89 @@ std::string BaseParser::nextCSVValue() {
         if (c == ',' && !inQuotes) {
             break;
         }
-        value << c;
+        value += c;
     }
 
-    lineStream >> std::skipws;
-    return value.str();
+    return value;
 }
 
 double BaseParser::parseDouble() {
-    skipWhiteSpace();
-
-    std::string doubleStr;
-    lineStream >> doubleStr;
+    std::string_view token = nextToken();
+
+    // the mapped data isn't NUL-terminated, so strtod gets a copy
+    char buf[64];
+    std::string longToken;
+    const char *str = buf;
+    if (token.size() < sizeof(buf)) {
+        std::memcpy(buf, token.data(), token.size());
+        buf[token.size()] = '\0';
+    } else {
+        longToken = std::string(token);
+        str = longToken.c_str();
+    }
 
     try {
-        return platform::locale_independent_strtod(doubleStr.c_str(), NULL);
+        return platform::locale_independent_strtod(str, NULL);
     } catch (...) {
         return std::numeric_limits<double>::quiet_NaN();
     }
 }
 
 void BaseParser::skip(char c) {
-    char is;
-    lineStream >> is;
-    if (is != c) {
+    skipWhiteSpace();
+    if (linePos >= lineEnd || *linePos != c) {
         throw std::runtime_error("Unexpected char in data");
     }
+    ++linePos;
 }
 
 void BaseParser::skipWhiteSpace() {
-    char c;
-    do {
-        if (!(lineStream >> c)) {
-            return;
-        }
-    } while (std::isspace(c));
-    lineStream.putback(c);
-}
-
-std::istream& BaseParser::getLine(std::string& str) {
-    stream.clear();
-
-    std::istream::sentry se(stream, true);
-    std::streambuf *sbuf = stream.rdbuf();
-
-    while (true) {
-        int c = sbuf->sbumpc();
-        switch (c) {
-        case '\n':
-            return stream;
-        case '\r':
-            if (sbuf->sgetc() == '\n') {
-                sbuf->sbumpc();
-            }
-            return stream;
-        case std::streambuf::traits_type::eof():
-            if (str.empty()) {
-                stream.setstate(std::ios::eofbit);
-            }
-            return stream;
-        default:
-            str += static_cast<char>(c);
-        }
+    while (linePos < lineEnd && isSpace(*linePos)) {
+        ++linePos;
+    }
+}
+
+std::string_view BaseParser::nextLine() {
+    if (filePos >= fileEnd) {
+        return {};
     }
+
+    const char *start = filePos;
+    auto nl = static_cast<const char *>(std::memchr(start, '\n', fileEnd - start));
+    const char *end = nl ? nl : fileEnd;
+    filePos = nl ? nl + 1 : fileEnd;
+
+    if (end > start && end[-1] == '\r') {
+        --end;
+    }
+    return std::string_view(start, end - start);
+}
+
+void BaseParser::startLine(std::string_view line) {
+    linePos = line.data();
+    lineEnd = line.data() + line.size();
+}
+
+std::string_view BaseParser::nextToken() {
+    skipWhiteSpace();
+
+    const char *start = linePos;
+    while (linePos < lineEnd && !isSpace(*linePos)) {
+        ++linePos;
+    }
+    return std::string_view(start, linePos - start);
 }
 
 int BaseParser::getVersion() {
     return version;
 }
 
+std::shared_ptr<const platform::MappedFile> BaseParser::getFile() const {
+    return file;
+}
+
+size_t BaseParser::getOffset() const {
+    return filePos - file->data();
+}
+
 } /* namespace world */
@@ -19,20 +19,27 @@
 #define SRC_WORLD_PARSERS_BASEPARSER_H_
 
 #include <string>
+#include <string_view>
 #include <functional>
-#include <sstream>
-#include <iosfwd>
+#include <memory>
 #include "src/platform/Platform.h"
+#include "src/platform/MappedFile.h"
 
 namespace world {
 
 class BaseParser {
 public:
     using LineFunctor = std::function<void()>;
+    using RowFilter = bool (*)(int rowCode);
     BaseParser(const std::string &file);
+    // parse only the lines in [begin, end) of an already mapped file
+    BaseParser(std::shared_ptr<const platform::MappedFile> file, size_t begin, size_t end);
 
     std::string parseHeader();
     void eachLine(LineFunctor f);
+    // like eachLine, but lines whose leading row code fails the filter are
+    // skipped to their end without being handed out or tokenised
+    void eachRow(RowFilter wanted, LineFunctor f);
 
     bool isEOL();
     std::string restOfLine();
@@ -46,11 +53,22 @@ public:
 
     void skipWhiteSpace();
     int getVersion();
+
+    std::shared_ptr<const platform::MappedFile> getFile() const;
+    size_t getOffset() const;
 private:
-    fs::ifstream stream;
-    std::istringstream lineStream;
-    std::istream &getLine(std::string &str);
-    int version;
+    // The file is mapped as a whole and lines are handed out as views into it,
+    // so tokens are only copied when a parser asks for a std::string.
+    std::shared_ptr<const platform::MappedFile> file;
+    const char *filePos = nullptr;
+    const char *fileEnd = nullptr;
+    const char *linePos = nullptr;
+    const char *lineEnd = nullptr;
+    int version = 0;
+
+    std::string_view nextLine();
+    void startLine(std::string_view line);
+    std::string_view nextToken();
 };
 
 } /* namespace world */
@@ -61,6 +61,7 @@ void FMSParser::parseLine() {
 
 void FMSParser::parseEnRouteBlock() {
     FlightPlanNodeData node {};
+    node.lineNum = lineNum;
     node.type = parseWaypointType(parser.parseInt());
     if (node.type == FlightPlanNodeData::Type::ERR) {
         return;
@@ -78,6 +79,7 @@ void FMSParser::parseEnRouteBlock() {
 
 void FMSParser::parseIntroBlocks() {
     FlightPlanNodeData node {};
+    node.lineNum = lineNum;
     std::string prefix = parser.parseWord();
     if (prefix == "NUMENR") {
         parsingEnRouteBlock = true;
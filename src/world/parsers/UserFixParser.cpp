@@ -48,14 +48,15 @@ void UserFixParser::parseLine() {
     // See online manual for Little Nav Map, and Manual in Plan G install folder for further info
 
     std::string typeString = parser.nextCSVValue();
-    if (parseType(typeString) == UserFix::Type::NONE) {
+    UserFix::Type type = parseType(typeString);
+    if (type == UserFix::Type::NONE) {
         lineNum++;
         return;
     }
     UserFixData userFix {};
 
     try {
-        userFix.type = parseType(typeString);
+        userFix.type = type;
 
         std::string name = parser.nextCSVValue();
         // Strip leading and trailing spaces
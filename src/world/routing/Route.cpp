@@ -80,6 +80,16 @@ void Route::iterateRouteShort(RouteIterator f) const {
     f(currentEdge, prevNode);
 }
 
+std::vector<Location> Route::getPathLocations() const {
+    std::vector<Location> res;
+    res.reserve(waypoints.size() + 1);
+    res.push_back(startNode->getLocation());
+    for (auto &entry: waypoints) {
+        res.push_back(entry.to->getLocation());
+    }
+    return res;
+}
+
 double Route::getDirectDistance() const {
     return startNode->getLocation().distanceTo(destNode->getLocation());
 }
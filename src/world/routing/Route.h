@@ -72,6 +72,9 @@ public:
     void iterateRouteShort(RouteIterator f) const;
     void setGetMagVarsCallback(GetMagVarsCallback cb);
 
+    // the start and the end of each leg
+    std::vector<Location> getPathLocations() const;
+
     double getDirectDistance() const;
     double getRouteDistance() const;
 
@@ -17,9 +17,12 @@
  */
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
 #include "RouteFinder.h"
 #include "Route.h"
+#include "src/world/models/airport/Airport.h"
 #include "src/Logger.h"
+#include "src/platform/Metrics.h"
 
 namespace world {
 
@@ -28,6 +31,10 @@ RouteFinder::RouteFinder(std::shared_ptr<world::World> w):
 {
 }
 
+RouteFinder::~RouteFinder() {
+    stopWorker();
+}
+
 void RouteFinder::setDeparture(Route::NodePtr dep) {
     departure = dep;
 }
@@ -40,44 +47,323 @@ void RouteFinder::setAirwayLevel(AirwayLevel level) {
     airwayLevel = level;
 }
 
+void RouteFinder::blockAirway(const std::string &id) {
+    blockedAirways.insert(id);
+}
+
+void RouteFinder::clearBlockedAirways() {
+    blockedAirways.clear();
+}
+
+Route::NodePtr RouteFinder::rejoinRoute(const Route &route, const Location &position) {
+    // the nearest leg is the one that adds the least to the direct way through the position
+    Route::NodePtr best = route.getStart();
+    double bestDetour = std::numeric_limits<double>::infinity();
+    route.iterateLegs([&] (const Route::NodePtr from, const Route::EdgePtr, const Route::NodePtr to, double, double, double) {
+        if (!from || !to) {
+            return;
+        }
+        auto &a = from->getLocation();
+        auto &b = to->getLocation();
+        double detour = position.distanceTo(a) + position.distanceTo(b) - a.distanceTo(b);
+        if (detour < bestDetour) {
+            bestDetour = detour;
+            best = to;
+        }
+    });
+    departure = best;
+    return best;
+}
+
 void RouteFinder::setGetMagVarsCallback(GetMagVarsCallback cb) {
     getMagneticVariations = cb;
 }
 
+void RouteFinder::setLandmarks(LandmarkMap tables, ArrivalFixesCallback arrivalFixes) {
+    landmarks = tables;
+    getArrivalFixes = arrivalFixes;
+}
+
+void RouteFinder::setExpansionBudget(size_t maxExpansions) {
+    expansionBudget = maxExpansions;
+}
+
+void RouteFinder::setProgressCallback(ProgressCallback cb) {
+    onProgress = cb;
+}
+
+void RouteFinder::findAsync(SearchCall::ThenCB then) {
+    auto call = std::make_shared<SearchCall>([this] { return search(); });
+    call->andThen(then);
+    startWorker(call);
+}
+
+void RouteFinder::findAlternativesAsync(size_t count, AlternativesCall::ThenCB then) {
+    auto call = std::make_shared<AlternativesCall>([this, count] { return searchAlternatives(count); });
+    call->andThen(then);
+    startWorker(call);
+}
+
+void RouteFinder::cancel() {
+    cancelled = true;
+}
+
+void RouteFinder::startWorker(std::shared_ptr<apis::BaseCall> call) {
+    stopWorker();
+    cancelled = false;
+
+    worker = platform::Executor::shared().submit("routes", platform::Executor::Priority::INTERACTIVE,
+            [call] { call->exec(); });
+}
+
+void RouteFinder::stopWorker() {
+    if (!worker) {
+        return;
+    }
+    cancel();
+    worker->cancel();
+    // returns at once if the finder was released by its own result callback
+    worker->wait();
+    worker.reset();
+}
+
 std::shared_ptr<Route> RouteFinder::find() {
+    cancelled = false;
+    return search();
+}
+
+std::vector<RouteFinder::Alternative> RouteFinder::findAlternatives(size_t count) {
+    cancelled = false;
+    return searchAlternatives(count);
+}
+
+std::shared_ptr<Route> RouteFinder::search() {
+    Path path;
+    PathResult result;
+    if (canReplan()) {
+        result = replanPath(path);
+    } else {
+        size_t start = beginSearch();
+        result = searchPath(start, nullptr, 0, path);
+        treeRoot = start;
+    }
+
+    // a cancelled search throws before this, its tree is not reused
+    treeValid = true;
+    treeLevel = airwayLevel;
+    treeArrival = arrival;
+    treeBlockedAirways = blockedAirways;
+
+    switch (result) {
+    case PathResult::FOUND:
+        break;
+    case PathResult::OVER_BUDGET:
+        logger::info("Route search gave up after %zu nodes", expanded);
+        throw std::runtime_error("Route search gave up, the route is too complex");
+    case PathResult::NO_PATH:
+        logger::verbose("No route found");
+        throw std::runtime_error("No route found");
+    }
+
+    logger::verbose("Route found");
+    auto magVars = getPathMagVars({&path});
+    return makeRoute(path, magVars);
+}
+
+std::vector<RouteFinder::Alternative> RouteFinder::searchAlternatives(size_t count) {
+    std::vector<Alternative> res;
+    if (count == 0) {
+        return res;
+    }
+
+    size_t start = beginSearch();
+    treeValid = false;
+
+    // Yen's algorithm: every further path leaves one of the paths found so far at some
+    // spur node, after following it exactly up to there. The spur searches share the
+    // node numbering, positions and landmark rows and only reset the nodes they reach.
+    std::vector<Path> shortest;
+    std::vector<Path> candidates;
+    std::vector<size_t> chosen;
+    std::set<std::vector<const NavEdge *>> usedAirways;
+
+    auto sameSteps = [] (const Path &a, const Path &b, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if ((a[i].node != b[i].node) || (a[i].via != b[i].via)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto isKnown = [&sameSteps] (const std::vector<Path> &paths, const Path &path) {
+        return std::any_of(paths.begin(), paths.end(), [&] (const Path &p) {
+            return (p.size() == path.size()) && sameSteps(p, path, p.size());
+        });
+    };
+
+    shortest.emplace_back();
+    switch (searchPath(start, nullptr, 0, shortest.back())) {
+    case PathResult::FOUND:
+        break;
+    case PathResult::OVER_BUDGET:
+        logger::info("Route search gave up after %zu nodes", expanded);
+        throw std::runtime_error("Route search gave up, the route is too complex");
+    case PathResult::NO_PATH:
+        logger::verbose("No route found");
+        throw std::runtime_error("No route found");
+    }
+
+    size_t maxPaths = count * PATHS_PER_ALTERNATIVE;
+    bool overBudget = false;
+    while (true) {
+        const Path &last = shortest.back();
+        if (usedAirways.insert(airwaySequence(last)).second) {
+            chosen.push_back(shortest.size() - 1);
+        }
+        if ((chosen.size() >= count) || (shortest.size() >= maxPaths)) {
+            break;
+        }
+
+        for (size_t i = 0; (i + 1 < last.size()) && !overBudget; ++i) {
+            // paths sharing this root already left the spur node through these edges
+            spurBans.clear();
+            for (auto &p: shortest) {
+                if ((p.size() > i + 1) && sameSteps(p, last, i + 1)) {
+                    spurBans.emplace_back(p[i + 1].via, p[i + 1].node);
+                }
+            }
+
+            // the root may not be entered again, which keeps the paths loopless
+            blockedNodes.clear();
+            for (size_t j = 0; j < i; ++j) {
+                blockedNodes.push_back(last[j].node);
+            }
+
+            Path spur;
+            PathResult result = searchPath(last[i].node, last[i].via, last[i].gScore, spur);
+            if (result == PathResult::OVER_BUDGET) {
+                overBudget = true;
+            } else if (result == PathResult::FOUND) {
+                Path path(last.begin(), last.begin() + i);
+                path.insert(path.end(), spur.begin(), spur.end());
+                if (!isKnown(candidates, path) && !isKnown(shortest, path)) {
+                    candidates.push_back(std::move(path));
+                }
+            }
+        }
+        blockedNodes.clear();
+        spurBans.clear();
+
+        if (overBudget) {
+            logger::info("Route alternatives gave up after %zu nodes", expanded);
+            break;
+        }
+        if (candidates.empty()) {
+            break;
+        }
+
+        auto next = std::min_element(candidates.begin(), candidates.end(), [] (const Path &a, const Path &b) {
+            return a.back().gScore < b.back().gScore;
+        });
+        shortest.push_back(std::move(*next));
+        candidates.erase(next);
+    }
+
+    logger::verbose("Found %zu alternative routes in %zu paths", chosen.size(), shortest.size());
+
+    // one batch for all routes, magnetic variations are slow to get
+    std::vector<const Path *> paths;
+    for (size_t i: chosen) {
+        paths.push_back(&shortest[i]);
+    }
+    auto magVars = getPathMagVars(paths);
+
+    for (auto path: paths) {
+        Alternative alt;
+        alt.route = makeRoute(*path, magVars);
+        alt.distance = path->back().gScore;
+        alt.airwayChanges = countAirwayChanges(*path);
+        res.push_back(alt);
+    }
+    return res;
+}
+
+size_t RouteFinder::beginSearch() {
     logger::verbose("Searching route from %s to %s", departure->getID().c_str(), arrival->getID().c_str());
     directDistance = departure->getLocation().distanceTo(arrival->getLocation());
 
-    auto from = departure;
-    auto goal = arrival;
+    // airports with lazily loaded procedures only connect to the network once loaded
+    for (auto &node: {departure, arrival}) {
+        auto airport = std::dynamic_pointer_cast<Airport>(node);
+        if (airport) {
+            airport->loadProcedures();
+        }
+    }
 
     // Init
-    closedSet.clear();
-    openSet.clear();
-    openSet.insert(from);
-    cameFrom.clear();
-    gScore.clear();
-
-    // The cost from start to start is zero
-    gScore[from] = 0;
-    fScore[from] = minCostHeuristic(from, goal);
-
-    while (!openSet.empty()) {
-        Route::NodePtr current = getLowestOpen();
-        if (current == goal) {
-            logger::verbose("Route found");
-            std::shared_ptr<world::Route> route = std::make_shared<world::Route>(world, departure, arrival);
-            route->loadRoute(reconstructPath(goal));
-            return route;
-        }
-
-        openSet.erase(current);
-        closedSet.insert(current);
-
-        auto &neighbors = world->getConnections(current);
-        for (auto neighborConn: neighbors) {
-            auto &edge = std::get<0>(neighborConn);
-            auto &neighbor = std::get<1>(neighborConn);
+    treeValid = false;
+    prepareLandmarks();
+    nodeIndex.clear();
+    nodes.clear();
+    visits.clear();
+    openHeap.clear();
+    blockedNodes.clear();
+    spurBans.clear();
+    currentSearch = 0;
+    expanded = 0;
+
+    goalIndex = getNodeIndex(arrival);
+    return getNodeIndex(departure);
+}
+
+RouteFinder::PathResult RouteFinder::searchPath(size_t from, const Route::EdgePtr &arrivedVia, double startCost, Path &path) {
+    ++currentSearch;
+    openHeap.clear();
+
+    for (size_t n: blockedNodes) {
+        touch(n);
+        visits[n].closed = true;
+    }
+
+    // The cost up to the start is known
+    touch(from);
+    visits[from].cameFrom = Route::Leg(arrivedVia, nullptr);
+    visits[from].gScore = startCost;
+    visits[from].fScore = startCost + minCostHeuristic(from);
+    pushOpen(from);
+
+    return continueSearch(from, path);
+}
+
+RouteFinder::PathResult RouteFinder::continueSearch(size_t from, Path &path) {
+    static auto &expansions = platform::Metrics::counter("route/expansions");
+    while (!openHeap.empty()) {
+        if (cancelled) {
+            logger::verbose("Route search cancelled");
+            throw std::runtime_error("Route search cancelled");
+        }
+        if (expansionBudget && (expanded >= expansionBudget)) {
+            return PathResult::OVER_BUDGET;
+        }
+
+        size_t current = popLowestOpen();
+        ++expanded;
+        expansions.add();
+        if (onProgress && ((expanded % PROGRESS_INTERVAL) == 0)) {
+            onProgress(SearchProgress{expanded, visits[current].fScore});
+        }
+        if (current == goalIndex) {
+            path = tracePath(current);
+            return PathResult::FOUND;
+        }
+
+        visits[current].closed = true;
+
+        Route::NodePtr currentNode = nodes[current];
+        auto neighbors = world->getConnections(currentNode);
+        for (auto &neighborConn: *neighbors) {
+            auto &edge = neighborConn.via;
+            auto &neighbor = neighborConn.to;
             if (!edge || !neighbor) {
                 continue;
             }
@@ -86,66 +372,242 @@ std::shared_ptr<Route> RouteFinder::find() {
                 continue;
             }
 
-            if (closedSet.find(neighbor) != closedSet.end()) {
+            // visits may grow here, so entries are only accessed by index from now on
+            size_t next = getNodeIndex(neighbor);
+            touch(next);
+            if (visits[next].closed) {
                 continue;
             }
 
-            if (openSet.find(neighbor) == openSet.end()) {
-                openSet.insert(neighbor);
+            if ((current == from) && isSpurBanned(edge, next)) {
+                continue;
             }
 
-            double tentativeGScore = getGScore(current) + cost(current, Route::Leg(edge, neighbor));
-            if (tentativeGScore > getGScore(neighbor)) {
+            double tentativeGScore = visits[current].gScore + cost(current, neighborConn);
+            if (tentativeGScore > visits[next].gScore) {
                 continue;
             }
 
-            cameFrom[neighbor] = Route::Leg(edge, current);
-            gScore[neighbor] = tentativeGScore;
-            fScore[neighbor] = getGScore(neighbor) + minCostHeuristic(neighbor, goal);
+            auto &visit = visits[next];
+            visit.cameFrom = Route::Leg(edge, currentNode);
+            visit.parent = current;
+            visit.gScore = tentativeGScore;
+            visit.fScore = tentativeGScore + minCostHeuristic(next);
+            pushOpen(next);
         }
     }
 
-    logger::verbose("No route found");
-    throw std::runtime_error("No route found");
+    return PathResult::NO_PATH;
 }
 
-std::vector<Route::Leg> RouteFinder::reconstructPath(Route::NodePtr lastFix) {
-    logger::info("Backtracking route...");
-    std::vector<Route::Leg> res;
-    std::vector<std::pair<double, double>> locations;
+bool RouteFinder::canReplan() const {
+    if (!treeValid || (airwayLevel != treeLevel)) {
+        return false;
+    }
 
-    // Collate magnetic variations for the node locations used in the route
-    // Getting magVar from XPlane is asynchronous and slow, so batch request
-    auto locLast = lastFix->getLocation();
-    locations.push_back(std::make_pair(locLast.latitude, locLast.longitude));
+    // unblocked airways could make any part of the tree shorter
+    if (!std::includes(blockedAirways.begin(), blockedAirways.end(), treeBlockedAirways.begin(), treeBlockedAirways.end())) {
+        return false;
+    }
 
-    Route::Leg cur = cameFrom[lastFix];
-    decltype(cameFrom.find(nullptr)) it;
-    while ((it = cameFrom.find(cur.to)) != cameFrom.end()) {
-        cur = cameFrom[it->first];
-        auto loc = it->first->getLocation();
-        locations.push_back(std::make_pair(loc.latitude, loc.longitude));
+    // a new departure must be a finished node of the tree, its subtree then still holds shortest paths
+    auto it = nodeIndex.find(departure);
+    if (it == nodeIndex.end()) {
+        return false;
     }
-    auto magVarMap = getMagneticVariations(locations);
+    auto &visit = visits[it->second];
+    return (visit.search == currentSearch) && visit.closed;
+}
 
+RouteFinder::PathResult RouteFinder::replanPath(Path &path) {
+    logger::verbose("Re-planning route from %s to %s", departure->getID().c_str(), arrival->getID().c_str());
+    treeValid = false;
+    directDistance = departure->getLocation().distanceTo(arrival->getLocation());
+    expanded = 0;
 
-    // Now we've got magvars, reconstruct the path
-    cur = cameFrom[lastFix];
-    double magVar = magVarMap[std::make_pair(locLast.latitude, locLast.longitude)];
-    res.push_back(Route::Leg(cur.to, cur.via, lastFix, magVar));
+    auto airport = std::dynamic_pointer_cast<Airport>(arrival);
+    if (airport) {
+        airport->loadProcedures();
+    }
+
+    size_t root = nodeIndex[departure];
+    size_t oldGoal = goalIndex;
+    bool arrivalChanged = (arrival != treeArrival);
+
+    // a node stays if the tree path to it starts at the new root and uses no blocked
+    // airway. the procedure into the old arrival is only valid for that arrival.
+    enum : uint8_t { UNKNOWN, KEEP, DROP };
+    std::vector<uint8_t> state(nodes.size(), UNKNOWN);
+    state[root] = KEEP;
+    std::vector<size_t> chain;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        chain.clear();
+        size_t m = n;
+        uint8_t result = DROP;
+        while (m != NO_NODE) {
+            if (state[m] != UNKNOWN) {
+                result = state[m];
+                break;
+            }
+            auto &visit = visits[m];
+            auto &via = visit.cameFrom.via;
+            bool stale = (visit.search != currentSearch) ||
+                         (via && blockedAirways.count(via->getID())) ||
+                         (arrivalChanged && (m == oldGoal) && via && via->isProcedure());
+            chain.push_back(m);
+            if (stale) {
+                break;
+            }
+            m = visit.parent;
+        }
+        for (size_t c: chain) {
+            state[c] = result;
+        }
+    }
 
-    while ((it = cameFrom.find(cur.to)) != cameFrom.end()) {
-        cur = cameFrom[it->first];
-        auto loc = it->first->getLocation();
-        magVar = magVarMap[std::make_pair(loc.latitude, loc.longitude)];
-        res.push_back(Route::Leg(cur.to, cur.via, it->first, magVar));
+    // the kept paths now start at the root, the others are forgotten
+    double offset = visits[root].gScore;
+    openHeap.clear();
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        auto &visit = visits[n];
+        visit.heapPos = NO_NODE;
+        if (state[n] == KEEP) {
+            visit.gScore -= offset;
+        } else {
+            visit.search = 0;
+            touch(n);
+        }
+    }
+    visits[root].parent = NO_NODE;
+    visits[root].cameFrom = Route::Leg();
+
+    // the heuristic follows the arrival, then the open nodes are ordered by it again
+    goalIndex = getNodeIndex(arrival);
+    touch(goalIndex);
+    prepareLandmarks();
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        visits[n].landmarkRow = getLandmarkRow(nodes[n]);
     }
 
+    // finished nodes that can improve one of their neighbours are opened again. these are the
+    // ones next to dropped parts of the tree and those with new procedures into the arrival.
+    size_t finished = nodes.size();
+    for (size_t n = 0; n < finished; ++n) {
+        if (!visits[n].closed) {
+            continue;
+        }
+        auto neighbors = world->getConnections(nodes[n]);
+        for (auto &conn: *neighbors) {
+            if (!conn.via || !conn.to || !checkEdge(conn.via, conn.to)) {
+                continue;
+            }
+            size_t next = getNodeIndex(conn.to);
+            touch(next);
+            // the tolerance in metres covers the rounding of the rebased scores
+            if (visits[n].gScore + cost(n, conn) < visits[next].gScore - 1) {
+                visits[n].closed = false;
+                break;
+            }
+        }
+    }
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        auto &visit = visits[n];
+        if (!visit.closed && (visit.search == currentSearch) && (visit.gScore < std::numeric_limits<double>::infinity())) {
+            visit.fScore = visit.gScore + minCostHeuristic(n);
+            pushOpen(n);
+        }
+    }
+
+    treeRoot = root;
+    if (visits[goalIndex].closed) {
+        path = tracePath(goalIndex);
+        return PathResult::FOUND;
+    }
+    return continueSearch(root, path);
+}
+
+void RouteFinder::touch(size_t n) {
+    auto &visit = visits[n];
+    if (visit.search == currentSearch) {
+        return;
+    }
+    visit.search = currentSearch;
+    visit.gScore = std::numeric_limits<double>::infinity();
+    visit.fScore = std::numeric_limits<double>::infinity();
+    visit.cameFrom = Route::Leg();
+    visit.parent = NO_NODE;
+    visit.heapPos = NO_NODE;
+    visit.closed = false;
+}
+
+bool RouteFinder::isSpurBanned(const Route::EdgePtr &via, size_t to) const {
+    for (auto &ban: spurBans) {
+        if ((ban.first == via) && (ban.second == to)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+RouteFinder::Path RouteFinder::tracePath(size_t lastFix) const {
+    Path res;
+    for (size_t n = lastFix; n != NO_NODE; n = visits[n].parent) {
+        res.push_back(PathStep{n, visits[n].cameFrom.via, visits[n].gScore});
+    }
     std::reverse(std::begin(res), std::end(res));
+    return res;
+}
+
+size_t RouteFinder::countAirwayChanges(const Path &path) const {
+    size_t changes = 0;
+    for (size_t i = 1; i + 1 < path.size(); ++i) {
+        auto &in = path[i].via;
+        auto &out = path[i + 1].via;
+        if (in && out && (in != out) && !in->isProcedure() && !out->isProcedure()) {
+            ++changes;
+        }
+    }
+    return changes;
+}
 
+std::vector<const NavEdge *> RouteFinder::airwaySequence(const Path &path) const {
+    std::vector<const NavEdge *> res;
+    for (auto &step: path) {
+        if (step.via && (res.empty() || (res.back() != step.via.get()))) {
+            res.push_back(step.via.get());
+        }
+    }
     return res;
 }
 
+RouteFinder::MagVarMap RouteFinder::getPathMagVars(const std::vector<const Path *> &paths) {
+    // Collate magnetic variations for the node locations used in the routes
+    // Getting magVar from XPlane is asynchronous and slow, so batch request
+    std::vector<std::pair<double, double>> locations;
+    for (auto path: paths) {
+        for (size_t i = 1; i < path->size(); ++i) {
+            auto &loc = nodes[(*path)[i].node]->getLocation();
+            locations.push_back(std::make_pair(loc.latitude, loc.longitude));
+        }
+    }
+    return getMagneticVariations(locations);
+}
+
+std::shared_ptr<Route> RouteFinder::makeRoute(const Path &path, MagVarMap &magVars) const {
+    logger::info("Backtracking route...");
+    std::vector<Route::Leg> legs;
+    for (size_t i = 1; i < path.size(); ++i) {
+        auto &to = nodes[path[i].node];
+        auto &loc = to->getLocation();
+        double magVar = magVars[std::make_pair(loc.latitude, loc.longitude)];
+        legs.push_back(Route::Leg(nodes[path[i - 1].node], path[i].via, to, magVar));
+    }
+
+    auto route = std::make_shared<world::Route>(world, departure, arrival);
+    route->loadRoute(legs);
+    return route;
+}
+
 bool RouteFinder::checkEdge(const Route::EdgePtr via, const Route::NodePtr to) const {
     if (via->isProcedure()) {
         // We only allow SIDs, STARs etc. if they are start or end of the route.
@@ -153,51 +615,158 @@ bool RouteFinder::checkEdge(const Route::EdgePtr via, const Route::NodePtr to) c
         return world->areConnected(departure, to) || (to == arrival);
     } else {
         // Normal airways are allowed if their level matches the desired level
+        if (!blockedAirways.empty() && blockedAirways.count(via->getID())) {
+            return false;
+        }
         return via->supportsLevel(airwayLevel);
     }
 
 }
 
-Route::NodePtr RouteFinder::getLowestOpen() {
-    Route::NodePtr res = nullptr;
-    double best = std::numeric_limits<double>::infinity();
+size_t RouteFinder::getNodeIndex(const Route::NodePtr &node) {
+    auto it = nodeIndex.emplace(node, nodes.size());
+    if (it.second) {
+        nodes.push_back(node);
+        auto &visit = visits.emplace_back();
+        auto &loc = node->getLocation();
+        double phi = loc.latitude * M_PI / 180.0;
+        double lambda = loc.longitude * M_PI / 180.0;
+        visit.x = std::cos(phi) * std::cos(lambda);
+        visit.y = std::cos(phi) * std::sin(lambda);
+        visit.z = std::sin(phi);
+        visit.landmarkRow = getLandmarkRow(node);
+    }
+    return it.first->second;
+}
 
-    for (Route::NodePtr f: openSet) {
-        auto fScoreIt = fScore.find(f);
-        if (fScoreIt != fScore.end()) {
-            if (fScoreIt->second < best) {
-                res = fScoreIt->first;
-                best = fScoreIt->second;
-            }
+void RouteFinder::pushOpen(size_t n) {
+    // adds the node to the open set, or moves it up after its fScore decreased
+    if (visits[n].heapPos == NO_NODE) {
+        visits[n].heapPos = openHeap.size();
+        openHeap.push_back(n);
+    }
+    siftUp(visits[n].heapPos);
+}
+
+size_t RouteFinder::popLowestOpen() {
+    size_t lowest = openHeap.front();
+    size_t last = openHeap.back();
+    openHeap.pop_back();
+    visits[lowest].heapPos = NO_NODE;
+    if (!openHeap.empty()) {
+        openHeap[0] = last;
+        visits[last].heapPos = 0;
+        siftDown(0);
+    }
+    return lowest;
+}
+
+void RouteFinder::siftUp(size_t pos) {
+    size_t n = openHeap[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (visits[openHeap[parent]].fScore <= visits[n].fScore) {
+            break;
         }
+        openHeap[pos] = openHeap[parent];
+        visits[openHeap[pos]].heapPos = pos;
+        pos = parent;
     }
-    return res;
+    openHeap[pos] = n;
+    visits[n].heapPos = pos;
 }
 
-double RouteFinder::minCostHeuristic(Route::NodePtr a, Route::NodePtr b) {
-    // the minimum cost is a direct line
-    return a->getLocation().distanceTo(b->getLocation());
+void RouteFinder::siftDown(size_t pos) {
+    size_t n = openHeap[pos];
+    size_t count = openHeap.size();
+    while (true) {
+        size_t child = 2 * pos + 1;
+        if (child >= count) {
+            break;
+        }
+        if ((child + 1 < count) && (visits[openHeap[child + 1]].fScore < visits[openHeap[child]].fScore)) {
+            ++child;
+        }
+        if (visits[n].fScore <= visits[openHeap[child]].fScore) {
+            break;
+        }
+        openHeap[pos] = openHeap[child];
+        visits[openHeap[pos]].heapPos = pos;
+        pos = child;
+    }
+    openHeap[pos] = n;
+    visits[n].heapPos = pos;
 }
 
-double RouteFinder::cost(Route::NodePtr a, const Route::Leg& dir) {
-    // the actual cost can have penalties later
-    double penalty = 0;
-    auto it = cameFrom.find(a);
-    if (it != cameFrom.end()) {
-        if (it->second.via != dir.via) {
-            penalty += airwayChangePenalty * directDistance;
+double RouteFinder::minCostHeuristic(size_t a) const {
+    // the minimum cost is a direct line. the chord through the earth is never longer
+    // than the great circle, so it is an admissible estimate without any trigonometry.
+    auto &from = visits[a];
+    auto &to = visits[goalIndex];
+    double dx = from.x - to.x;
+    double dy = from.y - to.y;
+    double dz = from.z - to.z;
+    double estimate = EARTH_RADIUS_METRES * std::sqrt(dx * dx + dy * dy + dz * dz);
+
+    // the landmark bounds follow the airway network, they are much tighter when airways detour
+    if (from.landmarkRow != NO_ROW) {
+        double bound = std::numeric_limits<double>::infinity();
+        for (auto &goal: goalRows) {
+            bound = std::min(bound, activeLandmarks->lowerBound(from.landmarkRow, goal.first) + goal.second);
         }
+        estimate = std::max(estimate, bound);
     }
+    return estimate;
+}
 
-    return minCostHeuristic(a, dir.to) + penalty;
+uint32_t RouteFinder::getLandmarkRow(const Route::NodePtr &node) const {
+    if (!activeLandmarks) {
+        return NO_ROW;
+    }
+    uint32_t index = node->getGraphIndex();
+    if ((index == 0) || !activeLandmarks->contains(index - 1)) {
+        return NO_ROW;
+    }
+    return index - 1;
 }
 
-double RouteFinder::getGScore(Route::NodePtr f) {
-    auto it = gScore.find(f);
-    if (it == gScore.end()) {
-        return std::numeric_limits<double>::infinity();
+void RouteFinder::prepareLandmarks() {
+    activeLandmarks = nullptr;
+    goalRows.clear();
+    auto it = landmarks.find(airwayLevel);
+    if ((it == landmarks.end()) || !it->second) {
+        return;
     }
-    return it->second;
+    activeLandmarks = it->second.get();
+
+    // the search ends at the arrival itself, or for an airport outside of the airway
+    // network through one of the fixes its arrival procedures start from
+    uint32_t row = getLandmarkRow(arrival);
+    if (row != NO_ROW) {
+        goalRows.emplace_back(row, 0);
+    } else if (getArrivalFixes) {
+        for (auto &fix: getArrivalFixes(arrival)) {
+            uint32_t fixRow = getLandmarkRow(fix);
+            if (fixRow != NO_ROW) {
+                goalRows.emplace_back(fixRow, fix->getLocation().distanceTo(arrival->getLocation()));
+            }
+        }
+    }
+
+    if (goalRows.empty()) {
+        activeLandmarks = nullptr;
+    }
+}
+
+double RouteFinder::cost(size_t a, const World::Connection &conn) const {
+    // the actual cost can have penalties later
+    double penalty = 0;
+    auto &via = visits[a].cameFrom.via;
+    if (via && (via != conn.via)) {
+        penalty += airwayChangePenalty * directDistance;
+    }
+
+    return conn.distance + penalty;
 }
 
 } /* namespace world */
@@ -20,12 +20,18 @@
 
 #include <vector>
 #include <memory>
-#include <set>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <limits>
 #include <functional>
 #include <cmath>
+#include <atomic>
 #include "Route.h"
+#include "RouteLandmarks.h"
 #include "../models/Airway.h"
+#include "src/charts/APICall.h"
+#include "src/platform/Executor.h"
 
 namespace world {
 
@@ -34,40 +40,167 @@ public:
     using EdgeFilter = std::function<bool(const Route::EdgePtr, const Route::NodePtr)>;
     using MagVarMap = std::map<std::pair<double, double>, double>;
     using GetMagVarsCallback = std::function<MagVarMap(std::vector<std::pair<double, double>>)>;
+    using LandmarkMap = std::map<AirwayLevel, std::shared_ptr<const RouteLandmarks>>;
+    // nodes with a procedure leading to the given airport
+    using ArrivalFixesCallback = std::function<std::vector<Route::NodePtr>(const Route::NodePtr &)>;
+
+    struct SearchProgress {
+        size_t nodesExpanded = 0;
+        // lowest estimated total cost in metres of the routes still open
+        double bestFScore = 0;
+    };
+    using ProgressCallback = std::function<void(const SearchProgress &)>;
+    using SearchCall = apis::APICall<std::shared_ptr<Route>>;
+
+    struct Alternative {
+        std::shared_ptr<Route> route;
+        // length in metres, including airway change penalties
+        double distance = 0;
+        size_t airwayChanges = 0;
+    };
+    using AlternativesCall = apis::APICall<std::vector<Alternative>>;
 
     RouteFinder() = delete;
     RouteFinder(std::shared_ptr<world::World> world);
+    ~RouteFinder();
 
     void setDeparture(Route::NodePtr dep);
     void setArrival(Route::NodePtr arr);
     void setAirwayLevel(AirwayLevel level);
+    // searches avoid the airways with this ID until the blocks are cleared
+    void blockAirway(const std::string &id);
+    void clearBlockedAirways();
+    // departs from the end of the leg of the route nearest to the position, to
+    // re-plan a route that is already being flown. returns the new departure.
+    Route::NodePtr rejoinRoute(const Route &route, const Location &position);
     void setGetMagVarsCallback(GetMagVarsCallback cb);
+    // optional lower bounds per airway level, indexed by node graph index - 1
+    void setLandmarks(LandmarkMap tables, ArrivalFixesCallback arrivalFixes);
+    // a search gives up after expanding this many nodes, 0 for no limit
+    void setExpansionBudget(size_t maxExpansions);
+    // called by the searching thread every PROGRESS_INTERVAL expanded nodes
+    void setProgressCallback(ProgressCallback cb);
 
+    // after a search, find() re-plans incrementally when only the arrival changed,
+    // airways were blocked or the departure moved to a node of the previous route.
+    // the parts of the previous search tree that are still valid are kept.
     std::shared_ptr<Route> find();
+    // runs find() on a worker thread of the shared executor, which then calls back with the result.
+    // a search that is still running is cancelled first.
+    void findAsync(SearchCall::ThenCB then);
+    // up to count loopless routes, shortest first, each following a different sequence
+    // of airways. fails like find() if there is no route at all.
+    std::vector<Alternative> findAlternatives(size_t count);
+    void findAlternativesAsync(size_t count, AlternativesCall::ThenCB then);
+    // makes the running search fail, can be called from any thread
+    void cancel();
 
 private:
+    static constexpr const size_t PROGRESS_INTERVAL = 2000;
+    // alternatives are taken from at most this many shortest paths per requested route,
+    // the others only differ in the fixes along the same airways
+    static constexpr const size_t PATHS_PER_ALTERNATIVE = 8;
+
     std::shared_ptr<World> world;
     std::shared_ptr<NavNode> departure;
     std::shared_ptr<NavNode> arrival;
 
     GetMagVarsCallback getMagneticVariations;
 
+    LandmarkMap landmarks;
+    ArrivalFixesCallback getArrivalFixes;
+    // the table of the current search and the rows the search may end at, each
+    // with the straight line distance still to go from there to the arrival
+    const RouteLandmarks *activeLandmarks = nullptr;
+    std::vector<std::pair<uint32_t, double>> goalRows;
+
+    size_t expansionBudget = 0;
+    size_t expanded = 0;
+    ProgressCallback onProgress;
+    std::atomic_bool cancelled { false };
+    std::shared_ptr<platform::Executor::Job> worker;
+
     double directDistance = 0;
     AirwayLevel airwayLevel = AirwayLevel::LOWER;
     float airwayChangePenalty = 0;
 
-    std::set<Route::NodePtr> closedSet;
-    std::set<Route::NodePtr> openSet;
-    std::map<Route::NodePtr, Route::Leg> cameFrom;
-    std::map<Route::NodePtr, double> gScore;
-    std::map<Route::NodePtr, double> fScore;
+    static constexpr size_t NO_NODE = std::numeric_limits<size_t>::max();
+    static constexpr double EARTH_RADIUS_METRES = 6371000;
+    static constexpr uint32_t NO_ROW = std::numeric_limits<uint32_t>::max();
+
+    // search state of a node, nodes are numbered densely as the search reaches them
+    struct Visit {
+        double gScore = std::numeric_limits<double>::infinity();
+        double fScore = std::numeric_limits<double>::infinity();
+        Route::Leg cameFrom;
+        size_t parent = NO_NODE;
+        size_t heapPos = NO_NODE;
+        bool closed = false;
+        // the search that last reset this entry, older entries count as unvisited
+        uint32_t search = 0;
+        // position on the unit sphere, for the heuristic
+        double x = 0, y = 0, z = 0;
+        uint32_t landmarkRow = NO_ROW;
+    };
+
+    std::unordered_map<Route::NodePtr, size_t> nodeIndex;
+    std::vector<Route::NodePtr> nodes;
+    std::vector<Visit> visits;
+
+    // binary min-heap of the open node numbers ordered by fScore
+    std::vector<size_t> openHeap;
+    size_t goalIndex = NO_NODE;
+    uint32_t currentSearch = 0;
+
+    // a found path, each step with the edge leading to it and the cost from the departure
+    struct PathStep {
+        size_t node;
+        Route::EdgePtr via;
+        double gScore;
+    };
+    using Path = std::vector<PathStep>;
+    enum class PathResult { FOUND, NO_PATH, OVER_BUDGET };
+
+    // restrictions of the spur searches for alternatives: nodes the path must not
+    // visit and edges it must not take when leaving its first node
+    std::vector<size_t> blockedNodes;
+    std::vector<std::pair<Route::EdgePtr, size_t>> spurBans;
+
+    std::set<std::string> blockedAirways;
+
+    // the tree of the last complete, failed or abandoned search that can be continued
+    bool treeValid = false;
+    AirwayLevel treeLevel = AirwayLevel::LOWER;
+    size_t treeRoot = NO_NODE;
+    Route::NodePtr treeArrival;
+    std::set<std::string> treeBlockedAirways;
 
+    std::shared_ptr<Route> search();
+    std::vector<Alternative> searchAlternatives(size_t count);
+    size_t beginSearch();
+    PathResult searchPath(size_t from, const Route::EdgePtr &arrivedVia, double startCost, Path &path);
+    PathResult continueSearch(size_t from, Path &path);
+    bool canReplan() const;
+    PathResult replanPath(Path &path);
+    void touch(size_t n);
+    bool isSpurBanned(const Route::EdgePtr &via, size_t to) const;
+    void startWorker(std::shared_ptr<apis::BaseCall> call);
+    void stopWorker();
     bool checkEdge(const Route::EdgePtr via, const Route::NodePtr to) const;
-    Route::NodePtr getLowestOpen();
-    double minCostHeuristic(Route::NodePtr a, Route::NodePtr b);
-    double cost(Route::NodePtr a, const Route::Leg &dir);
-    double getGScore(Route::NodePtr f);
-    std::vector<Route::Leg> reconstructPath(Route::NodePtr lastFix);
+    size_t getNodeIndex(const Route::NodePtr &node);
+    uint32_t getLandmarkRow(const Route::NodePtr &node) const;
+    void prepareLandmarks();
+    void pushOpen(size_t n);
+    size_t popLowestOpen();
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+    double minCostHeuristic(size_t a) const;
+    double cost(size_t a, const World::Connection &conn) const;
+    Path tracePath(size_t lastFix) const;
+    size_t countAirwayChanges(const Path &path) const;
+    std::vector<const NavEdge *> airwaySequence(const Path &path) const;
+    MagVarMap getPathMagVars(const std::vector<const Path *> &paths);
+    std::shared_ptr<Route> makeRoute(const Path &path, MagVarMap &magVars) const;
 };
 
 } /* namespace world */
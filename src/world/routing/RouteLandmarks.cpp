@@ -0,0 +1,180 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <queue>
+#include <limits>
+#include <cmath>
+#include <functional>
+#include "RouteLandmarks.h"
+
+namespace world {
+
+RouteLandmarks::RouteLandmarks(const std::vector<Location> &locations, const std::vector<uint32_t> &offsets,
+                               const std::vector<Edge> &edges, size_t landmarkCount):
+    nodeCount(locations.size()),
+    linked(locations.size(), false)
+{
+    for (size_t n = 0; n < nodeCount; ++n) {
+        if (offsets[n] != offsets[n + 1]) {
+            linked[n] = true;
+        }
+    }
+    for (auto &e: edges) {
+        linked[e.first] = true;
+    }
+
+    auto chosen = chooseLandmarks(locations, landmarkCount);
+    landmarks = chosen.size();
+    fromLandmark.assign(nodeCount * landmarks, std::numeric_limits<float>::infinity());
+    toLandmark.assign(nodeCount * landmarks, std::numeric_limits<float>::infinity());
+
+    // distances to a landmark are distances from it in the reversed network
+    std::vector<uint32_t> reverseOffsets(nodeCount + 1, 0);
+    for (auto &e: edges) {
+        ++reverseOffsets[e.first + 1];
+    }
+    for (size_t n = 0; n < nodeCount; ++n) {
+        reverseOffsets[n + 1] += reverseOffsets[n];
+    }
+    std::vector<Edge> reverseEdges(edges.size());
+    std::vector<uint32_t> fill(reverseOffsets.begin(), reverseOffsets.end() - 1);
+    for (size_t n = 0; n < nodeCount; ++n) {
+        for (auto e = offsets[n]; e < offsets[n + 1]; ++e) {
+            reverseEdges[fill[edges[e].first]++] = Edge(n, edges[e].second);
+        }
+    }
+
+    for (size_t l = 0; l < landmarks; ++l) {
+        storeShortestPaths(chosen[l], l, offsets, edges, fromLandmark);
+        storeShortestPaths(chosen[l], l, reverseOffsets, reverseEdges, toLandmark);
+    }
+}
+
+size_t RouteLandmarks::size() const {
+    return nodeCount;
+}
+
+bool RouteLandmarks::contains(uint32_t n) const {
+    return (n < nodeCount) && linked[n];
+}
+
+double RouteLandmarks::lowerBound(uint32_t a, uint32_t b) const {
+    const float *fromA = &fromLandmark[a * landmarks];
+    const float *fromB = &fromLandmark[b * landmarks];
+    const float *toA = &toLandmark[a * landmarks];
+    const float *toB = &toLandmark[b * landmarks];
+
+    double best = 0;
+    for (size_t l = 0; l < landmarks; ++l) {
+        if (std::isfinite(fromA[l])) {
+            if (!std::isfinite(fromB[l])) {
+                // the landmark reaches a but not b, so a can't reach b either
+                return std::numeric_limits<double>::infinity();
+            }
+            best = std::max(best, (double) fromB[l] - fromA[l]);
+        }
+        if (std::isfinite(toB[l])) {
+            if (!std::isfinite(toA[l])) {
+                return std::numeric_limits<double>::infinity();
+            }
+            best = std::max(best, (double) toA[l] - toB[l]);
+        }
+    }
+    return best;
+}
+
+std::vector<uint32_t> RouteLandmarks::chooseLandmarks(const std::vector<Location> &locations, size_t count) const {
+    // landmarks on the rim of the network give the best bounds, so each one is the
+    // node farthest from those chosen before. only nodes with edges can be landmarks.
+    std::vector<double> x(nodeCount), y(nodeCount), z(nodeCount);
+    for (size_t n = 0; n < nodeCount; ++n) {
+        double phi = locations[n].latitude * M_PI / 180.0;
+        double lambda = locations[n].longitude * M_PI / 180.0;
+        x[n] = std::cos(phi) * std::cos(lambda);
+        y[n] = std::cos(phi) * std::sin(lambda);
+        z[n] = std::sin(phi);
+    }
+
+    std::vector<uint32_t> chosen;
+    std::vector<double> nearest(nodeCount, std::numeric_limits<double>::infinity());
+    auto farthest = [&] () {
+        uint32_t best = 0;
+        double bestDistance = -1;
+        for (size_t n = 0; n < nodeCount; ++n) {
+            if (linked[n] && (nearest[n] > bestDistance)) {
+                best = n;
+                bestDistance = nearest[n];
+            }
+        }
+        return std::make_pair(best, bestDistance);
+    };
+    auto addChord = [&] (uint32_t from) {
+        for (size_t n = 0; n < nodeCount; ++n) {
+            double dx = x[n] - x[from], dy = y[n] - y[from], dz = z[n] - z[from];
+            nearest[n] = std::min(nearest[n], dx * dx + dy * dy + dz * dz);
+        }
+    };
+
+    // start from the node farthest from an arbitrary one
+    auto seed = farthest();
+    if (seed.second < 0) {
+        return chosen;
+    }
+    addChord(seed.first);
+    while (chosen.size() < count) {
+        auto next = farthest();
+        if (next.second <= 0) {
+            break;
+        }
+        chosen.push_back(next.first);
+        if (chosen.size() == 1) {
+            std::fill(nearest.begin(), nearest.end(), std::numeric_limits<double>::infinity());
+        }
+        addChord(next.first);
+    }
+    return chosen;
+}
+
+void RouteLandmarks::storeShortestPaths(uint32_t source, size_t landmark, const std::vector<uint32_t> &offsets,
+                                        const std::vector<Edge> &edges, std::vector<float> &table) {
+    std::vector<double> distance(nodeCount, std::numeric_limits<double>::infinity());
+    using Entry = std::pair<double, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    distance[source] = 0;
+    queue.emplace(0, source);
+    while (!queue.empty()) {
+        auto top = queue.top();
+        queue.pop();
+        if (top.first > distance[top.second]) {
+            continue;
+        }
+        for (auto e = offsets[top.second]; e < offsets[top.second + 1]; ++e) {
+            double d = top.first + edges[e].second;
+            if (d < distance[edges[e].first]) {
+                distance[edges[e].first] = d;
+                queue.emplace(d, edges[e].first);
+            }
+        }
+    }
+
+    for (size_t n = 0; n < nodeCount; ++n) {
+        table[n * landmarks + landmark] = distance[n];
+    }
+}
+
+} /* namespace world */
@@ -0,0 +1,68 @@
+/*
+ *   AviTab - Aviator's Virtual Tablet
+ *   Copyright (C) 2024 Folke Will <folko@solhost.org>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Affero General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Affero General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Affero General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "src/world/models/Location.h"
+
+namespace world {
+
+/*
+ * Shortest network distances to and from a few landmark nodes, for lower bounds
+ * of route searches (ALT: A*, landmarks and the triangle inequality). For any
+ * landmark L, d(a, b) >= d(L, b) - d(L, a) and d(a, b) >= d(a, L) - d(b, L).
+ * On an airway network these bounds are much tighter than the straight line,
+ * which lets the search skip most of the network. The table is immutable once
+ * built and can be shared between searches.
+ */
+class RouteLandmarks {
+public:
+    static constexpr const size_t DEFAULT_LANDMARKS = 8;
+
+    // target node and length in metres
+    using Edge = std::pair<uint32_t, float>;
+
+    // the edges leaving node n are edges[offsets[n]] up to edges[offsets[n + 1]]
+    RouteLandmarks(const std::vector<Location> &locations, const std::vector<uint32_t> &offsets,
+                   const std::vector<Edge> &edges, size_t landmarkCount = DEFAULT_LANDMARKS);
+
+    size_t size() const;
+    // true if the node has any edge in the network the table was built for
+    bool contains(uint32_t n) const;
+
+    // lower bound in metres of any network path from node a to node b, infinite if there is none
+    double lowerBound(uint32_t a, uint32_t b) const;
+
+private:
+    size_t nodeCount;
+    size_t landmarks = 0;
+    std::vector<bool> linked;
+
+    // node-major, the distances of one node to all landmarks are adjacent
+    std::vector<float> fromLandmark;
+    std::vector<float> toLandmark;
+
+    std::vector<uint32_t> chooseLandmarks(const std::vector<Location> &locations, size_t count) const;
+    void storeShortestPaths(uint32_t source, size_t landmark, const std::vector<uint32_t> &offsets,
+                            const std::vector<Edge> &edges, std::vector<float> &table);
+};
+
+} /* namespace world */